@@ -0,0 +1,46 @@
+# - EmbedSpirv
+#
+# vk_video_embed_spirv(<spirv dir> <output file>)
+#
+# Writes the <hash>.spv files of the directory, as written to the shader cache directory
+# (--pipelineCacheDir) by VulkanShaderCompiler, into a table included by VulkanShaderCompiler.cpp.
+# The shaders of that table are looked up before the cache directory and before shaderc.
+# Sets VK_VIDEO_PRECOMPILED_SPIRV_FOUND when the directory had any SPIR-V in it.
+# Re-run CMake after adding files to the directory.
+
+function(vk_video_embed_spirv SPIRV_DIR OUTPUT_FILE)
+    file(GLOB spirv_files "${SPIRV_DIR}/*.spv")
+    list(SORT spirv_files)
+
+    set(declarations "")
+    set(entries "")
+    set(num_entries 0)
+    foreach(spirv_file ${spirv_files})
+        get_filename_component(spirv_name "${spirv_file}" NAME_WE)
+        string(LENGTH "${spirv_name}" spirv_name_length)
+        if(NOT spirv_name_length EQUAL 16 OR NOT spirv_name MATCHES "^[0-9a-fA-F]+$")
+            message(WARNING "EmbedSpirv: ${spirv_file} isn't named after the hash of its GLSL, skipped")
+        else()
+            file(READ "${spirv_file}" spirv_hex HEX)
+            string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," spirv_bytes "${spirv_hex}")
+            set(declarations "${declarations}alignas(4) static const uint8_t s_spirv_${spirv_name}[] = {${spirv_bytes}};\n")
+            set(entries "${entries}    { 0x${spirv_name}ULL, sizeof(s_spirv_${spirv_name}), s_spirv_${spirv_name} },\n")
+            math(EXPR num_entries "${num_entries} + 1")
+        endif()
+    endforeach()
+
+    if(num_entries EQUAL 0)
+        message(STATUS "EmbedSpirv: no SPIR-V in ${SPIRV_DIR}")
+        set(VK_VIDEO_PRECOMPILED_SPIRV_FOUND FALSE PARENT_SCOPE)
+        return()
+    endif()
+
+    file(WRITE "${OUTPUT_FILE}"
+        "// Generated by cmake/EmbedSpirv.cmake from ${SPIRV_DIR}, do not edit\n"
+        "${declarations}\n"
+        "static const VulkanPrecompiledSpirv s_precompiledSpirv[] = {\n"
+        "${entries}"
+        "};\n")
+    message(STATUS "EmbedSpirv: ${num_entries} shaders from ${SPIRV_DIR}")
+    set(VK_VIDEO_PRECOMPILED_SPIRV_FOUND TRUE PARENT_SCOPE)
+endfunction()
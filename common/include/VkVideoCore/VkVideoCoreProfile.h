@@ -49,7 +49,11 @@ public:
         return  (videoCodecOperations & (VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR |
                                          VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR |
                                          VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR |
-                                         VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR));
+                                         VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR
+#ifdef VK_KHR_video_encode_av1
+                                         | VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR
+#endif
+                                         ));
     }
 
     bool PopulateProfileExt(VkBaseInStructure const * pVideoProfileExt)
@@ -116,6 +120,23 @@ public:
             }
             m_profile.pNext = &m_h265EncodeProfile;
             m_h265EncodeProfile.pNext = NULL;
+#ifdef VK_KHR_video_encode_av1
+        } else if (m_profile.videoCodecOperation == VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR) {
+            VkVideoEncodeAV1ProfileInfoKHR const * pProfileExt = (VkVideoEncodeAV1ProfileInfoKHR const *)pVideoProfileExt;
+            if (pProfileExt && (pProfileExt->sType != VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_PROFILE_INFO_KHR)) {
+                m_profile.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+                return false;
+            }
+            if (pProfileExt) {
+                m_av1EncodeProfile = *pProfileExt;
+            } else {
+                //  Use default ext profile parameters
+                m_av1EncodeProfile.sType      = VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_PROFILE_INFO_KHR;
+                m_av1EncodeProfile.stdProfile = STD_VIDEO_AV1_PROFILE_MAIN;
+            }
+            m_profile.pNext = &m_av1EncodeProfile;
+            m_av1EncodeProfile.pNext = NULL;
+#endif
         } else {
             assert(!"Unknown codec!");
             return false;
@@ -155,6 +176,9 @@ public:
         VkVideoDecodeH265ProfileInfoKHR decodeH265ProfilesRequest;
         VkVideoEncodeH264ProfileInfoKHR encodeH264ProfilesRequest;
         VkVideoEncodeH265ProfileInfoKHR encodeH265ProfilesRequest;
+#ifdef VK_KHR_video_encode_av1
+        VkVideoEncodeAV1ProfileInfoKHR encodeAV1ProfilesRequest;
+#endif
         VkBaseInStructure* pVideoProfileExt = NULL;
 
         if (videoCodecOperation == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
@@ -186,6 +210,14 @@ public:
                                                        STD_VIDEO_H265_PROFILE_IDC_INVALID :
                                                        (StdVideoH265ProfileIdc)videoH26xProfileIdc;
             pVideoProfileExt = (VkBaseInStructure*)&encodeH265ProfilesRequest;
+#ifdef VK_KHR_video_encode_av1
+        } else if (videoCodecOperation == VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR) {
+            // The seq_profile, MAIN for the 8 and 10 bit 4:2:0
+            encodeAV1ProfilesRequest.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_PROFILE_INFO_KHR;
+            encodeAV1ProfilesRequest.pNext = NULL;
+            encodeAV1ProfilesRequest.stdProfile = (StdVideoAV1Profile)videoH26xProfileIdc;
+            pVideoProfileExt = (VkBaseInStructure*)&encodeAV1ProfilesRequest;
+#endif
         } else {
             assert(!"Unknown codec!");
             return;
@@ -202,7 +234,11 @@ public:
     bool IsEncodeCodecType() const
     {
         return ((m_profile.videoCodecOperation == VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR) ||
-                (m_profile.videoCodecOperation == VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR));
+                (m_profile.videoCodecOperation == VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR)
+#ifdef VK_KHR_video_encode_av1
+                || (m_profile.videoCodecOperation == VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR)
+#endif
+                );
     }
 
     bool IsDecodeCodecType() const
@@ -327,6 +363,29 @@ public:
         return !(*this == other);
     }
 
+    // operator== does not compare the codec specific profile
+    bool IsSameCodecProfile(const VkVideoCoreProfile& other) const
+    {
+        if (*this != other) {
+            return false;
+        }
+
+        if (GetCodecType() == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
+            const VkVideoDecodeH264ProfileInfoKHR* pH264Profile = GetDecodeH264Profile();
+            const VkVideoDecodeH264ProfileInfoKHR* pOtherH264Profile = other.GetDecodeH264Profile();
+            return (pH264Profile && pOtherH264Profile &&
+                    (pH264Profile->stdProfileIdc == pOtherH264Profile->stdProfileIdc) &&
+                    (pH264Profile->pictureLayout == pOtherH264Profile->pictureLayout));
+        } else if (GetCodecType() == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR) {
+            const VkVideoDecodeH265ProfileInfoKHR* pH265Profile = GetDecodeH265Profile();
+            const VkVideoDecodeH265ProfileInfoKHR* pOtherH265Profile = other.GetDecodeH265Profile();
+            return (pH265Profile && pOtherH265Profile &&
+                    (pH265Profile->stdProfileIdc == pOtherH265Profile->stdProfileIdc));
+        }
+
+        return true;
+    }
+
     VkVideoChromaSubsamplingFlagsKHR GetColorSubsampling() const
     {
         return m_profile.chromaSubsampling;
@@ -510,6 +569,10 @@ public:
             return "encode h.264";
         case VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR:
             return "encode h.265";
+#ifdef VK_KHR_video_encode_av1
+        case VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR:
+            return "encode av1";
+#endif
         default:;
         }
         assert(!"Unknown codec");
@@ -668,6 +731,9 @@ private:
         VkVideoDecodeH265ProfileInfoKHR m_h265DecodeProfile;
         VkVideoEncodeH264ProfileInfoKHR m_h264EncodeProfile;
         VkVideoEncodeH265ProfileInfoKHR m_h265EncodeProfile;
+#ifdef VK_KHR_video_encode_av1
+        VkVideoEncodeAV1ProfileInfoKHR  m_av1EncodeProfile;
+#endif
     };
 };
 
@@ -164,6 +164,15 @@ public:
             assert(pH265EncCapabilities->sType ==  VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_CAPABILITIES_KHR);
         }
             break;
+#ifdef VK_KHR_video_encode_av1
+        case VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR:
+        {
+            assert(pVideoEncodeCapabilities->pNext);
+            const VkVideoEncodeAV1CapabilitiesKHR* pAV1EncCapabilities = (VkVideoEncodeAV1CapabilitiesKHR*)pVideoEncodeCapabilities->pNext;
+            assert(pAV1EncCapabilities->sType ==  VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_CAPABILITIES_KHR);
+        }
+            break;
+#endif
         default:
             assert(!"Unsupported codec");
             return VK_ERROR_FORMAT_NOT_SUPPORTED;
@@ -66,6 +66,9 @@ public:
                          uint32_t           signalSemaphoreCount = 0,
                          const VkSemaphore* pSignalSemaphores = nullptr) = 0;
 
+    // The decode order of the frame rendered by the last OnFrame(), -1 without one
+    virtual int64_t GetLastRenderedFrameId() const { return -1; }
+
     uint64_t GetTimeDiffNanoseconds(bool updateStartTime = true)
     {
         auto timeNow = std::chrono::steady_clock::now();
@@ -25,6 +25,7 @@
 #include <string>
 #include <vector>
 #include "vulkan_interfaces.h"
+#include "VkCodecUtils/VkThreadAffinity.h"
 
 struct ProgramConfig {
 
@@ -37,8 +38,36 @@ struct ProgramConfig {
         videoHeight = 0;
         queueCount = 1;
         numDecodeImagesInFlight = 8;
-        numDecodeImagesToPreallocate = -1; // pre-allocate the maximum num of images
+        numDecodeImagesToPreallocate = 0; // allocate the images on first use, -1 pre-allocates the maximum num of images
         numBitstreamBuffersToPreallocate = 8;
+        bitstreamBufferIdleTrimMs = 2000;
+        bitstreamRingBufferSizeMB = 0; // 0 uses a bitstream buffer per picture
+        decodeImageIdleFrames = 120;
+        deviceMemoryArenaBlockSizeMB = 64; // 0 disables the sub-allocation of the images and buffers
+        deviceMemoryBudgetMB = 0; // 0 admits the streams against the memory budget of the device only
+        sharedImagePoolMaxIdleImages = 8; // 0 disables the sharing of the decode images between the decoders
+        sessionPoolMaxIdleSessions = 4; // 0 disables the reuse of the decode sessions between the decoders
+        decodeSubmitBatchSize = 1; // 1 submits each decoded picture right away
+        decodeSubmitBatchLatencyMs = 4;
+        decodeCommandBatchSize = 0; // 0 records each decoded picture in its own command buffer
+        decodeAheadDepth = 8;
+        streamWorkers = 0;
+        capacityTargetFps = 30.0;
+        capacityMaxLatencyMs = 0.0; // 0 bounds the latency to two frame intervals
+        capacityMaxSessions = 64;
+        liveVideoQueues = 0; // 0 creates all the decode queues at the same priority
+        queueGlobalPriority = 0; // 0 keeps the default global priority of the video queues
+        liveStream = false;
+        preallocateSessionWidth = 0;
+        preallocateSessionHeight = 0;
+        renderQueueDepth = 0;
+        adaptiveDecodeAheadLatencyMs = -1;
+        displayRefreshMilliHz = 0;
+        metricsPort = 0;
+        seekFrame = 0;
+        maxTemporalLayers = 0;
+        maxScalableLayers = 0;
+        bitstreamWindowSize = 0;
         backBufferCount = 8;
         ticksPerSecond = 30;
         vsync = true;
@@ -49,6 +78,14 @@ struct ProgramConfig {
 
         noTick = false;
         noPresent = false;
+        benchmark = false;
+        capacityBenchmark = false;
+        decodeSubmitThread = false;
+        decodeReferenceOnly = false;
+        decodeKeyFramesOnly = false;
+        errorResilient = false;
+        deferSliceHeaders = false;
+        preallocateSession = false;
 
         maxFrameCount = -1;
         videoFileName = "";
@@ -62,8 +99,34 @@ struct ProgramConfig {
         deviceId = (uint32_t)-1;
         directMode = false;
         enableHwLoadBalancing = false;
+        asyncDecodeStatus = false;
+        asyncFrameOutput = false;
+        gpuTimestamps = false;
+        frameAnalytics = false;
+        thumbnailIntervalSeconds = 0.0;
+        thumbnailFormat = VK_FORMAT_UNDEFINED;
+        thumbnailExtent = { 0, 0 };
+        thumbnailFileName = "thumbnail";
+        thumbnailStrip = false;
+        gpuFrameOutput = false;
+        hostCachedFrameOutput = false;
+        hugePageStaging = false;
+        deviceLocalBitstream = false;
+        autoFrameOutputConversion = false;
+        outputFormat = 0;
+        frameChecksum = 0;
+        enableNalPreScan = false;
         selectVideoWithComputeQueue = false;
         enableVideoEncoder = false;
+        enableAllGpus = false;
+        presentPacing = false;
+        computePresent = false;
+        lowLatencyDisplay = false;
+        renderNewest = false;
+        mosaic = false;
+        exportFrames = false;
+        deviceMemoryReport = false;
+        latencyReport = false;
     }
 
     void ParseArgs(int argc, const char* argv[]) {
@@ -82,6 +145,318 @@ struct ProgramConfig {
                 } else if ((nullptr != strstr(argv[i], "4")) || (nullptr != strstr(argv[i], "h264"))) {
                     forceParserType = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR;
                 }
+            } else if (nullptr != strstr(argv[i], "--bitstreamBufferIdleTrimMs")) {
+                i++;
+                if (argv[i])
+                    bitstreamBufferIdleTrimMs = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--bitstreamRingBufferSizeMB")) {
+                i++;
+                if (argv[i])
+                    bitstreamRingBufferSizeMB = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--numDecodeImagesToPreallocate")) {
+                i++;
+                if (argv[i])
+                    numDecodeImagesToPreallocate = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--decodeImageIdleFrames")) {
+                i++;
+                if (argv[i])
+                    decodeImageIdleFrames = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--preallocateSession")) {
+                // <width>x<height>, or max for the extent of the capabilities
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                preallocateSession = true;
+                if (sscanf(argv[i], "%dx%d", &preallocateSessionWidth, &preallocateSessionHeight) != 2) {
+                    preallocateSessionWidth = 0;
+                    preallocateSessionHeight = 0;
+                }
+            } else if (nullptr != strstr(argv[i], "--deviceMemoryArenaBlockSizeMB")) {
+                i++;
+                if (argv[i])
+                    deviceMemoryArenaBlockSizeMB = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--deviceMemoryBudgetMB")) {
+                i++;
+                if (argv[i])
+                    deviceMemoryBudgetMB = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--deviceMemoryReport")) {
+                deviceMemoryReport = true;
+            } else if (nullptr != strstr(argv[i], "--latencyReport")) {
+                latencyReport = true;
+            } else if (nullptr != strstr(argv[i], "--sharedImagePoolMaxIdleImages")) {
+                i++;
+                if (argv[i])
+                    sharedImagePoolMaxIdleImages = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--sessionPoolMaxIdleSessions")) {
+                i++;
+                if (argv[i])
+                    sessionPoolMaxIdleSessions = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--decodeSubmitBatchSize")) {
+                i++;
+                if (argv[i])
+                    decodeSubmitBatchSize = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--decodeSubmitBatchLatencyMs")) {
+                i++;
+                if (argv[i])
+                    decodeSubmitBatchLatencyMs = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--decodeCommandBatch")) {
+                i++;
+                if (argv[i])
+                    decodeCommandBatchSize = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--decodeSubmitThread")) {
+                decodeSubmitThread = true;
+            } else if (nullptr != strstr(argv[i], "--seekFrame")) {
+                i++;
+                if (argv[i])
+                    seekFrame = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--streamIndex")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                streamIndexFileName = argv[i];
+            } else if (nullptr != strstr(argv[i], "--decodeReferenceOnly")) {
+                decodeReferenceOnly = true;
+            } else if (nullptr != strstr(argv[i], "--decodeKeyFramesOnly")) {
+                decodeKeyFramesOnly = true;
+            } else if (nullptr != strstr(argv[i], "--errorResilient")) {
+                errorResilient = true;
+            } else if (nullptr != strstr(argv[i], "--deferSliceHeaders")) {
+                deferSliceHeaders = true;
+            } else if (nullptr != strstr(argv[i], "--maxTemporalLayers")) {
+                i++;
+                if (argv[i])
+                    maxTemporalLayers = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--maxScalableLayers")) {
+                i++;
+                if (argv[i])
+                    maxScalableLayers = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--seiPayloadTypes")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                seiPayloadTypes.clear();
+                for (const char* p = argv[i]; *p != '\0';) {
+                    char* pEnd = nullptr;
+                    const unsigned long payloadType = strtoul(p, &pEnd, 10);
+                    if ((pEnd == p) || (payloadType > 255) || ((*pEnd != ',') && (*pEnd != '\0'))) {
+                        std::cerr << "Invalid SEI payload types for --seiPayloadTypes: " << argv[i] << std::endl;
+                        seiPayloadTypes.clear();
+                        break;
+                    }
+                    seiPayloadTypes.push_back((uint32_t)payloadType);
+                    p = (*pEnd == ',') ? (pEnd + 1) : pEnd;
+                }
+            } else if (nullptr != strstr(argv[i], "--bitstreamWindowSize")) {
+                i++;
+                if (argv[i])
+                    bitstreamWindowSize = std::atoll(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--pipelineCacheDir")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                pipelineCacheDir = argv[i];
+            } else if (nullptr != strstr(argv[i], "--fastStartup")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                deviceCacheFileName = argv[i];
+            } else if (nullptr != strstr(argv[i], "--parserCpus")) {
+                i++;
+                if (argv[i] && !VkParseCpuList(argv[i], parserCpus))
+                    std::cerr << "Invalid CPU list for --parserCpus: " << argv[i] << std::endl;
+            } else if (nullptr != strstr(argv[i], "--writerCpus")) {
+                i++;
+                if (argv[i] && !VkParseCpuList(argv[i], writerCpus))
+                    std::cerr << "Invalid CPU list for --writerCpus: " << argv[i] << std::endl;
+            } else if (nullptr != strstr(argv[i], "--benchmark")) {
+                benchmark = true;
+            } else if (nullptr != strstr(argv[i], "--capacityBenchmark")) {
+                capacityBenchmark = true;
+                noPresent = true;
+            } else if (nullptr != strstr(argv[i], "--capacityTargetFps")) {
+                i++;
+                if (argv[i])
+                    capacityTargetFps = std::atof(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--capacityMaxLatencyMs")) {
+                i++;
+                if (argv[i])
+                    capacityMaxLatencyMs = std::atof(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--capacityMaxSessions")) {
+                i++;
+                if (argv[i])
+                    capacityMaxSessions = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--captureDecode")) {
+                i++;
+                if (argv[i]) {
+                    decodeCaptureFileName = argv[i];
+                }
+            } else if (nullptr != strstr(argv[i], "--replayDecode")) {
+                i++;
+                if (argv[i]) {
+                    decodeReplayFileName = argv[i];
+                    // The replay measures the decoder alone, nothing is presented
+                    noPresent = true;
+                }
+            } else if (nullptr != strstr(argv[i], "--decodeAheadDepth")) {
+                i++;
+                if (argv[i])
+                    decodeAheadDepth = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--hostCachedFrameOutput")) {
+                hostCachedFrameOutput = true;
+            } else if (nullptr != strstr(argv[i], "--hugePageStaging")) {
+                hugePageStaging = true;
+            } else if (nullptr != strstr(argv[i], "--deviceLocalBitstream")) {
+                deviceLocalBitstream = true;
+            } else if (nullptr != strstr(argv[i], "--autoFrameOutputConversion")) {
+                autoFrameOutputConversion = true;
+            } else if (nullptr != strstr(argv[i], "--conversionCalibrationCache")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                conversionCalibrationCacheFileName = argv[i];
+            } else if (nullptr != strstr(argv[i], "--inputList")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                inputListFileName = argv[i];
+                std::ifstream validInputListStream(inputListFileName, std::ifstream::in);
+                if (!validInputListStream) {
+                    std::cerr << "Invalid input list file: " << inputListFileName << std::endl;
+                }
+            } else if (nullptr != strstr(argv[i], "--streamWorkers")) {
+                i++;
+                if (argv[i])
+                    streamWorkers = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--liveQueues")) {
+                i++;
+                if (argv[i])
+                    liveVideoQueues = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--live")) {
+                liveStream = true;
+            } else if (nullptr != strstr(argv[i], "--queueGlobalPriority")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                if (strcmp(argv[i], "low") == 0) {
+                    queueGlobalPriority = VK_QUEUE_GLOBAL_PRIORITY_LOW_KHR;
+                } else if (strcmp(argv[i], "medium") == 0) {
+                    queueGlobalPriority = VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_KHR;
+                } else if (strcmp(argv[i], "high") == 0) {
+                    queueGlobalPriority = VK_QUEUE_GLOBAL_PRIORITY_HIGH_KHR;
+                } else if (strcmp(argv[i], "realtime") == 0) {
+                    queueGlobalPriority = VK_QUEUE_GLOBAL_PRIORITY_REALTIME_KHR;
+                } else {
+                    std::cerr << "Invalid queue global priority: " << argv[i] << std::endl;
+                }
+            } else if (nullptr != strstr(argv[i], "--allGpus")) {
+                enableAllGpus = true;
+            } else if (nullptr != strstr(argv[i], "--presentPacing")) {
+                presentPacing = true;
+            } else if (nullptr != strstr(argv[i], "--computePresent")) {
+                computePresent = true;
+            } else if (nullptr != strstr(argv[i], "--lowLatencyDisplay")) {
+                lowLatencyDisplay = true;
+            } else if (nullptr != strstr(argv[i], "--displayRefreshRate")) {
+                // In Hz, e.g. 59.94, of the display mode of --direct
+                i++;
+                if (argv[i])
+                    displayRefreshMilliHz = (uint32_t)(std::atof(argv[i]) * 1000.0 + 0.5);
+            } else if (nullptr != strstr(argv[i], "--renderQueueDepth")) {
+                i++;
+                if (argv[i])
+                    renderQueueDepth = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--adaptiveDecodeAhead")) {
+                i++;
+                if (argv[i])
+                    adaptiveDecodeAheadLatencyMs = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--renderNewest")) {
+                renderNewest = true;
+            } else if (nullptr != strstr(argv[i], "--mosaic")) {
+                mosaic = true;
+            } else if (nullptr != strstr(argv[i], "--exportFrames")) {
+                exportFrames = true;
+            } else if (nullptr != strstr(argv[i], "--frameServer")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                frameServerSocket = argv[i];
+                // The frames are published to the processes of the clients, not presented
+                exportFrames = true;
+                noPresent = true;
+            } else if (nullptr != strstr(argv[i], "--fanOut")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                // <width>x<height>:<nv12|rgba>, once per output
+                uint32_t width = 0;
+                uint32_t height = 0;
+                char format[8] = "";
+                if ((sscanf(argv[i], "%ux%u:%7s", &width, &height, format) == 3) && (width > 0) && (height > 0) &&
+                        ((strcmp(format, "nv12") == 0) || (strcmp(format, "rgba") == 0))) {
+                    FanOutOutput fanOutOutput;
+                    fanOutOutput.format = (strcmp(format, "rgba") == 0) ? VK_FORMAT_R8G8B8A8_UNORM :
+                                                                          VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+                    fanOutOutput.extent = { width, height };
+                    fanOutOutputs.push_back(fanOutOutput);
+                    // The outputs go to their consumers, not presented
+                    noPresent = true;
+                } else {
+                    std::cerr << "Invalid fan-out output: " << argv[i] << std::endl;
+                }
+            } else if (nullptr != strstr(argv[i], "--thumbnailOutput")) {
+                i++;
+                if (argv[i]) {
+                    thumbnailFileName = argv[i];
+                }
+            } else if (nullptr != strstr(argv[i], "--thumbnailStrip")) {
+                thumbnailStrip = true;
+            } else if (nullptr != strstr(argv[i], "--thumbnails")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                // <seconds>:<width>x<height>:<nv12|rgba>
+                double intervalSeconds = 0.0;
+                uint32_t width = 0;
+                uint32_t height = 0;
+                char format[8] = "";
+                if ((sscanf(argv[i], "%lf:%ux%u:%7s", &intervalSeconds, &width, &height, format) == 4) &&
+                        (intervalSeconds > 0.0) && (width > 0) && (height > 0) &&
+                        ((strcmp(format, "nv12") == 0) || (strcmp(format, "rgba") == 0))) {
+                    thumbnailIntervalSeconds = intervalSeconds;
+                    thumbnailFormat = (strcmp(format, "rgba") == 0) ? VK_FORMAT_R8G8B8A8_UNORM :
+                                                                      VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+                    // Of an even extent, for the chroma of NV12
+                    thumbnailExtent = { (width + 1) & ~1U, (height + 1) & ~1U };
+                    // Only the random access points the thumbnails are taken from are decoded, none presented
+                    decodeKeyFramesOnly = true;
+                    noPresent = true;
+                } else {
+                    std::cerr << "Invalid thumbnails: " << argv[i] << std::endl;
+                }
+            } else if (nullptr != strstr(argv[i], "--deinterlace")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                // The post-process filters VulkanFilterYuvCompute::YCBCRDEINTERLACE_BOB and YCBCRDEINTERLACE_ADAPTIVE
+                if (strcmp(argv[i], "bob") == 0) {
+                    enablePostProcessFilter = 11;
+                } else if (strcmp(argv[i], "adaptive") == 0) {
+                    enablePostProcessFilter = 12;
+                } else {
+                    std::cerr << "Invalid deinterlace mode: " << argv[i] << std::endl;
+                }
             } else if (nullptr != strstr(argv[i], "-b")) {
                 vsync = false;
             } else if (nullptr != strstr(argv[i], "-w")) {
@@ -107,6 +482,67 @@ struct ProgramConfig {
                 noPresent = true;
             } else if (nullptr != strstr(argv[i], "--enableHwLoadBalancing")) {
                 enableHwLoadBalancing = true;
+            } else if (nullptr != strstr(argv[i], "--asyncDecodeStatus")) {
+                asyncDecodeStatus = true;
+            } else if (nullptr != strstr(argv[i], "--asyncFrameOutput")) {
+                asyncFrameOutput = true;
+            } else if (nullptr != strstr(argv[i], "--gpuTimestampsCsv")) {
+                i++;
+                if (argv[i]) {
+                    gpuTimestamps = true;
+                    gpuTimestampsCsvFileName = argv[i];
+                }
+            } else if (nullptr != strstr(argv[i], "--gpuTimestamps")) {
+                gpuTimestamps = true;
+            } else if (nullptr != strstr(argv[i], "--frameAnalyticsCsv")) {
+                i++;
+                if (argv[i]) {
+                    frameAnalytics = true;
+                    frameAnalyticsCsvFileName = argv[i];
+                }
+            } else if (nullptr != strstr(argv[i], "--frameAnalytics")) {
+                frameAnalytics = true;
+            } else if (nullptr != strstr(argv[i], "--traceFile")) {
+                i++;
+                if (argv[i]) {
+                    traceFileName = argv[i];
+                }
+            } else if (nullptr != strstr(argv[i], "--metricsFile")) {
+                i++;
+                if (argv[i]) {
+                    metricsFileName = argv[i];
+                }
+            } else if (nullptr != strstr(argv[i], "--metricsPort")) {
+                i++;
+                if (argv[i])
+                    metricsPort = std::atoi(argv[i]);
+            } else if (nullptr != strstr(argv[i], "--gpuFrameOutput")) {
+                gpuFrameOutput = true;
+            } else if (nullptr != strstr(argv[i], "--outputFormat")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                } else if ((nullptr != strstr(argv[i], "nv12")) || (nullptr != strstr(argv[i], "p010"))) {
+                    outputFormat = 1;
+                } else if (nullptr != strstr(argv[i], "y4m")) {
+                    outputFormat = 2;
+                } else {
+                    outputFormat = 0; // i420 or i010
+                }
+            } else if (nullptr != strstr(argv[i], "--frameChecksum")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                frameChecksum = (nullptr != strstr(argv[i], "crc")) ? 2 : 1; // crc32 or md5
+            } else if (nullptr != strstr(argv[i], "--checksumReference")) {
+                i++;
+                if (argv[i] == nullptr) {
+                    break;
+                }
+                checksumReferenceFileName = argv[i];
+            } else if (nullptr != strstr(argv[i], "--enableNalPreScan")) {
+                enableNalPreScan = true;
             } else if (nullptr != strstr(argv[i], "--selectVideoWithComputeQueue")) {
                 selectVideoWithComputeQueue = true;
             } else if (nullptr != strstr(argv[i], "-o")) {
@@ -115,8 +551,13 @@ struct ProgramConfig {
             } else if (nullptr != strstr(argv[i], "-i")) {
                 i++;
                 videoFileName = argv[i];
-                std::ifstream validVideoFileStream(videoFileName, std::ifstream::in);
-                if (!validVideoFileStream) {
+                // stdin ("-") and the TCP streams are opened by the decoder only
+                const bool streamingInput = (videoFileName == "-") || (videoFileName.compare(0, 6, "tcp://") == 0);
+                std::ifstream validVideoFileStream;
+                if (!streamingInput) {
+                    validVideoFileStream.open(videoFileName, std::ifstream::in);
+                }
+                if (!streamingInput && !validVideoFileStream) {
                     std::cerr << "Invalid input video file: " << videoFileName << std::endl;
                     std::cerr << "Please provide a valid name for the input video file to be decoded with the \"-i\" command line option." << std::endl;
                     std::cerr << "   vk-video-dec-test -i <absolute file path location>" << std::endl;
@@ -149,6 +590,12 @@ struct ProgramConfig {
                 directMode = true;
             }
         }
+
+        // The thumbnails seek from one random access point to the next: a window of the stream is parsed at a
+        // time, not the rest of it at once.
+        if ((thumbnailIntervalSeconds > 0.0) && (bitstreamWindowSize == 0)) {
+            bitstreamWindowSize = 1024 * 1024;
+        }
     }
 
     std::string appName;
@@ -161,12 +608,67 @@ struct ProgramConfig {
     int32_t numDecodeImagesInFlight;
     int32_t numDecodeImagesToPreallocate;
     int32_t numBitstreamBuffersToPreallocate;
+    int32_t bitstreamBufferIdleTrimMs;
+    int32_t bitstreamRingBufferSizeMB;
+    int32_t decodeImageIdleFrames;
+    int32_t deviceMemoryArenaBlockSizeMB;
+    int32_t deviceMemoryBudgetMB; // the device local memory the streams of the process may take, 0 for the device budget
+    int32_t sharedImagePoolMaxIdleImages;
+    int32_t sessionPoolMaxIdleSessions;
+    int32_t decodeSubmitBatchSize;
+    int32_t decodeSubmitBatchLatencyMs;
+    int32_t decodeCommandBatchSize; // the pictures of the decoders of a queue recorded into one command buffer
+    int32_t decodeAheadDepth; // the frames in flight of the benchmark
+    int32_t streamWorkers; // the threads parsing the streams of --inputList in turns, 0 for a thread per stream
+    double capacityTargetFps; // the frame rate each session of --capacityBenchmark must sustain
+    double capacityMaxLatencyMs; // the p99 latency of the frames of --capacityBenchmark, 0 for two frame intervals
+    int32_t capacityMaxSessions; // the most sessions --capacityBenchmark ramps up to
+    int32_t liveVideoQueues; // the decode queues at a higher priority for the live streams, "live:" in --inputList
+    int32_t queueGlobalPriority; // of the video queue families, low, medium, high or realtime with VK_KHR_global_priority
+    int32_t preallocateSessionWidth; // the max extent of the session created ahead of the stream, 0 for the capabilities
+    int32_t preallocateSessionHeight;
+    int32_t renderQueueDepth; // the frames decoded ahead of the presentation on a render thread, 0 without it
+    int32_t adaptiveDecodeAheadLatencyMs; // the render thread decodes ahead by a measured depth, adding up to this
+                                          // latency, 0 for no bound and -1 for the fixed renderQueueDepth
+    uint32_t displayRefreshMilliHz; // the refresh rate of the display mode of --direct, 0 for the highest one
+    int32_t metricsPort; // the TCP port serving the runtime metrics on /metrics in the Prometheus format, 0 without it
+    int32_t seekFrame; // the display frame number the decoding starts from
+    int32_t maxTemporalLayers; // the H.265 temporal sub-layers decoded, 0 for all
+    int32_t maxScalableLayers; // the H.264 MVC views (1 for the base view) or SVC dependency layers decoded, 0 for all
+    // The H.264/H.265 SEI payload types parsed, the other SEI messages are skipped, e.g. "1,137,144" for the picture
+    // timing, mastering display colour volume and content light level ones. Empty to parse all of them.
+    std::vector<uint32_t> seiPayloadTypes;
+    int64_t bitstreamWindowSize; // bytes of an elementary stream parsed per call, 0 for the rest of the stream, e.g. 4194304
     int backBufferCount;
     int ticksPerSecond;
     int maxFrameCount;
 
     std::string videoFileName;
     std::string outputFileName;
+    std::string gpuTimestampsCsvFileName;
+    std::string frameAnalyticsCsvFileName; // the per frame analytics of --frameAnalyticsCsv
+    std::string traceFileName; // the Chrome trace JSON of the decode pipeline, with --traceFile
+    std::string metricsFileName; // the JSON of the metrics written at the end of the run, with --metricsFile
+    std::string checksumReferenceFileName;
+    std::string streamIndexFileName; // the sidecar file of the random access points, built if it is not valid
+    std::string inputListFileName; // the streams decoded concurrently on the device, one path per line
+    std::string pipelineCacheDir; // the pipeline cache and the SPIR-V of the shaders, kept between the runs
+    std::string frameServerSocket; // the Unix socket the decoded frames are published on, with --frameServer
+    struct FanOutOutput {
+        VkFormat   format;
+        VkExtent2D extent;
+    };
+    std::vector<FanOutOutput> fanOutOutputs; // the consumers of the decoded frames, with --fanOut
+    double thumbnailIntervalSeconds; // a thumbnail of the random access point at or before each interval, 0 without them
+    VkFormat thumbnailFormat; // VK_FORMAT_R8G8B8A8_UNORM or VK_FORMAT_G8_B8R8_2PLANE_420_UNORM
+    VkExtent2D thumbnailExtent;
+    std::string thumbnailFileName; // the prefix of the thumbnail files, or the file of the strip
+    std::string deviceCacheFileName; // the selected physical device and its queue families, with --fastStartup
+    std::string conversionCalibrationCacheFileName; // the times of the output conversion paths, per device and frames
+    std::string decodeCaptureFileName; // the calls of the parser to the decoder recorded, with --captureDecode
+    std::string decodeReplayFileName; // a capture fed to the decoder without the parser, with --replayDecode
+    std::vector<uint32_t> parserCpus; // the CPUs of the threads parsing and submitting the streams, e.g. "0-7"
+    std::vector<uint32_t> writerCpus; // the CPUs of the output file writer thread
     int gpuIndex;
     int loopCount;
     int queueId;
@@ -174,6 +676,8 @@ struct ProgramConfig {
     uint32_t deviceId;
     uint32_t decoderQueueSize;
     int32_t enablePostProcessFilter;
+    uint32_t outputFormat; // VkVideoFrameToFile::OutputFormat of the output file
+    uint32_t frameChecksum; // VkVideoFrameChecksum::Algorithm of the frame digests written instead of the frames
     uint32_t enableStreamDemuxing : 1;
     uint32_t directMode : 1;
     uint32_t vsync : 1;
@@ -182,9 +686,38 @@ struct ProgramConfig {
     uint32_t verbose : 1;
     uint32_t noTick : 1;
     uint32_t noPresent : 1;
+    uint32_t benchmark : 1; // headless decode only, released on completion, reports the throughput
+    uint32_t capacityBenchmark : 1; // ramp the concurrent decode sessions for the most that sustain the target fps
+    uint32_t decodeSubmitThread : 1; // submit the decoded pictures from a thread per decode queue
+    uint32_t decodeReferenceOnly : 1; // the parser drops the pictures no other one refers to
+    uint32_t decodeKeyFramesOnly : 1; // the parser drops all but the IDR pictures, and the CRA and BLA ones of H.265
+    uint32_t errorResilient : 1; // keep decoding past the lost references, with stand-ins, checking the status asynchronously
+    uint32_t deferSliceHeaders : 1; // H.264/H.265: the headers of the slices after the first one of a picture are checked on a worker
+    uint32_t preallocateSession : 1; // create the video session and the images before the first sequence
     uint32_t enableHwLoadBalancing : 1;
+    uint32_t asyncDecodeStatus : 1; // harvest the frame fences and decode status queries on a background thread
+    uint32_t asyncFrameOutput : 1; // write the output frames from a ring of buffers on a background thread
+    uint32_t gpuTimestamps : 1; // time the decode commands on the device, reported at the end of the run
+    uint32_t frameAnalytics : 1; // histograms, black, frozen and clipped frames of the output, on the compute queue
+    uint32_t thumbnailStrip : 1; // the thumbnails written to one file, stacked vertically, instead of a file each
+    uint32_t gpuFrameOutput : 1; // deinterleave the frames for the output file with a compute shader
+    uint32_t hostCachedFrameOutput : 1; // copy the frames for the output file to host cached buffers
+    uint32_t hugePageStaging : 1; // the staging and readback buffers in imported huge pages of host memory
+    uint32_t deviceLocalBitstream : 1; // decode from device-local copies of the bitstream, uploaded on the transfer queue
+    uint32_t autoFrameOutputConversion : 1; // deinterleave them on the GPU or the host, whichever is faster
+    uint32_t enableNalPreScan : 1;
     uint32_t selectVideoWithComputeQueue : 1;
     uint32_t enableVideoEncoder : 1;
+    uint32_t enableAllGpus : 1; // spread the streams of --inputList over all the GPUs with the decode queues
+    uint32_t presentPacing : 1; // present the frames at the times of their PTS, dropping the late ones
+    uint32_t computePresent : 1; // convert the frames into storage swapchain images with a compute shader
+    uint32_t lowLatencyDisplay : 1; // 2 swapchain images, frames rendered just in time for the next refresh
+    uint32_t renderNewest : 1; // the render thread presents the newest decoded frame, dropping the older ones
+    uint32_t mosaic : 1; // present the streams of --inputList tiled in one window instead of only decoding them
+    uint32_t exportFrames : 1; // decode to output images exported as file descriptors, for the other processes
+    uint32_t deviceMemoryReport : 1; // print the device memory by owner at exit
+    uint32_t latencyReport : 1; // print the percentiles of the segments of the frame latency at exit, of a single stream
+    uint32_t liveStream : 1; // decode on the live queues of --liveQueues, with --live or "live:" in --inputList
 };
 
 #endif /* _PROGRAMSETTINGS_H_ */
@@ -96,13 +96,27 @@ VkResult VkBufferResource::CreateBuffer(const VulkanDeviceContext* vkDevCtx,
     bufferSize = ((bufferSize + (bufferSizeAlignment - 1)) & ~(bufferSizeAlignment - 1));
     bufferOffset = 0;
 
+    const bool isStagingBuffer = ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) &&
+                                 ((usage & (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) != 0);
+    if (isStagingBuffer && vkDevCtx->GetHugePageStaging()) {
+        VkResult result = CreateHugePageBuffer(vkDevCtx, usage, bufferSize, buffer, memoryPropertyFlags,
+                                               initializeBufferMemorySize, pInitializeBufferMemory,
+                                               queueFamilyIndexes, vulkanDeviceMemory);
+        if (result == VK_SUCCESS) {
+            return result;
+        }
+        // Without the huge pages or their import, a regular allocation
+    }
+
     // Create the buffer
     VkBufferCreateInfo createBufferInfo = VkBufferCreateInfo();
     createBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     createBufferInfo.size = bufferSize;
     createBufferInfo.usage = usage;
     createBufferInfo.flags = 0;
-    createBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // Shared by the queue families given, without ownership transfers
+    createBufferInfo.sharingMode = (queueFamilyIndexes.size() > 1) ? VK_SHARING_MODE_CONCURRENT :
+                                                                     VK_SHARING_MODE_EXCLUSIVE;
     createBufferInfo.queueFamilyIndexCount = (uint32_t)queueFamilyIndexes.size();
     createBufferInfo.pQueueFamilyIndices = queueFamilyIndexes.data();
 
@@ -115,26 +129,31 @@ VkResult VkBufferResource::CreateBuffer(const VulkanDeviceContext* vkDevCtx,
     VkMemoryRequirements memoryRequirements = VkMemoryRequirements();
     vkDevCtx->GetBufferMemoryRequirements(*vkDevCtx, buffer, &memoryRequirements);
 
-    // Allocate memory for the buffer
+    // Allocate memory for the buffer, the host visible transfer buffers of no other owner stage the host copies
+    const VulkanMemoryOwner owner = VulkanDeviceMemoryBudget::GetCurrentOwner();
+    VulkanMemoryOwnerScope ownerScope(((owner == VULKAN_MEMORY_OWNER_OTHER) && isStagingBuffer) ?
+                                          VULKAN_MEMORY_OWNER_STAGING : owner);
     VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory;
-    result = VulkanDeviceMemoryImpl::Create(vkDevCtx,
-                                            memoryRequirements,
-                                            memoryPropertyFlags,
-                                            pInitializeBufferMemory,
-                                            initializeBufferMemorySize,
+    result = VulkanDeviceMemoryImpl::CreateFromArena(vkDevCtx,
+                                                     memoryRequirements,
+                                                     memoryPropertyFlags,
+                                                     pInitializeBufferMemory,
+                                                     initializeBufferMemorySize,
 #ifdef CLEAR_BITSTREAM_BUFFERS_ON_CREATE
-                                            true, // clearMemory
+                                                     true, // clearMemory
 #else
-                                            false, // clearMemory
+                                                     false, // clearMemory
 #endif
-                                            vkDeviceMemory);
+                                                     true, // linearResource
+                                                     vkDeviceMemory);
     if (result != VK_SUCCESS) {
         vkDevCtx->DestroyBuffer(*vkDevCtx, buffer, nullptr);
         assert(!"Create Memory Failed!");
         return result;
     }
 
-    result = vkDevCtx->BindBufferMemory(*vkDevCtx, buffer, *vkDeviceMemory, bufferOffset);
+    result = vkDevCtx->BindBufferMemory(*vkDevCtx, buffer, *vkDeviceMemory,
+                                        vkDeviceMemory->GetDeviceMemoryOffset() + bufferOffset);
     if (result != VK_SUCCESS) {
         vkDevCtx->DestroyBuffer(*vkDevCtx, buffer, nullptr);
         assert(!"Bind buffer memory failed!");
@@ -146,6 +165,61 @@ VkResult VkBufferResource::CreateBuffer(const VulkanDeviceContext* vkDevCtx,
     return result;
 }
 
+VkResult VkBufferResource::CreateHugePageBuffer(const VulkanDeviceContext* vkDevCtx,
+                                                VkBufferUsageFlags usage,
+                                                VkDeviceSize bufferSize,
+                                                VkBuffer& buffer,
+                                                VkMemoryPropertyFlags& memoryPropertyFlags,
+                                                VkDeviceSize initializeBufferMemorySize,
+                                                const void* pInitializeBufferMemory,
+                                                const std::vector<uint32_t>& queueFamilyIndexes,
+                                                VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory)
+{
+    VkExternalMemoryBufferCreateInfo externalMemoryBufferInfo = { VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO };
+    externalMemoryBufferInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+    VkBufferCreateInfo createBufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, &externalMemoryBufferInfo };
+    createBufferInfo.size = bufferSize;
+    createBufferInfo.usage = usage;
+    createBufferInfo.sharingMode = (queueFamilyIndexes.size() > 1) ? VK_SHARING_MODE_CONCURRENT :
+                                                                     VK_SHARING_MODE_EXCLUSIVE;
+    createBufferInfo.queueFamilyIndexCount = (uint32_t)queueFamilyIndexes.size();
+    createBufferInfo.pQueueFamilyIndices = queueFamilyIndexes.data();
+
+    VkBuffer hugePageBuffer = VK_NULL_HANDLE;
+    VkResult result = vkDevCtx->CreateBuffer(*vkDevCtx, &createBufferInfo, nullptr, &hugePageBuffer);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkMemoryRequirements memoryRequirements = VkMemoryRequirements();
+    vkDevCtx->GetBufferMemoryRequirements(*vkDevCtx, hugePageBuffer, &memoryRequirements);
+
+    const VulkanMemoryOwner owner = VulkanDeviceMemoryBudget::GetCurrentOwner();
+    VulkanMemoryOwnerScope ownerScope((owner == VULKAN_MEMORY_OWNER_OTHER) ? VULKAN_MEMORY_OWNER_STAGING : owner);
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory;
+    VkMemoryPropertyFlags hugePageMemoryPropertyFlags = memoryPropertyFlags;
+    result = VulkanDeviceMemoryImpl::CreateFromHugePages(vkDevCtx,
+                                                         memoryRequirements,
+                                                         hugePageMemoryPropertyFlags,
+                                                         pInitializeBufferMemory,
+                                                         initializeBufferMemorySize,
+                                                         vkDeviceMemory);
+    if (result == VK_SUCCESS) {
+        result = vkDevCtx->BindBufferMemory(*vkDevCtx, hugePageBuffer, *vkDeviceMemory, 0);
+    }
+    if (result != VK_SUCCESS) {
+        vkDevCtx->DestroyBuffer(*vkDevCtx, hugePageBuffer, nullptr);
+        return result;
+    }
+
+    buffer = hugePageBuffer;
+    memoryPropertyFlags = hugePageMemoryPropertyFlags;
+    vulkanDeviceMemory = vkDeviceMemory;
+
+    return result;
+}
+
 VkResult VkBufferResource::Initialize(VkDeviceSize bufferSize,
                                       const void* pInitializeBufferMemory,
                                       VkDeviceSize initializeBufferMemorySize)
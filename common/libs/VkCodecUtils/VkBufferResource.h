@@ -102,6 +102,17 @@ private:
                                  const std::vector<uint32_t>& queueFamilyIndexes,
                                  VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
 
+    // A staging buffer in the huge pages of VulkanDeviceMemoryImpl::CreateFromHugePages()
+    static VkResult CreateHugePageBuffer(const VulkanDeviceContext* vkDevCtx,
+                                         VkBufferUsageFlags usage,
+                                         VkDeviceSize bufferSize,
+                                         VkBuffer& buffer,
+                                         VkMemoryPropertyFlags& memoryPropertyFlags,
+                                         VkDeviceSize initializeBufferMemorySize,
+                                         const void* pInitializeBufferMemory,
+                                         const std::vector<uint32_t>& queueFamilyIndexes,
+                                         VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
+
     uint8_t* CheckAccess(VkDeviceSize offset, VkDeviceSize size) const;
 
     VkResult Initialize(VkDeviceSize bufferSize,
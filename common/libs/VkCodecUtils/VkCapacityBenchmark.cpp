@@ -0,0 +1,232 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdio.h>
+#include <thread>
+#if defined(__linux) || defined(__linux__) || defined(linux)
+#include <unistd.h>
+#endif
+#include "VkCodecUtils/VkCapacityBenchmark.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
+
+namespace {
+
+// The slowest session may fall this much short of the target rate, for the frames of its start and its end
+const double minFpsRatio = 0.98;
+// The share of the time of a resource above which a step not sustained is deemed to have run out of it
+const double engineBusyLimit = 0.9;
+const double cpuBusyLimit = 0.9;
+// Of the time of the sessions, spent waiting for another session to be done submitting to the same queue
+const double queueLockWaitLimit = 0.1;
+// The memory peaks of a step are sampled at this interval
+const std::chrono::milliseconds memorySampleInterval(10);
+
+// The resident memory of the process in MB, 0 if unknown on the platform
+double GetResidentMemoryMB()
+{
+#if defined(__linux) || defined(__linux__) || defined(linux)
+    FILE* statmFile = fopen("/proc/self/statm", "r");
+    if (statmFile == nullptr) {
+        return 0.0;
+    }
+    unsigned long long sizePages = 0;
+    unsigned long long residentPages = 0;
+    const int numFields = fscanf(statmFile, "%llu %llu", &sizePages, &residentPages);
+    fclose(statmFile);
+    if (numFields != 2) {
+        return 0.0;
+    }
+    return (double)residentPages * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#else
+    return 0.0;
+#endif
+}
+
+double GetDeviceLocalMemoryMB()
+{
+    return (double)VulkanDeviceMemoryBudget::GetDeviceLocalAllocatedSize() / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+VkCapacityBenchmark::VkCapacityBenchmark(const char* sessionType, double targetFps, double maxLatencyMs,
+                                         uint32_t maxSessions)
+    : m_sessionType(sessionType)
+    , m_targetFps(std::max(targetFps, 1.0))
+    , m_maxLatencyMs((maxLatencyMs > 0.0) ? maxLatencyMs : (2000.0 / m_targetFps))
+    , m_maxSessions(std::max(maxSessions, 1U))
+    , m_baseDeviceMemoryMB(0.0)
+    , m_baseHostMemoryMB(0.0)
+{
+}
+
+double VkCapacityBenchmark::GetPercentile(std::vector<double>& values, double percentile)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min((size_t)((percentile / 100.0) * (double)values.size()), values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void VkCapacityBenchmark::RunStep(const RunStepFunction& runStep, Step& step)
+{
+    step.sessionsStarted = false;
+    step.numFrames = 0;
+    step.minSessionFps = 0.0;
+    step.p99LatencyMs = 0.0;
+    step.engineBusy = -1.0;
+
+    // The sessions free their memory as they end, the peaks are sampled while they run
+    std::atomic<bool> stepDone(false);
+    double peakDeviceMemoryMB = GetDeviceLocalMemoryMB();
+    double peakHostMemoryMB = GetResidentMemoryMB();
+    std::thread memorySampler([&stepDone, &peakDeviceMemoryMB, &peakHostMemoryMB]() {
+        while (!stepDone.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(memorySampleInterval);
+            peakDeviceMemoryMB = std::max(peakDeviceMemoryMB, GetDeviceLocalMemoryMB());
+            peakHostMemoryMB = std::max(peakHostMemoryMB, GetResidentMemoryMB());
+        }
+    });
+
+    const uint64_t startQueueLockWaitNs = VulkanDeviceContext::GetQueueLockWaitNs();
+    const std::clock_t startCpuTime = std::clock();
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    runStep(step);
+
+    step.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    step.cpuTimeMs = 1000.0 * (double)(std::clock() - startCpuTime) / CLOCKS_PER_SEC;
+    step.queueLockWaitMs = (double)(VulkanDeviceContext::GetQueueLockWaitNs() - startQueueLockWaitNs) / 1000000.0;
+
+    stepDone.store(true, std::memory_order_release);
+    memorySampler.join();
+    step.deviceMemoryMB = std::max(peakDeviceMemoryMB - m_baseDeviceMemoryMB, 0.0);
+    step.hostMemoryMB = std::max(peakHostMemoryMB - m_baseHostMemoryMB, 0.0);
+
+    step.sustained = step.sessionsStarted && (step.numFrames > 0) &&
+                     (step.minSessionFps >= (minFpsRatio * m_targetFps)) && (step.p99LatencyMs <= m_maxLatencyMs);
+    step.limitingResource = step.sustained ? "" : GetLimitingResource(step);
+}
+
+const char* VkCapacityBenchmark::GetLimitingResource(const Step& step) const
+{
+    if (!step.sessionsStarted) {
+        return "memory";
+    }
+    if (step.engineBusy >= engineBusyLimit) {
+        return "engine";
+    }
+    const uint32_t numCpus = std::max(std::thread::hardware_concurrency(), 1U);
+    if ((step.wallTimeMs > 0.0) && (step.cpuTimeMs >= (cpuBusyLimit * numCpus * step.wallTimeMs))) {
+        return "CPU";
+    }
+    if ((step.wallTimeMs > 0.0) && (step.queueLockWaitMs >= (queueLockWaitLimit * step.numSessions * step.wallTimeMs))) {
+        return "submit lock";
+    }
+    // The encoders don't time their queues, the engine is what is left
+    if (step.engineBusy < 0.0) {
+        return "engine (not measured)";
+    }
+    return "none saturated";
+}
+
+void VkCapacityBenchmark::PrintStep(const Step& step) const
+{
+    const double wallTimeMs = std::max(step.wallTimeMs, 1.0);
+    printf("\t%8u %10.2f %10.2f %10.1f %12.1f %12.1f %10.1f ", step.numSessions, step.minSessionFps,
+           step.p99LatencyMs, (100.0 * step.cpuTimeMs) / (wallTimeMs * step.numSessions),
+           step.deviceMemoryMB / step.numSessions, step.hostMemoryMB / step.numSessions,
+           (100.0 * step.queueLockWaitMs) / (wallTimeMs * step.numSessions));
+    if (step.engineBusy >= 0.0) {
+        printf("%8.1f", 100.0 * step.engineBusy);
+    } else {
+        printf("%8s", "-");
+    }
+    if (step.sustained) {
+        printf("  sustained\n");
+    } else {
+        printf("  failed: %s\n", step.limitingResource);
+    }
+}
+
+uint32_t VkCapacityBenchmark::Run(const RunStepFunction& runStep)
+{
+    m_baseDeviceMemoryMB = GetDeviceLocalMemoryMB();
+    m_baseHostMemoryMB = GetResidentMemoryMB();
+
+    printf("Capacity of the %s sessions at %.2f fps, p99 latency within %.1f ms, up to %u sessions\n",
+           m_sessionType.c_str(), m_targetFps, m_maxLatencyMs, m_maxSessions);
+    printf("\t%8s %10s %10s %10s %12s %12s %10s %8s\n", "sessions", "min fps", "p99 ms", "CPU %/ses",
+           "dev MB/ses", "host MB/ses", "lock %/ses", "engine %");
+
+    Step lastSustainedStep = Step();
+    Step firstFailedStep = Step();
+    uint32_t numSustained = 0;
+    uint32_t numFailed = m_maxSessions + 1;
+
+    // Doubled until a step fails, then bisected
+    uint32_t numSessions = 1;
+    while (numSessions < numFailed) {
+        Step step = Step();
+        step.numSessions = numSessions;
+        RunStep(runStep, step);
+        PrintStep(step);
+        if (step.sustained) {
+            numSustained = numSessions;
+            lastSustainedStep = step;
+        } else {
+            numFailed = numSessions;
+            firstFailedStep = step;
+        }
+
+        if (numFailed > m_maxSessions) {
+            if (numSessions == m_maxSessions) {
+                break;
+            }
+            numSessions = std::min(2 * numSessions, m_maxSessions);
+        } else {
+            numSessions = numSustained + (numFailed - numSustained) / 2;
+            if (numSessions == numSustained) {
+                break;
+            }
+        }
+    }
+
+    if (numSustained == 0) {
+        printf("Capacity: not a single %s session sustained, limited by the %s\n", m_sessionType.c_str(),
+               firstFailedStep.limitingResource);
+        return 0;
+    }
+    const double wallTimeMs = std::max(lastSustainedStep.wallTimeMs, 1.0);
+    printf("Capacity: %u %s sessions at %.2f fps\n", numSustained, m_sessionType.c_str(), m_targetFps);
+    printf("\tDevice memory per session: %10.1f MB\n", lastSustainedStep.deviceMemoryMB / numSustained);
+    printf("\tHost memory per session:   %10.1f MB\n", lastSustainedStep.hostMemoryMB / numSustained);
+    printf("\tCPU per session:           %10.1f %% of a core\n",
+           (100.0 * lastSustainedStep.cpuTimeMs) / (wallTimeMs * numSustained));
+    if (numFailed <= m_maxSessions) {
+        printf("\tLimited by:                %s, at %u sessions\n", firstFailedStep.limitingResource, numFailed);
+    } else {
+        printf("\tLimited by:                none up to the %u sessions of the ramp\n", m_maxSessions);
+    }
+    return numSustained;
+}
@@ -0,0 +1,83 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKCAPACITYBENCHMARK_H_
+#define _VKCODECUTILS_VKCAPACITYBENCHMARK_H_
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Finds the number of concurrent sessions a device sustains at a target frame rate, e.g. how many 1080p30 streams
+// fit on a GPU. The number of sessions is doubled until a step fails, then bisected between the last step sustained
+// and the first one failed. A step is sustained when all its sessions start, the slowest one keeps the target rate
+// and the p99 latency of the frames is within the bound. The memory and the CPU time of the sessions are measured
+// around each step, and the resource a failed step ran out of is reported: the engine, the memory, the CPU or the
+// lock of the queues the sessions submit to.
+class VkCapacityBenchmark
+{
+public:
+    // A step of the ramp, the sessions run concurrently for about the same number of frames
+    struct Step {
+        uint32_t numSessions;
+        // Filled in by the function running the step
+        bool     sessionsStarted;  // false if a session failed to start, e.g. out of device memory
+        uint64_t numFrames;        // of all the sessions
+        double   minSessionFps;    // of the slowest session
+        double   p99LatencyMs;     // of the frames of all the sessions, from when they were due
+        double   engineBusy;       // of the busiest video queue, 1.0 for all the time, negative if not measured
+        // Filled in by the benchmark
+        double   wallTimeMs;
+        double   cpuTimeMs;        // of the process
+        double   queueLockWaitMs;  // of all the threads, see VulkanDeviceContext::GetQueueLockWaitNs()
+        double   deviceMemoryMB;   // the peak of the device local memory of the step, above the one before the ramp
+        double   hostMemoryMB;     // the same for the resident memory of the process
+        bool     sustained;
+        const char* limitingResource; // of a step not sustained
+    };
+
+    // Runs the sessions of step.numSessions at the target rate until they are done, and fills in the step
+    typedef std::function<void(Step& step)> RunStepFunction;
+
+    // maxLatencyMs of 0 bounds the latency to two frame intervals
+    VkCapacityBenchmark(const char* sessionType, double targetFps, double maxLatencyMs, uint32_t maxSessions);
+
+    double GetTargetFps() const { return m_targetFps; }
+    double GetMaxLatencyMs() const { return m_maxLatencyMs; }
+
+    // Ramps the sessions and prints each step and the capacity found. Returns the number of sessions sustained,
+    // 0 if not even one.
+    uint32_t Run(const RunStepFunction& runStep);
+
+    // The percentile, 0 to 100, of the values, sorted in place
+    static double GetPercentile(std::vector<double>& values, double percentile);
+
+private:
+    void RunStep(const RunStepFunction& runStep, Step& step);
+    const char* GetLimitingResource(const Step& step) const;
+    void PrintStep(const Step& step) const;
+
+private:
+    const std::string m_sessionType;
+    const double      m_targetFps;
+    const double      m_maxLatencyMs;
+    const uint32_t    m_maxSessions;
+    double            m_baseDeviceMemoryMB; // before the first step, the memory of the device and the process
+    double            m_baseHostMemoryMB;   // shared by the sessions
+};
+
+#endif /* _VKCODECUTILS_VKCAPACITYBENCHMARK_H_ */
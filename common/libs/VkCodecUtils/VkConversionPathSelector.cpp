@@ -0,0 +1,190 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "VkCodecUtils/VkConversionPathSelector.h"
+
+// The weight of a new sample in the average occupancy
+static const double gOccupancyWeight = 1.0 / 16.0;
+
+static const char* const gPathNames[2] = { "CPU", "GPU" };
+
+VkConversionPathSelector::VkConversionPathSelector(const char* name, const char* cacheFileName,
+                                                   const uint8_t deviceUuid[VK_UUID_SIZE], const std::string& cacheKey)
+    : m_name(name)
+    , m_cacheFileName((cacheFileName != nullptr) ? cacheFileName : "")
+    , m_cacheKey()
+    , m_path(PATH_CPU)
+    , m_needsCalibration(true)
+    , m_fromCache(false)
+    , m_pathMs{ 0.0, 0.0 }
+    , m_calibrationOccupancy(-1.0)
+    , m_averageOccupancy(0.0)
+    , m_framesSinceCalibration(0)
+    , m_numFrames{ 0, 0 }
+    , m_numCalibrations(0)
+{
+    std::stringstream key;
+    key << std::hex << std::setfill('0');
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+        key << std::setw(2) << (uint32_t)deviceUuid[i];
+    }
+    key << " " << m_name << " " << cacheKey;
+    m_cacheKey = key.str();
+
+    if (!m_cacheFileName.empty() && LoadCache()) {
+        m_needsCalibration = false;
+        m_fromCache = true;
+    }
+}
+
+bool VkConversionPathSelector::Calibrate(const ConvertFunc& convert, double queueOccupancy)
+{
+    bool pathValid[2] = { false, false };
+    for (uint32_t path = PATH_CPU; path <= PATH_GPU; path++) {
+        double bestMs = 0.0;
+        for (uint32_t run = 0; run < CALIBRATION_RUNS; run++) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (!convert((Path)path)) {
+                break;
+            }
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!pathValid[path] || (ms < bestMs)) {
+                bestMs = ms;
+            }
+            pathValid[path] = true;
+        }
+        m_pathMs[path] = bestMs;
+    }
+
+    m_needsCalibration = false;
+    m_calibrationOccupancy = queueOccupancy;
+    m_averageOccupancy = queueOccupancy;
+    m_framesSinceCalibration = 0;
+    m_numCalibrations++;
+
+    if (!pathValid[PATH_GPU]) {
+        std::cerr << m_name << ": the GPU conversion failed, the frames are converted on the CPU" << std::endl;
+        m_path = PATH_CPU;
+        return pathValid[PATH_CPU];
+    }
+    m_path = (pathValid[PATH_CPU] && (m_pathMs[PATH_CPU] <= m_pathMs[PATH_GPU])) ? PATH_CPU : PATH_GPU;
+
+    std::cout << m_name << ": " << std::fixed << std::setprecision(3) << m_pathMs[PATH_CPU] << " ms per frame on the CPU, "
+              << m_pathMs[PATH_GPU] << " ms on the GPU, with " << std::setprecision(1) << queueOccupancy
+              << " frames queued, converting on the " << gPathNames[m_path] << std::defaultfloat << std::endl;
+
+    // Only the times of an idle start are cached, not those of a loaded GPU
+    if ((m_numCalibrations == 1) && !m_cacheFileName.empty() && pathValid[PATH_CPU]) {
+        SaveCache();
+    }
+    return true;
+}
+
+void VkConversionPathSelector::OnFrame(double queueOccupancy)
+{
+    m_numFrames[m_path]++;
+    m_framesSinceCalibration++;
+
+    if (m_calibrationOccupancy < 0.0) {
+        // The cached times were taken without the queue of this run
+        m_calibrationOccupancy = queueOccupancy;
+        m_averageOccupancy = queueOccupancy;
+        return;
+    }
+
+    m_averageOccupancy += gOccupancyWeight * (queueOccupancy - m_averageOccupancy);
+    if ((m_framesSinceCalibration >= MIN_FRAMES_BETWEEN_CALIBRATIONS) &&
+            (fabs(m_averageOccupancy - m_calibrationOccupancy) >= occupancyDrift)) {
+        m_needsCalibration = true;
+    }
+}
+
+void VkConversionPathSelector::PrintStats() const
+{
+    std::cout << m_name << ": " << m_numFrames[PATH_CPU] << " frames converted on the CPU, " << m_numFrames[PATH_GPU]
+              << " on the GPU, " << m_numCalibrations << " calibrations"
+              << (m_fromCache ? ", started from the cached times" : "") << std::endl;
+}
+
+bool VkConversionPathSelector::LoadCache()
+{
+    std::ifstream cacheFile(m_cacheFileName);
+    if (!cacheFile) {
+        return false;
+    }
+
+    // One line per device, path and frames: the key, then the CPU and the GPU times in ms
+    const std::string prefix = GetCacheLinePrefix();
+    std::string line;
+    while (std::getline(cacheFile, line)) {
+        if (line.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::istringstream times(line.substr(prefix.size()));
+        double cpuMs = 0.0;
+        double gpuMs = 0.0;
+        if (!(times >> cpuMs >> gpuMs) || (cpuMs <= 0.0) || (gpuMs <= 0.0)) {
+            return false;
+        }
+        m_pathMs[PATH_CPU] = cpuMs;
+        m_pathMs[PATH_GPU] = gpuMs;
+        m_path = (cpuMs <= gpuMs) ? PATH_CPU : PATH_GPU;
+        std::cout << m_name << ": cached " << cpuMs << " ms per frame on the CPU, " << gpuMs
+                  << " ms on the GPU, converting on the " << gPathNames[m_path] << std::endl;
+        return true;
+    }
+    return false;
+}
+
+void VkConversionPathSelector::SaveCache() const
+{
+    // The lines of the other devices and frames are kept
+    const std::string prefix = GetCacheLinePrefix();
+    std::vector<std::string> lines;
+    {
+        std::ifstream cacheFile(m_cacheFileName);
+        std::string line;
+        while (std::getline(cacheFile, line)) {
+            if (!line.empty() && (line.compare(0, prefix.size(), prefix) != 0)) {
+                lines.push_back(line);
+            }
+        }
+    }
+    std::stringstream line;
+    line << prefix << m_pathMs[PATH_CPU] << " " << m_pathMs[PATH_GPU];
+    lines.push_back(line.str());
+
+    std::ofstream cacheFile(m_cacheFileName, std::ios::trunc);
+    for (const std::string& cacheLine : lines) {
+        cacheFile << cacheLine << "\n";
+    }
+    if (!cacheFile) {
+        std::cerr << "WARNING: Can't write the conversion calibration cache " << m_cacheFileName << std::endl;
+    }
+}
+
+std::string VkConversionPathSelector::GetCacheLinePrefix() const
+{
+    return m_cacheKey + " : ";
+}
@@ -0,0 +1,86 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKCONVERSIONPATHSELECTOR_H_
+#define _VKCODECUTILS_VKCONVERSIONPATHSELECTOR_H_
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vulkan_interfaces.h>
+
+// Chooses between the conversion of the frames on the CPU and with a compute shader, whichever completes a frame
+// sooner on this host: its cores, the bandwidth to the device and the load of the GPU all weigh in. Both paths are
+// timed on a frame of the stream before the first one is converted, unless a cache file has their times for the
+// device, the frames and the CPU threads. The occupancy of the queue the converted frames go to is followed, and
+// the paths are timed again once its average drifted away from the one they were timed with, e.g. when other work
+// loads the GPU. Called from the thread converting the frames.
+class VkConversionPathSelector
+{
+public:
+    enum Path { PATH_CPU = 0, PATH_GPU = 1 };
+
+    enum {
+        CALIBRATION_RUNS = 3,                  // per path, the fastest run is kept
+        MIN_FRAMES_BETWEEN_CALIBRATIONS = 120,
+    };
+
+    // The frames within the average occupancy can drift from the calibrated one
+    static constexpr double occupancyDrift = 1.5;
+
+    // Converts the frame on the path and waits for the conversion to complete, false on failure
+    typedef std::function<bool(Path path)> ConvertFunc;
+
+    // The name is for the messages. The cacheKey describes the frames, e.g. their size and format, and the CPU
+    // threads converting them. Without a cache file name, the paths are always timed.
+    VkConversionPathSelector(const char* name, const char* cacheFileName,
+                             const uint8_t deviceUuid[VK_UUID_SIZE], const std::string& cacheKey);
+
+    // The paths are to be timed before the next frame
+    bool NeedsCalibration() const { return m_needsCalibration; }
+
+    // Times both paths, each on its own, and keeps the faster one. The CPU is kept if the GPU path fails.
+    // Returns false if both fail.
+    bool Calibrate(const ConvertFunc& convert, double queueOccupancy);
+
+    // Once per frame converted, with the occupancy of the queue of the converted frames
+    void OnFrame(double queueOccupancy);
+
+    Path GetPath() const { return m_path; }
+
+    void PrintStats() const;
+
+private:
+    bool LoadCache();
+    void SaveCache() const;
+    std::string GetCacheLinePrefix() const;
+
+private:
+    const std::string m_name;
+    const std::string m_cacheFileName;
+    std::string       m_cacheKey;
+    Path              m_path;
+    bool              m_needsCalibration;
+    bool              m_fromCache;
+    double            m_pathMs[2];               // of the last calibration
+    double            m_calibrationOccupancy;    // negative until the first frame after a cached calibration
+    double            m_averageOccupancy;
+    uint64_t          m_framesSinceCalibration;
+    uint64_t          m_numFrames[2];            // per path
+    uint32_t          m_numCalibrations;
+};
+
+#endif /* _VKCODECUTILS_VKCONVERSIONPATHSELECTOR_H_ */
@@ -0,0 +1,114 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include "VkCodecUtils/VkDecodeAheadController.h"
+
+// The weight of a new sample in the averages
+static const double gAverageWeight = 1.0 / 8.0;
+
+VkDecodeAheadController::VkDecodeAheadController(uint32_t minDepth, uint32_t maxDepth, double maxLatencyMs)
+    : m_minDepth(std::max(minDepth, 1U))
+    , m_maxDepth(std::max(maxDepth, std::max(minDepth, 1U)))
+    , m_maxLatencyMs(maxLatencyMs)
+    , m_mutex()
+    , m_depth(m_minDepth)
+    , m_margin(0)
+    , m_decodeMs(0.0)
+    , m_consumeIntervalMs(0.0)
+    , m_lastConsumeMs(-1.0)
+    , m_windowFrames(0)
+    , m_windowMinQueued(UINT32_MAX)
+    , m_numConsumed(0)
+    , m_numStarved(0)
+    , m_depthSum(0)
+    , m_lowestDepth(m_minDepth)
+    , m_highestDepth(m_minDepth)
+{
+}
+
+void VkDecodeAheadController::OnFrameDecoded(double decodeMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_decodeMs = (m_decodeMs > 0.0) ? (m_decodeMs + gAverageWeight * (decodeMs - m_decodeMs)) : decodeMs;
+    UpdateDepth();
+}
+
+void VkDecodeAheadController::OnFrameConsumed(uint32_t queuedFrames, double nowMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_lastConsumeMs >= 0.0) {
+        const double intervalMs = nowMs - m_lastConsumeMs;
+        m_consumeIntervalMs = (m_consumeIntervalMs > 0.0) ?
+                (m_consumeIntervalMs + gAverageWeight * (intervalMs - m_consumeIntervalMs)) : intervalMs;
+    }
+    m_lastConsumeMs = nowMs;
+
+    // The first frame is always waited for, the producer only starts with it
+    if ((queuedFrames == 0) && (m_numConsumed > 0)) {
+        m_numStarved++;
+        m_margin = std::min(m_margin + 1, m_maxDepth);
+        m_windowFrames = 0;
+        m_windowMinQueued = UINT32_MAX;
+    } else {
+        m_windowMinQueued = std::min(m_windowMinQueued, queuedFrames);
+        if (++m_windowFrames >= SHRINK_WINDOW_FRAMES) {
+            // There was always a frame ready besides the one taken
+            if ((m_windowMinQueued >= 2) && (m_margin > 0)) {
+                m_margin--;
+            }
+            m_windowFrames = 0;
+            m_windowMinQueued = UINT32_MAX;
+        }
+    }
+
+    UpdateDepth();
+    m_numConsumed++;
+    m_depthSum += m_depth;
+    m_lowestDepth = std::min(m_lowestDepth, m_depth);
+    m_highestDepth = std::max(m_highestDepth, m_depth);
+}
+
+void VkDecodeAheadController::UpdateDepth()
+{
+    uint32_t depth = 1;
+    uint32_t highestDepth = m_maxDepth;
+    if (m_consumeIntervalMs > 0.0) {
+        depth = (uint32_t)ceil(m_decodeMs / m_consumeIntervalMs) + 1;
+        if (m_maxLatencyMs > 0.0) {
+            highestDepth = std::min(highestDepth, (uint32_t)std::max(m_maxLatencyMs / m_consumeIntervalMs, 1.0));
+        }
+    }
+    depth += m_margin;
+    m_depth = std::max(std::min(depth, highestDepth), m_minDepth);
+}
+
+uint32_t VkDecodeAheadController::GetDepth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_depth;
+}
+
+void VkDecodeAheadController::PrintStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::cout << "Decode-ahead depth: " << m_depth << " frames, within [" << m_lowestDepth << ", " << m_highestDepth
+              << "], " << ((m_numConsumed > 0) ? ((double)m_depthSum / m_numConsumed) : 0.0) << " on average, "
+              << m_numStarved << " frames waited for" << std::endl
+              << "\tdecode " << m_decodeMs << " ms, consumed every " << m_consumeIntervalMs << " ms" << std::endl;
+}
@@ -0,0 +1,67 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKDECODEAHEADCONTROLLER_H_
+#define _VKCODECUTILS_VKDECODEAHEADCONTROLLER_H_
+
+#include <stdint.h>
+#include <mutex>
+
+// The number of frames a stream is decoded ahead of its consumer. The frames needed in flight are the time to decode
+// one over the interval the consumer takes them at, plus one being consumed. A margin on top of that absorbs the
+// variations of both: it grows each time the consumer finds no frame ready, and shrinks again after a window of frames
+// that all had one to spare. The depth stays within [minDepth, maxDepth], the bound of the images allocated for it,
+// and within the frames the consumer takes in maxLatencyMs, the latency the queue is allowed to add.
+class VkDecodeAheadController
+{
+public:
+    enum { SHRINK_WINDOW_FRAMES = 60 };
+
+    VkDecodeAheadController(uint32_t minDepth, uint32_t maxDepth, double maxLatencyMs);
+
+    // The time the producer took to get the next frame out of the decoder
+    void OnFrameDecoded(double decodeMs);
+
+    // The consumer takes a frame, queuedFrames were ready including it, 0 if it had to wait for it
+    void OnFrameConsumed(uint32_t queuedFrames, double nowMs);
+
+    uint32_t GetDepth() const;
+
+    void PrintStats() const;
+
+private:
+    void UpdateDepth();
+
+private:
+    const uint32_t     m_minDepth;
+    const uint32_t     m_maxDepth;
+    const double       m_maxLatencyMs;
+    mutable std::mutex m_mutex;
+    uint32_t           m_depth;
+    uint32_t           m_margin;
+    double             m_decodeMs;          // averages
+    double             m_consumeIntervalMs;
+    double             m_lastConsumeMs;
+    uint32_t           m_windowFrames;
+    uint32_t           m_windowMinQueued;
+    uint64_t           m_numConsumed;
+    uint64_t           m_numStarved;
+    uint64_t           m_depthSum;
+    uint32_t           m_lowestDepth;
+    uint32_t           m_highestDepth;
+};
+
+#endif /* _VKCODECUTILS_VKDECODEAHEADCONTROLLER_H_ */
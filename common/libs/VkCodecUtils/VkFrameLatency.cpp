@@ -0,0 +1,167 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+#include "VkCodecUtils/VkFrameLatency.h"
+
+namespace {
+
+struct LatencySegment {
+    const char*         name;
+    VkFrameLatencyPoint from;
+    VkFrameLatencyPoint to;
+};
+
+// A segment is counted for the frames that went through both of its points
+const LatencySegment latencySegments[] = {
+    { "parse",             VK_FRAME_LATENCY_DEMUXED,   VK_FRAME_LATENCY_PARSED },
+    { "record, submit",    VK_FRAME_LATENCY_PARSED,    VK_FRAME_LATENCY_SUBMITTED },
+    { "queue wait",        VK_FRAME_LATENCY_SUBMITTED, VK_FRAME_LATENCY_GPU_BEGIN },
+    { "GPU decode",        VK_FRAME_LATENCY_GPU_BEGIN, VK_FRAME_LATENCY_GPU_END },
+    { "display queue",     VK_FRAME_LATENCY_GPU_END,   VK_FRAME_LATENCY_DEQUEUED },
+    { "submit to dequeue", VK_FRAME_LATENCY_SUBMITTED, VK_FRAME_LATENCY_DEQUEUED },
+    { "output",            VK_FRAME_LATENCY_DEQUEUED,  VK_FRAME_LATENCY_OUTPUT },
+    { "present",           VK_FRAME_LATENCY_OUTPUT,    VK_FRAME_LATENCY_DISPLAYED },
+    { "held",              VK_FRAME_LATENCY_OUTPUT,    VK_FRAME_LATENCY_RELEASED },
+    { "demux to output",   VK_FRAME_LATENCY_DEMUXED,   VK_FRAME_LATENCY_OUTPUT },
+    { "demux to display",  VK_FRAME_LATENCY_DEMUXED,   VK_FRAME_LATENCY_DISPLAYED },
+};
+const uint32_t numLatencySegments = sizeof(latencySegments) / sizeof(latencySegments[0]);
+
+// The frames are folded into the segments once this many newer ones are pending, late enough for the device
+// timestamps, collected a few frames behind, to be in
+const size_t maxPendingFrames = 256;
+
+struct FrameTimes {
+    FrameTimes()
+    {
+        for (uint32_t point = 0; point < VK_FRAME_LATENCY_POINT_COUNT; point++) {
+            timeNs[point] = 0;
+        }
+    }
+    uint64_t timeNs[VK_FRAME_LATENCY_POINT_COUNT]; // 0 if the frame didn't go through the point
+};
+
+struct LatencyRecorder {
+    LatencyRecorder() : mutex(), pendingFrames(), segmentsUs(numLatencySegments), numFrames(0) { }
+
+    std::mutex                         mutex;
+    std::map<uint64_t, FrameTimes>     pendingFrames;
+    std::vector<std::vector<uint32_t>> segmentsUs;
+    uint64_t                           numFrames;
+};
+
+LatencyRecorder& GetRecorder()
+{
+    static LatencyRecorder recorder;
+    return recorder;
+}
+
+thread_local uint64_t t_demuxTimeNs = 0;
+
+void FoldFrame(LatencyRecorder& recorder, const FrameTimes& frame)
+{
+    for (uint32_t segment = 0; segment < numLatencySegments; segment++) {
+        const uint64_t fromNs = frame.timeNs[latencySegments[segment].from];
+        const uint64_t toNs = frame.timeNs[latencySegments[segment].to];
+        if ((fromNs == 0) || (toNs == 0)) {
+            continue;
+        }
+        // A frame is handed out before its decode completes, its consumer waiting for it on the device
+        const uint64_t durationNs = (toNs > fromNs) ? (toNs - fromNs) : 0;
+        recorder.segmentsUs[segment].push_back((uint32_t)std::min<uint64_t>(durationNs / 1000, UINT32_MAX));
+    }
+    // Not the points of the device recorded after the frame was folded
+    if (frame.timeNs[VK_FRAME_LATENCY_PARSED] != 0) {
+        recorder.numFrames++;
+    }
+}
+
+} // namespace
+
+std::atomic<bool> VkFrameLatency::s_enabled(false);
+
+void VkFrameLatency::Enable()
+{
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void VkFrameLatency::MarkDemuxed()
+{
+    if (IsEnabled()) {
+        t_demuxTimeNs = VkTrace::NowNs();
+    }
+}
+
+void VkFrameLatency::RecordDemuxed(uint64_t frameId)
+{
+    if (IsEnabled() && (t_demuxTimeNs != 0)) {
+        AddPoint(VK_FRAME_LATENCY_DEMUXED, frameId, t_demuxTimeNs);
+    }
+}
+
+void VkFrameLatency::AddPoint(VkFrameLatencyPoint point, uint64_t frameId, uint64_t timeNs)
+{
+    LatencyRecorder& recorder = GetRecorder();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    recorder.pendingFrames[frameId].timeNs[point] = timeNs;
+    while (recorder.pendingFrames.size() > maxPendingFrames) {
+        FoldFrame(recorder, recorder.pendingFrames.begin()->second);
+        recorder.pendingFrames.erase(recorder.pendingFrames.begin());
+    }
+}
+
+uint64_t VkFrameLatency::GetPointTime(VkFrameLatencyPoint point, uint64_t frameId)
+{
+    LatencyRecorder& recorder = GetRecorder();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    std::map<uint64_t, FrameTimes>::const_iterator it = recorder.pendingFrames.find(frameId);
+    return (it != recorder.pendingFrames.end()) ? it->second.timeNs[point] : 0;
+}
+
+void VkFrameLatency::PrintReport()
+{
+    LatencyRecorder& recorder = GetRecorder();
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    for (std::map<uint64_t, FrameTimes>::const_iterator it = recorder.pendingFrames.begin();
+            it != recorder.pendingFrames.end(); ++it) {
+        FoldFrame(recorder, it->second);
+    }
+    recorder.pendingFrames.clear();
+
+    printf("Frame latency of %llu frames, ms:\n", (unsigned long long)recorder.numFrames);
+    printf("\t%-18s %8s %8s %8s %8s %8s %8s\n", "segment", "frames", "mean", "p50", "p90", "p99", "max");
+    for (uint32_t segment = 0; segment < numLatencySegments; segment++) {
+        std::vector<uint32_t>& samplesUs = recorder.segmentsUs[segment];
+        if (samplesUs.empty()) {
+            continue;
+        }
+        std::sort(samplesUs.begin(), samplesUs.end());
+        uint64_t sumUs = 0;
+        for (size_t i = 0; i < samplesUs.size(); i++) {
+            sumUs += samplesUs[i];
+        }
+        const size_t last = samplesUs.size() - 1;
+        printf("\t%-18s %8zu %8.3f %8.3f %8.3f %8.3f %8.3f\n", latencySegments[segment].name, samplesUs.size(),
+               (double)sumUs / samplesUs.size() / 1000.0,
+               samplesUs[last * 50 / 100] / 1000.0, samplesUs[last * 90 / 100] / 1000.0,
+               samplesUs[last * 99 / 100] / 1000.0, samplesUs[last] / 1000.0);
+    }
+}
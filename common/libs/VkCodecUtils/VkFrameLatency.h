@@ -0,0 +1,111 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKFRAMELATENCY_H_
+#define _VKCODECUTILS_VKFRAMELATENCY_H_
+
+#include <atomic>
+#include <stdint.h>
+#include "VkCodecUtils/VkTrace.h"
+
+// The points of the life of a decoded frame, in the order it goes through them
+enum VkFrameLatencyPoint {
+    VK_FRAME_LATENCY_DEMUXED = 0,  // the last chunk of the bitstream read before the frame was parsed
+    VK_FRAME_LATENCY_PARSED,       // the picture handed to the decoder by the parser
+    VK_FRAME_LATENCY_SUBMITTED,    // the decode commands handed to the queue, or to the submit batch or thread
+    VK_FRAME_LATENCY_GPU_BEGIN,    // the decode on the device, from the timestamps mapped to the host clock
+    VK_FRAME_LATENCY_GPU_END,
+    VK_FRAME_LATENCY_DEQUEUED,     // the frame handed out by DequeueDecodedPicture()
+    VK_FRAME_LATENCY_OUTPUT,       // the frame submitted for presentation, or written to the output file
+    VK_FRAME_LATENCY_DISPLAYED,    // the present of the frame on the display, with the present waits
+    VK_FRAME_LATENCY_RELEASED,     // the frame returned to the decoder
+    VK_FRAME_LATENCY_POINT_COUNT
+};
+
+// The per-frame timestamps of the points of the decode pipeline, on the clock of the trace, and the percentiles of
+// the segments between them. The frames are identified by their decode order, so a report is of a single stream.
+// While disabled, which is the default, a point costs a relaxed atomic load.
+class VkFrameLatency
+{
+public:
+    static void Enable();
+
+    static bool IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static void Record(VkFrameLatencyPoint point, uint64_t frameId, uint64_t timeNs)
+    {
+        if (IsEnabled()) {
+            AddPoint(point, frameId, timeNs);
+        }
+    }
+
+    static void Record(VkFrameLatencyPoint point, uint64_t frameId)
+    {
+        if (IsEnabled()) {
+            AddPoint(point, frameId, VkTrace::NowNs());
+        }
+    }
+
+    // The bitstream is read ahead of the picture being known, the time of the last read of the calling thread is
+    // recorded as the demux time of the next picture it parses
+    static void MarkDemuxed();
+
+    // Records the demux time marked by the calling thread for the frame
+    static void RecordDemuxed(uint64_t frameId);
+
+    // The time of the point of a frame not folded into the segments yet, 0 if it has none
+    static uint64_t GetPointTime(VkFrameLatencyPoint point, uint64_t frameId);
+
+    // The percentiles of each segment over the frames recorded so far
+    static void PrintReport();
+
+private:
+    static void AddPoint(VkFrameLatencyPoint point, uint64_t frameId, uint64_t timeNs);
+
+    static std::atomic<bool> s_enabled;
+};
+
+// Enables the latency recording for the lifetime of the object and prints the report on destruction.
+// Meant to be declared in main(), once the arguments are parsed.
+class VkFrameLatencyReport
+{
+public:
+    explicit VkFrameLatencyReport(bool enable)
+        : m_enable(enable)
+    {
+        if (m_enable) {
+            VkFrameLatency::Enable();
+        }
+    }
+
+    ~VkFrameLatencyReport()
+    {
+        if (m_enable) {
+            VkFrameLatency::PrintReport();
+        }
+    }
+
+private:
+    VkFrameLatencyReport(const VkFrameLatencyReport&);
+    VkFrameLatencyReport& operator=(const VkFrameLatencyReport&);
+
+    const bool m_enable;
+};
+
+#endif /* _VKCODECUTILS_VKFRAMELATENCY_H_ */
@@ -0,0 +1,125 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include "VkCodecUtils/VkImageBarrierBatch.h"
+
+namespace {
+
+const VkAccessFlags2KHR writeAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_HOST_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_MEMORY_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_VIDEO_DECODE_WRITE_BIT_KHR |
+                                          VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR;
+
+const VkPipelineStageFlags2KHR videoCodingStageMask = VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR |
+                                                      VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR;
+
+} // namespace
+
+VkImageBarrierBatch::VkImageBarrierBatch()
+    : m_numImageBarriers(0)
+    , m_numBufferBarriers(0)
+{
+}
+
+bool VkImageBarrierBatch::AddTransition(VkImageResource* imageResource, uint32_t arrayLayer, VkImageLayout newLayout,
+                                        VkPipelineStageFlags2KHR dstStageMask, VkAccessFlags2KHR dstAccessMask,
+                                        bool discardContent)
+{
+    assert(imageResource != nullptr);
+    const VkImageResource::LayerState& layerState = imageResource->GetLayerState(arrayLayer);
+
+    if (layerState.layout == newLayout) {
+        // The reads after the reads, and the DPB accesses of the consecutive video coding operations of a
+        // session, like the decoder references have always been, don't wait on each other
+        const bool sameVideoCodingStage = (layerState.stageMask == dstStageMask) &&
+                                          ((dstStageMask & ~videoCodingStageMask) == 0);
+        const bool hazard = ((layerState.accessMask & writeAccessMask) != 0) ||
+                            (((dstAccessMask & writeAccessMask) != 0) && (layerState.accessMask != 0));
+        if (!hazard || sameVideoCodingStage) {
+            imageResource->SetLayerState(arrayLayer, newLayout,
+                                         layerState.stageMask | dstStageMask,
+                                         layerState.accessMask | dstAccessMask);
+            return false;
+        }
+    }
+
+    assert(m_numImageBarriers < MAX_IMAGE_BARRIERS);
+    if (m_numImageBarriers >= MAX_IMAGE_BARRIERS) {
+        return false;
+    }
+
+    VkImageMemoryBarrier2KHR& imageBarrier = m_imageBarriers[m_numImageBarriers++];
+    imageBarrier = VkImageMemoryBarrier2KHR();
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+    imageBarrier.srcStageMask = layerState.stageMask;
+    imageBarrier.srcAccessMask = layerState.accessMask & writeAccessMask;
+    imageBarrier.dstStageMask = dstStageMask;
+    imageBarrier.dstAccessMask = dstAccessMask;
+    imageBarrier.oldLayout = (discardContent && (layerState.layout != newLayout)) ? VK_IMAGE_LAYOUT_UNDEFINED :
+                                                                                    layerState.layout;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = imageResource->GetImage();
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.baseArrayLayer = arrayLayer;
+    imageBarrier.subresourceRange.layerCount = 1;
+
+    imageResource->SetLayerState(arrayLayer, newLayout, dstStageMask, dstAccessMask);
+    return true;
+}
+
+void VkImageBarrierBatch::AddImageBarrier(const VkImageMemoryBarrier2KHR& imageBarrier)
+{
+    assert(m_numImageBarriers < MAX_IMAGE_BARRIERS);
+    if (m_numImageBarriers < MAX_IMAGE_BARRIERS) {
+        m_imageBarriers[m_numImageBarriers++] = imageBarrier;
+    }
+}
+
+void VkImageBarrierBatch::AddBufferBarrier(const VkBufferMemoryBarrier2KHR& bufferBarrier)
+{
+    assert(m_numBufferBarriers < MAX_BUFFER_BARRIERS);
+    if (m_numBufferBarriers < MAX_BUFFER_BARRIERS) {
+        m_bufferBarriers[m_numBufferBarriers++] = bufferBarrier;
+    }
+}
+
+void VkImageBarrierBatch::Record(const VulkanDeviceContext* vkDevCtx, VkCommandBuffer cmdBuf)
+{
+    if (IsEmpty()) {
+        return;
+    }
+
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencyInfo.bufferMemoryBarrierCount = m_numBufferBarriers;
+    dependencyInfo.pBufferMemoryBarriers = (m_numBufferBarriers > 0) ? m_bufferBarriers : nullptr;
+    dependencyInfo.imageMemoryBarrierCount = m_numImageBarriers;
+    dependencyInfo.pImageMemoryBarriers = (m_numImageBarriers > 0) ? m_imageBarriers : nullptr;
+    vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_numImageBarriers = 0;
+    m_numBufferBarriers = 0;
+}
@@ -0,0 +1,63 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKIMAGEBARRIERBATCH_H_
+#define _VKCODECUTILS_VKIMAGEBARRIERBATCH_H_
+
+#include <stdint.h>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VkImageResource.h"
+
+// The barriers of the images and the buffers of a frame, recorded in a single dependency.
+// The transitions of the tracked images take their old layout and source stages from the state of the
+// image layer, and are elided when the layer is already in the layout with no hazard to wait for.
+class VkImageBarrierBatch
+{
+public:
+    // The DPB slots, the setup picture, the output and the input pictures of a frame
+    static const uint32_t MAX_IMAGE_BARRIERS = 40;
+    static const uint32_t MAX_BUFFER_BARRIERS = 4;
+
+    VkImageBarrierBatch();
+
+    // Transitions the layer of the image to newLayout for the accesses of dstStageMask. With discardContent,
+    // the content of the layer is not needed and it is transitioned from the undefined layout.
+    // Returns false if the transition was elided.
+    bool AddTransition(VkImageResource* imageResource, uint32_t arrayLayer, VkImageLayout newLayout,
+                       VkPipelineStageFlags2KHR dstStageMask, VkAccessFlags2KHR dstAccessMask,
+                       bool discardContent = false);
+
+    // The barriers of the untracked images, e.g. the ones of the decoder frame buffer, and of the buffers
+    void AddImageBarrier(const VkImageMemoryBarrier2KHR& imageBarrier);
+    void AddBufferBarrier(const VkBufferMemoryBarrier2KHR& bufferBarrier);
+
+    uint32_t GetImageBarrierCount() const { return m_numImageBarriers; }
+    bool IsEmpty() const { return (m_numImageBarriers == 0) && (m_numBufferBarriers == 0); }
+
+    // Records the barriers of the batch in one dependency, if any, and empties the batch
+    void Record(const VulkanDeviceContext* vkDevCtx, VkCommandBuffer cmdBuf);
+
+private:
+    VkImageBarrierBatch(const VkImageBarrierBatch&);
+    VkImageBarrierBatch& operator=(const VkImageBarrierBatch&);
+
+    VkImageMemoryBarrier2KHR  m_imageBarriers[MAX_IMAGE_BARRIERS];
+    VkBufferMemoryBarrier2KHR m_bufferBarriers[MAX_BUFFER_BARRIERS];
+    uint32_t                  m_numImageBarriers;
+    uint32_t                  m_numBufferBarriers;
+};
+
+#endif /* _VKCODECUTILS_VKIMAGEBARRIERBATCH_H_ */
@@ -14,6 +14,7 @@
 * limitations under the License.
 */
 
+#include <algorithm>
 #include <atomic>
 #include "VkCodecUtils/HelpersDispatchTable.h"
 #include "VkCodecUtils/Helpers.h"
@@ -28,8 +29,15 @@ VkImageResource::VkImageResource(const VulkanDeviceContext* vkDevCtx,
    : m_refCount(0), m_imageCreateInfo(*pImageCreateInfo), m_vkDevCtx(vkDevCtx)
    , m_image(image), m_imageOffset(imageOffset), m_imageSize(imageSize)
    , m_vulkanDeviceMemory(vulkanDeviceMemory), m_layouts{}
+   , m_layerStates(std::max<uint32_t>(pImageCreateInfo->arrayLayers, 1))
    , m_isLinearImage(false), m_is16Bit(false), m_isSubsampledX(false), m_isSubsampledY(false) {
 
+    for (size_t arrayLayer = 0; arrayLayer < m_layerStates.size(); arrayLayer++) {
+        m_layerStates[arrayLayer].layout = pImageCreateInfo->initialLayout;
+        m_layerStates[arrayLayer].stageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+        m_layerStates[arrayLayer].accessMask = 0;
+    }
+
     const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(pImageCreateInfo->format);
 
     m_isSubsampledX = (mpInfo && mpInfo->planesLayout.secondaryPlaneSubsampledX);
@@ -103,22 +111,28 @@ VkResult VkImageResource::Create(const VulkanDeviceContext* vkDevCtx,
         VkMemoryRequirements memoryRequirements = { };
         vkDevCtx->GetImageMemoryRequirements(device, image, &memoryRequirements);
 
-        // Allocate memory for the image
+        // Allocate memory for the image, the linear ones of no other owner stage the host copies
+        const VulkanMemoryOwner owner = VulkanDeviceMemoryBudget::GetCurrentOwner();
+        VulkanMemoryOwnerScope ownerScope(((owner == VULKAN_MEMORY_OWNER_OTHER) &&
+                                           (pImageCreateInfo->tiling == VK_IMAGE_TILING_LINEAR)) ?
+                                              VULKAN_MEMORY_OWNER_STAGING : owner);
         VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory;
-        result = VulkanDeviceMemoryImpl::Create(vkDevCtx,
-                                                memoryRequirements,
-                                                memoryPropertyFlags,
-                                                nullptr,  // pInitializeMemory
-                                                0ULL,     // initializeMemorySize
-                                                false,    // clearMemory
-                                                vkDeviceMemory);
+        result = VulkanDeviceMemoryImpl::CreateFromArena(vkDevCtx,
+                                                         memoryRequirements,
+                                                         memoryPropertyFlags,
+                                                         nullptr,  // pInitializeMemory
+                                                         0ULL,     // initializeMemorySize
+                                                         false,    // clearMemory
+                                                         (pImageCreateInfo->tiling == VK_IMAGE_TILING_LINEAR),
+                                                         vkDeviceMemory);
         if (result != VK_SUCCESS) {
             assert(!"Create Memory Failed!");
             break;
         }
 
         VkDeviceSize imageOffset = 0;
-        result = vkDevCtx->BindImageMemory(device, image, *vkDeviceMemory, imageOffset);
+        result = vkDevCtx->BindImageMemory(device, image, *vkDeviceMemory,
+                                           vkDeviceMemory->GetDeviceMemoryOffset() + imageOffset);
         if (result != VK_SUCCESS) {
             assert(!"BindImageMemory Failed!");
             break;
@@ -147,6 +161,113 @@ VkResult VkImageResource::Create(const VulkanDeviceContext* vkDevCtx,
     return result;
 }
 
+VkResult VkImageResource::CreateExportable(const VulkanDeviceContext* vkDevCtx,
+                                           const VkImageCreateInfo* pImageCreateInfo,
+                                           VkMemoryPropertyFlags memoryPropertyFlags,
+                                           VkExternalMemoryHandleTypeFlags exportHandleTypes,
+                                           VkSharedBaseObj<VkImageResource>& imageResource)
+{
+    VkExternalMemoryImageCreateInfo externalMemoryImageInfo = { VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+                                                                pImageCreateInfo->pNext };
+    externalMemoryImageInfo.handleTypes = exportHandleTypes;
+
+    VkImageCreateInfo imageCreateInfo(*pImageCreateInfo);
+    imageCreateInfo.pNext = &externalMemoryImageInfo;
+
+    VkDevice device = vkDevCtx->getDevice();
+    VkImage image = VK_NULL_HANDLE;
+    VkResult result = vkDevCtx->CreateImage(device, &imageCreateInfo, nullptr, &image);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkMemoryRequirements memoryRequirements = { };
+    vkDevCtx->GetImageMemoryRequirements(device, image, &memoryRequirements);
+
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory;
+    result = VulkanDeviceMemoryImpl::CreateExportable(vkDevCtx, memoryRequirements, memoryPropertyFlags,
+                                                      exportHandleTypes, image, vkDeviceMemory);
+    if (result == VK_SUCCESS) {
+        result = vkDevCtx->BindImageMemory(device, image, *vkDeviceMemory, 0);
+    }
+    if (result != VK_SUCCESS) {
+        vkDevCtx->DestroyImage(device, image, nullptr);
+        return result;
+    }
+
+    imageResource = new VkImageResource(vkDevCtx,
+                                        pImageCreateInfo,
+                                        image,
+                                        0,
+                                        memoryRequirements.size,
+                                        vkDeviceMemory);
+    return (imageResource != nullptr) ? VK_SUCCESS : VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+VkResult VkImageResource::CreateFromFd(const VulkanDeviceContext* vkDevCtx,
+                                       const VkImageCreateInfo* pImageCreateInfo,
+                                       VkExternalMemoryHandleTypeFlagBits handleType, int fd,
+                                       uint64_t drmFormatModifier,
+                                       uint32_t planeLayoutCount, const VkSubresourceLayout* pPlaneLayouts,
+                                       VkSharedBaseObj<VkImageResource>& imageResource)
+{
+    const bool useDrmFormatModifier = (drmFormatModifier != INVALID_DRM_FORMAT_MODIFIER);
+    if (useDrmFormatModifier &&
+            ((vkDevCtx->FindRequiredDeviceExtension(VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME) == nullptr) ||
+             (planeLayoutCount == 0) || (pPlaneLayouts == nullptr))) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkImageDrmFormatModifierExplicitCreateInfoEXT drmFormatModifierInfo =
+        { VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT, pImageCreateInfo->pNext };
+    drmFormatModifierInfo.drmFormatModifier = drmFormatModifier;
+    drmFormatModifierInfo.drmFormatModifierPlaneCount = planeLayoutCount;
+    drmFormatModifierInfo.pPlaneLayouts = pPlaneLayouts;
+
+    VkExternalMemoryImageCreateInfo externalMemoryImageInfo = { VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+                                                                useDrmFormatModifier ? &drmFormatModifierInfo :
+                                                                                       pImageCreateInfo->pNext };
+    externalMemoryImageInfo.handleTypes = handleType;
+
+    VkImageCreateInfo imageCreateInfo(*pImageCreateInfo);
+    imageCreateInfo.pNext = &externalMemoryImageInfo;
+    if (useDrmFormatModifier) {
+        imageCreateInfo.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+    }
+
+    VkDevice device = vkDevCtx->getDevice();
+    VkImage image = VK_NULL_HANDLE;
+    VkResult result = vkDevCtx->CreateImage(device, &imageCreateInfo, nullptr, &image);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkMemoryRequirements memoryRequirements = { };
+    vkDevCtx->GetImageMemoryRequirements(device, image, &memoryRequirements);
+
+    // Whichever memory type of the exporter, the imported memory is not mapped
+    VkMemoryPropertyFlags memoryPropertyFlags = 0;
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory;
+    result = VulkanDeviceMemoryImpl::CreateFromFd(vkDevCtx, memoryRequirements, memoryPropertyFlags,
+                                                  handleType, fd, image, vkDeviceMemory);
+    if (result == VK_SUCCESS) {
+        result = vkDevCtx->BindImageMemory(device, image, *vkDeviceMemory, 0);
+    }
+    if (result != VK_SUCCESS) {
+        vkDevCtx->DestroyImage(device, image, nullptr);
+        return result;
+    }
+
+    // The chain of the create info is not kept
+    imageCreateInfo.pNext = nullptr;
+    imageResource = new VkImageResource(vkDevCtx,
+                                        &imageCreateInfo,
+                                        image,
+                                        0,
+                                        memoryRequirements.size,
+                                        vkDeviceMemory);
+    return (imageResource != nullptr) ? VK_SUCCESS : VK_ERROR_OUT_OF_HOST_MEMORY;
+}
 
 void VkImageResource::Destroy()
 {
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <atomic>
+#include <vector>
 #include <vulkan_interfaces.h>
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 #include "VkCodecUtils/VulkanDeviceMemoryImpl.h"
@@ -29,6 +30,26 @@ public:
                            VkMemoryPropertyFlags memoryPropertyFlags,
                            VkSharedBaseObj<VkImageResource>& imageResource);
 
+    // The DRM format modifier of an imported image without one, with the tiling of its create info
+    static const uint64_t INVALID_DRM_FORMAT_MODIFIER = 0x00ffffffffffffffULL;
+
+    // Creates the image on the memory of a file descriptor, like the dma-buf of a capture or a V4L2 device,
+    // without a copy. With a DRM format modifier, the image has its tiling and the explicit layout of its
+    // memory planes. The image owns the descriptor once its memory is imported, the caller keeps it otherwise.
+    static VkResult CreateFromFd(const VulkanDeviceContext* vkDevCtx,
+                                 const VkImageCreateInfo* pImageCreateInfo,
+                                 VkExternalMemoryHandleTypeFlagBits handleType, int fd,
+                                 uint64_t drmFormatModifier,
+                                 uint32_t planeLayoutCount, const VkSubresourceLayout* pPlaneLayouts,
+                                 VkSharedBaseObj<VkImageResource>& imageResource);
+
+    // Creates the image on a memory exported with ExportFd(), for the consumers in other processes or APIs
+    static VkResult CreateExportable(const VulkanDeviceContext* vkDevCtx,
+                                     const VkImageCreateInfo* pImageCreateInfo,
+                                     VkMemoryPropertyFlags memoryPropertyFlags,
+                                     VkExternalMemoryHandleTypeFlags exportHandleTypes,
+                                     VkSharedBaseObj<VkImageResource>& imageResource);
+
     bool IsCompatible ( VkDevice dev,
                         const VkImageCreateInfo* pImageCreateInfo)
     {
@@ -88,10 +109,36 @@ public:
 
     const VkImageCreateInfo& GetImageCreateInfo() const { return m_imageCreateInfo; }
 
+    // A new file descriptor of the memory of an exportable image, owned by the caller
+    VkResult ExportFd(VkExternalMemoryHandleTypeFlagBits handleType, int* pFd) const {
+        return m_vulkanDeviceMemory->ExportFd(handleType, pFd);
+    }
+
     const VkSubresourceLayout* GetSubresourceLayout() const {
         return m_isLinearImage ? m_layouts : nullptr;
     }
 
+    // The layout of an array layer and the last accesses to it, as of the last barrier recorded for it.
+    // Kept by the thread recording the commands of the image, in their submission order.
+    struct LayerState {
+        VkImageLayout            layout;
+        VkPipelineStageFlags2KHR stageMask;
+        VkAccessFlags2KHR        accessMask;
+    };
+
+    const LayerState& GetLayerState(uint32_t arrayLayer) const {
+        assert(arrayLayer < m_layerStates.size());
+        return m_layerStates[arrayLayer];
+    }
+
+    void SetLayerState(uint32_t arrayLayer, VkImageLayout layout,
+                       VkPipelineStageFlags2KHR stageMask, VkAccessFlags2KHR accessMask) {
+        assert(arrayLayer < m_layerStates.size());
+        m_layerStates[arrayLayer].layout = layout;
+        m_layerStates[arrayLayer].stageMask = stageMask;
+        m_layerStates[arrayLayer].accessMask = accessMask;
+    }
+
 private:
     std::atomic<int32_t>    m_refCount;
     const VkImageCreateInfo m_imageCreateInfo;
@@ -101,6 +148,7 @@ private:
     VkDeviceSize            m_imageSize;
     VkSharedBaseObj<VulkanDeviceMemoryImpl> m_vulkanDeviceMemory;
     VkSubresourceLayout     m_layouts[3]; // per plane layout for linear images
+    std::vector<LayerState> m_layerStates; // per array layer
     uint32_t                m_isLinearImage : 1;
     uint32_t                m_is16Bit : 1;
     uint32_t                m_isSubsampledX : 1;
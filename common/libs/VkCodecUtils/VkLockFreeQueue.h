@@ -0,0 +1,266 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKLOCKFREEQUEUE_H_
+#define _VKCODECUTILS_VKLOCKFREEQUEUE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// The fixed-capacity, lock-free counterpart of VkThreadSafeQueue, with the same interface and flush semantics.
+// The nodes are moved in and out of a ring allocated by SetMaxPendingQueueNodes(), which has to be called before
+// the queue is used by more than one thread. With multiProducerConsumer, any number of threads can push and pop,
+// with the bounded queue of Dmitry Vyukov; else a single producer and a single consumer thread only touch the
+// head and the tail indices. A producer of a full queue, or a consumer of an empty one, spins for a while before
+// it blocks on a condition, and is only woken up when it is blocked.
+template <typename QueueNodeType, bool multiProducerConsumer>
+class VkLockFreeQueue {
+public:
+    VkLockFreeQueue(uint32_t maxPendingQueueNodes = 4)
+        : m_cells()
+        , m_capacity(0)
+        , m_head(0)
+        , m_tail(0)
+        , m_queueIsFlushing(false)
+        , m_numWaitingProducers(0)
+        , m_numWaitingConsumers(0)
+    {
+        SetMaxPendingQueueNodes(maxPendingQueueNodes);
+    }
+
+    // Drops the nodes queued, if any
+    bool SetMaxPendingQueueNodes(uint32_t maxPendingQueueNodes = 16) {
+        if (maxPendingQueueNodes == 0) {
+            return false;
+        }
+        m_cells.reset(new Cell[maxPendingQueueNodes]);
+        for (uint32_t i = 0; i < maxPendingQueueNodes; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_capacity = maxPendingQueueNodes;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool Push(QueueNodeType& node) {
+
+        // Wait for the consumer to consume the previous node item(s)
+        for (uint32_t spin = 0; !m_queueIsFlushing.load(std::memory_order_acquire); spin++) {
+            if (TryPushNode(node)) {
+                Notify(m_numWaitingConsumers, m_condConsumer);
+                return true;
+            }
+            if (spin >= spinCount) {
+                Park(m_numWaitingProducers, m_condProducer, [this]() { return !Full(); });
+                spin = 0;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        return false;
+    }
+
+    // Fails right away instead of waiting when the queue is full
+    bool TryPush(QueueNodeType& node) {
+        if (m_queueIsFlushing.load(std::memory_order_acquire) || !TryPushNode(node)) {
+            return false;
+        }
+        Notify(m_numWaitingConsumers, m_condConsumer);
+        return true;
+    }
+
+    bool TryPop(QueueNodeType& node) {
+        if (!TryPopNode(node)) {
+            return false;
+        }
+        Notify(m_numWaitingProducers, m_condProducer);
+        return true;
+    }
+
+    bool WaitAndPop(QueueNodeType& node) {
+
+        // Also woken up by the flush, to drain what is left without waiting
+        for (uint32_t spin = 0; ; spin++) {
+            if (TryPop(node)) {
+                return true;
+            }
+            if (m_queueIsFlushing.load(std::memory_order_acquire)) {
+                return TryPop(node);
+            }
+            if (spin >= spinCount) {
+                Park(m_numWaitingConsumers, m_condConsumer, [this]() { return !Empty(); });
+                spin = 0;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool Empty() const {
+        return (Size() == 0);
+    }
+
+    size_t Size() const {
+        const uint64_t head = m_head.load(std::memory_order_acquire);
+        const uint64_t tail = m_tail.load(std::memory_order_acquire);
+        return (tail > head) ? (size_t)(tail - head) : 0;
+    }
+
+    void SetFlushAndExit()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queueIsFlushing.store(true, std::memory_order_seq_cst);
+        }
+        m_condProducer.notify_all();
+        m_condConsumer.notify_all();
+    }
+
+    bool ExitQueue() {
+        return (m_queueIsFlushing.load(std::memory_order_acquire) && Empty());
+    }
+
+private:
+    static const uint32_t spinCount = 128;
+    static const size_t cacheLineSize = 64;
+
+    struct Cell {
+        Cell() : sequence(0), node() { }
+        std::atomic<uint64_t> sequence; // only used with multiProducerConsumer
+        QueueNodeType         node;
+    };
+
+    bool Full() const {
+        return (Size() >= m_capacity);
+    }
+
+    bool TryPushNode(QueueNodeType& node) {
+
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if (!multiProducerConsumer) {
+            if ((tail - m_head.load(std::memory_order_acquire)) >= m_capacity) {
+                return false;
+            }
+            m_cells[tail % m_capacity].node = std::move(node);
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // The cell at the tail is free when its sequence is the tail, the producers race for it on the tail
+        Cell* pCell = nullptr;
+        while (true) {
+            pCell = &m_cells[tail % m_capacity];
+            const int64_t diff = (int64_t)(pCell->sequence.load(std::memory_order_acquire) - tail);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // the consumer of the previous round hasn't popped it yet
+            } else {
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        pCell->node = std::move(node);
+        pCell->sequence.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPopNode(QueueNodeType& node) {
+
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (!multiProducerConsumer) {
+            if (head == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            Cell& cell = m_cells[head % m_capacity];
+            node = std::move(cell.node);
+            cell.node = QueueNodeType(); // the references of the node don't outlive its pop
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // The cell at the head is full when its sequence is one past the head
+        Cell* pCell = nullptr;
+        while (true) {
+            pCell = &m_cells[head % m_capacity];
+            const int64_t diff = (int64_t)(pCell->sequence.load(std::memory_order_acquire) - (head + 1));
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // the producer of this round hasn't pushed it yet
+            } else {
+                head = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        node = std::move(pCell->node);
+        pCell->node = QueueNodeType();
+        pCell->sequence.store(head + m_capacity, std::memory_order_release);
+        return true;
+    }
+
+    // Either the waiter sees the condition when it checks it, or it is counted as waiting when notified
+    template<class Ready>
+    void Park(std::atomic<uint32_t>& numWaiting, std::condition_variable& cond, Ready ready) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        numWaiting.fetch_add(1, std::memory_order_seq_cst);
+        cond.wait(lock, [this, &ready]() { return m_queueIsFlushing.load(std::memory_order_seq_cst) || ready(); });
+        numWaiting.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Notify(std::atomic<uint32_t>& numWaiting, std::condition_variable& cond) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (numWaiting.load(std::memory_order_seq_cst) > 0) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            cond.notify_all();
+        }
+    }
+
+private:
+    // The head and the tail on cache lines of their own, for the producers and the consumers not to share them
+    std::unique_ptr<Cell[]>   m_cells;
+    uint32_t                  m_capacity;
+    uint8_t                   m_headPadding[cacheLineSize];
+    std::atomic<uint64_t>     m_head; // of the next node popped
+    uint8_t                   m_tailPadding[cacheLineSize - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t>     m_tail; // of the next node pushed
+    uint8_t                   m_flushPadding[cacheLineSize - sizeof(std::atomic<uint64_t>)];
+    std::atomic<bool>         m_queueIsFlushing;
+    std::atomic<uint32_t>     m_numWaitingProducers;
+    std::atomic<uint32_t>     m_numWaitingConsumers;
+    std::mutex                m_mutex;
+    std::condition_variable   m_condProducer;
+    std::condition_variable   m_condConsumer;
+};
+
+// The encoder consumer and stage threads, one thread on each side
+template <typename QueueNodeType>
+using VkSpscQueue = VkLockFreeQueue<QueueNodeType, false>;
+
+template <typename QueueNodeType>
+using VkMpmcQueue = VkLockFreeQueue<QueueNodeType, true>;
+
+#endif /* _VKCODECUTILS_VKLOCKFREEQUEUE_H_ */
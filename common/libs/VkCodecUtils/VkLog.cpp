@@ -0,0 +1,107 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "VkCodecUtils/VkLockFreeQueue.h"
+#include "VkCodecUtils/VkLog.h"
+
+std::atomic<int32_t> VkLog::s_level(VK_LOG_LEVEL_INFO);
+
+namespace {
+
+struct VkLogMessage {
+    int32_t level;
+    char    text[VkLog::MAX_MESSAGE_SIZE];
+};
+
+// Started once, by the first StartAsync()
+std::mutex                                  s_asyncMutex;
+std::unique_ptr<VkMpmcQueue<VkLogMessage> > s_asyncQueue;
+std::thread                                 s_asyncWriterThread;
+std::atomic<bool>                           s_asyncRunning(false);
+std::atomic<uint64_t>                       s_droppedMessages(0);
+
+void PrintMessage(const VkLogMessage& message)
+{
+    fputs(message.text, (message.level <= VK_LOG_LEVEL_WARNING) ? stderr : stdout);
+}
+
+void AsyncWriterThread()
+{
+    VkLogMessage message;
+    while (s_asyncQueue->WaitAndPop(message)) {
+        PrintMessage(message);
+        // Written out in bursts, once the queue is drained
+        if (s_asyncQueue->Empty()) {
+            fflush(stdout);
+        }
+    }
+    fflush(stdout);
+}
+
+} // namespace
+
+void VkLog::Write(int32_t level, const char* format, ...)
+{
+    VkLogMessage message;
+    message.level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message.text, sizeof(message.text), format, args);
+    va_end(args);
+
+    if (!s_asyncRunning.load(std::memory_order_acquire)) {
+        PrintMessage(message);
+        return;
+    }
+
+    if (!s_asyncQueue->TryPush(message)) {
+        s_droppedMessages.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void VkLog::StartAsync(uint32_t maxPendingMessages)
+{
+    std::lock_guard<std::mutex> lock(s_asyncMutex);
+    if (s_asyncQueue) {
+        return;
+    }
+    s_asyncQueue.reset(new VkMpmcQueue<VkLogMessage>(maxPendingMessages));
+    s_asyncWriterThread = std::thread(AsyncWriterThread);
+    s_asyncRunning.store(true, std::memory_order_release);
+}
+
+void VkLog::StopAsync()
+{
+    std::lock_guard<std::mutex> lock(s_asyncMutex);
+    if (!s_asyncRunning.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    // The writer drains the queue before it exits
+    s_asyncQueue->SetFlushAndExit();
+    if (s_asyncWriterThread.joinable()) {
+        s_asyncWriterThread.join();
+    }
+
+    const uint64_t droppedMessages = s_droppedMessages.exchange(0, std::memory_order_relaxed);
+    if (droppedMessages > 0) {
+        fprintf(stderr, "%llu log messages were dropped\n", (unsigned long long)droppedMessages);
+    }
+}
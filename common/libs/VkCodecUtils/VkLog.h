@@ -0,0 +1,119 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKLOG_H_
+#define _VKCODECUTILS_VKLOG_H_
+
+#include <atomic>
+#include <stdint.h>
+
+#define VK_LOG_LEVEL_ERROR   0
+#define VK_LOG_LEVEL_WARNING 1
+#define VK_LOG_LEVEL_INFO    2
+#define VK_LOG_LEVEL_DEBUG   3
+
+// The most detailed level compiled in, the messages of the levels above it are removed by the preprocessor.
+// The debug messages are only compiled into the debug builds by default.
+#ifndef VK_LOG_MAX_LEVEL
+#ifdef NDEBUG
+#define VK_LOG_MAX_LEVEL VK_LOG_LEVEL_INFO
+#else
+#define VK_LOG_MAX_LEVEL VK_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// The console messages of the per-frame paths, printf formatted. The messages of the levels above the current one
+// cost a relaxed atomic load. While the async sink runs, a message is formatted by the calling thread and queued,
+// without locks, for a writer thread to print, the errors and warnings to stderr and the rest to stdout. Messages
+// are dropped rather than blocking the caller when the writer falls behind. Without the sink they are printed
+// synchronously.
+class VkLog
+{
+public:
+    enum { MAX_MESSAGE_SIZE = 240 }; // longer messages are truncated
+
+    static void SetLevel(int32_t level)
+    {
+        s_level.store(level, std::memory_order_relaxed);
+    }
+
+    static bool IsEnabled(int32_t level)
+    {
+        return (level <= s_level.load(std::memory_order_relaxed));
+    }
+
+    static void Write(int32_t level, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+    // Starts the writer thread of the async sink, up to maxPendingMessages are queued
+    static void StartAsync(uint32_t maxPendingMessages = 1024);
+
+    // Prints the messages still queued and stops the writer thread, the messages after it are synchronous again
+    static void StopAsync();
+
+private:
+    static std::atomic<int32_t> s_level;
+};
+
+// Runs the async sink for the lifetime of the object, at the debug level if verbose.
+// Meant to be declared first in main(), once the arguments are parsed.
+class VkLogSession
+{
+public:
+    explicit VkLogSession(bool verbose)
+    {
+        if (verbose) {
+            VkLog::SetLevel(VK_LOG_LEVEL_DEBUG);
+        }
+        VkLog::StartAsync();
+    }
+
+    ~VkLogSession()
+    {
+        VkLog::StopAsync();
+    }
+
+private:
+    VkLogSession(const VkLogSession&);
+    VkLogSession& operator=(const VkLogSession&);
+};
+
+#define VK_LOG(level, ...) do { if (VkLog::IsEnabled(level)) { VkLog::Write(level, __VA_ARGS__); } } while (0)
+
+#define VK_LOG_ERROR(...) VK_LOG(VK_LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#if VK_LOG_MAX_LEVEL >= VK_LOG_LEVEL_WARNING
+#define VK_LOG_WARNING(...) VK_LOG(VK_LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define VK_LOG_WARNING(...) do { } while (0)
+#endif
+
+#if VK_LOG_MAX_LEVEL >= VK_LOG_LEVEL_INFO
+#define VK_LOG_INFO(...) VK_LOG(VK_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define VK_LOG_INFO(...) do { } while (0)
+#endif
+
+#if VK_LOG_MAX_LEVEL >= VK_LOG_LEVEL_DEBUG
+#define VK_LOG_DEBUG(...) VK_LOG(VK_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define VK_LOG_DEBUG(...) do { } while (0)
+#endif
+
+#endif /* _VKCODECUTILS_VKLOG_H_ */
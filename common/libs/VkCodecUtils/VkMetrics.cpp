@@ -0,0 +1,408 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <errno.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "VkCodecUtils/VkMetrics.h"
+
+namespace {
+
+struct MetricEntry {
+    MetricEntry(VkMetricType metricType, const char* metricName, const char* metricHelp,
+                const std::string& metricLabels)
+        : type(metricType), name(metricName), help(metricHelp), labels(metricLabels)
+        , counter(), gauge(), histogram() { }
+
+    const VkMetricType      type;
+    const char* const       name;
+    const char* const       help;
+    const std::string       labels;
+    VkMetricCounter         counter;
+    VkMetricGauge           gauge;
+    VkMetricHistogram       histogram;
+};
+
+struct MetricsRegistry {
+    MetricsRegistry() : mutex(), entries(), numStreams(0) { }
+
+    std::mutex                                mutex;
+    std::vector<std::unique_ptr<MetricEntry>> entries;
+    uint32_t                                  numStreams;
+};
+
+MetricsRegistry& GetRegistry()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricEntry& GetEntry(VkMetricType type, const char* name, const char* help, const std::string& labels)
+{
+    MetricsRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t i = 0; i < registry.entries.size(); i++) {
+        MetricEntry& entry = *registry.entries[i];
+        if ((strcmp(entry.name, name) == 0) && (entry.labels == labels)) {
+            // A name is of a single type
+            if (entry.type == type) {
+                return entry;
+            }
+        }
+    }
+    registry.entries.push_back(std::unique_ptr<MetricEntry>(new MetricEntry(type, name, help, labels)));
+    return *registry.entries.back();
+}
+
+void AppendValue(std::string& text, const char* name, const char* suffix, const std::string& labels,
+                 const char* extraLabel, double value)
+{
+    char valueText[64];
+    snprintf(valueText, sizeof(valueText), "%.17g", value);
+
+    text += name;
+    text += suffix;
+    if (!labels.empty() || (extraLabel != nullptr)) {
+        text += '{';
+        text += labels;
+        if (extraLabel != nullptr) {
+            if (!labels.empty()) {
+                text += ',';
+            }
+            text += extraLabel;
+        }
+        text += '}';
+    }
+    text += ' ';
+    text += valueText;
+    text += '\n';
+}
+
+} // namespace
+
+std::atomic<bool> VkMetrics::s_enabled(false);
+
+void VkMetrics::Enable()
+{
+    s_enabled.store(true, std::memory_order_release);
+}
+
+std::string VkMetrics::NewStreamLabels()
+{
+    MetricsRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return "stream=\"" + std::to_string(registry.numStreams++) + "\"";
+}
+
+VkMetricCounter& VkMetrics::GetCounter(const char* name, const char* help, const std::string& labels)
+{
+    return GetEntry(VK_METRIC_TYPE_COUNTER, name, help, labels).counter;
+}
+
+VkMetricGauge& VkMetrics::GetGauge(const char* name, const char* help, const std::string& labels)
+{
+    return GetEntry(VK_METRIC_TYPE_GAUGE, name, help, labels).gauge;
+}
+
+VkMetricHistogram& VkMetrics::GetHistogram(const char* name, const char* help, const std::string& labels)
+{
+    return GetEntry(VK_METRIC_TYPE_HISTOGRAM, name, help, labels).histogram;
+}
+
+void VkMetrics::GetSamples(std::vector<VkMetricSample>& samples)
+{
+    MetricsRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    samples.resize(registry.entries.size());
+    for (size_t i = 0; i < registry.entries.size(); i++) {
+        const MetricEntry& entry = *registry.entries[i];
+        VkMetricSample& sample = samples[i];
+        sample.type = entry.type;
+        sample.name = entry.name;
+        sample.labels = entry.labels;
+        sample.sum = 0;
+        sample.buckets.clear();
+        if (entry.type == VK_METRIC_TYPE_COUNTER) {
+            sample.value = (double)entry.counter.Get();
+        } else if (entry.type == VK_METRIC_TYPE_GAUGE) {
+            sample.value = entry.gauge.Get();
+        } else {
+            // The buckets are read before the count, which is then at least their total
+            uint64_t cumulativeCount = 0;
+            sample.buckets.resize(VkMetricHistogram::numBuckets);
+            for (uint32_t bucket = 0; bucket < VkMetricHistogram::numBuckets; bucket++) {
+                cumulativeCount += entry.histogram.GetBucketCount(bucket);
+                sample.buckets[bucket] = cumulativeCount;
+            }
+            sample.sum = entry.histogram.GetSum();
+            sample.value = (double)std::max(entry.histogram.GetCount(), cumulativeCount);
+        }
+    }
+}
+
+void VkMetrics::WritePrometheusText(std::string& text)
+{
+    MetricsRegistry& registry = GetRegistry();
+    std::vector<const MetricEntry*> entries;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (size_t i = 0; i < registry.entries.size(); i++) {
+            entries.push_back(registry.entries[i].get());
+        }
+    }
+    // The entries live until the process exits, they are read without the lock. The samples of a name are grouped.
+    std::stable_sort(entries.begin(), entries.end(), [](const MetricEntry* a, const MetricEntry* b) {
+        return strcmp(a->name, b->name) < 0;
+    });
+
+    static const char* const typeNames[] = { "counter", "gauge", "histogram" };
+    text.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        const MetricEntry& entry = *entries[i];
+        if ((i == 0) || (strcmp(entries[i - 1]->name, entry.name) != 0)) {
+            text += "# HELP ";
+            text += entry.name;
+            text += ' ';
+            text += entry.help;
+            text += "\n# TYPE ";
+            text += entry.name;
+            text += ' ';
+            text += typeNames[entry.type];
+            text += '\n';
+        }
+
+        if (entry.type == VK_METRIC_TYPE_COUNTER) {
+            AppendValue(text, entry.name, "", entry.labels, nullptr, (double)entry.counter.Get());
+        } else if (entry.type == VK_METRIC_TYPE_GAUGE) {
+            AppendValue(text, entry.name, "", entry.labels, nullptr, entry.gauge.Get());
+        } else {
+            uint64_t cumulativeCount = 0;
+            for (uint32_t bucket = 0; bucket < VkMetricHistogram::numBuckets; bucket++) {
+                cumulativeCount += entry.histogram.GetBucketCount(bucket);
+                if (bucket == (VkMetricHistogram::numBuckets - 1)) {
+                    break;
+                }
+                char bucketLabel[48];
+                snprintf(bucketLabel, sizeof(bucketLabel), "le=\"%llu\"",
+                         (unsigned long long)VkMetricHistogram::GetBucketBound(bucket));
+                AppendValue(text, entry.name, "_bucket", entry.labels, bucketLabel, (double)cumulativeCount);
+            }
+            AppendValue(text, entry.name, "_bucket", entry.labels, "le=\"+Inf\"", (double)cumulativeCount);
+            AppendValue(text, entry.name, "_sum", entry.labels, nullptr, (double)entry.histogram.GetSum());
+            AppendValue(text, entry.name, "_count", entry.labels, nullptr, (double)cumulativeCount);
+        }
+    }
+}
+
+void VkMetrics::WriteJson(std::string& text)
+{
+    std::vector<VkMetricSample> samples;
+    GetSamples(samples);
+
+    static const char* const typeNames[] = { "counter", "gauge", "histogram" };
+    char valueText[64];
+    text = "[";
+    for (size_t i = 0; i < samples.size(); i++) {
+        const VkMetricSample& sample = samples[i];
+        text += (i == 0) ? "\n" : ",\n";
+        text += "  { \"name\": \"";
+        text += sample.name;
+        text += "\", \"type\": \"";
+        text += typeNames[sample.type];
+        // The labels are name="value" pairs, their quotes escaped
+        text += "\", \"labels\": \"";
+        for (const char c : sample.labels) {
+            if ((c == '"') || (c == '\\')) {
+                text += '\\';
+            }
+            text += c;
+        }
+        snprintf(valueText, sizeof(valueText), "%.17g", sample.value);
+        text += "\", \"value\": ";
+        text += valueText;
+        if (sample.type == VK_METRIC_TYPE_HISTOGRAM) {
+            text += ", \"sum\": " + std::to_string(sample.sum) + ", \"buckets\": [";
+            for (uint32_t bucket = 0; bucket < sample.buckets.size(); bucket++) {
+                // The last bucket also counts the values above its bound
+                text += (bucket == 0) ? "[" : ", [";
+                text += (bucket == (sample.buckets.size() - 1)) ? std::string("null") :
+                                                                  std::to_string(VkMetricHistogram::GetBucketBound(bucket));
+                text += ", " + std::to_string(sample.buckets[bucket]) + "]";
+            }
+            text += "]";
+        }
+        text += " }";
+    }
+    text += "\n]";
+}
+
+VkMetricsFile::VkMetricsFile(const char* fileName)
+    : m_fileName((fileName != nullptr) ? fileName : "")
+    , m_start(std::chrono::steady_clock::now())
+{
+}
+
+VkMetricsFile::~VkMetricsFile()
+{
+    if (m_fileName.empty()) {
+        return;
+    }
+
+    FILE* file = fopen(m_fileName.c_str(), "w");
+    if (file == nullptr) {
+        std::cerr << "Failed to open the metrics file " << m_fileName << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    std::string metrics;
+    VkMetrics::WriteJson(metrics);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    fprintf(file, "{\n\"seconds\": %.6f,\n\"metrics\": %s\n}\n", seconds, metrics.c_str());
+    fclose(file);
+}
+
+VkMetricsServer::VkMetricsServer(uint16_t port)
+    : m_socket(-1)
+    , m_stop(false)
+    , m_thread()
+{
+    if (port != 0) {
+        Start(port);
+    }
+}
+
+VkMetricsServer::~VkMetricsServer()
+{
+    Stop();
+}
+
+#ifdef _WIN32
+
+bool VkMetricsServer::Start(uint16_t)
+{
+    std::cerr << "The metrics endpoint is not supported on this platform" << std::endl;
+    return false;
+}
+
+void VkMetricsServer::Stop()
+{
+}
+
+void VkMetricsServer::ServerThread()
+{
+}
+
+#else
+
+bool VkMetricsServer::Start(uint16_t port)
+{
+    if (m_thread.joinable()) {
+        return false;
+    }
+
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_socket < 0) {
+        std::cerr << "Failed to create the socket of the metrics endpoint: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    const int reuseAddress = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if ((bind(m_socket, (const struct sockaddr*)&address, sizeof(address)) != 0) || (listen(m_socket, 4) != 0)) {
+        std::cerr << "Failed to listen on port " << port << " for the metrics endpoint: " << strerror(errno) << std::endl;
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    VkMetrics::Enable();
+    m_stop = false;
+    m_thread = std::thread(&VkMetricsServer::ServerThread, this);
+    std::cout << "Serving the metrics on http://0.0.0.0:" << port << "/metrics" << std::endl;
+    return true;
+}
+
+void VkMetricsServer::Stop()
+{
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_socket >= 0) {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+void VkMetricsServer::ServerThread()
+{
+    std::string body;
+    std::string response;
+    while (!m_stop) {
+        // Polled with a timeout, for Stop() to be noticed
+        struct pollfd pollFd = { m_socket, POLLIN, 0 };
+        if (poll(&pollFd, 1, 100) <= 0) {
+            continue;
+        }
+        const int clientSocket = accept(m_socket, nullptr, nullptr);
+        if (clientSocket < 0) {
+            continue;
+        }
+
+        // A scrape fits in a single read, the rest of the request is not needed
+        char request[1024];
+        struct pollfd clientPollFd = { clientSocket, POLLIN, 0 };
+        const ssize_t requestSize = (poll(&clientPollFd, 1, 1000) > 0) ?
+                                        recv(clientSocket, request, sizeof(request) - 1, 0) : -1;
+        if (requestSize > 0) {
+            request[requestSize] = '\0';
+            if ((strncmp(request, "GET /metrics ", 13) == 0) || (strncmp(request, "GET / ", 6) == 0)) {
+                VkMetrics::WritePrometheusText(body);
+                response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            } else {
+                response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+            size_t sent = 0;
+            while (sent < response.size()) {
+                const ssize_t result = send(clientSocket, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (result <= 0) {
+                    break;
+                }
+                sent += (size_t)result;
+            }
+        }
+        close(clientSocket);
+    }
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKMETRICS_H_
+#define _VKCODECUTILS_VKMETRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A monotonic count, e.g. of the frames decoded
+class VkMetricCounter
+{
+public:
+    VkMetricCounter() : m_value(0) { }
+
+    void Add(uint64_t value = 1)
+    {
+        m_value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+// A value going up and down, e.g. the depth of a queue
+class VkMetricGauge
+{
+public:
+    VkMetricGauge() : m_value(0.0) { }
+
+    void Set(double value)
+    {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+
+    void Add(double value)
+    {
+        double expected = m_value.load(std::memory_order_relaxed);
+        while (!m_value.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed)) { }
+    }
+
+    double Get() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> m_value;
+};
+
+// The distribution of a value, e.g. of the time of a frame in microseconds, in buckets of powers of two
+class VkMetricHistogram
+{
+public:
+    static const uint32_t numBuckets = 24;
+
+    VkMetricHistogram() : m_count(0), m_sum(0)
+    {
+        for (uint32_t i = 0; i < numBuckets; i++) {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // The largest value of a bucket, the last one also counts the values above it
+    static uint64_t GetBucketBound(uint32_t bucket)
+    {
+        return 1ULL << bucket;
+    }
+
+    void Observe(uint64_t value)
+    {
+        uint32_t bucket = 0;
+        while ((bucket < (numBuckets - 1)) && (value > GetBucketBound(bucket))) {
+            bucket++;
+        }
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t GetCount() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t GetSum() const { return m_sum.load(std::memory_order_relaxed); }
+    uint64_t GetBucketCount(uint32_t bucket) const { return m_buckets[bucket].load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_buckets[numBuckets];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+};
+
+// Observes the time of the scope it lives in, in microseconds
+class VkMetricScopedTimer
+{
+public:
+    explicit VkMetricScopedTimer(VkMetricHistogram& histogram)
+        : m_histogram(histogram)
+        , m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~VkMetricScopedTimer()
+    {
+        m_histogram.Observe((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - m_start).count());
+    }
+
+private:
+    VkMetricScopedTimer(const VkMetricScopedTimer&);
+    VkMetricScopedTimer& operator=(const VkMetricScopedTimer&);
+
+    VkMetricHistogram&                          m_histogram;
+    const std::chrono::steady_clock::time_point m_start;
+};
+
+enum VkMetricType {
+    VK_METRIC_TYPE_COUNTER,
+    VK_METRIC_TYPE_GAUGE,
+    VK_METRIC_TYPE_HISTOGRAM,
+};
+
+// The value of a metric at the time it was pulled
+struct VkMetricSample {
+    VkMetricType          type;
+    std::string           name;
+    std::string           labels;  // e.g. stream="0", empty if none
+    double                value;   // of a counter or a gauge, the number of observations of a histogram
+    uint64_t              sum;     // of the observations of a histogram
+    std::vector<uint64_t> buckets; // of a histogram, the cumulative counts up to VkMetricHistogram::GetBucketBound()
+};
+
+// The process wide registry of the runtime metrics of the decode and encode pipelines. The metrics are registered
+// once, under a lock, and updated with relaxed atomics from any thread. They live until the process exits, so a
+// stream registering the labels of an earlier one continues its counts.
+class VkMetrics
+{
+public:
+    // The metrics are always counted, the enabled state only gates the ones that are sampled at some cost,
+    // e.g. the occupancy of a pool taking its lock
+    static void Enable();
+
+    static bool IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // The labels of a new stream, stream="<n>", the streams of the decoders and the encoders counted together
+    static std::string NewStreamLabels();
+
+    // The name and the help text must be string literals
+    static VkMetricCounter& GetCounter(const char* name, const char* help, const std::string& labels = std::string());
+    static VkMetricGauge& GetGauge(const char* name, const char* help, const std::string& labels = std::string());
+    static VkMetricHistogram& GetHistogram(const char* name, const char* help,
+                                           const std::string& labels = std::string());
+
+    // The pull API, the current value of every metric registered
+    static void GetSamples(std::vector<VkMetricSample>& samples);
+
+    // The metrics in the Prometheus text exposition format
+    static void WritePrometheusText(std::string& text);
+
+    // The metrics in JSON, an array of the samples with the bounds of the histogram buckets, for the scripts
+    // comparing runs, e.g. scripts/perf_regression.py
+    static void WriteJson(std::string& text);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Serves the Prometheus text of the metrics on GET /metrics over HTTP, from a thread of its own.
+// Meant to be declared in main(), once the arguments are parsed; a port of 0 leaves it stopped.
+class VkMetricsServer
+{
+public:
+    explicit VkMetricsServer(uint16_t port = 0);
+    ~VkMetricsServer();
+
+    bool Start(uint16_t port);
+    void Stop();
+
+private:
+    VkMetricsServer(const VkMetricsServer&);
+    VkMetricsServer& operator=(const VkMetricsServer&);
+
+    void ServerThread();
+
+    int               m_socket;
+    std::atomic<bool> m_stop;
+    std::thread       m_thread;
+};
+
+// Writes the JSON of the metrics and the run time to a file when it goes out of scope. Meant to be declared in
+// main() before the device, for the totals of the whole run; an empty file name disables it.
+class VkMetricsFile
+{
+public:
+    explicit VkMetricsFile(const char* fileName);
+    ~VkMetricsFile();
+
+private:
+    VkMetricsFile(const VkMetricsFile&);
+    VkMetricsFile& operator=(const VkMetricsFile&);
+
+    const std::string                           m_fileName;
+    const std::chrono::steady_clock::time_point m_start;
+};
+
+#endif /* _VKCODECUTILS_VKMETRICS_H_ */
@@ -0,0 +1,129 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include "VkCodecUtils/VkNalPreScanner.h"
+
+void VkNalPreScanner::Start(const uint8_t* pData, size_t dataSize, size_t startOffset)
+{
+    Stop();
+
+    m_pData = pData;
+    m_dataSize = dataSize;
+    m_scannedBytes = std::min(startOffset, dataSize);
+    m_consumerOffset = m_scannedBytes;
+    m_stopScanning = false;
+    m_startCodes.clear();
+
+    m_thread = std::thread(&VkNalPreScanner::ScanThread, this);
+}
+
+void VkNalPreScanner::Stop()
+{
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopScanning = true;
+        }
+        m_condScanner.notify_one();
+        m_thread.join();
+    }
+
+    m_pData = nullptr;
+    m_dataSize = 0;
+    m_startCodes.clear();
+}
+
+size_t VkNalPreScanner::GetStartCodes(size_t offset, size_t size, std::vector<size_t>& startCodeOffsets)
+{
+    startCodeOffsets.clear();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if ((m_pData == nullptr) || (offset >= m_dataSize)) {
+        return 0;
+    }
+
+    // Let the scanner move ahead and wait for at least one scan window past the current offset,
+    // so the parser doesn't fall back to its own start code search right away.
+    m_consumerOffset = offset;
+    m_condScanner.notify_one();
+    const size_t chunkEnd = offset + std::min(size, m_dataSize - offset);
+    const size_t minScannedBytes = std::min(chunkEnd, offset + m_scanWindowSize);
+    m_condConsumer.wait(lock, [this, minScannedBytes]{ return m_stopScanning || (m_scannedBytes >= minScannedBytes); });
+
+    // Drop the boundaries the parser has already gone past
+    while (!m_startCodes.empty() && (m_startCodes.front() <= offset)) {
+        m_startCodes.pop_front();
+    }
+
+    if (m_scannedBytes <= offset) {
+        return 0;
+    }
+
+    const size_t scanEnd = std::min(m_scannedBytes, chunkEnd);
+    for (size_t startCode : m_startCodes) {
+        if (startCode > scanEnd) {
+            break;
+        }
+        startCodeOffsets.push_back(startCode - offset);
+    }
+
+    return scanEnd - offset;
+}
+
+void VkNalPreScanner::ScanThread()
+{
+    std::vector<size_t> windowStartCodes;
+
+    for (;;) {
+        size_t scanStart = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condScanner.wait(lock, [this]{
+                return m_stopScanning || (m_scannedBytes < (m_consumerOffset + m_scanWindowSize * m_maxWindowsAhead));
+            });
+            if (m_stopScanning || (m_scannedBytes >= m_dataSize)) {
+                return;
+            }
+            scanStart = m_scannedBytes;
+        }
+
+        const size_t scanEnd = std::min(scanStart + m_scanWindowSize, m_dataSize);
+        windowStartCodes.clear();
+
+        // Back up two bytes to catch the start codes straddling the previous window.
+        // If the third byte is greater than 1, none of the three positions can begin a start code.
+        size_t i = (scanStart >= 2) ? (scanStart - 2) : 0;
+        while ((i + 3) <= scanEnd) {
+            const uint8_t c = m_pData[i + 2];
+            if (c > 1) {
+                i += 3;
+            } else if ((c == 1) && (m_pData[i + 1] == 0) && (m_pData[i] == 0)) {
+                windowStartCodes.push_back(i + 3);
+                i += 3;
+            } else {
+                i++;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_startCodes.insert(m_startCodes.end(), windowStartCodes.begin(), windowStartCodes.end());
+            m_scannedBytes = scanEnd;
+        }
+        m_condConsumer.notify_one();
+    }
+}
@@ -0,0 +1,77 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKNALPRESCANNER_H_
+#define _VKCODECUTILS_VKNALPRESCANNER_H_
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Scans an Annex-B byte stream for 00.00.01 start codes on a worker thread, ahead of the parser.
+// The boundaries are recorded as absolute stream offsets of the first byte after each start code,
+// which is the same position VulkanVideoDecoder::next_start_code() would return for them.
+class VkNalPreScanner {
+public:
+    VkNalPreScanner(size_t scanWindowSize = 1024 * 1024, uint32_t maxWindowsAhead = 8)
+        : m_scanWindowSize(scanWindowSize)
+        , m_maxWindowsAhead(maxWindowsAhead)
+        , m_pData(nullptr)
+        , m_dataSize(0)
+        , m_scannedBytes(0)
+        , m_consumerOffset(0)
+        , m_stopScanning(false)
+        , m_startCodes()
+        , m_thread()
+    {
+    }
+
+    ~VkNalPreScanner() { Stop(); }
+
+    // Start (or restart) scanning pData from startOffset, the beginning by default. The data must stay valid until Stop().
+    void Start(const uint8_t* pData, size_t dataSize, size_t startOffset = 0);
+
+    void Stop();
+
+    bool IsStarted() const { return m_pData != nullptr; }
+
+    // Returns the start code table for the chunk of the stream at offset with up to size bytes.
+    // The offsets are relative to the chunk. The return value is the number of chunk bytes
+    // covered by the table, which can be less than size if the scanner has not got that far yet.
+    size_t GetStartCodes(size_t offset, size_t size, std::vector<size_t>& startCodeOffsets);
+
+private:
+    void ScanThread();
+
+private:
+    const size_t              m_scanWindowSize;
+    const uint32_t            m_maxWindowsAhead;
+    const uint8_t*            m_pData;
+    size_t                    m_dataSize;
+    size_t                    m_scannedBytes;   // bytes of the stream with all start codes in m_startCodes
+    size_t                    m_consumerOffset; // stream offset the parser has reached
+    bool                      m_stopScanning;
+    std::deque<size_t>        m_startCodes;
+    std::mutex                m_mutex;
+    std::condition_variable   m_condScanner;
+    std::condition_variable   m_condConsumer;
+    std::thread               m_thread;
+};
+
+#endif /* _VKCODECUTILS_VKNALPRESCANNER_H_ */
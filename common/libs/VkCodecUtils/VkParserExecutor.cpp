@@ -0,0 +1,88 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include "VkParserExecutor.h"
+
+VkParserExecutor::VkParserExecutor(size_t numWorkers, const std::vector<uint32_t>& cpus)
+    : m_threadPool(new VkThreadPool((numWorkers > 0) ? numWorkers : 1, cpus))
+    , m_channels()
+    , m_pendingSteps()
+{
+}
+
+VkParserExecutor::~VkParserExecutor()
+{
+    m_pendingSteps.Wait();
+    // The workers are joined before the channels go away
+    m_threadPool.reset();
+}
+
+uint32_t VkParserExecutor::AddChannel(const StepFunction& step)
+{
+    Channel channel;
+    channel.step = step;
+    channel.lastWorker = -1;
+    channel.numSteps = 0;
+    channel.numMigrations = 0;
+    m_channels.push_back(channel);
+    return (uint32_t)(m_channels.size() - 1);
+}
+
+void VkParserExecutor::Run()
+{
+    // Spread round-robin over the workers from here, each worker keeps its channels from then on
+    for (uint32_t channelIndex = 0; channelIndex < (uint32_t)m_channels.size(); channelIndex++) {
+        SubmitStep(channelIndex);
+    }
+    m_pendingSteps.Wait();
+}
+
+void VkParserExecutor::SubmitStep(uint32_t channelIndex)
+{
+    VkParserExecutor* pExecutor = this;
+    m_threadPool->Submit([pExecutor, channelIndex]() { pExecutor->RunStep(channelIndex); },
+                         VkThreadPool::PRIORITY_BACKGROUND, &m_pendingSteps);
+}
+
+void VkParserExecutor::RunStep(uint32_t channelIndex)
+{
+    assert(channelIndex < m_channels.size());
+    Channel& channel = m_channels[channelIndex];
+
+    const int32_t worker = VkThreadPool::GetCurrentWorkerIndex();
+    if ((channel.lastWorker >= 0) && (channel.lastWorker != worker)) {
+        channel.numMigrations++;
+    }
+    channel.lastWorker = worker;
+    channel.numSteps++;
+
+    // Queued again behind the other channels of the worker, counted in the group before this step is done
+    if (channel.step()) {
+        SubmitStep(channelIndex);
+    }
+}
+
+void VkParserExecutor::PrintStats() const
+{
+    printf("Parser executor: %zu channels on %zu workers\n", m_channels.size(), m_threadPool->GetNumThreads());
+    for (uint32_t channelIndex = 0; channelIndex < (uint32_t)m_channels.size(); channelIndex++) {
+        const Channel& channel = m_channels[channelIndex];
+        printf("\tChannel %u: %8llu steps, %6llu on another worker\n", channelIndex,
+               (unsigned long long)channel.numSteps, (unsigned long long)channel.numMigrations);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKPARSEREXECUTOR_H_
+#define _VKCODECUTILS_VKPARSEREXECUTOR_H_
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "VkCodecUtils/VkThreadPool.h"
+
+// Time-slices the parsing and the decode submission of many channels over a few workers, instead of a thread per
+// channel. A channel runs one step at a time, e.g. the frames of its decode-ahead depth, then goes to the back of
+// the deque of the worker that ran it, so it stays on the same core as long as that worker keeps up. The idle
+// workers steal the steps of the busy ones. With at most one step of a channel queued or running at any time, the
+// state of its parser is only ever used by one worker at a time, handed over with the lock of the deque.
+class VkParserExecutor
+{
+public:
+    // Runs one time slice of the channel, returns false once the channel is done
+    typedef std::function<bool()> StepFunction;
+
+    // The workers are pinned to the CPUs of the list in turn, one each, if not empty
+    VkParserExecutor(size_t numWorkers, const std::vector<uint32_t>& cpus);
+    ~VkParserExecutor();
+
+    // Before Run(), returns the index of the channel
+    uint32_t AddChannel(const StepFunction& step);
+
+    // Steps all the channels until they are all done
+    void Run();
+
+    // The steps per channel and how many of them ran on another worker than the previous one
+    void PrintStats() const;
+
+private:
+    struct Channel {
+        StepFunction step;
+        int32_t      lastWorker;    // -1 before the first step
+        uint64_t     numSteps;
+        uint64_t     numMigrations; // the steps stolen by another worker
+    };
+
+    void SubmitStep(uint32_t channelIndex);
+    void RunStep(uint32_t channelIndex);
+
+    VkParserExecutor(const VkParserExecutor&) = delete;
+    VkParserExecutor& operator=(const VkParserExecutor&) = delete;
+
+private:
+    std::unique_ptr<VkThreadPool> m_threadPool;
+    std::vector<Channel>          m_channels;     // not resized while running
+    VkThreadPool::TaskGroup       m_pendingSteps;
+};
+
+#endif /* _VKCODECUTILS_VKPARSEREXECUTOR_H_ */
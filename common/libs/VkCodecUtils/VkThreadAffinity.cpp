@@ -0,0 +1,254 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "VkThreadAffinity.h"
+
+bool VkParseCpuList(const char* pCpuList, std::vector<uint32_t>& cpus)
+{
+    cpus.clear();
+    if (pCpuList == nullptr) {
+        return false;
+    }
+
+    const char* p = pCpuList;
+    while (*p != '\0') {
+        char* pEnd = nullptr;
+        const unsigned long first = strtoul(p, &pEnd, 10);
+        if (pEnd == p) {
+            cpus.clear();
+            return false;
+        }
+        unsigned long last = first;
+        p = pEnd;
+        if (*p == '-') {
+            p++;
+            last = strtoul(p, &pEnd, 10);
+            if ((pEnd == p) || (last < first)) {
+                cpus.clear();
+                return false;
+            }
+            p = pEnd;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back((uint32_t)cpu);
+        }
+        if (*p == ',') {
+            p++;
+        } else if ((*p != '\0') && (*p != '\n')) {
+            cpus.clear();
+            return false;
+        } else {
+            break;
+        }
+    }
+    return !cpus.empty();
+}
+
+#if defined(_WIN32)
+static bool SetAffinity(HANDLE thread, const std::vector<uint32_t>& cpus)
+{
+    // The CPUs of the first processor group only
+    DWORD_PTR mask = 0;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i] < (sizeof(DWORD_PTR) * 8)) {
+            mask |= (DWORD_PTR)1 << cpus[i];
+        }
+    }
+    return (mask != 0) && (SetThreadAffinityMask(thread, mask) != 0);
+}
+#elif defined(__linux__)
+static bool SetAffinity(pthread_t thread, const std::vector<uint32_t>& cpus)
+{
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    bool anyCpu = false;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i] < CPU_SETSIZE) {
+            CPU_SET(cpus[i], &cpuSet);
+            anyCpu = true;
+        }
+    }
+    return anyCpu && (pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet) == 0);
+}
+#endif
+
+bool VkSetThreadAffinity(std::thread& thread, const std::vector<uint32_t>& cpus)
+{
+    if (cpus.empty() || !thread.joinable()) {
+        return false;
+    }
+#if defined(_WIN32)
+    return SetAffinity((HANDLE)thread.native_handle(), cpus);
+#elif defined(__linux__)
+    return SetAffinity(thread.native_handle(), cpus);
+#else
+    return false;
+#endif
+}
+
+bool VkSetCurrentThreadAffinity(const std::vector<uint32_t>& cpus)
+{
+    if (cpus.empty()) {
+        return false;
+    }
+#if defined(_WIN32)
+    return SetAffinity(GetCurrentThread(), cpus);
+#elif defined(__linux__)
+    return SetAffinity(pthread_self(), cpus);
+#else
+    return false;
+#endif
+}
+
+int32_t VkGetCpuNumaNode(uint32_t cpu)
+{
+#if defined(__linux__)
+    // The node of the CPU is the nodeN link in its sysfs directory
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+    DIR* pDir = opendir(path);
+    if (pDir == nullptr) {
+        return -1;
+    }
+    int32_t numaNode = -1;
+    for (struct dirent* pEntry = readdir(pDir); pEntry != nullptr; pEntry = readdir(pDir)) {
+        if ((strncmp(pEntry->d_name, "node", 4) == 0) && (pEntry->d_name[4] >= '0') && (pEntry->d_name[4] <= '9')) {
+            numaNode = atoi(pEntry->d_name + 4);
+            break;
+        }
+    }
+    closedir(pDir);
+    return numaNode;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+int32_t VkGetCurrentNumaNode()
+{
+#if defined(__linux__)
+    const int cpu = sched_getcpu();
+    return (cpu >= 0) ? VkGetCpuNumaNode((uint32_t)cpu) : -1;
+#else
+    return -1;
+#endif
+}
+
+bool VkBindMemoryToNumaNode(void* pMemory, size_t size, int32_t numaNode)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    // From <numaif.h>, without a dependency on libnuma
+    const int mpolPreferred = 1;
+    const unsigned int mpolMfMove = (1 << 1);
+
+    const unsigned long numMaskBits = 1024;
+    unsigned long nodeMask[numMaskBits / (sizeof(unsigned long) * 8)] = {};
+    if ((pMemory == nullptr) || (size == 0) || (numaNode < 0) || ((unsigned long)numaNode >= numMaskBits)) {
+        return false;
+    }
+    nodeMask[numaNode / (sizeof(unsigned long) * 8)] |= 1UL << (numaNode % (sizeof(unsigned long) * 8));
+
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0) {
+        return false;
+    }
+    const uintptr_t start = (uintptr_t)pMemory & ~((uintptr_t)pageSize - 1);
+    const size_t length = (size_t)(((uintptr_t)pMemory + size) - start);
+    return (syscall(SYS_mbind, start, length, mpolPreferred, nodeMask, numMaskBits, mpolMfMove) == 0);
+#else
+    (void)pMemory;
+    (void)size;
+    (void)numaNode;
+    return false;
+#endif
+}
+
+#if defined(__linux__)
+static bool ReadSysfsLine(const std::string& path, std::string& line)
+{
+    FILE* pFile = fopen(path.c_str(), "r");
+    if (pFile == nullptr) {
+        return false;
+    }
+    char buffer[1024];
+    const bool success = (fgets(buffer, sizeof(buffer), pFile) != nullptr);
+    fclose(pFile);
+    if (success) {
+        line = buffer;
+        const size_t end = line.find_last_not_of(" \n\r");
+        line.erase((end != std::string::npos) ? (end + 1) : 0);
+    }
+    return success;
+}
+#endif
+
+bool VkGetPciDeviceTopology(uint32_t domain, uint32_t bus, uint32_t device, uint32_t function,
+                            VkPciDeviceTopology& topology)
+{
+    topology = VkPciDeviceTopology();
+#if defined(__linux__)
+    char devicePath[64];
+    snprintf(devicePath, sizeof(devicePath), "/sys/bus/pci/devices/%04x:%02x:%02x.%x", domain, bus, device, function);
+
+    // The device link resolves into the hierarchy, e.g. /sys/devices/pci0000:00/0000:00:01.0/0000:01:00.0
+    char resolvedPath[PATH_MAX];
+    if (realpath(devicePath, resolvedPath) == nullptr) {
+        return false;
+    }
+    const std::string hierarchy(resolvedPath);
+    const std::string devicesPrefix("/sys/devices/");
+    if (hierarchy.compare(0, devicesPrefix.size(), devicesPrefix) != 0) {
+        return false;
+    }
+    const size_t rootComplexEnd = hierarchy.find('/', devicesPrefix.size());
+    topology.rootComplex = hierarchy.substr(devicesPrefix.size(), rootComplexEnd - devicesPrefix.size());
+    // No root port for a device on the root complex itself, e.g. an integrated GPU
+    const size_t rootPortEnd = (rootComplexEnd != std::string::npos) ? hierarchy.find('/', rootComplexEnd + 1) :
+                                                                       std::string::npos;
+    if (rootPortEnd != std::string::npos) {
+        topology.rootPort = hierarchy.substr(rootComplexEnd + 1, rootPortEnd - rootComplexEnd - 1);
+    }
+
+    std::string line;
+    if (ReadSysfsLine(std::string(devicePath) + "/numa_node", line)) {
+        topology.numaNode = atoi(line.c_str());
+    }
+    if (ReadSysfsLine(std::string(devicePath) + "/local_cpulist", line)) {
+        topology.localCpuList = line;
+    }
+    return true;
+#else
+    (void)domain;
+    (void)bus;
+    (void)device;
+    (void)function;
+    return false;
+#endif
+}
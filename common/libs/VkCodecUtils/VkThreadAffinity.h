@@ -0,0 +1,58 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKTHREADAFFINITY_H_
+#define _VKCODECUTILS_VKTHREADAFFINITY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The placement of the threads and of the host memory on the CPUs and the NUMA nodes of the system.
+// Everything is best effort: where the platform doesn't support it, the functions return false or -1
+// and the threads and the memory stay where the OS puts them.
+
+// Parses a list of CPUs in the format of the Linux cpulist files, e.g. "0-7,16,18"
+bool VkParseCpuList(const char* pCpuList, std::vector<uint32_t>& cpus);
+
+// Restricts the thread to run on the CPUs of the list, nothing is done for an empty list
+bool VkSetThreadAffinity(std::thread& thread, const std::vector<uint32_t>& cpus);
+bool VkSetCurrentThreadAffinity(const std::vector<uint32_t>& cpus);
+
+// The NUMA node of the CPU or of the CPU the calling thread runs on, -1 when unknown
+int32_t VkGetCpuNumaNode(uint32_t cpu);
+int32_t VkGetCurrentNumaNode();
+
+// Moves the pages of the host memory range to the NUMA node, with the pages faulted in later allocated there.
+// Only applies to the memory the OS can migrate, i.e. not to the mappings of the device memory apertures.
+bool VkBindMemoryToNumaNode(void* pMemory, size_t size, int32_t numaNode);
+
+// Where a PCI device is attached to the host, from its domain, bus, device and function numbers
+struct VkPciDeviceTopology {
+    VkPciDeviceTopology() : rootComplex(), rootPort(), numaNode(-1), localCpuList() { }
+
+    std::string rootComplex;  // the host bridge of the PCIe hierarchy, e.g. "pci0000:00"
+    std::string rootPort;     // the root port the device or its switch hangs off, e.g. "0000:00:01.0"
+    int32_t     numaNode;     // -1 when the system has no NUMA
+    std::string localCpuList; // the CPUs of that NUMA node, as a cpulist
+};
+
+bool VkGetPciDeviceTopology(uint32_t domain, uint32_t bus, uint32_t device, uint32_t function,
+                            VkPciDeviceTopology& topology);
+
+#endif /* _VKCODECUTILS_VKTHREADAFFINITY_H_ */
@@ -15,15 +15,198 @@
 */
 
 #include "VkThreadPool.h"
+#include "VkThreadAffinity.h"
 
-VkThreadPool::VkThreadPool()
+// Before a worker blocks, or a TaskGroup waits on its condition
+static const uint32_t spinCount = 256;
+
+// The pool and the index of the worker of the current thread, for the tasks submitted from the tasks to stay on it
+static thread_local VkThreadPool* t_pThreadPool = nullptr;
+static thread_local uint32_t t_workerIndex = 0;
+
+void VkThreadPool::TaskGroup::Wait()
+{
+    for (uint32_t spin = 0; (spin < spinCount) && (m_numPending.load(std::memory_order_acquire) != 0); spin++) {
+        std::this_thread::yield();
+    }
+
+    // Also for Done() to have released the mutex before the group goes away
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]() { return (m_numPending.load(std::memory_order_acquire) == 0); });
+}
+
+void VkThreadPool::TaskGroup::Done()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_numPending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_doneCondition.notify_all();
+    }
+}
+
+bool VkThreadPool::Deque::PushBack(Task& task)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_size == DEQUE_CAPACITY) {
+        return false;
+    }
+    m_tasks[(m_first + m_size) % DEQUE_CAPACITY] = std::move(task);
+    m_size++;
+    return true;
+}
+
+bool VkThreadPool::Deque::PopFront(Task& task)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_size == 0) {
+        return false;
+    }
+    task = std::move(m_tasks[m_first]);
+    m_first = (m_first + 1) % DEQUE_CAPACITY;
+    m_size--;
+    return true;
+}
+
+VkThreadPool::VkThreadPool(size_t threads, bool pinThreads)
+    : m_workers()
+    , m_threads()
+    , m_cpus()
+    , m_nextWorker(0)
+    , m_numPending(0)
+    , m_numSleeping(0)
+    , m_stop(false)
+    , m_mutex()
+    , m_taskCondition()
 {
-    // TODO Auto-generated constructor stub
+    const uint32_t numCores = std::thread::hardware_concurrency();
+    for (uint32_t core = 0; pinThreads && (core < ((numCores > 0) ? numCores : 1)); core++) {
+        m_cpus.push_back(core);
+    }
+    StartWorkers(threads);
+}
 
+VkThreadPool::VkThreadPool(size_t threads, const std::vector<uint32_t>& cpus)
+    : m_workers()
+    , m_threads()
+    , m_cpus(cpus)
+    , m_nextWorker(0)
+    , m_numPending(0)
+    , m_numSleeping(0)
+    , m_stop(false)
+    , m_mutex()
+    , m_taskCondition()
+{
+    StartWorkers(threads);
+}
+
+void VkThreadPool::StartWorkers(size_t threads)
+{
+    for (size_t i = 0; i < threads; i++) {
+        m_workers.push_back(new Worker());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        m_threads.emplace_back(&VkThreadPool::WorkerThread, this, (uint32_t)i);
+    }
 }
 
 VkThreadPool::~VkThreadPool()
 {
-    // TODO Auto-generated destructor stub
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_taskCondition.notify_all();
+
+    // The tasks still queued run before the workers exit
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    for (Worker* pWorker : m_workers) {
+        delete pWorker;
+    }
+}
+
+int32_t VkThreadPool::GetCurrentWorkerIndex()
+{
+    return (t_pThreadPool != nullptr) ? (int32_t)t_workerIndex : -1;
+}
+
+bool VkThreadPool::Push(Task& task, Priority priority)
+{
+    const uint32_t numWorkers = (uint32_t)m_workers.size();
+    if (numWorkers == 0) {
+        return false;
+    }
+
+    // To the worker of the thread submitting it, else round-robin, then to the next one with space left
+    const uint32_t firstWorker = (t_pThreadPool == this) ? t_workerIndex :
+                                     (m_nextWorker.fetch_add(1, std::memory_order_relaxed) % numWorkers);
+    bool pushed = false;
+    for (uint32_t i = 0; (i < numWorkers) && !pushed; i++) {
+        pushed = m_workers[(firstWorker + i) % numWorkers]->deques[priority].PushBack(task);
+    }
+    if (!pushed) {
+        return false;
+    }
+
+    // Either the worker going to sleep sees the task pending, or it is counted as sleeping here
+    m_numPending.fetch_add(1, std::memory_order_seq_cst);
+    if (m_numSleeping.load(std::memory_order_seq_cst) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_taskCondition.notify_one();
+    }
+    return true;
+}
+
+bool VkThreadPool::Pop(uint32_t workerIndex, Task& task)
+{
+    // All the latency-critical tasks first, from the own deque, then stolen from the others
+    const uint32_t numWorkers = (uint32_t)m_workers.size();
+    for (uint32_t priority = 0; priority < PRIORITY_COUNT; priority++) {
+        for (uint32_t i = 0; i < numWorkers; i++) {
+            if (m_workers[(workerIndex + i) % numWorkers]->deques[priority].PopFront(task)) {
+                m_numPending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
+void VkThreadPool::WorkerThread(uint32_t workerIndex)
+{
+    t_pThreadPool = this;
+    t_workerIndex = workerIndex;
+
+    if (!m_cpus.empty()) {
+        VkSetCurrentThreadAffinity(std::vector<uint32_t>(1, m_cpus[workerIndex % m_cpus.size()]));
+    }
+
+    Task task;
+    while (true) {
+
+        bool hasTask = Pop(workerIndex, task);
+        for (uint32_t spin = 0; !hasTask && (spin < spinCount); spin++) {
+            std::this_thread::yield();
+            hasTask = (m_numPending.load(std::memory_order_acquire) > 0) && Pop(workerIndex, task);
+        }
+
+        if (hasTask) {
+            task.Run();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_numSleeping.fetch_add(1, std::memory_order_seq_cst);
+        m_taskCondition.wait(lock, [this]() {
+            return m_stop || (m_numPending.load(std::memory_order_seq_cst) > 0);
+        });
+        m_numSleeping.fetch_sub(1, std::memory_order_relaxed);
+        if (m_stop && (m_numPending.load(std::memory_order_acquire) <= 0)) {
+            break;
+        }
+    }
+
+    t_pThreadPool = nullptr;
+}
@@ -17,75 +17,226 @@
 #ifndef _VKCODECUTILS_VKTHREADPOOL_H_
 #define _VKCODECUTILS_VKTHREADPOOL_H_
 
-#include <thread>
-#include <mutex>
+#include <cstddef>
+#include <stdint.h>
+#include <atomic>
 #include <condition_variable>
-#include <queue>
-#include <vector>
 #include <functional>
 #include <future>
-#include <stdexcept>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// A work-stealing pool: each worker has a bounded deque of tasks per priority, and takes the tasks of the other
+// workers when its own deques are empty. The latency-critical tasks of all the deques are taken before any of the
+// background ones. The tasks are stored in place in the deques, a task submitted doesn't allocate memory unless
+// a std::future is needed for its result. The workers spin for a while before they block when there is nothing to
+// do, and can be pinned to one core each.
 class VkThreadPool
 {
 public:
-    VkThreadPool(size_t threads) : stop(false) {
-        for(size_t i = 0; i < threads; ++i)
-            workers.emplace_back([this] {
-                for(;;) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty()) {
-                            return;
-                        }
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-                    task();
-                }
-            });
+    enum Priority {
+        PRIORITY_LATENCY_CRITICAL = 0, // something waits for it, e.g. the row bands of a frame
+        PRIORITY_BACKGROUND       = 1, // work ahead of its use, e.g. the frames loaded ahead
+        PRIORITY_COUNT
+    };
+
+    enum { TASK_STORAGE_SIZE = 64, DEQUE_CAPACITY = 256 };
+
+    // Counts the tasks submitted with it that haven't run yet
+    class TaskGroup {
+    public:
+        TaskGroup() : m_numPending(0) { }
+        ~TaskGroup() { Wait(); }
+
+        // Blocks until all the tasks of the group ran
+        void Wait();
+
+    private:
+        friend class VkThreadPool;
+        void Add() { m_numPending.fetch_add(1, std::memory_order_relaxed); }
+        void Done();
+
+        std::atomic<uint32_t>   m_numPending;
+        std::mutex              m_mutex;
+        std::condition_variable m_doneCondition;
+    };
+
+    // The pool threads are pinned to the cores from 0 on with pinThreads
+    explicit VkThreadPool(size_t threads, bool pinThreads = false);
+    // The pool threads are pinned to the CPUs of the list in turn, one each
+    VkThreadPool(size_t threads, const std::vector<uint32_t>& cpus);
+    ~VkThreadPool();
+
+    // Runs f() on one of the workers. When the deque it goes to is full, f() runs on the calling thread instead.
+    template<class F>
+    void Submit(F&& f, Priority priority = PRIORITY_BACKGROUND, TaskGroup* pGroup = nullptr)
+    {
+        Task task(std::forward<F>(f), pGroup);
+        if (pGroup != nullptr) {
+            pGroup->Add();
+        }
+        if (!Push(task, priority)) {
+            task.Run();
+        }
     }
 
+    // Runs f(args...) on one of the workers, for its result
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type> {
         using return_type = typename std::result_of<F(Args...)>::type;
 
-        auto task = std::make_shared< std::packaged_task<return_type()> >(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
+        std::packaged_task<return_type()> packagedTask(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = packagedTask.get_future();
+        Submit(PackagedTaskRunner<return_type>(std::move(packagedTask)), PRIORITY_BACKGROUND);
+        return res;
+    }
+
+    size_t GetNumThreads() const { return m_workers.size(); }
+
+    // The index of the worker of the calling thread in its pool, -1 if it isn't a pool thread
+    static int32_t GetCurrentWorkerIndex();
+
+private:
+    // A callable moved in place into the storage of the task
+    class Task {
+    public:
+        Task() : m_pOps(nullptr), m_pGroup(nullptr) { }
+
+        template<class F>
+        Task(F&& f, TaskGroup* pGroup)
+            : m_pOps(&Ops<typename std::decay<F>::type>::ops)
+            , m_pGroup(pGroup)
+        {
+            typedef typename std::decay<F>::type Callable;
+            static_assert(sizeof(Callable) <= TASK_STORAGE_SIZE, "The task is larger than TASK_STORAGE_SIZE");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t), "The task is over-aligned");
+            new (m_storage) Callable(std::forward<F>(f));
+        }
 
-        std::future<return_type> res = task->get_future();
+        Task(Task&& other) : m_pOps(other.m_pOps), m_pGroup(other.m_pGroup)
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            if(stop)
-                throw std::runtime_error("enqueue on stopped ThreadPool");
+            if (m_pOps != nullptr) {
+                m_pOps->move(m_storage, other.m_storage);
+                other.Reset();
+            }
+        }
 
-            tasks.emplace([task](){ (*task)(); });
+        Task& operator=(Task&& other)
+        {
+            if (this != &other) {
+                Reset();
+                m_pOps = other.m_pOps;
+                m_pGroup = other.m_pGroup;
+                if (m_pOps != nullptr) {
+                    m_pOps->move(m_storage, other.m_storage);
+                    other.Reset();
+                }
+            }
+            return *this;
         }
-        condition.notify_one();
-        return res;
-    }
 
-    ~VkThreadPool() {
+        ~Task() { Reset(); }
+
+        // Runs the callable once, then releases it
+        void Run()
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
+            if (m_pOps != nullptr) {
+                m_pOps->invoke(m_storage);
+                TaskGroup* pGroup = m_pGroup;
+                Reset();
+                if (pGroup != nullptr) {
+                    pGroup->Done();
+                }
+            }
         }
-        condition.notify_all();
-        for(std::thread &worker: workers)
-            worker.join();
-    }
+
+    private:
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        struct TaskOps {
+            void (*invoke)(void* pStorage);
+            void (*move)(void* pDstStorage, void* pSrcStorage); // and destroys the source
+            void (*destroy)(void* pStorage);
+        };
+
+        template<class Callable>
+        struct Ops {
+            static void Invoke(void* pStorage) { (*static_cast<Callable*>(pStorage))(); }
+            static void Move(void* pDstStorage, void* pSrcStorage)
+            {
+                Callable* pSrc = static_cast<Callable*>(pSrcStorage);
+                new (pDstStorage) Callable(std::move(*pSrc));
+                pSrc->~Callable();
+            }
+            static void Destroy(void* pStorage) { static_cast<Callable*>(pStorage)->~Callable(); }
+            static const TaskOps ops;
+        };
+
+        void Reset()
+        {
+            if (m_pOps != nullptr) {
+                m_pOps->destroy(m_storage);
+                m_pOps = nullptr;
+            }
+            m_pGroup = nullptr;
+        }
+
+        alignas(std::max_align_t) unsigned char m_storage[TASK_STORAGE_SIZE];
+        const TaskOps* m_pOps;
+        TaskGroup*     m_pGroup;
+    };
+
+    template<class R>
+    struct PackagedTaskRunner {
+        explicit PackagedTaskRunner(std::packaged_task<R()>&& packagedTask) : task(std::move(packagedTask)) { }
+        void operator()() { task(); }
+        std::packaged_task<R()> task;
+    };
+
+    // A ring of tasks, taken from its front by its worker and by the thieves alike
+    struct Deque {
+        Deque() : m_tasks(), m_first(0), m_size(0), m_mutex() { }
+        bool PushBack(Task& task);
+        bool PopFront(Task& task);
+
+        Task       m_tasks[DEQUE_CAPACITY];
+        uint32_t   m_first;
+        uint32_t   m_size;
+        std::mutex m_mutex;
+    };
+
+    struct Worker {
+        Deque deques[PRIORITY_COUNT];
+    };
+
+    bool Push(Task& task, Priority priority);
+    bool Pop(uint32_t workerIndex, Task& task);
+    void StartWorkers(size_t threads);
+    void WorkerThread(uint32_t workerIndex);
 
 private:
-    std::vector< std::thread > workers;
-    std::queue< std::function<void()> > tasks;
+    std::vector<Worker*>     m_workers;
+    std::vector<std::thread> m_threads;
+    std::vector<uint32_t>    m_cpus;        // of the pinned workers
+    std::atomic<uint32_t>    m_nextWorker;  // of the tasks submitted from outside of the pool
+    std::atomic<int32_t>     m_numPending;  // tasks in the deques, briefly negative while one is being pushed
+    std::atomic<uint32_t>    m_numSleeping; // workers blocked on m_taskCondition
+    bool                     m_stop;
+    std::mutex               m_mutex;
+    std::condition_variable  m_taskCondition;
+};
 
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
+template<class Callable>
+const VkThreadPool::Task::TaskOps VkThreadPool::Task::Ops<Callable>::ops = {
+    &VkThreadPool::Task::Ops<Callable>::Invoke,
+    &VkThreadPool::Task::Ops<Callable>::Move,
+    &VkThreadPool::Task::Ops<Callable>::Destroy
 };
 
 #endif /* _VKCODECUTILS_VKTHREADPOOL_H_ */
@@ -41,7 +41,10 @@ public:
         }
 
         // Wait for the consumer to consume the previous node item(s)
-        m_condProducer.wait(lock, [this]{ return (!m_queueIsFlushing && (m_queue.size() < m_maxPendingQueueNodes)); });
+        m_condProducer.wait(lock, [this]{ return (m_queueIsFlushing || (m_queue.size() < m_maxPendingQueueNodes)); });
+        if (m_queueIsFlushing) {
+            return false;
+        }
 
         m_queue.push(std::move(node));
         m_condConsumer.notify_one();
@@ -51,7 +54,13 @@ public:
 
     bool TryPop(QueueNodeType& node) {
         std::unique_lock<std::mutex> lock(m_mutex);
-        return TryPopNoLock(node);
+        if (!TryPopNoLock(node)) {
+            return false;
+        }
+        // Notify the producer
+        m_condProducer.notify_one();
+
+        return true;
     }
 
     bool WaitAndPop(QueueNodeType& node) {
@@ -61,9 +70,11 @@ public:
             return TryPopNoLock(node);
         }
 
-        m_condConsumer.wait(lock, [this]{ return ((m_queueIsFlushing == false) && !m_queue.empty()); });
-        node = std::move(m_queue.front());
-        m_queue.pop();
+        // Also woken up by the flush, to drain what is left without waiting
+        m_condConsumer.wait(lock, [this]{ return (m_queueIsFlushing || !m_queue.empty()); });
+        if (!TryPopNoLock(node)) {
+            return false;
+        }
         // Notify the producer
         m_condProducer.notify_one();
 
@@ -75,7 +86,7 @@ public:
         return m_queue.empty();
     }
 
-    bool Size() const {
+    size_t Size() const {
         std::lock_guard<std::mutex> lock(m_mutex);
         return m_queue.size();
     }
@@ -86,8 +97,8 @@ public:
 
         m_queueIsFlushing = true;
 
-        m_condProducer.notify_one();
-        m_condConsumer.notify_one();
+        m_condProducer.notify_all();
+        m_condConsumer.notify_all();
     }
 
     bool ExitQueue() {
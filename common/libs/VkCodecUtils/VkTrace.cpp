@@ -0,0 +1,217 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+#include "VkCodecUtils/VkTrace.h"
+
+namespace {
+
+struct TraceZone {
+    const char* name;
+    uint64_t    beginNs;
+    uint64_t    endNs;
+    uint64_t    frameId;
+};
+
+// The ring buffer of a thread or of a device track. Only its thread writes the zones of a thread, the zones of
+// a track are written under the registry lock.
+struct TraceBuffer {
+    TraceBuffer(uint32_t id, size_t size) : tid(id), name(), zones(size), numZones(0) { }
+
+    const uint32_t         tid;
+    std::string            name;
+    std::vector<TraceZone> zones;
+    std::atomic<uint64_t>  numZones;
+};
+
+struct TraceRegistry {
+    TraceRegistry() : mutex(), buffers(), tracks(), bufferSize(0), startNs(0) { }
+
+    std::mutex                                mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<std::unique_ptr<TraceBuffer>> tracks;
+    size_t                                    bufferSize;
+    uint64_t                                  startNs;
+};
+
+TraceRegistry& GetRegistry()
+{
+    static TraceRegistry registry;
+    return registry;
+}
+
+// The buffers outlive their threads, for the zones of the threads that have exited to be flushed too
+thread_local TraceBuffer* t_traceBuffer = nullptr;
+
+TraceBuffer* CreateBuffer(TraceRegistry& registry, std::vector<std::unique_ptr<TraceBuffer>>& buffers)
+{
+    const uint32_t tid = (uint32_t)(registry.buffers.size() + registry.tracks.size() + 1);
+    buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(tid, registry.bufferSize)));
+    return buffers.back().get();
+}
+
+TraceBuffer* GetThreadBuffer()
+{
+    if (t_traceBuffer == nullptr) {
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        t_traceBuffer = CreateBuffer(registry, registry.buffers);
+    }
+    return t_traceBuffer;
+}
+
+void AddZoneToBuffer(TraceBuffer* buffer, const char* name, uint64_t beginNs, uint64_t endNs, uint64_t frameId)
+{
+    if (buffer->zones.empty()) {
+        return;
+    }
+    const uint64_t numZones = buffer->numZones.load(std::memory_order_relaxed);
+    TraceZone& zone = buffer->zones[numZones % buffer->zones.size()];
+    zone.name = name;
+    zone.beginNs = beginNs;
+    zone.endNs = endNs;
+    zone.frameId = frameId;
+    buffer->numZones.store(numZones + 1, std::memory_order_release);
+}
+
+void WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* p = str; *p != '\0'; p++) {
+        if ((*p == '"') || (*p == '\\')) {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*p >= ' ') {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+size_t WriteBuffer(FILE* file, const TraceBuffer& buffer, uint64_t startNs, bool& first)
+{
+    if (!buffer.name.empty()) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", buffer.tid);
+        WriteJsonString(file, buffer.name.c_str());
+        fprintf(file, "}}");
+        first = false;
+    }
+
+    const uint64_t numZones = buffer.numZones.load(std::memory_order_acquire);
+    const uint64_t firstZone = (numZones > buffer.zones.size()) ? (numZones - buffer.zones.size()) : 0;
+    for (uint64_t i = firstZone; i < numZones; i++) {
+        const TraceZone& zone = buffer.zones[i % buffer.zones.size()];
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        WriteJsonString(file, zone.name);
+        // In microseconds, from the time the trace was enabled
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", buffer.tid,
+                (double)(int64_t)(zone.beginNs - startNs) / 1000.0,
+                (double)(int64_t)(zone.endNs - zone.beginNs) / 1000.0);
+        if (zone.frameId != VkTrace::noFrameId) {
+            fprintf(file, ",\"args\":{\"frame\":%llu}", (unsigned long long)zone.frameId);
+        }
+        fprintf(file, "}");
+        first = false;
+    }
+    return (size_t)(numZones - firstZone);
+}
+
+} // namespace
+
+std::atomic<bool> VkTrace::s_enabled(false);
+
+void VkTrace::Enable(size_t eventsPerThread)
+{
+    TraceRegistry& registry = GetRegistry();
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (registry.startNs == 0) {
+            registry.startNs = NowNs();
+        }
+        // The buffers created already keep their size
+        registry.bufferSize = eventsPerThread;
+    }
+    s_enabled.store(eventsPerThread > 0, std::memory_order_release);
+}
+
+void VkTrace::SetThreadName(const char* threadName)
+{
+    if (!IsEnabled() || (threadName == nullptr)) {
+        return;
+    }
+    TraceBuffer* buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    buffer->name = threadName;
+}
+
+void VkTrace::AddZone(const char* name, uint64_t beginNs, uint64_t endNs, uint64_t frameId)
+{
+    AddZoneToBuffer(GetThreadBuffer(), name, beginNs, endNs, frameId);
+}
+
+uint32_t VkTrace::AddTrack(const char* trackName)
+{
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    TraceBuffer* track = CreateBuffer(registry, registry.tracks);
+    track->name = (trackName != nullptr) ? trackName : "device";
+    return (uint32_t)(registry.tracks.size() - 1);
+}
+
+void VkTrace::AddTrackZone(uint32_t trackId, uint64_t beginNs, uint64_t endNs, uint64_t frameId)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (trackId < registry.tracks.size()) {
+        TraceBuffer* track = registry.tracks[trackId].get();
+        AddZoneToBuffer(track, track->name.c_str(), beginNs, endNs, frameId);
+    }
+}
+
+bool VkTrace::Flush(const char* fileName)
+{
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    FILE* file = fopen(fileName, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "\nERROR: Can't open the trace file %s\n", fileName);
+        return false;
+    }
+
+    bool first = true;
+    size_t numZones = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < registry.buffers.size(); i++) {
+        numZones += WriteBuffer(file, *registry.buffers[i], registry.startNs, first);
+    }
+    for (size_t i = 0; i < registry.tracks.size(); i++) {
+        numZones += WriteBuffer(file, *registry.tracks[i], registry.startNs, first);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Wrote %zu trace zones of %zu threads and %zu device tracks to %s\n", numZones,
+           registry.buffers.size(), registry.tracks.size(), fileName);
+    return true;
+}
@@ -0,0 +1,127 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKTRACE_H_
+#define _VKCODECUTILS_VKTRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// A timeline of the host work of the decode and encode pipelines, written in the Chrome trace JSON format that
+// chrome://tracing and the Perfetto UI open. Every thread records its zones into its own ring buffer, without locks,
+// the oldest zones being overwritten once it's full. The device work goes to named tracks on the same timeline.
+// While disabled, which is the default, a zone costs a relaxed atomic load.
+class VkTrace
+{
+public:
+    static const uint64_t noFrameId = ~0ULL;
+
+    // The zones are recorded from now on, up to eventsPerThread of the last ones per thread are kept
+    static void Enable(size_t eventsPerThread = 1 << 16);
+
+    static bool IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // The host time base of the trace, the steady clock
+    static uint64_t NowNs()
+    {
+        return ToNs(std::chrono::steady_clock::now());
+    }
+
+    static uint64_t ToNs(const std::chrono::steady_clock::time_point& timePoint)
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count();
+    }
+
+    // The name of the calling thread in the trace, the string is copied
+    static void SetThreadName(const char* threadName);
+
+    // Records a zone of the calling thread, the name must be a string literal
+    static void AddZone(const char* name, uint64_t beginNs, uint64_t endNs, uint64_t frameId = noFrameId);
+
+    // A track of the device work, e.g. of a queue, returns its id. The zones of a track are named after it.
+    static uint32_t AddTrack(const char* trackName);
+    static void AddTrackZone(uint32_t trackId, uint64_t beginNs, uint64_t endNs, uint64_t frameId = noFrameId);
+
+    // Writes the zones recorded so far, the threads must not be recording anymore
+    static bool Flush(const char* fileName);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Records the scope it lives in as a zone of the calling thread
+class VkTraceZone
+{
+public:
+    explicit VkTraceZone(const char* name, uint64_t frameId = VkTrace::noFrameId)
+        : m_name(VkTrace::IsEnabled() ? name : nullptr)
+        , m_frameId(frameId)
+        , m_beginNs((m_name != nullptr) ? VkTrace::NowNs() : 0)
+    {
+    }
+
+    ~VkTraceZone()
+    {
+        if (m_name != nullptr) {
+            VkTrace::AddZone(m_name, m_beginNs, VkTrace::NowNs(), m_frameId);
+        }
+    }
+
+private:
+    VkTraceZone(const VkTraceZone&);
+    VkTraceZone& operator=(const VkTraceZone&);
+
+    const char* const m_name;
+    const uint64_t    m_frameId;
+    const uint64_t    m_beginNs;
+};
+
+// Enables the trace for the lifetime of the object if a file name is given, writing the file on destruction.
+// Meant to be declared first in main(), once the arguments are parsed.
+class VkTraceSession
+{
+public:
+    explicit VkTraceSession(const char* fileName)
+        : m_fileName((fileName != nullptr) ? fileName : "")
+    {
+        if (!m_fileName.empty()) {
+            VkTrace::Enable();
+        }
+    }
+
+    ~VkTraceSession()
+    {
+        if (!m_fileName.empty()) {
+            VkTrace::Flush(m_fileName.c_str());
+        }
+    }
+
+private:
+    std::string m_fileName;
+};
+
+#define VK_TRACE_CONCAT_INNER(a, b) a ## b
+#define VK_TRACE_CONCAT(a, b) VK_TRACE_CONCAT_INNER(a, b)
+#define VK_TRACE_ZONE(name) VkTraceZone VK_TRACE_CONCAT(vkTraceZone, __LINE__)(name)
+#define VK_TRACE_ZONE_FRAME(name, frameId) VkTraceZone VK_TRACE_CONCAT(vkTraceZone, __LINE__)(name, (uint64_t)(frameId))
+
+#endif /* _VKCODECUTILS_VKTRACE_H_ */
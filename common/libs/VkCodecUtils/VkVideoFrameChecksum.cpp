@@ -0,0 +1,340 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "VkCodecUtils/VkVideoFrameChecksum.h"
+
+// The CRC32 tables of the reflected 0xEDB88320 polynomial, for 8 bytes at a time (slicing-by-8)
+struct Crc32Tables {
+    uint32_t table[8][256];
+
+    Crc32Tables()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (uint32_t bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (uint32_t slice = 1; slice < 8; slice++) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static const Crc32Tables crc32Tables;
+
+VkVideoFrameChecksum::VkVideoFrameChecksum()
+    : m_algorithm(ALGORITHM_NONE)
+    , m_streamMd5()
+    , m_streamCrc(0)
+    , m_numFrames(0)
+    , m_numMismatches(0)
+    , m_hasReference(false)
+    , m_referenceFrameDigests()
+    , m_referenceStreamDigest()
+{
+}
+
+bool VkVideoFrameChecksum::Configure(Algorithm algorithm, const char* referenceFileName)
+{
+    m_algorithm = algorithm;
+    Md5Init(m_streamMd5);
+    m_streamCrc = 0;
+    m_numFrames = 0;
+    m_numMismatches = 0;
+    m_hasReference = false;
+    m_referenceFrameDigests.clear();
+    m_referenceStreamDigest.clear();
+
+    if ((algorithm == ALGORITHM_NONE) || (referenceFileName == nullptr) || (referenceFileName[0] == '\0')) {
+        return true;
+    }
+
+    std::ifstream referenceFile(referenceFileName);
+    if (!referenceFile) {
+        fprintf(stderr, "\nERROR: Can't open the checksum reference file %s\n", referenceFileName);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(referenceFile, line)) {
+        std::istringstream lineStream(line);
+        std::string token;
+        if (!(lineStream >> token) || (token[0] == '#')) {
+            continue;
+        }
+        if (token == "stream") {
+            lineStream >> m_referenceStreamDigest;
+        } else {
+            m_referenceFrameDigests.push_back(token);
+        }
+    }
+    m_hasReference = true;
+    return true;
+}
+
+void VkVideoFrameChecksum::AddFrame(const uint8_t* pData, size_t size, FILE* pOutFile)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+
+    const std::string digest = ComputeDigest(pData, size);
+    if (pOutFile != nullptr) {
+        fprintf(pOutFile, "%s\n", digest.c_str());
+    }
+
+    if (m_hasReference) {
+        static const std::string noReference("(none)");
+        const std::string& referenceDigest = (m_numFrames < m_referenceFrameDigests.size()) ?
+                                                 m_referenceFrameDigests[m_numFrames] : noReference;
+        char what[32];
+        snprintf(what, sizeof(what), "frame %u", m_numFrames);
+        Compare(digest, referenceDigest, what);
+    }
+    m_numFrames++;
+}
+
+uint32_t VkVideoFrameChecksum::Finish(FILE* pOutFile)
+{
+    if (!IsEnabled()) {
+        return 0;
+    }
+
+    std::string streamDigest;
+    if (m_algorithm == ALGORITHM_MD5) {
+        uint8_t digest[16];
+        Md5Final(m_streamMd5, digest);
+        streamDigest = ToHex(digest, sizeof(digest));
+    } else {
+        char digest[16];
+        snprintf(digest, sizeof(digest), "%08x", m_streamCrc);
+        streamDigest = digest;
+    }
+
+    if (pOutFile != nullptr) {
+        fprintf(pOutFile, "stream %s\n", streamDigest.c_str());
+        fflush(pOutFile);
+    }
+    std::cout << "Checksum of " << m_numFrames << " frames, stream " << streamDigest << std::endl;
+
+    if (m_hasReference) {
+        if (m_numFrames < m_referenceFrameDigests.size()) {
+            fprintf(stderr, "Checksum mismatch: %u frames decoded, %u in the reference\n",
+                    m_numFrames, (uint32_t)m_referenceFrameDigests.size());
+            m_numMismatches++;
+        }
+        if (!m_referenceStreamDigest.empty()) {
+            Compare(streamDigest, m_referenceStreamDigest, "stream");
+        }
+        std::cout << "Checksum comparison " << ((m_numMismatches == 0) ? "PASSED" : "FAILED")
+                  << ", " << m_numMismatches << " mismatches" << std::endl;
+    }
+
+    // The stream digest is final, the frames after it are not hashed
+    m_algorithm = ALGORITHM_NONE;
+    return m_numMismatches;
+}
+
+void VkVideoFrameChecksum::Compare(const std::string& digest, const std::string& referenceDigest, const char* what)
+{
+    const bool match = (digest.size() == referenceDigest.size()) &&
+        std::equal(digest.begin(), digest.end(), referenceDigest.begin(),
+                   [](char a, char b) { return (tolower((unsigned char)a) == tolower((unsigned char)b)); });
+    if (match) {
+        return;
+    }
+
+    // Only the first mismatches are reported, the count is in the summary
+    if (m_numMismatches < 16) {
+        fprintf(stderr, "Checksum mismatch of the %s: %s, expected %s\n", what, digest.c_str(), referenceDigest.c_str());
+    }
+    m_numMismatches++;
+}
+
+std::string VkVideoFrameChecksum::ComputeDigest(const uint8_t* pData, size_t size)
+{
+    if (m_algorithm == ALGORITHM_MD5) {
+        Md5Context context;
+        uint8_t digest[16];
+        Md5Init(context);
+        Md5Update(context, pData, size);
+        Md5Final(context, digest);
+        Md5Update(m_streamMd5, digest, sizeof(digest));
+        return ToHex(digest, sizeof(digest));
+    }
+
+    const uint32_t crc = Crc32Update(0, pData, size);
+    const uint8_t crcBytes[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+    m_streamCrc = Crc32Update(m_streamCrc, crcBytes, sizeof(crcBytes));
+    return ToHex(crcBytes, sizeof(crcBytes));
+}
+
+std::string VkVideoFrameChecksum::ToHex(const uint8_t* pDigest, size_t size)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; i++) {
+        hex[2 * i]     = hexDigits[pDigest[i] >> 4];
+        hex[2 * i + 1] = hexDigits[pDigest[i] & 0xF];
+    }
+    return hex;
+}
+
+uint32_t VkVideoFrameChecksum::Crc32Update(uint32_t crc, const uint8_t* pData, size_t size)
+{
+    const uint32_t (*table)[256] = crc32Tables.table;
+    crc = ~crc;
+
+    // 8 bytes per iteration, independent table lookups instead of a dependency chain per byte
+    while (size >= 8) {
+        uint32_t low, high;
+        memcpy(&low, pData, sizeof(low));
+        memcpy(&high, pData + 4, sizeof(high));
+        low ^= crc; // little endian byte order
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        pData += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *pData++) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+void VkVideoFrameChecksum::Md5Init(Md5Context& context)
+{
+    context.state[0] = 0x67452301;
+    context.state[1] = 0xefcdab89;
+    context.state[2] = 0x98badcfe;
+    context.state[3] = 0x10325476;
+    context.numBytes = 0;
+}
+
+void VkVideoFrameChecksum::Md5Update(Md5Context& context, const uint8_t* pData, size_t size)
+{
+    size_t blockOffset = (size_t)(context.numBytes & 63);
+    context.numBytes += size;
+
+    if (blockOffset != 0) {
+        const size_t count = std::min<size_t>(64 - blockOffset, size);
+        memcpy(context.block + blockOffset, pData, count);
+        pData += count;
+        size -= count;
+        blockOffset += count;
+        if (blockOffset < 64) {
+            return;
+        }
+        Md5Transform(context.state, context.block);
+    }
+
+    // The whole blocks are hashed in place
+    while (size >= 64) {
+        Md5Transform(context.state, pData);
+        pData += 64;
+        size -= 64;
+    }
+
+    memcpy(context.block, pData, size);
+}
+
+void VkVideoFrameChecksum::Md5Final(Md5Context& context, uint8_t digest[16])
+{
+    const uint64_t numBits = context.numBytes * 8;
+    static const uint8_t padding[64] = { 0x80 };
+    const size_t blockOffset = (size_t)(context.numBytes & 63);
+    Md5Update(context, padding, (blockOffset < 56) ? (56 - blockOffset) : (120 - blockOffset));
+
+    uint8_t length[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        length[i] = (uint8_t)(numBits >> (8 * i));
+    }
+    Md5Update(context, length, sizeof(length));
+
+    for (uint32_t i = 0; i < 16; i++) {
+        digest[i] = (uint8_t)(context.state[i / 4] >> (8 * (i % 4)));
+    }
+}
+
+void VkVideoFrameChecksum::Md5Transform(uint32_t state[4], const uint8_t block[64])
+{
+    static const uint32_t sines[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+    };
+    static const uint32_t shifts[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+    uint32_t words[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        words[i] = (uint32_t)block[4 * i] | ((uint32_t)block[4 * i + 1] << 8) |
+                   ((uint32_t)block[4 * i + 2] << 16) | ((uint32_t)block[4 * i + 3] << 24);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (uint32_t i = 0; i < 64; i++) {
+        const uint32_t round = i / 16;
+        uint32_t f, word;
+        switch (round) {
+        case 0:
+            f = (b & c) | (~b & d);
+            word = i;
+            break;
+        case 1:
+            f = (d & b) | (~d & c);
+            word = (5 * i + 1) % 16;
+            break;
+        case 2:
+            f = b ^ c ^ d;
+            word = (3 * i + 5) % 16;
+            break;
+        default:
+            f = c ^ (b | ~d);
+            word = (7 * i) % 16;
+            break;
+        }
+        const uint32_t shift = shifts[round][i % 4];
+        const uint32_t sum = a + f + sines[i] + words[word];
+        a = d;
+        d = c;
+        c = b;
+        b = b + ((sum << shift) | (sum >> (32 - shift)));
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
@@ -0,0 +1,87 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKVIDEOFRAMECHECKSUM_H_
+#define _VKCODECUTILS_VKVIDEOFRAMECHECKSUM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Computes the MD5 or CRC32 digest of each output frame, and of the stream as the digest of the frame digests.
+// The digests are compared against a reference list, one line per frame in output order with the hex digest
+// as its first token, and an optional "stream <digest>" line. The empty lines and the ones starting with '#'
+// are skipped, so the list written by a previous run can be used as the reference.
+class VkVideoFrameChecksum {
+
+public:
+    enum Algorithm { ALGORITHM_NONE = 0, ALGORITHM_MD5 = 1, ALGORITHM_CRC32 = 2 };
+
+    VkVideoFrameChecksum();
+
+    // Returns false if the reference list can't be read.
+    bool Configure(Algorithm algorithm, const char* referenceFileName);
+
+    bool IsEnabled() const
+    {
+        return (m_algorithm != ALGORITHM_NONE);
+    }
+
+    // Hashes a frame and compares its digest with the reference. The digest line is written to pOutFile if set.
+    void AddFrame(const uint8_t* pData, size_t size, FILE* pOutFile);
+
+    // Prints the stream digest and the result of the comparison. Returns the number of mismatched digests.
+    uint32_t Finish(FILE* pOutFile);
+
+    uint32_t GetNumMismatches() const
+    {
+        return m_numMismatches;
+    }
+
+private:
+    struct Md5Context {
+        uint32_t state[4];
+        uint64_t numBytes;
+        uint8_t  block[64];
+    };
+
+    static void Md5Init(Md5Context& context);
+    static void Md5Update(Md5Context& context, const uint8_t* pData, size_t size);
+    static void Md5Final(Md5Context& context, uint8_t digest[16]);
+    static void Md5Transform(uint32_t state[4], const uint8_t block[64]);
+
+    static uint32_t Crc32Update(uint32_t crc, const uint8_t* pData, size_t size);
+
+    static std::string ToHex(const uint8_t* pDigest, size_t size);
+
+    // The digest of the data, in hex, also added to the stream digest
+    std::string ComputeDigest(const uint8_t* pData, size_t size);
+
+    void Compare(const std::string& digest, const std::string& referenceDigest, const char* what);
+
+private:
+    Algorithm                m_algorithm;
+    Md5Context               m_streamMd5;
+    uint32_t                 m_streamCrc;
+    uint32_t                 m_numFrames;
+    uint32_t                 m_numMismatches;
+    bool                     m_hasReference;
+    std::vector<std::string> m_referenceFrameDigests;
+    std::string              m_referenceStreamDigest;
+};
+
+#endif /* _VKCODECUTILS_VKVIDEOFRAMECHECKSUM_H_ */
@@ -17,20 +17,66 @@
 #ifndef _VKCODECUTILS_VKVIDEOFRAMETOFILE_H_
 #define _VKCODECUTILS_VKVIDEOFRAMETOFILE_H_
 
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "VkCodecUtils/VkThreadAffinity.h"
+#include "VkCodecUtils/VkVideoFrameChecksum.h"
+
+// Writes the decoded frames to the output file. With the writer thread, the frames go through a ring of
+// buffers: the decode thread acquires a buffer, fills it or starts its copy-out, and queues it. The writer
+// thread waits for the data of each queued frame and writes the frames in the queue order.
+// AcquireBuffer() and QueueWrite() must be called from one thread.
 class VkVideoFrameToFile {
 
 public:
+    enum { MAX_WRITE_BUFFERS = 8, DEFAULT_WRITE_BUFFERS = 2 };
+
+    // The layout of the frames in the output file. The samples over 8 bits take 16 bits.
+    enum OutputFormat {
+        OUTPUT_FORMAT_PLANAR      = 0, // I420 / I010, the Y, Cb and Cr planes one after the other
+        OUTPUT_FORMAT_SEMI_PLANAR = 1, // NV12 / P010, the decoded Y and CbCr planes as they are
+        OUTPUT_FORMAT_Y4M         = 2, // planar, with the YUV4MPEG2 stream and frame headers
+    };
+
+    // Called on the writer thread before the frame is written, i.e. to wait for the copy-out to the buffer.
+    // Returns the frame data, or nullptr to drop the frame.
+    typedef std::function<const uint8_t*()> GetFrameDataFunc;
 
     VkVideoFrameToFile()
         : m_outputFile(),
           m_pLinearMemory()
-        , m_allocationSize() {}
+        , m_allocationSize()
+        , m_outputFormat(OUTPUT_FORMAT_PLANAR)
+        , m_y4mStreamHeader()
+        , m_y4mHeaderWritten(false)
+        , m_y4mSampleShift(0)
+        , m_checksum()
+        , m_numBuffers(1)
+        , m_nextBuffer(0)
+        , m_mutex()
+        , m_condWriter()
+        , m_condProducer()
+        , m_pendingWrites()
+        , m_bufferInUse()
+        , m_exit(false)
+        , m_thread() {}
 
     ~VkVideoFrameToFile()
     {
-        if (m_pLinearMemory) {
-            delete[] m_pLinearMemory;
-            m_pLinearMemory = nullptr;
+        StopWriterThread();
+
+        for (uint32_t i = 0; i < MAX_WRITE_BUFFERS; i++) {
+            if (m_pLinearMemory[i]) {
+                delete[] m_pLinearMemory[i];
+                m_pLinearMemory[i] = nullptr;
+            }
         }
 
         if (m_outputFile) {
@@ -40,43 +86,51 @@ public:
     }
 
     uint8_t* EnsureAllocation(const VulkanDeviceContext* vkDevCtx,
-                              VkSharedBaseObj<VkImageResource>& imageResource) {
+                              VkSharedBaseObj<VkImageResource>& imageResource,
+                              uint32_t bufferIndex = 0) {
 
-        if (m_outputFile == nullptr) {
+        if (!IsFileStreamValid() || (bufferIndex >= m_numBuffers)) {
             return nullptr;
         }
 
         VkDeviceSize imageMemorySize = imageResource->GetImageDeviceMemorySize();
 
-        if ((m_pLinearMemory == nullptr) || (imageMemorySize > m_allocationSize)) {
+        if ((m_pLinearMemory[bufferIndex] == nullptr) || (imageMemorySize > m_allocationSize[bufferIndex])) {
 
-            if (m_outputFile) {
+            if (m_outputFile && !m_thread.joinable()) {
                 fflush(m_outputFile);
             }
 
-            if (m_pLinearMemory != nullptr) {
-                delete[] m_pLinearMemory;
-                m_pLinearMemory = nullptr;
+            if (m_pLinearMemory[bufferIndex] != nullptr) {
+                delete[] m_pLinearMemory[bufferIndex];
+                m_pLinearMemory[bufferIndex] = nullptr;
             }
 
             // Allocate the memory that will be dumped to file directly.
-            m_allocationSize = (size_t)(imageMemorySize);
-            m_pLinearMemory = new uint8_t[m_allocationSize];
-            if (m_pLinearMemory == nullptr) {
+            m_allocationSize[bufferIndex] = (size_t)(imageMemorySize);
+            m_pLinearMemory[bufferIndex] = new uint8_t[m_allocationSize[bufferIndex]];
+            if (m_pLinearMemory[bufferIndex] == nullptr) {
                 return nullptr;
             }
-            assert(m_pLinearMemory != nullptr);
+            assert(m_pLinearMemory[bufferIndex] != nullptr);
         }
-        return m_pLinearMemory;
+        return m_pLinearMemory[bufferIndex];
     }
 
-    FILE* AttachFile(const char* fileName) {
+    FILE* AttachFile(const char* fileName, OutputFormat outputFormat = OUTPUT_FORMAT_PLANAR) {
+
+        StopWriterThread();
 
         if (m_outputFile) {
             fclose(m_outputFile);
             m_outputFile = nullptr;
         }
 
+        m_outputFormat = outputFormat;
+        m_y4mStreamHeader[0] = '\0';
+        m_y4mHeaderWritten = false;
+        m_y4mSampleShift = 0;
+
         if (fileName != nullptr) {
             m_outputFile = fopen(fileName, "wb");
             if (m_outputFile) {
@@ -87,28 +141,243 @@ public:
         return nullptr;
     }
 
+    // With the checksums, the frames are hashed instead of written, and the output file is optional.
     bool IsFileStreamValid() const
     {
-        return m_outputFile != nullptr;
+        return (m_outputFile != nullptr) || m_checksum.IsEnabled();
+    }
+
+    // To be called after AttachFile(), the output file gets the digests instead of the frames.
+    bool EnableChecksum(VkVideoFrameChecksum::Algorithm algorithm, const char* referenceFileName)
+    {
+        return m_checksum.Configure(algorithm, referenceFileName);
+    }
+
+    // Writes out the queued frames, and reports the stream checksum. Returns the number of mismatches.
+    uint32_t FinishChecksum()
+    {
+        StopWriterThread();
+        return m_checksum.Finish(m_outputFile);
     }
 
     operator bool() const {
         return IsFileStreamValid();
     }
 
-    size_t WriteDataToFile(size_t offset, size_t size)
+    OutputFormat GetOutputFormat() const
+    {
+        return m_outputFormat;
+    }
+
+    // Sets the Y4M stream header, written before the first frame. To be called before the first frame is
+    // written or queued. A Y4M stream can't change its format, returns false if the header differs from the
+    // one already set. The samples over 8 bits are written LSB aligned, as Y4M expects them.
+    bool SetY4mStreamHeader(uint32_t width, uint32_t height,
+                            uint32_t frameRateNumerator, uint32_t frameRateDenominator,
+                            const char* colorSpace, uint32_t bitDepth)
+    {
+        char streamHeader[sizeof(m_y4mStreamHeader)];
+        snprintf(streamHeader, sizeof(streamHeader), "YUV4MPEG2 W%u H%u F%u:%u Ip A0:0 C%s\n",
+                 width, height, frameRateNumerator, frameRateDenominator, colorSpace);
+        if (m_y4mStreamHeader[0] != '\0') {
+            return (strcmp(m_y4mStreamHeader, streamHeader) == 0);
+        }
+
+        memcpy(m_y4mStreamHeader, streamHeader, sizeof(m_y4mStreamHeader));
+        m_y4mSampleShift = (bitDepth > 8) ? (16 - bitDepth) : 0;
+        return true;
+    }
+
+    bool HasY4mStreamHeader() const
+    {
+        return (m_y4mStreamHeader[0] != '\0');
+    }
+
+    size_t WriteDataToFile(size_t offset, size_t size, uint32_t bufferIndex = 0)
+    {
+        return WriteFrame(m_pLinearMemory[bufferIndex] + offset, size);
+    }
+
+    // Writes the frame data from memory that is not owned, i.e. a mapped readback buffer.
+    size_t WriteBufferToFile(const uint8_t* pData, size_t size)
+    {
+        return WriteFrame(pData, size);
+    }
+
+    size_t GetMaxFrameSize(uint32_t bufferIndex = 0) {
+        return m_allocationSize[bufferIndex];
+    }
+
+    // Starts the writer thread with a ring of numBuffers buffers, to be called after AttachFile().
+    // The thread runs on the CPUs of the list, if any.
+    bool StartWriterThread(uint32_t numBuffers = DEFAULT_WRITE_BUFFERS,
+                           const std::vector<uint32_t>& cpus = std::vector<uint32_t>())
+    {
+        if (!IsFileStreamValid() || m_thread.joinable() || (numBuffers == 0) || (numBuffers > MAX_WRITE_BUFFERS)) {
+            return false;
+        }
+
+        m_numBuffers = numBuffers;
+        m_nextBuffer = 0;
+        m_exit = false;
+        m_thread = std::thread(&VkVideoFrameToFile::WriterThread, this);
+        VkSetThreadAffinity(m_thread, cpus);
+        return true;
+    }
+
+    // Writes out the queued frames before the thread exits.
+    void StopWriterThread()
+    {
+        if (!m_thread.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_exit = true;
+        }
+        m_condWriter.notify_one();
+        m_thread.join();
+        m_numBuffers = 1;
+        if (m_outputFile) {
+            fflush(m_outputFile);
+        }
+    }
+
+    bool IsWriterThreadRunning() const
+    {
+        return m_thread.joinable();
+    }
+
+    uint32_t GetNumBuffers() const
+    {
+        return m_numBuffers;
+    }
+
+    // The frames queued to the writer thread and not written yet
+    uint32_t GetNumBuffersInUse()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t numBuffersInUse = 0;
+        for (uint32_t i = 0; i < m_numBuffers; i++) {
+            numBuffersInUse += m_bufferInUse[i] ? 1 : 0;
+        }
+        return numBuffersInUse;
+    }
+
+    // Returns the next buffer of the ring, once the writer thread is done with its previous frame.
+    uint32_t AcquireBuffer()
+    {
+        const uint32_t bufferIndex = m_nextBuffer;
+        m_nextBuffer = (m_nextBuffer + 1) % m_numBuffers;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condProducer.wait(lock, [this, bufferIndex]{ return !m_bufferInUse[bufferIndex]; });
+        return bufferIndex;
+    }
+
+    // Queues size bytes of the frame of the acquired buffer, from the data returned by getFrameData.
+    void QueueWrite(uint32_t bufferIndex, size_t size, const GetFrameDataFunc& getFrameData)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bufferInUse[bufferIndex] = true;
+            m_pendingWrites.push_back(PendingWrite{ bufferIndex, size, getFrameData });
+        }
+        m_condWriter.notify_one();
+    }
+
+private:
+    struct PendingWrite {
+        uint32_t         bufferIndex;
+        size_t           size;
+        GetFrameDataFunc getFrameData;
+    };
+
+    void WriterThread()
     {
-        return fwrite(m_pLinearMemory + offset, size, 1, m_outputFile);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_condWriter.wait(lock, [this]{ return (m_exit || !m_pendingWrites.empty()); });
+            if (m_pendingWrites.empty()) {
+                // m_exit, all the frames are written
+                return;
+            }
+
+            PendingWrite pendingWrite(std::move(m_pendingWrites.front()));
+            m_pendingWrites.pop_front();
+            lock.unlock();
+
+            const uint8_t* pData = pendingWrite.getFrameData();
+            if ((pData != nullptr) && (WriteFrame(pData, pendingWrite.size) != 1)) {
+                fprintf(stderr, "\nERROR: Failed to write %zu bytes of the output frame\n", pendingWrite.size);
+            }
+            // Releases what the function holds before the buffer is reused
+            pendingWrite.getFrameData = nullptr;
+
+            lock.lock();
+            m_bufferInUse[pendingWrite.bufferIndex] = false;
+            m_condProducer.notify_one();
+        }
     }
 
-    size_t GetMaxFrameSize() {
-        return m_allocationSize;
+    // Writes a frame with the headers of its output format, returns 1 once all of it is written.
+    size_t WriteFrame(const uint8_t* pData, size_t size)
+    {
+        if (m_checksum.IsEnabled()) {
+            m_checksum.AddFrame(pData, size, m_outputFile);
+            return 1;
+        }
+
+        if (m_outputFormat != OUTPUT_FORMAT_Y4M) {
+            return fwrite(pData, size, 1, m_outputFile);
+        }
+
+        if (!m_y4mHeaderWritten) {
+            fputs(m_y4mStreamHeader, m_outputFile);
+            m_y4mHeaderWritten = true;
+        }
+        fputs("FRAME\n", m_outputFile);
+
+        if (m_y4mSampleShift == 0) {
+            return fwrite(pData, size, 1, m_outputFile);
+        }
+
+        // The decoded samples are MSB aligned, shifted down through a small staging buffer.
+        uint16_t samples[4096];
+        const size_t numSamples = size / sizeof(uint16_t);
+        for (size_t sample = 0; sample < numSamples; ) {
+            const size_t count = std::min<size_t>(numSamples - sample, sizeof(samples) / sizeof(samples[0]));
+            memcpy(samples, pData + (sample * sizeof(uint16_t)), count * sizeof(uint16_t));
+            for (size_t i = 0; i < count; i++) {
+                samples[i] >>= m_y4mSampleShift;
+            }
+            if (fwrite(samples, count * sizeof(uint16_t), 1, m_outputFile) != 1) {
+                return 0;
+            }
+            sample += count;
+        }
+        return 1;
     }
 
 private:
-    FILE*    m_outputFile;
-    uint8_t* m_pLinearMemory;
-    size_t   m_allocationSize;
+    FILE*                    m_outputFile;
+    uint8_t*                 m_pLinearMemory[MAX_WRITE_BUFFERS];
+    size_t                   m_allocationSize[MAX_WRITE_BUFFERS];
+    OutputFormat             m_outputFormat;
+    char                     m_y4mStreamHeader[128];
+    bool                     m_y4mHeaderWritten;
+    uint32_t                 m_y4mSampleShift;
+    VkVideoFrameChecksum     m_checksum;
+    uint32_t                 m_numBuffers;
+    uint32_t                 m_nextBuffer;
+    std::mutex               m_mutex;
+    std::condition_variable  m_condWriter;
+    std::condition_variable  m_condProducer;
+    std::deque<PendingWrite> m_pendingWrites;
+    bool                     m_bufferInUse[MAX_WRITE_BUFFERS];
+    bool                     m_exit;
+    std::thread              m_thread;
 };
 
 
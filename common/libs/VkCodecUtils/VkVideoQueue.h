@@ -32,6 +32,17 @@ public:
                                          int32_t* pBitDepth = nullptr) const = 0;
     virtual int32_t GetNextFrame(FrameDataType* pFrame, bool* endOfStream) = 0;
     virtual int32_t ReleaseFrame(FrameDataType* pDisplayedFrame) = 0;
+    // Releases the frames of the array, in one call to the producer where it supports it
+    virtual int32_t ReleaseFrames(FrameDataType* pDisplayedFrames, uint32_t numFrames)
+    {
+        int32_t result = 0;
+        for (uint32_t i = 0; i < numFrames; i++) {
+            if (ReleaseFrame(&pDisplayedFrames[i]) < 0) {
+                result = -1;
+            }
+        }
+        return result;
+    }
 public:
     virtual ~VkVideoQueue() {};
 };
@@ -19,6 +19,7 @@
 
 #include "stdint.h"
 #include "assert.h"
+#include <utility>
 
 class VkVideoRefCountBase {
 
@@ -136,14 +137,21 @@ public:
 
     bool operator!() const { return m_sharedObject == nullptr; }
 
-    // Exchange
+    // Exchange, without touching the refcounts
     void Swap(VkSharedBaseObj<VkBaseObjType>& sharedObject)
     {
-        VkSharedBaseObj<VkBaseObjType> tmp(m_sharedObject);
+        VkBaseObjType* const tmp = m_sharedObject;
         m_sharedObject = sharedObject.m_sharedObject;
         sharedObject.m_sharedObject = tmp;
     }
 
+    // Hands the reference over to the returned object, leaving this one empty, without touching the refcount.
+    // For the hand-offs between the stages of a pipeline, where a copy followed by a reset would cost two atomics.
+    VkSharedBaseObj<VkBaseObjType> Detach()
+    {
+        return VkSharedBaseObj<VkBaseObjType>(std::move(*this));
+    }
+
     // Non ref-counted access to the underlying object
     VkBaseObjType* Get(void) const
     {
@@ -0,0 +1,227 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "VkCodecUtils/VkVideoStreamIndex.h"
+
+static const char* const streamIndexSignature = "# vk_video_samples stream index 1";
+
+VkVideoStreamIndex::VkVideoStreamIndex()
+    : m_codec(VK_VIDEO_CODEC_OPERATION_NONE_KHR)
+    , m_streamSize(0)
+    , m_streamHeaderSize(0)
+    , m_numFrames(0)
+    , m_entries()
+{
+}
+
+void VkVideoStreamIndex::Reset()
+{
+    m_codec = VK_VIDEO_CODEC_OPERATION_NONE_KHR;
+    m_streamSize = 0;
+    m_streamHeaderSize = 0;
+    m_numFrames = 0;
+    m_entries.clear();
+}
+
+bool VkVideoStreamIndex::Build(const uint8_t* pData, size_t size, VkVideoCodecOperationFlagBitsKHR codec)
+{
+    Reset();
+
+    if ((codec != VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) &&
+        (codec != VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR)) {
+        return false;
+    }
+
+    const bool isH265 = (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR);
+    const size_t nalHeaderSize = isH265 ? 2 : 1;
+
+    // The start of the access unit of the next picture, at the first NAL unit after the last slice
+    const uint64_t noAccessUnit = UINT64_MAX;
+    uint64_t accessUnitOffset = noAccessUnit;
+    bool accessUnitHasSps = false;
+    bool hasStreamHeader = false;
+
+    size_t i = 0;
+    while ((i + 3) <= size) {
+
+        // If the third byte is greater than 1, none of the three positions can begin a start code.
+        const uint8_t c = pData[i + 2];
+        if (c > 1) {
+            i += 3;
+            continue;
+        } else if ((c != 1) || (pData[i + 1] != 0) || (pData[i] != 0)) {
+            i++;
+            continue;
+        }
+
+        // With the zero byte of a four bytes start code
+        const size_t startCodeOffset = ((i > 0) && (pData[i - 1] == 0)) ? (i - 1) : i;
+        const size_t nalOffset = i + 3;
+        i = nalOffset;
+        if ((nalOffset + nalHeaderSize + 1) > size) {
+            break;
+        }
+
+        const uint8_t* pNal = &pData[nalOffset];
+        uint8_t nalUnitType = 0;
+        bool isVcl = false;
+        bool isRandomAccessPoint = false;
+        bool isSps = false;
+        bool isTrailing = false; // belongs to the access unit before it
+        bool firstSliceInPicture = false;
+        if (isH265) {
+            nalUnitType = (pNal[0] >> 1) & 0x3f;
+            const uint8_t layerId = ((pNal[0] & 1) << 5) | (pNal[1] >> 3);
+            if (layerId != 0) {
+                continue;
+            }
+            isVcl = (nalUnitType < 32);
+            isRandomAccessPoint = (nalUnitType >= 16) && (nalUnitType <= 21); // BLA, IDR and CRA
+            isSps = (nalUnitType == 33);
+            isTrailing = (nalUnitType == 36) || (nalUnitType == 37) || (nalUnitType == 38) || (nalUnitType == 40);
+            firstSliceInPicture = isVcl && ((pNal[2] & 0x80) != 0); // first_slice_segment_in_pic_flag
+        } else {
+            nalUnitType = pNal[0] & 0x1f;
+            isVcl = (nalUnitType >= 1) && (nalUnitType <= 5);
+            isRandomAccessPoint = (nalUnitType == 5);
+            isSps = (nalUnitType == 7);
+            isTrailing = (nalUnitType == 10) || (nalUnitType == 11) || (nalUnitType == 12);
+            firstSliceInPicture = isVcl && ((pNal[1] & 0x80) != 0); // first_mb_in_slice is 0
+        }
+
+        if (!isVcl) {
+            if ((accessUnitOffset == noAccessUnit) && !isTrailing) {
+                accessUnitOffset = startCodeOffset;
+            }
+            accessUnitHasSps = accessUnitHasSps || isSps;
+            continue;
+        }
+
+        if (firstSliceInPicture) {
+            const uint64_t pictureOffset = (accessUnitOffset != noAccessUnit) ? accessUnitOffset : startCodeOffset;
+            if (!hasStreamHeader) {
+                m_streamHeaderSize = startCodeOffset;
+                hasStreamHeader = true;
+            }
+            if (isRandomAccessPoint) {
+                Entry entry;
+                entry.offset = pictureOffset;
+                entry.frameNumber = m_numFrames;
+                entry.nalUnitType = nalUnitType;
+                entry.hasParameterSets = accessUnitHasSps ? 1 : 0;
+                m_entries.push_back(entry);
+            }
+            m_numFrames++;
+        }
+        accessUnitOffset = noAccessUnit;
+        accessUnitHasSps = false;
+    }
+
+    m_codec = codec;
+    m_streamSize = size;
+    return true;
+}
+
+bool VkVideoStreamIndex::Load(const char* fileName, size_t streamSize, VkVideoCodecOperationFlagBitsKHR codec)
+{
+    Reset();
+
+    FILE* pFile = fopen(fileName, "r");
+    if (pFile == nullptr) {
+        return false;
+    }
+
+    char line[256];
+    unsigned long long fileStreamSize = 0, streamHeaderSize = 0;
+    unsigned int fileCodec = 0, numFrames = 0, numEntries = 0;
+    bool valid = (fgets(line, sizeof(line), pFile) != nullptr) &&
+                 (strncmp(line, streamIndexSignature, strlen(streamIndexSignature)) == 0) &&
+                 (fscanf(pFile, "codec %u\n", &fileCodec) == 1) &&
+                 (fscanf(pFile, "streamSize %llu\n", &fileStreamSize) == 1) &&
+                 (fscanf(pFile, "streamHeaderSize %llu\n", &streamHeaderSize) == 1) &&
+                 (fscanf(pFile, "frames %u\n", &numFrames) == 1) &&
+                 (fscanf(pFile, "entries %u\n", &numEntries) == 1) &&
+                 (fileCodec == (unsigned int)codec) && (fileStreamSize == (unsigned long long)streamSize);
+
+    for (uint32_t n = 0; valid && (n < numEntries); n++) {
+        unsigned long long offset = 0;
+        unsigned int frameNumber = 0, nalUnitType = 0, hasParameterSets = 0;
+        valid = (fscanf(pFile, "%llu %u %u %u\n", &offset, &frameNumber, &nalUnitType, &hasParameterSets) == 4) &&
+                (offset < fileStreamSize) && (frameNumber < numFrames);
+        if (valid) {
+            Entry entry;
+            entry.offset = offset;
+            entry.frameNumber = frameNumber;
+            entry.nalUnitType = (uint8_t)nalUnitType;
+            entry.hasParameterSets = hasParameterSets ? 1 : 0;
+            m_entries.push_back(entry);
+        }
+    }
+    fclose(pFile);
+
+    if (!valid) {
+        Reset();
+        return false;
+    }
+
+    m_codec = codec;
+    m_streamSize = fileStreamSize;
+    m_streamHeaderSize = streamHeaderSize;
+    m_numFrames = numFrames;
+    return true;
+}
+
+bool VkVideoStreamIndex::Save(const char* fileName) const
+{
+    FILE* pFile = fopen(fileName, "w");
+    if (pFile == nullptr) {
+        return false;
+    }
+
+    fprintf(pFile, "%s\n", streamIndexSignature);
+    fprintf(pFile, "codec %u\n", (unsigned int)m_codec);
+    fprintf(pFile, "streamSize %llu\n", (unsigned long long)m_streamSize);
+    fprintf(pFile, "streamHeaderSize %llu\n", (unsigned long long)m_streamHeaderSize);
+    fprintf(pFile, "frames %u\n", m_numFrames);
+    fprintf(pFile, "entries %u\n", (unsigned int)m_entries.size());
+    for (const Entry& entry : m_entries) {
+        fprintf(pFile, "%llu %u %u %u\n", (unsigned long long)entry.offset, entry.frameNumber,
+                (unsigned int)entry.nalUnitType, (unsigned int)entry.hasParameterSets);
+    }
+
+    const bool written = (ferror(pFile) == 0);
+    fclose(pFile);
+    return written;
+}
+
+const VkVideoStreamIndex::Entry* VkVideoStreamIndex::FindEntry(uint32_t frameNumber) const
+{
+    // The entries are in stream order, with increasing frame numbers
+    const Entry* pEntry = nullptr;
+    size_t first = 0, last = m_entries.size();
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        if (m_entries[middle].frameNumber <= frameNumber) {
+            pEntry = &m_entries[middle];
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return pEntry;
+}
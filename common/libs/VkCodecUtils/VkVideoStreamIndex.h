@@ -0,0 +1,83 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VKVIDEOSTREAMINDEX_H_
+#define _VKCODECUTILS_VKVIDEOSTREAMINDEX_H_
+
+#include <stdint.h>
+#include <vector>
+#include "vulkan_interfaces.h"
+
+// The random access points of an H.264 or H.265 Annex-B elementary stream: the IDR pictures, plus the CRA
+// and BLA ones of H.265. Each entry has the byte offset of the access unit of the picture, including the
+// parameter sets and SEI in front of it, and the number of pictures before it in decode order. The picture
+// order counts restart at each IDR, so the pictures are counted over the whole stream instead, which is
+// their display frame number for closed GOPs. The index can be saved to a sidecar file, one line per entry.
+class VkVideoStreamIndex {
+
+public:
+    struct Entry {
+        uint64_t offset;         // of the first byte of the start code of the access unit
+        uint32_t frameNumber;    // the number of pictures before it in decode order
+        uint8_t  nalUnitType;
+        uint8_t  hasParameterSets; // a SPS is part of the access unit
+    };
+
+    VkVideoStreamIndex();
+
+    // Scans the stream for its random access points. Returns false for a codec without an index.
+    bool Build(const uint8_t* pData, size_t size, VkVideoCodecOperationFlagBitsKHR codec);
+
+    // Returns false if the file can't be read, or was built for another codec or size of stream.
+    bool Load(const char* fileName, size_t streamSize, VkVideoCodecOperationFlagBitsKHR codec);
+
+    bool Save(const char* fileName) const;
+
+    bool IsValid() const
+    {
+        return !m_entries.empty();
+    }
+
+    // The last random access point at or before frameNumber, nullptr if there is none.
+    const Entry* FindEntry(uint32_t frameNumber) const;
+
+    // The size of the parameter sets and SEI at the start of the stream, before its first picture
+    size_t GetStreamHeaderSize() const
+    {
+        return (size_t)m_streamHeaderSize;
+    }
+
+    uint32_t GetNumFrames() const
+    {
+        return m_numFrames;
+    }
+
+    uint32_t GetNumEntries() const
+    {
+        return (uint32_t)m_entries.size();
+    }
+
+    void Reset();
+
+private:
+    VkVideoCodecOperationFlagBitsKHR m_codec;
+    uint64_t                         m_streamSize;
+    uint64_t                         m_streamHeaderSize;
+    uint32_t                         m_numFrames;
+    std::vector<Entry>               m_entries;
+};
+
+#endif /* _VKCODECUTILS_VKVIDEOSTREAMINDEX_H_ */
@@ -0,0 +1,99 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANATOMICBITMASK_H_
+#define _VKCODECUTILS_VULKANATOMICBITMASK_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <atomic>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The mask must not be zero
+static inline uint32_t VkCountTrailingZeros64(uint64_t mask)
+{
+    assert(mask != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(mask);
+#endif
+}
+
+// A 64 entry bit mask of available slots, acquired and released with compare-and-swap and no lock.
+// A set bit means the slot is available.
+class VulkanAtomicBitMask
+{
+public:
+    VulkanAtomicBitMask(uint64_t mask = 0)
+        : m_mask(mask) { }
+
+    uint64_t Get() const
+    {
+        return m_mask.load(std::memory_order_acquire);
+    }
+
+    void Set(uint64_t mask)
+    {
+        m_mask.store(mask, std::memory_order_release);
+    }
+
+    // Clears and returns the first set bit at or after startBit, wrapping around to the bits before it.
+    // Returns -1 if no bit is set.
+    int32_t AcquireFirstSetBit(uint32_t startBit = 0)
+    {
+        const uint64_t startMask = (startBit < 64) ? ~((1ULL << startBit) - 1) : 0;
+        uint64_t mask = m_mask.load(std::memory_order_relaxed);
+        while (mask != 0) {
+            const uint64_t candidates = ((mask & startMask) != 0) ? (mask & startMask) : mask;
+            const uint32_t bit = VkCountTrailingZeros64(candidates);
+            if (m_mask.compare_exchange_weak(mask, mask & ~(1ULL << bit),
+                                             std::memory_order_acquire, std::memory_order_relaxed)) {
+                return (int32_t)bit;
+            }
+            // mask has been reloaded by the failed compare-and-swap
+        }
+        return -1;
+    }
+
+    // Sets the bit back, returns false if it was already set.
+    bool ReleaseBit(uint32_t bit)
+    {
+        assert(bit < 64);
+        const uint64_t prevMask = m_mask.fetch_or(1ULL << bit, std::memory_order_release);
+        return !(prevMask & (1ULL << bit));
+    }
+
+    // A snapshot, the slots can be acquired or released meanwhile
+    uint32_t CountSetBits() const
+    {
+        uint64_t mask = m_mask.load(std::memory_order_relaxed);
+        uint32_t count = 0;
+        for (; mask != 0; mask &= (mask - 1)) {
+            count++;
+        }
+        return count;
+    }
+
+private:
+    std::atomic<uint64_t> m_mask;
+};
+
+#endif /* _VKCODECUTILS_VULKANATOMICBITMASK_H_ */
@@ -90,7 +90,8 @@ VkResult VulkanBitstreamBufferImpl::CreateBuffer(const VulkanDeviceContext* vkDe
     VkBufferCreateInfo createBufferInfo = VkBufferCreateInfo();
     createBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     createBufferInfo.size = bufferSize;
-    createBufferInfo.usage = VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR;
+    // Also the copy target of the device-local encoder output
+    createBufferInfo.usage = VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     createBufferInfo.flags = 0;
     createBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     createBufferInfo.queueFamilyIndexCount = 1;
@@ -106,25 +107,28 @@ VkResult VulkanBitstreamBufferImpl::CreateBuffer(const VulkanDeviceContext* vkDe
     vkDevCtx->GetBufferMemoryRequirements(*vkDevCtx, buffer, &memoryRequirements);
 
     // Allocate memory for the buffer
+    VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_BITSTREAM);
     VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory;
-    result = VulkanDeviceMemoryImpl::Create(vkDevCtx,
-                                            memoryRequirements,
-                                            memoryPropertyFlags,
-                                            pInitializeBufferMemory,
-                                            initializeBufferMemorySize,
+    result = VulkanDeviceMemoryImpl::CreateFromArena(vkDevCtx,
+                                                     memoryRequirements,
+                                                     memoryPropertyFlags,
+                                                     pInitializeBufferMemory,
+                                                     initializeBufferMemorySize,
 #ifdef CLEAR_BITSTREAM_BUFFERS_ON_CREATE
-                                            true, // clearMemory
+                                                     true, // clearMemory
 #else
-                                            false, // clearMemory
+                                                     false, // clearMemory
 #endif
-                                            vkDeviceMemory);
+                                                     true, // linearResource
+                                                     vkDeviceMemory);
     if (result != VK_SUCCESS) {
         vkDevCtx->DestroyBuffer(*vkDevCtx, buffer, nullptr);
         assert(!"Create Memory Failed!");
         return result;
     }
 
-    result = vkDevCtx->BindBufferMemory(*vkDevCtx, buffer, *vkDeviceMemory, bufferOffset);
+    result = vkDevCtx->BindBufferMemory(*vkDevCtx, buffer, *vkDeviceMemory,
+                                        vkDeviceMemory->GetDeviceMemoryOffset() + bufferOffset);
     if (result != VK_SUCCESS) {
         vkDevCtx->DestroyBuffer(*vkDevCtx, buffer, nullptr);
         assert(!"Bind buffer memory failed!");
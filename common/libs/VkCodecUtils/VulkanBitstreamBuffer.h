@@ -50,6 +50,12 @@ public:
     virtual void InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const = 0;
     virtual VkBuffer GetBuffer() const = 0;
     virtual VkDeviceMemory GetDeviceMemory() const = 0;
+    // Offset of the decode source range in GetBuffer(), the stream markers are relative to it.
+    virtual VkDeviceSize GetBufferOffset() const { return 0; }
+    // Offset of the data at GetDataPtr(0) from the start of the decode source range.
+    virtual VkDeviceSize GetDataOffset() const { return 0; }
+    // True if the next buffer can continue the data of this one in place, when it's initialized from it.
+    virtual bool ContinuesInPlace() const { return false; }
 
     virtual uint32_t  AddStreamMarker(uint32_t streamOffset) = 0;
     virtual uint32_t  SetStreamMarker(uint32_t streamOffset, uint32_t index) = 0;
@@ -132,14 +138,22 @@ public:
             assert(!"Could not resize the bitstream buffer!");
             return retSize;
         }
+
+        // Keep the markers of the data that was copied
+        newVulkanBitstreamBuffer->ResetStreamMarkers();
+        for (uint32_t i = 0; i < m_numSlices; i++) {
+            const uint32_t streamOffset = m_bitstreamBuffer->GetStreamMarker(i);
+            if ((streamOffset >= copyOffset) && (streamOffset < (copyOffset + copySize))) {
+                newVulkanBitstreamBuffer->AddStreamMarker((uint32_t)(streamOffset - copyOffset));
+            }
+        }
         m_bitstreamBuffer = newVulkanBitstreamBuffer;
+        m_numSlices = m_bitstreamBuffer->GetStreamMarkersCount();
 
         m_pData = m_bitstreamBuffer->GetDataPtr(0, m_maxSize);
         assert(m_pData);
         assert(m_maxSize);
 
-        ResetStreamMarkers();
-
         return m_maxSize;
     }
 
@@ -180,6 +194,10 @@ public:
     VkDeviceSize SetSliceStartCodeAtOffset(VkDeviceSize indx) {
         assert(m_pData);
         assert(indx < m_maxSize);
+        if (HasSliceStartCodeAtOffset(indx)) {
+            // Already there, don't write to buffers aliasing read-only input memory
+            return 3;
+        }
         m_pData[indx + 0] = 0x00;
         m_pData[indx + 1] = 0x00;
         m_pData[indx + 2] = 0x01;
@@ -0,0 +1,350 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <string.h>
+#include "VkCodecUtils/VulkanBitstreamRingBuffer.h"
+
+VkResult
+VulkanBitstreamRingBuffer::Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex, VkDeviceSize ringSize,
+                                  VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment,
+                                  VkSharedBaseObj<VulkanBitstreamRingBuffer>& ringBuffer)
+{
+    VkSharedBaseObj<VulkanBitstreamRingBuffer> vkRingBuffer(new VulkanBitstreamRingBuffer(vkDevCtx, queueFamilyIndex,
+                                                                                          bufferOffsetAlignment,
+                                                                                          bufferSizeAlignment));
+    if (!vkRingBuffer) {
+        assert(!"Out of host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = VulkanBitstreamBufferImpl::Create(vkDevCtx, queueFamilyIndex, ringSize,
+                                                        bufferOffsetAlignment, bufferSizeAlignment,
+                                                        nullptr, 0, vkRingBuffer->m_buffer);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkDeviceSize maxSize = 0;
+    vkRingBuffer->m_pData = vkRingBuffer->m_buffer->GetDataPtr(0, maxSize);
+    if (vkRingBuffer->m_pData == nullptr) {
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    vkRingBuffer->m_size = maxSize;
+
+    ringBuffer = vkRingBuffer;
+    return VK_SUCCESS;
+}
+
+bool VulkanBitstreamRingBuffer::FindSpace(VkDeviceSize size, VkDeviceSize& start) const
+{
+    if (m_regions.empty()) {
+        start = 0;
+        return (size <= m_size);
+    }
+
+    const VkDeviceSize tail = m_regions.front().start;
+    const VkDeviceSize head = ((m_head + m_bufferOffsetAlignment - 1) / m_bufferOffsetAlignment) * m_bufferOffsetAlignment;
+    if (m_head >= tail) {
+        // The regions don't wrap around, there is room after them and before them
+        if ((head + size) <= m_size) {
+            start = head;
+            return true;
+        }
+        start = 0;
+        return (size < tail);
+    }
+
+    // Between the most recent region and the oldest one, they must not meet to tell a full ring from an empty one
+    start = head;
+    return ((head + size) < tail);
+}
+
+VkResult VulkanBitstreamRingBuffer::Allocate(VkDeviceSize size, const uint8_t* pInitializeData,
+                                             VkDeviceSize initializeDataSize,
+                                             VkSharedBaseObj<VulkanRingBitstreamBuffer>& bitstreamBuffer)
+{
+    assert(initializeDataSize <= size);
+    size = ((size + m_bufferSizeAlignment - 1) / m_bufferSizeAlignment) * m_bufferSizeAlignment;
+    // Large pictures would leave too little room for the ones still being decoded
+    if (size > (m_size / 2)) {
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool continueInPlace = false;
+    VkDeviceSize start = 0;
+    if ((initializeDataSize > 0) && !m_regions.empty() && !m_regions.back().retired &&
+            (pInitializeData >= (m_pData + m_regions.back().start)) &&
+            ((pInitializeData + initializeDataSize) <= (m_pData + m_regions.back().end))) {
+        // The data is at the end of the most recent region, continue it from there
+        start = (VkDeviceSize)(pInitializeData - m_pData);
+        const VkDeviceSize tail = m_regions.front().start;
+        continueInPlace = (start >= tail) ? ((start + size) <= m_size) : ((start + size) < tail);
+    }
+
+    if (!continueInPlace && !FindSpace(size, start)) {
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    VkSharedBaseObj<VulkanBitstreamRingBuffer> ringBuffer(this);
+    VkSharedBaseObj<VulkanRingBitstreamBuffer> vkBitstreamBuffer(
+            new VulkanRingBitstreamBuffer(ringBuffer, m_nextRegionId, m_pData + start, size, start,
+                                          m_bufferOffsetAlignment, m_bufferSizeAlignment));
+    if (!vkBitstreamBuffer) {
+        assert(!"Out of host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    if (continueInPlace) {
+        // The previous region gives up its data from here on, it's no longer written to
+        m_regions.back().end = start;
+    } else if (initializeDataSize > 0) {
+        memcpy(m_pData + start, pInitializeData, (size_t)initializeDataSize);
+    }
+
+    Region region;
+    region.id = m_nextRegionId++;
+    region.start = start;
+    region.end = start + size;
+    region.retired = false;
+    m_regions.push_back(region);
+    m_head = region.end;
+
+    bitstreamBuffer = vkBitstreamBuffer;
+    return VK_SUCCESS;
+}
+
+void VulkanBitstreamRingBuffer::RetireRegion(uint64_t regionId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (Region& region : m_regions) {
+        if (region.id == regionId) {
+            region.retired = true;
+            break;
+        }
+    }
+
+    // The decodes complete mostly in order, the space is reused once the oldest regions are done
+    while (!m_regions.empty() && m_regions.front().retired) {
+        m_regions.pop_front();
+    }
+    if (m_regions.empty()) {
+        m_head = 0;
+    }
+}
+
+VkDeviceSize VulkanRingBitstreamBuffer::Resize(VkDeviceSize newSize, VkDeviceSize, VkDeviceSize)
+{
+    // Can't grow in place, use Clone() to continue in a larger region
+    return (m_dataSize >= newSize) ? m_dataSize : 0;
+}
+
+VkDeviceSize VulkanRingBitstreamBuffer::Clone(VkDeviceSize newSize, VkDeviceSize copySize, VkDeviceSize copyOffset,
+                                              VkSharedBaseObj<VulkanBitstreamBuffer>& vulkanBitstreamBuffer)
+{
+    const uint8_t* pCopyData = nullptr;
+    if (copySize) {
+        pCopyData = CheckAccess(copyOffset, copySize);
+        if (pCopyData == nullptr) {
+            return 0;
+        }
+    }
+
+    VkSharedBaseObj<VulkanRingBitstreamBuffer> ringBitstreamBuffer;
+    if (m_ringBuffer->Allocate(newSize, pCopyData, copySize, ringBitstreamBuffer) == VK_SUCCESS) {
+        vulkanBitstreamBuffer = ringBitstreamBuffer;
+        return vulkanBitstreamBuffer->GetMaxSize();
+    }
+
+    // The ring is full, or the picture is too large for it
+    VkSharedBaseObj<VulkanBitstreamBufferImpl> vkBitstreamBuffer;
+    VkResult result = VulkanBitstreamBufferImpl::Create(m_ringBuffer->GetDeviceContext(),
+                                                        m_ringBuffer->GetQueueFamilyIndex(),
+                                                        newSize, m_bufferOffsetAlignment, m_bufferSizeAlignment,
+                                                        pCopyData, copySize, vkBitstreamBuffer);
+    if (result != VK_SUCCESS) {
+        assert(!"Initialize failed!");
+        return 0;
+    }
+
+    vulkanBitstreamBuffer = vkBitstreamBuffer;
+    return newSize;
+}
+
+uint8_t* VulkanRingBitstreamBuffer::CheckAccess(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (offset + size <= m_dataSize) {
+        return m_pData + offset;
+    }
+
+    assert(!"Bad buffer access - out of range!");
+    return nullptr;
+}
+
+int64_t VulkanRingBitstreamBuffer::MemsetData(uint32_t value, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    uint8_t* setData = CheckAccess(offset, size);
+    if (setData == nullptr) {
+        assert(!"Could not MemsetData!");
+        return -1;
+    }
+    memset(setData, value, (size_t)size);
+    return size;
+}
+
+int64_t VulkanRingBitstreamBuffer::CopyDataToBuffer(uint8_t *dstBuffer, VkDeviceSize dstOffset,
+                                                    VkDeviceSize srcOffset, VkDeviceSize size) const
+{
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* readData = CheckAccess(srcOffset, size);
+    if (readData == nullptr) {
+        return -1;
+    }
+    memcpy(dstBuffer + dstOffset, readData, (size_t)size);
+    return size;
+}
+
+int64_t VulkanRingBitstreamBuffer::CopyDataToBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& dstBuffer,
+                                                    VkDeviceSize dstOffset,
+                                                    VkDeviceSize srcOffset, VkDeviceSize size) const
+{
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* readData = CheckAccess(srcOffset, size);
+    if (readData == nullptr) {
+        assert(!"Could not CopyDataToBuffer!");
+        return -1;
+    }
+    return dstBuffer->CopyDataFromBuffer(readData, 0, dstOffset, size);
+}
+
+int64_t VulkanRingBitstreamBuffer::CopyDataFromBuffer(const uint8_t *sourceBuffer, VkDeviceSize srcOffset,
+                                                      VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    uint8_t* writeData = CheckAccess(dstOffset, size);
+    if (writeData == nullptr) {
+        assert(!"Could not CopyDataFromBuffer!");
+        return -1;
+    }
+    // Nothing to do for the data that was continued in place
+    if ((sourceBuffer + srcOffset) != writeData) {
+        memmove(writeData, sourceBuffer + srcOffset, (size_t)size);
+    }
+    return size;
+}
+
+int64_t VulkanRingBitstreamBuffer::CopyDataFromBuffer(const VkSharedBaseObj<VulkanBitstreamBuffer>& sourceBuffer,
+                                                      VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* readData = sourceBuffer->GetReadOnlyDataPtr(srcOffset, size);
+    if (readData == nullptr) {
+        assert(!"Could not CopyDataFromBuffer!");
+        return -1;
+    }
+    return CopyDataFromBuffer(readData, 0, dstOffset, size);
+}
+
+uint8_t* VulkanRingBitstreamBuffer::GetDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize)
+{
+    uint8_t* readData = CheckAccess(offset, 1);
+    if (readData == nullptr) {
+        assert(!"Could not GetDataPtr()!");
+        return nullptr;
+    }
+    maxSize = m_dataSize - offset;
+    return readData;
+}
+
+const uint8_t* VulkanRingBitstreamBuffer::GetReadOnlyDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize) const
+{
+    const uint8_t* readData = CheckAccess(offset, 1);
+    if (readData == nullptr) {
+        assert(!"Could not GetReadOnlyDataPtr()!");
+        return nullptr;
+    }
+    maxSize = m_dataSize - offset;
+    return readData;
+}
+
+void VulkanRingBitstreamBuffer::FlushRange(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (size == 0) {
+        return;
+    }
+    m_ringBuffer->FlushRange(m_ringOffset + offset, size);
+}
+
+void VulkanRingBitstreamBuffer::InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (size == 0) {
+        return;
+    }
+    m_ringBuffer->InvalidateRange(m_ringOffset + offset, size);
+}
+
+uint32_t VulkanRingBitstreamBuffer::AddStreamMarker(uint32_t streamOffset)
+{
+    m_streamMarkers.push_back(streamOffset + (uint32_t)m_dataOffset);
+    return (uint32_t)(m_streamMarkers.size() - 1);
+}
+
+uint32_t VulkanRingBitstreamBuffer::SetStreamMarker(uint32_t streamOffset, uint32_t index)
+{
+    assert(index < (uint32_t)m_streamMarkers.size());
+    if (!(index < (uint32_t)m_streamMarkers.size())) {
+        return uint32_t(-1);
+    }
+    m_streamMarkers[index] = streamOffset + (uint32_t)m_dataOffset;
+    return index;
+}
+
+uint32_t VulkanRingBitstreamBuffer::GetStreamMarker(uint32_t index) const
+{
+    assert(index < (uint32_t)m_streamMarkers.size());
+    return m_streamMarkers[index] - (uint32_t)m_dataOffset;
+}
+
+uint32_t VulkanRingBitstreamBuffer::GetStreamMarkersCount() const
+{
+    return (uint32_t)m_streamMarkers.size();
+}
+
+const uint32_t* VulkanRingBitstreamBuffer::GetStreamMarkersPtr(uint32_t startIndex, uint32_t& maxCount) const
+{
+    maxCount = (uint32_t)m_streamMarkers.size() - startIndex;
+    return m_streamMarkers.data() + startIndex;
+}
+
+uint32_t VulkanRingBitstreamBuffer::ResetStreamMarkers()
+{
+    uint32_t oldSize = (uint32_t)m_streamMarkers.size();
+    m_streamMarkers.clear();
+    return oldSize;
+}
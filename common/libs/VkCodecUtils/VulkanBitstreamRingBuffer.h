@@ -0,0 +1,224 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANBITSTREAMRINGBUFFER_H_
+#define _VKCODECUTILS_VULKANBITSTREAMRINGBUFFER_H_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanBitstreamBuffer.h"
+#include "VkCodecUtils/VulkanBistreamBufferImpl.h"
+
+class VulkanRingBitstreamBuffer;
+
+// A single large bitstream buffer the bitstream buffers of consecutive pictures are regions of, allocated in
+// order around the ring. A region is retired when its bitstream buffer is released, i.e. once its decode is
+// complete, and its space is reused once all the regions before it are retired too.
+// A new region can start inside the most recent one, e.g. at the NAL unit of the next picture that follows
+// the current one, the data is then continued in place instead of being copied to a new buffer.
+class VulkanBitstreamRingBuffer : public VkVideoRefCountBase
+{
+public:
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex, VkDeviceSize ringSize,
+                           VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment,
+                           VkSharedBaseObj<VulkanBitstreamRingBuffer>& ringBuffer);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the ring if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns a region of at least size bytes starting with the initialize data. The data is continued in place
+    // if it's in the most recent region, the rest of which then moves to the new one, else it's copied.
+    // Fails with VK_ERROR_OUT_OF_POOL_MEMORY if the regions still being decoded leave no room. Thread safe.
+    VkResult Allocate(VkDeviceSize size, const uint8_t* pInitializeData, VkDeviceSize initializeDataSize,
+                      VkSharedBaseObj<VulkanRingBitstreamBuffer>& bitstreamBuffer);
+
+    bool IsCompatible(VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment) const
+    {
+        return (m_bufferOffsetAlignment == std::max<VkDeviceSize>(bufferOffsetAlignment, 1)) &&
+               (m_bufferSizeAlignment == std::max<VkDeviceSize>(bufferSizeAlignment, 1));
+    }
+
+    VkDeviceSize GetSize() const { return m_size; }
+    VkBuffer GetBuffer() const { return m_buffer->GetBuffer(); }
+    VkDeviceMemory GetDeviceMemory() const { return m_buffer->GetDeviceMemory(); }
+    void FlushRange(VkDeviceSize offset, VkDeviceSize size) const { m_buffer->FlushRange(offset, size); }
+    void InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const { m_buffer->InvalidateRange(offset, size); }
+    const VulkanDeviceContext* GetDeviceContext() const { return m_vkDevCtx; }
+    uint32_t GetQueueFamilyIndex() const { return m_queueFamilyIndex; }
+
+    // Called by the bitstream buffer of the region when it's released. Thread safe.
+    void RetireRegion(uint64_t regionId);
+
+private:
+    struct Region {
+        uint64_t     id;
+        VkDeviceSize start;
+        VkDeviceSize end;
+        bool         retired;
+    };
+
+    VulkanBitstreamRingBuffer(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex,
+                              VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment)
+        : m_refCount(0)
+        , m_vkDevCtx(vkDevCtx)
+        , m_queueFamilyIndex(queueFamilyIndex)
+        , m_bufferOffsetAlignment(std::max<VkDeviceSize>(bufferOffsetAlignment, 1))
+        , m_bufferSizeAlignment(std::max<VkDeviceSize>(bufferSizeAlignment, 1))
+        , m_buffer()
+        , m_pData()
+        , m_size()
+        , m_regions()
+        , m_head()
+        , m_nextRegionId()
+        , m_mutex() { }
+
+    // Start of the free space for a new region of size bytes, with the lock held
+    bool FindSpace(VkDeviceSize size, VkDeviceSize& start) const;
+
+    virtual ~VulkanBitstreamRingBuffer() { assert(m_regions.empty()); }
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    const VulkanDeviceContext* m_vkDevCtx;
+    uint32_t                   m_queueFamilyIndex;
+    VkDeviceSize               m_bufferOffsetAlignment;
+    VkDeviceSize               m_bufferSizeAlignment;
+    VkSharedBaseObj<VulkanBitstreamBufferImpl> m_buffer;
+    uint8_t*                   m_pData;
+    VkDeviceSize               m_size;
+    std::deque<Region>         m_regions;       // in allocation order, the oldest one first
+    VkDeviceSize               m_head;          // end of the most recent region
+    uint64_t                   m_nextRegionId;
+    std::mutex                 m_mutex;
+};
+
+// A region of a VulkanBitstreamRingBuffer. The decode source range starts at GetBufferOffset(), aligned down to
+// the bitstream buffer offset alignment, and the stream markers are kept relative to it.
+// Clone() continues the data in place when the region is still the most recent one of the ring.
+class VulkanRingBitstreamBuffer : public VulkanBitstreamBuffer
+{
+public:
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Retire the region if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    virtual int32_t GetRefCount()
+    {
+        assert(m_refCount > 0);
+        return m_refCount;
+    }
+
+    virtual VkDeviceSize GetMaxSize() const { return m_dataSize; }
+    virtual VkDeviceSize GetOffsetAlignment() const { return m_bufferOffsetAlignment; }
+    virtual VkDeviceSize GetSizeAlignment() const { return m_bufferSizeAlignment; }
+    virtual VkDeviceSize Resize(VkDeviceSize newSize, VkDeviceSize copySize = 0, VkDeviceSize copyOffset = 0);
+    virtual VkDeviceSize Clone(VkDeviceSize newSize, VkDeviceSize copySize, VkDeviceSize copyOffset,
+                               VkSharedBaseObj<VulkanBitstreamBuffer>& vulkanBitstreamBuffer);
+
+    virtual int64_t  MemsetData(uint32_t value, VkDeviceSize offset, VkDeviceSize size);
+    virtual int64_t  CopyDataToBuffer(uint8_t *dstBuffer, VkDeviceSize dstOffset,
+                                      VkDeviceSize srcOffset, VkDeviceSize size) const;
+    virtual int64_t  CopyDataToBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& dstBuffer, VkDeviceSize dstOffset,
+                                      VkDeviceSize srcOffset, VkDeviceSize size) const;
+    virtual int64_t  CopyDataFromBuffer(const uint8_t *sourceBuffer, VkDeviceSize srcOffset,
+                                        VkDeviceSize dstOffset, VkDeviceSize size);
+    virtual int64_t  CopyDataFromBuffer(const VkSharedBaseObj<VulkanBitstreamBuffer>& sourceBuffer, VkDeviceSize srcOffset,
+                                        VkDeviceSize dstOffset, VkDeviceSize size);
+    virtual uint8_t* GetDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize);
+    virtual const uint8_t* GetReadOnlyDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize) const;
+
+    virtual void FlushRange(VkDeviceSize offset, VkDeviceSize size) const;
+    virtual void InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const;
+
+    virtual VkBuffer GetBuffer() const { return m_ringBuffer->GetBuffer(); }
+    virtual VkDeviceMemory GetDeviceMemory() const { return m_ringBuffer->GetDeviceMemory(); }
+    virtual VkDeviceSize GetBufferOffset() const { return m_bufferOffset; }
+    virtual VkDeviceSize GetDataOffset() const { return m_dataOffset; }
+    virtual bool ContinuesInPlace() const { return true; }
+
+    virtual uint32_t  AddStreamMarker(uint32_t streamOffset);
+    virtual uint32_t  SetStreamMarker(uint32_t streamOffset, uint32_t index);
+    virtual uint32_t  GetStreamMarker(uint32_t index) const;
+    virtual uint32_t  GetStreamMarkersCount() const;
+    virtual const uint32_t* GetStreamMarkersPtr(uint32_t startIndex, uint32_t& maxCount) const;
+    virtual uint32_t  ResetStreamMarkers();
+
+private:
+    friend class VulkanBitstreamRingBuffer;
+
+    VulkanRingBitstreamBuffer(VkSharedBaseObj<VulkanBitstreamRingBuffer>& ringBuffer, uint64_t regionId,
+                              uint8_t* pData, VkDeviceSize dataSize, VkDeviceSize ringOffset,
+                              VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment)
+        : VulkanBitstreamBuffer()
+        , m_refCount(0)
+        , m_ringBuffer(ringBuffer)
+        , m_regionId(regionId)
+        , m_pData(pData)
+        , m_dataSize(dataSize)
+        , m_ringOffset(ringOffset)
+        , m_bufferOffset(ringOffset - (ringOffset % bufferOffsetAlignment))
+        , m_dataOffset(ringOffset - m_bufferOffset)
+        , m_bufferOffsetAlignment(bufferOffsetAlignment)
+        , m_bufferSizeAlignment(bufferSizeAlignment)
+        , m_streamMarkers() { m_streamMarkers.reserve(256); }
+
+    uint8_t* CheckAccess(VkDeviceSize offset, VkDeviceSize size) const;
+
+    virtual ~VulkanRingBitstreamBuffer() { m_ringBuffer->RetireRegion(m_regionId); }
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    VkSharedBaseObj<VulkanBitstreamRingBuffer> m_ringBuffer;
+    uint64_t                   m_regionId;
+    uint8_t*                   m_pData;
+    VkDeviceSize               m_dataSize;
+    VkDeviceSize               m_ringOffset;     // of m_pData
+    VkDeviceSize               m_bufferOffset;
+    VkDeviceSize               m_dataOffset;
+    VkDeviceSize               m_bufferOffsetAlignment;
+    VkDeviceSize               m_bufferSizeAlignment;
+    std::vector<uint32_t>      m_streamMarkers;  // relative to m_bufferOffset
+};
+
+#endif /* _VKCODECUTILS_VULKANBITSTREAMRINGBUFFER_H_ */
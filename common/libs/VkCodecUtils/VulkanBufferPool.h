@@ -18,12 +18,13 @@
 #define _VKCODECUTILS_VULKANBUFFERPOOL_H_
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 #include <atomic>
-#include <mutex>
 
 #include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanAtomicBitMask.h"
 
 class VulkanBufferPoolIf : public VkVideoRefCountBase
 {
@@ -39,10 +40,9 @@ public:
 
     VulkanBufferPool()
         : m_refCount()
-        , m_queueMutex()
         , m_poolSize(0)
         , m_nextNodeToUse(0)
-        , m_availablePoolNodes(0UL)
+        , m_availablePoolNodes(0ULL)
         , m_poolNodes(maxPoolNodes)
     {
     }
@@ -54,17 +54,21 @@ public:
 
     void Init(uint32_t numPoolNodes)
     {
+        assert(numPoolNodes <= maxPoolNodes);
+        uint64_t availablePoolNodes = 0;
         for (uint32_t poolNodeIdx = 0; poolNodeIdx < numPoolNodes; poolNodeIdx++) {
             m_poolNodes[poolNodeIdx].Init();
-            m_availablePoolNodes |= (1ULL << poolNodeIdx);
+            availablePoolNodes |= (1ULL << poolNodeIdx);
         }
 
         m_poolSize = numPoolNodes;
+        m_availablePoolNodes.Set(availablePoolNodes);
     }
 
+    // Must not race with GetAvailablePoolNode()
     void Deinit()
     {
-        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_availablePoolNodes.Set(0);
         for (size_t ndx = 0; ndx < m_poolSize; ndx++) {
             m_poolNodes[ndx].Deinit();
         }
@@ -104,35 +108,12 @@ public:
 
     bool GetAvailablePoolNode(VkSharedBaseObj<PoolNodeType>&  poolNode)
     {
-        int32_t availablePoolNodeIndx = -1;
-        {
-            std::lock_guard<std::mutex> lock(m_queueMutex);
-            if (m_nextNodeToUse >= m_poolSize) {
-                m_nextNodeToUse = 0;
-            }
-            bool retryFirstPoolPartition = false;
-            do {
-                for (uint32_t i = m_nextNodeToUse; i < m_poolSize; i++) {
-                    if (m_availablePoolNodes & (1ULL << i)) {
-                        m_nextNodeToUse = i + 1;
-                        m_availablePoolNodes &= ~(1ULL << i);
-                        availablePoolNodeIndx = i;
-                        break;
-                    }
-                }
-
-                if ((availablePoolNodeIndx == -1) && (m_nextNodeToUse > 0)) {
-                    // Search again the first part of the bit array
-                    m_nextNodeToUse = 0;
-                    retryFirstPoolPartition = true;
-                } else {
-                    retryFirstPoolPartition = false;
-                    break;
-                }
-
-            } while (retryFirstPoolPartition);
-        }
+        // Round-robin from the node after the last one handed out, m_nextNodeToUse is only a hint.
+        const int32_t availablePoolNodeIndx =
+                m_availablePoolNodes.AcquireFirstSetBit(m_nextNodeToUse.load(std::memory_order_relaxed));
         if (availablePoolNodeIndx != -1) {
+            assert((uint32_t)availablePoolNodeIndx < m_poolSize);
+            m_nextNodeToUse.store(availablePoolNodeIndx + 1, std::memory_order_relaxed);
             m_poolNodes[availablePoolNodeIndx].SetParent(this, availablePoolNodeIndx);
             poolNode = &m_poolNodes[availablePoolNodeIndx];
             return true;
@@ -142,20 +123,19 @@ public:
 
     virtual bool ReleasePoolNodeToPool(uint32_t poolNodeIndex)
     {
-        std::lock_guard<std::mutex> lock(m_queueMutex);
-
-        assert(!(m_availablePoolNodes & uint64_t(1ULL << poolNodeIndex)));
-        m_availablePoolNodes |= uint64_t(1ULL << poolNodeIndex);
+        assert(poolNodeIndex < m_poolSize);
+        const bool wasInUse = m_availablePoolNodes.ReleaseBit(poolNodeIndex);
+        assert(wasInUse);
+        (void)wasInUse;
 
         return true;
     }
 
 private:
     std::atomic<int32_t>       m_refCount;
-    std::mutex                 m_queueMutex;
     uint32_t                   m_poolSize;
-    uint32_t                   m_nextNodeToUse;
-    uint64_t                   m_availablePoolNodes;
+    std::atomic<uint32_t>      m_nextNodeToUse;
+    VulkanAtomicBitMask        m_availablePoolNodes;
     std::vector<PoolNodeType>  m_poolNodes;
 };
 
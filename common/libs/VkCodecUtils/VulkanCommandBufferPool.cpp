@@ -57,37 +57,78 @@ void VulkanCommandBufferPool::PoolNode::Deinit()
 }
 
 
-bool VulkanCommandBufferPool::GetAvailablePoolNode(VkSharedBaseObj<PoolNode>& poolNode)
+std::atomic<uint64_t> VulkanCommandBufferPool::s_nextPoolId(0);
+
+// The command pools the current thread took in the last pools it recorded from, to find them with no lock
+struct ThreadCommandPool {
+    uint64_t poolId;
+    uint32_t commandPoolIndex;
+};
+static const uint32_t maxThreadCommandPools = 8;
+static thread_local ThreadCommandPool t_threadCommandPools[maxThreadCommandPools];
+static thread_local uint32_t t_nextThreadCommandPool = 0;
+
+uint32_t VulkanCommandBufferPool::GetThreadCommandPoolIndex()
 {
-    int32_t availablePoolNodeIndx = -1;
+    if (m_numCommandPools <= 1) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < maxThreadCommandPools; i++) {
+        if (t_threadCommandPools[i].poolId == m_poolId) {
+            return t_threadCommandPools[i].commandPoolIndex;
+        }
+    }
+
+    // The command pool already taken by this thread, else the first free one
+    const std::thread::id threadId = std::this_thread::get_id();
+    uint32_t commandPoolIndex = m_numCommandPools;
     {
         std::lock_guard<std::mutex> lock(m_queueMutex);
-        if (m_nextNodeToUse >= m_poolSize) {
-            m_nextNodeToUse = 0;
+        for (uint32_t poolIndex = 0; poolIndex < m_numCommandPools; poolIndex++) {
+            if (m_commandPoolThreads[poolIndex] == threadId) {
+                commandPoolIndex = poolIndex;
+                break;
+            }
         }
-        bool retryFirstPoolPartition = false;
-        do {
-            for (uint32_t i = m_nextNodeToUse; i < m_poolSize; i++) {
-                if (m_availablePoolNodes & (1ULL << i)) {
-                    m_nextNodeToUse = i + 1;
-                    m_availablePoolNodes &= ~(1ULL << i);
-                    availablePoolNodeIndx = i;
-                    break;
-                }
+        for (uint32_t poolIndex = 0; (poolIndex < m_numCommandPools) && (commandPoolIndex == m_numCommandPools); poolIndex++) {
+            if (m_commandPoolThreads[poolIndex] == std::thread::id()) {
+                m_commandPoolThreads[poolIndex] = threadId;
+                commandPoolIndex = poolIndex;
             }
+        }
+        if (commandPoolIndex == m_numCommandPools) {
+            // More threads than command pools, the threads sharing one have to serialize their recording
+            commandPoolIndex = m_numSharedCommandPools++ % m_numCommandPools;
+        }
+    }
 
-            if ((availablePoolNodeIndx == -1) && (m_nextNodeToUse > 0)) {
-                // Search again the first part of the bit array
-                m_nextNodeToUse = 0;
-                retryFirstPoolPartition = true;
-            } else {
-                retryFirstPoolPartition = false;
-                break;
-            }
+    ThreadCommandPool& threadCommandPool = t_threadCommandPools[t_nextThreadCommandPool];
+    t_nextThreadCommandPool = (t_nextThreadCommandPool + 1) % maxThreadCommandPools;
+    threadCommandPool.poolId = m_poolId;
+    threadCommandPool.commandPoolIndex = commandPoolIndex;
+    return commandPoolIndex;
+}
+
+bool VulkanCommandBufferPool::GetAvailablePoolNode(VkSharedBaseObj<PoolNode>& poolNode)
+{
+    return GetAvailablePoolNode(poolNode, GetThreadCommandPoolIndex());
+}
 
-        } while (retryFirstPoolPartition);
+bool VulkanCommandBufferPool::GetAvailablePoolNode(VkSharedBaseObj<PoolNode>& poolNode, uint32_t commandPoolIndex)
+{
+    if (commandPoolIndex >= m_numCommandPools) {
+        assert(!"Invalid command pool index");
+        return false;
     }
+
+    // Round-robin from the node after the last one handed out of this command pool, m_nextNodeToUse is only a hint.
+    std::atomic<uint32_t>& nextNodeToUse = m_nextNodeToUse[commandPoolIndex];
+    const int32_t availablePoolNodeIndx =
+            m_availablePoolNodes[commandPoolIndex].AcquireFirstSetBit(nextNodeToUse.load(std::memory_order_relaxed));
     if (availablePoolNodeIndx != -1) {
+        assert((uint32_t)availablePoolNodeIndx < m_poolSize);
+        nextNodeToUse.store(availablePoolNodeIndx + 1, std::memory_order_relaxed);
         m_poolNodes[availablePoolNodeIndx].SetParent(this, availablePoolNodeIndx);
         poolNode = &m_poolNodes[availablePoolNodeIndx];
         return true;
@@ -97,10 +138,10 @@ bool VulkanCommandBufferPool::GetAvailablePoolNode(VkSharedBaseObj<PoolNode>& po
 
 bool VulkanCommandBufferPool::ReleasePoolNodeToPool(uint32_t poolNodeIndex)
 {
-    std::lock_guard<std::mutex> lock(m_queueMutex);
-
-    assert(!(m_availablePoolNodes & (1ULL << poolNodeIndex)));
-    m_availablePoolNodes |= (1ULL << poolNodeIndex);
+    assert(poolNodeIndex < m_poolSize);
+    const bool wasInUse = m_availablePoolNodes[poolNodeIndex % m_numCommandPools].ReleaseBit(poolNodeIndex);
+    assert(wasInUse);
+    (void)wasInUse;
 
     return true;
 }
@@ -124,7 +165,9 @@ VkResult VulkanCommandBufferPool::Configure(const VulkanDeviceContext*   vkDevCt
                                             bool                         createQueryPool,
                                             const void*                  pNext,
                                             bool                         createSemaphores,
-                                            bool                         createFences)
+                                            bool                         createFences,
+                                            uint32_t                     numCommandPools,
+                                            bool                         useTimelineSemaphore)
 {
     std::lock_guard<std::mutex> lock(m_queueMutex);
     if (numPoolNodes > m_poolNodes.size()) {
@@ -132,12 +175,33 @@ VkResult VulkanCommandBufferPool::Configure(const VulkanDeviceContext*   vkDevCt
         return VK_ERROR_TOO_MANY_OBJECTS;
     }
 
-    VkResult result = m_commandBuffersSet.CreateCommandBufferPool(vkDevCtx, queueFamilyIndex, numPoolNodes);
+    if ((numCommandPools == 0) || (numCommandPools > maxCommandPools) || (numCommandPools > numPoolNodes)) {
+        assert(!"Invalid number of command pools");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkResult result = m_commandBuffersSet.CreateCommandBufferPool(vkDevCtx, queueFamilyIndex, numPoolNodes,
+                                                                  numCommandPools);
     if (result != VK_SUCCESS) {
         assert(!"ERROR: CreateCommandBufferPool!");
         return result;
     }
 
+    m_useTimelineSemaphore = useTimelineSemaphore && vkDevCtx->GetTimelineSemaphoreSupport();
+    m_lastSignalValue.store(0, std::memory_order_relaxed);
+    if (m_useTimelineSemaphore) {
+        VkSemaphoreTypeCreateInfo timelineCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+        timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineCreateInfo.initialValue = 0; // the first submission signals 1
+        result = m_semaphoreSet.CreateSet(vkDevCtx, 1, VkSemaphoreCreateFlags(), &timelineCreateInfo);
+        if (result != VK_SUCCESS) {
+            assert(!"ERROR: m_semaphoreSet.CreateSet of the timeline semaphore!");
+            return result;
+        }
+        createSemaphores = false;
+        createFences = false;
+    }
+
     if (createSemaphores) {
         result = m_semaphoreSet.CreateSet(vkDevCtx, numPoolNodes);
         if (result != VK_SUCCESS) {
@@ -161,17 +225,43 @@ VkResult VulkanCommandBufferPool::Configure(const VulkanDeviceContext*   vkDevCt
                                  pNext);
     }
 
+    uint64_t availablePoolNodes[maxCommandPools] = {};
     for (uint32_t poolNodeIdx = 0; poolNodeIdx < numPoolNodes; poolNodeIdx++) {
         m_poolNodes[poolNodeIdx].Init(vkDevCtx);
-        m_availablePoolNodes |= (1ULL << poolNodeIdx);
+        availablePoolNodes[poolNodeIdx % numCommandPools] |= (1ULL << poolNodeIdx);
+    }
+    for (uint32_t poolIndex = 0; poolIndex < maxCommandPools; poolIndex++) {
+        m_availablePoolNodes[poolIndex].Set(availablePoolNodes[poolIndex]);
+        m_nextNodeToUse[poolIndex].store(poolIndex, std::memory_order_relaxed);
+        m_commandPoolThreads[poolIndex] = std::thread::id();
     }
 
     m_vkDevCtx         = vkDevCtx;
     m_poolSize         = numPoolNodes;
+    m_numCommandPools  = numCommandPools;
+    m_numSharedCommandPools = 0;
     m_queueFamilyIndex = queueFamilyIndex;
     return VK_SUCCESS;
 }
 
+VkResult VulkanCommandBufferPool::WaitForSignalValue(uint64_t signalValue, uint64_t timeoutNanosec) const
+{
+    if (!m_useTimelineSemaphore) {
+        assert(!"The pool has no timeline semaphore");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkSemaphore timelineSemaphore = m_semaphoreSet.GetSemaphore(0);
+    const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                           &timelineSemaphore, &signalValue };
+    VkResult result = m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, timeoutNanosec);
+    assert(result == VK_SUCCESS);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: WaitSemaphores() result: 0x%x\n", result);
+    }
+    return result;
+}
+
 void VulkanCommandBufferPool::Deinit()
 {
     std::lock_guard<std::mutex> lock(m_queueMutex);
@@ -19,14 +19,22 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanAtomicBitMask.h"
 #include "VkCodecUtils/VulkanCommandBuffersSet.h"
 #include "VkCodecUtils/VulkanSemaphoreSet.h"
 #include "VkCodecUtils/VulkanFenceSet.h"
 #include "VkCodecUtils/VulkanQueryPoolSet.h"
 
+// The pool nodes can be split between several command pools, the node i belonging to the command pool
+// (i % numCommandPools). A thread recording from the pool gets the nodes of a command pool of its own, so
+// that the threads recording at the same time don't need to synchronize on a shared VkCommandPool. The nodes
+// are acquired and released with no lock, the node released from another thread goes back to its command pool.
 class VulkanCommandBufferPool : public VkVideoRefCountBase {
 public:
 
@@ -56,6 +64,7 @@ public:
             , m_parent()
             , m_parentIndex(-1)
             , m_cmdBufState(CmdBufStateReset)
+            , m_signalValue(0)
         {
         }
 
@@ -133,6 +142,21 @@ public:
             return true;
         }
 
+        // For a command buffer recorded outside of the pool, e.g. once and then resubmitted as is, the node only
+        // provides the synchronization of the submission
+        bool SetExternalCommandBufferSubmitted() {
+            if ((m_parent == nullptr) || (m_parentIndex < 0)) {
+                assert(!"Invalid PoolNode state!");
+                return false;
+            }
+            if (m_cmdBufState != CmdBufStateReset) {
+                assert(!"Command Buffer is not in reset state!");
+                return false;
+            }
+            m_cmdBufState = CmdBufStateSubmitted;
+            return true;
+        }
+
         VkFence GetFence() const {
             if ((m_parent == nullptr) || (m_parentIndex < 0)) {
                 assert(!"Invalid PoolNode state!");
@@ -141,6 +165,38 @@ public:
             return m_parent->m_fenceSet.GetFence(m_parentIndex);
         }
 
+        // With the timeline semaphore of the pool, takes the value the submission of the command buffer signals,
+        // right before it is submitted: the submissions of a pool are made in the order of their values, by one
+        // thread at a time. 0 with the binary semaphores, whose values are ignored.
+        uint64_t AssignSignalValue() {
+            if ((m_parent == nullptr) || (m_parentIndex < 0)) {
+                assert(!"Invalid PoolNode state!");
+                return 0;
+            }
+            m_signalValue = m_parent->m_useTimelineSemaphore ?
+                                (m_parent->m_lastSignalValue.fetch_add(1, std::memory_order_relaxed) + 1) : 0;
+            return m_signalValue;
+        }
+
+        uint64_t GetSignalValue() const { return m_signalValue; }
+
+        // VK_SUCCESS once the submission is complete, VK_NOT_READY before
+        VkResult GetCompletionStatus() const {
+            if ((m_parent == nullptr) || (m_parentIndex < 0) || (m_vkDevCtx == nullptr)) {
+                assert(!"Invalid PoolNode state!");
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+            if (m_parent->m_useTimelineSemaphore) {
+                uint64_t value = 0;
+                VkResult result = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, GetSemaphore(), &value);
+                if (result != VK_SUCCESS) {
+                    return result;
+                }
+                return (value >= m_signalValue) ? VK_SUCCESS : VK_NOT_READY;
+            }
+            return m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, GetFence());
+        }
+
         VkResult SyncHostOnCmdBuffComplete(bool resetAfterWait = true,
                                            uint64_t timeoutNanosec = 100 * 1000 * 1000)
         {
@@ -148,6 +204,11 @@ public:
                 return VK_ERROR_INITIALIZATION_FAILED;
             }
 
+            if ((m_parent != nullptr) && m_parent->m_useTimelineSemaphore) {
+                // Nothing to reset, the next submission signals a greater value
+                return m_parent->WaitForSignalValue(m_signalValue, timeoutNanosec);
+            }
+
             VkFence cmdBufferCompleteFence = GetFence();
 
             if ((m_vkDevCtx == nullptr) || (cmdBufferCompleteFence == VK_NULL_HANDLE)) {
@@ -199,7 +260,8 @@ public:
                 assert(!"Invalid PoolNode state!");
                 return VK_NULL_HANDLE;
             }
-            return m_parent->m_semaphoreSet.GetSemaphore(m_parentIndex);
+            return m_parent->m_useTimelineSemaphore ? m_parent->m_semaphoreSet.GetSemaphore(0) :
+                                                      m_parent->m_semaphoreSet.GetSemaphore(m_parentIndex);
         }
 
         VkQueryPool GetQueryPool(uint32_t& queryIdx) const {
@@ -223,24 +285,33 @@ public:
         VkSharedBaseObj<VulkanCommandBufferPool> m_parent;
         int32_t                                  m_parentIndex;
         CmdBufState                              m_cmdBufState;
+        uint64_t                                 m_signalValue; // of the last submission, with the timeline semaphore
     };
 
     static constexpr size_t maxPoolNodes = 64;
+    static constexpr uint32_t maxCommandPools = 8;
 
     VulkanCommandBufferPool()
         : m_vkDevCtx()
         , m_refCount()
         , m_queueMutex()
+        , m_poolId(++s_nextPoolId)
         , m_poolSize(0)
-        , m_nextNodeToUse(0)
-        , m_availablePoolNodes(0UL)
+        , m_numCommandPools(1)
+        , m_numSharedCommandPools(0)
+        , m_commandPoolThreads()
         , m_queueFamilyIndex((uint32_t)-1)
         , m_commandBuffersSet()
         , m_semaphoreSet()
         , m_fenceSet()
         , m_queryPoolSet()
+        , m_useTimelineSemaphore(false)
+        , m_lastSignalValue(0)
         , m_poolNodes(maxPoolNodes)
     {
+        for (uint32_t poolIndex = 0; poolIndex < maxCommandPools; poolIndex++) {
+            m_nextNodeToUse[poolIndex].store(0, std::memory_order_relaxed);
+        }
     }
 
     static VkResult Create(const VulkanDeviceContext* vkDevCtx,
@@ -267,7 +338,9 @@ public:
                        bool                         createQueryPool = false, // must have a valid pVideoProfile
                        const void*                  pNext           = nullptr,
                        bool                         createSemaphores = false,
-                       bool                         createFences = true);
+                       bool                         createFences = true,
+                       uint32_t                     numCommandPools = 1,
+                       bool                         useTimelineSemaphore = false);
 
     void Deinit();
 
@@ -287,22 +360,47 @@ public:
         return m_poolNodes.size();
     }
 
+    // From the command pool of the calling thread
     bool GetAvailablePoolNode(VkSharedBaseObj<PoolNode>&  poolNode);
 
+    // From the given command pool, for a pipeline stage that records from a command pool of its own.
+    // The nodes of a command pool must not be recorded from more than one thread at a time.
+    bool GetAvailablePoolNode(VkSharedBaseObj<PoolNode>&  poolNode, uint32_t commandPoolIndex);
+
     bool ReleasePoolNodeToPool(uint32_t poolNodeIndex);
 
+    uint32_t GetNumCommandPools() const { return m_numCommandPools; }
+
+    // With useTimelineSemaphore, the submissions of all the nodes signal a single timeline semaphore with increasing
+    // values, instead of a binary semaphore and a fence per node, if the device supports it
+    bool UsesTimelineSemaphore() const { return m_useTimelineSemaphore; }
+
+    // Waits for all the submissions up to the one that signals the value, with a single wait
+    VkResult WaitForSignalValue(uint64_t signalValue, uint64_t timeoutNanosec) const;
+
+private:
+    uint32_t GetThreadCommandPoolIndex();
+
 private:
+    static std::atomic<uint64_t> s_nextPoolId;
+
     const VulkanDeviceContext* m_vkDevCtx;
     std::atomic<int32_t>       m_refCount;
-    std::mutex                 m_queueMutex;
+    std::mutex                 m_queueMutex; // for Configure(), Deinit() and a thread taking a command pool
+    const uint64_t             m_poolId;     // unique for the pools of the process, unlike their addresses
     uint32_t                   m_poolSize;
-    uint32_t                   m_nextNodeToUse;
-    uint64_t                   m_availablePoolNodes;
+    uint32_t                   m_numCommandPools;
+    uint32_t                   m_numSharedCommandPools; // handed out once all of them were taken by a thread
+    std::thread::id            m_commandPoolThreads[maxCommandPools]; // of the threads of GetAvailablePoolNode()
+    std::atomic<uint32_t>      m_nextNodeToUse[maxCommandPools];
+    VulkanAtomicBitMask        m_availablePoolNodes[maxCommandPools];
     uint32_t                   m_queueFamilyIndex;
     VulkanCommandBuffersSet    m_commandBuffersSet;
     VulkanSemaphoreSet         m_semaphoreSet;
     VulkanFenceSet             m_fenceSet;
     VulkanQueryPoolSet         m_queryPoolSet;
+    bool                       m_useTimelineSemaphore;
+    std::atomic<uint64_t>      m_lastSignalValue;
     std::vector<PoolNode>      m_poolNodes;
 };
 
@@ -18,35 +18,53 @@
 
 VkResult VulkanCommandBuffersSet::CreateCommandBufferPool(const VulkanDeviceContext* vkDevCtx,
                                                           uint32_t queueFamilyIndex,
-                                                          uint32_t maxCommandBuffersCount)
+                                                          uint32_t maxCommandBuffersCount,
+                                                          uint32_t numCommandPools)
 {
     DestroyCommandBuffer();
     DestroyCommandBufferPool();
 
+    if ((numCommandPools == 0) || (numCommandPools > maxCommandBuffersCount)) {
+        numCommandPools = 1;
+    }
+
     m_vkDevCtx = vkDevCtx;
      // -----------------------------------------------
-     // Create a pool of command buffers to allocate command buffer from
+     // Create the pools of command buffers to allocate command buffer from
      VkCommandPoolCreateInfo cmdPoolCreateInfo = VkCommandPoolCreateInfo();
      cmdPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
      cmdPoolCreateInfo.pNext = nullptr;
      cmdPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
      cmdPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
-     VkResult result = m_vkDevCtx->CreateCommandPool(*m_vkDevCtx, &cmdPoolCreateInfo, nullptr, &m_cmdPool);
-     if (result != VK_SUCCESS) {
-         assert(!"ERROR: Can't allocate command buffer pool");
-         return result;
+     VkResult result = VK_SUCCESS;
+     m_cmdPools.resize(numCommandPools, VK_NULL_HANDLE);
+     for (uint32_t poolIndex = 0; poolIndex < numCommandPools; poolIndex++) {
+         result = m_vkDevCtx->CreateCommandPool(*m_vkDevCtx, &cmdPoolCreateInfo, nullptr, &m_cmdPools[poolIndex]);
+         if (result != VK_SUCCESS) {
+             assert(!"ERROR: Can't allocate command buffer pool");
+             return result;
+         }
      }
 
-     m_cmdBuffer.resize(maxCommandBuffersCount);
-     VkCommandBufferAllocateInfo cmdBufferCreateInfo = VkCommandBufferAllocateInfo();
-     cmdBufferCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-     cmdBufferCreateInfo.pNext = nullptr;
-     cmdBufferCreateInfo.commandPool = m_cmdPool;
-     cmdBufferCreateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-     cmdBufferCreateInfo.commandBufferCount = maxCommandBuffersCount;
-     result = m_vkDevCtx->AllocateCommandBuffers(*m_vkDevCtx, &cmdBufferCreateInfo, m_cmdBuffer.data());
-     if (result != VK_SUCCESS) {
-         assert(!"ERROR: Can't get command buffer");
+     // The command buffers of each pool are interleaved, to be found with GetCommandPool(bufferIndex)
+     m_cmdBuffer.assign(maxCommandBuffersCount, VK_NULL_HANDLE);
+     std::vector<VkCommandBuffer> poolCmdBuffers(maxCommandBuffersCount);
+     for (uint32_t poolIndex = 0; poolIndex < numCommandPools; poolIndex++) {
+         const uint32_t poolCmdBuffersCount = (maxCommandBuffersCount - poolIndex + numCommandPools - 1) / numCommandPools;
+         VkCommandBufferAllocateInfo cmdBufferCreateInfo = VkCommandBufferAllocateInfo();
+         cmdBufferCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+         cmdBufferCreateInfo.pNext = nullptr;
+         cmdBufferCreateInfo.commandPool = m_cmdPools[poolIndex];
+         cmdBufferCreateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+         cmdBufferCreateInfo.commandBufferCount = poolCmdBuffersCount;
+         result = m_vkDevCtx->AllocateCommandBuffers(*m_vkDevCtx, &cmdBufferCreateInfo, poolCmdBuffers.data());
+         if (result != VK_SUCCESS) {
+             assert(!"ERROR: Can't get command buffer");
+             return result;
+         }
+         for (uint32_t i = 0; i < poolCmdBuffersCount; i++) {
+             m_cmdBuffer[poolIndex + (i * numCommandPools)] = poolCmdBuffers[i];
+         }
      }
      return result;
 }
@@ -26,12 +26,15 @@ public:
 
     VulkanCommandBuffersSet()
         :m_vkDevCtx(),
-        m_cmdPool(),
+        m_cmdPools(),
         m_cmdBuffer(1)
         {}
 
+    // The command buffer i is allocated from the command pool (i % numCommandPools). The command buffers of
+    // different command pools can be recorded on different threads at the same time.
     VkResult CreateCommandBufferPool(const VulkanDeviceContext* vkDevCtx, uint32_t  queueFamilyIndex,
-                                     uint32_t maxCommandBuffersCount = 1);
+                                     uint32_t maxCommandBuffersCount = 1,
+                                     uint32_t numCommandPools = 1);
 
     ~VulkanCommandBuffersSet() {
         DestroyCommandBuffer();
@@ -40,20 +43,34 @@ public:
 
     void DestroyCommandBuffer() {
         if ((m_vkDevCtx != nullptr) && !m_cmdBuffer.empty()) {
-            m_vkDevCtx->FreeCommandBuffers(*m_vkDevCtx, m_cmdPool, (uint32_t)m_cmdBuffer.size(), m_cmdBuffer.data());
+            for (size_t bufferIndex = 0; bufferIndex < m_cmdBuffer.size(); bufferIndex++) {
+                if (m_cmdBuffer[bufferIndex] != VK_NULL_HANDLE) {
+                    m_vkDevCtx->FreeCommandBuffers(*m_vkDevCtx, GetCommandPool((uint32_t)bufferIndex),
+                                                   1, &m_cmdBuffer[bufferIndex]);
+                }
+            }
             m_cmdBuffer.clear();
         }
     }
 
     void DestroyCommandBufferPool() {
-        if (m_cmdPool) {
-           m_vkDevCtx->DestroyCommandPool(*m_vkDevCtx, m_cmdPool, nullptr);
-           m_cmdPool = VkCommandPool(0);
+        for (size_t poolIndex = 0; poolIndex < m_cmdPools.size(); poolIndex++) {
+            if (m_cmdPools[poolIndex]) {
+               m_vkDevCtx->DestroyCommandPool(*m_vkDevCtx, m_cmdPools[poolIndex], nullptr);
+            }
         }
+        m_cmdPools.clear();
     }
 
-    VkCommandPool GetCommandPool(uint32_t bufferIndex = 0) {
-        return m_cmdPool;
+    VkCommandPool GetCommandPool(uint32_t bufferIndex = 0) const {
+        if (m_cmdPools.empty()) {
+            return VK_NULL_HANDLE;
+        }
+        return m_cmdPools[bufferIndex % m_cmdPools.size()];
+    }
+
+    uint32_t GetNumCommandPools() const {
+        return (uint32_t)m_cmdPools.size();
     }
 
     const VkCommandBuffer* GetCommandBuffer(uint32_t bufferIndex = 0) const {
@@ -67,7 +84,7 @@ public:
 
 private:
     const VulkanDeviceContext*   m_vkDevCtx;
-    VkCommandPool                m_cmdPool;
+    std::vector<VkCommandPool>   m_cmdPools;
     std::vector<VkCommandBuffer> m_cmdBuffer;
 };
 
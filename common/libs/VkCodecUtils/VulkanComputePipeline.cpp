@@ -29,7 +29,8 @@ VkResult VulkanComputePipeline::CreatePipeline(const VulkanDeviceContext* vkDevC
 {
     m_vkDevCtx = vkDevCtx;
 
-    if (m_pipelineCache == VkPipelineCache(0)) {
+    // The cache of the device, persisted between the runs, when there is one
+    if ((m_vkDevCtx->GetPipelineCache() == VkPipelineCache(0)) && (m_pipelineCache == VkPipelineCache(0))) {
         // Create the pipeline cache
         VkPipelineCacheCreateInfo pipelineCacheInfo = VkPipelineCacheCreateInfo();
         pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
@@ -81,7 +82,9 @@ VkResult VulkanComputePipeline::CreatePipeline(const VulkanDeviceContext* vkDevC
 
     // Make sure we destroy the existing pipeline, if it were to exist.
     DestroyPipeline();
-    VkResult pipelineResult = m_vkDevCtx->CreateComputePipelines(*m_vkDevCtx, m_pipelineCache, 1,
+    const VkPipelineCache pipelineCache = (m_vkDevCtx->GetPipelineCache() != VkPipelineCache(0)) ?
+                                              m_vkDevCtx->GetPipelineCache() : m_pipelineCache;
+    VkResult pipelineResult = m_vkDevCtx->CreateComputePipelines(*m_vkDevCtx, pipelineCache, 1,
                                                                   &computePipelineCreateInfo,
                                                                   nullptr, &m_pipeline);
 
@@ -24,6 +24,61 @@ class VulkanDecodedFrame : public VulkanDisplayFrame {
 
 public:
     VulkanDecodedFrame() : VulkanDisplayFrame() {}
+
+    // The frames of a decoder with exported output images, for the consumers in other processes or APIs.
+    // A new file descriptor of the memory of the image, owned by the caller.
+    VkResult ExportImageFd(VkExternalMemoryHandleTypeFlagBits handleType, int* pFd) const
+    {
+        if (!imageView) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        return imageView->GetImageResource()->ExportFd(handleType, pFd);
+    }
+
+    // A sync file signaled once the frame is decoded, waited for by the consumer instead of frameCompleteSemaphore.
+    // Without a semaphore to export, the frame is waited for here and the file is -1, already signaled.
+    VkResult ExportFrameCompleteSyncFd(const VulkanDeviceContext* vkDevCtx, int* pFd)
+    {
+        *pFd = -1;
+        const uint64_t fenceTimeout = 100ULL * 1000 * 1000 * 1000; // 100 seconds
+        if ((frameCompleteSemaphore != VK_NULL_HANDLE) &&
+                (vkDevCtx->FindRequiredDeviceExtension(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME) != nullptr)) {
+            const VkSemaphoreGetFdInfoKHR getFdInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR, nullptr,
+                                                        frameCompleteSemaphore,
+                                                        VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT };
+            VkResult result = vkDevCtx->GetSemaphoreFdKHR(*vkDevCtx, &getFdInfo, pFd);
+            if (result == VK_SUCCESS) {
+                // The export is the wait on the semaphore
+                frameCompleteSemaphore = VK_NULL_HANDLE;
+            }
+            return result;
+        } else if (frameCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+            const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                                   &frameCompleteTimelineSemaphore, &frameCompleteTimelineValue };
+            return vkDevCtx->WaitSemaphores(*vkDevCtx, &waitInfo, fenceTimeout);
+        } else if (frameCompleteFence != VK_NULL_HANDLE) {
+            return vkDevCtx->WaitForFences(*vkDevCtx, 1, &frameCompleteFence, true, fenceTimeout);
+        }
+        return VK_SUCCESS;
+    }
+
+    // The sync file the consumer signals once done with the image, -1 if it already is. The decoder waits for it
+    // before decoding to the image again, once the frame is released.
+    VkResult ImportConsumerDoneSyncFd(const VulkanDeviceContext* vkDevCtx, int fd)
+    {
+        if (frameConsumerDoneSemaphore == VK_NULL_HANDLE) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        const VkImportSemaphoreFdInfoKHR importInfo = { VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR, nullptr,
+                                                        frameConsumerDoneSemaphore,
+                                                        VK_SEMAPHORE_IMPORT_TEMPORARY_BIT,
+                                                        VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT, fd };
+        VkResult result = vkDevCtx->ImportSemaphoreFdKHR(*vkDevCtx, &importInfo);
+        if (result == VK_SUCCESS) {
+            hasConsummerSignalSemaphore = true;
+        }
+        return result;
+    }
 };
 
 #endif /* _VKCODECUTILS_VULKANDECODEDFRAME_H_ */
@@ -0,0 +1,521 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include "VkCodecUtils/Helpers.h"
+#include "VkCodecUtils/VulkanDecodedFrameFanOut.h"
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+
+static const uint64_t frameCompleteTimeout = 100ULL * 1000 * 1000 * 1000; // 100 seconds
+
+VkResult VulkanDecodedFrameFanOut::Create(const VulkanDeviceContext* vkDevCtx,
+                                          VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                                          const std::vector<OutputConfig>& outputs,
+                                          uint32_t maxFramesInFlight,
+                                          VkSharedBaseObj<VulkanDecodedFrameFanOut>& fanOut)
+{
+    if (outputs.empty() || (vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VulkanDecodedFrameFanOut> decodedFrameFanOut(
+            new VulkanDecodedFrameFanOut(vkDevCtx, decoderQueue, outputs));
+    if (!decodedFrameFanOut) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = decodedFrameFanOut->Init(std::max<uint32_t>(maxFramesInFlight, 1));
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    fanOut = decodedFrameFanOut;
+    return VK_SUCCESS;
+}
+
+VulkanDecodedFrameFanOut::VulkanDecodedFrameFanOut(const VulkanDeviceContext* vkDevCtx,
+                                                   VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                                                   const std::vector<OutputConfig>& outputs)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_decoderQueue(decoderQueue)
+    , m_outputs(outputs)
+    , m_filters(outputs.size())
+    , m_commandPool()
+    , m_completeTimelineSemaphore()
+    , m_frameSerial(0)
+    , m_slots()
+    , m_outputQueues(outputs.size(), OutputQueue { std::deque<OutputFrame>(), false, 0 })
+    , m_mutex()
+    , m_slotReleasedCondition()
+    , m_frameReadyCondition()
+    , m_numFrames(0)
+    , m_consumerWaitMs(0.0)
+{
+}
+
+VkResult VulkanDecodedFrameFanOut::Init(uint32_t maxFramesInFlight)
+{
+    VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolInfo.queueFamilyIndex = m_vkDevCtx->GetComputeQueueFamilyIdx();
+    VkResult result = m_vkDevCtx->CreateCommandPool(*m_vkDevCtx, &cmdPoolInfo, nullptr, &m_commandPool);
+    if (result != VK_SUCCESS) {
+        m_commandPool = VK_NULL_HANDLE;
+        return result;
+    }
+
+    VkSemaphoreTypeCreateInfo timelineCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineCreateInfo.initialValue = 0; // the first frame signals 1
+    const VkSemaphoreCreateInfo semaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &timelineCreateInfo, 0 };
+    result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &semaphoreCreateInfo, nullptr, &m_completeTimelineSemaphore);
+    if (result != VK_SUCCESS) {
+        m_completeTimelineSemaphore = VK_NULL_HANDLE;
+        return result;
+    }
+
+    VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    cmdInfo.commandPool = m_commandPool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = 1;
+    m_slots.resize(maxFramesInFlight);
+    for (Slot& slot : m_slots) {
+        slot.commandBuffer = VK_NULL_HANDLE;
+        slot.consumersPending = 0;
+        slot.decodedFrameHeld = false;
+        slot.completeValue = 0;
+        result = m_vkDevCtx->AllocateCommandBuffers(*m_vkDevCtx, &cmdInfo, &slot.commandBuffer);
+        if (result != VK_SUCCESS) {
+            slot.commandBuffer = VK_NULL_HANDLE;
+            return result;
+        }
+
+        // The images are written by the storage image views of their planes
+        slot.outputImageViews.resize(m_outputs.size());
+        for (size_t output = 0; output < m_outputs.size(); output++) {
+            const OutputConfig& outputConfig = m_outputs[output];
+            const bool isMultiPlanar = (YcbcrVkFormatInfo(outputConfig.format) != nullptr);
+            VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+            imageCreateInfo.flags = isMultiPlanar ? (VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) : 0;
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = outputConfig.format;
+            imageCreateInfo.extent = { outputConfig.extent.width, outputConfig.extent.height, 1 };
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VkSharedBaseObj<VkImageResource> imageResource;
+            result = VkImageResource::Create(m_vkDevCtx, &imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                             imageResource);
+            if (result != VK_SUCCESS) {
+                return result;
+            }
+            VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            result = VkImageResourceView::Create(m_vkDevCtx, imageResource, subresourceRange,
+                                                 slot.outputImageViews[output]);
+            if (result != VK_SUCCESS) {
+                return result;
+            }
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+VulkanDecodedFrameFanOut::~VulkanDecodedFrameFanOut()
+{
+    if (m_completeTimelineSemaphore != VK_NULL_HANDLE) {
+        // The command buffers and the images are released after the last submission
+        const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                               &m_completeTimelineSemaphore, &m_frameSerial };
+        m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, frameCompleteTimeout);
+        m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_completeTimelineSemaphore, nullptr);
+        m_completeTimelineSemaphore = VK_NULL_HANDLE;
+    }
+
+    for (Slot& slot : m_slots) {
+        // The frames of the consumers that didn't release them
+        if (slot.decodedFrameHeld) {
+            m_decoderQueue->ReleaseFrame(&slot.frame);
+            slot.decodedFrameHeld = false;
+        }
+        if (slot.commandBuffer != VK_NULL_HANDLE) {
+            m_vkDevCtx->FreeCommandBuffers(*m_vkDevCtx, m_commandPool, 1, &slot.commandBuffer);
+            slot.commandBuffer = VK_NULL_HANDLE;
+        }
+    }
+    if (m_commandPool != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroyCommandPool(*m_vkDevCtx, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+}
+
+VkResult VulkanDecodedFrameFanOut::InitFilters(VkFormat inputFormat)
+{
+    // The color description of the stream is not known past the decoder queue, BT.709 narrow range is assumed
+    const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
+               VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+               nullptr,
+               inputFormat,
+               VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709,
+               VK_SAMPLER_YCBCR_RANGE_ITU_NARROW,
+               { VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY
+               },
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_FILTER_LINEAR,
+               false
+               };
+
+    static const VkSamplerCreateInfo samplerInfo = {
+               VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+               nullptr,
+               0,
+               VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+               VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+               // mipLodBias  anisotropyEnable  maxAnisotropy  compareEnable      compareOp         minLod  maxLod          borderColor
+               // unnormalizedCoordinates
+               0.0, false, 0.00, false, VK_COMPARE_OP_NEVER, 0.0, 16.0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false
+    };
+
+    const YcbcrPrimariesConstants ycbcrPrimariesConstants = GetYcbcrPrimariesConstants(YcbcrBtStandardBt709);
+
+    for (size_t output = 0; output < m_outputs.size(); output++) {
+        VkResult result = VulkanFilterYuvCompute::Create(m_vkDevCtx,
+                                                         m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                                         0,
+                                                         VulkanFilterYuvCompute::YCBCRFUSED,
+                                                         (uint32_t)m_slots.size(),
+                                                         inputFormat,
+                                                         m_outputs[output].format,
+                                                         &ycbcrConversionCreateInfo,
+                                                         &ycbcrPrimariesConstants,
+                                                         &samplerInfo,
+                                                         m_filters[output]);
+        if (result != VK_SUCCESS) {
+            std::cerr << "Fan-out: the filter of output " << output << " can't convert to format "
+                      << m_outputs[output].format << std::endl;
+            return result;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+VkResult VulkanDecodedFrameFanOut::SubmitFrame(Slot& slot)
+{
+    const VulkanDecodedFrame& frame = slot.frame;
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    uint64_t waitValue = 0;
+    if (frame.frameCompleteSemaphore != VK_NULL_HANDLE) {
+        waitSemaphore = frame.frameCompleteSemaphore;
+    } else if (frame.frameCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+        waitSemaphore = frame.frameCompleteTimelineSemaphore;
+        waitValue = frame.frameCompleteTimelineValue;
+    } else if (frame.frameCompleteFence != VK_NULL_HANDLE) {
+        VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &frame.frameCompleteFence, true,
+                                                    frameCompleteTimeout);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    VkCommandBuffer cmdBuf = slot.commandBuffer;
+    VkResult result = m_vkDevCtx->ResetCommandBuffer(cmdBuf, VkCommandBufferResetFlags());
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    result = m_vkDevCtx->BeginCommandBuffer(cmdBuf, &beginInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The decoded image, read by all the outputs, then the output images, overwritten
+    const uint32_t numOutputs = (uint32_t)m_outputs.size();
+    std::vector<VkImageMemoryBarrier2KHR> imageBarriers(1 + numOutputs);
+    for (uint32_t i = 0; i < imageBarriers.size(); i++) {
+        const VkImageResourceView* imageView = (i == 0) ? frame.imageView.Get() : slot.outputImageViews[i - 1].Get();
+        imageBarriers[i] = {
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+                nullptr, // const void*     pNext
+                VK_PIPELINE_STAGE_2_NONE_KHR, // srcStageMask, the decode is waited on by the submission
+                0, // VkAccessFlags2KHR        srcAccessMask
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+                (i == 0) ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR : VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+                (i == 0) ? VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR : VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout   oldLayout
+                VK_IMAGE_LAYOUT_GENERAL, // VkImageLayout   newLayout
+                VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+                VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+                imageView->GetImageResource()->GetImage(), // VkImage         image;
+                {
+                    // VkImageSubresourceRange   subresourceRange
+                    VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                    0, // uint32_t           baseMipLevel
+                    1, // uint32_t           levelCount
+                    (i == 0) ? frame.imageLayerIndex : 0, // uint32_t           baseArrayLayer
+                    1, // uint32_t           layerCount;
+                },
+        };
+    }
+
+    VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        (uint32_t)imageBarriers.size(),
+        imageBarriers.data(),
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    // The displayed rectangle of the decoded picture is scaled to each output
+    VkVideoPictureResourceInfoKHR inputResourceInfo = { VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR };
+    inputResourceInfo.codedExtent = { (uint32_t)frame.displayWidth, (uint32_t)frame.displayHeight };
+    inputResourceInfo.baseArrayLayer = frame.imageLayerIndex;
+    inputResourceInfo.imageViewBinding = frame.imageView->GetImageView();
+    for (uint32_t output = 0; output < numOutputs; output++) {
+        VkVideoPictureResourceInfoKHR outputResourceInfo = { VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR };
+        outputResourceInfo.codedExtent = m_outputs[output].extent;
+        outputResourceInfo.imageViewBinding = slot.outputImageViews[output]->GetImageView();
+        VulkanFilterYuvCompute* pFilter = static_cast<VulkanFilterYuvCompute*>(m_filters[output].Get());
+        result = pFilter->RecordCommandBuffer(cmdBuf, frame.imageView, &inputResourceInfo,
+                                              slot.outputImageViews[output], &outputResourceInfo);
+        if (result != VK_SUCCESS) {
+            m_vkDevCtx->EndCommandBuffer(cmdBuf);
+            return result;
+        }
+    }
+
+    // The decoded image goes back to the layout of the decoder, the consumers wait on the timeline semaphore
+    // which makes the shader writes of the outputs available
+    imageBarriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarriers[0].srcAccessMask = 0;
+    imageBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarriers[0].dstAccessMask = 0;
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    result = m_vkDevCtx->EndCommandBuffer(cmdBuf);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The next decode into the image waits for the outputs to be read from it
+    const uint64_t completeValue = m_frameSerial + 1;
+    VkSemaphore signalSemaphores[2] = { m_completeTimelineSemaphore, frame.frameConsumerDoneSemaphore };
+    const uint64_t signalValues[2] = { completeValue, 0 };
+    const uint32_t signalSemaphoreCount = (frame.frameConsumerDoneSemaphore != VK_NULL_HANDLE) ? 2 : 1;
+    const VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const uint32_t waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineSubmitInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+    timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+    timelineSubmitInfo.signalSemaphoreValueCount = signalSemaphoreCount;
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineSubmitInfo };
+    submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = &waitSemaphore;
+    submitInfo.pWaitDstStageMask = &waitDstStageMask;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuf;
+    submitInfo.signalSemaphoreCount = signalSemaphoreCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+    result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::COMPUTE, 0, 1, &submitInfo, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_frameSerial = completeValue;
+    slot.completeValue = completeValue;
+    if (frame.frameConsumerDoneSemaphore != VK_NULL_HANDLE) {
+        slot.frame.hasConsummerSignalSemaphore = true;
+    }
+    return VK_SUCCESS;
+}
+
+void VulkanDecodedFrameFanOut::ReleaseDecodedFrames(bool all)
+{
+    std::vector<Slot*> releasedSlots;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (all) {
+            m_slotReleasedCondition.wait(lock, [this]() {
+                for (const Slot& slot : m_slots) {
+                    if (slot.consumersPending > 0) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+        for (Slot& slot : m_slots) {
+            if (slot.decodedFrameHeld && (slot.consumersPending == 0)) {
+                slot.decodedFrameHeld = false;
+                releasedSlots.push_back(&slot);
+            }
+        }
+    }
+
+    // The consumers are done with these slots. The decoder reuses the images once the submissions reading them
+    // are done, which it waits for on the device.
+    for (Slot* pSlot : releasedSlots) {
+        m_decoderQueue->ReleaseFrame(&pSlot->frame);
+        pSlot->frame.Reset();
+    }
+}
+
+int32_t VulkanDecodedFrameFanOut::Run()
+{
+    const uint32_t numOutputs = (uint32_t)m_outputs.size();
+    uint32_t slotIndex = 0;
+    bool endOfStream = false;
+    int32_t ret = 0;
+    while (!endOfStream) {
+
+        // The slots are used round-robin, the one of the oldest frame is released by the slowest consumer
+        Slot& slot = m_slots[slotIndex];
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (slot.consumersPending > 0) {
+                const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+                m_slotReleasedCondition.wait(lock, [&slot]() { return slot.consumersPending == 0; });
+                m_consumerWaitMs += std::chrono::duration<double, std::milli>(
+                                        std::chrono::steady_clock::now() - waitStart).count();
+            }
+        }
+        // The decoder queue is only used by this thread, the frames released by the consumers go back to it here
+        ReleaseDecodedFrames(false);
+
+        VulkanDecodedFrame frame;
+        m_decoderQueue->GetNextFrame(&frame, &endOfStream);
+        // The last frame of maxFrameCount comes with -1
+        if ((frame.pictureIndex == -1) || !frame.imageView) {
+            continue;
+        }
+
+        if (!m_filters[0]) {
+            VkResult result = InitFilters(frame.imageView->GetImageResource()->GetImageCreateInfo().format);
+            if (result != VK_SUCCESS) {
+                m_decoderQueue->ReleaseFrame(&frame);
+                ret = -1;
+                break;
+            }
+        }
+
+        slot.frame = frame;
+        VkResult result = SubmitFrame(slot);
+        if (result != VK_SUCCESS) {
+            std::cerr << "Fan-out: the frame " << frame.displayOrder << " failed, result: " << result << std::endl;
+            m_decoderQueue->ReleaseFrame(&slot.frame);
+            slot.frame.Reset();
+            ret = -1;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.consumersPending = numOutputs;
+            slot.decodedFrameHeld = true;
+            for (uint32_t output = 0; output < numOutputs; output++) {
+                OutputFrame outputFrame;
+                outputFrame.slot = slotIndex;
+                outputFrame.displayOrder = frame.displayOrder;
+                outputFrame.timestamp = frame.timestamp;
+                outputFrame.imageView = slot.outputImageViews[output];
+                outputFrame.completeSemaphore = m_completeTimelineSemaphore;
+                outputFrame.completeValue = slot.completeValue;
+                m_outputQueues[output].frames.push_back(outputFrame);
+            }
+            m_numFrames++;
+        }
+        m_frameReadyCondition.notify_all();
+
+        slotIndex = (slotIndex + 1) % (uint32_t)m_slots.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (OutputQueue& outputQueue : m_outputQueues) {
+            outputQueue.endOfStream = true;
+        }
+    }
+    m_frameReadyCondition.notify_all();
+
+    // The consumers done with the last frames
+    ReleaseDecodedFrames(true);
+    return ((ret == 0) && (m_numFrames > 0)) ? 0 : -1;
+}
+
+bool VulkanDecodedFrameFanOut::AcquireFrame(uint32_t outputIndex, OutputFrame& outputFrame)
+{
+    assert(outputIndex < m_outputQueues.size());
+    OutputQueue& outputQueue = m_outputQueues[outputIndex];
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frameReadyCondition.wait(lock, [&outputQueue]() {
+        return !outputQueue.frames.empty() || outputQueue.endOfStream;
+    });
+    if (outputQueue.frames.empty()) {
+        return false;
+    }
+    outputFrame = outputQueue.frames.front();
+    outputQueue.frames.pop_front();
+    return true;
+}
+
+void VulkanDecodedFrameFanOut::ReleaseFrame(uint32_t outputIndex, const OutputFrame& outputFrame)
+{
+    assert(outputIndex < m_outputQueues.size());
+    assert(outputFrame.slot < m_slots.size());
+    Slot& slot = m_slots[outputFrame.slot];
+    std::lock_guard<std::mutex> lock(m_mutex);
+    assert(slot.consumersPending > 0);
+    m_outputQueues[outputIndex].numReleased++;
+    if (--slot.consumersPending == 0) {
+        // The last consumer of the frame, the decode thread hands it back to the decoder
+        m_slotReleasedCondition.notify_one();
+    }
+}
+
+void VulkanDecodedFrameFanOut::PrintStats() const
+{
+    std::cout << "Fan-out: " << m_numFrames << " frames to " << m_outputs.size() << " outputs, the decode waited "
+              << m_consumerWaitMs << " ms for the consumers" << std::endl;
+    for (size_t output = 0; output < m_outputs.size(); output++) {
+        std::cout << "\tOutput " << output << ": " << m_outputs[output].extent.width << "x"
+                  << m_outputs[output].extent.height << " format " << m_outputs[output].format << ", "
+                  << m_outputQueues[output].numReleased << " frames released" << std::endl;
+    }
+}
@@ -0,0 +1,134 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANDECODEDFRAMEFANOUT_H_
+#define _VKCODECUTILS_VULKANDECODEDFRAMEFANOUT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VkVideoQueue.h"
+#include "VkCodecUtils/VulkanDecodedFrame.h"
+#include "VkCodecUtils/VulkanFilterYuvCompute.h"
+
+// Delivers each decoded frame to several consumers, e.g. a display, an encoder and an analytics pass, each with
+// its own size and format. The outputs of a frame are recorded into one command buffer, a fused crop, scale and
+// color conversion dispatch per output, submitted once to the compute queue. Each output has its own queue of
+// frames, consumed on its own thread. The decoded frame is only released to the decoder once every consumer has
+// released its output of it, by the decode thread, before it takes the next frame. The outputs of maxFramesInFlight frames are allocated up front, the decode waits for
+// the slowest consumer while they are all in use.
+class VulkanDecodedFrameFanOut : public VkVideoRefCountBase {
+public:
+
+    struct OutputConfig {
+        VkFormat   format;  // RGBA, or 2-plane YCbCr
+        VkExtent2D extent;
+    };
+
+    // The output of a frame, in VK_IMAGE_LAYOUT_GENERAL once completeValue is reached by completeSemaphore
+    struct OutputFrame {
+        uint32_t                             slot;
+        uint64_t                             displayOrder;
+        uint64_t                             timestamp;
+        VkSharedBaseObj<VkImageResourceView> imageView;
+        VkSemaphore                          completeSemaphore; // timeline
+        uint64_t                             completeValue;
+    };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                           const std::vector<OutputConfig>& outputs,
+                           uint32_t maxFramesInFlight,
+                           VkSharedBaseObj<VulkanDecodedFrameFanOut>& fanOut);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the fan-out if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    uint32_t GetNumOutputs() const { return (uint32_t)m_outputs.size(); }
+
+    // Decodes and fans out the frames to the end of the stream, on the calling thread, then ends the output
+    // queues. Returns once every frame is released by all the consumers.
+    int32_t Run();
+
+    // The next frame of the output, blocking. Returns false at the end of the stream.
+    bool AcquireFrame(uint32_t outputIndex, OutputFrame& outputFrame);
+
+    // The consumer is done with the output image on the device, e.g. its submission reading it has completed
+    void ReleaseFrame(uint32_t outputIndex, const OutputFrame& outputFrame);
+
+    // The frames fanned out and the time the decode waited for the consumers
+    void PrintStats() const;
+
+private:
+
+    struct Slot {
+        VulkanDecodedFrame                                frame;
+        VkCommandBuffer                                   commandBuffer;
+        std::vector<VkSharedBaseObj<VkImageResourceView>> outputImageViews; // per output
+        uint32_t                                          consumersPending; // yet to release the frame
+        bool                                              decodedFrameHeld; // not released to the decoder yet
+        uint64_t                                          completeValue;
+    };
+
+    struct OutputQueue {
+        std::deque<OutputFrame> frames;
+        bool                    endOfStream;
+        uint64_t                numReleased;
+    };
+
+    VulkanDecodedFrameFanOut(const VulkanDeviceContext* vkDevCtx,
+                             VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                             const std::vector<OutputConfig>& outputs);
+    virtual ~VulkanDecodedFrameFanOut();
+
+    VkResult Init(uint32_t maxFramesInFlight);
+    VkResult InitFilters(VkFormat inputFormat);
+    VkResult SubmitFrame(Slot& slot);
+    void     ReleaseDecodedFrames(bool all);
+
+private:
+    std::atomic<int32_t>                              m_refCount;
+    const VulkanDeviceContext*                        m_vkDevCtx;
+    VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>> m_decoderQueue;
+    const std::vector<OutputConfig>                   m_outputs;
+    std::vector<VkSharedBaseObj<VulkanFilter>>        m_filters;    // per output, once the input format is known
+    VkCommandPool                                     m_commandPool;
+    VkSemaphore                                       m_completeTimelineSemaphore;
+    uint64_t                                          m_frameSerial;
+    std::vector<Slot>                                 m_slots;
+    std::vector<OutputQueue>                          m_outputQueues;
+    std::mutex                                        m_mutex;
+    std::condition_variable                           m_slotReleasedCondition;
+    std::condition_variable                           m_frameReadyCondition;
+    uint64_t                                          m_numFrames;
+    double                                            m_consumerWaitMs;
+};
+
+#endif /* _VKCODECUTILS_VULKANDECODEDFRAMEFANOUT_H_ */
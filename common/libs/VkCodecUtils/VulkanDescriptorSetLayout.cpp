@@ -83,7 +83,7 @@ VkResult VulkanDescriptorSetLayout::CreateDescriptorSet(const VulkanDeviceContex
     if (autoSelectdescriptorSetLayoutCreateFlags) {
         if (m_vkDevCtx->FindRequiredDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) {
             descriptorSetLayoutCreateFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
-        } else if (m_vkDevCtx->FindRequiredDeviceExtension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)){
+        } else if (m_vkDevCtx->GetDescriptorBufferSupport()) {
             descriptorSetLayoutCreateFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
         } else {
             descriptorSetLayoutCreateFlags = 0;
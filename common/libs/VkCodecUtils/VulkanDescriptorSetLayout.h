@@ -267,20 +267,31 @@ public:
                                                                pDescriptorWrite->dstBinding,
                                                                &dstBindingOffset);
 
-            size_t descriptorSize = m_descriptorBufferProperties.storageImageDescriptorSize;
+            size_t descriptorSize = 0;
             switch (pDescriptorWrite->descriptorType) {
             case VK_DESCRIPTOR_TYPE_SAMPLER:
                 descriptorSize = m_descriptorBufferProperties.samplerDescriptorSize;
-                // fall through
+                break;
             case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
                 descriptorSize = m_descriptorBufferProperties.combinedImageSamplerDescriptorSize;
-                // fall through
+                break;
             case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
                 descriptorSize = m_descriptorBufferProperties.sampledImageDescriptorSize;
-                // fall through
+                break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                descriptorSize = m_descriptorBufferProperties.storageImageDescriptorSize;
+                break;
+            default:
+                break;
+            }
+
+            switch (pDescriptorWrite->descriptorType) {
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
             case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
             {
-                assert((dstBindingOffset + descriptorSize) < m_descriptorLayoutSize);
+                assert((dstBindingOffset + descriptorSize) <= m_descriptorLayoutSize);
 
                 VkDescriptorGetInfoEXT descriptorInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT };
                 descriptorInfo.type = pDescriptorWrite->descriptorType;
@@ -16,12 +16,16 @@
 
 #if !defined(VK_USE_PLATFORM_WIN32_KHR)
 #include <dlfcn.h>
+#include <unistd.h>
 #endif
 
 #include <cassert>
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include <array>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -30,6 +34,12 @@
 #include <algorithm>    // std::find_if
 #include "VkCodecUtils/Helpers.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanDeviceMemoryArena.h"
+#include "VkCodecUtils/VulkanVideoSharedImagePool.h"
+#include "VkCodecUtils/VulkanVideoSessionPool.h"
+#include "VkCodecUtils/VulkanQueueSubmitThread.h"
+#include "VkCodecUtils/VulkanVideoDecodeCommandBatch.h"
+#include "VkCodecUtils/VkThreadAffinity.h"
 
 #if !defined(VK_USE_PLATFORM_WIN32_KHR)
 PFN_vkGetInstanceProcAddr VulkanDeviceContext::LoadVk(VulkanLibraryHandleType &vulkanLibHandle,
@@ -124,7 +134,7 @@ VkResult VulkanDeviceContext::CheckAllInstanceLayers(bool verbose)
         if (name == nullptr) {
             break;
         }
-        std::cout << '\t' << name << std::endl;
+        if (verbose) std::cout << '\t' << name << std::endl;
         if (layer_names.find(name) == layer_names.end()) {
             std::cerr << "AssertAllInstanceLayers() ERROR: requested instance layer"
                     << name << " is missing!" << std::endl << std::flush;
@@ -247,15 +257,36 @@ static int DumpSoLibs()
 }
 #endif
 
-VkResult VulkanDeviceContext::InitVkInstance(const char * pAppName, bool verbose)
+static double MillisecondsSince(const std::chrono::steady_clock::time_point& startTime)
 {
-    VkResult result = CheckAllInstanceLayers(verbose);
-    if (result != VK_SUCCESS) {
-        return result;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+static uint32_t CountNames(const char* const* names)
+{
+    uint32_t count = 0;
+    while ((names != nullptr) && (names[count] != nullptr)) {
+        count++;
     }
-    result = CheckAllInstanceExtensions(verbose);
-    if (result != VK_SUCCESS) {
-        return result;
+    return count;
+}
+
+VkResult VulkanDeviceContext::InitVkInstance(const char * pAppName, bool verbose)
+{
+    VkResult result = VK_SUCCESS;
+    if (m_deviceCacheFileName.empty()) {
+        result = CheckAllInstanceLayers(verbose);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        result = CheckAllInstanceExtensions(verbose);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    } else {
+        // Checked when the instance can't be created with them
+        m_reqInstanceLayersSize = CountNames(m_reqInstanceLayers);
+        m_reqInstanceExtensionsSize = CountNames(m_reqInstanceExtensions);
     }
 
     VkApplicationInfo app_info = {};
@@ -273,6 +304,16 @@ VkResult VulkanDeviceContext::InitVkInstance(const char * pAppName, bool verbose
     instance_info.ppEnabledExtensionNames = m_reqInstanceExtensions;
 
     result = CreateInstance(&instance_info, nullptr, &m_instance);
+    if (!m_deviceCacheFileName.empty() &&
+            ((result == VK_ERROR_LAYER_NOT_PRESENT) || (result == VK_ERROR_EXTENSION_NOT_PRESENT))) {
+        // For the missing ones to be reported
+        m_reqInstanceLayersSize = 0;
+        m_reqInstanceExtensionsSize = 0;
+        if (CheckAllInstanceLayers(verbose) == VK_SUCCESS) {
+            CheckAllInstanceExtensions(verbose);
+        }
+        return result;
+    }
 
 #if !defined(VK_USE_PLATFORM_WIN32_KHR)
     // For debugging which .so libraries are loaded and in use
@@ -346,6 +387,50 @@ VkResult VulkanDeviceContext::InitPhysicalDevice(const VkQueueFlags requestQueue
                                                  const VkQueueFlags requestVideoEncodeQueueMask,
                                                  const VkVideoCodecOperationFlagsKHR requestVideoEncodeQueueOperations)
 {
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    m_physicalDeviceRequest.queueTypes = requestQueueTypes;
+    m_physicalDeviceRequest.pWsiDisplay = pWsiDisplay;
+    m_physicalDeviceRequest.videoDecodeQueueMask = requestVideoDecodeQueueMask;
+    m_physicalDeviceRequest.videoDecodeQueueOperations = requestVideoDecodeQueueOperations;
+    m_physicalDeviceRequest.videoEncodeQueueMask = requestVideoEncodeQueueMask;
+    m_physicalDeviceRequest.videoEncodeQueueOperations = requestVideoEncodeQueueOperations;
+
+    VkResult result = VK_SUCCESS;
+    m_physicalDeviceFromCache = !m_deviceCacheFileName.empty() && LoadDeviceCache();
+    if (!m_physicalDeviceFromCache) {
+        result = EnumeratePhysicalDevices();
+        if ((result == VK_SUCCESS) && !m_deviceCacheFileName.empty()) {
+            SaveDeviceCache();
+        }
+    }
+
+    if (result == VK_SUCCESS) {
+        VkPhysicalDeviceProperties props;
+        GetPhysicalDeviceProperties(m_physDevice, &props);
+        std::cout << "*** Selected Vulkan physical device with name: " << props.deviceName << std::hex
+                  << ", vendor ID: " << props.vendorID << ", and device ID: " << props.deviceID << std::dec
+                  << ", Num Decode Queues: " << m_videoDecodeNumQueues
+                  << ", Num Encode Queues: " << m_videoEncodeNumQueues
+                  << (m_physicalDeviceFromCache ? ", from the device cache" : "")
+                  << " ***" << std::endl << std::flush;
+
+        ReportPciTopology();
+    }
+
+    m_startupTimesMs[STARTUP_PHYSICAL_DEVICE] = MillisecondsSince(startTime);
+    return result;
+}
+
+VkResult VulkanDeviceContext::EnumeratePhysicalDevices()
+{
+    const VkQueueFlags requestQueueTypes = m_physicalDeviceRequest.queueTypes;
+    const VkWsiDisplay* pWsiDisplay = m_physicalDeviceRequest.pWsiDisplay;
+    const VkQueueFlags requestVideoDecodeQueueMask = m_physicalDeviceRequest.videoDecodeQueueMask;
+    const VkVideoCodecOperationFlagsKHR requestVideoDecodeQueueOperations = m_physicalDeviceRequest.videoDecodeQueueOperations;
+    const VkQueueFlags requestVideoEncodeQueueMask = m_physicalDeviceRequest.videoEncodeQueueMask;
+    const VkVideoCodecOperationFlagsKHR requestVideoEncodeQueueOperations = m_physicalDeviceRequest.videoEncodeQueueOperations;
+
     // enumerate physical devices
     std::vector<VkPhysicalDevice> availablePhysicalDevices;
     VkResult result = vk::enumerate(this, m_instance, availablePhysicalDevices);
@@ -362,6 +447,19 @@ VkResult VulkanDeviceContext::InitPhysicalDevice(const VkQueueFlags requestQueue
             continue;
         }
 
+        if (!m_deviceUuid.empty()) {
+            VkPhysicalDeviceIDProperties idProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+            VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &idProps };
+            GetPhysicalDeviceProperties2(physicalDevice, &props2);
+            if (memcmp(idProps.deviceUUID, m_deviceUuid.data(), VK_UUID_SIZE) != 0) {
+                continue;
+            }
+        }
+
+        // Only the extensions of the selected device are enabled
+        m_reqDeviceExtensions.clear();
+        m_requestedDeviceExtensionsSize = 0;
+        m_optDeviceExtensionsSize = 0;
         if (!HasAllDeviceExtensions(physicalDevice, props.deviceName)) {
             std::cerr << "ERROR: Found physical device with name: " << props.deviceName << std::hex
                          << ", vendor ID: " << props.vendorID << ", and device ID: " << props.deviceID
@@ -393,7 +491,7 @@ VkResult VulkanDeviceContext::InitPhysicalDevice(const VkQueueFlags requestQueue
             transferQueueFamilyOnly = -1,
             transferNumQueues = 0;
 
-        const bool dumpQueues = true;
+        const bool dumpQueues = m_deviceCacheFileName.empty();
         for (uint32_t i = 0; i < queues.size(); i++) {
             const VkQueueFamilyProperties2 &queue = queues[i];
 
@@ -529,12 +627,6 @@ VkResult VulkanDeviceContext::InitPhysicalDevice(const VkQueueFlags requestQueue
                     PrintExtensions(true);
                 }
 
-                std::cout << "*** Selected Vulkan physical device with name: " << props.deviceName << std::hex
-                          << ", vendor ID: " << props.vendorID << ", and device ID: " << props.deviceID << std::dec
-			  << ", Num Decode Queues: " << m_videoDecodeNumQueues
-			  << ", Num Encode Queues: " << m_videoEncodeNumQueues
-			  << " ***" << std::endl << std::flush;
-
                 return VK_SUCCESS;
             }
         }
@@ -547,23 +639,299 @@ VkResult VulkanDeviceContext::InitPhysicalDevice(const VkQueueFlags requestQueue
     return (m_physDevice != VK_NULL_HANDLE) ? VK_SUCCESS : VK_ERROR_FEATURE_NOT_PRESENT;
 }
 
+void VulkanDeviceContext::ReportPciTopology()
+{
+    m_deviceNumaNode = -1;
+    if (FindDeviceExtension(VK_EXT_PCI_BUS_INFO_EXTENSION_NAME) == nullptr) {
+        return;
+    }
+
+    VkPhysicalDevicePCIBusInfoPropertiesEXT pciBusInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PCI_BUS_INFO_PROPERTIES_EXT };
+    VkPhysicalDeviceProperties2 deviceProps2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &pciBusInfo };
+    GetPhysicalDeviceProperties2(m_physDevice, &deviceProps2);
+
+    std::cout << "*** PCI bus address: " << std::hex << std::setfill('0')
+              << std::setw(4) << pciBusInfo.pciDomain << ":" << std::setw(2) << pciBusInfo.pciBus << ":"
+              << std::setw(2) << pciBusInfo.pciDevice << "." << pciBusInfo.pciFunction
+              << std::dec << std::setfill(' ');
+
+    VkPciDeviceTopology topology;
+    if (VkGetPciDeviceTopology(pciBusInfo.pciDomain, pciBusInfo.pciBus, pciBusInfo.pciDevice, pciBusInfo.pciFunction,
+                               topology)) {
+        m_deviceNumaNode = topology.numaNode;
+        std::cout << ", PCIe root: " << topology.rootComplex;
+        if (!topology.rootPort.empty()) {
+            std::cout << " port " << topology.rootPort;
+        }
+        std::cout << ", NUMA node: " << topology.numaNode;
+        if (!topology.localCpuList.empty()) {
+            std::cout << ", local CPUs: " << topology.localCpuList;
+        }
+    }
+    std::cout << " ***" << std::endl << std::flush;
+}
+
 VkResult VulkanDeviceContext::InitVulkanDevice(const char * pAppName, bool verbose,
                                                const char * pCustomLoader) {
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
     PFN_vkGetInstanceProcAddr getInstanceProcAddrFunc = LoadVk(m_libHandle, pCustomLoader);
     if ((getInstanceProcAddrFunc == nullptr) || m_libHandle == VulkanLibraryHandleType()) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
     vk::InitDispatchTableTop(getInstanceProcAddrFunc, this);
+    m_startupTimesMs[STARTUP_LOADER] = MillisecondsSince(startTime);
 
+    startTime = std::chrono::steady_clock::now();
     VkResult result = InitVkInstance(pAppName, verbose);
     if (result != VK_SUCCESS) {
         return result;
     }
     vk::InitDispatchTableMiddle(m_instance, false, this);
+    m_startupTimesMs[STARTUP_INSTANCE] = MillisecondsSince(startTime);
 
     return result;
 }
 
+void VulkanDeviceContext::SetFastStartup(const char* pDeviceCacheFileName)
+{
+    m_deviceCacheFileName = (pDeviceCacheFileName != nullptr) ? pDeviceCacheFileName : "";
+}
+
+void VulkanDeviceContext::PrintStartupTimes() const
+{
+    static const char* const stepNames[STARTUP_STEP_COUNT] = {
+        "loader", "instance", "physical device", "device", "pipeline cache"
+    };
+    double totalMs = 0.0;
+    std::cout << "Device startup times (ms"
+              << (m_physicalDeviceFromCache ? ", physical device from the cache" : "") << "):" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (uint32_t step = 0; step < STARTUP_STEP_COUNT; step++) {
+        std::cout << "\t" << std::setw(16) << std::left << stepNames[step] << std::right
+                  << std::setw(10) << m_startupTimesMs[step] << std::endl;
+        totalMs += m_startupTimesMs[step];
+    }
+    std::cout << "\t" << std::setw(16) << std::left << "total" << std::right << std::setw(10) << totalMs << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << std::setprecision(6) << std::flush;
+}
+
+std::string VulkanDeviceContext::GetDeviceCacheKey() const
+{
+    std::stringstream key;
+    key << std::hex << "device:" << m_deviceId << ";uuid:";
+    for (uint8_t uuidByte : m_deviceUuid) {
+        key << std::setw(2) << std::setfill('0') << (uint32_t)uuidByte;
+    }
+    key << ";queues:" << m_physicalDeviceRequest.queueTypes
+        << ";present:" << (m_physicalDeviceRequest.pWsiDisplay != nullptr)
+        << ";decode:" << m_physicalDeviceRequest.videoDecodeQueueMask << "/" << m_physicalDeviceRequest.videoDecodeQueueOperations
+        << ";encode:" << m_physicalDeviceRequest.videoEncodeQueueMask << "/" << m_physicalDeviceRequest.videoEncodeQueueOperations
+        << ";required:";
+    for (uint32_t i = 0; (m_requestedDeviceExtensions != nullptr) && (m_requestedDeviceExtensions[i] != nullptr); i++) {
+        key << m_requestedDeviceExtensions[i] << ",";
+    }
+    key << ";optional:";
+    for (uint32_t i = 0; (m_optDeviceExtensions != nullptr) && (m_optDeviceExtensions[i] != nullptr); i++) {
+        key << m_optDeviceExtensions[i] << ",";
+    }
+    return key.str();
+}
+
+static const char deviceCacheSignature[] = "vk_video_device_cache 1";
+
+bool VulkanDeviceContext::LoadDeviceCache()
+{
+    FILE* pFile = fopen(m_deviceCacheFileName.c_str(), "r");
+    if (pFile == nullptr) {
+        return false;
+    }
+
+    // One "<name> <values>" entry per line, after the signature
+    std::vector<std::string> lines;
+    char line[1024];
+    while (fgets(line, sizeof(line), pFile) != nullptr) {
+        size_t length = strlen(line);
+        while ((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r'))) {
+            line[--length] = '\0';
+        }
+        lines.push_back(line);
+    }
+    fclose(pFile);
+
+    if (lines.empty() || (lines[0] != deviceCacheSignature)) {
+        return false;
+    }
+
+    std::string key, uuid;
+    uint32_t driverVersion = 0;
+    int32_t families[11] = { -1, -1, -1, -1, 0, -1, 0, -1, 0, -1, 0 };
+    uint32_t queueFlags[2] = {};
+    uint32_t queryResultStatus[2] = {};
+    std::vector<VkExtensionProperties> deviceExtensions;
+    std::set<std::string> enabledExtensions;
+    bool hasFamilies = false;
+    for (size_t i = 1; i < lines.size(); i++) {
+        std::istringstream entry(lines[i]);
+        std::string name;
+        entry >> name;
+        if (name == "request") {
+            key = (lines[i].size() > name.size()) ? lines[i].substr(name.size() + 1) : "";
+        } else if (name == "uuid") {
+            entry >> uuid;
+        } else if (name == "driver") {
+            entry >> driverVersion;
+        } else if (name == "families") {
+            for (uint32_t family = 0; family < 11; family++) {
+                entry >> families[family];
+            }
+            entry >> std::hex >> queueFlags[0] >> queueFlags[1] >> std::dec >> queryResultStatus[0] >> queryResultStatus[1];
+            hasFamilies = !entry.fail();
+        } else if (name == "ext") {
+            VkExtensionProperties extension = VkExtensionProperties();
+            std::string extensionName;
+            entry >> extensionName >> extension.specVersion;
+            strncpy(extension.extensionName, extensionName.c_str(), VK_MAX_EXTENSION_NAME_SIZE - 1);
+            deviceExtensions.push_back(extension);
+        } else if (name == "enabled") {
+            std::string extensionName;
+            entry >> extensionName;
+            enabledExtensions.insert(extensionName);
+        }
+    }
+
+    if (!hasFamilies || (key != GetDeviceCacheKey())) {
+        return false;
+    }
+
+    // The cached device, if still there with the same driver
+    std::vector<VkPhysicalDevice> availablePhysicalDevices;
+    if (vk::enumerate(this, m_instance, availablePhysicalDevices) != VK_SUCCESS) {
+        return false;
+    }
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    for (auto availablePhysicalDevice : availablePhysicalDevices) {
+        VkPhysicalDeviceIDProperties idProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+        VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &idProps };
+        GetPhysicalDeviceProperties2(availablePhysicalDevice, &props2);
+        std::stringstream deviceUuid;
+        deviceUuid << std::hex << std::setfill('0');
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+            deviceUuid << std::setw(2) << (uint32_t)idProps.deviceUUID[i];
+        }
+        if ((deviceUuid.str() == uuid) && (props2.properties.driverVersion == driverVersion)) {
+            physicalDevice = availablePhysicalDevice;
+            break;
+        }
+    }
+    if (physicalDevice == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    // The present queue needs the surface of this run
+    const int32_t presentQueueFamily = families[2];
+    if ((m_physicalDeviceRequest.pWsiDisplay != nullptr) &&
+            ((presentQueueFamily < 0) ||
+             !m_physicalDeviceRequest.pWsiDisplay->PhysDeviceCanPresent(physicalDevice, presentQueueFamily))) {
+        return false;
+    }
+
+    // The extension names of the lists outlive the device, unlike the ones of the file
+    m_reqDeviceExtensions.clear();
+    m_requestedDeviceExtensionsSize = 0;
+    m_optDeviceExtensionsSize = 0;
+    for (uint32_t i = 0; (m_requestedDeviceExtensions != nullptr) && (m_requestedDeviceExtensions[i] != nullptr); i++) {
+        AddRequiredDeviceExtension(m_requestedDeviceExtensions[i]);
+        m_requestedDeviceExtensionsSize++;
+    }
+    for (uint32_t i = 0; (m_optDeviceExtensions != nullptr) && (m_optDeviceExtensions[i] != nullptr); i++) {
+        if (enabledExtensions.find(m_optDeviceExtensions[i]) != enabledExtensions.end()) {
+            AddRequiredDeviceExtension(m_optDeviceExtensions[i]);
+            m_optDeviceExtensionsSize++;
+        }
+    }
+    m_deviceExtensions = deviceExtensions;
+
+    m_physDevice = physicalDevice;
+    m_gfxQueueFamily = families[0];
+    m_computeQueueFamily = families[1];
+    m_presentQueueFamily = presentQueueFamily;
+    m_transferQueueFamily = families[3];
+    m_transferNumQueues = families[4];
+    m_videoDecodeQueueFamily = families[5];
+    m_videoDecodeNumQueues = families[6];
+    m_videoEncodeQueueFamily = families[7];
+    m_videoEncodeNumQueues = families[8];
+    m_videoDecodeEncodeComputeQueueFamily = families[9];
+    m_videoDecodeEncodeComputeNumQueues = families[10];
+    m_videoDecodeQueueFlags = queueFlags[0];
+    m_videoEncodeQueueFlags = queueFlags[1];
+    m_videoDecodeQueryResultStatusSupport = (queryResultStatus[0] != 0);
+    m_videoEncodeQueryResultStatusSupport = (queryResultStatus[1] != 0);
+    return true;
+}
+
+void VulkanDeviceContext::SaveDeviceCache() const
+{
+    VkPhysicalDeviceIDProperties idProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+    VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &idProps };
+    GetPhysicalDeviceProperties2(m_physDevice, &props2);
+
+    std::stringstream cache;
+    cache << deviceCacheSignature << "\n";
+    cache << "request " << GetDeviceCacheKey() << "\n";
+    cache << "uuid " << std::hex << std::setfill('0');
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+        cache << std::setw(2) << (uint32_t)idProps.deviceUUID[i];
+    }
+    cache << std::dec << std::setfill(' ') << "\n";
+    cache << "driver " << props2.properties.driverVersion << "\n";
+    cache << "families " << m_gfxQueueFamily << " " << m_computeQueueFamily << " " << m_presentQueueFamily << " "
+          << m_transferQueueFamily << " " << m_transferNumQueues << " "
+          << m_videoDecodeQueueFamily << " " << m_videoDecodeNumQueues << " "
+          << m_videoEncodeQueueFamily << " " << m_videoEncodeNumQueues << " "
+          << m_videoDecodeEncodeComputeQueueFamily << " " << m_videoDecodeEncodeComputeNumQueues << " "
+          << std::hex << m_videoDecodeQueueFlags << " " << m_videoEncodeQueueFlags << std::dec << " "
+          << (uint32_t)m_videoDecodeQueryResultStatusSupport << " " << (uint32_t)m_videoEncodeQueryResultStatusSupport << "\n";
+    for (const VkExtensionProperties& extension : m_deviceExtensions) {
+        cache << "ext " << extension.extensionName << " " << extension.specVersion << "\n";
+    }
+    for (const char* extensionName : m_reqDeviceExtensions) {
+        cache << "enabled " << extensionName << "\n";
+    }
+
+    // Written aside and renamed, like the pipeline cache
+#if !defined(VK_USE_PLATFORM_WIN32_KHR)
+    const unsigned long processId = (unsigned long)getpid();
+#else
+    const unsigned long processId = (unsigned long)GetCurrentProcessId();
+#endif
+    const std::string tmpFileName = m_deviceCacheFileName + "." + std::to_string(processId) + ".tmp";
+    FILE* pFile = fopen(tmpFileName.c_str(), "w");
+    if (pFile == nullptr) {
+        std::cerr << "WARNING: Can't write the device cache " << m_deviceCacheFileName << std::endl;
+        return;
+    }
+    const std::string cacheData = cache.str();
+    const bool written = (fwrite(cacheData.data(), 1, cacheData.size(), pFile) == cacheData.size());
+    fclose(pFile);
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    remove(m_deviceCacheFileName.c_str());
+#endif
+    if (!written || (rename(tmpFileName.c_str(), m_deviceCacheFileName.c_str()) != 0)) {
+        remove(tmpFileName.c_str());
+        std::cerr << "WARNING: Can't write the device cache " << m_deviceCacheFileName << std::endl;
+    }
+}
+
+void VulkanDeviceContext::GetPhysicalDeviceUuid(uint8_t deviceUuid[VK_UUID_SIZE]) const
+{
+    VkPhysicalDeviceIDProperties idProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+    VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &idProps };
+    GetPhysicalDeviceProperties2(m_physDevice, &props2);
+    memcpy(deviceUuid, idProps.deviceUUID, VK_UUID_SIZE);
+}
+
 VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
                                                  int32_t numEncodeQueues,
                                                  bool createTransferQueue,
@@ -571,6 +939,10 @@ VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
                                                  bool createPresentQueue,
                                                  bool createComputeQueue)
 {
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    const int32_t requestedNumDecodeQueues = numDecodeQueues;
+    const int32_t requestedNumEncodeQueues = numEncodeQueues;
+
     std::unordered_set<int32_t> uniqueQueueFamilies;
     VkDeviceCreateInfo devInfo = {};
     devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -592,6 +964,18 @@ VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
     const int32_t maxQueueInstances = std::max(numDecodeQueues, numEncodeQueues);
     assert(maxQueueInstances <= MAX_QUEUE_INSTANCES);
     const std::vector<float> queuePriorities(maxQueueInstances, 0.0f);
+    // The first video queues of each family are the live ones, above the batch ones of the same family
+    std::vector<float> decodeQueuePriorities(std::max(numDecodeQueues, 1), 0.0f);
+    std::vector<float> encodeQueuePriorities(std::max(numEncodeQueues, 1), 0.0f);
+    std::fill_n(decodeQueuePriorities.begin(), GetNumLiveVideoQueues(numDecodeQueues), 1.0f);
+    std::fill_n(encodeQueuePriorities.begin(), GetNumLiveVideoQueues(numEncodeQueues), 1.0f);
+    // And the video queue families above the queues of the other processes, if requested. The global priority
+    // is per queue family, so it doesn't separate the live and batch sessions of this process.
+    VkDeviceQueueGlobalPriorityCreateInfoKHR videoGlobalPriorityInfo =
+            { VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_KHR, nullptr, m_videoQueueGlobalPriority };
+    const bool useGlobalPriority = (m_videoQueueGlobalPriority != VkQueueGlobalPriorityKHR()) &&
+                                   (FindRequiredDeviceExtension(VK_KHR_GLOBAL_PRIORITY_EXTENSION_NAME) ||
+                                    FindRequiredDeviceExtension(VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME));
     std::array<VkDeviceQueueCreateInfo, MAX_QUEUE_FAMILIES> queueInfo = {};
     const bool isUnique = uniqueQueueFamilies.insert(m_gfxQueueFamily).second;
     assert(isUnique);
@@ -618,9 +1002,10 @@ VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
             (m_videoDecodeQueueFamily != -1) &&
             uniqueQueueFamilies.insert(m_videoDecodeQueueFamily).second) {
         queueInfo[devInfo.queueCreateInfoCount].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo[devInfo.queueCreateInfoCount].pNext = useGlobalPriority ? &videoGlobalPriorityInfo : nullptr;
         queueInfo[devInfo.queueCreateInfoCount].queueFamilyIndex = m_videoDecodeQueueFamily;
         queueInfo[devInfo.queueCreateInfoCount].queueCount = numDecodeQueues;
-        queueInfo[devInfo.queueCreateInfoCount].pQueuePriorities = queuePriorities.data();
+        queueInfo[devInfo.queueCreateInfoCount].pQueuePriorities = decodeQueuePriorities.data();
         devInfo.queueCreateInfoCount++;
     }
 
@@ -628,9 +1013,10 @@ VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
             (m_videoEncodeQueueFamily != -1) &&
             uniqueQueueFamilies.insert(m_videoEncodeQueueFamily).second) {
         queueInfo[devInfo.queueCreateInfoCount].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo[devInfo.queueCreateInfoCount].pNext = useGlobalPriority ? &videoGlobalPriorityInfo : nullptr;
         queueInfo[devInfo.queueCreateInfoCount].queueFamilyIndex = m_videoEncodeQueueFamily;
         queueInfo[devInfo.queueCreateInfoCount].queueCount = numEncodeQueues;
-        queueInfo[devInfo.queueCreateInfoCount].pQueuePriorities = queuePriorities.data();
+        queueInfo[devInfo.queueCreateInfoCount].pQueuePriorities = encodeQueuePriorities.data();
         devInfo.queueCreateInfoCount++;
     }
 
@@ -665,7 +1051,79 @@ VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
     VkPhysicalDeviceFeatures features = {};
     devInfo.pEnabledFeatures = &features;
 
+    // Except for the descriptor buffers of the filters, which also need the buffer device addresses
+    VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures =
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES, nullptr };
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures =
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT, &bufferDeviceAddressFeatures };
+    m_descriptorBufferSupport = false;
+    if (FindRequiredDeviceExtension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 deviceFeatures2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &descriptorBufferFeatures };
+        GetPhysicalDeviceFeatures2(m_physDevice, &deviceFeatures2);
+        if (descriptorBufferFeatures.descriptorBuffer && bufferDeviceAddressFeatures.bufferDeviceAddress) {
+            descriptorBufferFeatures = VkPhysicalDeviceDescriptorBufferFeaturesEXT();
+            descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+            descriptorBufferFeatures.pNext = &bufferDeviceAddressFeatures;
+            descriptorBufferFeatures.descriptorBuffer = VK_TRUE;
+            bufferDeviceAddressFeatures = VkPhysicalDeviceBufferDeviceAddressFeatures();
+            bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+            bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+            devInfo.pNext = &descriptorBufferFeatures;
+            m_descriptorBufferSupport = true;
+        }
+    }
+
+    // And for the timeline semaphores the frames of the pipelines signal
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures =
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, nullptr };
+    VkPhysicalDeviceFeatures2 timelineDeviceFeatures2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &timelineSemaphoreFeatures };
+    GetPhysicalDeviceFeatures2(m_physDevice, &timelineDeviceFeatures2);
+    m_timelineSemaphoreSupport = (timelineSemaphoreFeatures.timelineSemaphore != VK_FALSE);
+    if (m_timelineSemaphoreSupport) {
+        timelineSemaphoreFeatures.pNext = const_cast<void*>(devInfo.pNext);
+        devInfo.pNext = &timelineSemaphoreFeatures;
+    }
+
+    // And for the present waits of the low latency presentation
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures =
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, nullptr };
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures =
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR, &presentWaitFeatures };
+    m_presentWaitSupport = false;
+    if (FindRequiredDeviceExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            FindRequiredDeviceExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 presentDeviceFeatures2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &presentIdFeatures };
+        GetPhysicalDeviceFeatures2(m_physDevice, &presentDeviceFeatures2);
+        m_presentWaitSupport = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        if (m_presentWaitSupport) {
+            presentWaitFeatures.pNext = const_cast<void*>(devInfo.pNext);
+            devInfo.pNext = &presentIdFeatures;
+        }
+    }
+
     VkResult result = CreateDevice(m_physDevice, &devInfo, nullptr, &m_device);
+    if ((result == VK_ERROR_NOT_PERMITTED_KHR) && useGlobalPriority) {
+        // A priority above medium may need privileges the process doesn't have, keep the default one
+        std::cerr << "WARNING: The video queues can't be created at global priority " << m_videoQueueGlobalPriority
+                  << ", using the default one" << std::endl;
+        m_videoQueueGlobalPriority = VkQueueGlobalPriorityKHR();
+        return CreateVulkanDevice(requestedNumDecodeQueues, requestedNumEncodeQueues, createTransferQueue,
+                                  createGraphicsQueue, createPresentQueue, createComputeQueue);
+    }
+    if ((result != VK_SUCCESS) && m_physicalDeviceFromCache) {
+        // E.g. an extension gone with a driver update of the same version, selected again from the enumeration
+        std::cerr << "WARNING: The device of the cache " << m_deviceCacheFileName << " can't be created ("
+                  << result << "), enumerating the physical devices" << std::endl;
+        m_physicalDeviceFromCache = false;
+        result = EnumeratePhysicalDevices();
+        if (result == VK_SUCCESS) {
+            SaveDeviceCache();
+            result = CreateVulkanDevice(requestedNumDecodeQueues, requestedNumEncodeQueues, createTransferQueue,
+                                        createGraphicsQueue, createPresentQueue, createComputeQueue);
+        }
+        m_startupTimesMs[STARTUP_DEVICE] = MillisecondsSince(startTime);
+        return result;
+    }
     if (result != VK_SUCCESS) {
         return result;
     }
@@ -704,9 +1162,22 @@ VkResult VulkanDeviceContext::CreateVulkanDevice(int32_t numDecodeQueues,
         }
     }
 
+    // Only the created queues are handed out to the decoders and encoders
+    if (numDecodeQueues > 0) {
+        m_videoDecodeNumQueues = numDecodeQueues;
+        m_videoDecodeQueues.resize(numDecodeQueues);
+    }
+    if (numEncodeQueues > 0) {
+        m_videoEncodeNumQueues = numEncodeQueues;
+        m_videoEncodeQueues.resize(numEncodeQueues);
+    }
+
+    m_startupTimesMs[STARTUP_DEVICE] = MillisecondsSince(startTime);
     return result;
 }
 
+std::atomic<uint64_t> VulkanDeviceContext::s_queueLockWaitNs(0);
+
 VulkanDeviceContext::VulkanDeviceContext(int32_t deviceId,
                                          const char* const* reqInstanceLayers,
                                          const char* const* reqInstanceExtensions,
@@ -716,6 +1187,7 @@ VulkanDeviceContext::VulkanDeviceContext(int32_t deviceId,
     , m_libHandle()
     , m_instance()
     , m_physDevice()
+    , m_deviceNumaNode(-1)
     , m_gfxQueueFamily(-1)
     , m_computeQueueFamily(-1)
     , m_presentQueueFamily(-1)
@@ -732,6 +1204,11 @@ VulkanDeviceContext::VulkanDeviceContext(int32_t deviceId,
     , m_videoEncodeQueueFlags(0)
     , m_videoDecodeQueryResultStatusSupport(false)
     , m_videoEncodeQueryResultStatusSupport(false)
+    , m_descriptorBufferSupport(false)
+    , m_timelineSemaphoreSupport(false)
+    , m_presentWaitSupport(false)
+    , m_numLiveVideoQueues(0)
+    , m_videoQueueGlobalPriority()
     , m_device()
     , m_gfxQueue()
     , m_computeQueue()
@@ -747,10 +1224,243 @@ VulkanDeviceContext::VulkanDeviceContext(int32_t deviceId,
     , m_requestedDeviceExtensionsSize(0)
     , m_optDeviceExtensions(optDeviceExtensions)
     , m_optDeviceExtensionsSize(0)
+    , m_deviceMemoryArena()
+    , m_hugePageStaging(false)
+    , m_videoSharedImagePool()
+    , m_videoSessionPool()
+    , m_videoDecodeSubmitThreads()
+    , m_videoDecodeCommandBatches()
+    , m_pipelineCache()
+    , m_shaderCacheDirectory()
+    , m_pipelineCacheFileName()
+    , m_deviceCacheFileName()
+    , m_physicalDeviceFromCache(false)
+    , m_deviceUuid()
+    , m_physicalDeviceRequest()
+    , m_startupTimesMs()
 {
 
 }
 
+VkResult VulkanDeviceContext::CreateDeviceMemoryArena(VkDeviceSize blockSize)
+{
+    if (m_deviceMemoryArena) {
+        m_deviceMemoryArena->Release();
+        m_deviceMemoryArena = nullptr;
+    }
+
+    if (blockSize == 0) {
+        return VK_SUCCESS;
+    }
+
+    VkSharedBaseObj<VulkanDeviceMemoryArena> deviceMemoryArena;
+    VkResult result = VulkanDeviceMemoryArena::Create(this, blockSize, deviceMemoryArena);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_deviceMemoryArena = deviceMemoryArena;
+    m_deviceMemoryArena->AddRef();
+
+    return result;
+}
+
+VkResult VulkanDeviceContext::InitPipelineCache(const char* pCacheDirectory)
+{
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    if (m_pipelineCache) {
+        DestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+        m_pipelineCache = VK_NULL_HANDLE;
+    }
+    m_shaderCacheDirectory.clear();
+    m_pipelineCacheFileName.clear();
+
+    std::vector<uint8_t> cacheData;
+    if ((pCacheDirectory != nullptr) && (pCacheDirectory[0] != '\0')) {
+
+        m_shaderCacheDirectory = pCacheDirectory;
+
+        VkPhysicalDeviceProperties props;
+        GetPhysicalDeviceProperties(m_physDevice, &props);
+        std::stringstream fileName;
+        fileName << m_shaderCacheDirectory << "/pipeline_cache_" << std::hex << std::setfill('0')
+                 << std::setw(4) << props.vendorID << "_" << std::setw(4) << props.deviceID << ".bin";
+        m_pipelineCacheFileName = fileName.str();
+
+        FILE* pFile = fopen(m_pipelineCacheFileName.c_str(), "rb");
+        if (pFile != nullptr) {
+            fseek(pFile, 0, SEEK_END);
+            const long fileSize = ftell(pFile);
+            fseek(pFile, 0, SEEK_SET);
+            if (fileSize > 0) {
+                cacheData.resize((size_t)fileSize);
+                if (fread(cacheData.data(), 1, cacheData.size(), pFile) != cacheData.size()) {
+                    cacheData.clear();
+                }
+            }
+            fclose(pFile);
+        }
+
+        // The data of another driver version is rejected by the driver at best, don't hand it over
+        VkPipelineCacheHeaderVersionOne header;
+        if (cacheData.size() >= sizeof(header)) {
+            memcpy(&header, cacheData.data(), sizeof(header));
+            if ((header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) ||
+                    (header.vendorID != props.vendorID) || (header.deviceID != props.deviceID) ||
+                    (memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+                cacheData.clear();
+            }
+        } else {
+            cacheData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheInfo = VkPipelineCacheCreateInfo();
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheInfo.initialDataSize = cacheData.size();
+    pipelineCacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+    VkResult result = CreatePipelineCache(m_device, &pipelineCacheInfo, nullptr, &m_pipelineCache);
+    if ((result != VK_SUCCESS) && !cacheData.empty()) {
+        pipelineCacheInfo.initialDataSize = 0;
+        pipelineCacheInfo.pInitialData = nullptr;
+        result = CreatePipelineCache(m_device, &pipelineCacheInfo, nullptr, &m_pipelineCache);
+    }
+    m_startupTimesMs[STARTUP_PIPELINE_CACHE] = MillisecondsSince(startTime);
+    return result;
+}
+
+VkResult VulkanDeviceContext::SavePipelineCache() const
+{
+    if (!m_pipelineCache || m_pipelineCacheFileName.empty()) {
+        return VK_SUCCESS;
+    }
+
+    size_t dataSize = 0;
+    VkResult result = GetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr);
+    if ((result != VK_SUCCESS) || (dataSize == 0)) {
+        return result;
+    }
+    std::vector<uint8_t> cacheData(dataSize);
+    result = GetPipelineCacheData(m_device, m_pipelineCache, &dataSize, cacheData.data());
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // Written aside and renamed, for the processes sharing the directory to never read a partial file
+#if !defined(VK_USE_PLATFORM_WIN32_KHR)
+    const unsigned long processId = (unsigned long)getpid();
+#else
+    const unsigned long processId = (unsigned long)GetCurrentProcessId();
+#endif
+    const std::string tmpFileName = m_pipelineCacheFileName + "." + std::to_string(processId) + ".tmp";
+    FILE* pFile = fopen(tmpFileName.c_str(), "wb");
+    if (pFile == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    const bool written = (fwrite(cacheData.data(), 1, dataSize, pFile) == dataSize);
+    fclose(pFile);
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    remove(m_pipelineCacheFileName.c_str()); // rename() doesn't replace an existing file there
+#endif
+    if (!written || (rename(tmpFileName.c_str(), m_pipelineCacheFileName.c_str()) != 0)) {
+        remove(tmpFileName.c_str());
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    return VK_SUCCESS;
+}
+
+VkResult VulkanDeviceContext::CreateVideoSharedImagePool(uint32_t maxIdleImages)
+{
+    if (m_videoSharedImagePool) {
+        m_videoSharedImagePool->Release();
+        m_videoSharedImagePool = nullptr;
+    }
+
+    if (maxIdleImages == 0) {
+        return VK_SUCCESS;
+    }
+
+    VkSharedBaseObj<VulkanVideoSharedImagePool> sharedImagePool;
+    VkResult result = VulkanVideoSharedImagePool::Create(this, maxIdleImages, sharedImagePool);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_videoSharedImagePool = sharedImagePool;
+    m_videoSharedImagePool->AddRef();
+
+    return result;
+}
+
+VkResult VulkanDeviceContext::CreateVideoSessionPool(uint32_t maxIdleSessions)
+{
+    if (m_videoSessionPool) {
+        m_videoSessionPool->Release();
+        m_videoSessionPool = nullptr;
+    }
+
+    if (maxIdleSessions == 0) {
+        return VK_SUCCESS;
+    }
+
+    VkSharedBaseObj<VulkanVideoSessionPool> videoSessionPool;
+    VkResult result = VulkanVideoSessionPool::Create(this, maxIdleSessions, videoSessionPool);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_videoSessionPool = videoSessionPool;
+    m_videoSessionPool->AddRef();
+
+    return result;
+}
+
+VkResult VulkanDeviceContext::CreateVideoDecodeSubmitThreads(const std::vector<uint32_t>& cpus)
+{
+    for (int32_t queueIndex = 0; queueIndex < m_videoDecodeNumQueues; queueIndex++) {
+
+        if (m_videoDecodeSubmitThreads[queueIndex]) {
+            continue;
+        }
+
+        VkSharedBaseObj<VulkanQueueSubmitThread> submitThread;
+        VkResult result = VulkanQueueSubmitThread::Create(this, DECODE, queueIndex, submitThread);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        if (!cpus.empty()) {
+            submitThread->SetThreadAffinity(cpus);
+        }
+
+        m_videoDecodeSubmitThreads[queueIndex] = submitThread;
+        m_videoDecodeSubmitThreads[queueIndex]->AddRef();
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult VulkanDeviceContext::CreateVideoDecodeCommandBatches(uint32_t maxPictures, uint32_t maxLatencyMs)
+{
+    for (int32_t queueIndex = 0; queueIndex < m_videoDecodeNumQueues; queueIndex++) {
+
+        if (m_videoDecodeCommandBatches[queueIndex]) {
+            continue;
+        }
+
+        VkSharedBaseObj<VulkanVideoDecodeCommandBatch> commandBatch;
+        VkResult result = VulkanVideoDecodeCommandBatch::Create(this, queueIndex, maxPictures, maxLatencyMs, commandBatch);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        m_videoDecodeCommandBatches[queueIndex] = commandBatch;
+        m_videoDecodeCommandBatches[queueIndex]->AddRef();
+    }
+
+    return VK_SUCCESS;
+}
+
 void VulkanDeviceContext::DeviceWaitIdle() const
 {
     vk::VkInterfaceFunctions::DeviceWaitIdle(m_device);
@@ -758,6 +1468,44 @@ void VulkanDeviceContext::DeviceWaitIdle() const
 
 VulkanDeviceContext::~VulkanDeviceContext() {
 
+    // The command batches submit what is still pending before they are destroyed, ahead of the submit threads
+    for (size_t queueIndex = 0; queueIndex < m_videoDecodeCommandBatches.size(); queueIndex++) {
+        if (m_videoDecodeCommandBatches[queueIndex]) {
+            m_videoDecodeCommandBatches[queueIndex]->Release();
+            m_videoDecodeCommandBatches[queueIndex] = nullptr;
+        }
+    }
+
+    // The submit threads submit what is still pending before they exit
+    for (size_t queueIndex = 0; queueIndex < m_videoDecodeSubmitThreads.size(); queueIndex++) {
+        if (m_videoDecodeSubmitThreads[queueIndex]) {
+            m_videoDecodeSubmitThreads[queueIndex]->Release();
+            m_videoDecodeSubmitThreads[queueIndex] = nullptr;
+        }
+    }
+
+    if (m_videoSessionPool) {
+        m_videoSessionPool->Release();
+        m_videoSessionPool = nullptr;
+    }
+
+    // The pooled images may be sub-allocated from the arena
+    if (m_videoSharedImagePool) {
+        m_videoSharedImagePool->Release();
+        m_videoSharedImagePool = nullptr;
+    }
+
+    if (m_deviceMemoryArena) {
+        m_deviceMemoryArena->Release();
+        m_deviceMemoryArena = nullptr;
+    }
+
+    if (m_pipelineCache) {
+        SavePipelineCache();
+        DestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+        m_pipelineCache = VK_NULL_HANDLE;
+    }
+
     if (m_device) {
         if (!m_isExternallyManagedDevice) {
             DestroyDevice(m_device, nullptr);
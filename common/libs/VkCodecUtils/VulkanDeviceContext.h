@@ -18,13 +18,24 @@
 #define _VULKANDEVICECONTEXT_H_
 
 #include <assert.h>
+#include <algorithm>
 #include <vector>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <string>
 #include <vulkan_interfaces.h>
 #include <VkCodecUtils/HelpersDispatchTable.h>
+#include "VkCodecUtils/VkTrace.h"
 #include "VkShell/VkWsiDisplay.h"
 
+class VulkanDeviceMemoryArena;
+class VulkanVideoSharedImagePool;
+class VulkanVideoSessionPool;
+class VulkanQueueSubmitThread;
+class VulkanVideoDecodeCommandBatch;
+
 class VulkanDeviceContext : public vk::VkInterfaceFunctions {
 
 public:
@@ -45,6 +56,12 @@ public:
         PRESENT,
     };
 
+    // The class of a video session, live sessions get the higher priority queues
+    enum VideoQueuePriority {
+        VIDEO_QUEUE_PRIORITY_BATCH = 0,
+        VIDEO_QUEUE_PRIORITY_LIVE  = 1,
+    };
+
     enum {
         MAX_QUEUE_INSTANCES = 8,
         MAX_QUEUE_FAMILIES = 6, // Gfx, Present, Compute, Transfer, Decode, Encode
@@ -93,8 +110,16 @@ public:
         }
         return m_videoEncodeQueues[index];
     }
+    // The NUMA node of the host the physical device is attached to, -1 when unknown
+    int32_t GetDeviceNumaNode() const { return m_deviceNumaNode; }
     bool    GetVideoDecodeQueryResultStatusSupport() const { return m_videoDecodeQueryResultStatusSupport; }
     bool    GetVideoEncodeQueryResultStatusSupport() const { return m_videoEncodeQueryResultStatusSupport; }
+    // The descriptorBuffer and bufferDeviceAddress features, enabled by CreateVulkanDevice() with VK_EXT_descriptor_buffer
+    bool    GetDescriptorBufferSupport() const { return m_descriptorBufferSupport; }
+    // The timelineSemaphore feature, enabled by CreateVulkanDevice() when the device has it
+    bool    GetTimelineSemaphoreSupport() const { return m_timelineSemaphoreSupport; }
+    // The presentId and presentWait features, enabled by CreateVulkanDevice() with VK_KHR_present_id and VK_KHR_present_wait
+    bool    GetPresentWaitSupport() const { return m_presentWaitSupport; }
     VkQueueFlags GetVideoDecodeQueueFlag() const { return m_videoDecodeQueueFlags; }
     VkQueueFlags GetVideoEncodeQueueFlag() const { return m_videoEncodeQueueFlags; }
     class MtQueueMutex {
@@ -135,8 +160,13 @@ public:
                 m_mutex = nullptr;
                 break;
             }
-            if (m_mutex) {
+            if (m_mutex && !m_mutex->try_lock()) {
+                // Contended, the wait of the submitters on each other is counted for GetQueueLockWaitNs()
+                const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
                 m_mutex->lock();
+                s_queueLockWaitNs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                std::chrono::steady_clock::now() - waitStart).count(),
+                                            std::memory_order_relaxed);
             }
         }
 
@@ -163,6 +193,8 @@ public:
     VkResult MultiThreadedQueueSubmit(const QueueFamilySubmitType submitType, const int32_t queueIndex,
                                       uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) const
     {
+        // Includes the wait for the queue lock
+        VK_TRACE_ZONE("QueueSubmit");
         MtQueueMutex queue(this, submitType, queueIndex);
         if (queue) {
             return QueueSubmit(queue, submitCount, pSubmits, fence);
@@ -171,6 +203,30 @@ public:
         }
     }
 
+    // Submits all the batches in one call, under one queue lock. A fence can only go with the whole call, so the fence
+    // of the last batch is signaled by it and the fences of the other batches by fence only submissions after it.
+    VkResult MultiThreadedQueueSubmitBatches(const QueueFamilySubmitType submitType, const int32_t queueIndex,
+                                             uint32_t submitCount, const VkSubmitInfo* pSubmits, const VkFence* pFences) const
+    {
+        if (submitCount == 0) {
+            return VK_SUCCESS;
+        }
+
+        VK_TRACE_ZONE("QueueSubmit");
+        MtQueueMutex queue(this, submitType, queueIndex);
+        if (!queue) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        VkResult result = QueueSubmit(queue, submitCount, pSubmits, pFences[submitCount - 1]);
+        for (uint32_t i = 0; (result == VK_SUCCESS) && (i < (submitCount - 1)); i++) {
+            if (pFences[i] != VK_NULL_HANDLE) {
+                result = QueueSubmit(queue, 0, nullptr, pFences[i]);
+            }
+        }
+        return result;
+    }
+
     VkResult MultiThreadedQueueWaitIdle(const QueueFamilySubmitType submitType, const int32_t queueIndex) const
     {
         MtQueueMutex queue(this, submitType, queueIndex);
@@ -218,6 +274,45 @@ public:
     VkResult InitVulkanDevice(const char * pAppName, bool verbose = false,
                               const char * pCustomLoader = nullptr);
 
+    // With a device cache file, InitPhysicalDevice() selects the physical device, its queue families and extensions
+    // cached there by a previous run with the same request and driver, without enumerating them again, and the
+    // instance layers and extensions are only checked when the instance can't be created with them. The cache is
+    // written by the runs enumerating them. Must be called before InitVulkanDevice().
+    void SetFastStartup(const char* pDeviceCacheFileName);
+    bool IsPhysicalDeviceFromCache() const { return m_physicalDeviceFromCache; }
+    // Restricts InitPhysicalDevice() to the physical device of that UUID, e.g. one of several identical GPUs
+    void SetDeviceUuid(const uint8_t deviceUuid[VK_UUID_SIZE]) { m_deviceUuid.assign(deviceUuid, deviceUuid + VK_UUID_SIZE); }
+    // The UUID of the physical device in use, e.g. the key of the results cached for the device
+    void GetPhysicalDeviceUuid(uint8_t deviceUuid[VK_UUID_SIZE]) const;
+    // Creates the first numLiveQueues decode and encode queues of CreateVulkanDevice() at a higher priority than
+    // the others, for the live sessions, always leaving one for the batch sessions. With a globalPriority, also
+    // creates the video queue families at that global priority, if VK_KHR/EXT_global_priority is enabled.
+    void SetVideoQueuePriorities(int32_t numLiveQueues,
+                                 VkQueueGlobalPriorityKHR globalPriority = VkQueueGlobalPriorityKHR())
+    {
+        m_numLiveVideoQueues = std::max(numLiveQueues, 0);
+        m_videoQueueGlobalPriority = globalPriority;
+    }
+    // The range of the decode or encode queues of a priority class, all of them without live queues
+    void GetVideoQueueRange(QueueFamilySubmitType submitType, VideoQueuePriority priority,
+                            int32_t& firstQueue, int32_t& numQueues) const
+    {
+        const int32_t numFamilyQueues = (submitType == ENCODE) ? m_videoEncodeNumQueues : m_videoDecodeNumQueues;
+        const int32_t numLiveQueues = GetNumLiveVideoQueues(numFamilyQueues);
+        if (numLiveQueues == 0) {
+            firstQueue = 0;
+            numQueues = numFamilyQueues;
+        } else if (priority == VIDEO_QUEUE_PRIORITY_LIVE) {
+            firstQueue = 0;
+            numQueues = numLiveQueues;
+        } else {
+            firstQueue = numLiveQueues;
+            numQueues = numFamilyQueues - numLiveQueues;
+        }
+    }
+    // Prints the time spent in each step of the device initialization
+    void PrintStartupTimes() const;
+
     VkResult CheckAllInstanceLayers(bool verbose = false);
     VkResult CheckAllInstanceExtensions(bool verbose = false);
     bool HasAllDeviceExtensions(VkPhysicalDevice physDevice, const char* printMissingDeviceExt = nullptr);
@@ -250,6 +345,49 @@ public:
                                 bool createPresentQueue = false,
                                 bool createComputeQueue = false);
     VkResult InitDebugReport(bool validate = false, bool validateVerbose = false);
+
+    // Creates the arena the images and buffers are sub-allocated from. A blockSize of 0 disables it.
+    VkResult CreateDeviceMemoryArena(VkDeviceSize blockSize);
+    VulkanDeviceMemoryArena* GetDeviceMemoryArena() const { return m_deviceMemoryArena; }
+
+    // The host visible transfer buffers of VkBufferResource, that stage the host copies, allocated in 2 MB huge
+    // pages of host memory imported with VK_EXT_external_memory_host. Falls back to the regular allocations.
+    void SetHugePageStaging(bool hugePageStaging) { m_hugePageStaging = hugePageStaging; }
+    bool GetHugePageStaging() const { return m_hugePageStaging; }
+
+    // Creates the pool of video images shared by the decoders of this device. A maxIdleImages of 0 disables it.
+    VkResult CreateVideoSharedImagePool(uint32_t maxIdleImages);
+    VulkanVideoSharedImagePool* GetVideoSharedImagePool() const { return m_videoSharedImagePool; }
+
+    // Creates the pool of idle video sessions shared by the decoders. A maxIdleSessions of 0 disables it.
+    VkResult CreateVideoSessionPool(uint32_t maxIdleSessions);
+    VulkanVideoSessionPool* GetVideoSessionPool() const { return m_videoSessionPool; }
+
+    // Creates a submit thread for each of the decode queues, for the decoders to submit through it
+    // instead of locking the queue. Must be called after the decode queues are created.
+    // The threads run on the CPUs of the list, if any.
+    VkResult CreateVideoDecodeSubmitThreads(const std::vector<uint32_t>& cpus = std::vector<uint32_t>());
+    VulkanQueueSubmitThread* GetVideoDecodeSubmitThread(int32_t queueIndex) const {
+        return ((queueIndex >= 0) && (queueIndex < MAX_QUEUE_INSTANCES)) ? m_videoDecodeSubmitThreads[queueIndex] : nullptr;
+    }
+
+    // Creates a command batch for each of the decode queues, for the decoders on the queue to record their pictures
+    // into one command buffer, submitted once it has maxPictures of them or after maxLatencyMs.
+    // Must be called after the decode queues are created.
+    VkResult CreateVideoDecodeCommandBatches(uint32_t maxPictures, uint32_t maxLatencyMs);
+    VulkanVideoDecodeCommandBatch* GetVideoDecodeCommandBatch(int32_t queueIndex) const {
+        return ((queueIndex >= 0) && (queueIndex < MAX_QUEUE_INSTANCES)) ? m_videoDecodeCommandBatches[queueIndex] : nullptr;
+    }
+
+    // Creates the pipeline cache the pipelines of this device are created with, loaded from the cache
+    // directory when it has one for this device and driver. The SPIR-V of the shaders compiled at runtime
+    // is also kept in that directory. The cache is written back to it when the device is destroyed.
+    VkResult InitPipelineCache(const char* pCacheDirectory);
+    VkResult SavePipelineCache() const;
+    VkPipelineCache GetPipelineCache() const { return m_pipelineCache; }
+    const std::string& GetShaderCacheDirectory() const { return m_shaderCacheDirectory; }
+    // The time the threads of the process waited for the lock of a queue held by another one, on all the devices
+    static uint64_t GetQueueLockWaitNs() { return s_queueLockWaitNs.load(std::memory_order_relaxed); }
 private:
 
     static PFN_vkGetInstanceProcAddr LoadVk(VulkanLibraryHandleType &vulkanLibHandle,
@@ -261,11 +399,45 @@ private:
 
     VkResult PopulateDeviceExtensions();
 
+    // Reports the PCIe root and the NUMA node of the selected physical device
+    void ReportPciTopology();
+
+    VkResult EnumeratePhysicalDevices();
+    // The request of InitPhysicalDevice() and the extension lists the cached selection is only valid for
+    std::string GetDeviceCacheKey() const;
+    bool LoadDeviceCache();
+    void SaveDeviceCache() const;
+
+    // The live ones of numQueues video queues
+    int32_t GetNumLiveVideoQueues(int32_t numQueues) const
+    {
+        return std::max(std::min(m_numLiveVideoQueues, numQueues - 1), 0);
+    }
+
+    enum StartupStep {
+        STARTUP_LOADER,
+        STARTUP_INSTANCE,
+        STARTUP_PHYSICAL_DEVICE,
+        STARTUP_DEVICE,
+        STARTUP_PIPELINE_CACHE,
+        STARTUP_STEP_COUNT
+    };
+
+    struct PhysicalDeviceRequest {
+        VkQueueFlags                  queueTypes;
+        const VkWsiDisplay*           pWsiDisplay;
+        VkQueueFlags                  videoDecodeQueueMask;
+        VkVideoCodecOperationFlagsKHR videoDecodeQueueOperations;
+        VkQueueFlags                  videoEncodeQueueMask;
+        VkVideoCodecOperationFlagsKHR videoEncodeQueueOperations;
+    };
+
 private:
     int32_t                 m_deviceId;
     VulkanLibraryHandleType m_libHandle;
     VkInstance m_instance;
     VkPhysicalDevice m_physDevice;
+    int32_t  m_deviceNumaNode;
     int32_t  m_gfxQueueFamily;
     int32_t  m_computeQueueFamily;
     int32_t  m_presentQueueFamily;
@@ -282,6 +454,11 @@ private:
     VkQueueFlags m_videoEncodeQueueFlags;
     uint32_t m_videoDecodeQueryResultStatusSupport : 1;
     uint32_t m_videoEncodeQueryResultStatusSupport : 1;
+    uint32_t m_descriptorBufferSupport : 1;
+    uint32_t m_timelineSemaphoreSupport : 1;
+    uint32_t m_presentWaitSupport : 1;
+    int32_t                  m_numLiveVideoQueues;
+    VkQueueGlobalPriorityKHR m_videoQueueGlobalPriority;
     VkDevice                m_device;
     VkQueue                 m_gfxQueue;
     VkQueue                 m_computeQueue;
@@ -295,6 +472,7 @@ private:
     mutable std::mutex                                  m_presentQueueMutex;
     mutable std::array<std::mutex, MAX_QUEUE_INSTANCES> m_videoDecodeQueueMutexes;
     mutable std::array<std::mutex, MAX_QUEUE_INSTANCES> m_videoEncodeQueueMutexes;
+    static std::atomic<uint64_t>                        s_queueLockWaitNs;
     bool m_isExternallyManagedDevice;
     VkDebugReportCallbackEXT           m_debugReport;
     const char* const*                 m_reqInstanceLayers;
@@ -308,6 +486,20 @@ private:
     std::vector<const char *>          m_reqDeviceExtensions;
     std::vector<VkExtensionProperties> m_instanceExtensions;
     std::vector<VkExtensionProperties> m_deviceExtensions;
+    VulkanDeviceMemoryArena*           m_deviceMemoryArena;
+    bool                               m_hugePageStaging;
+    VulkanVideoSharedImagePool*              m_videoSharedImagePool;
+    VulkanVideoSessionPool*            m_videoSessionPool;
+    std::array<VulkanQueueSubmitThread*, MAX_QUEUE_INSTANCES> m_videoDecodeSubmitThreads;
+    std::array<VulkanVideoDecodeCommandBatch*, MAX_QUEUE_INSTANCES> m_videoDecodeCommandBatches;
+    VkPipelineCache                    m_pipelineCache;
+    std::string                        m_shaderCacheDirectory;
+    std::string                        m_pipelineCacheFileName;
+    std::string                        m_deviceCacheFileName;
+    bool                               m_physicalDeviceFromCache;
+    std::vector<uint8_t>               m_deviceUuid; // of the selected physical device, any if empty
+    PhysicalDeviceRequest              m_physicalDeviceRequest; // of the last InitPhysicalDevice()
+    std::array<double, STARTUP_STEP_COUNT> m_startupTimesMs;
 };
 
 #endif /* _VULKANDEVICECONTEXT_H_ */
@@ -0,0 +1,246 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <numeric>
+#include "VkCodecUtils/Helpers.h"
+#include "VkCodecUtils/VulkanDeviceContextManager.h"
+
+VulkanDeviceContextManager::VulkanDeviceContextManager(const char* const* reqInstanceLayers,
+                                                       const char* const* reqInstanceExtensions,
+                                                       const char* const* requestedDeviceExtensions,
+                                                       const char* const* optDeviceExtensions)
+    : m_reqInstanceLayers(reqInstanceLayers)
+    , m_reqInstanceExtensions(reqInstanceExtensions)
+    , m_requestedDeviceExtensions(requestedDeviceExtensions)
+    , m_optDeviceExtensions(optDeviceExtensions)
+    , m_numLiveVideoQueues(0)
+    , m_videoQueueGlobalPriority()
+    , m_sessionsMutex()
+    , m_devices()
+{
+}
+
+VulkanDeviceContextManager::~VulkanDeviceContextManager()
+{
+    for (Device& device : m_devices) {
+        delete device.pVkDevCtx;
+        device.pVkDevCtx = nullptr;
+    }
+    m_devices.clear();
+}
+
+VkResult VulkanDeviceContextManager::OpenAllDevices(const char* pAppName,
+                                                    const VkQueueFlags requestQueueTypes,
+                                                    const VkQueueFlags requestVideoDecodeQueueMask,
+                                                    const VkVideoCodecOperationFlagsKHR requestVideoDecodeQueueOperations,
+                                                    const VkQueueFlags requestVideoEncodeQueueMask,
+                                                    const VkVideoCodecOperationFlagsKHR requestVideoEncodeQueueOperations,
+                                                    bool createTransferQueue,
+                                                    bool createComputeQueue,
+                                                    bool validate,
+                                                    bool validateVerbose)
+{
+    // The physical devices are told apart by their UUIDs, the identical GPUs share their device IDs
+    std::vector<std::array<uint8_t, VK_UUID_SIZE>> deviceUuids;
+    {
+        VulkanDeviceContext enumerationContext(-1, m_reqInstanceLayers, m_reqInstanceExtensions,
+                                               m_requestedDeviceExtensions, m_optDeviceExtensions);
+        VkResult result = enumerationContext.InitVulkanDevice(pAppName);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        std::vector<VkPhysicalDevice> physicalDevices;
+        result = vk::enumerate(&enumerationContext, enumerationContext.getInstance(), physicalDevices);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        for (VkPhysicalDevice physicalDevice : physicalDevices) {
+            VkPhysicalDeviceIDProperties idProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+            VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &idProps };
+            enumerationContext.GetPhysicalDeviceProperties2(physicalDevice, &props2);
+            std::array<uint8_t, VK_UUID_SIZE> deviceUuid;
+            std::copy(idProps.deviceUUID, idProps.deviceUUID + VK_UUID_SIZE, deviceUuid.begin());
+            deviceUuids.push_back(deviceUuid);
+        }
+    }
+
+    const bool decodeQueuesRequested = (requestQueueTypes & VK_QUEUE_VIDEO_DECODE_BIT_KHR) != 0;
+    const bool encodeQueuesRequested = (requestQueueTypes & VK_QUEUE_VIDEO_ENCODE_BIT_KHR) != 0;
+    for (uint32_t deviceNum = 0; deviceNum < deviceUuids.size(); deviceNum++) {
+
+        VulkanDeviceContext* pVkDevCtx = new VulkanDeviceContext(-1, m_reqInstanceLayers, m_reqInstanceExtensions,
+                                                                 m_requestedDeviceExtensions, m_optDeviceExtensions);
+        pVkDevCtx->SetDeviceUuid(deviceUuids[deviceNum].data());
+        pVkDevCtx->SetVideoQueuePriorities(m_numLiveVideoQueues, m_videoQueueGlobalPriority);
+
+        VkResult result = pVkDevCtx->InitVulkanDevice(pAppName);
+        if (result == VK_SUCCESS) {
+            result = pVkDevCtx->InitDebugReport(validate, validateVerbose);
+        }
+        if (result == VK_SUCCESS) {
+            result = pVkDevCtx->InitPhysicalDevice(requestQueueTypes, nullptr,
+                                                   requestVideoDecodeQueueMask, requestVideoDecodeQueueOperations,
+                                                   requestVideoEncodeQueueMask, requestVideoEncodeQueueOperations);
+        }
+        if (result == VK_SUCCESS) {
+            // Not all implementations support transfer on the video queues, a separate one is created for those
+            const bool videoQueuesWithoutTransfer =
+                    (decodeQueuesRequested && ((pVkDevCtx->GetVideoDecodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) == 0)) ||
+                    (encodeQueuesRequested && ((pVkDevCtx->GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) == 0));
+            result = pVkDevCtx->CreateVulkanDevice(decodeQueuesRequested ? -1 : 0, // all the decode queues
+                                                   encodeQueuesRequested ? -1 : 0, // all the encode queues
+                                                   createTransferQueue || videoQueuesWithoutTransfer,
+                                                   false, // createGraphicsQueue
+                                                   false, // createPresentQueue
+                                                   createComputeQueue);
+        }
+        if (result != VK_SUCCESS) {
+            std::cout << "Skipping the physical device " << deviceNum << " without the requested video queues ("
+                      << result << ")" << std::endl;
+            delete pVkDevCtx;
+            continue;
+        }
+
+        Device device;
+        device.pVkDevCtx = pVkDevCtx;
+        device.decodeQueueSessions.assign(decodeQueuesRequested ? std::max(pVkDevCtx->GetVideoDecodeNumQueues(), 0) : 0, 0);
+        device.encodeQueueSessions.assign(encodeQueuesRequested ? std::max(pVkDevCtx->GetVideoEncodeNumQueues(), 0) : 0, 0);
+        m_devices.push_back(device);
+    }
+
+    return m_devices.empty() ? VK_ERROR_FEATURE_NOT_PRESENT : VK_SUCCESS;
+}
+
+std::vector<uint32_t>* VulkanDeviceContextManager::GetQueueSessions(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                                                    uint32_t deviceIndex)
+{
+    if (deviceIndex >= m_devices.size()) {
+        return nullptr;
+    }
+    switch (queueType) {
+    case VulkanDeviceContext::DECODE:
+        return &m_devices[deviceIndex].decodeQueueSessions;
+    case VulkanDeviceContext::ENCODE:
+        return &m_devices[deviceIndex].encodeQueueSessions;
+    default:
+        return nullptr;
+    }
+}
+
+const std::vector<uint32_t>* VulkanDeviceContextManager::GetQueueSessions(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                                                          uint32_t deviceIndex) const
+{
+    return const_cast<VulkanDeviceContextManager*>(this)->GetQueueSessions(queueType, deviceIndex);
+}
+
+VkResult VulkanDeviceContextManager::AcquireStream(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                                   uint32_t& deviceIndex, int32_t& queueIndex,
+                                                   VulkanDeviceContext::VideoQueuePriority priority)
+{
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+
+    int32_t bestDevice = -1;
+    uint32_t bestSessions = 0;
+    size_t bestQueues = 0;
+    int32_t bestFirstQueue = 0;
+    for (uint32_t device = 0; device < m_devices.size(); device++) {
+        const std::vector<uint32_t>* pQueueSessions = GetQueueSessions(queueType, device);
+        if ((pQueueSessions == nullptr) || pQueueSessions->empty()) {
+            continue;
+        }
+        // Only the queues of the priority class of the stream
+        int32_t firstQueue = 0;
+        int32_t numQueues = (int32_t)pQueueSessions->size();
+        m_devices[device].pVkDevCtx->GetVideoQueueRange(queueType, priority, firstQueue, numQueues);
+        numQueues = std::min(numQueues, (int32_t)pQueueSessions->size() - firstQueue);
+        if (numQueues <= 0) {
+            continue;
+        }
+        const uint32_t sessions = std::accumulate(pQueueSessions->begin() + firstQueue,
+                                                  pQueueSessions->begin() + firstQueue + numQueues, 0U);
+        // sessions / queues < bestSessions / bestQueues, then the device with fewer sessions
+        const uint64_t load = (uint64_t)sessions * bestQueues;
+        const uint64_t bestLoad = (uint64_t)bestSessions * numQueues;
+        if ((bestDevice < 0) || (load < bestLoad) || ((load == bestLoad) && (sessions < bestSessions))) {
+            bestDevice = (int32_t)device;
+            bestSessions = sessions;
+            bestQueues = numQueues;
+            bestFirstQueue = firstQueue;
+        }
+    }
+    if (bestDevice < 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    std::vector<uint32_t>& queueSessions = *GetQueueSessions(queueType, (uint32_t)bestDevice);
+    const std::vector<uint32_t>::iterator queue = std::min_element(queueSessions.begin() + bestFirstQueue,
+                                                                   queueSessions.begin() + bestFirstQueue + bestQueues);
+    (*queue)++;
+
+    deviceIndex = (uint32_t)bestDevice;
+    queueIndex = (int32_t)(queue - queueSessions.begin());
+    return VK_SUCCESS;
+}
+
+void VulkanDeviceContextManager::ReleaseStream(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                               uint32_t deviceIndex, int32_t queueIndex)
+{
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+
+    std::vector<uint32_t>* pQueueSessions = GetQueueSessions(queueType, deviceIndex);
+    if ((pQueueSessions == nullptr) || (queueIndex < 0) || ((size_t)queueIndex >= pQueueSessions->size())) {
+        assert(!"Invalid stream to release!");
+        return;
+    }
+    assert((*pQueueSessions)[queueIndex] > 0);
+    (*pQueueSessions)[queueIndex]--;
+}
+
+uint32_t VulkanDeviceContextManager::GetNumActiveSessions(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                                          uint32_t deviceIndex) const
+{
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+
+    const std::vector<uint32_t>* pQueueSessions = GetQueueSessions(queueType, deviceIndex);
+    return (pQueueSessions != nullptr) ? std::accumulate(pQueueSessions->begin(), pQueueSessions->end(), 0U) : 0;
+}
+
+uint32_t VulkanDeviceContextManager::GetNumQueues(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                                  uint32_t deviceIndex) const
+{
+    const std::vector<uint32_t>* pQueueSessions = GetQueueSessions(queueType, deviceIndex);
+    return (pQueueSessions != nullptr) ? (uint32_t)pQueueSessions->size() : 0;
+}
+
+void VulkanDeviceContextManager::PrintDevices() const
+{
+    std::cout << "Opened " << m_devices.size() << " video devices:" << std::endl;
+    for (uint32_t device = 0; device < m_devices.size(); device++) {
+        VkPhysicalDeviceProperties props;
+        m_devices[device].pVkDevCtx->GetPhysicalDeviceProperties(m_devices[device].pVkDevCtx->getPhysicalDevice(), &props);
+        std::cout << "\t" << device << ": " << props.deviceName
+                  << ", decode queues: " << GetNumQueues(VulkanDeviceContext::DECODE, device)
+                  << " (" << GetNumActiveSessions(VulkanDeviceContext::DECODE, device) << " sessions)"
+                  << ", encode queues: " << GetNumQueues(VulkanDeviceContext::ENCODE, device)
+                  << " (" << GetNumActiveSessions(VulkanDeviceContext::ENCODE, device) << " sessions)"
+                  << std::endl;
+    }
+}
@@ -0,0 +1,101 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANDEVICECONTEXTMANAGER_H_
+#define _VKCODECUTILS_VULKANDEVICECONTEXTMANAGER_H_
+
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// Opens a VulkanDeviceContext on each of the physical devices with the requested video queues, for one process to
+// drive all the GPUs of the host. The streams are assigned to the device and the queue with the fewest sessions per
+// queue, so that a device with more hardware decoders or encoders takes proportionally more of them.
+class VulkanDeviceContextManager
+{
+public:
+    // The lists are kept by the device contexts, they must outlive the manager
+    VulkanDeviceContextManager(const char* const* reqInstanceLayers,
+                               const char* const* reqInstanceExtensions,
+                               const char* const* requestedDeviceExtensions,
+                               const char* const* optDeviceExtensions = nullptr);
+
+    ~VulkanDeviceContextManager();
+
+    // Creates the devices with all their decode and encode queues of the requested types. The physical devices
+    // without the queues or the extensions are skipped. Fails if none of them has them.
+    VkResult OpenAllDevices(const char* pAppName,
+                            const VkQueueFlags requestQueueTypes,
+                            const VkQueueFlags requestVideoDecodeQueueMask,
+                            const VkVideoCodecOperationFlagsKHR requestVideoDecodeQueueOperations,
+                            const VkQueueFlags requestVideoEncodeQueueMask,
+                            const VkVideoCodecOperationFlagsKHR requestVideoEncodeQueueOperations,
+                            bool createTransferQueue,
+                            bool createComputeQueue,
+                            bool validate = false,
+                            bool validateVerbose = false);
+
+    // The live and batch video queues of the devices opened next, see VulkanDeviceContext::SetVideoQueuePriorities()
+    void SetVideoQueuePriorities(int32_t numLiveQueues,
+                                 VkQueueGlobalPriorityKHR globalPriority = VkQueueGlobalPriorityKHR())
+    {
+        m_numLiveVideoQueues = numLiveQueues;
+        m_videoQueueGlobalPriority = globalPriority;
+    }
+
+    uint32_t GetNumDevices() const { return (uint32_t)m_devices.size(); }
+    VulkanDeviceContext* GetDeviceContext(uint32_t deviceIndex) const {
+        return (deviceIndex < m_devices.size()) ? m_devices[deviceIndex].pVkDevCtx : nullptr;
+    }
+
+    // Picks the device and the DECODE or ENCODE queue of a new stream, counted as a session of the queue until
+    // released. The least loaded device is the one with the fewest sessions per queue, then the queue of it with
+    // the fewest sessions. Only the queues of the priority class of the stream are considered.
+    VkResult AcquireStream(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                           uint32_t& deviceIndex, int32_t& queueIndex,
+                           VulkanDeviceContext::VideoQueuePriority priority = VulkanDeviceContext::VIDEO_QUEUE_PRIORITY_BATCH);
+    void ReleaseStream(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                       uint32_t deviceIndex, int32_t queueIndex);
+
+    // The active sessions and the queues of the type on the device
+    uint32_t GetNumActiveSessions(VulkanDeviceContext::QueueFamilySubmitType queueType, uint32_t deviceIndex) const;
+    uint32_t GetNumQueues(VulkanDeviceContext::QueueFamilySubmitType queueType, uint32_t deviceIndex) const;
+
+    // Prints the devices with their queue counts and sessions
+    void PrintDevices() const;
+
+private:
+    struct Device {
+        VulkanDeviceContext*  pVkDevCtx;
+        std::vector<uint32_t> decodeQueueSessions; // per decode queue
+        std::vector<uint32_t> encodeQueueSessions; // per encode queue
+    };
+
+    std::vector<uint32_t>* GetQueueSessions(VulkanDeviceContext::QueueFamilySubmitType queueType, uint32_t deviceIndex);
+    const std::vector<uint32_t>* GetQueueSessions(VulkanDeviceContext::QueueFamilySubmitType queueType,
+                                                  uint32_t deviceIndex) const;
+
+    const char* const*  m_reqInstanceLayers;
+    const char* const*  m_reqInstanceExtensions;
+    const char* const*  m_requestedDeviceExtensions;
+    const char* const*  m_optDeviceExtensions;
+    int32_t             m_numLiveVideoQueues;
+    VkQueueGlobalPriorityKHR m_videoQueueGlobalPriority;
+    mutable std::mutex  m_sessionsMutex;
+    std::vector<Device> m_devices;
+};
+
+#endif /* _VKCODECUTILS_VULKANDEVICECONTEXTMANAGER_H_ */
@@ -0,0 +1,291 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <iterator>
+#include "VkCodecUtils/VulkanDeviceMemoryArena.h"
+#include "VkCodecUtils/Helpers.h"
+
+VkResult VulkanDeviceMemoryArena::Create(const VulkanDeviceContext* vkDevCtx,
+                                         VkDeviceSize blockSize,
+                                         VkSharedBaseObj<VulkanDeviceMemoryArena>& deviceMemoryArena)
+{
+    if (blockSize == 0) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VulkanDeviceMemoryArena> memoryArena(new VulkanDeviceMemoryArena(vkDevCtx, blockSize));
+    if (!memoryArena) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    deviceMemoryArena = memoryArena;
+    return VK_SUCCESS;
+}
+
+VulkanDeviceMemoryArena::~VulkanDeviceMemoryArena()
+{
+    for (Block& block : m_blocks) {
+        // Every sub-allocation holds a reference to the arena, so all of them are gone by now.
+        assert(block.allocatedSize == 0);
+        DestroyBlock(block);
+    }
+    m_blocks.clear();
+}
+
+VkResult VulkanDeviceMemoryArena::Allocate(const VkMemoryRequirements& memoryRequirements,
+                                           VkMemoryPropertyFlags& memoryPropertyFlags,
+                                           bool linearResource,
+                                           Allocation& allocation)
+{
+    // Large resources would waste most of a block, or not fit at all
+    if (memoryRequirements.size > (m_blockSize / 2)) {
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    uint32_t memoryTypeIndex = 0;
+    VkResult result = vk::MapMemoryTypeToIndex(m_vkDevCtx, m_vkDevCtx->getPhysicalDevice(),
+                                               memoryRequirements.memoryTypeBits,
+                                               memoryPropertyFlags,
+                                               &memoryTypeIndex);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    VkDeviceSize offset = 0;
+    uint32_t blockIndex = 0;
+    for (; blockIndex < m_blocks.size(); blockIndex++) {
+        Block& block = m_blocks[blockIndex];
+        if ((block.memory != VK_NULL_HANDLE) &&
+                (block.memoryTypeIndex == memoryTypeIndex) &&
+                (block.linearResource == linearResource) &&
+                ((block.memoryPropertyFlags & memoryPropertyFlags) == memoryPropertyFlags) &&
+                AllocateFromBlock(block, memoryRequirements, offset)) {
+            break;
+        }
+    }
+
+    if (blockIndex == m_blocks.size()) {
+        result = CreateBlock(memoryTypeIndex, memoryPropertyFlags, linearResource, blockIndex);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        if (!AllocateFromBlock(m_blocks[blockIndex], memoryRequirements, offset)) {
+            assert(!"A new block can't fit the allocation!");
+            return VK_ERROR_OUT_OF_POOL_MEMORY;
+        }
+    }
+
+    const Block& block = m_blocks[blockIndex];
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = memoryRequirements.size;
+    allocation.pMappedData = (block.pMappedData != nullptr) ? (block.pMappedData + offset) : nullptr;
+    allocation.blockIndex = blockIndex;
+
+    return VK_SUCCESS;
+}
+
+void VulkanDeviceMemoryArena::Free(const Allocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(allocation.blockIndex < m_blocks.size());
+    Block& block = m_blocks[allocation.blockIndex];
+    assert(block.memory == allocation.memory);
+    assert(block.allocatedSize >= allocation.size);
+
+    VkDeviceSize offset = allocation.offset;
+    VkDeviceSize size = allocation.size;
+
+    // Coalesce with the free range after
+    std::map<VkDeviceSize, VkDeviceSize>::iterator next = block.freeRanges.lower_bound(offset);
+    if ((next != block.freeRanges.end()) && (next->first == (offset + size))) {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+
+    // and with the free range before
+    if (next != block.freeRanges.begin()) {
+        std::map<VkDeviceSize, VkDeviceSize>::iterator prev = std::prev(next);
+        assert((prev->first + prev->second) <= offset);
+        if ((prev->first + prev->second) == offset) {
+            prev->second += size;
+            offset = prev->first;
+            size = prev->second;
+        } else {
+            block.freeRanges[offset] = size;
+        }
+    } else {
+        block.freeRanges[offset] = size;
+    }
+
+    block.allocatedSize -= allocation.size;
+
+    if ((block.allocatedSize == 0) && !IsSpareBlock(allocation.blockIndex)) {
+        DestroyBlock(block);
+    }
+}
+
+uint32_t VulkanDeviceMemoryArena::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t numReleasedBlocks = 0;
+    for (Block& block : m_blocks) {
+        if ((block.memory != VK_NULL_HANDLE) && (block.allocatedSize == 0)) {
+            DestroyBlock(block);
+            numReleasedBlocks++;
+        }
+    }
+    return numReleasedBlocks;
+}
+
+uint32_t VulkanDeviceMemoryArena::GetNumBlocks()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t numBlocks = 0;
+    for (const Block& block : m_blocks) {
+        if (block.memory != VK_NULL_HANDLE) {
+            numBlocks++;
+        }
+    }
+    return numBlocks;
+}
+
+bool VulkanDeviceMemoryArena::AllocateFromBlock(Block& block, const VkMemoryRequirements& memoryRequirements,
+                                                VkDeviceSize& offset)
+{
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+
+    // First fit, the ranges are in offset order
+    for (std::map<VkDeviceSize, VkDeviceSize>::iterator range = block.freeRanges.begin();
+            range != block.freeRanges.end(); ++range) {
+
+        const VkDeviceSize rangeOffset = range->first;
+        const VkDeviceSize rangeEnd = range->first + range->second;
+        const VkDeviceSize alignedOffset = ((rangeOffset + (alignment - 1)) / alignment) * alignment;
+        if ((alignedOffset + memoryRequirements.size) > rangeEnd) {
+            continue;
+        }
+
+        block.freeRanges.erase(range);
+        // The alignment padding in front stays free, as well as the tail
+        if (alignedOffset > rangeOffset) {
+            block.freeRanges[rangeOffset] = alignedOffset - rangeOffset;
+        }
+        if ((alignedOffset + memoryRequirements.size) < rangeEnd) {
+            block.freeRanges[alignedOffset + memoryRequirements.size] = rangeEnd - (alignedOffset + memoryRequirements.size);
+        }
+
+        block.allocatedSize += memoryRequirements.size;
+        offset = alignedOffset;
+        return true;
+    }
+    return false;
+}
+
+VkResult VulkanDeviceMemoryArena::CreateBlock(uint32_t memoryTypeIndex, VkMemoryPropertyFlags memoryPropertyFlags,
+                                              bool linearResource, uint32_t& blockIndex)
+{
+    VkMemoryAllocateInfo allocInfo = VkMemoryAllocateInfo();
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = m_blockSize;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    // The buffers of the blocks may be descriptor buffers, bound by their device address
+    VkMemoryAllocateFlagsInfo allocFlagsInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr };
+    if (linearResource && m_vkDevCtx->GetDescriptorBufferSupport()) {
+        allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+        allocInfo.pNext = &allocFlagsInfo;
+    }
+
+    VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+    VkResult result = m_vkDevCtx->AllocateMemory(*m_vkDevCtx, &allocInfo, nullptr, &deviceMemory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    uint8_t* pMappedData = nullptr;
+    if (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        // A memory object can only be mapped once, so the whole block is mapped for all of its sub-allocations.
+        result = m_vkDevCtx->MapMemory(*m_vkDevCtx, deviceMemory, 0, VK_WHOLE_SIZE, 0, (void**)&pMappedData);
+        if (result != VK_SUCCESS) {
+            m_vkDevCtx->FreeMemory(*m_vkDevCtx, deviceMemory, nullptr);
+            assert(!"Couldn't MapMemory()!");
+            return result;
+        }
+    }
+
+    // Reuse the slot of a released block, the indexes of the live ones must not change.
+    for (blockIndex = 0; blockIndex < m_blocks.size(); blockIndex++) {
+        if (m_blocks[blockIndex].memory == VK_NULL_HANDLE) {
+            break;
+        }
+    }
+    if (blockIndex == m_blocks.size()) {
+        m_blocks.push_back(Block());
+    }
+
+    Block& block = m_blocks[blockIndex];
+    block.memory = deviceMemory;
+    block.size = m_blockSize;
+    block.memoryTypeIndex = memoryTypeIndex;
+    block.memoryPropertyFlags = memoryPropertyFlags;
+    block.linearResource = linearResource;
+    block.pMappedData = pMappedData;
+    block.allocatedSize = 0;
+    block.freeRanges.clear();
+    block.freeRanges[0] = m_blockSize;
+
+    return VK_SUCCESS;
+}
+
+void VulkanDeviceMemoryArena::DestroyBlock(Block& block)
+{
+    if (block.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    if (block.pMappedData != nullptr) {
+        m_vkDevCtx->UnmapMemory(*m_vkDevCtx, block.memory);
+        block.pMappedData = nullptr;
+    }
+
+    m_vkDevCtx->FreeMemory(*m_vkDevCtx, block.memory, nullptr);
+    block.memory = VK_NULL_HANDLE;
+    block.allocatedSize = 0;
+    block.freeRanges.clear();
+}
+
+bool VulkanDeviceMemoryArena::IsSpareBlock(uint32_t blockIndex)
+{
+    const Block& emptyBlock = m_blocks[blockIndex];
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+        const Block& block = m_blocks[i];
+        if ((i != blockIndex) && (block.memory != VK_NULL_HANDLE) && (block.allocatedSize == 0) &&
+                (block.memoryTypeIndex == emptyBlock.memoryTypeIndex) &&
+                (block.linearResource == emptyBlock.linearResource)) {
+            // There is already a spare block of this kind
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANDEVICEMEMORYARENA_H_
+#define _VULKANDEVICEMEMORYARENA_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// Sub-allocates images and buffers from large VkDeviceMemory blocks, instead of one vkAllocateMemory() each.
+// The blocks are kept per memory type and per resource kind: linear resources (buffers and linear images)
+// and optimal tiling images never share a block, so bufferImageGranularity does not apply.
+// The free ranges of a block are coalesced on every free, a block is released when it gets empty,
+// except for one spare block of each kind that is kept for the next allocation until Reset().
+class VulkanDeviceMemoryArena : public VkVideoRefCountBase
+{
+public:
+    enum { DEFAULT_BLOCK_SIZE_MB = 64 };
+
+    struct Allocation {
+        VkDeviceMemory memory;
+        VkDeviceSize   offset;
+        VkDeviceSize   size;
+        uint8_t*       pMappedData; // the block is persistently mapped if it is host visible
+        uint32_t       blockIndex;
+    };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkDeviceSize blockSize,
+                           VkSharedBaseObj<VulkanDeviceMemoryArena>& deviceMemoryArena);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the arena if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns VK_ERROR_OUT_OF_POOL_MEMORY if the request is too large for a block,
+    // such requests should get a dedicated allocation.
+    VkResult Allocate(const VkMemoryRequirements& memoryRequirements,
+                      VkMemoryPropertyFlags& memoryPropertyFlags,
+                      bool linearResource,
+                      Allocation& allocation);
+
+    void Free(const Allocation& allocation);
+
+    // Releases all the empty blocks. Returns the number of blocks released.
+    uint32_t Reset();
+
+    VkDeviceSize GetBlockSize() const { return m_blockSize; }
+    uint32_t GetNumBlocks();
+
+private:
+    struct Block {
+        VkDeviceMemory                         memory;
+        VkDeviceSize                           size;
+        uint32_t                               memoryTypeIndex;
+        VkMemoryPropertyFlags                  memoryPropertyFlags;
+        bool                                   linearResource;
+        uint8_t*                               pMappedData;
+        VkDeviceSize                           allocatedSize;
+        std::map<VkDeviceSize, VkDeviceSize>   freeRanges; // offset to size, sorted by offset
+    };
+
+    VulkanDeviceMemoryArena(const VulkanDeviceContext* vkDevCtx, VkDeviceSize blockSize)
+        : m_refCount(0)
+        , m_vkDevCtx(vkDevCtx)
+        , m_blockSize(blockSize)
+        , m_mutex()
+        , m_blocks() { }
+
+    virtual ~VulkanDeviceMemoryArena();
+
+    // These functions must be called with the m_mutex lock obtained
+    bool AllocateFromBlock(Block& block, const VkMemoryRequirements& memoryRequirements, VkDeviceSize& offset);
+    VkResult CreateBlock(uint32_t memoryTypeIndex, VkMemoryPropertyFlags memoryPropertyFlags,
+                         bool linearResource, uint32_t& blockIndex);
+    void DestroyBlock(Block& block);
+    bool IsSpareBlock(uint32_t blockIndex);
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    const VulkanDeviceContext* m_vkDevCtx;
+    const VkDeviceSize         m_blockSize;
+    std::mutex                 m_mutex;
+    std::vector<Block>         m_blocks; // released blocks have a null memory and are reused
+};
+
+#endif /* _VULKANDEVICEMEMORYARENA_H_ */
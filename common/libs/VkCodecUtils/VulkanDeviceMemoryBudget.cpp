@@ -0,0 +1,231 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <assert.h>
+#include <iostream>
+#include <string>
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+#include "VkCodecUtils/VkMetrics.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
+
+namespace {
+
+const uint64_t megaByte = 1024 * 1024;
+
+thread_local VulkanMemoryOwner t_currentOwner = VULKAN_MEMORY_OWNER_OTHER;
+
+// The gauges of the allocated memory by owner, registered once
+VkMetricGauge& GetOwnerGauge(VulkanMemoryOwner owner)
+{
+    struct OwnerGauges {
+        OwnerGauges()
+        {
+            for (uint32_t owner = 0; owner < VULKAN_MEMORY_OWNER_COUNT; owner++) {
+                const std::string labels = std::string("owner=\"") +
+                        VulkanDeviceMemoryBudget::GetOwnerName((VulkanMemoryOwner)owner) + "\"";
+                gauges[owner] = &VkMetrics::GetGauge("vk_device_memory_allocated_bytes",
+                                                     "The device memory allocated, by owner", labels);
+            }
+        }
+        VkMetricGauge* gauges[VULKAN_MEMORY_OWNER_COUNT];
+    };
+    static OwnerGauges ownerGauges;
+    return *ownerGauges.gauges[owner];
+}
+
+// The peak of the device local memory of all the owners, e.g. the figure the perf regression runs compare
+VkMetricGauge& GetDeviceLocalPeakGauge()
+{
+    static VkMetricGauge& gauge = VkMetrics::GetGauge("vk_device_memory_device_local_peak_bytes",
+                                                      "The peak of the device local memory allocated");
+    return gauge;
+}
+
+} // namespace
+
+std::atomic<uint64_t> VulkanDeviceMemoryBudget::s_allocatedSize[VULKAN_MEMORY_OWNER_COUNT];
+std::atomic<uint64_t> VulkanDeviceMemoryBudget::s_peakAllocatedSize[VULKAN_MEMORY_OWNER_COUNT];
+std::atomic<uint64_t> VulkanDeviceMemoryBudget::s_deviceLocalAllocatedSize(0);
+std::atomic<uint64_t> VulkanDeviceMemoryBudget::s_peakDeviceLocalAllocatedSize(0);
+std::atomic<uint64_t> VulkanDeviceMemoryBudget::s_limit(0);
+
+const char* VulkanDeviceMemoryBudget::GetOwnerName(VulkanMemoryOwner owner)
+{
+    static const char* const ownerNames[VULKAN_MEMORY_OWNER_COUNT] = {
+        "other", "dpb", "output", "input", "staging", "bitstream", "filter", "session"
+    };
+    return (owner < VULKAN_MEMORY_OWNER_COUNT) ? ownerNames[owner] : "unknown";
+}
+
+VulkanMemoryOwner VulkanDeviceMemoryBudget::GetCurrentOwner()
+{
+    return t_currentOwner;
+}
+
+VulkanMemoryOwner VulkanDeviceMemoryBudget::SetCurrentOwner(VulkanMemoryOwner owner)
+{
+    const VulkanMemoryOwner prevOwner = t_currentOwner;
+    t_currentOwner = owner;
+    return prevOwner;
+}
+
+void VulkanDeviceMemoryBudget::AddAllocation(VulkanMemoryOwner owner, VkDeviceSize size, bool deviceLocal)
+{
+    assert(owner < VULKAN_MEMORY_OWNER_COUNT);
+    const uint64_t allocatedSize = s_allocatedSize[owner].fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peakSize = s_peakAllocatedSize[owner].load(std::memory_order_relaxed);
+    while ((allocatedSize > peakSize) &&
+           !s_peakAllocatedSize[owner].compare_exchange_weak(peakSize, allocatedSize, std::memory_order_relaxed)) { }
+    if (deviceLocal) {
+        const uint64_t deviceLocalSize = s_deviceLocalAllocatedSize.fetch_add(size, std::memory_order_relaxed) + size;
+        uint64_t peakDeviceLocalSize = s_peakDeviceLocalAllocatedSize.load(std::memory_order_relaxed);
+        while (deviceLocalSize > peakDeviceLocalSize) {
+            if (s_peakDeviceLocalAllocatedSize.compare_exchange_weak(peakDeviceLocalSize, deviceLocalSize,
+                                                                      std::memory_order_relaxed)) {
+                GetDeviceLocalPeakGauge().Set((double)deviceLocalSize);
+                break;
+            }
+        }
+    }
+    GetOwnerGauge(owner).Set((double)allocatedSize);
+}
+
+void VulkanDeviceMemoryBudget::RemoveAllocation(VulkanMemoryOwner owner, VkDeviceSize size, bool deviceLocal)
+{
+    assert(owner < VULKAN_MEMORY_OWNER_COUNT);
+    const uint64_t allocatedSize = s_allocatedSize[owner].fetch_sub(size, std::memory_order_relaxed) - size;
+    if (deviceLocal) {
+        s_deviceLocalAllocatedSize.fetch_sub(size, std::memory_order_relaxed);
+    }
+    GetOwnerGauge(owner).Set((double)allocatedSize);
+}
+
+VkDeviceSize VulkanDeviceMemoryBudget::GetAllocatedSize(VulkanMemoryOwner owner)
+{
+    return s_allocatedSize[owner].load(std::memory_order_relaxed);
+}
+
+VkDeviceSize VulkanDeviceMemoryBudget::GetPeakAllocatedSize(VulkanMemoryOwner owner)
+{
+    return s_peakAllocatedSize[owner].load(std::memory_order_relaxed);
+}
+
+VkDeviceSize VulkanDeviceMemoryBudget::GetDeviceLocalAllocatedSize()
+{
+    return s_deviceLocalAllocatedSize.load(std::memory_order_relaxed);
+}
+
+VkDeviceSize VulkanDeviceMemoryBudget::GetPeakDeviceLocalAllocatedSize()
+{
+    return s_peakDeviceLocalAllocatedSize.load(std::memory_order_relaxed);
+}
+
+void VulkanDeviceMemoryBudget::SetLimit(VkDeviceSize limit)
+{
+    s_limit.store(limit, std::memory_order_relaxed);
+}
+
+VkDeviceSize VulkanDeviceMemoryBudget::GetAvailableDeviceLocalSize(const VulkanDeviceContext* vkDevCtx)
+{
+    const VkDeviceSize allocatedSize = GetDeviceLocalAllocatedSize();
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+    const bool hasMemoryBudget = (vkDevCtx->FindRequiredDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) != nullptr);
+    VkPhysicalDeviceMemoryProperties2 memoryProperties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+                                                           hasMemoryBudget ? &budgetProperties : nullptr };
+    vkDevCtx->GetPhysicalDeviceMemoryProperties2(vkDevCtx->getPhysicalDevice(), &memoryProperties);
+
+    VkDeviceSize availableSize = 0;
+    VkDeviceSize heapsSize = 0;
+    for (uint32_t heap = 0; heap < memoryProperties.memoryProperties.memoryHeapCount; heap++) {
+        if ((memoryProperties.memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+            continue;
+        }
+        heapsSize += memoryProperties.memoryProperties.memoryHeaps[heap].size;
+        if (hasMemoryBudget && (budgetProperties.heapBudget[heap] > budgetProperties.heapUsage[heap])) {
+            // The usage of the other processes included
+            availableSize += budgetProperties.heapBudget[heap] - budgetProperties.heapUsage[heap];
+        }
+    }
+    if (!hasMemoryBudget) {
+        availableSize = (heapsSize > allocatedSize) ? (heapsSize - allocatedSize) : 0;
+    }
+
+    const VkDeviceSize limit = s_limit.load(std::memory_order_relaxed);
+    if (limit != 0) {
+        availableSize = std::min(availableSize, (limit > allocatedSize) ? (limit - allocatedSize) : 0);
+    }
+    return availableSize;
+}
+
+VkDeviceSize VulkanDeviceMemoryBudget::EstimateImageSize(VkFormat format, const VkExtent2D& extent)
+{
+    // The planes padded to the 64x64 tiles of the optimal tiling of most devices
+    const VkDeviceSize width = (extent.width + 63) & ~63;
+    const VkDeviceSize height = (extent.height + 63) & ~63;
+
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(format);
+    if (mpInfo == nullptr) {
+        // A packed format, e.g. RGBA
+        return width * height * 4;
+    }
+
+    const VkDeviceSize bytesPerSample = (mpInfo->planesLayout.bpp == YCBCRA_8BPP) ? 1 : 2;
+    const VkDeviceSize lumaSize = width * height * bytesPerSample;
+    if (mpInfo->planesLayout.layout == YCBCR_SINGLE_PLANE_UNNORMALIZED) {
+        return lumaSize;
+    }
+    const VkDeviceSize chromaSize = (width >> mpInfo->planesLayout.secondaryPlaneSubsampledX) *
+                                    (height >> mpInfo->planesLayout.secondaryPlaneSubsampledY) *
+                                    bytesPerSample * 2;
+    return lumaSize + chromaSize;
+}
+
+int32_t VulkanDeviceMemoryBudget::Admit(const VulkanDeviceContext* vkDevCtx, const char* sessionName,
+                                        VkDeviceSize fixedSize, VkDeviceSize unitSize,
+                                        uint32_t minUnits, uint32_t maxUnits)
+{
+    const VkDeviceSize availableSize = GetAvailableDeviceLocalSize(vkDevCtx);
+    const VkDeviceSize requiredSize = fixedSize + (unitSize * minUnits);
+    if (requiredSize > availableSize) {
+        std::cerr << "The " << sessionName << " needs at least " << (requiredSize / megaByte)
+                  << " MB of device memory, only " << (availableSize / megaByte) << " MB are available" << std::endl;
+        return -1;
+    }
+
+    uint32_t numUnits = maxUnits;
+    if ((unitSize != 0) && ((fixedSize + (unitSize * maxUnits)) > availableSize)) {
+        numUnits = (uint32_t)std::min<VkDeviceSize>((availableSize - fixedSize) / unitSize, maxUnits);
+        std::cout << "The " << sessionName << " is reduced from " << maxUnits << " to " << numUnits
+                  << " frames in flight, to fit in the " << (availableSize / megaByte)
+                  << " MB of device memory available" << std::endl;
+    }
+    return (int32_t)numUnits;
+}
+
+void VulkanDeviceMemoryBudget::PrintReport()
+{
+    std::cout << "Device memory by owner, current / peak MB:" << std::endl;
+    for (uint32_t owner = 0; owner < VULKAN_MEMORY_OWNER_COUNT; owner++) {
+        if (GetPeakAllocatedSize((VulkanMemoryOwner)owner) == 0) {
+            continue;
+        }
+        std::cout << "\t" << GetOwnerName((VulkanMemoryOwner)owner) << ": "
+                  << (GetAllocatedSize((VulkanMemoryOwner)owner) / megaByte) << " / "
+                  << (GetPeakAllocatedSize((VulkanMemoryOwner)owner) / megaByte) << std::endl;
+    }
+}
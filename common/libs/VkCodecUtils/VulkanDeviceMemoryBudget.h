@@ -0,0 +1,134 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANDEVICEMEMORYBUDGET_H_
+#define _VULKANDEVICEMEMORYBUDGET_H_
+
+#include <atomic>
+#include <stdint.h>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// The subsystem a device memory allocation is made for
+enum VulkanMemoryOwner {
+    VULKAN_MEMORY_OWNER_OTHER = 0,
+    VULKAN_MEMORY_OWNER_DPB,       // the decoded and the reconstructed pictures
+    VULKAN_MEMORY_OWNER_OUTPUT,    // the decoder output images, when separate from the DPB
+    VULKAN_MEMORY_OWNER_INPUT,     // the encoder input images
+    VULKAN_MEMORY_OWNER_STAGING,   // the linear images and the buffers of the host copies
+    VULKAN_MEMORY_OWNER_BITSTREAM,
+    VULKAN_MEMORY_OWNER_FILTER,    // the images and the buffers of the compute filters and analysis
+    VULKAN_MEMORY_OWNER_SESSION,   // the memory bound to the video sessions
+    VULKAN_MEMORY_OWNER_COUNT
+};
+
+// The process wide accounting of the device memory by owner, and the admission control of the new sessions
+// against the memory budget of the device. The allocations are tagged with the owner of the thread making
+// them, set by a VulkanMemoryOwnerScope at the subsystem boundaries.
+class VulkanDeviceMemoryBudget
+{
+public:
+    static const char* GetOwnerName(VulkanMemoryOwner owner);
+
+    // The owner of the memory allocated by the calling thread
+    static VulkanMemoryOwner GetCurrentOwner();
+    // Returns the previous owner of the thread
+    static VulkanMemoryOwner SetCurrentOwner(VulkanMemoryOwner owner);
+
+    // By VulkanDeviceMemoryImpl and VulkanVideoSession, for the memory they allocate and free
+    static void AddAllocation(VulkanMemoryOwner owner, VkDeviceSize size, bool deviceLocal);
+    static void RemoveAllocation(VulkanMemoryOwner owner, VkDeviceSize size, bool deviceLocal);
+
+    static VkDeviceSize GetAllocatedSize(VulkanMemoryOwner owner);
+    static VkDeviceSize GetPeakAllocatedSize(VulkanMemoryOwner owner);
+    static VkDeviceSize GetDeviceLocalAllocatedSize();
+    static VkDeviceSize GetPeakDeviceLocalAllocatedSize();
+
+    // Caps the device local memory of the process, e.g. to its share of a device packed with other processes.
+    // 0 leaves it to the budget of the device.
+    static void SetLimit(VkDeviceSize limit);
+
+    // The device local memory still available to a new session: the budget of VK_EXT_memory_budget less the
+    // usage of all the processes, or without the extension the size of the heaps less the memory tracked here,
+    // within the limit
+    static VkDeviceSize GetAvailableDeviceLocalSize(const VulkanDeviceContext* vkDevCtx);
+
+    // A rough size of a 2D image of the format, for the estimates of the admission control
+    static VkDeviceSize EstimateImageSize(VkFormat format, const VkExtent2D& extent);
+
+    // The admission control of a new session needing fixedSize bytes plus a number of units of unitSize bytes,
+    // e.g. one per frame in flight. Returns the number of units that fit, from maxUnits down to minUnits,
+    // or -1 if not even minUnits do.
+    static int32_t Admit(const VulkanDeviceContext* vkDevCtx, const char* sessionName,
+                         VkDeviceSize fixedSize, VkDeviceSize unitSize,
+                         uint32_t minUnits, uint32_t maxUnits);
+
+    // The current and the peak memory of each owner
+    static void PrintReport();
+
+private:
+    static std::atomic<uint64_t> s_allocatedSize[VULKAN_MEMORY_OWNER_COUNT];
+    static std::atomic<uint64_t> s_peakAllocatedSize[VULKAN_MEMORY_OWNER_COUNT];
+    static std::atomic<uint64_t> s_deviceLocalAllocatedSize;
+    static std::atomic<uint64_t> s_peakDeviceLocalAllocatedSize;
+    static std::atomic<uint64_t> s_limit;
+};
+
+// Tags the memory allocated by the calling thread within the scope
+class VulkanMemoryOwnerScope
+{
+public:
+    explicit VulkanMemoryOwnerScope(VulkanMemoryOwner owner)
+        : m_prevOwner(VulkanDeviceMemoryBudget::SetCurrentOwner(owner))
+    {
+    }
+
+    ~VulkanMemoryOwnerScope()
+    {
+        VulkanDeviceMemoryBudget::SetCurrentOwner(m_prevOwner);
+    }
+
+private:
+    VulkanMemoryOwnerScope(const VulkanMemoryOwnerScope&);
+    VulkanMemoryOwnerScope& operator=(const VulkanMemoryOwnerScope&);
+
+    const VulkanMemoryOwner m_prevOwner;
+};
+
+// Prints the report of the device memory when it goes out of scope. Meant to be declared in main() before the
+// device, for the peaks of the whole run, the current memory left being leaked.
+class VulkanDeviceMemoryReport
+{
+public:
+    explicit VulkanDeviceMemoryReport(bool enable)
+        : m_enable(enable)
+    {
+    }
+
+    ~VulkanDeviceMemoryReport()
+    {
+        if (m_enable) {
+            VulkanDeviceMemoryBudget::PrintReport();
+        }
+    }
+
+private:
+    VulkanDeviceMemoryReport(const VulkanDeviceMemoryReport&);
+    VulkanDeviceMemoryReport& operator=(const VulkanDeviceMemoryReport&);
+
+    const bool m_enable;
+};
+
+#endif /* _VULKANDEVICEMEMORYBUDGET_H_ */
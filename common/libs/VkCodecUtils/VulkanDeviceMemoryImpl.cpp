@@ -15,9 +15,55 @@
 */
 
 #include <string.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 #include "VkCodecUtils/VulkanDeviceMemoryImpl.h"
 #include "VkCodecUtils/Helpers.h"
 
+static const size_t hugePageSize = 2 * 1024 * 1024;
+
+// Host memory of size, a multiple of hugePageSize, in the pages of the hugetlbfs pool when it has them reserved,
+// else aligned for the transparent huge pages where the kernel allows them. Freed with FreeHugePages().
+static void* AllocateHugePages(size_t size)
+{
+#if defined(__linux__)
+    void* pMemory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pMemory != MAP_FAILED) {
+        return pMemory;
+    }
+
+    // Mapped with the room to align it to a huge page, the rest unmapped
+    const size_t mappedSize = size + hugePageSize;
+    uint8_t* pMapped = (uint8_t*)mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*)pMapped == MAP_FAILED) {
+        return nullptr;
+    }
+    uint8_t* pAligned = (uint8_t*)vk::alignedSize((uintptr_t)pMapped, (uintptr_t)hugePageSize);
+    if (pAligned != pMapped) {
+        munmap(pMapped, pAligned - pMapped);
+    }
+    munmap(pAligned + size, (pMapped + mappedSize) - (pAligned + size));
+#if defined(MADV_HUGEPAGE)
+    madvise(pAligned, size, MADV_HUGEPAGE);
+#endif
+    return pAligned;
+#else
+    (void)size;
+    return nullptr;
+#endif
+}
+
+static void FreeHugePages(void* pMemory, size_t size)
+{
+#if defined(__linux__)
+    munmap(pMemory, size);
+#else
+    (void)pMemory;
+    (void)size;
+#endif
+}
+
 VkResult
 VulkanDeviceMemoryImpl::Create(const VulkanDeviceContext* vkDevCtx,
                                const VkMemoryRequirements& memoryRequirements,
@@ -42,6 +88,129 @@ VulkanDeviceMemoryImpl::Create(const VulkanDeviceContext* vkDevCtx,
     return result;
 }
 
+VkResult
+VulkanDeviceMemoryImpl::CreateFromArena(const VulkanDeviceContext* vkDevCtx,
+                                        const VkMemoryRequirements& memoryRequirements,
+                                        VkMemoryPropertyFlags& memoryPropertyFlags,
+                                        const void* pInitializeMemory, VkDeviceSize initializeMemorySize, bool clearMemory,
+                                        bool linearResource,
+                                        VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory)
+{
+    VkSharedBaseObj<VulkanDeviceMemoryArena> deviceMemoryArena(vkDevCtx->GetDeviceMemoryArena());
+    if (!deviceMemoryArena) {
+        return Create(vkDevCtx, memoryRequirements, memoryPropertyFlags,
+                      pInitializeMemory, initializeMemorySize, clearMemory,
+                      vulkanDeviceMemory);
+    }
+
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory(new VulkanDeviceMemoryImpl(vkDevCtx));
+    if (!vkDeviceMemory) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = vkDeviceMemory->InitializeFromArena(deviceMemoryArena, memoryRequirements,
+                                                          memoryPropertyFlags, linearResource);
+    if (result != VK_SUCCESS) {
+        // Too large for the arena blocks, or the arena could not grow
+        return Create(vkDevCtx, memoryRequirements, memoryPropertyFlags,
+                      pInitializeMemory, initializeMemorySize, clearMemory,
+                      vulkanDeviceMemory);
+    }
+
+    vkDeviceMemory->InitializeData(pInitializeMemory, initializeMemorySize, clearMemory);
+    vulkanDeviceMemory = vkDeviceMemory;
+
+    return result;
+}
+
+VkResult
+VulkanDeviceMemoryImpl::CreateFromHugePages(const VulkanDeviceContext* vkDevCtx,
+                                            const VkMemoryRequirements& memoryRequirements,
+                                            VkMemoryPropertyFlags& memoryPropertyFlags,
+                                            const void* pInitializeMemory, VkDeviceSize initializeMemorySize,
+                                            VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory)
+{
+    if (vkDevCtx->FindRequiredDeviceExtension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory(new VulkanDeviceMemoryImpl(vkDevCtx));
+    if (!vkDeviceMemory) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = vkDeviceMemory->InitializeFromHugePages(memoryRequirements, memoryPropertyFlags);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    vkDeviceMemory->InitializeData(pInitializeMemory, initializeMemorySize, false);
+    vulkanDeviceMemory = vkDeviceMemory;
+
+    return result;
+}
+
+VkResult
+VulkanDeviceMemoryImpl::CreateFromFd(const VulkanDeviceContext* vkDevCtx,
+                                     const VkMemoryRequirements& memoryRequirements,
+                                     VkMemoryPropertyFlags& memoryPropertyFlags,
+                                     VkExternalMemoryHandleTypeFlagBits handleType, int fd,
+                                     VkImage dedicatedImage,
+                                     VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory)
+{
+    if (vkDevCtx->FindRequiredDeviceExtension(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    if ((handleType == VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT) &&
+            (vkDevCtx->FindRequiredDeviceExtension(VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME) == nullptr)) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory(new VulkanDeviceMemoryImpl(vkDevCtx));
+    if (!vkDeviceMemory) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = vkDeviceMemory->InitializeFromFd(memoryRequirements, memoryPropertyFlags,
+                                                       handleType, fd, dedicatedImage);
+    if (result == VK_SUCCESS) {
+        vulkanDeviceMemory = vkDeviceMemory;
+    }
+
+    return result;
+}
+
+VkResult
+VulkanDeviceMemoryImpl::CreateExportable(const VulkanDeviceContext* vkDevCtx,
+                                         const VkMemoryRequirements& memoryRequirements,
+                                         VkMemoryPropertyFlags& memoryPropertyFlags,
+                                         VkExternalMemoryHandleTypeFlags exportHandleTypes,
+                                         VkImage dedicatedImage,
+                                         VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory)
+{
+    if (vkDevCtx->FindRequiredDeviceExtension(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> vkDeviceMemory(new VulkanDeviceMemoryImpl(vkDevCtx));
+    if (!vkDeviceMemory) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = vkDeviceMemory->InitializeExportable(memoryRequirements, memoryPropertyFlags,
+                                                           exportHandleTypes, dedicatedImage);
+    if (result == VK_SUCCESS) {
+        vulkanDeviceMemory = vkDeviceMemory;
+    }
+
+    return result;
+}
+
 VkResult VulkanDeviceMemoryImpl::CreateDeviceMemory(const VulkanDeviceContext* vkDevCtx,
                                                     const VkMemoryRequirements& memoryRequirements,
                                                     VkMemoryPropertyFlags& memoryPropertyFlags,
@@ -63,6 +232,13 @@ VkResult VulkanDeviceMemoryImpl::CreateDeviceMemory(const VulkanDeviceContext* v
                          memoryPropertyFlags,
                          &allocInfo.memoryTypeIndex);
 
+    // For the descriptor buffers, bound by their device address
+    VkMemoryAllocateFlagsInfo allocFlagsInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr };
+    if (vkDevCtx->GetDescriptorBufferSupport()) {
+        allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+        allocInfo.pNext = &allocFlagsInfo;
+    }
+
     // Allocate memory for the buffer
     VkResult result = vkDevCtx->AllocateMemory(*vkDevCtx, &allocInfo, nullptr, &deviceMemory);
     if (result != VK_SUCCESS) {
@@ -105,7 +281,194 @@ VkResult VulkanDeviceMemoryImpl::Initialize(const VkMemoryRequirements& memoryRe
 
     m_memoryPropertyFlags = memoryPropertyFlags;
     m_memoryRequirements = memoryRequirements;
+    TrackAllocation(VulkanDeviceMemoryBudget::GetCurrentOwner());
+
+    InitializeData(pInitializeMemory, initializeMemorySize, clearMemory);
+
+    return result;
+}
+
+VkResult VulkanDeviceMemoryImpl::InitializeFromArena(VkSharedBaseObj<VulkanDeviceMemoryArena>& deviceMemoryArena,
+                                                     const VkMemoryRequirements& memoryRequirements,
+                                                     VkMemoryPropertyFlags& memoryPropertyFlags,
+                                                     bool linearResource)
+{
+    Deinitialize();
+
+    VkResult result = deviceMemoryArena->Allocate(memoryRequirements, memoryPropertyFlags,
+                                                  linearResource, m_arenaAllocation);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_deviceMemoryArena = deviceMemoryArena;
+    m_memoryPropertyFlags = memoryPropertyFlags;
+    m_memoryRequirements = memoryRequirements;
+    m_deviceMemory = m_arenaAllocation.memory;
+    m_deviceMemoryOffset = m_arenaAllocation.offset;
+    // The arena keeps its host visible blocks mapped
+    m_deviceMemoryDataPtr = m_arenaAllocation.pMappedData;
+    TrackAllocation(VulkanDeviceMemoryBudget::GetCurrentOwner());
+
+    return result;
+}
+
+VkResult VulkanDeviceMemoryImpl::InitializeFromHugePages(const VkMemoryRequirements& memoryRequirements,
+                                                         VkMemoryPropertyFlags& memoryPropertyFlags)
+{
+    Deinitialize();
+
+    // The imported pointer and size must be aligned to minImportedHostPointerAlignment, a huge page covers it
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT externalMemoryHostProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT };
+    VkPhysicalDeviceProperties2 deviceProps2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &externalMemoryHostProps };
+    m_vkDevCtx->GetPhysicalDeviceProperties2(m_vkDevCtx->getPhysicalDevice(), &deviceProps2);
+    const VkDeviceSize importAlignment = std::max<VkDeviceSize>(externalMemoryHostProps.minImportedHostPointerAlignment,
+                                                                hugePageSize);
+    if ((importAlignment % hugePageSize) != 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+    const size_t allocationSize = (size_t)vk::alignedSize(memoryRequirements.size, importAlignment);
+
+    void* pHostMemory = AllocateHugePages(allocationSize);
+    if (pHostMemory == nullptr) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkMemoryHostPointerPropertiesEXT hostPointerProps = { VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT };
+    VkResult result = m_vkDevCtx->GetMemoryHostPointerPropertiesEXT(*m_vkDevCtx,
+                                                                    VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                                                                    pHostMemory, &hostPointerProps);
+    const uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits & hostPointerProps.memoryTypeBits;
+    if ((result != VK_SUCCESS) || (memoryTypeBits == 0)) {
+        FreeHugePages(pHostMemory, allocationSize);
+        return (result != VK_SUCCESS) ? result : VK_ERROR_INVALID_EXTERNAL_HANDLE;
+    }
+
+    VkImportMemoryHostPointerInfoEXT importMemoryInfo = { VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT };
+    importMemoryInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importMemoryInfo.pHostPointer = pHostMemory;
+
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importMemoryInfo };
+    allocInfo.allocationSize = allocationSize;
+    result = vk::MapMemoryTypeToIndex(m_vkDevCtx, m_vkDevCtx->getPhysicalDevice(),
+                                      memoryTypeBits, memoryPropertyFlags, &allocInfo.memoryTypeIndex);
+    if (result == VK_SUCCESS) {
+        result = m_vkDevCtx->AllocateMemory(*m_vkDevCtx, &allocInfo, nullptr, &m_deviceMemory);
+    }
+    if (result != VK_SUCCESS) {
+        FreeHugePages(pHostMemory, allocationSize);
+        return result;
+    }
+
+    // The host accesses the pages through their own mapping, never through vkMapMemory()
+    m_hostAllocation = pHostMemory;
+    m_hostAllocationSize = allocationSize;
+    m_deviceMemoryDataPtr = (uint8_t*)pHostMemory;
+    m_memoryPropertyFlags = memoryPropertyFlags;
+    m_memoryRequirements = memoryRequirements;
+    TrackAllocation(VulkanDeviceMemoryBudget::GetCurrentOwner());
+
+    return result;
+}
+
+VkResult VulkanDeviceMemoryImpl::InitializeExportable(const VkMemoryRequirements& memoryRequirements,
+                                                      VkMemoryPropertyFlags& memoryPropertyFlags,
+                                                      VkExternalMemoryHandleTypeFlags exportHandleTypes,
+                                                      VkImage dedicatedImage)
+{
+    Deinitialize();
+
+    // Not sub-allocated from the arena, the importers map the whole memory
+    VkMemoryDedicatedAllocateInfo dedicatedAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+    dedicatedAllocateInfo.image = dedicatedImage;
+
+    VkExportMemoryAllocateInfo exportMemoryInfo = { VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+                                                    (dedicatedImage != VK_NULL_HANDLE) ? &dedicatedAllocateInfo : nullptr };
+    exportMemoryInfo.handleTypes = exportHandleTypes;
+
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &exportMemoryInfo };
+    allocInfo.allocationSize = memoryRequirements.size;
+    VkResult result = MapMemoryTypeToIndex(m_vkDevCtx, m_vkDevCtx->getPhysicalDevice(),
+                                           memoryRequirements.memoryTypeBits, memoryPropertyFlags,
+                                           &allocInfo.memoryTypeIndex);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    result = m_vkDevCtx->AllocateMemory(*m_vkDevCtx, &allocInfo, nullptr, &m_deviceMemory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_memoryPropertyFlags = memoryPropertyFlags;
+    m_memoryRequirements = memoryRequirements;
+    m_exportHandleTypes = exportHandleTypes;
+    TrackAllocation(VulkanDeviceMemoryBudget::GetCurrentOwner());
+
+    return result;
+}
+
+VkResult VulkanDeviceMemoryImpl::ExportFd(VkExternalMemoryHandleTypeFlagBits handleType, int* pFd) const
+{
+    if ((m_exportHandleTypes & handleType) == 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VkMemoryGetFdInfoKHR getFdInfo = { VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR, nullptr,
+                                             m_deviceMemory, handleType };
+    return m_vkDevCtx->GetMemoryFdKHR(*m_vkDevCtx, &getFdInfo, pFd);
+}
+
+VkResult VulkanDeviceMemoryImpl::InitializeFromFd(const VkMemoryRequirements& memoryRequirements,
+                                                  VkMemoryPropertyFlags& memoryPropertyFlags,
+                                                  VkExternalMemoryHandleTypeFlagBits handleType, int fd,
+                                                  VkImage dedicatedImage)
+{
+    Deinitialize();
+
+    // A dma-buf can only be imported to the memory types of its exporter
+    uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits;
+    if (handleType == VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT) {
+        VkMemoryFdPropertiesKHR memoryFdProperties = { VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR };
+        VkResult result = m_vkDevCtx->GetMemoryFdPropertiesKHR(*m_vkDevCtx, handleType, fd, &memoryFdProperties);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        memoryTypeBits &= memoryFdProperties.memoryTypeBits;
+    }
+
+    VkMemoryDedicatedAllocateInfo dedicatedAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+    dedicatedAllocateInfo.image = dedicatedImage;
+
+    VkImportMemoryFdInfoKHR importMemoryFdInfo = { VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+                                                   (dedicatedImage != VK_NULL_HANDLE) ? &dedicatedAllocateInfo : nullptr };
+    importMemoryFdInfo.handleType = handleType;
+    importMemoryFdInfo.fd = fd;
+
+    VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importMemoryFdInfo };
+    allocInfo.allocationSize = memoryRequirements.size;
+    VkResult result = MapMemoryTypeToIndex(m_vkDevCtx, m_vkDevCtx->getPhysicalDevice(),
+                                           memoryTypeBits, memoryPropertyFlags,
+                                           &allocInfo.memoryTypeIndex);
+    if (result != VK_SUCCESS) {
+        return VK_ERROR_INVALID_EXTERNAL_HANDLE;
+    }
+
+    result = m_vkDevCtx->AllocateMemory(*m_vkDevCtx, &allocInfo, nullptr, &m_deviceMemory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_memoryPropertyFlags = memoryPropertyFlags;
+    m_memoryRequirements = memoryRequirements;
+
+    return result;
+}
 
+void VulkanDeviceMemoryImpl::InitializeData(const void* pInitializeMemory,
+                                            VkDeviceSize initializeMemorySize,
+                                            bool clearMemory)
+{
     if (m_memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
 
         VkDeviceSize copySize = std::min<VkDeviceSize>(initializeMemorySize, m_memoryRequirements.size);
@@ -118,11 +481,38 @@ VkResult VulkanDeviceMemoryImpl::Initialize(const VkMemoryRequirements& memoryRe
             MemsetData(0x0, copySize, m_memoryRequirements.size - copySize);
         }
     }
-    return result;
+}
+
+void VulkanDeviceMemoryImpl::TrackAllocation(VulkanMemoryOwner owner)
+{
+    m_memoryOwner = owner;
+    m_trackedSize = m_memoryRequirements.size;
+    VulkanDeviceMemoryBudget::AddAllocation(m_memoryOwner, m_trackedSize,
+                                            (m_memoryPropertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0);
 }
 
 void VulkanDeviceMemoryImpl::Deinitialize()
 {
+    if (m_trackedSize != 0) {
+        VulkanDeviceMemoryBudget::RemoveAllocation(m_memoryOwner, m_trackedSize,
+                                                   (m_memoryPropertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0);
+        m_trackedSize = 0;
+    }
+
+    if (m_deviceMemoryArena) {
+        // The memory and its mapping belong to the arena
+        m_deviceMemoryArena->Free(m_arenaAllocation);
+        m_deviceMemoryArena = nullptr;
+        m_arenaAllocation = VulkanDeviceMemoryArena::Allocation();
+        m_deviceMemoryDataPtr = nullptr;
+        m_deviceMemory = VK_NULL_HANDLE;
+    }
+
+    if (m_hostAllocation != nullptr) {
+        // Not mapped by vkMapMemory(), the pages are released once the imported memory is freed
+        m_deviceMemoryDataPtr = nullptr;
+    }
+
     if (m_deviceMemoryDataPtr != nullptr) {
         m_vkDevCtx->UnmapMemory(*m_vkDevCtx, m_deviceMemory);
         m_deviceMemoryDataPtr = nullptr;
@@ -133,6 +523,12 @@ void VulkanDeviceMemoryImpl::Deinitialize()
         m_deviceMemory = VK_NULL_HANDLE;
     }
 
+    if (m_hostAllocation != nullptr) {
+        FreeHugePages(m_hostAllocation, m_hostAllocationSize);
+        m_hostAllocation = nullptr;
+        m_hostAllocationSize = 0;
+    }
+
     m_deviceMemoryOffset = 0;
 }
 
@@ -148,7 +544,7 @@ VkResult VulkanDeviceMemoryImpl::FlushInvalidateMappedMemoryRange(VkDeviceSize o
             VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,  // sType
             NULL,                                   // pNext
             m_deviceMemory,                         // memory
-            offset,                                 // offset
+            m_deviceMemoryOffset + offset,          // offset
             size,                                   // size
         };
 
@@ -181,13 +577,18 @@ VkResult VulkanDeviceMemoryImpl::CopyDataToMemory(const uint8_t* pData,
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    uint8_t* pDst = NULL;
     assert((memoryOffset + size) <= m_memoryRequirements.size);
-    VkResult result = m_vkDevCtx->MapMemory(*m_vkDevCtx, m_deviceMemory, memoryOffset,
-                                            size, 0, (void**)&pDst);
 
-    if (result != VK_SUCCESS) {
-        return result;
+    // The memory can only be mapped once, use the existing mapping if there is one.
+    const bool isMapped = (m_deviceMemoryDataPtr != nullptr);
+    uint8_t* pDst = isMapped ? (m_deviceMemoryDataPtr + memoryOffset) : NULL;
+    VkResult result = VK_SUCCESS;
+    if (!isMapped) {
+        result = m_vkDevCtx->MapMemory(*m_vkDevCtx, m_deviceMemory, m_deviceMemoryOffset + memoryOffset,
+                                       size, 0, (void**)&pDst);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
     }
 
     memcpy(pDst, pData, (size_t)size);
@@ -198,7 +599,9 @@ VkResult VulkanDeviceMemoryImpl::CopyDataToMemory(const uint8_t* pData,
         return result;
     }
 
-    m_vkDevCtx->UnmapMemory(*m_vkDevCtx, m_deviceMemory);
+    if (!isMapped) {
+        m_vkDevCtx->UnmapMemory(*m_vkDevCtx, m_deviceMemory);
+    }
 
     return VK_SUCCESS;
 }
@@ -219,6 +622,7 @@ VkDeviceSize VulkanDeviceMemoryImpl::Resize(VkDeviceSize newSize, VkDeviceSize c
         return VK_SUCCESS;
     }
 
+    // The resized memory is always a dedicated allocation, even if the current one is from an arena.
     VkMemoryRequirements memoryRequirements(m_memoryRequirements);
     memoryRequirements.size = ((newSize + (memoryRequirements.alignment - 1)) & ~(memoryRequirements.alignment - 1));
     VkDeviceMemory  newDeviceMemory = VK_NULL_HANDLE;
@@ -256,6 +660,8 @@ VkDeviceSize VulkanDeviceMemoryImpl::Resize(VkDeviceSize newSize, VkDeviceSize c
         memcpy(newBufferDataPtr, readData, (size_t)copySize);
     }
 
+    // The resized memory keeps the owner of the current one
+    const VulkanMemoryOwner owner = m_memoryOwner;
     Deinitialize();
 
     m_memoryRequirements = memoryRequirements;
@@ -263,6 +669,7 @@ VkDeviceSize VulkanDeviceMemoryImpl::Resize(VkDeviceSize newSize, VkDeviceSize c
     m_deviceMemory = newDeviceMemory;
     m_deviceMemoryOffset = newBufferOffset;
     m_deviceMemoryDataPtr = newBufferDataPtr;
+    TrackAllocation(owner);
 
     if (copySize == 0) {
 #ifdef CLEAR_DEVICE_MEMORY_ON_CREATE
@@ -288,6 +695,10 @@ uint8_t* VulkanDeviceMemoryImpl::CheckAccess(VkDeviceSize offset, VkDeviceSize s
 
     if (offset + size <= m_memoryRequirements.size) {
         if (m_deviceMemoryDataPtr == nullptr) {
+            if (m_deviceMemoryArena) {
+                assert(!"The arena memory is not host visible!");
+                return nullptr;
+            }
             VkResult result = m_vkDevCtx->MapMemory(*m_vkDevCtx, m_deviceMemory, m_deviceMemoryOffset,
                                                     m_memoryRequirements.size, 0, (void**)&m_deviceMemoryDataPtr);
             if ((result != VK_SUCCESS) || (m_deviceMemoryDataPtr == nullptr)) {
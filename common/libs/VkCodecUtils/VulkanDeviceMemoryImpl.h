@@ -20,6 +20,8 @@
 #include <atomic>
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanDeviceMemoryArena.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
 
 class VulkanDeviceMemoryImpl : public VkVideoRefCountBase
 {
@@ -31,6 +33,41 @@ public:
                            const void* pInitializeMemory, VkDeviceSize initializeMemorySize, bool clearMemory,
                            VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
 
+    // Sub-allocates the memory from the device memory arena, if there is one.
+    // Falls back to a dedicated allocation without an arena or if the request is too large for it.
+    static VkResult CreateFromArena(const VulkanDeviceContext* vkDevCtx,
+                                    const VkMemoryRequirements& memoryRequirements,
+                                    VkMemoryPropertyFlags& memoryPropertyFlags,
+                                    const void* pInitializeMemory, VkDeviceSize initializeMemorySize, bool clearMemory,
+                                    bool linearResource,
+                                    VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
+
+    // Imports the memory of a file descriptor, like the dma-buf of a capture device, as the dedicated
+    // allocation of the image. The memory owns the descriptor on success, the caller keeps it on failure.
+    static VkResult CreateFromFd(const VulkanDeviceContext* vkDevCtx,
+                                 const VkMemoryRequirements& memoryRequirements,
+                                 VkMemoryPropertyFlags& memoryPropertyFlags,
+                                 VkExternalMemoryHandleTypeFlagBits handleType, int fd,
+                                 VkImage dedicatedImage,
+                                 VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
+
+    // A dedicated allocation of the image that can be exported with ExportFd() to another process or API
+    static VkResult CreateExportable(const VulkanDeviceContext* vkDevCtx,
+                                     const VkMemoryRequirements& memoryRequirements,
+                                     VkMemoryPropertyFlags& memoryPropertyFlags,
+                                     VkExternalMemoryHandleTypeFlags exportHandleTypes,
+                                     VkImage dedicatedImage,
+                                     VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
+
+    // Allocates the memory in 2 MB huge pages of host memory and imports them with VK_EXT_external_memory_host,
+    // for the staging buffers the host writes or reads in full. The driver pins the pages for the lifetime of the
+    // memory. The resource must be created for VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT.
+    static VkResult CreateFromHugePages(const VulkanDeviceContext* vkDevCtx,
+                                        const VkMemoryRequirements& memoryRequirements,
+                                        VkMemoryPropertyFlags& memoryPropertyFlags,
+                                        const void* pInitializeMemory, VkDeviceSize initializeMemorySize,
+                                        VkSharedBaseObj<VulkanDeviceMemoryImpl>& vulkanDeviceMemory);
+
     virtual int32_t AddRef()
     {
         return ++m_refCount;
@@ -66,13 +103,23 @@ public:
     virtual void InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const;
 
     virtual VkDeviceMemory GetDeviceMemory() const { return m_deviceMemory; }
+    // The offset of the memory within GetDeviceMemory(), non-zero when sub-allocated from an arena.
+    // The resources must be bound at this offset, all the data offsets are relative to it.
+    VkDeviceSize GetDeviceMemoryOffset() const { return m_deviceMemoryOffset; }
     operator VkDeviceMemory() { return m_deviceMemory; }
     operator bool() { return m_deviceMemory != VK_NULL_HANDLE; }
 
     VkMemoryPropertyFlags GetMemoryPropertyFlags() const { return m_memoryPropertyFlags; }
 
+    // A new file descriptor of the memory, owned by the caller, for the memory created exportable
+    VkResult ExportFd(VkExternalMemoryHandleTypeFlagBits handleType, int* pFd) const;
+    VkExternalMemoryHandleTypeFlags GetExportHandleTypes() const { return m_exportHandleTypes; }
+
     const VkMemoryRequirements& GetMemoryRequirements() const { return m_memoryRequirements; }
 
+    // The subsystem the memory was allocated for, see VulkanMemoryOwnerScope
+    VulkanMemoryOwner GetMemoryOwner() const { return m_memoryOwner; }
+
     VkResult FlushInvalidateMappedMemoryRange(VkDeviceSize offset, VkDeviceSize size, bool flush = true)  const;
 
     VkResult CopyDataToMemory(const uint8_t* pData, VkDeviceSize size,
@@ -95,6 +142,31 @@ private:
                         VkDeviceSize initializeMemorySize,
                         bool clearMemory);
 
+    VkResult InitializeExportable(const VkMemoryRequirements& memoryRequirements,
+                                  VkMemoryPropertyFlags& memoryPropertyFlags,
+                                  VkExternalMemoryHandleTypeFlags exportHandleTypes,
+                                  VkImage dedicatedImage);
+
+    VkResult InitializeFromFd(const VkMemoryRequirements& memoryRequirements,
+                              VkMemoryPropertyFlags& memoryPropertyFlags,
+                              VkExternalMemoryHandleTypeFlagBits handleType, int fd,
+                              VkImage dedicatedImage);
+
+    VkResult InitializeFromHugePages(const VkMemoryRequirements& memoryRequirements,
+                                     VkMemoryPropertyFlags& memoryPropertyFlags);
+
+    VkResult InitializeFromArena(VkSharedBaseObj<VulkanDeviceMemoryArena>& deviceMemoryArena,
+                                 const VkMemoryRequirements& memoryRequirements,
+                                 VkMemoryPropertyFlags& memoryPropertyFlags,
+                                 bool linearResource);
+
+    // Accounts the memory to its owner in VulkanDeviceMemoryBudget, until Deinitialize()
+    void TrackAllocation(VulkanMemoryOwner owner);
+
+    void InitializeData(const void* pInitializeMemory,
+                        VkDeviceSize initializeMemorySize,
+                        bool clearMemory);
+
     VulkanDeviceMemoryImpl(const VulkanDeviceContext* vkDevCtx)
         : m_refCount(0)
         , m_vkDevCtx(vkDevCtx)
@@ -102,7 +174,14 @@ private:
         , m_memoryPropertyFlags()
         , m_deviceMemory()
         , m_deviceMemoryOffset()
-        , m_deviceMemoryDataPtr(nullptr) { }
+        , m_deviceMemoryDataPtr(nullptr)
+        , m_deviceMemoryArena()
+        , m_arenaAllocation()
+        , m_exportHandleTypes()
+        , m_memoryOwner(VULKAN_MEMORY_OWNER_OTHER)
+        , m_trackedSize(0)
+        , m_hostAllocation(nullptr)
+        , m_hostAllocationSize(0) { }
 
     void Deinitialize();
 
@@ -116,6 +195,13 @@ private:
     VkDeviceMemory             m_deviceMemory;
     VkDeviceSize               m_deviceMemoryOffset;
     uint8_t*                   m_deviceMemoryDataPtr;
+    VkSharedBaseObj<VulkanDeviceMemoryArena> m_deviceMemoryArena;
+    VulkanDeviceMemoryArena::Allocation      m_arenaAllocation;
+    VkExternalMemoryHandleTypeFlags          m_exportHandleTypes;
+    VulkanMemoryOwner                        m_memoryOwner;
+    VkDeviceSize                             m_trackedSize; // accounted to m_memoryOwner, 0 for the imported memory
+    void*                                    m_hostAllocation; // the huge pages imported, mapped at m_deviceMemoryDataPtr
+    size_t                                   m_hostAllocationSize;
 };
 
 #endif /* _VULKANDEVICEMEMORYIMPL_H_ */
@@ -29,13 +29,18 @@ public:
     int32_t  displayHeight;   // Valid usable height of the image
     uint64_t decodeOrder;
     uint64_t displayOrder;
-    uint64_t timestamp;
+    uint64_t timestamp;       // presentation time stamp of the container, in 100 ns units, 0 without it
+    uint64_t decodeTimestamp; // decode time stamp of the container, in 100 ns units, 0 without it
     VkSharedBaseObj<VkImageResourceView> imageView; // input or output image view resource to be displayed
     VkSharedBaseObj<VkImageResourceView> dpbImageView;   // dpb image view (optional)
     VkFence frameCompleteFence; // If valid, the fence is signaled when the decoder or encoder is done decoding / encoding the frame.
     VkFence frameConsumerDoneFence; // If valid, the fence is signaled when the consumer (graphics, compute or display) is done using the frame.
     VkSemaphore frameCompleteSemaphore; // If valid, the semaphore is signaled when the decoder or encoder is done decoding / encoding the frame.
     VkSemaphore frameConsumerDoneSemaphore; // If valid, the semaphore is signaled when the consumer (graphics, compute or display) is done using the frame.
+    VkSemaphore frameCompleteTimelineSemaphore; // If valid, the timeline semaphore reaches frameCompleteTimelineValue when the post-process filter, or the encoder input upload, is done with the frame.
+    uint64_t frameCompleteTimelineValue;
+    VkSemaphore frameConsumerDoneTimelineSemaphore; // If set by the consumer, the frame is reused once the timeline semaphore reaches frameConsumerDoneTimelineValue on the device, it can be released before then.
+    uint64_t frameConsumerDoneTimelineValue;
     VkQueryPool queryPool;                  // queryPool handle used for the video queries.
     int32_t startQueryId;                   // query Id used for the this frame.
     uint32_t numQueries;                    // usually one query per frame
@@ -57,11 +62,16 @@ public:
         frameConsumerDoneFence = VkFence();
         frameCompleteSemaphore = VkSemaphore();
         frameConsumerDoneSemaphore = VkSemaphore();
+        frameCompleteTimelineSemaphore = VkSemaphore();
+        frameCompleteTimelineValue = 0;
+        frameConsumerDoneTimelineSemaphore = VkSemaphore();
+        frameConsumerDoneTimelineValue = 0;
         queryPool = VkQueryPool();
         startQueryId = 0;
         numQueries = 0;
         submittedVideoQueueIndex = 0;
         timestamp = 0;
+        decodeTimestamp = 0;
         hasConsummerSignalFence = false;
         hasConsummerSignalSemaphore = false;
         // For debugging
@@ -77,12 +87,17 @@ public:
     , decodeOrder()
     , displayOrder()
     , timestamp()
+    , decodeTimestamp()
     , imageView()
     , dpbImageView()
     , frameCompleteFence()
     , frameConsumerDoneFence()
     , frameCompleteSemaphore()
     , frameConsumerDoneSemaphore()
+    , frameCompleteTimelineSemaphore()
+    , frameCompleteTimelineValue()
+    , frameConsumerDoneTimelineSemaphore()
+    , frameConsumerDoneTimelineValue()
     , queryPool()
     , startQueryId()
     , numQueries()
@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <string>
+#include <vector>
 
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
@@ -41,7 +42,10 @@ public:
           m_vulkanShaderCompiler(),
           m_queueFamilyIndex(queueFamilyIndex),
           m_queueIndex(queueIndex),
-          m_queue()
+          m_queue(),
+          m_filterCompleteTimelineSemaphore(),
+          m_filterCompleteTimelineValue(0),
+          m_frameTimelineValues()
     {
         m_vkDevCtx->GetDeviceQueue(*m_vkDevCtx, queueFamilyIndex, queueIndex, &m_queue);
     }
@@ -49,6 +53,10 @@ public:
     virtual ~VulkanFilter()
     {
         assert(m_vkDevCtx != nullptr);
+        if (m_filterCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+            m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_filterCompleteTimelineSemaphore, nullptr);
+            m_filterCompleteTimelineSemaphore = VK_NULL_HANDLE;
+        }
         m_vkDevCtx = nullptr;
     }
 
@@ -94,12 +102,24 @@ public:
 
     virtual VkFence GetFilterSignalFence(uint32_t frameIdx) const = 0;
 
+    // The timeline semaphore each submission of the filter signals on its completion, with the value of the
+    // last submission of the frame. VK_NULL_HANDLE and 0 without the timeline semaphore.
+    VkSemaphore GetFilterCompleteTimelineSemaphore() const
+    {
+        return m_filterCompleteTimelineSemaphore;
+    }
+
+    uint64_t GetFilterCompleteTimelineValue(uint32_t frameIdx) const
+    {
+        return (frameIdx < m_frameTimelineValues.size()) ? m_frameTimelineValues[frameIdx] : 0;
+    }
+
     virtual VkResult SubmitCommandBuffer(uint32_t frameIdx,
                                          uint32_t waitSemaphoreCount,
                                          const VkSemaphore* pWaitSemaphores,
                                          uint32_t signalSemaphoreCount,
                                          const VkSemaphore* pSignalSemaphores,
-                                         VkFence filterCompleteFence) const
+                                         VkFence filterCompleteFence)
     {
 
         assert(m_queue != VK_NULL_HANDLE);
@@ -107,16 +127,71 @@ public:
         // Wait for rendering finished
         VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
+        const uint32_t maxSignalSemaphores = 4;
+        assert(signalSemaphoreCount < maxSignalSemaphores);
+        VkSemaphore signalSemaphores[maxSignalSemaphores] = {};
+        uint64_t signalSemaphoreValues[maxSignalSemaphores] = { 0 /* ignored for binary semaphores */ };
+        for (uint32_t i = 0; i < signalSemaphoreCount; i++) {
+            signalSemaphores[i] = pSignalSemaphores[i];
+        }
+
+        VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+        const bool signalTimeline = (m_filterCompleteTimelineSemaphore != VK_NULL_HANDLE) &&
+                                    (frameIdx < m_frameTimelineValues.size());
+        if (signalTimeline) {
+            signalSemaphores[signalSemaphoreCount] = m_filterCompleteTimelineSemaphore;
+            signalSemaphoreValues[signalSemaphoreCount] = m_filterCompleteTimelineValue + 1;
+            signalSemaphoreCount++;
+            timelineSemaphoreInfo.signalSemaphoreValueCount = signalSemaphoreCount;
+            timelineSemaphoreInfo.pSignalSemaphoreValues = signalSemaphoreValues;
+        }
+
         // Submit compute commands
         VkSubmitInfo submitInfo {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = signalTimeline ? &timelineSemaphoreInfo : nullptr;
         submitInfo.commandBufferCount = GetSubmitCommandBuffers(frameIdx, &submitInfo.pCommandBuffers);
         submitInfo.waitSemaphoreCount = waitSemaphoreCount;
         submitInfo.pWaitSemaphores = pWaitSemaphores;
         submitInfo.pWaitDstStageMask = &waitStageMask;
         submitInfo.signalSemaphoreCount = signalSemaphoreCount;
-        submitInfo.pSignalSemaphores = pSignalSemaphores;
-        return m_vkDevCtx->QueueSubmit(m_queue, 1, &submitInfo, filterCompleteFence);
+        submitInfo.pSignalSemaphores = signalSemaphores;
+        VkResult result = m_vkDevCtx->QueueSubmit(m_queue, 1, &submitInfo, filterCompleteFence);
+        if ((result == VK_SUCCESS) && signalTimeline) {
+            m_frameTimelineValues[frameIdx] = ++m_filterCompleteTimelineValue;
+        }
+        return result;
+    }
+
+protected:
+    // Creates the timeline semaphore the submissions of the maxNumFrames frames signal. Without it, the filter
+    // completion is only signaled with the semaphores and the fence of the submissions.
+    VkResult InitFilterCompleteTimeline(uint32_t maxNumFrames)
+    {
+        VkSemaphoreTypeCreateInfo timelineCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+        timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineCreateInfo.initialValue = 0; // the first submission signals 1
+        const VkSemaphoreCreateInfo createInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &timelineCreateInfo, 0 };
+        VkResult result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &createInfo, nullptr, &m_filterCompleteTimelineSemaphore);
+        if (result != VK_SUCCESS) {
+            m_filterCompleteTimelineSemaphore = VK_NULL_HANDLE;
+            return result;
+        }
+        m_filterCompleteTimelineValue = 0;
+        m_frameTimelineValues.assign(maxNumFrames, 0);
+        return VK_SUCCESS;
+    }
+
+    // Waits until the last submission of the frame is complete, before its command buffer is recorded again
+    VkResult WaitFilterCompleteTimeline(uint32_t frameIdx, uint64_t timeout) const
+    {
+        const uint64_t value = GetFilterCompleteTimelineValue(frameIdx);
+        if ((m_filterCompleteTimelineSemaphore == VK_NULL_HANDLE) || (value == 0)) {
+            return VK_SUCCESS;
+        }
+        const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                               &m_filterCompleteTimelineSemaphore, &value };
+        return m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, timeout);
     }
 
 private:
@@ -127,5 +202,8 @@ protected:
     uint32_t                           m_queueFamilyIndex;
     uint32_t                           m_queueIndex;
     VkQueue                            m_queue;
+    VkSemaphore                        m_filterCompleteTimelineSemaphore;
+    uint64_t                           m_filterCompleteTimelineValue; // of the last submission
+    std::vector<uint64_t>              m_frameTimelineValues;         // of the last submission of each frame
 };
 #endif /* _VKCODECUTILS_VULKANFILTER_H_ */
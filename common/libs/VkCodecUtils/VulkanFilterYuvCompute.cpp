@@ -58,7 +58,15 @@ VkResult VulkanFilterYuvCompute::Init(const VkSamplerYcbcrConversionCreateInfo*
 {
 
     VkResult result = VK_SUCCESS;
-    if (pYcbcrConversionCreateInfo) {
+    if (m_filterType == RGBA2YCBCR) {
+        // The RGBA input is a storage image, the conversion info only describes the output
+        if (pYcbcrConversionCreateInfo == nullptr) {
+            assert(!"ERROR: RGBA2YCBCR needs the YCbCr conversion info of its output!");
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        m_outputYcbcrConversionInfo = *pYcbcrConversionCreateInfo;
+        m_outputYcbcrConversionInfo.pNext = nullptr;
+    } else if (pYcbcrConversionCreateInfo) {
          result = m_samplerYcbcrConversion.CreateVulkanSampler(m_vkDevCtx,
                                                                pSamplerCreateInfo,
                                                                pYcbcrConversionCreateInfo);
@@ -76,6 +84,17 @@ VkResult VulkanFilterYuvCompute::Init(const VkSamplerYcbcrConversionCreateInfo*
         return result;
     }
 
+    // The descriptors of each recording are pushed, or written to a slot of the descriptor buffer, with the
+    // storage buffer of the buffer filters only pushed
+    const VkDescriptorSetLayoutCreateFlags layoutMode = m_descriptorSetLayout.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode();
+    const bool usesStorageBuffer = (m_filterType == BUFFER2YCBCR) || (m_filterType == YCBCR2BUFFER);
+    if ((layoutMode != VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) &&
+            ((layoutMode != VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT) || usesStorageBuffer)) {
+        std::cerr << "ERROR: The YUV compute filters need " << VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME
+                  << (usesStorageBuffer ? "" : " or " VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) << std::endl;
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
     result = m_commandBuffersSet.CreateCommandBufferPool(m_vkDevCtx, m_queueFamilyIndex, m_maxNumFrames);
     if (result != VK_SUCCESS) {
         assert(!"ERROR: CreateCommandBufferPool!");
@@ -94,6 +113,13 @@ VkResult VulkanFilterYuvCompute::Init(const VkSamplerYcbcrConversionCreateInfo*
         return result;
     }
 
+    // The consumers of the filtered frames wait on its values instead of on fences, when supported
+    if (InitFilterCompleteTimeline(m_maxNumFrames) != VK_SUCCESS) {
+        std::cerr << "WARNING: No timeline semaphore for the completion of the filter" << std::endl;
+    }
+
+    InitWorkgroupSize();
+
     std::string computeShader;
     size_t computeShaderSize = 0;
     switch (m_filterType) {
@@ -107,13 +133,38 @@ VkResult VulkanFilterYuvCompute::Init(const VkSamplerYcbcrConversionCreateInfo*
          computeShaderSize = InitYCBCR2RGBA(computeShader);
          break;
      case RGBA2YCBCR:
-         assert(!"TODO RGBA2YCBCR");
+         computeShaderSize = InitRGBA2YCBCR(computeShader);
+         break;
+     case BUFFER2YCBCR:
+         computeShaderSize = InitBUFFER2YCBCR(computeShader);
+         break;
+     case YCBCRSCALE:
+         computeShaderSize = InitYCBCRSCALE(computeShader);
+         break;
+     case YCBCR2BUFFER:
+         computeShaderSize = InitYCBCR2BUFFER(computeShader);
+         break;
+     case YCBCRSCALE_BILINEAR:
+     case YCBCRSCALE_BICUBIC:
+     case YCBCRSCALE_LANCZOS:
+         computeShaderSize = InitYCBCRRESAMPLE(computeShader);
+         break;
+     case YCBCRFUSED:
+         computeShaderSize = InitYCBCRFUSED(computeShader);
+         break;
+     case YCBCRDEINTERLACE_BOB:
+     case YCBCRDEINTERLACE_ADAPTIVE:
+         computeShaderSize = InitYCBCRDEINTERLACE(computeShader);
          break;
      default:
          assert(!"Invalid filter type");
          break;
     }
 
+    if (computeShaderSize == 0) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
     return m_computePipeline.CreatePipeline(m_vkDevCtx, m_vulkanShaderCompiler,
                                             computeShader.c_str(), computeShaderSize,
                                             "main",
@@ -123,11 +174,73 @@ VkResult VulkanFilterYuvCompute::Init(const VkSamplerYcbcrConversionCreateInfo*
     return VK_ERROR_LAYER_NOT_PRESENT;
 }
 
+void VulkanFilterYuvCompute::InitWorkgroupSize()
+{
+    m_samplesPerInvocation = 1;
+
+    // The resampling filters a square block of the output per workgroup, with a column of its tile per invocation
+    if (IsScaleFilter(m_filterType) && (m_filterType != YCBCRSCALE)) {
+        m_workgroupSizeX = 16;
+        m_workgroupSizeY = 16;
+        return;
+    }
+
+    VkPhysicalDeviceSubgroupProperties subgroupProperties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES, nullptr };
+    VkPhysicalDeviceProperties2 deviceProps2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &subgroupProperties };
+    m_vkDevCtx->GetPhysicalDeviceProperties2(m_vkDevCtx->getPhysicalDevice(), &deviceProps2);
+
+    // Whole subgroups and at least 64 invocations, within the 128 every device supports. The subgroup size is a
+    // power of two. The rows are 16 invocations wide, for the loads and the stores of a row to stay contiguous.
+    const uint32_t subgroupSize = (subgroupProperties.subgroupSize != 0) ? subgroupProperties.subgroupSize : 32;
+    const uint32_t numInvocations = std::min(std::max(subgroupSize, 64U), 128U);
+    m_workgroupSizeX = 16;
+    m_workgroupSizeY = numInvocations / m_workgroupSizeX;
+}
+
+VkResult VulkanFilterYuvCompute::BindDescriptors(VkCommandBuffer cmdBuf, uint32_t descriptorSlot,
+                                                 uint32_t descriptorWriteCount,
+                                                 const VkWriteDescriptorSet* pDescriptorWrites)
+{
+    const uint32_t set = 0;
+    const VkDescriptorSetLayoutCreateFlags layoutMode = m_descriptorSetLayout.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode();
+    if (layoutMode == VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) {
+        m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                            m_descriptorSetLayout.GetPipelineLayout(),
+                                            set, descriptorWriteCount, pDescriptorWrites);
+        return VK_SUCCESS;
+    }
+
+    assert(layoutMode == VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+    VkDeviceOrHostAddressConstKHR imageDescriptorBufferDeviceAddress =
+          m_descriptorSetLayout.UpdateDescriptorBuffer(descriptorSlot, set, descriptorWriteCount, pDescriptorWrites);
+    if (imageDescriptorBufferDeviceAddress.deviceAddress == 0) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Descriptor buffer bindings
+    // Set 0 = Image
+    VkDescriptorBufferBindingInfoEXT bindingInfo{};
+    bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+    bindingInfo.pNext = nullptr;
+    bindingInfo.address = imageDescriptorBufferDeviceAddress.deviceAddress;
+    bindingInfo.usage = VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+                        VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
+    m_vkDevCtx->CmdBindDescriptorBuffersEXT(cmdBuf, 1, &bindingInfo);
+
+    // Image (set 0)
+    uint32_t bufferIndexImage = 0;
+    VkDeviceSize bufferOffset = 0;
+    m_vkDevCtx->CmdSetDescriptorBufferOffsetsEXT(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                               m_descriptorSetLayout.GetPipelineLayout(),
+                                               set, 1, &bufferIndexImage, &bufferOffset);
+    return VK_SUCCESS;
+}
+
 VkResult VulkanFilterYuvCompute::InitDescriptorSetLayout(uint32_t maxNumFrames)
 {
 
     VkSampler ccSampler = m_samplerYcbcrConversion.GetSampler();
-    assert(ccSampler != VK_NULL_HANDLE);
+    assert((ccSampler != VK_NULL_HANDLE) || (m_filterType == RGBA2YCBCR));
     VkDescriptorType type = (ccSampler != VK_NULL_HANDLE) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
     const VkSampler* pImmutableSamplers = (ccSampler != VK_NULL_HANDLE) ? &ccSampler : nullptr;
 
@@ -153,12 +266,17 @@ VkResult VulkanFilterYuvCompute::InitDescriptorSetLayout(uint32_t maxNumFrames)
 
         // Binding 8: uniform buffer for input parameters.
         VkDescriptorSetLayoutBinding{ 8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+
+        // Binding 9: Input (read-only) or output (write) buffer of the YCbCr planes
+        VkDescriptorSetLayoutBinding{ 9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
     };
 
     VkPushConstantRange pushConstantRange = {};
     pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT; // Stage the push constant is for
     pushConstantRange.offset = 0;
-    pushConstantRange.size = 2 * sizeof(uint32_t); // Size of the push constant - source and destination image layers
+    // Size of the push constant - source and destination image layers,
+    // followed by the offsets and pitches of the buffer planes and the image extent.
+    pushConstantRange.size = 10 * sizeof(uint32_t);
 
     return m_descriptorSetLayout.CreateDescriptorSet(m_vkDevCtx,
                                                      setLayoutBindings,
@@ -185,58 +303,123 @@ static YcbcrBtStandard GetYcbcrPrimariesConstantsId(VkSamplerYcbcrModelConversio
     return YcbcrBtStandardUnknown;
 }
 
-size_t VulkanFilterYuvCompute::InitYCBCR2RGBA(std::string& computeShader)
+// How the compute shaders access the planes of a multi-planar YCbCr format
+struct YcbcrPlanesFormat {
+    uint32_t    numPlanes;         // 2 for Y and interleaved CbCr, 3 for separate Cb and Cr planes
+    uint32_t    chromaShiftX;      // 1 for 4:2:2 and 4:2:0
+    uint32_t    chromaShiftY;      // 1 for 4:2:0
+    const char* lumaImageFormat;   // r16 for more than 8 bits, in 16-bit containers
+    const char* chromaImageFormat; // rg8 or rg16, r8 or r16 for the separate planes
+};
+
+// The 2-plane 4:2:0 8-bit layout of NV12 for the formats without YCbCr info
+static YcbcrPlanesFormat GetYcbcrPlanesFormat(VkFormat format)
 {
-    // The compute filter uses two input images as separate planes
-    // Y (R) binding = 1
-    // CbCr (RG) binding = 2
-    // TODO: Add more YCbCr formats
-    m_inputImageAspects = VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT;
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(format);
+    const bool is16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != YCBCRA_8BPP);
+    const bool isSemiPlanar = (mpInfo == nullptr) ||
+                              (mpInfo->planesLayout.layout == YCBCR_SEMI_PLANAR_CBCR_INTERLEAVED);
 
-    // The compute filter uses RGBA output image with binding = 4
-    m_outputImageAspects = VK_IMAGE_ASPECT_COLOR_BIT;
+    YcbcrPlanesFormat planesFormat;
+    planesFormat.numPlanes = isSemiPlanar ? 2 : 3;
+    planesFormat.chromaShiftX = ((mpInfo == nullptr) || mpInfo->planesLayout.secondaryPlaneSubsampledX) ? 1 : 0;
+    planesFormat.chromaShiftY = ((mpInfo == nullptr) || mpInfo->planesLayout.secondaryPlaneSubsampledY) ? 1 : 0;
+    planesFormat.lumaImageFormat = is16BitSample ? "r16" : "r8";
+    planesFormat.chromaImageFormat = isSemiPlanar ? (is16BitSample ? "rg16" : "rg8") :
+                                                    (is16BitSample ? "r16" : "r8");
+    return planesFormat;
+}
 
-    // Create compute pipeline
-    std::stringstream shaderStr;
-    shaderStr << "#version 450\n"
-                        "layout(push_constant) uniform PushConstants {\n"
-                        "    uint srcImageLayer;\n"
-                        "    uint dstImageLayer;\n"
-                        "} pushConstants;\n"
-                        "\n"
-                        "layout (local_size_x = 16, local_size_y = 16) in;\n"
-                        " // TODO: use set and binding from the layout\n"
-                        " // TODO: use r16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 1, r8) uniform readonly image2DArray inputImageY;\n"
-                        " // TODO: use rg16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 2, rg8) uniform readonly image2DArray inputImageCbCr;\n"
-                        " // TODO: use rgba16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 4, rgba8) uniform writeonly image2DArray outImage;\n"
-                        "\n"
-                        " // TODO: normalize only narrow\n"
-                        "float normalizeY(float Y) {\n"
-                            "//    return (Y - (16.0 / 255.0)) * (255.0 / (235.0 - 16.0));\n"
-                            "return (Y - 0.0627451) * 1.164383562;\n"
-                        "}\n"
-                        "\n"
-                        "vec2 shiftCbCr(vec2 CbCr) {\n"
-                        "    return CbCr - 0.5;\n"
-                        "}\n"
-                        "\n"
-                        "vec3 shiftCbCr(vec3 ycbcr) {\n"
-                        "    const vec3 shiftCbCr  = vec3(0.0, -0.5, -0.5);\n"
-                        "    return ycbcr + shiftCbCr;\n"
-                        "}\n"
-                        "\n"
-                        " // TODO: normalize only narrow\n"
-                        "vec2 normalizeCbCr(vec2 CbCr) {\n"
-                        "    // return (CbCr - (16.0 / 255.0)) / ((240.0 - 16.0) / 255.0);\n"
-                        "    return (CbCr - 0.0627451) * 1.138392857;\n"
-                        "}\n"
-                        "\n";
+static VkImageAspectFlags GetPlaneAspects(const YcbcrPlanesFormat& planesFormat)
+{
+    return VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT |
+           ((planesFormat.numPlanes > 2) ? VK_IMAGE_ASPECT_PLANE_2_BIT : 0);
+}
+
+// Declares the input planes with bindings 1 to 3, as inputImageY and loadCbCr() of the chroma sample position
+static void AddInputPlanes(std::stringstream& shaderStr, const YcbcrPlanesFormat& planesFormat)
+{
+    shaderStr << "layout (set = 0, binding = 1, " << planesFormat.lumaImageFormat
+              << ") uniform readonly image2DArray inputImageY;\n";
+    if (planesFormat.numPlanes == 2) {
+        shaderStr << "layout (set = 0, binding = 2, " << planesFormat.chromaImageFormat
+                  << ") uniform readonly image2DArray inputImageCbCr;\n"
+                     "\n"
+                     "vec2 loadCbCr(ivec3 pos) {\n"
+                     "    return imageLoad(inputImageCbCr, pos).rg;\n"
+                     "}\n";
+    } else {
+        shaderStr << "layout (set = 0, binding = 2, " << planesFormat.chromaImageFormat
+                  << ") uniform readonly image2DArray inputImageCb;\n"
+                     "layout (set = 0, binding = 3, " << planesFormat.chromaImageFormat
+                  << ") uniform readonly image2DArray inputImageCr;\n"
+                     "\n"
+                     "vec2 loadCbCr(ivec3 pos) {\n"
+                     "    return vec2(imageLoad(inputImageCb, pos).r, imageLoad(inputImageCr, pos).r);\n"
+                     "}\n";
+    }
+    shaderStr << "const ivec2 inputChromaShift = ivec2(" << planesFormat.chromaShiftX << ", "
+              << planesFormat.chromaShiftY << ");\n"
+                 "\n";
+}
+
+// Declares the output planes with bindings 5 to 7, as outImageY and storeCbCr() of the chroma sample position
+static void AddOutputPlanes(std::stringstream& shaderStr, const YcbcrPlanesFormat& planesFormat)
+{
+    shaderStr << "layout (set = 0, binding = 5, " << planesFormat.lumaImageFormat
+              << ") uniform writeonly image2DArray outImageY;\n";
+    if (planesFormat.numPlanes == 2) {
+        shaderStr << "layout (set = 0, binding = 6, " << planesFormat.chromaImageFormat
+                  << ") uniform writeonly image2DArray outImageCbCr;\n"
+                     "\n"
+                     "void storeCbCr(ivec3 pos, vec2 CbCr) {\n"
+                     "    imageStore(outImageCbCr, pos, vec4(CbCr, 0, 1));\n"
+                     "}\n";
+    } else {
+        shaderStr << "layout (set = 0, binding = 6, " << planesFormat.chromaImageFormat
+                  << ") uniform writeonly image2DArray outImageCb;\n"
+                     "layout (set = 0, binding = 7, " << planesFormat.chromaImageFormat
+                  << ") uniform writeonly image2DArray outImageCr;\n"
+                     "\n"
+                     "void storeCbCr(ivec3 pos, vec2 CbCr) {\n"
+                     "    imageStore(outImageCb, pos, vec4(CbCr.r, 0, 0, 1));\n"
+                     "    imageStore(outImageCr, pos, vec4(CbCr.g, 0, 0, 1));\n"
+                     "}\n";
+    }
+    shaderStr << "const ivec2 outChromaShift = ivec2(" << planesFormat.chromaShiftX << ", "
+              << planesFormat.chromaShiftY << ");\n"
+                 "\n";
+}
+
+// The YCbCr to RGB conversion of the format, the model and the range of the sampler YCbCr conversion, as
+// normalizeYCbCr(), shiftCbCr() and convertYCbCrToRgb() of the normalized YCbCr
+static void AddYCbCrToRgbConversion(std::stringstream& shaderStr,
+                                    const VkSamplerYcbcrConversionCreateInfo& samplerYcbcrConversionCreateInfo)
+{
+    shaderStr <<
+        " // TODO: normalize only narrow\n"
+        "float normalizeY(float Y) {\n"
+            "//    return (Y - (16.0 / 255.0)) * (255.0 / (235.0 - 16.0));\n"
+            "return (Y - 0.0627451) * 1.164383562;\n"
+        "}\n"
+        "\n"
+        "vec2 shiftCbCr(vec2 CbCr) {\n"
+        "    return CbCr - 0.5;\n"
+        "}\n"
+        "\n"
+        "vec3 shiftCbCr(vec3 ycbcr) {\n"
+        "    const vec3 shiftCbCr  = vec3(0.0, -0.5, -0.5);\n"
+        "    return ycbcr + shiftCbCr;\n"
+        "}\n"
+        "\n"
+        " // TODO: normalize only narrow\n"
+        "vec2 normalizeCbCr(vec2 CbCr) {\n"
+        "    // return (CbCr - (16.0 / 255.0)) / ((240.0 - 16.0) / 255.0);\n"
+        "    return (CbCr - 0.0627451) * 1.138392857;\n"
+        "}\n"
+        "\n";
 
 
-    const VkSamplerYcbcrConversionCreateInfo& samplerYcbcrConversionCreateInfo = m_samplerYcbcrConversion.GetSamplerYcbcrConversionCreateInfo();
     const VkMpFormatInfo * mpInfo = YcbcrVkFormatInfo(samplerYcbcrConversionCreateInfo.format);
     const unsigned int bpp = (8 + mpInfo->planesLayout.bpp * 2);
 
@@ -270,21 +453,76 @@ size_t VulkanFilterYuvCompute::InitYCBCR2RGBA(std::string& computeShader)
         "    return yuvNorm;\n"
         "}\n"
         "\n";
+}
+
+size_t VulkanFilterYuvCompute::InitYCBCR2RGBA(std::string& computeShader)
+{
+    const VkSamplerYcbcrConversionCreateInfo& samplerYcbcrConversionCreateInfo = m_samplerYcbcrConversion.GetSamplerYcbcrConversionCreateInfo();
+
+    // The compute filter uses the input image planes
+    // Y (R) binding = 1
+    // CbCr (RG) binding = 2, or Cb (R) binding = 2 and Cr (R) binding = 3
+    const YcbcrPlanesFormat inputPlanesFormat = GetYcbcrPlanesFormat(samplerYcbcrConversionCreateInfo.format);
+    m_inputImageAspects = GetPlaneAspects(inputPlanesFormat);
+
+    // The compute filter uses RGBA output image with binding = 4
+    m_outputImageAspects = VK_IMAGE_ASPECT_COLOR_BIT;
+    m_samplesPerInvocation = 2;
+
+    // The 16-bit RGBA of the formats with more than 8 bits, not to lose their precision
+    const VkMpFormatInfo* outputMpInfo = YcbcrVkFormatInfo(m_outputFormat);
+    const bool is16BitOutput = (m_outputFormat == VK_FORMAT_R16G16B16A16_UNORM) ||
+                               ((outputMpInfo != nullptr) && (outputMpInfo->planesLayout.bpp != YCBCRA_8BPP));
+
+    // Create compute pipeline
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    AddInputPlanes(shaderStr, inputPlanesFormat);
+    shaderStr << "layout (set = 0, binding = 4, " << (is16BitOutput ? "rgba16" : "rgba8")
+              <<            ") uniform writeonly image2DArray outImage;\n"
+                        "\n";
+    AddYCbCrToRgbConversion(shaderStr, samplerYcbcrConversionCreateInfo);
 
+    // The quad of 4:2:0 has a single chroma sample, loaded once
+    const bool isQuadChroma = (inputPlanesFormat.chromaShiftX != 0) && (inputPlanesFormat.chromaShiftY != 0);
     shaderStr <<
         "void main()\n"
         "{\n"
-        "    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);\n"
+        "    // A 2x2 quad of samples per invocation, aligned to the chroma samples\n"
+        "    ivec2 quadPos = ivec2(gl_GlobalInvocationID.xy) * 2;\n"
+        "    ivec2 dstSize = imageSize(outImage).xy;\n"
+        "    if (any(greaterThanEqual(quadPos, dstSize))) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n";
+    if (isQuadChroma) {
+        shaderStr <<
+        "    vec2 quadCbCr = loadCbCr(ivec3(quadPos >> inputChromaShift, pushConstants.srcImageLayer));\n"
+        "\n";
+    }
+    shaderStr <<
+        "    for (int i = 0; i < 4; i++) {\n"
+        "        ivec2 pos = quadPos + ivec2(i & 1, i >> 1);\n"
+        "        if (any(greaterThanEqual(pos, dstSize))) {\n"
+        "            continue;\n"
+        "        }\n"
         "\n"
-        "    // Fetch from the texture.\n"
-        "    float Y = imageLoad(inputImageY, ivec3(pos, pushConstants.srcImageLayer)).r;\n"
-        "    // TODO: it is /2 only for sub-sampled formats\n"
-        "    vec2 CbCr = imageLoad(inputImageCbCr, ivec3(pos/2, pushConstants.srcImageLayer)).rg;\n"
+        "        // Fetch from the texture.\n"
+        "        float Y = imageLoad(inputImageY, ivec3(pos, pushConstants.srcImageLayer)).r;\n"
+        "        vec2 CbCr = " << (isQuadChroma ? "quadCbCr" :
+                                  "loadCbCr(ivec3(pos >> inputChromaShift, pushConstants.srcImageLayer))") << ";\n"
         "\n"
-        "    vec3 ycbcr = shiftCbCr(normalizeYCbCr(vec3(Y, CbCr)));\n"
-        "    vec4 rgba = vec4(convertYCbCrToRgb(ycbcr),1.0);\n"
-        "    // Store it back.\n"
-        "    imageStore(outImage, ivec3(pos, pushConstants.dstImageLayer), rgba);\n"
+        "        vec3 ycbcr = shiftCbCr(normalizeYCbCr(vec3(Y, CbCr)));\n"
+        "        vec4 rgba = vec4(convertYCbCrToRgb(ycbcr),1.0);\n"
+        "        // Store it back.\n"
+        "        imageStore(outImage, ivec3(pos, pushConstants.dstImageLayer), rgba);\n"
+        "    }\n"
         "}\n";
 
     computeShader = shaderStr.str();
@@ -294,53 +532,288 @@ size_t VulkanFilterYuvCompute::InitYCBCR2RGBA(std::string& computeShader)
 
 size_t VulkanFilterYuvCompute::InitYCBCRCOPY(std::string& computeShader)
 {
-    // The compute filter uses two input images as separate planes
+    // The compute filter uses the input image planes
     // Y (R) binding = 1
-    // CbCr (RG) binding = 2
-    // TODO: Add more YCbCr formats
-    m_inputImageAspects = VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT;
+    // CbCr (RG) binding = 2, or Cb (R) binding = 2 and Cr (R) binding = 3
+    const YcbcrPlanesFormat inputPlanesFormat = GetYcbcrPlanesFormat(m_inputFormat);
+    m_inputImageAspects = GetPlaneAspects(inputPlanesFormat);
+
+    // The compute filter uses the output image planes
+    // Y (R) binding = 5
+    // CbCr (RG) binding = 6, or Cb (R) binding = 6 and Cr (R) binding = 7
+    const YcbcrPlanesFormat outputPlanesFormat = GetYcbcrPlanesFormat(m_outputFormat);
+    m_outputImageAspects = GetPlaneAspects(outputPlanesFormat);
+    m_samplesPerInvocation = 2;
+
+    std::stringstream shaderStr;
+    // Create compute pipeline
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    AddInputPlanes(shaderStr, inputPlanesFormat);
+    AddOutputPlanes(shaderStr, outputPlanesFormat);
+
+    shaderStr <<
+        "void main()\n"
+        "{\n"
+        "    // A 2x2 quad of samples per invocation, aligned to the chroma samples\n"
+        "    ivec2 quadPos = ivec2(gl_GlobalInvocationID.xy) * 2;\n"
+        "    ivec2 dstSize = imageSize(outImageY).xy;\n"
+        "    if (any(greaterThanEqual(quadPos, dstSize))) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    for (int i = 0; i < 4; i++) {\n"
+        "        ivec2 pos = quadPos + ivec2(i & 1, i >> 1);\n"
+        "        if (any(greaterThanEqual(pos, dstSize))) {\n"
+        "            continue;\n"
+        "        }\n"
+        "\n"
+        "        // Read Y value from source Y plane and write it to destination Y plane\n"
+        "        float Y = imageLoad(inputImageY, ivec3(pos, pushConstants.srcImageLayer)).r;\n"
+        "        imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(Y, 0, 0, 1));\n"
+        "\n"
+        "        // Do the same for the CbCr samples, once per output chroma sample. The chroma is replicated\n"
+        "        // or point sampled when the input and the output subsampling differ.\n"
+        "        if ((pos & ((ivec2(1) << outChromaShift) - 1)) == ivec2(0, 0)) {\n"
+        "            vec2 CbCr = loadCbCr(ivec3(pos >> inputChromaShift, pushConstants.srcImageLayer));\n"
+        "            storeCbCr(ivec3(pos >> outChromaShift, pushConstants.dstImageLayer), CbCr);\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+size_t VulkanFilterYuvCompute::InitYCBCRDEINTERLACE(std::string& computeShader)
+{
+    // The same planes as YCBCRCOPY, the fields of the input are woven into its even and odd lines
+    const YcbcrPlanesFormat inputPlanesFormat = GetYcbcrPlanesFormat(m_inputFormat);
+    m_inputImageAspects = GetPlaneAspects(inputPlanesFormat);
+    const YcbcrPlanesFormat outputPlanesFormat = GetYcbcrPlanesFormat(m_outputFormat);
+    m_outputImageAspects = GetPlaneAspects(outputPlanesFormat);
+    m_samplesPerInvocation = 2;
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    AddInputPlanes(shaderStr, inputPlanesFormat);
+    AddOutputPlanes(shaderStr, outputPlanesFormat);
+
+    // The weight of the interpolation of a bottom field sample, from its combing against the top field lines
+    // around it: how far it is beyond both of them, on the normalized sample scale
+    if (m_filterType == YCBCRDEINTERLACE_ADAPTIVE) {
+        shaderStr <<
+            "const float combThreshold = 0.02;\n"
+            "\n"
+            "vec2 deinterlace(vec2 above, vec2 woven, vec2 below)\n"
+            "{\n"
+            "    vec2 comb = max(min(woven - above, woven - below), min(above - woven, below - woven));\n"
+            "    vec2 weight = smoothstep(vec2(combThreshold), vec2(2.0 * combThreshold), comb);\n"
+            "    return mix(woven, (above + below) * 0.5, weight);\n"
+            "}\n";
+    } else {
+        shaderStr <<
+            "vec2 deinterlace(vec2 above, vec2 woven, vec2 below)\n"
+            "{\n"
+            "    return (above + below) * 0.5;\n"
+            "}\n";
+    }
+
+    shaderStr <<
+        "\n"
+        "// The top field lines are even, the lines below the last one repeat it\n"
+        "int topFieldLine(int y, int height)\n"
+        "{\n"
+        "    return min(y, (height - 1) & ~1);\n"
+        "}\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    // A 2x2 quad of samples per invocation, aligned to the chroma samples\n"
+        "    ivec2 quadPos = ivec2(gl_GlobalInvocationID.xy) * 2;\n"
+        "    ivec2 dstSize = imageSize(outImageY).xy;\n"
+        "    if (any(greaterThanEqual(quadPos, dstSize))) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    int srcLayer = int(pushConstants.srcImageLayer);\n"
+        "    int dstLayer = int(pushConstants.dstImageLayer);\n"
+        "    int height = imageSize(inputImageY).y;\n"
+        "    for (int i = 0; i < 4; i++) {\n"
+        "        ivec2 pos = quadPos + ivec2(i & 1, i >> 1);\n"
+        "        if (any(greaterThanEqual(pos, dstSize))) {\n"
+        "            continue;\n"
+        "        }\n"
+        "\n"
+        "        float Y = imageLoad(inputImageY, ivec3(pos, srcLayer)).r;\n"
+        "        if ((pos.y & 1) != 0) {\n"
+        "            float above = imageLoad(inputImageY, ivec3(pos.x, pos.y - 1, srcLayer)).r;\n"
+        "            float below = imageLoad(inputImageY, ivec3(pos.x, topFieldLine(pos.y + 1, height), srcLayer)).r;\n"
+        "            Y = deinterlace(vec2(above), vec2(Y), vec2(below)).x;\n"
+        "        }\n"
+        "        imageStore(outImageY, ivec3(pos, dstLayer), vec4(Y, 0, 0, 1));\n"
+        "\n"
+        "        // The chroma lines alternate between the fields too, once per output chroma sample\n"
+        "        if ((pos & ((ivec2(1) << outChromaShift) - 1)) == ivec2(0, 0)) {\n"
+        "            ivec2 chromaPos = pos >> inputChromaShift;\n"
+        "            int chromaHeight = (height + (1 << inputChromaShift.y) - 1) >> inputChromaShift.y;\n"
+        "            vec2 CbCr = loadCbCr(ivec3(chromaPos, srcLayer));\n"
+        "            if ((chromaPos.y & 1) != 0) {\n"
+        "                vec2 above = loadCbCr(ivec3(chromaPos.x, chromaPos.y - 1, srcLayer));\n"
+        "                vec2 below = loadCbCr(ivec3(chromaPos.x, topFieldLine(chromaPos.y + 1, chromaHeight), srcLayer));\n"
+        "                CbCr = deinterlace(above, CbCr, below);\n"
+        "            }\n"
+        "            storeCbCr(ivec3(pos >> outChromaShift, dstLayer), CbCr);\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+size_t VulkanFilterYuvCompute::InitYCBCRCLEAR(std::string& computeShader)
+{
+    // The compute filter uses NO input images
+    m_inputImageAspects = VK_IMAGE_ASPECT_NONE;
+
+    // The compute filter uses the output image planes
+    // Y (R) binding = 5
+    // CbCr (RG) binding = 6, or Cb (R) binding = 6 and Cr (R) binding = 7
+    const YcbcrPlanesFormat outputPlanesFormat = GetYcbcrPlanesFormat(m_outputFormat);
+    m_outputImageAspects = GetPlaneAspects(outputPlanesFormat);
+    m_samplesPerInvocation = 2;
+
+    // Create compute pipeline
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    AddOutputPlanes(shaderStr, outputPlanesFormat);
+
+    shaderStr <<
+        "void main()\n"
+        "{\n"
+        "    // A 2x2 quad of samples per invocation, aligned to the chroma samples\n"
+        "    ivec2 quadPos = ivec2(gl_GlobalInvocationID.xy) * 2;\n"
+        "    ivec2 dstSize = imageSize(outImageY).xy;\n"
+        "    if (any(greaterThanEqual(quadPos, dstSize))) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    for (int i = 0; i < 4; i++) {\n"
+        "        ivec2 pos = quadPos + ivec2(i & 1, i >> 1);\n"
+        "        if (any(greaterThanEqual(pos, dstSize))) {\n"
+        "            continue;\n"
+        "        }\n"
+        "\n"
+        "        imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(0.5, 0, 0, 1));\n"
+        "\n"
+        "        // Do the same for the CbCr samples, once per output chroma sample\n"
+        "        if ((pos & ((ivec2(1) << outChromaShift) - 1)) == ivec2(0, 0)) {\n"
+        "            storeCbCr(ivec3(pos >> outChromaShift, pushConstants.dstImageLayer), vec2(0.5, 0.5));\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+size_t VulkanFilterYuvCompute::InitBUFFER2YCBCR(std::string& computeShader)
+{
+    // The compute filter reads the Y, Cb and Cr planes from the input buffer with binding = 9
+    m_inputImageAspects = VK_IMAGE_ASPECT_NONE;
 
     // The compute filter uses two output images as separate planes
     // Y (R) binding = 5
     // CbCr (RG) binding = 6
-    // TODO: Add more YCbCr formats
     m_outputImageAspects = VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT;
 
-    std::stringstream shaderStr;
+    // More than 8 bits per sample come in 16-bit little-endian containers, LSB aligned.
+    // The output formats, i.e. P010, are MSB aligned.
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_outputFormat);
+    const uint32_t bitDepth = 8 + ((mpInfo != nullptr) ? mpInfo->planesLayout.bpp * 2 : 0);
+    const bool is16BitSample = (bitDepth > 8);
+
     // Create compute pipeline
+    std::stringstream shaderStr;
     shaderStr << "#version 450\n"
                         "layout(push_constant) uniform PushConstants {\n"
                         "    uint srcImageLayer;\n"
                         "    uint dstImageLayer;\n"
+                        "    uint yOffset;\n"
+                        "    uint yPitch;\n"
+                        "    uint cbOffset;\n"
+                        "    uint cbPitch;\n"
+                        "    uint crOffset;\n"
+                        "    uint crPitch;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
                         "} pushConstants;\n"
                         "\n"
-                        "layout (local_size_x = 16, local_size_y = 16) in;\n"
-                        " // TODO: use set and binding from the layout\n"
-                        " // TODO: use r16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 1, r8) uniform  readonly  image2DArray inputImageY;\n"
-                        " // TODO: use rg16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 2, rg8) uniform readonly  image2DArray inputImageCbCr;\n"
-                        " // TODO: use rgba16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 5, r8) uniform  writeonly image2DArray outImageY;\n"
-                        " // TODO: use rg16 for 16-bit formats\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n"
+                        "layout (set = 0, binding = 9) readonly buffer InputBuffer {\n"
+                        "    uint inputData[];\n"
+                        "};\n";
+    if (is16BitSample) {
+        shaderStr <<    "layout (set = 0, binding = 5, r16) uniform writeonly image2DArray outImageY;\n"
+                        "layout (set = 0, binding = 6, rg16) uniform writeonly image2DArray outImageCbCr;\n"
+                        "\n"
+                        "float fetchSample(uint byteOffset) {\n"
+                        "    uint value = (inputData[byteOffset >> 2] >> ((byteOffset & 2) * 8)) & 0xffff;\n"
+                        "    return float(value << " << (16 - bitDepth) << ") / 65535.0;\n"
+                        "}\n"
+                        "\n"
+                        "const uint bytesPerSample = 2;\n";
+    } else {
+        shaderStr <<    "layout (set = 0, binding = 5, r8) uniform writeonly image2DArray outImageY;\n"
                         "layout (set = 0, binding = 6, rg8) uniform writeonly image2DArray outImageCbCr;\n"
                         "\n"
-                        "\n";
+                        "float fetchSample(uint byteOffset) {\n"
+                        "    uint value = (inputData[byteOffset >> 2] >> ((byteOffset & 3) * 8)) & 0xff;\n"
+                        "    return float(value) / 255.0;\n"
+                        "}\n"
+                        "\n"
+                        "const uint bytesPerSample = 1;\n";
+    }
 
     shaderStr <<
+        "\n"
         "void main()\n"
         "{\n"
-        "    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);\n"
+        "    uvec2 pos = gl_GlobalInvocationID.xy;\n"
+        "    if ((pos.x >= pushConstants.width) || (pos.y >= pushConstants.height)) {\n"
+        "        return;\n"
+        "    }\n"
         "\n"
-        "    // Read Y value from source Y plane and write it to destination Y plane\n"
-        "    float Y = imageLoad(inputImageY, ivec3(pos, pushConstants.srcImageLayer)).r;\n"
+        "    float Y = fetchSample(pushConstants.yOffset + pos.y * pushConstants.yPitch + pos.x * bytesPerSample);\n"
         "    imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(Y, 0, 0, 1));\n"
         "\n"
-        "    // Do the same for the CbCr plane, but remember about the 4:2:0 subsampling\n"
-        "    if (pos % 2 == ivec2(0, 0)) {\n"
+        "    // Interleave the Cb and Cr planes, with the 4:2:0 subsampling\n"
+        "    if ((pos.x % 2 == 0) && (pos.y % 2 == 0)) {\n"
         "        pos /= 2;\n"
-        "        vec2 CbCr = imageLoad(inputImageCbCr, ivec3(pos, pushConstants.srcImageLayer)).rg;\n"
-        "        imageStore(outImageCbCr, ivec3(pos, pushConstants.dstImageLayer), vec4(CbCr, 0, 1));\n"
+        "        float Cb = fetchSample(pushConstants.cbOffset + pos.y * pushConstants.cbPitch + pos.x * bytesPerSample);\n"
+        "        float Cr = fetchSample(pushConstants.crOffset + pos.y * pushConstants.crPitch + pos.x * bytesPerSample);\n"
+        "        imageStore(outImageCbCr, ivec3(pos, pushConstants.dstImageLayer), vec4(Cb, Cr, 0, 1));\n"
         "    }\n"
         "}\n";
 
@@ -349,44 +822,87 @@ size_t VulkanFilterYuvCompute::InitYCBCRCOPY(std::string& computeShader)
     return computeShader.size();
 }
 
-size_t VulkanFilterYuvCompute::InitYCBCRCLEAR(std::string& computeShader)
+size_t VulkanFilterYuvCompute::InitYCBCRSCALE(std::string& computeShader)
 {
-    // The compute filter uses NO input images
-    m_inputImageAspects = VK_IMAGE_ASPECT_NONE;
+    // The compute filter uses two input images as separate planes
+    // Y (R) binding = 1
+    // CbCr (RG) binding = 2
+    m_inputImageAspects = VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT;
 
     // The compute filter uses two output images as separate planes
     // Y (R) binding = 5
     // CbCr (RG) binding = 6
-    // TODO: Add more YCbCr formats
     m_outputImageAspects = VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT;
 
+    // The input and the output images have the same format
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_outputFormat);
+    const bool is16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != YCBCRA_8BPP);
+
     // Create compute pipeline
     std::stringstream shaderStr;
     shaderStr << "#version 450\n"
                         "layout(push_constant) uniform PushConstants {\n"
                         "    uint srcImageLayer;\n"
                         "    uint dstImageLayer;\n"
+                        "    uint srcWidth;\n"
+                        "    uint srcHeight;\n"
+                        "    uint dstWidth;\n"
+                        "    uint dstHeight;\n"
                         "} pushConstants;\n"
                         "\n"
-                        "layout (local_size_x = 16, local_size_y = 16) in;\n"
-                        " // TODO: use rgba16 for 16-bit formats\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    if (is16BitSample) {
+        shaderStr <<    "layout (set = 0, binding = 1, r16) uniform readonly image2DArray inputImageY;\n"
+                        "layout (set = 0, binding = 2, rg16) uniform readonly image2DArray inputImageCbCr;\n"
+                        "layout (set = 0, binding = 5, r16) uniform writeonly image2DArray outImageY;\n"
+                        "layout (set = 0, binding = 6, rg16) uniform writeonly image2DArray outImageCbCr;\n";
+    } else {
+        shaderStr <<    "layout (set = 0, binding = 1, r8) uniform readonly image2DArray inputImageY;\n"
+                        "layout (set = 0, binding = 2, rg8) uniform readonly image2DArray inputImageCbCr;\n"
                         "layout (set = 0, binding = 5, r8) uniform writeonly image2DArray outImageY;\n"
-                        " // TODO: use rg16 for 16-bit formats\n"
-                        "layout (set = 0, binding = 6, rg8) uniform writeonly image2DArray outImageCbCr;\n"
-                        "\n"
-                        "\n";
+                        "layout (set = 0, binding = 6, rg8) uniform writeonly image2DArray outImageCbCr;\n";
+    }
 
     shaderStr <<
+        "\n"
+        "// The input samples covered by the output sample, from xy up to zw, at least one\n"
+        "uvec4 inputArea(uvec2 pos, uvec2 srcSize, uvec2 dstSize) {\n"
+        "    uvec2 start = (pos * srcSize) / dstSize;\n"
+        "    uvec2 end = max(((pos + 1) * srcSize + dstSize - 1) / dstSize, start + 1);\n"
+        "    return uvec4(start, min(end, srcSize));\n"
+        "}\n"
+        "\n"
         "void main()\n"
         "{\n"
-        "    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);\n"
+        "    uvec2 pos = gl_GlobalInvocationID.xy;\n"
+        "    uvec2 srcSize = uvec2(pushConstants.srcWidth, pushConstants.srcHeight);\n"
+        "    uvec2 dstSize = uvec2(pushConstants.dstWidth, pushConstants.dstHeight);\n"
+        "    if ((pos.x >= dstSize.x) || (pos.y >= dstSize.y)) {\n"
+        "        return;\n"
+        "    }\n"
         "\n"
-        "    imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(0.5, 0, 0, 1));\n"
+        "    uvec4 area = inputArea(pos, srcSize, dstSize);\n"
+        "    float Y = 0.0;\n"
+        "    for (uint y = area.y; y < area.w; y++) {\n"
+        "        for (uint x = area.x; x < area.z; x++) {\n"
+        "            Y += imageLoad(inputImageY, ivec3(x, y, pushConstants.srcImageLayer)).r;\n"
+        "        }\n"
+        "    }\n"
+        "    Y /= float((area.z - area.x) * (area.w - area.y));\n"
+        "    imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(Y, 0, 0, 1));\n"
         "\n"
         "    // Do the same for the CbCr plane, but remember about the 4:2:0 subsampling\n"
-        "    if (pos % 2 == ivec2(0, 0)) {\n"
+        "    if ((pos.x % 2 == 0) && (pos.y % 2 == 0)) {\n"
         "        pos /= 2;\n"
-        "        imageStore(outImageCbCr, ivec3(pos, pushConstants.dstImageLayer), vec4(0.5, 0.5, 0.0, 1.0));\n"
+        "        area = inputArea(pos, (srcSize + 1) / 2, (dstSize + 1) / 2);\n"
+        "        vec2 CbCr = vec2(0.0);\n"
+        "        for (uint y = area.y; y < area.w; y++) {\n"
+        "            for (uint x = area.x; x < area.z; x++) {\n"
+        "                CbCr += imageLoad(inputImageCbCr, ivec3(x, y, pushConstants.srcImageLayer)).rg;\n"
+        "            }\n"
+        "        }\n"
+        "        CbCr /= float((area.z - area.x) * (area.w - area.y));\n"
+        "        imageStore(outImageCbCr, ivec3(pos, pushConstants.dstImageLayer), vec4(CbCr, 0, 1));\n"
         "    }\n"
         "}\n";
 
@@ -394,3 +910,949 @@ size_t VulkanFilterYuvCompute::InitYCBCRCLEAR(std::string& computeShader)
     std::cout << "\nCompute Shader:\n" << computeShader;
     return computeShader.size();
 }
+
+// Generates resample<name>(), the separable filtering of a plane by a workgroup into its block of output samples.
+// The rows of the input footprint of the block are filtered horizontally in chunks of tileRows into the shared tile,
+// from which each invocation accumulates the vertical pass of its output sample.
+static void AddResamplePlane(std::stringstream& shaderStr, const char* name, const char* type,
+                             const char* loadFunction, const char* storeStatement, uint32_t blockSize)
+{
+    shaderStr <<
+        "shared " << type << " tile" << name << "[tileRows][" << blockSize << "];\n"
+        "\n"
+        "void resample" << name << "(ivec2 srcSize, ivec2 dstSize)\n"
+        "{\n"
+        "    ivec2 blockOrigin = ivec2(gl_WorkGroupID.xy) * " << blockSize << ";\n"
+        "    if (any(greaterThanEqual(blockOrigin, dstSize))) {\n"
+        "        return; // the whole workgroup, e.g. beyond the sub-sampled chroma\n"
+        "    }\n"
+        "    ivec2 local = ivec2(gl_LocalInvocationID.xy);\n"
+        "    ivec2 pos = blockOrigin + local;\n"
+        "\n"
+        "    // The kernel is widened by the downscaling ratio, for it to low-pass the input\n"
+        "    vec2 scale = vec2(srcSize) / vec2(dstSize);\n"
+        "    vec2 kernelScale = max(scale, vec2(1.0));\n"
+        "    vec2 support = kernelRadius * kernelScale;\n"
+        "    vec2 center = (vec2(pos) + 0.5) * scale - 0.5;\n"
+        "    ivec2 first = ivec2(ceil(center - support));\n"
+        "    ivec2 last = ivec2(floor(center + support));\n"
+        "\n"
+        "    // The input rows of the footprint of the block, the same for the whole workgroup\n"
+        "    int blockLastY = min(blockOrigin.y + " << blockSize << " - 1, dstSize.y - 1);\n"
+        "    int blockFirstRow = int(ceil((float(blockOrigin.y) + 0.5) * scale.y - 0.5 - support.y));\n"
+        "    int blockLastRow = int(floor((float(blockLastY) + 0.5) * scale.y - 0.5 + support.y));\n"
+        "\n"
+        "    " << type << " sum = " << type << "(0.0);\n"
+        "    float weightSum = 0.0;\n"
+        "    for (int chunkRow = blockFirstRow; chunkRow <= blockLastRow; chunkRow += int(tileRows)) {\n"
+        "        int numRows = min(int(tileRows), blockLastRow - chunkRow + 1);\n"
+        "        for (int row = local.y; row < numRows; row += " << blockSize << ") {\n"
+        "            int y = clamp(chunkRow + row, 0, srcSize.y - 1);\n"
+        "            " << type << " h = " << type << "(0.0);\n"
+        "            float hWeightSum = 0.0;\n"
+        "            for (int x = first.x; x <= last.x; x++) {\n"
+        "                float w = kernelWeight((float(x) - center.x) / kernelScale.x);\n"
+        "                h += w * " << loadFunction << "(ivec3(clamp(x, 0, srcSize.x - 1), y, pushConstants.srcImageLayer));\n"
+        "                hWeightSum += w;\n"
+        "            }\n"
+        "            tile" << name << "[row][local.x] = h / hWeightSum;\n"
+        "        }\n"
+        "        barrier();\n"
+        "\n"
+        "        int chunkLastRow = min(chunkRow + numRows - 1, last.y);\n"
+        "        for (int y = max(first.y, chunkRow); y <= chunkLastRow; y++) {\n"
+        "            float w = kernelWeight((float(y) - center.y) / kernelScale.y);\n"
+        "            sum += w * tile" << name << "[y - chunkRow][local.x];\n"
+        "            weightSum += w;\n"
+        "        }\n"
+        "        barrier();\n"
+        "    }\n"
+        "\n"
+        "    if (all(lessThan(pos, dstSize))) {\n"
+        "        " << type << " value = sum / weightSum;\n"
+        "        " << storeStatement << "\n"
+        "    }\n"
+        "}\n"
+        "\n";
+}
+
+size_t VulkanFilterYuvCompute::InitYCBCRRESAMPLE(std::string& computeShader)
+{
+    // The compute filter uses the input image planes
+    // Y (R) binding = 1
+    // CbCr (RG) binding = 2, or Cb (R) binding = 2 and Cr (R) binding = 3
+    const YcbcrPlanesFormat inputPlanesFormat = GetYcbcrPlanesFormat(m_inputFormat);
+    m_inputImageAspects = GetPlaneAspects(inputPlanesFormat);
+
+    // The compute filter uses the output image planes
+    // Y (R) binding = 5
+    // CbCr (RG) binding = 6, or Cb (R) binding = 6 and Cr (R) binding = 7
+    const YcbcrPlanesFormat outputPlanesFormat = GetYcbcrPlanesFormat(m_outputFormat);
+    m_outputImageAspects = GetPlaneAspects(outputPlanesFormat);
+
+    // The workgroup is square, a column of the shared tile per invocation
+    assert(m_workgroupSizeX == m_workgroupSizeY);
+
+    // Create compute pipeline
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "    uint srcWidth;\n"
+                        "    uint srcHeight;\n"
+                        "    uint dstWidth;\n"
+                        "    uint dstHeight;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    AddInputPlanes(shaderStr, inputPlanesFormat);
+    AddOutputPlanes(shaderStr, outputPlanesFormat);
+
+    switch (m_filterType) {
+    case YCBCRSCALE_BILINEAR:
+        shaderStr <<
+            "const float kernelRadius = 1.0;\n"
+            "\n"
+            "float kernelWeight(float x) {\n"
+            "    return max(1.0 - abs(x), 0.0);\n"
+            "}\n";
+        break;
+    case YCBCRSCALE_BICUBIC:
+        // Catmull-Rom, i.e. the cubic convolution with a = -0.5
+        shaderStr <<
+            "const float kernelRadius = 2.0;\n"
+            "\n"
+            "float kernelWeight(float x) {\n"
+            "    x = abs(x);\n"
+            "    if (x < 1.0) {\n"
+            "        return (1.5 * x - 2.5) * x * x + 1.0;\n"
+            "    } else if (x < 2.0) {\n"
+            "        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;\n"
+            "    }\n"
+            "    return 0.0;\n"
+            "}\n";
+        break;
+    case YCBCRSCALE_LANCZOS:
+    default:
+        assert(m_filterType == YCBCRSCALE_LANCZOS);
+        shaderStr <<
+            "const float kernelRadius = 3.0;\n"
+            "\n"
+            "float kernelWeight(float x) {\n"
+            "    x = abs(x);\n"
+            "    if (x < 1e-5) {\n"
+            "        return 1.0;\n"
+            "    } else if (x >= kernelRadius) {\n"
+            "        return 0.0;\n"
+            "    }\n"
+            "    float px = 3.14159265 * x;\n"
+            "    return kernelRadius * sin(px) * sin(px / kernelRadius) / (px * px);\n"
+            "}\n";
+        break;
+    }
+
+    shaderStr <<
+        "\n"
+        "const uint tileRows = 64;\n"
+        "\n"
+        "float loadY(ivec3 pos) {\n"
+        "    return imageLoad(inputImageY, pos).r;\n"
+        "}\n"
+        "\n";
+    AddResamplePlane(shaderStr, "Y", "float", "loadY",
+                     "imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(value, 0, 0, 1));",
+                     m_workgroupSizeX);
+    AddResamplePlane(shaderStr, "CbCr", "vec2", "loadCbCr",
+                     "storeCbCr(ivec3(pos, pushConstants.dstImageLayer), value);",
+                     m_workgroupSizeX);
+
+    shaderStr <<
+        "void main()\n"
+        "{\n"
+        "    ivec2 srcSize = ivec2(pushConstants.srcWidth, pushConstants.srcHeight);\n"
+        "    ivec2 dstSize = ivec2(pushConstants.dstWidth, pushConstants.dstHeight);\n"
+        "    resampleY(srcSize, dstSize);\n"
+        "\n"
+        "    // The chroma planes with their own sub-sampling, the sample centers aligned as for the midpoint siting\n"
+        "    resampleCbCr((srcSize + (ivec2(1) << inputChromaShift) - 1) >> inputChromaShift,\n"
+        "                 (dstSize + (ivec2(1) << outChromaShift) - 1) >> outChromaShift);\n"
+        "}\n";
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+size_t VulkanFilterYuvCompute::InitYCBCR2BUFFER(std::string& computeShader)
+{
+    // The compute filter uses two input images as separate planes
+    // Y (R) binding = 1
+    // CbCr (RG) binding = 2
+    m_inputImageAspects = VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT;
+
+    // The compute filter writes the Y, Cb and Cr planes to the output buffer with binding = 9
+    m_outputImageAspects = VK_IMAGE_ASPECT_NONE;
+
+    // The samples keep the containers of the input format, i.e. P010 stays MSB aligned in 16 bits.
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_inputFormat);
+    const bool is16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != YCBCRA_8BPP);
+    const uint32_t chromaShiftX = ((mpInfo != nullptr) && mpInfo->planesLayout.secondaryPlaneSubsampledX) ? 1 : 0;
+    const uint32_t chromaShiftY = ((mpInfo != nullptr) && mpInfo->planesLayout.secondaryPlaneSubsampledY) ? 1 : 0;
+
+    // Create compute pipeline
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "    uint yOffset;\n"
+                        "    uint yPitch;\n"
+                        "    uint cbOffset;\n"
+                        "    uint cbPitch;\n"
+                        "    uint crOffset;\n"
+                        "    uint crPitch;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n"
+                        "layout (set = 0, binding = 9) writeonly buffer OutputBuffer {\n"
+                        "    uint outputData[];\n"
+                        "};\n";
+    if (is16BitSample) {
+        shaderStr <<    "layout (set = 0, binding = 1, r16) uniform readonly image2DArray inputImageY;\n"
+                        "layout (set = 0, binding = 2, rg16) uniform readonly image2DArray inputImageCbCr;\n"
+                        "\n"
+                        "const uint bytesPerSample = 2;\n"
+                        "const float sampleMax = 65535.0;\n";
+    } else {
+        shaderStr <<    "layout (set = 0, binding = 1, r8) uniform readonly image2DArray inputImageY;\n"
+                        "layout (set = 0, binding = 2, rg8) uniform readonly image2DArray inputImageCbCr;\n"
+                        "\n"
+                        "const uint bytesPerSample = 1;\n"
+                        "const float sampleMax = 255.0;\n";
+    }
+
+    shaderStr <<
+        "const uint chromaShiftX = " << chromaShiftX << ";\n"
+        "const uint chromaShiftY = " << chromaShiftY << ";\n"
+        "\n"
+        "// The sample stored at the byte offset of the output buffer, zero for the padding\n"
+        "uint loadSample(uint byteOffset) {\n"
+        "    uint planeOffset = pushConstants.yOffset;\n"
+        "    uint pitch = pushConstants.yPitch;\n"
+        "    uint width = pushConstants.width;\n"
+        "    if (byteOffset >= pushConstants.cbOffset) {\n"
+        "        bool isCr = (byteOffset >= pushConstants.crOffset);\n"
+        "        planeOffset = isCr ? pushConstants.crOffset : pushConstants.cbOffset;\n"
+        "        pitch = isCr ? pushConstants.crPitch : pushConstants.cbPitch;\n"
+        "        width >>= chromaShiftX;\n"
+        "    } else if (byteOffset < planeOffset) {\n"
+        "        return 0;\n"
+        "    }\n"
+        "\n"
+        "    uint offsetInPlane = byteOffset - planeOffset;\n"
+        "    uvec2 pos = uvec2((offsetInPlane % pitch) / bytesPerSample, offsetInPlane / pitch);\n"
+        "    if (pos.x >= width) {\n"
+        "        return 0;\n"
+        "    }\n"
+        "\n"
+        "    float value;\n"
+        "    if (byteOffset < pushConstants.cbOffset) {\n"
+        "        value = imageLoad(inputImageY, ivec3(pos, pushConstants.srcImageLayer)).r;\n"
+        "    } else {\n"
+        "        vec2 CbCr = imageLoad(inputImageCbCr, ivec3(pos, pushConstants.srcImageLayer)).rg;\n"
+        "        value = (byteOffset >= pushConstants.crOffset) ? CbCr.g : CbCr.r;\n"
+        "    }\n"
+        "    return uint(value * sampleMax + 0.5);\n"
+        "}\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    // Each invocation packs a 32-bit word of the output buffer, without sharing it with another one\n"
+        "    uint wordIndex = gl_GlobalInvocationID.y * (gl_NumWorkGroups.x * gl_WorkGroupSize.x) + gl_GlobalInvocationID.x;\n"
+        "    uint byteOffset = wordIndex * 4;\n"
+        "    uint size = pushConstants.crOffset + pushConstants.crPitch * (pushConstants.height >> chromaShiftY);\n"
+        "    if (byteOffset >= size) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    uint word = 0;\n"
+        "    for (uint i = 0; (i < 4) && ((byteOffset + i) < size); i += bytesPerSample) {\n"
+        "        word |= loadSample(byteOffset + i) << (i * 8);\n"
+        "    }\n"
+        "    outputData[wordIndex] = word;\n"
+        "}\n";
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+// Generates sample<name>(), the input samples of a plane about center filtered by the triangle kernel widened by
+// kernelScale, with the samples outside of the rectangle first..last clamped to its edges
+static void AddSamplePlane(std::stringstream& shaderStr, const char* name, const char* type, const char* loadFunction)
+{
+    shaderStr <<
+        type << " sample" << name << "(vec2 center, vec2 kernelScale, ivec2 first, ivec2 last)\n"
+        "{\n"
+        "    ivec2 firstTap = ivec2(ceil(center - kernelScale));\n"
+        "    ivec2 lastTap = ivec2(floor(center + kernelScale));\n"
+        "    " << type << " sum = " << type << "(0.0);\n"
+        "    float weightSum = 0.0;\n"
+        "    for (int y = firstTap.y; y <= lastTap.y; y++) {\n"
+        "        float wy = kernelWeight((float(y) - center.y) / kernelScale.y);\n"
+        "        for (int x = firstTap.x; x <= lastTap.x; x++) {\n"
+        "            float w = wy * kernelWeight((float(x) - center.x) / kernelScale.x);\n"
+        "            sum += w * " << loadFunction << "(ivec3(clamp(ivec2(x, y), first, last), pushConstants.srcImageLayer));\n"
+        "            weightSum += w;\n"
+        "        }\n"
+        "    }\n"
+        "    return sum / weightSum;\n"
+        "}\n"
+        "\n";
+}
+
+size_t VulkanFilterYuvCompute::InitYCBCRFUSED(std::string& computeShader)
+{
+    // The compute filter uses the input image planes
+    // Y (R) binding = 1
+    // CbCr (RG) binding = 2, or Cb (R) binding = 2 and Cr (R) binding = 3
+    const YcbcrPlanesFormat inputPlanesFormat = GetYcbcrPlanesFormat(m_inputFormat);
+    m_inputImageAspects = GetPlaneAspects(inputPlanesFormat);
+
+    // The compute filter uses RGBA output image with binding = 4 for a format without YCbCr info, else the
+    // output image planes
+    // Y (R) binding = 5
+    // CbCr (RG) binding = 6, or Cb (R) binding = 6 and Cr (R) binding = 7
+    const VkMpFormatInfo* outputMpInfo = YcbcrVkFormatInfo(m_outputFormat);
+    const bool isRgbaOutput = (outputMpInfo == nullptr);
+    const YcbcrPlanesFormat outputPlanesFormat = GetYcbcrPlanesFormat(m_outputFormat);
+    m_outputImageAspects = isRgbaOutput ? (VkImageAspectFlags)VK_IMAGE_ASPECT_COLOR_BIT :
+                                          GetPlaneAspects(outputPlanesFormat);
+
+    // The color conversion is of the YCbCr sampler conversion
+    assert(!isRgbaOutput || (m_samplerYcbcrConversion.GetSampler() != VK_NULL_HANDLE));
+    const bool is16BitRgbaOutput = (m_outputFormat == VK_FORMAT_R16G16B16A16_UNORM);
+
+    // Create compute pipeline
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "    int  cropX;\n"
+                        "    int  cropY;\n"
+                        "    uint cropWidth;\n"
+                        "    uint cropHeight;\n"
+                        "    uint dstWidth;\n"
+                        "    uint dstHeight;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n";
+    AddInputPlanes(shaderStr, inputPlanesFormat);
+    if (isRgbaOutput) {
+        shaderStr << "layout (set = 0, binding = 4, " << (is16BitRgbaOutput ? "rgba16" : "rgba8")
+                  <<            ") uniform writeonly image2DArray outImage;\n"
+                            "\n";
+        AddYCbCrToRgbConversion(shaderStr, m_samplerYcbcrConversion.GetSamplerYcbcrConversionCreateInfo());
+    } else {
+        AddOutputPlanes(shaderStr, outputPlanesFormat);
+    }
+
+    shaderStr <<
+        "float kernelWeight(float x) {\n"
+        "    return max(1.0 - abs(x), 0.0);\n"
+        "}\n"
+        "\n"
+        "float loadY(ivec3 pos) {\n"
+        "    return imageLoad(inputImageY, pos).r;\n"
+        "}\n"
+        "\n";
+    AddSamplePlane(shaderStr, "Y", "float", "loadY");
+    AddSamplePlane(shaderStr, "CbCr", "vec2", "loadCbCr");
+
+    shaderStr <<
+        "void main()\n"
+        "{\n"
+        "    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);\n"
+        "    ivec2 dstSize = ivec2(pushConstants.dstWidth, pushConstants.dstHeight);\n"
+        "    if (any(greaterThanEqual(pos, dstSize))) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    // The crop rectangle, in the luma and in the chroma samples of the input\n"
+        "    ivec2 cropFirst = ivec2(pushConstants.cropX, pushConstants.cropY);\n"
+        "    ivec2 cropLast = cropFirst + ivec2(pushConstants.cropWidth, pushConstants.cropHeight) - 1;\n"
+        "    ivec2 chromaFirst = cropFirst >> inputChromaShift;\n"
+        "    ivec2 chromaLast = cropLast >> inputChromaShift;\n"
+        "    vec2 inputChromaScale = vec2(ivec2(1) << inputChromaShift);\n"
+        "\n"
+        "    // The kernel is widened by the downscaling ratio, for it to low-pass the input\n"
+        "    vec2 scale = vec2(pushConstants.cropWidth, pushConstants.cropHeight) / vec2(dstSize);\n"
+        "    vec2 center = vec2(cropFirst) + (vec2(pos) + 0.5) * scale - 0.5;\n"
+        "    float Y = sampleY(center, max(scale, vec2(1.0)), cropFirst, cropLast);\n"
+        "\n";
+    if (isRgbaOutput) {
+        shaderStr <<
+        "    // The chroma at the luma sample, the sample centers aligned as for the midpoint siting\n"
+        "    vec2 CbCr = sampleCbCr((center + 0.5) / inputChromaScale - 0.5,\n"
+        "                           max(scale / inputChromaScale, vec2(1.0)), chromaFirst, chromaLast);\n"
+        "\n"
+        "    vec3 ycbcr = shiftCbCr(normalizeYCbCr(vec3(Y, CbCr)));\n"
+        "    imageStore(outImage, ivec3(pos, pushConstants.dstImageLayer), vec4(convertYCbCrToRgb(ycbcr), 1.0));\n"
+        "}\n";
+    } else {
+        shaderStr <<
+        "    imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(Y, 0, 0, 1));\n"
+        "\n"
+        "    // An output chroma sample covers 1 << outChromaShift luma samples, sited as for the midpoint\n"
+        "    if ((pos & ((ivec2(1) << outChromaShift) - 1)) == ivec2(0, 0)) {\n"
+        "        vec2 outChromaScale = vec2(ivec2(1) << outChromaShift);\n"
+        "        vec2 chromaPos = vec2(pos >> outChromaShift);\n"
+        "        vec2 chromaCenter = (vec2(cropFirst) + (chromaPos + 0.5) * outChromaScale * scale) / inputChromaScale - 0.5;\n"
+        "        vec2 CbCr = sampleCbCr(chromaCenter, max(scale * outChromaScale / inputChromaScale, vec2(1.0)),\n"
+        "                               chromaFirst, chromaLast);\n"
+        "        storeCbCr(ivec3(pos >> outChromaShift, pushConstants.dstImageLayer), CbCr);\n"
+        "    }\n"
+        "}\n";
+    }
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+// The storage image format qualifier of the RGBA input formats of RGBA2YCBCR
+static const char* GetRgbaImageFormat(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return "rgba8";
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        return "rgb10_a2";
+    case VK_FORMAT_R16G16B16A16_UNORM:
+        return "rgba16";
+    default:
+        ;
+    }
+
+    return nullptr;
+}
+
+size_t VulkanFilterYuvCompute::InitRGBA2YCBCR(std::string& computeShader)
+{
+    // The compute filter uses the RGBA input image with binding = 0, as a storage image
+    const char* inputImageFormat = GetRgbaImageFormat(m_inputFormat);
+    if (inputImageFormat == nullptr) {
+        std::cerr << "ERROR: Unsupported RGBA input format " << m_inputFormat << " of RGBA2YCBCR" << std::endl;
+        return 0;
+    }
+    m_inputImageAspects = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    // The compute filter uses the output image planes
+    // Y (R) binding = 5
+    // CbCr (RG) binding = 6, or Cb (R) binding = 6 and Cr (R) binding = 7
+    const VkMpFormatInfo* outputMpInfo = YcbcrVkFormatInfo(m_outputFormat);
+    if (outputMpInfo == nullptr) {
+        std::cerr << "ERROR: Unsupported YCbCr output format " << m_outputFormat << " of RGBA2YCBCR" << std::endl;
+        return 0;
+    }
+    const YcbcrPlanesFormat outputPlanesFormat = GetYcbcrPlanesFormat(m_outputFormat);
+    m_outputImageAspects = GetPlaneAspects(outputPlanesFormat);
+    m_samplesPerInvocation = 2;
+
+    const YcbcrBtStandard btStandard =
+        (m_outputYcbcrConversionInfo.ycbcrModel == VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_601)  ? YcbcrBtStandardBt601Ebu :
+        (m_outputYcbcrConversionInfo.ycbcrModel == VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_2020) ? YcbcrBtStandardBt2020 :
+                                                                                                    YcbcrBtStandardBt709;
+    const YcbcrPrimariesConstants primariesConstants = GetYcbcrPrimariesConstants(btStandard);
+    const YcbcrRangeConstants rangeConstants = GetYcbcrRangeConstants(YcbcrLevelsDigital);
+    const YcbcrBtMatrix yCbCrMatrix(primariesConstants.kb,
+                                    primariesConstants.kr,
+                                    rangeConstants.cbMax,
+                                    rangeConstants.crMax);
+
+    // The codes of the range at the bit depth of the output, MSB aligned in their 8 or 16-bit containers and
+    // normalized to the UNORM of the container
+    const uint32_t bitDepth = 8 + outputMpInfo->planesLayout.bpp * 2;
+    const uint32_t containerBits = (outputMpInfo->planesLayout.bpp != YCBCRA_8BPP) ? 16 : 8;
+    const double codeScale = (double)(1U << (containerBits - bitDepth)) / (double)((1U << containerBits) - 1);
+    const bool isNarrowRange = (m_outputYcbcrConversionInfo.ycbcrRange == VK_SAMPLER_YCBCR_RANGE_ITU_NARROW);
+    const double maxCode = (double)((1U << bitDepth) - 1);
+    const float yScale  = (float)((isNarrowRange ? (double)(219U << (bitDepth - 8)) : maxCode) * codeScale);
+    const float yOffset = (float)((isNarrowRange ? (double)(16U << (bitDepth - 8)) : 0.0) * codeScale);
+    const float cScale  = (float)((isNarrowRange ? (double)(224U << (bitDepth - 8)) : maxCode) * codeScale);
+    const float cOffset = (float)((double)(1U << (bitDepth - 1)) * codeScale);
+
+    // The weights of the RGB samples at the offsets -1 to 2 from the luma sample of a chroma sample, for the
+    // chroma to be centered on its siting: cosited with the even luma sample, or midway to the odd one
+    const uint32_t chromaShift[2] = { outputPlanesFormat.chromaShiftX, outputPlanesFormat.chromaShiftY };
+    const VkChromaLocation chromaOffset[2] = { m_outputYcbcrConversionInfo.xChromaOffset,
+                                               m_outputYcbcrConversionInfo.yChromaOffset };
+    const char* chromaWeights[2];
+    for (uint32_t dim = 0; dim < 2; dim++) {
+        chromaWeights[dim] = (chromaShift[dim] == 0) ? "vec4(0.0, 1.0, 0.0, 0.0)" :
+                             (chromaOffset[dim] == VK_CHROMA_LOCATION_COSITED_EVEN) ? "vec4(0.25, 0.5, 0.25, 0.0)" :
+                                                                                     "vec4(0.0, 0.5, 0.5, 0.0)";
+    }
+
+    // Create compute pipeline
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint dstImageLayer;\n"
+                        "    int  cropX;\n"
+                        "    int  cropY;\n"
+                        "    uint cropWidth;\n"
+                        "    uint cropHeight;\n"
+                        "    uint dstWidth;\n"
+                        "    uint dstHeight;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << m_workgroupSizeX << ", local_size_y = " << m_workgroupSizeY << ") in;\n"
+                        "layout (set = 0, binding = 0, " << inputImageFormat << ") uniform readonly image2DArray inputImage;\n";
+    AddOutputPlanes(shaderStr, outputPlanesFormat);
+
+    shaderStr <<
+        "vec3 convertRgbToYCbCr(vec3 rgb) {\n"
+        "    vec3 yuv;\n";
+    yCbCrMatrix.ConvertRgbToYCbCrString(shaderStr);
+    shaderStr <<
+        "    return yuv;\n"
+        "}\n"
+        "\n"
+        "float encodeY(float Y) {\n"
+        "    return clamp(Y * " << yScale << " + " << yOffset << ", 0.0, 1.0);\n"
+        "}\n"
+        "\n"
+        "vec2 encodeCbCr(vec2 CbCr) {\n"
+        "    return clamp(CbCr * " << cScale << " + " << cOffset << ", 0.0, 1.0);\n"
+        "}\n"
+        "\n"
+        "const vec4 chromaWeightsX = " << chromaWeights[0] << ";\n"
+        "const vec4 chromaWeightsY = " << chromaWeights[1] << ";\n"
+        "\n"
+        "vec3 loadRgb(ivec2 pos, ivec2 first, ivec2 last) {\n"
+        "    return imageLoad(inputImage, ivec3(clamp(pos, first, last), pushConstants.srcImageLayer)).rgb;\n"
+        "}\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    // A 2x2 quad of luma samples per invocation, aligned to the chroma samples\n"
+        "    ivec2 quadPos = ivec2(gl_GlobalInvocationID.xy) * 2;\n"
+        "    ivec2 srcSize = ivec2(pushConstants.cropWidth, pushConstants.cropHeight);\n"
+        "    ivec2 dstSize = min(srcSize, ivec2(pushConstants.dstWidth, pushConstants.dstHeight));\n"
+        "    if (any(greaterThanEqual(quadPos, dstSize))) {\n"
+        "        return;\n"
+        "    }\n"
+        "\n"
+        "    ivec2 srcFirst = ivec2(pushConstants.cropX, pushConstants.cropY);\n"
+        "    ivec2 srcLast = srcFirst + srcSize - 1;\n"
+        "\n"
+        "    for (int i = 0; i < 4; i++) {\n"
+        "        ivec2 pos = quadPos + ivec2(i & 1, i >> 1);\n"
+        "        if (any(greaterThanEqual(pos, dstSize))) {\n"
+        "            continue;\n"
+        "        }\n"
+        "\n"
+        "        float Y = convertRgbToYCbCr(loadRgb(srcFirst + pos, srcFirst, srcLast)).x;\n"
+        "        imageStore(outImageY, ivec3(pos, pushConstants.dstImageLayer), vec4(encodeY(Y), 0, 0, 1));\n"
+        "    }\n"
+        "\n"
+        "    // The chroma samples of the quad, low-passed from the RGB samples around their siting, as the\n"
+        "    // conversion is linear\n"
+        "    ivec2 chromaCount = ivec2(2) >> outChromaShift;\n"
+        "    for (int cy = 0; cy < chromaCount.y; cy++) {\n"
+        "        for (int cx = 0; cx < chromaCount.x; cx++) {\n"
+        "            ivec2 lumaPos = quadPos + (ivec2(cx, cy) << outChromaShift);\n"
+        "            if (any(greaterThanEqual(lumaPos, dstSize))) {\n"
+        "                continue;\n"
+        "            }\n"
+        "\n"
+        "            vec3 rgb = vec3(0.0);\n"
+        "            for (int ty = 0; ty < 4; ty++) {\n"
+        "                for (int tx = 0; tx < 4; tx++) {\n"
+        "                    float w = chromaWeightsX[tx] * chromaWeightsY[ty];\n"
+        "                    if (w > 0.0) {\n"
+        "                        rgb += w * loadRgb(srcFirst + lumaPos + ivec2(tx, ty) - 1, srcFirst, srcLast);\n"
+        "                    }\n"
+        "                }\n"
+        "            }\n"
+        "\n"
+        "            vec2 CbCr = convertRgbToYCbCr(rgb).yz;\n"
+        "            storeCbCr(ivec3(lumaPos >> outChromaShift, pushConstants.dstImageLayer), encodeCbCr(CbCr));\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    computeShader = shaderStr.str();
+    std::cout << "\nCompute Shader:\n" << computeShader;
+    return computeShader.size();
+}
+
+VkResult VulkanFilterYuvCompute::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                     VkBuffer inputBuffer,
+                                                     const VkSubresourceLayout inputPlaneLayouts[3],
+                                                     const VkExtent2D& inputExtent,
+                                                     const VkImageResourceView* outputImageView,
+                                                     const VkVideoPictureResourceInfoKHR* outputImageResourceInfo)
+{
+    assert(m_filterType == BUFFER2YCBCR);
+    assert((inputBuffer != VK_NULL_HANDLE) && (outputImageView != nullptr));
+    assert(outputImageView->GetNumberOfPlanes() >= 2);
+    // The storage buffer descriptor is pushed, see Init()
+    assert(m_descriptorSetLayout.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode() ==
+               VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 3;
+    VkDescriptorImageInfo imageDescriptors[2]{};
+    VkDescriptorBufferInfo bufferDescriptor{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    // Input planes buffer
+    bufferDescriptor.buffer = inputBuffer;
+    bufferDescriptor.offset = 0;
+    bufferDescriptor.range = VK_WHOLE_SIZE;
+    writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[0].dstBinding = 9;
+    writeDescriptorSets[0].descriptorCount = 1;
+    writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writeDescriptorSets[0].pBufferInfo = &bufferDescriptor;
+
+    // y and CbCr planes out
+    for (uint32_t planeNum = 0; planeNum < 2; planeNum++) {
+        imageDescriptors[planeNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[planeNum].imageView = outputImageView->GetPlaneImageView(planeNum);
+        assert(imageDescriptors[planeNum].imageView);
+        imageDescriptors[planeNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[1 + planeNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = 5 + planeNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.pImageInfo = &imageDescriptors[planeNum];
+    }
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t dstLayer;
+        uint32_t yOffset;
+        uint32_t yPitch;
+        uint32_t cbOffset;
+        uint32_t cbPitch;
+        uint32_t crOffset;
+        uint32_t crPitch;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    const PushConstants pushConstants = {
+            0,
+            outputImageResourceInfo ? outputImageResourceInfo->baseArrayLayer : 0, // Set the destination layer index
+            (uint32_t)inputPlaneLayouts[0].offset,
+            (uint32_t)inputPlaneLayouts[0].rowPitch,
+            (uint32_t)inputPlaneLayouts[1].offset,
+            (uint32_t)inputPlaneLayouts[1].rowPitch,
+            (uint32_t)inputPlaneLayouts[2].offset,
+            (uint32_t)inputPlaneLayouts[2].rowPitch,
+            inputExtent.width,
+            inputExtent.height
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    const uint32_t width  = inputExtent.width  + (m_workgroupSizeX - 1);
+    const uint32_t height = inputExtent.height + (m_workgroupSizeY - 1);
+
+    m_vkDevCtx->CmdDispatch(cmdBuf, width / m_workgroupSizeX, height / m_workgroupSizeY, 1);
+
+    return VK_SUCCESS;
+}
+
+VkResult VulkanFilterYuvCompute::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                     VkImageView inputImageView,
+                                                     uint32_t inputImageLayer,
+                                                     const VkExtent2D& inputExtent,
+                                                     const VkImageResourceView* outputImageView,
+                                                     const VkVideoPictureResourceInfoKHR* outputImageResourceInfo)
+{
+    assert(m_filterType == RGBA2YCBCR);
+    assert((inputImageView != VK_NULL_HANDLE) && (outputImageView != nullptr));
+    assert(m_descriptorSetLayout.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode() ==
+               VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numPlanes = (m_outputImageAspects & VK_IMAGE_ASPECT_PLANE_2_BIT) ? 3 : 2;
+    assert(outputImageView->GetNumberOfPlanes() >= numPlanes);
+    VkDescriptorImageInfo imageDescriptors[4]{};
+    std::array<VkWriteDescriptorSet, 4> writeDescriptorSets{};
+
+    // RGBA in
+    imageDescriptors[0].sampler = VK_NULL_HANDLE;
+    imageDescriptors[0].imageView = inputImageView;
+    imageDescriptors[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[0].dstBinding = 0;
+    writeDescriptorSets[0].descriptorCount = 1;
+    writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSets[0].pImageInfo = &imageDescriptors[0];
+
+    // y and CbCr, or y, Cb and Cr planes out
+    for (uint32_t planeNum = 0; planeNum < numPlanes; planeNum++) {
+        imageDescriptors[1 + planeNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[1 + planeNum].imageView = outputImageView->GetPlaneImageView(planeNum);
+        assert(imageDescriptors[1 + planeNum].imageView);
+        imageDescriptors[1 + planeNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[1 + planeNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = 5 + planeNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.pImageInfo = &imageDescriptors[1 + planeNum];
+    }
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, 1 + numPlanes, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t dstLayer;
+        int32_t  cropX;
+        int32_t  cropY;
+        uint32_t cropWidth;
+        uint32_t cropHeight;
+        uint32_t dstWidth;
+        uint32_t dstHeight;
+    };
+
+    const VkImageCreateInfo& imageCreateInfo = outputImageView->GetImageResource()->GetImageCreateInfo();
+    const bool hasOutputRect = (outputImageResourceInfo != nullptr) &&
+                               (outputImageResourceInfo->codedExtent.width != 0) &&
+                               (outputImageResourceInfo->codedExtent.height != 0);
+    const VkExtent2D dstExtent = hasOutputRect ? outputImageResourceInfo->codedExtent :
+                                                 VkExtent2D{ imageCreateInfo.extent.width, imageCreateInfo.extent.height };
+
+    const PushConstants pushConstants = {
+            inputImageLayer,
+            outputImageResourceInfo ? outputImageResourceInfo->baseArrayLayer : 0, // Set the destination layer index
+            0,
+            0,
+            inputExtent.width,
+            inputExtent.height,
+            dstExtent.width,
+            dstExtent.height
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    // A 2x2 quad per invocation, over the samples both images have
+    const uint32_t blockWidth  = m_workgroupSizeX * m_samplesPerInvocation;
+    const uint32_t blockHeight = m_workgroupSizeY * m_samplesPerInvocation;
+    const uint32_t width  = std::min(inputExtent.width, dstExtent.width);
+    const uint32_t height = std::min(inputExtent.height, dstExtent.height);
+    m_vkDevCtx->CmdDispatch(cmdBuf,
+                            (width  + (blockWidth - 1))  / blockWidth,
+                            (height + (blockHeight - 1)) / blockHeight,
+                            1);
+
+    return VK_SUCCESS;
+}
+
+VkResult VulkanFilterYuvCompute::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                     const VkImageResourceView* inputImageView,
+                                                     const VkVideoPictureResourceInfoKHR* inputImageResourceInfo,
+                                                     const VkExtent2D& inputExtent,
+                                                     const VkImageResourceView* outputImageView,
+                                                     const VkVideoPictureResourceInfoKHR* outputImageResourceInfo,
+                                                     const VkExtent2D& outputExtent)
+{
+    assert(IsScaleFilter(m_filterType));
+    assert((inputImageView != nullptr) && (outputImageView != nullptr));
+
+    const uint32_t numInputPlanes = (m_inputImageAspects & VK_IMAGE_ASPECT_PLANE_2_BIT) ? 3 : 2;
+    const uint32_t numOutputPlanes = (m_outputImageAspects & VK_IMAGE_ASPECT_PLANE_2_BIT) ? 3 : 2;
+    assert((inputImageView->GetNumberOfPlanes() >= numInputPlanes) &&
+           (outputImageView->GetNumberOfPlanes() >= numOutputPlanes));
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t maxNumDescriptors = 6;
+    const uint32_t numDescriptors = numInputPlanes + numOutputPlanes;
+    VkDescriptorImageInfo imageDescriptors[maxNumDescriptors]{};
+    std::array<VkWriteDescriptorSet, maxNumDescriptors> writeDescriptorSets{};
+
+    // y and CbCr (or Cb and Cr) planes in, then out
+    for (uint32_t descrIndex = 0; descrIndex < numDescriptors; descrIndex++) {
+        const bool isInput = (descrIndex < numInputPlanes);
+        const uint32_t planeNum = isInput ? descrIndex : (descrIndex - numInputPlanes);
+        imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+        imageDescriptors[descrIndex].imageView = isInput ? inputImageView->GetPlaneImageView(planeNum) :
+                                                           outputImageView->GetPlaneImageView(planeNum);
+        assert(imageDescriptors[descrIndex].imageView);
+        imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[descrIndex];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = (isInput ? 1 : 5) + planeNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.pImageInfo = &imageDescriptors[descrIndex];
+    }
+
+    // The slot of the descriptor buffer is reused after maxNumFrames recordings
+    VkResult result = BindDescriptors(cmdBuf, GetNextDescriptorSlot(), numDescriptors, writeDescriptorSets.data());
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t dstLayer;
+        uint32_t srcWidth;
+        uint32_t srcHeight;
+        uint32_t dstWidth;
+        uint32_t dstHeight;
+    };
+
+    const PushConstants pushConstants = {
+            inputImageResourceInfo  ? inputImageResourceInfo->baseArrayLayer : 0, // Set the source layer index
+            outputImageResourceInfo ? outputImageResourceInfo->baseArrayLayer : 0, // Set the destination layer index
+            inputExtent.width,
+            inputExtent.height,
+            outputExtent.width,
+            outputExtent.height
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    const uint32_t width  = outputExtent.width  + (m_workgroupSizeX - 1);
+    const uint32_t height = outputExtent.height + (m_workgroupSizeY - 1);
+
+    m_vkDevCtx->CmdDispatch(cmdBuf, width / m_workgroupSizeX, height / m_workgroupSizeY, 1);
+
+    return VK_SUCCESS;
+}
+
+VkResult VulkanFilterYuvCompute::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                     const VkImageResourceView* inputImageView,
+                                                     const VkVideoPictureResourceInfoKHR* inputImageResourceInfo,
+                                                     const VkExtent2D& inputExtent,
+                                                     const VkBufferResource* outputBuffer,
+                                                     const VkSubresourceLayout outputPlaneLayouts[3])
+{
+    assert(m_filterType == YCBCR2BUFFER);
+    assert((inputImageView != nullptr) && (outputBuffer != nullptr));
+    assert(inputImageView->GetNumberOfPlanes() >= 2);
+    assert((outputPlaneLayouts[0].offset <= outputPlaneLayouts[1].offset) &&
+           (outputPlaneLayouts[1].offset <= outputPlaneLayouts[2].offset));
+    // The storage buffer descriptor is pushed, see Init()
+    assert(m_descriptorSetLayout.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode() ==
+               VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 3;
+    VkDescriptorImageInfo imageDescriptors[2]{};
+    VkDescriptorBufferInfo bufferDescriptor{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    // y and CbCr planes in
+    for (uint32_t planeNum = 0; planeNum < 2; planeNum++) {
+        imageDescriptors[planeNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[planeNum].imageView = inputImageView->GetPlaneImageView(planeNum);
+        assert(imageDescriptors[planeNum].imageView);
+        imageDescriptors[planeNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[planeNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = 1 + planeNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.pImageInfo = &imageDescriptors[planeNum];
+    }
+
+    // Output planes buffer
+    bufferDescriptor.buffer = outputBuffer->GetBuffer();
+    bufferDescriptor.offset = 0;
+    bufferDescriptor.range = VK_WHOLE_SIZE;
+    writeDescriptorSets[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[2].dstBinding = 9;
+    writeDescriptorSets[2].descriptorCount = 1;
+    writeDescriptorSets[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writeDescriptorSets[2].pBufferInfo = &bufferDescriptor;
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t dstLayer;
+        uint32_t yOffset;
+        uint32_t yPitch;
+        uint32_t cbOffset;
+        uint32_t cbPitch;
+        uint32_t crOffset;
+        uint32_t crPitch;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    const PushConstants pushConstants = {
+            inputImageResourceInfo ? inputImageResourceInfo->baseArrayLayer : 0, // Set the source layer index
+            0,
+            (uint32_t)outputPlaneLayouts[0].offset,
+            (uint32_t)outputPlaneLayouts[0].rowPitch,
+            (uint32_t)outputPlaneLayouts[1].offset,
+            (uint32_t)outputPlaneLayouts[1].rowPitch,
+            (uint32_t)outputPlaneLayouts[2].offset,
+            (uint32_t)outputPlaneLayouts[2].rowPitch,
+            inputExtent.width,
+            inputExtent.height
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    // One invocation per 32-bit word, a row of the dispatch covers a luma row
+    const uint32_t numWords = (uint32_t)((outputPlaneLayouts[2].offset + outputPlaneLayouts[2].size + 3) / 4);
+    const uint32_t groupCountX = (((uint32_t)outputPlaneLayouts[0].rowPitch + 3) / 4 + (m_workgroupSizeX - 1)) / m_workgroupSizeX;
+    const uint32_t wordsPerRow = groupCountX * m_workgroupSizeX;
+    const uint32_t groupCountY = ((numWords + wordsPerRow - 1) / wordsPerRow + (m_workgroupSizeY - 1)) / m_workgroupSizeY;
+
+    m_vkDevCtx->CmdDispatch(cmdBuf, groupCountX, groupCountY, 1);
+
+    return VK_SUCCESS;
+}
@@ -18,19 +18,50 @@
 #ifndef _VULKANFILTERYUVCOMPUTE_H_
 #define _VULKANFILTERYUVCOMPUTE_H_
 
+#include <cstddef>
 #include "VkCodecUtils/VulkanCommandBuffersSet.h"
 #include "VkCodecUtils/VulkanSemaphoreSet.h"
 #include "VkCodecUtils/VulkanFenceSet.h"
 #include "VkCodecUtils/VulkanDescriptorSetLayout.h"
 #include "VkCodecUtils/VulkanComputePipeline.h"
 #include "VkCodecUtils/VulkanFilter.h"
+#include "VkCodecUtils/VkBufferResource.h"
 #include "nvidia_utils/vulkan/ycbcr_utils.h"
 
 class VulkanFilterYuvCompute : public VulkanFilter
 {
 public:
 
-    enum FilterType { YCBCRCOPY, YCBCRCLEAR, YCBCR2RGBA, RGBA2YCBCR };
+    // BUFFER2YCBCR converts a 3-plane 4:2:0 buffer (I420 or its 16-bit container variants) to a 2-plane image.
+    // YCBCRSCALE resizes a 2-plane 4:2:0 image into another one, averaging the input samples each output sample covers.
+    // YCBCR2BUFFER deinterleaves a 2-plane image into a 3-plane buffer, with the sample containers of the image.
+    // YCBCRSCALE_BILINEAR, YCBCRSCALE_BICUBIC and YCBCRSCALE_LANCZOS resample a 2 or 3-plane image into another one
+    // with the separable kernel, widened by the downscaling ratio. The horizontal pass of the rows a workgroup needs
+    // is kept in shared memory for its vertical pass, one input sample is read once per output column.
+    // YCBCRFUSED runs the crop, the scaling, the color conversion and the bit-depth change of the output
+    // processing as one dispatch, reading the input samples once: the input is cropped to the coded rectangle of
+    // its picture resource and scaled to the coded extent of the output one, or to the output image. The output
+    // is RGBA, or YCbCr of the bit depth and the chroma sub-sampling of the output format.
+    // RGBA2YCBCR converts an RGBA image (R8G8B8A8, A2B10G10R10 or R16G16B16A16 UNORM) to a 2 or 3-plane image, with
+    // the model, the range and the chroma siting of the YCbCr conversion info: the chroma samples are low-passed
+    // from the RGB samples they cover, centered on their siting.
+    // YCBCRDEINTERLACE_BOB and YCBCRDEINTERLACE_ADAPTIVE turn a frame of woven fields, e.g. the field pair decoded
+    // into one picture, into a progressive frame of the same size. The lines of the top field are kept, those of the
+    // bottom field are interpolated from the lines above and below them by bob. The motion adaptive mode keeps the
+    // bottom field samples where they don't comb against the top field, i.e. where the picture didn't move between
+    // the fields, and blends over to the interpolation where they do.
+    enum FilterType { YCBCRCOPY, YCBCRCLEAR, YCBCR2RGBA, RGBA2YCBCR, BUFFER2YCBCR, YCBCRSCALE, YCBCR2BUFFER,
+                      YCBCRSCALE_BILINEAR, YCBCRSCALE_BICUBIC, YCBCRSCALE_LANCZOS, YCBCRFUSED,
+                      YCBCRDEINTERLACE_BOB, YCBCRDEINTERLACE_ADAPTIVE };
+
+    static bool IsScaleFilter(FilterType filterType) {
+        return (filterType == YCBCRSCALE) || (filterType == YCBCRSCALE_BILINEAR) ||
+               (filterType == YCBCRSCALE_BICUBIC) || (filterType == YCBCRSCALE_LANCZOS);
+    }
+
+    static bool IsDeinterlaceFilter(FilterType filterType) {
+        return (filterType == YCBCRDEINTERLACE_BOB) || (filterType == YCBCRDEINTERLACE_ADAPTIVE);
+    }
 
     static VkResult Create(const VulkanDeviceContext* vkDevCtx,
                            uint32_t queueFamilyIndex,
@@ -58,8 +89,11 @@ public:
         , m_outputFormat(outputFormat)
         , m_workgroupSizeX(16)
         , m_workgroupSizeY(16)
+        , m_samplesPerInvocation(1)
         , m_maxNumFrames(maxNumFrames)
+        , m_nextDescriptorSlot(0)
         , m_ycbcrPrimariesConstants (*pYcbcrPrimariesConstants)
+        , m_outputYcbcrConversionInfo()
         , m_inputImageAspects(  VK_IMAGE_ASPECT_COLOR_BIT |
                                 VK_IMAGE_ASPECT_PLANE_0_BIT |
                                 VK_IMAGE_ASPECT_PLANE_1_BIT |
@@ -94,13 +128,14 @@ public:
                                          const VkVideoPictureResourceInfoKHR * outputImageResourceInfo)
     {
 
-        static const uint64_t fenceWaitTimeout = 100 * 1000 * 1000 /* 100 mSec */;
-        VkFence frameCompleteFence = m_filterCompleteFenceSet.GetFence(frameIdx);
-        assert(frameCompleteFence != VK_NULL_HANDLE);
-        VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &frameCompleteFence, true, fenceWaitTimeout);
+        // The previous submission of the frame must be done with its command buffer. The decode of this frame
+        // is not waited on here, the submission of the filter waits on it on the device.
+        static const uint64_t filterCompleteTimeout = 5ULL * 1000 * 1000 * 1000 /* 5 Sec */;
+        VkResult result = WaitFilterCompleteTimeline(frameIdx, filterCompleteTimeout);
         if (result != VK_SUCCESS) {
-            std::cerr << "\t *************** WARNING: frameCompleteFence is not done *************< " << frameIdx << " >**********************" << std::endl;
-            assert(!"frameCompleteFence is not signaled yet after more than 100 mSec wait");
+            std::cerr << "\t *************** WARNING: the filter of frame " << frameIdx << " is not done, result: "
+                      << result << std::endl;
+            return result;
         }
 
         VkCommandBufferBeginInfo cmdBufferBeginInfo {};
@@ -113,246 +148,331 @@ public:
             return result;
         }
 
+        result = RecordDispatch(cmdBuf, frameIdx, inputImageView, inputImageResourceInfo,
+                                outputImageView, outputImageResourceInfo);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        return m_vkDevCtx->EndCommandBuffer(cmdBuf);
+    }
+
+    // Records the filter into a command buffer of the caller, which also owns its synchronization, after what is
+    // recorded into it already, e.g. the filters of the other outputs of the same frame.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 const VkImageResourceView* inputImageView,
+                                 const VkVideoPictureResourceInfoKHR* inputImageResourceInfo,
+                                 const VkImageResourceView* outputImageView,
+                                 const VkVideoPictureResourceInfoKHR* outputImageResourceInfo)
+    {
+        return RecordDispatch(cmdBuf, GetNextDescriptorSlot(), inputImageView, inputImageResourceInfo,
+                              outputImageView, outputImageResourceInfo);
+    }
+
+    // Records the BUFFER2YCBCR conversion into a command buffer of the caller, which also owns its synchronization.
+    // The output image must be in the VK_IMAGE_LAYOUT_GENERAL layout. The plane layouts are in bytes.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 const VkBufferResource* inputBuffer,
+                                 const VkSubresourceLayout inputPlaneLayouts[3],
+                                 const VkExtent2D& inputExtent,
+                                 const VkImageResourceView* outputImageView,
+                                 const VkVideoPictureResourceInfoKHR* outputImageResourceInfo)
+    {
+        assert(inputBuffer != nullptr);
+        return RecordCommandBuffer(cmdBuf, inputBuffer->GetBuffer(), inputPlaneLayouts, inputExtent,
+                                   outputImageView, outputImageResourceInfo);
+    }
+
+    // The same, from any storage buffer, e.g. an imported host memory range the plane offsets point into.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 VkBuffer inputBuffer,
+                                 const VkSubresourceLayout inputPlaneLayouts[3],
+                                 const VkExtent2D& inputExtent,
+                                 const VkImageResourceView* outputImageView,
+                                 const VkVideoPictureResourceInfoKHR* outputImageResourceInfo);
+
+    // Records the RGBA2YCBCR conversion into a command buffer of the caller, which also owns its synchronization.
+    // The RGBA input image view and the output image must be in the VK_IMAGE_LAYOUT_GENERAL layout. The input
+    // extent is cropped to the output image.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 VkImageView inputImageView,
+                                 uint32_t inputImageLayer,
+                                 const VkExtent2D& inputExtent,
+                                 const VkImageResourceView* outputImageView,
+                                 const VkVideoPictureResourceInfoKHR* outputImageResourceInfo);
+
+    // Records the YCBCRSCALE* resize into a command buffer of the caller, which also owns its synchronization.
+    // Both images must be in the VK_IMAGE_LAYOUT_GENERAL layout.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 const VkImageResourceView* inputImageView,
+                                 const VkVideoPictureResourceInfoKHR* inputImageResourceInfo,
+                                 const VkExtent2D& inputExtent,
+                                 const VkImageResourceView* outputImageView,
+                                 const VkVideoPictureResourceInfoKHR* outputImageResourceInfo,
+                                 const VkExtent2D& outputExtent);
+
+    // Records the YCBCR2BUFFER conversion into a command buffer of the caller, which also owns its synchronization.
+    // The input image must be in the VK_IMAGE_LAYOUT_GENERAL layout. The plane layouts are in bytes, in the plane
+    // order, with the offsets and the pitches aligned to the sample size. The row padding is written as zeros,
+    // up to the size of the Cr plane.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 const VkImageResourceView* inputImageView,
+                                 const VkVideoPictureResourceInfoKHR* inputImageResourceInfo,
+                                 const VkExtent2D& inputExtent,
+                                 const VkBufferResource* outputBuffer,
+                                 const VkSubresourceLayout outputPlaneLayouts[3]);
+
+    virtual uint32_t GetSubmitCommandBuffers(uint32_t frameIdx, const VkCommandBuffer** ppCommandBuffers) const {
+        *ppCommandBuffers = m_commandBuffersSet.GetCommandBuffer(frameIdx);
+        return 1;
+    }
+
+private:
+    // The descriptors, the push constants and the dispatch of the filters recorded by the frame
+    VkResult RecordDispatch(VkCommandBuffer cmdBuf, uint32_t descriptorSlot,
+                            const VkImageResourceView* inputImageView,
+                            const VkVideoPictureResourceInfoKHR* inputImageResourceInfo,
+                            const VkImageResourceView* outputImageView,
+                            const VkVideoPictureResourceInfoKHR* outputImageResourceInfo)
+    {
         m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
 
-        VkDescriptorSetLayoutCreateFlags layoutMode = m_descriptorSetLayout.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode();
-
-        switch (layoutMode) {
-            case VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR:
-            case VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT:
-            {
-
-                const uint32_t maxNumComputeDescr = 8;
-                VkDescriptorImageInfo imageDescriptors[8]{};
-                std::array<VkWriteDescriptorSet, maxNumComputeDescr> writeDescriptorSets{};
-
-                // Images
-                uint32_t set = 0;
-                uint32_t descrIndex = 0;
-                uint32_t dstBinding = 0;
-                // RGBA color converted by an YCbCr sample
-                if (m_inputImageAspects & VK_IMAGE_ASPECT_COLOR_BIT) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = (m_samplerYcbcrConversion.GetSampler() != VK_NULL_HANDLE) ?
-                                                                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER :
-                                                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-
-                    imageDescriptors[descrIndex].sampler = m_samplerYcbcrConversion.GetSampler();
-                    imageDescriptors[descrIndex].imageView = inputImageView->GetImageView();
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // RGBA or Sampled YCbCr
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                uint32_t planeNum = 0;
-                // y plane - G -> R8
-                if ((m_inputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
-                        (planeNum < inputImageView->GetNumberOfPlanes())) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = inputImageView->GetPlaneImageView(planeNum++);
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // Y (0) plane
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                // CbCr plane - BR -> R8B8
-                if ((m_inputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
-                        (planeNum < inputImageView->GetNumberOfPlanes())) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = inputImageView->GetPlaneImageView(planeNum++);
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // CbCr (1) plane
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                // Cr plane - R -> R8
-                if ((m_inputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
-                        (planeNum < inputImageView->GetNumberOfPlanes())) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = inputImageView->GetPlaneImageView(planeNum++);
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // CbCr (1) plane
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                // Out RGBA or single planar YCbCr image
-                if (m_outputImageAspects & VK_IMAGE_ASPECT_COLOR_BIT) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = outputImageView->GetImageView();
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                planeNum = 0;
-                // y plane out - G -> R8
-                if ((m_outputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
-                        (planeNum < outputImageView->GetNumberOfPlanes())) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = outputImageView->GetPlaneImageView(planeNum++);
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                // CbCr plane out - BR -> R8B8
-                if ((m_outputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
-                        (planeNum < outputImageView->GetNumberOfPlanes())) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = outputImageView->GetPlaneImageView(planeNum++);
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                // Cr plane out - R -> R8
-                if ((m_outputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
-                        (planeNum < outputImageView->GetNumberOfPlanes())) {
-                    writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
-                    writeDescriptorSets[descrIndex].dstBinding = dstBinding;
-                    writeDescriptorSets[descrIndex].descriptorCount = 1;
-                    writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                    imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
-                    imageDescriptors[descrIndex].imageView = outputImageView->GetPlaneImageView(planeNum++);
-                    assert(imageDescriptors[descrIndex].imageView);
-                    imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-                    writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
-                    descrIndex++;
-                }
-                dstBinding++;
-
-                assert(descrIndex <= maxNumComputeDescr);
-                assert(descrIndex >= 2);
-
-                if (layoutMode ==  VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) {
-                    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                                        m_descriptorSetLayout.GetPipelineLayout(),
-                                                        set, descrIndex, writeDescriptorSets.data());
-                } else {
-
-                    VkDeviceOrHostAddressConstKHR imageDescriptorBufferDeviceAddress =
-                          m_descriptorSetLayout.UpdateDescriptorBuffer(frameIdx, set, descrIndex, writeDescriptorSets.data());
-
-
-                    // Descriptor buffer bindings
-                    // Set 0 = Image
-                    VkDescriptorBufferBindingInfoEXT bindingInfo{};
-                    bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
-                    bindingInfo.pNext = nullptr;
-                    bindingInfo.address = imageDescriptorBufferDeviceAddress.deviceAddress;
-                    bindingInfo.usage = VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
-                                        VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
-                    m_vkDevCtx->CmdBindDescriptorBuffersEXT(cmdBuf, 1, &bindingInfo);
-
-                    // Image (set 0)
-                    uint32_t bufferIndexImage = 0;
-                    VkDeviceSize bufferOffset = 0;
-                    m_vkDevCtx->CmdSetDescriptorBufferOffsetsEXT(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                                               m_descriptorSetLayout.GetPipelineLayout(),
-                                                               set, 1, &bufferIndexImage, &bufferOffset);
-                }
-            }
-            break;
-
-            default:
-            m_vkDevCtx->CmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                              m_descriptorSetLayout.GetPipelineLayout(),
-                                              0, 1, m_descriptorSetLayout.GetDescriptorSet(), 0, 0);
+        const uint32_t maxNumComputeDescr = 8;
+        VkDescriptorImageInfo imageDescriptors[8]{};
+        std::array<VkWriteDescriptorSet, maxNumComputeDescr> writeDescriptorSets{};
+
+        // Images
+        uint32_t descrIndex = 0;
+        uint32_t dstBinding = 0;
+        // RGBA color converted by an YCbCr sample
+        if (m_inputImageAspects & VK_IMAGE_ASPECT_COLOR_BIT) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = (m_samplerYcbcrConversion.GetSampler() != VK_NULL_HANDLE) ?
+                                                                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER :
+                                                                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+            imageDescriptors[descrIndex].sampler = m_samplerYcbcrConversion.GetSampler();
+            imageDescriptors[descrIndex].imageView = inputImageView->GetImageView();
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = (m_samplerYcbcrConversion.GetSampler() != VK_NULL_HANDLE) ?
+                                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+                                                           VK_IMAGE_LAYOUT_GENERAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // RGBA or Sampled YCbCr
+            descrIndex++;
+        }
+        dstBinding++;
+
+        uint32_t planeNum = 0;
+        // y plane - G -> R8
+        if ((m_inputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
+                (planeNum < inputImageView->GetNumberOfPlanes())) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = inputImageView->GetPlaneImageView(planeNum++);
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // Y (0) plane
+            descrIndex++;
+        }
+        dstBinding++;
+
+        // CbCr plane - BR -> R8B8
+        if ((m_inputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
+                (planeNum < inputImageView->GetNumberOfPlanes())) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = inputImageView->GetPlaneImageView(planeNum++);
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // CbCr (1) plane
+            descrIndex++;
+        }
+        dstBinding++;
+
+        // Cr plane - R -> R8
+        if ((m_inputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
+                (planeNum < inputImageView->GetNumberOfPlanes())) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = inputImageView->GetPlaneImageView(planeNum++);
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex]; // CbCr (1) plane
+            descrIndex++;
+        }
+        dstBinding++;
+
+        // Out RGBA or single planar YCbCr image
+        if (m_outputImageAspects & VK_IMAGE_ASPECT_COLOR_BIT) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = outputImageView->GetImageView();
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
+            descrIndex++;
+        }
+        dstBinding++;
+
+        planeNum = 0;
+        // y plane out - G -> R8
+        if ((m_outputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
+                (planeNum < outputImageView->GetNumberOfPlanes())) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = outputImageView->GetPlaneImageView(planeNum++);
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
+            descrIndex++;
+        }
+        dstBinding++;
+
+        // CbCr plane out - BR -> R8B8
+        if ((m_outputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
+                (planeNum < outputImageView->GetNumberOfPlanes())) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = outputImageView->GetPlaneImageView(planeNum++);
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
+            descrIndex++;
+        }
+        dstBinding++;
+
+        // Cr plane out - R -> R8
+        if ((m_outputImageAspects & (VK_IMAGE_ASPECT_PLANE_0_BIT << planeNum)) &&
+                (planeNum < outputImageView->GetNumberOfPlanes())) {
+            writeDescriptorSets[descrIndex].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[descrIndex].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[descrIndex].dstBinding = dstBinding;
+            writeDescriptorSets[descrIndex].descriptorCount = 1;
+            writeDescriptorSets[descrIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            imageDescriptors[descrIndex].sampler = VK_NULL_HANDLE;
+            imageDescriptors[descrIndex].imageView = outputImageView->GetPlaneImageView(planeNum++);
+            assert(imageDescriptors[descrIndex].imageView);
+            imageDescriptors[descrIndex].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            writeDescriptorSets[descrIndex].pImageInfo = &imageDescriptors[descrIndex];
+            descrIndex++;
+        }
+        dstBinding++;
+
+        assert(descrIndex <= maxNumComputeDescr);
+        assert(descrIndex >= 2);
+
+        VkResult result = BindDescriptors(cmdBuf, descriptorSlot, descrIndex, writeDescriptorSets.data());
+        if (result != VK_SUCCESS) {
+            return result;
         }
 
         struct PushConstants {
             uint32_t srcLayer;
             uint32_t dstLayer;
+            // YCBCRFUSED and RGBA2YCBCR only, the crop rectangle of the input and the extent it is scaled to
+            int32_t  cropX;
+            int32_t  cropY;
+            uint32_t cropWidth;
+            uint32_t cropHeight;
+            uint32_t dstWidth;
+            uint32_t dstHeight;
         };
 
+        const VkImageCreateInfo& inputImageCreateInfo = inputImageView->GetImageResource()->GetImageCreateInfo();
+        const VkImageCreateInfo& imageCreateInfo = outputImageView->GetImageResource()->GetImageCreateInfo();
+        const bool hasInputRect = (inputImageResourceInfo != nullptr) &&
+                                  (inputImageResourceInfo->codedExtent.width != 0) &&
+                                  (inputImageResourceInfo->codedExtent.height != 0);
+        const bool hasOutputRect = (outputImageResourceInfo != nullptr) &&
+                                   (outputImageResourceInfo->codedExtent.width != 0) &&
+                                   (outputImageResourceInfo->codedExtent.height != 0);
+
         PushConstants pushConstants = {
                 inputImageResourceInfo  ? inputImageResourceInfo->baseArrayLayer : 0, // Set the source layer index
-                outputImageResourceInfo ? outputImageResourceInfo->baseArrayLayer : 0 // Set the destination layer index
+                outputImageResourceInfo ? outputImageResourceInfo->baseArrayLayer : 0, // Set the destination layer index
+                hasInputRect ? inputImageResourceInfo->codedOffset.x : 0,
+                hasInputRect ? inputImageResourceInfo->codedOffset.y : 0,
+                hasInputRect ? inputImageResourceInfo->codedExtent.width : inputImageCreateInfo.extent.width,
+                hasInputRect ? inputImageResourceInfo->codedExtent.height : inputImageCreateInfo.extent.height,
+                hasOutputRect ? outputImageResourceInfo->codedExtent.width : imageCreateInfo.extent.width,
+                hasOutputRect ? outputImageResourceInfo->codedExtent.height : imageCreateInfo.extent.height
         };
 
         m_vkDevCtx->CmdPushConstants(cmdBuf,
                                      m_descriptorSetLayout.GetPipelineLayout(),
                                      VK_SHADER_STAGE_COMPUTE_BIT,
                                      0, // offset
-                                     sizeof(PushConstants),
+                                     ((m_filterType == YCBCRFUSED) || (m_filterType == RGBA2YCBCR)) ?
+                                         (uint32_t)sizeof(PushConstants) : (uint32_t)offsetof(PushConstants, cropX),
                                      &pushConstants);
 
-        const VkImageCreateInfo& imageCreateInfo = outputImageView->GetImageResource()->GetImageCreateInfo();
-        uint32_t  width  = imageCreateInfo.extent.width  + (m_workgroupSizeX - 1);
-        uint32_t  height = imageCreateInfo.extent.height + (m_workgroupSizeY - 1);
-
-        m_vkDevCtx->CmdDispatch(cmdBuf, width / m_workgroupSizeX, height / m_workgroupSizeY, 1);
-
-        return m_vkDevCtx->EndCommandBuffer(cmdBuf);
-    }
+        // Rounded up, the shaders skip the samples beyond the output image
+        const uint32_t blockWidth  = m_workgroupSizeX * m_samplesPerInvocation;
+        const uint32_t blockHeight = m_workgroupSizeY * m_samplesPerInvocation;
+        m_vkDevCtx->CmdDispatch(cmdBuf,
+                                (imageCreateInfo.extent.width  + (blockWidth - 1))  / blockWidth,
+                                (imageCreateInfo.extent.height + (blockHeight - 1)) / blockHeight,
+                                1);
 
-    virtual uint32_t GetSubmitCommandBuffers(uint32_t frameIdx, const VkCommandBuffer** ppCommandBuffers) const {
-        *ppCommandBuffers = m_commandBuffersSet.GetCommandBuffer(frameIdx);
-        return 1;
+        return VK_SUCCESS;
     }
 
-private:
     VkResult InitDescriptorSetLayout(uint32_t maxNumFrames);
+    // Pushes the descriptors, or writes them to the descriptor buffer slot, else to the descriptor set
+    VkResult BindDescriptors(VkCommandBuffer cmdBuf, uint32_t descriptorSlot,
+                             uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites);
+    // The descriptor buffer slots of the recordings into the command buffers of the callers, in turn
+    uint32_t GetNextDescriptorSlot() { return (m_nextDescriptorSlot++ % m_maxNumFrames); }
+    void InitWorkgroupSize();
     size_t InitYCBCRCOPY(std::string& computeShader);
     size_t InitYCBCRCLEAR(std::string& computeShader);
     size_t InitYCBCR2RGBA(std::string& computeShader);
+    size_t InitBUFFER2YCBCR(std::string& computeShader);
+    size_t InitYCBCRSCALE(std::string& computeShader);
+    size_t InitYCBCRRESAMPLE(std::string& computeShader);
+    size_t InitYCBCR2BUFFER(std::string& computeShader);
+    size_t InitYCBCRFUSED(std::string& computeShader);
+    size_t InitYCBCRDEINTERLACE(std::string& computeShader);
+    size_t InitRGBA2YCBCR(std::string& computeShader);
 
 private:
     const FilterType                         m_filterType;
     VkFormat                                 m_inputFormat;
     VkFormat                                 m_outputFormat;
-    uint32_t                                 m_workgroupSizeX; // usually 16
-    uint32_t                                 m_workgroupSizeY; // usually 16
+    uint32_t                                 m_workgroupSizeX; // from the subgroup size of the device
+    uint32_t                                 m_workgroupSizeY;
+    uint32_t                                 m_samplesPerInvocation; // 2 for a 2x2 quad of samples per invocation
     uint32_t                                 m_maxNumFrames;
+    uint32_t                                 m_nextDescriptorSlot;
     const YcbcrPrimariesConstants            m_ycbcrPrimariesConstants;
     VulkanSamplerYcbcrConversion             m_samplerYcbcrConversion;
+    VkSamplerYcbcrConversionCreateInfo       m_outputYcbcrConversionInfo; // of RGBA2YCBCR, without a sampler
     VulkanDescriptorSetLayout                m_descriptorSetLayout;
     VulkanComputePipeline                    m_computePipeline;
     VulkanCommandBuffersSet                  m_commandBuffersSet;
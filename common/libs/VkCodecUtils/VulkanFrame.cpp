@@ -21,6 +21,9 @@
 
 #include "VkCodecUtils/Helpers.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VkFrameLatency.h"
 #include "VkShell/Shell.h"
 #include "VkCodecUtils/VulkanVideoUtils.h"
 #include "VulkanFrame.h"
@@ -38,10 +41,12 @@ VulkanFrame<FrameDataType>::VulkanFrame(const VulkanDeviceContext* vkDevCtx,
     , m_videoRenderer(nullptr)
     , m_codecPaused(false)
     , m_gfxQueue()
+    , m_presentScheduler(nullptr)
     , m_vkFormat()
     , m_physicalDevProps()
     , m_frameData()
     , m_frameDataIndex()
+    , m_lastRenderedFrameId(-1)
 {
 }
 
@@ -56,6 +61,7 @@ int VulkanFrame<FrameDataType>::AttachShell(const Shell& sh)
 {
     const Shell::Context& ctx = sh.GetContext();
     m_gfxQueue = ctx.devCtx->GetGfxQueue();
+    m_presentScheduler = ctx.presentScheduler;
 
     m_vkDevCtx->GetPhysicalDeviceProperties(ctx.devCtx->getPhysicalDevice(), &m_physicalDevProps);
 
@@ -215,7 +221,8 @@ int VulkanFrame<FrameDataType>::AttachSwapchain(const Shell& sh)
                                                                   &ctx.format,
                                                                   m_videoRenderer->m_renderPass.getRenderPass(),
                                                                   &defaultSamplerInfo,
-                                                                  &defaultSamplerYcbcrConversionCreateInfo);
+                                                                  &defaultSamplerYcbcrConversionCreateInfo,
+                                                                  ctx.storageSwapchain);
     if (result != VK_SUCCESS) {
         assert(!"ERROR: Could't create rawContexts!");
         return -1;
@@ -281,18 +288,18 @@ bool VulkanFrame<FrameDataType>::OnFrame( int32_t renderIndex,
     const bool trainFrame = (renderIndex < 0);
     const bool gfxRendererIsEnabled = (m_videoRenderer != nullptr);
     m_frameCount++;
+    m_lastRenderedFrameId = -1;
 
     if (dumpDebug == false) {
         bool displayTimeNow = false;
         float fps = GetFrameRateFps(displayTimeNow);
         if (displayTimeNow) {
-            std::cout << "\t\tFrame " << m_frameCount << ", FPS: " << fps << std::endl;
+            VK_LOG_INFO("\t\tFrame %lld, FPS: %g\n", (long long)m_frameCount, fps);
         }
     } else {
         uint64_t timeDiffNanoSec = GetTimeDiffNanoseconds();
-        std::cout << "\t\t Time nanoseconds: " << timeDiffNanoSec <<
-                     " milliseconds: " << timeDiffNanoSec / 1000 <<
-                     " rate: " << 1000000000.0 / timeDiffNanoSec << std::endl;
+        VK_LOG_DEBUG("\t\t Time nanoseconds: %llu milliseconds: %llu rate: %g\n", (unsigned long long)timeDiffNanoSec,
+                     (unsigned long long)(timeDiffNanoSec / 1000), 1000000000.0 / timeDiffNanoSec);
     }
 
     FrameDataType& data = m_frameData[m_frameDataIndex];
@@ -328,6 +335,7 @@ bool VulkanFrame<FrameDataType>::OnFrame( int32_t renderIndex,
                                  diffMilliseconds.count() << "." << diffMicroseconds.count() << " mSec" << std::endl;
                 }
             } else if (pLastDecodedFrame->frameCompleteFence != VkFence()) {
+                VK_TRACE_ZONE("WaitForFences");
                 VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &pLastDecodedFrame->frameCompleteFence, true, 100 * 1000 * 1000 /* 100 mSec */);
                 assert(result == VK_SUCCESS);
                 if (result != VK_SUCCESS) {
@@ -349,12 +357,19 @@ bool VulkanFrame<FrameDataType>::OnFrame( int32_t renderIndex,
         int32_t numVideoFrames = 0;
 
         numVideoFrames = m_videoQueue->GetNextFrame(pLastDecodedFrame, &endOfStream);
+        // The frames too late for their display time are dropped, instead of delaying all the ones after them
+        while ((m_presentScheduler != nullptr) && (numVideoFrames > 0) &&
+                !m_presentScheduler->ScheduleFrame(pLastDecodedFrame->timestamp)) {
+            m_videoQueue->ReleaseFrame(pLastDecodedFrame);
+            pLastDecodedFrame->Reset();
+            numVideoFrames = m_videoQueue->GetNextFrame(pLastDecodedFrame, &endOfStream);
+        }
         if (endOfStream && (numVideoFrames < 0)) {
             continueLoop = false;
             bool displayTimeNow = true;
             float fps = GetFrameRateFps(displayTimeNow);
             if (displayTimeNow) {
-                std::cout << "\t\tFrame " << m_frameCount << ", FPS: " << fps << std::endl;
+                VK_LOG_INFO("\t\tFrame %lld, FPS: %g\n", (long long)m_frameCount, fps);
             }
         }
     }
@@ -480,16 +495,26 @@ VkResult VulkanFrame<FrameDataType>::DrawFrame( int32_t            renderIndex,
         pPerDrawContext->descriptorSetLayoutBinding.WriteDescriptorSet(1, &writeDescriptorSet);
     }
 
-    pPerDrawContext->RecordCommandBuffer(*pPerDrawContext->commandBuffer.GetCommandBuffer(),
-                                         m_videoRenderer->m_renderPass.getRenderPass(),
-                                         pRtImage,
-                                         displayWidth, displayHeight,
-                                         pPerDrawContext->frameBuffer.GetFbImage(),
-                                         pPerDrawContext->frameBuffer.GetFrameBuffer(), &m_scissor,
-                                         pPerDrawContext->gfxPipeline.getPipeline(),
-                                         pPerDrawContext->descriptorSetLayoutBinding,
-                                         pPerDrawContext->samplerYcbcrConversion,
-                                         m_videoRenderer->m_vertexBuffer);
+    if (pPerDrawContext->HasComputePresent()) {
+        // The storage swapchain image is written by the compute shader, without the graphics blit
+        pPerDrawContext->RecordComputeCommandBuffer(*pPerDrawContext->commandBuffer.GetCommandBuffer(),
+                                                    pRtImage,
+                                                    displayWidth, displayHeight,
+                                                    pPerDrawContext->frameBuffer.GetFbImage(),
+                                                    pPerDrawContext->frameBuffer.mImageView,
+                                                    m_scissor.extent);
+    } else {
+        pPerDrawContext->RecordCommandBuffer(*pPerDrawContext->commandBuffer.GetCommandBuffer(),
+                                             m_videoRenderer->m_renderPass.getRenderPass(),
+                                             pRtImage,
+                                             displayWidth, displayHeight,
+                                             pPerDrawContext->frameBuffer.GetFbImage(),
+                                             pPerDrawContext->frameBuffer.GetFrameBuffer(), &m_scissor,
+                                             pPerDrawContext->gfxPipeline.getPipeline(),
+                                             pPerDrawContext->descriptorSetLayoutBinding,
+                                             pPerDrawContext->samplerYcbcrConversion,
+                                             m_videoRenderer->m_vertexBuffer);
+    }
 
     if (dumpDebug) {
         std::cout << "Drawing Frame " << m_frameCount << " FB: " << renderIndex << std::endl;
@@ -506,7 +531,17 @@ VkResult VulkanFrame<FrameDataType>::DrawFrame( int32_t            renderIndex,
     VkResult result = VK_SUCCESS;
     if (!m_videoRenderer->m_useTestImage && inFrame) {
         if (inFrame->frameCompleteSemaphore == VkSemaphore()) {
-            if (inFrame->frameCompleteFence == VkFence()) {
+            if (inFrame->frameCompleteTimelineSemaphore != VkSemaphore()) {
+                VK_TRACE_ZONE("WaitSemaphores");
+                const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                                       &inFrame->frameCompleteTimelineSemaphore,
+                                                       &inFrame->frameCompleteTimelineValue };
+                result = m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, 100 * 1000 * 1000 /* 100 mSec */);
+                assert(result == VK_SUCCESS);
+                if (result != VK_SUCCESS) {
+                    fprintf(stderr, "\nERROR: WaitSemaphores() result: 0x%x\n", result);
+                }
+            } else if (inFrame->frameCompleteFence == VkFence()) {
                 VkQueue videoDecodeQueue = m_vkDevCtx->GetVideoDecodeQueue();
                 if (videoDecodeQueue != VkQueue()) {
                     result = m_vkDevCtx->QueueWaitIdle(videoDecodeQueue);
@@ -516,6 +551,7 @@ VkResult VulkanFrame<FrameDataType>::DrawFrame( int32_t            renderIndex,
                     }
                 }
             } else {
+                VK_TRACE_ZONE("WaitForFences");
                 result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &inFrame->frameCompleteFence, true, 100 * 1000 * 1000 /* 100 mSec */);
                 assert(result == VK_SUCCESS);
                 if (result != VK_SUCCESS) {
@@ -642,6 +678,10 @@ VkResult VulkanFrame<FrameDataType>::DrawFrame( int32_t            renderIndex,
         fprintf(stderr, "\nERROR: MultiThreadedQueueSubmit() result: 0x%x\n", result);
         return result;
     }
+    if ((inFrame != nullptr) && (inFrame->pictureIndex != -1)) {
+        VkFrameLatency::Record(VK_FRAME_LATENCY_OUTPUT, inFrame->decodeOrder);
+        m_lastRenderedFrameId = (int64_t)inFrame->decodeOrder;
+    }
 
     if (false && (frameConsumerDoneFence != VkFence())) { // For fence/sync debugging
         const uint64_t fenceTimeout = 100 * 1000 * 1000 /* 100 mSec */;
@@ -23,6 +23,7 @@
 
 #include "VkCodecUtils/FrameProcessor.h"
 #include "VkCodecUtils/VkVideoQueue.h"
+#include "VkCodecUtils/VulkanPresentScheduler.h"
 
 template<class FrameDataType>
 class VulkanFrame : public FrameProcessor {
@@ -63,6 +64,7 @@ public:
                           uint32_t           signalSemaphoreCount = 0,
                           const VkSemaphore* pSignalSemaphores = nullptr);
 
+    virtual int64_t GetLastRenderedFrameId() const { return m_lastRenderedFrameId; }
 
     VkResult DrawFrame( int32_t           renderIndex,
                        uint32_t           waitSemaphoreCount,
@@ -91,6 +93,7 @@ public:
     vulkanVideoUtils::VkVideoAppCtx*      m_videoRenderer;
     bool                                  m_codecPaused;
     VkQueue                               m_gfxQueue;
+    VulkanPresentScheduler*               m_presentScheduler; // of the shell, with the presentation pacing
     VkFormat                              m_vkFormat;
 
     VkPhysicalDeviceProperties            m_physicalDevProps;
@@ -98,6 +101,7 @@ public:
 
     std::vector<FrameDataType>            m_frameData;
     int                                   m_frameDataIndex;
+    int64_t                               m_lastRenderedFrameId;
 
     VkExtent2D                            m_extent;
     VkViewport                            m_viewport;
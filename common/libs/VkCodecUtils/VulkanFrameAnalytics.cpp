@@ -0,0 +1,720 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <sstream>
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VulkanFrameAnalytics.h"
+
+// Each invocation analyzes one 8x8 block of the luma plane and the chroma samples co-located with it
+static const uint32_t blockSize = 8;
+static const uint32_t workgroupSize = 8;
+// The bins are the top bits of the samples on the 8-bit scale
+static const uint32_t histogramBinShift = 3;
+
+// The words of the results of a frame: the histograms of the planes, then per plane the sum and the sum of squares
+// of the samples as 64-bit low and high words, the sum of the luma block differences, and the clipped luma samples
+static const uint32_t histogramOffset = 0;
+static const uint32_t sumsOffset = histogramOffset + VulkanFrameAnalytics::NUM_PLANES * VulkanFrameAnalytics::NUM_HISTOGRAM_BINS;
+static const uint32_t differenceOffset = sumsOffset + VulkanFrameAnalytics::NUM_PLANES * 4;
+static const uint32_t clippedLowOffset = differenceOffset + 2;
+static const uint32_t clippedHighOffset = clippedLowOffset + 1;
+static const uint32_t numResultWords = clippedHighOffset + 1;
+
+// The video range of the luma samples on the 8-bit scale
+static const uint32_t blackLevel = 16;
+static const uint32_t whiteLevel = 235;
+
+// The flags of the frames
+static const double blackMaxMean = 20.0;
+static const double blackMaxVariance = 9.0;
+static const double frozenMaxDifference = 0.02;
+static const double clippedMinFraction = 0.2;
+
+static const uint64_t slotWaitTimeout = 5ULL * 1000 * 1000 * 1000; // 5 Sec
+
+VkResult VulkanFrameAnalytics::Create(const VulkanDeviceContext* vkDevCtx,
+                                      VkFormat imageFormat,
+                                      const VkExtent2D& extent,
+                                      uint32_t numSlots,
+                                      FILE* csvFile,
+                                      VkSharedBaseObj<VulkanFrameAnalytics>& frameAnalytics)
+{
+    // The descriptors are pushed with the command buffer of each frame
+    if (!vkDevCtx->FindRequiredDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) ||
+            (vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(imageFormat);
+    if ((mpInfo == nullptr) || (mpInfo->planesLayout.numberOfExtraPlanes != 1) ||
+            (extent.width == 0) || (extent.height == 0)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkSharedBaseObj<VulkanFrameAnalytics> analytics(new VulkanFrameAnalytics(vkDevCtx, imageFormat, extent,
+                                                                             mpInfo->planesLayout.secondaryPlaneSubsampledX,
+                                                                             mpInfo->planesLayout.secondaryPlaneSubsampledY,
+                                                                             csvFile));
+    if (!analytics) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = analytics->Init(numSlots);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    frameAnalytics = analytics;
+    return VK_SUCCESS;
+}
+
+VulkanFrameAnalytics::VulkanFrameAnalytics(const VulkanDeviceContext* vkDevCtx, VkFormat imageFormat,
+                                           const VkExtent2D& extent, uint32_t chromaShiftX, uint32_t chromaShiftY,
+                                           FILE* csvFile)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_imageFormat(imageFormat)
+    , m_extent(extent)
+    , m_chromaShiftX(chromaShiftX)
+    , m_chromaShiftY(chromaShiftY)
+    , m_numWorkgroups{ (extent.width  + (blockSize * workgroupSize) - 1) / (blockSize * workgroupSize),
+                       (extent.height + (blockSize * workgroupSize) - 1) / (blockSize * workgroupSize) }
+    , m_csvFile(csvFile)
+    , m_vulkanShaderCompiler()
+    , m_descriptorSetLayout()
+    , m_computePipeline()
+    , m_commandBuffersSet()
+    , m_completeTimelineSemaphore()
+    , m_lastSubmittedValue(0)
+    , m_nextSlot(0)
+    , m_slotValues()
+    , m_slotFrameIds()
+    , m_slotPending()
+    , m_results()
+    , m_blockSums()
+    , m_hasPreviousFrame(false)
+    , m_numFrames(0)
+    , m_numBlackFrames(0)
+    , m_numFrozenFrames(0)
+    , m_numClippedFrames(0)
+    , m_blackRunStart(-1)
+    , m_frozenRunStart(-1)
+    , m_clippedRunStart(-1)
+    , m_lastFrameId(0)
+{
+}
+
+VulkanFrameAnalytics::~VulkanFrameAnalytics()
+{
+    if (m_completeTimelineSemaphore != VK_NULL_HANDLE) {
+        // The command buffers and the buffers of the slots are released after their last submission
+        for (uint32_t slot = 0; slot < m_slotValues.size(); slot++) {
+            WaitForSlot(slot);
+        }
+        m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_completeTimelineSemaphore, nullptr);
+        m_completeTimelineSemaphore = VK_NULL_HANDLE;
+    }
+}
+
+VkResult VulkanFrameAnalytics::Init(uint32_t numSlots)
+{
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        //                        binding,  descriptorType,          descriptorCount, stageFlags, pImmutableSamplers;
+        // Binding 0: Decoded image (read-only) Y plane
+        VkDescriptorSetLayoutBinding{ 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 1: Decoded image (read-only) CbCr plane
+        VkDescriptorSetLayoutBinding{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 2: Results of the frame (atomic adds)
+        VkDescriptorSetLayoutBinding{ 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 3: Luma sums of the blocks of the previous frame (read-write)
+        VkDescriptorSetLayoutBinding{ 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // The image layer, the extent, the chroma shifts and whether there is a previous frame
+    pushConstantRange.size = 6 * sizeof(uint32_t);
+
+    VkResult result = m_descriptorSetLayout.CreateDescriptorSet(m_vkDevCtx,
+                                                                setLayoutBindings,
+                                                                VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                                1, &pushConstantRange,
+                                                                nullptr,
+                                                                1,
+                                                                false);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::string computeShader;
+    const size_t computeShaderSize = InitShader(computeShader);
+    result = m_computePipeline.CreatePipeline(m_vkDevCtx, m_vulkanShaderCompiler,
+                                              computeShader.c_str(), computeShaderSize,
+                                              "main",
+                                              workgroupSize, workgroupSize,
+                                              &m_descriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    result = m_commandBuffersSet.CreateCommandBufferPool(m_vkDevCtx, m_vkDevCtx->GetComputeQueueFamilyIdx(), numSlots);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkSemaphoreTypeCreateInfo timelineCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineCreateInfo.initialValue = 0; // the first submission signals 1
+    const VkSemaphoreCreateInfo semaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &timelineCreateInfo, 0 };
+    result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &semaphoreCreateInfo, nullptr, &m_completeTimelineSemaphore);
+    if (result != VK_SUCCESS) {
+        m_completeTimelineSemaphore = VK_NULL_HANDLE;
+        return result;
+    }
+    m_slotValues.assign(numSlots, 0);
+    m_slotFrameIds.assign(numSlots, 0);
+    m_slotPending.assign(numSlots, false);
+
+    m_results.resize(numSlots);
+    VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_FILTER);
+    for (VkSharedBaseObj<VkBufferResource>& results : m_results) {
+        result = VkBufferResource::Create(m_vkDevCtx,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          numResultWords * sizeof(uint32_t),
+                                          results);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    // One sum per invocation of the dispatch, the blocks on the edges included
+    const VkDeviceSize blockSumsSize = (VkDeviceSize)m_numWorkgroups.width * m_numWorkgroups.height *
+                                       workgroupSize * workgroupSize * sizeof(uint32_t);
+    return VkBufferResource::Create(m_vkDevCtx,
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    blockSumsSize,
+                                    m_blockSums);
+}
+
+size_t VulkanFrameAnalytics::InitShader(std::string& computeShader) const
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_imageFormat);
+    const bool isImage16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != 0);
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint imageLayer;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
+                        "    uint chromaShiftX;\n"
+                        "    uint chromaShiftY;\n"
+                        "    uint hasPreviousFrame;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << workgroupSize << ", local_size_y = " << workgroupSize << ") in;\n"
+                        "layout (set = 0, binding = 0, " << (isImage16BitSample ? "r16" : "r8") <<
+                                ") uniform readonly image2DArray inImageY;\n"
+                        "layout (set = 0, binding = 1, " << (isImage16BitSample ? "rg16" : "rg8") <<
+                                ") uniform readonly image2DArray inImageCbCr;\n"
+                        "layout (set = 0, binding = 2) buffer Results {\n"
+                        "    uint results[];\n"
+                        "};\n"
+                        "layout (set = 0, binding = 3) buffer BlockSums {\n"
+                        "    uint blockSums[];\n"
+                        "};\n"
+                        "\n"
+                        "const int blockSize = " << blockSize << ";\n"
+                        "const uint numInvocations = " << (workgroupSize * workgroupSize) << ";\n"
+                        "const uint numBins = " << NUM_HISTOGRAM_BINS << ";\n"
+                        "const uint binShift = " << histogramBinShift << ";\n"
+                        "const uint histogramOffset = " << histogramOffset << ";\n"
+                        "const uint sumsOffset = " << sumsOffset << ";\n"
+                        "const uint differenceOffset = " << differenceOffset << ";\n"
+                        "const uint clippedLowOffset = " << clippedLowOffset << ";\n"
+                        "const uint clippedHighOffset = " << clippedHighOffset << ";\n"
+                        "const uint blackLevel = " << blackLevel << ";\n"
+                        "const uint whiteLevel = " << whiteLevel << ";\n"
+                        "\n"
+                        "// The sums of the workgroup fit in 32 bits, the ones of the frame don't\n"
+                        "shared uint sharedHistogram[3 * numBins];\n"
+                        "shared uint sharedSums[3];\n"
+                        "shared uint sharedSumSquares[3];\n"
+                        "shared uint sharedDifference;\n"
+                        "shared uint sharedClippedLow;\n"
+                        "shared uint sharedClippedHigh;\n"
+                        "\n"
+                        "// Of the normalized sample, for the 8-bit and the 10-bit samples alike\n"
+                        "uint toSample8(float sampleValue)\n"
+                        "{\n"
+                        "    return min(uint(sampleValue * 255.0 + 0.5), 255u);\n"
+                        "}\n"
+                        "\n"
+                        "// Adds to the 64-bit low and high words, the add wrapping the low word carries\n"
+                        "void addWide(uint offset, uint value)\n"
+                        "{\n"
+                        "    uint previous = atomicAdd(results[offset], value);\n"
+                        "    if (previous + value < previous) {\n"
+                        "        atomicAdd(results[offset + 1], 1u);\n"
+                        "    }\n"
+                        "}\n"
+                        "\n"
+                        "void main()\n"
+                        "{\n"
+                        "    for (uint i = gl_LocalInvocationIndex; i < 3 * numBins; i += numInvocations) {\n"
+                        "        sharedHistogram[i] = 0u;\n"
+                        "    }\n"
+                        "    if (gl_LocalInvocationIndex < 3) {\n"
+                        "        sharedSums[gl_LocalInvocationIndex] = 0u;\n"
+                        "        sharedSumSquares[gl_LocalInvocationIndex] = 0u;\n"
+                        "    }\n"
+                        "    if (gl_LocalInvocationIndex == 0) {\n"
+                        "        sharedDifference = 0u;\n"
+                        "        sharedClippedLow = 0u;\n"
+                        "        sharedClippedHigh = 0u;\n"
+                        "    }\n"
+                        "    barrier();\n"
+                        "\n"
+                        "    // The blocks on the right and bottom edges are clipped to the image\n"
+                        "    ivec2 extent = ivec2(pushConstants.width, pushConstants.height);\n"
+                        "    ivec2 blockPos = ivec2(gl_GlobalInvocationID.xy) * blockSize;\n"
+                        "    if ((blockPos.x < extent.x) && (blockPos.y < extent.y)) {\n"
+                        "        ivec2 blockEnd = min(blockPos + blockSize, extent);\n"
+                        "        uint sum = 0u;\n"
+                        "        uint sumSquares = 0u;\n"
+                        "        uint clippedLow = 0u;\n"
+                        "        uint clippedHigh = 0u;\n"
+                        "        for (int y = blockPos.y; y < blockEnd.y; y++) {\n"
+                        "            for (int x = blockPos.x; x < blockEnd.x; x++) {\n"
+                        "                uint value = toSample8(imageLoad(inImageY, ivec3(x, y, pushConstants.imageLayer)).r);\n"
+                        "                sum += value;\n"
+                        "                sumSquares += value * value;\n"
+                        "                clippedLow += (value <= blackLevel) ? 1u : 0u;\n"
+                        "                clippedHigh += (value >= whiteLevel) ? 1u : 0u;\n"
+                        "                atomicAdd(sharedHistogram[value >> binShift], 1u);\n"
+                        "            }\n"
+                        "        }\n"
+                        "        atomicAdd(sharedSums[0], sum);\n"
+                        "        atomicAdd(sharedSumSquares[0], sumSquares);\n"
+                        "        atomicAdd(sharedClippedLow, clippedLow);\n"
+                        "        atomicAdd(sharedClippedHigh, clippedHigh);\n"
+                        "\n"
+                        "        // The sum of the block in the previous frame is replaced by the one of this frame\n"
+                        "        uint blockIndex = gl_GlobalInvocationID.y * (gl_NumWorkGroups.x * gl_WorkGroupSize.x) +\n"
+                        "                          gl_GlobalInvocationID.x;\n"
+                        "        if (pushConstants.hasPreviousFrame != 0u) {\n"
+                        "            atomicAdd(sharedDifference, uint(abs(int(sum) - int(blockSums[blockIndex]))));\n"
+                        "        }\n"
+                        "        blockSums[blockIndex] = sum;\n"
+                        "\n"
+                        "        ivec2 chromaShift = ivec2(pushConstants.chromaShiftX, pushConstants.chromaShiftY);\n"
+                        "        ivec2 chromaExtent = (extent + (ivec2(1) << chromaShift) - 1) >> chromaShift;\n"
+                        "        ivec2 chromaPos = blockPos >> chromaShift;\n"
+                        "        ivec2 chromaEnd = min((blockPos + blockSize) >> chromaShift, chromaExtent);\n"
+                        "        uvec2 chromaSum = uvec2(0);\n"
+                        "        uvec2 chromaSumSquares = uvec2(0);\n"
+                        "        for (int y = chromaPos.y; y < chromaEnd.y; y++) {\n"
+                        "            for (int x = chromaPos.x; x < chromaEnd.x; x++) {\n"
+                        "                vec2 cbcr = imageLoad(inImageCbCr, ivec3(x, y, pushConstants.imageLayer)).rg;\n"
+                        "                uvec2 value = uvec2(toSample8(cbcr.x), toSample8(cbcr.y));\n"
+                        "                chromaSum += value;\n"
+                        "                chromaSumSquares += value * value;\n"
+                        "                atomicAdd(sharedHistogram[numBins + (value.x >> binShift)], 1u);\n"
+                        "                atomicAdd(sharedHistogram[2 * numBins + (value.y >> binShift)], 1u);\n"
+                        "            }\n"
+                        "        }\n"
+                        "        atomicAdd(sharedSums[1], chromaSum.x);\n"
+                        "        atomicAdd(sharedSums[2], chromaSum.y);\n"
+                        "        atomicAdd(sharedSumSquares[1], chromaSumSquares.x);\n"
+                        "        atomicAdd(sharedSumSquares[2], chromaSumSquares.y);\n"
+                        "    }\n"
+                        "    barrier();\n"
+                        "\n"
+                        "    for (uint i = gl_LocalInvocationIndex; i < 3 * numBins; i += numInvocations) {\n"
+                        "        if (sharedHistogram[i] != 0u) {\n"
+                        "            atomicAdd(results[histogramOffset + i], sharedHistogram[i]);\n"
+                        "        }\n"
+                        "    }\n"
+                        "    if (gl_LocalInvocationIndex < 3) {\n"
+                        "        addWide(sumsOffset + gl_LocalInvocationIndex * 4 + 0, sharedSums[gl_LocalInvocationIndex]);\n"
+                        "        addWide(sumsOffset + gl_LocalInvocationIndex * 4 + 2, sharedSumSquares[gl_LocalInvocationIndex]);\n"
+                        "    } else if (gl_LocalInvocationIndex == 3) {\n"
+                        "        addWide(differenceOffset, sharedDifference);\n"
+                        "    } else if (gl_LocalInvocationIndex == 4) {\n"
+                        "        atomicAdd(results[clippedLowOffset], sharedClippedLow);\n"
+                        "        atomicAdd(results[clippedHighOffset], sharedClippedHigh);\n"
+                        "    }\n"
+                        "}\n";
+
+    computeShader = shaderStr.str();
+    return computeShader.size();
+}
+
+VkResult VulkanFrameAnalytics::WaitForSlot(uint32_t slot) const
+{
+    assert(slot < m_slotValues.size());
+    const uint64_t value = m_slotValues[slot];
+    if (value == 0) {
+        return VK_SUCCESS;
+    }
+    const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                           &m_completeTimelineSemaphore, &value };
+    return m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, slotWaitTimeout);
+}
+
+VkResult VulkanFrameAnalytics::SubmitFrame(uint64_t frameId, VulkanDecodedFrame& frame)
+{
+    const VkImageResourceView* imageView = frame.imageView;
+    if ((imageView == nullptr) ||
+            ((imageView->GetImageResource()->GetImageCreateInfo().usage & VK_IMAGE_USAGE_STORAGE_BIT) == 0)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    // The analytics of the previous submission of the slot are read before its command buffer is reused
+    const uint32_t slot = m_nextSlot;
+    if (m_slotPending[slot]) {
+        VkResult result = ReadSlot(slot);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    uint64_t waitValue = 0;
+    if (frame.frameCompleteSemaphore != VK_NULL_HANDLE) {
+        waitSemaphore = frame.frameCompleteSemaphore;
+    } else if (frame.frameCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+        waitSemaphore = frame.frameCompleteTimelineSemaphore;
+        waitValue = frame.frameCompleteTimelineValue;
+    } else if (frame.frameCompleteFence != VK_NULL_HANDLE) {
+        VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &frame.frameCompleteFence, true, slotWaitTimeout);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    VkCommandBuffer cmdBuf = *m_commandBuffersSet.GetCommandBuffer(slot);
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult result = m_vkDevCtx->BeginCommandBuffer(cmdBuf, &beginInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    const VkBufferResource* results = m_results[slot];
+    m_vkDevCtx->CmdFillBuffer(cmdBuf, results->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+    // The results are cleared, and the block sums written by the analysis of the previous frame
+    VkMemoryBarrier2KHR memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR };
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+
+    // The decoder leaves the output in the DPB layout when the output and the DPB coincide.
+    const VkImageLayout decodedImageLayout =
+            ((imageView->GetImageResource()->GetImageCreateInfo().usage & VK_IMAGE_USAGE_VIDEO_DECODE_DPB_BIT_KHR) != 0) ?
+                    VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR : VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR;
+    VkImageMemoryBarrier2KHR imageBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR };
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE_KHR; // the decode is waited on by the submission
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+    imageBarrier.oldLayout = decodedImageLayout;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = imageView->GetImageResource()->GetImage();
+    imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, frame.imageLayerIndex, 1 };
+
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 4;
+    VkDescriptorImageInfo imageDescriptors[2]{};
+    VkDescriptorBufferInfo bufferDescriptors[2]{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    for (uint32_t descriptorNum = 0; descriptorNum < 2; descriptorNum++) {
+        imageDescriptors[descriptorNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[descriptorNum].imageView = imageView->GetPlaneImageView(descriptorNum);
+        assert(imageDescriptors[descriptorNum].imageView);
+        imageDescriptors[descriptorNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        writeDescriptorSets[descriptorNum].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[descriptorNum].dstBinding = descriptorNum;
+        writeDescriptorSets[descriptorNum].descriptorCount = 1;
+        writeDescriptorSets[descriptorNum].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSets[descriptorNum].pImageInfo = &imageDescriptors[descriptorNum];
+    }
+
+    const VkBufferResource* buffers[2] = { results, m_blockSums };
+    for (uint32_t bufferNum = 0; bufferNum < 2; bufferNum++) {
+        const uint32_t descriptorNum = 2 + bufferNum;
+        bufferDescriptors[bufferNum].buffer = buffers[bufferNum]->GetBuffer();
+        bufferDescriptors[bufferNum].offset = 0;
+        bufferDescriptors[bufferNum].range = VK_WHOLE_SIZE;
+
+        writeDescriptorSets[descriptorNum].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[descriptorNum].dstBinding = descriptorNum;
+        writeDescriptorSets[descriptorNum].descriptorCount = 1;
+        writeDescriptorSets[descriptorNum].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[descriptorNum].pBufferInfo = &bufferDescriptors[bufferNum];
+    }
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t imageLayer;
+        uint32_t width;
+        uint32_t height;
+        uint32_t chromaShiftX;
+        uint32_t chromaShiftY;
+        uint32_t hasPreviousFrame;
+    };
+
+    const PushConstants pushConstants = {
+            frame.imageLayerIndex,
+            m_extent.width,
+            m_extent.height,
+            m_chromaShiftX,
+            m_chromaShiftY,
+            m_hasPreviousFrame ? 1U : 0U
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    m_vkDevCtx->CmdDispatch(cmdBuf, m_numWorkgroups.width, m_numWorkgroups.height, 1);
+
+    // The results are read by the host after the timeline value of the submission, the image goes back to its layout
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.newLayout = decodedImageLayout;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    result = m_vkDevCtx->EndCommandBuffer(cmdBuf);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    const uint64_t signalValue = m_lastSubmittedValue + 1;
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineSemaphoreInfo.signalSemaphoreValueCount = 1;
+    timelineSemaphoreInfo.waitSemaphoreValueCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    timelineSemaphoreInfo.pWaitSemaphoreValues = (waitSemaphore != VK_NULL_HANDLE) ? &waitValue : nullptr;
+    timelineSemaphoreInfo.pSignalSemaphoreValues = &signalValue;
+
+    const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineSemaphoreInfo };
+    submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    submitInfo.pWaitSemaphores = (waitSemaphore != VK_NULL_HANDLE) ? &waitSemaphore : nullptr;
+    submitInfo.pWaitDstStageMask = &waitStageMask;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuf;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_completeTimelineSemaphore;
+    result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::COMPUTE, 0, 1, &submitInfo, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The binary semaphore of the decode is consumed by the wait, the consumers wait for the analysis instead
+    frame.frameCompleteSemaphore = VK_NULL_HANDLE;
+    frame.frameCompleteTimelineSemaphore = m_completeTimelineSemaphore;
+    frame.frameCompleteTimelineValue = signalValue;
+
+    m_lastSubmittedValue = signalValue;
+    m_slotValues[slot] = signalValue;
+    m_slotFrameIds[slot] = frameId;
+    m_slotPending[slot] = true;
+    m_nextSlot = (slot + 1) % (uint32_t)m_slotValues.size();
+    m_hasPreviousFrame = true;
+    return VK_SUCCESS;
+}
+
+VkResult VulkanFrameAnalytics::ReadSlot(uint32_t slot)
+{
+    assert(slot < m_results.size());
+    m_slotPending[slot] = false;
+
+    VkResult result = WaitForSlot(slot);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkDeviceSize maxSize = 0;
+    const uint32_t* pResults = (const uint32_t*)m_results[slot]->GetReadOnlyDataPtr(0, maxSize);
+    assert((pResults != nullptr) && (maxSize >= numResultWords * sizeof(uint32_t)));
+
+    FrameAnalytics analytics{};
+    analytics.frameId = m_slotFrameIds[slot];
+    const double numLumaSamples = (double)m_extent.width * m_extent.height;
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        const uint32_t shiftX = (plane > 0) ? m_chromaShiftX : 0;
+        const uint32_t shiftY = (plane > 0) ? m_chromaShiftY : 0;
+        const uint32_t planeWidth  = (m_extent.width  + (1 << shiftX) - 1) >> shiftX;
+        const uint32_t planeHeight = (m_extent.height + (1 << shiftY) - 1) >> shiftY;
+        const double numSamples = (double)planeWidth * planeHeight;
+
+        const uint32_t* pSums = &pResults[sumsOffset + plane * 4];
+        const uint64_t sum = ((uint64_t)pSums[1] << 32) | pSums[0];
+        const uint64_t sumSquares = ((uint64_t)pSums[3] << 32) | pSums[2];
+        analytics.mean[plane] = sum / numSamples;
+        analytics.variance[plane] = std::max(sumSquares / numSamples - analytics.mean[plane] * analytics.mean[plane], 0.0);
+        for (uint32_t bin = 0; bin < NUM_HISTOGRAM_BINS; bin++) {
+            analytics.histogram[plane][bin] =
+                    (float)(pResults[histogramOffset + plane * NUM_HISTOGRAM_BINS + bin] / numSamples);
+        }
+    }
+
+    // The sum of the absolute differences of the block sums is the one of the block means, weighted by their size
+    const uint64_t difference = ((uint64_t)pResults[differenceOffset + 1] << 32) | pResults[differenceOffset];
+    const bool hasPreviousFrame = (m_numFrames > 0);
+    analytics.frameDifference = hasPreviousFrame ? (difference / numLumaSamples) : -1.0;
+    analytics.clippedLow = pResults[clippedLowOffset] / numLumaSamples;
+    analytics.clippedHigh = pResults[clippedHighOffset] / numLumaSamples;
+
+    analytics.isBlack = (analytics.mean[0] <= blackMaxMean) && (analytics.variance[0] <= blackMaxVariance);
+    analytics.isFrozen = hasPreviousFrame && (analytics.frameDifference <= frozenMaxDifference);
+    analytics.isClipped = !analytics.isBlack && ((analytics.clippedLow + analytics.clippedHigh) >= clippedMinFraction);
+
+    ReportFrame(analytics);
+    return VK_SUCCESS;
+}
+
+void VulkanFrameAnalytics::ReportFrame(const FrameAnalytics& analytics)
+{
+    m_numFrames++;
+    m_lastFrameId = analytics.frameId;
+
+    struct Run {
+        bool        flagged;
+        int64_t&    runStart;
+        uint64_t&   numFrames;
+        const char* name;
+    };
+    Run runs[] = {
+        { analytics.isBlack,   m_blackRunStart,   m_numBlackFrames,   "black"  },
+        { analytics.isFrozen,  m_frozenRunStart,  m_numFrozenFrames,  "frozen" },
+        { analytics.isClipped, m_clippedRunStart, m_numClippedFrames, "clipped" },
+    };
+    for (Run& run : runs) {
+        if (run.flagged) {
+            run.numFrames++;
+            if (run.runStart < 0) {
+                run.runStart = (int64_t)analytics.frameId;
+                VK_LOG_WARNING("Frame analytics: %s frames from frame %llu\n", run.name,
+                               (unsigned long long)analytics.frameId);
+            }
+        } else if (run.runStart >= 0) {
+            VK_LOG_WARNING("Frame analytics: %s frames end at frame %llu, %llu frames\n", run.name,
+                           (unsigned long long)analytics.frameId,
+                           (unsigned long long)(analytics.frameId - (uint64_t)run.runStart));
+            run.runStart = -1;
+        }
+    }
+
+    if (m_csvFile != nullptr) {
+        fprintf(m_csvFile, "%llu", (unsigned long long)analytics.frameId);
+        for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+            fprintf(m_csvFile, ",%.3f,%.3f", analytics.mean[plane], analytics.variance[plane]);
+        }
+        fprintf(m_csvFile, ",%.4f,%.6f,%.6f,%d,%d,%d", analytics.frameDifference,
+                analytics.clippedLow, analytics.clippedHigh,
+                analytics.isBlack ? 1 : 0, analytics.isFrozen ? 1 : 0, analytics.isClipped ? 1 : 0);
+        for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+            for (uint32_t bin = 0; bin < NUM_HISTOGRAM_BINS; bin++) {
+                fprintf(m_csvFile, ",%.6f", analytics.histogram[plane][bin]);
+            }
+        }
+        fprintf(m_csvFile, "\n");
+    }
+}
+
+void VulkanFrameAnalytics::WriteCsvHeader(FILE* csvFile)
+{
+    static const char* planeNames[NUM_PLANES] = { "Y", "Cb", "Cr" };
+    fprintf(csvFile, "frame");
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        fprintf(csvFile, ",mean%s,variance%s", planeNames[plane], planeNames[plane]);
+    }
+    fprintf(csvFile, ",difference,clippedLow,clippedHigh,black,frozen,clipped");
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        for (uint32_t bin = 0; bin < NUM_HISTOGRAM_BINS; bin++) {
+            fprintf(csvFile, ",histogram%s%u", planeNames[plane], bin);
+        }
+    }
+    fprintf(csvFile, "\n");
+}
+
+void VulkanFrameAnalytics::Flush()
+{
+    // The slots are read in the order of their submission, from the oldest one
+    const uint32_t numSlots = (uint32_t)m_slotPending.size();
+    for (uint32_t i = 0; i < numSlots; i++) {
+        const uint32_t slot = (m_nextSlot + i) % numSlots;
+        if (m_slotPending[slot]) {
+            ReadSlot(slot);
+        }
+    }
+
+    if (m_numFrames == 0) {
+        return;
+    }
+    const int64_t runStarts[] = { m_blackRunStart, m_frozenRunStart, m_clippedRunStart };
+    const char* runNames[] = { "black", "frozen", "clipped" };
+    for (uint32_t run = 0; run < 3; run++) {
+        if (runStarts[run] >= 0) {
+            VK_LOG_WARNING("Frame analytics: %s frames to the last frame %llu\n", runNames[run],
+                           (unsigned long long)m_lastFrameId);
+        }
+    }
+    m_blackRunStart = m_frozenRunStart = m_clippedRunStart = -1;
+
+    std::cout << "Frame analytics: " << m_numFrames << " frames of " << m_extent.width << "x" << m_extent.height
+              << ", " << m_numBlackFrames << " black, " << m_numFrozenFrames << " frozen, "
+              << m_numClippedFrames << " clipped" << std::endl;
+}
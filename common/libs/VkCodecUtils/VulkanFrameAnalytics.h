@@ -0,0 +1,143 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANFRAMEANALYTICS_H_
+#define _VKCODECUTILS_VULKANFRAMEANALYTICS_H_
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanShaderCompiler.h"
+#include "VkCodecUtils/VulkanDescriptorSetLayout.h"
+#include "VkCodecUtils/VulkanComputePipeline.h"
+#include "VkCodecUtils/VulkanCommandBuffersSet.h"
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VulkanDecodedFrame.h"
+
+// Analyzes the decoded frames on the compute queue, in their output order. Per plane, the histogram, the sum and
+// the sum of squares of the samples are reduced per workgroup in shared memory, then added into a small host visible
+// buffer per slot, with the clipped luma samples and the difference of the luma means of the 8x8 blocks from the
+// ones of the previous frame, kept on the device. Only these few hundred bytes per frame are read by the host, which
+// flags the black, frozen and clipped frames and reports where their runs start and end.
+// The images are 2-plane YCbCr and need the storage usage.
+class VulkanFrameAnalytics : public VkVideoRefCountBase
+{
+public:
+    enum { NUM_PLANES = 3 };
+    enum { NUM_HISTOGRAM_BINS = 32 }; // of the samples on the 8-bit scale
+
+    struct FrameAnalytics {
+        uint64_t frameId;
+        double   mean[NUM_PLANES];     // on the 8-bit sample scale
+        double   variance[NUM_PLANES];
+        float    histogram[NUM_PLANES][NUM_HISTOGRAM_BINS]; // the fraction of the samples of the plane per bin
+        double   frameDifference;      // mean absolute difference of the 8x8 block luma means, -1 for the first frame
+        double   clippedLow;           // fraction of the luma samples at or under the black level
+        double   clippedHigh;          // and at or over the white level
+        bool     isBlack;
+        bool     isFrozen;
+        bool     isClipped;
+    };
+
+    // The frames of the extent and format, with a slot per frame in flight. The analytics of each frame are written
+    // to csvFile, if any, once read.
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkFormat imageFormat,
+                           const VkExtent2D& extent,
+                           uint32_t numSlots,
+                           FILE* csvFile,
+                           VkSharedBaseObj<VulkanFrameAnalytics>& frameAnalytics);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the analytics if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    bool IsCompatible(VkFormat imageFormat, const VkExtent2D& extent) const
+    {
+        return (imageFormat == m_imageFormat) && (extent.width == m_extent.width) && (extent.height == m_extent.height);
+    }
+
+    // Submits the analysis of the frame after its decode. The consumers of the frame wait for the analysis instead:
+    // its frameCompleteSemaphore is waited on here, and replaced by the timeline semaphore of the analysis.
+    // The analytics of the frame submitted numSlots frames before are read first.
+    VkResult SubmitFrame(uint64_t frameId, VulkanDecodedFrame& frame);
+
+    // Reads the analytics of the frames submitted and not read yet, then reports the frames analyzed
+    void Flush();
+
+    // The CSV header of the columns written per frame
+    static void WriteCsvHeader(FILE* csvFile);
+
+private:
+    VulkanFrameAnalytics(const VulkanDeviceContext* vkDevCtx, VkFormat imageFormat, const VkExtent2D& extent,
+                         uint32_t chromaShiftX, uint32_t chromaShiftY, FILE* csvFile);
+
+    virtual ~VulkanFrameAnalytics();
+
+    VkResult Init(uint32_t numSlots);
+    size_t InitShader(std::string& computeShader) const;
+    VkResult WaitForSlot(uint32_t slot) const;
+    VkResult ReadSlot(uint32_t slot);
+    void ReportFrame(const FrameAnalytics& analytics);
+
+private:
+    std::atomic<int32_t>                           m_refCount;
+    const VulkanDeviceContext*                     m_vkDevCtx;
+    const VkFormat                                 m_imageFormat;
+    const VkExtent2D                               m_extent;
+    const uint32_t                                 m_chromaShiftX;
+    const uint32_t                                 m_chromaShiftY;
+    const VkExtent2D                               m_numWorkgroups;
+    FILE*                                          m_csvFile;
+    VulkanShaderCompiler                           m_vulkanShaderCompiler;
+    VulkanDescriptorSetLayout                      m_descriptorSetLayout;
+    VulkanComputePipeline                          m_computePipeline;
+    VulkanCommandBuffersSet                        m_commandBuffersSet;
+    VkSemaphore                                    m_completeTimelineSemaphore;
+    uint64_t                                       m_lastSubmittedValue;
+    uint32_t                                       m_nextSlot;
+    std::vector<uint64_t>                          m_slotValues;     // of the last submission of each slot
+    std::vector<uint64_t>                          m_slotFrameIds;
+    std::vector<bool>                              m_slotPending;    // submitted and not read yet
+    std::vector<VkSharedBaseObj<VkBufferResource>> m_results;        // per slot
+    VkSharedBaseObj<VkBufferResource>              m_blockSums;      // the luma sums of the blocks of the last frame
+    bool                                           m_hasPreviousFrame;
+    // The frames read so far, and the runs of the flagged frames
+    uint64_t                                       m_numFrames;
+    uint64_t                                       m_numBlackFrames;
+    uint64_t                                       m_numFrozenFrames;
+    uint64_t                                       m_numClippedFrames;
+    int64_t                                        m_blackRunStart;  // -1 outside of a run
+    int64_t                                        m_frozenRunStart;
+    int64_t                                        m_clippedRunStart;
+    uint64_t                                       m_lastFrameId;
+};
+
+#endif /* _VKCODECUTILS_VULKANFRAMEANALYTICS_H_ */
@@ -0,0 +1,255 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <stdint.h>
+#include <algorithm>
+#include "VkCodecUtils/VulkanFrameCompletionReaper.h"
+#include "VkCodecUtils/VkTrace.h"
+
+// How long the reaper sleeps on the device, or on the producer when nothing is in flight
+static const std::chrono::milliseconds reaperPollPeriod(1);
+
+VkResult VulkanFrameCompletionReaper::Create(const VulkanDeviceContext* vkDevCtx,
+                                             VkSharedBaseObj<VulkanFrameCompletionReaper>& frameCompletionReaper)
+{
+    VkSharedBaseObj<VulkanFrameCompletionReaper> completionReaper(new VulkanFrameCompletionReaper(vkDevCtx));
+    if (!completionReaper) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    frameCompletionReaper = completionReaper;
+    return VK_SUCCESS;
+}
+
+VulkanFrameCompletionReaper::VulkanFrameCompletionReaper(const VulkanDeviceContext* vkDevCtx)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_exit(false)
+    , m_wakeMutex()
+    , m_wakeCondition()
+    , m_trackedFrames()
+    , m_completions()
+    , m_pictureCompletions()
+    , m_thread()
+    , m_usedQueryPool(VK_NULL_HANDLE)
+    , m_usedQueryIds(0)
+{
+    for (PictureCompletion& pictureCompletion : m_pictureCompletions) {
+        pictureCompletion.completedDecodeOrder = 0;
+    }
+    m_thread = std::thread(&VulkanFrameCompletionReaper::ReaperThread, this);
+}
+
+VulkanFrameCompletionReaper::~VulkanFrameCompletionReaper()
+{
+    m_exit = true;
+    m_wakeCondition.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool VulkanFrameCompletionReaper::Track(int32_t pictureIndex, uint64_t decodeOrder, VkFence frameCompleteFence,
+                                        VkQueryPool queryPool, int32_t queryId)
+{
+    if (((uint32_t)pictureIndex >= MAX_PICTURES) || (frameCompleteFence == VK_NULL_HANDLE)) {
+        return false;
+    }
+
+    InFlightFrame frame;
+    frame.pictureIndex = pictureIndex;
+    frame.decodeOrder = decodeOrder;
+    frame.frameCompleteFence = frameCompleteFence;
+    frame.queryPool = queryPool;
+    frame.queryId = queryId;
+    frame.trackTime = std::chrono::steady_clock::now();
+    if (!m_trackedFrames.Push(frame)) {
+        return false;
+    }
+
+    m_wakeCondition.notify_one();
+    return true;
+}
+
+bool VulkanFrameCompletionReaper::GetCompletion(int32_t pictureIndex, uint64_t decodeOrder,
+                                                FrameCompletion& completion) const
+{
+    if ((uint32_t)pictureIndex >= MAX_PICTURES) {
+        return false;
+    }
+
+    const PictureCompletion& pictureCompletion = m_pictureCompletions[pictureIndex];
+    if (pictureCompletion.completedDecodeOrder.load(std::memory_order_acquire) < (decodeOrder + 1)) {
+        return false;
+    }
+    // The picture is not decoded again before its consumer is done with it, so the completion is stable here.
+    completion = pictureCompletion.completion;
+    return true;
+}
+
+void VulkanFrameCompletionReaper::Publish(const InFlightFrame& frame, VkQueryResultStatusKHR status)
+{
+    FrameCompletion completion;
+    completion.pictureIndex = frame.pictureIndex;
+    completion.decodeOrder = frame.decodeOrder;
+    completion.status = status;
+    completion.trackTime = frame.trackTime;
+    completion.completionTime = std::chrono::steady_clock::now();
+
+    PictureCompletion& pictureCompletion = m_pictureCompletions[frame.pictureIndex];
+    pictureCompletion.completion = completion;
+    pictureCompletion.completedDecodeOrder.store(frame.decodeOrder + 1, std::memory_order_release);
+
+    // The statistics consumer may be behind, the per picture completion is published regardless.
+    m_completions.Push(completion);
+}
+
+void VulkanFrameCompletionReaper::GetQueryStatuses(const std::vector<InFlightFrame>& completedFrames,
+                                                   std::vector<VkQueryResultStatusKHR>& statuses)
+{
+    // Not written for the queries not available
+    statuses.assign(completedFrames.size(), VK_QUERY_RESULT_STATUS_NOT_READY_KHR);
+
+    int32_t firstQueryId = INT32_MAX;
+    int32_t lastQueryId = -1;
+    bool sharedPool = true;
+    for (const InFlightFrame& completedFrame : completedFrames) {
+        sharedPool = sharedPool && (completedFrame.queryPool == completedFrames[0].queryPool);
+        firstQueryId = std::min(firstQueryId, completedFrame.queryId);
+        lastQueryId = std::max(lastQueryId, completedFrame.queryId);
+    }
+
+    // The frames completed together are read in one call, over the span of their queries, as long as all the
+    // queries in between are initialized. The ones of the frames still in flight are left unwritten.
+    const uint32_t spanSize = (uint32_t)(lastQueryId - firstQueryId + 1);
+    const uint64_t spanMask = (spanSize < 64) ? (((1ULL << spanSize) - 1) << firstQueryId) : ~0ULL;
+    if ((completedFrames.size() > 1) && sharedPool && (completedFrames[0].queryPool == m_usedQueryPool) &&
+            (firstQueryId >= 0) && (lastQueryId < 64) && ((m_usedQueryIds & spanMask) == spanMask)) {
+        VkQueryResultStatusKHR spanStatuses[64];
+        for (uint32_t i = 0; i < spanSize; i++) {
+            spanStatuses[i] = VK_QUERY_RESULT_STATUS_NOT_READY_KHR;
+        }
+        VkResult queryResult = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx,
+                                                               m_usedQueryPool,
+                                                               (uint32_t)firstQueryId,
+                                                               spanSize,
+                                                               spanSize * sizeof(VkQueryResultStatusKHR),
+                                                               spanStatuses,
+                                                               sizeof(VkQueryResultStatusKHR),
+                                                               VK_QUERY_RESULT_WITH_STATUS_BIT_KHR);
+        if ((queryResult == VK_SUCCESS) || (queryResult == VK_NOT_READY)) {
+            for (size_t i = 0; i < completedFrames.size(); i++) {
+                statuses[i] = spanStatuses[completedFrames[i].queryId - firstQueryId];
+            }
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < completedFrames.size(); i++) {
+        VkQueryResultStatusKHR queryStatus = VK_QUERY_RESULT_STATUS_NOT_READY_KHR;
+        VkResult queryResult = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx,
+                                                               completedFrames[i].queryPool,
+                                                               completedFrames[i].queryId,
+                                                               1,
+                                                               sizeof(queryStatus),
+                                                               &queryStatus,
+                                                               sizeof(queryStatus),
+                                                               VK_QUERY_RESULT_WITH_STATUS_BIT_KHR);
+        if (queryResult == VK_SUCCESS) {
+            statuses[i] = queryStatus;
+        } else if (queryResult != VK_NOT_READY) {
+            statuses[i] = VK_QUERY_RESULT_STATUS_ERROR_KHR;
+        }
+    }
+}
+
+void VulkanFrameCompletionReaper::ReaperThread()
+{
+    std::vector<InFlightFrame> inFlightFrames;
+    std::vector<InFlightFrame> completedFrames; // with a query, their fence signaled
+    std::vector<VkQueryResultStatusKHR> queryStatuses;
+    std::vector<VkFence> fences;
+    inFlightFrames.reserve(MAX_IN_FLIGHT_FRAMES);
+    completedFrames.reserve(MAX_IN_FLIGHT_FRAMES);
+    queryStatuses.reserve(MAX_IN_FLIGHT_FRAMES);
+    fences.reserve(MAX_IN_FLIGHT_FRAMES);
+
+    while (!m_exit) {
+
+        InFlightFrame frame;
+        while (m_trackedFrames.Pop(frame)) {
+            if ((frame.queryPool != VK_NULL_HANDLE) && (frame.queryPool != m_usedQueryPool)) {
+                m_usedQueryPool = frame.queryPool;
+                m_usedQueryIds = 0;
+            }
+            if ((frame.queryPool != VK_NULL_HANDLE) && (frame.queryId >= 0) && (frame.queryId < 64)) {
+                m_usedQueryIds |= 1ULL << frame.queryId;
+            }
+            inFlightFrames.push_back(frame);
+        }
+
+        if (inFlightFrames.empty()) {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wakeCondition.wait_for(lock, reaperPollPeriod,
+                                     [this]() { return m_exit || !m_trackedFrames.Empty(); });
+            continue;
+        }
+
+        fences.clear();
+        for (const InFlightFrame& inFlightFrame : inFlightFrames) {
+            fences.push_back(inFlightFrame.frameCompleteFence);
+        }
+
+        // Sleep on the device until any of the frames completes
+        const uint64_t timeoutNs = std::chrono::duration_cast<std::chrono::nanoseconds>(reaperPollPeriod).count();
+        VkResult result = VK_SUCCESS;
+        {
+            VK_TRACE_ZONE("WaitForFences");
+            result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, (uint32_t)fences.size(), fences.data(),
+                                               VK_FALSE, timeoutNs);
+        }
+        if (result == VK_TIMEOUT) {
+            continue;
+        }
+
+        completedFrames.clear();
+        std::vector<InFlightFrame>::iterator it = inFlightFrames.begin();
+        while (it != inFlightFrames.end()) {
+            const VkResult fenceStatus = m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, it->frameCompleteFence);
+            if (fenceStatus == VK_NOT_READY) {
+                ++it;
+                continue;
+            }
+
+            if (fenceStatus != VK_SUCCESS) {
+                Publish(*it, VK_QUERY_RESULT_STATUS_ERROR_KHR);
+            } else if (it->queryPool == VK_NULL_HANDLE) {
+                Publish(*it, VK_QUERY_RESULT_STATUS_COMPLETE_KHR);
+            } else {
+                completedFrames.push_back(*it);
+            }
+            it = inFlightFrames.erase(it);
+        }
+
+        if (!completedFrames.empty()) {
+            GetQueryStatuses(completedFrames, queryStatuses);
+            for (size_t i = 0; i < completedFrames.size(); i++) {
+                Publish(completedFrames[i], queryStatuses[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANFRAMECOMPLETIONREAPER_H_
+#define _VKCODECUTILS_VULKANFRAMECOMPLETIONREAPER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanSpscRingQueue.h"
+
+// Harvests the frame complete fences and the decode status queries of the in-flight frames on a background thread.
+// The completions are published per picture index, for the consumers to check without blocking,
+// and on a lock-free queue with their completion time and status, for statistics.
+// Track() must be called from one producer thread and PopCompletion() from one consumer thread.
+class VulkanFrameCompletionReaper : public VkVideoRefCountBase
+{
+public:
+    enum { MAX_PICTURES = 32, MAX_IN_FLIGHT_FRAMES = 64 };
+
+    struct FrameCompletion {
+        int32_t                               pictureIndex;
+        uint64_t                              decodeOrder;
+        VkQueryResultStatusKHR                status; // VK_QUERY_RESULT_STATUS_COMPLETE_KHR if there is no query
+        std::chrono::steady_clock::time_point trackTime;
+        std::chrono::steady_clock::time_point completionTime;
+    };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkSharedBaseObj<VulkanFrameCompletionReaper>& frameCompletionReaper);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the reaper if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Starts watching the fence and the query of a frame. Returns false if too many frames are in flight.
+    bool Track(int32_t pictureIndex, uint64_t decodeOrder, VkFence frameCompleteFence,
+               VkQueryPool queryPool, int32_t queryId);
+
+    // Non-blocking, returns true once the frame with this decode order has completed on the device.
+    bool GetCompletion(int32_t pictureIndex, uint64_t decodeOrder, FrameCompletion& completion) const;
+
+    bool PopCompletion(FrameCompletion& completion)
+    {
+        return m_completions.Pop(completion);
+    }
+
+private:
+    struct InFlightFrame {
+        int32_t                               pictureIndex;
+        uint64_t                              decodeOrder;
+        VkFence                               frameCompleteFence;
+        VkQueryPool                           queryPool;
+        int32_t                               queryId;
+        std::chrono::steady_clock::time_point trackTime;
+    };
+
+    struct PictureCompletion {
+        std::atomic<uint64_t> completedDecodeOrder; // decode order + 1 of the last completed frame, 0 for none
+        FrameCompletion       completion;
+    };
+
+    VulkanFrameCompletionReaper(const VulkanDeviceContext* vkDevCtx);
+
+    virtual ~VulkanFrameCompletionReaper();
+
+    void ReaperThread();
+    void GetQueryStatuses(const std::vector<InFlightFrame>& completedFrames,
+                          std::vector<VkQueryResultStatusKHR>& statuses);
+    void Publish(const InFlightFrame& frame, VkQueryResultStatusKHR status);
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    const VulkanDeviceContext* m_vkDevCtx;
+    std::atomic<bool>          m_exit;
+    std::mutex                 m_wakeMutex;
+    std::condition_variable    m_wakeCondition;
+    VulkanSpscRingQueue<InFlightFrame, MAX_IN_FLIGHT_FRAMES>   m_trackedFrames;
+    VulkanSpscRingQueue<FrameCompletion, MAX_IN_FLIGHT_FRAMES> m_completions;
+    PictureCompletion          m_pictureCompletions[MAX_PICTURES];
+    std::thread                m_thread;
+    VkQueryPool                m_usedQueryPool; // of the last tracked frames, by the reaper thread only
+    uint64_t                   m_usedQueryIds;  // the queries of m_usedQueryPool tracked so far, reset at least once
+};
+
+#endif /* _VKCODECUTILS_VULKANFRAMECOMPLETIONREAPER_H_ */
@@ -0,0 +1,618 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "VkCodecUtils/VulkanFrameServer.h"
+
+#if defined(__linux) || defined(__linux__) || defined(linux)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/sync_file.h>
+
+using namespace VulkanFrameServerProtocol;
+
+// Blocks until the sync file is signaled, then closes it
+static void WaitAndCloseSyncFd(int syncFd)
+{
+    if (syncFd < 0) {
+        return;
+    }
+    struct pollfd pollFd = { syncFd, POLLIN, 0 };
+    while ((poll(&pollFd, 1, -1) < 0) && ((errno == EINTR) || (errno == EAGAIN))) {
+    }
+    close(syncFd);
+}
+
+VkResult VulkanFrameServer::Create(const VulkanDeviceContext* vkDevCtx,
+                                   VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                                   const char* socketPath, uint32_t maxFramesPerClient,
+                                   VkSharedBaseObj<VulkanFrameServer>& frameServer)
+{
+    if (!decoderQueue || (socketPath == nullptr) || (socketPath[0] == '\0')) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VulkanFrameServer> vkFrameServer(new VulkanFrameServer(vkDevCtx, decoderQueue,
+                                                                           std::max(maxFramesPerClient, 1U)));
+    if (!vkFrameServer) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = vkFrameServer->Initialize(socketPath);
+    if (result == VK_SUCCESS) {
+        frameServer = vkFrameServer;
+    }
+    return result;
+}
+
+VulkanFrameServer::VulkanFrameServer(const VulkanDeviceContext* vkDevCtx,
+                                     VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                                     uint32_t maxFramesPerClient)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_decoderQueue(decoderQueue)
+    , m_maxFramesPerClient(maxFramesPerClient)
+    , m_socketPath()
+    , m_listenFd(-1)
+    , m_ringFd(-1)
+    , m_ring(nullptr)
+    , m_clients()
+    , m_images(MAX_IMAGES)
+    , m_slots(std::min(2 * maxFramesPerClient, MAX_SLOTS))
+    , m_frameSerial(0)
+    , m_imageSerial(0)
+    , m_numPublished(0)
+    , m_numSent(0)
+    , m_numMissed(0)
+{
+    for (Image& image : m_images) {
+        image.serial = 0;
+        image.framesInFlight = 0;
+    }
+    for (Slot& slot : m_slots) {
+        slot.refCount = 0;
+        slot.consumerDoneFd = -1;
+        slot.sentTo.assign(MAX_CLIENTS, false);
+    }
+}
+
+VulkanFrameServer::~VulkanFrameServer()
+{
+    Deinit();
+}
+
+VkResult VulkanFrameServer::Initialize(const char* socketPath)
+{
+    // The metadata ring, shared with each client on connection
+    m_ringFd = memfd_create("vk-video-frame-server", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if ((m_ringFd < 0) || (ftruncate(m_ringFd, sizeof(Ring)) != 0)) {
+        std::cerr << "Frame server: can't create the shared memory of the ring: " << strerror(errno) << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    fcntl(m_ringFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+    void* pRing = mmap(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE, MAP_SHARED, m_ringFd, 0);
+    if (pRing == MAP_FAILED) {
+        std::cerr << "Frame server: can't map the ring: " << strerror(errno) << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    m_ring = static_cast<Ring*>(pRing);
+    memset(m_ring, 0, sizeof(Ring));
+    m_ring->magic = RING_MAGIC;
+    m_ring->version = RING_VERSION;
+    m_ring->numImages = MAX_IMAGES;
+    m_ring->numSlots = (uint32_t)m_slots.size();
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        std::cerr << "Frame server: the socket path is too long: " << socketPath << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    m_listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_listenFd < 0) {
+        std::cerr << "Frame server: can't create the socket: " << strerror(errno) << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    // The socket of a previous run
+    unlink(socketPath);
+    if ((bind(m_listenFd, (const struct sockaddr*)&address, sizeof(address)) != 0) ||
+            (listen(m_listenFd, MAX_CLIENTS) != 0)) {
+        std::cerr << "Frame server: can't listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    m_socketPath = socketPath;
+    return VK_SUCCESS;
+}
+
+void VulkanFrameServer::Deinit()
+{
+    // The frames of the clients still connected are released on their behalf
+    for (uint32_t slotIndex = 0; slotIndex < m_slots.size(); slotIndex++) {
+        Slot& slot = m_slots[slotIndex];
+        if ((m_ring == nullptr) || (m_ring->slots[slotIndex].serial == 0)) {
+            continue;
+        }
+        WaitAndCloseSyncFd(slot.consumerDoneFd);
+        slot.consumerDoneFd = -1;
+        m_decoderQueue->ReleaseFrame(&slot.frame);
+        slot.frame.Reset();
+        m_ring->slots[slotIndex].serial = 0;
+    }
+
+    for (Client& client : m_clients) {
+        if (client.socketFd >= 0) {
+            close(client.socketFd);
+            client.socketFd = -1;
+        }
+    }
+    m_clients.clear();
+    m_images.clear();
+
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+        m_listenFd = -1;
+        unlink(m_socketPath.c_str());
+    }
+    if (m_ring != nullptr) {
+        munmap(m_ring, sizeof(Ring));
+        m_ring = nullptr;
+    }
+    if (m_ringFd >= 0) {
+        close(m_ringFd);
+        m_ringFd = -1;
+    }
+}
+
+bool VulkanFrameServer::SendMessage(int socketFd, const Message& message, int fd)
+{
+    struct iovec iov = { const_cast<Message*>(&message), sizeof(message) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    union {
+        char           buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    if (fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+        pCmsg->cmsg_level = SOL_SOCKET;
+        pCmsg->cmsg_type = SCM_RIGHTS;
+        pCmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(pCmsg), &fd, sizeof(int));
+    }
+
+    // A client not reading its messages does not block the decode, it misses the frame
+    return sendmsg(socketFd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)sizeof(message);
+}
+
+void VulkanFrameServer::AcceptClient()
+{
+    int socketFd;
+    while ((socketFd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+
+        uint32_t clientIndex = 0;
+        while ((clientIndex < m_clients.size()) && (m_clients[clientIndex].socketFd >= 0)) {
+            clientIndex++;
+        }
+        if (clientIndex >= MAX_CLIENTS) {
+            std::cerr << "Frame server: too many clients, the connection is refused" << std::endl;
+            close(socketFd);
+            continue;
+        }
+
+        Message hello;
+        memset(&hello, 0, sizeof(hello));
+        hello.type = MSG_HELLO;
+        if (!SendMessage(socketFd, hello, m_ringFd)) {
+            close(socketFd);
+            continue;
+        }
+
+        if (clientIndex == m_clients.size()) {
+            m_clients.push_back(Client());
+        }
+        Client& client = m_clients[clientIndex];
+        client.socketFd = socketFd;
+        client.imageSerials.assign(m_images.size(), 0);
+        client.framesInFlight = 0;
+    }
+}
+
+void VulkanFrameServer::ReleaseSlot(uint32_t slotIndex, uint32_t clientIndex, int syncFd)
+{
+    Slot& slot = m_slots[slotIndex];
+    slot.sentTo[clientIndex] = false;
+    m_clients[clientIndex].framesInFlight--;
+
+    if (syncFd >= 0) {
+        if (slot.consumerDoneFd < 0) {
+            slot.consumerDoneFd = syncFd;
+        } else {
+            // One sync file signaled once all the clients are done
+            struct sync_merge_data mergeData;
+            memset(&mergeData, 0, sizeof(mergeData));
+            strncpy(mergeData.name, "vk-video-frame-server", sizeof(mergeData.name) - 1);
+            mergeData.fd2 = syncFd;
+            if (ioctl(slot.consumerDoneFd, SYNC_IOC_MERGE, &mergeData) == 0) {
+                close(slot.consumerDoneFd);
+                close(syncFd);
+                slot.consumerDoneFd = mergeData.fence;
+            } else {
+                WaitAndCloseSyncFd(syncFd);
+            }
+        }
+    }
+
+    assert(slot.refCount > 0);
+    if (--slot.refCount > 0) {
+        return;
+    }
+
+    // The last client is done with the frame, the decoder waits for the sync files before decoding to it again
+    if (slot.consumerDoneFd >= 0) {
+        if (slot.frame.ImportConsumerDoneSyncFd(m_vkDevCtx, slot.consumerDoneFd) != VK_SUCCESS) {
+            WaitAndCloseSyncFd(slot.consumerDoneFd);
+        }
+        slot.consumerDoneFd = -1;
+    }
+    const uint32_t imageId = m_ring->slots[slotIndex].imageId;
+    if ((imageId < m_images.size()) && (m_images[imageId].framesInFlight > 0)) {
+        m_images[imageId].framesInFlight--;
+    }
+    m_decoderQueue->ReleaseFrame(&slot.frame);
+    slot.frame.Reset();
+    m_ring->slots[slotIndex].serial = 0;
+}
+
+void VulkanFrameServer::DisconnectClient(uint32_t clientIndex)
+{
+    Client& client = m_clients[clientIndex];
+    close(client.socketFd);
+    client.socketFd = -1;
+    for (uint32_t slotIndex = 0; slotIndex < m_slots.size(); slotIndex++) {
+        if (m_slots[slotIndex].sentTo[clientIndex]) {
+            ReleaseSlot(slotIndex, clientIndex, -1);
+        }
+    }
+}
+
+bool VulkanFrameServer::ReceiveMessages(uint32_t clientIndex)
+{
+    for (;;) {
+        Message message;
+        struct iovec iov = { &message, sizeof(message) };
+        union {
+            char           buffer[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+
+        const ssize_t size = recvmsg(m_clients[clientIndex].socketFd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (size < 0) {
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+        } else if (size == 0) {
+            return false; // disconnected
+        }
+
+        int syncFd = -1;
+        for (struct cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg); pCmsg != nullptr; pCmsg = CMSG_NXTHDR(&msg, pCmsg)) {
+            if ((pCmsg->cmsg_level == SOL_SOCKET) && (pCmsg->cmsg_type == SCM_RIGHTS) &&
+                    (pCmsg->cmsg_len == CMSG_LEN(sizeof(int)))) {
+                memcpy(&syncFd, CMSG_DATA(pCmsg), sizeof(int));
+            }
+        }
+
+        // Only the release of a frame sent to the client and not released yet
+        if ((size == (ssize_t)sizeof(message)) && (message.type == MSG_RELEASE) &&
+                (message.slot < m_slots.size()) && (message.serial != 0) &&
+                (m_ring->slots[message.slot].serial == message.serial) &&
+                m_slots[message.slot].sentTo[clientIndex]) {
+            ReleaseSlot(message.slot, clientIndex, syncFd);
+        } else if (syncFd >= 0) {
+            close(syncFd);
+        }
+    }
+}
+
+bool VulkanFrameServer::PollClients(int timeoutMs)
+{
+    std::vector<struct pollfd> pollFds;
+    std::vector<uint32_t> clientIndices;
+    struct pollfd listenPollFd = { m_listenFd, POLLIN, 0 };
+    pollFds.push_back(listenPollFd);
+    for (uint32_t clientIndex = 0; clientIndex < m_clients.size(); clientIndex++) {
+        if (m_clients[clientIndex].socketFd >= 0) {
+            struct pollfd clientPollFd = { m_clients[clientIndex].socketFd, POLLIN, 0 };
+            pollFds.push_back(clientPollFd);
+            clientIndices.push_back(clientIndex);
+        }
+    }
+
+    const int numEvents = poll(pollFds.data(), (nfds_t)pollFds.size(), timeoutMs);
+    if (numEvents <= 0) {
+        return false;
+    }
+
+    if (pollFds[0].revents & POLLIN) {
+        AcceptClient();
+    }
+    for (size_t i = 1; i < pollFds.size(); i++) {
+        if (pollFds[i].revents == 0) {
+            continue;
+        }
+        const uint32_t clientIndex = clientIndices[i - 1];
+        if (!ReceiveMessages(clientIndex) || (pollFds[i].revents & (POLLHUP | POLLERR | POLLNVAL))) {
+            DisconnectClient(clientIndex);
+        }
+    }
+    return true;
+}
+
+int32_t VulkanFrameServer::FindFreeSlot() const
+{
+    for (uint32_t slotIndex = 0; slotIndex < m_slots.size(); slotIndex++) {
+        if (m_ring->slots[slotIndex].serial == 0) {
+            return (int32_t)slotIndex;
+        }
+    }
+    return -1;
+}
+
+int32_t VulkanFrameServer::GetImageId(const VkSharedBaseObj<VkImageResource>& imageResource)
+{
+    int32_t freeImageId = -1;
+    int32_t unusedImageId = -1;
+    for (uint32_t imageId = 0; imageId < m_images.size(); imageId++) {
+        const Image& image = m_images[imageId];
+        if (image.imageResource == imageResource) {
+            return (int32_t)imageId;
+        } else if ((image.serial == 0) && (freeImageId < 0)) {
+            freeImageId = (int32_t)imageId;
+        } else if ((image.framesInFlight == 0) && (unusedImageId < 0)) {
+            unusedImageId = (int32_t)imageId;
+        }
+    }
+    // A free entry, or else the one of an image not in the frames in flight, sent again to the clients if reused
+    if (freeImageId < 0) {
+        freeImageId = unusedImageId;
+    }
+    if (freeImageId < 0) {
+        return -1;
+    }
+
+    Image& image = m_images[freeImageId];
+    image.imageResource = imageResource;
+    image.serial = ++m_imageSerial;
+    image.framesInFlight = 0;
+
+    const VkImageCreateInfo& createInfo = imageResource->GetImageCreateInfo();
+    ImageInfo& imageInfo = m_ring->images[freeImageId];
+    imageInfo.imageId = (uint32_t)freeImageId;
+    imageInfo.format = createInfo.format;
+    imageInfo.width = createInfo.extent.width;
+    imageInfo.height = createInfo.extent.height;
+    imageInfo.arrayLayers = createInfo.arrayLayers;
+    imageInfo.usage = createInfo.usage;
+    imageInfo.tiling = createInfo.tiling;
+    imageInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+    imageInfo.memorySize = image.imageResource->GetMemory()->GetMemoryRequirements().size;
+    return freeImageId;
+}
+
+bool VulkanFrameServer::SendImage(Client& client, uint32_t imageId)
+{
+    const Image& image = m_images[imageId];
+    if (client.imageSerials[imageId] == image.serial) {
+        return true;
+    }
+
+    int memoryFd = -1;
+    if (image.imageResource->ExportFd(VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT, &memoryFd) != VK_SUCCESS) {
+        return false;
+    }
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.type = MSG_IMAGE;
+    message.imageId = imageId;
+    const bool sent = SendMessage(client.socketFd, message, memoryFd);
+    close(memoryFd);
+    if (sent) {
+        client.imageSerials[imageId] = image.serial;
+    }
+    return sent;
+}
+
+uint32_t VulkanFrameServer::GetNumClients() const
+{
+    uint32_t numClients = 0;
+    for (const Client& client : m_clients) {
+        if (client.socketFd >= 0) {
+            numClients++;
+        }
+    }
+    return numClients;
+}
+
+bool VulkanFrameServer::HasFramesInFlight() const
+{
+    return std::any_of(m_clients.begin(), m_clients.end(),
+                       [](const Client& client) { return (client.socketFd >= 0) && (client.framesInFlight > 0); });
+}
+
+void VulkanFrameServer::PublishFrame(VulkanDecodedFrame& frame)
+{
+    m_numPublished++;
+
+    uint32_t numEligible = 0;
+    for (const Client& client : m_clients) {
+        if (client.socketFd < 0) {
+            continue;
+        } else if (client.framesInFlight < m_maxFramesPerClient) {
+            numEligible++;
+        } else {
+            m_numMissed++;
+        }
+    }
+
+    const int32_t slotIndex = FindFreeSlot();
+    const int32_t imageId = ((numEligible > 0) && (slotIndex >= 0) && frame.imageView) ?
+                                GetImageId(frame.imageView->GetImageResource()) : -1;
+    int frameCompleteFd = -1;
+    if ((imageId < 0) || (frame.ExportFrameCompleteSyncFd(m_vkDevCtx, &frameCompleteFd) != VK_SUCCESS)) {
+        // No client to send the frame to
+        m_decoderQueue->ReleaseFrame(&frame);
+        return;
+    }
+
+    FrameSlot& frameSlot = m_ring->slots[slotIndex];
+    frameSlot.serial = ++m_frameSerial;
+    frameSlot.pts = frame.timestamp;
+    frameSlot.displayOrder = frame.displayOrder;
+    frameSlot.decodeOrder = frame.decodeOrder;
+    frameSlot.imageId = (uint32_t)imageId;
+    frameSlot.baseArrayLayer = frame.imageLayerIndex;
+    frameSlot.imageLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR;
+    frameSlot.displayWidth = frame.displayWidth;
+    frameSlot.displayHeight = frame.displayHeight;
+
+    Slot& slot = m_slots[slotIndex];
+    slot.frame = frame;
+    slot.refCount = 0;
+    slot.consumerDoneFd = -1;
+
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.type = MSG_FRAME;
+    message.imageId = (uint32_t)imageId;
+    message.slot = (uint32_t)slotIndex;
+    message.serial = frameSlot.serial;
+    for (uint32_t clientIndex = 0; clientIndex < m_clients.size(); clientIndex++) {
+        Client& client = m_clients[clientIndex];
+        if ((client.socketFd < 0) || (client.framesInFlight >= m_maxFramesPerClient)) {
+            continue;
+        }
+        if (!SendImage(client, (uint32_t)imageId) || !SendMessage(client.socketFd, message, frameCompleteFd)) {
+            m_numMissed++;
+            continue;
+        }
+        slot.sentTo[clientIndex] = true;
+        slot.refCount++;
+        client.framesInFlight++;
+        m_numSent++;
+    }
+    // Each client got its own copy of the sync file
+    if (frameCompleteFd >= 0) {
+        close(frameCompleteFd);
+    }
+
+    if (slot.refCount == 0) {
+        m_decoderQueue->ReleaseFrame(&slot.frame);
+        slot.frame.Reset();
+        frameSlot.serial = 0;
+    } else {
+        m_images[imageId].framesInFlight++;
+    }
+}
+
+int32_t VulkanFrameServer::Run(bool waitForClient)
+{
+    while (waitForClient && (GetNumClients() == 0)) {
+        PollClients(-1);
+    }
+
+    bool endOfStream = false;
+    while (!endOfStream) {
+
+        // The releases and the connections, then a slot for the next frame
+        PollClients(0);
+        while ((FindFreeSlot() < 0) && (GetNumClients() > 0)) {
+            PollClients(-1);
+        }
+
+        VulkanDecodedFrame frame;
+        m_decoderQueue->GetNextFrame(&frame, &endOfStream);
+        // The last frame of maxFrameCount comes with -1
+        if (frame.pictureIndex != -1) {
+            PublishFrame(frame);
+        }
+    }
+
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.type = MSG_END_OF_STREAM;
+    for (const Client& client : m_clients) {
+        if (client.socketFd >= 0) {
+            SendMessage(client.socketFd, message, -1);
+        }
+    }
+
+    // The clients done with the last frames, or gone
+    const int releaseTimeoutMs = 5000;
+    while (HasFramesInFlight() && PollClients(releaseTimeoutMs)) {
+    }
+    return (m_numPublished > 0) ? 0 : -1;
+}
+
+void VulkanFrameServer::PrintStats() const
+{
+    std::cout << "Frame server: " << m_numPublished << " frames published, " << m_numSent
+              << " sent to the clients, " << m_numMissed << " missed by the clients at their limit of "
+              << m_maxFramesPerClient << " frames" << std::endl;
+}
+
+#else
+
+VkResult VulkanFrameServer::Create(const VulkanDeviceContext*,
+                                   VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>&,
+                                   const char*, uint32_t,
+                                   VkSharedBaseObj<VulkanFrameServer>&)
+{
+    std::cerr << "Frame server: only supported on Linux" << std::endl;
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+}
+
+int32_t VulkanFrameServer::Run(bool)
+{
+    return -1;
+}
+
+void VulkanFrameServer::PrintStats() const
+{
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANFRAMESERVER_H_
+#define _VKCODECUTILS_VULKANFRAMESERVER_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <vulkan_interfaces.h>
+#include "VkCodecUtils/VkVideoQueue.h"
+#include "VkCodecUtils/VulkanDecodedFrame.h"
+
+// The protocol of the frame server, shared with its clients. The messages are SOCK_SEQPACKET datagrams of a
+// Unix socket, with at most one file descriptor passed along with SCM_RIGHTS:
+//   HELLO   server -> client, fd: the shared memory of the Ring, mapped read-only by the client
+//   IMAGE   server -> client, fd: the memory of the image images[imageId] of the ring, dedicated, at offset 0.
+//           Sent once per image and client, ahead of the first frame in it; a new one replaces the old image.
+//   FRAME   server -> client, fd: a sync file signaled once the frame is decoded, or none if it already is.
+//           The frame is described by slots[slot] of the ring, valid until the client releases it.
+//   RELEASE client -> server, fd: an optional sync file the client signals once done reading the image.
+//   END_OF_STREAM server -> client, no more frames follow.
+// The images stay in the layout of the slot and belong to the decode queue family: the clients acquire them from
+// VK_QUEUE_FAMILY_EXTERNAL, without a release on the decode side.
+namespace VulkanFrameServerProtocol {
+
+enum MessageType : uint32_t {
+    MSG_HELLO          = 1,
+    MSG_IMAGE          = 2,
+    MSG_FRAME          = 3,
+    MSG_RELEASE        = 4,
+    MSG_END_OF_STREAM  = 5,
+};
+
+struct Message {
+    uint32_t type;     // MessageType
+    uint32_t imageId;  // IMAGE
+    uint32_t slot;     // FRAME and RELEASE
+    uint32_t reserved;
+    uint64_t serial;   // FRAME and RELEASE, the serial of the slot
+};
+
+static const uint32_t RING_MAGIC   = 0x56464D53; // "VFMS"
+static const uint32_t RING_VERSION = 1;
+static const uint32_t MAX_IMAGES   = 64;
+static const uint32_t MAX_SLOTS    = 64;
+
+struct ImageInfo {
+    uint32_t imageId;
+    uint32_t format;          // VkFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t arrayLayers;
+    uint32_t usage;           // VkImageUsageFlags
+    uint32_t tiling;          // VkImageTiling
+    uint32_t handleType;      // VkExternalMemoryHandleTypeFlagBits of the memory fd
+    uint64_t memorySize;
+};
+
+struct FrameSlot {
+    uint64_t serial;          // of the frame, the slot is free while 0
+    uint64_t pts;             // the presentation time stamp of the container, in 100 ns units, 0 without it
+    uint64_t displayOrder;
+    uint64_t decodeOrder;
+    uint32_t imageId;
+    uint32_t baseArrayLayer;
+    uint32_t imageLayout;     // VkImageLayout of the image once decoded
+    int32_t  displayWidth;
+    int32_t  displayHeight;
+    uint32_t reserved;
+};
+
+// The metadata ring in the shared memory, written by the server before it sends the messages referring to it
+struct Ring {
+    uint32_t  magic;
+    uint32_t  version;
+    uint32_t  numImages;
+    uint32_t  numSlots;
+    ImageInfo images[MAX_IMAGES];
+    FrameSlot slots[MAX_SLOTS];
+};
+
+} // namespace VulkanFrameServerProtocol
+
+// Publishes the decoded frames to the consumers in other processes, e.g. an encoder or a compositor: the exported
+// output images are passed once to each client, then each frame is announced with the sync file of its decode.
+// A frame is released to the decoder when all the clients it was sent to have released it, the decoder waiting for
+// the sync files they returned, merged, before decoding to the image again. A client with maxFramesPerClient frames
+// not released misses the next frames instead of stalling the decode, and the frames of a client that disconnects
+// are released on its behalf. Frames decoded while no client is connected are released right away. The ring has
+// 2 * maxFramesPerClient slots, the decode waits for a release while they are all in use.
+// Needs a decoder with ENABLE_EXPORT_OUTPUT, Linux only. Without VK_KHR_external_semaphore_fd, the frames are
+// waited for on the host before they are sent.
+class VulkanFrameServer : public VkVideoRefCountBase {
+public:
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                           const char* socketPath, uint32_t maxFramesPerClient,
+                           VkSharedBaseObj<VulkanFrameServer>& frameServer);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the server if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Decodes and publishes the frames to the end of the stream, once the first client is connected if
+    // waitForClient. Returns once every frame sent is released or its client gone.
+    int32_t Run(bool waitForClient);
+
+    // The frames published, sent and missed by the slow clients
+    void PrintStats() const;
+
+private:
+
+    static const uint32_t MAX_CLIENTS = 16;
+
+    struct Client {
+        int                   socketFd;
+        std::vector<uint64_t> imageSerials;   // per image id, the image serial last sent to the client
+        uint32_t              framesInFlight; // sent and not released yet
+    };
+
+    struct Image {
+        VkSharedBaseObj<VkImageResource> imageResource; // kept alive while the clients may have it imported
+        uint64_t                         serial;        // changes with each new image in the entry, 0 if free
+        uint32_t                         framesInFlight;
+    };
+
+    struct Slot {
+        VulkanDecodedFrame    frame;
+        uint32_t              refCount;    // the clients yet to release the frame
+        int                   consumerDoneFd; // the merged sync files of the clients released, -1 if none
+        std::vector<bool>     sentTo;      // per client index
+    };
+
+    VulkanFrameServer(const VulkanDeviceContext* vkDevCtx,
+                      VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                      uint32_t maxFramesPerClient);
+    virtual ~VulkanFrameServer();
+
+    VkResult Initialize(const char* socketPath);
+    void     Deinit();
+    bool     PollClients(int timeoutMs);
+    void     AcceptClient();
+    bool     ReceiveMessages(uint32_t clientIndex);
+    void     DisconnectClient(uint32_t clientIndex);
+    void     ReleaseSlot(uint32_t slotIndex, uint32_t clientIndex, int syncFd);
+    int32_t  FindFreeSlot() const;
+    int32_t  GetImageId(const VkSharedBaseObj<VkImageResource>& imageResource);
+    bool     SendImage(Client& client, uint32_t imageId);
+    void     PublishFrame(VulkanDecodedFrame& frame);
+    bool     SendMessage(int socketFd, const VulkanFrameServerProtocol::Message& message, int fd);
+    bool     HasFramesInFlight() const;
+    uint32_t GetNumClients() const;
+
+private:
+    std::atomic<int32_t>                              m_refCount;
+    const VulkanDeviceContext*                        m_vkDevCtx;
+    VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>> m_decoderQueue;
+    const uint32_t                                    m_maxFramesPerClient;
+    std::string                                       m_socketPath;
+    int                                               m_listenFd;
+    int                                               m_ringFd;
+    VulkanFrameServerProtocol::Ring*                  m_ring;
+    std::vector<Client>                               m_clients;     // the disconnected ones have socketFd -1
+    std::vector<Image>                                m_images;      // per image id
+    std::vector<Slot>                                 m_slots;       // per ring slot
+    uint64_t                                          m_frameSerial;
+    uint64_t                                          m_imageSerial;
+    uint64_t                                          m_numPublished;
+    uint64_t                                          m_numSent;
+    uint64_t                                          m_numMissed;   // not sent to a client at its limit
+};
+
+#endif /* _VKCODECUTILS_VULKANFRAMESERVER_H_ */
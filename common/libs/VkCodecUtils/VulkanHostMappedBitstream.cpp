@@ -0,0 +1,466 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <string.h>
+#include "VkCodecUtils/VulkanHostMappedBitstream.h"
+#include "VkCodecUtils/VulkanBistreamBufferImpl.h"
+#include "VkCodecUtils/Helpers.h"
+
+VkResult
+VulkanHostMappedMemory::Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex,
+                               const uint8_t* pData, VkDeviceSize dataSize,
+                               VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory,
+                               VkBufferUsageFlags usage)
+{
+    if ((pData == nullptr) || (dataSize == 0)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (vkDevCtx->FindRequiredDeviceExtension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkSharedBaseObj<VulkanHostMappedMemory> vkHostMappedMemory(new VulkanHostMappedMemory(vkDevCtx,
+                                                                                          queueFamilyIndex));
+    if (!vkHostMappedMemory) {
+        assert(!"Out of host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = vkHostMappedMemory->Initialize(pData, dataSize, usage);
+    if (result == VK_SUCCESS) {
+        hostMappedMemory = vkHostMappedMemory;
+    }
+
+    return result;
+}
+
+VkResult
+VulkanHostMappedMemory::Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex,
+                               VkDeviceSize dataSize,
+                               VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory)
+{
+    if (dataSize == 0) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (vkDevCtx->FindRequiredDeviceExtension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkSharedBaseObj<VulkanHostMappedMemory> vkHostMappedMemory(new VulkanHostMappedMemory(vkDevCtx,
+                                                                                          queueFamilyIndex));
+    if (!vkHostMappedMemory) {
+        assert(!"Out of host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    // Allocated with the room to align the start of the data, and its size, to the import alignment
+    const VkDeviceSize importAlignment = GetImportAlignment(vkDevCtx);
+    const VkDeviceSize importSize = vk::alignedSize(dataSize, importAlignment);
+    vkHostMappedMemory->m_allocation.resize((size_t)(importSize + importAlignment));
+    const uintptr_t allocationAddress = reinterpret_cast<uintptr_t>(vkHostMappedMemory->m_allocation.data());
+    const uint8_t* pData = reinterpret_cast<const uint8_t*>(vk::alignedSize(allocationAddress, (uintptr_t)importAlignment));
+
+    VkResult result = vkHostMappedMemory->Initialize(pData, importSize);
+    if (result == VK_SUCCESS) {
+        hostMappedMemory = vkHostMappedMemory;
+    }
+
+    return result;
+}
+
+VkDeviceSize VulkanHostMappedMemory::GetImportAlignment(const VulkanDeviceContext* vkDevCtx)
+{
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT externalMemoryHostProps{};
+    externalMemoryHostProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2KHR deviceProps2{};
+    deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+    deviceProps2.pNext = &externalMemoryHostProps;
+    vkDevCtx->GetPhysicalDeviceProperties2(vkDevCtx->getPhysicalDevice(), &deviceProps2);
+
+    return std::max<VkDeviceSize>(externalMemoryHostProps.minImportedHostPointerAlignment, 1);
+}
+
+VkResult VulkanHostMappedMemory::Initialize(const uint8_t* pData, VkDeviceSize dataSize, VkBufferUsageFlags usage)
+{
+    // The imported pointer and size must be aligned to minImportedHostPointerAlignment. Memory mapped files
+    // start at a page boundary and their last page is mapped in full, so the import covers the whole range.
+    const VkDeviceSize importAlignment = GetImportAlignment(m_vkDevCtx);
+    const uintptr_t dataAddress = reinterpret_cast<uintptr_t>(pData);
+    const uintptr_t importAddress = dataAddress - (dataAddress % importAlignment);
+    void* pImportPointer = reinterpret_cast<void*>(importAddress);
+    const VkDeviceSize dataBufferOffset = dataAddress - importAddress;
+    const VkDeviceSize importSize = vk::alignedSize(dataBufferOffset + dataSize, importAlignment);
+
+    VkMemoryHostPointerPropertiesEXT hostPointerProps{};
+    hostPointerProps.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+    VkResult result = m_vkDevCtx->GetMemoryHostPointerPropertiesEXT(*m_vkDevCtx,
+                                                                    VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                                                                    pImportPointer, &hostPointerProps);
+    if ((result != VK_SUCCESS) || (hostPointerProps.memoryTypeBits == 0)) {
+        return (result != VK_SUCCESS) ? result : VK_ERROR_INVALID_EXTERNAL_HANDLE;
+    }
+
+    VkExternalMemoryBufferCreateInfo externalMemoryBufferInfo{};
+    externalMemoryBufferInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalMemoryBufferInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+    VkBufferCreateInfo createBufferInfo = VkBufferCreateInfo();
+    createBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createBufferInfo.pNext = &externalMemoryBufferInfo;
+    createBufferInfo.size = importSize;
+    createBufferInfo.usage = usage;
+    createBufferInfo.flags = 0;
+    createBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createBufferInfo.queueFamilyIndexCount = 1;
+    createBufferInfo.pQueueFamilyIndices = &m_queueFamilyIndex;
+
+    result = m_vkDevCtx->CreateBuffer(*m_vkDevCtx, &createBufferInfo, nullptr, &m_buffer);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkMemoryRequirements memoryRequirements = VkMemoryRequirements();
+    m_vkDevCtx->GetBufferMemoryRequirements(*m_vkDevCtx, m_buffer, &memoryRequirements);
+
+    const uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits & hostPointerProps.memoryTypeBits;
+    if ((memoryTypeBits == 0) || (memoryRequirements.size > importSize)) {
+        Deinitialize();
+        return VK_ERROR_INVALID_EXTERNAL_HANDLE;
+    }
+
+    VkImportMemoryHostPointerInfoEXT importMemoryInfo{};
+    importMemoryInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    importMemoryInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importMemoryInfo.pHostPointer = pImportPointer;
+
+    VkMemoryAllocateInfo allocInfo = VkMemoryAllocateInfo();
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = &importMemoryInfo;
+    allocInfo.allocationSize = importSize;
+    allocInfo.memoryTypeIndex = 0;
+    result = vk::MapMemoryTypeToIndex(m_vkDevCtx, m_vkDevCtx->getPhysicalDevice(),
+                                      memoryTypeBits, 0, &allocInfo.memoryTypeIndex);
+    if (result == VK_SUCCESS) {
+        result = m_vkDevCtx->AllocateMemory(*m_vkDevCtx, &allocInfo, nullptr, &m_deviceMemory);
+    }
+    if (result != VK_SUCCESS) {
+        // Some implementations can't import read-only mappings, the caller falls back to copying.
+        Deinitialize();
+        return result;
+    }
+
+    result = m_vkDevCtx->BindBufferMemory(*m_vkDevCtx, m_buffer, m_deviceMemory, 0);
+    if (result != VK_SUCCESS) {
+        Deinitialize();
+        assert(!"Bind buffer memory failed!");
+        return result;
+    }
+
+    m_pData = pData;
+    m_dataSize = dataSize;
+    m_dataBufferOffset = dataBufferOffset;
+
+    return VK_SUCCESS;
+}
+
+void VulkanHostMappedMemory::Deinitialize()
+{
+    if (m_buffer) {
+        m_vkDevCtx->DestroyBuffer(*m_vkDevCtx, m_buffer, nullptr);
+        m_buffer = VK_NULL_HANDLE;
+    }
+
+    if (m_deviceMemory) {
+        m_vkDevCtx->FreeMemory(*m_vkDevCtx, m_deviceMemory, nullptr);
+        m_deviceMemory = VK_NULL_HANDLE;
+    }
+
+    m_pData = nullptr;
+    m_dataSize = 0;
+    m_dataBufferOffset = 0;
+}
+
+VkResult
+VulkanHostMappedBitstreamBuffer::Create(VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory, const uint8_t* pData,
+                                        VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment,
+                                        VkSharedBaseObj<VulkanHostMappedBitstreamBuffer>& vulkanBitstreamBuffer)
+{
+    if (!hostMappedMemory || !hostMappedMemory->Contains(pData, 1)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VulkanHostMappedBitstreamBuffer> vkBitstreamBuffer(
+            new VulkanHostMappedBitstreamBuffer(hostMappedMemory, bufferOffsetAlignment, bufferSizeAlignment));
+    if (!vkBitstreamBuffer) {
+        assert(!"Out of host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    const VkDeviceSize dataBufferOffset = hostMappedMemory->GetBufferOffset(pData);
+    const VkDeviceSize offsetAlignment = std::max<VkDeviceSize>(bufferOffsetAlignment, 1);
+    vkBitstreamBuffer->m_pData = pData;
+    vkBitstreamBuffer->m_dataSize = hostMappedMemory->GetMaxSize(pData);
+    vkBitstreamBuffer->m_bufferOffset = dataBufferOffset - (dataBufferOffset % offsetAlignment);
+    vkBitstreamBuffer->m_dataOffset = dataBufferOffset - vkBitstreamBuffer->m_bufferOffset;
+
+    vulkanBitstreamBuffer = vkBitstreamBuffer;
+    return VK_SUCCESS;
+}
+
+VkDeviceSize VulkanHostMappedBitstreamBuffer::Resize(VkDeviceSize newSize, VkDeviceSize, VkDeviceSize)
+{
+    // Can't grow in place, use Clone() to move to a larger buffer
+    return (m_dataSize >= newSize) ? m_dataSize : 0;
+}
+
+VkDeviceSize VulkanHostMappedBitstreamBuffer::Clone(VkDeviceSize newSize, VkDeviceSize copySize, VkDeviceSize copyOffset,
+                                                    VkSharedBaseObj<VulkanBitstreamBuffer>& vulkanBitstreamBuffer)
+{
+    const uint8_t* pCopyData = nullptr;
+    if (copySize) {
+        pCopyData = CheckAccess(copyOffset, copySize);
+        if (pCopyData == nullptr) {
+            return 0;
+        }
+    }
+
+    VkSharedBaseObj<VulkanBitstreamBufferImpl> vkBitstreamBuffer;
+    VkResult result = VulkanBitstreamBufferImpl::Create(m_hostMappedMemory->GetDeviceContext(),
+                                                        m_hostMappedMemory->GetQueueFamilyIndex(),
+                                                        newSize, m_bufferOffsetAlignment, m_bufferSizeAlignment,
+                                                        pCopyData, copySize, vkBitstreamBuffer);
+    if (result != VK_SUCCESS) {
+        assert(!"Initialize failed!");
+        return 0;
+    }
+
+    vulkanBitstreamBuffer = vkBitstreamBuffer;
+    return newSize;
+}
+
+const uint8_t* VulkanHostMappedBitstreamBuffer::CheckAccess(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (offset + size <= m_dataSize) {
+        return m_pData + offset;
+    }
+
+    assert(!"Bad buffer access - out of range!");
+    return nullptr;
+}
+
+int64_t VulkanHostMappedBitstreamBuffer::MemsetData(uint32_t value, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    assert(!"Can't write to a host mapped bitstream buffer!");
+    return -1;
+}
+
+int64_t VulkanHostMappedBitstreamBuffer::CopyDataToBuffer(uint8_t *dstBuffer, VkDeviceSize dstOffset,
+                                                          VkDeviceSize srcOffset, VkDeviceSize size) const
+{
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* readData = CheckAccess(srcOffset, size);
+    if (readData == nullptr) {
+        return -1;
+    }
+    memcpy(dstBuffer + dstOffset, readData, (size_t)size);
+    return size;
+}
+
+int64_t VulkanHostMappedBitstreamBuffer::CopyDataToBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& dstBuffer,
+                                                          VkDeviceSize dstOffset,
+                                                          VkDeviceSize srcOffset, VkDeviceSize size) const
+{
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* readData = CheckAccess(srcOffset, size);
+    if (readData == nullptr) {
+        assert(!"Could not CopyDataToBuffer!");
+        return -1;
+    }
+    return dstBuffer->CopyDataFromBuffer(readData, 0, dstOffset, size);
+}
+
+int64_t VulkanHostMappedBitstreamBuffer::CopyDataFromBuffer(const uint8_t *sourceBuffer, VkDeviceSize srcOffset,
+                                                            VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    // The parser appending input that is already in place
+    if (((sourceBuffer + srcOffset) == (m_pData + dstOffset)) && (CheckAccess(dstOffset, size) != nullptr)) {
+        return size;
+    }
+    assert(!"Can't write to a host mapped bitstream buffer!");
+    return -1;
+}
+
+int64_t VulkanHostMappedBitstreamBuffer::CopyDataFromBuffer(const VkSharedBaseObj<VulkanBitstreamBuffer>& sourceBuffer,
+                                                            VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* readData = sourceBuffer->GetReadOnlyDataPtr(srcOffset, size);
+    if (readData == nullptr) {
+        assert(!"Could not CopyDataFromBuffer!");
+        return -1;
+    }
+    return CopyDataFromBuffer(readData, 0, dstOffset, size);
+}
+
+uint8_t* VulkanHostMappedBitstreamBuffer::GetDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize)
+{
+    // The data is read-only, see VulkanBitstreamBufferStream::SetSliceStartCodeAtOffset()
+    return const_cast<uint8_t*>(GetReadOnlyDataPtr(offset, maxSize));
+}
+
+const uint8_t* VulkanHostMappedBitstreamBuffer::GetReadOnlyDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize) const
+{
+    const uint8_t* readData = CheckAccess(offset, 1);
+    if (readData == nullptr) {
+        assert(!"Could not GetReadOnlyDataPtr()!");
+        return nullptr;
+    }
+    maxSize = m_dataSize - offset;
+    return readData;
+}
+
+uint32_t VulkanHostMappedBitstreamBuffer::AddStreamMarker(uint32_t streamOffset)
+{
+    m_streamMarkers.push_back(streamOffset + (uint32_t)m_dataOffset);
+    return (uint32_t)(m_streamMarkers.size() - 1);
+}
+
+uint32_t VulkanHostMappedBitstreamBuffer::SetStreamMarker(uint32_t streamOffset, uint32_t index)
+{
+    assert(index < (uint32_t)m_streamMarkers.size());
+    if (!(index < (uint32_t)m_streamMarkers.size())) {
+        return uint32_t(-1);
+    }
+    m_streamMarkers[index] = streamOffset + (uint32_t)m_dataOffset;
+    return index;
+}
+
+uint32_t VulkanHostMappedBitstreamBuffer::GetStreamMarker(uint32_t index) const
+{
+    assert(index < (uint32_t)m_streamMarkers.size());
+    return m_streamMarkers[index] - (uint32_t)m_dataOffset;
+}
+
+uint32_t VulkanHostMappedBitstreamBuffer::GetStreamMarkersCount() const
+{
+    return (uint32_t)m_streamMarkers.size();
+}
+
+const uint32_t* VulkanHostMappedBitstreamBuffer::GetStreamMarkersPtr(uint32_t startIndex, uint32_t& maxCount) const
+{
+    maxCount = (uint32_t)m_streamMarkers.size() - startIndex;
+    return m_streamMarkers.data() + startIndex;
+}
+
+uint32_t VulkanHostMappedBitstreamBuffer::ResetStreamMarkers()
+{
+    uint32_t oldSize = (uint32_t)m_streamMarkers.size();
+    m_streamMarkers.clear();
+    return oldSize;
+}
+
+VkResult
+VulkanHostMappedMemoryPool::Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex, VkDeviceSize blockSize,
+                                   VkSharedBaseObj<VulkanHostMappedMemoryPool>& hostMappedMemoryPool)
+{
+    VkSharedBaseObj<VulkanHostMappedMemoryPool> memoryPool(new VulkanHostMappedMemoryPool(vkDevCtx, queueFamilyIndex,
+                                                                                          blockSize));
+    if (!memoryPool) {
+        assert(!"Out of host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = memoryPool->AddBlock(blockSize);
+    if (result == VK_SUCCESS) {
+        hostMappedMemoryPool = memoryPool;
+    }
+
+    return result;
+}
+
+VkResult VulkanHostMappedMemoryPool::AddBlock(VkDeviceSize size)
+{
+    // A power of two in size, at least the block size
+    VkDeviceSize blockSize = std::max<VkDeviceSize>(m_blockSize, 1);
+    while (blockSize < size) {
+        blockSize <<= 1;
+    }
+
+    Block block;
+    VkResult result = VulkanHostMappedMemory::Create(m_vkDevCtx, m_queueFamilyIndex, blockSize, block.memory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    block.usedSize = 0;
+    m_blocks.push_back(block);
+    m_currentBlock = (uint32_t)(m_blocks.size() - 1);
+    return VK_SUCCESS;
+}
+
+uint8_t* VulkanHostMappedMemoryPool::Allocate(VkDeviceSize size, VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool found = (m_currentBlock < m_blocks.size()) &&
+                 ((m_blocks[m_currentBlock].usedSize + size) <= m_blocks[m_currentBlock].memory->GetDataSize());
+
+    // Else the first block large enough that nothing else references anymore
+    for (uint32_t i = 0; !found && (i < m_blocks.size()); i++) {
+        if ((m_blocks[i].memory->GetRefCount() == 1) && (size <= m_blocks[i].memory->GetDataSize())) {
+            m_blocks[i].usedSize = 0;
+            m_currentBlock = i;
+            found = true;
+        }
+    }
+
+    if (!found && ((m_blocks.size() >= MAX_BLOCKS) || (AddBlock(size) != VK_SUCCESS))) {
+        return nullptr;
+    }
+
+    Block& block = m_blocks[m_currentBlock];
+    uint8_t* pData = block.memory->GetDataPtr() + block.usedSize;
+    block.usedSize += size;
+    hostMappedMemory = block.memory;
+    return pData;
+}
+
+bool VulkanHostMappedMemoryPool::FindMemory(const uint8_t* pData, VkDeviceSize size,
+                                            VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const Block& block : m_blocks) {
+        if (block.memory->Contains(pData, size)) {
+            hostMappedMemory = block.memory;
+            return true;
+        }
+    }
+    return false;
+}
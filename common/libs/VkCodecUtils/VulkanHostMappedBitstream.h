@@ -0,0 +1,291 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANHOSTMAPPEDBITSTREAM_H_
+#define _VKCODECUTILS_VULKANHOSTMAPPEDBITSTREAM_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanBitstreamBuffer.h"
+
+// A host memory range (e.g. a memory mapped input file) imported with VK_EXT_external_memory_host
+// into a single buffer, a video decode source by default. The memory must stay valid for the lifetime of this object.
+class VulkanHostMappedMemory : public VkVideoRefCountBase
+{
+public:
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex,
+                           const uint8_t* pData, VkDeviceSize dataSize,
+                           VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory,
+                           VkBufferUsageFlags usage = VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR);
+
+    // Allocates the host memory to import itself, for the data to be written to it with GetDataPtr()
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex,
+                           VkDeviceSize dataSize,
+                           VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the memory if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    virtual int32_t GetRefCount()
+    {
+        assert(m_refCount > 0);
+        return m_refCount;
+    }
+
+    bool Contains(const uint8_t* pData, VkDeviceSize size) const
+    {
+        return (pData >= m_pData) && (pData < (m_pData + m_dataSize)) &&
+               (size <= (VkDeviceSize)((m_pData + m_dataSize) - pData));
+    }
+
+    // Offset of pData in the imported buffer
+    VkDeviceSize GetBufferOffset(const uint8_t* pData) const
+    {
+        assert(Contains(pData, 0));
+        return m_dataBufferOffset + (VkDeviceSize)(pData - m_pData);
+    }
+
+    // Bytes of the imported range available from pData on
+    VkDeviceSize GetMaxSize(const uint8_t* pData) const
+    {
+        assert(Contains(pData, 0));
+        return (VkDeviceSize)((m_pData + m_dataSize) - pData);
+    }
+
+    // nullptr unless the memory was allocated by this object
+    uint8_t* GetDataPtr() const { return m_allocation.empty() ? nullptr : const_cast<uint8_t*>(m_pData); }
+    VkDeviceSize GetDataSize() const { return m_dataSize; }
+
+    const VulkanDeviceContext* GetDeviceContext() const { return m_vkDevCtx; }
+    uint32_t GetQueueFamilyIndex() const { return m_queueFamilyIndex; }
+    VkBuffer GetBuffer() const { return m_buffer; }
+    VkDeviceMemory GetDeviceMemory() const { return m_deviceMemory; }
+
+private:
+
+    VulkanHostMappedMemory(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex)
+        : m_refCount(0)
+        , m_vkDevCtx(vkDevCtx)
+        , m_queueFamilyIndex(queueFamilyIndex)
+        , m_buffer()
+        , m_deviceMemory()
+        , m_pData()
+        , m_dataSize()
+        , m_dataBufferOffset()
+        , m_allocation() { }
+
+    static VkDeviceSize GetImportAlignment(const VulkanDeviceContext* vkDevCtx);
+
+    VkResult Initialize(const uint8_t* pData, VkDeviceSize dataSize,
+                        VkBufferUsageFlags usage = VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR);
+
+    void Deinitialize();
+
+    virtual ~VulkanHostMappedMemory() { Deinitialize(); }
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    const VulkanDeviceContext* m_vkDevCtx;
+    uint32_t                   m_queueFamilyIndex;
+    VkBuffer                   m_buffer;
+    VkDeviceMemory             m_deviceMemory;
+    const uint8_t*             m_pData;
+    VkDeviceSize               m_dataSize;
+    VkDeviceSize               m_dataBufferOffset; // m_pData less the import base, aligned down
+    std::vector<uint8_t>       m_allocation;       // the memory m_pData is aligned in, if allocated here
+};
+
+// A read-only bitstream buffer referencing the data of a VulkanHostMappedMemory in place, from a given
+// pointer to the end of the imported range. The decode source range starts at GetBufferOffset(), aligned
+// down to the bitstream buffer offset alignment, and the stream markers are kept relative to it.
+// Writes are only accepted when they would not change the data, Resize() and Clone() move the data
+// into a regular VulkanBitstreamBufferImpl.
+class VulkanHostMappedBitstreamBuffer : public VulkanBitstreamBuffer
+{
+public:
+
+    static VkResult Create(VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory, const uint8_t* pData,
+                           VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment,
+                           VkSharedBaseObj<VulkanHostMappedBitstreamBuffer>& vulkanBitstreamBuffer);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the buffer if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    virtual int32_t GetRefCount()
+    {
+        assert(m_refCount > 0);
+        return m_refCount;
+    }
+
+    virtual VkDeviceSize GetMaxSize() const { return m_dataSize; }
+    virtual VkDeviceSize GetOffsetAlignment() const { return m_bufferOffsetAlignment; }
+    virtual VkDeviceSize GetSizeAlignment() const { return m_bufferSizeAlignment; }
+    virtual VkDeviceSize Resize(VkDeviceSize newSize, VkDeviceSize copySize = 0, VkDeviceSize copyOffset = 0);
+    virtual VkDeviceSize Clone(VkDeviceSize newSize, VkDeviceSize copySize, VkDeviceSize copyOffset,
+                               VkSharedBaseObj<VulkanBitstreamBuffer>& vulkanBitstreamBuffer);
+
+    virtual int64_t  MemsetData(uint32_t value, VkDeviceSize offset, VkDeviceSize size);
+    virtual int64_t  CopyDataToBuffer(uint8_t *dstBuffer, VkDeviceSize dstOffset,
+                                      VkDeviceSize srcOffset, VkDeviceSize size) const;
+    virtual int64_t  CopyDataToBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& dstBuffer, VkDeviceSize dstOffset,
+                                      VkDeviceSize srcOffset, VkDeviceSize size) const;
+    virtual int64_t  CopyDataFromBuffer(const uint8_t *sourceBuffer, VkDeviceSize srcOffset,
+                                        VkDeviceSize dstOffset, VkDeviceSize size);
+    virtual int64_t  CopyDataFromBuffer(const VkSharedBaseObj<VulkanBitstreamBuffer>& sourceBuffer, VkDeviceSize srcOffset,
+                                        VkDeviceSize dstOffset, VkDeviceSize size);
+    virtual uint8_t* GetDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize);
+    virtual const uint8_t* GetReadOnlyDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize) const;
+
+    // The imported memory is never written through this buffer, nothing to flush or invalidate.
+    virtual void FlushRange(VkDeviceSize offset, VkDeviceSize size) const { }
+    virtual void InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const { }
+
+    virtual VkBuffer GetBuffer() const { return m_hostMappedMemory->GetBuffer(); }
+    virtual VkDeviceMemory GetDeviceMemory() const { return m_hostMappedMemory->GetDeviceMemory(); }
+    virtual VkDeviceSize GetBufferOffset() const { return m_bufferOffset; }
+    virtual VkDeviceSize GetDataOffset() const { return m_dataOffset; }
+
+    virtual uint32_t  AddStreamMarker(uint32_t streamOffset);
+    virtual uint32_t  SetStreamMarker(uint32_t streamOffset, uint32_t index);
+    virtual uint32_t  GetStreamMarker(uint32_t index) const;
+    virtual uint32_t  GetStreamMarkersCount() const;
+    virtual const uint32_t* GetStreamMarkersPtr(uint32_t startIndex, uint32_t& maxCount) const;
+    virtual uint32_t  ResetStreamMarkers();
+
+private:
+
+    VulkanHostMappedBitstreamBuffer(VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory,
+                                    VkDeviceSize bufferOffsetAlignment,
+                                    VkDeviceSize bufferSizeAlignment)
+        : VulkanBitstreamBuffer()
+        , m_refCount(0)
+        , m_hostMappedMemory(hostMappedMemory)
+        , m_pData()
+        , m_dataSize()
+        , m_bufferOffset()
+        , m_dataOffset()
+        , m_bufferOffsetAlignment(bufferOffsetAlignment)
+        , m_bufferSizeAlignment(bufferSizeAlignment)
+        , m_streamMarkers() { m_streamMarkers.reserve(256); }
+
+    const uint8_t* CheckAccess(VkDeviceSize offset, VkDeviceSize size) const;
+
+    virtual ~VulkanHostMappedBitstreamBuffer() { }
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    VkSharedBaseObj<VulkanHostMappedMemory> m_hostMappedMemory;
+    const uint8_t*             m_pData;
+    VkDeviceSize               m_dataSize;
+    VkDeviceSize               m_bufferOffset;
+    VkDeviceSize               m_dataOffset;
+    VkDeviceSize               m_bufferOffsetAlignment;
+    VkDeviceSize               m_bufferSizeAlignment;
+    std::vector<uint32_t>      m_streamMarkers;  // relative to m_bufferOffset
+};
+
+// Blocks of host memory allocated and imported once, for a producer thread (e.g. a demuxer) to write the decoder
+// input to them and the decoder to reference it in place. The allocations from a block follow each other without
+// a gap, so consecutive ones form a contiguous stream, and a block is only reused once the pool is the last one
+// referencing it: the bitstream buffers referencing a block keep it until their decode is complete.
+class VulkanHostMappedMemoryPool : public VkVideoRefCountBase
+{
+public:
+    enum { MAX_BLOCKS = 32 };
+
+    // Fails if the device can't import host memory, the first block is allocated up-front to find out
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex, VkDeviceSize blockSize,
+                           VkSharedBaseObj<VulkanHostMappedMemoryPool>& hostMappedMemoryPool);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the pool if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns size bytes of a block, valid while the block is referenced, or nullptr if all the blocks are in use.
+    // Thread safe.
+    uint8_t* Allocate(VkDeviceSize size, VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory);
+
+    // The block of data returned by Allocate(). Thread safe.
+    bool FindMemory(const uint8_t* pData, VkDeviceSize size, VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory);
+
+private:
+    struct Block {
+        VkSharedBaseObj<VulkanHostMappedMemory> memory;
+        VkDeviceSize                            usedSize;
+    };
+
+    VulkanHostMappedMemoryPool(const VulkanDeviceContext* vkDevCtx, uint32_t queueFamilyIndex, VkDeviceSize blockSize)
+        : m_refCount(0)
+        , m_vkDevCtx(vkDevCtx)
+        , m_queueFamilyIndex(queueFamilyIndex)
+        , m_blockSize(blockSize)
+        , m_blocks()
+        , m_currentBlock(0)
+        , m_mutex() { }
+
+    VkResult AddBlock(VkDeviceSize size);
+
+    virtual ~VulkanHostMappedMemoryPool() { }
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    const VulkanDeviceContext* m_vkDevCtx;
+    uint32_t                   m_queueFamilyIndex;
+    VkDeviceSize               m_blockSize;
+    std::vector<Block>         m_blocks;
+    uint32_t                   m_currentBlock; // the block of the last allocation
+    std::mutex                 m_mutex;
+};
+
+#endif /* _VKCODECUTILS_VULKANHOSTMAPPEDBITSTREAM_H_ */
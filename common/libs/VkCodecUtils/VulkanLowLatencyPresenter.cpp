@@ -0,0 +1,205 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "VkCodecUtils/VkFrameLatency.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VulkanVideoUtils.h"
+#include "VkCodecUtils/VulkanLowLatencyPresenter.h"
+
+// Until the refresh cycle of the display is known, 60 Hz
+static const int64_t defaultRefreshDurationNs = 1000000000LL / 60;
+// The margin of a frame for its render on the device, and the latch of its present by the display engine
+static const int64_t initialMarginNs = 2000000LL;
+// Grown by a missed refresh, up to half of the refresh cycle
+static const int64_t marginStepNs = 500000LL;
+
+VulkanLowLatencyPresenter::VulkanLowLatencyPresenter()
+    : m_vkDevCtx(nullptr)
+    , m_swapchain(VK_NULL_HANDLE)
+    , m_vkWaitForPresentKHR(nullptr)
+    , m_refreshDurationNs(defaultRefreshDurationNs)
+    , m_refreshLocked(false)
+    , m_presentId(0)
+    , m_pendingFrameId(-1)
+    , m_frameStartNs(0)
+    , m_frameWorkNs(0)
+    , m_marginNs(initialMarginNs)
+    , m_lastDisplayTimeNs(0)
+    , m_numFrames(0)
+    , m_numLatencies(0)
+    , m_numMissedRefreshes(0)
+    , m_sumLatencyNs(0.0)
+    , m_maxLatencyNs(0)
+{
+}
+
+VulkanLowLatencyPresenter::~VulkanLowLatencyPresenter()
+{
+    DetachSwapchain();
+}
+
+int64_t VulkanLowLatencyPresenter::NowNanoseconds()
+{
+    return (int64_t)VkTrace::NowNs();
+}
+
+void VulkanLowLatencyPresenter::AttachSwapchain(const VulkanDeviceContext* vkDevCtx, VkSwapchainKHR swapchain,
+                                                int64_t refreshDurationNs, bool refreshLocked)
+{
+    m_vkDevCtx = vkDevCtx;
+    m_swapchain = swapchain;
+    m_refreshLocked = refreshLocked;
+    m_vkWaitForPresentKHR = nullptr;
+    if (m_vkDevCtx->GetPresentWaitSupport()) {
+        m_vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                m_vkDevCtx->GetDeviceProcAddr(m_vkDevCtx->getDevice(), "vkWaitForPresentKHR"));
+    }
+
+    m_refreshDurationNs = defaultRefreshDurationNs;
+    if (refreshDurationNs > 0) {
+        m_refreshDurationNs = refreshDurationNs;
+    } else if (m_vkDevCtx->FindRequiredDeviceExtension(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) != nullptr) {
+        vulkanVideoUtils::VulkanDisplayTiming displayTiming(m_vkDevCtx);
+        uint64_t displayRefreshDurationNs = 0;
+        if (displayTiming.DisplayTimingIsEnabled() &&
+                (displayTiming.GetRefreshCycle(*m_vkDevCtx, m_swapchain, &displayRefreshDurationNs) == VK_SUCCESS) &&
+                (displayRefreshDurationNs > 0)) {
+            m_refreshDurationNs = (int64_t)displayRefreshDurationNs;
+        }
+    }
+
+    // The present ids of the old swapchain are not waited on with the new one
+    m_presentId = 0;
+    m_pendingFrameId = -1;
+    m_lastDisplayTimeNs = 0;
+
+    std::cout << "Low latency presentation: " << (m_refreshLocked ? "locked to the refresh of " : "unlocked, ")
+              << (1000000000.0 / m_refreshDurationNs) << " Hz, "
+              << (m_vkWaitForPresentKHR ? "frames started just in time with the present waits" :
+                                          "without the present waits, the latency is to the present")
+              << std::endl;
+}
+
+void VulkanLowLatencyPresenter::DetachSwapchain()
+{
+    m_vkWaitForPresentKHR = nullptr;
+    m_swapchain = VK_NULL_HANDLE;
+}
+
+void VulkanLowLatencyPresenter::WaitForFrameStart()
+{
+    if ((m_vkWaitForPresentKHR != nullptr) && (m_presentId != 0)) {
+        const VkResult result = m_vkWaitForPresentKHR(*m_vkDevCtx, m_swapchain, m_presentId, PRESENT_WAIT_TIMEOUT_NS);
+        const int64_t nowNs = NowNanoseconds();
+        if (result == VK_SUCCESS) {
+            OnDisplayed(nowNs);
+
+            if (m_refreshLocked) {
+                // Rendered and presented just before the refresh after the one the previous frame is shown at
+                const int64_t startNs = nowNs + m_refreshDurationNs - m_frameWorkNs - m_marginNs;
+                const int64_t waitNs = startNs - nowNs;
+                if (waitNs > 0) {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+                }
+            }
+        }
+    }
+    m_frameStartNs = NowNanoseconds();
+}
+
+const void* VulkanLowLatencyPresenter::PreparePresent(const void* pNext, VkPresentIdKHR& presentIdInfo,
+                                                      uint64_t& presentId)
+{
+    if (m_vkWaitForPresentKHR == nullptr) {
+        return pNext;
+    }
+
+    presentId = ++m_presentId;
+    presentIdInfo = VkPresentIdKHR();
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.pNext = pNext;
+    presentIdInfo.swapchainCount = 1;
+    presentIdInfo.pPresentIds = &presentId;
+    return &presentIdInfo;
+}
+
+void VulkanLowLatencyPresenter::OnPresented(int64_t frameId)
+{
+    m_numFrames++;
+    const int64_t nowNs = NowNanoseconds();
+
+    // A longer frame is followed at once, a shorter one slowly
+    const int64_t workNs = nowNs - m_frameStartNs;
+    if (workNs > m_frameWorkNs) {
+        m_frameWorkNs = workNs;
+    } else {
+        m_frameWorkNs += (workNs - m_frameWorkNs) / 16;
+    }
+
+    if (m_vkWaitForPresentKHR != nullptr) {
+        m_pendingFrameId = frameId;
+    } else if (frameId >= 0) {
+        AddLatency(frameId, nowNs);
+    }
+}
+
+void VulkanLowLatencyPresenter::OnDisplayed(int64_t displayTimeNs)
+{
+    if (m_refreshLocked && (m_lastDisplayTimeNs != 0) &&
+            ((displayTimeNs - m_lastDisplayTimeNs) > (m_refreshDurationNs + m_refreshDurationNs / 2))) {
+        // The frame missed the refresh it was started for
+        m_numMissedRefreshes++;
+        m_marginNs = std::min(m_marginNs + marginStepNs, m_refreshDurationNs / 2);
+    }
+    m_lastDisplayTimeNs = displayTimeNs;
+
+    if (m_pendingFrameId >= 0) {
+        VkFrameLatency::Record(VK_FRAME_LATENCY_DISPLAYED, (uint64_t)m_pendingFrameId, (uint64_t)displayTimeNs);
+        AddLatency(m_pendingFrameId, displayTimeNs);
+        m_pendingFrameId = -1;
+    }
+}
+
+void VulkanLowLatencyPresenter::AddLatency(int64_t frameId, int64_t timeNs)
+{
+    const int64_t inputTimeNs = (int64_t)VkFrameLatency::GetPointTime(VK_FRAME_LATENCY_DEMUXED, (uint64_t)frameId);
+    if ((inputTimeNs == 0) || (inputTimeNs > timeNs)) {
+        return;
+    }
+    const int64_t latencyNs = timeNs - inputTimeNs;
+    m_numLatencies++;
+    m_sumLatencyNs += (double)latencyNs;
+    m_maxLatencyNs = std::max(m_maxLatencyNs, latencyNs);
+    VK_LOG_INFO("\t\tFrame %lld: input to %s %.3f ms\n", (long long)frameId,
+                (m_vkWaitForPresentKHR != nullptr) ? "photon" : "present", latencyNs / 1000000.0);
+}
+
+void VulkanLowLatencyPresenter::PrintStats() const
+{
+    std::cout << "Low latency presentation: " << m_numFrames << " frames presented, " << m_numMissedRefreshes
+              << " missed refreshes, " << (m_frameWorkNs / 1000000.0) << " ms per frame, "
+              << (m_marginNs / 1000000.0) << " ms margin";
+    if (m_numLatencies > 0) {
+        std::cout << ", input to " << (m_vkWaitForPresentKHR ? "photon" : "present") << " latency mean "
+                  << (m_sumLatencyNs / m_numLatencies / 1000000.0) << " ms, max " << (m_maxLatencyNs / 1000000.0)
+                  << " ms of " << m_numLatencies << " frames";
+    }
+    std::cout << std::endl;
+}
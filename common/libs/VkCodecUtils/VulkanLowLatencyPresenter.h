@@ -0,0 +1,81 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANLOWLATENCYPRESENTER_H_
+#define _VKCODECUTILS_VULKANLOWLATENCYPRESENTER_H_
+
+#include <stdint.h>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// Presents the frames with the least latency from their input to the display, for a swapchain of 2 images. With
+// VK_KHR_present_wait each frame waits for the previous one to reach the display, which is the refresh it is locked
+// to with the FIFO present mode, then on the host until it is due to be rendered just in time for the next refresh:
+// the frame it takes from the decoder is the newest one, and it doesn't wait in the swapchain. The time the frames
+// take from their start to their present is followed, with a margin grown by the refreshes they miss. The time the
+// present wait returns is taken as the time the frame is displayed, its latency from the demux of its bitstream is
+// reported per frame. Without the present waits the latency is to the present instead. The times are in nanoseconds
+// of std::chrono::steady_clock, the one of VkFrameLatency.
+class VulkanLowLatencyPresenter
+{
+public:
+    VulkanLowLatencyPresenter();
+    ~VulkanLowLatencyPresenter();
+
+    // Called for each new swapchain, with the refresh duration of the display mode, 0 when it is not known.
+    // Refresh locked with the FIFO present mode, otherwise the frames are presented as soon as they are rendered.
+    void AttachSwapchain(const VulkanDeviceContext* vkDevCtx, VkSwapchainKHR swapchain,
+                         int64_t refreshDurationNs, bool refreshLocked);
+    void DetachSwapchain();
+
+    // Before the acquire of the image of the next frame, waits for the previous present to be displayed and for the
+    // start of the frame to make the next refresh
+    void WaitForFrameStart();
+
+    // Before the present of the frame, returns the pNext of VkPresentInfoKHR to its present id in presentIdInfo
+    const void* PreparePresent(const void* pNext, VkPresentIdKHR& presentIdInfo, uint64_t& presentId);
+    // After the present, with the decode order of the frame presented, -1 without one
+    void OnPresented(int64_t frameId);
+
+    // The input to photon latency of the frames and the refreshes they missed
+    void PrintStats() const;
+
+private:
+    static int64_t NowNanoseconds();
+    void OnDisplayed(int64_t displayTimeNs);
+    void AddLatency(int64_t frameId, int64_t timeNs);
+
+private:
+    enum { PRESENT_WAIT_TIMEOUT_NS = 100 * 1000 * 1000 };
+
+    const VulkanDeviceContext* m_vkDevCtx;
+    VkSwapchainKHR             m_swapchain;
+    PFN_vkWaitForPresentKHR    m_vkWaitForPresentKHR; // with the presentWait feature
+    int64_t                    m_refreshDurationNs;
+    bool                       m_refreshLocked;
+    uint64_t                   m_presentId;           // of the last present
+    int64_t                    m_pendingFrameId;      // presented and not displayed yet, -1 without one
+    int64_t                    m_frameStartNs;
+    int64_t                    m_frameWorkNs;         // from the start of a frame to its present, decaying max
+    int64_t                    m_marginNs;            // for the render of the frame on the device
+    int64_t                    m_lastDisplayTimeNs;
+    uint64_t                   m_numFrames;
+    uint64_t                   m_numLatencies;
+    uint64_t                   m_numMissedRefreshes;
+    double                     m_sumLatencyNs;
+    int64_t                    m_maxLatencyNs;
+};
+
+#endif /* _VKCODECUTILS_VULKANLOWLATENCYPRESENTER_H_ */
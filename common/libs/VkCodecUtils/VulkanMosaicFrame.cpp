@@ -0,0 +1,597 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "VkCodecUtils/Helpers.h"
+#include "VkShell/Shell.h"
+#include "VkCodecUtils/VulkanMosaicFrame.h"
+#include <nvidia_utils/vulkan/ycbcrvkinfo.h>
+
+static const uint64_t frameWaitTimeout = 100 * 1000 * 1000; /* 100 mSec */
+
+// The background of the tiles and of their letterbox
+static const VkClearColorValue mosaicClearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+VkResult VulkanMosaicFrame::Create(const VulkanDeviceContext* vkDevCtx,
+                                   std::vector<VkSharedBaseObj<VulkanVideoRenderQueue>>& channelQueues,
+                                   VkSharedBaseObj<VulkanMosaicFrame>& mosaicFrame)
+{
+    if (channelQueues.empty()) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VulkanMosaicFrame> vkMosaicFrame(new VulkanMosaicFrame(vkDevCtx, channelQueues));
+    if (vkMosaicFrame) {
+        mosaicFrame = vkMosaicFrame;
+        return VK_SUCCESS;
+    }
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+VulkanMosaicFrame::VulkanMosaicFrame(const VulkanDeviceContext* vkDevCtx,
+                                     std::vector<VkSharedBaseObj<VulkanVideoRenderQueue>>& channelQueues)
+    : FrameProcessor(false)
+    , m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_channels()
+    , m_retiredFrames()
+    , m_pendingWaitSemaphores()
+    , m_samplerYcbcrModelConversion(VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709)
+    , m_samplerYcbcrRange(VK_SAMPLER_YCBCR_RANGE_ITU_NARROW)
+    , m_renderPass()
+    , m_vertexBuffer()
+    , m_renderInfo()
+    , m_imageSubmits()
+    , m_imageTileSerials()
+    , m_submitSerial(0)
+    , m_completedSubmit(0)
+    , m_columns(1)
+    , m_rows(1)
+    , m_extent()
+    , m_viewport()
+    , m_scissor()
+    , m_paused(false)
+{
+    for (VkSharedBaseObj<VulkanVideoRenderQueue>& channelQueue : channelQueues) {
+        std::unique_ptr<Channel> channel(new Channel());
+        channel->queue = channelQueue;
+        channel->drawContext.m_vkDevCtx = vkDevCtx;
+        channel->drawContext.contextIndex = (int32_t)m_channels.size();
+        m_channels.push_back(std::move(channel));
+    }
+}
+
+VulkanMosaicFrame::~VulkanMosaicFrame()
+{
+    // After the shell, the device is idle
+    ReleaseFrames();
+}
+
+int VulkanMosaicFrame::AttachShell(const Shell& sh)
+{
+    // position/texture coordinate pair per vertex, the quad is placed in its tile by the push constants.
+    static const vk::Vertex vertices[4] = {
+       //    Vertex         Texture coordinate
+        { {  1.0f,  1.0f }, { 1.0f, 1.0f }, },
+        { { -1.0f,  1.0f }, { 0.0f, 1.0f }, },
+        { { -1.0f, -1.0f }, { 0.0f, 0.0f }, },
+        { {  1.0f, -1.0f }, { 1.0f, 0.0f }, },
+    };
+
+    if (VK_SUCCESS != m_vertexBuffer.CreateVertexBuffer(m_vkDevCtx, (const float*)vertices, sizeof(vertices),
+                                                        sizeof(vertices) / sizeof(vertices[0]))) {
+
+        std::cerr << "VulkanMosaicFrame: " << "File " << __FILE__ << "line " << __LINE__;
+        return -1;
+    }
+
+    return 0;
+}
+
+void VulkanMosaicFrame::DetachShell()
+{
+    // The frames are returned to their decoders once the GPU is done with them
+    m_vkDevCtx->DeviceWaitIdle();
+    ReleaseFrames();
+    m_vertexBuffer.DestroyVertexBuffer();
+}
+
+void VulkanMosaicFrame::ReleaseFrames()
+{
+    ReleaseRetiredFrames(true);
+    for (std::unique_ptr<Channel>& channel : m_channels) {
+        channel->queue->ReleaseFrame(&channel->frame);
+        channel->frameSerial = 0;
+        channel->waitFrameComplete = false;
+    }
+    m_pendingWaitSemaphores.clear();
+}
+
+void VulkanMosaicFrame::LayoutTiles(const VkExtent2D& extent)
+{
+    m_extent = extent;
+
+    m_viewport.x = 0.0f;
+    m_viewport.y = 0.0f;
+    m_viewport.width = static_cast<float>(extent.width);
+    m_viewport.height = static_cast<float>(extent.height);
+    m_viewport.minDepth = 0.0f;
+    m_viewport.maxDepth = 1.0f;
+
+    m_scissor.offset = { 0, 0 };
+    m_scissor.extent = extent;
+
+    // The squarest grid holding all the channels, filled row by row
+    const uint32_t numChannels = (uint32_t)m_channels.size();
+    m_columns = (uint32_t)std::ceil(std::sqrt((double)numChannels));
+    m_rows = (numChannels + m_columns - 1) / m_columns;
+
+    for (uint32_t channelIndex = 0; channelIndex < numChannels; channelIndex++) {
+        const uint32_t column = channelIndex % m_columns;
+        const uint32_t row = channelIndex / m_columns;
+        const uint32_t x0 = (column * extent.width) / m_columns;
+        const uint32_t x1 = ((column + 1) * extent.width) / m_columns;
+        const uint32_t y0 = (row * extent.height) / m_rows;
+        const uint32_t y1 = ((row + 1) * extent.height) / m_rows;
+
+        VkRect2D& tile = m_channels[channelIndex]->tile;
+        tile.offset = { (int32_t)x0, (int32_t)y0 };
+        tile.extent = { x1 - x0, y1 - y0 };
+    }
+}
+
+int VulkanMosaicFrame::AttachSwapchain(const Shell& sh)
+{
+    const Shell::Context& ctx = sh.GetContext();
+
+    LayoutTiles(ctx.extent);
+
+    // The tiles not updated keep the content of the previous present of the image
+    VkResult result = m_renderPass.CreateRenderPass(m_vkDevCtx, ctx.format.format, true);
+    if (result != VK_SUCCESS) {
+        assert(!"ERROR: Could't create RenderPass!");
+        return -1;
+    }
+
+    // The framebuffers, the command buffers and the fences per swapchain image, the channels have their own
+    // samplers and pipelines
+    result = m_renderInfo.CreatePerDrawContexts(m_vkDevCtx,
+                                                ctx.swapchain,
+                                                &ctx.extent,
+                                                &m_viewport,
+                                                &m_scissor,
+                                                &ctx.format,
+                                                m_renderPass.getRenderPass());
+    if (result != VK_SUCCESS) {
+        assert(!"ERROR: Could't create rawContexts!");
+        return -1;
+    }
+
+    // The new images are cleared and all their tiles drawn
+    const uint32_t numImages = m_renderInfo.GetNumDrawContexts();
+    m_imageSubmits.assign(numImages, 0);
+    m_imageTileSerials.assign(numImages, std::vector<uint64_t>(m_channels.size(), 0));
+
+    // The pipelines are created for the new render pass
+    for (std::unique_ptr<Channel>& channel : m_channels) {
+        channel->pipelineFormat = VK_FORMAT_UNDEFINED;
+    }
+
+    // The old swapchain is idle, the frames retired before are not in use anymore
+    ReleaseRetiredFrames(true);
+
+    return 0;
+}
+
+void VulkanMosaicFrame::DetachSwapchain() { }
+
+bool VulkanMosaicFrame::OnKey(Key key)
+{
+    switch (key) {
+    case KEY_SHUTDOWN:
+    case KEY_ESC:
+        return false;
+    case KEY_SPACE:
+        // The tiles keep their last frame while paused
+        m_paused = !m_paused;
+        break;
+    default:
+        break;
+    }
+
+    return true;
+}
+
+VkResult VulkanMosaicFrame::WaitFrameComplete(const VulkanDecodedFrame& frame)
+{
+    // The binary semaphores are waited for by the submit drawing the frame
+    VkResult result = VK_SUCCESS;
+    if (frame.frameCompleteSemaphore != VkSemaphore()) {
+        return result;
+    }
+
+    if (frame.frameCompleteTimelineSemaphore != VkSemaphore()) {
+        const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                               &frame.frameCompleteTimelineSemaphore,
+                                               &frame.frameCompleteTimelineValue };
+        result = m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, frameWaitTimeout);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: WaitSemaphores() result: 0x%x\n", result);
+        }
+    } else if (frame.frameCompleteFence == VkFence()) {
+        VkQueue videoDecodeQueue = m_vkDevCtx->GetVideoDecodeQueue();
+        if (videoDecodeQueue != VkQueue()) {
+            result = m_vkDevCtx->QueueWaitIdle(videoDecodeQueue);
+            if (result != VK_SUCCESS) {
+                fprintf(stderr, "\nERROR: QueueWaitIdle() result: 0x%x\n", result);
+            }
+        }
+    } else {
+        result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &frame.frameCompleteFence, true, frameWaitTimeout);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: WaitForFences() result: 0x%x\n", result);
+        }
+    }
+    return result;
+}
+
+bool VulkanMosaicFrame::UpdateChannels()
+{
+    bool channelsActive = false;
+    for (uint32_t channelIndex = 0; channelIndex < (uint32_t)m_channels.size(); channelIndex++) {
+        Channel& channel = *m_channels[channelIndex];
+        if (channel.endOfStream) {
+            continue;
+        }
+        channelsActive = true;
+        if (m_paused) {
+            continue;
+        }
+
+        VulkanDecodedFrame frame;
+        bool endOfStream = false;
+        const int32_t numFrames = channel.queue->TryGetNextFrame(&frame, &endOfStream);
+        if (numFrames > 0) {
+            if (WaitFrameComplete(frame) != VK_SUCCESS) {
+                channel.queue->ReleaseFrame(&frame);
+                continue;
+            }
+
+            if (channel.frame.pictureIndex != -1) {
+                RetiredFrame retiredFrame;
+                retiredFrame.channel = channelIndex;
+                retiredFrame.frame = channel.frame;
+                retiredFrame.lastUseSubmit = channel.lastUseSubmit;
+                if (channel.waitFrameComplete) {
+                    // Replaced before being drawn, its semaphore is still waited for by the next submit
+                    m_pendingWaitSemaphores.push_back(channel.frame.frameCompleteSemaphore);
+                    retiredFrame.lastUseSubmit = m_submitSerial + 1;
+                }
+                m_retiredFrames.push_back(retiredFrame);
+            }
+
+            channel.frame = frame;
+            channel.frameSerial++;
+            channel.waitFrameComplete = (frame.frameCompleteSemaphore != VkSemaphore());
+            channel.numFrames++;
+        } else if (endOfStream && (numFrames < 0)) {
+            // The last frame stays in the tile
+            channel.endOfStream = true;
+        }
+    }
+    return channelsActive;
+}
+
+void VulkanMosaicFrame::ReleaseRetiredFrames(bool waitIdle)
+{
+    if (waitIdle) {
+        m_completedSubmit = m_submitSerial;
+    } else {
+        // The submits before the oldest one still pending on its image fence are complete
+        uint64_t completedSubmit = m_submitSerial;
+        for (uint32_t imageIndex = 0; imageIndex < (uint32_t)m_imageSubmits.size(); imageIndex++) {
+            if ((m_imageSubmits[imageIndex] == 0) || (m_imageSubmits[imageIndex] <= m_completedSubmit)) {
+                continue;
+            }
+            VkFence fence = m_renderInfo.GetDrawContext(imageIndex)->syncPrimitives.mFence;
+            if (m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, fence) != VK_SUCCESS) {
+                completedSubmit = std::min(completedSubmit, m_imageSubmits[imageIndex] - 1);
+            }
+        }
+        m_completedSubmit = std::max(m_completedSubmit, completedSubmit);
+    }
+
+    std::vector<RetiredFrame>::iterator it = m_retiredFrames.begin();
+    while (it != m_retiredFrames.end()) {
+        if (it->lastUseSubmit <= m_completedSubmit) {
+            // Sampled by the mosaic only, the decoder does not wait for a consumer signal
+            it->frame.hasConsummerSignalFence = false;
+            it->frame.hasConsummerSignalSemaphore = false;
+            m_channels[it->channel]->queue->ReleaseFrame(&it->frame);
+            it = m_retiredFrames.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+VkResult VulkanMosaicFrame::UpdateChannelPipeline(Channel& channel)
+{
+    vulkanVideoUtils::ImageResourceInfo inputImage(channel.frame.imageView, VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR);
+    if ((channel.pipelineFormat == inputImage.imageFormat) &&
+            (channel.drawContext.gfxPipeline.getPipeline() != VK_NULL_HANDLE)) {
+        return VK_SUCCESS;
+    }
+
+    const VkSamplerYcbcrConversionCreateInfo samplerYcbcrConversionCreateInfo = {
+        VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+        NULL,
+        inputImage.imageFormat,
+        m_samplerYcbcrModelConversion,
+        m_samplerYcbcrRange,
+#ifndef NV_RMAPI_TEGRA
+        { VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY },
+#else
+        { VK_COMPONENT_SWIZZLE_B,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_R,
+            VK_COMPONENT_SWIZZLE_IDENTITY },
+#endif
+        VK_CHROMA_LOCATION_MIDPOINT,
+        VK_CHROMA_LOCATION_MIDPOINT,
+        VK_FILTER_LINEAR,
+        false
+    };
+
+    VkResult result = m_renderInfo.UpdatePerDrawContexts(&channel.drawContext, &m_viewport, &m_scissor,
+                                                         m_renderPass.getRenderPass(), nullptr,
+                                                         &samplerYcbcrConversionCreateInfo);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: the pipeline of the mosaic channel %d result: 0x%x\n",
+                channel.drawContext.contextIndex, result);
+        return result;
+    }
+    channel.pipelineFormat = inputImage.imageFormat;
+    return result;
+}
+
+static void TransitionInputImage(const VulkanDeviceContext* vkDevCtx, VkCommandBuffer cmdBuffer,
+                                 const vulkanVideoUtils::ImageResourceInfo& inputImage,
+                                 VkImageLayout oldImageLayout, VkImageLayout newImageLayout,
+                                 VkPipelineStageFlags srcStages, VkPipelineStageFlags destStages)
+{
+    const VkMpFormatInfo* pFormatInfo = YcbcrVkFormatInfo(inputImage.imageFormat);
+    if (pFormatInfo == NULL) {
+        // Non-planar input image.
+        vulkanVideoUtils::setImageLayout(vkDevCtx, cmdBuffer, inputImage.image, oldImageLayout, newImageLayout,
+                                         srcStages, destStages, VK_IMAGE_ASPECT_COLOR_BIT);
+        return;
+    }
+    // Multi-planar input image.
+    for (uint32_t planeIndx = 0; (planeIndx < (uint32_t)pFormatInfo->planesLayout.numberOfExtraPlanes + 1); planeIndx++) {
+        vulkanVideoUtils::setImageLayout(vkDevCtx, cmdBuffer, inputImage.image, oldImageLayout, newImageLayout,
+                                         srcStages, destStages, (VK_IMAGE_ASPECT_PLANE_0_BIT_KHR << planeIndx));
+    }
+}
+
+VkResult VulkanMosaicFrame::RecordTiles(vulkanVideoUtils::VulkanPerDrawContext* pPerDrawContext,
+                                        uint32_t renderIndex, const std::vector<uint32_t>& drawnChannels)
+{
+    VkCommandBuffer cmdBuffer = *pPerDrawContext->commandBuffer.GetCommandBuffer();
+    const bool firstUse = (m_imageSubmits[renderIndex] == 0);
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = VkCommandBufferBeginInfo();
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult result = m_vkDevCtx->BeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    if (firstUse) {
+        // The render pass loads the image in the present layout
+        vulkanVideoUtils::setImageLayout(m_vkDevCtx, cmdBuffer, pPerDrawContext->frameBuffer.GetFbImage(),
+                                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+
+    for (uint32_t channelIndex : drawnChannels) {
+        vulkanVideoUtils::ImageResourceInfo inputImage(m_channels[channelIndex]->frame.imageView,
+                                                      VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR);
+        TransitionInputImage(m_vkDevCtx, cmdBuffer, inputImage,
+                             VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    VkRenderPassBeginInfo renderPassBeginInfo = VkRenderPassBeginInfo();
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.renderPass = m_renderPass.getRenderPass();
+    renderPassBeginInfo.framebuffer = pPerDrawContext->frameBuffer.GetFrameBuffer();
+    renderPassBeginInfo.renderArea = m_scissor;
+    m_vkDevCtx->CmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkClearAttachment clearAttachment = VkClearAttachment();
+    clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    clearAttachment.colorAttachment = 0;
+    clearAttachment.clearValue.color = mosaicClearColor;
+    if (firstUse) {
+        // The cells of the grid without a channel, and the channels without a frame yet
+        const VkClearRect clearRect = { m_scissor, 0, 1 };
+        m_vkDevCtx->CmdClearAttachments(cmdBuffer, 1, &clearAttachment, 1, &clearRect);
+    }
+
+    for (uint32_t channelIndex : drawnChannels) {
+        Channel& channel = *m_channels[channelIndex];
+        vulkanVideoUtils::ImageResourceInfo inputImage(channel.frame.imageView, VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR);
+
+        // The letterbox of the previous frame, the aspect ratio of the stream can change
+        const VkClearRect tileRect = { channel.tile, 0, 1 };
+        m_vkDevCtx->CmdClearAttachments(cmdBuffer, 1, &clearAttachment, 1, &tileRect);
+
+        const int32_t displayWidth = channel.frame.displayWidth ? channel.frame.displayWidth : inputImage.imageWidth;
+        const int32_t displayHeight = channel.frame.displayHeight ? channel.frame.displayHeight : inputImage.imageHeight;
+
+        // The frame scaled to fit the tile with its aspect ratio, centered
+        const float tileWidth = (float)channel.tile.extent.width;
+        const float tileHeight = (float)channel.tile.extent.height;
+        const float scale = std::min(tileWidth / displayWidth, tileHeight / displayHeight);
+        const float drawWidth = displayWidth * scale;
+        const float drawHeight = displayHeight * scale;
+        const float drawX = channel.tile.offset.x + ((tileWidth - drawWidth) / 2.0f);
+        const float drawY = channel.tile.offset.y + ((tileHeight - drawHeight) / 2.0f);
+
+        // From the [-1, 1] quad to the normalized device coordinates of the drawn rectangle
+        vk::TransformPushConstants constants;
+        constants.posMatrix[0] = vk::Vec4(drawWidth / m_extent.width, 0.0f, 0.0f, 0.0f);
+        constants.posMatrix[1] = vk::Vec4(0.0f, drawHeight / m_extent.height, 0.0f, 0.0f);
+        constants.posMatrix[3] = vk::Vec4(((2.0f * drawX + drawWidth) / m_extent.width) - 1.0f,
+                                          ((2.0f * drawY + drawHeight) / m_extent.height) - 1.0f, 0.0f, 1.0f);
+        // Without the padding of the decoded image
+        if (displayWidth != inputImage.imageWidth) {
+            constants.texMatrix[0] = vk::Vec2((float)displayWidth / inputImage.imageWidth, 0.0f);
+        }
+        if (displayHeight != inputImage.imageHeight) {
+            constants.texMatrix[1] = vk::Vec2(0.0f, (float)displayHeight / inputImage.imageHeight);
+        }
+
+        result = channel.drawContext.RecordDrawInputImage(cmdBuffer, &inputImage, constants, m_vertexBuffer);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    m_vkDevCtx->CmdEndRenderPass(cmdBuffer);
+
+    for (uint32_t channelIndex : drawnChannels) {
+        vulkanVideoUtils::ImageResourceInfo inputImage(m_channels[channelIndex]->frame.imageView,
+                                                      VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR);
+        TransitionInputImage(m_vkDevCtx, cmdBuffer, inputImage,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR);
+    }
+
+    return m_vkDevCtx->EndCommandBuffer(cmdBuffer);
+}
+
+bool VulkanMosaicFrame::OnFrame(int32_t            renderIndex,
+                                uint32_t           waitSemaphoreCount,
+                                const VkSemaphore* pWaitSemaphores,
+                                uint32_t           signalSemaphoreCount,
+                                const VkSemaphore* pSignalSemaphores)
+{
+    if (renderIndex < 0) {
+        renderIndex = -renderIndex;
+    }
+    vulkanVideoUtils::VulkanPerDrawContext* pPerDrawContext = m_renderInfo.GetDrawContext(renderIndex);
+    if (pPerDrawContext == nullptr) {
+        return false;
+    }
+
+    const bool channelsActive = UpdateChannels();
+    ReleaseRetiredFrames(false);
+
+    // The command buffer of the image is reused once its previous submit is complete
+    VkFence fence = pPerDrawContext->syncPrimitives.mFence;
+    VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &fence, true, frameWaitTimeout);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: WaitForFences() result: 0x%x\n", result);
+        return false;
+    }
+    result = m_vkDevCtx->ResetFences(*m_vkDevCtx, 1, &fence);
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    // Only the tiles with a newer frame than the one in this image are drawn
+    std::vector<uint32_t> drawnChannels;
+    std::vector<VkSemaphore> waitSemaphores;
+    if ((waitSemaphoreCount > 0) && (pWaitSemaphores != nullptr)) {
+        waitSemaphores.push_back(*pWaitSemaphores);
+    }
+    waitSemaphores.insert(waitSemaphores.end(), m_pendingWaitSemaphores.begin(), m_pendingWaitSemaphores.end());
+    for (uint32_t channelIndex = 0; channelIndex < (uint32_t)m_channels.size(); channelIndex++) {
+        Channel& channel = *m_channels[channelIndex];
+        if ((channel.frameSerial == 0) || (m_imageTileSerials[renderIndex][channelIndex] == channel.frameSerial)) {
+            continue;
+        }
+        if (UpdateChannelPipeline(channel) != VK_SUCCESS) {
+            continue;
+        }
+        drawnChannels.push_back(channelIndex);
+        if (channel.waitFrameComplete) {
+            waitSemaphores.push_back(channel.frame.frameCompleteSemaphore);
+        }
+    }
+
+    result = RecordTiles(pPerDrawContext, renderIndex, drawnChannels);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: the mosaic command buffer result: 0x%x\n", result);
+        return false;
+    }
+
+    // Submitted even without a new frame, the present waits for the render complete semaphore
+    const std::vector<VkPipelineStageFlags> waitStages(waitSemaphores.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    VkSubmitInfo submitInfo = VkSubmitInfo();
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+    submitInfo.pWaitSemaphores = waitSemaphores.empty() ? NULL : waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.empty() ? NULL : waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = pPerDrawContext->commandBuffer.GetCommandBuffer();
+    submitInfo.signalSemaphoreCount = ((signalSemaphoreCount > 0) && (pSignalSemaphores != nullptr)) ? 1 : 0;
+    submitInfo.pSignalSemaphores = submitInfo.signalSemaphoreCount ? pSignalSemaphores : NULL;
+
+    result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::GRAPHICS, 0, 1, &submitInfo, fence);
+    if (result != VK_SUCCESS) {
+        assert(result == VK_SUCCESS);
+        fprintf(stderr, "\nERROR: MultiThreadedQueueSubmit() result: 0x%x\n", result);
+        return false;
+    }
+
+    m_submitSerial++;
+    m_imageSubmits[renderIndex] = m_submitSerial;
+    m_pendingWaitSemaphores.clear();
+    for (uint32_t channelIndex : drawnChannels) {
+        Channel& channel = *m_channels[channelIndex];
+        channel.lastUseSubmit = m_submitSerial;
+        channel.waitFrameComplete = false;
+        channel.numTileDraws++;
+        m_imageTileSerials[renderIndex][channelIndex] = channel.frameSerial;
+    }
+
+    m_frameCount++;
+
+    // Once all the channels are at the end of their streams
+    return channelsActive;
+}
+
+void VulkanMosaicFrame::PrintStats() const
+{
+    std::cout << "Mosaic: " << m_channels.size() << " channels in a " << m_columns << "x" << m_rows
+              << " grid, " << m_frameCount << " presents" << std::endl;
+    for (uint32_t channelIndex = 0; channelIndex < (uint32_t)m_channels.size(); channelIndex++) {
+        const Channel& channel = *m_channels[channelIndex];
+        std::cout << "\tChannel " << channelIndex << ": " << channel.numFrames << " frames shown, "
+                  << channel.numTileDraws << " tile draws" << std::endl << "\t";
+        channel.queue->PrintStats();
+    }
+}
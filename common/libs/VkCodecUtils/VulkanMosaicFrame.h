@@ -0,0 +1,137 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANMOSAICFRAME_H_
+#define _VKCODECUTILS_VULKANMOSAICFRAME_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "VkCodecUtils/FrameProcessor.h"
+#include "VkCodecUtils/VulkanVideoRenderQueue.h"
+#include "VkCodecUtils/VulkanVideoUtils.h"
+
+// Presents the decoded frames of several channels tiled into a single swapchain, e.g. a 4x4 monitoring wall.
+// The channels are decoded on their own render threads, the newest frame of each is drawn into its tile with
+// the YCbCr sampler of its format, scaled to fit the tile with its aspect ratio. All the tiles are drawn in one
+// render pass that keeps the previous content of the swapchain image, and only the tiles whose channel produced
+// a new frame since the image was last presented are drawn again.
+class VulkanMosaicFrame : public FrameProcessor {
+public:
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           std::vector<VkSharedBaseObj<VulkanVideoRenderQueue>>& channelQueues,
+                           VkSharedBaseObj<VulkanMosaicFrame>& mosaicFrame);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the mosaic if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    virtual int AttachShell(const Shell& sh);
+    virtual void DetachShell();
+
+    virtual int AttachSwapchain(const Shell& sh);
+    virtual void DetachSwapchain();
+
+    virtual int CreateFrameData(int count) { return count; }
+    virtual void DestroyFrameData() {}
+
+    virtual bool OnKey(Key key);
+    virtual bool OnFrame(int32_t            renderIndex,
+                         uint32_t           waitSemaphoreCount = 0,
+                         const VkSemaphore* pWaitSemaphores  = nullptr,
+                         uint32_t           signalSemaphoreCount = 0,
+                         const VkSemaphore* pSignalSemaphores = nullptr);
+
+    // The frames presented and the tiles drawn per channel
+    void PrintStats() const;
+
+private:
+
+    struct Channel {
+        VkSharedBaseObj<VulkanVideoRenderQueue> queue;
+        vulkanVideoUtils::VulkanPerDrawContext  drawContext;     // the sampler and the pipeline of its format
+        VkFormat                                pipelineFormat;
+        VulkanDecodedFrame                      frame;           // the one shown, until a newer one replaces it
+        uint64_t                                frameSerial;     // of the frame shown, 0 before the first one
+        uint64_t                                lastUseSubmit;   // the last submit sampling the frame
+        bool                                    waitFrameComplete; // its binary semaphore is not waited for yet
+        bool                                    endOfStream;
+        VkRect2D                                tile;
+        uint64_t                                numFrames;
+        uint64_t                                numTileDraws;
+
+        Channel()
+            : queue(), drawContext(), pipelineFormat(VK_FORMAT_UNDEFINED), frame(), frameSerial(0)
+            , lastUseSubmit(0), waitFrameComplete(false), endOfStream(false), tile(), numFrames(0)
+            , numTileDraws(0) {}
+    };
+
+    // The frames replaced in their tile, released to their decoder once the submits sampling them are done
+    struct RetiredFrame {
+        uint32_t           channel;
+        VulkanDecodedFrame frame;
+        uint64_t           lastUseSubmit;
+    };
+
+    VulkanMosaicFrame(const VulkanDeviceContext* vkDevCtx,
+                      std::vector<VkSharedBaseObj<VulkanVideoRenderQueue>>& channelQueues);
+    virtual ~VulkanMosaicFrame();
+
+    void LayoutTiles(const VkExtent2D& extent);
+    bool UpdateChannels();
+    VkResult UpdateChannelPipeline(Channel& channel);
+    VkResult WaitFrameComplete(const VulkanDecodedFrame& frame);
+    void ReleaseRetiredFrames(bool waitIdle);
+    void ReleaseFrames();
+    VkResult RecordTiles(vulkanVideoUtils::VulkanPerDrawContext* pPerDrawContext, uint32_t renderIndex,
+                         const std::vector<uint32_t>& drawnChannels);
+
+private:
+    std::atomic<int32_t>                      m_refCount;
+    const VulkanDeviceContext*                m_vkDevCtx;
+    std::vector<std::unique_ptr<Channel>>     m_channels;
+    std::vector<RetiredFrame>                 m_retiredFrames;
+    std::vector<VkSemaphore>                  m_pendingWaitSemaphores; // of the frames retired before being drawn
+    VkSamplerYcbcrModelConversion             m_samplerYcbcrModelConversion;
+    VkSamplerYcbcrRange                       m_samplerYcbcrRange;
+    vulkanVideoUtils::VulkanRenderPass        m_renderPass;   // loads the previous content of the image
+    vulkanVideoUtils::VulkanVertexBuffer      m_vertexBuffer;
+    vulkanVideoUtils::VulkanRenderInfo        m_renderInfo;   // the framebuffers and the commands per image
+    std::vector<uint64_t>                     m_imageSubmits; // the last submit per swapchain image
+    std::vector<std::vector<uint64_t>>        m_imageTileSerials; // the frame serials drawn per image and tile
+    uint64_t                                  m_submitSerial;
+    uint64_t                                  m_completedSubmit;
+    uint32_t                                  m_columns;
+    uint32_t                                  m_rows;
+    VkExtent2D                                m_extent;
+    VkViewport                                m_viewport;
+    VkRect2D                                  m_scissor;
+    bool                                      m_paused;
+};
+
+#endif /* _VKCODECUTILS_VULKANMOSAICFRAME_H_ */
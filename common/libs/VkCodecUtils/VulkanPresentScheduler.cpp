@@ -0,0 +1,210 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "VkCodecUtils/VulkanVideoUtils.h"
+#include "VkCodecUtils/VulkanPresentScheduler.h"
+
+// Until the refresh cycle of the swapchain is known, 60 Hz
+static const int64_t defaultRefreshDurationNs = 1000000000LL / 60;
+// A frame to be shown later than that is taken as a jump of the PTS, e.g. a seek, and the pacing restarts from it
+static const int64_t maxScheduleAheadNs = 1000000000LL;
+
+VulkanPresentScheduler::VulkanPresentScheduler()
+    : m_vkDevCtx(nullptr)
+    , m_swapchain(VK_NULL_HANDLE)
+    , m_displayTiming()
+    , m_refreshDurationNs(defaultRefreshDurationNs)
+    , m_anchored(false)
+    , m_anchorPts(0)
+    , m_anchorTimeNs(0)
+    , m_lastPts(0)
+    , m_targetTimeNs(0)
+    , m_consecutiveDrops(0)
+    , m_presentId(0)
+    , m_numPresented(0)
+    , m_numDropped(0)
+    , m_numErrors(0)
+    , m_sumErrorNs(0.0)
+    , m_sumSquaredErrorNs(0.0)
+    , m_maxAbsErrorNs(0)
+    , m_pastTimings()
+{
+}
+
+VulkanPresentScheduler::~VulkanPresentScheduler()
+{
+    DetachSwapchain();
+}
+
+int64_t VulkanPresentScheduler::NowNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void VulkanPresentScheduler::AttachSwapchain(const VulkanDeviceContext* vkDevCtx, VkSwapchainKHR swapchain)
+{
+    m_vkDevCtx = vkDevCtx;
+    m_swapchain = swapchain;
+    m_displayTiming.reset();
+    m_refreshDurationNs = defaultRefreshDurationNs;
+
+    if (m_vkDevCtx->FindRequiredDeviceExtension(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) != nullptr) {
+        m_displayTiming.reset(new vulkanVideoUtils::VulkanDisplayTiming(m_vkDevCtx));
+        uint64_t refreshDurationNs = 0;
+        if (!m_displayTiming->DisplayTimingIsEnabled() ||
+                (m_displayTiming->GetRefreshCycle(*m_vkDevCtx, m_swapchain, &refreshDurationNs) != VK_SUCCESS)) {
+            m_displayTiming.reset();
+        } else if (refreshDurationNs > 0) {
+            m_refreshDurationNs = (int64_t)refreshDurationNs;
+        }
+    }
+
+    // The presents of the old swapchain are not matched with the new one
+    m_anchored = false;
+}
+
+void VulkanPresentScheduler::DetachSwapchain()
+{
+    m_displayTiming.reset();
+    m_swapchain = VK_NULL_HANDLE;
+}
+
+void VulkanPresentScheduler::Anchor(uint64_t pts, int64_t nowNs)
+{
+    // One refresh cycle for the frame to be rendered and queued
+    m_anchorPts = pts;
+    m_anchorTimeNs = nowNs + m_refreshDurationNs;
+    m_anchored = true;
+}
+
+bool VulkanPresentScheduler::ScheduleFrame(uint64_t timestamp)
+{
+    const int64_t nowNs = NowNanoseconds();
+
+    if (m_anchored && (timestamp == 0) && (m_lastPts == 0)) {
+        // A stream without PTS, the frames are shown as they come
+        m_targetTimeNs = 0;
+        return true;
+    }
+
+    if (!m_anchored || (timestamp < m_lastPts)) {
+        // The first frame, or a discontinuity of the stream, e.g. a loop
+        Anchor(timestamp, nowNs);
+    }
+    m_lastPts = timestamp;
+
+    // The PTS are in 100 ns units
+    int64_t targetTimeNs = m_anchorTimeNs + (int64_t)(timestamp - m_anchorPts) * 100;
+    if (targetTimeNs > (nowNs + maxScheduleAheadNs)) {
+        Anchor(timestamp, nowNs);
+        targetTimeNs = m_anchorTimeNs;
+    }
+
+    if ((targetTimeNs + m_refreshDurationNs) < nowNs) {
+        if (m_consecutiveDrops < MAX_CONSECUTIVE_DROPS) {
+            m_consecutiveDrops++;
+            m_numDropped++;
+            m_targetTimeNs = 0;
+            return false;
+        }
+        // Too far behind to catch up by dropping, the pacing restarts from this frame
+        Anchor(timestamp, nowNs);
+        targetTimeNs = m_anchorTimeNs;
+    }
+
+    m_consecutiveDrops = 0;
+    m_targetTimeNs = targetTimeNs;
+    return true;
+}
+
+const void* VulkanPresentScheduler::PreparePresent(const void* pNext, VkPresentTimesInfoGOOGLE& presentTimesInfo,
+                                                   VkPresentTimeGOOGLE& presentTime)
+{
+    m_numPresented++;
+    if (m_targetTimeNs == 0) {
+        return pNext;
+    }
+
+    // The image is shown at the first refresh after the time it is presented at, the closest one to the target
+    const int64_t presentAtNs = m_targetTimeNs - (m_refreshDurationNs / 2);
+
+    if (m_displayTiming) {
+        presentTime.presentID = ++m_presentId;
+        presentTime.desiredPresentTime = (uint64_t)presentAtNs;
+        presentTimesInfo = VkPresentTimesInfoGOOGLE();
+        presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+        presentTimesInfo.pNext = pNext;
+        presentTimesInfo.swapchainCount = 1;
+        presentTimesInfo.pTimes = &presentTime;
+        return &presentTimesInfo;
+    }
+
+    const int64_t waitNs = presentAtNs - NowNanoseconds();
+    if (waitNs > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(waitNs, maxScheduleAheadNs)));
+    }
+    return pNext;
+}
+
+void VulkanPresentScheduler::OnPresented()
+{
+    if (!m_displayTiming) {
+        // Estimated from the time the present is queued at, without the latency of the presentation engine
+        if (m_targetTimeNs != 0) {
+            AddPresentError(NowNanoseconds() - m_targetTimeNs);
+        }
+        return;
+    }
+
+    if (m_displayTiming->GetPastPresentationTiming(*m_vkDevCtx, m_swapchain, m_pastTimings) != VK_SUCCESS) {
+        return;
+    }
+    for (const VkPastPresentationTimingGOOGLE& timing : m_pastTimings) {
+        if ((timing.desiredPresentTime != 0) && (timing.actualPresentTime != 0)) {
+            const int64_t targetTimeNs = (int64_t)timing.desiredPresentTime + (m_refreshDurationNs / 2);
+            AddPresentError((int64_t)timing.actualPresentTime - targetTimeNs);
+        }
+    }
+}
+
+void VulkanPresentScheduler::AddPresentError(int64_t errorNs)
+{
+    m_numErrors++;
+    m_sumErrorNs += (double)errorNs;
+    m_sumSquaredErrorNs += (double)errorNs * (double)errorNs;
+    m_maxAbsErrorNs = std::max(m_maxAbsErrorNs, (int64_t)std::llabs(errorNs));
+}
+
+void VulkanPresentScheduler::PrintStats() const
+{
+    std::cout << "Presentation pacing: " << m_numPresented << " frames presented, " << m_numDropped
+              << " late frames dropped, refresh cycle " << (m_refreshDurationNs / 1000000.0) << " ms" << std::endl;
+    if (m_numErrors == 0) {
+        return;
+    }
+    const double meanErrorNs = m_sumErrorNs / m_numErrors;
+    const double varianceNs = std::max((m_sumSquaredErrorNs / m_numErrors) - (meanErrorNs * meanErrorNs), 0.0);
+    std::cout << "\tPresentation error" << (m_displayTiming ? "" : " (host estimate)") << ": mean "
+              << (meanErrorNs / 1000000.0) << " ms, jitter (std dev) " << (std::sqrt(varianceNs) / 1000000.0)
+              << " ms, max " << (m_maxAbsErrorNs / 1000000.0) << " ms over " << m_numErrors << " frames" << std::endl;
+}
@@ -0,0 +1,87 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANPRESENTSCHEDULER_H_
+#define _VKCODECUTILS_VULKANPRESENTSCHEDULER_H_
+
+#include <memory>
+#include <vector>
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+namespace vulkanVideoUtils {
+class VulkanDisplayTiming;
+}
+
+// Paces the presentation of the frames by their presentation time stamps, for a stable latency instead of the
+// highest frame rate. The first frame anchors the stream time to the host time, each frame is then targeted at
+// its PTS relative to it. The frames that missed their display time are dropped rather than shown late, so that
+// a decoder falling behind does not accumulate latency. With VK_GOOGLE_display_timing the target is passed as
+// the desired present time and the actual ones are read back, otherwise the presents are held on the host until
+// shortly before their target time. The times are in nanoseconds of the monotonic clock of the presentation
+// engine, std::chrono::steady_clock.
+class VulkanPresentScheduler
+{
+public:
+    VulkanPresentScheduler();
+    ~VulkanPresentScheduler();
+
+    // Called for each new swapchain, queries its refresh cycle
+    void AttachSwapchain(const VulkanDeviceContext* vkDevCtx, VkSwapchainKHR swapchain);
+    void DetachSwapchain();
+
+    // Targets the next frame at the display time of its PTS, in 100 ns units, 0 without one.
+    // Returns false for a frame too late to be shown, to be dropped instead of presented.
+    bool ScheduleFrame(uint64_t timestamp);
+
+    // Before the present of the scheduled frame, returns the pNext of VkPresentInfoKHR to the desired present
+    // time in presentTimesInfo and presentTime, or waits on the host until the target without display timing
+    const void* PreparePresent(const void* pNext, VkPresentTimesInfoGOOGLE& presentTimesInfo,
+                               VkPresentTimeGOOGLE& presentTime);
+    // After the present, records the presentation error of the completed presents
+    void OnPresented();
+
+    // The presented and dropped frames and the presentation jitter
+    void PrintStats() const;
+
+private:
+    static int64_t NowNanoseconds();
+    void Anchor(uint64_t pts, int64_t nowNs);
+    void AddPresentError(int64_t errorNs);
+
+private:
+    enum { MAX_CONSECUTIVE_DROPS = 8 };
+
+    const VulkanDeviceContext*                               m_vkDevCtx;
+    VkSwapchainKHR                                           m_swapchain;
+    std::unique_ptr<vulkanVideoUtils::VulkanDisplayTiming>   m_displayTiming; // with VK_GOOGLE_display_timing
+    int64_t                                                  m_refreshDurationNs;
+    bool                                                     m_anchored;
+    uint64_t                                                 m_anchorPts;
+    int64_t                                                  m_anchorTimeNs;
+    uint64_t                                                 m_lastPts;
+    int64_t                                                  m_targetTimeNs;  // of the scheduled frame, 0 unpaced
+    uint32_t                                                 m_consecutiveDrops;
+    uint32_t                                                 m_presentId;
+    uint64_t                                                 m_numPresented;
+    uint64_t                                                 m_numDropped;
+    uint64_t                                                 m_numErrors;
+    double                                                   m_sumErrorNs;
+    double                                                   m_sumSquaredErrorNs;
+    int64_t                                                  m_maxAbsErrorNs;
+    std::vector<VkPastPresentationTimingGOOGLE>              m_pastTimings;
+};
+
+#endif /* _VKCODECUTILS_VULKANPRESENTSCHEDULER_H_ */
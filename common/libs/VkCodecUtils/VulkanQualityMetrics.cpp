@@ -0,0 +1,507 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+#include "VulkanQualityMetrics.h"
+
+// Each invocation compares one 8x8 block of a plane, the planes are the z of the dispatch
+static const uint32_t blockSize = 8;
+static const uint32_t workgroupSize = 8;
+// The squared error and the SSIM sums of each plane, per workgroup
+static const uint32_t numWorkgroupSums = 2 * VulkanQualityMetrics::NUM_PLANES;
+// Of the identical planes
+static const double maxPsnr = 100.0;
+
+static const uint64_t slotWaitTimeout = 5ULL * 1000 * 1000 * 1000; // 5 Sec
+
+VkResult VulkanQualityMetrics::Create(const VulkanDeviceContext* vkDevCtx,
+                                      VkFormat referenceFormat,
+                                      VkFormat imageFormat,
+                                      const VkExtent2D& extent,
+                                      uint32_t numSlots,
+                                      VkSharedBaseObj<VulkanQualityMetrics>& qualityMetrics)
+{
+    // The descriptors are pushed with the command buffer of each frame
+    if (!vkDevCtx->FindRequiredDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) ||
+            (vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VkMpFormatInfo* referenceMpInfo = YcbcrVkFormatInfo(referenceFormat);
+    const VkMpFormatInfo* imageMpInfo = YcbcrVkFormatInfo(imageFormat);
+    if ((referenceMpInfo == nullptr) || (imageMpInfo == nullptr) ||
+            (referenceMpInfo->planesLayout.numberOfExtraPlanes != 1) ||
+            (imageMpInfo->planesLayout.numberOfExtraPlanes != 1) ||
+            (referenceMpInfo->planesLayout.secondaryPlaneSubsampledX != imageMpInfo->planesLayout.secondaryPlaneSubsampledX) ||
+            (referenceMpInfo->planesLayout.secondaryPlaneSubsampledY != imageMpInfo->planesLayout.secondaryPlaneSubsampledY)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkSharedBaseObj<VulkanQualityMetrics> metrics(new VulkanQualityMetrics(vkDevCtx, referenceFormat, imageFormat, extent,
+                                                                           imageMpInfo->planesLayout.secondaryPlaneSubsampledX,
+                                                                           imageMpInfo->planesLayout.secondaryPlaneSubsampledY));
+    if (!metrics) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = metrics->Init(numSlots);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    qualityMetrics = metrics;
+    return VK_SUCCESS;
+}
+
+VulkanQualityMetrics::VulkanQualityMetrics(const VulkanDeviceContext* vkDevCtx, VkFormat referenceFormat,
+                                           VkFormat imageFormat, const VkExtent2D& extent,
+                                           uint32_t chromaShiftX, uint32_t chromaShiftY)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_referenceFormat(referenceFormat)
+    , m_imageFormat(imageFormat)
+    , m_extent(extent)
+    , m_chromaShiftX(chromaShiftX)
+    , m_chromaShiftY(chromaShiftY)
+    , m_numWorkgroups{ (extent.width  + (blockSize * workgroupSize) - 1) / (blockSize * workgroupSize),
+                       (extent.height + (blockSize * workgroupSize) - 1) / (blockSize * workgroupSize) }
+    , m_vulkanShaderCompiler()
+    , m_descriptorSetLayout()
+    , m_computePipeline()
+    , m_commandBuffersSet()
+    , m_completeTimelineSemaphore()
+    , m_lastSubmittedValue(0)
+    , m_slotValues()
+    , m_workgroupSums()
+{
+}
+
+VulkanQualityMetrics::~VulkanQualityMetrics()
+{
+    if (m_completeTimelineSemaphore != VK_NULL_HANDLE) {
+        // The command buffers and the buffers of the slots are released after their last submission
+        for (uint32_t slot = 0; slot < m_slotValues.size(); slot++) {
+            WaitForSlot(slot);
+        }
+        m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_completeTimelineSemaphore, nullptr);
+        m_completeTimelineSemaphore = VK_NULL_HANDLE;
+    }
+}
+
+VkResult VulkanQualityMetrics::Init(uint32_t numSlots)
+{
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        //                        binding,  descriptorType,          descriptorCount, stageFlags, pImmutableSamplers;
+        // Binding 0: Reference image (read-only) Y plane
+        VkDescriptorSetLayoutBinding{ 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 1: Reference image (read-only) CbCr plane
+        VkDescriptorSetLayoutBinding{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 2: Compared image (read-only) Y plane
+        VkDescriptorSetLayoutBinding{ 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 3: Compared image (read-only) CbCr plane
+        VkDescriptorSetLayoutBinding{ 3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 4: Workgroup sums (write)
+        VkDescriptorSetLayoutBinding{ 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // The image layers, the extent and the chroma shifts
+    pushConstantRange.size = 6 * sizeof(uint32_t);
+
+    VkResult result = m_descriptorSetLayout.CreateDescriptorSet(m_vkDevCtx,
+                                                                setLayoutBindings,
+                                                                VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                                1, &pushConstantRange,
+                                                                nullptr,
+                                                                1,
+                                                                false);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::string computeShader;
+    const size_t computeShaderSize = InitShader(computeShader);
+    result = m_computePipeline.CreatePipeline(m_vkDevCtx, m_vulkanShaderCompiler,
+                                              computeShader.c_str(), computeShaderSize,
+                                              "main",
+                                              workgroupSize, workgroupSize,
+                                              &m_descriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    result = m_commandBuffersSet.CreateCommandBufferPool(m_vkDevCtx, m_vkDevCtx->GetComputeQueueFamilyIdx(), numSlots);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkSemaphoreTypeCreateInfo timelineCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineCreateInfo.initialValue = 0; // the first submission signals 1
+    const VkSemaphoreCreateInfo semaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &timelineCreateInfo, 0 };
+    result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &semaphoreCreateInfo, nullptr, &m_completeTimelineSemaphore);
+    if (result != VK_SUCCESS) {
+        m_completeTimelineSemaphore = VK_NULL_HANDLE;
+        return result;
+    }
+    m_slotValues.assign(numSlots, 0);
+
+    const VkDeviceSize workgroupSumsSize = (VkDeviceSize)m_numWorkgroups.width * m_numWorkgroups.height *
+                                           numWorkgroupSums * sizeof(float);
+    m_workgroupSums.resize(numSlots);
+    VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_FILTER);
+    for (VkSharedBaseObj<VkBufferResource>& workgroupSums : m_workgroupSums) {
+        result = VkBufferResource::Create(m_vkDevCtx,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          workgroupSumsSize,
+                                          workgroupSums);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+size_t VulkanQualityMetrics::InitShader(std::string& computeShader) const
+{
+    const VkMpFormatInfo* referenceMpInfo = YcbcrVkFormatInfo(m_referenceFormat);
+    const VkMpFormatInfo* imageMpInfo = YcbcrVkFormatInfo(m_imageFormat);
+    const bool isReference16BitSample = (referenceMpInfo != nullptr) && (referenceMpInfo->planesLayout.bpp != 0);
+    const bool isImage16BitSample = (imageMpInfo != nullptr) && (imageMpInfo->planesLayout.bpp != 0);
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint referenceLayer;\n"
+                        "    uint imageLayer;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
+                        "    uint chromaShiftX;\n"
+                        "    uint chromaShiftY;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << workgroupSize << ", local_size_y = " << workgroupSize << ") in;\n"
+                        "layout (set = 0, binding = 0, " << (isReference16BitSample ? "r16" : "r8") <<
+                                ") uniform readonly image2DArray referenceImageY;\n"
+                        "layout (set = 0, binding = 1, " << (isReference16BitSample ? "rg16" : "rg8") <<
+                                ") uniform readonly image2DArray referenceImageCbCr;\n"
+                        "layout (set = 0, binding = 2, " << (isImage16BitSample ? "r16" : "r8") <<
+                                ") uniform readonly image2DArray inImageY;\n"
+                        "layout (set = 0, binding = 3, " << (isImage16BitSample ? "rg16" : "rg8") <<
+                                ") uniform readonly image2DArray inImageCbCr;\n"
+                        "layout (set = 0, binding = 4) writeonly buffer WorkgroupSums {\n"
+                        "    float workgroupSums[];\n"
+                        "};\n"
+                        "\n"
+                        "const int blockSize = " << blockSize << ";\n"
+                        "const uint numInvocations = " << (workgroupSize * workgroupSize) << ";\n"
+                        "// Of the normalized samples\n"
+                        "const float c1 = 0.01 * 0.01;\n"
+                        "const float c2 = 0.03 * 0.03;\n"
+                        "\n"
+                        "shared float sharedSquaredError[numInvocations];\n"
+                        "shared float sharedSsim[numInvocations];\n"
+                        "\n"
+                        "// The reference and the compared sample of the plane\n"
+                        "vec2 loadSamples(uint plane, ivec2 pos)\n"
+                        "{\n"
+                        "    if (plane == 0) {\n"
+                        "        return vec2(imageLoad(referenceImageY, ivec3(pos, pushConstants.referenceLayer)).r,\n"
+                        "                    imageLoad(inImageY, ivec3(pos, pushConstants.imageLayer)).r);\n"
+                        "    }\n"
+                        "    vec2 referenceCbCr = imageLoad(referenceImageCbCr, ivec3(pos, pushConstants.referenceLayer)).rg;\n"
+                        "    vec2 inCbCr = imageLoad(inImageCbCr, ivec3(pos, pushConstants.imageLayer)).rg;\n"
+                        "    return (plane == 1) ? vec2(referenceCbCr.x, inCbCr.x) : vec2(referenceCbCr.y, inCbCr.y);\n"
+                        "}\n"
+                        "\n"
+                        "void main()\n"
+                        "{\n"
+                        "    uint plane = gl_GlobalInvocationID.z;\n"
+                        "    ivec2 planeExtent = ivec2(pushConstants.width, pushConstants.height);\n"
+                        "    if (plane > 0) {\n"
+                        "        ivec2 chromaShift = ivec2(pushConstants.chromaShiftX, pushConstants.chromaShiftY);\n"
+                        "        planeExtent = (planeExtent + (ivec2(1) << chromaShift) - 1) >> chromaShift;\n"
+                        "    }\n"
+                        "\n"
+                        "    // The blocks on the right and bottom edges are clipped to the plane\n"
+                        "    ivec2 blockPos = ivec2(gl_GlobalInvocationID.xy) * blockSize;\n"
+                        "    float squaredError = 0.0;\n"
+                        "    float ssim = 0.0;\n"
+                        "    if ((blockPos.x < planeExtent.x) && (blockPos.y < planeExtent.y)) {\n"
+                        "        ivec2 blockEnd = min(blockPos + blockSize, planeExtent);\n"
+                        "        vec2 sum = vec2(0.0);\n"
+                        "        vec2 sumSquares = vec2(0.0);\n"
+                        "        float sumProducts = 0.0;\n"
+                        "        for (int y = blockPos.y; y < blockEnd.y; y++) {\n"
+                        "            for (int x = blockPos.x; x < blockEnd.x; x++) {\n"
+                        "                vec2 samples = loadSamples(plane, ivec2(x, y));\n"
+                        "                float error = samples.x - samples.y;\n"
+                        "                squaredError += error * error;\n"
+                        "                sum += samples;\n"
+                        "                sumSquares += samples * samples;\n"
+                        "                sumProducts += samples.x * samples.y;\n"
+                        "            }\n"
+                        "        }\n"
+                        "        float numSamples = float((blockEnd.x - blockPos.x) * (blockEnd.y - blockPos.y));\n"
+                        "        vec2 mean = sum / numSamples;\n"
+                        "        vec2 variance = max(sumSquares / numSamples - mean * mean, vec2(0.0));\n"
+                        "        float covariance = sumProducts / numSamples - mean.x * mean.y;\n"
+                        "        ssim = ((2.0 * mean.x * mean.y + c1) * (2.0 * covariance + c2)) /\n"
+                        "               ((mean.x * mean.x + mean.y * mean.y + c1) * (variance.x + variance.y + c2));\n"
+                        "    }\n"
+                        "\n"
+                        "    sharedSquaredError[gl_LocalInvocationIndex] = squaredError;\n"
+                        "    sharedSsim[gl_LocalInvocationIndex] = ssim;\n"
+                        "    barrier();\n"
+                        "    for (uint stride = numInvocations / 2; stride > 0; stride /= 2) {\n"
+                        "        if (gl_LocalInvocationIndex < stride) {\n"
+                        "            sharedSquaredError[gl_LocalInvocationIndex] += sharedSquaredError[gl_LocalInvocationIndex + stride];\n"
+                        "            sharedSsim[gl_LocalInvocationIndex] += sharedSsim[gl_LocalInvocationIndex + stride];\n"
+                        "        }\n"
+                        "        barrier();\n"
+                        "    }\n"
+                        "\n"
+                        "    if (gl_LocalInvocationIndex == 0) {\n"
+                        "        uint workgroupIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;\n"
+                        "        workgroupSums[(workgroupIndex * 3 + plane) * 2 + 0] = sharedSquaredError[0];\n"
+                        "        workgroupSums[(workgroupIndex * 3 + plane) * 2 + 1] = sharedSsim[0];\n"
+                        "    }\n"
+                        "}\n";
+
+    computeShader = shaderStr.str();
+    return computeShader.size();
+}
+
+VkResult VulkanQualityMetrics::WaitForSlot(uint32_t slot) const
+{
+    assert(slot < m_slotValues.size());
+    const uint64_t value = m_slotValues[slot];
+    if (value == 0) {
+        return VK_SUCCESS;
+    }
+    const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                           &m_completeTimelineSemaphore, &value };
+    return m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, slotWaitTimeout);
+}
+
+VkResult VulkanQualityMetrics::Submit(uint32_t slot,
+                                      VkSemaphore waitSemaphore,
+                                      uint64_t waitValue,
+                                      const VkImageResourceView* referenceImageView,
+                                      uint32_t referenceImageLayer,
+                                      VkImageLayout referenceImageLayout,
+                                      const VkImageResourceView* imageView,
+                                      uint32_t imageLayer,
+                                      VkImageLayout imageLayout)
+{
+    assert(slot < m_workgroupSums.size());
+    assert((referenceImageView != nullptr) && (imageView != nullptr));
+
+    // The host has read the sums of the previous submission of the slot before its command buffer is reused
+    VkResult result = WaitForSlot(slot);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkCommandBuffer cmdBuf = *m_commandBuffersSet.GetCommandBuffer(slot);
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    result = m_vkDevCtx->BeginCommandBuffer(cmdBuf, &beginInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    const VkImageResourceView* imageViews[2] = { referenceImageView, imageView };
+    const uint32_t imageLayers[2] = { referenceImageLayer, imageLayer };
+    const VkImageLayout imageLayouts[2] = { referenceImageLayout, imageLayout };
+    std::array<VkImageMemoryBarrier2KHR, 2> imageBarriers{};
+    for (uint32_t imageNum = 0; imageNum < 2; imageNum++) {
+        VkImageMemoryBarrier2KHR& imageBarrier = imageBarriers[imageNum];
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+        imageBarrier.oldLayout = imageLayouts[imageNum];
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = imageViews[imageNum]->GetImageResource()->GetImage();
+        imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, imageLayers[imageNum], 1 };
+    }
+
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencyInfo.imageMemoryBarrierCount = (uint32_t)imageBarriers.size();
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 5;
+    VkDescriptorImageInfo imageDescriptors[4]{};
+    VkDescriptorBufferInfo bufferDescriptor{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    for (uint32_t descriptorNum = 0; descriptorNum < 4; descriptorNum++) {
+        imageDescriptors[descriptorNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[descriptorNum].imageView = imageViews[descriptorNum / 2]->GetPlaneImageView(descriptorNum % 2);
+        assert(imageDescriptors[descriptorNum].imageView);
+        imageDescriptors[descriptorNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        writeDescriptorSets[descriptorNum].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[descriptorNum].dstBinding = descriptorNum;
+        writeDescriptorSets[descriptorNum].descriptorCount = 1;
+        writeDescriptorSets[descriptorNum].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSets[descriptorNum].pImageInfo = &imageDescriptors[descriptorNum];
+    }
+
+    const VkBufferResource* workgroupSums = m_workgroupSums[slot];
+    bufferDescriptor.buffer = workgroupSums->GetBuffer();
+    bufferDescriptor.offset = 0;
+    bufferDescriptor.range = VK_WHOLE_SIZE;
+    writeDescriptorSets[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[4].dstBinding = 4;
+    writeDescriptorSets[4].descriptorCount = 1;
+    writeDescriptorSets[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writeDescriptorSets[4].pBufferInfo = &bufferDescriptor;
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t referenceLayer;
+        uint32_t imageLayer;
+        uint32_t width;
+        uint32_t height;
+        uint32_t chromaShiftX;
+        uint32_t chromaShiftY;
+    };
+
+    const PushConstants pushConstants = {
+            referenceImageLayer,
+            imageLayer,
+            m_extent.width,
+            m_extent.height,
+            m_chromaShiftX,
+            m_chromaShiftY
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    m_vkDevCtx->CmdDispatch(cmdBuf, m_numWorkgroups.width, m_numWorkgroups.height, NUM_PLANES);
+
+    // The sums are read by the host after the timeline value of the submission, the images go back to their layouts
+    VkMemoryBarrier2KHR memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR };
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+    for (uint32_t imageNum = 0; imageNum < 2; imageNum++) {
+        VkImageMemoryBarrier2KHR& imageBarrier = imageBarriers[imageNum];
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+        imageBarrier.dstAccessMask = 0;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.newLayout = imageLayouts[imageNum];
+    }
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    result = m_vkDevCtx->EndCommandBuffer(cmdBuf);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    const uint64_t signalValue = m_lastSubmittedValue + 1;
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineSemaphoreInfo.signalSemaphoreValueCount = 1;
+    timelineSemaphoreInfo.waitSemaphoreValueCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    timelineSemaphoreInfo.pWaitSemaphoreValues = (waitSemaphore != VK_NULL_HANDLE) ? &waitValue : nullptr;
+    timelineSemaphoreInfo.pSignalSemaphoreValues = &signalValue;
+
+    const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineSemaphoreInfo };
+    submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    submitInfo.pWaitSemaphores = (waitSemaphore != VK_NULL_HANDLE) ? &waitSemaphore : nullptr;
+    submitInfo.pWaitDstStageMask = &waitStageMask;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuf;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_completeTimelineSemaphore;
+    result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::COMPUTE, 0, 1, &submitInfo, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    m_lastSubmittedValue = signalValue;
+    m_slotValues[slot] = signalValue;
+    return VK_SUCCESS;
+}
+
+VkResult VulkanQualityMetrics::GetFrameMetrics(uint32_t slot, FrameMetrics& frameMetrics) const
+{
+    assert(slot < m_workgroupSums.size());
+
+    VkResult result = WaitForSlot(slot);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkDeviceSize maxSize = 0;
+    const float* pWorkgroupSums = (const float*)m_workgroupSums[slot]->GetReadOnlyDataPtr(0, maxSize);
+    const uint32_t numWorkgroups = m_numWorkgroups.width * m_numWorkgroups.height;
+    assert((pWorkgroupSums != nullptr) && (maxSize >= numWorkgroups * numWorkgroupSums * sizeof(float)));
+
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        const uint32_t shiftX = (plane > 0) ? m_chromaShiftX : 0;
+        const uint32_t shiftY = (plane > 0) ? m_chromaShiftY : 0;
+        const uint32_t planeWidth  = (m_extent.width  + (1 << shiftX) - 1) >> shiftX;
+        const uint32_t planeHeight = (m_extent.height + (1 << shiftY) - 1) >> shiftY;
+        const uint32_t numBlocks = ((planeWidth + blockSize - 1) / blockSize) * ((planeHeight + blockSize - 1) / blockSize);
+
+        double squaredError = 0.0;
+        double ssim = 0.0;
+        for (uint32_t workgroup = 0; workgroup < numWorkgroups; workgroup++) {
+            squaredError += pWorkgroupSums[(workgroup * NUM_PLANES + plane) * 2 + 0];
+            ssim += pWorkgroupSums[(workgroup * NUM_PLANES + plane) * 2 + 1];
+        }
+
+        frameMetrics.mse[plane] = squaredError / std::max<uint32_t>(planeWidth * planeHeight, 1);
+        frameMetrics.psnr[plane] = (frameMetrics.mse[plane] > 0.0) ?
+                                       std::min(-10.0 * log10(frameMetrics.mse[plane]), maxPsnr) : maxPsnr;
+        frameMetrics.ssim[plane] = ssim / std::max<uint32_t>(numBlocks, 1);
+    }
+    return VK_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANQUALITYMETRICS_H_
+#define _VKCODECUTILS_VULKANQUALITYMETRICS_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanShaderCompiler.h"
+#include "VkCodecUtils/VulkanDescriptorSetLayout.h"
+#include "VkCodecUtils/VulkanComputePipeline.h"
+#include "VkCodecUtils/VulkanCommandBuffersSet.h"
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VkImageResource.h"
+
+// Compares an image, e.g. decoded or reconstructed, with its reference image on the compute queue. Per plane,
+// the squared errors are summed and the SSIM is averaged over 8x8 blocks, reduced per workgroup on the device
+// into a host visible buffer per slot. The host adds up the per workgroup sums of the slot it reads.
+// The images are 2-plane YCbCr of the same chroma sub-sampling and need the storage usage.
+class VulkanQualityMetrics : public VkVideoRefCountBase
+{
+public:
+    enum { NUM_PLANES = 3 };
+
+    struct FrameMetrics {
+        double mse[NUM_PLANES];  // on the normalized [0, 1] sample scale
+        double psnr[NUM_PLANES]; // in dB, 100 for identical planes
+        double ssim[NUM_PLANES];
+    };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkFormat referenceFormat,
+                           VkFormat imageFormat,
+                           const VkExtent2D& extent,
+                           uint32_t numSlots,
+                           VkSharedBaseObj<VulkanQualityMetrics>& qualityMetrics);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the metrics if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Records and submits the comparison of the images of the slot to the compute queue, after waitSemaphore, if any.
+    // The waitValue is the one waited on when waitSemaphore is a timeline semaphore, it is ignored otherwise.
+    // The images are left in their layouts. The submission signals the timeline semaphore with the next value.
+    VkResult Submit(uint32_t slot,
+                    VkSemaphore waitSemaphore,
+                    uint64_t waitValue,
+                    const VkImageResourceView* referenceImageView,
+                    uint32_t referenceImageLayer,
+                    VkImageLayout referenceImageLayout,
+                    const VkImageResourceView* imageView,
+                    uint32_t imageLayer,
+                    VkImageLayout imageLayout);
+
+    // The submissions using the images after the comparison wait on the value of its submission
+    VkSemaphore GetCompleteTimelineSemaphore() const { return m_completeTimelineSemaphore; }
+    uint64_t GetLastSubmittedValue() const { return m_lastSubmittedValue; }
+
+    // Waits for the last submission of the slot, then reads its metrics
+    VkResult GetFrameMetrics(uint32_t slot, FrameMetrics& frameMetrics) const;
+
+private:
+    VulkanQualityMetrics(const VulkanDeviceContext* vkDevCtx, VkFormat referenceFormat, VkFormat imageFormat,
+                         const VkExtent2D& extent, uint32_t chromaShiftX, uint32_t chromaShiftY);
+
+    virtual ~VulkanQualityMetrics();
+
+    VkResult Init(uint32_t numSlots);
+    size_t InitShader(std::string& computeShader) const;
+    VkResult WaitForSlot(uint32_t slot) const;
+
+private:
+    std::atomic<int32_t>                           m_refCount;
+    const VulkanDeviceContext*                     m_vkDevCtx;
+    const VkFormat                                 m_referenceFormat;
+    const VkFormat                                 m_imageFormat;
+    const VkExtent2D                               m_extent;
+    const uint32_t                                 m_chromaShiftX;
+    const uint32_t                                 m_chromaShiftY;
+    const VkExtent2D                               m_numWorkgroups;
+    VulkanShaderCompiler                           m_vulkanShaderCompiler;
+    VulkanDescriptorSetLayout                      m_descriptorSetLayout;
+    VulkanComputePipeline                          m_computePipeline;
+    VulkanCommandBuffersSet                        m_commandBuffersSet;
+    VkSemaphore                                    m_completeTimelineSemaphore;
+    uint64_t                                       m_lastSubmittedValue;
+    std::vector<uint64_t>                          m_slotValues;     // of the last submission of each slot
+    std::vector<VkSharedBaseObj<VkBufferResource>> m_workgroupSums;  // per slot
+};
+
+#endif /* _VKCODECUTILS_VULKANQUALITYMETRICS_H_ */
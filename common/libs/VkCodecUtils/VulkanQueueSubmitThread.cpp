@@ -0,0 +1,259 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include "VkCodecUtils/VulkanQueueSubmitThread.h"
+#include "VkCodecUtils/VkThreadAffinity.h"
+
+VkResult VulkanQueueSubmitThread::Create(const VulkanDeviceContext* vkDevCtx,
+                                         VulkanDeviceContext::QueueFamilySubmitType submitType,
+                                         int32_t queueIndex,
+                                         VkSharedBaseObj<VulkanQueueSubmitThread>& submitThread)
+{
+    VkSharedBaseObj<VulkanQueueSubmitThread> queueSubmitThread(new VulkanQueueSubmitThread(vkDevCtx, submitType, queueIndex));
+    if (!queueSubmitThread) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    submitThread = queueSubmitThread;
+    return VK_SUCCESS;
+}
+
+VulkanQueueSubmitThread::VulkanQueueSubmitThread(const VulkanDeviceContext* vkDevCtx,
+                                                 VulkanDeviceContext::QueueFamilySubmitType submitType,
+                                                 int32_t queueIndex)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_submitType(submitType)
+    , m_queueIndex(queueIndex)
+    , m_head(&m_stub)
+    , m_tail(&m_stub)
+    , m_stub()
+    , m_numPending(0)
+    , m_submitThreadWaiting(false)
+    , m_numSubmitWaiters(0)
+    , m_result(VK_SUCCESS)
+    , m_stop(false)
+    , m_mutex()
+    , m_pendingCondition()
+    , m_submittedCondition()
+    , m_submitThread()
+{
+    m_stub.next.store(nullptr, std::memory_order_relaxed);
+    m_submitThread = std::thread(&VulkanQueueSubmitThread::SubmitThread, this);
+}
+
+bool VulkanQueueSubmitThread::SetThreadAffinity(const std::vector<uint32_t>& cpus)
+{
+    return VkSetThreadAffinity(m_submitThread, cpus);
+}
+
+VulkanQueueSubmitThread::~VulkanQueueSubmitThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_pendingCondition.notify_one();
+
+    // The pending submissions are submitted before the thread exits
+    if (m_submitThread.joinable()) {
+        m_submitThread.join();
+    }
+}
+
+void VulkanQueueSubmitThread::Push(SubmitNode* pNode)
+{
+    pNode->next.store(nullptr, std::memory_order_relaxed);
+    SubmitNode* pPrev = m_head.exchange(pNode, std::memory_order_acq_rel);
+    // Until this store, the node is not visible to the submit thread
+    pPrev->next.store(pNode, std::memory_order_release);
+}
+
+VulkanQueueSubmitThread::SubmitNode* VulkanQueueSubmitThread::Pop()
+{
+    SubmitNode* pTail = m_tail;
+    SubmitNode* pNext = pTail->next.load(std::memory_order_acquire);
+    if (pTail == &m_stub) {
+        if (pNext == nullptr) {
+            return nullptr;
+        }
+        m_tail = pNext;
+        pTail = pNext;
+        pNext = pNext->next.load(std::memory_order_acquire);
+    }
+
+    if (pNext != nullptr) {
+        m_tail = pNext;
+        return pTail;
+    }
+
+    if (pTail != m_head.load(std::memory_order_acquire)) {
+        // A producer is between the exchange of the head and the link of its node
+        return nullptr;
+    }
+
+    // The tail is the last node, the stub takes its place for it to be popped
+    Push(&m_stub);
+    pNext = pTail->next.load(std::memory_order_acquire);
+    if (pNext != nullptr) {
+        m_tail = pNext;
+        return pTail;
+    }
+
+    return nullptr;
+}
+
+VkResult VulkanQueueSubmitThread::Submit(const VkSubmitInfo& submitInfo, VkFence fence, SubmitCounter& counter)
+{
+    assert(submitInfo.waitSemaphoreCount <= MAX_SUBMIT_SEMAPHORES);
+    assert(submitInfo.signalSemaphoreCount <= MAX_SUBMIT_SEMAPHORES);
+    assert(submitInfo.commandBufferCount <= MAX_SUBMIT_COMMAND_BUFFERS);
+    if ((submitInfo.waitSemaphoreCount > MAX_SUBMIT_SEMAPHORES) ||
+        (submitInfo.signalSemaphoreCount > MAX_SUBMIT_SEMAPHORES) ||
+        (submitInfo.commandBufferCount > MAX_SUBMIT_COMMAND_BUFFERS)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    SubmitNode* pNode = new SubmitNode();
+    if (pNode == nullptr) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    pNode->submitInfo = submitInfo;
+    for (uint32_t i = 0; i < submitInfo.waitSemaphoreCount; i++) {
+        pNode->waitSemaphores[i] = submitInfo.pWaitSemaphores[i];
+        pNode->waitDstStageMasks[i] = submitInfo.pWaitDstStageMask[i];
+    }
+    for (uint32_t i = 0; i < submitInfo.signalSemaphoreCount; i++) {
+        pNode->signalSemaphores[i] = submitInfo.pSignalSemaphores[i];
+    }
+    for (uint32_t i = 0; i < submitInfo.commandBufferCount; i++) {
+        pNode->commandBuffers[i] = submitInfo.pCommandBuffers[i];
+    }
+    pNode->submitInfo.pWaitSemaphores = pNode->waitSemaphores;
+    pNode->submitInfo.pWaitDstStageMask = pNode->waitDstStageMasks;
+    pNode->submitInfo.pSignalSemaphores = pNode->signalSemaphores;
+    pNode->submitInfo.pCommandBuffers = pNode->commandBuffers;
+
+    if (submitInfo.pNext != nullptr) {
+        const VkTimelineSemaphoreSubmitInfo* pTimelineSemaphoreInfo = (const VkTimelineSemaphoreSubmitInfo*)submitInfo.pNext;
+        assert(pTimelineSemaphoreInfo->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
+        assert(pTimelineSemaphoreInfo->pNext == nullptr);
+        assert(pTimelineSemaphoreInfo->waitSemaphoreValueCount <= MAX_SUBMIT_SEMAPHORES);
+        assert(pTimelineSemaphoreInfo->signalSemaphoreValueCount <= MAX_SUBMIT_SEMAPHORES);
+        pNode->timelineSemaphoreInfo = *pTimelineSemaphoreInfo;
+        for (uint32_t i = 0; i < pTimelineSemaphoreInfo->waitSemaphoreValueCount; i++) {
+            pNode->waitSemaphoreValues[i] = pTimelineSemaphoreInfo->pWaitSemaphoreValues[i];
+        }
+        for (uint32_t i = 0; i < pTimelineSemaphoreInfo->signalSemaphoreValueCount; i++) {
+            pNode->signalSemaphoreValues[i] = pTimelineSemaphoreInfo->pSignalSemaphoreValues[i];
+        }
+        pNode->timelineSemaphoreInfo.pWaitSemaphoreValues = pNode->waitSemaphoreValues;
+        pNode->timelineSemaphoreInfo.pSignalSemaphoreValues = pNode->signalSemaphoreValues;
+        pNode->submitInfo.pNext = &pNode->timelineSemaphoreInfo;
+    }
+
+    pNode->fence = fence;
+    pNode->pCounter = &counter;
+    counter.numQueued++;
+
+    // Counted before the push, for the submit thread not to pop more than the pending count
+    m_numPending.fetch_add(1);
+    Push(pNode);
+
+    // The lock is only taken when the submit thread is asleep, or about to be
+    if (m_submitThreadWaiting.load()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingCondition.notify_one();
+    }
+
+    return m_result.load();
+}
+
+VkResult VulkanQueueSubmitThread::WaitSubmitted(const SubmitCounter& counter, uint64_t numQueued)
+{
+    numQueued = std::min(numQueued, counter.numQueued);
+    if (counter.numSubmitted.load() < numQueued) {
+
+        m_numSubmitWaiters.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_submittedCondition.wait(lock, [&counter, numQueued]() {
+                return (counter.numSubmitted.load() >= numQueued);
+            });
+        }
+        m_numSubmitWaiters.fetch_sub(1);
+    }
+
+    return m_result.load();
+}
+
+void VulkanQueueSubmitThread::SubmitThread()
+{
+    SubmitNode*  batchNodes[MAX_SUBMIT_BATCH_SIZE];
+    VkSubmitInfo batchSubmitInfos[MAX_SUBMIT_BATCH_SIZE];
+    VkFence      batchFences[MAX_SUBMIT_BATCH_SIZE];
+
+    while (true) {
+
+        uint32_t batchSize = 0;
+        SubmitNode* pNode = nullptr;
+        while ((batchSize < MAX_SUBMIT_BATCH_SIZE) && ((pNode = Pop()) != nullptr)) {
+            batchNodes[batchSize] = pNode;
+            batchSubmitInfos[batchSize] = pNode->submitInfo;
+            batchFences[batchSize] = pNode->fence;
+            batchSize++;
+        }
+
+        if (batchSize == 0) {
+            if (m_numPending.load() > 0) {
+                // A node is being pushed
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stop) {
+                break;
+            }
+            m_submitThreadWaiting.store(true);
+            m_pendingCondition.wait(lock, [this]() { return (m_numPending.load() > 0) || m_stop; });
+            m_submitThreadWaiting.store(false);
+            continue;
+        }
+
+        m_numPending.fetch_sub(batchSize);
+
+        const VkResult result = m_vkDevCtx->MultiThreadedQueueSubmitBatches(m_submitType, m_queueIndex,
+                                                                             batchSize, batchSubmitInfos, batchFences);
+        if (result != VK_SUCCESS) {
+            assert(!"The queue submission has failed");
+            m_result.store(result);
+        }
+
+        for (uint32_t i = 0; i < batchSize; i++) {
+            batchNodes[i]->pCounter->numSubmitted.fetch_add(1);
+            delete batchNodes[i];
+        }
+
+        if (m_numSubmitWaiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_submittedCondition.notify_all();
+        }
+    }
+}
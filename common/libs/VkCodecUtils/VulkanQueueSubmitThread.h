@@ -0,0 +1,122 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANQUEUESUBMITTHREAD_H_
+#define _VULKANQUEUESUBMITTHREAD_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// Submits to one queue from a thread of its own. The threads recording the command buffers push copies of
+// their submissions onto a lock-free queue instead of contending for the queue lock, and all the submissions
+// pending when the thread wakes up go to the queue in one call. A submission is on the queue some time after
+// Submit() returns: WaitSubmitted() must be called before one of its binary semaphores is waited on from
+// another queue, or before the queue is waited idle.
+class VulkanQueueSubmitThread : public VkVideoRefCountBase
+{
+public:
+    enum { MAX_SUBMIT_SEMAPHORES = 8, MAX_SUBMIT_COMMAND_BUFFERS = 4, MAX_SUBMIT_BATCH_SIZE = 32 };
+
+    // The submissions of one producer thread
+    struct SubmitCounter {
+        SubmitCounter() : numQueued(0), numSubmitted(0) {}
+        uint64_t              numQueued;    // only updated by the producer
+        std::atomic<uint64_t> numSubmitted; // only updated by the submit thread
+    };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VulkanDeviceContext::QueueFamilySubmitType submitType,
+                           int32_t queueIndex,
+                           VkSharedBaseObj<VulkanQueueSubmitThread>& submitThread);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the thread if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Queues a copy of the submission, the arrays it points to can be reused on return. The only chained
+    // structure supported is a VkTimelineSemaphoreSubmitInfo. Returns the error of a previous submission, if any.
+    VkResult Submit(const VkSubmitInfo& submitInfo, VkFence fence, SubmitCounter& counter);
+
+    // Blocks until the first numQueued submissions of the counter are on the queue, all of them by default
+    VkResult WaitSubmitted(const SubmitCounter& counter, uint64_t numQueued = UINT64_MAX);
+
+    // Restricts the submit thread to the CPUs of the list
+    bool SetThreadAffinity(const std::vector<uint32_t>& cpus);
+
+private:
+    struct SubmitNode {
+        std::atomic<SubmitNode*>      next;
+        VkSubmitInfo                  submitInfo;
+        VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo;
+        VkSemaphore                   waitSemaphores[MAX_SUBMIT_SEMAPHORES];
+        uint64_t                      waitSemaphoreValues[MAX_SUBMIT_SEMAPHORES];
+        VkPipelineStageFlags          waitDstStageMasks[MAX_SUBMIT_SEMAPHORES];
+        VkSemaphore                   signalSemaphores[MAX_SUBMIT_SEMAPHORES];
+        uint64_t                      signalSemaphoreValues[MAX_SUBMIT_SEMAPHORES];
+        VkCommandBuffer               commandBuffers[MAX_SUBMIT_COMMAND_BUFFERS];
+        VkFence                       fence;
+        SubmitCounter*                pCounter;
+    };
+
+    VulkanQueueSubmitThread(const VulkanDeviceContext* vkDevCtx,
+                            VulkanDeviceContext::QueueFamilySubmitType submitType,
+                            int32_t queueIndex);
+
+    virtual ~VulkanQueueSubmitThread();
+
+    // The intrusive MPSC queue of Vyukov: the producers exchange the head, the submit thread pops at the tail
+    void Push(SubmitNode* pNode);
+    SubmitNode* Pop();
+
+    void SubmitThread();
+
+private:
+    std::atomic<int32_t>                       m_refCount;
+    const VulkanDeviceContext*                 m_vkDevCtx;
+    VulkanDeviceContext::QueueFamilySubmitType m_submitType;
+    int32_t                                    m_queueIndex;
+    std::atomic<SubmitNode*>                   m_head;
+    SubmitNode*                                m_tail;
+    SubmitNode                                 m_stub;
+    std::atomic<uint32_t>                      m_numPending;
+    std::atomic<bool>                          m_submitThreadWaiting;
+    std::atomic<uint32_t>                      m_numSubmitWaiters;
+    std::atomic<VkResult>                      m_result;
+    bool                                       m_stop;
+    std::mutex                                 m_mutex;
+    std::condition_variable                    m_pendingCondition;
+    std::condition_variable                    m_submittedCondition;
+    std::thread                                m_submitThread;
+};
+
+#endif /* _VULKANQUEUESUBMITTHREAD_H_ */
@@ -14,15 +14,34 @@
 * limitations under the License.
 */
 
+#if !defined(VK_USE_PLATFORM_WIN32_KHR)
+#include <unistd.h>
+#endif
 #include "assert.h"
+#include <stdio.h>
+#include <string.h>
 #include <iostream>
 #include <fstream>
 
 #include "VulkanShaderCompiler.h"
+#if !defined(VK_VIDEO_NO_SHADERC)
 #include <shaderc/shaderc.h>
+#endif
 #include "Helpers.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
 
+struct VulkanPrecompiledSpirv {
+    uint64_t       shaderHash;
+    size_t         size;
+    const uint8_t* pSpirv;
+};
+
+#if defined(VK_VIDEO_PRECOMPILED_SPIRV)
+// Generated by cmake/EmbedSpirv.cmake
+#include "VulkanPrecompiledSpirv.inc"
+#endif
+
+#if !defined(VK_VIDEO_NO_SHADERC)
 // Translate Vulkan Shader Type to shaderc shader type
 static shaderc_shader_kind getShadercShaderType(VkShaderStageFlagBits type)
 {
@@ -44,28 +63,106 @@ static shaderc_shader_kind getShadercShaderType(VkShaderStageFlagBits type)
     }
     return static_cast<shaderc_shader_kind>(-1);
 }
+#endif
 
 VulkanShaderCompiler::VulkanShaderCompiler()
     : compilerHandle(0)
 {
+#if !defined(VK_VIDEO_NO_SHADERC)
     shaderc_compiler_t compiler = shaderc_compiler_initialize();
     compilerHandle = compiler;
+#endif
 }
 
 VulkanShaderCompiler::~VulkanShaderCompiler() {
 
+#if !defined(VK_VIDEO_NO_SHADERC)
     if (compilerHandle) {
         shaderc_compiler_t compiler = (shaderc_compiler_t)compilerHandle;
         shaderc_compiler_release(compiler);
         compilerHandle = nullptr;
     }
+#endif
 }
 
-VkShaderModule VulkanShaderCompiler::BuildGlslShader(const char *shaderCode, size_t shaderSize,
-                                                     VkShaderStageFlagBits type,
-                                                     const VulkanDeviceContext* vkDevCtx)
+// 64-bit FNV-1a of the stage and of the GLSL text
+uint64_t VulkanShaderCompiler::GetShaderHash(const char *shaderCode, size_t shaderSize, VkShaderStageFlagBits type)
 {
-    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    const uint64_t fnvPrime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint32_t stage = (uint32_t)type;
+    for (uint32_t i = 0; i < sizeof(stage); i++) {
+        hash = (hash ^ ((stage >> (i * 8)) & 0xff)) * fnvPrime;
+    }
+    for (size_t i = 0; i < shaderSize; i++) {
+        hash = (hash ^ (uint8_t)shaderCode[i]) * fnvPrime;
+    }
+    return hash;
+}
+
+bool VulkanShaderCompiler::GetPrecompiledSpirv(uint64_t shaderHash, std::vector<uint32_t>& spirv)
+{
+#if defined(VK_VIDEO_PRECOMPILED_SPIRV)
+    for (size_t i = 0; i < sizeof(s_precompiledSpirv) / sizeof(s_precompiledSpirv[0]); i++) {
+        if (s_precompiledSpirv[i].shaderHash == shaderHash) {
+            spirv.resize(s_precompiledSpirv[i].size / sizeof(uint32_t));
+            memcpy(spirv.data(), s_precompiledSpirv[i].pSpirv, spirv.size() * sizeof(uint32_t));
+            return !spirv.empty();
+        }
+    }
+#else
+    (void)shaderHash;
+    (void)spirv;
+#endif
+    return false;
+}
+
+bool VulkanShaderCompiler::ReadCachedSpirv(const std::string& fileName, std::vector<uint32_t>& spirv)
+{
+    std::ifstream is(fileName.c_str(), std::ios::binary | std::ios::in | std::ios::ate);
+    if (!is.is_open()) {
+        return false;
+    }
+    const std::streamoff size = is.tellg();
+    if ((size <= 0) || ((size % sizeof(uint32_t)) != 0)) {
+        return false;
+    }
+    spirv.resize((size_t)size / sizeof(uint32_t));
+    is.seekg(0, std::ios::beg);
+    is.read((char*)spirv.data(), size);
+
+    // Not a SPIR-V module, e.g. a file truncated by a full disk
+    const uint32_t spirvMagic = 0x07230203;
+    return is.good() && (spirv[0] == spirvMagic);
+}
+
+void VulkanShaderCompiler::WriteCachedSpirv(const std::string& fileName, const std::vector<uint32_t>& spirv)
+{
+    // Written aside and renamed, for the processes sharing the directory to never read a partial file
+#if !defined(VK_USE_PLATFORM_WIN32_KHR)
+    const unsigned long processId = (unsigned long)getpid();
+#else
+    const unsigned long processId = (unsigned long)GetCurrentProcessId();
+#endif
+    const std::string tmpFileName = fileName + "." + std::to_string(processId) + ".tmp";
+    FILE* pFile = fopen(tmpFileName.c_str(), "wb");
+    if (pFile == nullptr) {
+        return;
+    }
+    const bool written = (fwrite(spirv.data(), sizeof(uint32_t), spirv.size(), pFile) == spirv.size());
+    fclose(pFile);
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    remove(fileName.c_str()); // rename() doesn't replace an existing file there
+#endif
+    if (!written || (rename(tmpFileName.c_str(), fileName.c_str()) != 0)) {
+        remove(tmpFileName.c_str());
+    }
+}
+
+bool VulkanShaderCompiler::CompileGlslShader(const char *shaderCode, size_t shaderSize, VkShaderStageFlagBits type,
+                                             std::vector<uint32_t>& spirv)
+{
+#if !defined(VK_VIDEO_NO_SHADERC)
     if (compilerHandle) {
         shaderc_compiler_t compiler = (shaderc_compiler_t)compilerHandle;
 
@@ -77,21 +174,66 @@ VkShaderModule VulkanShaderCompiler::BuildGlslShader(const char *shaderCode, siz
 
             std::cerr << "Compilation error: \n" << shaderc_result_get_error_message(spvShader) << std::endl;
 
-            return VK_NULL_HANDLE;
+            shaderc_result_release(spvShader);
+            return false;
         }
 
-        // build vulkan shader module
-        VkShaderModuleCreateInfo shaderModuleCreateInfo = VkShaderModuleCreateInfo();
-        shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderModuleCreateInfo.pNext = nullptr;
-        shaderModuleCreateInfo.codeSize = shaderc_result_get_length(spvShader);
-        shaderModuleCreateInfo.pCode = (const uint32_t *)shaderc_result_get_bytes(spvShader);
-        shaderModuleCreateInfo.flags = 0;
-        VkResult result = vkDevCtx->CreateShaderModule(*vkDevCtx, &shaderModuleCreateInfo, nullptr, &shaderModule);
-        assert(result == VK_SUCCESS);
+        spirv.resize(shaderc_result_get_length(spvShader) / sizeof(uint32_t));
+        memcpy(spirv.data(), shaderc_result_get_bytes(spvShader), spirv.size() * sizeof(uint32_t));
 
         shaderc_result_release(spvShader);
+        return !spirv.empty();
     }
+#else
+    (void)shaderCode;
+    (void)shaderSize;
+    (void)type;
+    (void)spirv;
+#endif
+    return false;
+}
+
+VkShaderModule VulkanShaderCompiler::BuildGlslShader(const char *shaderCode, size_t shaderSize,
+                                                     VkShaderStageFlagBits type,
+                                                     const VulkanDeviceContext* vkDevCtx)
+{
+    const uint64_t shaderHash = GetShaderHash(shaderCode, shaderSize, type);
+
+    std::string cacheFileName;
+    if (!vkDevCtx->GetShaderCacheDirectory().empty()) {
+        char hashName[32];
+        snprintf(hashName, sizeof(hashName), "/%016llx.spv", (unsigned long long)shaderHash);
+        cacheFileName = vkDevCtx->GetShaderCacheDirectory() + hashName;
+    }
+
+    std::vector<uint32_t> spirv;
+    if (!GetPrecompiledSpirv(shaderHash, spirv) &&
+            (cacheFileName.empty() || !ReadCachedSpirv(cacheFileName, spirv))) {
+
+        if (!CompileGlslShader(shaderCode, shaderSize, type, spirv)) {
+            std::cerr << "VulkanShaderCompiler: no SPIR-V for the shader " << std::hex << shaderHash << std::dec
+                      << ", neither precompiled nor in the cache directory" << std::endl;
+            return VK_NULL_HANDLE;
+        }
+        if (!cacheFileName.empty()) {
+            WriteCachedSpirv(cacheFileName, spirv);
+        }
+    }
+
+    // build vulkan shader module
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = VkShaderModuleCreateInfo();
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.pNext = nullptr;
+    shaderModuleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+    shaderModuleCreateInfo.pCode = spirv.data();
+    shaderModuleCreateInfo.flags = 0;
+    VkResult result = vkDevCtx->CreateShaderModule(*vkDevCtx, &shaderModuleCreateInfo, nullptr, &shaderModule);
+    assert(result == VK_SUCCESS);
+    if (result != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+
     return shaderModule;
 }
 
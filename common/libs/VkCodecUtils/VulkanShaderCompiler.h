@@ -19,6 +19,14 @@
 
 #include "VkCodecUtils/VulkanDeviceContext.h"
 
+#include <stdint.h>
+#include <vector>
+
+// The SPIR-V of a GLSL shader comes from, in that order:
+//  - the shaders built into the binary (the PRECOMPILED_SPIRV_DIR of the build),
+//  - the <hash>.spv files of the shader cache directory of the device (VulkanDeviceContext::InitPipelineCache()),
+//  - shaderc, unless built without it (USE_SHADERC=OFF), with the SPIR-V then written to the cache directory.
+// The shaders are keyed by the hash of their stage and GLSL text, the same for all the devices.
 class VulkanShaderCompiler {
 
 public:
@@ -26,6 +34,8 @@ public:
     VulkanShaderCompiler();
     ~VulkanShaderCompiler();
 
+    static uint64_t GetShaderHash(const char *shaderCode, size_t shaderSize, VkShaderStageFlagBits type);
+
     VkShaderModule BuildGlslShader(const char *shaderCode, size_t shaderSize, VkShaderStageFlagBits type,
                                    const VulkanDeviceContext* vkDevCtx);
 
@@ -34,6 +44,12 @@ public:
                                        const VulkanDeviceContext* vkDevCtx);
 
 private:
+    static bool GetPrecompiledSpirv(uint64_t shaderHash, std::vector<uint32_t>& spirv);
+    static bool ReadCachedSpirv(const std::string& fileName, std::vector<uint32_t>& spirv);
+    static void WriteCachedSpirv(const std::string& fileName, const std::vector<uint32_t>& spirv);
+    bool CompileGlslShader(const char *shaderCode, size_t shaderSize, VkShaderStageFlagBits type,
+                           std::vector<uint32_t>& spirv);
+
     void* compilerHandle;
 };
 
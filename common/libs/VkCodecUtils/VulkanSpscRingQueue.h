@@ -0,0 +1,80 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANSPSCRINGQUEUE_H_
+#define _VKCODECUTILS_VULKANSPSCRINGQUEUE_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <atomic>
+
+// A fixed size, lock-free ring queue for exactly one producer thread and one consumer thread.
+// Everything the producer writes before Push() is visible to the consumer after the matching Pop().
+template <typename ElementType, uint32_t CAPACITY>
+class VulkanSpscRingQueue
+{
+    static_assert((CAPACITY != 0) && ((CAPACITY & (CAPACITY - 1)) == 0), "CAPACITY must be a power of two");
+
+public:
+    VulkanSpscRingQueue()
+        : m_head(0)
+        , m_tail(0)
+        , m_elements() { }
+
+    // Producer only. Returns false if the queue is full.
+    bool Push(const ElementType& element)
+    {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if ((tail - m_head.load(std::memory_order_acquire)) == CAPACITY) {
+            return false;
+        }
+        m_elements[tail & (CAPACITY - 1)] = element;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty.
+    bool Pop(ElementType& element)
+    {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        element = m_elements[head & (CAPACITY - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Exact from the consumer thread, a snapshot from any other thread.
+    uint32_t Size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    bool Empty() const
+    {
+        return (Size() == 0);
+    }
+
+private:
+    // Free running indexes, the head and the tail are on separate cache lines
+    // so that the producer and the consumer do not invalidate each other's line.
+    alignas(64) std::atomic<uint32_t> m_head;
+    alignas(64) std::atomic<uint32_t> m_tail;
+    ElementType                       m_elements[CAPACITY];
+};
+
+#endif /* _VKCODECUTILS_VULKANSPSCRINGQUEUE_H_ */
@@ -0,0 +1,379 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include "VkCodecUtils/VulkanThumbnailExtractor.h"
+
+static const uint64_t thumbnailTimeout = 100ULL * 1000 * 1000 * 1000; // 100 seconds
+
+VkResult VulkanThumbnailExtractor::Create(const VulkanDeviceContext* vkDevCtx,
+                                          VkFormat format,
+                                          const VkExtent2D& extent,
+                                          VkSharedBaseObj<VulkanThumbnailExtractor>& thumbnailExtractor)
+{
+    if (vkDevCtx->GetComputeQueueFamilyIdx() < 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+    if (((format != VK_FORMAT_R8G8B8A8_UNORM) && (format != VK_FORMAT_G8_B8R8_2PLANE_420_UNORM)) ||
+            (extent.width < 2) || (extent.height < 2) || ((extent.width | extent.height) & 1)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkSharedBaseObj<VulkanThumbnailExtractor> extractor(new VulkanThumbnailExtractor(vkDevCtx, format, extent));
+    if (!extractor) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = extractor->Init();
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    thumbnailExtractor = extractor;
+    return VK_SUCCESS;
+}
+
+VulkanThumbnailExtractor::VulkanThumbnailExtractor(const VulkanDeviceContext* vkDevCtx, VkFormat format,
+                                                   const VkExtent2D& extent)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_format(format)
+    , m_extent(extent)
+    , m_inputFormat(VK_FORMAT_UNDEFINED)
+    , m_filter()
+    , m_commandPool()
+    , m_commandBuffer()
+    , m_fence()
+    , m_imageView()
+    , m_readbackBuffer()
+{
+}
+
+VulkanThumbnailExtractor::~VulkanThumbnailExtractor()
+{
+    if (m_fence != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroyFence(*m_vkDevCtx, m_fence, nullptr);
+        m_fence = VK_NULL_HANDLE;
+    }
+    if (m_commandBuffer != VK_NULL_HANDLE) {
+        m_vkDevCtx->FreeCommandBuffers(*m_vkDevCtx, m_commandPool, 1, &m_commandBuffer);
+        m_commandBuffer = VK_NULL_HANDLE;
+    }
+    if (m_commandPool != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroyCommandPool(*m_vkDevCtx, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+}
+
+size_t VulkanThumbnailExtractor::GetThumbnailSize() const
+{
+    const size_t numPixels = (size_t)m_extent.width * m_extent.height;
+    return (m_format == VK_FORMAT_R8G8B8A8_UNORM) ? (numPixels * 4) : (numPixels + numPixels / 2);
+}
+
+VkResult VulkanThumbnailExtractor::Init()
+{
+    VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolInfo.queueFamilyIndex = m_vkDevCtx->GetComputeQueueFamilyIdx();
+    VkResult result = m_vkDevCtx->CreateCommandPool(*m_vkDevCtx, &cmdPoolInfo, nullptr, &m_commandPool);
+    if (result != VK_SUCCESS) {
+        m_commandPool = VK_NULL_HANDLE;
+        return result;
+    }
+
+    VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    cmdInfo.commandPool = m_commandPool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = 1;
+    result = m_vkDevCtx->AllocateCommandBuffers(*m_vkDevCtx, &cmdInfo, &m_commandBuffer);
+    if (result != VK_SUCCESS) {
+        m_commandBuffer = VK_NULL_HANDLE;
+        return result;
+    }
+
+    const VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    result = m_vkDevCtx->CreateFence(*m_vkDevCtx, &fenceInfo, nullptr, &m_fence);
+    if (result != VK_SUCCESS) {
+        m_fence = VK_NULL_HANDLE;
+        return result;
+    }
+
+    // The image is written by the storage image views of its planes
+    const bool isMultiPlanar = (m_format != VK_FORMAT_R8G8B8A8_UNORM);
+    VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageCreateInfo.flags = isMultiPlanar ? (VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) : 0;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = m_format;
+    imageCreateInfo.extent = { m_extent.width, m_extent.height, 1 };
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkSharedBaseObj<VkImageResource> imageResource;
+    result = VkImageResource::Create(m_vkDevCtx, &imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageResource);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    result = VkImageResourceView::Create(m_vkDevCtx, imageResource, subresourceRange, m_imageView);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // Only the thumbnail crosses to the host, read from cached memory
+    return VkBufferResource::Create(m_vkDevCtx,
+                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_CACHED_BIT),
+                                    GetThumbnailSize(),
+                                    m_readbackBuffer);
+}
+
+VkResult VulkanThumbnailExtractor::InitFilter(VkFormat inputFormat)
+{
+    // The color description of the stream is not known past the decoder queue, BT.709 narrow range is assumed
+    const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
+               VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+               nullptr,
+               inputFormat,
+               VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709,
+               VK_SAMPLER_YCBCR_RANGE_ITU_NARROW,
+               { VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY
+               },
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_FILTER_LINEAR,
+               false
+               };
+
+    static const VkSamplerCreateInfo samplerInfo = {
+               VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+               nullptr,
+               0,
+               VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+               VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+               // mipLodBias  anisotropyEnable  maxAnisotropy  compareEnable      compareOp         minLod  maxLod          borderColor
+               // unnormalizedCoordinates
+               0.0, false, 0.00, false, VK_COMPARE_OP_NEVER, 0.0, 16.0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false
+    };
+
+    const YcbcrPrimariesConstants ycbcrPrimariesConstants = GetYcbcrPrimariesConstants(YcbcrBtStandardBt709);
+
+    m_filter = nullptr;
+    VkResult result = VulkanFilterYuvCompute::Create(m_vkDevCtx,
+                                                     m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                                     0,
+                                                     VulkanFilterYuvCompute::YCBCRFUSED,
+                                                     1,
+                                                     inputFormat,
+                                                     m_format,
+                                                     &ycbcrConversionCreateInfo,
+                                                     &ycbcrPrimariesConstants,
+                                                     &samplerInfo,
+                                                     m_filter);
+    if (result != VK_SUCCESS) {
+        std::cerr << "Thumbnails: the filter can't convert format " << inputFormat << " to format "
+                  << m_format << std::endl;
+        return result;
+    }
+    m_inputFormat = inputFormat;
+    return VK_SUCCESS;
+}
+
+VkResult VulkanThumbnailExtractor::RecordCommandBuffer(const VulkanDecodedFrame& frame)
+{
+    VkCommandBuffer cmdBuf = m_commandBuffer;
+    VkResult result = m_vkDevCtx->ResetCommandBuffer(cmdBuf, VkCommandBufferResetFlags());
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    result = m_vkDevCtx->BeginCommandBuffer(cmdBuf, &beginInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The decoder leaves the output in the DPB layout when the output and the DPB coincide.
+    const VkImageResource* decodedImage = frame.imageView->GetImageResource();
+    const VkImageLayout decodedImageLayout =
+            ((decodedImage->GetImageCreateInfo().usage & VK_IMAGE_USAGE_VIDEO_DECODE_DPB_BIT_KHR) != 0) ?
+                    VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR : VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR;
+
+    // The decoded image, read, then the thumbnail image, overwritten
+    VkImageMemoryBarrier2KHR imageBarriers[2] = {};
+    for (uint32_t i = 0; i < 2; i++) {
+        imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        imageBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_NONE_KHR; // the decode is waited on by the submission
+        imageBarriers[i].srcAccessMask = 0;
+        imageBarriers[i].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        imageBarriers[i].dstAccessMask = (i == 0) ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR :
+                                                    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+        imageBarriers[i].oldLayout = (i == 0) ? decodedImageLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarriers[i].image = (i == 0) ? decodedImage->GetImage() : m_imageView->GetImageResource()->GetImage();
+        imageBarriers[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, (i == 0) ? frame.imageLayerIndex : 0, 1 };
+    }
+
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.imageMemoryBarrierCount = 2;
+    dependencyInfo.pImageMemoryBarriers = imageBarriers;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    // The displayed rectangle of the decoded picture is scaled to the thumbnail
+    VkVideoPictureResourceInfoKHR inputResourceInfo = { VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR };
+    inputResourceInfo.codedExtent = { (uint32_t)frame.displayWidth, (uint32_t)frame.displayHeight };
+    inputResourceInfo.baseArrayLayer = frame.imageLayerIndex;
+    inputResourceInfo.imageViewBinding = frame.imageView->GetImageView();
+    VkVideoPictureResourceInfoKHR outputResourceInfo = { VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR };
+    outputResourceInfo.codedExtent = m_extent;
+    outputResourceInfo.imageViewBinding = m_imageView->GetImageView();
+    VulkanFilterYuvCompute* pFilter = static_cast<VulkanFilterYuvCompute*>(m_filter.Get());
+    result = pFilter->RecordCommandBuffer(cmdBuf, frame.imageView, &inputResourceInfo,
+                                          m_imageView, &outputResourceInfo);
+    if (result != VK_SUCCESS) {
+        m_vkDevCtx->EndCommandBuffer(cmdBuf);
+        return result;
+    }
+
+    // The decoded image goes back to the layout of the decoder, the thumbnail is copied to the readback buffer
+    imageBarriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarriers[0].srcAccessMask = 0;
+    imageBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarriers[0].dstAccessMask = 0;
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[0].newLayout = decodedImageLayout;
+    imageBarriers[1].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarriers[1].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    imageBarriers[1].dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    imageBarriers[1].dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT_KHR;
+    imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    VkBufferImageCopy copyRegions[2] = {};
+    uint32_t numCopyRegions = 1;
+    copyRegions[0].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copyRegions[0].imageExtent = { m_extent.width, m_extent.height, 1 };
+    if (m_format != VK_FORMAT_R8G8B8A8_UNORM) {
+        copyRegions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+        copyRegions[1].bufferOffset = (VkDeviceSize)m_extent.width * m_extent.height;
+        copyRegions[1].imageSubresource = { VK_IMAGE_ASPECT_PLANE_1_BIT, 0, 0, 1 };
+        copyRegions[1].imageExtent = { m_extent.width / 2, m_extent.height / 2, 1 };
+        numCopyRegions = 2;
+    }
+    m_vkDevCtx->CmdCopyImageToBuffer(cmdBuf, m_imageView->GetImageResource()->GetImage(),
+                                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_readbackBuffer->GetBuffer(),
+                                     numCopyRegions, copyRegions);
+
+    VkBufferMemoryBarrier2KHR bufferBarrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR };
+    bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = m_readbackBuffer->GetBuffer();
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    VkDependencyInfoKHR bufferDependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    bufferDependencyInfo.bufferMemoryBarrierCount = 1;
+    bufferDependencyInfo.pBufferMemoryBarriers = &bufferBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &bufferDependencyInfo);
+
+    return m_vkDevCtx->EndCommandBuffer(cmdBuf);
+}
+
+VkResult VulkanThumbnailExtractor::Extract(const VulkanDecodedFrame& frame, uint8_t* pThumbnail)
+{
+    if (!frame.imageView) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkFormat inputFormat = frame.imageView->GetImageResource()->GetImageCreateInfo().format;
+    if (!m_filter || (inputFormat != m_inputFormat)) {
+        VkResult result = InitFilter(inputFormat);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    uint64_t waitValue = 0;
+    if (frame.frameCompleteSemaphore != VK_NULL_HANDLE) {
+        waitSemaphore = frame.frameCompleteSemaphore;
+    } else if (frame.frameCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+        waitSemaphore = frame.frameCompleteTimelineSemaphore;
+        waitValue = frame.frameCompleteTimelineValue;
+    } else if (frame.frameCompleteFence != VK_NULL_HANDLE) {
+        VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &frame.frameCompleteFence, true, thumbnailTimeout);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    VkResult result = RecordCommandBuffer(frame);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    const VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const uint32_t waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineSubmitInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+    timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineSubmitInfo };
+    submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = &waitSemaphore;
+    submitInfo.pWaitDstStageMask = &waitDstStageMask;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_commandBuffer;
+    result = m_vkDevCtx->ResetFences(*m_vkDevCtx, 1, &m_fence);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::COMPUTE, 0, 1, &submitInfo, m_fence);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &m_fence, true, thumbnailTimeout);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkDeviceSize maxSize = 0;
+    const uint8_t* pReadbackData = m_readbackBuffer->GetReadOnlyDataPtr(0, maxSize);
+    if ((pReadbackData == nullptr) || (maxSize < GetThumbnailSize())) {
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    memcpy(pThumbnail, pReadbackData, GetThumbnailSize());
+    return VK_SUCCESS;
+}
@@ -0,0 +1,84 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANTHUMBNAILEXTRACTOR_H_
+#define _VKCODECUTILS_VULKANTHUMBNAILEXTRACTOR_H_
+
+#include <atomic>
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VulkanDecodedFrame.h"
+#include "VkCodecUtils/VulkanFilterYuvCompute.h"
+
+// Downscales the decoded frames to thumbnails on the compute queue, only the thumbnails are read back. The displayed
+// rectangle of a frame goes through the fused crop, scale and color conversion of the fan-out into an RGBA or NV12
+// image of the thumbnail size, copied to a host visible buffer. One frame at a time, each extraction waits for its
+// completion, after which the decoded frame can be released.
+class VulkanThumbnailExtractor : public VkVideoRefCountBase {
+public:
+
+    // The format is VK_FORMAT_R8G8B8A8_UNORM or VK_FORMAT_G8_B8R8_2PLANE_420_UNORM, of an even extent
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkFormat format,
+                           const VkExtent2D& extent,
+                           VkSharedBaseObj<VulkanThumbnailExtractor>& thumbnailExtractor);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the extractor if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    VkFormat GetFormat() const { return m_format; }
+    const VkExtent2D& GetExtent() const { return m_extent; }
+
+    // In bytes, the rows and the planes packed without padding
+    size_t GetThumbnailSize() const;
+
+    // Writes the thumbnail of the frame to pThumbnail, of GetThumbnailSize() bytes
+    VkResult Extract(const VulkanDecodedFrame& frame, uint8_t* pThumbnail);
+
+private:
+    VulkanThumbnailExtractor(const VulkanDeviceContext* vkDevCtx, VkFormat format, const VkExtent2D& extent);
+    virtual ~VulkanThumbnailExtractor();
+
+    VkResult Init();
+    VkResult InitFilter(VkFormat inputFormat);
+    VkResult RecordCommandBuffer(const VulkanDecodedFrame& frame);
+
+private:
+    std::atomic<int32_t>                 m_refCount;
+    const VulkanDeviceContext*           m_vkDevCtx;
+    const VkFormat                       m_format;
+    const VkExtent2D                     m_extent;
+    VkFormat                             m_inputFormat; // of the filter, created with the first frame
+    VkSharedBaseObj<VulkanFilter>        m_filter;
+    VkCommandPool                        m_commandPool;
+    VkCommandBuffer                      m_commandBuffer;
+    VkFence                              m_fence;
+    VkSharedBaseObj<VkImageResourceView> m_imageView;      // of the thumbnail, on the device
+    VkSharedBaseObj<VkBufferResource>    m_readbackBuffer; // host visible, of GetThumbnailSize()
+};
+
+#endif /* _VKCODECUTILS_VULKANTHUMBNAILEXTRACTOR_H_ */
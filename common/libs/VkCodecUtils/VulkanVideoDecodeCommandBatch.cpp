@@ -0,0 +1,251 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include "VkCodecUtils/VulkanVideoDecodeCommandBatch.h"
+
+VkResult VulkanVideoDecodeCommandBatch::Create(const VulkanDeviceContext* vkDevCtx, int32_t queueIndex,
+                                               uint32_t maxPictures, uint32_t maxLatencyMs,
+                                               VkSharedBaseObj<VulkanVideoDecodeCommandBatch>& commandBatch)
+{
+    VkSharedBaseObj<VulkanVideoDecodeCommandBatch> decodeCommandBatch(
+            new VulkanVideoDecodeCommandBatch(vkDevCtx, queueIndex, maxPictures, maxLatencyMs));
+    if (!decodeCommandBatch) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = decodeCommandBatch->Init();
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    commandBatch = decodeCommandBatch;
+    return VK_SUCCESS;
+}
+
+VulkanVideoDecodeCommandBatch::VulkanVideoDecodeCommandBatch(const VulkanDeviceContext* vkDevCtx, int32_t queueIndex,
+                                                             uint32_t maxPictures, uint32_t maxLatencyMs)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_queueIndex(queueIndex)
+    , m_maxPictures(std::min<uint32_t>(std::max<uint32_t>(maxPictures, 1), MAX_BATCH_PICTURES))
+    , m_maxLatency(maxLatencyMs)
+    , m_commandPool()
+    , m_commandBuffers()
+    , m_currentCommandBuffer(0)
+    , m_batchId(0)
+    , m_numPictures(0)
+    , m_firstPictureTime()
+    , m_waitSemaphores()
+    , m_waitDstStageMasks()
+    , m_signalSemaphores()
+    , m_submitInfos()
+    , m_fences()
+    , m_stop(false)
+    , m_mutex()
+    , m_pendingCondition()
+    , m_flushThread()
+{
+}
+
+VkResult VulkanVideoDecodeCommandBatch::Init()
+{
+    VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolInfo.queueFamilyIndex = m_vkDevCtx->GetVideoDecodeQueueFamilyIdx();
+    VkResult result = m_vkDevCtx->CreateCommandPool(*m_vkDevCtx, &cmdPoolInfo, nullptr, &m_commandPool);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    cmdInfo.commandPool = m_commandPool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = 1;
+    // Created signaled, none of the command buffers is in use yet
+    const VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, VK_FENCE_CREATE_SIGNALED_BIT };
+    for (CommandBuffer& commandBuffer : m_commandBuffers) {
+        result = m_vkDevCtx->AllocateCommandBuffers(*m_vkDevCtx, &cmdInfo, &commandBuffer.commandBuffer);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        result = m_vkDevCtx->CreateFence(*m_vkDevCtx, &fenceInfo, nullptr, &commandBuffer.fence);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    m_submitInfos.reserve(m_maxPictures + 1);
+    m_fences.reserve(m_maxPictures + 1);
+    m_flushThread = std::thread(&VulkanVideoDecodeCommandBatch::FlushThread, this);
+    return VK_SUCCESS;
+}
+
+VulkanVideoDecodeCommandBatch::~VulkanVideoDecodeCommandBatch()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        // The decoders flush their pictures before they are destroyed, this is only what they left behind
+        FlushLocked();
+    }
+    m_pendingCondition.notify_one();
+    if (m_flushThread.joinable()) {
+        m_flushThread.join();
+    }
+
+    for (CommandBuffer& commandBuffer : m_commandBuffers) {
+        if (commandBuffer.fence != VK_NULL_HANDLE) {
+            m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &commandBuffer.fence, true, UINT64_MAX);
+            m_vkDevCtx->DestroyFence(*m_vkDevCtx, commandBuffer.fence, nullptr);
+            commandBuffer.fence = VK_NULL_HANDLE;
+        }
+        if (commandBuffer.commandBuffer != VK_NULL_HANDLE) {
+            m_vkDevCtx->FreeCommandBuffers(*m_vkDevCtx, m_commandPool, 1, &commandBuffer.commandBuffer);
+            commandBuffer.commandBuffer = VK_NULL_HANDLE;
+        }
+    }
+    if (m_commandPool != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroyCommandPool(*m_vkDevCtx, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+}
+
+VkCommandBuffer VulkanVideoDecodeCommandBatch::BeginPicture()
+{
+    m_mutex.lock();
+
+    CommandBuffer& commandBuffer = m_commandBuffers[m_currentCommandBuffer];
+    if (m_numPictures == 0) {
+        // The first picture of the batch, the command buffer is recorded again once its previous batch is done
+        VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &commandBuffer.fence, true, UINT64_MAX);
+        if (result == VK_SUCCESS) {
+            result = m_vkDevCtx->ResetFences(*m_vkDevCtx, 1, &commandBuffer.fence);
+        }
+        if (result == VK_SUCCESS) {
+            result = m_vkDevCtx->ResetCommandBuffer(commandBuffer.commandBuffer, VkCommandBufferResetFlags());
+        }
+        if (result == VK_SUCCESS) {
+            VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            result = m_vkDevCtx->BeginCommandBuffer(commandBuffer.commandBuffer, &beginInfo);
+        }
+        if (result != VK_SUCCESS) {
+            m_mutex.unlock();
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    return commandBuffer.commandBuffer;
+}
+
+VkResult VulkanVideoDecodeCommandBatch::EndPicture(const VkSubmitInfo& submitInfo, VkFence fence, uint64_t& batchId)
+{
+    assert(submitInfo.commandBufferCount == 0);
+    assert(submitInfo.pNext == nullptr);
+
+    for (uint32_t i = 0; i < submitInfo.waitSemaphoreCount; i++) {
+        m_waitSemaphores.push_back(submitInfo.pWaitSemaphores[i]);
+        m_waitDstStageMasks.push_back(submitInfo.pWaitDstStageMask[i]);
+    }
+    for (uint32_t i = 0; i < submitInfo.signalSemaphoreCount; i++) {
+        m_signalSemaphores.push_back(submitInfo.pSignalSemaphores[i]);
+    }
+    m_fences.push_back(fence);
+
+    batchId = m_batchId;
+    m_numPictures++;
+    VkResult result = VK_SUCCESS;
+    if (m_numPictures >= m_maxPictures) {
+        result = FlushLocked();
+    } else if (m_numPictures == 1) {
+        m_firstPictureTime = std::chrono::steady_clock::now();
+        m_pendingCondition.notify_one();
+    }
+
+    m_mutex.unlock();
+    return result;
+}
+
+VkResult VulkanVideoDecodeCommandBatch::Flush(uint64_t batchId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ((batchId != UINT64_MAX) && (batchId != m_batchId)) {
+        // Submitted already
+        return VK_SUCCESS;
+    }
+    return FlushLocked();
+}
+
+VkResult VulkanVideoDecodeCommandBatch::FlushLocked()
+{
+    if (m_numPictures == 0) {
+        return VK_SUCCESS;
+    }
+
+    CommandBuffer& commandBuffer = m_commandBuffers[m_currentCommandBuffer];
+    VkResult result = m_vkDevCtx->EndCommandBuffer(commandBuffer.commandBuffer);
+
+    if (result == VK_SUCCESS) {
+        VkSubmitInfo batchSubmitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        batchSubmitInfo.waitSemaphoreCount = (uint32_t)m_waitSemaphores.size();
+        batchSubmitInfo.pWaitSemaphores = m_waitSemaphores.data();
+        batchSubmitInfo.pWaitDstStageMask = m_waitDstStageMasks.data();
+        batchSubmitInfo.commandBufferCount = 1;
+        batchSubmitInfo.pCommandBuffers = &commandBuffer.commandBuffer;
+        batchSubmitInfo.signalSemaphoreCount = (uint32_t)m_signalSemaphores.size();
+        batchSubmitInfo.pSignalSemaphores = m_signalSemaphores.data();
+
+        // The batch goes with the first fence of the pictures, the other ones and the fence of the command buffer
+        // with the empty submissions after it, all signaled once the batch is complete
+        m_submitInfos.assign(m_numPictures + 1, VkSubmitInfo { VK_STRUCTURE_TYPE_SUBMIT_INFO });
+        m_submitInfos[0] = batchSubmitInfo;
+        m_fences.push_back(commandBuffer.fence);
+        result = m_vkDevCtx->MultiThreadedQueueSubmitBatches(VulkanDeviceContext::DECODE, m_queueIndex,
+                                                             (uint32_t)m_submitInfos.size(), m_submitInfos.data(),
+                                                             m_fences.data());
+    }
+    assert(result == VK_SUCCESS);
+
+    m_waitSemaphores.clear();
+    m_waitDstStageMasks.clear();
+    m_signalSemaphores.clear();
+    m_fences.clear();
+    m_numPictures = 0;
+    m_batchId++;
+    m_currentCommandBuffer = (m_currentCommandBuffer + 1) % NUM_COMMAND_BUFFERS;
+    return result;
+}
+
+void VulkanVideoDecodeCommandBatch::FlushThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_numPictures == 0) {
+            m_pendingCondition.wait(lock);
+            continue;
+        }
+
+        // The pictures of a batch that doesn't fill up in time are submitted on time
+        const uint64_t batchId = m_batchId;
+        const std::chrono::steady_clock::time_point deadline = m_firstPictureTime + m_maxLatency;
+        m_pendingCondition.wait_until(lock, deadline, [this, batchId]() { return m_stop || (m_batchId != batchId); });
+        if (!m_stop && (m_batchId == batchId) && (std::chrono::steady_clock::now() >= deadline)) {
+            FlushLocked();
+        }
+    }
+}
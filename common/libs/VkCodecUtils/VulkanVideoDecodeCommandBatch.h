@@ -0,0 +1,113 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANVIDEODECODECOMMANDBATCH_H_
+#define _VULKANVIDEODECODECOMMANDBATCH_H_
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// The pictures of the decoders sharing a decode queue, recorded one after the other into a single command buffer,
+// each in its own video coding scope, and submitted together. The submission waits for the semaphores of all the
+// pictures and signals all of theirs, and their fences by fence only submissions after it. A batch is submitted
+// once it has maxPictures pictures, when one of its fences is about to be waited on, or by the thread of the batch
+// once its first picture is maxLatencyMs old.
+class VulkanVideoDecodeCommandBatch : public VkVideoRefCountBase
+{
+public:
+    enum { NUM_COMMAND_BUFFERS = 4, MAX_BATCH_PICTURES = 64 };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx, int32_t queueIndex,
+                           uint32_t maxPictures, uint32_t maxLatencyMs,
+                           VkSharedBaseObj<VulkanVideoDecodeCommandBatch>& commandBatch);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the batch if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Locks the batch for the picture of the caller and returns the command buffer to record it into, after the
+    // pictures before it. Returns VK_NULL_HANDLE, unlocked, on failure. Must be followed by EndPicture().
+    VkCommandBuffer BeginPicture();
+
+    // Adds the semaphores and the fence of the picture recorded since BeginPicture() and unlocks the batch. The
+    // submit info has no command buffers and no chained structures. batchId is the batch of the picture.
+    VkResult EndPicture(const VkSubmitInfo& submitInfo, VkFence fence, uint64_t& batchId);
+
+    // Submits the batch if it's still pending, all the pending pictures by default
+    VkResult Flush(uint64_t batchId = UINT64_MAX);
+
+private:
+    struct CommandBuffer {
+        VkCommandBuffer commandBuffer;
+        VkFence         fence; // of its last submission, signaled when it can be recorded again
+    };
+
+    VulkanVideoDecodeCommandBatch(const VulkanDeviceContext* vkDevCtx, int32_t queueIndex,
+                                  uint32_t maxPictures, uint32_t maxLatencyMs);
+
+    VkResult Init();
+
+    // With the lock held
+    VkResult FlushLocked();
+
+    // Submits the batches older than the latency
+    void FlushThread();
+
+    virtual ~VulkanVideoDecodeCommandBatch();
+
+private:
+    std::atomic<int32_t>                             m_refCount;
+    const VulkanDeviceContext*                       m_vkDevCtx;
+    int32_t                                          m_queueIndex;
+    uint32_t                                         m_maxPictures;
+    std::chrono::milliseconds                        m_maxLatency;
+    VkCommandPool                                    m_commandPool;
+    std::array<CommandBuffer, NUM_COMMAND_BUFFERS>   m_commandBuffers;
+    uint32_t                                         m_currentCommandBuffer;
+    uint64_t                                         m_batchId;       // of the pending batch
+    uint32_t                                         m_numPictures;   // in the pending batch
+    std::chrono::steady_clock::time_point            m_firstPictureTime;
+    std::vector<VkSemaphore>                         m_waitSemaphores;
+    std::vector<VkPipelineStageFlags>                m_waitDstStageMasks;
+    std::vector<VkSemaphore>                         m_signalSemaphores;
+    std::vector<VkSubmitInfo>                        m_submitInfos;   // the batch, then a fence only one per picture
+    std::vector<VkFence>                             m_fences;        // of the pictures, then of the command buffer
+    bool                                             m_stop;
+    std::mutex                                       m_mutex;
+    std::condition_variable                          m_pendingCondition;
+    std::thread                                      m_flushThread;
+};
+
+#endif /* _VULKANVIDEODECODECOMMANDBATCH_H_ */
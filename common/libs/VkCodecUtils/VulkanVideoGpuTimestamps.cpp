@@ -0,0 +1,379 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <algorithm>
+#include "VkCodecUtils/VulkanVideoGpuTimestamps.h"
+
+// Two timestamps per slot, around the video coding command
+static const uint32_t queriesPerSlot = 2;
+
+VkResult VulkanVideoGpuTimestamps::Create(const VulkanDeviceContext* vkDevCtx,
+                                          uint32_t queueFamilyIndex,
+                                          uint32_t numSlots,
+                                          const char* name,
+                                          const char* csvFileName,
+                                          VkSharedBaseObj<VulkanVideoGpuTimestamps>& gpuTimestamps)
+{
+    uint32_t queueFamilyCount = 0;
+    vkDevCtx->GetPhysicalDeviceQueueFamilyProperties(vkDevCtx->getPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkDevCtx->GetPhysicalDeviceQueueFamilyProperties(vkDevCtx->getPhysicalDevice(), &queueFamilyCount,
+                                                     queueFamilyProperties.data());
+    if ((queueFamilyIndex >= queueFamilyCount) || (queueFamilyProperties[queueFamilyIndex].timestampValidBits == 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VkPhysicalDeviceProperties deviceProperties = VkPhysicalDeviceProperties();
+    vkDevCtx->GetPhysicalDeviceProperties(vkDevCtx->getPhysicalDevice(), &deviceProperties);
+
+    const uint32_t validBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+    const uint64_t timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+
+    VkSharedBaseObj<VulkanVideoGpuTimestamps> timestamps(new VulkanVideoGpuTimestamps(vkDevCtx, timestampMask,
+                                                                                       deviceProperties.limits.timestampPeriod,
+                                                                                       name));
+    if (!timestamps) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = timestamps->SetNumSlots(numSlots);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    if ((csvFileName != nullptr) && (csvFileName[0] != '\0')) {
+        timestamps->m_csvFile = fopen(csvFileName, "w");
+        if (timestamps->m_csvFile == nullptr) {
+            fprintf(stderr, "\nERROR: Can't open the GPU timestamps CSV file %s\n", csvFileName);
+        } else {
+            fprintf(timestamps->m_csvFile, "frame,slot,gpu_ms,submit_to_complete_ms,queue_wait_ms\n");
+        }
+    }
+
+    gpuTimestamps = timestamps;
+    return VK_SUCCESS;
+}
+
+VulkanVideoGpuTimestamps::VulkanVideoGpuTimestamps(const VulkanDeviceContext* vkDevCtx, uint64_t timestampMask,
+                                                   double timestampPeriodNs, const char* name)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_timestampMask(timestampMask)
+    , m_timestampPeriodNs(timestampPeriodNs)
+    , m_name((name != nullptr) ? name : "")
+    , m_mutex()
+    , m_queryPool(VK_NULL_HANDLE)
+    , m_slots()
+    , m_samples()
+    , m_csvFile(nullptr)
+    , m_traceTrackId(~0U)
+    , m_hasTraceOffset(false)
+    , m_traceOffsetNs(0)
+{
+}
+
+VulkanVideoGpuTimestamps::~VulkanVideoGpuTimestamps()
+{
+    DestroyQueryPool();
+    if (m_csvFile != nullptr) {
+        fclose(m_csvFile);
+        m_csvFile = nullptr;
+    }
+}
+
+VkResult VulkanVideoGpuTimestamps::CreateQueryPool(uint32_t numSlots)
+{
+    VkQueryPoolCreateInfo queryPoolCreateInfo = VkQueryPoolCreateInfo();
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = numSlots * queriesPerSlot;
+
+    return m_vkDevCtx->CreateQueryPool(*m_vkDevCtx, &queryPoolCreateInfo, nullptr, &m_queryPool);
+}
+
+void VulkanVideoGpuTimestamps::DestroyQueryPool()
+{
+    if (m_queryPool != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroyQueryPool(*m_vkDevCtx, m_queryPool, nullptr);
+        m_queryPool = VK_NULL_HANDLE;
+    }
+}
+
+VkResult VulkanVideoGpuTimestamps::SetNumSlots(uint32_t numSlots)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ((m_queryPool != VK_NULL_HANDLE) && (numSlots <= m_slots.size())) {
+        return VK_SUCCESS;
+    }
+
+    // Called between sequences, once the device is idle
+    for (uint32_t slot = 0; slot < m_slots.size(); slot++) {
+        CollectSlot(slot, true);
+    }
+    DestroyQueryPool();
+
+    m_slots.assign(numSlots, Slot());
+    return CreateQueryPool(numSlots);
+}
+
+void VulkanVideoGpuTimestamps::CmdResetSlot(VkCommandBuffer cmdBuf, uint32_t slot)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(slot < m_slots.size());
+    // The fence of the previous submission may have been reset for this one already
+    CollectSlot(slot, true);
+
+    m_vkDevCtx->CmdResetQueryPool(cmdBuf, m_queryPool, slot * queriesPerSlot, queriesPerSlot);
+    m_slots[slot].recorded = true;
+    m_slots[slot].submitted = false;
+}
+
+void VulkanVideoGpuTimestamps::CmdWriteBegin(VkCommandBuffer cmdBuf, uint32_t slot) const
+{
+    m_vkDevCtx->CmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, slot * queriesPerSlot);
+}
+
+void VulkanVideoGpuTimestamps::CmdWriteEnd(VkCommandBuffer cmdBuf, uint32_t slot) const
+{
+    m_vkDevCtx->CmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, slot * queriesPerSlot + 1);
+}
+
+void VulkanVideoGpuTimestamps::SetSubmitted(uint32_t slot, uint64_t frameId, VkFence fence)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(slot < m_slots.size());
+    if (m_slots[slot].recorded) {
+        m_slots[slot].frameId = frameId;
+        m_slots[slot].submitTime = std::chrono::steady_clock::now();
+        m_slots[slot].hasLastSample = false;
+        m_slots[slot].fence = fence;
+        m_slots[slot].timelineSemaphore = VK_NULL_HANDLE;
+        m_slots[slot].timelineValue = 0;
+        m_slots[slot].submitted = true;
+    }
+
+    CollectAvailable();
+}
+
+void VulkanVideoGpuTimestamps::SetSubmitted(uint32_t slot, uint64_t frameId, VkSemaphore timelineSemaphore,
+                                            uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(slot < m_slots.size());
+    if (m_slots[slot].recorded) {
+        m_slots[slot].frameId = frameId;
+        m_slots[slot].submitTime = std::chrono::steady_clock::now();
+        m_slots[slot].hasLastSample = false;
+        m_slots[slot].fence = VK_NULL_HANDLE;
+        m_slots[slot].timelineSemaphore = timelineSemaphore;
+        m_slots[slot].timelineValue = timelineValue;
+        m_slots[slot].submitted = true;
+    }
+
+    CollectAvailable();
+}
+
+bool VulkanVideoGpuTimestamps::IsSlotComplete(const Slot& timestampSlot) const
+{
+    if (timestampSlot.timelineSemaphore != VK_NULL_HANDLE) {
+        uint64_t value = 0;
+        return (m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, timestampSlot.timelineSemaphore, &value) == VK_SUCCESS) &&
+               (value >= timestampSlot.timelineValue);
+    }
+    return (timestampSlot.fence != VK_NULL_HANDLE) &&
+           (m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, timestampSlot.fence) == VK_SUCCESS);
+}
+
+bool VulkanVideoGpuTimestamps::CollectSlot(uint32_t slot, bool knownComplete)
+{
+    Slot& timestampSlot = m_slots[slot];
+    if (!timestampSlot.submitted) {
+        return true;
+    }
+
+    // The queries can only be read once their reset has executed, so the completion is checked first.
+    bool observedComplete = false;
+    if (!knownComplete) {
+        if (!IsSlotComplete(timestampSlot)) {
+            return false;
+        }
+        observedComplete = true;
+    }
+    const std::chrono::steady_clock::time_point completeTime = std::chrono::steady_clock::now();
+
+    timestampSlot.submitted = false;
+    timestampSlot.recorded = false;
+
+    uint64_t timestamps[queriesPerSlot] = {};
+    VkResult result = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx, m_queryPool, slot * queriesPerSlot, queriesPerSlot,
+                                                     sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                                     VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    if (result != VK_SUCCESS) {
+        return true;
+    }
+
+    Sample sample;
+    sample.gpuTimeMs = (double)((timestamps[1] - timestamps[0]) & m_timestampMask) * m_timestampPeriodNs / 1000000.0;
+    sample.latencyMs = -1.0;
+    sample.queueWaitMs = -1.0;
+    if (observedComplete) {
+        sample.latencyMs = std::chrono::duration<double, std::milli>(completeTime - timestampSlot.submitTime).count();
+        sample.queueWaitMs = std::max(sample.latencyMs - sample.gpuTimeMs, 0.0);
+    }
+    m_samples.push_back(sample);
+    timestampSlot.lastSample = sample;
+    timestampSlot.hasLastSample = true;
+
+    if (VkTrace::IsEnabled() || VkFrameLatency::IsEnabled()) {
+        AddHostTimeZone(timestamps, sample.gpuTimeMs, observedComplete, completeTime, timestampSlot.frameId);
+    }
+
+    if (m_csvFile != nullptr) {
+        if (observedComplete) {
+            fprintf(m_csvFile, "%llu,%u,%.4f,%.4f,%.4f\n", (unsigned long long)timestampSlot.frameId, slot,
+                    sample.gpuTimeMs, sample.latencyMs, sample.queueWaitMs);
+        } else {
+            fprintf(m_csvFile, "%llu,%u,%.4f,,\n", (unsigned long long)timestampSlot.frameId, slot, sample.gpuTimeMs);
+        }
+    }
+    return true;
+}
+
+void VulkanVideoGpuTimestamps::AddHostTimeZone(const uint64_t* timestamps, double gpuTimeMs, bool observedComplete,
+                                               const std::chrono::steady_clock::time_point& completeTime, uint64_t frameId)
+{
+    const int64_t beginNs = (int64_t)((double)(timestamps[0] & m_timestampMask) * m_timestampPeriodNs);
+    const int64_t endNs = beginNs + (int64_t)(gpuTimeMs * 1000000.0);
+    if (observedComplete) {
+        // The completion is observed after the end of the work, the smallest difference is the closest mapping.
+        // A much larger one means the device counter has wrapped around.
+        const int64_t offsetNs = (int64_t)VkTrace::ToNs(completeTime) - endNs;
+        const int64_t maxDriftNs = 1000 * 1000 * 1000;
+        if (!m_hasTraceOffset || (offsetNs < m_traceOffsetNs) || (offsetNs > (m_traceOffsetNs + maxDriftNs))) {
+            m_traceOffsetNs = offsetNs;
+            m_hasTraceOffset = true;
+        }
+    }
+    if (!m_hasTraceOffset) {
+        return;
+    }
+
+    VkFrameLatency::Record(VK_FRAME_LATENCY_GPU_BEGIN, frameId, (uint64_t)(beginNs + m_traceOffsetNs));
+    VkFrameLatency::Record(VK_FRAME_LATENCY_GPU_END, frameId, (uint64_t)(endNs + m_traceOffsetNs));
+    if (!VkTrace::IsEnabled()) {
+        return;
+    }
+
+    if (m_traceTrackId == ~0U) {
+        m_traceTrackId = VkTrace::AddTrack(("GPU " + m_name).c_str());
+    }
+    VkTrace::AddTrackZone(m_traceTrackId, (uint64_t)(beginNs + m_traceOffsetNs), (uint64_t)(endNs + m_traceOffsetNs),
+                          frameId);
+}
+
+bool VulkanVideoGpuTimestamps::GetFrameTimes(uint32_t slot, uint64_t frameId, double* pGpuTimeMs,
+                                             double* pQueueWaitMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ((slot >= m_slots.size()) || (m_slots[slot].frameId != frameId)) {
+        return false;
+    }
+    // Observed complete if it can be, for the queue wait
+    if (!CollectSlot(slot, false)) {
+        CollectSlot(slot, true);
+    }
+    if (!m_slots[slot].hasLastSample) {
+        return false;
+    }
+    *pGpuTimeMs = m_slots[slot].lastSample.gpuTimeMs;
+    *pQueueWaitMs = m_slots[slot].lastSample.queueWaitMs;
+    return true;
+}
+
+void VulkanVideoGpuTimestamps::CollectAvailable()
+{
+    for (uint32_t slot = 0; slot < m_slots.size(); slot++) {
+        CollectSlot(slot, false);
+    }
+}
+
+double VulkanVideoGpuTimestamps::GetTotalGpuTimeMs(size_t* pNumSamples)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    CollectAvailable();
+
+    if (pNumSamples != nullptr) {
+        *pNumSamples = m_samples.size();
+    }
+    double totalGpuTimeMs = 0.0;
+    for (const Sample& sample : m_samples) {
+        totalGpuTimeMs += sample.gpuTimeMs;
+    }
+    return totalGpuTimeMs;
+}
+
+static double Percentile(std::vector<double>& values, uint32_t percentile)
+{
+    const size_t index = std::min(values.size() - 1, (values.size() * percentile) / 100);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void VulkanVideoGpuTimestamps::PrintStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The device is idle by now, the pending slots are complete
+    for (uint32_t slot = 0; slot < m_slots.size(); slot++) {
+        CollectSlot(slot, false);
+        CollectSlot(slot, true);
+    }
+
+    if (m_csvFile != nullptr) {
+        fflush(m_csvFile);
+    }
+
+    if (m_samples.empty()) {
+        return;
+    }
+
+    std::vector<double> gpuTimes, latencies, queueWaits;
+    gpuTimes.reserve(m_samples.size());
+    latencies.reserve(m_samples.size());
+    queueWaits.reserve(m_samples.size());
+    for (const Sample& sample : m_samples) {
+        gpuTimes.push_back(sample.gpuTimeMs);
+        if (sample.latencyMs >= 0.0) {
+            latencies.push_back(sample.latencyMs);
+            queueWaits.push_back(sample.queueWaitMs);
+        }
+    }
+
+    printf("%s GPU timestamps over %zu frames (ms):\n", m_name.c_str(), m_samples.size());
+    printf("\tGPU time:           p50 %8.3f p99 %8.3f\n", Percentile(gpuTimes, 50), Percentile(gpuTimes, 99));
+    if (!latencies.empty()) {
+        printf("\tSubmit to complete: p50 %8.3f p99 %8.3f (%zu frames)\n",
+               Percentile(latencies, 50), Percentile(latencies, 99), latencies.size());
+        printf("\tQueue wait:         p50 %8.3f p99 %8.3f\n", Percentile(queueWaits, 50), Percentile(queueWaits, 99));
+    }
+}
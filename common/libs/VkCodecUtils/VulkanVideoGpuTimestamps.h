@@ -0,0 +1,141 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANVIDEOGPUTIMESTAMPS_H_
+#define _VKCODECUTILS_VULKANVIDEOGPUTIMESTAMPS_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "VkCodecUtils/VkFrameLatency.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+
+// Measures the device execution time of the video coding commands with a pair of timestamps per command buffer slot.
+// The results are harvested without blocking once the submission's fence is signaled, or its timeline semaphore value
+// reached, which also gives the host submit to complete latency. The queue wait time is estimated as that latency minus
+// the device time, there are no calibrated host timestamps. Slots submitted without either only report their device time.
+// Percentiles are reported on teardown. Optionally, every frame is also written to a CSV file.
+// With the trace or the frame latency enabled, the device work also goes to the host timeline. The device clock is mapped to
+// the host one by the closest of the observed completions, so the zones can land slightly late until it settles.
+class VulkanVideoGpuTimestamps : public VkVideoRefCountBase
+{
+public:
+    // Returns VK_ERROR_FEATURE_NOT_PRESENT if the queue family doesn't support timestamps.
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           uint32_t queueFamilyIndex,
+                           uint32_t numSlots,
+                           const char* name,
+                           const char* csvFileName,
+                           VkSharedBaseObj<VulkanVideoGpuTimestamps>& gpuTimestamps);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the timestamps if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Grows the number of slots. The pending results are waited for, the collected ones are kept.
+    VkResult SetNumSlots(uint32_t numSlots);
+
+    uint32_t GetNumSlots() const { return (uint32_t)m_slots.size(); }
+
+    // Must be recorded outside of the video coding scope, before the slot's timestamps are written.
+    // Harvests the previous results of the slot, its command buffer must have completed executing by now.
+    void CmdResetSlot(VkCommandBuffer cmdBuf, uint32_t slot);
+
+    // The timestamps can be written inside of the video coding scope.
+    void CmdWriteBegin(VkCommandBuffer cmdBuf, uint32_t slot) const;
+    void CmdWriteEnd(VkCommandBuffer cmdBuf, uint32_t slot) const;
+
+    // Called once the command buffer of the slot is submitted. Also harvests the results of the completed slots.
+    void SetSubmitted(uint32_t slot, uint64_t frameId, VkFence fence);
+    // For a submission signaling a timeline semaphore with the value instead of a fence
+    void SetSubmitted(uint32_t slot, uint64_t frameId, VkSemaphore timelineSemaphore, uint64_t timelineValue);
+
+    // Waits for the pending results and prints the percentiles of the collected ones.
+    void PrintStats();
+
+    // The device time of the collected results so far, after collecting the completed slots, and their number.
+    double GetTotalGpuTimeMs(size_t* pNumSamples = nullptr);
+
+    // The times of the frame submitted with the slot, once its work is known to be done, collected now if need be.
+    // The queue wait is negative if the completion was not observed. False if the slot has gone on to another frame.
+    bool GetFrameTimes(uint32_t slot, uint64_t frameId, double* pGpuTimeMs, double* pQueueWaitMs);
+
+private:
+    struct Sample {
+        double gpuTimeMs;
+        double latencyMs;   // negative if the completion was not observed
+        double queueWaitMs;
+    };
+
+    struct Slot {
+        uint64_t                              frameId;
+        std::chrono::steady_clock::time_point submitTime;
+        VkFence                               fence;
+        VkSemaphore                           timelineSemaphore;
+        uint64_t                              timelineValue;
+        bool                                  recorded;
+        bool                                  submitted;
+        bool                                  hasLastSample; // of frameId, until the slot is submitted again
+        Sample                                lastSample;
+    };
+
+    VulkanVideoGpuTimestamps(const VulkanDeviceContext* vkDevCtx, uint64_t timestampMask,
+                             double timestampPeriodNs, const char* name);
+
+    virtual ~VulkanVideoGpuTimestamps();
+
+    VkResult CreateQueryPool(uint32_t numSlots);
+    void DestroyQueryPool();
+    // Without known completion, returns false if the fence or the timeline value of a submitted slot is not signaled yet.
+    bool CollectSlot(uint32_t slot, bool knownComplete);
+    bool IsSlotComplete(const Slot& timestampSlot) const;
+    void CollectAvailable();
+    void AddHostTimeZone(const uint64_t* timestamps, double gpuTimeMs, bool observedComplete,
+                         const std::chrono::steady_clock::time_point& completeTime, uint64_t frameId);
+
+private:
+    std::atomic<int32_t>       m_refCount;
+    const VulkanDeviceContext* m_vkDevCtx;
+    const uint64_t             m_timestampMask;
+    const double               m_timestampPeriodNs;
+    const std::string          m_name;
+    std::mutex                 m_mutex;
+    VkQueryPool                m_queryPool;
+    std::vector<Slot>          m_slots;
+    std::vector<Sample>        m_samples;
+    FILE*                      m_csvFile;
+    uint32_t                   m_traceTrackId;
+    bool                       m_hasTraceOffset;
+    int64_t                    m_traceOffsetNs; // from the device to the host time, in ns
+};
+
+#endif /* _VKCODECUTILS_VULKANVIDEOGPUTIMESTAMPS_H_ */
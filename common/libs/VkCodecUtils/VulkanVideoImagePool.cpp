@@ -93,7 +93,8 @@ VkResult VulkanVideoImagePoolNode::CreateImage( const VulkanDeviceContext* vkDev
 
         } else {
 
-            m_pictureResourceInfo.baseArrayLayer = 0;
+            // The view of all the layers of the parent image, the picture is the layer of the node
+            m_pictureResourceInfo.baseArrayLayer = imageIndex;
             m_imageResourceView = imageViewArrayParent;
         }
     }
@@ -142,6 +143,7 @@ VkResult VulkanVideoImagePool::GetImageSetNewLayout(uint32_t imageIndex,
     bool recreateImage = !m_imageResources[imageIndex].RecreateImage();
 
     if (recreateImage) {
+        VulkanMemoryOwnerScope ownerScope(m_memoryOwner);
         result = m_imageResources[imageIndex].CreateImage(
                            m_vkDevCtx,
                            &m_imageCreateInfo,
@@ -165,51 +167,65 @@ VkResult VulkanVideoImagePool::GetImageSetNewLayout(uint32_t imageIndex,
 bool VulkanVideoImagePool::GetAvailableImage(VkSharedBaseObj<VulkanVideoImagePoolNode>& imageResource,
                                              VkImageLayout newImageLayout)
 {
-    int32_t availablePoolNodeIndx = -1;
-    {
-        std::lock_guard<std::mutex> lock(m_queueMutex);
-        if (m_nextNodeToUse >= m_poolSize) {
-            m_nextNodeToUse = 0;
-        }
-        bool retryFirstPoolPartition = false;
-        do {
-            for (uint32_t i = m_nextNodeToUse; i < m_poolSize; i++) {
-                if (m_availablePoolNodes & (1ULL << i)) {
-                    m_nextNodeToUse = i + 1;
-                    m_availablePoolNodes &= ~(1ULL << i);
-                    availablePoolNodeIndx = i;
-                    break;
-                }
-            }
-
-            if ((availablePoolNodeIndx == -1) && (m_nextNodeToUse > 0)) {
-                // Search again the first part of the bit array
-                m_nextNodeToUse = 0;
-                retryFirstPoolPartition = true;
-            } else {
-                retryFirstPoolPartition = false;
-                break;
-            }
-
-        } while (retryFirstPoolPartition);
-    }
+    // Round-robin from the node after the last one handed out, m_nextNodeToUse is only a hint.
+    const int32_t availablePoolNodeIndx =
+            m_availablePoolNodes.AcquireFirstSetBit(m_nextNodeToUse.load(std::memory_order_relaxed));
     if (availablePoolNodeIndx != -1) {
+        assert((uint32_t)availablePoolNodeIndx < m_poolSize);
+        m_nextNodeToUse.store(availablePoolNodeIndx + 1, std::memory_order_relaxed);
         VkResult result = GetImageSetNewLayout(availablePoolNodeIndx, newImageLayout);
         if (result == VK_SUCCESS) {
             m_imageResources[availablePoolNodeIndx].SetParent(this, availablePoolNodeIndx);
             imageResource = &m_imageResources[availablePoolNodeIndx];
             return true;
         }
+        ReleaseImageToPool(availablePoolNodeIndx);
     }
     return false;
 }
 
-bool VulkanVideoImagePool::ReleaseImageToPool(uint32_t imageIndex)
+bool VulkanVideoImagePool::GetAvailableImage(VkSharedBaseObj<VulkanVideoImagePoolNode>& imageResource,
+                                             VkImageLayout newImageLayout,
+                                             std::chrono::nanoseconds timeout)
 {
-    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (GetAvailableImage(imageResource, newImageLayout)) {
+        return true;
+    }
 
-    assert(!(m_availablePoolNodes & (1ULL << imageIndex)));
-    m_availablePoolNodes |= (1ULL << imageIndex);
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    m_numReleaseWaiters++;
+    std::atomic_thread_fence(std::memory_order_seq_cst); // against the release, see ReleaseImageToPool()
+    bool success = false;
+    while (!success && (std::chrono::steady_clock::now() < deadline)) {
+        // Checked under the lock, a release after the check notifies after the wait
+        if (m_availablePoolNodes.Get() != 0) {
+            lock.unlock();
+            success = GetAvailableImage(imageResource, newImageLayout);
+            lock.lock();
+        } else {
+            m_releaseCondition.wait_until(lock, deadline);
+        }
+    }
+    m_numReleaseWaiters--;
+
+    return success;
+}
+
+bool VulkanVideoImagePool::ReleaseImageToPool(uint32_t imageIndex)
+{
+    assert(imageIndex < m_poolSize);
+    const bool wasInUse = m_availablePoolNodes.ReleaseBit(imageIndex);
+    assert(wasInUse);
+    (void)wasInUse;
+
+    // The waiters are notified under the lock, not between their check of the mask and their wait. A waiter
+    // counted after the load finds the image in the mask.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_numReleaseWaiters.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_releaseCondition.notify_all();
+    }
 
     return true;
 }
@@ -240,6 +256,11 @@ VkResult VulkanVideoImagePool::Configure(const VulkanDeviceContext*   vkDevCtx,
                                          bool                         useLinearImage)
 {
     std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (m_memoryOwner == VULKAN_MEMORY_OWNER_OTHER) {
+        // The owner of the thread configuring the pool
+        m_memoryOwner = VulkanDeviceMemoryBudget::GetCurrentOwner();
+    }
+    VulkanMemoryOwnerScope ownerScope(m_memoryOwner);
     if (numImages > m_imageResources.size()) {
         assert(!"Number of requested images exceeds the max size of the image array");
         return VK_ERROR_TOO_MANY_OBJECTS;
@@ -253,7 +274,7 @@ VkResult VulkanVideoImagePool::Configure(const VulkanDeviceContext*   vkDevCtx,
 
     for (uint32_t imageIndex = m_poolSize; imageIndex < numImages; imageIndex++) {
         m_imageResources[imageIndex].Init(vkDevCtx);
-        m_availablePoolNodes |= (1ULL << imageIndex);
+        m_availablePoolNodes.ReleaseBit(imageIndex);
     }
 
     if (useImageViewArray) {
@@ -19,8 +19,13 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 #include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanAtomicBitMask.h"
 #include "vulkan_interfaces.h"
 #include "VkVideoCore/VkVideoCoreProfile.h"
 #include "VkCodecUtils/VkImageResource.h"
@@ -138,10 +143,12 @@ public:
         , m_usesImageArray(false)
         , m_usesImageViewArray(false)
         , m_usesLinearImage(false)
-        , m_availablePoolNodes(0UL)
+        , m_availablePoolNodes(0ULL)
+        , m_numReleaseWaiters(0)
         , m_imageResources(maxImages)
         , m_imageArray()
         , m_imageViewArray()
+        , m_memoryOwner(VULKAN_MEMORY_OWNER_OTHER)
     {
     }
 
@@ -175,6 +182,9 @@ public:
                        bool                         useImageViewArray = false,
                        bool                         useLinear = false);
 
+    // The owner the memory of the images is accounted to, also when they are recreated on their next use
+    void SetMemoryOwner(VulkanMemoryOwner memoryOwner) { m_memoryOwner = memoryOwner; }
+
     void Deinit();
 
     ~VulkanVideoImagePool()
@@ -193,9 +203,22 @@ public:
         return m_poolSize;
     }
 
+    // The images acquired and not released yet, e.g. the frames in flight
+    uint32_t GetNumImagesInUse() const
+    {
+        return m_poolSize - m_availablePoolNodes.CountSetBits();
+    }
+
     bool GetAvailableImage(VkSharedBaseObj<VulkanVideoImagePoolNode>&  imageResource,
                            VkImageLayout newImageLayout);
 
+    // Waits up to the timeout for an image to be released when none is available, the oldest in-flight one being
+    // the next released, for the producer of the frames to be throttled by their consumers instead of the pool
+    // being sized for the worst case. Returns false on the timeout.
+    bool GetAvailableImage(VkSharedBaseObj<VulkanVideoImagePoolNode>&  imageResource,
+                           VkImageLayout newImageLayout,
+                           std::chrono::nanoseconds timeout);
+
     bool ReleaseImageToPool(uint32_t imageIndex);
 
 private:
@@ -205,20 +228,23 @@ private:
 private:
     const VulkanDeviceContext*            m_vkDevCtx;
     std::atomic<int32_t>                  m_refCount;
-    std::mutex                            m_queueMutex;
+    std::mutex                            m_queueMutex;        // of the configuration and the release waits
+    std::condition_variable               m_releaseCondition;  // signaled by the releases of the images
     uint32_t                              m_queueFamilyIndex;
     VkVideoCoreProfile                    m_videoProfile;
     VkImageCreateInfo                     m_imageCreateInfo;
     VkMemoryPropertyFlags                 m_requiredMemProps;
     uint32_t                              m_poolSize;
-    uint32_t                              m_nextNodeToUse;
+    std::atomic<uint32_t>                 m_nextNodeToUse;     // only a hint of the round-robin
     uint32_t                              m_usesImageArray : 1;
     uint32_t                              m_usesImageViewArray : 1;
     uint32_t                              m_usesLinearImage : 1;
-    uint64_t                              m_availablePoolNodes;
+    VulkanAtomicBitMask                   m_availablePoolNodes;
+    std::atomic<uint32_t>                 m_numReleaseWaiters;
     std::vector<VulkanVideoImagePoolNode> m_imageResources;
     VkSharedBaseObj<VkImageResource>      m_imageArray;     // must be valid if m_usesImageArray is true
     VkSharedBaseObj<VkImageResourceView>  m_imageViewArray; // must be valid if m_usesImageViewArray is true
+    VulkanMemoryOwner                     m_memoryOwner;
 };
 
 #endif /* _VULKANVIDEOIMAGEPOOL_H_ */
@@ -15,6 +15,7 @@
 */
 
 #include <assert.h>
+#include <chrono>
 #include <iostream>
 #include <mutex>
 #include <queue>
@@ -22,18 +23,29 @@
 #include <stdint.h>
 #include <string.h>
 #include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
 
 #include "VkCodecUtils/Helpers.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VkFrameLatency.h"
 #include "VkVideoCore/VulkanVideoCapabilities.h"
 #include "VulkanVideoProcessor.h"
 #include "vulkan_interfaces.h"
 #include "nvidia_utils/vulkan/ycbcrvkinfo.h"
 
+// The output frames analyzed ahead of the host reading their analytics
+static const uint32_t frameAnalyticsSlots = 4;
+
 inline void CheckInputFile(const char* szInFilePath)
 {
+    if (VideoStreamDemuxer::IsStreamingInput(szInFilePath)) {
+        // Opened once only, a FIFO or a connection can't be probed
+        return;
+    }
     std::ifstream fpIn(szInFilePath, std::ios::in | std::ios::binary);
     if (fpIn.fail()) {
         std::ostringstream err;
@@ -62,6 +74,7 @@ int32_t VulkanVideoProcessor::Initialize(const VulkanDeviceContext* vkDevCtx,
     const int32_t numDecodeImagesToPreallocate = programConfig.numDecodeImagesToPreallocate;
     const int32_t numBitstreamBuffersToPreallocate = std::max(programConfig.numBitstreamBuffersToPreallocate, 4);
     const bool enableHwLoadBalancing = programConfig.enableHwLoadBalancing;
+    const bool enableNalPreScan = programConfig.enableNalPreScan;
     const bool enablePostProcessFilter = (programConfig.enablePostProcessFilter >= 0);
     const  VulkanFilterYuvCompute::FilterType postProcessFilterType = enablePostProcessFilter ?
             (VulkanFilterYuvCompute::FilterType)programConfig.enablePostProcessFilter :
@@ -95,6 +108,8 @@ int32_t VulkanVideoProcessor::Initialize(const VulkanDeviceContext* vkDevCtx,
 
     m_usesStreamDemuxer = m_videoStreamDemuxer->IsStreamDemuxerEnabled();
     m_usesFramePreparser = m_videoStreamDemuxer->HasFramePreparser();
+    // The pre-scan only applies to the raw byte stream path, where the parser does its own NAL boundary detection
+    m_usesNalPreScanner = enableNalPreScan && !m_usesStreamDemuxer && !m_usesFramePreparser;
 
     if (verbose) {
         m_videoStreamDemuxer->DumpStreamParameters();
@@ -106,14 +121,40 @@ int32_t VulkanVideoProcessor::Initialize(const VulkanDeviceContext* vkDevCtx,
         fprintf(stderr, "\nERROR: Create VulkanVideoFrameBuffer result: 0x%x\n", result);
     }
 
-    FILE* outFile = m_frameToFile.AttachFile(outputFileName);
+    const VkVideoFrameToFile::OutputFormat outputFormat = (programConfig.outputFormat <= VkVideoFrameToFile::OUTPUT_FORMAT_Y4M) ?
+            (VkVideoFrameToFile::OutputFormat)programConfig.outputFormat : VkVideoFrameToFile::OUTPUT_FORMAT_PLANAR;
+    FILE* outFile = m_frameToFile.AttachFile(outputFileName, outputFormat);
     if ((outputFileName != nullptr) && (outFile == nullptr)) {
         fprintf( stderr, "Error opening the output file %s", outputFileName);
         return -1;
     }
 
+    // The checksums of the frames replace the frames in the output file, which becomes optional.
+    if ((programConfig.frameChecksum != VkVideoFrameChecksum::ALGORITHM_NONE) &&
+            !m_frameToFile.EnableChecksum((VkVideoFrameChecksum::Algorithm)programConfig.frameChecksum,
+                                          programConfig.checksumReferenceFileName.c_str())) {
+        return -1;
+    }
+    const bool frameOutput = m_frameToFile;
+
+    if (frameOutput && programConfig.asyncFrameOutput) {
+        m_frameToFile.StartWriterThread(VkVideoFrameToFile::DEFAULT_WRITE_BUFFERS, programConfig.writerCpus);
+    }
+
+    // The frames for the output file are read back from the optimal images into host cached buffers on the
+    // compute queue, instead of from the linear output images. With gpuFrameOutput, a compute shader
+    // deinterleaves them, otherwise the planes are copied and deinterleaved on the host. With
+    // autoFrameOutputConversion, both are timed on the first frame and the faster one is used.
+    m_useGpuFrameOutput = frameOutput && (programConfig.gpuFrameOutput || programConfig.hostCachedFrameOutput ||
+                                          programConfig.autoFrameOutputConversion) &&
+                          (vkDevCtx->GetComputeQueueFamilyIdx() >= 0);
+    m_useFrameToBufferFilter = m_useGpuFrameOutput && programConfig.gpuFrameOutput;
+    m_useAutoFrameOutputConversion = m_useGpuFrameOutput && programConfig.autoFrameOutputConversion &&
+                                     !programConfig.gpuFrameOutput && !programConfig.hostCachedFrameOutput;
+    m_conversionCalibrationCacheFileName = programConfig.conversionCalibrationCacheFileName;
+
     uint32_t enableDecoderFeatures = 0;
-    if (outFile != nullptr) {
+    if (frameOutput && !m_useGpuFrameOutput) {
         enableDecoderFeatures |= VkVideoDecoder::ENABLE_LINEAR_OUTPUT;
     }
 
@@ -125,6 +166,14 @@ int32_t VulkanVideoProcessor::Initialize(const VulkanDeviceContext* vkDevCtx,
         enableDecoderFeatures |= VkVideoDecoder::ENABLE_POST_PROCESS_FILTER;
     }
 
+    if (programConfig.exportFrames) {
+        enableDecoderFeatures |= VkVideoDecoder::ENABLE_EXPORT_OUTPUT;
+    }
+
+    if (programConfig.errorResilient) {
+        enableDecoderFeatures |= VkVideoDecoder::ENABLE_ERROR_RESILIENCE;
+    }
+
     result = VkVideoDecoder::Create(vkDevCtx,
                                     m_vkVideoFrameBuffer,
                                     videoQueueIndx,
@@ -137,6 +186,36 @@ int32_t VulkanVideoProcessor::Initialize(const VulkanDeviceContext* vkDevCtx,
     assert(result == VK_SUCCESS);
     if (result != VK_SUCCESS) {
         fprintf(stderr, "\nERROR: Create VkVideoDecoder result: 0x%x\n", result);
+    } else {
+        m_vkVideoDecoder->SetBitstreamBufferIdleTrimPeriod((uint32_t)std::max(programConfig.bitstreamBufferIdleTrimMs, 0));
+        m_vkVideoDecoder->SetBitstreamRingBufferSize((VkDeviceSize)std::max(programConfig.bitstreamRingBufferSizeMB, 0) * 1024 * 1024);
+        m_vkVideoDecoder->SetDeviceLocalBitstream(programConfig.deviceLocalBitstream);
+        m_vkVideoDecoder->SetDecodeSubmitBatching((uint32_t)std::max(programConfig.decodeSubmitBatchSize, 1),
+                                                  (uint32_t)std::max(programConfig.decodeSubmitBatchLatencyMs, 0));
+        if (programConfig.gpuTimestamps) {
+            m_vkVideoDecoder->EnableGpuTimestamps(programConfig.gpuTimestampsCsvFileName.c_str());
+        }
+        m_vkVideoFrameBuffer->SetIdleImageReleaseFrames((uint32_t)std::max(programConfig.decodeImageIdleFrames, 0));
+        m_metrics.reset(new ProcessorMetrics(m_vkVideoDecoder->GetMetricsLabels()));
+    }
+
+    // The decode status of the pictures is harvested without blocking the decode on it
+    if (programConfig.asyncDecodeStatus || programConfig.errorResilient) {
+        result = VulkanFrameCompletionReaper::Create(vkDevCtx, m_frameCompletionReaper);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: Create VulkanFrameCompletionReaper result: 0x%x\n", result);
+        }
+    }
+
+    // The output frames are analyzed on the compute queue, once their format and extent are known
+    m_useFrameAnalytics = programConfig.frameAnalytics;
+    if (m_useFrameAnalytics && !programConfig.frameAnalyticsCsvFileName.empty()) {
+        m_frameAnalyticsCsvFile = fopen(programConfig.frameAnalyticsCsvFileName.c_str(), "w");
+        if (m_frameAnalyticsCsvFile == nullptr) {
+            fprintf(stderr, "Error opening the frame analytics file %s\n", programConfig.frameAnalyticsCsvFileName.c_str());
+            return -1;
+        }
+        VulkanFrameAnalytics::WriteCsvHeader(m_frameAnalyticsCsvFile);
     }
 
     VkVideoCoreProfile videoProfile(m_videoStreamDemuxer->GetVideoCodec(),
@@ -165,21 +244,107 @@ int32_t VulkanVideoProcessor::Initialize(const VulkanDeviceContext* vkDevCtx,
         return -result;
     }
 
+    if (programConfig.preallocateSession && m_vkVideoDecoder) {
+        // The extent of the capabilities when not given, the first sequence has to fit
+        VkExtent2D maxCodedExtent = videoCapabilities.maxCodedExtent;
+        if ((programConfig.preallocateSessionWidth > 0) && (programConfig.preallocateSessionHeight > 0)) {
+            maxCodedExtent.width = std::min(maxCodedExtent.width, (uint32_t)programConfig.preallocateSessionWidth);
+            maxCodedExtent.height = std::min(maxCodedExtent.height, (uint32_t)programConfig.preallocateSessionHeight);
+        }
+        const uint32_t maxDpbSlots = std::min<uint32_t>(videoCapabilities.maxDpbSlots,
+                                                        VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS);
+        const VkVideoChromaSubsamplingFlagBitsKHR chromaSubsampling =
+                (VkVideoChromaSubsamplingFlagBitsKHR)m_videoStreamDemuxer->GetChromaSubsampling();
+        result = m_vkVideoDecoder->PreallocateVideoSession(m_videoStreamDemuxer->GetVideoCodec(),
+                                                           chromaSubsampling,
+                                                           m_videoStreamDemuxer->GetLumaBitDepth(),
+                                                           m_videoStreamDemuxer->GetChromaBitDepth(),
+                                                           m_videoStreamDemuxer->GetProfileIdc(),
+                                                           maxCodedExtent, maxDpbSlots);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nWARNING: PreallocateVideoSession() %u x %u result: 0x%x\n",
+                    maxCodedExtent.width, maxCodedExtent.height, result);
+        }
+    }
+
+    VkParserDecodeFilter decodeFilter = VkParserDecodeFilter();
+    decodeFilter.referencePicturesOnly = programConfig.decodeReferenceOnly;
+    decodeFilter.randomAccessPicturesOnly = programConfig.decodeKeyFramesOnly;
+    decodeFilter.maxTemporalLayers = (uint32_t)std::max(programConfig.maxTemporalLayers, 0);
+    decodeFilter.maxScalableLayers = (uint32_t)std::max(programConfig.maxScalableLayers, 0);
+    decodeFilter.errorResilient = programConfig.errorResilient;
+    decodeFilter.deferSliceHeaders = programConfig.deferSliceHeaders;
+    decodeFilter.seiPayloadTypesSelected = !programConfig.seiPayloadTypes.empty();
+    for (uint32_t payloadType : programConfig.seiPayloadTypes) {
+        decodeFilter.seiPayloadTypes[payloadType / 32] |= 1u << (payloadType % 32);
+    }
+    m_usesDecodeFilter = (decodeFilter.referencePicturesOnly || decodeFilter.randomAccessPicturesOnly ||
+                          (decodeFilter.maxTemporalLayers > 0));
+
     const uint32_t defaultMinBufferSize = 2 * 1024 * 1024; // 2MB
     result = CreateParser(filePath,
                           m_videoStreamDemuxer->GetVideoCodec(),
                           defaultMinBufferSize,
                           (uint32_t)videoCapabilities.minBitstreamBufferOffsetAlignment,
-                          (uint32_t)videoCapabilities.minBitstreamBufferSizeAlignment);
+                          (uint32_t)videoCapabilities.minBitstreamBufferSizeAlignment,
+                          &decodeFilter,
+                          programConfig.decodeCaptureFileName.c_str());
     assert(result == VK_SUCCESS);
     if (result != VK_SUCCESS) {
         fprintf(stderr, "\nERROR: CreateParser() result: 0x%x\n", result);
     }
 
+    const uint8_t* pParameterSets = nullptr;
+    const int64_t parameterSetsSize = m_videoStreamDemuxer->GetParameterSets(&pParameterSets);
+    if ((result == VK_SUCCESS) && (parameterSetsSize > 0)) {
+        // The parameter sets of the container, the frames demuxed may not repeat them
+        const uint32_t parameterSetsNalLengthSize = 4;
+        ParseVideoStreamData(pParameterSets, (size_t)parameterSetsSize, nullptr, false, 0, 0, nullptr, 0,
+                             parameterSetsNalLengthSize);
+    }
+
+    m_bitstreamWindowSize = std::max<int64_t>(programConfig.bitstreamWindowSize, 0);
+    m_parserCpus = programConfig.parserCpus;
+    m_parserThreadId = std::thread::id();
+    if (m_vkVideoDecoder && !m_usesStreamDemuxer && !m_usesFramePreparser && (m_bitstreamWindowSize == 0)) {
+        // The elementary stream is memory mapped as a whole, let the decoder reference it in place.
+        // Not with a bitstream window: the imported pages would stay resident until the end of the stream.
+        const uint8_t* pBitstreamData = nullptr;
+        const int64_t bitstreamSize = m_videoStreamDemuxer->ReadBitstreamData(&pBitstreamData, 0);
+        if ((bitstreamSize > 0) && (pBitstreamData != nullptr)) {
+            m_vkVideoDecoder->SetHostMappedBitstream(pBitstreamData, (VkDeviceSize)bitstreamSize);
+        }
+    }
+
+    if (m_vkVideoDecoder && (m_usesStreamDemuxer || m_usesFramePreparser)) {
+        // The demux thread writes the frames to host memory the decoder imported once, so that the decode thread
+        // doesn't copy them, and without the packet allocator they are copied to the bitstream buffers instead.
+        const VkDeviceSize packetMemoryBlockSize = 4 * 1024 * 1024;
+        if (VulkanHostMappedMemoryPool::Create(vkDevCtx, vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                               packetMemoryBlockSize, m_packetMemoryPool) == VK_SUCCESS) {
+            m_videoStreamDemuxer->SetPacketAllocator(this);
+        }
+    }
+
     m_loopCount = loopCount;
     m_startFrame = startFrame;
     m_maxFrameCount = maxFrameCount;
 
+    if (m_usesNalPreScanner) {
+        StartNalPreScanner();
+    }
+
+    m_streamIndex.Reset();
+    m_streamIndexFileName = programConfig.streamIndexFileName;
+    m_seekFramesToDrop = 0;
+    if (!m_streamIndexFileName.empty() && !InitStreamIndex()) {
+        return -1;
+    }
+
+    if ((programConfig.seekFrame > 0) && (SeekToFrame((uint32_t)programConfig.seekFrame) < 0)) {
+        return -1;
+    }
+
     return 0;
 }
 
@@ -242,7 +407,33 @@ int32_t VulkanVideoProcessor::GetBitDepth()  const
 
 void VulkanVideoProcessor::Deinit()
 {
+    m_nalPreScanner.Stop();
 
+    // Stop watching the fences before the frame buffer destroys them
+    m_frameCompletionReaper = nullptr;
+    if (m_frameAnalytics) {
+        m_frameAnalytics->Flush();
+        m_frameAnalytics = nullptr;
+    }
+    if (m_frameAnalyticsCsvFile != nullptr) {
+        fclose(m_frameAnalyticsCsvFile);
+        m_frameAnalyticsCsvFile = nullptr;
+    }
+    // The queued frames are written out before their readback resources are released
+    m_frameToFile.FinishChecksum();
+    if (m_frameOutputSelector) {
+        m_frameOutputSelector->PrintStats();
+        m_frameOutputSelector.reset();
+    }
+    m_frameToBufferFilter = nullptr;
+    m_frameToBufferCommandBufferPool = nullptr;
+    for (uint32_t i = 0; i < VkVideoFrameToFile::MAX_WRITE_BUFFERS; i++) {
+        m_frameReadbackBuffers[i] = nullptr;
+    }
+    if (m_videoStreamDemuxer) {
+        m_videoStreamDemuxer->SetPacketAllocator(nullptr);
+    }
+    m_packetMemoryPool = nullptr;
     m_vkParser = nullptr;
     m_vkVideoDecoder = nullptr;
     m_vkVideoFrameBuffer = nullptr;
@@ -378,28 +569,109 @@ void VulkanVideoProcessor::DumpVideoFormat(const VkParserDetectedVideoFormat* vi
 
 const VkMpFormatInfo* YcbcrVkFormatInfo(const VkFormat format);
 
-size_t VulkanVideoProcessor::ConvertFrameToNv12(VulkanDecodedFrame* pFrame,
-                                                VkSharedBaseObj<VkImageResource>& imageResource,
-                                                uint8_t* pOutBuffer, size_t bufferSize)
+bool VulkanVideoProcessor::IsFrameComplete(VulkanDecodedFrame* pFrame) const
 {
-    size_t outputBufferSize = 0;
-    VkResult result = VK_SUCCESS;
+    assert(pFrame->frameCompleteFence != VK_NULL_HANDLE);
+    if (m_frameCompletionReaper) {
+        VulkanFrameCompletionReaper::FrameCompletion completion;
+        return m_frameCompletionReaper->GetCompletion(pFrame->pictureIndex, pFrame->decodeOrder, completion);
+    }
+    if (pFrame->frameCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+        // The post-process filter of the frame signals the value once it is done
+        uint64_t timelineValue = 0;
+        return (m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, pFrame->frameCompleteTimelineSemaphore, &timelineValue) == VK_SUCCESS) &&
+               (timelineValue >= pFrame->frameCompleteTimelineValue);
+    }
+    return (m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, pFrame->frameCompleteFence) == VK_SUCCESS);
+}
 
-    VkDevice device   = imageResource->GetDevice();
-    VkImage  srcImage = imageResource->GetImage ();
-    VkFormat format   = imageResource->GetImageCreateInfo().format;
-    VkSharedBaseObj<VulkanDeviceMemoryImpl> srcImageDeviceMemory(imageResource->GetMemory());
+double VulkanVideoProcessor::GetDecodeGpuTimeMs() const
+{
+    return m_vkVideoDecoder ? m_vkVideoDecoder->GetTotalGpuTimeMs() : 0.0;
+}
+
+int64_t VulkanVideoProcessor::ReplayDecodeCapture(VkVideoDecodeReplay* pDecodeReplay)
+{
+    if (!m_vkVideoDecoder) {
+        return -1;
+    }
+    if (pDecodeReplay->GetCodec() != m_videoStreamDemuxer->GetVideoCodec()) {
+        fprintf(stderr, "\nERROR: The decode capture is not of the codec of the input stream\n");
+        return -1;
+    }
+
+    VkSharedBaseObj<IVulkanVideoDecoderHandler> decoderHandler(m_vkVideoDecoder);
+    const int64_t numPictures = pDecodeReplay->Run(decoderHandler);
+
+    // Like at the end of the stream, then for the pictures submitted to be done
+    m_vkVideoDecoder->FlushDecodeSubmitBatch();
+    m_vkVideoDecoder->FlushPendingFirstField();
+    m_vkVideoDecoder->FlushDecodeCommandBatch();
+    m_vkVideoDecoder->WaitDecodeSubmitThreads();
+    m_vkDevCtx->DeviceWaitIdle();
+
+    return numPictures;
+}
+
+void VulkanVideoProcessor::WaitForFrameCompletion(VulkanDecodedFrame* pFrame)
+{
+    VkResult result = VK_SUCCESS;
+    VkDevice device = *m_vkDevCtx;
 
-    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(format);
     assert(pFrame->frameCompleteFence != VK_NULL_HANDLE);
     const uint64_t fenceTimeout = 100 * 1000 * 1000; // 100 mSec
     int32_t retryCount = 300; // Allow for a timeout of 30s, this should allow for any frame to complete correctly when -o is used.
 
-    do {
+    if (m_frameCompletionReaper) {
+        // The reaper thread watches the fence, check its completion instead of waiting on the fence here.
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+                std::chrono::nanoseconds(fenceTimeout * retryCount);
+        VulkanFrameCompletionReaper::FrameCompletion completion = VulkanFrameCompletionReaper::FrameCompletion();
+        while (!m_frameCompletionReaper->GetCompletion(pFrame->pictureIndex, pFrame->decodeOrder, completion)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                if (m_metrics) {
+                    m_metrics->fenceTimeouts.Add();
+                }
+                VK_LOG_WARNING("\t Timeout on the completion of CurrPicIdx: %d\n", pFrame->pictureIndex);
+                break;
+            }
+            std::this_thread::yield();
+        }
+        if (completion.status == VK_QUERY_RESULT_STATUS_ERROR_KHR) {
+            VK_LOG_WARNING("\t Decoding of the frame failed.\n");
+        }
+        retryCount = 0; // skip the fence polling below
+    }
+
+    if ((retryCount > 0) && (pFrame->frameCompleteTimelineSemaphore != VK_NULL_HANDLE)) {
+        // The filter of the frame is waited on with its timeline value, instead of the fence
+        const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                               &pFrame->frameCompleteTimelineSemaphore,
+                                               &pFrame->frameCompleteTimelineValue };
+        for (; retryCount > 0; retryCount--) {
+            VK_TRACE_ZONE("WaitSemaphores");
+            result = m_vkDevCtx->WaitSemaphores(device, &waitInfo, fenceTimeout);
+            if (result != VK_TIMEOUT) {
+                break;
+            }
+            if (m_metrics) {
+                m_metrics->fenceTimeouts.Add();
+            }
+            VK_LOG_WARNING("WaitSemaphores timeout %llu value %llu retry %d\n", (unsigned long long)fenceTimeout,
+                           (unsigned long long)pFrame->frameCompleteTimelineValue, retryCount);
+        }
+        retryCount = 0; // skip the fence polling below
+    }
+
+    while (retryCount > 0) {
+        VK_TRACE_ZONE("WaitForFences");
         result = m_vkDevCtx->WaitForFences(device, 1, &pFrame->frameCompleteFence, VK_TRUE, fenceTimeout);
+        if ((result == VK_TIMEOUT) && m_metrics) {
+            m_metrics->fenceTimeouts.Add();
+        }
         if (result != VK_SUCCESS) {
-            std::cout << "WaitForFences timeout " << fenceTimeout
-                    << " result " << result << " retry " << retryCount << std::endl << std::flush;
+            VK_LOG_WARNING("WaitForFences timeout %llu result %d retry %d\n", (unsigned long long)fenceTimeout,
+                           result, retryCount);
 
             VkQueryResultStatusKHR decodeStatus = VK_QUERY_RESULT_STATUS_NOT_READY_KHR;
             VkResult queryResult = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx,
@@ -411,25 +683,41 @@ size_t VulkanVideoProcessor::ConvertFrameToNv12(VulkanDecodedFrame* pFrame,
                                                      sizeof(decodeStatus),
                                                      VK_QUERY_RESULT_WITH_STATUS_BIT_KHR);
 
-            printf("\nERROR: GetQueryPoolResults() result: 0x%x\n", queryResult);
-            std::cout << "\t +++++++++++++++++++++++++++< " << (pFrame ? pFrame->pictureIndex : -1)
-                    << " >++++++++++++++++++++++++++++++" << std::endl;
-            std::cout << "\t => Decode Status for CurrPicIdx: " << (pFrame ? pFrame->pictureIndex : -1) << std::endl
-                    << "\t\tdecodeStatus: " << decodeStatus << std::endl;
+            VK_LOG_ERROR("\nERROR: GetQueryPoolResults() result: 0x%x\n", queryResult);
+            VK_LOG_WARNING("\t +++++++++++++++++++++++++++< %d >++++++++++++++++++++++++++++++\n"
+                           "\t => Decode Status for CurrPicIdx: %d\n"
+                           "\t\tdecodeStatus: %d\n",
+                           (pFrame ? pFrame->pictureIndex : -1), (pFrame ? pFrame->pictureIndex : -1), decodeStatus);
 
             if (queryResult == VK_ERROR_DEVICE_LOST) {
-                std::cout << "\t Dropping frame" << std::endl;
+                VK_LOG_WARNING("\t Dropping frame\n");
                 break;
             }
 
             if ((queryResult == VK_SUCCESS) && (decodeStatus == VK_QUERY_RESULT_STATUS_ERROR_KHR)) {
-                std::cout << "\t Decoding of the frame failed." << std::endl;
+                VK_LOG_WARNING("\t Decoding of the frame failed.\n");
                 break;
             }
         }
 
         retryCount--;
-    } while ((result == VK_TIMEOUT) && (retryCount > 0));
+        if (result != VK_TIMEOUT) {
+            break;
+        }
+    }
+}
+
+size_t VulkanVideoProcessor::ConvertFrameToOutputFormat(VulkanDecodedFrame* pFrame,
+                                                        VkSharedBaseObj<VkImageResource>& imageResource,
+                                                        uint8_t* pOutBuffer, size_t bufferSize)
+{
+    VkDevice device   = imageResource->GetDevice();
+    VkImage  srcImage = imageResource->GetImage ();
+    VkFormat format   = imageResource->GetImageCreateInfo().format;
+    VkSharedBaseObj<VulkanDeviceMemoryImpl> srcImageDeviceMemory(imageResource->GetMemory());
+
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(format);
+    WaitForFrameCompletion(pFrame);
 
     // Map the image and read the image data.
     VkDeviceSize imageOffset = imageResource->GetImageDeviceMemoryOffset();
@@ -437,17 +725,11 @@ size_t VulkanVideoProcessor::ConvertFrameToNv12(VulkanDecodedFrame* pFrame,
     const uint8_t* readImagePtr = srcImageDeviceMemory->GetReadOnlyDataPtr(imageOffset, maxSize);
     assert(readImagePtr != nullptr);
 
-    int secondaryPlaneHeight = pFrame->displayHeight;
-    int imageHeight = pFrame->displayHeight;
     bool isUnnormalizedRgba = false;
     if (mpInfo && (mpInfo->planesLayout.layout == YCBCR_SINGLE_PLANE_UNNORMALIZED) && !(mpInfo->planesLayout.disjoint)) {
         isUnnormalizedRgba = true;
     }
 
-    if (mpInfo && mpInfo->planesLayout.secondaryPlaneSubsampledY) {
-        secondaryPlaneHeight /= 2;
-    }
-
     VkImageSubresource subResource = {};
     VkSubresourceLayout layouts[3];
     memset(layouts, 0x00, sizeof(layouts));
@@ -483,23 +765,67 @@ size_t VulkanVideoProcessor::ConvertFrameToNv12(VulkanDecodedFrame* pFrame,
         m_vkDevCtx->GetImageSubresourceLayout(device, srcImage, &subResource, &layouts[0]);
     }
 
+    return ConvertPlanesToOutputFormat(mpInfo, pFrame->displayWidth, pFrame->displayHeight, readImagePtr, layouts,
+                                       (m_frameToFile.GetOutputFormat() == VkVideoFrameToFile::OUTPUT_FORMAT_SEMI_PLANAR),
+                                       pOutBuffer);
+}
+
+size_t VulkanVideoProcessor::ConvertPlanesToOutputFormat(const VkMpFormatInfo* mpInfo,
+                                                         int32_t displayWidth, int32_t displayHeight,
+                                                         const uint8_t* readImagePtr,
+                                                         const VkSubresourceLayout layouts[3],
+                                                         bool semiPlanarOutput,
+                                                         uint8_t* pOutBuffer)
+{
+    size_t outputBufferSize = 0;
+
+    int secondaryPlaneHeight = displayHeight;
+    int imageHeight = displayHeight;
+    bool isUnnormalizedRgba = false;
+    if (mpInfo && (mpInfo->planesLayout.layout == YCBCR_SINGLE_PLANE_UNNORMALIZED) && !(mpInfo->planesLayout.disjoint)) {
+        isUnnormalizedRgba = true;
+    }
+
+    if (mpInfo && mpInfo->planesLayout.secondaryPlaneSubsampledY) {
+        secondaryPlaneHeight /= 2;
+    }
+
     // Treat all non 8bpp formats as 16bpp for output to prevent any loss.
     uint32_t bytesPerPixel = 1;
     if (mpInfo->planesLayout.bpp != YCBCRA_8BPP) {
         bytesPerPixel = 2;
     }
 
+    // The semi-planar output keeps the decoded planes, only their rows are copied without the padding.
+    if (semiPlanarOutput && !isUnnormalizedRgba && (mpInfo->planesLayout.layout == YCBCR_SEMI_PLANAR_CBCR_INTERLEAVED)) {
+
+        const size_t rowSize[2] = { (size_t)displayWidth * bytesPerPixel,
+                                    (size_t)(mpInfo->planesLayout.secondaryPlaneSubsampledX ?
+                                                 (displayWidth / 2) : displayWidth) * 2 * bytesPerPixel };
+        const int planeHeight[2] = { imageHeight, secondaryPlaneHeight };
+        uint8_t* pDst = pOutBuffer;
+        for (uint32_t plane = 0; plane < 2; plane++) {
+            const uint8_t* pSrc = readImagePtr + layouts[plane].offset;
+            for (int height = 0; height < planeHeight[plane]; height++) {
+                memcpy(pDst, pSrc, rowSize[plane]);
+                pDst += rowSize[plane];
+                pSrc += (size_t)layouts[plane].rowPitch;
+            }
+        }
+        return (size_t)(pDst - pOutBuffer);
+    }
+
     uint32_t numPlanes = 3;
     VkSubresourceLayout yuvPlaneLayouts[3] = {};
     yuvPlaneLayouts[0].offset = 0;
-    yuvPlaneLayouts[0].rowPitch = pFrame->displayWidth * bytesPerPixel;
-    yuvPlaneLayouts[1].offset = yuvPlaneLayouts[0].rowPitch * pFrame->displayHeight;
-    yuvPlaneLayouts[1].rowPitch = pFrame->displayWidth * bytesPerPixel;
+    yuvPlaneLayouts[0].rowPitch = displayWidth * bytesPerPixel;
+    yuvPlaneLayouts[1].offset = yuvPlaneLayouts[0].rowPitch * displayHeight;
+    yuvPlaneLayouts[1].rowPitch = displayWidth * bytesPerPixel;
     if (mpInfo && mpInfo->planesLayout.secondaryPlaneSubsampledX) {
         yuvPlaneLayouts[1].rowPitch /= 2;
     }
     yuvPlaneLayouts[2].offset = yuvPlaneLayouts[1].offset + (yuvPlaneLayouts[1].rowPitch * secondaryPlaneHeight);
-    yuvPlaneLayouts[2].rowPitch = pFrame->displayWidth * bytesPerPixel;
+    yuvPlaneLayouts[2].rowPitch = displayWidth * bytesPerPixel;
     if (mpInfo && mpInfo->planesLayout.secondaryPlaneSubsampledX) {
         yuvPlaneLayouts[2].rowPitch /= 2;
     }
@@ -546,6 +872,299 @@ size_t VulkanVideoProcessor::ConvertFrameToNv12(VulkanDecodedFrame* pFrame,
     return outputBufferSize;
 }
 
+VkResult VulkanVideoProcessor::InitGpuFrameOutput(VkFormat imageFormat, bool copyPlanes)
+{
+    // The filter is created with the first frame deinterleaved on the GPU, which can come after the first copy
+    VkResult result = VK_SUCCESS;
+    if (!copyPlanes && !m_frameToBufferFilter) {
+        result = InitFrameToBufferFilter(imageFormat);
+        if (result != VK_SUCCESS) {
+            m_frameToBufferFilter = nullptr;
+            return result;
+        }
+    }
+
+    if (m_frameToBufferCommandBufferPool) {
+        return VK_SUCCESS;
+    }
+
+    result = VulkanCommandBufferPool::Create(m_vkDevCtx, m_frameToBufferCommandBufferPool);
+    if (result == VK_SUCCESS) {
+        result = m_frameToBufferCommandBufferPool->Configure(m_vkDevCtx,
+                                                             m_frameToFile.GetNumBuffers(), // numPoolNodes, one per frame in flight
+                                                             m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                                             false,    // createQueryPool
+                                                             nullptr,  // pVideoProfile
+                                                             false,    // createSemaphores
+                                                             true      // createFences
+                                                            );
+    }
+    if (result != VK_SUCCESS) {
+        m_frameToBufferFilter = nullptr;
+        m_frameToBufferCommandBufferPool = nullptr;
+    }
+    return result;
+}
+
+VkResult VulkanVideoProcessor::InitFrameToBufferFilter(VkFormat imageFormat)
+{
+    // The sampler is not used by the filter, only required by its descriptor set layout
+    const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
+               VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+               nullptr,
+               imageFormat,
+               VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709,
+               VK_SAMPLER_YCBCR_RANGE_ITU_NARROW,
+               { VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY
+               },
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_FILTER_LINEAR,
+               false
+               };
+
+    static const VkSamplerCreateInfo samplerInfo = {
+               VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+               nullptr,
+               0,
+               VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+               VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+               // mipLodBias  anisotropyEnable  maxAnisotropy  compareEnable      compareOp         minLod  maxLod          borderColor
+               // unnormalizedCoordinates
+               0.0, false, 0.00, false, VK_COMPARE_OP_NEVER, 0.0, 16.0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false
+    };
+
+    const YcbcrPrimariesConstants ycbcrPrimariesConstants = GetYcbcrPrimariesConstants(YcbcrBtStandardBt709);
+
+    return VulkanFilterYuvCompute::Create(m_vkDevCtx,
+                                          m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                          0,
+                                          VulkanFilterYuvCompute::YCBCR2BUFFER,
+                                          1,
+                                          imageFormat,
+                                          imageFormat,
+                                          &ycbcrConversionCreateInfo,
+                                          &ycbcrPrimariesConstants,
+                                          &samplerInfo,
+                                          m_frameToBufferFilter);
+}
+
+bool VulkanVideoProcessor::SetY4mStreamHeader(VulkanDecodedFrame* pFrame, VkFormat imageFormat)
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(imageFormat);
+    if (mpInfo == nullptr) {
+        return false;
+    }
+
+    const uint32_t bitDepth = 8 + (2 * mpInfo->planesLayout.bpp);
+    const char* chromaFormat = "mono";
+    if (mpInfo->planesLayout.numberOfExtraPlanes > 0) {
+        chromaFormat = mpInfo->planesLayout.secondaryPlaneSubsampledY ? "420" :
+                       (mpInfo->planesLayout.secondaryPlaneSubsampledX ? "422" : "444");
+    }
+    char colorSpace[16];
+    if (bitDepth > 8) {
+        snprintf(colorSpace, sizeof(colorSpace), "%sp%u", chromaFormat, bitDepth);
+    } else {
+        snprintf(colorSpace, sizeof(colorSpace), "%s", chromaFormat);
+    }
+
+    // The variable or unknown frame rates are written as 30 fps
+    const VkParserDetectedVideoFormat* pVideoFormat = m_vkVideoDecoder->GetVideoFormatInfo();
+    uint32_t frameRateNumerator = pVideoFormat->frame_rate.numerator;
+    uint32_t frameRateDenominator = pVideoFormat->frame_rate.denominator;
+    if ((frameRateNumerator == 0) || (frameRateDenominator == 0)) {
+        frameRateNumerator = 30;
+        frameRateDenominator = 1;
+    }
+
+    if (!m_frameToFile.SetY4mStreamHeader(pFrame->displayWidth, pFrame->displayHeight,
+                                          frameRateNumerator, frameRateDenominator,
+                                          colorSpace, bitDepth)) {
+        fprintf(stderr, "\nERROR: The frame %dx%d %s doesn't match the format of the Y4M stream, dropped\n",
+                pFrame->displayWidth, pFrame->displayHeight, colorSpace);
+        return false;
+    }
+    return true;
+}
+
+size_t VulkanVideoProcessor::SubmitFrameReadback(VulkanDecodedFrame* pFrame,
+                                                 VkSharedBaseObj<VkImageResource>& imageResource,
+                                                 uint32_t bufferIndex,
+                                                 bool useFilter,
+                                                 VkSharedBaseObj<VulkanCommandBufferPool::PoolNode>& cmdBuffer,
+                                                 VkSubresourceLayout bufferPlaneLayouts[3])
+{
+    const VkImageCreateInfo& imageCreateInfo = imageResource->GetImageCreateInfo();
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(imageCreateInfo.format);
+    if ((mpInfo == nullptr) || (mpInfo->planesLayout.layout != YCBCR_SEMI_PLANAR_CBCR_INTERLEAVED)) {
+        fprintf(stderr, "\nERROR: The frames of format %d can't be read back to the output buffers\n", imageCreateInfo.format);
+        return 0;
+    }
+
+
+    // The same layouts as ConvertFrameToOutputFormat(), tightly packed. The planes are copied as they are
+    // without the filter, or for the semi-planar output. Otherwise the filter deinterleaves them.
+    const bool copyPlanes = !useFilter ||
+                            (m_frameToFile.GetOutputFormat() == VkVideoFrameToFile::OUTPUT_FORMAT_SEMI_PLANAR);
+    const VkDeviceSize bytesPerPixel = (mpInfo->planesLayout.bpp != YCBCRA_8BPP) ? 2 : 1;
+    const VkDeviceSize chromaWidth = mpInfo->planesLayout.secondaryPlaneSubsampledX ? (pFrame->displayWidth / 2) : pFrame->displayWidth;
+    const VkDeviceSize chromaHeight = mpInfo->planesLayout.secondaryPlaneSubsampledY ? (pFrame->displayHeight / 2) : pFrame->displayHeight;
+    const uint32_t numPlanes = copyPlanes ? 2 : 3;
+    VkSubresourceLayout yuvPlaneLayouts[3] = {};
+    yuvPlaneLayouts[0].rowPitch = pFrame->displayWidth * bytesPerPixel;
+    yuvPlaneLayouts[0].size = yuvPlaneLayouts[0].rowPitch * pFrame->displayHeight;
+    for (uint32_t plane = 1; plane < numPlanes; plane++) {
+        yuvPlaneLayouts[plane].offset = yuvPlaneLayouts[plane - 1].offset + yuvPlaneLayouts[plane - 1].size;
+        yuvPlaneLayouts[plane].rowPitch = chromaWidth * bytesPerPixel * (copyPlanes ? 2 : 1);
+        yuvPlaneLayouts[plane].size = yuvPlaneLayouts[plane].rowPitch * chromaHeight;
+    }
+    const VkDeviceSize frameSize = yuvPlaneLayouts[numPlanes - 1].offset + yuvPlaneLayouts[numPlanes - 1].size;
+    memcpy(bufferPlaneLayouts, yuvPlaneLayouts, sizeof(yuvPlaneLayouts));
+
+    if (!m_frameToBufferCommandBufferPool || (!copyPlanes && !m_frameToBufferFilter)) {
+        VkResult result = InitGpuFrameOutput(imageCreateInfo.format, copyPlanes);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: InitGpuFrameOutput() result: 0x%x\n", result);
+            return 0;
+        }
+    }
+
+    VkSharedBaseObj<VkBufferResource>& readbackBuffer = m_frameReadbackBuffers[bufferIndex];
+    if (!readbackBuffer || (readbackBuffer->GetMaxSize() < frameSize)) {
+        // Sized for the largest frame, the resolution changes rarely grow it again.
+        const VkDeviceSize bufferSize = std::max<VkDeviceSize>(imageResource->GetImageDeviceMemorySize(), frameSize);
+        readbackBuffer = nullptr;
+        VkResult result = VkBufferResource::Create(m_vkDevCtx,
+                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                   (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  |
+                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT),
+                                                   (bufferSize + 3) & ~(VkDeviceSize)3,
+                                                   readbackBuffer);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: Create the frame readback buffer result: 0x%x\n", result);
+            return 0;
+        }
+    }
+
+    // The compute queue can't wait on the video decode stages, the host does before the submission
+    WaitForFrameCompletion(pFrame);
+
+    m_frameToBufferCommandBufferPool->GetAvailablePoolNode(cmdBuffer);
+    assert(cmdBuffer != nullptr);
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkCommandBuffer cmdBuf = cmdBuffer->BeginCommandBufferRecording(beginInfo);
+
+    // The decoder leaves the output in the DPB layout when the output and the DPB coincide.
+    const VkImageLayout decodedImageLayout = ((imageCreateInfo.usage & VK_IMAGE_USAGE_VIDEO_DECODE_DPB_BIT_KHR) != 0) ?
+                                                 VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR : VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR;
+    VkImageMemoryBarrier2KHR imageBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr };
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+    imageBarrier.dstStageMask = copyPlanes ? VK_PIPELINE_STAGE_2_COPY_BIT_KHR : VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.dstAccessMask = copyPlanes ? VK_ACCESS_2_TRANSFER_READ_BIT_KHR : VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+    imageBarrier.oldLayout = decodedImageLayout;
+    imageBarrier.newLayout = copyPlanes ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = imageResource->GetImage();
+    imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, pFrame->imageLayerIndex, 1 };
+
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR, nullptr };
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    if (copyPlanes) {
+        VkBufferImageCopy copyRegions[2] = {};
+        for (uint32_t plane = 0; plane < 2; plane++) {
+            copyRegions[plane].bufferOffset = yuvPlaneLayouts[plane].offset;
+            copyRegions[plane].bufferRowLength = (uint32_t)((plane == 0) ? pFrame->displayWidth : chromaWidth);
+            copyRegions[plane].imageSubresource = { (VkImageAspectFlags)((plane == 0) ? VK_IMAGE_ASPECT_PLANE_0_BIT :
+                                                                                        VK_IMAGE_ASPECT_PLANE_1_BIT),
+                                                    0, pFrame->imageLayerIndex, 1 };
+            copyRegions[plane].imageExtent = { copyRegions[plane].bufferRowLength,
+                                               (uint32_t)((plane == 0) ? pFrame->displayHeight : chromaHeight), 1 };
+        }
+        m_vkDevCtx->CmdCopyImageToBuffer(cmdBuf, imageResource->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                         readbackBuffer->GetBuffer(), 2, copyRegions);
+    } else {
+        VkVideoPictureResourceInfoKHR pictureResourceInfo = { VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR, nullptr };
+        pictureResourceInfo.baseArrayLayer = pFrame->imageLayerIndex;
+        const VkExtent2D frameExtent { (uint32_t)pFrame->displayWidth, (uint32_t)pFrame->displayHeight };
+        VulkanFilterYuvCompute* pFilter = static_cast<VulkanFilterYuvCompute*>(m_frameToBufferFilter.Get());
+        pFilter->RecordCommandBuffer(cmdBuf, pFrame->imageView, &pictureResourceInfo, frameExtent,
+                                     readbackBuffer, yuvPlaneLayouts);
+    }
+
+    // Back to the layout of the decoder, and the buffer writes made visible to the host
+    imageBarrier.srcStageMask = imageBarrier.dstStageMask;
+    imageBarrier.srcAccessMask = imageBarrier.dstAccessMask;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = imageBarrier.newLayout;
+    imageBarrier.newLayout = decodedImageLayout;
+
+    VkBufferMemoryBarrier2KHR bufferBarrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR, nullptr };
+    bufferBarrier.srcStageMask = copyPlanes ? VK_PIPELINE_STAGE_2_COPY_BIT_KHR : VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    bufferBarrier.srcAccessMask = copyPlanes ? VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR : VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = readbackBuffer->GetBuffer();
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+
+    dependencyInfo.bufferMemoryBarrierCount = 1;
+    dependencyInfo.pBufferMemoryBarriers = &bufferBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    VkResult result = cmdBuffer->EndCommandBufferRecording(cmdBuf);
+    if (result != VK_SUCCESS) {
+        cmdBuffer = nullptr;
+        return 0;
+    }
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = cmdBuffer->GetCommandBuffer();
+    result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::COMPUTE, 0, 1, &submitInfo,
+                                                  cmdBuffer->GetFence());
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: Submit the frame readback result: 0x%x\n", result);
+        cmdBuffer->ResetCommandBuffer(false);
+        cmdBuffer = nullptr;
+        return 0;
+    }
+    cmdBuffer->SetCommandBufferSubmitted();
+
+    return (size_t)frameSize;
+}
+
+const uint8_t* VulkanVideoProcessor::GetFrameReadbackData(VkSharedBaseObj<VulkanCommandBufferPool::PoolNode>& cmdBuffer,
+                                                          VkSharedBaseObj<VkBufferResource>& readbackBuffer,
+                                                          size_t frameSize)
+{
+    VkResult result = cmdBuffer->SyncHostOnCmdBuffComplete();
+    cmdBuffer->ResetCommandBuffer(false);
+    if (result != VK_SUCCESS) {
+        return nullptr;
+    }
+
+    readbackBuffer->InvalidateRange(0, frameSize);
+    VkDeviceSize maxSize = 0;
+    const uint8_t* pFrameData = readbackBuffer->GetReadOnlyDataPtr(0, maxSize);
+    assert((pFrameData != nullptr) && (maxSize >= frameSize));
+    return pFrameData;
+}
+
 size_t VulkanVideoProcessor::OutputFrameToFile(VulkanDecodedFrame* pFrame)
 {
     if (!m_frameToFile) {
@@ -557,27 +1176,267 @@ size_t VulkanVideoProcessor::OutputFrameToFile(VulkanDecodedFrame* pFrame)
     assert(pFrame->pictureIndex != -1);
 
     VkSharedBaseObj<VkImageResource> imageResource = pFrame->imageView->GetImageResource();
-    uint8_t* pLinearMemory = m_frameToFile.EnsureAllocation(m_vkDevCtx, imageResource);
+
+    if ((m_frameToFile.GetOutputFormat() == VkVideoFrameToFile::OUTPUT_FORMAT_Y4M) &&
+            !SetY4mStreamHeader(pFrame, imageResource->GetImageCreateInfo().format)) {
+        return (size_t)-1;
+    }
+
+    // With the writer thread, the frame goes to the next buffer of its ring and is written in the background.
+    const bool asyncWrite = m_frameToFile.IsWriterThreadRunning();
+    const uint32_t bufferIndex = asyncWrite ? m_frameToFile.AcquireBuffer() : 0;
+
+    if (m_useGpuFrameOutput) {
+        const bool semiPlanarOutput = (m_frameToFile.GetOutputFormat() == VkVideoFrameToFile::OUTPUT_FORMAT_SEMI_PLANAR);
+        const bool useFilter = (m_useAutoFrameOutputConversion && !semiPlanarOutput) ?
+                                   SelectFrameOutputPath(pFrame, imageResource, bufferIndex) : m_useFrameToBufferFilter;
+
+        // The frame is written straight from the mapped readback buffer, without a copy on the host.
+        VkSharedBaseObj<VulkanCommandBufferPool::PoolNode> cmdBuffer;
+        VkSubresourceLayout bufferPlaneLayouts[3];
+        const size_t frameSize = SubmitFrameReadback(pFrame, imageResource, bufferIndex, useFilter,
+                                                     cmdBuffer, bufferPlaneLayouts);
+        if (frameSize == 0) {
+            return (size_t)-1;
+        }
+
+        VkSharedBaseObj<VkBufferResource> readbackBuffer(m_frameReadbackBuffers[bufferIndex]);
+        VkVideoFrameToFile::GetFrameDataFunc getFrameData = [cmdBuffer, readbackBuffer, frameSize]() mutable {
+            return GetFrameReadbackData(cmdBuffer, readbackBuffer, frameSize);
+        };
+
+        // Without the filter, the copied planes are deinterleaved on the host once the copy completes.
+        // The planar frame has the size of the semi-planar one.
+        if (!useFilter && !semiPlanarOutput) {
+            uint8_t* pLinearMemory = m_frameToFile.EnsureAllocation(m_vkDevCtx, imageResource, bufferIndex);
+            assert(pLinearMemory != nullptr);
+            const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(imageResource->GetImageCreateInfo().format);
+            const int32_t displayWidth = pFrame->displayWidth;
+            const int32_t displayHeight = pFrame->displayHeight;
+            getFrameData = [getFrameData, mpInfo, displayWidth, displayHeight,
+                            bufferPlaneLayouts, pLinearMemory]() mutable -> const uint8_t* {
+                const uint8_t* pPlanes = getFrameData();
+                if (pPlanes == nullptr) {
+                    return nullptr;
+                }
+                ConvertPlanesToOutputFormat(mpInfo, displayWidth, displayHeight, pPlanes, bufferPlaneLayouts,
+                                            false, pLinearMemory);
+                return pLinearMemory;
+            };
+        }
+
+        if (asyncWrite) {
+            m_frameToFile.QueueWrite(bufferIndex, frameSize, getFrameData);
+            return frameSize;
+        }
+
+        const uint8_t* pFrameData = getFrameData();
+        if (pFrameData == nullptr) {
+            return (size_t)-1;
+        }
+        return m_frameToFile.WriteBufferToFile(pFrameData, frameSize);
+    }
+
+    // The linear image is reused once the frame is released, it is converted before the writer thread gets it.
+    uint8_t* pLinearMemory = m_frameToFile.EnsureAllocation(m_vkDevCtx, imageResource, bufferIndex);
     assert(pLinearMemory != nullptr);
 
     // Needed allocation size can shrink, but may never grow. Frames will be allocated for maximum resolution upfront.
     assert((pFrame->displayWidth >= 0) && (pFrame->displayHeight >= 0));
 
     // Convert frame to linear image format.
-    size_t usedBufferSize = ConvertFrameToNv12(pFrame,
-                                               imageResource,
-                                               pLinearMemory,
-                                               m_frameToFile.GetMaxFrameSize());
+    size_t usedBufferSize = ConvertFrameToOutputFormat(pFrame,
+                                                       imageResource,
+                                                       pLinearMemory,
+                                                       m_frameToFile.GetMaxFrameSize(bufferIndex));
+
+    if (asyncWrite) {
+        m_frameToFile.QueueWrite(bufferIndex, usedBufferSize, [pLinearMemory]() -> const uint8_t* {
+            return pLinearMemory;
+        });
+        return usedBufferSize;
+    }
 
     // Write image to file.
     return m_frameToFile.WriteDataToFile(0, usedBufferSize);
 }
 
+bool VulkanVideoProcessor::SelectFrameOutputPath(VulkanDecodedFrame* pFrame, VkSharedBaseObj<VkImageResource>& imageResource,
+                                                 uint32_t bufferIndex)
+{
+    if (!m_frameOutputSelector) {
+        uint8_t deviceUuid[VK_UUID_SIZE];
+        m_vkDevCtx->GetPhysicalDeviceUuid(deviceUuid);
+        std::stringstream cacheKey;
+        cacheKey << pFrame->displayWidth << "x" << pFrame->displayHeight << " format "
+                 << imageResource->GetImageCreateInfo().format << " output " << m_frameToFile.GetOutputFormat();
+        m_frameOutputSelector.reset(new VkConversionPathSelector("Frame output conversion",
+                                                                 m_conversionCalibrationCacheFileName.c_str(),
+                                                                 deviceUuid, cacheKey.str()));
+    }
+
+    // The frames queued to the writer thread, the GPU is busier with the decode when they pile up
+    const double queueOccupancy = m_frameToFile.GetNumBuffersInUse();
+    if (m_frameOutputSelector->NeedsCalibration()) {
+        // The calibration converts the frame to its own buffers, before it is converted again for the file
+        m_frameOutputSelector->Calibrate([this, pFrame, &imageResource, bufferIndex](VkConversionPathSelector::Path path) {
+            return RunFrameOutputConversion(pFrame, imageResource, bufferIndex,
+                                            (path == VkConversionPathSelector::PATH_GPU));
+        }, queueOccupancy);
+    }
+    m_frameOutputSelector->OnFrame(queueOccupancy);
+    return (m_frameOutputSelector->GetPath() == VkConversionPathSelector::PATH_GPU);
+}
+
+bool VulkanVideoProcessor::RunFrameOutputConversion(VulkanDecodedFrame* pFrame,
+                                                    VkSharedBaseObj<VkImageResource>& imageResource,
+                                                    uint32_t bufferIndex, bool useFilter)
+{
+    VkSharedBaseObj<VulkanCommandBufferPool::PoolNode> cmdBuffer;
+    VkSubresourceLayout bufferPlaneLayouts[3];
+    const size_t frameSize = SubmitFrameReadback(pFrame, imageResource, bufferIndex, useFilter,
+                                                 cmdBuffer, bufferPlaneLayouts);
+    if (frameSize == 0) {
+        return false;
+    }
+
+    const uint8_t* pPlanes = GetFrameReadbackData(cmdBuffer, m_frameReadbackBuffers[bufferIndex], frameSize);
+    if (pPlanes == nullptr) {
+        return false;
+    }
+    if (useFilter) {
+        return true;
+    }
+
+    uint8_t* pLinearMemory = m_frameToFile.EnsureAllocation(m_vkDevCtx, imageResource, bufferIndex);
+    if (pLinearMemory == nullptr) {
+        return false;
+    }
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(imageResource->GetImageCreateInfo().format);
+    ConvertPlanesToOutputFormat(mpInfo, pFrame->displayWidth, pFrame->displayHeight, pPlanes, bufferPlaneLayouts,
+                                false, pLinearMemory);
+    return true;
+}
+
 void VulkanVideoProcessor::Restart(void)
 {
+    // The parser starts the sequence again, the decoder keeps its session and images when it is the same one
     m_videoStreamDemuxer->Rewind();
     m_videoFrameNum = false;
     m_currentBitstreamOffset = 0;
+    m_seekFramesToDrop = 0;
+    if (m_usesNalPreScanner) {
+        StartNalPreScanner();
+    }
+}
+
+void VulkanVideoProcessor::StartNalPreScanner(size_t startOffset)
+{
+    const uint8_t* pBitstreamData = nullptr;
+    const int64_t bitstreamSize = m_videoStreamDemuxer->ReadBitstreamData(&pBitstreamData, 0);
+    if ((bitstreamSize > 0) && (pBitstreamData != nullptr)) {
+        m_nalPreScanner.Start(pBitstreamData, (size_t)bitstreamSize, startOffset);
+    }
+}
+
+bool VulkanVideoProcessor::InitStreamIndex()
+{
+    if (m_usesStreamDemuxer || m_usesFramePreparser) {
+        std::cerr << "The random access points are only indexed for elementary streams" << std::endl;
+        return false;
+    }
+
+    const uint8_t* pBitstreamData = nullptr;
+    const int64_t bitstreamSize = m_videoStreamDemuxer->ReadBitstreamData(&pBitstreamData, 0);
+    if ((bitstreamSize <= 0) || (pBitstreamData == nullptr)) {
+        return false;
+    }
+
+    const VkVideoCodecOperationFlagBitsKHR codec = m_videoStreamDemuxer->GetVideoCodec();
+    const char* indexFileName = m_streamIndexFileName.empty() ? nullptr : m_streamIndexFileName.c_str();
+    if ((indexFileName != nullptr) && m_streamIndex.Load(indexFileName, (size_t)bitstreamSize, codec)) {
+        return true;
+    }
+
+    if (!m_streamIndex.Build(pBitstreamData, (size_t)bitstreamSize, codec) || !m_streamIndex.IsValid()) {
+        std::cerr << "No random access point found in the stream" << std::endl;
+        return false;
+    }
+    std::cout << "Indexed " << m_streamIndex.GetNumEntries() << " random access points of "
+              << m_streamIndex.GetNumFrames() << " pictures" << std::endl;
+
+    if ((indexFileName != nullptr) && !m_streamIndex.Save(indexFileName)) {
+        std::cerr << "Unable to write the stream index file: " << indexFileName << std::endl;
+    }
+    return true;
+}
+
+int32_t VulkanVideoProcessor::SeekToFrame(uint32_t frameNumber)
+{
+    if (!m_vkParser || (!m_streamIndex.IsValid() && !InitStreamIndex())) {
+        return -1;
+    }
+
+    const VkVideoStreamIndex::Entry* pEntry = m_streamIndex.FindEntry(frameNumber);
+    if (pEntry == nullptr) {
+        std::cerr << "No random access point before frame " << frameNumber << std::endl;
+        return -1;
+    }
+
+    // End the stream for the parser, which outputs and resets its DPB, and drop the frames it outputs
+    ParseVideoStreamData(nullptr, 0);
+    VulkanDecodedFrame frame;
+    while (m_vkVideoFrameBuffer->DequeueDecodedPicture(&frame) > 0) {
+        ReleaseFrame(&frame);
+    }
+
+    const uint8_t* pBitstreamData = nullptr;
+    m_videoStreamDemuxer->ReadBitstreamData(&pBitstreamData, 0);
+    if (!pEntry->hasParameterSets && (m_streamIndex.GetStreamHeaderSize() > 0)) {
+        // The picture may only be preceded by its parameter sets at the start of the stream
+        size_t bitstreamBytesConsumed = 0;
+        ParseVideoStreamData(pBitstreamData, m_streamIndex.GetStreamHeaderSize(), &bitstreamBytesConsumed, true);
+    }
+
+    m_currentBitstreamOffset = (int64_t)pEntry->offset;
+    m_videoStreamsCompleted = false;
+    // The index counts all the pictures, not the ones left by the decode filter: decoding starts at the entry
+    m_seekFramesToDrop = m_usesDecodeFilter ? 0 : (frameNumber - pEntry->frameNumber);
+    if (m_usesNalPreScanner) {
+        StartNalPreScanner((size_t)pEntry->offset);
+    }
+
+    return 0;
+}
+
+int64_t VulkanVideoProcessor::FindRandomAccessFrame(uint32_t frameNumber)
+{
+    if (!m_vkParser || (!m_streamIndex.IsValid() && !InitStreamIndex())) {
+        return -1;
+    }
+    if (frameNumber >= m_streamIndex.GetNumFrames()) {
+        return -1;
+    }
+    const VkVideoStreamIndex::Entry* pEntry = m_streamIndex.FindEntry(frameNumber);
+    return (pEntry != nullptr) ? (int64_t)pEntry->frameNumber : -1;
+}
+
+double VulkanVideoProcessor::GetFrameRate() const
+{
+    const VkParserDetectedVideoFormat* pVideoFormat = m_vkVideoDecoder->GetVideoFormatInfo();
+    if ((pVideoFormat == nullptr) ||
+            (pVideoFormat->frame_rate.numerator == 0) || (pVideoFormat->frame_rate.denominator == 0)) {
+        return 30.0;
+    }
+    return (double)pVideoFormat->frame_rate.numerator / pVideoFormat->frame_rate.denominator;
+}
+
+uint8_t* VulkanVideoProcessor::AllocatePacketMemory(size_t size, VkSharedBaseObj<VkVideoRefCountBase>& packetMemory)
+{
+    VkSharedBaseObj<VulkanHostMappedMemory> hostMappedMemory;
+    uint8_t* pData = m_packetMemoryPool ? m_packetMemoryPool->Allocate((VkDeviceSize)size, hostMappedMemory) : nullptr;
+    packetMemory = hostMappedMemory;
+    return pData;
 }
 
 bool VulkanVideoProcessor::StreamCompleted()
@@ -589,6 +1448,10 @@ bool VulkanVideoProcessor::StreamCompleted()
         return false;
     } else {
         std::cout << "End of Video Stream with status  " << VK_SUCCESS << std::endl;
+        if (m_vkVideoDecoder && (m_vkVideoDecoder->GetPictureParametersRecreationCount() > 0)) {
+            std::cout << "Video session parameters objects recreated: "
+                      << m_vkVideoDecoder->GetPictureParametersRecreationCount() << std::endl;
+        }
         return true;
     }
 }
@@ -604,20 +1467,58 @@ int32_t VulkanVideoProcessor::ParserProcessNextDataChunk()
     size_t  bitstreamBytesConsumed = 0;
     const uint8_t* pBitstreamData = nullptr;
     bool requiresPartialParsing = false;
+    uint32_t nalLengthSize = 0;
+    uint32_t packetFlags = 0;
+    int64_t presentationTimestamp = 0;
+    int64_t decodeTimestamp = 0;
     if (m_usesFramePreparser || m_usesStreamDemuxer) {
         bitstreamChunkSize = m_videoStreamDemuxer->DemuxFrame(&pBitstreamData);
+        nalLengthSize = m_videoStreamDemuxer->GetNalLengthSize();
+        if ((bitstreamChunkSize > 0) &&
+                m_videoStreamDemuxer->GetFrameTimestamps(&presentationTimestamp, &decodeTimestamp)) {
+            // The parser reorders the presentation time stamps of the container to the display order
+            packetFlags |= VK_PARSER_PKT_TIMESTAMP;
+            if (decodeTimestamp != std::numeric_limits<int64_t>::min()) {
+                packetFlags |= VK_PARSER_PKT_DECODE_TIMESTAMP;
+            } else {
+                decodeTimestamp = 0;
+            }
+        }
+        VkSharedBaseObj<VulkanHostMappedMemory> packetMemory;
+        if (m_packetMemoryPool && (bitstreamChunkSize > 0) &&
+                m_packetMemoryPool->FindMemory(pBitstreamData, (VkDeviceSize)bitstreamChunkSize, packetMemory)) {
+            // Written with start codes by the demuxer, for the decoder to reference it in place
+            m_vkVideoDecoder->SetHostMappedBitstream(packetMemory);
+            nalLengthSize = 0;
+        }
         assert(bitstreamBytesConsumed <= (size_t)std::numeric_limits<int32_t>::max());
         retValue = (int32_t)bitstreamChunkSize;
     } else {
         bitstreamChunkSize = m_videoStreamDemuxer->ReadBitstreamData(&pBitstreamData, m_currentBitstreamOffset);
+        if (m_bitstreamWindowSize > 0) {
+            // The window can end in the middle of a NAL unit, the parser keeps its start for the next call
+            bitstreamChunkSize = std::min(bitstreamChunkSize, m_bitstreamWindowSize);
+        }
         requiresPartialParsing = true;
     }
     const bool bitstreamHasMoreData = ((bitstreamChunkSize > 0) && (pBitstreamData != nullptr));
     if (bitstreamHasMoreData) {
+        VkFrameLatency::MarkDemuxed();
         assert((uint64_t)bitstreamChunkSize < (uint64_t)std::numeric_limits<size_t>::max());
+        size_t startCodeScanLength = 0;
+        if (m_nalPreScanner.IsStarted()) {
+            startCodeScanLength = m_nalPreScanner.GetStartCodes((size_t)m_currentBitstreamOffset,
+                                                                (size_t)bitstreamChunkSize,
+                                                                m_startCodeOffsets);
+        }
         VkResult parserStatus = ParseVideoStreamData(pBitstreamData, (size_t)bitstreamChunkSize,
                                                      &bitstreamBytesConsumed,
-                                                     requiresPartialParsing);
+                                                     requiresPartialParsing,
+                                                     packetFlags, presentationTimestamp,
+                                                     (startCodeScanLength > 0) ? &m_startCodeOffsets : nullptr,
+                                                     startCodeScanLength,
+                                                     nalLengthSize,
+                                                     decodeTimestamp);
         if (parserStatus != VK_SUCCESS) {
             m_videoStreamsCompleted = true;
             std::cerr << "Parser: end of Video Stream with status  " << parserStatus << std::endl;
@@ -627,6 +1528,11 @@ int32_t VulkanVideoProcessor::ParserProcessNextDataChunk()
         }
         assert(bitstreamBytesConsumed <= (size_t)std::numeric_limits<int32_t>::max());
         m_currentBitstreamOffset += bitstreamBytesConsumed;
+        if (requiresPartialParsing && (m_bitstreamWindowSize > 0) &&
+                (m_currentBitstreamOffset > m_bitstreamWindowSize)) {
+            // One window behind the cursor, for the NAL unit being parsed to stay resident
+            m_videoStreamDemuxer->DiscardBitstreamData(m_currentBitstreamOffset - m_bitstreamWindowSize);
+        }
     } else {
         // Call the parser one last time with zero buffer to flush the display queue.
         ParseVideoStreamData(nullptr, 0, &bitstreamBytesConsumed, requiresPartialParsing);
@@ -639,29 +1545,65 @@ int32_t VulkanVideoProcessor::ParserProcessNextDataChunk()
 
 int32_t VulkanVideoProcessor::GetNextFrame(VulkanDecodedFrame* pFrame, bool* endOfStream)
 {
+    // The frames are parsed, recorded and submitted on the calling thread, which is only known from here on
+    if (!m_parserCpus.empty() && (m_parserThreadId != std::this_thread::get_id())) {
+        m_parserThreadId = std::this_thread::get_id();
+        VkSetCurrentThreadAffinity(m_parserCpus);
+    }
+
     // The below call to DequeueDecodedPicture allows returning the next frame without parsing of the stream.
     // Parsing is only done when there are no more frames in the queue.
-    int32_t framesInQueue = m_vkVideoFrameBuffer->DequeueDecodedPicture(pFrame);
+    int32_t framesInQueue = DequeueDecodedPicture(pFrame);
 
     // Loop until a frame (or more) is parsed and added to the queue.
-    while ((framesInQueue == 0) && !m_videoStreamsCompleted) {
+    // After a seek, the frames in front of its target are dropped.
+    while (((framesInQueue == 0) || (m_seekFramesToDrop > 0)) && !m_videoStreamsCompleted) {
 
-        ParserProcessNextDataChunk();
+        if (framesInQueue != 0) {
+            m_seekFramesToDrop--;
+            ReleaseFrame(pFrame);
+        } else {
+            ParserProcessNextDataChunk();
+        }
 
-        framesInQueue = m_vkVideoFrameBuffer->DequeueDecodedPicture(pFrame);
+        framesInQueue = DequeueDecodedPicture(pFrame);
     }
 
     if (framesInQueue) {
 
+        // The display needs this picture now, submit it if it is still batched or with a submit thread
+        m_vkVideoDecoder->FlushDecodeSubmitBatch(pFrame->pictureIndex);
+        m_vkVideoDecoder->WaitDecodeSubmitThreads(pFrame->pictureIndex);
+
+        if (m_frameCompletionReaper) {
+            m_frameCompletionReaper->Track(pFrame->pictureIndex, pFrame->decodeOrder, pFrame->frameCompleteFence,
+                                           pFrame->queryPool, pFrame->startQueryId);
+
+            VulkanFrameCompletionReaper::FrameCompletion completion;
+            while (m_frameCompletionReaper->PopCompletion(completion)) {
+                if (completion.status != VK_QUERY_RESULT_STATUS_COMPLETE_KHR) {
+                    VK_LOG_WARNING("\t Decoding of picture %d (decode order %llu) failed with status %d\n",
+                                   (int32_t)completion.pictureIndex, (unsigned long long)completion.decodeOrder,
+                                   completion.status);
+                }
+            }
+        }
+
         if (m_videoFrameNum == 0) {
             DumpVideoFormat(m_vkVideoDecoder->GetVideoFormatInfo(), true);
         }
 
+        if (m_useFrameAnalytics) {
+            AnalyzeFrame(pFrame);
+        }
+
         if (m_frameToFile) {
             OutputFrameToFile(pFrame);
+            VkFrameLatency::Record(VK_FRAME_LATENCY_OUTPUT, pFrame->decodeOrder);
         }
 
         m_videoFrameNum++;
+        UpdateOutputMetrics();
     }
 
     if ((m_maxFrameCount != -1) && (m_videoFrameNum >= (uint32_t)m_maxFrameCount)) {
@@ -682,32 +1624,152 @@ int32_t VulkanVideoProcessor::GetNextFrame(VulkanDecodedFrame* pFrame, bool* end
     return 1;
 }
 
+void VulkanVideoProcessor::AnalyzeFrame(VulkanDecodedFrame* pFrame)
+{
+    if (!pFrame->imageView) {
+        return;
+    }
+
+    const VkFormat imageFormat = pFrame->imageView->GetImageResource()->GetImageCreateInfo().format;
+    const VkExtent2D extent = { (uint32_t)pFrame->displayWidth, (uint32_t)pFrame->displayHeight };
+    if (m_frameAnalytics && !m_frameAnalytics->IsCompatible(imageFormat, extent)) {
+        // The frames of a new sequence aren't compared with the ones of the previous sequence
+        m_frameAnalytics->Flush();
+        m_frameAnalytics = nullptr;
+    }
+
+    VkResult result = VK_SUCCESS;
+    if (!m_frameAnalytics) {
+        result = VulkanFrameAnalytics::Create(m_vkDevCtx, imageFormat, extent, frameAnalyticsSlots,
+                                              m_frameAnalyticsCsvFile, m_frameAnalytics);
+    }
+    if (result == VK_SUCCESS) {
+        result = m_frameAnalytics->SubmitFrame(m_videoFrameNum, *pFrame);
+    }
+    if (result != VK_SUCCESS) {
+        VK_LOG_WARNING("\t The frame analytics are disabled, format %d result %d\n", imageFormat, result);
+        m_useFrameAnalytics = false;
+        m_frameAnalytics = nullptr;
+    }
+}
+
 int32_t VulkanVideoProcessor::ReleaseFrame(VulkanDecodedFrame* pDisplayedFrame)
 {
-    if (pDisplayedFrame->pictureIndex != -1) {
-        DecodedFrameRelease decodedFramesRelease = { pDisplayedFrame->pictureIndex };
-        DecodedFrameRelease* decodedFramesReleasePtr = &decodedFramesRelease;
+    return ReleaseFrames(pDisplayedFrame, 1);
+}
+
+int32_t VulkanVideoProcessor::ReleaseFrames(VulkanDecodedFrame* pDisplayedFrames, uint32_t numFrames)
+{
+    // Released to the frame buffer with one call, in chunks of the size of its picture mask
+    const uint32_t maxFramesPerRelease = 32;
+    DecodedFrameRelease decodedFramesRelease[maxFramesPerRelease];
+    DecodedFrameRelease* decodedFramesReleasePtrs[maxFramesPerRelease];
+
+    int32_t result = -1;
+    uint32_t frameIndex = 0;
+    while (frameIndex < numFrames) {
+        uint32_t numFramesToRelease = 0;
+        for (; (frameIndex < numFrames) && (numFramesToRelease < maxFramesPerRelease); frameIndex++) {
+            VulkanDecodedFrame* pDisplayedFrame = &pDisplayedFrames[frameIndex];
+            if (pDisplayedFrame->pictureIndex == -1) {
+                continue;
+            }
+
+            DecodedFrameRelease& decodedFrameRelease = decodedFramesRelease[numFramesToRelease];
+            decodedFrameRelease = DecodedFrameRelease();
+            decodedFrameRelease.pictureIndex = pDisplayedFrame->pictureIndex;
+            pDisplayedFrame->pictureIndex = -1;
+
+            decodedFrameRelease.decodeOrder = pDisplayedFrame->decodeOrder;
+            decodedFrameRelease.displayOrder = pDisplayedFrame->displayOrder;
+
+            decodedFrameRelease.hasConsummerSignalFence = pDisplayedFrame->hasConsummerSignalFence;
+            decodedFrameRelease.hasConsummerSignalSemaphore = pDisplayedFrame->hasConsummerSignalSemaphore;
+            decodedFrameRelease.consumerDoneTimelineSemaphore = pDisplayedFrame->frameConsumerDoneTimelineSemaphore;
+            decodedFrameRelease.consumerDoneTimelineValue = pDisplayedFrame->frameConsumerDoneTimelineValue;
+            decodedFrameRelease.timestamp = pDisplayedFrame->timestamp;
+
+            VkFrameLatency::Record(VK_FRAME_LATENCY_RELEASED, pDisplayedFrame->decodeOrder);
+            decodedFramesReleasePtrs[numFramesToRelease] = &decodedFrameRelease;
+            numFramesToRelease++;
+        }
+
+        if (numFramesToRelease == 0) {
+            continue;
+        }
 
-        pDisplayedFrame->pictureIndex = -1;
+        if (m_metrics) {
+            m_metrics->imagesHeld.Add(-(double)numFramesToRelease);
+        }
+        result = m_vkVideoFrameBuffer->ReleaseDisplayedPicture(decodedFramesReleasePtrs, numFramesToRelease);
+    }
 
-        decodedFramesRelease.decodeOrder = pDisplayedFrame->decodeOrder;
-        decodedFramesRelease.displayOrder = pDisplayedFrame->displayOrder;
+    return result;
+}
 
-        decodedFramesRelease.hasConsummerSignalFence = pDisplayedFrame->hasConsummerSignalFence;
-        decodedFramesRelease.hasConsummerSignalSemaphore = pDisplayedFrame->hasConsummerSignalSemaphore;
-        decodedFramesRelease.timestamp = 0;
+VulkanVideoProcessor::ProcessorMetrics::ProcessorMetrics(const std::string& labels)
+    : framesOutput(VkMetrics::GetCounter("vkvideo_decoder_frames_output_total",
+                                         "Decoded frames returned in display order", labels))
+    , fps(VkMetrics::GetGauge("vkvideo_decoder_fps", "Output frame rate over the last second", labels))
+    , displayQueueDepth(VkMetrics::GetGauge("vkvideo_decoder_display_queue_depth",
+                                            "Decoded frames waiting in the display queue", labels))
+    , imagesHeld(VkMetrics::GetGauge("vkvideo_decoder_images_held",
+                                     "Output frames held by the application, not released yet", labels))
+    , images(VkMetrics::GetGauge("vkvideo_decoder_images", "Images of the decoder frame buffer", labels))
+    , fenceTimeouts(VkMetrics::GetCounter("vkvideo_decoder_fence_timeouts_total",
+                                          "Timeouts waiting for the completion of a frame", labels))
+{
+}
 
-        return m_vkVideoFrameBuffer->ReleaseDisplayedPicture(&decodedFramesReleasePtr, 1);
+int32_t VulkanVideoProcessor::DequeueDecodedPicture(VulkanDecodedFrame* pFrame)
+{
+    const int32_t framesInQueue = m_vkVideoFrameBuffer->DequeueDecodedPicture(pFrame);
+    if (framesInQueue > 0) {
+        VkFrameLatency::Record(VK_FRAME_LATENCY_DEQUEUED, pFrame->decodeOrder);
     }
+    if (m_metrics) {
+        // The count includes the frame just dequeued
+        m_metrics->displayQueueDepth.Set((framesInQueue > 0) ? (framesInQueue - 1) : 0);
+        if (framesInQueue > 0) {
+            m_metrics->imagesHeld.Add(1.0);
+        }
+    }
+    return framesInQueue;
+}
 
-    return -1;
+void VulkanVideoProcessor::UpdateOutputMetrics()
+{
+    if (!m_metrics) {
+        return;
+    }
+    m_metrics->framesOutput.Add();
+
+    // From the output counter, which the restarts of the stream don't reset
+    const uint64_t numFrames = m_metrics->framesOutput.Get();
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (m_metricsFpsStartFrame == 0) {
+        m_metricsFpsStartTime = now;
+        m_metricsFpsStartFrame = numFrames;
+        return;
+    }
+    const double elapsedSec = std::chrono::duration<double>(now - m_metricsFpsStartTime).count();
+    if (elapsedSec >= 1.0) {
+        m_metrics->fps.Set((double)(numFrames - m_metricsFpsStartFrame) / elapsedSec);
+        m_metricsFpsStartTime = now;
+        m_metricsFpsStartFrame = numFrames;
+        if (VkMetrics::IsEnabled()) {
+            m_metrics->images.Set((double)m_vkVideoFrameBuffer->GetSize());
+        }
+    }
 }
 
 VkResult VulkanVideoProcessor::CreateParser(const char* filename,
                                             VkVideoCodecOperationFlagBitsKHR vkCodecType,
                                             uint32_t defaultMinBufferSize,
                                             uint32_t bufferOffsetAlignment,
-                                            uint32_t bufferSizeAlignment)
+                                            uint32_t bufferSizeAlignment,
+                                            const VkParserDecodeFilter* pDecodeFilter,
+                                            const char* decodeCaptureFileName)
 {
     static const VkExtensionProperties h264StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_SPEC_VERSION };
     static const VkExtensionProperties h265StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_SPEC_VERSION };
@@ -723,6 +1785,15 @@ VkResult VulkanVideoProcessor::CreateParser(const char* filename,
     }
 
     VkSharedBaseObj<IVulkanVideoDecoderHandler> decoderHandler(m_vkVideoDecoder);
+    if ((decodeCaptureFileName != nullptr) && (decodeCaptureFileName[0] != '\0')) {
+        // The parser calls the decoder through the capture, released with the parser
+        VkSharedBaseObj<IVulkanVideoDecoderHandler> captureHandler;
+        VkResult result = VkVideoDecodeCapture::Create(decodeCaptureFileName, vkCodecType, decoderHandler, captureHandler);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        decoderHandler = captureHandler;
+    }
     VkSharedBaseObj<IVulkanVideoFrameBufferParserCb> videoFrameBufferCb(m_vkVideoFrameBuffer);
     return vulkanCreateVideoParser(decoderHandler,
                                    videoFrameBufferCb,
@@ -734,12 +1805,17 @@ VkResult VulkanVideoProcessor::CreateParser(const char* filename,
                                    bufferOffsetAlignment,
                                    bufferSizeAlignment,
                                    0, // clockRate - default 0 = 10Mhz
+                                   pDecodeFilter,
                                    m_vkParser);
 }
 
 VkResult VulkanVideoProcessor::ParseVideoStreamData(const uint8_t* pData, size_t size,
                                                     size_t *pnVideoBytes, bool doPartialParsing,
-                                                    uint32_t flags, int64_t timestamp) {
+                                                    uint32_t flags, int64_t timestamp,
+                                                    const std::vector<size_t>* pStartCodeOffsets,
+                                                    size_t startCodeScanLength,
+                                                    uint32_t nalLengthSize,
+                                                    int64_t decodeTimestamp) {
     if (!m_vkParser) {
         assert(!"Parser not initialized!");
         return VK_ERROR_INITIALIZATION_FAILED;
@@ -753,9 +1829,24 @@ VkResult VulkanVideoProcessor::ParseVideoStreamData(const uint8_t* pData, size_t
         packet.flags |= VK_PARSER_PKT_TIMESTAMP;
     }
     packet.timestamp = timestamp;
+    packet.decodeTimestamp = decodeTimestamp;
+    if (pStartCodeOffsets != nullptr) {
+        packet.startCodeOffsets = pStartCodeOffsets->data();
+        packet.startCodeOffsetsCount = (uint32_t)pStartCodeOffsets->size();
+        packet.startCodeScanLength = startCodeScanLength;
+    }
+    packet.nalLengthSize = nalLengthSize;
     if (!pData || size == 0) {
         packet.flags |= VK_PARSER_PKT_ENDOFSTREAM;
     }
 
-    return m_vkParser->ParseVideoData(&packet, pnVideoBytes, doPartialParsing);
+    VkResult result = m_vkParser->ParseVideoData(&packet, pnVideoBytes, doPartialParsing);
+
+    if ((packet.flags & VK_PARSER_PKT_ENDOFSTREAM) && m_vkVideoDecoder) {
+        // The stream may end on an unpaired field, complete it for the display
+        m_vkVideoDecoder->FlushDecodeSubmitBatch();
+        m_vkVideoDecoder->FlushPendingFirstField();
+    }
+
+    return result;
 }
@@ -17,13 +17,26 @@
 #ifndef _VULKANVIDEOPROCESSOR_H_
 #define _VULKANVIDEOPROCESSOR_H_
 
+#include <memory>
+
 #include "VkDecoderUtils/VideoStreamDemuxer.h"
 #include "VkVideoDecoder/VkVideoDecoder.h"
+#include "VkVideoDecoder/VkVideoDecodeReplay.h"
 #include "VkCodecUtils/VkVideoFrameToFile.h"
 #include "VkCodecUtils/ProgramConfig.h"
 #include "VkCodecUtils/VkVideoQueue.h"
+#include "VkCodecUtils/VkNalPreScanner.h"
+#include "VkCodecUtils/VkVideoStreamIndex.h"
+#include "VkCodecUtils/VulkanFrameCompletionReaper.h"
+#include "VkCodecUtils/VulkanFrameAnalytics.h"
+#include "VkCodecUtils/VulkanCommandBufferPool.h"
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VulkanHostMappedBitstream.h"
+#include "VkCodecUtils/VkMetrics.h"
+#include "VkCodecUtils/VkConversionPathSelector.h"
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
 
-class VulkanVideoProcessor : public VkVideoQueue<VulkanDecodedFrame> {
+class VulkanVideoProcessor : public VkVideoQueue<VulkanDecodedFrame>, public VideoStreamPacketAllocator {
 public:
 
     virtual bool IsValid(void)    const { return m_vkVideoDecoder; }
@@ -33,6 +46,7 @@ public:
     virtual VkFormat GetFrameImageFormat(int32_t* pWidth = NULL, int32_t* pHeight = NULL, int32_t* pBitDepth = NULL)  const;
     virtual int32_t GetNextFrame(VulkanDecodedFrame* pFrame, bool* endOfStream);
     virtual int32_t ReleaseFrame(VulkanDecodedFrame* pDisplayedFrame);
+    virtual int32_t ReleaseFrames(VulkanDecodedFrame* pDisplayedFrames, uint32_t numFrames);
 
     static VkSharedBaseObj<VulkanVideoProcessor>& invalidVulkanVideoProcessor;
 
@@ -63,8 +77,35 @@ public:
     int32_t ParserProcessNextDataChunk();
 
     size_t OutputFrameToFile(VulkanDecodedFrame* pFrame);
+
+    // Non-blocking, true once the device is done decoding the frame.
+    bool IsFrameComplete(VulkanDecodedFrame* pFrame) const;
+    void WaitForFrameCompletion(VulkanDecodedFrame* pFrame);
+
+    // The device time of the decode commands so far, needs the gpuTimestamps option.
+    double GetDecodeGpuTimeMs() const;
     void Restart(void);
 
+    // Restarts the decoding from the last random access point at or before frameNumber, counted in display
+    // order from the start of the stream, and drops the frames in front of frameNumber. The frames returned
+    // by GetNextFrame() must be released first. Elementary streams only, the index of their random access
+    // points is built or loaded on the first seek.
+    int32_t SeekToFrame(uint32_t frameNumber);
+
+    // The frame number of the random access point SeekToFrame() restarts from for frameNumber, -1 past the last
+    // picture of the stream or without an index of its random access points.
+    int64_t FindRandomAccessFrame(uint32_t frameNumber);
+
+    // Feeds the calls of a decode capture to the decoder, bypassing the parser, and waits for the pictures to be
+    // decoded. Returns the number of pictures decoded, negative on an error. Instead of the decoding of the stream.
+    int64_t ReplayDecodeCapture(VkVideoDecodeReplay* pDecodeReplay);
+
+    // Of the stream, once its first frame is decoded. 30 fps when variable or unknown.
+    double GetFrameRate() const;
+
+    // The demuxed frames are written to the blocks of m_packetMemoryPool, imported by the decoder
+    virtual uint8_t* AllocatePacketMemory(size_t size, VkSharedBaseObj<VkVideoRefCountBase>& packetMemory);
+
 private:
 
     VulkanVideoProcessor(const VulkanDeviceContext* vkDevCtx)
@@ -74,15 +115,41 @@ private:
         , m_vkVideoFrameBuffer()
         , m_vkVideoDecoder()
         , m_vkParser()
+        , m_frameCompletionReaper()
+        , m_packetMemoryPool()
         , m_currentBitstreamOffset(0)
+        , m_bitstreamWindowSize(0)
         , m_videoFrameNum(0)
         , m_videoStreamsCompleted(false)
         , m_usesStreamDemuxer(false)
         , m_usesFramePreparser(false)
+        , m_usesNalPreScanner(false)
+        , m_usesDecodeFilter(false)
+        , m_nalPreScanner()
+        , m_parserCpus()
+        , m_parserThreadId()
+        , m_startCodeOffsets()
+        , m_streamIndex()
+        , m_streamIndexFileName()
+        , m_seekFramesToDrop(0)
         , m_frameToFile()
+        , m_useGpuFrameOutput(false)
+        , m_useFrameToBufferFilter(false)
+        , m_useAutoFrameOutputConversion(false)
+        , m_conversionCalibrationCacheFileName()
+        , m_frameOutputSelector()
+        , m_frameToBufferFilter()
+        , m_frameToBufferCommandBufferPool()
+        , m_frameReadbackBuffers()
+        , m_useFrameAnalytics(false)
+        , m_frameAnalytics()
+        , m_frameAnalyticsCsvFile(nullptr)
         , m_loopCount(1)
         , m_startFrame(0)
         , m_maxFrameCount(-1)
+        , m_metrics()
+        , m_metricsFpsStartTime()
+        , m_metricsFpsStartFrame(0)
     {
     }
 
@@ -92,17 +159,49 @@ private:
                           VkVideoCodecOperationFlagBitsKHR vkCodecType,
                           uint32_t defaultMinBufferSize,
                           uint32_t bufferOffsetAlignment,
-                          uint32_t bufferSizeAlignment);
+                          uint32_t bufferSizeAlignment,
+                          const VkParserDecodeFilter* pDecodeFilter = nullptr,
+                          const char* decodeCaptureFileName = nullptr);
 
     VkResult ParseVideoStreamData(const uint8_t* pData, size_t size,
                                   size_t* pnVideoBytes = nullptr,
                                   bool doPartialParsing = false,
-                                  uint32_t flags = 0, int64_t timestamp = 0);
-    size_t ConvertFrameToNv12(VulkanDecodedFrame* pFrame, VkSharedBaseObj<VkImageResource>& imageResource,
-                              uint8_t* pOutputBuffer, size_t bufferSize);
+                                  uint32_t flags = 0, int64_t timestamp = 0,
+                                  const std::vector<size_t>* pStartCodeOffsets = nullptr,
+                                  size_t startCodeScanLength = 0,
+                                  uint32_t nalLengthSize = 0,
+                                  int64_t decodeTimestamp = 0);
+    void StartNalPreScanner(size_t startOffset = 0);
+    bool InitStreamIndex();
+    size_t ConvertFrameToOutputFormat(VulkanDecodedFrame* pFrame, VkSharedBaseObj<VkImageResource>& imageResource,
+                                      uint8_t* pOutputBuffer, size_t bufferSize);
+    VkResult InitGpuFrameOutput(VkFormat imageFormat, bool copyPlanes);
+    VkResult InitFrameToBufferFilter(VkFormat imageFormat);
+    bool SetY4mStreamHeader(VulkanDecodedFrame* pFrame, VkFormat imageFormat);
+    static size_t ConvertPlanesToOutputFormat(const VkMpFormatInfo* mpInfo, int32_t displayWidth, int32_t displayHeight,
+                                              const uint8_t* readImagePtr, const VkSubresourceLayout layouts[3],
+                                              bool semiPlanarOutput, uint8_t* pOutBuffer);
+    size_t SubmitFrameReadback(VulkanDecodedFrame* pFrame, VkSharedBaseObj<VkImageResource>& imageResource,
+                               uint32_t bufferIndex, bool useFilter,
+                               VkSharedBaseObj<VulkanCommandBufferPool::PoolNode>& cmdBuffer,
+                               VkSubresourceLayout bufferPlaneLayouts[3]);
+    static const uint8_t* GetFrameReadbackData(VkSharedBaseObj<VulkanCommandBufferPool::PoolNode>& cmdBuffer,
+                                               VkSharedBaseObj<VkBufferResource>& readbackBuffer,
+                                               size_t frameSize);
+    // With autoFrameOutputConversion, true if the frame is deinterleaved by m_frameToBufferFilter
+    bool SelectFrameOutputPath(VulkanDecodedFrame* pFrame, VkSharedBaseObj<VkImageResource>& imageResource,
+                               uint32_t bufferIndex);
+    // Reads the frame back and deinterleaves it on the path, waiting for the readback to complete
+    bool RunFrameOutputConversion(VulkanDecodedFrame* pFrame, VkSharedBaseObj<VkImageResource>& imageResource,
+                                  uint32_t bufferIndex, bool useFilter);
 
 
+    // Submits the analytics of the output frame, its consumers wait for them
+    void AnalyzeFrame(VulkanDecodedFrame* pFrame);
+
     bool StreamCompleted();
+    int32_t DequeueDecodedPicture(VulkanDecodedFrame* pFrame);
+    void UpdateOutputMetrics();
 
 private:
     std::atomic<int32_t>       m_refCount;
@@ -111,15 +210,52 @@ private:
     VkSharedBaseObj<VulkanVideoFrameBuffer> m_vkVideoFrameBuffer;
     VkSharedBaseObj<VkVideoDecoder> m_vkVideoDecoder;
     VkSharedBaseObj<IVulkanVideoParser> m_vkParser;
+    VkSharedBaseObj<VulkanFrameCompletionReaper> m_frameCompletionReaper;
+    VkSharedBaseObj<VulkanHostMappedMemoryPool> m_packetMemoryPool; // of the demuxed frames, if the device can import it
     int64_t  m_currentBitstreamOffset;
+    int64_t  m_bitstreamWindowSize; // of the elementary stream parsed per call, 0 for the rest of the stream
     uint32_t m_videoFrameNum;
     uint32_t m_videoStreamsCompleted : 1;
     uint32_t m_usesStreamDemuxer : 1;
     uint32_t m_usesFramePreparser : 1;
+    uint32_t m_usesNalPreScanner : 1;
+    uint32_t m_usesDecodeFilter : 1; // the parser drops some of the pictures
+    VkNalPreScanner m_nalPreScanner;
+    std::vector<uint32_t> m_parserCpus; // of the threads calling GetNextFrame(), pinned on their first call
+    std::thread::id m_parserThreadId;
+    std::vector<size_t> m_startCodeOffsets;
+    VkVideoStreamIndex m_streamIndex;
+    std::string m_streamIndexFileName;
+    uint32_t m_seekFramesToDrop;
     VkVideoFrameToFile m_frameToFile;
+    uint32_t m_useGpuFrameOutput : 1; // the frames are read back through m_frameReadbackBuffers
+    uint32_t m_useFrameToBufferFilter : 1; // and deinterleaved by m_frameToBufferFilter
+    uint32_t m_useAutoFrameOutputConversion : 1; // or by it or the host, as m_frameOutputSelector chooses per frame
+    std::string m_conversionCalibrationCacheFileName;
+    std::unique_ptr<VkConversionPathSelector> m_frameOutputSelector; // created with the first frame output
+    VkSharedBaseObj<VulkanFilter> m_frameToBufferFilter; // YCBCR2BUFFER of the frames to the output file planes
+    VkSharedBaseObj<VulkanCommandBufferPool> m_frameToBufferCommandBufferPool;
+    // host cached, written by m_frameToBufferFilter, one per buffer of the frame writer
+    VkSharedBaseObj<VkBufferResource> m_frameReadbackBuffers[VkVideoFrameToFile::MAX_WRITE_BUFFERS];
+    uint32_t m_useFrameAnalytics : 1;
+    VkSharedBaseObj<VulkanFrameAnalytics> m_frameAnalytics; // created with the first output frame of its format and extent
+    FILE* m_frameAnalyticsCsvFile;
     int32_t   m_loopCount;
     uint32_t  m_startFrame;
     int32_t   m_maxFrameCount;
+    struct ProcessorMetrics { // of the stream of m_vkVideoDecoder, once it is created
+        explicit ProcessorMetrics(const std::string& labels);
+
+        VkMetricCounter& framesOutput;
+        VkMetricGauge&   fps;               // of the output, over the last second
+        VkMetricGauge&   displayQueueDepth; // the decoded frames waiting for GetNextFrame()
+        VkMetricGauge&   imagesHeld;        // the frames returned by GetNextFrame() not released yet
+        VkMetricGauge&   images;            // of the frame buffer, sampled while the metrics are enabled
+        VkMetricCounter& fenceTimeouts;
+    };
+    std::unique_ptr<ProcessorMetrics> m_metrics;
+    std::chrono::steady_clock::time_point m_metricsFpsStartTime;
+    uint64_t m_metricsFpsStartFrame;
 };
 
 #endif /* _VULKANVIDEOPROCESSOR_H_ */
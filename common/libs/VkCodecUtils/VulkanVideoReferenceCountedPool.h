@@ -135,6 +135,24 @@ public:
         return freeNodeSlotIndx;
     }
 
+    // Drop the pool references of all the nodes no one else is holding and free their slots.
+    // Returns the number of nodes released.
+    uint32_t ReleaseAvailableNodes()
+    {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+
+        uint32_t numReleasedNodes = 0;
+        for (uint32_t i = 0; i < m_maxNodes; i++) {
+            if (m_pool[i] && (1 == m_pool[i]->GetRefCount())) {
+                m_pool[i] = nullptr;
+                m_poolNodesInUseMask[i] = false;
+                m_poolNodeSlotsInUseMask[i] = false;
+                numReleasedNodes++;
+            }
+        }
+        return numReleasedNodes;
+    }
+
 private:
     // These functions must be called with the m_poolMutex lock obtained unavailable
     int32_t GetAvailableNodeIndx(bool setUnavailable = true) {
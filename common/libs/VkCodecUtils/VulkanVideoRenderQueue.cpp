@@ -0,0 +1,242 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "VkCodecUtils/VulkanVideoRenderQueue.h"
+
+VkResult VulkanVideoRenderQueue::Create(VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                                        RenderPolicy renderPolicy, uint32_t queueDepth,
+                                        VkSharedBaseObj<VulkanVideoRenderQueue>& renderQueue)
+{
+    if (!decoderQueue) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VulkanVideoRenderQueue> vkRenderQueue(new VulkanVideoRenderQueue(decoderQueue, renderPolicy,
+                                                                                     std::max(queueDepth, 1U)));
+    if (vkRenderQueue) {
+        renderQueue = vkRenderQueue;
+        return VK_SUCCESS;
+    }
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+void VulkanVideoRenderQueue::EnableAdaptiveDepth(uint32_t minDepth, double maxLatencyMs)
+{
+    assert(!m_renderThread.joinable());
+    m_depthController.reset(new VkDecodeAheadController(std::min(minDepth, m_queueDepth), m_queueDepth, maxLatencyMs));
+}
+
+static double GetTimeMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void VulkanVideoRenderQueue::StartRenderThread()
+{
+    std::lock_guard<std::mutex> lock(m_releaseMutex);
+    if (m_renderThreadRunning || m_endOfStream) {
+        return;
+    }
+    m_renderThreadRunning = true;
+    m_renderThread = std::thread(&VulkanVideoRenderQueue::RenderThread, this);
+}
+
+void VulkanVideoRenderQueue::ReleasePendingFrames()
+{
+    std::vector<VulkanDecodedFrame> pendingReleases;
+    {
+        std::lock_guard<std::mutex> lock(m_releaseMutex);
+        pendingReleases.swap(m_pendingReleases);
+    }
+    if (!pendingReleases.empty()) {
+        m_decoderQueue->ReleaseFrames(pendingReleases.data(), (uint32_t)pendingReleases.size());
+    }
+}
+
+void VulkanVideoRenderQueue::RenderThread()
+{
+    bool endOfStream = false;
+    while (!m_stopRequested && !endOfStream) {
+
+        // The frames of the presenter are back to the decoder before the next decode needs them
+        ReleasePendingFrames();
+
+        if (m_depthController) {
+            // Holds the decode back at the depth, below the capacity of the queue
+            std::unique_lock<std::mutex> lock(m_depthMutex);
+            m_depthCondition.wait(lock, [this]() {
+                return m_stopRequested || (m_numQueued < (int32_t)m_depthController->GetDepth());
+            });
+        }
+
+        const double decodeStartMs = GetTimeMs();
+        RenderNode node;
+        node.numFrames = m_decoderQueue->GetNextFrame(&node.frame, &node.endOfStream);
+        endOfStream = node.endOfStream && (node.numFrames < 0);
+        if (node.numFrames > 0) {
+            m_numDecoded++;
+            if (m_depthController) {
+                m_depthController->OnFrameDecoded(GetTimeMs() - decodeStartMs);
+            }
+        }
+
+        // Blocks while the queue is full, until the presenter takes a frame or the queue is stopped
+        m_numQueued++;
+        if (!m_renderQueue.Push(node)) {
+            m_numQueued--;
+            if (node.numFrames > 0) {
+                m_decoderQueue->ReleaseFrame(&node.frame);
+            }
+            break;
+        }
+    }
+
+    // From now on, the frames are released to the decoder directly by the presenter
+    std::lock_guard<std::mutex> lock(m_releaseMutex);
+    if (!m_pendingReleases.empty()) {
+        m_decoderQueue->ReleaseFrames(m_pendingReleases.data(), (uint32_t)m_pendingReleases.size());
+    }
+    m_pendingReleases.clear();
+    m_renderThreadRunning = false;
+}
+
+int32_t VulkanVideoRenderQueue::GetNextFrame(VulkanDecodedFrame* pFrame, bool* endOfStream)
+{
+    return GetFrame(pFrame, endOfStream, true);
+}
+
+int32_t VulkanVideoRenderQueue::TryGetNextFrame(VulkanDecodedFrame* pFrame, bool* endOfStream)
+{
+    return GetFrame(pFrame, endOfStream, false);
+}
+
+int32_t VulkanVideoRenderQueue::GetFrame(VulkanDecodedFrame* pFrame, bool* endOfStream, bool waitForFrame)
+{
+    if (m_endOfStream) {
+        *endOfStream = true;
+        return -1;
+    }
+
+    if (!m_renderThread.joinable()) {
+        StartRenderThread();
+    }
+
+    RenderNode node;
+    bool waited = false;
+    if (!m_renderQueue.TryPop(node)) {
+        if (!waitForFrame) {
+            *endOfStream = false;
+            return 0;
+        }
+        waited = true;
+        if (!m_renderQueue.WaitAndPop(node)) {
+            *endOfStream = true;
+            return -1;
+        }
+    }
+    OnNodePopped(node, waited);
+
+    if (m_renderPolicy == RENDER_NEWEST) {
+        // Skip to the newest decoded frame, but the end of the stream is only reported after it
+        RenderNode newerNode;
+        while ((node.numFrames > 0) && m_renderQueue.TryPop(newerNode)) {
+            OnNodePopped(newerNode, false);
+            if (newerNode.numFrames <= 0) {
+                m_endOfStream = newerNode.endOfStream;
+                break;
+            }
+            ReleaseFrame(&node.frame);
+            m_numDropped++;
+            node = newerNode;
+        }
+    }
+
+    if (node.endOfStream && (node.numFrames < 0)) {
+        m_endOfStream = true;
+    }
+    *endOfStream = node.endOfStream;
+    *pFrame = node.frame;
+    return node.numFrames;
+}
+
+void VulkanVideoRenderQueue::OnNodePopped(const RenderNode& node, bool waited)
+{
+    const int32_t numQueued = m_numQueued--;
+    if (!m_depthController) {
+        return;
+    }
+    if (node.numFrames > 0) {
+        m_depthController->OnFrameConsumed(waited ? 0 : (uint32_t)std::max(numQueued, 1), GetTimeMs());
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_depthMutex);
+    }
+    m_depthCondition.notify_one();
+}
+
+int32_t VulkanVideoRenderQueue::ReleaseFrame(VulkanDecodedFrame* pDisplayedFrame)
+{
+    if (pDisplayedFrame->pictureIndex == -1) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_releaseMutex);
+    int32_t result = 0;
+    if (m_renderThreadRunning) {
+        m_pendingReleases.push_back(*pDisplayedFrame);
+    } else {
+        result = m_decoderQueue->ReleaseFrame(pDisplayedFrame);
+    }
+    pDisplayedFrame->pictureIndex = -1;
+    return result;
+}
+
+void VulkanVideoRenderQueue::Deinit()
+{
+    m_stopRequested = true;
+    m_renderQueue.SetFlushAndExit();
+    {
+        std::lock_guard<std::mutex> lock(m_depthMutex);
+    }
+    m_depthCondition.notify_all();
+    if (m_renderThread.joinable()) {
+        m_renderThread.join();
+    }
+
+    // The frames decoded ahead and not presented
+    RenderNode node;
+    while (m_renderQueue.TryPop(node)) {
+        if (node.numFrames > 0) {
+            ReleaseFrame(&node.frame);
+        }
+    }
+}
+
+void VulkanVideoRenderQueue::PrintStats() const
+{
+    std::cout << "Render queue: " << m_numDecoded << " frames decoded";
+    if (m_renderPolicy == RENDER_NEWEST) {
+        std::cout << ", " << m_numDropped << " older frames not presented";
+    }
+    std::cout << std::endl;
+    if (m_depthController) {
+        m_depthController->PrintStats();
+    }
+}
@@ -0,0 +1,148 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKCODECUTILS_VULKANVIDEORENDERQUEUE_H_
+#define _VKCODECUTILS_VULKANVIDEORENDERQUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan_interfaces.h>
+#include "VkCodecUtils/VkDecodeAheadController.h"
+#include "VkCodecUtils/VkVideoQueue.h"
+#include "VkCodecUtils/VkThreadSafeQueue.h"
+#include "VkCodecUtils/VulkanDecodedFrame.h"
+
+// Decouples the decode from the presentation: a render thread pulls the frames of the decoder queue ahead of the
+// presenter into a bounded queue, so that a blocking acquire or present does not stall the parsing and the decode,
+// and the decode is not capped by the refresh rate. The presenter takes the next frame in the display order, or
+// the newest decoded one, releasing the frames it skips. The frames are only released to the decoder on the render
+// thread, the one that decodes into them.
+class VulkanVideoRenderQueue : public VkVideoQueue<VulkanDecodedFrame> {
+public:
+
+    enum RenderPolicy {
+        RENDER_IN_ORDER = 0, // all the frames are presented, the decode runs at most queueDepth frames ahead
+        RENDER_NEWEST   = 1, // the newest decoded frame is presented, the older ones are dropped
+    };
+
+    static VkResult Create(VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                           RenderPolicy renderPolicy, uint32_t queueDepth,
+                           VkSharedBaseObj<VulkanVideoRenderQueue>& renderQueue);
+
+    virtual bool IsValid(void)    const { return m_decoderQueue->IsValid(); }
+    virtual int32_t GetWidth()    const { return m_decoderQueue->GetWidth(); }
+    virtual int32_t GetHeight()   const { return m_decoderQueue->GetHeight(); }
+    virtual int32_t GetBitDepth() const { return m_decoderQueue->GetBitDepth(); }
+    virtual VkFormat GetFrameImageFormat(int32_t* pWidth = nullptr, int32_t* pHeight = nullptr,
+                                         int32_t* pBitDepth = nullptr) const {
+        return m_decoderQueue->GetFrameImageFormat(pWidth, pHeight, pBitDepth);
+    }
+    // The render thread is started by the first call, once the decoder is initialized
+    virtual int32_t GetNextFrame(VulkanDecodedFrame* pFrame, bool* endOfStream);
+    virtual int32_t ReleaseFrame(VulkanDecodedFrame* pDisplayedFrame);
+    // Like GetNextFrame, but returns 0 instead of waiting when no frame is ready yet
+    int32_t TryGetNextFrame(VulkanDecodedFrame* pFrame, bool* endOfStream);
+
+    // The decode runs ahead by the depth of a VkDecodeAheadController instead of the whole queue, at least
+    // minDepth frames. Called before the first frame.
+    void EnableAdaptiveDepth(uint32_t minDepth, double maxLatencyMs);
+
+    // Stops the render thread and returns its frames to the decoder
+    void Deinit();
+
+    // The frames decoded and the ones dropped by the newest frame policy
+    void PrintStats() const;
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the queue if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+private:
+
+    struct RenderNode {
+        VulkanDecodedFrame frame;
+        int32_t            numFrames; // of the decoder queue, negative at the end of the stream
+        bool               endOfStream;
+
+        RenderNode() : frame(), numFrames(0), endOfStream(false) {}
+    };
+
+    VulkanVideoRenderQueue(VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& decoderQueue,
+                           RenderPolicy renderPolicy, uint32_t queueDepth)
+        : m_refCount(0)
+        , m_decoderQueue(decoderQueue)
+        , m_renderPolicy(renderPolicy)
+        , m_queueDepth(queueDepth)
+        , m_renderQueue(queueDepth)
+        , m_numQueued(0)
+        , m_depthController()
+        , m_depthMutex()
+        , m_depthCondition()
+        , m_releaseMutex()
+        , m_pendingReleases()
+        , m_renderThread()
+        , m_renderThreadRunning(false)
+        , m_stopRequested(false)
+        , m_endOfStream(false)
+        , m_numDecoded(0)
+        , m_numDropped(0)
+    {
+    }
+
+    virtual ~VulkanVideoRenderQueue() { Deinit(); }
+
+    int32_t GetFrame(VulkanDecodedFrame* pFrame, bool* endOfStream, bool waitForFrame);
+    void OnNodePopped(const RenderNode& node, bool waited);
+    void RenderThread();
+    void ReleasePendingFrames();
+    void StartRenderThread();
+
+private:
+    std::atomic<int32_t>                              m_refCount;
+    VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>> m_decoderQueue;
+    const RenderPolicy                                m_renderPolicy;
+    const uint32_t                                    m_queueDepth;
+    VkThreadSafeQueue<RenderNode>                     m_renderQueue;
+    std::atomic<int32_t>                              m_numQueued;
+    std::unique_ptr<VkDecodeAheadController>          m_depthController; // of the adaptive depth
+    std::mutex                                        m_depthMutex;
+    std::condition_variable                           m_depthCondition;  // a frame taken or the queue stopped
+    std::mutex                                        m_releaseMutex;
+    std::vector<VulkanDecodedFrame>                   m_pendingReleases; // to the decoder, on the render thread
+    std::thread                                       m_renderThread;
+    bool                                              m_renderThreadRunning; // guarded by m_releaseMutex
+    std::atomic<bool>                                 m_stopRequested;
+    bool                                              m_endOfStream;
+    std::atomic<uint64_t>                             m_numDecoded;
+    uint64_t                                          m_numDropped;
+};
+
+#endif /* _VKCODECUTILS_VULKANVIDEORENDERQUEUE_H_ */
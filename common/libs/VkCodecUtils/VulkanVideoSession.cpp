@@ -40,7 +40,11 @@ VkResult VulkanVideoSession::Create(const VulkanDeviceContext* vkDevCtx,
     static const VkExtensionProperties h265DecodeStdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_SPEC_VERSION };
     static const VkExtensionProperties h264EncodeStdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H264_ENCODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H264_ENCODE_SPEC_VERSION };
     static const VkExtensionProperties h265EncodeStdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H265_ENCODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H265_ENCODE_SPEC_VERSION };
+#ifdef VK_KHR_video_encode_av1
+    static const VkExtensionProperties av1EncodeStdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_AV1_ENCODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_AV1_ENCODE_SPEC_VERSION };
+#endif
 
+    pNewVideoSession->m_flags = sessionCreateFlags;
     VkVideoSessionCreateInfoKHR& createInfo = pNewVideoSession->m_createInfo;
     createInfo.flags = sessionCreateFlags;
     createInfo.pVideoProfile = pVideoProfile->GetProfile();
@@ -64,6 +68,11 @@ VkResult VulkanVideoSession::Create(const VulkanDeviceContext* vkDevCtx,
     case VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR:
         createInfo.pStdHeaderVersion = &h265EncodeStdExtensionVersion;
         break;
+#ifdef VK_KHR_video_encode_av1
+    case VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR:
+        createInfo.pStdHeaderVersion = &av1EncodeStdExtensionVersion;
+        break;
+#endif
     default:
         assert(0);
     }
@@ -95,6 +104,9 @@ VkResult VulkanVideoSession::Create(const VulkanDeviceContext* vkDevCtx,
     uint32_t decodeSessionBindMemoryCount = videoSessionMemoryRequirementsCount;
     VkBindVideoSessionMemoryInfoKHR decodeSessionBindMemory[MAX_BOUND_MEMORY];
 
+    VkSharedBaseObj<VulkanDeviceMemoryArena> deviceMemoryArena(vkDevCtx->GetDeviceMemoryArena());
+    pNewVideoSession->m_deviceMemoryArena = deviceMemoryArena;
+
     for (uint32_t memIdx = 0; memIdx < decodeSessionBindMemoryCount; memIdx++) {
 
         uint32_t memoryTypeIndex = 0;
@@ -108,27 +120,51 @@ VkResult VulkanVideoSession::Create(const VulkanDeviceContext* vkDevCtx,
             memoryTypeBits >>= 1;
         }
 
-        VkMemoryAllocateInfo memInfo = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,                          // sType
-            NULL,                                                            // pNext
-            decodeSessionMemoryRequirements[memIdx].memoryRequirements.size, // allocationSize
-            memoryTypeIndex,                                                 // memoryTypeIndex
-        };
-
-        result = vkDevCtx->AllocateMemory(*vkDevCtx, &memInfo, 0,
-                                                   &pNewVideoSession->m_memoryBound[memIdx]);
-        if (result != VK_SUCCESS) {
-            return result;
+        const VkMemoryRequirements& memoryRequirements = decodeSessionMemoryRequirements[memIdx].memoryRequirements;
+        VkDeviceMemory boundMemory = VK_NULL_HANDLE;
+        VkDeviceSize boundMemoryOffset = 0;
+
+        // Sub-allocate from the device memory arena first, so that the session memory
+        // shares the per memory type blocks with the images and is recycled across sessions.
+        // The session memory is opaque to us, it is kept with the optimal tiling resources.
+        if (deviceMemoryArena) {
+            VkMemoryPropertyFlags memoryPropertyFlags = 0;
+            VulkanDeviceMemoryArena::Allocation& arenaAllocation = pNewVideoSession->m_arenaAllocations[memIdx];
+            if (deviceMemoryArena->Allocate(memoryRequirements, memoryPropertyFlags,
+                                            false /* linearResource */, arenaAllocation) == VK_SUCCESS) {
+                boundMemory = arenaAllocation.memory;
+                boundMemoryOffset = arenaAllocation.offset;
+            } else {
+                arenaAllocation = VulkanDeviceMemoryArena::Allocation();
+            }
+        }
+
+        if (boundMemory == VK_NULL_HANDLE) {
+            VkMemoryAllocateInfo memInfo = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,                          // sType
+                NULL,                                                            // pNext
+                memoryRequirements.size,                                         // allocationSize
+                memoryTypeIndex,                                                 // memoryTypeIndex
+            };
+
+            result = vkDevCtx->AllocateMemory(*vkDevCtx, &memInfo, 0,
+                                                       &pNewVideoSession->m_memoryBound[memIdx]);
+            if (result != VK_SUCCESS) {
+                return result;
+            }
+            boundMemory = pNewVideoSession->m_memoryBound[memIdx];
         }
+        VulkanDeviceMemoryBudget::AddAllocation(VULKAN_MEMORY_OWNER_SESSION, memoryRequirements.size, true);
+        pNewVideoSession->m_memoryBoundSize += memoryRequirements.size;
 
         assert(result == VK_SUCCESS);
         decodeSessionBindMemory[memIdx].pNext = NULL;
         decodeSessionBindMemory[memIdx].sType = VK_STRUCTURE_TYPE_BIND_VIDEO_SESSION_MEMORY_INFO_KHR;
-        decodeSessionBindMemory[memIdx].memory = pNewVideoSession->m_memoryBound[memIdx];
+        decodeSessionBindMemory[memIdx].memory = boundMemory;
 
         decodeSessionBindMemory[memIdx].memoryBindIndex = decodeSessionMemoryRequirements[memIdx].memoryBindIndex;
-        decodeSessionBindMemory[memIdx].memoryOffset = 0;
-        decodeSessionBindMemory[memIdx].memorySize = decodeSessionMemoryRequirements[memIdx].memoryRequirements.size;
+        decodeSessionBindMemory[memIdx].memoryOffset = boundMemoryOffset;
+        decodeSessionBindMemory[memIdx].memorySize = memoryRequirements.size;
     }
 
     result = vkDevCtx->BindVideoSessionMemoryKHR(*vkDevCtx, pNewVideoSession->m_videoSession, decodeSessionBindMemoryCount,
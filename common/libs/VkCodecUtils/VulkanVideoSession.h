@@ -19,6 +19,8 @@
 #include <atomic>
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
+#include "VkCodecUtils/VulkanDeviceMemoryArena.h"
 
 class VulkanVideoSession : public VkVideoRefCountBase
 {
@@ -45,7 +47,7 @@ public:
                         uint32_t            maxDpbSlots,
                         uint32_t            maxActiveReferencePictures)
     {
-        if (*pVideoProfile != m_profile) {
+        if (!pVideoProfile->IsSameCodecProfile(m_profile)) {
             return false;
         }
 
@@ -105,6 +107,7 @@ public:
     }
 
     VkVideoSessionKHR GetVideoSession() const { return m_videoSession; }
+    const VkExtent2D& GetMaxCodedExtent() const { return m_createInfo.maxCodedExtent; }
 
     operator VkVideoSessionKHR() const {
         assert(m_videoSession != VK_NULL_HANDLE);
@@ -117,7 +120,8 @@ private:
                    VkVideoCoreProfile* pVideoProfile)
        : m_refCount(0), m_flags(), m_profile(*pVideoProfile), m_vkDevCtx(vkDevCtx),
          m_createInfo{ VK_STRUCTURE_TYPE_VIDEO_SESSION_CREATE_INFO_KHR, NULL },
-         m_videoSession(VkVideoSessionKHR()), m_memoryBound{}
+         m_videoSession(VkVideoSessionKHR()), m_memoryBound{}, m_memoryBoundSize(0),
+         m_deviceMemoryArena(), m_arenaAllocations{}
     {
 
     }
@@ -135,6 +139,14 @@ private:
                 m_vkDevCtx->FreeMemory(*m_vkDevCtx, m_memoryBound[memIdx], 0);
                 m_memoryBound[memIdx] = VK_NULL_HANDLE;
             }
+            if (m_arenaAllocations[memIdx].memory != VK_NULL_HANDLE) {
+                m_deviceMemoryArena->Free(m_arenaAllocations[memIdx]);
+                m_arenaAllocations[memIdx] = VulkanDeviceMemoryArena::Allocation();
+            }
+        }
+        m_deviceMemoryArena = nullptr;
+        if (m_memoryBoundSize != 0) {
+            VulkanDeviceMemoryBudget::RemoveAllocation(VULKAN_MEMORY_OWNER_SESSION, m_memoryBoundSize, true);
         }
         m_vkDevCtx = nullptr;
     }
@@ -147,4 +159,7 @@ private:
     VkVideoSessionCreateInfoKHR            m_createInfo;
     VkVideoSessionKHR                      m_videoSession;
     VkDeviceMemory                         m_memoryBound[MAX_BOUND_MEMORY];
+    VkDeviceSize                           m_memoryBoundSize; // accounted as device local in VulkanDeviceMemoryBudget
+    VkSharedBaseObj<VulkanDeviceMemoryArena> m_deviceMemoryArena;
+    VulkanDeviceMemoryArena::Allocation    m_arenaAllocations[MAX_BOUND_MEMORY]; // sub-allocations, instead of m_memoryBound
 };
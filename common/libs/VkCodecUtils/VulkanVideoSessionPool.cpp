@@ -0,0 +1,114 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include "VkCodecUtils/VulkanVideoSessionPool.h"
+
+VkResult VulkanVideoSessionPool::Create(const VulkanDeviceContext* vkDevCtx,
+                                        uint32_t maxIdleSessions,
+                                        VkSharedBaseObj<VulkanVideoSessionPool>& videoSessionPool)
+{
+    VkSharedBaseObj<VulkanVideoSessionPool> sessionPool(new VulkanVideoSessionPool(vkDevCtx, maxIdleSessions));
+    if (!sessionPool) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    videoSessionPool = sessionPool;
+    return VK_SUCCESS;
+}
+
+VkResult VulkanVideoSessionPool::GetVideoSession(VkVideoSessionCreateFlagsKHR sessionCreateFlags,
+                                                 uint32_t            videoQueueFamily,
+                                                 VkVideoCoreProfile* pVideoProfile,
+                                                 VkFormat            pictureFormat,
+                                                 const VkExtent2D&   maxCodedExtent,
+                                                 VkFormat            referencePicturesFormat,
+                                                 uint32_t            maxDpbSlots,
+                                                 uint32_t            maxActiveReferencePictures,
+                                                 VkSharedBaseObj<VulkanVideoSession>& videoSession)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // The smallest session that fits uses the least memory, the larger ones are left to the larger streams
+    int32_t bestIndex = -1;
+    uint64_t bestArea = 0;
+    for (uint32_t i = 0; i < (uint32_t)m_idleSessions.size(); i++) {
+        VkSharedBaseObj<VulkanVideoSession>& idleSession = m_idleSessions[i];
+        if (!idleSession->IsCompatible(m_vkDevCtx, sessionCreateFlags, videoQueueFamily, pVideoProfile,
+                                       pictureFormat, maxCodedExtent, referencePicturesFormat,
+                                       maxDpbSlots, maxActiveReferencePictures)) {
+            continue;
+        }
+        const VkExtent2D& sessionExtent = idleSession->GetMaxCodedExtent();
+        const uint64_t area = (uint64_t)sessionExtent.width * sessionExtent.height;
+        if ((bestIndex < 0) || (area < bestArea)) {
+            bestIndex = (int32_t)i;
+            bestArea = area;
+        }
+    }
+
+    if (bestIndex >= 0) {
+        videoSession = m_idleSessions[bestIndex];
+        m_idleSessions.erase(m_idleSessions.begin() + bestIndex);
+        m_numReused++;
+        return VK_SUCCESS;
+    }
+
+    m_numCreated++;
+    lock.unlock();
+
+    return VulkanVideoSession::Create(m_vkDevCtx, sessionCreateFlags, videoQueueFamily, pVideoProfile,
+                                      pictureFormat, maxCodedExtent, referencePicturesFormat,
+                                      maxDpbSlots, maxActiveReferencePictures, videoSession);
+}
+
+void VulkanVideoSessionPool::ReturnVideoSession(VkSharedBaseObj<VulkanVideoSession>& videoSession)
+{
+    if (!videoSession || (m_maxIdleSessions == 0)) {
+        videoSession = nullptr;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_idleSessions.size() >= m_maxIdleSessions) {
+        m_idleSessions.erase(m_idleSessions.begin());
+    }
+
+    m_idleSessions.push_back(videoSession);
+
+    videoSession = nullptr;
+}
+
+void VulkanVideoSessionPool::Flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idleSessions.clear();
+}
+
+uint32_t VulkanVideoSessionPool::GetNumIdleSessions()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_idleSessions.size();
+}
+
+void VulkanVideoSessionPool::GetStats(uint64_t& numReused, uint64_t& numCreated)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    numReused = m_numReused;
+    numCreated = m_numCreated;
+}
@@ -0,0 +1,102 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANVIDEOSESSIONPOOL_H_
+#define _VULKANVIDEOSESSIONPOOL_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkVideoCore/VkVideoCoreProfile.h"
+#include "VkCodecUtils/VulkanVideoSession.h"
+
+// Video sessions shared by all the decoder instances of a device. A decoder returns its session once the device
+// is done with it, at the end of its stream or when a new sequence needs another session, and a decoder starting
+// a sequence checks out an idle session compatible with it, so the short streams skip the session creation and
+// the allocation and binding of its memory. The least recently returned sessions are destroyed beyond
+// maxIdleSessions.
+class VulkanVideoSessionPool : public VkVideoRefCountBase
+{
+public:
+    enum { DEFAULT_MAX_IDLE_SESSIONS = 4 };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           uint32_t maxIdleSessions,
+                           VkSharedBaseObj<VulkanVideoSessionPool>& videoSessionPool);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the pool if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns the idle session of the smallest extent compatible with the parameters, or creates one.
+    // The parameters are the ones of VulkanVideoSession::Create().
+    VkResult GetVideoSession(VkVideoSessionCreateFlagsKHR sessionCreateFlags,
+                             uint32_t            videoQueueFamily,
+                             VkVideoCoreProfile* pVideoProfile,
+                             VkFormat            pictureFormat,
+                             const VkExtent2D&   maxCodedExtent,
+                             VkFormat            referencePicturesFormat,
+                             uint32_t            maxDpbSlots,
+                             uint32_t            maxActiveReferencePictures,
+                             VkSharedBaseObj<VulkanVideoSession>& videoSession);
+
+    // The caller must be done with the session on the device, videoSession is reset
+    void ReturnVideoSession(VkSharedBaseObj<VulkanVideoSession>& videoSession);
+
+    // Destroys all the idle sessions
+    void Flush();
+
+    uint32_t GetNumIdleSessions();
+
+    // The sessions checked out of the pool vs. created
+    void GetStats(uint64_t& numReused, uint64_t& numCreated);
+
+private:
+    VulkanVideoSessionPool(const VulkanDeviceContext* vkDevCtx, uint32_t maxIdleSessions)
+        : m_refCount(0)
+        , m_vkDevCtx(vkDevCtx)
+        , m_maxIdleSessions(maxIdleSessions)
+        , m_numReused(0)
+        , m_numCreated(0)
+        , m_mutex()
+        , m_idleSessions() { }
+
+    virtual ~VulkanVideoSessionPool() { Flush(); }
+
+private:
+    std::atomic<int32_t>                   m_refCount;
+    const VulkanDeviceContext*             m_vkDevCtx;
+    const uint32_t                         m_maxIdleSessions;
+    uint64_t                               m_numReused;
+    uint64_t                               m_numCreated;
+    std::mutex                             m_mutex;
+    std::vector<VkSharedBaseObj<VulkanVideoSession>> m_idleSessions; // in the order they were returned
+};
+
+#endif /* _VULKANVIDEOSESSIONPOOL_H_ */
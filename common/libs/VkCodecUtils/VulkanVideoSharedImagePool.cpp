@@ -0,0 +1,183 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "VkCodecUtils/VulkanVideoSharedImagePool.h"
+
+VkResult VulkanVideoSharedImagePool::Create(const VulkanDeviceContext* vkDevCtx,
+                                            uint32_t maxIdleImages,
+                                            VkSharedBaseObj<VulkanVideoSharedImagePool>& sharedImagePool)
+{
+    VkSharedBaseObj<VulkanVideoSharedImagePool> imagePool(new VulkanVideoSharedImagePool(vkDevCtx, maxIdleImages));
+    if (!imagePool) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    sharedImagePool = imagePool;
+    return VK_SUCCESS;
+}
+
+VkResult VulkanVideoSharedImagePool::GetImage(const VkImageCreateInfo* pImageCreateInfo,
+                                              VkMemoryPropertyFlags memoryPropertyFlags,
+                                              VkSharedBaseObj<VkImageResource>& imageResource)
+{
+    // Only single layer images with no other extension than a single video profile are pooled
+    const VkVideoProfileListInfoKHR* pProfileList = (const VkVideoProfileListInfoKHR*)pImageCreateInfo->pNext;
+    const bool isPoolable = (pImageCreateInfo->arrayLayers == 1) &&
+                            ((pProfileList == nullptr) ||
+                             ((pProfileList->sType == VK_STRUCTURE_TYPE_VIDEO_PROFILE_LIST_INFO_KHR) &&
+                              (pProfileList->pNext == nullptr) &&
+                              (pProfileList->profileCount == 1)));
+    if (!isPoolable) {
+        return VkImageResource::Create(m_vkDevCtx, pImageCreateInfo, memoryPropertyFlags, imageResource);
+    }
+
+    VkVideoCoreProfile videoProfile;
+    if ((pProfileList != nullptr) && !videoProfile.InitFromProfile(&pProfileList->pProfiles[0])) {
+        return VkImageResource::Create(m_vkDevCtx, pImageCreateInfo, memoryPropertyFlags, imageResource);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    ImageKey* pImageKey = FindImageKey(pImageCreateInfo,
+                                       (pProfileList != nullptr) ? &videoProfile : nullptr,
+                                       memoryPropertyFlags);
+    if (pImageKey == nullptr) {
+        std::unique_ptr<ImageKey> imageKey(new ImageKey());
+        imageKey->hasProfile = (pProfileList != nullptr);
+        if (imageKey->hasProfile) {
+            imageKey->videoProfile = videoProfile;
+        }
+        imageKey->format = pImageCreateInfo->format;
+        imageKey->extent = pImageCreateInfo->extent;
+        imageKey->usage = pImageCreateInfo->usage;
+        imageKey->tiling = pImageCreateInfo->tiling;
+        imageKey->flags = pImageCreateInfo->flags;
+        imageKey->memoryPropertyFlags = memoryPropertyFlags;
+        pImageKey = imageKey.get();
+        m_imageKeys.push_back(std::move(imageKey));
+    }
+
+    if (!pImageKey->idleImages.empty()) {
+        // The most recently returned image is the most likely to still be resident
+        imageResource = pImageKey->idleImages.back().imageResource;
+        pImageKey->idleImages.pop_back();
+        m_numIdleImages--;
+        return VK_SUCCESS;
+    }
+
+    VkImageCreateInfo imageCreateInfo(*pImageCreateInfo);
+    imageCreateInfo.pNext = pImageKey->hasProfile ? pImageKey->videoProfile.GetProfileListInfo() : nullptr;
+
+    lock.unlock();
+
+    return VkImageResource::Create(m_vkDevCtx, &imageCreateInfo, memoryPropertyFlags, imageResource);
+}
+
+void VulkanVideoSharedImagePool::ReturnImage(VkSharedBaseObj<VkImageResource>& imageResource)
+{
+    if (!imageResource || (m_maxIdleImages == 0)) {
+        imageResource = nullptr;
+        return;
+    }
+
+    const VkImageCreateInfo& imageCreateInfo = imageResource->GetImageCreateInfo();
+    const VkMemoryPropertyFlags memoryPropertyFlags = imageResource->GetMemory()->GetMemoryPropertyFlags();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (std::unique_ptr<ImageKey>& imageKey : m_imageKeys) {
+        // The images of the pool point to the profile of their key
+        const void* pProfileList = imageKey->hasProfile ? imageKey->videoProfile.GetProfileListInfo() : nullptr;
+        if ((imageCreateInfo.pNext == pProfileList) &&
+                (imageCreateInfo.arrayLayers == 1) &&
+                (imageCreateInfo.format == imageKey->format) &&
+                (imageCreateInfo.extent.width == imageKey->extent.width) &&
+                (imageCreateInfo.extent.height == imageKey->extent.height) &&
+                (imageCreateInfo.usage == imageKey->usage) &&
+                (imageCreateInfo.tiling == imageKey->tiling) &&
+                (imageCreateInfo.flags == imageKey->flags) &&
+                (memoryPropertyFlags == imageKey->memoryPropertyFlags)) {
+
+            if (m_numIdleImages >= m_maxIdleImages) {
+                EvictOldestIdleImage();
+            }
+
+            IdleImage idleImage;
+            idleImage.imageResource = imageResource;
+            idleImage.returnedSequence = m_returnedSequence++;
+            imageKey->idleImages.push_back(idleImage);
+            m_numIdleImages++;
+            break;
+        }
+    }
+
+    imageResource = nullptr;
+}
+
+void VulkanVideoSharedImagePool::Flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (std::unique_ptr<ImageKey>& imageKey : m_imageKeys) {
+        imageKey->idleImages.clear();
+    }
+    m_numIdleImages = 0;
+}
+
+uint32_t VulkanVideoSharedImagePool::GetNumIdleImages()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_numIdleImages;
+}
+
+VulkanVideoSharedImagePool::ImageKey* VulkanVideoSharedImagePool::FindImageKey(const VkImageCreateInfo* pImageCreateInfo,
+                                                                               const VkVideoCoreProfile* pVideoProfile,
+                                                                               VkMemoryPropertyFlags memoryPropertyFlags)
+{
+    for (std::unique_ptr<ImageKey>& imageKey : m_imageKeys) {
+        if ((imageKey->hasProfile == (pVideoProfile != nullptr)) &&
+                (!imageKey->hasProfile || imageKey->videoProfile.IsSameCodecProfile(*pVideoProfile)) &&
+                (imageKey->format == pImageCreateInfo->format) &&
+                (imageKey->extent.width == pImageCreateInfo->extent.width) &&
+                (imageKey->extent.height == pImageCreateInfo->extent.height) &&
+                (imageKey->usage == pImageCreateInfo->usage) &&
+                (imageKey->tiling == pImageCreateInfo->tiling) &&
+                (imageKey->flags == pImageCreateInfo->flags) &&
+                (imageKey->memoryPropertyFlags == memoryPropertyFlags)) {
+            return imageKey.get();
+        }
+    }
+    return nullptr;
+}
+
+void VulkanVideoSharedImagePool::EvictOldestIdleImage()
+{
+    ImageKey* pOldestImageKey = nullptr;
+    for (std::unique_ptr<ImageKey>& imageKey : m_imageKeys) {
+        // The idle images of a key are in the order they were returned
+        if (!imageKey->idleImages.empty() &&
+                ((pOldestImageKey == nullptr) ||
+                 (imageKey->idleImages.front().returnedSequence < pOldestImageKey->idleImages.front().returnedSequence))) {
+            pOldestImageKey = imageKey.get();
+        }
+    }
+
+    if (pOldestImageKey != nullptr) {
+        pOldestImageKey->idleImages.erase(pOldestImageKey->idleImages.begin());
+        m_numIdleImages--;
+    }
+}
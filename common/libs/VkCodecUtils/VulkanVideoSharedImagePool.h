@@ -0,0 +1,118 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANVIDEOSHAREDIMAGEPOOL_H_
+#define _VULKANVIDEOSHAREDIMAGEPOOL_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VkImageResource.h"
+#include "VkVideoCore/VkVideoCoreProfile.h"
+
+// Video images shared by all the decoder instances of a device. The images are checked out when a
+// picture needs one and returned when the picture releases it, so that a stream restart, a return to
+// a previous resolution or another stream of the same configuration reuses a warm image instead of
+// allocating a new one. The idle images are keyed by (profile, format, extent, usage, tiling, memory
+// properties) and the least recently returned ones are destroyed beyond maxIdleImages.
+class VulkanVideoSharedImagePool : public VkVideoRefCountBase
+{
+public:
+    enum { DEFAULT_MAX_IDLE_IMAGES = 8 };
+
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           uint32_t maxIdleImages,
+                           VkSharedBaseObj<VulkanVideoSharedImagePool>& sharedImagePool);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the pool if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns an idle image of the same configuration, or creates one. The image create info of
+    // the returned image points to a profile owned by the pool, not to the one of the caller.
+    VkResult GetImage(const VkImageCreateInfo* pImageCreateInfo,
+                      VkMemoryPropertyFlags memoryPropertyFlags,
+                      VkSharedBaseObj<VkImageResource>& imageResource);
+
+    // The caller must be done with the image on the device. Images not created by the pool are ignored.
+    void ReturnImage(VkSharedBaseObj<VkImageResource>& imageResource);
+
+    // Destroys all the idle images
+    void Flush();
+
+    uint32_t GetNumIdleImages();
+
+private:
+    struct IdleImage {
+        VkSharedBaseObj<VkImageResource> imageResource;
+        uint64_t                         returnedSequence;
+    };
+
+    struct ImageKey {
+        bool                   hasProfile;
+        VkVideoCoreProfile     videoProfile;   // the image create info of the pooled images points to it
+        VkFormat               format;
+        VkExtent3D             extent;
+        VkImageUsageFlags      usage;
+        VkImageTiling          tiling;
+        VkImageCreateFlags     flags;
+        VkMemoryPropertyFlags  memoryPropertyFlags;
+        std::vector<IdleImage> idleImages;
+    };
+
+    VulkanVideoSharedImagePool(const VulkanDeviceContext* vkDevCtx, uint32_t maxIdleImages)
+        : m_refCount(0)
+        , m_vkDevCtx(vkDevCtx)
+        , m_maxIdleImages(maxIdleImages)
+        , m_numIdleImages(0)
+        , m_returnedSequence(0)
+        , m_mutex()
+        , m_imageKeys() { }
+
+    virtual ~VulkanVideoSharedImagePool() { Flush(); }
+
+    // These functions must be called with the m_mutex lock obtained
+    ImageKey* FindImageKey(const VkImageCreateInfo* pImageCreateInfo,
+                           const VkVideoCoreProfile* pVideoProfile,
+                           VkMemoryPropertyFlags memoryPropertyFlags);
+    void EvictOldestIdleImage();
+
+private:
+    std::atomic<int32_t>                   m_refCount;
+    const VulkanDeviceContext*             m_vkDevCtx;
+    const uint32_t                         m_maxIdleImages;
+    uint32_t                               m_numIdleImages;
+    uint64_t                               m_returnedSequence;
+    std::mutex                             m_mutex;
+    // Never removed, the profiles of the keys must stay at the same address for the images using them
+    std::vector<std::unique_ptr<ImageKey>> m_imageKeys;
+};
+
+#endif /* _VULKANVIDEOSHAREDIMAGEPOOL_H_ */
@@ -0,0 +1,176 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANVIDEOSIZECLASSREFCOUNTEDPOOL_H_
+#define _VULKANVIDEOSIZECLASSREFCOUNTEDPOOL_H_
+
+#include <chrono>
+#include <mutex>
+#include "vulkan_interfaces.h"
+#include "VkCodecUtils/VulkanVideoReferenceCountedPool.h"
+
+// A VulkanVideoRefCountedPool split into power-of-two size classes, for nodes with a GetMaxSize(),
+// like the bitstream buffers. Class n holds the nodes of at least (1 << (MIN_SIZE_CLASS_LOG2 + n)) bytes,
+// so a request is served from the smallest class that fits instead of whichever node is free first.
+// The available nodes of a class that has not been used for the idle trim period are released.
+template <class RefCountedNodeType, const size_t MAX_POOL_ENTRIES>
+class VulkanVideoSizeClassRefCountedPool {
+
+public:
+    enum { MIN_SIZE_CLASS_LOG2 = 16 }; // 64 KB
+    enum { MAX_SIZE_CLASS_LOG2 = 30 }; // 1 GB
+    enum { NUM_SIZE_CLASSES = MAX_SIZE_CLASS_LOG2 - MIN_SIZE_CLASS_LOG2 + 1 };
+    enum { DEFAULT_IDLE_TRIM_PERIOD_MS = 2000 };
+
+    VulkanVideoSizeClassRefCountedPool(uint32_t maxNodesPerClass = 32,
+                                       uint32_t idleTrimPeriodMs = DEFAULT_IDLE_TRIM_PERIOD_MS)
+    : m_sizeClassMutex()
+    , m_idleTrimPeriod(idleTrimPeriodMs)
+    , m_lastUsed()
+    , m_sizeClasses()
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+            m_sizeClasses[i].SetMaxNodes(maxNodesPerClass);
+            m_lastUsed[i] = now;
+        }
+    }
+
+    // Returns the smallest class with nodes of at least size bytes, or NUM_SIZE_CLASSES if size is too large.
+    static uint32_t GetSizeClass(VkDeviceSize size)
+    {
+        uint32_t sizeClass = 0;
+        while ((sizeClass < NUM_SIZE_CLASSES) && (GetSizeClassSize(sizeClass) < size)) {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    static VkDeviceSize GetSizeClassSize(uint32_t sizeClass)
+    {
+        return (VkDeviceSize)1 << (MIN_SIZE_CLASS_LOG2 + sizeClass);
+    }
+
+    // The size to allocate a new node with for a request of size bytes
+    static VkDeviceSize GetAllocationSize(VkDeviceSize size)
+    {
+        const uint32_t sizeClass = GetSizeClass(size);
+        return (sizeClass < NUM_SIZE_CLASSES) ? GetSizeClassSize(sizeClass) : size;
+    }
+
+    // A period of zero disables trimming.
+    void SetIdleTrimPeriod(uint32_t idleTrimPeriodMs)
+    {
+        std::lock_guard<std::mutex> lock(m_sizeClassMutex);
+        m_idleTrimPeriod = std::chrono::milliseconds(idleTrimPeriodMs);
+    }
+
+    uint32_t GetMaxNodes()
+    {
+        return m_sizeClasses[0].GetMaxNodes();
+    }
+
+    uint32_t GetAvailableNodesNumber()
+    {
+        uint32_t numAvailableNodes = 0;
+        for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+            numAvailableNodes += m_sizeClasses[i].GetAvailableNodesNumber();
+        }
+        return numAvailableNodes;
+    }
+
+    // Free node slots of the class new nodes of size bytes are added to
+    uint32_t GetFreeNodesNumber(VkDeviceSize size)
+    {
+        const uint32_t sizeClass = GetNodeSizeClass(size);
+        return (sizeClass < NUM_SIZE_CLASSES) ? m_sizeClasses[sizeClass].GetFreeNodesNumber() : 0;
+    }
+
+    // Returns the slot index of the node within its size class, or -1 if no class that fits has an available node.
+    int32_t GetAvailableNodeFromPool(VkDeviceSize size, VkSharedBaseObj<RefCountedNodeType>& availableNodeFromPool)
+    {
+        TrimIdleSizeClasses();
+
+        for (uint32_t sizeClass = GetSizeClass(size); sizeClass < NUM_SIZE_CLASSES; sizeClass++) {
+            int32_t availableNodeIndx = m_sizeClasses[sizeClass].GetAvailableNodeFromPool(availableNodeFromPool);
+            if (availableNodeIndx >= 0) {
+                assert(availableNodeFromPool->GetMaxSize() >= size);
+                MarkUsed(sizeClass);
+                return availableNodeIndx;
+            }
+        }
+        return -1;
+    }
+
+    // The node goes to the largest class it can serve, nodes smaller than the first class are not pooled.
+    int32_t AddNodeToPool(VkSharedBaseObj<RefCountedNodeType>& newNodeToPool, bool setUnavailable)
+    {
+        const uint32_t sizeClass = GetNodeSizeClass(newNodeToPool->GetMaxSize());
+        if (!(sizeClass < NUM_SIZE_CLASSES)) {
+            return -1;
+        }
+        MarkUsed(sizeClass);
+        return m_sizeClasses[sizeClass].AddNodeToPool(newNodeToPool, setUnavailable);
+    }
+
+    // Release the available nodes of the classes that have been idle for longer than the trim period.
+    // Returns the number of nodes released.
+    uint32_t TrimIdleSizeClasses()
+    {
+        uint32_t numReleasedNodes = 0;
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(m_sizeClassMutex);
+        if (m_idleTrimPeriod.count() == 0) {
+            return 0;
+        }
+        for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+            if ((now - m_lastUsed[i]) > m_idleTrimPeriod) {
+                numReleasedNodes += m_sizeClasses[i].ReleaseAvailableNodes();
+                // Nodes still in use are caught by the next period
+                m_lastUsed[i] = now;
+            }
+        }
+        return numReleasedNodes;
+    }
+
+private:
+    static uint32_t GetNodeSizeClass(VkDeviceSize nodeSize)
+    {
+        if (nodeSize < GetSizeClassSize(0)) {
+            return NUM_SIZE_CLASSES;
+        }
+        uint32_t sizeClass = 0;
+        while (((sizeClass + 1) < NUM_SIZE_CLASSES) && (GetSizeClassSize(sizeClass + 1) <= nodeSize)) {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    void MarkUsed(uint32_t sizeClass)
+    {
+        std::lock_guard<std::mutex> lock(m_sizeClassMutex);
+        m_lastUsed[sizeClass] = std::chrono::steady_clock::now();
+    }
+
+private:
+    std::mutex                                                     m_sizeClassMutex;
+    std::chrono::milliseconds                                      m_idleTrimPeriod;
+    std::chrono::steady_clock::time_point                          m_lastUsed[NUM_SIZE_CLASSES];
+    VulkanVideoRefCountedPool<RefCountedNodeType, MAX_POOL_ENTRIES> m_sizeClasses[NUM_SIZE_CLASSES];
+};
+
+#endif // _VULKANVIDEOSIZECLASSREFCOUNTEDPOOL_H_
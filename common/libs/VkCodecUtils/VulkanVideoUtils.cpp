@@ -18,7 +18,6 @@
 #include <iostream>
 #include <vulkan_interfaces.h>
 #include "pattern.h"
-#include <shaderc/shaderc.hpp>
 
 #include "VulkanVideoUtils.h"
 #include <nvidia_utils/vulkan/ycbcrvkinfo.h>
@@ -41,6 +40,9 @@ namespace vulkanVideoUtils {
 
 using namespace Pattern;
 
+// The workgroup width and height of the compute present
+static const uint32_t computePresentWorkgroupSize = 16;
+
 void VulkanSwapchainInfo::CreateSwapChain(const VulkanDeviceContext* vkDevCtx, VkSwapchainKHR swapchain)
 {
     if (mVerbose) std::cout << "VkVideoUtils: " << "Enter Function: " << __FUNCTION__ <<  "File " << __FILE__ << "line " <<  __LINE__ << std::endl;
@@ -385,7 +387,8 @@ VkResult VulkanSyncPrimitives::CreateSyncPrimitives(const VulkanDeviceContext* v
     return m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &semaphoreCreateInfo, nullptr, &mRenderCompleteSemaphore);
 }
 
-VkResult VulkanRenderPass::CreateRenderPass(const VulkanDeviceContext* vkDevCtx, VkFormat displayImageFormat)
+VkResult VulkanRenderPass::CreateRenderPass(const VulkanDeviceContext* vkDevCtx, VkFormat displayImageFormat,
+                                            bool loadContent)
 {
     DestroyRenderPass();
 
@@ -395,11 +398,11 @@ VkResult VulkanRenderPass::CreateRenderPass(const VulkanDeviceContext* vkDevCtx,
     VkAttachmentDescription attachmentDescriptions = VkAttachmentDescription();
     attachmentDescriptions.format = displayImageFormat;
     attachmentDescriptions.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescriptions.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachmentDescriptions.loadOp = loadContent ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachmentDescriptions.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachmentDescriptions.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachmentDescriptions.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachmentDescriptions.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachmentDescriptions.initialLayout = loadContent ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
     attachmentDescriptions.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colourReference = VkAttachmentReference();
@@ -458,7 +461,8 @@ VkResult VulkanGraphicsPipeline::CreatePipeline(const VulkanDeviceContext* vkDev
 {
     m_vkDevCtx = vkDevCtx;
 
-    if (m_cache == VkPipelineCache(0)) {
+    // The cache of the device, persisted between the runs, when there is one
+    if ((m_vkDevCtx->GetPipelineCache() == VkPipelineCache(0)) && (m_cache == VkPipelineCache(0))) {
         // Create the pipeline cache
         VkPipelineCacheCreateInfo pipelineCacheInfo = VkPipelineCacheCreateInfo();
         pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
@@ -492,7 +496,7 @@ VkResult VulkanGraphicsPipeline::CreatePipeline(const VulkanDeviceContext* vkDev
         "void main()\n"
         "{\n"
         "    vTexCoord = transformPushConstants.texMatrix * aTexCoord;\n"
-        "    gl_Position = vec4(aVertex, 0, 1);\n"
+        "    gl_Position = transformPushConstants.posMatrix * vec4(aVertex, 0, 1);\n"
         "}\n"
         ;
 
@@ -657,13 +661,105 @@ VkResult VulkanGraphicsPipeline::CreatePipeline(const VulkanDeviceContext* vkDev
 
     // Make sure we destroy the existing pipeline, if it were to exist.
     DestroyPipeline();
-    VkResult pipelineResult = m_vkDevCtx->CreateGraphicsPipelines(*m_vkDevCtx, m_cache, 1,
+    const VkPipelineCache pipelineCache = (m_vkDevCtx->GetPipelineCache() != VkPipelineCache(0)) ?
+                                              m_vkDevCtx->GetPipelineCache() : m_cache;
+    VkResult pipelineResult = m_vkDevCtx->CreateGraphicsPipelines(*m_vkDevCtx, pipelineCache, 1,
                                                                   &pipelineCreateInfo,
                                                                   nullptr, &m_pipeline);
 
     return pipelineResult;
 }
 
+void VulkanPerDrawContext::BindInputImage(VkCommandBuffer cmdBuffer,
+                                          const ImageResourceInfo* inputImageToDrawFrom,
+                                          const VulkanDescriptorSetLayout& descriptorSetLayoutBinding,
+                                          const VulkanSamplerYcbcrConversion& samplerYcbcrConversion)
+{
+    VkDescriptorSetLayoutCreateFlags layoutMode = descriptorSetLayoutBinding.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode();
+    switch (layoutMode) {
+        case VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR:
+        case VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT:
+        {
+            const VkDescriptorImageInfo combinedImageSampler { samplerYcbcrConversion.GetSampler(),
+                                                               inputImageToDrawFrom->view,
+                                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+            const uint32_t numDescriptors = 1;
+            std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+            uint32_t set = 0;
+
+            // Image
+            writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[0].dstSet = VK_NULL_HANDLE;
+            writeDescriptorSets[0].dstBinding = 0;
+            writeDescriptorSets[0].descriptorCount = 1;
+            writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writeDescriptorSets[0].pImageInfo = &combinedImageSampler;
+
+            if (layoutMode == VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) {
+                m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                    descriptorSetLayoutBinding.GetPipelineLayout(),
+                                                    set, numDescriptors,
+                                                    writeDescriptorSets.data());
+            } else {
+
+                VkDeviceOrHostAddressConstKHR imageDescriptorBufferDeviceAddress =
+                        descriptorSetLayoutBinding.UpdateDescriptorBuffer(0, // always index 0
+                                                                          set, numDescriptors,
+                                                                          writeDescriptorSets.data());
+
+                // Descriptor buffer bindings
+                // Set 0 = Image
+                VkDescriptorBufferBindingInfoEXT bindingInfo{};
+                bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+                bindingInfo.pNext = nullptr;
+                bindingInfo.address = imageDescriptorBufferDeviceAddress.deviceAddress;
+                bindingInfo.usage = VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+                                    VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
+                m_vkDevCtx->CmdBindDescriptorBuffersEXT(cmdBuffer, 1, &bindingInfo);
+
+                // Image (set 0)
+                uint32_t bufferIndexImage = 0;
+                VkDeviceSize bufferOffset = 0;
+                m_vkDevCtx->CmdSetDescriptorBufferOffsetsEXT(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                             descriptorSetLayoutBinding.GetPipelineLayout(),
+                                                             set, 1, &bufferIndexImage, &bufferOffset);
+            }
+        }
+        break;
+        default:
+            m_vkDevCtx->CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                              descriptorSetLayoutBinding.GetPipelineLayout(),
+                                              0, 1, descriptorSetLayoutBinding.GetDescriptorSet(),
+                                              0, nullptr);
+    }
+}
+
+VkResult VulkanPerDrawContext::RecordDrawInputImage(VkCommandBuffer cmdBuffer,
+                                                    const ImageResourceInfo* inputImageToDrawFrom,
+                                                    const vk::TransformPushConstants& constants,
+                                                    const VulkanVertexBuffer& vertexBuffer)
+{
+    VkPipeline pipeline = gfxPipeline.getPipeline();
+    if (pipeline == VK_NULL_HANDLE) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    BindInputImage(cmdBuffer, inputImageToDrawFrom, descriptorSetLayoutBinding, samplerYcbcrConversion);
+
+    VkDeviceSize offset = 0;
+    VkBuffer vertexBuff = vertexBuffer.GetBuffer();
+    m_vkDevCtx->CmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuff, &offset);
+
+    m_vkDevCtx->CmdPushConstants(cmdBuffer, descriptorSetLayoutBinding.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vk::TransformPushConstants), &constants);
+
+    m_vkDevCtx->CmdDraw(cmdBuffer, vertexBuffer.GetNumVertices(), 1, 0, 0);
+    return VK_SUCCESS;
+}
+
 VkResult VulkanPerDrawContext::RecordCommandBuffer(VkCommandBuffer cmdBuffer,
                                                    VkRenderPass renderPass,
                                                    const ImageResourceInfo* inputImageToDrawFrom,
@@ -729,65 +825,7 @@ VkResult VulkanPerDrawContext::RecordCommandBuffer(VkCommandBuffer cmdBuffer,
     // Bind what is necessary to the command buffer
     m_vkDevCtx->CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-    VkDescriptorSetLayoutCreateFlags layoutMode = descriptorSetLayoutBinding.GetDescriptorSetLayoutInfo().GetDescriptorLayoutMode();
-    switch (layoutMode) {
-        case VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR:
-        case VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT:
-        {
-            const VkDescriptorImageInfo combinedImageSampler { samplerYcbcrConversion.GetSampler(),
-                                                               inputImageToDrawFrom->view,
-                                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-
-            const uint32_t numDescriptors = 1;
-            std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
-
-            uint32_t set = 0;
-
-            // Image
-            writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSets[0].dstSet = VK_NULL_HANDLE;
-            writeDescriptorSets[0].dstBinding = 0;
-            writeDescriptorSets[0].descriptorCount = 1;
-            writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writeDescriptorSets[0].pImageInfo = &combinedImageSampler;
-
-            if (layoutMode == VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) {
-                m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                    descriptorSetLayoutBinding.GetPipelineLayout(),
-                                                    set, numDescriptors,
-                                                    writeDescriptorSets.data());
-            } else {
-
-                VkDeviceOrHostAddressConstKHR imageDescriptorBufferDeviceAddress =
-                        descriptorSetLayoutBinding.UpdateDescriptorBuffer(0, // always index 0
-                                                                          set, numDescriptors,
-                                                                          writeDescriptorSets.data());
-
-                // Descriptor buffer bindings
-                // Set 0 = Image
-                VkDescriptorBufferBindingInfoEXT bindingInfo{};
-                bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
-                bindingInfo.pNext = nullptr;
-                bindingInfo.address = imageDescriptorBufferDeviceAddress.deviceAddress;
-                bindingInfo.usage = VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
-                                    VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
-                m_vkDevCtx->CmdBindDescriptorBuffersEXT(cmdBuffer, 1, &bindingInfo);
-
-                // Image (set 0)
-                uint32_t bufferIndexImage = 0;
-                VkDeviceSize bufferOffset = 0;
-                m_vkDevCtx->CmdSetDescriptorBufferOffsetsEXT(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                             descriptorSetLayoutBinding.GetPipelineLayout(),
-                                                             set, 1, &bufferIndexImage, &bufferOffset);
-            }
-        }
-        break;
-        default:
-            m_vkDevCtx->CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                              descriptorSetLayoutBinding.GetPipelineLayout(),
-                                              0, 1, descriptorSetLayoutBinding.GetDescriptorSet(),
-                                              0, nullptr);
-    }
+    BindInputImage(cmdBuffer, inputImageToDrawFrom, descriptorSetLayoutBinding, samplerYcbcrConversion);
 
     VkDeviceSize offset = 0;
     VkBuffer vertexBuff = vertexBuffer.GetBuffer();
@@ -842,6 +880,190 @@ VkResult VulkanPerDrawContext::RecordCommandBuffer(VkCommandBuffer cmdBuffer,
     return m_vkDevCtx->EndCommandBuffer(cmdBuffer);
 }
 
+VkResult VulkanPerDrawContext::RecordComputeCommandBuffer(VkCommandBuffer cmdBuffer,
+                                                          const ImageResourceInfo* inputImageToDrawFrom,
+                                                          int32_t displayWidth, int32_t displayHeight,
+                                                          VkImage displayImage, VkImageView displayImageView,
+                                                          const VkExtent2D& displayExtent)
+{
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = VkCommandBufferBeginInfo();
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = nullptr;
+    cmdBufferBeginInfo.flags = 0;
+    cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+    VkResult result = m_vkDevCtx->BeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The whole swapchain image is written, its previous content is discarded
+    VkImageMemoryBarrier2KHR displayImageBarrier = VkImageMemoryBarrier2KHR();
+    displayImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+    displayImageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT_KHR;
+    displayImageBarrier.srcAccessMask = 0;
+    displayImageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    displayImageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    displayImageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    displayImageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    displayImageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    displayImageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    displayImageBarrier.image = displayImage;
+    displayImageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    VkDependencyInfoKHR dependencyInfo = VkDependencyInfoKHR();
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &displayImageBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuffer, &dependencyInfo);
+
+    const VkMpFormatInfo * pFormatInfo = YcbcrVkFormatInfo(inputImageToDrawFrom->imageFormat);
+    const uint32_t numPlanes = (pFormatInfo == NULL) ? 1 : (uint32_t)pFormatInfo->planesLayout.numberOfExtraPlanes + 1;
+    for (uint32_t planeIndx = 0; planeIndx < numPlanes; planeIndx++) {
+        setImageLayout(m_vkDevCtx, cmdBuffer, inputImageToDrawFrom->image,
+                       VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       (pFormatInfo == NULL) ? VK_IMAGE_ASPECT_COLOR_BIT : (VK_IMAGE_ASPECT_PLANE_0_BIT_KHR << planeIndx));
+    }
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.getPipeline());
+
+    const VkDescriptorImageInfo combinedImageSampler { samplerYcbcrConversion.GetSampler(),
+                                                       inputImageToDrawFrom->view,
+                                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    const VkDescriptorImageInfo storageImage { VK_NULL_HANDLE, displayImageView, VK_IMAGE_LAYOUT_GENERAL };
+
+    const uint32_t numDescriptors = 2;
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+    // Input image
+    writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[0].dstBinding = 0;
+    writeDescriptorSets[0].descriptorCount = 1;
+    writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeDescriptorSets[0].pImageInfo = &combinedImageSampler;
+    // Swapchain image
+    writeDescriptorSets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[1].dstBinding = 1;
+    writeDescriptorSets[1].descriptorCount = 1;
+    writeDescriptorSets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSets[1].pImageInfo = &storageImage;
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        computeDescriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        float    inputScaleX;
+        float    inputScaleY;
+        uint32_t outputWidth;
+        uint32_t outputHeight;
+    };
+
+    // The cropped display area of the input, like the texture matrix of the graphics blit
+    const PushConstants pushConstants = {
+            (displayWidth != 0) ? ((float)displayWidth / inputImageToDrawFrom->imageWidth) : 1.0f,
+            (displayHeight != 0) ? ((float)displayHeight / inputImageToDrawFrom->imageHeight) : 1.0f,
+            displayExtent.width,
+            displayExtent.height
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuffer, computeDescriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+    m_vkDevCtx->CmdDispatch(cmdBuffer,
+                            (displayExtent.width + computePresentWorkgroupSize - 1) / computePresentWorkgroupSize,
+                            (displayExtent.height + computePresentWorkgroupSize - 1) / computePresentWorkgroupSize,
+                            1);
+
+    displayImageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    displayImageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    displayImageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT_KHR;
+    displayImageBarrier.dstAccessMask = 0;
+    displayImageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    displayImageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuffer, &dependencyInfo);
+
+    for (uint32_t planeIndx = 0; planeIndx < numPlanes; planeIndx++) {
+        setImageLayout(m_vkDevCtx, cmdBuffer, inputImageToDrawFrom->image,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR,
+                       (pFormatInfo == NULL) ? VK_IMAGE_ASPECT_COLOR_BIT : (VK_IMAGE_ASPECT_PLANE_0_BIT_KHR << planeIndx));
+    }
+
+    return m_vkDevCtx->EndCommandBuffer(cmdBuffer);
+}
+
+VkFormat VulkanRenderInfo::GetComputePresentFormat(VkFormat swapchainFormat)
+{
+    // The formats with a storage image format qualifier of the same channel order, for the writes without
+    // shaderStorageImageWriteWithoutFormat. The BGRA ones have none.
+    switch (swapchainFormat) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        return swapchainFormat;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+VkResult VulkanRenderInfo::CreateComputePresentPipeline(VulkanPerDrawContext* pPerDrawContext)
+{
+    if (mVerbose) std::cout << "VkVideoUtils: " << "CreateComputePresentPipeline " << pPerDrawContext->contextIndex << std::endl;
+
+    VkSampler immutableSampler = pPerDrawContext->samplerYcbcrConversion.GetSampler();
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        //                        binding,  descriptorType,          descriptorCount, stageFlags, pImmutableSamplers;
+        // Binding 0: Input image (read-only) RGBA or RGBA YCbCr sampler sampled
+        VkDescriptorSetLayoutBinding{ 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, &immutableSampler},
+        // Binding 1: Swapchain image (write)
+        VkDescriptorSetLayoutBinding{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // The input scale and the output extent
+    pushConstantRange.size = 4 * sizeof(uint32_t);
+
+    VkResult result = pPerDrawContext->computeDescriptorSetLayout.CreateDescriptorSet(m_vkDevCtx, setLayoutBindings,
+                                                                                     VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                                                     1, &pushConstantRange,
+                                                                                     &pPerDrawContext->samplerYcbcrConversion);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                 "layout (local_size_x = " << computePresentWorkgroupSize << ", local_size_y = " << computePresentWorkgroupSize << ") in;\n"
+                 "layout (set = 0, binding = 0) uniform sampler2D inputImage;\n"
+              << "layout (set = 0, binding = 1, "
+              << ((m_computePresentFormat == VK_FORMAT_A2B10G10R10_UNORM_PACK32) ? "rgb10_a2" : "rgba8")
+              << ") uniform writeonly image2D outputImage;\n"
+                 "layout (push_constant) uniform PushConstants {\n"
+                 "    vec2  inputScale;\n"
+                 "    uvec2 outputExtent;\n"
+                 "} pushConstants;\n"
+                 "\n"
+                 "void main()\n"
+                 "{\n"
+                 "    const uvec2 pos = gl_GlobalInvocationID.xy;\n"
+                 "    if (any(greaterThanEqual(pos, pushConstants.outputExtent))) {\n"
+                 "        return;\n"
+                 "    }\n"
+                 "    // The sampler converts the YCbCr to RGB and filters the scaling\n"
+                 "    const vec2 uv = (vec2(pos) + 0.5) / vec2(pushConstants.outputExtent) * pushConstants.inputScale;\n"
+                 "    imageStore(outputImage, ivec2(pos), vec4(textureLod(inputImage, uv, 0.0).rgb, 1.0));\n"
+                 "}\n";
+    const std::string computeShader = shaderStr.str();
+
+    return pPerDrawContext->computePipeline.CreatePipeline(m_vkDevCtx, m_shaderCompiler,
+                                                           computeShader.c_str(), computeShader.size(),
+                                                           "main",
+                                                           computePresentWorkgroupSize, computePresentWorkgroupSize,
+                                                           &pPerDrawContext->computeDescriptorSetLayout);
+}
+
 VkResult VulkanRenderInfo::UpdatePerDrawContexts(VulkanPerDrawContext* pPerDrawContext,
         VkViewport* pViewport, VkRect2D* pScissor, VkRenderPass renderPass,
         const VkSamplerCreateInfo* pSamplerCreateInfo,
@@ -887,6 +1109,16 @@ VkResult VulkanRenderInfo::UpdatePerDrawContexts(VulkanPerDrawContext* pPerDrawC
                                                          pScissor,
                                                          renderPass,
                                                          &pPerDrawContext->descriptorSetLayoutBinding);
+    if ((result != VK_SUCCESS) || (m_computePresentFormat == VK_FORMAT_UNDEFINED)) {
+        pPerDrawContext->computePipeline.DestroyPipeline();
+        return result;
+    }
+
+    // The immutable sampler is part of the compute pipeline layout too
+    if (CreateComputePresentPipeline(pPerDrawContext) != VK_SUCCESS) {
+        std::cout << "VkVideoUtils: the compute present is not available, falling back to the graphics blit" << std::endl;
+        pPerDrawContext->computePipeline.DestroyPipeline();
+    }
 
     return result;
 }
@@ -897,8 +1129,11 @@ VkResult VulkanRenderInfo::CreatePerDrawContexts(const VulkanDeviceContext* vkDe
         VkSwapchainKHR swapchain, const VkExtent2D* pFbExtent2D, VkViewport* pViewport,
         VkRect2D* pScissor, const VkSurfaceFormatKHR* pSurfaceFormat,
         VkRenderPass renderPass, const VkSamplerCreateInfo* pSamplerCreateInfo,
-        const VkSamplerYcbcrConversionCreateInfo* pSamplerYcbcrConversionCreateInfo)
+        const VkSamplerYcbcrConversionCreateInfo* pSamplerYcbcrConversionCreateInfo,
+        bool storageSwapchain)
 {
+    m_computePresentFormat = storageSwapchain ? GetComputePresentFormat(pSurfaceFormat->format) : VK_FORMAT_UNDEFINED;
+
     std::vector<VkImage> fbImages;
     vk::get(vkDevCtx, vkDevCtx->getDevice(), swapchain, fbImages);
     int32_t numFbImages = (int32_t )fbImages.size();
@@ -36,6 +36,7 @@
 #include "VkCodecUtils/VulkanDeviceContext.h"
 #include "VkCodecUtils/VulkanShaderCompiler.h"
 #include "VkCodecUtils/VulkanDescriptorSetLayout.h"
+#include "VkCodecUtils/VulkanComputePipeline.h"
 #include "VkCodecUtils/VulkanCommandBuffersSet.h"
 #include "VkCodecUtils/Helpers.h"
 
@@ -112,6 +113,25 @@ public:
         return result;
     }
 
+    // The timings of the presents that completed since the last call, in the order of their presentIDs
+    VkResult GetPastPresentationTiming(VkDevice device, VkSwapchainKHR swapchain,
+                                       std::vector<VkPastPresentationTimingGOOGLE>& timings) {
+
+        timings.clear();
+        if (!vkGetPastPresentationTimingGOOGLE) {
+            return VK_ERROR_EXTENSION_NOT_PRESENT;
+        }
+
+        uint32_t count = 0;
+        VkResult result = vkGetPastPresentationTimingGOOGLE(device, swapchain, &count, nullptr);
+        if ((result == VK_SUCCESS) && (count > 0)) {
+            timings.resize(count);
+            result = vkGetPastPresentationTimingGOOGLE(device, swapchain, &count, timings.data());
+            timings.resize(count);
+        }
+        return result;
+    }
+
     bool DisplayTimingIsEnabled() {
         return (vkGetRefreshCycleDurationGOOGLE && vkGetPastPresentationTimingGOOGLE);
     }
@@ -367,7 +387,9 @@ public:
           renderPass()
     {}
 
-    VkResult CreateRenderPass(const VulkanDeviceContext* vkDevCtx, VkFormat displayImageFormat);
+    // With loadContent, the attachment keeps the content of its previous present, for the partial updates
+    VkResult CreateRenderPass(const VulkanDeviceContext* vkDevCtx, VkFormat displayImageFormat,
+                              bool loadContent = false);
 
     void DestroyRenderPass() {
         if (renderPass) {
@@ -620,6 +642,8 @@ public:
       descriptorSetLayoutBinding(),
       commandBuffer(),
       gfxPipeline(),
+      computeDescriptorSetLayout(),
+      computePipeline(),
       lastVideoFormatUpdate((uint32_t)-1)
     {
     }
@@ -633,6 +657,8 @@ public:
           descriptorSetLayoutBinding(std::move(other.descriptorSetLayoutBinding)),
           commandBuffer(std::move(other.commandBuffer)),
           gfxPipeline(std::move(other.gfxPipeline)),
+          computeDescriptorSetLayout(std::move(other.computeDescriptorSetLayout)),
+          computePipeline(std::move(other.computePipeline)),
           lastVideoFormatUpdate(other.lastVideoFormatUpdate)
     {
         // Set the moved-from object's members to a valid but indeterminate state
@@ -662,6 +688,32 @@ public:
                                  const VulkanSamplerYcbcrConversion& samplerYcbcrConversion,
                                  const VulkanVertexBuffer& vertexBuffer);
 
+    // Within a render pass begun by the caller, draws the input image with the pipeline and the sampler of this
+    // context, the position and the crop of the quad given by the push constants, e.g. for one tile of a mosaic.
+    VkResult RecordDrawInputImage(VkCommandBuffer cmdBuffer,
+                                  const ImageResourceInfo* inputImageToDrawFrom,
+                                  const vk::TransformPushConstants& constants,
+                                  const VulkanVertexBuffer& vertexBuffer);
+
+    bool HasComputePresent() {
+        return (computePipeline.getPipeline() != VK_NULL_HANDLE);
+    }
+
+    // Converts and scales the input image straight into the storage swapchain image with the compute pipeline,
+    // without the render pass and the vertex stages of the graphics blit.
+    VkResult RecordComputeCommandBuffer(VkCommandBuffer cmdBuffer,
+                                        const ImageResourceInfo* inputImageToDrawFrom,
+                                        int32_t displayWidth, int32_t displayHeight,
+                                        VkImage displayImage, VkImageView displayImageView,
+                                        const VkExtent2D& displayExtent);
+
+private:
+    void BindInputImage(VkCommandBuffer cmdBuffer,
+                        const ImageResourceInfo* inputImageToDrawFrom,
+                        const VulkanDescriptorSetLayout& descriptorSetLayoutBinding,
+                        const VulkanSamplerYcbcrConversion& samplerYcbcrConversion);
+
+public:
     const VulkanDeviceContext* m_vkDevCtx;
     int32_t contextIndex;
     VulkanFrameBuffer frameBuffer;
@@ -670,6 +722,9 @@ public:
     VulkanDescriptorSetLayout descriptorSetLayoutBinding;
     VulkanCommandBuffersSet commandBuffer;
     VulkanGraphicsPipeline gfxPipeline;
+    // With a storage swapchain, the input sampler and the swapchain image of the compute present
+    VulkanDescriptorSetLayout computeDescriptorSetLayout;
+    VulkanComputePipeline computePipeline;
     uint32_t lastVideoFormatUpdate;
 };
 
@@ -679,16 +734,22 @@ public:
 
     VulkanRenderInfo()
       : mVerbose(),
-        m_vkDevCtx()
+        m_vkDevCtx(),
+        m_computePresentFormat(VK_FORMAT_UNDEFINED),
+        m_shaderCompiler()
         {}
 
+    // The swapchain format written by the compute present, VK_FORMAT_UNDEFINED for the graphics blit
+    static VkFormat GetComputePresentFormat(VkFormat swapchainFormat);
+
 
     // Create per draw contexts.
     VkResult CreatePerDrawContexts(const VulkanDeviceContext* vkDevCtx,
             VkSwapchainKHR swapchain, const VkExtent2D* pFbExtent2D,
             VkViewport* pViewport, VkRect2D* pScissor, const VkSurfaceFormatKHR* pSurfaceFormat,
             VkRenderPass renderPass, const VkSamplerCreateInfo* pSamplerCreateInfo = nullptr,
-            const VkSamplerYcbcrConversionCreateInfo* pSamplerYcbcrConversionCreateInfo = nullptr);
+            const VkSamplerYcbcrConversionCreateInfo* pSamplerYcbcrConversionCreateInfo = nullptr,
+            bool storageSwapchain = false);
 
     VkResult UpdatePerDrawContexts(VulkanPerDrawContext* pPerDrawContext,
             VkViewport* pViewport, VkRect2D* pScissor, VkRenderPass renderPass,
@@ -709,8 +770,12 @@ public:
     }
 
 private:
+    VkResult CreateComputePresentPipeline(VulkanPerDrawContext* pPerDrawContext);
+
     uint32_t mVerbose : 1;
     const VulkanDeviceContext* m_vkDevCtx;
+    VkFormat m_computePresentFormat;
+    VulkanShaderCompiler m_shaderCompiler;
     std::vector<VulkanPerDrawContext> perDrawCtx;
 
 };
@@ -5,7 +5,22 @@
  *      Author: tzlatinski
  */
 
+#include <algorithm>
+#include <atomic>
 #include "YCbCrConvUtilsCpu.h"
+#include "VkThreadPool.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define YCBCR_CONV_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define YCBCR_CONV_NEON 1
+#include <arm_neon.h>
+#endif
 
 YCbCrConvUtilsCpu::YCbCrConvUtilsCpu()
 {
@@ -18,3 +33,317 @@ YCbCrConvUtilsCpu::~YCbCrConvUtilsCpu()
     // TODO Auto-generated destructor stub
 }
 
+static void MergeUVRowScalar(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width)
+{
+    for (int x = 0; x < width - 1; x += 2) {
+        dst_uv[0] = src_u[x];
+        dst_uv[1] = src_v[x];
+        dst_uv[2] = src_u[x + 1];
+        dst_uv[3] = src_v[x + 1];
+        dst_uv += 4;
+    }
+    if (width & 1) {
+        dst_uv[0] = src_u[width - 1];
+        dst_uv[1] = src_v[width - 1];
+    }
+}
+
+static void MergeUVRow16Scalar(const uint16_t* src_u, const uint16_t* src_v, uint16_t* dst_uv, int shift, int width)
+{
+    for (int x = 0; x < width; x++) {
+        dst_uv[0] = (uint16_t)(src_u[x] << shift);
+        dst_uv[1] = (uint16_t)(src_v[x] << shift);
+        dst_uv += 2;
+    }
+}
+
+static void ShiftRow16Scalar(const uint16_t* src, uint16_t* dst, int shift, int width)
+{
+    for (int x = 0; x < width; x++) {
+        dst[x] = (uint16_t)(src[x] << shift);
+    }
+}
+
+#if defined(YCBCR_CONV_X86)
+static void MergeUVRowSSE2(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i u = _mm_loadu_si128((const __m128i*)(src_u + x));
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src_v + x));
+        _mm_storeu_si128((__m128i*)(dst_uv + 2 * x), _mm_unpacklo_epi8(u, v));
+        _mm_storeu_si128((__m128i*)(dst_uv + 2 * x + 16), _mm_unpackhi_epi8(u, v));
+    }
+    MergeUVRowScalar(src_u + x, src_v + x, dst_uv + 2 * x, width - x);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+static void MergeUVRowAVX2(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i u = _mm256_loadu_si256((const __m256i*)(src_u + x));
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(src_v + x));
+        // The unpacks interleave within the 128-bit lanes, the permutes put the lanes back in order
+        const __m256i lo = _mm256_unpacklo_epi8(u, v);
+        const __m256i hi = _mm256_unpackhi_epi8(u, v);
+        _mm256_storeu_si256((__m256i*)(dst_uv + 2 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(dst_uv + 2 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    MergeUVRowSSE2(src_u + x, src_v + x, dst_uv + 2 * x, width - x);
+}
+
+static void MergeUVRow16SSE2(const uint16_t* src_u, const uint16_t* src_v, uint16_t* dst_uv, int shift, int width)
+{
+    const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i u = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(src_u + x)), shiftCount);
+        const __m128i v = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(src_v + x)), shiftCount);
+        _mm_storeu_si128((__m128i*)(dst_uv + 2 * x), _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i*)(dst_uv + 2 * x + 8), _mm_unpackhi_epi16(u, v));
+    }
+    MergeUVRow16Scalar(src_u + x, src_v + x, dst_uv + 2 * x, shift, width - x);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+static void MergeUVRow16AVX2(const uint16_t* src_u, const uint16_t* src_v, uint16_t* dst_uv, int shift, int width)
+{
+    const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i u = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(src_u + x)), shiftCount);
+        const __m256i v = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(src_v + x)), shiftCount);
+        const __m256i lo = _mm256_unpacklo_epi16(u, v);
+        const __m256i hi = _mm256_unpackhi_epi16(u, v);
+        _mm256_storeu_si256((__m256i*)(dst_uv + 2 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(dst_uv + 2 * x + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    MergeUVRow16SSE2(src_u + x, src_v + x, dst_uv + 2 * x, shift, width - x);
+}
+
+static void ShiftRow16SSE2(const uint16_t* src, uint16_t* dst, int shift, int width)
+{
+    const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(src + x)), shiftCount));
+    }
+    ShiftRow16Scalar(src + x, dst + x, shift, width - x);
+}
+
+static bool CpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] < 7) {
+        return false;
+    }
+    __cpuid(cpuInfo, 1);
+    const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    const bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || ((_xgetbv(0) & 0x6) != 0x6)) {
+        return false;
+    }
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static bool UseAVX2()
+{
+    static const bool useAVX2 = CpuSupportsAVX2();
+    return useAVX2;
+}
+#endif // YCBCR_CONV_X86
+
+#if defined(YCBCR_CONV_NEON)
+static void MergeUVRowNEON(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x2_t uv;
+        uv.val[0] = vld1q_u8(src_u + x);
+        uv.val[1] = vld1q_u8(src_v + x);
+        vst2q_u8(dst_uv + 2 * x, uv);
+    }
+    MergeUVRowScalar(src_u + x, src_v + x, dst_uv + 2 * x, width - x);
+}
+
+static void MergeUVRow16NEON(const uint16_t* src_u, const uint16_t* src_v, uint16_t* dst_uv, int shift, int width)
+{
+    const int16x8_t shiftCount = vdupq_n_s16((int16_t)shift);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8x2_t uv;
+        uv.val[0] = vshlq_u16(vld1q_u16(src_u + x), shiftCount);
+        uv.val[1] = vshlq_u16(vld1q_u16(src_v + x), shiftCount);
+        vst2q_u16(dst_uv + 2 * x, uv);
+    }
+    MergeUVRow16Scalar(src_u + x, src_v + x, dst_uv + 2 * x, shift, width - x);
+}
+
+static void ShiftRow16NEON(const uint16_t* src, uint16_t* dst, int shift, int width)
+{
+    const int16x8_t shiftCount = vdupq_n_s16((int16_t)shift);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        vst1q_u16(dst + x, vshlq_u16(vld1q_u16(src + x), shiftCount));
+    }
+    ShiftRow16Scalar(src + x, dst + x, shift, width - x);
+}
+#endif // YCBCR_CONV_NEON
+
+void YCbCrConvUtilsCpu::MergeUVRow(const uint8_t* src_u,
+                                   const uint8_t* src_v,
+                                   uint8_t* dst_uv,
+                                   int width)
+{
+#if defined(YCBCR_CONV_X86)
+    if (UseAVX2()) {
+        MergeUVRowAVX2(src_u, src_v, dst_uv, width);
+    } else {
+        MergeUVRowSSE2(src_u, src_v, dst_uv, width);
+    }
+#elif defined(YCBCR_CONV_NEON)
+    MergeUVRowNEON(src_u, src_v, dst_uv, width);
+#else
+    MergeUVRowScalar(src_u, src_v, dst_uv, width);
+#endif
+}
+
+void YCbCrConvUtilsCpu::MergeUVRow_16(const uint16_t* src_u,
+                                      const uint16_t* src_v,
+                                      uint16_t* dst_uv,
+                                      int depth,
+                                      int width)
+{
+    const int shift = 16 - depth;
+#if defined(YCBCR_CONV_X86)
+    if (UseAVX2()) {
+        MergeUVRow16AVX2(src_u, src_v, dst_uv, shift, width);
+    } else {
+        MergeUVRow16SSE2(src_u, src_v, dst_uv, shift, width);
+    }
+#elif defined(YCBCR_CONV_NEON)
+    MergeUVRow16NEON(src_u, src_v, dst_uv, shift, width);
+#else
+    MergeUVRow16Scalar(src_u, src_v, dst_uv, shift, width);
+#endif
+}
+
+void YCbCrConvUtilsCpu::ShiftRow_16(const uint16_t* src, uint16_t* dst, int depth, int width)
+{
+    const int shift = 16 - depth;
+    if (shift == 0) {
+        memcpy(dst, src, width * sizeof(uint16_t));
+        return;
+    }
+#if defined(YCBCR_CONV_X86)
+    ShiftRow16SSE2(src, dst, shift, width);
+#elif defined(YCBCR_CONV_NEON)
+    ShiftRow16NEON(src, dst, shift, width);
+#else
+    ShiftRow16Scalar(src, dst, shift, width);
+#endif
+}
+
+// Splits the luma rows in bands of an even number of rows, so that each band starts on a chroma row.
+// The first band is converted on the calling thread, while the pool converts the others.
+template<class ConvertBand>
+static int ConvertInRowBands(VkThreadPool* threadPool, int numBands, int height, ConvertBand convertBand)
+{
+    const int bandHeight = (((height + numBands - 1) / numBands) + 1) & ~1;
+
+    // The calling thread waits for the bands, ahead of the background work of the pool
+    std::atomic<int> numFailedBands(0);
+    VkThreadPool::TaskGroup bands;
+    for (int firstRow = bandHeight; firstRow < height; firstRow += bandHeight) {
+        const int numRows = std::min(bandHeight, height - firstRow);
+        threadPool->Submit([&convertBand, &numFailedBands, firstRow, numRows]() {
+                               if (convertBand(firstRow, numRows) != 0) {
+                                   numFailedBands++;
+                               }
+                           },
+                           VkThreadPool::PRIORITY_LATENCY_CRITICAL, &bands);
+    }
+
+    int result = convertBand(0, std::min(bandHeight, height));
+    bands.Wait();
+    if (numFailedBands.load() != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+int YCbCrConvUtilsCpu::I420ToNV12(const uint8_t* src_y,
+                                  int src_stride_y,
+                                  const uint8_t* src_u,
+                                  int src_stride_u,
+                                  const uint8_t* src_v,
+                                  int src_stride_v,
+                                  uint8_t* dst_y,
+                                  int dst_stride_y,
+                                  uint8_t* dst_uv,
+                                  int dst_stride_uv,
+                                  int width,
+                                  int height,
+                                  VkThreadPool* threadPool,
+                                  int numBands)
+{
+    if ((threadPool == nullptr) || (numBands <= 1) || (height < 2 * numBands)) {
+        return I420ToNV12(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
+                          dst_y, dst_stride_y, dst_uv, dst_stride_uv, width, height);
+    }
+
+    return ConvertInRowBands(threadPool, numBands, height, [=](int firstRow, int numRows) {
+        const ptrdiff_t chromaRow = firstRow / 2;
+        return I420ToNV12(src_y + firstRow * (ptrdiff_t)src_stride_y, src_stride_y,
+                          src_u + chromaRow * src_stride_u, src_stride_u,
+                          src_v + chromaRow * src_stride_v, src_stride_v,
+                          dst_y ? (dst_y + firstRow * (ptrdiff_t)dst_stride_y) : nullptr, dst_stride_y,
+                          dst_uv + chromaRow * dst_stride_uv, dst_stride_uv,
+                          width, numRows);
+    });
+}
+
+int YCbCrConvUtilsCpu::I010ToP010(const uint16_t* src_y,
+                                  int src_stride_y,
+                                  const uint16_t* src_u,
+                                  int src_stride_u,
+                                  const uint16_t* src_v,
+                                  int src_stride_v,
+                                  uint16_t* dst_y,
+                                  int dst_stride_y,
+                                  uint16_t* dst_uv,
+                                  int dst_stride_uv,
+                                  int depth,
+                                  int width,
+                                  int height,
+                                  VkThreadPool* threadPool,
+                                  int numBands)
+{
+    if ((threadPool == nullptr) || (numBands <= 1) || (height < 2 * numBands)) {
+        return I010ToP010(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
+                          dst_y, dst_stride_y, dst_uv, dst_stride_uv, depth, width, height);
+    }
+
+    return ConvertInRowBands(threadPool, numBands, height, [=](int firstRow, int numRows) {
+        const ptrdiff_t chromaRow = firstRow / 2;
+        return I010ToP010(src_y + firstRow * (ptrdiff_t)src_stride_y, src_stride_y,
+                          src_u + chromaRow * src_stride_u, src_stride_u,
+                          src_v + chromaRow * src_stride_v, src_stride_v,
+                          dst_y ? (dst_y + firstRow * (ptrdiff_t)dst_stride_y) : nullptr, dst_stride_y,
+                          dst_uv + chromaRow * dst_stride_uv, dst_stride_uv,
+                          depth, width, numRows);
+    });
+}
@@ -34,6 +34,8 @@
 #include <assert.h>
 #include <stdint.h>
 
+class VkThreadPool;
+
 class YCbCrConvUtilsCpu
 {
 public:
@@ -79,23 +81,20 @@ public:
         }
     }
 
+    // Interleaves a row of U and a row of V, with SSE2/AVX2 or NEON when available.
     static void MergeUVRow(const uint8_t* src_u,
                            const uint8_t* src_v,
                            uint8_t* dst_uv,
-                           int width) {
+                           int width);
 
-        for (int x = 0; x < width - 1; x += 2) {
-            dst_uv[0] = src_u[x];
-            dst_uv[1] = src_v[x];
-            dst_uv[2] = src_u[x + 1];
-            dst_uv[3] = src_v[x + 1];
-            dst_uv += 4;
-        }
-        if (width & 1) {
-            dst_uv[0] = src_u[width - 1];
-            dst_uv[1] = src_v[width - 1];
-        }
-    }
+    // 16-bit variant, the samples of depth bits are shifted to the most significant bits, as P010/P016 store them.
+    static void MergeUVRow_16(const uint16_t* src_u,
+                              const uint16_t* src_v,
+                              uint16_t* dst_uv,
+                              int depth,
+                              int width);
+
+    static void ShiftRow_16(const uint16_t* src, uint16_t* dst, int depth, int width);
 
     static void MergeUVPlane(const uint8_t* src_u,
                              int src_stride_u,
@@ -173,6 +172,109 @@ public:
 
         return 0;
     }
+
+    // The strides of the 16-bit planes are in samples.
+    static void ShiftPlane_16(const uint16_t* src_y,
+                              int src_stride_y,
+                              uint16_t* dst_y,
+                              int dst_stride_y,
+                              int depth,
+                              int width,
+                              int height) {
+        if ((width <= 0) || (height <= 0)) {
+            return;
+        }
+
+        for (int y = 0; y < height; ++y) {
+            ShiftRow_16(src_y, dst_y, depth, width);
+            src_y += src_stride_y;
+            dst_y += dst_stride_y;
+        }
+    }
+
+    static void MergeUVPlane_16(const uint16_t* src_u,
+                                int src_stride_u,
+                                const uint16_t* src_v,
+                                int src_stride_v,
+                                uint16_t* dst_uv,
+                                int dst_stride_uv,
+                                int depth,
+                                int width,
+                                int height) {
+        if ((width <= 0) || (height <= 0)) {
+            return;
+        }
+
+        for (int y = 0; y < height; ++y) {
+            MergeUVRow_16(src_u, src_v, dst_uv, depth, width);
+            src_u += src_stride_u;
+            src_v += src_stride_v;
+            dst_uv += dst_stride_uv;
+        }
+    }
+
+    // I010/I012/I016 (LSB aligned samples of depth bits) to P010/P012/P016, the strides are in samples.
+    static int I010ToP010(const uint16_t* src_y,
+                          int src_stride_y,
+                          const uint16_t* src_u,
+                          int src_stride_u,
+                          const uint16_t* src_v,
+                          int src_stride_v,
+                          uint16_t* dst_y,
+                          int dst_stride_y,
+                          uint16_t* dst_uv,
+                          int dst_stride_uv,
+                          int depth,
+                          int width,
+                          int height) {
+
+        if (!src_y || !src_u || !src_v || !dst_uv || (width <= 0) || (height <= 0) ||
+                (depth < 8) || (depth > 16)) {
+            return -1;
+        }
+
+        if (dst_y) {
+            ShiftPlane_16(src_y, src_stride_y, dst_y, dst_stride_y, depth, width, height);
+        }
+
+        MergeUVPlane_16(src_u, src_stride_u, src_v, src_stride_v, dst_uv, dst_stride_uv, depth,
+                        (width + 1) / 2, (height + 1) / 2);
+
+        return 0;
+    }
+
+    // Same as I420ToNV12, with the rows split in bands converted on the thread pool. A null pool,
+    // a single band or a negative (inverting) height converts on the calling thread.
+    static int I420ToNV12(const uint8_t* src_y,
+                          int src_stride_y,
+                          const uint8_t* src_u,
+                          int src_stride_u,
+                          const uint8_t* src_v,
+                          int src_stride_v,
+                          uint8_t* dst_y,
+                          int dst_stride_y,
+                          uint8_t* dst_uv,
+                          int dst_stride_uv,
+                          int width,
+                          int height,
+                          VkThreadPool* threadPool,
+                          int numBands);
+
+    static int I010ToP010(const uint16_t* src_y,
+                          int src_stride_y,
+                          const uint16_t* src_u,
+                          int src_stride_u,
+                          const uint16_t* src_v,
+                          int src_stride_v,
+                          uint16_t* dst_y,
+                          int dst_stride_y,
+                          uint16_t* dst_uv,
+                          int dst_stride_uv,
+                          int depth,
+                          int width,
+                          int height,
+                          VkThreadPool* threadPool,
+                          int numBands);
 };
 
 #endif /* _VKCODECUTILS_YCBCRCONVUTILSCPU_H_ */
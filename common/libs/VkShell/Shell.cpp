@@ -23,6 +23,7 @@
 #include <set>
 #include <thread>
 #include "VkCodecUtils/Helpers.h"
+#include "VkCodecUtils/VulkanVideoUtils.h"
 #include "Shell.h"
 
 Shell::Shell(const VulkanDeviceContext* devCtx, const Configuration& configuration,
@@ -30,7 +31,18 @@ Shell::Shell(const VulkanDeviceContext* devCtx, const Configuration& configurati
     : m_refCount(0)
     , m_settings(configuration)
     , m_frameProcessor(frameProcessor)
-    , m_ctx(devCtx) { }
+    , m_ctx(devCtx)
+    , m_presentScheduler()
+    , m_lowLatencyPresenter()
+    , m_displayRefreshDurationNs(0)
+{
+    if (m_settings.m_presentPacing) {
+        m_ctx.presentScheduler = &m_presentScheduler;
+    }
+    if (m_settings.m_lowLatency) {
+        m_ctx.lowLatencyPresenter = &m_lowLatencyPresenter;
+    }
+}
 
 Shell::AcquireBuffer::AcquireBuffer()
     : m_vkDevCtx(nullptr)
@@ -134,6 +146,13 @@ void Shell::DestroyContext() {
 
     m_ctx.devCtx->DeviceWaitIdle();
 
+    if (m_ctx.presentScheduler != nullptr) {
+        m_ctx.presentScheduler->PrintStats();
+    }
+    if (m_ctx.lowLatencyPresenter != nullptr) {
+        m_ctx.lowLatencyPresenter->PrintStats();
+    }
+
     DestroySwapchain();
 
     m_frameProcessor->DetachShell();
@@ -177,6 +196,16 @@ void Shell::DestroyBackBuffers() {
     m_ctx.currentBackBuffer = 0;
 }
 
+// Whether the frame processor can write the images of the format with its compute shaders
+static bool IsStorageSwapchainFormat(const VulkanDeviceContext* devCtx, VkFormat format) {
+    if (vulkanVideoUtils::VulkanRenderInfo::GetComputePresentFormat(format) == VK_FORMAT_UNDEFINED) {
+        return false;
+    }
+    VkFormatProperties formatProperties;
+    devCtx->GetPhysicalDeviceFormatProperties(devCtx->getPhysicalDevice(), format, &formatProperties);
+    return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
 void Shell::CreateSwapchain() {
     m_ctx.surface = CreateSurface(m_ctx.devCtx->getInstance());
     assert(m_ctx.surface);
@@ -192,6 +221,15 @@ void Shell::CreateSwapchain() {
     std::vector<VkSurfaceFormatKHR> formats;
     vk::get(m_ctx.devCtx, m_ctx.devCtx->getPhysicalDevice(), m_ctx.surface, formats);
     m_ctx.format = formats[0];
+    if (m_settings.m_computePresent) {
+        // The first of the storage formats of the surface, else the blit to the preferred one
+        for (const VkSurfaceFormatKHR& format : formats) {
+            if (IsStorageSwapchainFormat(m_ctx.devCtx, format.format)) {
+                m_ctx.format = format;
+                break;
+            }
+        }
+    }
 
     // Tegra hack __VkModesetApiNvdc::vkFormatToNvColorFormat() does not mapp the correct formats.
 #ifdef NV_RMAPI_TEGRA
@@ -207,6 +245,12 @@ void Shell::CreateSwapchain() {
 void Shell::DestroySwapchain() {
     if (m_ctx.swapchain != VK_NULL_HANDLE) {
         m_frameProcessor->DetachSwapchain();
+        if (m_ctx.presentScheduler != nullptr) {
+            m_ctx.presentScheduler->DetachSwapchain();
+        }
+        if (m_ctx.lowLatencyPresenter != nullptr) {
+            m_ctx.lowLatencyPresenter->DetachSwapchain();
+        }
 
         m_ctx.devCtx->DestroySwapchainKHR(*m_ctx.devCtx, m_ctx.swapchain, nullptr);
         m_ctx.swapchain = VK_NULL_HANDLE;
@@ -240,6 +284,10 @@ void Shell::ResizeSwapchain(uint32_t width_hint, uint32_t height_hint) {
     if (m_ctx.extent.width == extent.width && m_ctx.extent.height == extent.height) return;
 
     uint32_t image_count = m_settings.m_backBufferCount;
+    if (m_settings.m_lowLatency) {
+        // One image on the display and one rendered, none of the frames waits in the swapchain
+        image_count = 2;
+    }
     if (image_count < caps.minImageCount) {
         image_count = caps.minImageCount;
     }
@@ -257,9 +305,23 @@ void Shell::ResizeSwapchain(uint32_t width_hint, uint32_t height_hint) {
     std::vector<VkPresentModeKHR> modes;
     vk::get(m_ctx.devCtx, m_ctx.devCtx->getPhysicalDevice(), m_ctx.surface, modes);
 
-    // FIFO is the only mode universally supported
+    // FIFO is the only mode universally supported, and the one of the paced presents, shown at their refresh
     VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
     for (auto m : modes) {
+        if (m_settings.m_presentPacing) {
+            break;
+        }
+        if (m_settings.m_lowLatency) {
+            // FIFO with vsync, locked to the refresh, else the immediate mode or the mailbox one
+            if (!m_settings.m_vsync && (m == VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+                mode = m;
+                break;
+            }
+            if (!m_settings.m_vsync && (m == VK_PRESENT_MODE_MAILBOX_KHR)) {
+                mode = m;
+            }
+            continue;
+        }
         if ((m_settings.m_vsync && (m == VK_PRESENT_MODE_MAILBOX_KHR)) ||
             (!m_settings.m_vsync && (m == VK_PRESENT_MODE_IMMEDIATE_KHR))) {
             mode = m;
@@ -276,6 +338,14 @@ void Shell::ResizeSwapchain(uint32_t width_hint, uint32_t height_hint) {
     swapchain_info.imageExtent = extent;
     swapchain_info.imageArrayLayers = 1;
     swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    m_ctx.storageSwapchain = m_settings.m_computePresent &&
+                             ((caps.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) != 0) &&
+                             IsStorageSwapchainFormat(m_ctx.devCtx, m_ctx.format.format);
+    if (m_ctx.storageSwapchain) {
+        swapchain_info.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    } else if (m_settings.m_computePresent && m_settings.m_verbose) {
+        std::cout << "The surface has no storage swapchain images, the frames are blitted" << std::endl;
+    }
 
     std::vector<uint32_t> queueFamilies(1, m_ctx.devCtx->GetGfxQueueFamilyIdx());
     if (m_ctx.devCtx->GetGfxQueueFamilyIdx() != m_ctx.devCtx->GetPresentQueueFamilyIdx()) {
@@ -307,11 +377,23 @@ void Shell::ResizeSwapchain(uint32_t width_hint, uint32_t height_hint) {
         m_ctx.devCtx->DestroySwapchainKHR(*m_ctx.devCtx, swapchain_info.oldSwapchain, nullptr);
     }
 
+    if (m_ctx.presentScheduler != nullptr) {
+        m_ctx.presentScheduler->AttachSwapchain(m_ctx.devCtx, m_ctx.swapchain);
+    }
+    if (m_ctx.lowLatencyPresenter != nullptr) {
+        m_ctx.lowLatencyPresenter->AttachSwapchain(m_ctx.devCtx, m_ctx.swapchain, m_displayRefreshDurationNs,
+                                                   (mode == VK_PRESENT_MODE_FIFO_KHR));
+    }
+
     m_frameProcessor->AttachSwapchain(*this);
 }
 
 void Shell::AcquireBackBuffer(bool trainFrame) {
 
+    if (m_ctx.lowLatencyPresenter != nullptr) {
+        m_ctx.lowLatencyPresenter->WaitForFrameStart();
+    }
+
     if(!m_ctx.acquireBuffers.empty()) {
 
         AcquireBuffer* acquireBuf = m_ctx.acquireBuffers.front();
@@ -419,12 +501,30 @@ void Shell::PresentBackBuffer(bool trainFrame) {
     presentInfo.pSwapchains = &m_ctx.swapchain;
     presentInfo.pImageIndices = &imageIndex;
 
+    VkPresentTimesInfoGOOGLE presentTimesInfo = VkPresentTimesInfoGOOGLE();
+    VkPresentTimeGOOGLE presentTime = VkPresentTimeGOOGLE();
+    if (m_ctx.presentScheduler != nullptr) {
+        presentInfo.pNext = m_ctx.presentScheduler->PreparePresent(presentInfo.pNext, presentTimesInfo, presentTime);
+    }
+    VkPresentIdKHR presentIdInfo = VkPresentIdKHR();
+    uint64_t presentId = 0;
+    if (m_ctx.lowLatencyPresenter != nullptr) {
+        presentInfo.pNext = m_ctx.lowLatencyPresenter->PreparePresent(presentInfo.pNext, presentIdInfo, presentId);
+    }
+
     VkResult res = m_ctx.devCtx->QueuePresentKHR(m_ctx.devCtx->GetPresentQueue(), &presentInfo);
     if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         std::cout << "Out of date Present Surface" << res << std::endl;
         return;
     }
 
+    if (m_ctx.presentScheduler != nullptr) {
+        m_ctx.presentScheduler->OnPresented();
+    }
+    if (m_ctx.lowLatencyPresenter != nullptr) {
+        m_ctx.lowLatencyPresenter->OnPresented(m_frameProcessor->GetLastRenderedFrameId());
+    }
+
     m_ctx.lastPresentTime = backBuffer->m_lastPresentTime = std::chrono::high_resolution_clock::now();
     static const std::chrono::nanoseconds targetDuration(12 * 1000 * 1000); // 16 mSec targeting ~60 FPS
     backBuffer->m_targetTimeDelta = targetDuration;
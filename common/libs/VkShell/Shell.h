@@ -28,6 +28,8 @@
 #include "VkCodecUtils/FrameProcessor.h"
 #include "VkCodecUtils/ProgramConfig.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanPresentScheduler.h"
+#include "VkCodecUtils/VulkanLowLatencyPresenter.h"
 #include "VkShell/VkWsiDisplay.h"
 
 static VkSemaphore vkNullSemaphore = VkSemaphore(0);
@@ -43,21 +45,30 @@ public:
         int32_t     m_initialHeight;
         int32_t     m_initialBitdepth;
         int32_t     m_backBufferCount;
+        uint32_t    m_displayRefreshMilliHz; // of the display mode of the direct mode, 0 for the highest one
         uint32_t    m_directToDisplayMode : 1;
         uint32_t    m_vsync : 1;
         uint32_t    m_verbose : 1;
+        uint32_t    m_presentPacing : 1; // present the frames at the display times of their PTS, on FIFO
+        uint32_t    m_computePresent : 1; // write the frames to storage swapchain images, without the graphics blit
+        uint32_t    m_lowLatency : 1; // 2 swapchain images, the frames started just in time for the next refresh
 
         Configuration(const char* windowName, int32_t backBufferCount = 4, bool directToDisplayMode = false,
                int32_t initialWidth = 1920, int32_t initialHeight = 1080, int32_t initialBitdepth = 8,
-               bool vsync = true, bool verbose = false)
+               bool vsync = true, bool verbose = false, bool presentPacing = false, bool computePresent = false,
+               bool lowLatency = false, uint32_t displayRefreshMilliHz = 0)
             : m_windowName(windowName)
             , m_initialWidth(initialWidth)
             , m_initialHeight(initialHeight)
             , m_initialBitdepth(initialBitdepth)
             , m_backBufferCount(backBufferCount)
-            , m_directToDisplayMode(false)
+            , m_displayRefreshMilliHz(displayRefreshMilliHz)
+            , m_directToDisplayMode(directToDisplayMode)
             , m_vsync(vsync)
             , m_verbose(verbose)
+            , m_presentPacing(presentPacing)
+            , m_computePresent(computePresent)
+            , m_lowLatency(lowLatency)
         {}
 
     };
@@ -167,7 +178,10 @@ public:
         , format()
         , swapchain()
         , extent()
-        , acquiredFrameId() {}
+        , acquiredFrameId()
+        , presentScheduler()
+        , lowLatencyPresenter()
+        , storageSwapchain() {}
 
         const VulkanDeviceContext* devCtx;
 
@@ -184,6 +198,15 @@ public:
         VkExtent2D extent;
 
         uint64_t acquiredFrameId;
+
+        // With the presentation pacing, the frame processor schedules its frames on it
+        VulkanPresentScheduler* presentScheduler;
+
+        // With the low latency presentation, the frames are started and presented by it
+        VulkanLowLatencyPresenter* lowLatencyPresenter;
+
+        // The swapchain images can be written by the compute shaders, for the compute present
+        bool storageSwapchain;
     };
     const Context &GetContext() const { return m_ctx; }
 
@@ -234,6 +257,10 @@ private:
 
 protected:
     Context m_ctx;
+    VulkanPresentScheduler m_presentScheduler;
+    VulkanLowLatencyPresenter m_lowLatencyPresenter;
+    // Of the display mode, set by the shells that choose it, 0 otherwise
+    int64_t m_displayRefreshDurationNs;
 };
 
 #endif  // SHELL_H
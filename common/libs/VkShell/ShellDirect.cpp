@@ -19,6 +19,7 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <cstdlib>
 
 #include <thread>
 #include <chrono>
@@ -128,7 +129,31 @@ VkSurfaceKHR ShellDirect::CreateSurface(VkInstance instance)
 
     // choose the first display mode
     assert(!modeProperties.empty());
-    const auto& modeProps = modeProperties[0];
+    uint32_t modeIndex = 0;
+    if (m_settings.m_lowLatency || (m_settings.m_displayRefreshMilliHz != 0)) {
+        // Of the resolution of the first one, the refresh rate closest to the requested one, else the highest
+        const VkExtent2D& visibleRegion = modeProperties[0].parameters.visibleRegion;
+        for (uint32_t i = 1; i < modeCount; i++) {
+            const VkDisplayModeParametersKHR& parameters = modeProperties[i].parameters;
+            if ((parameters.visibleRegion.width != visibleRegion.width) ||
+                    (parameters.visibleRegion.height != visibleRegion.height)) {
+                continue;
+            }
+            const uint32_t refreshRate = parameters.refreshRate;
+            const uint32_t bestRefreshRate = modeProperties[modeIndex].parameters.refreshRate;
+            const bool better = (m_settings.m_displayRefreshMilliHz == 0) ? (refreshRate > bestRefreshRate) :
+                    (std::abs((int64_t)refreshRate - m_settings.m_displayRefreshMilliHz) <
+                     std::abs((int64_t)bestRefreshRate - m_settings.m_displayRefreshMilliHz));
+            if (better) {
+                modeIndex = i;
+            }
+        }
+    }
+    const auto& modeProps = modeProperties[modeIndex];
+    if (modeProps.parameters.refreshRate > 0) {
+        // The refresh rate is in millihertz
+        m_displayRefreshDurationNs = 1000000000000LL / modeProps.parameters.refreshRate;
+    }
 
     // Get the list of planes
     uint32_t planeCount = 0;
@@ -187,7 +212,8 @@ VkSurfaceKHR ShellDirect::CreateSurface(VkInstance instance)
     AssertSuccess(m_ctx.devCtx->CreateDisplayPlaneSurfaceKHR(m_ctx.devCtx->getInstance(), &surfaceCreateInfo, nullptr, &surface));
 
     printf("Created display surface.\n"
-           "display res: %ux%u\n", surfaceExtent.width, surfaceExtent.height);
+           "display res: %ux%u, refresh rate: %.3f Hz\n", surfaceExtent.width, surfaceExtent.height,
+           modeProps.parameters.refreshRate / 1000.0);
     m_displayWidth = surfaceExtent.width;
     m_displayHeight = surfaceExtent.height;
 
@@ -279,6 +279,20 @@ vk_khr_buffer_device_address = Extension(name='VK_KHR_buffer_device_address', ve
 
 vk_khr_external_memory_fd = Extension(name='VK_KHR_external_memory_fd', version=1, guard=None, commands=[
     Command(name='GetMemoryFdKHR', dispatch='VkDevice'),
+    Command(name='GetMemoryFdPropertiesKHR', dispatch='VkDevice'),
+])
+
+vk_khr_external_semaphore_fd = Extension(name='VK_KHR_external_semaphore_fd', version=1, guard=None, commands=[
+    Command(name='GetSemaphoreFdKHR', dispatch='VkDevice'),
+    Command(name='ImportSemaphoreFdKHR', dispatch='VkDevice'),
+])
+
+vk_ext_image_drm_format_modifier = Extension(name='VK_EXT_image_drm_format_modifier', version=2, guard=None, commands=[
+    Command(name='GetImageDrmFormatModifierPropertiesEXT', dispatch='VkDevice'),
+])
+
+vk_ext_external_memory_host = Extension(name='VK_EXT_external_memory_host', version=1, guard=None, commands=[
+    Command(name='GetMemoryHostPointerPropertiesEXT', dispatch='VkDevice'),
 ])
 
 vk_khr_external_fence_fd = Extension(name='VK_KHR_external_fence_fd', version=1, guard=None, commands=[
@@ -400,6 +414,9 @@ extensions = [
     vk_ext_descriptor_buffer,
     vk_khr_buffer_device_address,
     vk_khr_external_memory_fd,
+    vk_ext_image_drm_format_modifier,
+    vk_khr_external_semaphore_fd,
+    vk_ext_external_memory_host,
     vk_khr_external_fence_fd,
     vk_khr_surface,
     vk_khr_swapchain,
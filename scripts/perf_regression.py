@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+# Copyright 2024 NVIDIA Corporation.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Runs the parser benchmark, the headless decode and the synthetic encode jobs of a corpus, and compares their
+# frame rate, p99 frame latency, peak memory and CPU time with the baseline of the GPU family. Exits with 1 when
+# a metric regresses beyond its threshold.
+#
+#   perf_regression.py --corpus-dir <streams> --bin-dir <build>/demos [--output results.json] [--update-baseline]
+#
+# The decoder and the encoder write their metrics with --metricsFile, the parser benchmark with --json.
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+SCRIPTS_DIR = os.path.dirname(os.path.abspath(__file__))
+
+TOOLS = {
+    'parser': 'vk-parser-bench',
+    'decode': 'vk-video-dec',
+    'encode': 'vk-video-enc',
+}
+
+# The metrics compared and whether a larger value is better
+METRICS = {
+    'fps': True,
+    'p99_frame_latency_ms': False,
+    'peak_device_memory_mb': False,
+    'peak_host_memory_mb': False,
+    'cpu_seconds': False,
+}
+
+DEFAULT_THRESHOLD = 0.05
+
+def gpu_family():
+    # The device name of vulkaninfo, e.g. nvidia-geforce-rtx-4090, else the baseline of any device
+    try:
+        summary = subprocess.run(['vulkaninfo', '--summary'], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                                 universal_newlines=True, timeout=60).stdout
+    except (OSError, subprocess.SubprocessError):
+        return 'default'
+    match = re.search(r'deviceName\s*=\s*(.+)', summary)
+    if not match:
+        return 'default'
+    return re.sub(r'[^a-z0-9]+', '-', match.group(1).strip().lower()).strip('-')
+
+def find_tool(bin_dirs, tool):
+    for bin_dir in bin_dirs:
+        for name in (tool, tool + '.exe'):
+            path = os.path.join(bin_dir, name)
+            if os.path.isfile(path) and os.access(path, os.X_OK):
+                return path
+    return None
+
+def run_timed(command, log_file):
+    # The CPU time and the peak resident memory of the child alone, from its usage where there is wait4
+    start = time.monotonic()
+    cpu_seconds = None
+    peak_host_memory_mb = None
+    with open(log_file, 'w') as log:
+        process = subprocess.Popen(command, stdout=log, stderr=subprocess.STDOUT)
+        if hasattr(os, 'wait4'):
+            _, status, usage = os.wait4(process.pid, 0)
+            process.returncode = -os.WTERMSIG(status) if os.WIFSIGNALED(status) else os.WEXITSTATUS(status)
+            cpu_seconds = usage.ru_utime + usage.ru_stime
+            peak_host_memory_mb = usage.ru_maxrss / 1024.0
+        else:
+            process.wait()
+    return process.returncode, time.monotonic() - start, cpu_seconds, peak_host_memory_mb
+
+def histogram_percentile(samples, name, percentile):
+    # The histograms of the streams merged, the bound of the bucket holding the percentile
+    buckets = {}
+    for sample in samples:
+        if sample['name'] != name or sample['type'] != 'histogram':
+            continue
+        for bound, count in sample['buckets']:
+            buckets[bound] = buckets.get(bound, 0) + count
+    if not buckets:
+        return None
+    bounds = sorted((bound for bound in buckets if bound is not None))
+    total = buckets.get(None, buckets[bounds[-1]] if bounds else 0)
+    if total == 0:
+        return None
+    for bound in bounds:
+        if buckets[bound] >= total * percentile:
+            return bound
+    return bounds[-1] * 2 if bounds else None
+
+def sum_samples(samples, name):
+    return sum(sample['value'] for sample in samples if sample['name'] == name)
+
+def run_job(job, tools, corpus_dir, work_dir):
+    tool = tools.get(job['tool'])
+    if tool is None:
+        return None, 'no %s' % TOOLS[job['tool']]
+
+    for stream in job.get('streams', []):
+        if not os.path.isfile(os.path.join(corpus_dir, stream)):
+            return None, 'no %s in the corpus' % stream
+
+    result_file = os.path.join(work_dir, job['name'] + '.json')
+    substitutions = {'corpus': corpus_dir, 'out': work_dir}
+    command = [tool] + [arg.format(**substitutions) for arg in job['args']]
+    command += ['--json' if job['tool'] == 'parser' else '--metricsFile', result_file]
+
+    log_file = os.path.join(work_dir, job['name'] + '.log')
+    if os.path.isfile(result_file):
+        os.remove(result_file)
+    returncode, _, cpu_seconds, peak_host_memory_mb = run_timed(command, log_file)
+    if returncode != 0 or not os.path.isfile(result_file):
+        with open(log_file) as f:
+            output = f.read()
+        return None, 'failed (%d):\n%s' % (returncode, output[-4000:])
+
+    with open(result_file) as f:
+        result = json.load(f)
+
+    metrics = {'cpu_seconds': cpu_seconds, 'peak_host_memory_mb': peak_host_memory_mb}
+    if job['tool'] == 'parser':
+        pictures = sum(stream['pictures'] for stream in result['streams'])
+        parse_seconds = sum(stream['seconds'] for stream in result['streams'])
+        metrics['fps'] = pictures / parse_seconds if parse_seconds > 0 else 0.0
+    else:
+        samples = result['metrics']
+        if job['tool'] == 'decode':
+            frames = sum_samples(samples, 'vkvideo_decoder_frames_decoded_total')
+            latency_us = histogram_percentile(samples, 'vkvideo_decoder_decode_picture_us', 0.99)
+        else:
+            frames = sum_samples(samples, 'vkvideo_encoder_frames_encoded_total')
+            latency_us = histogram_percentile(samples, 'vkvideo_encoder_frame_latency_us', 0.99)
+        metrics['fps'] = frames / result['seconds'] if result['seconds'] > 0 else 0.0
+        metrics['p99_frame_latency_ms'] = latency_us / 1000.0 if latency_us is not None else None
+        metrics['peak_device_memory_mb'] = sum_samples(samples, 'vk_device_memory_device_local_peak_bytes') / 2**20
+    return {name: value for name, value in metrics.items() if value is not None}, None
+
+def median_of(runs):
+    # The median run of each metric, the repeats being noisy both ways
+    metrics = {}
+    for name in METRICS:
+        values = sorted(run[name] for run in runs if name in run)
+        if values:
+            metrics[name] = values[len(values) // 2]
+    return metrics
+
+def compare(results, baseline, default_threshold):
+    regressions = []
+    thresholds = baseline.get('thresholds', {})
+    for job_name, metrics in sorted(results.items()):
+        baseline_metrics = baseline.get('jobs', {}).get(job_name)
+        if baseline_metrics is None:
+            print('%s: no baseline' % job_name)
+            continue
+        for name, higher_is_better in METRICS.items():
+            if name not in metrics or not baseline_metrics.get(name):
+                continue
+            threshold = thresholds.get(name, default_threshold)
+            change = (metrics[name] - baseline_metrics[name]) / baseline_metrics[name]
+            regressed = (change < -threshold) if higher_is_better else (change > threshold)
+            print('%s: %s %.3f, baseline %.3f, %+.1f%%%s' % (job_name, name, metrics[name], baseline_metrics[name],
+                                                             change * 100.0, ' REGRESSION' if regressed else ''))
+            if regressed:
+                regressions.append('%s %s' % (job_name, name))
+    return regressions
+
+def main():
+    parser = argparse.ArgumentParser(description='Compares the performance of the samples with a stored baseline')
+    parser.add_argument('--corpus', default=os.path.join(SCRIPTS_DIR, 'perf_corpus.json'),
+                        help='The JSON of the jobs')
+    parser.add_argument('--corpus-dir', default=os.environ.get('VK_VIDEO_PERF_CORPUS_DIR', ''),
+                        help='The directory of the streams of the jobs')
+    parser.add_argument('--bin-dir', action='append', default=[],
+                        help='A directory of the tools, can be repeated')
+    parser.add_argument('--tools', default=','.join(TOOLS),
+                        help='The kinds of jobs run, e.g. parser,decode')
+    parser.add_argument('--gpu-family', default=None,
+                        help='The baseline compared with, the device name of vulkaninfo by default')
+    parser.add_argument('--baseline-dir', default=os.path.join(SCRIPTS_DIR, 'perf_baselines'))
+    parser.add_argument('--threshold', type=float, default=DEFAULT_THRESHOLD,
+                        help='The relative change of a metric taken as a regression, unless the baseline sets one')
+    parser.add_argument('--repeat', type=int, default=3, help='Runs of each job, the median is compared')
+    parser.add_argument('--output', default=None, help='Also writes the results to that JSON file')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='Writes the results as the baseline of the GPU family instead of comparing them')
+    args = parser.parse_args()
+
+    with open(args.corpus) as f:
+        jobs = json.load(f)['jobs']
+    kinds = args.tools.split(',')
+    tools = {kind: find_tool(args.bin_dir or [os.getcwd()], TOOLS[kind]) for kind in kinds if kind in TOOLS}
+    family = args.gpu_family or gpu_family()
+    baseline_file = os.path.join(args.baseline_dir, family + '.json')
+
+    work_dir = tempfile.mkdtemp(prefix='vk-perf-')
+    results = {}
+    failures = []
+    try:
+        for job in jobs:
+            if job['tool'] not in tools:
+                continue
+            runs = []
+            error = None
+            for _ in range(max(args.repeat, 1)):
+                metrics, error = run_job(job, tools, args.corpus_dir, work_dir)
+                if metrics is None:
+                    break
+                runs.append(metrics)
+            if error is not None and error.startswith('failed'):
+                print('%s: %s' % (job['name'], error))
+                failures.append(job['name'])
+            elif error is not None:
+                print('%s: skipped, %s' % (job['name'], error))
+            else:
+                results[job['name']] = median_of(runs)
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    report = {'gpu_family': family, 'jobs': results}
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+
+    if args.update_baseline:
+        # The thresholds tuned in the previous baseline and the jobs not run this time are kept
+        if os.path.isfile(baseline_file):
+            with open(baseline_file) as f:
+                previous = json.load(f)
+            if 'thresholds' in previous:
+                report['thresholds'] = previous['thresholds']
+            report['jobs'] = dict(previous.get('jobs', {}), **results)
+        os.makedirs(args.baseline_dir, exist_ok=True)
+        with open(baseline_file, 'w') as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            f.write('\n')
+        print('Wrote the baseline %s' % baseline_file)
+        return 1 if failures else 0
+
+    if not os.path.isfile(baseline_file):
+        print('No baseline for %s in %s, run with --update-baseline to record one' % (family, args.baseline_dir))
+        return 1 if failures else 0
+    with open(baseline_file) as f:
+        baseline = json.load(f)
+    regressions = compare(results, baseline, args.threshold)
+    for regression in regressions:
+        print('Regression: %s' % regression)
+    for failure in failures:
+        print('Failed: %s' % failure)
+    return 1 if (regressions or failures) else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the CPU copy and color conversion kernels of YCbCrConvUtilsCpu, the ones the encoder's input and the
+// decoder's frame output go through, from CIF to 8K and for 8, 10 and 16-bit samples. Reports the bytes read and
+// written per second, next to the rate of a memcpy() of a buffer larger than the caches, the memory bandwidth the
+// kernels are bound by. The frames that fit in the caches are converted above that rate.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VkCodecUtils/YCbCrConvUtilsCpu.h"
+#include "VkCodecUtils/VkThreadPool.h"
+
+struct Resolution {
+    const char* name;
+    int         width;
+    int         height;
+};
+
+static const Resolution gResolutions[] = {
+    { "CIF",    352,  288 },
+    { "720p",  1280,  720 },
+    { "1080p", 1920, 1080 },
+    { "4K",    3840, 2160 },
+    { "8K",    7680, 4320 },
+};
+
+static const int gDepths[] = { 8, 10, 16 };
+
+// The bytes each timed sample moves at least, the small frames are converted several times per sample
+static const size_t gMinBytesPerSample = 64 * 1024 * 1024;
+
+// The planes of a 4:2:0 frame, I420 (I010/I016 above 8 bits) in and NV12 (P010/P016) out, with padded strides
+class BenchFrame
+{
+public:
+
+    BenchFrame(int width, int height, int depth)
+        : m_width(width)
+        , m_height(height)
+        , m_chromaWidth((width + 1) / 2)
+        , m_chromaHeight((height + 1) / 2)
+        , m_bytesPerSample((depth > 8) ? 2 : 1)
+        , m_stride(AlignStride(width))
+        , m_chromaStride(AlignStride(m_chromaWidth))
+        , m_src((size_t)m_stride * height + 2 * (size_t)m_chromaStride * m_chromaHeight)
+        , m_dst((size_t)m_stride * height + 2 * (size_t)m_chromaStride * m_chromaHeight)
+    {
+        // Samples within the depth, the 16-bit kernels shift them up
+        const uint32_t mask = (1U << depth) - 1;
+        if (m_bytesPerSample == 2) {
+            uint16_t* src = (uint16_t*)m_src.data();
+            for (size_t i = 0; i < m_src.size() / 2; i++) {
+                src[i] = (uint16_t)((i * 7) & mask);
+            }
+        } else {
+            for (size_t i = 0; i < m_src.size(); i++) {
+                m_src[i] = (uint8_t)(i * 7);
+            }
+        }
+        // Fault the pages in before the timing
+        memset(m_dst.data(), 0, m_dst.size());
+    }
+
+    int Width() const { return m_width; }
+    int Height() const { return m_height; }
+    int ChromaWidth() const { return m_chromaWidth; }
+    int ChromaHeight() const { return m_chromaHeight; }
+    int BytesPerSample() const { return m_bytesPerSample; }
+
+    // In bytes, and in samples for the 16-bit kernels
+    int Stride() const { return m_stride; }
+    int ChromaStride() const { return m_chromaStride; }
+    int Stride16() const { return m_stride / 2; }
+    int ChromaStride16() const { return m_chromaStride / 2; }
+
+    const uint8_t* SrcY() const { return m_src.data(); }
+    const uint8_t* SrcU() const { return SrcY() + (size_t)m_stride * m_height; }
+    const uint8_t* SrcV() const { return SrcU() + (size_t)m_chromaStride * m_chromaHeight; }
+    uint8_t* DstY() { return m_dst.data(); }
+    uint8_t* DstUV() { return DstY() + (size_t)m_stride * m_height; }
+
+    size_t LumaBytes() const { return (size_t)m_width * m_height * m_bytesPerSample; }
+    size_t ChromaPlaneBytes() const { return (size_t)m_chromaWidth * m_chromaHeight * m_bytesPerSample; }
+
+private:
+
+    int AlignStride(int samples) const { return ((samples * m_bytesPerSample) + 255) & ~255; }
+
+private:
+    const int            m_width;
+    const int            m_height;
+    const int            m_chromaWidth;
+    const int            m_chromaHeight;
+    const int            m_bytesPerSample;
+    const int            m_stride;
+    const int            m_chromaStride;
+    std::vector<uint8_t> m_src;
+    std::vector<uint8_t> m_dst;
+};
+
+// The fastest of the iterations, each running the kernel repeatCount times, in seconds per run
+static double TimeKernel(const std::function<void()>& kernel, uint32_t iterations, uint32_t repeatCount)
+{
+    // Warm up, e.g. the thread pool and the dispatch of the SIMD paths
+    kernel();
+    double bestSeconds = 0.0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+            kernel();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() /
+                                repeatCount;
+        if ((iteration == 0) || (seconds < bestSeconds)) {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds;
+}
+
+// The bytes read and written per second by a memcpy() of a buffer no cache holds
+static double MeasureMemoryBandwidth(uint32_t iterations)
+{
+    const size_t size = 512 * 1024 * 1024;
+    std::vector<uint8_t> src(size, 1);
+    std::vector<uint8_t> dst(size, 0);
+    const double seconds = TimeKernel([&]() { memcpy(dst.data(), src.data(), size); }, iterations, 1);
+    return (seconds > 0.0) ? (2.0 * size / seconds) : 0.0;
+}
+
+static void PrintHelp()
+{
+    fprintf(stderr, "Usage: vk-conv-bench [options]\n\
+Times the CPU copy and color conversion kernels from CIF to 8K, for 8, 10 and 16-bit samples\n\
+    --iterations            <integer> : Times each kernel is timed, the fastest one is reported (default 5) \n\
+    --threads               <integer> : Threads of the banded conversions (default: the hardware threads) \n\
+    --resolution            <string> : Only that resolution, CIF, 720p, 1080p, 4K or 8K \n\
+    --depth                 <integer> : Only that bit depth, 8, 10 or 16 \n\
+    --json                  <string> : Also write the results to that file in JSON \n\
+    --help                  Print this help\n");
+}
+
+int main(int argc, const char** argv)
+{
+    uint32_t iterations = 5;
+    uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    const char* resolutionName = nullptr;
+    int onlyDepth = 0;
+    const char* jsonFileName = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%u", &iterations) != 1) || (iterations == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%u", &numThreads) != 1) || (numThreads == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--resolution") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            resolutionName = argv[i];
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%d", &onlyDepth) != 1) ||
+                    (std::find(std::begin(gDepths), std::end(gDepths), onlyDepth) == std::end(gDepths))) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--json") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            jsonFileName = argv[i];
+        } else if (strcmp(argv[i], "--help") == 0) {
+            PrintHelp();
+            return 0;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            PrintHelp();
+            return -1;
+        }
+    }
+
+    if ((resolutionName != nullptr) &&
+            std::none_of(std::begin(gResolutions), std::end(gResolutions),
+                         [&](const Resolution& resolution) { return strcmp(resolution.name, resolutionName) == 0; })) {
+        fprintf(stderr, "Invalid resolution: %s\n", resolutionName);
+        return -1;
+    }
+
+    const double memoryBandwidth = MeasureMemoryBandwidth(iterations);
+    printf("Memory bandwidth: %.2f GB/s (memcpy, read and written), %u threads for the banded kernels\n",
+           memoryBandwidth / 1.0e9, numThreads);
+
+    std::unique_ptr<VkThreadPool> threadPool;
+    if (numThreads > 1) {
+        threadPool.reset(new VkThreadPool(numThreads));
+    }
+    const int numBands = (int)numThreads;
+
+    std::string jsonResults;
+    for (const Resolution& resolution : gResolutions) {
+        if ((resolutionName != nullptr) && (strcmp(resolution.name, resolutionName) != 0)) {
+            continue;
+        }
+        for (const int depth : gDepths) {
+            if ((onlyDepth != 0) && (depth != onlyDepth)) {
+                continue;
+            }
+
+            BenchFrame frame(resolution.width, resolution.height, depth);
+            const size_t lumaBytes = frame.LumaBytes();
+            const size_t chromaBytes = 2 * frame.ChromaPlaneBytes();
+
+            // The name, the bytes read and written by a run, and the kernel
+            struct Kernel {
+                const char*           name;
+                size_t                bytes;
+                std::function<void()> run;
+            };
+            std::vector<Kernel> kernels;
+            if (depth == 8) {
+                kernels.push_back({ "CopyPlane", 2 * lumaBytes, [&]() {
+                    YCbCrConvUtilsCpu::CopyPlane(frame.SrcY(), frame.Stride(), frame.DstY(), frame.Stride(),
+                                                 frame.Width(), frame.Height());
+                } });
+                kernels.push_back({ "MergeUVPlane", 2 * chromaBytes, [&]() {
+                    YCbCrConvUtilsCpu::MergeUVPlane(frame.SrcU(), frame.ChromaStride(),
+                                                    frame.SrcV(), frame.ChromaStride(),
+                                                    frame.DstUV(), frame.Stride(),
+                                                    frame.ChromaWidth(), frame.ChromaHeight());
+                } });
+                kernels.push_back({ "I420ToNV12", 2 * (lumaBytes + chromaBytes), [&]() {
+                    YCbCrConvUtilsCpu::I420ToNV12(frame.SrcY(), frame.Stride(), frame.SrcU(), frame.ChromaStride(),
+                                                  frame.SrcV(), frame.ChromaStride(), frame.DstY(), frame.Stride(),
+                                                  frame.DstUV(), frame.Stride(), frame.Width(), frame.Height());
+                } });
+                if (threadPool) {
+                    kernels.push_back({ "I420ToNV12 banded", 2 * (lumaBytes + chromaBytes), [&]() {
+                        YCbCrConvUtilsCpu::I420ToNV12(frame.SrcY(), frame.Stride(),
+                                                      frame.SrcU(), frame.ChromaStride(),
+                                                      frame.SrcV(), frame.ChromaStride(),
+                                                      frame.DstY(), frame.Stride(), frame.DstUV(), frame.Stride(),
+                                                      frame.Width(), frame.Height(), threadPool.get(), numBands);
+                    } });
+                }
+            } else {
+                const uint16_t* srcY = (const uint16_t*)frame.SrcY();
+                const uint16_t* srcU = (const uint16_t*)frame.SrcU();
+                const uint16_t* srcV = (const uint16_t*)frame.SrcV();
+                uint16_t* dstY = (uint16_t*)frame.DstY();
+                uint16_t* dstUV = (uint16_t*)frame.DstUV();
+                kernels.push_back({ "CopyPlane", 2 * lumaBytes, [&]() {
+                    YCbCrConvUtilsCpu::CopyPlane(frame.SrcY(), frame.Stride(), frame.DstY(), frame.Stride(),
+                                                 frame.Width() * 2, frame.Height());
+                } });
+                kernels.push_back({ "ShiftPlane_16", 2 * lumaBytes, [=, &frame]() {
+                    YCbCrConvUtilsCpu::ShiftPlane_16(srcY, frame.Stride16(), dstY, frame.Stride16(), depth,
+                                                     frame.Width(), frame.Height());
+                } });
+                kernels.push_back({ "MergeUVPlane_16", 2 * chromaBytes, [=, &frame]() {
+                    YCbCrConvUtilsCpu::MergeUVPlane_16(srcU, frame.ChromaStride16(), srcV, frame.ChromaStride16(),
+                                                       dstUV, frame.Stride16(), depth,
+                                                       frame.ChromaWidth(), frame.ChromaHeight());
+                } });
+                kernels.push_back({ "I010ToP010", 2 * (lumaBytes + chromaBytes), [=, &frame]() {
+                    YCbCrConvUtilsCpu::I010ToP010(srcY, frame.Stride16(), srcU, frame.ChromaStride16(),
+                                                  srcV, frame.ChromaStride16(), dstY, frame.Stride16(),
+                                                  dstUV, frame.Stride16(), depth, frame.Width(), frame.Height());
+                } });
+                if (threadPool) {
+                    VkThreadPool* pool = threadPool.get();
+                    kernels.push_back({ "I010ToP010 banded", 2 * (lumaBytes + chromaBytes), [=, &frame]() {
+                        YCbCrConvUtilsCpu::I010ToP010(srcY, frame.Stride16(), srcU, frame.ChromaStride16(),
+                                                      srcV, frame.ChromaStride16(), dstY, frame.Stride16(),
+                                                      dstUV, frame.Stride16(), depth, frame.Width(), frame.Height(),
+                                                      pool, numBands);
+                    } });
+                }
+            }
+
+            printf("%s %dx%d, %d-bit\n", resolution.name, resolution.width, resolution.height, depth);
+            for (const Kernel& kernel : kernels) {
+                const uint32_t repeatCount = (uint32_t)std::max<size_t>(gMinBytesPerSample / kernel.bytes, 1);
+                const double seconds = TimeKernel(kernel.run, iterations, repeatCount);
+                const double bytesPerSecond = (seconds > 0.0) ? (kernel.bytes / seconds) : 0.0;
+                const double percentOfMemory = (memoryBandwidth > 0.0) ? (100.0 * bytesPerSecond / memoryBandwidth) : 0.0;
+                printf("\t%-20s %10.3f us %10.2f GB/s %6.1f%% of memory bandwidth\n",
+                       kernel.name, seconds * 1.0e6, bytesPerSecond / 1.0e9, percentOfMemory);
+
+                if (jsonFileName != nullptr) {
+                    char jsonResult[384];
+                    snprintf(jsonResult, sizeof(jsonResult),
+                             "%s\n    { \"kernel\": \"%s\", \"resolution\": \"%s\", \"width\": %d, \"height\": %d, "
+                             "\"depth\": %d, \"bytes\": %zu, \"seconds\": %.9f, \"gbPerSecond\": %.3f, "
+                             "\"percentOfMemoryBandwidth\": %.1f }",
+                             jsonResults.empty() ? "" : ",", kernel.name, resolution.name, resolution.width,
+                             resolution.height, depth, kernel.bytes, seconds, bytesPerSecond / 1.0e9, percentOfMemory);
+                    jsonResults += jsonResult;
+                }
+            }
+        }
+    }
+
+    if (jsonFileName != nullptr) {
+        FILE* jsonFile = fopen(jsonFileName, "w");
+        if (jsonFile == nullptr) {
+            fprintf(stderr, "Can't open %s for writing\n", jsonFileName);
+            return -1;
+        }
+        fprintf(jsonFile, "{\n  \"iterations\": %u,\n  \"threads\": %u,\n  \"memoryGbPerSecond\": %.3f,\n"
+                "  \"results\": [%s\n  ]\n}\n", iterations, numThreads, memoryBandwidth / 1.0e9, jsonResults.c_str());
+        fclose(jsonFile);
+    }
+
+    return 0;
+}
@@ -0,0 +1,605 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the H.264 and H.265 parsers on elementary streams, without a Vulkan device: the pictures are
+// dropped once parsed, so that the parsing is measured apart from the decode. Reports the input rate, the NAL
+// units and the slices per second, for a corpus of streams of the features of interest, e.g. CAVLC and CABAC,
+// multi-slice, field coded and high bitrate intra streams.
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "vkvideo_parser/VulkanVideoParserIf.h"
+#include "NvVideoParser/nvVulkanVideoParser.h"
+#include "VkCodecUtils/VulkanBitstreamBuffer.h"
+
+// A bitstream buffer in host memory, reused once the parser and the pictures are done with it
+class HostBitstreamBuffer : public VulkanBitstreamBuffer
+{
+public:
+
+    static VkSharedBaseObj<HostBitstreamBuffer> Create(VkDeviceSize size, VkDeviceSize offsetAlignment,
+                                                       VkDeviceSize sizeAlignment)
+    {
+        return VkSharedBaseObj<HostBitstreamBuffer>(new HostBitstreamBuffer(size, offsetAlignment, sizeAlignment));
+    }
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the buffer if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    virtual int32_t GetRefCount()
+    {
+        assert(m_refCount > 0);
+        return m_refCount;
+    }
+
+    virtual VkDeviceSize GetMaxSize() const { return m_data.size(); }
+    virtual VkDeviceSize GetOffsetAlignment() const { return m_offsetAlignment; }
+    virtual VkDeviceSize GetSizeAlignment() const { return m_sizeAlignment; }
+
+    virtual VkDeviceSize Resize(VkDeviceSize newSize, VkDeviceSize copySize = 0, VkDeviceSize copyOffset = 0)
+    {
+        if (newSize > m_data.size()) {
+            // The data kept is moved to the start of the buffer
+            if ((copySize > 0) && (copyOffset > 0)) {
+                memmove(m_data.data(), m_data.data() + copyOffset, (size_t)copySize);
+            }
+            m_data.resize((size_t)AlignSize(newSize));
+        }
+        return m_data.size();
+    }
+
+    virtual VkDeviceSize Clone(VkDeviceSize newSize, VkDeviceSize copySize, VkDeviceSize copyOffset,
+                               VkSharedBaseObj<VulkanBitstreamBuffer>& vulkanBitstreamBuffer)
+    {
+        VkSharedBaseObj<HostBitstreamBuffer> clone(Create(newSize, m_offsetAlignment, m_sizeAlignment));
+        if (copySize > 0) {
+            memcpy(clone->m_data.data(), m_data.data() + copyOffset, (size_t)copySize);
+        }
+        vulkanBitstreamBuffer = clone;
+        return clone->GetMaxSize();
+    }
+
+    virtual int64_t MemsetData(uint32_t value, VkDeviceSize offset, VkDeviceSize size)
+    {
+        if ((offset + size) > m_data.size()) {
+            return -1;
+        }
+        memset(m_data.data() + offset, (int)value, (size_t)size);
+        return (int64_t)size;
+    }
+
+    virtual int64_t CopyDataToBuffer(uint8_t *dstBuffer, VkDeviceSize dstOffset,
+                                     VkDeviceSize srcOffset, VkDeviceSize size) const
+    {
+        if ((srcOffset + size) > m_data.size()) {
+            return -1;
+        }
+        memcpy(dstBuffer + dstOffset, m_data.data() + srcOffset, (size_t)size);
+        return (int64_t)size;
+    }
+
+    virtual int64_t CopyDataToBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& dstBuffer, VkDeviceSize dstOffset,
+                                     VkDeviceSize srcOffset, VkDeviceSize size) const
+    {
+        VkDeviceSize maxSize = 0;
+        uint8_t* pDstData = dstBuffer->GetDataPtr(dstOffset, maxSize);
+        if ((pDstData == nullptr) || (maxSize < size)) {
+            return -1;
+        }
+        return CopyDataToBuffer(pDstData, 0, srcOffset, size);
+    }
+
+    virtual int64_t CopyDataFromBuffer(const uint8_t *sourceBuffer, VkDeviceSize srcOffset,
+                                       VkDeviceSize dstOffset, VkDeviceSize size)
+    {
+        if ((dstOffset + size) > m_data.size()) {
+            return -1;
+        }
+        memcpy(m_data.data() + dstOffset, sourceBuffer + srcOffset, (size_t)size);
+        return (int64_t)size;
+    }
+
+    virtual int64_t CopyDataFromBuffer(const VkSharedBaseObj<VulkanBitstreamBuffer>& sourceBuffer,
+                                       VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size)
+    {
+        VkDeviceSize maxSize = 0;
+        const uint8_t* pSrcData = sourceBuffer->GetReadOnlyDataPtr(srcOffset, maxSize);
+        if ((pSrcData == nullptr) || (maxSize < size)) {
+            return -1;
+        }
+        return CopyDataFromBuffer(pSrcData, 0, dstOffset, size);
+    }
+
+    virtual uint8_t* GetDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize)
+    {
+        if (offset >= m_data.size()) {
+            maxSize = 0;
+            return nullptr;
+        }
+        maxSize = m_data.size() - offset;
+        return m_data.data() + offset;
+    }
+
+    virtual const uint8_t* GetReadOnlyDataPtr(VkDeviceSize offset, VkDeviceSize &maxSize) const
+    {
+        if (offset >= m_data.size()) {
+            maxSize = 0;
+            return nullptr;
+        }
+        maxSize = m_data.size() - offset;
+        return m_data.data() + offset;
+    }
+
+    virtual void FlushRange(VkDeviceSize offset, VkDeviceSize size) const { }
+    virtual void InvalidateRange(VkDeviceSize offset, VkDeviceSize size) const { }
+    virtual VkBuffer GetBuffer() const { return VK_NULL_HANDLE; }
+    virtual VkDeviceMemory GetDeviceMemory() const { return VK_NULL_HANDLE; }
+
+    virtual uint32_t AddStreamMarker(uint32_t streamOffset)
+    {
+        m_streamMarkers.push_back(streamOffset);
+        return (uint32_t)(m_streamMarkers.size() - 1);
+    }
+
+    virtual uint32_t SetStreamMarker(uint32_t streamOffset, uint32_t index)
+    {
+        if (index >= m_streamMarkers.size()) {
+            return (uint32_t)-1;
+        }
+        m_streamMarkers[index] = streamOffset;
+        return index;
+    }
+
+    virtual uint32_t GetStreamMarker(uint32_t index) const
+    {
+        assert(index < m_streamMarkers.size());
+        return m_streamMarkers[index];
+    }
+
+    virtual uint32_t GetStreamMarkersCount() const { return (uint32_t)m_streamMarkers.size(); }
+
+    virtual const uint32_t* GetStreamMarkersPtr(uint32_t startIndex, uint32_t& maxCount) const
+    {
+        maxCount = (startIndex < m_streamMarkers.size()) ? (uint32_t)(m_streamMarkers.size() - startIndex) : 0;
+        return (maxCount > 0) ? &m_streamMarkers[startIndex] : nullptr;
+    }
+
+    virtual uint32_t ResetStreamMarkers()
+    {
+        const uint32_t oldSize = (uint32_t)m_streamMarkers.size();
+        m_streamMarkers.clear();
+        return oldSize;
+    }
+
+private:
+
+    HostBitstreamBuffer(VkDeviceSize size, VkDeviceSize offsetAlignment, VkDeviceSize sizeAlignment)
+        : VulkanBitstreamBuffer()
+        , m_refCount(0)
+        , m_offsetAlignment(std::max<VkDeviceSize>(offsetAlignment, 1))
+        , m_sizeAlignment(std::max<VkDeviceSize>(sizeAlignment, 1))
+        , m_data((size_t)AlignSize(size))
+        , m_streamMarkers() { m_streamMarkers.reserve(256); }
+
+    virtual ~HostBitstreamBuffer() { }
+
+    VkDeviceSize AlignSize(VkDeviceSize size) const
+    {
+        return ((size + m_sizeAlignment - 1) / m_sizeAlignment) * m_sizeAlignment;
+    }
+
+private:
+    std::atomic<int32_t>  m_refCount;
+    const VkDeviceSize    m_offsetAlignment;
+    const VkDeviceSize    m_sizeAlignment;
+    std::vector<uint8_t>  m_data;
+    std::vector<uint32_t> m_streamMarkers;
+};
+
+// Back to the pool once the parser releases its last reference
+class BenchPicture : public vkPicBuffBase {
+};
+
+// Counts what the parser hands over and drops it, with just enough state for the parser to go on
+class BenchDecodeClient : public VkParserVideoDecodeClient
+{
+public:
+
+    enum { MAX_PICTURES = 64 };
+
+    BenchDecodeClient()
+        : m_pictures(MAX_PICTURES)
+        , m_bitstreamBuffers()
+        , m_numSequences(0)
+        , m_numPictures(0)
+        , m_numSlices(0)
+        , m_numDisplayed(0)
+    {
+        for (uint32_t picIdx = 0; picIdx < MAX_PICTURES; picIdx++) {
+            m_pictures[picIdx].m_picIdx = (int32_t)picIdx;
+        }
+    }
+
+    virtual ~BenchDecodeClient() { }
+
+    void ResetCounters()
+    {
+        m_numSequences = 0;
+        m_numPictures = 0;
+        m_numSlices = 0;
+        m_numDisplayed = 0;
+    }
+
+    virtual int32_t BeginSequence(const VkParserSequenceInfo* pnvsi)
+    {
+        m_numSequences++;
+        return std::min<int32_t>(std::max<int32_t>(pnvsi->nMinNumDecodeSurfaces, 1), MAX_PICTURES);
+    }
+
+    virtual bool AllocPictureBuffer(VkPicIf** ppPicBuf)
+    {
+        for (BenchPicture& picture : m_pictures) {
+            if (picture.IsAvailable()) {
+                picture.AddRef();
+                *ppPicBuf = &picture;
+                return true;
+            }
+        }
+        *ppPicBuf = nullptr;
+        return false;
+    }
+
+    virtual bool DecodePicture(VkParserPictureData* pParserPictureData)
+    {
+        m_numPictures++;
+        m_numSlices += pParserPictureData->numSlices;
+        return true;
+    }
+
+    virtual bool UpdatePictureParameters(VkSharedBaseObj<StdVideoPictureParametersSet>& pictureParametersObject,
+                                         VkSharedBaseObj<VkVideoRefCountBase>& client)
+    {
+        return true;
+    }
+
+    virtual bool DisplayPicture(VkPicIf* pPicBuf, int64_t llPTS)
+    {
+        m_numDisplayed++;
+        return true;
+    }
+
+    virtual void UnhandledNALU(const uint8_t* pbData, size_t cbData) { }
+
+    virtual VkDeviceSize GetBitstreamBuffer(VkDeviceSize size,
+                                            VkDeviceSize minBitstreamBufferOffsetAlignment,
+                                            VkDeviceSize minBitstreamBufferSizeAlignment,
+                                            const uint8_t* pInitializeBufferMemory,
+                                            VkDeviceSize initializeBufferMemorySize,
+                                            VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer)
+    {
+        // A buffer only the pool refers to anymore is reused, as a decoder's bitstream buffer pool would
+        VkSharedBaseObj<HostBitstreamBuffer> hostBuffer;
+        for (VkSharedBaseObj<HostBitstreamBuffer>& pooledBuffer : m_bitstreamBuffers) {
+            if (pooledBuffer->GetRefCount() == 1) {
+                hostBuffer = pooledBuffer;
+                break;
+            }
+        }
+        if (!hostBuffer) {
+            hostBuffer = HostBitstreamBuffer::Create(size, minBitstreamBufferOffsetAlignment,
+                                                     minBitstreamBufferSizeAlignment);
+            m_bitstreamBuffers.push_back(hostBuffer);
+        }
+        hostBuffer->Resize(size);
+        hostBuffer->ResetStreamMarkers();
+        if (initializeBufferMemorySize > 0) {
+            hostBuffer->CopyDataFromBuffer(pInitializeBufferMemory, 0, 0, initializeBufferMemorySize);
+        }
+        bitstreamBuffer = hostBuffer;
+        return hostBuffer->GetMaxSize();
+    }
+
+    uint64_t GetNumSequences() const { return m_numSequences; }
+    uint64_t GetNumPictures() const { return m_numPictures; }
+    uint64_t GetNumSlices() const { return m_numSlices; }
+    uint64_t GetNumDisplayed() const { return m_numDisplayed; }
+
+private:
+    std::vector<BenchPicture>                          m_pictures;
+    std::vector<VkSharedBaseObj<HostBitstreamBuffer>>  m_bitstreamBuffers;
+    uint64_t                                           m_numSequences;
+    uint64_t                                           m_numPictures;
+    uint64_t                                           m_numSlices;
+    uint64_t                                           m_numDisplayed;
+};
+
+// Quiet while timing
+static void BenchParserLog(const char* format, ...)
+{
+}
+
+static bool ReadFile(const char* fileName, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(fileName, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize((size > 0) ? (size_t)size : 0);
+    const bool success = (size > 0) && (fread(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+    return success;
+}
+
+static uint64_t CountNalUnits(const std::vector<uint8_t>& data)
+{
+    uint64_t numNalUnits = 0;
+    for (size_t i = 0; (i + 2) < data.size(); i++) {
+        if ((data[i] == 0) && (data[i + 1] == 0) && (data[i + 2] == 1)) {
+            numNalUnits++;
+            i += 2;
+        }
+    }
+    return numNalUnits;
+}
+
+static bool HasExtension(const std::string& fileName, const char* const* extensions)
+{
+    const size_t dot = fileName.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string extension = fileName.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (; *extensions != nullptr; extensions++) {
+        if (extension == *extensions) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void PrintHelp()
+{
+    fprintf(stderr, "Usage: vk-parser-bench [options] <stream> [<stream> ...]\n\
+Parses the H.264 and H.265 elementary streams without decoding them and reports the parsing rate\n\
+    --codec                 <string> : h264 or h265, else from the extension of each stream \n\
+    --iterations            <integer> : Times each stream is parsed, the fastest one is reported (default 5) \n\
+    --packetSize            <integer> : Bytes per packet fed to the parser (default 1048576) \n\
+    --json                  <string> : Also write the results to that file in JSON, e.g. for scripts/perf_regression.py \n\
+    --help                  Print this help\n");
+}
+
+int main(int argc, const char** argv)
+{
+    static const char* const h264Extensions[] = { "h264", "264", "avc", "jsv", "jvt", "26l", nullptr };
+    static const char* const h265Extensions[] = { "h265", "265", "hevc", "bit", "bin", nullptr };
+
+    VkVideoCodecOperationFlagBitsKHR forcedCodec = VK_VIDEO_CODEC_OPERATION_NONE_KHR;
+    uint32_t iterations = 5;
+    size_t packetSize = 1024 * 1024;
+    const char* jsonFileName = nullptr;
+    std::vector<std::string> fileNames;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--codec") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            if ((strcmp(argv[i], "h264") == 0) || (strcmp(argv[i], "avc") == 0)) {
+                forcedCodec = VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR;
+            } else if ((strcmp(argv[i], "h265") == 0) || (strcmp(argv[i], "hevc") == 0)) {
+                forcedCodec = VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR;
+            } else {
+                fprintf(stderr, "Invalid codec: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--iterations") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%u", &iterations) != 1) || (iterations == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--packetSize") == 0) {
+            unsigned long long size = 0;
+            if ((++i >= argc) || (sscanf(argv[i], "%llu", &size) != 1) || (size == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            packetSize = (size_t)size;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            jsonFileName = argv[i];
+        } else if (strcmp(argv[i], "--help") == 0) {
+            PrintHelp();
+            return 0;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            PrintHelp();
+            return -1;
+        } else {
+            fileNames.push_back(argv[i]);
+        }
+    }
+
+    if (fileNames.empty()) {
+        PrintHelp();
+        return -1;
+    }
+
+    static const VkExtensionProperties h264StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_EXTENSION_NAME,
+                                                                   VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_SPEC_VERSION };
+    static const VkExtensionProperties h265StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_EXTENSION_NAME,
+                                                                   VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_SPEC_VERSION };
+
+    int exitCode = 0;
+    uint64_t totalBytes = 0;
+    double totalSeconds = 0.0;
+    std::string jsonStreams;
+    for (const std::string& fileName : fileNames) {
+
+        VkVideoCodecOperationFlagBitsKHR codec = forcedCodec;
+        if (codec == VK_VIDEO_CODEC_OPERATION_NONE_KHR) {
+            codec = HasExtension(fileName, h265Extensions) ? VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR :
+                    HasExtension(fileName, h264Extensions) ? VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR :
+                                                             VK_VIDEO_CODEC_OPERATION_NONE_KHR;
+        }
+        if (codec == VK_VIDEO_CODEC_OPERATION_NONE_KHR) {
+            fprintf(stderr, "%s: unknown codec, use --codec\n", fileName.c_str());
+            exitCode = -1;
+            continue;
+        }
+
+        std::vector<uint8_t> data;
+        if (!ReadFile(fileName.c_str(), data)) {
+            fprintf(stderr, "%s: can't read the stream\n", fileName.c_str());
+            exitCode = -1;
+            continue;
+        }
+        const uint64_t numNalUnits = CountNalUnits(data);
+
+        BenchDecodeClient client;
+        double bestSeconds = 0.0;
+        bool parseError = false;
+        for (uint32_t iteration = 0; (iteration < iterations) && !parseError; iteration++) {
+
+            VkParserInitDecodeParameters initParameters;
+            memset(&initParameters, 0, sizeof(initParameters));
+            initParameters.interfaceVersion = NV_VULKAN_VIDEO_PARSER_API_VERSION;
+            initParameters.pClient = &client;
+            initParameters.defaultMinBufferSize = 2 * 1024 * 1024;
+            initParameters.bufferOffsetAlignment = 256;
+            initParameters.bufferSizeAlignment = 256;
+            initParameters.referenceClockRate = 0;
+            initParameters.errorThreshold = 0;
+            initParameters.outOfBandPictureParameters = true;
+
+            VkSharedBaseObj<VulkanVideoDecodeParser> parser;
+            const VkExtensionProperties* pStdExtensionVersion =
+                (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) ? &h264StdExtensionVersion :
+                                                                          &h265StdExtensionVersion;
+            VkResult result = CreateVulkanVideoDecodeParser(codec, pStdExtensionVersion, &BenchParserLog, 0,
+                                                            &initParameters, parser);
+            if (result == VK_SUCCESS) {
+                result = parser->Initialize(&initParameters);
+            }
+            if (result != VK_SUCCESS) {
+                fprintf(stderr, "%s: can't create the parser (%d)\n", fileName.c_str(), result);
+                parseError = true;
+                break;
+            }
+
+            client.ResetCounters();
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t offset = 0; offset < data.size(); offset += packetSize) {
+                VkParserBitstreamPacket packet;
+                memset(&packet, 0, sizeof(packet));
+                packet.pByteStream = data.data() + offset;
+                packet.nDataLength = std::min(packetSize, data.size() - offset);
+                packet.bEOS = ((offset + packet.nDataLength) >= data.size());
+                size_t parsedBytes = 0;
+                if (!parser->ParseByteStream(&packet, &parsedBytes)) {
+                    fprintf(stderr, "%s: parse error at byte %zu\n", fileName.c_str(), offset);
+                    parseError = true;
+                    break;
+                }
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if ((iteration == 0) || (seconds < bestSeconds)) {
+                bestSeconds = seconds;
+            }
+        }
+        if (parseError) {
+            exitCode = -1;
+            continue;
+        }
+
+        const double mbPerSecond = (bestSeconds > 0.0) ? ((double)data.size() / (1024.0 * 1024.0) / bestSeconds) : 0.0;
+        const double nalPerSecond = (bestSeconds > 0.0) ? ((double)numNalUnits / bestSeconds) : 0.0;
+        const double nsPerSlice = (client.GetNumSlices() > 0) ? (bestSeconds * 1.0e9 / client.GetNumSlices()) : 0.0;
+        printf("%s: %s, %zu bytes, %llu NAL units, %llu sequences, %llu pictures, %llu slices\n",
+               fileName.c_str(), (codec == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) ? "H.264" : "H.265",
+               data.size(), (unsigned long long)numNalUnits, (unsigned long long)client.GetNumSequences(),
+               (unsigned long long)client.GetNumPictures(), (unsigned long long)client.GetNumSlices());
+        printf("\t%10.2f MB/s %12.0f NAL/s %10.0f ns per slice, best of %u in %.3f ms\n",
+               mbPerSecond, nalPerSecond, nsPerSlice, iterations, bestSeconds * 1000.0);
+
+        if (jsonFileName != nullptr) {
+            // The names are paths of the command line, only the quotes and the backslashes need escaping
+            std::string escapedName;
+            for (const char c : fileName) {
+                if ((c == '"') || (c == '\\')) {
+                    escapedName += '\\';
+                }
+                escapedName += c;
+            }
+            std::vector<char> jsonStream(escapedName.size() + 384);
+            snprintf(jsonStream.data(), jsonStream.size(),
+                     "%s\n    { \"stream\": \"%s\", \"bytes\": %zu, \"nalUnits\": %llu, \"pictures\": %llu, "
+                     "\"slices\": %llu, \"seconds\": %.9f, \"mbPerSecond\": %.3f, \"picturesPerSecond\": %.3f, "
+                     "\"nsPerSlice\": %.1f }",
+                     jsonStreams.empty() ? "" : ",", escapedName.c_str(), data.size(), (unsigned long long)numNalUnits,
+                     (unsigned long long)client.GetNumPictures(), (unsigned long long)client.GetNumSlices(),
+                     bestSeconds, mbPerSecond,
+                     (bestSeconds > 0.0) ? ((double)client.GetNumPictures() / bestSeconds) : 0.0, nsPerSlice);
+            jsonStreams += jsonStream.data();
+        }
+
+        totalBytes += data.size();
+        totalSeconds += bestSeconds;
+    }
+
+    if ((fileNames.size() > 1) && (totalSeconds > 0.0)) {
+        printf("Total: %llu bytes, %.2f MB/s\n", (unsigned long long)totalBytes,
+               (double)totalBytes / (1024.0 * 1024.0) / totalSeconds);
+    }
+
+    if (jsonFileName != nullptr) {
+        FILE* jsonFile = fopen(jsonFileName, "w");
+        if (jsonFile == nullptr) {
+            fprintf(stderr, "Can't open %s for writing\n", jsonFileName);
+            return -1;
+        }
+        fprintf(jsonFile, "{\n  \"iterations\": %u,\n  \"packetSize\": %zu,\n  \"streams\": [%s\n  ]\n}\n",
+                iterations, packetSize, jsonStreams.c_str());
+        fclose(jsonFile);
+    }
+
+    return exitCode;
+}
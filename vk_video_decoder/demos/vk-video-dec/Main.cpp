@@ -16,22 +16,890 @@
  */
 
 #include <assert.h>
+#include <algorithm>
 #include <string>
 #include <vector>
+#include <deque>
+#include <chrono>
 #include <cstring>
 #include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <functional>
+#include <memory>
+#if defined(__linux) || defined(__linux__) || defined(linux)
+#include <sys/resource.h>
+#endif
 
 #include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanDeviceContextManager.h"
 #include "VkCodecUtils/ProgramConfig.h"
 #include "VkCodecUtils/VulkanVideoProcessor.h"
 #include "VkCodecUtils/VulkanDecoderFrameProcessor.h"
+#include "VkCodecUtils/VulkanVideoRenderQueue.h"
+#include "VkCodecUtils/VulkanMosaicFrame.h"
+#include "VkCodecUtils/VulkanFrameServer.h"
+#include "VkCodecUtils/VulkanDecodedFrameFanOut.h"
+#include "VkCodecUtils/VulkanThumbnailExtractor.h"
+#include "VkCodecUtils/VkParserExecutor.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VkFrameLatency.h"
+#include "VkCodecUtils/VkMetrics.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
+#include "VkCodecUtils/VulkanVideoSessionPool.h"
+#include "VkCodecUtils/VkCapacityBenchmark.h"
 #include "VkShell/Shell.h"
 
+// The peak resident set size of the process in MB, 0 if unknown on the platform.
+static double GetPeakResidentMemoryMB()
+{
+#if defined(__linux) || defined(__linux__) || defined(linux)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss / 1024.0; // in KB
+    }
+#endif
+    return 0.0;
+}
+
+struct DecodeStreamStats {
+    uint64_t numFrames;
+    size_t   maxFramesInFlight;
+    double   wallTimeMs;
+    double   gpuTimeMs;
+};
+
+// Decodes as fast as the device allows, without the presentation: up to decodeAheadDepth frames are kept in flight
+// and each frame is released as soon as the device is done decoding it, in any order.
+struct DecodeStreamState {
+    VulkanVideoProcessor*                 pVideoProcessor;
+    size_t                                decodeAheadDepth;
+    std::deque<VulkanDecodedFrame>        framesInFlight;
+    bool                                  endOfStream;
+    DecodeStreamStats*                    pStats;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+static void BeginDecodeStream(DecodeStreamState& state, VulkanVideoProcessor* pVideoProcessor,
+                              size_t decodeAheadDepth, DecodeStreamStats& stats)
+{
+    state.pVideoProcessor = pVideoProcessor;
+    state.decodeAheadDepth = decodeAheadDepth;
+    state.framesInFlight.clear();
+    state.endOfStream = false;
+    state.pStats = &stats;
+    stats.numFrames = 0;
+    stats.maxFramesInFlight = 0;
+    stats.wallTimeMs = 0.0;
+    stats.gpuTimeMs = 0.0;
+    state.startTime = std::chrono::steady_clock::now();
+}
+
+// Decodes up to the depth and releases the frames complete, returns false once the stream is done. At the depth with
+// no frame complete, blocks on the oldest one if waitForFrame, else returns for the other streams to run meanwhile.
+static bool DecodeStreamStep(DecodeStreamState& state, bool waitForFrame)
+{
+    VulkanVideoProcessor* pVideoProcessor = state.pVideoProcessor;
+    std::deque<VulkanDecodedFrame>& framesInFlight = state.framesInFlight;
+    DecodeStreamStats& stats = *state.pStats;
+
+    if (state.endOfStream && framesInFlight.empty()) {
+        stats.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - state.startTime).count();
+        stats.gpuTimeMs = pVideoProcessor->GetDecodeGpuTimeMs();
+        return false;
+    }
+
+    while (!state.endOfStream && (framesInFlight.size() < state.decodeAheadDepth)) {
+        VulkanDecodedFrame frame;
+        const int32_t ret = pVideoProcessor->GetNextFrame(&frame, &state.endOfStream);
+        // The last frame of maxFrameCount comes with -1
+        if (frame.pictureIndex != -1) {
+            framesInFlight.push_back(frame);
+            stats.numFrames++;
+        }
+        if (ret < 0) {
+            state.endOfStream = true;
+        }
+    }
+    stats.maxFramesInFlight = std::max(stats.maxFramesInFlight, framesInFlight.size());
+
+    bool released = false;
+    for (std::deque<VulkanDecodedFrame>::iterator it = framesInFlight.begin(); it != framesInFlight.end(); ) {
+        if ((it->frameCompleteFence == VK_NULL_HANDLE) || pVideoProcessor->IsFrameComplete(&(*it))) {
+            pVideoProcessor->ReleaseFrame(&(*it));
+            it = framesInFlight.erase(it);
+            released = true;
+        } else {
+            ++it;
+        }
+    }
+
+    // At the depth, or draining at the end, block on the oldest frame
+    if (!released && !framesInFlight.empty() && (state.endOfStream || (framesInFlight.size() >= state.decodeAheadDepth))) {
+        if (!waitForFrame) {
+            std::this_thread::yield();
+            return true;
+        }
+        pVideoProcessor->WaitForFrameCompletion(&framesInFlight.front());
+        pVideoProcessor->ReleaseFrame(&framesInFlight.front());
+        framesInFlight.pop_front();
+    }
+    return true;
+}
+
+static void DecodeStream(VulkanVideoProcessor* pVideoProcessor, size_t decodeAheadDepth, DecodeStreamStats& stats)
+{
+    DecodeStreamState state;
+    BeginDecodeStream(state, pVideoProcessor, decodeAheadDepth, stats);
+    while (DecodeStreamStep(state, true)) {
+    }
+}
+
+static int RunDecodeBenchmark(VulkanVideoProcessor* pVideoProcessor, const ProgramConfig& programConfig)
+{
+    const size_t decodeAheadDepth = (size_t)std::max(programConfig.decodeAheadDepth, 1);
+    const std::clock_t startCpuTime = std::clock();
+
+    DecodeStreamStats stats;
+    DecodeStream(pVideoProcessor, decodeAheadDepth, stats);
+
+    const double cpuTimeMs = 1000.0 * (double)(std::clock() - startCpuTime) / CLOCKS_PER_SEC;
+
+    printf("Decode benchmark: %llu frames in %.3f s, decode-ahead depth %zu (max in flight %zu)\n",
+           (unsigned long long)stats.numFrames, stats.wallTimeMs / 1000.0, decodeAheadDepth, stats.maxFramesInFlight);
+    if ((stats.numFrames == 0) || (stats.wallTimeMs <= 0.0)) {
+        return -1;
+    }
+    printf("\tThroughput:         %10.2f fps\n", (1000.0 * stats.numFrames) / stats.wallTimeMs);
+    // The decode time is summed over the queues, it can exceed 100% with parallel queues
+    printf("\tGPU busy:           %10.1f %%\n", (100.0 * stats.gpuTimeMs) / stats.wallTimeMs);
+    printf("\tCPU time per frame: %10.3f ms\n", cpuTimeMs / stats.numFrames);
+    printf("\tPeak host memory:   %10.1f MB\n", GetPeakResidentMemoryMB());
+    return 0;
+}
+
+// Decodes the pictures of the capture of --replayDecode without the parser, for the throughput of the decoder alone.
+// The capture is read before the timing starts.
+static int RunDecodeReplay(VulkanVideoProcessor* pVideoProcessor, const ProgramConfig& programConfig)
+{
+    VkSharedBaseObj<VkVideoDecodeReplay> decodeReplay;
+    if (VkVideoDecodeReplay::Create(programConfig.decodeReplayFileName.c_str(), decodeReplay) != VK_SUCCESS) {
+        return -1;
+    }
+
+    const std::clock_t startCpuTime = std::clock();
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    const int64_t numPictures = pVideoProcessor->ReplayDecodeCapture(decodeReplay);
+
+    const double wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    const double cpuTimeMs = 1000.0 * (double)(std::clock() - startCpuTime) / CLOCKS_PER_SEC;
+
+    printf("Decode replay: %lld of %llu pictures in %.3f s\n", (long long)numPictures,
+           (unsigned long long)decodeReplay->GetNumPictures(), wallTimeMs / 1000.0);
+    if ((numPictures <= 0) || (wallTimeMs <= 0.0)) {
+        return -1;
+    }
+    printf("\tThroughput:           %10.2f fps\n", (1000.0 * numPictures) / wallTimeMs);
+    printf("\tBitstream:            %10.3f MB/s\n",
+           (double)decodeReplay->GetBitstreamBytes() / (1000.0 * wallTimeMs));
+    printf("\tGPU busy:             %10.1f %%\n", (100.0 * pVideoProcessor->GetDecodeGpuTimeMs()) / wallTimeMs);
+    printf("\tCPU time per picture: %10.3f ms\n", cpuTimeMs / numPictures);
+    printf("\tPeak host memory:     %10.1f MB\n", GetPeakResidentMemoryMB());
+    return 0;
+}
+
+// Publishes the decoded frames on the Unix socket of --frameServer, to the consumers in other processes. The decode
+// starts with the first client, each client holding at most maxFramesPerClient frames at a time.
+static int RunFrameServer(const VulkanDeviceContext* vkDevCtx, VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& videoQueue,
+                          const ProgramConfig& programConfig)
+{
+    const uint32_t maxFramesPerClient = 2;
+    VkSharedBaseObj<VulkanFrameServer> frameServer;
+    VkResult result = VulkanFrameServer::Create(vkDevCtx, videoQueue, programConfig.frameServerSocket.c_str(),
+                                                maxFramesPerClient, frameServer);
+    if (result != VK_SUCCESS) {
+        std::cerr << "Failed to start the frame server on " << programConfig.frameServerSocket << std::endl;
+        return -1;
+    }
+
+    std::cout << "Publishing the decoded frames on " << programConfig.frameServerSocket << std::endl;
+    const int32_t ret = frameServer->Run(true);
+    frameServer->PrintStats();
+    return ret;
+}
+
+// Fans the decoded frames out to the outputs of --fanOut, each consumed on its own thread. The consumers here only
+// wait for their outputs and release them, standing in for the display, the encoder or the analytics of a pipeline.
+static int RunFanOut(const VulkanDeviceContext* vkDevCtx, VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>>& videoQueue,
+                     const ProgramConfig& programConfig)
+{
+    std::vector<VulkanDecodedFrameFanOut::OutputConfig> outputs;
+    for (const ProgramConfig::FanOutOutput& fanOutOutput : programConfig.fanOutOutputs) {
+        outputs.push_back(VulkanDecodedFrameFanOut::OutputConfig { fanOutOutput.format, fanOutOutput.extent });
+    }
+
+    const uint32_t maxFramesInFlight = std::max<uint32_t>(programConfig.decoderQueueSize, 2);
+    VkSharedBaseObj<VulkanDecodedFrameFanOut> fanOut;
+    VkResult result = VulkanDecodedFrameFanOut::Create(vkDevCtx, videoQueue, outputs, maxFramesInFlight, fanOut);
+    if (result != VK_SUCCESS) {
+        std::cerr << "Failed to create the fan-out of the decoded frames" << std::endl;
+        return -1;
+    }
+
+    std::vector<std::thread> consumerThreads;
+    for (uint32_t output = 0; output < fanOut->GetNumOutputs(); output++) {
+        consumerThreads.push_back(std::thread([vkDevCtx, &fanOut, output]() {
+            const uint64_t frameTimeout = 100ULL * 1000 * 1000 * 1000; // 100 seconds
+            VulkanDecodedFrameFanOut::OutputFrame outputFrame;
+            while (fanOut->AcquireFrame(output, outputFrame)) {
+                const VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, 0, 1,
+                                                       &outputFrame.completeSemaphore, &outputFrame.completeValue };
+                vkDevCtx->WaitSemaphores(*vkDevCtx, &waitInfo, frameTimeout);
+                fanOut->ReleaseFrame(output, outputFrame);
+            }
+        }));
+    }
+
+    const int32_t ret = fanOut->Run();
+    for (std::thread& consumerThread : consumerThreads) {
+        consumerThread.join();
+    }
+    fanOut->PrintStats();
+    return ret;
+}
+
+// Writes the thumbnails of --thumbnails, a file each or appended to the strip: RGBA as PAM images, NV12 raw. The
+// RGBA strip is one image of the thumbnails stacked vertically, written by Close().
+class ThumbnailWriter {
+public:
+    ThumbnailWriter(const ProgramConfig& programConfig, size_t thumbnailSize)
+        : m_fileNamePrefix(programConfig.thumbnailFileName)
+        , m_isRgba(programConfig.thumbnailFormat == VK_FORMAT_R8G8B8A8_UNORM)
+        , m_strip(programConfig.thumbnailStrip)
+        , m_extent(programConfig.thumbnailExtent)
+        , m_thumbnailSize(thumbnailSize)
+        , m_numThumbnails(0)
+        , m_stripFile(nullptr)
+        , m_stripData()
+    {
+    }
+
+    bool Write(const uint8_t* pThumbnail)
+    {
+        const uint32_t thumbnailIndex = m_numThumbnails++;
+        if (m_strip && m_isRgba) {
+            m_stripData.insert(m_stripData.end(), pThumbnail, pThumbnail + m_thumbnailSize);
+            return true;
+        }
+
+        FILE* file = m_stripFile;
+        if (file == nullptr) {
+            char fileName[32];
+            if (m_strip) {
+                snprintf(fileName, sizeof(fileName), ".nv12");
+            } else {
+                snprintf(fileName, sizeof(fileName), "_%05u.%s", thumbnailIndex, m_isRgba ? "pam" : "nv12");
+            }
+            file = fopen((m_fileNamePrefix + fileName).c_str(), "wb");
+            if (file == nullptr) {
+                std::cerr << "Unable to create the thumbnail file " << m_fileNamePrefix << fileName << std::endl;
+                return false;
+            }
+        }
+        if (m_isRgba) {
+            WritePamHeader(file, m_extent.height);
+        }
+        const bool written = (fwrite(pThumbnail, 1, m_thumbnailSize, file) == m_thumbnailSize);
+        if (m_strip) {
+            m_stripFile = file;
+        } else {
+            fclose(file);
+        }
+        return written;
+    }
+
+    bool Close()
+    {
+        bool written = true;
+        if (m_stripFile != nullptr) {
+            fclose(m_stripFile);
+            m_stripFile = nullptr;
+        }
+        if (m_strip && m_isRgba && (m_numThumbnails > 0)) {
+            FILE* file = fopen((m_fileNamePrefix + ".pam").c_str(), "wb");
+            if (file == nullptr) {
+                std::cerr << "Unable to create the thumbnail strip " << m_fileNamePrefix << ".pam" << std::endl;
+                return false;
+            }
+            WritePamHeader(file, m_extent.height * m_numThumbnails);
+            written = (fwrite(m_stripData.data(), 1, m_stripData.size(), file) == m_stripData.size());
+            fclose(file);
+        }
+        return written;
+    }
+
+    uint32_t GetNumThumbnails() const { return m_numThumbnails; }
+
+private:
+    void WritePamHeader(FILE* file, uint32_t height) const
+    {
+        fprintf(file, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                m_extent.width, height);
+    }
+
+    const std::string    m_fileNamePrefix;
+    const bool           m_isRgba;
+    const bool           m_strip;
+    const VkExtent2D     m_extent;
+    const size_t         m_thumbnailSize;
+    uint32_t             m_numThumbnails;
+    FILE*                m_stripFile;  // of the NV12 strip, appended to
+    std::vector<uint8_t> m_stripData;  // of the RGBA strip, written at the end
+};
+
+// Takes a thumbnail every thumbnailIntervalSeconds of the stream, from the random access point at or before its
+// time. Only these pictures are decoded: with the index of an elementary stream, the decoding seeks from one to the
+// next, else the key frames of the stream are decoded in turn, and the first at or past each time is kept. The
+// thumbnails are scaled on the compute queue, only they are read back.
+static int RunThumbnails(const VulkanDeviceContext* vkDevCtx, VulkanVideoProcessor* pVideoProcessor,
+                         const ProgramConfig& programConfig)
+{
+    VkSharedBaseObj<VulkanThumbnailExtractor> thumbnailExtractor;
+    VkResult result = VulkanThumbnailExtractor::Create(vkDevCtx, programConfig.thumbnailFormat,
+                                                       programConfig.thumbnailExtent, thumbnailExtractor);
+    if (result != VK_SUCCESS) {
+        std::cerr << "Failed to create the thumbnail extractor" << std::endl;
+        return -1;
+    }
+
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::vector<uint8_t> thumbnail(thumbnailExtractor->GetThumbnailSize());
+    ThumbnailWriter thumbnailWriter(programConfig, thumbnail.size());
+    uint32_t numFramesDecoded = 0;
+
+    // Decodes the next frame into the thumbnail, false at the end of the stream
+    auto ExtractNextFrame = [&](uint64_t& timestamp) -> bool {
+        VulkanDecodedFrame frame;
+        bool endOfStream = false;
+        pVideoProcessor->GetNextFrame(&frame, &endOfStream);
+        if (frame.pictureIndex == -1) {
+            return false;
+        }
+        numFramesDecoded++;
+        const VkResult extractResult = thumbnailExtractor->Extract(frame, thumbnail.data());
+        timestamp = frame.timestamp;
+        pVideoProcessor->ReleaseFrame(&frame);
+        return (extractResult == VK_SUCCESS);
+    };
+
+    bool written = true;
+    uint64_t timestamp = 0;
+    if (pVideoProcessor->FindRandomAccessFrame(0) >= 0) {
+        // The random access point of each time, once: the times between two of them repeat the thumbnail
+        int64_t lastRandomAccessFrame = -1;
+        double frameRate = 0.0;
+        for (uint32_t thumbnailIndex = 0; written; thumbnailIndex++) {
+            const uint32_t targetFrame = (uint32_t)(thumbnailIndex * programConfig.thumbnailIntervalSeconds * frameRate + 0.5);
+            const int64_t randomAccessFrame = pVideoProcessor->FindRandomAccessFrame(targetFrame);
+            if (randomAccessFrame < 0) {
+                break;
+            }
+            if (randomAccessFrame != lastRandomAccessFrame) {
+                if ((lastRandomAccessFrame >= 0) && (pVideoProcessor->SeekToFrame(targetFrame) < 0)) {
+                    break;
+                }
+                if (!ExtractNextFrame(timestamp)) {
+                    break;
+                }
+                lastRandomAccessFrame = randomAccessFrame;
+                // Known once the first frame is decoded
+                frameRate = pVideoProcessor->GetFrameRate();
+            }
+            written = thumbnailWriter.Write(thumbnail.data());
+        }
+    } else {
+        // Without the timestamps of a container, every key frame
+        double nextTime = 0.0;
+        while (written && ExtractNextFrame(timestamp)) {
+            const double frameTime = timestamp / 10000000.0; // in 100 ns units
+            if ((timestamp == 0) || (frameTime >= nextTime)) {
+                written = thumbnailWriter.Write(thumbnail.data());
+                nextTime = frameTime + programConfig.thumbnailIntervalSeconds;
+            }
+        }
+    }
+    written = thumbnailWriter.Close() && written;
+
+    const double wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    const uint32_t numThumbnails = thumbnailWriter.GetNumThumbnails();
+    printf("Thumbnails: %u of %ux%u from %u decoded frames in %.3f s, %zu bytes read back each\n",
+           numThumbnails, programConfig.thumbnailExtent.width, programConfig.thumbnailExtent.height,
+           numFramesDecoded, wallTimeMs / 1000.0, thumbnail.size());
+    if (numThumbnails > 0) {
+        printf("\tTime per thumbnail: %10.3f ms\n", wallTimeMs / numThumbnails);
+    }
+    return (written && (numThumbnails > 0)) ? 0 : -1;
+}
+
+// The paths of the input list, one per line. The empty lines and the ones starting with '#' are skipped.
+static size_t ReadInputList(const std::string& inputListFileName, std::vector<std::string>& inputFileNames)
+{
+    std::ifstream inputListStream(inputListFileName, std::ifstream::in);
+    std::string line;
+    while (std::getline(inputListStream, line)) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if ((first == std::string::npos) || (line[first] == '#')) {
+            continue;
+        }
+        const size_t last = line.find_last_not_of(" \t\r");
+        inputFileNames.push_back(line.substr(first, last - first + 1));
+    }
+    return inputFileNames.size();
+}
+
+// Decodes the streams of the input list concurrently, each with its own processor and thread on the shared
+// device. The streams are spread round-robin over the decode queues, so that equal channels load each
+// hardware decoder evenly, and the throughput is reported per stream and for all of them.
+// With the device manager, each stream goes to the least loaded decode queue of all its devices instead.
+// With --streamWorkers, the streams are parsed and submitted in turns on that many workers instead of a thread each.
+// The configuration of one of the streams of the input list. A "live:" or "batch:" before the path sets its
+// priority class, the one of the command line otherwise.
+static void InitStreamConfig(ProgramConfig& streamConfig, const std::string& videoFileName, int queueId)
+{
+    static const std::string livePrefix("live:");
+    static const std::string batchPrefix("batch:");
+    streamConfig.videoFileName = videoFileName;
+    if (videoFileName.compare(0, livePrefix.size(), livePrefix) == 0) {
+        streamConfig.videoFileName = videoFileName.substr(livePrefix.size());
+        streamConfig.liveStream = true;
+    } else if (videoFileName.compare(0, batchPrefix.size(), batchPrefix) == 0) {
+        streamConfig.videoFileName = videoFileName.substr(batchPrefix.size());
+        streamConfig.liveStream = false;
+    }
+    streamConfig.queueId = queueId;
+    // The streams are only decoded, there is no output file or frame digests per stream
+    streamConfig.outputFileName.clear();
+    streamConfig.frameChecksum = 0;
+}
+
+// The decode queue of the next stream of a priority class, round-robin over the queues of the class
+static int SelectStreamQueue(const VulkanDeviceContext* vkDevCtx, bool liveStream, uint32_t streamsOfClass[2])
+{
+    const VulkanDeviceContext::VideoQueuePriority priority = liveStream ?
+            VulkanDeviceContext::VIDEO_QUEUE_PRIORITY_LIVE : VulkanDeviceContext::VIDEO_QUEUE_PRIORITY_BATCH;
+    int32_t firstQueue = 0;
+    int32_t numQueues = 0;
+    vkDevCtx->GetVideoQueueRange(VulkanDeviceContext::DECODE, priority, firstQueue, numQueues);
+    return firstQueue + (int)(streamsOfClass[priority]++ % (uint32_t)std::max(numQueues, 1));
+}
+
+// The decoders of the streams of the input list, each decoded on the render thread of its mosaic channel
+static int CreateMosaicChannels(const VulkanDeviceContext* vkDevCtx, const ProgramConfig& programConfig,
+                                std::vector<ProgramConfig>& streamConfigs,
+                                std::vector<VkSharedBaseObj<VulkanVideoProcessor>>& videoProcessors,
+                                std::vector<VkSharedBaseObj<VulkanVideoRenderQueue>>& channelQueues)
+{
+    std::vector<std::string> inputFileNames;
+    if (ReadInputList(programConfig.inputListFileName, inputFileNames) == 0) {
+        std::cerr << "No streams in the input list: " << programConfig.inputListFileName << std::endl;
+        return -1;
+    }
+
+    const uint32_t numStreams = (uint32_t)inputFileNames.size();
+    // The tiles show the newest frame of their stream, a shallow queue keeps the latency low
+    const uint32_t channelQueueDepth = (uint32_t)std::max(programConfig.renderQueueDepth, 2);
+    streamConfigs.assign(numStreams, programConfig);
+    videoProcessors.resize(numStreams);
+    channelQueues.resize(numStreams);
+    for (uint32_t stream = 0; stream < numStreams; stream++) {
+        // The decode queues are only known once the device is created
+        InitStreamConfig(streamConfigs[stream], inputFileNames[stream], 0);
+
+        VkResult result = VulkanVideoProcessor::Create(vkDevCtx, videoProcessors[stream]);
+        if (result != VK_SUCCESS) {
+            return -1;
+        }
+        VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>> decoderQueue(videoProcessors[stream]);
+        result = VulkanVideoRenderQueue::Create(decoderQueue, VulkanVideoRenderQueue::RENDER_NEWEST,
+                                                channelQueueDepth, channelQueues[stream]);
+        if (result != VK_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int RunMultiStreamDecode(const VulkanDeviceContext* vkDevCtx, VulkanDeviceContextManager* pDeviceManager,
+                                const ProgramConfig& programConfig)
+{
+    std::vector<std::string> inputFileNames;
+    if (ReadInputList(programConfig.inputListFileName, inputFileNames) == 0) {
+        std::cerr << "No streams in the input list: " << programConfig.inputListFileName << std::endl;
+        return -1;
+    }
+
+    const uint32_t numStreams = (uint32_t)inputFileNames.size();
+    const uint32_t numDevices = (pDeviceManager != nullptr) ? pDeviceManager->GetNumDevices() : 1;
+    int32_t numDecodeQueues = std::max(vkDevCtx->GetVideoDecodeNumQueues(), 1);
+    if (pDeviceManager != nullptr) {
+        numDecodeQueues = 0;
+        for (uint32_t device = 0; device < numDevices; device++) {
+            numDecodeQueues += (int32_t)pDeviceManager->GetNumQueues(VulkanDeviceContext::DECODE, device);
+        }
+    }
+    const size_t decodeAheadDepth = (size_t)std::max(programConfig.decodeAheadDepth, 1);
+
+    std::vector<ProgramConfig> streamConfigs(numStreams, programConfig);
+    std::vector<uint32_t> streamDevices(numStreams, 0);
+    std::vector<VkSharedBaseObj<VulkanVideoProcessor>> videoProcessors(numStreams);
+    uint32_t streamsOfClass[2] = { 0, 0 };
+    for (uint32_t stream = 0; stream < numStreams; stream++) {
+
+        ProgramConfig& streamConfig = streamConfigs[stream];
+        InitStreamConfig(streamConfig, inputFileNames[stream], 0);
+        streamConfig.queueId = SelectStreamQueue(vkDevCtx, streamConfig.liveStream, streamsOfClass);
+        if (programConfig.streamWorkers > 0) {
+            // The workers are pinned to the parser CPUs instead, the streams move between them
+            streamConfig.parserCpus.clear();
+        }
+
+        const VulkanDeviceContext* streamDevCtx = vkDevCtx;
+        if (pDeviceManager != nullptr) {
+            int32_t queueIndex = 0;
+            const VulkanDeviceContext::VideoQueuePriority priority = streamConfig.liveStream ?
+                    VulkanDeviceContext::VIDEO_QUEUE_PRIORITY_LIVE : VulkanDeviceContext::VIDEO_QUEUE_PRIORITY_BATCH;
+            if (pDeviceManager->AcquireStream(VulkanDeviceContext::DECODE, streamDevices[stream], queueIndex,
+                                              priority) != VK_SUCCESS) {
+                std::cerr << "No decode queue for the stream: " << streamConfig.videoFileName << std::endl;
+                return -1;
+            }
+            streamConfig.queueId = queueIndex;
+            streamDevCtx = pDeviceManager->GetDeviceContext(streamDevices[stream]);
+        }
+
+        VkResult result = VulkanVideoProcessor::Create(streamDevCtx, videoProcessors[stream]);
+        if (result != VK_SUCCESS) {
+            return -1;
+        }
+        if (videoProcessors[stream]->Initialize(streamDevCtx, streamConfig) < 0) {
+            std::cerr << "Failed to initialize the decoder of the stream: " << streamConfig.videoFileName << std::endl;
+            return -1;
+        }
+    }
+    if (pDeviceManager != nullptr) {
+        pDeviceManager->PrintDevices();
+    }
+
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    const std::clock_t startCpuTime = std::clock();
+
+    std::vector<DecodeStreamStats> streamStats(numStreams);
+    std::unique_ptr<VkParserExecutor> parserExecutor;
+    if (programConfig.streamWorkers > 0) {
+        parserExecutor.reset(new VkParserExecutor((size_t)programConfig.streamWorkers, programConfig.parserCpus));
+        std::vector<DecodeStreamState> streamStates(numStreams);
+        for (uint32_t stream = 0; stream < numStreams; stream++) {
+            BeginDecodeStream(streamStates[stream], (VulkanVideoProcessor*)videoProcessors[stream],
+                              decodeAheadDepth, streamStats[stream]);
+            parserExecutor->AddChannel(std::bind(DecodeStreamStep, std::ref(streamStates[stream]), false));
+        }
+        parserExecutor->Run();
+    } else {
+        std::vector<std::thread> streamThreads;
+        for (uint32_t stream = 0; stream < numStreams; stream++) {
+            streamThreads.push_back(std::thread(DecodeStream, (VulkanVideoProcessor*)videoProcessors[stream],
+                                                decodeAheadDepth, std::ref(streamStats[stream])));
+        }
+        for (std::thread& streamThread : streamThreads) {
+            streamThread.join();
+        }
+    }
+    if (pDeviceManager != nullptr) {
+        for (uint32_t stream = 0; stream < numStreams; stream++) {
+            pDeviceManager->ReleaseStream(VulkanDeviceContext::DECODE, streamDevices[stream], streamConfigs[stream].queueId);
+        }
+    }
+
+    const double wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    const double cpuTimeMs = 1000.0 * (double)(std::clock() - startCpuTime) / CLOCKS_PER_SEC;
+
+    printf("Multi-stream decode: %u streams on %d decode queues of %u devices, decode-ahead depth %zu\n",
+           numStreams, numDecodeQueues, numDevices, decodeAheadDepth);
+    uint64_t totalFrames = 0;
+    double totalGpuTimeMs = 0.0;
+    for (uint32_t stream = 0; stream < numStreams; stream++) {
+        const DecodeStreamStats& stats = streamStats[stream];
+        printf("\tStream %u, device %u, queue %d: %8llu frames, %10.2f fps, %s\n", stream,
+               streamDevices[stream], streamConfigs[stream].queueId,
+               (unsigned long long)stats.numFrames,
+               (stats.wallTimeMs > 0.0) ? (1000.0 * stats.numFrames) / stats.wallTimeMs : 0.0,
+               streamConfigs[stream].videoFileName.c_str());
+        totalFrames += stats.numFrames;
+        totalGpuTimeMs += stats.gpuTimeMs;
+    }
+    if ((totalFrames == 0) || (wallTimeMs <= 0.0)) {
+        return -1;
+    }
+    printf("\tAggregate throughput: %10.2f fps in %.3f s\n", (1000.0 * totalFrames) / wallTimeMs, wallTimeMs / 1000.0);
+    if (programConfig.gpuTimestamps) {
+        printf("\tGPU busy per queue:   %10.1f %%\n", (100.0 * totalGpuTimeMs) / (wallTimeMs * numDecodeQueues));
+    }
+    printf("\tCPU time per frame:   %10.3f ms\n", cpuTimeMs / totalFrames);
+    printf("\tPeak host memory:     %10.1f MB\n", GetPeakResidentMemoryMB());
+    if (parserExecutor) {
+        parserExecutor->PrintStats();
+    }
+    VulkanVideoSessionPool* pSessionPool = vkDevCtx->GetVideoSessionPool();
+    if (pSessionPool != nullptr) {
+        uint64_t numReusedSessions = 0;
+        uint64_t numCreatedSessions = 0;
+        pSessionPool->GetStats(numReusedSessions, numCreatedSessions);
+        printf("\tVideo sessions:       %10llu reused, %llu created\n",
+               (unsigned long long)numReusedSessions, (unsigned long long)numCreatedSessions);
+    }
+    return 0;
+}
+
+// Opens all the GPUs with the decode queues, each with its own memory arena, image pool and submit threads,
+// then decodes the streams of the input list over all of their decode queues.
+static int RunMultiGpuStreamDecode(const ProgramConfig& programConfig,
+                                   const char* const* reqInstanceLayers,
+                                   const char* const* reqInstanceExtensions,
+                                   const char* const* requestedDeviceExtensions,
+                                   const char* const* optDeviceExtensions,
+                                   VkQueueFlags requestVideoDecodeQueueMask,
+                                   VkQueueFlags requestVideoComputeQueueMask)
+{
+    VulkanDeviceContextManager deviceManager(reqInstanceLayers, reqInstanceExtensions,
+                                             requestedDeviceExtensions, optDeviceExtensions);
+    deviceManager.SetVideoQueuePriorities(programConfig.liveVideoQueues,
+                                          (VkQueueGlobalPriorityKHR)programConfig.queueGlobalPriority);
+    VkResult result = deviceManager.OpenAllDevices(programConfig.appName.c_str(),
+                                                   (VK_QUEUE_TRANSFER_BIT | requestVideoDecodeQueueMask |
+                                                    requestVideoComputeQueueMask),
+                                                   requestVideoDecodeQueueMask, VK_VIDEO_CODEC_OPERATION_NONE_KHR,
+                                                   0, VK_VIDEO_CODEC_OPERATION_NONE_KHR,
+                                                   // createTransferQueue, for the bitstream uploads or when the
+                                                   // decode queues lack it
+                                                   programConfig.deviceLocalBitstream,
+                                                   requestVideoComputeQueueMask != 0, // createComputeQueue
+                                                   programConfig.validate,
+                                                   programConfig.validateVerbose);
+    if (result != VK_SUCCESS) {
+        std::cerr << "No GPU with the decode queues!" << std::endl;
+        return -1;
+    }
+
+    for (uint32_t device = 0; device < deviceManager.GetNumDevices(); device++) {
+        VulkanDeviceContext* vkDevCtx = deviceManager.GetDeviceContext(device);
+
+        result = vkDevCtx->CreateDeviceMemoryArena((VkDeviceSize)programConfig.deviceMemoryArenaBlockSizeMB * 1024 * 1024);
+        vkDevCtx->SetHugePageStaging(programConfig.hugePageStaging);
+        if (result == VK_SUCCESS) {
+            result = vkDevCtx->InitPipelineCache(programConfig.pipelineCacheDir.c_str());
+        }
+        if (result == VK_SUCCESS) {
+            result = vkDevCtx->CreateVideoSharedImagePool(programConfig.sharedImagePoolMaxIdleImages);
+        }
+        if (result == VK_SUCCESS) {
+            result = vkDevCtx->CreateVideoSessionPool((uint32_t)std::max(programConfig.sessionPoolMaxIdleSessions, 0));
+        }
+        if ((result == VK_SUCCESS) && programConfig.decodeSubmitThread) {
+            result = vkDevCtx->CreateVideoDecodeSubmitThreads(programConfig.parserCpus);
+        }
+        if ((result == VK_SUCCESS) && (programConfig.decodeCommandBatchSize > 0)) {
+            result = vkDevCtx->CreateVideoDecodeCommandBatches((uint32_t)programConfig.decodeCommandBatchSize,
+                                                               (uint32_t)std::max(programConfig.decodeSubmitBatchLatencyMs, 0));
+        }
+        if (result != VK_SUCCESS) {
+            std::cerr << "Failed to set up the device " << device << " for decoding!" << std::endl;
+            return -1;
+        }
+    }
+
+    return RunMultiStreamDecode(deviceManager.GetDeviceContext(0), &deviceManager, programConfig);
+}
+
+struct PacedStreamStats {
+    uint64_t            numFrames;
+    double              wallTimeMs;
+    double              gpuTimeMs;
+    std::vector<double> frameLatenciesMs;
+};
+
+// Decodes the stream as a live source at the target rate would feed it: a frame is only decoded once due, with up
+// to decodeAheadDepth of them in flight. The latency of a frame is from when it was due to its decode complete,
+// seen by polling the frames in flight, so it includes the time it waited for the ones before it.
+static void DecodePacedStream(VulkanVideoProcessor* pVideoProcessor, size_t decodeAheadDepth, double targetFps,
+                              PacedStreamStats& stats)
+{
+    struct PacedFrame {
+        VulkanDecodedFrame                    frame;
+        std::chrono::steady_clock::time_point dueTime;
+    };
+    static const std::chrono::microseconds pollInterval(500);
+    const std::chrono::duration<double> frameInterval(1.0 / targetFps);
+
+    std::deque<PacedFrame> framesInFlight;
+    bool endOfStream = false;
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    stats.numFrames = 0;
+    while (!endOfStream || !framesInFlight.empty()) {
+        const std::chrono::steady_clock::time_point dueTime = startTime +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameInterval * (double)stats.numFrames);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!endOfStream && (framesInFlight.size() < decodeAheadDepth) && (now >= dueTime)) {
+            PacedFrame pacedFrame;
+            pacedFrame.dueTime = dueTime;
+            const int32_t ret = pVideoProcessor->GetNextFrame(&pacedFrame.frame, &endOfStream);
+            // The last frame of maxFrameCount comes with -1
+            if (pacedFrame.frame.pictureIndex != -1) {
+                framesInFlight.push_back(pacedFrame);
+                stats.numFrames++;
+            }
+            if (ret < 0) {
+                endOfStream = true;
+            }
+            continue;
+        }
+
+        bool released = false;
+        now = std::chrono::steady_clock::now();
+        for (std::deque<PacedFrame>::iterator it = framesInFlight.begin(); it != framesInFlight.end(); ) {
+            if ((it->frame.frameCompleteFence == VK_NULL_HANDLE) || pVideoProcessor->IsFrameComplete(&it->frame)) {
+                stats.frameLatenciesMs.push_back(std::chrono::duration<double, std::milli>(now - it->dueTime).count());
+                pVideoProcessor->ReleaseFrame(&it->frame);
+                it = framesInFlight.erase(it);
+                released = true;
+            } else {
+                ++it;
+            }
+        }
+        if (released) {
+            continue;
+        }
+        if (framesInFlight.empty()) {
+            std::this_thread::sleep_until(dueTime);
+        } else {
+            std::this_thread::sleep_for(pollInterval);
+        }
+    }
+    stats.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    stats.gpuTimeMs = pVideoProcessor->GetDecodeGpuTimeMs();
+}
+
+// Decodes the sessions of a step of the capacity benchmark concurrently on the device, each with its own processor
+// and thread. The sessions take the streams of the input list in turns, or all decode the stream of the command line.
+static void RunCapacityStep(const VulkanDeviceContext* vkDevCtx, const ProgramConfig& programConfig,
+                            const std::vector<std::string>& inputFileNames, double targetFps,
+                            VkCapacityBenchmark::Step& step)
+{
+    const uint32_t numSessions = step.numSessions;
+    const size_t decodeAheadDepth = (size_t)std::max(programConfig.decodeAheadDepth, 1);
+
+    std::vector<ProgramConfig> sessionConfigs(numSessions, programConfig);
+    std::vector<VkSharedBaseObj<VulkanVideoProcessor>> videoProcessors(numSessions);
+    uint32_t streamsOfClass[2] = { 0, 0 };
+    for (uint32_t session = 0; session < numSessions; session++) {
+        ProgramConfig& sessionConfig = sessionConfigs[session];
+        InitStreamConfig(sessionConfig, inputFileNames[session % inputFileNames.size()], 0);
+        sessionConfig.queueId = SelectStreamQueue(vkDevCtx, sessionConfig.liveStream, streamsOfClass);
+        if ((VulkanVideoProcessor::Create(vkDevCtx, videoProcessors[session]) != VK_SUCCESS) ||
+                (videoProcessors[session]->Initialize(vkDevCtx, sessionConfig) < 0)) {
+            std::cerr << "Failed to start the decode session " << session << " of the capacity step" << std::endl;
+            return;
+        }
+    }
+
+    std::vector<PacedStreamStats> sessionStats(numSessions);
+    std::vector<std::thread> sessionThreads;
+    for (uint32_t session = 0; session < numSessions; session++) {
+        sessionThreads.push_back(std::thread(DecodePacedStream, (VulkanVideoProcessor*)videoProcessors[session],
+                                             decodeAheadDepth, targetFps, std::ref(sessionStats[session])));
+    }
+    for (std::thread& sessionThread : sessionThreads) {
+        sessionThread.join();
+    }
+
+    // The video sessions are created with the first sequence, a session out of memory decodes no frame
+    step.sessionsStarted = true;
+    step.minSessionFps = targetFps * 1000.0;
+    double wallTimeMs = 0.0;
+    double gpuTimeMs = 0.0;
+    std::vector<double> frameLatenciesMs;
+    for (const PacedStreamStats& stats : sessionStats) {
+        if (stats.numFrames == 0) {
+            step.sessionsStarted = false;
+        }
+        step.numFrames += stats.numFrames;
+        step.minSessionFps = std::min(step.minSessionFps,
+                                      (stats.wallTimeMs > 0.0) ? (1000.0 * stats.numFrames) / stats.wallTimeMs : 0.0);
+        wallTimeMs = std::max(wallTimeMs, stats.wallTimeMs);
+        gpuTimeMs += stats.gpuTimeMs;
+        frameLatenciesMs.insert(frameLatenciesMs.end(), stats.frameLatenciesMs.begin(), stats.frameLatenciesMs.end());
+    }
+    step.p99LatencyMs = VkCapacityBenchmark::GetPercentile(frameLatenciesMs, 99.0);
+    // The decode time is summed over the queues, the sessions are spread evenly over them
+    if (programConfig.gpuTimestamps && (wallTimeMs > 0.0)) {
+        step.engineBusy = gpuTimeMs / (wallTimeMs * std::max(vkDevCtx->GetVideoDecodeNumQueues(), 1));
+    }
+}
+
+// Ramps the number of concurrent decode sessions on the device for the most that sustain the target frame rate
+// within the latency bound, see VkCapacityBenchmark.
+static int RunDecodeCapacityBenchmark(const VulkanDeviceContext* vkDevCtx, const ProgramConfig& programConfig)
+{
+    std::vector<std::string> inputFileNames;
+    if (!programConfig.inputListFileName.empty()) {
+        if (ReadInputList(programConfig.inputListFileName, inputFileNames) == 0) {
+            std::cerr << "No streams in the input list: " << programConfig.inputListFileName << std::endl;
+            return -1;
+        }
+    } else {
+        inputFileNames.push_back(programConfig.videoFileName);
+    }
+
+    VkCapacityBenchmark capacityBenchmark("decode", programConfig.capacityTargetFps,
+                                          programConfig.capacityMaxLatencyMs,
+                                          (uint32_t)std::max(programConfig.capacityMaxSessions, 1));
+    const double targetFps = capacityBenchmark.GetTargetFps();
+    const uint32_t numSessions = capacityBenchmark.Run([vkDevCtx, &programConfig, &inputFileNames, targetFps]
+                                                       (VkCapacityBenchmark::Step& step) {
+        RunCapacityStep(vkDevCtx, programConfig, inputFileNames, targetFps, step);
+    });
+    return (numSessions > 0) ? 0 : -1;
+}
+
 int main(int argc, const char **argv) {
 
     ProgramConfig programConfig(argv[0]);
     programConfig.ParseArgs(argc, argv);
 
+    // The queued console messages are printed once everything declared after it is torn down
+    VkLogSession logSession(programConfig.verbose);
+    // Written once everything declared after it is torn down
+    VkTraceSession traceSession(programConfig.traceFileName.c_str());
+    VkTrace::SetThreadName("Decoder main");
+    VkMetricsServer metricsServer((uint16_t)std::max(programConfig.metricsPort, 0));
+    VkMetricsFile metricsFile(programConfig.metricsFileName.c_str());
+    VulkanDeviceMemoryReport deviceMemoryReport(programConfig.deviceMemoryReport);
+    VulkanDeviceMemoryBudget::SetLimit((VkDeviceSize)std::max(programConfig.deviceMemoryBudgetMB, 0) * 1024 * 1024);
+
+    if (programConfig.benchmark || programConfig.capacityBenchmark) {
+        // The GPU busy time of the benchmark comes from the decode timestamps
+        programConfig.gpuTimestamps = true;
+    }
+    // The low latency presentation reports the latency of the frames from their demux
+    VkFrameLatencyReport latencyReport(programConfig.latencyReport || programConfig.lowLatencyDisplay);
+    if (programConfig.latencyReport) {
+        // The device points of the frames come from the decode timestamps
+        programConfig.gpuTimestamps = true;
+    }
+
     static const char* const requiredInstanceLayerExtensions[] = {
         "VK_LAYER_KHRONOS_validation",
         nullptr
@@ -68,6 +936,20 @@ int main(int argc, const char **argv) {
         VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME,
         VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
         VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+        VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+        VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME,
+        // The present waits of the low latency presentation, with --lowLatencyDisplay
+        VK_KHR_PRESENT_ID_EXTENSION_NAME,
+        VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+        // The admission control of the streams, see VulkanDeviceMemoryBudget
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        // The video queues above the ones of the other processes, with --queueGlobalPriority
+        VK_KHR_GLOBAL_PRIORITY_EXTENSION_NAME,
+        VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME,
+#if defined(__linux) || defined(__linux__) || defined(linux)
+        // The sync files of the exported frames, with --exportFrames
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+#endif
         nullptr
     };
 
@@ -124,6 +1006,13 @@ int main(int argc, const char **argv) {
             reqDeviceExtensions.data(),
             optinalDeviceExtension);
 
+    if (!programConfig.deviceCacheFileName.empty()) {
+        vkDevCtxt.SetFastStartup(programConfig.deviceCacheFileName.c_str());
+    }
+
+    vkDevCtxt.SetVideoQueuePriorities(programConfig.liveVideoQueues,
+                                      (VkQueueGlobalPriorityKHR)programConfig.queueGlobalPriority);
+
     VkResult result = vkDevCtxt.InitVulkanDevice(programConfig.appName.c_str(),
                                                  programConfig.verbose);
     if (result != VK_SUCCESS) {
@@ -138,7 +1027,8 @@ int main(int argc, const char **argv) {
     }
 
     const bool supportsDisplay = true;
-    const int32_t numDecodeQueues = ((programConfig.queueId != 0) ||
+    const bool multiStreamDecode = !programConfig.inputListFileName.empty();
+    const int32_t numDecodeQueues = ((programConfig.queueId != 0) || multiStreamDecode || programConfig.capacityBenchmark ||
                                      (programConfig.enableHwLoadBalancing != 0)) ?
 					 -1 : // all available HW decoders
 					  1;  // only one HW decoder instance
@@ -158,7 +1048,10 @@ int main(int argc, const char **argv) {
     }
 
     VkQueueFlags requestVideoComputeQueueMask = 0;
-    if (programConfig.enablePostProcessFilter != -1) {
+    if ((programConfig.enablePostProcessFilter != -1) || programConfig.gpuFrameOutput ||
+            programConfig.hostCachedFrameOutput || programConfig.autoFrameOutputConversion ||
+            !programConfig.fanOutOutputs.empty() || programConfig.frameAnalytics ||
+            (programConfig.thumbnailIntervalSeconds > 0.0)) {
         requestVideoComputeQueueMask = VK_QUEUE_COMPUTE_BIT;
     }
 
@@ -169,17 +1062,63 @@ int main(int argc, const char **argv) {
     }
 
     VkSharedBaseObj<VkVideoQueue<VulkanDecodedFrame>> videoQueue(vulkanVideoProcessor);
+    VkSharedBaseObj<VulkanVideoRenderQueue> renderQueue;
+    const bool adaptiveDecodeAhead = (programConfig.adaptiveDecodeAheadLatencyMs >= 0);
+    if ((programConfig.renderQueueDepth > 0) || adaptiveDecodeAhead) {
+        // The decode runs ahead of the presentation on its own thread. The adaptive depth is bound by the images
+        // in flight of the decoder, those are only allocated once the depth reaches them.
+        const int32_t renderQueueDepth = (programConfig.renderQueueDepth > 0) ? programConfig.renderQueueDepth :
+                                                                                programConfig.numDecodeImagesInFlight;
+        result = VulkanVideoRenderQueue::Create(videoQueue,
+                                                programConfig.renderNewest ? VulkanVideoRenderQueue::RENDER_NEWEST :
+                                                                             VulkanVideoRenderQueue::RENDER_IN_ORDER,
+                                                (uint32_t)std::max(renderQueueDepth, 2),
+                                                renderQueue);
+        if (result != VK_SUCCESS) {
+            return -1;
+        }
+        if (adaptiveDecodeAhead) {
+            renderQueue->EnableAdaptiveDepth(2, (double)programConfig.adaptiveDecodeAheadLatencyMs);
+        }
+        videoQueue = renderQueue;
+    }
+    // The streams of the input list presented as the tiles of one window
+    const bool mosaicPresent = multiStreamDecode && programConfig.mosaic && supportsDisplay &&
+                               !programConfig.noPresent && !programConfig.benchmark;
+    std::vector<ProgramConfig> streamConfigs;
+    std::vector<VkSharedBaseObj<VulkanVideoProcessor>> streamProcessors;
+    std::vector<VkSharedBaseObj<VulkanVideoRenderQueue>> channelQueues;
+    VkSharedBaseObj<VulkanMosaicFrame> mosaicFrame;
+
     VkSharedBaseObj<FrameProcessor> frameProcessor;
-    result = CreateDecoderFrameProcessor(&vkDevCtxt, videoQueue, frameProcessor);
+    if (mosaicPresent) {
+        if (CreateMosaicChannels(&vkDevCtxt, programConfig, streamConfigs, streamProcessors, channelQueues) != 0) {
+            return -1;
+        }
+        result = VulkanMosaicFrame::Create(&vkDevCtxt, channelQueues, mosaicFrame);
+        frameProcessor = mosaicFrame;
+    } else {
+        result = CreateDecoderFrameProcessor(&vkDevCtxt, videoQueue, frameProcessor);
+    }
     if (result != VK_SUCCESS) {
         return -1;
     }
 
-    if (supportsDisplay && !programConfig.noPresent) {
+    if (supportsDisplay && !programConfig.noPresent && !programConfig.benchmark &&
+            (!multiStreamDecode || mosaicPresent)) {
 
         const Shell::Configuration configuration(programConfig.appName.c_str(),
                                                  programConfig.backBufferCount,
-                                                 programConfig.directMode);
+                                                 programConfig.directMode,
+                                                 programConfig.initialWidth,
+                                                 programConfig.initialHeight,
+                                                 programConfig.initialBitdepth,
+                                                 programConfig.vsync,
+                                                 programConfig.verbose,
+                                                 programConfig.presentPacing && !programConfig.lowLatencyDisplay,
+                                                 programConfig.computePresent,
+                                                 programConfig.lowLatencyDisplay,
+                                                 programConfig.displayRefreshMilliHz);
         VkSharedBaseObj<Shell> displayShell;
         result = Shell::Create(&vkDevCtxt, configuration, frameProcessor, displayShell);
         if (result != VK_SUCCESS) {
@@ -208,18 +1147,66 @@ int main(int argc, const char **argv) {
 
         vkDevCtxt.CreateVulkanDevice(numDecodeQueues,
                                      programConfig.enableVideoEncoder ? 1 : 0, // num encode queues
-                                     false, //  createTransferQueue
+                                     programConfig.deviceLocalBitstream, //  createTransferQueue, for the bitstream uploads
                                      true,  // createGraphicsQueue
                                      true,  // createDisplayQueue
                                      requestVideoComputeQueueMask != 0  // createComputeQueue
                                      );
-        vulkanVideoProcessor->Initialize(&vkDevCtxt, programConfig);
+        vkDevCtxt.CreateDeviceMemoryArena((VkDeviceSize)programConfig.deviceMemoryArenaBlockSizeMB * 1024 * 1024);
+        vkDevCtxt.SetHugePageStaging(programConfig.hugePageStaging);
+        vkDevCtxt.InitPipelineCache(programConfig.pipelineCacheDir.c_str());
+        if (!programConfig.deviceCacheFileName.empty()) {
+            vkDevCtxt.PrintStartupTimes();
+        }
+        vkDevCtxt.CreateVideoSharedImagePool(programConfig.sharedImagePoolMaxIdleImages);
+        vkDevCtxt.CreateVideoSessionPool((uint32_t)std::max(programConfig.sessionPoolMaxIdleSessions, 0));
+        if (programConfig.decodeSubmitThread) {
+            vkDevCtxt.CreateVideoDecodeSubmitThreads(programConfig.parserCpus);
+        }
+        if (programConfig.decodeCommandBatchSize > 0) {
+            vkDevCtxt.CreateVideoDecodeCommandBatches((uint32_t)programConfig.decodeCommandBatchSize,
+                                                      (uint32_t)std::max(programConfig.decodeSubmitBatchLatencyMs, 0));
+        }
+        if (mosaicPresent) {
+            uint32_t streamsOfClass[2] = { 0, 0 };
+            for (uint32_t stream = 0; stream < (uint32_t)streamProcessors.size(); stream++) {
+                streamConfigs[stream].queueId = SelectStreamQueue(&vkDevCtxt, streamConfigs[stream].liveStream,
+                                                                  streamsOfClass);
+                if (streamProcessors[stream]->Initialize(&vkDevCtxt, streamConfigs[stream]) < 0) {
+                    std::cerr << "Failed to initialize the decoder of the stream: "
+                              << streamConfigs[stream].videoFileName << std::endl;
+                    return -1;
+                }
+            }
+        } else {
+            vulkanVideoProcessor->Initialize(&vkDevCtxt, programConfig);
+        }
 
 
         displayShell->RunLoop();
+        if (renderQueue) {
+            renderQueue->Deinit();
+            renderQueue->PrintStats();
+        }
+        if (mosaicFrame) {
+            for (VkSharedBaseObj<VulkanVideoRenderQueue>& channelQueue : channelQueues) {
+                channelQueue->Deinit();
+            }
+            mosaicFrame->PrintStats();
+        }
 
     } else {
 
+        if (multiStreamDecode && programConfig.enableAllGpus && !programConfig.capacityBenchmark) {
+            return RunMultiGpuStreamDecode(programConfig,
+                                           programConfig.validate ? requiredInstanceLayerExtensions : nullptr,
+                                           reqInstanceExtensions.data(),
+                                           reqDeviceExtensions.data(),
+                                           optinalDeviceExtension,
+                                           requestVideoDecodeQueueMask,
+                                           requestVideoComputeQueueMask);
+        }
+
         result = vkDevCtxt.InitPhysicalDevice((VK_QUEUE_TRANSFER_BIT | requestVideoDecodeQueueMask  |
                                                requestVideoComputeQueueMask |
                                                requestVideoEncodeQueueMask),
@@ -236,7 +1223,9 @@ int main(int argc, const char **argv) {
                                               // If no graphics or compute queue is requested, only video queues
                                               // will be created. Not all implementations support transfer on video queues,
                                               // so request a separate transfer queue for such implementations.
-                                              ((vkDevCtxt.GetVideoDecodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) == 0), //  createTransferQueue
+                                              // The transfer queue also uploads the bitstream with deviceLocalBitstream
+                                              (((vkDevCtxt.GetVideoDecodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) == 0) ||
+                                               programConfig.deviceLocalBitstream), //  createTransferQueue
                                               false, // createGraphicsQueue
                                               false, // createDisplayQueue
                                               requestVideoComputeQueueMask != 0   // createComputeQueue
@@ -247,8 +1236,87 @@ int main(int argc, const char **argv) {
             return -1;
         }
 
+        result = vkDevCtxt.CreateDeviceMemoryArena((VkDeviceSize)programConfig.deviceMemoryArenaBlockSizeMB * 1024 * 1024);
+        if (result != VK_SUCCESS) {
+
+            assert(!"Failed to create the device memory arena!");
+            return -1;
+        }
+        vkDevCtxt.SetHugePageStaging(programConfig.hugePageStaging);
+
+        result = vkDevCtxt.InitPipelineCache(programConfig.pipelineCacheDir.c_str());
+        if (result != VK_SUCCESS) {
+
+            assert(!"Failed to create the pipeline cache!");
+            return -1;
+        }
+        if (!programConfig.deviceCacheFileName.empty()) {
+            vkDevCtxt.PrintStartupTimes();
+        }
+
+        result = vkDevCtxt.CreateVideoSharedImagePool(programConfig.sharedImagePoolMaxIdleImages);
+        if (result != VK_SUCCESS) {
+
+            assert(!"Failed to create the video image pool!");
+            return -1;
+        }
+
+        result = vkDevCtxt.CreateVideoSessionPool((uint32_t)std::max(programConfig.sessionPoolMaxIdleSessions, 0));
+        if (result != VK_SUCCESS) {
+
+            assert(!"Failed to create the video session pool!");
+            return -1;
+        }
+
+        if (programConfig.decodeSubmitThread) {
+            result = vkDevCtxt.CreateVideoDecodeSubmitThreads(programConfig.parserCpus);
+            if (result != VK_SUCCESS) {
+
+                assert(!"Failed to create the decode submit threads!");
+                return -1;
+            }
+        }
+
+        if (programConfig.decodeCommandBatchSize > 0) {
+            result = vkDevCtxt.CreateVideoDecodeCommandBatches((uint32_t)programConfig.decodeCommandBatchSize,
+                                                               (uint32_t)std::max(programConfig.decodeSubmitBatchLatencyMs, 0));
+            if (result != VK_SUCCESS) {
+
+                assert(!"Failed to create the decode command batches!");
+                return -1;
+            }
+        }
+
+        if (programConfig.capacityBenchmark) {
+            return RunDecodeCapacityBenchmark(&vkDevCtxt, programConfig);
+        }
+
+        if (multiStreamDecode) {
+            return RunMultiStreamDecode(&vkDevCtxt, nullptr, programConfig);
+        }
+
         vulkanVideoProcessor->Initialize(&vkDevCtxt, programConfig);
 
+        if (!programConfig.decodeReplayFileName.empty()) {
+            return RunDecodeReplay(vulkanVideoProcessor, programConfig);
+        }
+
+        if (programConfig.benchmark) {
+            return RunDecodeBenchmark(vulkanVideoProcessor, programConfig);
+        }
+
+        if (programConfig.thumbnailIntervalSeconds > 0.0) {
+            return RunThumbnails(&vkDevCtxt, vulkanVideoProcessor, programConfig);
+        }
+
+        if (!programConfig.frameServerSocket.empty()) {
+            return RunFrameServer(&vkDevCtxt, videoQueue, programConfig);
+        }
+
+        if (!programConfig.fanOutOutputs.empty()) {
+            return RunFanOut(&vkDevCtxt, videoQueue, programConfig);
+        }
+
         const int numberOfFrames = programConfig.decoderQueueSize;
         int ret = frameProcessor->CreateFrameData(numberOfFrames);
         assert(ret == numberOfFrames);
@@ -260,6 +1328,10 @@ int main(int argc, const char **argv) {
             continueLoop = frameProcessor->OnFrame(0);
         } while (continueLoop);
         frameProcessor->DestroyFrameData();
+        if (renderQueue) {
+            renderQueue->Deinit();
+            renderQueue->PrintStats();
+        }
     }
 
     return 0;
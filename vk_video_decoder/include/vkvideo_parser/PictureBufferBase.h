@@ -58,6 +58,7 @@ public:
         int32_t ref = --m_refCount;
         if (ref == 0) {
             Reset();
+            OnAvailable();
         }
     }
 
@@ -88,6 +89,10 @@ public:
     {
         Reset();
     }
+
+protected:
+    // Called by the Release() that drops the last reference
+    virtual void OnAvailable() { }
 };
 
 #endif /* _PICTUREBUFFERBASE_H_ */
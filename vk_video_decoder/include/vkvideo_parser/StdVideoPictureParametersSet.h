@@ -17,8 +17,24 @@
 #ifndef _VKVIDEODECODER_STDVIDEOPICTUREPARAMETERSSET_H_
 #define _VKVIDEODECODER_STDVIDEOPICTUREPARAMETERSSET_H_
 
+#include <mutex>
+#include <new>
+#include <vector>
 #include "vulkan_interfaces.h"
 
+class StdVideoPictureParametersSet;
+
+// Takes back the parameter sets once released by the parser and its client, for their storage to be reused
+class StdVideoPictureParametersSetRecycler : public VkVideoRefCountBase
+{
+public:
+    // Destroys the parameter set and keeps or frees its storage
+    virtual void Recycle(StdVideoPictureParametersSet* pParameterSet) = 0;
+
+protected:
+    virtual ~StdVideoPictureParametersSetRecycler() {}
+};
+
 class StdVideoPictureParametersSet : public VkVideoRefCountBase
 {
 public:
@@ -73,11 +89,19 @@ public:
         uint32_t ret = --m_refCount;
         // Destroy the device if refcount reaches zero
         if (ret == 0) {
-            delete this;
+            if (m_recycler) {
+                // The recycler outlives the destruction of its parameter set
+                VkSharedBaseObj<StdVideoPictureParametersSetRecycler> recycler(m_recycler);
+                recycler->Recycle(this);
+            } else {
+                delete this;
+            }
         }
         return ret;
     }
 
+    void SetRecycler(const VkSharedBaseObj<StdVideoPictureParametersSetRecycler>& recycler) { m_recycler = recycler; }
+
     bool IsMyClassId(const char* refClassId) const {
         if (m_classId == refClassId) {
             return true;
@@ -89,8 +113,15 @@ public:
     ParameterType GetParameterType() const { return m_parameterType; }
     uint32_t GetUpdateSequenceCount() const { return m_updateSequenceCount; }
 
+    // Hash of the NAL unit the set was parsed from and of the set it was parsed against, 0 if not known.
+    // The parser uses it to recognize the repeats of a parameter set that is already in use.
+    uint64_t GetContentHash() const { return m_contentHash; }
+    void SetContentHash(uint64_t contentHash) { m_contentHash = contentHash; }
+
     // VkParserVideoPictureParameters
     virtual bool GetClientObject(VkSharedBaseObj<VkVideoRefCountBase>& clientObject) const = 0;
+    // Non ref-counted access to the same object, valid as long as the set is referenced
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const = 0;
 
 protected:
     StdVideoPictureParametersSet(StdType updateType,
@@ -100,12 +131,15 @@ protected:
         , m_refCount(0)
         , m_stdType(updateType)
         , m_parameterType(itemType)
+        , m_recycler()
         , m_updateSequenceCount((uint32_t)updateSequenceCount)
+        , m_contentHash()
         , m_parent() { }
 
     virtual ~StdVideoPictureParametersSet()
     {
         m_parent = nullptr;
+        m_recycler = nullptr;
     }
 
 private:
@@ -113,11 +147,121 @@ private:
     std::atomic<int32_t>                             m_refCount;
     StdType                                          m_stdType;
     ParameterType                                    m_parameterType;
+    VkSharedBaseObj<StdVideoPictureParametersSetRecycler> m_recycler; // of the pooled parameter sets
 protected:
     uint32_t                                         m_updateSequenceCount;
+    uint64_t                                         m_contentHash;
 public:
     VkSharedBaseObj<StdVideoPictureParametersSet>    m_parent;        // SPS or PPS parent
 
 };
 
+// The storage of the released parameter sets of one type, reused by the next ones of the parser, so that the
+// parameter sets repeated before each IDR picture or each picture are parsed without heap allocations. The
+// parameter sets are destroyed on release, with their client objects, and constructed again in their storage.
+// A parameter set still held by the client keeps the pool alive once the parser is gone.
+template<class ParameterSetType>
+class StdVideoPictureParametersSetPool : public StdVideoPictureParametersSetRecycler
+{
+public:
+    enum { DEFAULT_MAX_FREE_PARAMETER_SETS = 8 };
+
+    static VkResult Create(uint32_t maxFreeParameterSets,
+                           VkSharedBaseObj<StdVideoPictureParametersSetPool>& parameterSetPool)
+    {
+        VkSharedBaseObj<StdVideoPictureParametersSetPool> pool(new StdVideoPictureParametersSetPool(maxFreeParameterSets));
+        if (pool) {
+            parameterSetPool = pool;
+            return VK_SUCCESS;
+        }
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the pool if refcount reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // A new parameter set, in the storage of a released one if there is any
+    VkResult Acquire(uint64_t updateSequenceCount, VkSharedBaseObj<ParameterSetType>& parameterSet)
+    {
+        void* pStorage = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_freeStorage.empty()) {
+                pStorage = m_freeStorage.back();
+                m_freeStorage.pop_back();
+                m_numReused++;
+            } else {
+                m_numAllocated++;
+            }
+        }
+        if (pStorage == nullptr) {
+            pStorage = ::operator new(sizeof(ParameterSetType));
+        }
+
+        ParameterSetType* pParameterSet = new (pStorage) ParameterSetType(updateSequenceCount);
+        pParameterSet->SetRecycler(VkSharedBaseObj<StdVideoPictureParametersSetRecycler>(this));
+        parameterSet = pParameterSet;
+        return VK_SUCCESS;
+    }
+
+    virtual void Recycle(StdVideoPictureParametersSet* pBaseParameterSet)
+    {
+        ParameterSetType* pParameterSet = static_cast<ParameterSetType*>(pBaseParameterSet);
+        pParameterSet->~ParameterSetType();
+
+        void* pStorage = pParameterSet;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_freeStorage.size() < m_maxFreeParameterSets) {
+                m_freeStorage.push_back(pStorage);
+                return;
+            }
+        }
+        ::operator delete(pStorage);
+    }
+
+    // The parameter sets constructed in a new storage, and in the one of a released parameter set
+    uint64_t GetNumAllocated() const { return m_numAllocated; }
+    uint64_t GetNumReused() const { return m_numReused; }
+
+private:
+    StdVideoPictureParametersSetPool(uint32_t maxFreeParameterSets)
+        : m_refCount(0)
+        , m_maxFreeParameterSets(maxFreeParameterSets)
+        , m_mutex()
+        , m_freeStorage()
+        , m_numAllocated(0)
+        , m_numReused(0)
+    {
+        m_freeStorage.reserve(maxFreeParameterSets);
+    }
+
+    virtual ~StdVideoPictureParametersSetPool()
+    {
+        for (void* pStorage : m_freeStorage) {
+            ::operator delete(pStorage);
+        }
+    }
+
+private:
+    std::atomic<int32_t>  m_refCount;
+    const uint32_t        m_maxFreeParameterSets;
+    std::mutex            m_mutex;
+    std::vector<void*>    m_freeStorage;  // of the destroyed parameter sets
+    std::atomic<uint64_t> m_numAllocated;
+    std::atomic<uint64_t> m_numReused;
+};
+
 #endif /* _VKVIDEODECODER_STDVIDEOPICTUREPARAMETERSSET_H_ */
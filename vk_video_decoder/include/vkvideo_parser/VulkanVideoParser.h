@@ -52,6 +52,7 @@ public:
 };
 
 struct VkParserSourceDataPacket;
+struct VkParserDecodeFilter;
 class IVulkanVideoParser : public VkVideoRefCountBase {
 public:
     static VkResult Create(
@@ -65,6 +66,7 @@ public:
         uint32_t bufferSizeAlignment,
         uint64_t clockRate,
         uint32_t errorThreshold,
+        const VkParserDecodeFilter* pDecodeFilter, // optional, all the pictures are decoded without it
         VkSharedBaseObj<IVulkanVideoParser>& vulkanVideoParser);
 
     // doPartialParsing 0: parse entire packet, 1: parse until next decode/display event
@@ -91,6 +93,7 @@ VkResult vulkanCreateVideoParser(
     uint32_t bufferOffsetAlignment,
     uint32_t bufferSizeAlignment,
     uint64_t clockRate,
+    const VkParserDecodeFilter* pDecodeFilter,
     VkSharedBaseObj<IVulkanVideoParser>& vulkanVideoParser);
 
 #endif /* _VULKANVIDEOPARSER_H_ */
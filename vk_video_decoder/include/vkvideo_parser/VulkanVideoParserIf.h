@@ -505,6 +505,9 @@ typedef struct VkParserAv1PictureData {
     VkPicIf* ref_frame_map[8];
 
     VkParserAv1GlobalMotionParameters ref_global_motion[7];
+
+    // The tiles of the frame: the stream markers of the bitstream data are their offsets, one per tile
+    const uint32_t* pTileSizes; // numSlices entries, valid for the duration of the DecodePicture() callback
 } VkParserAv1PictureData;
 
 typedef struct VkParserPictureData {
@@ -526,6 +529,8 @@ typedef struct VkParserPictureData {
     int32_t picture_order_count; // picture order count (if known)
     uint8_t* pSideData; // Encryption Info
     uint32_t sideDataLen; // Encryption Info length
+    int32_t bDTSValid; // llDTS is the decode time stamp of the packet the picture starts in
+    int64_t llDTS;
 
     // Codec-specific data
     union {
@@ -556,6 +561,12 @@ typedef struct VkParserBitstreamPacket {
     uint32_t bEOP:1;            // true if the packet in pByteStream is exactly one frame
     uint8_t* pbSideData;        // Auxiliary encryption information
     int32_t nSideDataLength;    // Auxiliary encrypton information length
+    const size_t* pStartCodeOffsets; // Optional pre-scanned offsets of the byte after each 00.00.01 start code
+    uint32_t nStartCodeOffsets;      // Number of entries in pStartCodeOffsets
+    size_t nStartCodeScanLength;     // Bytes from pByteStream covered by pStartCodeOffsets
+    uint32_t nNalLengthSize;         // 0: start codes, else the bytes of the big-endian length in front of each NAL unit
+    uint32_t bDTSValid;              // true if llDTS is valid
+    int64_t llDTS;                   // Decode Time Stamp for this packet, same clock as llPTS
 } VkParserBitstreamPacket;
 
 typedef struct VkParserOperatingPointInfo {
@@ -659,6 +670,21 @@ protected:
     virtual ~VkParserVideoDecodeClient() { }
 };
 
+// The pictures dropped by the parser before they are decoded, for trick play and thumbnails (H.264 and H.265).
+// The reference pictures are all kept, or none of the pictures referring to them, and the DPB stays consistent.
+typedef struct VkParserDecodeFilter {
+    uint32_t referencePicturesOnly : 1;    // drop the pictures no other picture decoded refers to
+    uint32_t randomAccessPicturesOnly : 1; // decode the IDR pictures only, and the BLA and CRA ones of H.265
+    uint32_t maxTemporalLayers;            // H.265: the number of temporal sub-layers decoded (0 = all)
+    uint32_t maxScalableLayers;            // H.264: the number of MVC views, or SVC dependency layers, decoded (0 = all)
+    uint32_t errorResilient : 1;           // stand in for the references lost, instead of waiting for a random access point
+    uint32_t deferSliceHeaders : 1;        // H.264/H.265: only the start of the headers of the slices after the first one is
+                                           // parsed, the rest is checked against the first slice on a worker thread
+    uint32_t seiPayloadTypesSelected : 1;  // H.264/H.265: only the SEI messages of the payload types in seiPayloadTypes
+                                           // are parsed, the other ones are skipped by their payloadSize unread
+    uint32_t seiPayloadTypes[8];           // a bit per payload type below 256, bit (type % 32) of word (type / 32)
+} VkParserDecodeFilter;
+
 // Initialization parameters for decoder class
 typedef struct VkParserInitDecodeParameters {
     uint32_t                   interfaceVersion;
@@ -675,6 +701,8 @@ typedef struct VkParserInitDecodeParameters {
 
     // If set, Picture Parameters are going to be provided via UpdatePictureParameters callback
     bool     outOfBandPictureParameters;
+
+    VkParserDecodeFilter decodeFilter; // zero to decode all the pictures
 } VkParserInitDecodeParameters;
 
 // High-level interface to video decoder (Note that parsing and decoding
@@ -164,6 +164,7 @@ typedef enum {
     VK_PARSER_PKT_TIMESTAMP = 0x02, /**< Timestamp is valid                                */
     VK_PARSER_PKT_DISCONTINUITY = 0x04, /**< Set when a discontinuity has to be signalled      */
     VK_PARSER_PKT_ENDOFPICTURE = 0x08, /**< Set when the packet contains exactly one frame    */
+    VK_PARSER_PKT_DECODE_TIMESTAMP = 0x10, /**< Decode timestamp is valid                       */
 } VkVideopacketflags;
 
 struct VkParserSourceDataPacket {
@@ -172,6 +173,12 @@ struct VkParserSourceDataPacket {
     const uint8_t* payload; /** Pointer to packet payload data (may be NULL if EOS flag is set) */
     VkVideotimestamp timestamp; /** Presentation time stamp (10MHz clock), only valid if
                                              VK_PARSER_PKT_TIMESTAMP flag is set                                 */
+    const size_t* startCodeOffsets; /** Optional start code table from a pre-scan of the payload (may be NULL) */
+    uint32_t startCodeOffsetsCount; /** Number of entries in startCodeOffsets                                  */
+    size_t startCodeScanLength; /** Number of payload bytes covered by startCodeOffsets                    */
+    uint32_t nalLengthSize; /** 0 for start codes, else the size of the length of each NAL unit (AVCC / HVCC) */
+    VkVideotimestamp decodeTimestamp; /** Decode time stamp (10MHz clock), only valid if
+                                          VK_PARSER_PKT_DECODE_TIMESTAMP flag is set                     */
 };
 
 #endif // __NV_VULKANVIDEOPARSERPARAMS_H__
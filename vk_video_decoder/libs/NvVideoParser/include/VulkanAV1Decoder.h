@@ -0,0 +1,278 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VULKANAV1DECODER_H_
+#define _VULKANAV1DECODER_H_
+
+#include <vector>
+#include "VulkanVideoDecoder.h"
+
+#define AV1_NUM_REF_FRAMES          8
+#define AV1_REFS_PER_FRAME          7
+#define AV1_PRIMARY_REF_NONE        7
+#define AV1_MAX_SEGMENTS            8
+#define AV1_SEG_LVL_MAX             8
+#define AV1_SEG_LVL_REF_FRAME       5
+#define AV1_MAX_TILE_COLS           64
+#define AV1_MAX_TILE_ROWS           64
+#define AV1_MAX_TILE_WIDTH          4096
+#define AV1_MAX_TILE_AREA           (4096 * 2304)
+#define AV1_MAX_OPERATING_POINTS    32
+#define AV1_WARPEDMODEL_PREC_BITS   16
+#define AV1_SELECT_SCREEN_CONTENT_TOOLS 2
+#define AV1_SELECT_INTEGER_MV       2
+
+enum av1_obu_type_e
+{
+    AV1_OBU_SEQUENCE_HEADER = 1,
+    AV1_OBU_TEMPORAL_DELIMITER = 2,
+    AV1_OBU_FRAME_HEADER = 3,
+    AV1_OBU_TILE_GROUP = 4,
+    AV1_OBU_METADATA = 5,
+    AV1_OBU_FRAME = 6,
+    AV1_OBU_REDUNDANT_FRAME_HEADER = 7,
+    AV1_OBU_TILE_LIST = 8,
+    AV1_OBU_PADDING = 15,
+};
+
+enum av1_frame_type_e
+{
+    AV1_KEY_FRAME = 0,
+    AV1_INTER_FRAME = 1,
+    AV1_INTRA_ONLY_FRAME = 2,
+    AV1_SWITCH_FRAME = 3,
+};
+
+enum av1_ref_frame_e
+{
+    AV1_INTRA_FRAME = 0,
+    AV1_LAST_FRAME = 1,
+    AV1_LAST2_FRAME = 2,
+    AV1_LAST3_FRAME = 3,
+    AV1_GOLDEN_FRAME = 4,
+    AV1_BWDREF_FRAME = 5,
+    AV1_ALTREF2_FRAME = 6,
+    AV1_ALTREF_FRAME = 7,
+};
+
+enum av1_warp_model_e
+{
+    AV1_IDENTITY = 0,
+    AV1_TRANSLATION = 1,
+    AV1_ROTZOOM = 2,
+    AV1_AFFINE = 3,
+};
+
+struct av1_seq_header_s
+{
+    uint32_t seq_profile;
+    uint32_t still_picture;
+    uint32_t reduced_still_picture_header;
+    uint32_t timing_info_present_flag;
+    uint32_t num_units_in_display_tick;
+    uint32_t time_scale;
+    uint32_t equal_picture_interval;
+    uint32_t num_ticks_per_picture_minus_1;
+    uint32_t decoder_model_info_present_flag;
+    uint32_t buffer_delay_length_minus_1;
+    uint32_t buffer_removal_time_length_minus_1;
+    uint32_t frame_presentation_time_length_minus_1;
+    uint32_t operating_points_cnt_minus_1;
+    uint32_t operating_point_idc[AV1_MAX_OPERATING_POINTS];
+    uint32_t seq_level_idx[AV1_MAX_OPERATING_POINTS];
+    uint32_t seq_tier[AV1_MAX_OPERATING_POINTS];
+    uint32_t decoder_model_present_for_this_op[AV1_MAX_OPERATING_POINTS];
+    uint32_t frame_width_bits_minus_1;
+    uint32_t frame_height_bits_minus_1;
+    uint32_t max_frame_width_minus_1;
+    uint32_t max_frame_height_minus_1;
+    uint32_t frame_id_numbers_present_flag;
+    uint32_t delta_frame_id_length_minus_2;
+    uint32_t additional_frame_id_length_minus_1;
+    uint32_t use_128x128_superblock;
+    uint32_t enable_filter_intra;
+    uint32_t enable_intra_edge_filter;
+    uint32_t enable_interintra_compound;
+    uint32_t enable_masked_compound;
+    uint32_t enable_warped_motion;
+    uint32_t enable_dual_filter;
+    uint32_t enable_order_hint;
+    uint32_t enable_jnt_comp;
+    uint32_t enable_ref_frame_mvs;
+    uint32_t seq_force_screen_content_tools;
+    uint32_t seq_force_integer_mv;
+    uint32_t OrderHintBits;
+    uint32_t enable_superres;
+    uint32_t enable_cdef;
+    uint32_t enable_restoration;
+    // color_config()
+    uint32_t BitDepth;
+    uint32_t mono_chrome;
+    uint32_t color_primaries;
+    uint32_t transfer_characteristics;
+    uint32_t matrix_coefficients;
+    uint32_t color_range;
+    uint32_t subsampling_x;
+    uint32_t subsampling_y;
+    uint32_t chroma_sample_position;
+    uint32_t separate_uv_delta_q;
+    uint32_t film_grain_params_present;
+};
+
+// The state saved with a reference frame by the reference frame update process (7.20)
+struct av1_ref_frame_s
+{
+    VkPicIf* pPicBuf;
+    uint32_t RefValid;
+    uint32_t RefFrameId;
+    uint32_t RefFrameType;
+    uint32_t RefOrderHint;
+    uint32_t RefUpscaledWidth;
+    uint32_t RefFrameWidth;
+    uint32_t RefFrameHeight;
+    uint32_t RefRenderWidth;
+    uint32_t RefRenderHeight;
+    uint32_t showable_frame;
+    uint32_t SavedOrderHints[AV1_NUM_REF_FRAMES];
+    int32_t  SavedGmParams[AV1_NUM_REF_FRAMES][6];
+    int8_t   loop_filter_ref_deltas[AV1_NUM_REF_FRAMES];
+    int8_t   loop_filter_mode_deltas[2];
+    uint8_t  FeatureEnabled[AV1_MAX_SEGMENTS][AV1_SEG_LVL_MAX];
+    int16_t  FeatureData[AV1_MAX_SEGMENTS][AV1_SEG_LVL_MAX];
+    VkParserAv1FilmGrain film_grain;
+};
+
+//
+// AV1 decoder: the OBUs of the low overhead bitstream format (AV1 spec, section 5), one temporal unit per packet
+// when bEOP is set. The frames are handed out once their last tile group is parsed, with their tiles as the
+// stream markers of the bitstream data.
+//
+class VulkanAV1Decoder : public VulkanVideoDecoder
+{
+public:
+    VulkanAV1Decoder(VkVideoCodecOperationFlagBitsKHR std);
+    virtual ~VulkanAV1Decoder();
+
+    // VulkanVideoDecodeParser
+    virtual bool ParseByteStream(const VkParserBitstreamPacket* pck, size_t* pParsedBytes);
+
+protected:
+    // VulkanVideoDecoder
+    virtual void CreatePrivateContext() { }
+    virtual void InitParser();
+    virtual bool IsPictureBoundary(int32_t) { return false; } // The frames end with their last tile
+    virtual int32_t ParseNalUnit() { return NALU_DISCARD; }   // The OBUs are parsed by ParseObu()
+    virtual bool BeginPicture(VkParserPictureData* pnvpd);
+    virtual void EndOfStream();
+    virtual void FreeContext();
+
+protected:
+    // OBUs
+    bool ParseObu(const uint8_t* pData, size_t dataSize, bool endOfTemporalUnit, size_t* pObuSize);
+    bool CopyObuData(const uint8_t* pData, size_t size);
+    bool sequence_header_obu(const uint8_t* pData, size_t size);
+    void color_config();
+    bool frame_header_obu();
+    bool uncompressed_header();
+    bool tile_group_obu();
+    void decode_frame_wrapup();
+    void show_existing_frame();
+    void reset_frame();
+
+    // Frame header
+    void mark_ref_frames(uint32_t idLen);
+    void frame_size();
+    void superres_params();
+    void render_size();
+    void frame_size_with_refs();
+    void set_frame_refs(uint32_t last_frame_idx, uint32_t gold_frame_idx);
+    void setup_past_independence();
+    void load_previous();
+    void tile_info();
+    void quantization_params();
+    int32_t read_delta_q();
+    void segmentation_params();
+    void delta_q_lf_params();
+    void compute_lossless();
+    void loop_filter_params();
+    void cdef_params();
+    void lr_params();
+    void skip_mode_params();
+    void global_motion_params();
+    void read_global_param(uint32_t type, uint32_t ref, uint32_t idx);
+    void film_grain_params();
+    void reference_frame_update();
+
+    // Syntax helpers
+    int32_t su(uint32_t n);
+    uint32_t ns(uint32_t n);
+    uint32_t uvlc();
+    uint32_t leb128(const uint8_t* pData, size_t dataSize, size_t* pSize) const;
+    void byte_alignment() { m_nalu.rbsp_bitpos = (m_nalu.rbsp_bitpos + 7) & ~7; }
+    int32_t get_relative_dist(uint32_t a, uint32_t b) const;
+    uint32_t decode_signed_subexp_with_ref(int32_t low, int32_t high, int32_t r);
+    uint32_t decode_unsigned_subexp_with_ref(uint32_t mx, uint32_t r);
+    uint32_t decode_subexp(uint32_t numSyms);
+
+    void release_ref_frames();
+
+protected:
+    av1_seq_header_s     m_sps;                 // Active sequence header
+    bool                 m_bSequenceHeaderSeen;
+    uint32_t             m_OperatingPointIdc;
+    uint32_t             m_temporal_id;         // Of the current OBU
+    uint32_t             m_spatial_id;
+    av1_ref_frame_s      m_refFrames[AV1_NUM_REF_FRAMES];
+
+    // Current frame
+    VkParserAv1PictureData m_PicData;           // Filled as the frame header is parsed
+    VkPicIf*             m_pCurrPic;
+    bool                 m_bSeenFrameHeader;
+    bool                 m_bSkipFrame;          // A reference of the frame is missing
+    uint32_t             m_show_existing_frame;
+    uint32_t             m_frame_to_show_map_idx;
+    uint32_t             m_showable_frame;
+    uint32_t             m_FrameIsIntra;
+    uint32_t             m_current_frame_id;
+    uint32_t             m_frame_size_override_flag;
+    uint32_t             m_OrderHint;
+    uint32_t             m_OrderHints[AV1_NUM_REF_FRAMES];
+    uint32_t             m_refresh_frame_flags;
+    int32_t              m_ref_frame_idx[AV1_REFS_PER_FRAME];
+    uint32_t             m_FrameWidth;
+    uint32_t             m_FrameHeight;
+    uint32_t             m_UpscaledWidth;
+    uint32_t             m_RenderWidth;
+    uint32_t             m_RenderHeight;
+    uint32_t             m_MiCols;
+    uint32_t             m_MiRows;
+    uint32_t             m_TileColsLog2;
+    uint32_t             m_TileRowsLog2;
+    uint32_t             m_TileSizeBytes;
+    int32_t              m_DeltaQYDc;
+    int32_t              m_DeltaQUDc;
+    int32_t              m_DeltaQUAc;
+    int32_t              m_DeltaQVDc;
+    int32_t              m_DeltaQVAc;
+    uint8_t              m_FeatureEnabled[AV1_MAX_SEGMENTS][AV1_SEG_LVL_MAX];
+    int16_t              m_FeatureData[AV1_MAX_SEGMENTS][AV1_SEG_LVL_MAX];
+    int32_t              m_PrevGmParams[AV1_NUM_REF_FRAMES][6];
+    int32_t              m_gm_params[AV1_NUM_REF_FRAMES][6];
+    std::vector<uint32_t> m_tileSizes;          // Of the tiles of the frame parsed so far
+    std::vector<uint8_t> m_pendingData;         // Start of an OBU split across packets
+};
+
+#endif // _VULKANAV1DECODER_H_
@@ -170,6 +170,8 @@ struct seq_parameter_set_s : public StdVideoPictureParametersSet, public StdVide
         return !!clientObject;
     }
 
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const { return client; }
+
     void Reset() {
 
         StdVideoH264SequenceParameterSet::operator=(StdVideoH264SequenceParameterSet());
@@ -448,6 +450,8 @@ struct pic_parameter_set_s : public StdVideoPictureParametersSet, public StdVide
         return !!clientObject;
     }
 
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const { return client; }
+
     void Reset() {
         StdVideoH264PictureParameterSet::operator=(StdVideoH264PictureParameterSet());
         picScalinList = NvScalingListH264();
@@ -614,6 +618,38 @@ struct slice_header_s
     nalu_header_extension_u nhe;
 };
 
+// The fields of the first slice of a picture the other slices repeat (7.4.3), and the parameters to find them
+struct deferred_slice_check_s
+{
+    int nal_ref_idc;
+    int IdrPicFlag;
+    int frame_num;
+    int field_pic_flag;
+    int bottom_field_flag;
+    int idr_pic_id;
+    int pic_order_cnt_lsb;
+    int delta_pic_order_cnt_bottom;
+    int delta_pic_order_cnt[2];
+    // dec_ref_pic_marking
+    unsigned char no_output_of_prior_pics_flag;
+    unsigned char long_term_reference_flag;
+    unsigned char adaptive_ref_pic_marking_mode_flag;
+    memory_management_control_operation_s mmco[MAX_MMCOS];
+    // active sps and pps
+    int log2_max_frame_num;
+    int frame_mbs_only_flag;
+    int pic_order_cnt_type;
+    int log2_max_pic_order_cnt_lsb;
+    int delta_pic_order_always_zero_flag;
+    int chroma_array_type;
+    int bottom_field_pic_order_in_frame_present_flag;
+    int num_ref_idx_l0_default_active_minus1;
+    int num_ref_idx_l1_default_active_minus1;
+    int weighted_pred_flag;
+    int weighted_bipred_idc;
+    int first_mb_in_slice_limit; // PicSizeInMbs, in MB pairs with MbaffFrameFlag
+};
+
 struct layer_data_s
 {
     int available;
@@ -782,9 +818,17 @@ protected:
     virtual void EndPicture();
     virtual void EndOfStream();
     virtual int32_t  ParseNalUnit();
+    virtual bool DropNalUnit();
     virtual void FreeContext();
 
 private:
+    bool IsMvcViewDropped(int view_id) const;
+    // The slices after the first one of a picture, with their headers checked on a worker
+    void init_deferred_slice_check(const slice_header_s *slh);
+    bool defer_slice_header(int nal_ref_idc);
+    static bool check_deferred_slice_header(const deferred_slice_check_s& pic, int nal_ref_idc, int slice_type,
+                                            NvVkRbspReader& rbsp);
+
     // Header parsing
     enum SpsNalUnitTarget {
        SPS_NAL_UNIT_TARGET_SPS = 0,
@@ -902,6 +946,9 @@ private:
     seq_parameter_set_mvc_extension_s *m_spsmes[MAX_NUM_SPS];
     VkSharedBaseObj<seq_parameter_set_s> m_spssvcs[MAX_NUM_SPS];
     VkSharedBaseObj<pic_parameter_set_s> m_ppss[MAX_NUM_PPS];
+    // The storage of the released parameter sets, reused by the next ones
+    VkSharedBaseObj<StdVideoPictureParametersSetPool<seq_parameter_set_s>> m_spsPool;
+    VkSharedBaseObj<StdVideoPictureParametersSetPool<pic_parameter_set_s>> m_ppsPool;
     frame_packing_arrangement_s m_fpa; // Stereo SEI
     nalu_header_extension_u m_nhe;  // current nal ubit header extension
     // use MVC decoder
@@ -923,6 +970,7 @@ private:
     dependency_data_s m_dependency_data[8];
     dependency_data_s *m_dd; // current dependency data
     slice_group_map_s* m_slice_group_map; // [pps_id] (base layer only)
+    std::shared_ptr<const deferred_slice_check_s> m_deferredSliceCheck; // shared by the deferred slices of the picture
 };
 
 #endif // _VULKANH264DECODER_H_
@@ -171,10 +171,18 @@ struct short_term_ref_pic_set_s
     uint8_t NumPositivePics;
     uint8_t inter_ref_pic_set_prediction_flag;
     uint8_t delta_idx_minus1;
+    // derived once per set, the delta POCs of RefPicSetStCurrBefore, StCurrAfter and StFoll (8.3.2)
+    uint8_t NumDeltaPocsStCurrBefore;
+    uint8_t NumDeltaPocsStCurrAfter;
+    uint8_t NumDeltaPocsStFoll;
+    uint8_t reserved;
     uint8_t UsedByCurrPicS0[MAX_NUM_STRPS_ENTRIES];
     uint8_t UsedByCurrPicS1[MAX_NUM_STRPS_ENTRIES];
     int32_t DeltaPocS0[MAX_NUM_STRPS_ENTRIES];
     int32_t DeltaPocS1[MAX_NUM_STRPS_ENTRIES];
+    int32_t DeltaPocStCurrBefore[MAX_NUM_STRPS_ENTRIES];
+    int32_t DeltaPocStCurrAfter[MAX_NUM_STRPS_ENTRIES];
+    int32_t DeltaPocStFoll[MAX_NUM_STRPS_ENTRIES];
 };
 
 struct hevc_seq_param_s : public StdVideoPictureParametersSet, public StdVideoH265SequenceParameterSet
@@ -232,6 +240,8 @@ struct hevc_seq_param_s : public StdVideoPictureParametersSet, public StdVideoH2
         return !!clientObject;
     }
 
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const { return client; }
+
     hevc_seq_param_s(uint64_t updateSequenceCount)
     : StdVideoPictureParametersSet(TYPE_H265_SPS, SPS_TYPE,
                                    m_refClassId, updateSequenceCount)
@@ -401,6 +411,8 @@ struct hevc_pic_param_s : public StdVideoPictureParametersSet, public StdVideoH2
         return !!clientObject;
     }
 
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const { return client; }
+
     void Reset() {
         StdVideoH265PictureParameterSet::operator=(StdVideoH265PictureParameterSet());
         pps_scaling_list = scaling_list_s();
@@ -534,6 +546,8 @@ struct hevc_video_param_s : public StdVideoPictureParametersSet, public StdVideo
         return !!clientObject;
     }
 
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const { return client; }
+
     void Reset() {
 
         StdVideoH265VideoParameterSet::operator=(StdVideoH265VideoParameterSet());
@@ -662,10 +676,6 @@ typedef struct _hevc_slice_header_s
     uint32_t used_by_curr_pic_lt_flags;      // bitmask [MAX_NUM_REF_PICS]
     uint32_t delta_poc_msb_present_flags;    // bitmask [MAX_NUM_REF_PICS]
 
-    uint8_t lt_idx_sps[MAX_NUM_REF_PICS];
-    uint16_t poc_lsb_lt[MAX_NUM_REF_PICS];
-    int32_t delta_poc_msb_cycle_lt[MAX_NUM_REF_PICS];
-
     uint8_t slice_temporal_mvp_enabled_flag;
     uint8_t inter_layer_pred_enabled_flag;
     uint8_t num_inter_layer_ref_pics_minus1;
@@ -673,12 +683,37 @@ typedef struct _hevc_slice_header_s
 
     uint8_t num_ref_idx_l0_active_minus1;
     uint8_t num_ref_idx_l1_active_minus1;
-    uint8_t inter_layer_pred_layer_idc[MAX_VPS_LAYERS];
     uint8_t reserved2[2];
 
+    // The arrays below are only initialized for the entries the slice header uses:
+    // num_long_term_sps + num_long_term_pics, numActiveRefLayerPics and the counts of strps.
+    uint8_t lt_idx_sps[MAX_NUM_REF_PICS];
+    uint16_t poc_lsb_lt[MAX_NUM_REF_PICS];
+    int32_t delta_poc_msb_cycle_lt[MAX_NUM_REF_PICS];
+    uint8_t inter_layer_pred_layer_idc[MAX_VPS_LAYERS];
+
     short_term_ref_pic_set_s strps;
 } hevc_slice_header_s;
 
+// The fields of the first slice of a picture the other slice segments repeat (7.4.7.1), and the parameters to find them
+typedef struct _hevc_deferred_slice_check_s
+{
+    uint8_t nal_unit_type;
+    uint8_t no_output_of_prior_pics_flag;
+    uint8_t pic_output_flag;
+    uint8_t short_term_ref_pic_set_sps_flag;
+    uint8_t short_term_ref_pic_set_idx;
+    uint16_t pic_order_cnt_lsb;
+    // active sps and pps
+    uint8_t dependent_slice_segments_enabled_flag;
+    uint8_t num_extra_slice_header_bits;
+    uint8_t output_flag_present_flag;
+    uint8_t separate_colour_plane_flag;
+    uint8_t log2_max_pic_order_cnt_lsb;
+    uint8_t num_short_term_ref_pic_sets;
+    uint32_t PicSizeInCtbsY;
+} hevc_deferred_slice_check_s;
+
 
 typedef struct _hevc_dpb_entry_s
 {
@@ -744,6 +779,7 @@ protected:
     virtual void EndPicture();
     virtual void EndOfStream();
     virtual int32_t  ParseNalUnit();
+    virtual bool DropNalUnit();
     virtual void FreeContext();
 
 protected:
@@ -770,6 +806,11 @@ protected:
     void hrd_parameters(hevc_video_hrd_param_s* pStdHrdParameters, bool commonInfPresentFlag, uint8_t maxNumSubLayersMinus1);
     void sub_layer_hrd_parameters(StdVideoH265SubLayerHrdParameters* pStdSubLayerHrdParameters, int subLayerId, int cpb_cnt_minus1, int sub_pic_cpb_params_present_flag);
     bool slice_header(int nal_unit_type, int nuh_temporal_id_plus1);
+    // The slice segments after the first one of a picture, with their headers checked on a worker
+    void init_deferred_slice_check(const hevc_seq_param_s* sps, const hevc_pic_param_s* pps);
+    bool defer_slice_header(int nal_unit_type);
+    static bool check_deferred_slice_header(const hevc_deferred_slice_check_s& pic, uint32_t no_output_of_prior_pics_flag,
+                                            NvVkRbspReader& rbsp);
     uint32_t getNumRefLayerPics(const hevc_video_param_s* vps, hevc_slice_header_s *pSliceHeader);
     void getNumActiveRefLayerPics(const hevc_video_param_s *pVideoParamSet, hevc_slice_header_s *pSliceHeader);
     // DPB management
@@ -785,6 +826,7 @@ protected:
     int  picture_order_count(hevc_slice_header_s *slh);
     void reference_picture_set(hevc_slice_header_s *slh, int PicOrderCntVal);
     int  create_lost_ref_pic(int lostPOC, int layerID, int marking_flag);
+    int  create_missing_ref_pic(int lostPOC, int layerID);
     // SEI layer
     void sei_payload();
 
@@ -815,13 +857,20 @@ protected:
     int8_t            m_current_dpb_id;
     hevc_dpb_entry_s m_dpb[HEVC_DPB_SIZE];
     hevc_slice_header_s m_slh;
+    uint64_t m_numSliceHeaders;
+    uint64_t m_sliceHeaderBytesCleared; // of the slice headers parsed, reported with the verbose log
     VkSharedBaseObj<hevc_seq_param_s> m_active_sps[MAX_VPS_LAYERS];
     VkSharedBaseObj<hevc_pic_param_s> m_active_pps[MAX_VPS_LAYERS];
     VkSharedBaseObj<hevc_video_param_s> m_active_vps;
     VkSharedBaseObj<hevc_seq_param_s> m_spss[MAX_NUM_SPS];
     VkSharedBaseObj<hevc_pic_param_s> m_ppss[MAX_NUM_PPS];
     VkSharedBaseObj<hevc_video_param_s> m_vpss[MAX_NUM_VPS];
+    // The storage of the released parameter sets, reused by the next ones
+    VkSharedBaseObj<StdVideoPictureParametersSetPool<hevc_seq_param_s>> m_spsPool;
+    VkSharedBaseObj<StdVideoPictureParametersSetPool<hevc_pic_param_s>> m_ppsPool;
+    VkSharedBaseObj<StdVideoPictureParametersSetPool<hevc_video_param_s>> m_vpsPool;
     mastering_display_colour_volume *m_display;
+    std::shared_ptr<const hevc_deferred_slice_check_s> m_deferredSliceCheck; // shared by the deferred slices of the picture
 };
 
 
@@ -18,7 +18,14 @@
 #define _VULKANVIDEODECODER_H_
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "VkCodecUtils/VulkanBitstreamBuffer.h"
 
 #define UNUSED_LOCAL_VAR(expr) do { (void)(expr); } while (0)
@@ -27,11 +34,11 @@ typedef struct NvVkNalUnit
 {
     int64_t start_offset;     // Start offset in byte stream buffer
     int64_t end_offset;       // End offset in byte
-    int64_t get_offset;       // Current read ptr in this NALU
+    int64_t get_offset;       // Next byte in this NALU to be converted to RBSP
     int32_t get_zerocnt;     // Zero byte count
-    uint32_t get_bfr;        // Bit buffer for reading
-    uint32_t get_bfroffs;    // Offset in bit buffer
     uint32_t get_emulcnt;    // Emulation prevention byte count
+    int64_t rbsp_size;        // Number of RBSP bytes available in the RBSP scratch buffer
+    int64_t rbsp_bitpos;      // Current read position in the RBSP scratch buffer (in bits)
 } NvVkNalUnit;
 
 // Presentation information stored with every decoded frame
@@ -46,6 +53,55 @@ typedef struct NvVkPresentationInfo
     int32_t bDiscontinuity; // Discontinuity before this PTS, do not check for out of order
 } NvVkPresentationInfo;
 
+// Bitstream data sizes of the recent pictures, used to size the bitstream buffers ahead of the picture data
+typedef struct NvVkPictureSizeHistory
+{
+    enum { HISTORY_SIZE = 32 };
+    uint32_t sizes[2][HISTORY_SIZE];    // [0] inter pictures, [1] intra pictures
+    uint32_t numSizes[2];
+    uint32_t maxSize[2];                // Rolling maximum of sizes[]
+    uint32_t picturesSinceIntra;
+    uint32_t intraPeriod;               // Distance between the last two intra pictures (0 if unknown)
+    uint32_t picturesSinceResize;       // Pictures since the bitstream data last outgrew its buffer
+    uint32_t numResizes;                // Number of bitstream buffer resizes
+    uint64_t resizeCopyBytes;           // Bytes copied by the resizes
+} NvVkPictureSizeHistory;
+
+// Bit reader over a copy of the start of a RBSP, for the slice header checks run off the parsing thread
+class NvVkRbspReader
+{
+public:
+    NvVkRbspReader(std::vector<uint8_t>&& rbsp, size_t bitpos)
+        : m_rbsp(std::move(rbsp)), m_bitpos(bitpos) {}
+
+    uint32_t u(uint32_t n) {
+        uint32_t bits = 0;
+        for (uint32_t i = 0; i < n; i++, m_bitpos++) {
+            const size_t byteOffset = m_bitpos >> 3;
+            const uint32_t bit = (byteOffset < m_rbsp.size()) ? ((m_rbsp[byteOffset] >> (7 - (m_bitpos & 7))) & 1) : 0;
+            bits = (bits << 1) | bit;
+        }
+        return bits;
+    }
+    uint32_t ue() {
+        uint32_t leadingZeroBits = 0;
+        while ((u(1) == 0) && !overrun()) {
+            if (++leadingZeroBits > 31) {
+                return std::numeric_limits<uint32_t>::max();
+            }
+        }
+        return (uint32_t)((((uint64_t)1 << leadingZeroBits) - 1) + u(leadingZeroBits));
+    }
+    int32_t se() {
+        const uint64_t codeNum = ue();
+        return (codeNum & 1) ? (int32_t)((codeNum + 1) >> 1) : -(int32_t)(codeNum >> 1);
+    }
+    bool overrun() const { return m_bitpos > (m_rbsp.size() * 8); } // the header runs past the bytes copied
+
+private:
+    std::vector<uint8_t> m_rbsp;
+    size_t               m_bitpos;
+};
 
 //
 // VulkanVideoDecoder is the base class for all decoders
@@ -79,12 +135,19 @@ protected:
     uint32_t m_bufferSizeAlignment;        // Minimum buffer size alignment of the bitstream data for each frame
     VulkanBitstreamBufferStream m_bitstreamData;// bitstream for the current picture
     VkDeviceSize                m_bitstreamDataLen; // bitstream buffer size
+    const uint8_t*              m_pBitstreamSource;      // input the bitstream data at m_bitstreamSourceOffset was copied from
+    VkDeviceSize                m_bitstreamSourceOffset; // the data from there on is a contiguous copy of the input
+    const uint8_t*              m_pPacketData;           // packet being parsed
+    size_t                      m_packetDataSize;
+    bool                        m_bZeroCopyBitstream;    // m_bitstreamData references the input in place
+    NvVkPictureSizeHistory      m_pictureSizes;          // for sizing the bitstream buffers
     uint32_t m_BitBfr;                          // Bit Buffer for start code parsing
     int32_t m_bEmulBytesPresent;                // Startcode emulation prevention bytes are present in the byte stream
     int32_t m_bNoStartCodes;                    // No startcode parsing (only rely on the presence of PTS to detect frame boundaries)
     int32_t m_bFilterTimestamps;                // Filter input timestamps in case the decoder is sending the DTS instead of the PTS
     int32_t m_MaxFrameBuffers;                  // Max frame buffers to keep as reference
     NvVkNalUnit m_nalu;                         // Current NAL unit being filled
+    std::vector<uint8_t> m_rbspData;            // RBSP of the current NAL unit (emulation prevention bytes removed)
     size_t m_lMinBytesForBoundaryDetection;     // Min number of bytes needed to detect picture boundaries
     int64_t m_lClockRate;                       // System Reference Clock Rate
     int64_t m_lFrameDuration;                   // Approximate frame duration in units of (1/m_lClockRate) seconds
@@ -93,6 +156,7 @@ protected:
     int64_t m_llNaluStartLocation;              // Byte count at the first byte of the current nal unit
     int64_t m_llFrameStartLocation;             // Byte count at the first byte of the picture bitstream data buffer
     int32_t m_lErrorThreshold;                  // Error threshold (0=strict, 100=ignore errors)
+    VkParserDecodeFilter m_decodeFilter;        // Pictures dropped before they are decoded
     int32_t m_bFirstPTS;                        // Number of frames displayed
     int32_t m_lPTSPos;                          // Current write position in PTS queue
     uint32_t m_nCallbackEventCount;              // Decode/Display callback count in current packet
@@ -103,6 +167,8 @@ protected:
         int32_t bPTSValid;                      // Entry is valid
         int64_t llPTS;                          // PTS value
         int64_t llPTSPos;                       // PTS position in byte stream
+        int32_t bDTSValid;                      // llDTS is valid
+        int64_t llDTS;                          // DTS value of the same packet
         int32_t bDiscontinuity;                 // Discontinuity before this PTS, do not check for out of order
     } m_PTSQueue[MAX_QUEUED_PTS];
     int32_t m_bDiscontinuityReported;           // Dicontinuity reported
@@ -110,6 +176,13 @@ protected:
     int32_t m_iTargetLayer;                     // Specific to SVC only
     int32_t m_bDecoderInitFailed;               // Set when m_pClient->BeginSequence fails to create the decoder
     int32_t m_lCheckPTS;                        // Run the m_bFilterTimestamps for the first few framew to look for out of order PTS
+    // The headers of the slices after the first one of a picture, checked in turns on a worker (m_decodeFilter.deferSliceHeaders)
+    std::thread m_sliceHeaderThread;
+    std::mutex m_sliceHeaderMutex;
+    std::condition_variable m_sliceHeaderCond;
+    std::deque<std::function<void()>> m_sliceHeaderChecks;
+    bool m_sliceHeaderThreadExit;
+    std::atomic<uint32_t> m_sliceHeaderMismatches;  // Deferred slice headers inconsistent with the first slice
 public:
     VulkanVideoDecoder(VkVideoCodecOperationFlagBitsKHR std);
     virtual ~VulkanVideoDecoder();
@@ -144,6 +217,7 @@ protected:
     virtual void InitParser() = 0;                             // Initialize codec-specific parser state
     virtual bool IsPictureBoundary(int32_t rbsp_size) = 0;     // Returns true if the current NAL unit belongs to a new picture
     virtual int32_t  ParseNalUnit() = 0;                       // Must return NALU_DISCARD or NALU_SLICE
+    virtual bool DropNalUnit() { return false; }               // Returns true if the NAL unit is dropped by m_decodeFilter
     virtual bool BeginPicture(VkParserPictureData *pnvpd) = 0; // Fills in picture data. Return true if picture should be sent to client
     virtual void EndPicture() {}                               // Called after a picture has been decoded
     virtual void EndOfStream() {}                              // Called to reset parser
@@ -152,32 +226,77 @@ protected:
 protected:
     // Byte stream parsing
     size_t next_start_code(const uint8_t *pdatain, size_t datasize, bool& found_start_code);
+    size_t lookup_start_code(const VkParserBitstreamPacket* pck, size_t packetOffset, size_t datasize,
+                             uint32_t& startCodeIndex, bool& found_start_code);
     void nal_unit();
     void init_dbits();
+    // The bit reader works on the RBSP of the current NAL unit: the emulation prevention bytes are
+    // stripped into m_rbspData on demand (see fill_rbsp), so that the nal payload beyond the last
+    // syntax element read is never touched.
+    enum { RBSP_READ_PADDING = 8 };             // Zero bytes kept past the end of the RBSP for 64-bit reads
+    void fill_rbsp(int64_t rbspSize);           // Convert NALU bytes to RBSP until rbspSize bytes are available
+    uint64_t peek_bits64() {                    // Next 64 bits of the RBSP, aligned to the current byte
+        const int64_t byteOffset = m_nalu.rbsp_bitpos >> 3;
+        if ((byteOffset + 8) > m_nalu.rbsp_size) {
+            fill_rbsp(byteOffset + 8);
+            if (byteOffset >= m_nalu.rbsp_size) {
+                return 0; // Reading past the end of the NAL unit
+            }
+        }
+        const uint8_t* p = &m_rbspData[(size_t)byteOffset];
+        return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+               ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+    }
+    uint32_t peek_bits32() { return (uint32_t)((peek_bits64() << (m_nalu.rbsp_bitpos & 7)) >> 32); }
     int32_t available_bits() { assert((m_nalu.end_offset - m_nalu.get_offset) < std::numeric_limits<int32_t>::max());
-                               return (int32_t)(m_nalu.end_offset - m_nalu.get_offset) * 8 + (32 - m_nalu.get_bfroffs); }
-    int32_t consumed_bits() { assert((m_nalu.get_offset - m_nalu.start_offset - m_nalu.get_emulcnt) < std::numeric_limits<int32_t>::max());
-                          return (int32_t)(m_nalu.get_offset - m_nalu.start_offset - m_nalu.get_emulcnt) * 8 - (32 - m_nalu.get_bfroffs); }
-    uint32_t next_bits(uint32_t n) { return (m_nalu.get_bfr << m_nalu.get_bfroffs) >> (32 - n); } // NOTE: n must be in the [1..25] range
-    void skip_bits(uint32_t n);  // advance bitstream position
-    uint32_t u(uint32_t n);   // return next n bits, advance bitstream position
+                               return (int32_t)((m_nalu.end_offset - m_nalu.get_offset + m_nalu.rbsp_size) * 8 - m_nalu.rbsp_bitpos); }
+    int32_t consumed_bits() { assert(m_nalu.rbsp_bitpos < std::numeric_limits<int32_t>::max());
+                          return (int32_t)m_nalu.rbsp_bitpos + ((m_bNoStartCodes) ? 0 : 3 * 8); }
+    uint32_t next_bits(uint32_t n) { assert((n > 0) && (n <= 32)); return peek_bits32() >> (32 - n); } // NOTE: n must be in the [1..32] range
+    void skip_bits(uint32_t n) { m_nalu.rbsp_bitpos += n; }  // advance bitstream position
+    uint32_t u(uint32_t n) {  // return next n bits, advance bitstream position
+        if (n == 0) {
+            return 0;
+        }
+        const uint32_t bits = next_bits(n);
+        m_nalu.rbsp_bitpos += n;
+        return bits;
+    }
     uint32_t u16_le()    { uint32_t tmp = u(8); tmp |= u(8) << 8; return tmp; }
     uint32_t u24_le()    { uint32_t tmp = u16_le(); tmp |= u(8) << 16; return tmp; }
     uint32_t u32_le()    { uint32_t tmp = u16_le(); tmp |= u16_le() << 16; return tmp; }
     uint32_t ue();
     int32_t se();
     uint32_t f(uint32_t n, uint32_t) { return u(n); }
-    bool byte_aligned() const { return ((m_nalu.get_bfroffs & 7) == 0); }
+    bool byte_aligned() const { return ((m_nalu.rbsp_bitpos & 7) == 0); }
+    void queue_packet_pts(const VkParserBitstreamPacket* pck);
     void end_of_picture();
     void end_of_stream();
     bool IsSequenceChange(VkParserSequenceInfo *pnvsi);
     int32_t init_sequence(VkParserSequenceInfo *pnvsi);  // Must be called by derived classes to initialize the sequence
     void display_picture(VkPicIf *pPicBuf, bool bEvict = true);
     void rbsp_trailing_bits();
-    bool end() { return m_nalu.get_offset >= m_nalu.end_offset; }
+    bool sei_payload_selected(int32_t payloadType) const { // Returns false if the SEI message is skipped by m_decodeFilter
+        return !m_decodeFilter.seiPayloadTypesSelected ||
+               ((payloadType >= 0) && (payloadType < 256) &&
+                ((m_decodeFilter.seiPayloadTypes[payloadType >> 5] >> (payloadType & 31)) & 1));
+    }
+    bool end() { return (m_nalu.get_offset >= m_nalu.end_offset) && (m_nalu.rbsp_bitpos >= (m_nalu.rbsp_size * 8)); }
     bool more_rbsp_data();
+    uint64_t nal_content_hash(uint64_t parentHash);
     bool resizeBitstreamBuffer(VkDeviceSize nExtrabytes);
     VkDeviceSize swapBitstreamBuffer(VkDeviceSize copyCurrBuffOffset, VkDeviceSize copyCurrBuffSize);
+    bool detachBitstreamBuffer();
+    void updatePictureSizeHistory(VkDeviceSize pictureSize, bool intraPicture);
+    VkDeviceSize getBitstreamBufferSize(VkDeviceSize minSize) const;
+    const uint8_t* getBitstreamSource(VkDeviceSize offset, VkDeviceSize size) const;
+    void setBitstreamSource(const uint8_t* pdatain, VkDeviceSize dstOffset);
+    void setSliceStartCode(VkDeviceSize offset);
+    // Queues the check of the rest of the current slice header, from the current bit position. The check
+    // returns false if the slice header does not agree with the first slice of the picture.
+    enum { MAX_DEFERRED_SLICE_HEADER_BYTES = 512 };
+    void defer_slice_header_check(std::function<bool(NvVkRbspReader&)>&& check);
+    void stop_slice_header_checks();            // Waits for the checks queued
 };
 
 void nvParserLog(const char* format, ...);
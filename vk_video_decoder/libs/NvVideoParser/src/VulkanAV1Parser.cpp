@@ -0,0 +1,1837 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// AV1 elementary stream parser (OBU, sequence & frame header layer)
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <string.h>
+#include "vkvideo_parser/VulkanVideoParserIf.h"
+#include "VulkanAV1Decoder.h"
+#include "nvVulkanVideoUtils.h"
+
+static const uint32_t Segmentation_Feature_Bits[AV1_SEG_LVL_MAX] = { 8, 6, 6, 6, 6, 3, 0, 0 };
+static const uint32_t Segmentation_Feature_Signed[AV1_SEG_LVL_MAX] = { 1, 1, 1, 1, 1, 0, 0, 0 };
+static const int32_t Segmentation_Feature_Max[AV1_SEG_LVL_MAX] = { 255, 63, 63, 63, 63, 7, 0, 0 };
+
+// lr_type to FrameRestorationType: NONE, SWITCHABLE, WIENER, SGRPROJ
+static const uint8_t Remap_Lr_Type[4] = { 0, 3, 1, 2 };
+
+static inline int32_t Clip3(int32_t x, int32_t y, int32_t z) { return (z < x) ? x : ((z > y) ? y : z); }
+
+static inline uint32_t tile_log2(uint32_t blkSize, uint32_t target)
+{
+    uint32_t k = 0;
+    while ((blkSize << k) < target) {
+        k++;
+    }
+    return k;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Construction/Destruction
+//
+
+VulkanAV1Decoder::VulkanAV1Decoder(VkVideoCodecOperationFlagBitsKHR std)
+    : VulkanVideoDecoder(std)
+    , m_bSequenceHeaderSeen(false)
+    , m_OperatingPointIdc(0)
+    , m_temporal_id(0)
+    , m_spatial_id(0)
+    , m_pCurrPic(nullptr)
+    , m_bSeenFrameHeader(false)
+    , m_bSkipFrame(false)
+{
+    memset(&m_sps, 0, sizeof(m_sps));
+    memset(m_refFrames, 0, sizeof(m_refFrames));
+}
+
+VulkanAV1Decoder::~VulkanAV1Decoder()
+{
+    release_ref_frames();
+}
+
+void VulkanAV1Decoder::InitParser()
+{
+    // The OBUs carry their size, no start code is looked for or written
+    m_bNoStartCodes = true;
+    m_bEmulBytesPresent = false;
+    m_bSequenceHeaderSeen = false;
+    m_OperatingPointIdc = 0;
+    memset(&m_sps, 0, sizeof(m_sps));
+    m_pendingData.clear();
+    release_ref_frames();
+    reset_frame();
+}
+
+void VulkanAV1Decoder::FreeContext()
+{
+    release_ref_frames();
+    m_pendingData.clear();
+}
+
+void VulkanAV1Decoder::EndOfStream()
+{
+    release_ref_frames();
+    reset_frame();
+    m_pendingData.clear();
+}
+
+void VulkanAV1Decoder::release_ref_frames()
+{
+    for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+        if (m_refFrames[i].pPicBuf != nullptr) {
+            m_refFrames[i].pPicBuf->Release();
+        }
+    }
+    memset(m_refFrames, 0, sizeof(m_refFrames));
+    if (m_pCurrPic != nullptr) {
+        m_pCurrPic->Release();
+        m_pCurrPic = nullptr;
+    }
+}
+
+// Drops the data of the frame being parsed, if any
+void VulkanAV1Decoder::reset_frame()
+{
+    m_bSeenFrameHeader = false;
+    m_bSkipFrame = false;
+    m_tileSizes.clear();
+    m_nalu.start_offset = 0;
+    m_nalu.end_offset = 0;
+    if (!!m_bitstreamData) {
+        m_bitstreamData.ResetStreamMarkers();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Byte stream
+//
+
+bool VulkanAV1Decoder::ParseByteStream(const VkParserBitstreamPacket* pck, size_t* pParsedBytes)
+{
+    if (!m_bitstreamData) { // make sure we're initialized
+        return false;
+    }
+
+    // The OBUs are copied to the bitstream buffer one at a time, never referenced in place
+    m_pPacketData = pck->pByteStream;
+    m_packetDataSize = pck->nDataLength;
+    m_pBitstreamSource = nullptr;
+
+    m_eError = NV_NO_ERROR;
+    m_nCallbackEventCount = 0;
+    if (pck->bDiscontinuity) {
+        // A frame cut by the discontinuity can't be decoded
+        if (m_bSeenFrameHeader && (m_pCurrPic != nullptr)) {
+            m_pCurrPic->Release();
+            m_pCurrPic = nullptr;
+        }
+        reset_frame();
+        m_pendingData.clear();
+        memset(&m_PTSQueue, 0, sizeof(m_PTSQueue));
+        m_bDiscontinuityReported = true;
+    }
+    queue_packet_pts(pck);
+
+    const uint8_t* pData = pck->pByteStream;
+    size_t dataSize = (pData != nullptr) ? pck->nDataLength : 0;
+    if (!m_pendingData.empty() && (dataSize > 0)) {
+        m_pendingData.insert(m_pendingData.end(), pData, pData + dataSize);
+        pData = m_pendingData.data();
+        dataSize = m_pendingData.size();
+    } else if (!m_pendingData.empty()) {
+        pData = m_pendingData.data();
+        dataSize = m_pendingData.size();
+    }
+
+    const bool endOfTemporalUnit = pck->bEOP || pck->bEOS;
+    size_t offset = 0;
+    while (offset < dataSize) {
+        size_t obuSize = 0;
+        if (!ParseObu(pData + offset, dataSize - offset, endOfTemporalUnit, &obuSize)) {
+            break; // The rest of the OBU is in the next packet
+        }
+        offset += obuSize;
+        if (m_bDecoderInitFailed) {
+            return false;
+        }
+    }
+
+    // Keep the start of an OBU the packet ends in the middle of
+    if (offset < dataSize) {
+        if (pData == m_pendingData.data()) {
+            m_pendingData.erase(m_pendingData.begin(), m_pendingData.begin() + offset);
+        } else {
+            m_pendingData.assign(pData + offset, pData + dataSize);
+        }
+    } else {
+        m_pendingData.clear();
+    }
+
+    if (pParsedBytes) {
+        *pParsedBytes = pck->nDataLength;
+    }
+    if (pck->bEOS) {
+        if (m_bSeenFrameHeader) {
+            nvParserLog("WARNING: AV1 frame truncated by the end of stream\n");
+        }
+        end_of_stream();
+    }
+    return (m_eError == NV_NO_ERROR);
+}
+
+uint32_t VulkanAV1Decoder::leb128(const uint8_t* pData, size_t dataSize, size_t* pSize) const
+{
+    uint64_t value = 0;
+    size_t i = 0;
+    for (; (i < 8) && (i < dataSize); i++) {
+        value |= (uint64_t)(pData[i] & 0x7f) << (i * 7);
+        if (!(pData[i] & 0x80)) {
+            *pSize = i + 1;
+            return (uint32_t)std::min<uint64_t>(value, UINT32_MAX);
+        }
+    }
+    *pSize = 0; // Truncated
+    return 0;
+}
+
+// Copies the payload of the OBU after the data of the current frame in the bitstream buffer, and points the
+// bit reader to it
+bool VulkanAV1Decoder::CopyObuData(const uint8_t* pData, size_t size)
+{
+    const VkDeviceSize requiredDataLen = m_nalu.end_offset + size;
+    if ((requiredDataLen > m_bitstreamDataLen) && !resizeBitstreamBuffer(requiredDataLen - m_bitstreamDataLen)) {
+        return false;
+    }
+    m_nalu.start_offset = m_nalu.end_offset;
+    if (size > 0) {
+        VkSharedBaseObj<VulkanBitstreamBuffer> bitstreamBuffer(m_bitstreamData.GetBitstreamBuffer());
+        bitstreamBuffer->CopyDataFromBuffer(pData, 0, m_nalu.start_offset, size);
+    }
+    m_nalu.end_offset = m_nalu.start_offset + size;
+    init_dbits();
+    return true;
+}
+
+// Parses the OBU at pData (5.3). Returns false if the OBU is not complete.
+bool VulkanAV1Decoder::ParseObu(const uint8_t* pData, size_t dataSize, bool endOfTemporalUnit, size_t* pObuSize)
+{
+    const uint8_t obuHeader = pData[0];
+    const uint32_t obu_type = (obuHeader >> 3) & 0xf;
+    const uint32_t obu_extension_flag = (obuHeader >> 2) & 1;
+    const uint32_t obu_has_size_field = (obuHeader >> 1) & 1;
+    size_t headerSize = 1 + obu_extension_flag;
+    if (dataSize < headerSize) {
+        return false;
+    }
+    m_temporal_id = 0;
+    m_spatial_id = 0;
+    if (obu_extension_flag) {
+        m_temporal_id = (pData[1] >> 5) & 7;
+        m_spatial_id = (pData[1] >> 3) & 3;
+    }
+
+    size_t obuSize = 0;
+    if (obu_has_size_field) {
+        size_t sizeFieldSize = 0;
+        obuSize = leb128(pData + headerSize, dataSize - headerSize, &sizeFieldSize);
+        if (sizeFieldSize == 0) {
+            if ((dataSize - headerSize) >= 8) {
+                nvParserLog("Invalid AV1 OBU size\n");
+                *pObuSize = dataSize;
+                return true;
+            }
+            return false;
+        }
+        headerSize += sizeFieldSize;
+        if ((obuSize > (dataSize - headerSize)) && !endOfTemporalUnit) {
+            return false;
+        }
+        if (obuSize > (dataSize - headerSize)) {
+            nvParserLog("Truncated AV1 OBU (%d/%d bytes)\n", (int32_t)(dataSize - headerSize), (int32_t)obuSize);
+            obuSize = dataSize - headerSize;
+        }
+    } else {
+        // The last OBU of the temporal unit
+        obuSize = dataSize - headerSize;
+    }
+    *pObuSize = headerSize + obuSize;
+    const uint8_t* pPayload = pData + headerSize;
+    m_llNaluStartLocation = m_llParsedBytes;
+    m_llParsedBytes += headerSize + obuSize;
+
+    // The OBUs of the layers not in the operating point are dropped
+    if ((obu_type != AV1_OBU_SEQUENCE_HEADER) && (obu_type != AV1_OBU_TEMPORAL_DELIMITER) &&
+        (m_OperatingPointIdc != 0) && obu_extension_flag) {
+        const uint32_t inTemporalLayer = (m_OperatingPointIdc >> m_temporal_id) & 1;
+        const uint32_t inSpatialLayer = (m_OperatingPointIdc >> (m_spatial_id + 8)) & 1;
+        if (!inTemporalLayer || !inSpatialLayer) {
+            return true;
+        }
+    }
+
+    switch (obu_type) {
+    case AV1_OBU_SEQUENCE_HEADER:
+        sequence_header_obu(pPayload, obuSize);
+        break;
+    case AV1_OBU_TEMPORAL_DELIMITER:
+        if (m_bSeenFrameHeader) {
+            nvParserLog("WARNING: Incomplete AV1 frame dropped\n");
+            if (m_pCurrPic != nullptr) {
+                m_pCurrPic->Release();
+                m_pCurrPic = nullptr;
+            }
+            reset_frame();
+        }
+        m_bSeenFrameHeader = false;
+        break;
+    case AV1_OBU_FRAME_HEADER:
+    case AV1_OBU_REDUNDANT_FRAME_HEADER:
+    case AV1_OBU_FRAME:
+        if (!m_bSequenceHeaderSeen) {
+            break;
+        }
+        if (m_bSeenFrameHeader) {
+            // frame_header_copy(), the tile groups of the frame follow
+            if (obu_type != AV1_OBU_FRAME) {
+                break;
+            }
+        }
+        if (!CopyObuData(pPayload, obuSize)) {
+            break;
+        }
+        if (!m_bSeenFrameHeader) {
+            if (!frame_header_obu()) {
+                m_nalu.end_offset = m_nalu.start_offset;
+                break;
+            }
+            if (!m_bSeenFrameHeader) {
+                // show_existing_frame
+                m_nalu.end_offset = m_nalu.start_offset;
+                break;
+            }
+        } else {
+            // A frame header copy starting a frame OBU: only the tile group of the second one is parsed
+            nvParserLog("WARNING: Unexpected AV1 frame OBU after the frame header\n");
+            m_nalu.end_offset = m_nalu.start_offset;
+            break;
+        }
+        if (obu_type == AV1_OBU_FRAME) {
+            byte_alignment();
+            tile_group_obu();
+        } else {
+            // Only the tile data is decoded
+            m_nalu.end_offset = m_nalu.start_offset;
+        }
+        break;
+    case AV1_OBU_TILE_GROUP:
+        if (!m_bSeenFrameHeader) {
+            break;
+        }
+        if (CopyObuData(pPayload, obuSize)) {
+            tile_group_obu();
+        }
+        break;
+    case AV1_OBU_TILE_LIST:
+        nvParserLog("WARNING: AV1 large scale tile decoding is not supported\n");
+        break;
+    default:
+        // Metadata and padding
+        break;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Syntax helpers (4.10)
+//
+
+int32_t VulkanAV1Decoder::su(uint32_t n)
+{
+    int32_t value = (int32_t)u(n);
+    const int32_t signMask = 1 << (n - 1);
+    if (value & signMask) {
+        value = value - 2 * signMask;
+    }
+    return value;
+}
+
+uint32_t VulkanAV1Decoder::ns(uint32_t n)
+{
+    uint32_t w = 0;
+    uint32_t x = n;
+    while (x != 0) {
+        x >>= 1;
+        w++;
+    }
+    const uint32_t m = (1 << w) - n;
+    const uint32_t v = u(w - 1);
+    if (v < m) {
+        return v;
+    }
+    const uint32_t extra_bit = u(1);
+    return (v << 1) - m + extra_bit;
+}
+
+uint32_t VulkanAV1Decoder::uvlc()
+{
+    uint32_t leadingZeros = 0;
+    while ((leadingZeros < 32) && !u(1)) {
+        leadingZeros++;
+    }
+    if (leadingZeros >= 32) {
+        return UINT32_MAX;
+    }
+    return u(leadingZeros) + (uint32_t)((1ull << leadingZeros) - 1);
+}
+
+int32_t VulkanAV1Decoder::get_relative_dist(uint32_t a, uint32_t b) const
+{
+    if (!m_sps.enable_order_hint) {
+        return 0;
+    }
+    int32_t diff = (int32_t)a - (int32_t)b;
+    const int32_t m = 1 << (m_sps.OrderHintBits - 1);
+    diff = (diff & (m - 1)) - (diff & m);
+    return diff;
+}
+
+static inline int32_t inverse_recenter(int32_t r, int32_t v)
+{
+    if (v > (2 * r)) {
+        return v;
+    } else if (v & 1) {
+        return r - ((v + 1) >> 1);
+    }
+    return r + (v >> 1);
+}
+
+uint32_t VulkanAV1Decoder::decode_subexp(uint32_t numSyms)
+{
+    uint32_t i = 0;
+    uint32_t mk = 0;
+    const uint32_t k = 3;
+    while (true) {
+        const uint32_t b2 = i ? (k + i - 1) : k;
+        const uint32_t a = 1 << b2;
+        if (numSyms <= (mk + 3 * a)) {
+            return ns(numSyms - mk) + mk;
+        }
+        if (!u(1)) {
+            return u(b2) + mk;
+        }
+        i++;
+        mk += a;
+    }
+}
+
+uint32_t VulkanAV1Decoder::decode_unsigned_subexp_with_ref(uint32_t mx, uint32_t r)
+{
+    const uint32_t v = decode_subexp(mx);
+    if ((r << 1) <= mx) {
+        return (uint32_t)inverse_recenter((int32_t)r, (int32_t)v);
+    }
+    return mx - 1 - (uint32_t)inverse_recenter((int32_t)(mx - 1 - r), (int32_t)v);
+}
+
+uint32_t VulkanAV1Decoder::decode_signed_subexp_with_ref(int32_t low, int32_t high, int32_t r)
+{
+    const uint32_t x = decode_unsigned_subexp_with_ref((uint32_t)(high - low), (uint32_t)(r - low));
+    return x + low;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Sequence header (5.5)
+//
+
+bool VulkanAV1Decoder::sequence_header_obu(const uint8_t* pData, size_t size)
+{
+    // Parsed in place of the frame data, which it doesn't interrupt
+    const int64_t frameDataEnd = m_nalu.end_offset;
+    if (!CopyObuData(pData, size)) {
+        return false;
+    }
+
+    av1_seq_header_s sps;
+    memset(&sps, 0, sizeof(sps));
+    sps.seq_profile = u(3);
+    sps.still_picture = u(1);
+    sps.reduced_still_picture_header = u(1);
+    uint32_t initial_display_delay_present_flag = 0;
+    if (sps.reduced_still_picture_header) {
+        sps.seq_level_idx[0] = u(5);
+    } else {
+        sps.timing_info_present_flag = u(1);
+        if (sps.timing_info_present_flag) {
+            sps.num_units_in_display_tick = u(32);
+            sps.time_scale = u(32);
+            sps.equal_picture_interval = u(1);
+            if (sps.equal_picture_interval) {
+                sps.num_ticks_per_picture_minus_1 = uvlc();
+            }
+            sps.decoder_model_info_present_flag = u(1);
+            if (sps.decoder_model_info_present_flag) {
+                sps.buffer_delay_length_minus_1 = u(5);
+                u(32); // num_units_in_decoding_tick
+                sps.buffer_removal_time_length_minus_1 = u(5);
+                sps.frame_presentation_time_length_minus_1 = u(5);
+            }
+        }
+        initial_display_delay_present_flag = u(1);
+        sps.operating_points_cnt_minus_1 = u(5);
+        for (uint32_t i = 0; i <= sps.operating_points_cnt_minus_1; i++) {
+            sps.operating_point_idc[i] = u(12);
+            sps.seq_level_idx[i] = u(5);
+            if (sps.seq_level_idx[i] > 7) {
+                sps.seq_tier[i] = u(1);
+            }
+            if (sps.decoder_model_info_present_flag) {
+                sps.decoder_model_present_for_this_op[i] = u(1);
+                if (sps.decoder_model_present_for_this_op[i]) {
+                    const uint32_t n = sps.buffer_delay_length_minus_1 + 1;
+                    u(n); // decoder_buffer_delay
+                    u(n); // encoder_buffer_delay
+                    u(1); // low_delay_mode_flag
+                }
+            }
+            if (initial_display_delay_present_flag) {
+                if (u(1)) { // initial_display_delay_present_for_this_op
+                    u(4);   // initial_display_delay_minus_1
+                }
+            }
+        }
+    }
+
+    // The operating point is chosen by the client
+    int32_t operatingPoint = 0;
+    if ((m_pClient != nullptr) && (sps.operating_points_cnt_minus_1 > 0)) {
+        VkParserOperatingPointInfo opInfo;
+        memset(&opInfo, 0, sizeof(opInfo));
+        opInfo.eCodec = m_standard;
+        opInfo.av1.operating_points_cnt = (uint8_t)(sps.operating_points_cnt_minus_1 + 1);
+        for (uint32_t i = 0; i <= sps.operating_points_cnt_minus_1; i++) {
+            opInfo.av1.operating_points_idc[i] = (uint16_t)sps.operating_point_idc[i];
+        }
+        operatingPoint = m_pClient->GetOperatingPoint(&opInfo);
+        if ((operatingPoint < 0) || (operatingPoint > (int32_t)sps.operating_points_cnt_minus_1)) {
+            operatingPoint = 0;
+        }
+    }
+    m_OperatingPointIdc = sps.operating_point_idc[operatingPoint];
+
+    sps.frame_width_bits_minus_1 = u(4);
+    sps.frame_height_bits_minus_1 = u(4);
+    sps.max_frame_width_minus_1 = u(sps.frame_width_bits_minus_1 + 1);
+    sps.max_frame_height_minus_1 = u(sps.frame_height_bits_minus_1 + 1);
+    if (!sps.reduced_still_picture_header) {
+        sps.frame_id_numbers_present_flag = u(1);
+    }
+    if (sps.frame_id_numbers_present_flag) {
+        sps.delta_frame_id_length_minus_2 = u(4);
+        sps.additional_frame_id_length_minus_1 = u(3);
+    }
+    sps.use_128x128_superblock = u(1);
+    sps.enable_filter_intra = u(1);
+    sps.enable_intra_edge_filter = u(1);
+    sps.seq_force_screen_content_tools = AV1_SELECT_SCREEN_CONTENT_TOOLS;
+    sps.seq_force_integer_mv = AV1_SELECT_INTEGER_MV;
+    if (!sps.reduced_still_picture_header) {
+        sps.enable_interintra_compound = u(1);
+        sps.enable_masked_compound = u(1);
+        sps.enable_warped_motion = u(1);
+        sps.enable_dual_filter = u(1);
+        sps.enable_order_hint = u(1);
+        if (sps.enable_order_hint) {
+            sps.enable_jnt_comp = u(1);
+            sps.enable_ref_frame_mvs = u(1);
+        }
+        const uint32_t seq_choose_screen_content_tools = u(1);
+        if (!seq_choose_screen_content_tools) {
+            sps.seq_force_screen_content_tools = u(1);
+        }
+        if (sps.seq_force_screen_content_tools > 0) {
+            const uint32_t seq_choose_integer_mv = u(1);
+            if (!seq_choose_integer_mv) {
+                sps.seq_force_integer_mv = u(1);
+            }
+        }
+        if (sps.enable_order_hint) {
+            sps.OrderHintBits = u(3) + 1;
+        }
+    }
+    sps.enable_superres = u(1);
+    sps.enable_cdef = u(1);
+    sps.enable_restoration = u(1);
+    m_sps = sps;
+    color_config();
+    m_sps.film_grain_params_present = u(1);
+    m_bSequenceHeaderSeen = true;
+
+    VkParserSequenceInfo nvsi;
+    memset(&nvsi, 0, sizeof(nvsi));
+    nvsi.eCodec = m_standard;
+    nvsi.frameRate = NV_FRAME_RATE_UNKNOWN;
+    if (m_sps.timing_info_present_flag && m_sps.equal_picture_interval && (m_sps.num_units_in_display_tick > 0)) {
+        const uint64_t ticks = (uint64_t)m_sps.num_units_in_display_tick * ((uint64_t)m_sps.num_ticks_per_picture_minus_1 + 1);
+        if ((ticks <= UINT32_MAX) && (m_sps.time_scale >= ticks)) { // >= 1Hz
+            nvsi.frameRate = PackFrameRate(m_sps.time_scale, (uint32_t)ticks);
+        }
+    }
+    nvsi.bProgSeq = 1;
+    nvsi.nCodedWidth = m_sps.max_frame_width_minus_1 + 1;
+    nvsi.nCodedHeight = m_sps.max_frame_height_minus_1 + 1;
+    nvsi.nDisplayWidth = nvsi.nCodedWidth;
+    nvsi.nDisplayHeight = nvsi.nCodedHeight;
+    nvsi.nMaxWidth = nvsi.nCodedWidth;
+    nvsi.nMaxHeight = nvsi.nCodedHeight;
+    nvsi.nChromaFormat = m_sps.mono_chrome ? 0 : (m_sps.subsampling_x && m_sps.subsampling_y) ? 1 : m_sps.subsampling_x ? 2 : 3;
+    nvsi.uBitDepthLumaMinus8 = (uint8_t)(m_sps.BitDepth - 8);
+    nvsi.uBitDepthChromaMinus8 = (uint8_t)(m_sps.BitDepth - 8);
+    nvsi.uVideoFullRange = (uint8_t)m_sps.color_range;
+    nvsi.lDARWidth = nvsi.nDisplayWidth;
+    nvsi.lDARHeight = nvsi.nDisplayHeight;
+    SimplifyAspectRatio(&nvsi.lDARWidth, &nvsi.lDARHeight);
+    nvsi.lVideoFormat = VideoFormatUnspecified;
+    nvsi.lColorPrimaries = m_sps.color_primaries;
+    nvsi.lTransferCharacteristics = m_sps.transfer_characteristics;
+    nvsi.lMatrixCoefficients = m_sps.matrix_coefficients;
+    // The reference frames, the current one and the ones waiting for display
+    nvsi.nMinNumDpbSlots = AV1_NUM_REF_FRAMES + 1;
+    nvsi.nMinNumDecodeSurfaces = AV1_NUM_REF_FRAMES + 3;
+    nvsi.codecProfile = m_sps.seq_profile;
+    if (size <= VK_MAX_SEQ_HDR_LEN) {
+        nvsi.cbSequenceHeader = (int32_t)size;
+        memcpy(nvsi.SequenceHeaderData, pData, size);
+    }
+
+    m_nalu.start_offset = frameDataEnd;
+    m_nalu.end_offset = frameDataEnd;
+
+    return (init_sequence(&nvsi) != 0);
+}
+
+void VulkanAV1Decoder::color_config()
+{
+    av1_seq_header_s& sps = m_sps;
+    const uint32_t high_bitdepth = u(1);
+    if ((sps.seq_profile == 2) && high_bitdepth) {
+        sps.BitDepth = u(1) ? 12 : 10; // twelve_bit
+    } else {
+        sps.BitDepth = high_bitdepth ? 10 : 8;
+    }
+    sps.mono_chrome = (sps.seq_profile == 1) ? 0 : u(1);
+    sps.color_primaries = ColorPrimariesUnspecified;
+    sps.transfer_characteristics = TransferCharacteristicsUnspecified;
+    sps.matrix_coefficients = MatrixCoefficientsUnspecified;
+    if (u(1)) { // color_description_present_flag
+        sps.color_primaries = u(8);
+        sps.transfer_characteristics = u(8);
+        sps.matrix_coefficients = u(8);
+    }
+    if (sps.mono_chrome) {
+        sps.color_range = u(1);
+        sps.subsampling_x = 1;
+        sps.subsampling_y = 1;
+        sps.separate_uv_delta_q = 0;
+        return;
+    } else if ((sps.color_primaries == ColorPrimariesBT709) &&
+               (sps.transfer_characteristics == TransferCharacteristicsIEC61966_2_1) &&
+               (sps.matrix_coefficients == 0)) { // sRGB
+        sps.color_range = 1;
+        sps.subsampling_x = 0;
+        sps.subsampling_y = 0;
+    } else {
+        sps.color_range = u(1);
+        if (sps.seq_profile == 0) {
+            sps.subsampling_x = 1;
+            sps.subsampling_y = 1;
+        } else if (sps.seq_profile == 1) {
+            sps.subsampling_x = 0;
+            sps.subsampling_y = 0;
+        } else if (sps.BitDepth == 12) {
+            sps.subsampling_x = u(1);
+            sps.subsampling_y = sps.subsampling_x ? u(1) : 0;
+        } else {
+            sps.subsampling_x = 1;
+            sps.subsampling_y = 0;
+        }
+        if (sps.subsampling_x && sps.subsampling_y) {
+            sps.chroma_sample_position = u(2);
+        }
+    }
+    sps.separate_uv_delta_q = u(1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Frame header (5.9)
+//
+
+// Returns false if the frame can't be decoded. m_bSeenFrameHeader is left clear for the frames shown again.
+bool VulkanAV1Decoder::frame_header_obu()
+{
+    m_bSkipFrame = false;
+    m_tileSizes.clear();
+    m_bitstreamData.ResetStreamMarkers();
+    if (!uncompressed_header()) {
+        return false;
+    }
+    if (m_show_existing_frame) {
+        show_existing_frame();
+        return true;
+    }
+    if (m_bSkipFrame) {
+        return false;
+    }
+
+    if ((m_pCurrPic == nullptr) && !m_pClient->AllocPictureBuffer(&m_pCurrPic)) {
+        nvParserLog("WARNING: Failed to allocate frame buffer picture\n");
+        m_pCurrPic = nullptr;
+    }
+    if (m_pCurrPic != nullptr) {
+        m_pCurrPic->decodeWidth = m_FrameWidth;
+        m_pCurrPic->decodeHeight = m_FrameHeight;
+        m_pCurrPic->decodeSuperResWidth = m_UpscaledWidth;
+    }
+    m_bSeenFrameHeader = true;
+    return true;
+}
+
+bool VulkanAV1Decoder::uncompressed_header()
+{
+    const av1_seq_header_s& sps = m_sps;
+    VkParserAv1PictureData& pic = m_PicData;
+    memset(&pic, 0, sizeof(pic));
+
+    uint32_t idLen = 0;
+    if (sps.frame_id_numbers_present_flag) {
+        idLen = sps.additional_frame_id_length_minus_1 + sps.delta_frame_id_length_minus_2 + 3;
+    }
+    const uint32_t allFrames = (1 << AV1_NUM_REF_FRAMES) - 1;
+    m_show_existing_frame = 0;
+    m_showable_frame = 0;
+    if (sps.reduced_still_picture_header) {
+        pic.frame_type = AV1_KEY_FRAME;
+        m_FrameIsIntra = 1;
+        pic.show_frame = 1;
+    } else {
+        m_show_existing_frame = u(1);
+        if (m_show_existing_frame) {
+            m_frame_to_show_map_idx = u(3);
+            if (sps.decoder_model_info_present_flag && !sps.equal_picture_interval) {
+                u(sps.frame_presentation_time_length_minus_1 + 1); // temporal_point_info()
+            }
+            m_refresh_frame_flags = 0;
+            if (sps.frame_id_numbers_present_flag) {
+                u(idLen); // display_frame_id
+            }
+            pic.frame_type = m_refFrames[m_frame_to_show_map_idx].RefFrameType;
+            if (pic.frame_type == AV1_KEY_FRAME) {
+                m_refresh_frame_flags = allFrames;
+            }
+            if (sps.film_grain_params_present) {
+                pic.fgs = m_refFrames[m_frame_to_show_map_idx].film_grain; // load_grain_params()
+            }
+            return true;
+        }
+        pic.frame_type = u(2);
+        m_FrameIsIntra = (pic.frame_type == AV1_INTRA_ONLY_FRAME) || (pic.frame_type == AV1_KEY_FRAME);
+        pic.show_frame = u(1);
+        if (pic.show_frame && sps.decoder_model_info_present_flag && !sps.equal_picture_interval) {
+            u(sps.frame_presentation_time_length_minus_1 + 1); // temporal_point_info()
+        }
+        m_showable_frame = pic.show_frame ? (pic.frame_type != AV1_KEY_FRAME) : u(1);
+        if ((pic.frame_type == AV1_SWITCH_FRAME) || ((pic.frame_type == AV1_KEY_FRAME) && pic.show_frame)) {
+            pic.error_resilient_mode = 1;
+        } else {
+            pic.error_resilient_mode = u(1);
+        }
+    }
+    if ((pic.frame_type == AV1_KEY_FRAME) && pic.show_frame) {
+        for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+            m_refFrames[i].RefValid = 0;
+            m_refFrames[i].RefOrderHint = 0;
+        }
+        for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+            m_OrderHints[AV1_LAST_FRAME + i] = 0;
+        }
+    }
+    pic.disable_cdf_update = u(1);
+    if (sps.seq_force_screen_content_tools == AV1_SELECT_SCREEN_CONTENT_TOOLS) {
+        pic.allow_screen_content_tools = u(1);
+    } else {
+        pic.allow_screen_content_tools = sps.seq_force_screen_content_tools;
+    }
+    if (pic.allow_screen_content_tools) {
+        if (sps.seq_force_integer_mv == AV1_SELECT_INTEGER_MV) {
+            pic.force_integer_mv = u(1);
+        } else {
+            pic.force_integer_mv = sps.seq_force_integer_mv;
+        }
+    }
+    if (m_FrameIsIntra) {
+        pic.force_integer_mv = 1;
+    }
+    if (sps.frame_id_numbers_present_flag) {
+        m_current_frame_id = u(idLen);
+        mark_ref_frames(idLen);
+    } else {
+        m_current_frame_id = 0;
+    }
+    if (pic.frame_type == AV1_SWITCH_FRAME) {
+        m_frame_size_override_flag = 1;
+    } else if (sps.reduced_still_picture_header) {
+        m_frame_size_override_flag = 0;
+    } else {
+        m_frame_size_override_flag = u(1);
+    }
+    m_OrderHint = u(sps.OrderHintBits);
+    if (m_FrameIsIntra || pic.error_resilient_mode) {
+        pic.primary_ref_frame = AV1_PRIMARY_REF_NONE;
+    } else {
+        pic.primary_ref_frame = (uint8_t)u(3);
+    }
+    if (sps.decoder_model_info_present_flag) {
+        const uint32_t buffer_removal_time_present_flag = u(1);
+        if (buffer_removal_time_present_flag) {
+            for (uint32_t opNum = 0; opNum <= sps.operating_points_cnt_minus_1; opNum++) {
+                if (sps.decoder_model_present_for_this_op[opNum]) {
+                    const uint32_t opPtIdc = sps.operating_point_idc[opNum];
+                    const uint32_t inTemporalLayer = (opPtIdc >> m_temporal_id) & 1;
+                    const uint32_t inSpatialLayer = (opPtIdc >> (m_spatial_id + 8)) & 1;
+                    if ((opPtIdc == 0) || (inTemporalLayer && inSpatialLayer)) {
+                        u(sps.buffer_removal_time_length_minus_1 + 1); // buffer_removal_time
+                    }
+                }
+            }
+        }
+    }
+    if ((pic.frame_type == AV1_SWITCH_FRAME) || ((pic.frame_type == AV1_KEY_FRAME) && pic.show_frame)) {
+        m_refresh_frame_flags = allFrames;
+    } else {
+        m_refresh_frame_flags = u(8);
+    }
+    if (!m_FrameIsIntra || (m_refresh_frame_flags != allFrames)) {
+        if (pic.error_resilient_mode && sps.enable_order_hint) {
+            for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+                const uint32_t ref_order_hint = u(sps.OrderHintBits);
+                if (ref_order_hint != m_refFrames[i].RefOrderHint) {
+                    m_refFrames[i].RefValid = 0;
+                    m_refFrames[i].RefOrderHint = ref_order_hint;
+                }
+            }
+        }
+    }
+
+    if (m_FrameIsIntra) {
+        frame_size();
+        render_size();
+        if (pic.allow_screen_content_tools && (m_UpscaledWidth == m_FrameWidth)) {
+            pic.allow_intrabc = u(1);
+        }
+    } else {
+        uint32_t frame_refs_short_signaling = 0;
+        if (sps.enable_order_hint) {
+            frame_refs_short_signaling = u(1);
+            if (frame_refs_short_signaling) {
+                const uint32_t last_frame_idx = u(3);
+                const uint32_t gold_frame_idx = u(3);
+                set_frame_refs(last_frame_idx, gold_frame_idx);
+            }
+        }
+        for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+            if (!frame_refs_short_signaling) {
+                m_ref_frame_idx[i] = u(3);
+            }
+            if (sps.frame_id_numbers_present_flag) {
+                u(sps.delta_frame_id_length_minus_2 + 2); // delta_frame_id_minus_1
+            }
+            const av1_ref_frame_s& ref = m_refFrames[m_ref_frame_idx[i]];
+            if (!ref.RefValid || (ref.pPicBuf == nullptr)) {
+                m_bSkipFrame = true;
+            }
+        }
+        if (m_bSkipFrame) {
+            nvParserLog("WARNING: Missing AV1 reference frame, frame dropped\n");
+            return true;
+        }
+        if (m_frame_size_override_flag && !pic.error_resilient_mode) {
+            frame_size_with_refs();
+        } else {
+            frame_size();
+            render_size();
+        }
+        if (pic.force_integer_mv) {
+            pic.allow_high_precision_mv = 0;
+        } else {
+            pic.allow_high_precision_mv = u(1);
+        }
+        const uint32_t is_filter_switchable = u(1);
+        pic.interp_filter = is_filter_switchable ? 4 : u(2); // SWITCHABLE
+        pic.switchable_motion_mode = u(1);
+        if (pic.error_resilient_mode || !sps.enable_ref_frame_mvs) {
+            pic.use_ref_frame_mvs = 0;
+        } else {
+            pic.use_ref_frame_mvs = u(1);
+        }
+        for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+            m_OrderHints[AV1_LAST_FRAME + i] = m_refFrames[m_ref_frame_idx[i]].RefOrderHint;
+        }
+    }
+
+    if ((m_FrameWidth > (sps.max_frame_width_minus_1 + 1)) || (m_FrameHeight > (sps.max_frame_height_minus_1 + 1))) {
+        nvParserLog("WARNING: AV1 frame size %dx%d larger than the sequence maximum\n", m_FrameWidth, m_FrameHeight);
+        return false;
+    }
+
+    if (sps.reduced_still_picture_header || pic.disable_cdf_update) {
+        pic.disable_frame_end_update_cdf = 1;
+    } else {
+        pic.disable_frame_end_update_cdf = u(1);
+    }
+    if (pic.primary_ref_frame == AV1_PRIMARY_REF_NONE) {
+        setup_past_independence();
+    } else {
+        load_previous();
+    }
+    tile_info();
+    quantization_params();
+    segmentation_params();
+    delta_q_lf_params();
+    compute_lossless();
+    loop_filter_params();
+    cdef_params();
+    lr_params();
+    if (pic.coded_lossless) {
+        pic.tx_mode = 0; // ONLY_4X4
+    } else {
+        pic.tx_mode = u(1) ? 2 : 1; // TX_MODE_SELECT : TX_MODE_LARGEST
+    }
+    pic.reference_mode = m_FrameIsIntra ? 0 : u(1); // reference_select
+    skip_mode_params();
+    if (m_FrameIsIntra || pic.error_resilient_mode || !sps.enable_warped_motion) {
+        pic.allow_warped_motion = 0;
+    } else {
+        pic.allow_warped_motion = u(1);
+    }
+    pic.reduced_tx_set = u(1);
+    global_motion_params();
+    film_grain_params();
+
+    // Sequence state of the picture
+    pic.profile = sps.seq_profile;
+    pic.use_128x128_superblock = sps.use_128x128_superblock;
+    pic.subsampling_x = sps.subsampling_x;
+    pic.subsampling_y = sps.subsampling_y;
+    pic.mono_chrome = sps.mono_chrome;
+    pic.bit_depth_minus8 = sps.BitDepth - 8;
+    pic.enable_filter_intra = sps.enable_filter_intra;
+    pic.enable_intra_edge_filter = sps.enable_intra_edge_filter;
+    pic.enable_interintra_compound = sps.enable_interintra_compound;
+    pic.enable_masked_compound = sps.enable_masked_compound;
+    pic.enable_dual_filter = sps.enable_dual_filter;
+    pic.enable_order_hint = sps.enable_order_hint;
+    pic.order_hint_bits_minus1 = sps.enable_order_hint ? (sps.OrderHintBits - 1) : 0;
+    pic.enable_jnt_comp = sps.enable_jnt_comp;
+    pic.enable_superres = sps.enable_superres;
+    pic.enable_cdef = sps.enable_cdef;
+    pic.enable_restoration = sps.enable_restoration;
+    pic.enable_fgs = sps.film_grain_params_present;
+    pic.width = m_FrameWidth;
+    pic.superres_width = m_UpscaledWidth;
+    pic.height = m_FrameHeight;
+    pic.frame_offset = m_OrderHint;
+    pic.temporal_layer_id = (uint8_t)m_temporal_id;
+    pic.spatial_layer_id = (uint8_t)m_spatial_id;
+    for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+        pic.ref_frame[i] = m_FrameIsIntra ? 0 : (uint8_t)m_ref_frame_idx[i];
+        for (uint32_t j = 0; j < 6; j++) {
+            pic.ref_global_motion[i].wmmat[j] = m_gm_params[AV1_LAST_FRAME + i][j];
+        }
+    }
+    return true;
+}
+
+void VulkanAV1Decoder::mark_ref_frames(uint32_t idLen)
+{
+    const uint32_t diffLen = m_sps.delta_frame_id_length_minus_2 + 2;
+    for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+        const uint32_t refFrameId = m_refFrames[i].RefFrameId;
+        if (m_current_frame_id > (1u << diffLen)) {
+            if ((refFrameId > m_current_frame_id) || (refFrameId < (m_current_frame_id - (1u << diffLen)))) {
+                m_refFrames[i].RefValid = 0;
+            }
+        } else if ((refFrameId > m_current_frame_id) &&
+                   (refFrameId < ((1u << idLen) + m_current_frame_id - (1u << diffLen)))) {
+            m_refFrames[i].RefValid = 0;
+        }
+    }
+}
+
+void VulkanAV1Decoder::frame_size()
+{
+    if (m_frame_size_override_flag) {
+        m_FrameWidth = u(m_sps.frame_width_bits_minus_1 + 1) + 1;
+        m_FrameHeight = u(m_sps.frame_height_bits_minus_1 + 1) + 1;
+    } else {
+        m_FrameWidth = m_sps.max_frame_width_minus_1 + 1;
+        m_FrameHeight = m_sps.max_frame_height_minus_1 + 1;
+    }
+    superres_params();
+}
+
+// Also compute_image_size()
+void VulkanAV1Decoder::superres_params()
+{
+    uint32_t SuperresDenom = 8;
+    m_PicData.use_superres = m_sps.enable_superres ? u(1) : 0;
+    if (m_PicData.use_superres) {
+        m_PicData.coded_denom = u(3);
+        SuperresDenom = m_PicData.coded_denom + 9;
+    }
+    m_UpscaledWidth = m_FrameWidth;
+    m_FrameWidth = (m_UpscaledWidth * 8 + (SuperresDenom / 2)) / SuperresDenom;
+    m_MiCols = 2 * ((m_FrameWidth + 7) >> 3);
+    m_MiRows = 2 * ((m_FrameHeight + 7) >> 3);
+}
+
+void VulkanAV1Decoder::render_size()
+{
+    const uint32_t render_and_frame_size_different = u(1);
+    if (render_and_frame_size_different) {
+        m_RenderWidth = u(16) + 1;
+        m_RenderHeight = u(16) + 1;
+    } else {
+        m_RenderWidth = m_UpscaledWidth;
+        m_RenderHeight = m_FrameHeight;
+    }
+}
+
+void VulkanAV1Decoder::frame_size_with_refs()
+{
+    for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+        if (u(1)) { // found_ref
+            const av1_ref_frame_s& ref = m_refFrames[m_ref_frame_idx[i]];
+            m_UpscaledWidth = ref.RefUpscaledWidth;
+            m_FrameWidth = m_UpscaledWidth;
+            m_FrameHeight = ref.RefFrameHeight;
+            m_RenderWidth = ref.RefRenderWidth;
+            m_RenderHeight = ref.RefRenderHeight;
+            superres_params();
+            return;
+        }
+    }
+    frame_size();
+    render_size();
+}
+
+// The references of the frame from the last and golden ones (7.8)
+void VulkanAV1Decoder::set_frame_refs(uint32_t last_frame_idx, uint32_t gold_frame_idx)
+{
+    static const uint32_t Ref_Frame_List[AV1_REFS_PER_FRAME - 2] = {
+        AV1_LAST2_FRAME, AV1_LAST3_FRAME, AV1_BWDREF_FRAME, AV1_ALTREF2_FRAME, AV1_ALTREF_FRAME };
+
+    bool usedFrame[AV1_NUM_REF_FRAMES] = {};
+    int32_t shiftedOrderHints[AV1_NUM_REF_FRAMES];
+    for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+        m_ref_frame_idx[i] = -1;
+    }
+    m_ref_frame_idx[AV1_LAST_FRAME - AV1_LAST_FRAME] = last_frame_idx;
+    m_ref_frame_idx[AV1_GOLDEN_FRAME - AV1_LAST_FRAME] = gold_frame_idx;
+    usedFrame[last_frame_idx] = true;
+    usedFrame[gold_frame_idx] = true;
+    const int32_t curFrameHint = 1 << (m_sps.OrderHintBits - 1);
+    for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+        shiftedOrderHints[i] = curFrameHint + get_relative_dist(m_refFrames[i].RefOrderHint, m_OrderHint);
+    }
+
+    // find_latest_backward() for ALTREF, find_earliest_backward() for BWDREF and ALTREF2
+    {
+        int32_t ref = -1;
+        int32_t latestOrderHint = 0;
+        for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+            const int32_t hint = shiftedOrderHints[i];
+            if (!usedFrame[i] && (hint >= curFrameHint) && ((ref < 0) || (hint >= latestOrderHint))) {
+                ref = i;
+                latestOrderHint = hint;
+            }
+        }
+        if (ref >= 0) {
+            m_ref_frame_idx[AV1_ALTREF_FRAME - AV1_LAST_FRAME] = ref;
+            usedFrame[ref] = true;
+        }
+    }
+    const uint32_t earliestBackwardRefs[2] = { AV1_BWDREF_FRAME, AV1_ALTREF2_FRAME };
+    for (uint32_t r = 0; r < 2; r++) {
+        int32_t ref = -1;
+        int32_t earliestOrderHint = 0;
+        for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+            const int32_t hint = shiftedOrderHints[i];
+            if (!usedFrame[i] && (hint >= curFrameHint) && ((ref < 0) || (hint < earliestOrderHint))) {
+                ref = i;
+                earliestOrderHint = hint;
+            }
+        }
+        if (ref >= 0) {
+            m_ref_frame_idx[earliestBackwardRefs[r] - AV1_LAST_FRAME] = ref;
+            usedFrame[ref] = true;
+        }
+    }
+
+    // find_latest_forward() for the remaining ones
+    for (uint32_t j = 0; j < (AV1_REFS_PER_FRAME - 2); j++) {
+        const uint32_t refFrame = Ref_Frame_List[j];
+        if (m_ref_frame_idx[refFrame - AV1_LAST_FRAME] < 0) {
+            int32_t ref = -1;
+            int32_t latestOrderHint = 0;
+            for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+                const int32_t hint = shiftedOrderHints[i];
+                if (!usedFrame[i] && (hint < curFrameHint) && ((ref < 0) || (hint >= latestOrderHint))) {
+                    ref = i;
+                    latestOrderHint = hint;
+                }
+            }
+            if (ref >= 0) {
+                m_ref_frame_idx[refFrame - AV1_LAST_FRAME] = ref;
+                usedFrame[ref] = true;
+            }
+        }
+    }
+
+    // The earliest frame for the references left
+    int32_t ref = -1;
+    int32_t earliestOrderHint = 0;
+    for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+        const int32_t hint = shiftedOrderHints[i];
+        if ((ref < 0) || (hint < earliestOrderHint)) {
+            ref = i;
+            earliestOrderHint = hint;
+        }
+    }
+    for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+        if (m_ref_frame_idx[i] < 0) {
+            m_ref_frame_idx[i] = ref;
+        }
+    }
+}
+
+void VulkanAV1Decoder::setup_past_independence()
+{
+    memset(m_FeatureEnabled, 0, sizeof(m_FeatureEnabled));
+    memset(m_FeatureData, 0, sizeof(m_FeatureData));
+    for (uint32_t ref = AV1_LAST_FRAME; ref <= AV1_ALTREF_FRAME; ref++) {
+        for (uint32_t i = 0; i < 6; i++) {
+            m_PrevGmParams[ref][i] = ((i % 3) == 2) ? (1 << AV1_WARPEDMODEL_PREC_BITS) : 0;
+        }
+    }
+    m_PicData.loop_filter_delta_enabled = 1;
+    static const int8_t defaultRefDeltas[AV1_NUM_REF_FRAMES] = { 1, 0, 0, 0, -1, 0, -1, -1 };
+    memcpy(m_PicData.loop_filter_ref_deltas, defaultRefDeltas, sizeof(defaultRefDeltas));
+    memset(m_PicData.loop_filter_mode_deltas, 0, sizeof(m_PicData.loop_filter_mode_deltas));
+}
+
+void VulkanAV1Decoder::load_previous()
+{
+    const av1_ref_frame_s& prevFrame = m_refFrames[m_ref_frame_idx[m_PicData.primary_ref_frame]];
+    memcpy(m_PrevGmParams, prevFrame.SavedGmParams, sizeof(m_PrevGmParams));
+    memcpy(m_PicData.loop_filter_ref_deltas, prevFrame.loop_filter_ref_deltas, sizeof(prevFrame.loop_filter_ref_deltas));
+    memcpy(m_PicData.loop_filter_mode_deltas, prevFrame.loop_filter_mode_deltas, sizeof(prevFrame.loop_filter_mode_deltas));
+    memcpy(m_FeatureEnabled, prevFrame.FeatureEnabled, sizeof(m_FeatureEnabled));
+    memcpy(m_FeatureData, prevFrame.FeatureData, sizeof(m_FeatureData));
+}
+
+void VulkanAV1Decoder::tile_info()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    const uint32_t sbCols = m_sps.use_128x128_superblock ? ((m_MiCols + 31) >> 5) : ((m_MiCols + 15) >> 4);
+    const uint32_t sbRows = m_sps.use_128x128_superblock ? ((m_MiRows + 31) >> 5) : ((m_MiRows + 15) >> 4);
+    const uint32_t sbShift = m_sps.use_128x128_superblock ? 5 : 4;
+    const uint32_t sbSize = sbShift + 2;
+    const uint32_t maxTileWidthSb = AV1_MAX_TILE_WIDTH >> sbSize;
+    uint32_t maxTileAreaSb = AV1_MAX_TILE_AREA >> (2 * sbSize);
+    const uint32_t minLog2TileCols = tile_log2(maxTileWidthSb, sbCols);
+    const uint32_t maxLog2TileCols = tile_log2(1, std::min<uint32_t>(sbCols, AV1_MAX_TILE_COLS));
+    const uint32_t maxLog2TileRows = tile_log2(1, std::min<uint32_t>(sbRows, AV1_MAX_TILE_ROWS));
+    const uint32_t minLog2Tiles = std::max<uint32_t>(minLog2TileCols, tile_log2(maxTileAreaSb, sbRows * sbCols));
+
+    uint32_t tileCols = 0;
+    uint32_t tileRows = 0;
+    const uint32_t uniform_tile_spacing_flag = u(1);
+    if (uniform_tile_spacing_flag) {
+        m_TileColsLog2 = minLog2TileCols;
+        while ((m_TileColsLog2 < maxLog2TileCols) && u(1)) { // increment_tile_cols_log2
+            m_TileColsLog2++;
+        }
+        const uint32_t tileWidthSb = (sbCols + (1 << m_TileColsLog2) - 1) >> m_TileColsLog2;
+        for (uint32_t startSb = 0; (startSb < sbCols) && (tileCols < AV1_MAX_TILE_COLS); startSb += tileWidthSb) {
+            pic.tile_col_start_sb[tileCols++] = (uint16_t)startSb;
+        }
+        pic.tile_col_start_sb[tileCols] = (uint16_t)sbCols;
+
+        const uint32_t minLog2TileRows = (minLog2Tiles > m_TileColsLog2) ? (minLog2Tiles - m_TileColsLog2) : 0;
+        m_TileRowsLog2 = minLog2TileRows;
+        while ((m_TileRowsLog2 < maxLog2TileRows) && u(1)) { // increment_tile_rows_log2
+            m_TileRowsLog2++;
+        }
+        const uint32_t tileHeightSb = (sbRows + (1 << m_TileRowsLog2) - 1) >> m_TileRowsLog2;
+        for (uint32_t startSb = 0; (startSb < sbRows) && (tileRows < AV1_MAX_TILE_ROWS); startSb += tileHeightSb) {
+            pic.tile_row_start_sb[tileRows++] = (uint16_t)startSb;
+        }
+        pic.tile_row_start_sb[tileRows] = (uint16_t)sbRows;
+    } else {
+        uint32_t widestTileSb = 0;
+        uint32_t startSb = 0;
+        for (; (startSb < sbCols) && (tileCols < AV1_MAX_TILE_COLS); tileCols++) {
+            pic.tile_col_start_sb[tileCols] = (uint16_t)startSb;
+            const uint32_t maxWidth = std::min<uint32_t>(sbCols - startSb, maxTileWidthSb);
+            const uint32_t sizeSb = ns(maxWidth) + 1; // width_in_sbs_minus_1
+            widestTileSb = std::max<uint32_t>(sizeSb, widestTileSb);
+            startSb += sizeSb;
+        }
+        pic.tile_col_start_sb[tileCols] = (uint16_t)sbCols;
+        m_TileColsLog2 = tile_log2(1, tileCols);
+
+        if (minLog2Tiles > 0) {
+            maxTileAreaSb = (sbRows * sbCols) >> (minLog2Tiles + 1);
+        } else {
+            maxTileAreaSb = sbRows * sbCols;
+        }
+        const uint32_t maxTileHeightSb = std::max<uint32_t>(maxTileAreaSb / widestTileSb, 1);
+        startSb = 0;
+        for (; (startSb < sbRows) && (tileRows < AV1_MAX_TILE_ROWS); tileRows++) {
+            pic.tile_row_start_sb[tileRows] = (uint16_t)startSb;
+            const uint32_t maxHeight = std::min<uint32_t>(sbRows - startSb, maxTileHeightSb);
+            const uint32_t sizeSb = ns(maxHeight) + 1; // height_in_sbs_minus_1
+            startSb += sizeSb;
+        }
+        pic.tile_row_start_sb[tileRows] = (uint16_t)sbRows;
+        m_TileRowsLog2 = tile_log2(1, tileRows);
+    }
+    pic.num_tile_cols = tileCols;
+    pic.num_tile_rows = tileRows;
+    if ((m_TileColsLog2 > 0) || (m_TileRowsLog2 > 0)) {
+        pic.context_update_tile_id = u(m_TileRowsLog2 + m_TileColsLog2);
+        m_TileSizeBytes = u(2) + 1;
+    } else {
+        pic.context_update_tile_id = 0;
+        m_TileSizeBytes = 4;
+    }
+}
+
+int32_t VulkanAV1Decoder::read_delta_q()
+{
+    if (u(1)) { // delta_coded
+        return su(1 + 6);
+    }
+    return 0;
+}
+
+void VulkanAV1Decoder::quantization_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    pic.base_qindex = (uint8_t)u(8);
+    m_DeltaQYDc = read_delta_q();
+    m_DeltaQUDc = m_DeltaQUAc = m_DeltaQVDc = m_DeltaQVAc = 0;
+    if (!m_sps.mono_chrome) {
+        const uint32_t diff_uv_delta = m_sps.separate_uv_delta_q ? u(1) : 0;
+        m_DeltaQUDc = read_delta_q();
+        m_DeltaQUAc = read_delta_q();
+        if (diff_uv_delta) {
+            m_DeltaQVDc = read_delta_q();
+            m_DeltaQVAc = read_delta_q();
+        } else {
+            m_DeltaQVDc = m_DeltaQUDc;
+            m_DeltaQVAc = m_DeltaQUAc;
+        }
+    }
+    pic.qp_y_dc_delta_q = (int8_t)m_DeltaQYDc;
+    pic.qp_u_dc_delta_q = (int8_t)m_DeltaQUDc;
+    pic.qp_u_ac_delta_q = (int8_t)m_DeltaQUAc;
+    pic.qp_v_dc_delta_q = (int8_t)m_DeltaQVDc;
+    pic.qp_v_ac_delta_q = (int8_t)m_DeltaQVAc;
+    pic.using_qmatrix = u(1);
+    if (pic.using_qmatrix) {
+        pic.qm_y = (int8_t)u(4);
+        pic.qm_u = (int8_t)u(4);
+        pic.qm_v = m_sps.separate_uv_delta_q ? (int8_t)u(4) : pic.qm_u;
+    }
+}
+
+void VulkanAV1Decoder::segmentation_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    pic.segmentation_enabled = (uint8_t)u(1);
+    if (pic.segmentation_enabled) {
+        if (pic.primary_ref_frame == AV1_PRIMARY_REF_NONE) {
+            pic.segmentation_update_map = 1;
+            pic.segmentation_temporal_update = 0;
+            pic.segmentation_update_data = 1;
+        } else {
+            pic.segmentation_update_map = (uint8_t)u(1);
+            pic.segmentation_temporal_update = pic.segmentation_update_map ? (uint8_t)u(1) : 0;
+            pic.segmentation_update_data = (uint8_t)u(1);
+        }
+        if (pic.segmentation_update_data) {
+            for (uint32_t i = 0; i < AV1_MAX_SEGMENTS; i++) {
+                for (uint32_t j = 0; j < AV1_SEG_LVL_MAX; j++) {
+                    int32_t clippedValue = 0;
+                    m_FeatureEnabled[i][j] = (uint8_t)u(1);
+                    if (m_FeatureEnabled[i][j]) {
+                        const uint32_t bitsToRead = Segmentation_Feature_Bits[j];
+                        const int32_t limit = Segmentation_Feature_Max[j];
+                        if (Segmentation_Feature_Signed[j]) {
+                            clippedValue = Clip3(-limit, limit, su(1 + bitsToRead));
+                        } else {
+                            clippedValue = Clip3(0, limit, (int32_t)u(bitsToRead));
+                        }
+                    }
+                    m_FeatureData[i][j] = (int16_t)clippedValue;
+                }
+            }
+        }
+    } else {
+        memset(m_FeatureEnabled, 0, sizeof(m_FeatureEnabled));
+        memset(m_FeatureData, 0, sizeof(m_FeatureData));
+    }
+    pic.last_active_segid = 0;
+    pic.segid_preskip = 0;
+    for (uint32_t i = 0; i < AV1_MAX_SEGMENTS; i++) {
+        for (uint32_t j = 0; j < AV1_SEG_LVL_MAX; j++) {
+            pic.segmentation_feature_enable[i][j] = m_FeatureEnabled[i][j];
+            pic.segmentation_feature_data[i][j] = m_FeatureData[i][j];
+            if (m_FeatureEnabled[i][j]) {
+                pic.last_active_segid = i;
+                if (j >= AV1_SEG_LVL_REF_FRAME) {
+                    pic.segid_preskip = 1;
+                }
+            }
+        }
+    }
+}
+
+void VulkanAV1Decoder::delta_q_lf_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    if (pic.base_qindex > 0) {
+        pic.delta_q_present = u(1);
+    }
+    if (pic.delta_q_present) {
+        pic.delta_q_res = u(2);
+        if (!pic.allow_intrabc) {
+            pic.delta_lf_present = u(1);
+        }
+        if (pic.delta_lf_present) {
+            pic.delta_lf_res = u(2);
+            pic.delta_lf_multi = u(1);
+        }
+    }
+}
+
+void VulkanAV1Decoder::compute_lossless()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    pic.coded_lossless = 1;
+    for (uint32_t segmentId = 0; segmentId < AV1_MAX_SEGMENTS; segmentId++) {
+        int32_t qindex = pic.base_qindex;
+        if (pic.segmentation_enabled && m_FeatureEnabled[segmentId][0]) { // SEG_LVL_ALT_Q
+            qindex = Clip3(0, 255, pic.base_qindex + m_FeatureData[segmentId][0]);
+        }
+        const bool lossless = (qindex == 0) && (m_DeltaQYDc == 0) && (m_DeltaQUAc == 0) && (m_DeltaQUDc == 0) &&
+                              (m_DeltaQVAc == 0) && (m_DeltaQVDc == 0);
+        if (!lossless) {
+            pic.coded_lossless = 0;
+            break;
+        }
+    }
+}
+
+void VulkanAV1Decoder::loop_filter_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    if (pic.coded_lossless || pic.allow_intrabc) {
+        static const int8_t defaultRefDeltas[AV1_NUM_REF_FRAMES] = { 1, 0, 0, 0, -1, 0, -1, -1 };
+        pic.loop_filter_level[0] = 0;
+        pic.loop_filter_level[1] = 0;
+        memcpy(pic.loop_filter_ref_deltas, defaultRefDeltas, sizeof(defaultRefDeltas));
+        memset(pic.loop_filter_mode_deltas, 0, sizeof(pic.loop_filter_mode_deltas));
+        return;
+    }
+    pic.loop_filter_level[0] = (uint8_t)u(6);
+    pic.loop_filter_level[1] = (uint8_t)u(6);
+    if (!m_sps.mono_chrome && (pic.loop_filter_level[0] || pic.loop_filter_level[1])) {
+        pic.loop_filter_level_u = (uint8_t)u(6);
+        pic.loop_filter_level_v = (uint8_t)u(6);
+    }
+    pic.loop_filter_sharpness = (uint8_t)u(3);
+    pic.loop_filter_delta_enabled = u(1);
+    if (pic.loop_filter_delta_enabled) {
+        const uint32_t loop_filter_delta_update = u(1);
+        if (loop_filter_delta_update) {
+            for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+                if (u(1)) { // update_ref_delta
+                    pic.loop_filter_ref_deltas[i] = (int8_t)su(1 + 6);
+                }
+            }
+            for (uint32_t i = 0; i < 2; i++) {
+                if (u(1)) { // update_mode_delta
+                    pic.loop_filter_mode_deltas[i] = (int8_t)su(1 + 6);
+                }
+            }
+        }
+    }
+}
+
+void VulkanAV1Decoder::cdef_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    if (pic.coded_lossless || pic.allow_intrabc || !m_sps.enable_cdef) {
+        pic.cdef_bits = 0;
+        pic.cdef_y_pri_strength[0] = 0;
+        pic.cdef_y_sec_strength[0] = 0;
+        pic.cdef_uv_pri_strength[0] = 0;
+        pic.cdef_uv_sec_strength[0] = 0;
+        pic.cdef_damping_minus_3 = 0;
+        return;
+    }
+    pic.cdef_damping_minus_3 = u(2);
+    pic.cdef_bits = u(2);
+    for (uint32_t i = 0; i < (1u << pic.cdef_bits); i++) {
+        pic.cdef_y_pri_strength[i] = (uint8_t)u(4);
+        pic.cdef_y_sec_strength[i] = (uint8_t)u(2);
+        if (pic.cdef_y_sec_strength[i] == 3) {
+            pic.cdef_y_sec_strength[i] += 1;
+        }
+        if (!m_sps.mono_chrome) {
+            pic.cdef_uv_pri_strength[i] = (uint8_t)u(4);
+            pic.cdef_uv_sec_strength[i] = (uint8_t)u(2);
+            if (pic.cdef_uv_sec_strength[i] == 3) {
+                pic.cdef_uv_sec_strength[i] += 1;
+            }
+        }
+    }
+}
+
+void VulkanAV1Decoder::lr_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    const bool allLossless = pic.coded_lossless && (m_FrameWidth == m_UpscaledWidth);
+    if (allLossless || pic.allow_intrabc || !m_sps.enable_restoration) {
+        return;
+    }
+    bool usesLr = false;
+    bool usesChromaLr = false;
+    const uint32_t numPlanes = m_sps.mono_chrome ? 1 : 3;
+    for (uint32_t i = 0; i < numPlanes; i++) {
+        pic.lr_type[i] = Remap_Lr_Type[u(2)];
+        if (pic.lr_type[i] != 0) {
+            usesLr = true;
+            usesChromaLr = usesChromaLr || (i > 0);
+        }
+    }
+    if (usesLr) {
+        uint32_t lr_unit_shift = u(1);
+        if (m_sps.use_128x128_superblock) {
+            lr_unit_shift++;
+        } else if (lr_unit_shift) {
+            lr_unit_shift += u(1); // lr_unit_extra_shift
+        }
+        // LoopRestorationSize[0] = 256 >> (2 - lr_unit_shift), as 0: 32, 1: 64, 2: 128, 3: 256
+        pic.lr_unit_size[0] = (uint8_t)(1 + lr_unit_shift);
+        uint32_t lr_uv_shift = 0;
+        if (m_sps.subsampling_x && m_sps.subsampling_y && usesChromaLr) {
+            lr_uv_shift = u(1);
+        }
+        pic.lr_unit_size[1] = (uint8_t)(pic.lr_unit_size[0] - lr_uv_shift);
+        pic.lr_unit_size[2] = pic.lr_unit_size[1];
+    }
+}
+
+void VulkanAV1Decoder::skip_mode_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    bool skipModeAllowed = false;
+    if (!m_FrameIsIntra && pic.reference_mode && m_sps.enable_order_hint) {
+        int32_t forwardIdx = -1;
+        int32_t backwardIdx = -1;
+        uint32_t forwardHint = 0;
+        uint32_t backwardHint = 0;
+        for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+            const uint32_t refHint = m_refFrames[m_ref_frame_idx[i]].RefOrderHint;
+            if (get_relative_dist(refHint, m_OrderHint) < 0) {
+                if ((forwardIdx < 0) || (get_relative_dist(refHint, forwardHint) > 0)) {
+                    forwardIdx = i;
+                    forwardHint = refHint;
+                }
+            } else if (get_relative_dist(refHint, m_OrderHint) > 0) {
+                if ((backwardIdx < 0) || (get_relative_dist(refHint, backwardHint) < 0)) {
+                    backwardIdx = i;
+                    backwardHint = refHint;
+                }
+            }
+        }
+        if (forwardIdx < 0) {
+            skipModeAllowed = false;
+        } else if (backwardIdx >= 0) {
+            skipModeAllowed = true;
+            pic.SkipModeFrame0 = AV1_LAST_FRAME + std::min(forwardIdx, backwardIdx);
+            pic.SkipModeFrame1 = AV1_LAST_FRAME + std::max(forwardIdx, backwardIdx);
+        } else {
+            int32_t secondForwardIdx = -1;
+            uint32_t secondForwardHint = 0;
+            for (uint32_t i = 0; i < AV1_REFS_PER_FRAME; i++) {
+                const uint32_t refHint = m_refFrames[m_ref_frame_idx[i]].RefOrderHint;
+                if (get_relative_dist(refHint, forwardHint) < 0) {
+                    if ((secondForwardIdx < 0) || (get_relative_dist(refHint, secondForwardHint) > 0)) {
+                        secondForwardIdx = i;
+                        secondForwardHint = refHint;
+                    }
+                }
+            }
+            if (secondForwardIdx >= 0) {
+                skipModeAllowed = true;
+                pic.SkipModeFrame0 = AV1_LAST_FRAME + std::min(forwardIdx, secondForwardIdx);
+                pic.SkipModeFrame1 = AV1_LAST_FRAME + std::max(forwardIdx, secondForwardIdx);
+            }
+        }
+    }
+    pic.skip_mode = skipModeAllowed ? u(1) : 0;
+}
+
+void VulkanAV1Decoder::global_motion_params()
+{
+    for (uint32_t ref = AV1_LAST_FRAME; ref <= AV1_ALTREF_FRAME; ref++) {
+        for (uint32_t i = 0; i < 6; i++) {
+            m_gm_params[ref][i] = ((i % 3) == 2) ? (1 << AV1_WARPEDMODEL_PREC_BITS) : 0;
+        }
+        m_PicData.ref_global_motion[ref - AV1_LAST_FRAME].wmtype = AV1_IDENTITY;
+    }
+    if (m_FrameIsIntra) {
+        return;
+    }
+    for (uint32_t ref = AV1_LAST_FRAME; ref <= AV1_ALTREF_FRAME; ref++) {
+        uint32_t type = AV1_IDENTITY;
+        if (u(1)) { // is_global
+            if (u(1)) { // is_rot_zoom
+                type = AV1_ROTZOOM;
+            } else {
+                type = u(1) ? AV1_TRANSLATION : AV1_AFFINE; // is_translation
+            }
+        }
+        if (type >= AV1_ROTZOOM) {
+            read_global_param(type, ref, 2);
+            read_global_param(type, ref, 3);
+            if (type == AV1_AFFINE) {
+                read_global_param(type, ref, 4);
+                read_global_param(type, ref, 5);
+            } else {
+                m_gm_params[ref][4] = -m_gm_params[ref][3];
+                m_gm_params[ref][5] = m_gm_params[ref][2];
+            }
+        }
+        if (type >= AV1_TRANSLATION) {
+            read_global_param(type, ref, 0);
+            read_global_param(type, ref, 1);
+        }
+        m_PicData.ref_global_motion[ref - AV1_LAST_FRAME].wmtype = type;
+    }
+}
+
+void VulkanAV1Decoder::read_global_param(uint32_t type, uint32_t ref, uint32_t idx)
+{
+    uint32_t absBits = 12; // GM_ABS_ALPHA_BITS
+    uint32_t precBits = 15; // GM_ALPHA_PREC_BITS
+    if (idx < 2) {
+        if (type == AV1_TRANSLATION) {
+            absBits = 9 - !m_PicData.allow_high_precision_mv; // GM_ABS_TRANS_ONLY_BITS
+            precBits = 3 - !m_PicData.allow_high_precision_mv; // GM_TRANS_ONLY_PREC_BITS
+        } else {
+            absBits = 12; // GM_ABS_TRANS_BITS
+            precBits = 6; // GM_TRANS_PREC_BITS
+        }
+    }
+    const uint32_t precDiff = AV1_WARPEDMODEL_PREC_BITS - precBits;
+    const int32_t round = ((idx % 3) == 2) ? (1 << AV1_WARPEDMODEL_PREC_BITS) : 0;
+    const int32_t sub = ((idx % 3) == 2) ? (1 << precBits) : 0;
+    const int32_t mx = 1 << absBits;
+    const int32_t r = (m_PrevGmParams[ref][idx] >> precDiff) - sub;
+    m_gm_params[ref][idx] = ((int32_t)decode_signed_subexp_with_ref(-mx, mx + 1, r) << precDiff) + round;
+}
+
+void VulkanAV1Decoder::film_grain_params()
+{
+    VkParserAv1PictureData& pic = m_PicData;
+    VkParserAv1FilmGrain& fgs = pic.fgs;
+    memset(&fgs, 0, sizeof(fgs)); // reset_grain_params()
+    if (!m_sps.film_grain_params_present || (!pic.show_frame && !m_showable_frame)) {
+        return;
+    }
+    fgs.apply_grain = u(1);
+    if (!fgs.apply_grain) {
+        return;
+    }
+    fgs.grain_seed = (uint16_t)u(16);
+    fgs.update_grain = (pic.frame_type == AV1_INTER_FRAME) ? u(1) : 1;
+    if (!fgs.update_grain) {
+        const uint32_t film_grain_params_ref_idx = u(3);
+        const uint16_t tempGrainSeed = fgs.grain_seed;
+        fgs = m_refFrames[film_grain_params_ref_idx].film_grain; // load_grain_params()
+        fgs.grain_seed = tempGrainSeed;
+        return;
+    }
+    fgs.num_y_points = (uint8_t)u(4);
+    for (uint32_t i = 0; (i < fgs.num_y_points) && (i < 14); i++) {
+        fgs.scaling_points_y[i][0] = (uint8_t)u(8); // point_y_value
+        fgs.scaling_points_y[i][1] = (uint8_t)u(8); // point_y_scaling
+    }
+    fgs.chroma_scaling_from_luma = m_sps.mono_chrome ? 0 : u(1);
+    if (m_sps.mono_chrome || fgs.chroma_scaling_from_luma ||
+        (m_sps.subsampling_x && m_sps.subsampling_y && (fgs.num_y_points == 0))) {
+        fgs.num_cb_points = 0;
+        fgs.num_cr_points = 0;
+    } else {
+        fgs.num_cb_points = (uint8_t)u(4);
+        for (uint32_t i = 0; (i < fgs.num_cb_points) && (i < 10); i++) {
+            fgs.scaling_points_cb[i][0] = (uint8_t)u(8);
+            fgs.scaling_points_cb[i][1] = (uint8_t)u(8);
+        }
+        fgs.num_cr_points = (uint8_t)u(4);
+        for (uint32_t i = 0; (i < fgs.num_cr_points) && (i < 10); i++) {
+            fgs.scaling_points_cr[i][0] = (uint8_t)u(8);
+            fgs.scaling_points_cr[i][1] = (uint8_t)u(8);
+        }
+    }
+    fgs.scaling_shift_minus8 = u(2);
+    fgs.ar_coeff_lag = u(2);
+    const uint32_t numPosLuma = 2 * fgs.ar_coeff_lag * (fgs.ar_coeff_lag + 1);
+    uint32_t numPosChroma = numPosLuma;
+    if (fgs.num_y_points) {
+        numPosChroma = numPosLuma + 1;
+        for (uint32_t i = 0; i < numPosLuma; i++) {
+            fgs.ar_coeffs_y[i] = (int16_t)u(8) - 128;
+        }
+    }
+    if (fgs.chroma_scaling_from_luma || fgs.num_cb_points) {
+        for (uint32_t i = 0; i < numPosChroma; i++) {
+            fgs.ar_coeffs_cb[i] = (int16_t)u(8) - 128;
+        }
+    }
+    if (fgs.chroma_scaling_from_luma || fgs.num_cr_points) {
+        for (uint32_t i = 0; i < numPosChroma; i++) {
+            fgs.ar_coeffs_cr[i] = (int16_t)u(8) - 128;
+        }
+    }
+    fgs.ar_coeff_shift_minus6 = u(2);
+    fgs.grain_scale_shift = u(2);
+    if (fgs.num_cb_points) {
+        fgs.cb_mult = (uint8_t)u(8);
+        fgs.cb_luma_mult = (uint8_t)u(8);
+        fgs.cb_offset = (int16_t)u(9);
+    }
+    if (fgs.num_cr_points) {
+        fgs.cr_mult = (uint8_t)u(8);
+        fgs.cr_luma_mult = (uint8_t)u(8);
+        fgs.cr_offset = (int16_t)u(9);
+    }
+    fgs.overlap_flag = u(1);
+    fgs.clip_to_restricted_range = u(1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Tile groups (5.11.1)
+//
+
+bool VulkanAV1Decoder::tile_group_obu()
+{
+    const uint32_t numTiles = m_PicData.num_tile_cols * m_PicData.num_tile_rows;
+    uint32_t tg_start = 0;
+    uint32_t tg_end = numTiles - 1;
+    if ((numTiles > 1) && u(1)) { // tile_start_and_end_present_flag
+        const uint32_t tileBits = m_TileColsLog2 + m_TileRowsLog2;
+        tg_start = u(tileBits);
+        tg_end = u(tileBits);
+    }
+    byte_alignment();
+    if ((tg_end < tg_start) || (tg_end >= numTiles) || (tg_start != (uint32_t)m_tileSizes.size())) {
+        nvParserLog("WARNING: Invalid AV1 tile group (%d - %d)\n", tg_start, tg_end);
+        m_nalu.end_offset = m_nalu.start_offset;
+        return false;
+    }
+
+    const uint8_t* pBitstreamData = m_bitstreamData.GetBitstreamPtr();
+    int64_t offset = m_nalu.start_offset + (consumed_bits() >> 3);
+    const int64_t end = m_nalu.end_offset;
+    for (uint32_t tileNum = tg_start; tileNum <= tg_end; tileNum++) {
+        int64_t tileSize = end - offset;
+        if (tileNum != tg_end) {
+            if ((offset + m_TileSizeBytes) > end) {
+                tileSize = -1;
+            } else {
+                tileSize = 1;
+                for (uint32_t i = 0; i < m_TileSizeBytes; i++) {
+                    tileSize += (int64_t)pBitstreamData[offset + i] << (8 * i); // tile_size_minus_1
+                }
+                offset += m_TileSizeBytes;
+            }
+        }
+        if ((tileSize <= 0) || ((offset + tileSize) > end)) {
+            nvParserLog("WARNING: Truncated AV1 tile %d\n", tileNum);
+            m_bSkipFrame = true;
+            break;
+        }
+        assert(offset < std::numeric_limits<int32_t>::max());
+        m_bitstreamData.AddStreamMarker((uint32_t)offset);
+        m_tileSizes.push_back((uint32_t)tileSize);
+        offset += tileSize;
+    }
+
+    if ((tg_end == (numTiles - 1)) || m_bSkipFrame) {
+        decode_frame_wrapup();
+    }
+    return true;
+}
+
+// The frame is complete: hands it to the client, and updates the references
+void VulkanAV1Decoder::decode_frame_wrapup()
+{
+    if (!m_bSkipFrame && (m_pCurrPic != nullptr)) {
+        // The shown frames take the timestamp of their temporal unit, the hidden ones are shown with a later one
+        m_llFrameStartLocation = m_PicData.show_frame ? m_llNaluStartLocation : -1;
+        m_nalu.start_offset = m_nalu.end_offset;
+        end_of_picture();
+        reference_frame_update();
+        if (m_PicData.show_frame) {
+            display_picture(m_pCurrPic);
+        }
+    }
+    m_bitstreamDataLen = swapBitstreamBuffer(0, 0);
+    if (m_pCurrPic != nullptr) {
+        m_pCurrPic->Release();
+        m_pCurrPic = nullptr;
+    }
+    reset_frame();
+}
+
+bool VulkanAV1Decoder::BeginPicture(VkParserPictureData* pnvpd)
+{
+    VkParserAv1PictureData* const pav1 = &pnvpd->CodecSpecific.av1;
+
+    *pav1 = m_PicData;
+    pav1->pDecodePic = m_pCurrPic;
+    for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+        pav1->ref_frame_map[i] = m_refFrames[i].RefValid ? m_refFrames[i].pPicBuf : nullptr;
+    }
+    pav1->pTileSizes = m_tileSizes.data();
+
+    pnvpd->PicWidthInMbs = (m_FrameWidth + 15) >> 4;
+    pnvpd->FrameHeightInMbs = (m_FrameHeight + 15) >> 4;
+    pnvpd->pCurrPic = m_pCurrPic;
+    pnvpd->progressive_frame = 1;
+    pnvpd->ref_pic_flag = (m_refresh_frame_flags != 0);
+    pnvpd->intra_pic_flag = m_FrameIsIntra;
+    pnvpd->chroma_format = m_sps.mono_chrome ? 0 : (m_sps.subsampling_x && m_sps.subsampling_y) ? 1 :
+                                                   m_sps.subsampling_x ? 2 : 3;
+    pnvpd->picture_order_count = m_OrderHint;
+    return true;
+}
+
+// Reference frame update process (7.20)
+void VulkanAV1Decoder::reference_frame_update()
+{
+    for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+        if (!((m_refresh_frame_flags >> i) & 1)) {
+            continue;
+        }
+        av1_ref_frame_s& ref = m_refFrames[i];
+        if (ref.pPicBuf != nullptr) {
+            ref.pPicBuf->Release();
+        }
+        ref.pPicBuf = m_pCurrPic;
+        if (ref.pPicBuf != nullptr) {
+            ref.pPicBuf->AddRef();
+        }
+        ref.RefValid = 1;
+        ref.RefFrameId = m_current_frame_id;
+        ref.RefFrameType = m_PicData.frame_type;
+        ref.RefOrderHint = m_OrderHint;
+        ref.RefUpscaledWidth = m_UpscaledWidth;
+        ref.RefFrameWidth = m_FrameWidth;
+        ref.RefFrameHeight = m_FrameHeight;
+        ref.RefRenderWidth = m_RenderWidth;
+        ref.RefRenderHeight = m_RenderHeight;
+        ref.showable_frame = m_showable_frame;
+        memcpy(ref.SavedOrderHints, m_OrderHints, sizeof(ref.SavedOrderHints));
+        memcpy(ref.SavedGmParams, m_gm_params, sizeof(ref.SavedGmParams));
+        memcpy(ref.loop_filter_ref_deltas, m_PicData.loop_filter_ref_deltas, sizeof(ref.loop_filter_ref_deltas));
+        memcpy(ref.loop_filter_mode_deltas, m_PicData.loop_filter_mode_deltas, sizeof(ref.loop_filter_mode_deltas));
+        memcpy(ref.FeatureEnabled, m_FeatureEnabled, sizeof(ref.FeatureEnabled));
+        memcpy(ref.FeatureData, m_FeatureData, sizeof(ref.FeatureData));
+        ref.film_grain = m_PicData.fgs;
+    }
+}
+
+// A frame decoded before is output again, a key frame reloads the references (7.21)
+void VulkanAV1Decoder::show_existing_frame()
+{
+    av1_ref_frame_s& frame = m_refFrames[m_frame_to_show_map_idx];
+    if (!frame.RefValid || (frame.pPicBuf == nullptr)) {
+        nvParserLog("WARNING: AV1 frame to show %d is missing\n", m_frame_to_show_map_idx);
+        return;
+    }
+    VkPicIf* pPicBuf = frame.pPicBuf;
+    pPicBuf->AddRef();
+
+    // The frame takes the timestamp of the temporal unit it is shown in
+    for (int32_t i = 0; i < MAX_DELAY; i++) {
+        if (m_DispInfo[i].pPicBuf != pPicBuf) {
+            continue;
+        }
+        uint32_t ndx = m_lPTSPos;
+        for (int32_t k = 0; k < MAX_QUEUED_PTS; k++) {
+            if (m_PTSQueue[ndx].bPTSValid && (m_PTSQueue[ndx].llPTSPos <= m_llNaluStartLocation)) {
+                m_DispInfo[i].bPTSValid = true;
+                m_DispInfo[i].llPTS = m_PTSQueue[ndx].llPTS;
+                m_DispInfo[i].bDiscontinuity = m_PTSQueue[ndx].bDiscontinuity;
+                m_PTSQueue[ndx].bPTSValid = false;
+            }
+            ndx = (ndx + 1) % MAX_QUEUED_PTS;
+        }
+        break;
+    }
+    display_picture(pPicBuf);
+
+    if (frame.RefFrameType == AV1_KEY_FRAME) {
+        const av1_ref_frame_s keyFrame = frame;
+        for (uint32_t i = 0; i < AV1_NUM_REF_FRAMES; i++) {
+            if (m_refFrames[i].pPicBuf != nullptr) {
+                m_refFrames[i].pPicBuf->Release();
+            }
+            m_refFrames[i] = keyFrame;
+            m_refFrames[i].pPicBuf->AddRef();
+        }
+    }
+    pPicBuf->Release();
+}
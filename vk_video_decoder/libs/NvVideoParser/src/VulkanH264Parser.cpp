@@ -68,7 +68,8 @@ VulkanH264Decoder::VulkanH264Decoder(VkVideoCodecOperationFlagBitsKHR std)
     m_spsme(NULL),
     m_bUseMVC(false),
     m_bUseSVC(false),
-    m_slice_group_map()
+    m_slice_group_map(),
+    m_deferredSliceCheck()
 {
     memset(m_spsmes, 0, sizeof(m_spsmes));
     memset(&m_nhe, 0, sizeof(nalu_header_extension_u));
@@ -89,6 +90,10 @@ VulkanH264Decoder::~VulkanH264Decoder()
 void VulkanH264Decoder::CreatePrivateContext()
 {
     m_pParserData = new H264ParserData();
+
+    const uint32_t maxFreeParameterSets = StdVideoPictureParametersSetPool<seq_parameter_set_s>::DEFAULT_MAX_FREE_PARAMETER_SETS;
+    StdVideoPictureParametersSetPool<seq_parameter_set_s>::Create(maxFreeParameterSets, m_spsPool);
+    StdVideoPictureParametersSetPool<pic_parameter_set_s>::Create(maxFreeParameterSets, m_ppsPool);
 }
 
 void VulkanH264Decoder::FreeContext()
@@ -1170,6 +1175,276 @@ bool VulkanH264Decoder::IsPictureBoundary(int32_t rbsp_size)
 }
 
 
+bool VulkanH264Decoder::DropNalUnit()
+{
+    if (!m_decodeFilter.referencePicturesOnly && !m_decodeFilter.randomAccessPicturesOnly &&
+            (m_decodeFilter.maxScalableLayers == 0)) {
+        return false;
+    }
+
+    f(1, 0); // forbidden_zero_bit
+    const int nal_ref_idc = u(2);
+    const int nal_unit_type = u(5);
+    bool idr_pic = (nal_unit_type == NAL_UNIT_CODED_SLICE_IDR);
+    if ((nal_unit_type == NAL_UNIT_CODED_SLICE_SCALABLE) || (nal_unit_type == NAL_UNIT_CODED_SLICE_IDR_SCALABLE)) {
+        if (!m_bUseMVC && !m_bUseSVC) {
+            return false;
+        }
+        const bool svc_extension_flag = !!u(1);
+        const bool idr_flag = !!u(1); // non_idr_flag of the MVC extension
+        idr_pic = svc_extension_flag ? idr_flag : !idr_flag;
+        // The layers above the target one never reach the DPB management (G.8.8.1 and H.8.5.3 sub-bitstreams)
+        if ((m_decodeFilter.maxScalableLayers > 0) && (nal_unit_type == NAL_UNIT_CODED_SLICE_SCALABLE)) {
+            u(6); // priority_id
+            if (svc_extension_flag) {
+                u(1); // no_inter_layer_pred_flag
+                const uint32_t dependency_id = u(3);
+                if (dependency_id >= m_decodeFilter.maxScalableLayers) {
+                    return true;
+                }
+            } else if (IsMvcViewDropped(u(10))) { // view_id
+                return true;
+            }
+        }
+        if (!m_decodeFilter.referencePicturesOnly && !m_decodeFilter.randomAccessPicturesOnly) {
+            return false;
+        }
+    } else if (!m_decodeFilter.referencePicturesOnly && !m_decodeFilter.randomAccessPicturesOnly) {
+        return false;
+    } else if (nal_unit_type != NAL_UNIT_CODED_SLICE && nal_unit_type != NAL_UNIT_CODED_SLICE_IDR) {
+        return false;
+    }
+
+    // The frame_num only increases after a reference picture: dropping the others leaves no gaps in it
+    if (m_decodeFilter.referencePicturesOnly && (nal_ref_idc == 0)) {
+        return true;
+    }
+    return m_decodeFilter.randomAccessPicturesOnly && !idr_pic;
+}
+
+// The views of the MVC sub-bitstream only refer to the ones preceding them in the view order
+bool VulkanH264Decoder::IsMvcViewDropped(int view_id) const
+{
+    if (m_decodeFilter.maxScalableLayers == 1) {
+        return true; // the base view is the only one coded with the NAL units 1 and 5
+    }
+    if (m_spsme == nullptr) {
+        return false; // the view order is not known yet
+    }
+    for (int voIdx = 0; voIdx <= m_spsme->num_views_minus1; voIdx++) {
+        if (m_spsme->view_id[voIdx] == view_id) {
+            return (voIdx >= (int)m_decodeFilter.maxScalableLayers);
+        }
+    }
+    return false;
+}
+
+// Snapshot of the first slice of the picture, for the checks of the other slice headers
+void VulkanH264Decoder::init_deferred_slice_check(const slice_header_s *slh)
+{
+    std::shared_ptr<deferred_slice_check_s> pic = std::make_shared<deferred_slice_check_s>();
+    pic->nal_ref_idc = slh->nal_ref_idc;
+    pic->IdrPicFlag = slh->IdrPicFlag;
+    pic->frame_num = slh->frame_num;
+    pic->field_pic_flag = slh->field_pic_flag;
+    pic->bottom_field_flag = slh->bottom_field_flag;
+    pic->idr_pic_id = slh->idr_pic_id;
+    pic->pic_order_cnt_lsb = slh->pic_order_cnt_lsb;
+    pic->delta_pic_order_cnt_bottom = slh->delta_pic_order_cnt_bottom;
+    pic->delta_pic_order_cnt[0] = slh->delta_pic_order_cnt[0];
+    pic->delta_pic_order_cnt[1] = slh->delta_pic_order_cnt[1];
+    pic->no_output_of_prior_pics_flag = slh->no_output_of_prior_pics_flag;
+    pic->long_term_reference_flag = slh->long_term_reference_flag;
+    pic->adaptive_ref_pic_marking_mode_flag = slh->adaptive_ref_pic_marking_mode_flag;
+    memcpy(pic->mmco, slh->mmco, sizeof(pic->mmco));
+    pic->log2_max_frame_num = m_sps->log2_max_frame_num_minus4 + 4;
+    pic->frame_mbs_only_flag = m_sps->flags.frame_mbs_only_flag;
+    pic->pic_order_cnt_type = m_sps->pic_order_cnt_type;
+    pic->log2_max_pic_order_cnt_lsb = m_sps->log2_max_pic_order_cnt_lsb_minus4 + 4;
+    pic->delta_pic_order_always_zero_flag = m_sps->flags.delta_pic_order_always_zero_flag;
+    pic->chroma_array_type = m_sps->flags.separate_colour_plane_flag ? 0 : m_sps->chroma_format_idc;
+    pic->bottom_field_pic_order_in_frame_present_flag = m_pps->flags.bottom_field_pic_order_in_frame_present_flag;
+    pic->num_ref_idx_l0_default_active_minus1 = m_pps->num_ref_idx_l0_default_active_minus1;
+    pic->num_ref_idx_l1_default_active_minus1 = m_pps->num_ref_idx_l1_default_active_minus1;
+    pic->weighted_pred_flag = m_pps->flags.weighted_pred_flag;
+    pic->weighted_bipred_idc = m_pps->weighted_bipred_idc;
+    int PicSizeInMbs = (m_sps->pic_width_in_mbs_minus1 + 1) * (m_sps->pic_height_in_map_units_minus1 + 1);
+    if (!m_sps->flags.frame_mbs_only_flag && !slh->field_pic_flag) {
+        PicSizeInMbs <<= 1;
+    }
+    const int MbaffFrameFlag = m_sps->flags.mb_adaptive_frame_field_flag && !slh->field_pic_flag;
+    pic->first_mb_in_slice_limit = PicSizeInMbs >> MbaffFrameFlag;
+    m_deferredSliceCheck = pic;
+}
+
+// Only the syntax elements the picture needs from the slices after the first one are parsed here: the offset of
+// the slice is recorded all the same. Returns false, with the position unchanged, for the slices that take the
+// full slice_header() parsing.
+bool VulkanH264Decoder::defer_slice_header(int nal_ref_idc)
+{
+    const int64_t rbsp_bitpos = m_nalu.rbsp_bitpos;
+    const int first_mb_in_slice = ue();
+    const int slice_type = ue() % 5;
+    const int pic_parameter_set_id = ue();
+    if ((pic_parameter_set_id != m_slh.pic_parameter_set_id) ||
+        m_pps->flags.redundant_pic_cnt_present_flag || (m_pps->num_slice_groups_minus1 > 0) ||
+        m_sps->flags.separate_colour_plane_flag ||
+        ((!m_sps->max_num_ref_frames) && (slice_type != I) && (slice_type != SI)) ||
+        ((m_lErrorThreshold < 60) && (slice_type == B) && (m_sps->profile_idc == 66))) {
+        m_nalu.rbsp_bitpos = rbsp_bitpos;
+        return false;
+    }
+
+    if (m_sps->profile_idc == 66) // fmo/aso only allowed in baseline
+    {
+        if (first_mb_in_slice < m_first_mb_in_slice)
+            m_aso = true;
+    }
+    m_first_mb_in_slice = first_mb_in_slice;
+    if ((slice_type != I) && (slice_type != SI))
+        m_intra_pic_flag = 0;
+
+    std::shared_ptr<const deferred_slice_check_s> pic = m_deferredSliceCheck;
+    defer_slice_header_check([pic, first_mb_in_slice, nal_ref_idc, slice_type](NvVkRbspReader& rbsp) {
+        if (first_mb_in_slice >= pic->first_mb_in_slice_limit) {
+            nvParserLog("Invalid first_mb_in_slice (%d) in a deferred slice header\n", first_mb_in_slice);
+            return false;
+        }
+        return check_deferred_slice_header(*pic, nal_ref_idc, slice_type, rbsp);
+    });
+    return true;
+}
+
+// The rest of the slice header, up to dec_ref_pic_marking(), checked against the first slice of the picture
+bool VulkanH264Decoder::check_deferred_slice_header(const deferred_slice_check_s& pic, int nal_ref_idc, int slice_type,
+                                                    NvVkRbspReader& rbsp)
+{
+    if ((int)rbsp.u(pic.log2_max_frame_num) != pic.frame_num) {
+        return false;
+    }
+    int field_pic_flag = 0, bottom_field_flag = 0;
+    if (!pic.frame_mbs_only_flag) {
+        field_pic_flag = rbsp.u(1);
+        if (field_pic_flag) {
+            bottom_field_flag = rbsp.u(1);
+        }
+    }
+    if ((field_pic_flag != pic.field_pic_flag) || (bottom_field_flag != pic.bottom_field_flag)) {
+        return false;
+    }
+    if (pic.IdrPicFlag && ((int)rbsp.ue() != pic.idr_pic_id)) {
+        return false;
+    }
+    if (pic.pic_order_cnt_type == 0) {
+        if ((int)rbsp.u(pic.log2_max_pic_order_cnt_lsb) != pic.pic_order_cnt_lsb) {
+            return false;
+        }
+        if (pic.bottom_field_pic_order_in_frame_present_flag && !field_pic_flag &&
+            (rbsp.se() != pic.delta_pic_order_cnt_bottom)) {
+            return false;
+        }
+    }
+    if ((pic.pic_order_cnt_type == 1) && !pic.delta_pic_order_always_zero_flag) {
+        if (rbsp.se() != pic.delta_pic_order_cnt[0]) {
+            return false;
+        }
+        if (pic.bottom_field_pic_order_in_frame_present_flag && !field_pic_flag &&
+            (rbsp.se() != pic.delta_pic_order_cnt[1])) {
+            return false;
+        }
+    }
+
+    uint32_t num_ref_idx_l0_active_minus1 = pic.num_ref_idx_l0_default_active_minus1;
+    uint32_t num_ref_idx_l1_active_minus1 = pic.num_ref_idx_l1_default_active_minus1;
+    if (slice_type == B) {
+        rbsp.u(1); // direct_spatial_mv_pred_flag
+    }
+    if ((slice_type == P) || (slice_type == SP) || (slice_type == B)) {
+        if (rbsp.u(1)) { // num_ref_idx_active_override_flag
+            num_ref_idx_l0_active_minus1 = rbsp.ue();
+            if (slice_type == B) {
+                num_ref_idx_l1_active_minus1 = rbsp.ue();
+            }
+            if ((num_ref_idx_l0_active_minus1 > 31) || (num_ref_idx_l1_active_minus1 > 31)) {
+                return false;
+            }
+        }
+    }
+
+    // ref_pic_list_modification()
+    for (int list = 0; list < ((slice_type == B) ? 2 : 1); list++) {
+        if ((slice_type == I) || (slice_type == SI) || !rbsp.u(1)) { // ref_pic_list_modification_flag_lX
+            continue;
+        }
+        for (int i = 0; ; i++) {
+            const uint32_t modification_of_pic_nums_idc = rbsp.ue();
+            if ((modification_of_pic_nums_idc > 5) || rbsp.overrun()) {
+                return false;
+            }
+            if ((modification_of_pic_nums_idc == 3) || (i >= MAX_REFS)) {
+                break;
+            }
+            rbsp.ue(); // abs_diff_pic_num_minus1, long_term_pic_num or abs_diff_view_idx_minus1
+        }
+    }
+
+    // pred_weight_table()
+    if ((pic.weighted_pred_flag && ((slice_type == P) || (slice_type == SP))) ||
+        ((pic.weighted_bipred_idc == 1) && (slice_type == B))) {
+        const uint32_t luma_log2_weight_denom = rbsp.ue();
+        const uint32_t chroma_log2_weight_denom = (pic.chroma_array_type != 0) ? rbsp.ue() : 0;
+        if ((luma_log2_weight_denom | chroma_log2_weight_denom) > 7) {
+            return false;
+        }
+        for (int list = 0; list < ((slice_type == B) ? 2 : 1); list++) {
+            const uint32_t num_ref_idx_active_minus1 = (list == 0) ? num_ref_idx_l0_active_minus1 : num_ref_idx_l1_active_minus1;
+            for (uint32_t i = 0; (i <= num_ref_idx_active_minus1) && !rbsp.overrun(); i++) {
+                if (rbsp.u(1)) { // luma_weight_lX_flag
+                    rbsp.se();
+                    rbsp.se();
+                }
+                if ((pic.chroma_array_type != 0) && rbsp.u(1)) { // chroma_weight_lX_flag
+                    for (int j = 0; j < 4; j++) {
+                        rbsp.se();
+                    }
+                }
+            }
+        }
+    }
+
+    // dec_ref_pic_marking()
+    if (nal_ref_idc != 0) {
+        if (pic.IdrPicFlag) {
+            if ((rbsp.u(1) != pic.no_output_of_prior_pics_flag) || (rbsp.u(1) != pic.long_term_reference_flag)) {
+                return false;
+            }
+        } else {
+            if (rbsp.u(1) != pic.adaptive_ref_pic_marking_mode_flag) {
+                return false;
+            }
+            for (int i = 0; pic.adaptive_ref_pic_marking_mode_flag && (i < MAX_MMCOS); i++) {
+                const memory_management_control_operation_s& mmco = pic.mmco[i];
+                if ((int)rbsp.ue() != mmco.memory_management_control_operation) {
+                    return false;
+                }
+                if (mmco.memory_management_control_operation == 0) {
+                    break;
+                }
+                if (((mmco.memory_management_control_operation == 1) || (mmco.memory_management_control_operation == 3)) &&
+                    ((int)rbsp.ue() != mmco.difference_of_pic_nums_minus1)) {
+                    return false;
+                }
+                if (((mmco.memory_management_control_operation == 2) || (mmco.memory_management_control_operation == 3) ||
+                     (mmco.memory_management_control_operation == 4) || (mmco.memory_management_control_operation == 6)) &&
+                    ((int)rbsp.ue() != mmco.long_term_frame_idx)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
 int32_t VulkanH264Decoder::ParseNalUnit()
 {
     slice_header_s slh;
@@ -1191,6 +1466,15 @@ int32_t VulkanH264Decoder::ParseNalUnit()
     {
     case NAL_UNIT_CODED_SLICE:
     case NAL_UNIT_CODED_SLICE_IDR:
+        if (picture_boundary)
+        {
+            m_deferredSliceCheck = nullptr;
+        }
+        else if (m_deferredSliceCheck && defer_slice_header(nal_ref_idc))
+        {
+            retval = NALU_SLICE;
+            break;
+        }
         if (slice_header(&slh, nal_ref_idc, nal_unit_type))
         {
             if (picture_boundary)
@@ -1211,6 +1495,8 @@ int32_t VulkanH264Decoder::ParseNalUnit()
                 m_last_primary_pic_type = -1;
                 if (!m_bUseSVC) // for SVC, it is handled inside BeginPicture_SVC
                     dpb_picture_start(m_ppss[slh.pic_parameter_set_id], &slh);
+                if (m_decodeFilter.deferSliceHeaders && !m_bUseMVC && !m_bUseSVC)
+                    init_deferred_slice_check(&slh);
                 m_intra_pic_flag = 1;
                 m_aso = false; //((sps->profile_idc == 66) && (slh.first_mb_in_slice != 0));
             }
@@ -1287,7 +1573,10 @@ int32_t VulkanH264Decoder::ParseNalUnit()
                 break;
             }
             bitsUsed = consumed_bits();
-            sei_payload(payloadType, payloadSize);
+            if (sei_payload_selected(payloadType))
+            {
+                sei_payload(payloadType, payloadSize);
+            }
             // Skip over unknown payloads (NOTE: assumes that emulation prevention bytes are not present)
             skip = payloadSize * 8 - (consumed_bits() - bitsUsed);
             if (skip > 0) {
@@ -1501,9 +1790,19 @@ int32_t VulkanH264Decoder::seq_parameter_set_rbsp(SpsNalUnitTarget spsNalUnitTar
     }
     m_last_sps_id = sps_id;
 
+    // A repeat of the SPS in use needs neither parsing nor a client update.
+    // The MVC and SVC extensions are parsed past the base SPS, so they always go through.
+    uint64_t contentHash = 0;
+    if ((spsNalUnitTarget == SPS_NAL_UNIT_TARGET_SPS) && (spssvc == nullptr)) {
+        contentHash = nal_content_hash(0);
+        if (m_spss[sps_id] && (m_spss[sps_id]->GetContentHash() == contentHash)) {
+            return sps_id;
+        }
+    }
+
     VkSharedBaseObj<seq_parameter_set_s> sps(spssvc);
     if (spssvc == nullptr) {
-        VkResult result = seq_parameter_set_s::Create(0, sps);
+        VkResult result = m_spsPool ? m_spsPool->Acquire(0, sps) : seq_parameter_set_s::Create(0, sps);
         assert((result == VK_SUCCESS) && sps);
         if (result != VK_SUCCESS) {
             return false;
@@ -1661,6 +1960,8 @@ int32_t VulkanH264Decoder::seq_parameter_set_rbsp(SpsNalUnitTarget spsNalUnitTar
         sps->pSequenceParameterSetVui = NULL;
     }
 
+    sps->SetContentHash(contentHash);
+
     if (spssvc == nullptr)
     {
         if ((spsNalUnitTarget == SPS_NAL_UNIT_TARGET_SPS) && m_outOfBandPictureParameters && m_pClient) {
@@ -1684,7 +1985,7 @@ bool VulkanH264Decoder::seq_parameter_set_svc_extension_rbsp()
 {
 
     VkSharedBaseObj<seq_parameter_set_s> spssvc;
-    VkResult result = seq_parameter_set_s::Create(0, spssvc);
+    VkResult result = m_spsPool ? m_spsPool->Acquire(0, spssvc) : seq_parameter_set_s::Create(0, spssvc);
     assert((result == VK_SUCCESS) && spssvc);
     if (result != VK_SUCCESS) {
         return false;
@@ -1984,7 +2285,7 @@ void VulkanH264Decoder::hrd_parameters(vui_parameters_s *vui, hrd_parameters_s *
         hrd->bit_rate = (ue() + 1) << hrd->bit_rate_scale;   // bit_rate_value_minus1[SchedSelIdx]
         hrd->cbp_size = (ue() + 1) << hrd->cpb_size_scale;   // cpb_size_value_minus1[SchedSelIdx]
         u(1);   // cbr_flag[SchedSelIdx]
-        if (m_nalu.get_offset >= m_nalu.end_offset) { // In case of bitstream error
+        if (end()) { // In case of bitstream error
             break;
         }
     }
@@ -2031,8 +2332,15 @@ bool VulkanH264Decoder::pic_parameter_set_rbsp()
     }
     m_last_sps_id = sps_id;
 
+    // A repeat of the PPS in use needs neither parsing nor a client update.
+    // Unlike h.265, the h.264 PPS is parsed without the SPS, its content only depends on the NAL unit.
+    const uint64_t contentHash = nal_content_hash(0);
+    if (m_ppss[pps_id] && (m_ppss[pps_id]->GetContentHash() == contentHash)) {
+        return true;
+    }
+
     VkSharedBaseObj<pic_parameter_set_s> pps;
-    VkResult result = pic_parameter_set_s::Create(0, pps);
+    VkResult result = m_ppsPool ? m_ppsPool->Acquire(0, pps) : pic_parameter_set_s::Create(0, pps);
     assert((result == VK_SUCCESS) && pps);
     if (result != VK_SUCCESS) {
         return false;
@@ -2151,6 +2459,8 @@ bool VulkanH264Decoder::pic_parameter_set_rbsp()
         pps->pScalingLists = NULL;
     }
 
+    pps->SetContentHash(contentHash);
+
     if (m_outOfBandPictureParameters && m_pClient) {
 
         pps->SetSequenceCount(m_pParserData->ppssClientUpdateCount[pps_id]++);
@@ -2359,6 +2669,17 @@ bool VulkanH264Decoder::slice_header(slice_header_s *slh, int nal_ref_idc, int n
     {
         // infer
     }
+
+    // Nothing past this point is needed to build the picture parameters (the slice data offset
+    // is already recorded by AddStreamMarker), so only SVC slices keep reading the header.
+    if (!slh->nhe.svc_extension_flag)
+    {
+        if (m_bUseSVC) {
+            update_layer_info(m_sps, m_pps, slh);
+        }
+        return true;
+    }
+
     if (pps->flags.entropy_coding_mode_flag && slh->slice_type != I && slh->slice_type != SI)
         ue(); // cabac_init_idc
     se(); // slice_qp_delta
@@ -2393,69 +2714,66 @@ bool VulkanH264Decoder::slice_header(slice_header_s *slh, int nal_ref_idc, int n
         }
     }
 
-    // Need further parsing for SVC only
-    if (slh->nhe.svc_extension_flag)
+    // SVC extension
+    if (!no_inter_layer_pred_flag && quality_id == 0)
     {
-        if (!no_inter_layer_pred_flag && quality_id == 0)
+        slh->ref_layer_dq_id = ue();
+        if (sps->svc.inter_layer_deblocking_filter_control_present_flag)
         {
-            slh->ref_layer_dq_id = ue();
-            if (sps->svc.inter_layer_deblocking_filter_control_present_flag)
+            slh->disable_inter_layer_deblocking_filter_idc = ue();
+            if (slh->disable_inter_layer_deblocking_filter_idc != 1)
             {
-                slh->disable_inter_layer_deblocking_filter_idc = ue();
-                if (slh->disable_inter_layer_deblocking_filter_idc != 1)
-                {
-                    slh->inter_layer_slice_alpha_c0_offset_div2 = se();
-                    slh->inter_layer_slice_beta_offset_div2 = se();
-                }
+                slh->inter_layer_slice_alpha_c0_offset_div2 = se();
+                slh->inter_layer_slice_beta_offset_div2 = se();
             }
-            slh->constrained_intra_resampling_flag = u(1);
-            // defaults
-            slh->ref_layer_chroma_phase_x_plus1_flag = sps->svc.seq_ref_layer_chroma_phase_x_plus1_flag;
-            slh->ref_layer_chroma_phase_y_plus1      = sps->svc.seq_ref_layer_chroma_phase_y_plus1;
-            slh->scaled_ref_layer_left_offset        = sps->svc.seq_scaled_ref_layer_left_offset;
-            slh->scaled_ref_layer_top_offset         = sps->svc.seq_scaled_ref_layer_top_offset;
-            slh->scaled_ref_layer_right_offset       = sps->svc.seq_scaled_ref_layer_right_offset;
-            slh->scaled_ref_layer_bottom_offset      = sps->svc.seq_scaled_ref_layer_bottom_offset;
-            if (sps->svc.extended_spatial_scalability_idc == 2)
+        }
+        slh->constrained_intra_resampling_flag = u(1);
+        // defaults
+        slh->ref_layer_chroma_phase_x_plus1_flag = sps->svc.seq_ref_layer_chroma_phase_x_plus1_flag;
+        slh->ref_layer_chroma_phase_y_plus1      = sps->svc.seq_ref_layer_chroma_phase_y_plus1;
+        slh->scaled_ref_layer_left_offset        = sps->svc.seq_scaled_ref_layer_left_offset;
+        slh->scaled_ref_layer_top_offset         = sps->svc.seq_scaled_ref_layer_top_offset;
+        slh->scaled_ref_layer_right_offset       = sps->svc.seq_scaled_ref_layer_right_offset;
+        slh->scaled_ref_layer_bottom_offset      = sps->svc.seq_scaled_ref_layer_bottom_offset;
+        if (sps->svc.extended_spatial_scalability_idc == 2)
+        {
+            if (sps->chroma_format_idc > 0) // ChromaArrayType > 0
             {
-                if (sps->chroma_format_idc > 0) // ChromaArrayType > 0
-                {
-                    slh->ref_layer_chroma_phase_x_plus1_flag = u(1);
-                    slh->ref_layer_chroma_phase_y_plus1      = u(2);
-                }
-                slh->scaled_ref_layer_left_offset   = se();
-                slh->scaled_ref_layer_top_offset    = se();
-                slh->scaled_ref_layer_right_offset  = se();
-                slh->scaled_ref_layer_bottom_offset = se();
+                slh->ref_layer_chroma_phase_x_plus1_flag = u(1);
+                slh->ref_layer_chroma_phase_y_plus1      = u(2);
             }
-        }        
-        if (!no_inter_layer_pred_flag)
+            slh->scaled_ref_layer_left_offset   = se();
+            slh->scaled_ref_layer_top_offset    = se();
+            slh->scaled_ref_layer_right_offset  = se();
+            slh->scaled_ref_layer_bottom_offset = se();
+        }
+    }        
+    if (!no_inter_layer_pred_flag)
+    {
+        slh->slice_skip_flag = u(1);
+        if (slh->slice_skip_flag)
+            slh->num_mbs_in_slice_minus1 = ue();
+        else
         {
-            slh->slice_skip_flag = u(1);
-            if (slh->slice_skip_flag)
-                slh->num_mbs_in_slice_minus1 = ue();
-            else
+            slh->adaptive_base_mode_flag = u(1);
+            if (!slh->adaptive_base_mode_flag)
+                slh->default_base_mode_flag = u(1);
+            if (!slh->default_base_mode_flag)
             {
-                slh->adaptive_base_mode_flag = u(1);
-                if (!slh->adaptive_base_mode_flag)
-                    slh->default_base_mode_flag = u(1);
-                if (!slh->default_base_mode_flag)
-                {
-                    slh->adaptive_motion_prediction_flag = u(1);
-                    if (!slh->adaptive_motion_prediction_flag)
-                        slh->default_motion_prediction_flag = u(1);
-                }
-                slh->adaptive_residual_prediction_flag = u(1);
-                if (!slh->adaptive_residual_prediction_flag)
-                    slh->default_residual_prediction_flag = u(1);
+                slh->adaptive_motion_prediction_flag = u(1);
+                if (!slh->adaptive_motion_prediction_flag)
+                    slh->default_motion_prediction_flag = u(1);
             }
-            // defaults
-            slh->tcoeff_level_prediction_flag = sps->svc.seq_tcoeff_level_prediction_flag;
-            if (sps->svc.adaptive_tcoeff_level_prediction_flag == 1)
-                slh->tcoeff_level_prediction_flag = u(1);
+            slh->adaptive_residual_prediction_flag = u(1);
+            if (!slh->adaptive_residual_prediction_flag)
+                slh->default_residual_prediction_flag = u(1);
         }
-        m_slh_prev = *slh;
+        // defaults
+        slh->tcoeff_level_prediction_flag = sps->svc.seq_tcoeff_level_prediction_flag;
+        if (sps->svc.adaptive_tcoeff_level_prediction_flag == 1)
+            slh->tcoeff_level_prediction_flag = u(1);
     }
+    m_slh_prev = *slh;
 
     // update layer info
     if (m_bUseSVC) {
@@ -4010,7 +4328,8 @@ void VulkanH264Decoder::gaps_in_frame_num()
                     break;
                 }
             }
-            if ((!bad_edit) && ((sps->flags.gaps_in_frame_num_value_allowed_flag) || (sps->max_num_ref_frames > 1)))
+            if ((!bad_edit) && ((sps->flags.gaps_in_frame_num_value_allowed_flag) || (sps->max_num_ref_frames > 1) ||
+                                m_decodeFilter.errorResilient))
             {
                 // DPB handling (C.4.2)
                 while (dpb_full())
@@ -4618,7 +4937,7 @@ void VulkanH264Decoder::sei_payload(int payloadType, int payloadSize)
                     {
                         u(sps->vui.initial_cpb_removal_delay_length);   // initial_cpb_removal_delay
                         u(sps->vui.initial_cpb_removal_delay_length);   // initial_cpb_removal_delay_offset
-                        if (m_nalu.get_offset >= m_nalu.end_offset)     // bitstream error
+                        if (end())     // bitstream error
                             break;
                     }
                 }
@@ -4628,7 +4947,7 @@ void VulkanH264Decoder::sei_payload(int payloadType, int payloadSize)
                     {
                         u(sps->vui.initial_cpb_removal_delay_length); // initial_cpb_removal_delay
                         u(sps->vui.initial_cpb_removal_delay_length); // initial_cpb_removal_delay_offset
-                        if (m_nalu.get_offset >= m_nalu.end_offset)   // bitstream error
+                        if (end())   // bitstream error
                             break;
                     }
                 }
@@ -20,6 +20,8 @@
 //
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cstddef>
 #include <limits>
 #include "vkvideo_parser/VulkanVideoParserIf.h"
 #include "nvVulkanh265ScalingList.h"
@@ -28,6 +30,29 @@
 
 static inline int CeilLog2(int n) { return (n > 0) ? Log2U31(n-1) : 0; }
 
+// Splits the delta POCs of a short-term RPS into the lists of the picture, relative to its POC (8.3.2), so the
+// sets of the SPS are only derived once and the pictures using them by index just offset the lists
+static void derive_short_term_ref_pic_lists(short_term_ref_pic_set_s *strps)
+{
+    int j = 0, k = 0;
+    for (int i = 0; i < strps->NumNegativePics; i++) {
+        if (strps->UsedByCurrPicS0[i])
+            strps->DeltaPocStCurrBefore[j++] = strps->DeltaPocS0[i];
+        else
+            strps->DeltaPocStFoll[k++] = strps->DeltaPocS0[i];
+    }
+    strps->NumDeltaPocsStCurrBefore = (uint8_t)j;
+    j = 0;
+    for (int i = 0; i < strps->NumPositivePics; i++) {
+        if (strps->UsedByCurrPicS1[i])
+            strps->DeltaPocStCurrAfter[j++] = strps->DeltaPocS1[i];
+        else
+            strps->DeltaPocStFoll[k++] = strps->DeltaPocS1[i];
+    }
+    strps->NumDeltaPocsStCurrAfter = (uint8_t)j;
+    strps->NumDeltaPocsStFoll = (uint8_t)k;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Construction/Destruction
@@ -40,6 +65,8 @@ VulkanH265Decoder::VulkanH265Decoder(VkVideoCodecOperationFlagBitsKHR std)
     m_dpb_cur = NULL;
     m_current_dpb_id = -1;
     memset(&m_dpb, 0, sizeof(m_dpb));
+    m_numSliceHeaders = 0;
+    m_sliceHeaderBytesCleared = 0;
     m_display = NULL;
 }
 
@@ -56,6 +83,11 @@ VulkanH265Decoder::~VulkanH265Decoder()
 void VulkanH265Decoder::CreatePrivateContext()
 {
     m_pParserData = new H265ParserData();
+
+    const uint32_t maxFreeParameterSets = StdVideoPictureParametersSetPool<hevc_seq_param_s>::DEFAULT_MAX_FREE_PARAMETER_SETS;
+    StdVideoPictureParametersSetPool<hevc_seq_param_s>::Create(maxFreeParameterSets, m_spsPool);
+    StdVideoPictureParametersSetPool<hevc_pic_param_s>::Create(maxFreeParameterSets, m_ppsPool);
+    StdVideoPictureParametersSetPool<hevc_video_param_s>::Create(maxFreeParameterSets, m_vpsPool);
 }
 
 void VulkanH265Decoder::FreeContext()
@@ -79,6 +111,14 @@ void VulkanH265Decoder::EndOfStream()
 {
     flush_decoded_picture_buffer();
     memset(&m_slh, 0, sizeof(m_slh));
+    if (m_numSliceHeaders > 0) {
+        nvParserVerboseLog("Slice headers: %llu, %llu of %u bytes cleared per slice header on average\n",
+                           (unsigned long long)m_numSliceHeaders,
+                           (unsigned long long)(m_sliceHeaderBytesCleared / m_numSliceHeaders),
+                           (uint32_t)sizeof(hevc_slice_header_s));
+    }
+    m_numSliceHeaders = 0;
+    m_sliceHeaderBytesCleared = 0;
 
     for (uint32_t i = 0; i < sizeof (m_vpss) / sizeof (m_vpss[0]); i++) {
         m_vpss[i] = nullptr;
@@ -263,6 +303,51 @@ bool VulkanH265Decoder::IsPictureBoundary(int32_t rbsp_size)
 }
 
 
+bool VulkanH265Decoder::DropNalUnit()
+{
+    if (!m_decodeFilter.referencePicturesOnly && !m_decodeFilter.randomAccessPicturesOnly &&
+            (m_decodeFilter.maxTemporalLayers == 0)) {
+        return false;
+    }
+
+    const int nal_unit_type = u(1+6); // forbidden_zero_bit, nal_unit_type
+    const int nuh_layer_id = u(6);
+    const int nuh_temporal_id_plus1 = u(3);
+    if ((nal_unit_type > 0x3f) || (nuh_temporal_id_plus1 > 0x7) || (nuh_temporal_id_plus1 <= 0)) {
+        return false; // discarded by ParseNalUnit()
+    }
+    const int TemporalId = nuh_temporal_id_plus1 - 1;
+
+    // The sub-bitstream extraction of C.10: the pictures only refer to the ones of the same or lower sub-layers
+    if ((m_decodeFilter.maxTemporalLayers > 0) && (TemporalId >= (int)m_decodeFilter.maxTemporalLayers)) {
+        return true;
+    }
+
+    const bool isSlice = (nal_unit_type >= NUT_TRAIL_N && nal_unit_type <= NUT_RASL_R) ||
+                         (nal_unit_type >= NUT_BLA_W_LP && nal_unit_type <= NUT_CRA_NUT);
+    if (!isSlice) {
+        return false;
+    }
+
+    const bool isIrapPic = (nal_unit_type >= NUT_BLA_W_LP && nal_unit_type <= 23);
+    if (m_decodeFilter.randomAccessPicturesOnly && !isIrapPic) {
+        return true;
+    }
+
+    // The sub-layer non-reference pictures (all even values < 16) may still be referred to by the pictures of
+    // the higher sub-layers, they are only dropped in the highest sub-layer decoded.
+    const bool isSubLayerNonRef = (nal_unit_type <= 14) && ((nal_unit_type & 1) == 0);
+    if (m_decodeFilter.referencePicturesOnly && isSubLayerNonRef &&
+            (nuh_layer_id < MAX_VPS_LAYERS) && m_active_sps[nuh_layer_id]) {
+        int HighestTid = m_active_sps[nuh_layer_id]->sps_max_sub_layers_minus1;
+        if (m_decodeFilter.maxTemporalLayers > 0) {
+            HighestTid = std::min(HighestTid, (int)m_decodeFilter.maxTemporalLayers - 1);
+        }
+        return (TemporalId >= HighestTid);
+    }
+    return false;
+}
+
 int32_t VulkanH265Decoder::ParseNalUnit()
 {
     int retval = NALU_DISCARD;
@@ -305,6 +390,16 @@ int32_t VulkanH265Decoder::ParseNalUnit()
         if ((nal_unit_type >= NUT_TRAIL_N && nal_unit_type <= NUT_RASL_R) || (nal_unit_type >= NUT_BLA_W_LP && nal_unit_type <= NUT_CRA_NUT))
         {
             // slice_layer_rbsp
+            if (!m_bPictureStarted)
+            {
+                m_deferredSliceCheck = nullptr;
+            }
+            else if (m_deferredSliceCheck && defer_slice_header(nal_unit_type))
+            {
+                m_intra_pic_flag &= (m_slh.slice_type == SLICE_TYPE_I);
+                retval = NALU_SLICE;
+                break;
+            }
             if (slice_header(nal_unit_type, nuh_temporal_id_plus1))
             {
                 if (!m_bPictureStarted) // 1st slice - can't rely on first_slice_segment_in_pic_flag if there are data drops
@@ -320,7 +415,9 @@ int32_t VulkanH265Decoder::ParseNalUnit()
                     }
 
                     if (isIrapPic) {
-                        NoRaslOutputFlag = (nal_unit_type <= NUT_IDR_N_LP); // BLA or IDR
+                        // When the pictures in between are dropped, each CRA picture starts a new coded video
+                        // sequence, as HandleCraAsBlaFlag would do.
+                        NoRaslOutputFlag = (nal_unit_type <= NUT_IDR_N_LP) || m_decodeFilter.randomAccessPicturesOnly; // BLA or IDR
                     }
 
                     StdVideoH265SequenceParameterSet* p_active_sps(*m_active_sps[m_nuh_layer_id]);
@@ -335,7 +432,7 @@ int32_t VulkanH265Decoder::ParseNalUnit()
                     }
 
                     if ((isIrapPic && NoRaslOutputFlag) || (discontinuity) || (!m_MaxDpbSize)) {
-                        int NoOutputOfPriorPicsFlag = (slh->nal_unit_type == NUT_CRA_NUT) ? 1 : slh->no_output_of_prior_pics_flag;
+                        int NoOutputOfPriorPicsFlag = (slh->nal_unit_type == NUT_CRA_NUT) ? !m_decodeFilter.randomAccessPicturesOnly : slh->no_output_of_prior_pics_flag;
                         if (m_nuh_layer_id == 0) {
                             flush_decoded_picture_buffer(NoOutputOfPriorPicsFlag);
                         }
@@ -360,6 +457,9 @@ int32_t VulkanH265Decoder::ParseNalUnit()
                     m_max_dec_pic_buffering = std::max(sps->max_dec_pic_buffering, vps_max_dec_pic_buffering);
 
                     dpb_picture_start(pps, slh);
+                    if (m_decodeFilter.deferSliceHeaders && (m_nuh_layer_id == 0)) {
+                        init_deferred_slice_check(sps, pps);
+                    }
                     m_intra_pic_flag = 1; // updated further down
                 }
                 else
@@ -394,7 +494,7 @@ void VulkanH265Decoder::seq_parameter_set_rbsp()
 {
 
     VkSharedBaseObj<hevc_seq_param_s> sps;
-    VkResult result = hevc_seq_param_s::Create(0, sps);
+    VkResult result = m_spsPool ? m_spsPool->Acquire(0, sps) : hevc_seq_param_s::Create(0, sps);
     assert((result == VK_SUCCESS) && sps);
     if (result != VK_SUCCESS) {
         return;
@@ -433,6 +533,15 @@ void VulkanH265Decoder::seq_parameter_set_rbsp()
     sps_error |= (seq_parameter_set_id >= MAX_NUM_SPS);
     sps->sps_seq_parameter_set_id = (uint8_t)seq_parameter_set_id;
 
+    // A repeat of the SPS in use, parsed against the same VPS, needs neither parsing nor a client update
+    uint64_t contentHash = 0;
+    if (!sps_error && (!vps || (vps->GetContentHash() != 0))) {
+        contentHash = nal_content_hash(vps ? vps->GetContentHash() : 0);
+        if (m_spss[seq_parameter_set_id] && (m_spss[seq_parameter_set_id]->GetContentHash() == contentHash)) {
+            return;
+        }
+    }
+
     if (MultiLayerExtSpsFlag) {
         if (u(1)) { // update_rep_format_flag
             sps->sps_rep_format_idx = u(8);
@@ -692,6 +801,7 @@ void VulkanH265Decoder::seq_parameter_set_rbsp()
         sps->pSequenceParameterSetVui = NULL;
     }
 
+    sps->SetContentHash(contentHash);
 
     if (m_outOfBandPictureParameters && m_pClient) {
 
@@ -711,7 +821,7 @@ void VulkanH265Decoder::seq_parameter_set_rbsp()
 void VulkanH265Decoder::pic_parameter_set_rbsp()
 {
     VkSharedBaseObj<hevc_pic_param_s> pps;
-    VkResult result = hevc_pic_param_s::Create(0, pps);
+    VkResult result = m_ppsPool ? m_ppsPool->Acquire(0, pps) : hevc_pic_param_s::Create(0, pps);
     assert((result == VK_SUCCESS) && pps);
     if (result != VK_SUCCESS) {
         return;
@@ -730,6 +840,15 @@ void VulkanH265Decoder::pic_parameter_set_rbsp()
     pps->pps_seq_parameter_set_id = (uint8_t)seq_parameter_set_id;
     const hevc_seq_param_s* sps = m_spss[pps->pps_seq_parameter_set_id];
 
+    // A repeat of the PPS in use, parsed against the same SPS, needs neither parsing nor a client update
+    uint64_t contentHash = 0;
+    if (!sps || (sps->GetContentHash() != 0)) {
+        contentHash = nal_content_hash(sps ? sps->GetContentHash() : 0);
+        if (m_ppss[pic_parameter_set_id] && (m_ppss[pic_parameter_set_id]->GetContentHash() == contentHash)) {
+            return;
+        }
+    }
+
     // In case we receive pps before sps, m_spss[] will return sps as NULL.
     // Setting the sps_video_parameter_set_id as 0 for this case.
     // This also implies that with h.265 we need to cache the PPS/SPS data before we get a valid VPS at the client side.
@@ -887,6 +1006,8 @@ void VulkanH265Decoder::pic_parameter_set_rbsp()
         pps->pScalingLists = NULL;
     }
 
+    pps->SetContentHash(contentHash);
+
     if (m_outOfBandPictureParameters && m_pClient) {
 
         pps->SetSequenceCount(m_pParserData->ppsClientUpdateCount[pic_parameter_set_id]++);
@@ -911,8 +1032,14 @@ void VulkanH265Decoder::video_parameter_set_rbsp()
         return;
     }
 
+    // A repeat of the VPS in use needs neither parsing nor a client update
+    const uint64_t contentHash = nal_content_hash(0);
+    if (m_vpss[vps_video_parameter_set_id] && (m_vpss[vps_video_parameter_set_id]->GetContentHash() == contentHash)) {
+        return;
+    }
+
     VkSharedBaseObj<hevc_video_param_s> vps;
-    VkResult result = hevc_video_param_s::Create(0, vps);
+    VkResult result = m_vpsPool ? m_vpsPool->Acquire(0, vps) : hevc_video_param_s::Create(0, vps);
     assert((result == VK_SUCCESS) && vps);
     if (result != VK_SUCCESS) {
         return;
@@ -1067,6 +1194,8 @@ void VulkanH265Decoder::video_parameter_set_rbsp()
         }
     }
 
+    vps->SetContentHash(contentHash);
+
     if (m_outOfBandPictureParameters && m_pClient) {
 
         vps->SetSequenceCount(m_pParserData->vpsClientUpdateCount[vps_video_parameter_set_id]++);
@@ -1912,6 +2041,7 @@ StdVideoH265ShortTermRefPicSet* VulkanH265Decoder::short_term_ref_pic_set(StdVid
             }
         }
     }
+    derive_short_term_ref_pic_lists(strps);
     return stdShortTermRefPicSet;
 }
 
@@ -2111,16 +2241,118 @@ void VulkanH265Decoder::hrd_parameters(hevc_video_hrd_param_s* pStdHrdParameters
 // Slice layer
 //
 
+// Snapshot of the first slice of the picture, for the checks of the other slice segment headers
+void VulkanH265Decoder::init_deferred_slice_check(const hevc_seq_param_s* sps, const hevc_pic_param_s* pps)
+{
+    std::shared_ptr<hevc_deferred_slice_check_s> pic = std::make_shared<hevc_deferred_slice_check_s>();
+    pic->nal_unit_type = m_slh.nal_unit_type;
+    pic->no_output_of_prior_pics_flag = m_slh.no_output_of_prior_pics_flag;
+    pic->pic_output_flag = m_slh.pic_output_flag;
+    pic->short_term_ref_pic_set_sps_flag = m_slh.short_term_ref_pic_set_sps_flag;
+    pic->short_term_ref_pic_set_idx = m_slh.short_term_ref_pic_set_idx;
+    pic->pic_order_cnt_lsb = m_slh.pic_order_cnt_lsb;
+    pic->dependent_slice_segments_enabled_flag = pps->flags.dependent_slice_segments_enabled_flag;
+    pic->num_extra_slice_header_bits = pps->num_extra_slice_header_bits;
+    pic->output_flag_present_flag = pps->flags.output_flag_present_flag;
+    pic->separate_colour_plane_flag = sps->flags.separate_colour_plane_flag;
+    pic->log2_max_pic_order_cnt_lsb = sps->log2_max_pic_order_cnt_lsb_minus4 + 4;
+    pic->num_short_term_ref_pic_sets = sps->num_short_term_ref_pic_sets;
+    const int Log2CtbSizeY = sps->log2_min_luma_coding_block_size_minus3 + 3 + sps->log2_diff_max_min_luma_coding_block_size;
+    const int PicWidthInCtbsY  = (sps->pic_width_in_luma_samples  + (1 << Log2CtbSizeY) - 1) / (1 << Log2CtbSizeY);
+    const int PicHeightInCtbsY = (sps->pic_height_in_luma_samples + (1 << Log2CtbSizeY) - 1) / (1 << Log2CtbSizeY);
+    pic->PicSizeInCtbsY = PicWidthInCtbsY * PicHeightInCtbsY;
+    m_deferredSliceCheck = pic;
+}
+
+// Only the syntax elements the picture needs from the slice segments after the first one are parsed here: the
+// offset of the slice segment is recorded all the same. Returns false, with the position unchanged, for the slice
+// segments that take the full slice_header() parsing.
+bool VulkanH265Decoder::defer_slice_header(int nal_unit_type)
+{
+    const hevc_deferred_slice_check_s* pic = m_deferredSliceCheck.get();
+    const int64_t rbsp_bitpos = m_nalu.rbsp_bitpos;
+    const bool RapPicFlag = (nal_unit_type >= NUT_BLA_W_LP) && (nal_unit_type <= NUT_CRA_NUT);
+    const uint32_t first_slice_segment_in_pic_flag = u(1);
+    const uint32_t no_output_of_prior_pics_flag = RapPicFlag ? u(1) : 0;
+    const uint32_t pic_parameter_set_id = ue();
+    bool deferred = !first_slice_segment_in_pic_flag && (m_nuh_layer_id == 0) && (nal_unit_type == pic->nal_unit_type) &&
+                    (pic_parameter_set_id == m_slh.pic_parameter_set_id);
+    if (deferred) {
+        const bool dependent_slice_segment_flag = pic->dependent_slice_segments_enabled_flag && u(1);
+        const uint32_t slice_segment_address = u(CeilLog2(pic->PicSizeInCtbsY));
+        deferred = (slice_segment_address >= 1) && (slice_segment_address < pic->PicSizeInCtbsY);
+        if (deferred && dependent_slice_segment_flag) {
+            // Of the same slice as the previous slice segment
+            deferred = (no_output_of_prior_pics_flag == pic->no_output_of_prior_pics_flag);
+        } else if (deferred) {
+            u(pic->num_extra_slice_header_bits); // slice_reserved_flag[]
+            const uint32_t slice_type = ue();
+            deferred = (slice_type <= 2);
+            if (deferred) {
+                m_slh.slice_type = (uint8_t)slice_type;
+                std::shared_ptr<const hevc_deferred_slice_check_s> picCheck = m_deferredSliceCheck;
+                defer_slice_header_check([picCheck, no_output_of_prior_pics_flag](NvVkRbspReader& rbsp) {
+                    return check_deferred_slice_header(*picCheck, no_output_of_prior_pics_flag, rbsp);
+                });
+            }
+        }
+    }
+    if (!deferred) {
+        m_nalu.rbsp_bitpos = rbsp_bitpos;
+    }
+    return deferred;
+}
+
+// The rest of the slice segment header, up to the short-term RPS, checked against the first slice of the picture
+bool VulkanH265Decoder::check_deferred_slice_header(const hevc_deferred_slice_check_s& pic, uint32_t no_output_of_prior_pics_flag,
+                                                    NvVkRbspReader& rbsp)
+{
+    const bool IdrPicFlag = (pic.nal_unit_type == NUT_IDR_W_RADL) || (pic.nal_unit_type == NUT_IDR_N_LP);
+    if (no_output_of_prior_pics_flag != pic.no_output_of_prior_pics_flag) {
+        return false;
+    }
+    if (pic.output_flag_present_flag && (rbsp.u(1) != pic.pic_output_flag)) {
+        return false;
+    }
+    if (pic.separate_colour_plane_flag && (rbsp.u(2) > 2)) { // colour_plane_id
+        return false;
+    }
+    if (IdrPicFlag) {
+        return true;
+    }
+    if (rbsp.u(pic.log2_max_pic_order_cnt_lsb) != pic.pic_order_cnt_lsb) {
+        return false;
+    }
+    if (rbsp.u(1) != pic.short_term_ref_pic_set_sps_flag) {
+        return false;
+    }
+    // The short-term RPS coded in the slice header is not compared
+    if (pic.short_term_ref_pic_set_sps_flag && (pic.num_short_term_ref_pic_sets > 1) &&
+        (rbsp.u(CeilLog2(pic.num_short_term_ref_pic_sets)) != pic.short_term_ref_pic_set_idx)) {
+        return false;
+    }
+    return true;
+}
+
 bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus1)
 {
 
     const bool RapPicFlag = (nal_unit_type >= NUT_BLA_W_LP) && (nal_unit_type <= NUT_CRA_NUT); // spec includes 2 reserved values (<=23)
     const bool IdrPicFlag = (nal_unit_type == NUT_IDR_W_RADL) || (nal_unit_type == NUT_IDR_N_LP);
 
-    // defaults
+    // defaults, the arrays of the slice header are cleared below for the entries it uses
     hevc_slice_header_s slhtmp;
     hevc_slice_header_s *slh = &slhtmp;
-    memset(slh, 0, sizeof(hevc_slice_header_s));
+    size_t bytesCleared = offsetof(hevc_slice_header_s, lt_idx_sps);
+    memset(slh, 0, bytesCleared);
+    slh->strps.NumNegativePics = 0;
+    slh->strps.NumPositivePics = 0;
+    slh->strps.inter_ref_pic_set_prediction_flag = 0;
+    slh->strps.delta_idx_minus1 = 0;
+    slh->strps.NumDeltaPocsStCurrBefore = 0;
+    slh->strps.NumDeltaPocsStCurrAfter = 0;
+    slh->strps.NumDeltaPocsStFoll = 0;
+    bytesCleared += offsetof(short_term_ref_pic_set_s, UsedByCurrPicS0);
     slh->nal_unit_type = (uint8_t) nal_unit_type;
     slh->nuh_temporal_id_plus1 = (uint8_t)nuh_temporal_id_plus1;
     slh->pic_output_flag = 1;
@@ -2253,7 +2485,13 @@ bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus
                     nvParserLog("Invalid num_long_term_sps + num_long_term_pics (%d + %d)\n", slh->num_long_term_sps, slh->num_long_term_pics);
                     return false;
                 }
-                for (uint32_t i = 0; i < (uint32_t)(slh->num_long_term_sps + slh->num_long_term_pics); i++) {
+                const uint32_t numLongTerm = slh->num_long_term_sps + slh->num_long_term_pics;
+                memset(slh->lt_idx_sps, 0, numLongTerm * sizeof(slh->lt_idx_sps[0]));
+                memset(slh->poc_lsb_lt, 0, numLongTerm * sizeof(slh->poc_lsb_lt[0]));
+                memset(slh->delta_poc_msb_cycle_lt, 0, numLongTerm * sizeof(slh->delta_poc_msb_cycle_lt[0]));
+                bytesCleared += numLongTerm * (sizeof(slh->lt_idx_sps[0]) + sizeof(slh->poc_lsb_lt[0]) +
+                                               sizeof(slh->delta_poc_msb_cycle_lt[0]));
+                for (uint32_t i = 0; i < numLongTerm; i++) {
                     if (i < slh->num_long_term_sps) {
                         if (sps->num_long_term_ref_pics_sps > 1) {
                             int v = CeilLog2(sps->num_long_term_ref_pics_sps);
@@ -2275,12 +2513,7 @@ bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus
             }
 
             const short_term_ref_pic_set_s *strps = !slh->short_term_ref_pic_set_sps_flag ? &slh->strps : &sps->strpss[slh->short_term_ref_pic_set_idx];
-            for (uint32_t i = 0; i < strps->NumNegativePics; i++) {
-                m_NumPocTotalCurr += strps->UsedByCurrPicS0[i];
-            }
-            for (uint32_t  i = 0; i < strps->NumPositivePics; i++) {
-                m_NumPocTotalCurr += strps->UsedByCurrPicS1[i];
-            }
+            m_NumPocTotalCurr += strps->NumDeltaPocsStCurrBefore + strps->NumDeltaPocsStCurrAfter;
             for (uint32_t i = 0; i < (uint32_t )(slh->num_long_term_sps + slh->num_long_term_pics); i++) {
                 int UsedByCurrPicLt =
                     (i < slh->num_long_term_sps) ? ((sps->stdLongTermRefPicsSps.used_by_curr_pic_lt_sps_flag >> slh->lt_idx_sps[i]) & 1)
@@ -2290,6 +2523,7 @@ bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus
         }
     }
 
+    bool interLayerPredLayerIdcParsed = false;
     if (m_nuh_layer_id > 0 && !vps->privFlags.default_ref_layers_active_flag &&
           vps->numDirectRefLayers[m_nuh_layer_id] > 0) {
         slh->inter_layer_pred_enabled_flag = (uint8_t) u(1);
@@ -2306,6 +2540,7 @@ bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus
                         codelength = CeilLog2(vps->numDirectRefLayers[m_nuh_layer_id]);
                         slh->inter_layer_pred_layer_idc[i] = (uint8_t) u(codelength);
                     }
+                    interLayerPredLayerIdcParsed = true;
                 }
             }
         }
@@ -2313,6 +2548,11 @@ bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus
 
     if (m_nuh_layer_id > 0) {
         getNumActiveRefLayerPics(vps, slh);
+        if (!interLayerPredLayerIdcParsed) {
+            const size_t numActiveRefLayerPics = std::min<size_t>(slh->numActiveRefLayerPics, MAX_VPS_LAYERS);
+            memset(slh->inter_layer_pred_layer_idc, 0, numActiveRefLayerPics);
+            bytesCleared += numActiveRefLayerPics;
+        }
     }
     if (sps->flags.sample_adaptive_offset_enabled_flag) {
         u(1 + 1); // slice_sao_luma_flag, slice_sao_chroma_flag
@@ -2331,7 +2571,11 @@ bool VulkanH265Decoder::slice_header(int nal_unit_type, int nuh_temporal_id_plus
         }
     }
 
+    // The remaining slice header syntax (weights, qp, deblocking, entry points) is not needed here,
+    // stop before it so the slice payload is never converted to RBSP.
     m_slh = *slh;
+    m_numSliceHeaders++;
+    m_sliceHeaderBytesCleared += bytesCleared;
     return true;
 }
 
@@ -2831,27 +3075,15 @@ void VulkanH265Decoder::reference_picture_set(hevc_slice_header_s *slh, int PicO
     else
     {
         const short_term_ref_pic_set_s *strps = !slh->short_term_ref_pic_set_sps_flag ? &slh->strps : &sps->strpss[slh->short_term_ref_pic_set_idx];
-        int j = 0;
-        int k = 0;
-        for (int i = 0; i < strps->NumNegativePics; i++)
-        {
-            if (strps->UsedByCurrPicS0[i])
-                PocStCurrBefore[j++] = PicOrderCntVal + strps->DeltaPocS0[i];
-            else
-                PocStFoll[k++] = PicOrderCntVal + strps->DeltaPocS0[i];
-        }
-        NumPocStCurrBefore = j;
-
-        j = 0;
-        for (int i = 0; i < strps->NumPositivePics; i++)
-        {
-            if (strps->UsedByCurrPicS1[i])
-                PocStCurrAfter[j++] = PicOrderCntVal + strps->DeltaPocS1[i];
-            else
-                PocStFoll[k++] = PicOrderCntVal + strps->DeltaPocS1[i];
-        }
-        NumPocStCurrAfter = j;
-        NumPocStFoll = k;
+        NumPocStCurrBefore = strps->NumDeltaPocsStCurrBefore;
+        for (int i = 0; i < NumPocStCurrBefore; i++)
+            PocStCurrBefore[i] = PicOrderCntVal + strps->DeltaPocStCurrBefore[i];
+        NumPocStCurrAfter = strps->NumDeltaPocsStCurrAfter;
+        for (int i = 0; i < NumPocStCurrAfter; i++)
+            PocStCurrAfter[i] = PicOrderCntVal + strps->DeltaPocStCurrAfter[i];
+        NumPocStFoll = strps->NumDeltaPocsStFoll;
+        for (int i = 0; i < NumPocStFoll; i++)
+            PocStFoll[i] = PicOrderCntVal + strps->DeltaPocStFoll[i];
 
         int PocLsbLt[16] = {0};
         bool UsedByCurrPicLt[16] = { false };
@@ -2874,8 +3106,8 @@ void VulkanH265Decoder::reference_picture_set(hevc_slice_header_s *slh, int PicO
             else
                 DeltaPocMSBCycleLt[i] = slh->delta_poc_msb_cycle_lt[i] + DeltaPocMSBCycleLt[i-1];
         }
-        j = 0;
-        k = 0;
+        int j = 0;
+        int k = 0;
         for (int i = 0; i < slh->num_long_term_sps + slh->num_long_term_pics; i++)
         {
             int pocLt = PocLsbLt[i];
@@ -2928,6 +3160,12 @@ void VulkanH265Decoder::reference_picture_set(hevc_slice_header_s *slh, int PicO
         if (m_RefPicSetLtCurr[i] < 0)
         {
             nvParserLog("long-term reference picture not available (POC=%d)\n", PocLtCurr[i]);
+            if (m_decodeFilter.errorResilient) {
+                m_RefPicSetLtCurr[i] = create_lost_ref_pic(PocLtCurr[i], m_nuh_layer_id, 2);
+                if (m_RefPicSetLtCurr[i] < 0) {
+                    m_RefPicSetLtCurr[i] = create_missing_ref_pic(PocLtCurr[i], m_nuh_layer_id);
+                }
+            }
         }
     }
 
@@ -2973,6 +3211,9 @@ void VulkanH265Decoder::reference_picture_set(hevc_slice_header_s *slh, int PicO
         {
             nvParserLog("short-term reference picture not available (POC=%d)\n", PocStCurrBefore[i]);
             m_RefPicSetStCurrBefore[i] = create_lost_ref_pic(PocStCurrBefore[i], m_nuh_layer_id, 1);
+            if ((m_RefPicSetStCurrBefore[i] < 0) && m_decodeFilter.errorResilient) {
+                m_RefPicSetStCurrBefore[i] = create_missing_ref_pic(PocStCurrBefore[i], m_nuh_layer_id);
+            }
         }
     }
 
@@ -2991,6 +3232,9 @@ void VulkanH265Decoder::reference_picture_set(hevc_slice_header_s *slh, int PicO
         {
             nvParserLog("short-term reference picture not available (POC=%d)\n", PocStCurrAfter[i]);
             m_RefPicSetStCurrAfter[i] = create_lost_ref_pic(PocStCurrAfter[i], m_nuh_layer_id, 1);
+            if ((m_RefPicSetStCurrAfter[i] < 0) && m_decodeFilter.errorResilient) {
+                m_RefPicSetStCurrAfter[i] = create_missing_ref_pic(PocStCurrAfter[i], m_nuh_layer_id);
+            }
         }
     }
 
@@ -3103,6 +3347,41 @@ int VulkanH265Decoder::create_lost_ref_pic(int lostPOC, int layerID, int marking
     return returnDPBPos;
 }
 
+// Without any picture of the layer to stand in for a lost reference, e.g. the IRAP picture itself was lost, a picture
+// buffer never decoded takes its place. The decoder finds it in the undefined layout and fills it with gray.
+// One entry is always left free for the current picture.
+int VulkanH265Decoder::create_missing_ref_pic(int lostPOC, int layerID)
+{
+    int missingDPBPos = -1;
+    int numFree = 0;
+    for (int i = 0; i < HEVC_DPB_SIZE; i++)
+    {
+        if (m_dpb[i].state == 0)
+        {
+            if (missingDPBPos < 0)
+                missingDPBPos = i;
+            numFree++;
+        }
+    }
+    if (numFree < 2)
+    {
+        return -1;
+    }
+    hevc_dpb_entry_s *missing = &m_dpb[missingDPBPos];
+    if (!missing->pPicBuf && !m_pClient->AllocPictureBuffer(&missing->pPicBuf))
+    {
+        nvParserLog("WARNING: Failed to allocate frame buffer picture\n");
+        return -1;
+    }
+    missing->state = 1;
+    missing->marking = 1;
+    missing->output = 0;
+    missing->PicOrderCntVal = lostPOC;
+    missing->LayerId = layerID;
+    nvParserLog("Generating a missing reference picture for picture %d\n", lostPOC);
+    return missingDPBPos;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // SEI payload (D.2)
@@ -3131,6 +3410,11 @@ void VulkanH265Decoder::sei_payload()
             nvParserLog("ignoring truncated SEI message (%d/%d)\n", payloadSize, available_bits() / 8);
             break;
         }
+        if (!sei_payload_selected(payloadType))
+        {
+            skip_bits(payloadSize * 8);
+            continue;
+        }
         bitsUsed = consumed_bits();
 
         switch (payloadType)
@@ -21,6 +21,21 @@
 #include "nvVulkanVideoParser.h"
 #include <algorithm>
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NV_STARTCODE_SCAN_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NV_STARTCODE_SCAN_NEON 1
+#include <arm_neon.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 VulkanVideoDecoder::VulkanVideoDecoder(VkVideoCodecOperationFlagBitsKHR std)
   : m_refCount(0),
     m_standard(std),
@@ -32,11 +47,19 @@ VulkanVideoDecoder::VulkanVideoDecoder(VkVideoCodecOperationFlagBitsKHR std)
     m_bufferOffsetAlignment(256),
     m_bufferSizeAlignment(256),
     m_bitstreamData(),
-    m_bitstreamDataLen()
+    m_bitstreamDataLen(),
+    m_pBitstreamSource(),
+    m_bitstreamSourceOffset(),
+    m_pPacketData(),
+    m_packetDataSize(),
+    m_bZeroCopyBitstream(false),
+    m_sliceHeaderThreadExit(false),
+    m_sliceHeaderMismatches(0)
 {
     m_bNoStartCodes = false;
     m_lMinBytesForBoundaryDetection = 256;
     m_bFilterTimestamps = false;
+    memset(&m_pictureSizes, 0, sizeof(m_pictureSizes));
     if (m_264SvcEnabled)
     {
         m_pVkPictureData = new VkParserPictureData[128];
@@ -80,6 +103,7 @@ VkResult VulkanVideoDecoder::Initialize(const VkParserInitDecodeParameters *pPar
     m_outOfBandPictureParameters = pParserPictureData->outOfBandPictureParameters;
     m_lClockRate = (pParserPictureData->referenceClockRate > 0) ? pParserPictureData->referenceClockRate : 10000000; // Use 10Mhz as default clock
     m_lErrorThreshold = pParserPictureData->errorThreshold;
+    m_decodeFilter = pParserPictureData->decodeFilter;
     m_bDiscontinuityReported = false;
     m_lFrameDuration = 0;
     m_llExpectedPTS = 0;
@@ -104,6 +128,10 @@ VkResult VulkanVideoDecoder::Initialize(const VkParserInitDecodeParameters *pPar
         return VK_ERROR_OUT_OF_HOST_MEMORY;
     }
     m_bitstreamDataLen = m_bitstreamData.SetBitstreamBuffer(bitstreamBuffer);
+    m_pBitstreamSource = nullptr;
+    m_bitstreamSourceOffset = 0;
+    m_bZeroCopyBitstream = false;
+    memset(&m_pictureSizes, 0, sizeof(m_pictureSizes));
     CreatePrivateContext();
     memset(&m_nalu, 0, sizeof(m_nalu));
     memset(&m_PrevSeqInfo, 0, sizeof(m_PrevSeqInfo));
@@ -126,6 +154,7 @@ VkResult VulkanVideoDecoder::Initialize(const VkParserInitDecodeParameters *pPar
 
 bool VulkanVideoDecoder::Deinitialize()
 {
+    stop_slice_header_checks();
     FreeContext();
     m_bitstreamData.ResetBitstreamBuffer();
     return true;
@@ -137,49 +166,53 @@ void VulkanVideoDecoder::init_dbits()
     m_nalu.get_offset = m_nalu.start_offset + ((m_bNoStartCodes) ? 0 : 3);  // Skip over start_code_prefix
     m_nalu.get_zerocnt = 0;
     m_nalu.get_emulcnt = 0;
-    m_nalu.get_bfr = 0;
-    // prime bit buffer
-    m_nalu.get_bfroffs = 32;
-    skip_bits(0);
+    m_nalu.rbsp_size = 0;
+    m_nalu.rbsp_bitpos = 0;
 }
 
 
-void VulkanVideoDecoder::skip_bits(uint32_t n)
+void VulkanVideoDecoder::fill_rbsp(int64_t rbspSize)
 {
-    m_nalu.get_bfroffs += n;
-    while (m_nalu.get_bfroffs >= 8)
-    {
-        m_nalu.get_bfr <<= 8;
-        if (m_nalu.get_offset < m_nalu.end_offset)
-        {
-            VkDeviceSize c = m_bitstreamData[m_nalu.get_offset++];
-            if (m_bEmulBytesPresent)
-            {
-                // detect / discard emulation_prevention_three_byte
-                if (m_nalu.get_zerocnt == 2)
-                {
-                    if (c == 3)
-                    {
-                        m_nalu.get_zerocnt = 0;
-                        c = (m_nalu.get_offset < m_nalu.end_offset) ? m_bitstreamData[m_nalu.get_offset] : 0;
-                        m_nalu.get_offset++;
-                        m_nalu.get_emulcnt++;
-                    }
-                }
-                if (c != 0)
-                    m_nalu.get_zerocnt = 0;
-                else
-                    m_nalu.get_zerocnt += (m_nalu.get_zerocnt < 2);
+    if (m_nalu.get_offset >= m_nalu.end_offset) {
+        return;
+    }
+    // Convert in chunks to amortize the call overhead, without running too far ahead of the reader
+    const int64_t minChunkSize = 64;
+    int64_t bytesToConvert = std::max<int64_t>(rbspSize - m_nalu.rbsp_size, minChunkSize);
+    bytesToConvert = std::min<int64_t>(bytesToConvert, m_nalu.end_offset - m_nalu.get_offset);
+    const size_t requiredSize = (size_t)(m_nalu.rbsp_size + bytesToConvert + RBSP_READ_PADDING);
+    if (m_rbspData.size() < requiredSize) {
+        m_rbspData.resize(std::max<size_t>(requiredSize, 2 * m_rbspData.size()));
+    }
+
+    const uint8_t* pSrc = m_bitstreamData.GetBitstreamPtr() + m_nalu.get_offset;
+    const uint8_t* const pSrcEnd = pSrc + bytesToConvert;
+    uint8_t* pDst = &m_rbspData[(size_t)m_nalu.rbsp_size];
+    if (!m_bEmulBytesPresent) {
+        memcpy(pDst, pSrc, (size_t)bytesToConvert);
+        pDst += bytesToConvert;
+        pSrc = pSrcEnd;
+    } else {
+        int32_t zeroCount = m_nalu.get_zerocnt;
+        while (pSrc < pSrcEnd) {
+            const uint8_t c = *pSrc++;
+            if ((zeroCount == 2) && (c == 3)) {
+                // discard emulation_prevention_three_byte
+                zeroCount = 0;
+                m_nalu.get_emulcnt++;
+                continue;
             }
-            m_nalu.get_bfr |= c;
-        } else
-        {
-            m_nalu.get_offset++;
+            zeroCount = (c != 0) ? 0 : (zeroCount + (zeroCount < 2));
+            *pDst++ = c;
         }
-        m_nalu.get_bfroffs -= 8;
+        m_nalu.get_zerocnt = zeroCount;
     }
+    m_nalu.get_offset += bytesToConvert;
+    m_nalu.rbsp_size = pDst - m_rbspData.data();
+    memset(pDst, 0, RBSP_READ_PADDING);
 }
 
+
 void VulkanVideoDecoder::rbsp_trailing_bits()
 {
     f(1, 1); // rbsp_stop_one_bit
@@ -189,41 +222,74 @@ void VulkanVideoDecoder::rbsp_trailing_bits()
 
 bool VulkanVideoDecoder::more_rbsp_data()
 {
-    // If the NAL unit contains any non-zero bits past the next bit we have more RBSP data.
-    // These non-zero bits may either already be in bfr (first check)
-    // or may not have been read yet (second check).
-    // Note that the assumption that end() == false implies that there are more unread
-    // non-zero bits is invalid for CABAC slices (because of cabac_zero_word). This is not
-    // a problem because more_rbsp_data is not used in CABAC slices. 
-    return (m_nalu.get_bfr << (m_nalu.get_bfroffs+1)) != 0 || !end();
+    // If the NAL unit contains any non-zero bits past the next bit we have more RBSP data,
+    // otherwise the next bit is the rbsp_stop_one_bit.
+    // Note that this is not valid for CABAC slices (because of cabac_zero_word). This is not
+    // a problem because more_rbsp_data is not used in CABAC slices.
+    const int64_t bitpos = m_nalu.rbsp_bitpos + 1;
+    int64_t byteOffset = bitpos >> 3;
+    for (;;) {
+        if (byteOffset >= m_nalu.rbsp_size) {
+            fill_rbsp(byteOffset + 1);
+            if (byteOffset >= m_nalu.rbsp_size) {
+                return false;
+            }
+        }
+        uint8_t rbspByte = m_rbspData[(size_t)byteOffset];
+        if (byteOffset == (bitpos >> 3)) {
+            rbspByte &= (0xff >> (bitpos & 7));
+        }
+        if (rbspByte != 0) {
+            return true;
+        }
+        byteOffset++;
+    }
 }
 
-uint32_t VulkanVideoDecoder::u(uint32_t n)
+// 64-bit FNV-1a hash of the current NAL unit bytes, header included and trailing zero bytes excluded,
+// seeded with the content hash of the parameter set the NAL unit is parsed against (0 if none).
+// Never returns 0, which is reserved for the parameter sets without a known content.
+uint64_t VulkanVideoDecoder::nal_content_hash(uint64_t parentHash)
 {
-    uint32_t bits = 0;
-    
-    if (n > 0)
-    {
-        if (n + m_nalu.get_bfroffs <= 32)
-        {
-            bits = next_bits(n);
-            skip_bits(n);
-        } else
-        {
-            // n == 26..32
-            bits = next_bits(n-25) << 25;
-            skip_bits(n-25);
-            bits |= next_bits(25);
-            skip_bits(25);
-        }
+    const uint8_t* pData = m_bitstreamData.GetBitstreamPtr();
+    const int64_t startOffset = m_nalu.start_offset + ((m_bNoStartCodes) ? 0 : 3);
+    int64_t endOffset = m_nalu.end_offset;
+    while ((endOffset > startOffset) && (pData[endOffset - 1] == 0)) {
+        endOffset--;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL ^ parentHash;
+    for (int64_t i = startOffset; i < endOffset; i++) {
+        hash ^= pData[i];
+        hash *= 0x100000001b3ULL;
     }
-    return bits;
+    return (hash != 0) ? hash : 1;
 }
 
+static inline uint32_t CountLeadingZeros32(uint32_t value)
+{
+    assert(value != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return 31 - (uint32_t)index;
+#else
+    return (uint32_t)__builtin_clz(value);
+#endif
+}
 
 // 9.1
 uint32_t VulkanVideoDecoder::ue()
 {
+    const uint32_t bits = peek_bits32();
+    if (bits >= (1u << 16)) {
+        // Fast path: the whole codeword (up to 31 bits) is in the 32-bit window
+        const uint32_t leadingZeroBits = CountLeadingZeros32(bits);
+        const uint32_t codeLength = 2 * leadingZeroBits + 1;
+        m_nalu.rbsp_bitpos += codeLength;
+        return (bits >> (32 - codeLength)) - 1;
+    }
+
     int leadingZeroBits, b, codeNum;
 
     leadingZeroBits = -1;
@@ -256,28 +322,225 @@ int32_t VulkanVideoDecoder::se()
 }
 
 
+// Start code scanners: each returns the offset of the first 00.00.01 sequence
+// fully contained in [pdatain, pdatain + datasize) or datasize if there is none.
+
+// Portable scanner: skips up to 3 bytes per iteration based on the third byte of the window
+static size_t FindStartCodeScalar(const uint8_t *pdatain, size_t datasize)
+{
+    size_t i = 0;
+    while (i + 2 < datasize) {
+        if (pdatain[i + 2] > 1) {
+            i += 3;
+        } else if (pdatain[i + 1] != 0) {
+            i += 2;
+        } else if ((pdatain[i] != 0) || (pdatain[i + 2] != 1)) {
+            i++;
+        } else {
+            return i;
+        }
+    }
+    return datasize;
+}
+
+#if defined(NV_STARTCODE_SCAN_X86)
+static inline uint32_t CountTrailingZeros32(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+static size_t FindStartCodeSSE2(const uint8_t *pdatain, size_t datasize)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 18 <= datasize; i += 16) {
+        const __m128i b0 = _mm_loadu_si128((const __m128i*)(pdatain + i));
+        const __m128i b1 = _mm_loadu_si128((const __m128i*)(pdatain + i + 1));
+        const __m128i b2 = _mm_loadu_si128((const __m128i*)(pdatain + i + 2));
+        const __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                            _mm_cmpeq_epi8(b2, one));
+        const uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+        if (mask) {
+            return i + CountTrailingZeros32(mask);
+        }
+    }
+    const size_t tail = FindStartCodeScalar(pdatain + i, datasize - i);
+    return i + tail;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+static size_t FindStartCodeAVX2(const uint8_t *pdatain, size_t datasize)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 34 <= datasize; i += 32) {
+        const __m256i b0 = _mm256_loadu_si256((const __m256i*)(pdatain + i));
+        const __m256i b1 = _mm256_loadu_si256((const __m256i*)(pdatain + i + 1));
+        const __m256i b2 = _mm256_loadu_si256((const __m256i*)(pdatain + i + 2));
+        const __m256i match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+                                               _mm256_cmpeq_epi8(b2, one));
+        const uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+        if (mask) {
+            return i + CountTrailingZeros32(mask);
+        }
+    }
+    const size_t tail = FindStartCodeSSE2(pdatain + i, datasize - i);
+    return i + tail;
+}
+
+static bool CpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] < 7) {
+        return false;
+    }
+    __cpuid(cpuInfo, 1);
+    const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    const bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || ((_xgetbv(0) & 0x6) != 0x6)) {
+        return false;
+    }
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+#endif // NV_STARTCODE_SCAN_X86
+
+#if defined(NV_STARTCODE_SCAN_NEON)
+static inline uint32_t CountTrailingZeros64(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(mask);
+#endif
+}
+
+static size_t FindStartCodeNEON(const uint8_t *pdatain, size_t datasize)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    size_t i = 0;
+    for (; i + 18 <= datasize; i += 16) {
+        const uint8x16_t b0 = vld1q_u8(pdatain + i);
+        const uint8x16_t b1 = vld1q_u8(pdatain + i + 1);
+        const uint8x16_t b2 = vld1q_u8(pdatain + i + 2);
+        const uint8x16_t match = vandq_u8(vandq_u8(vceqq_u8(b0, zero), vceqq_u8(b1, zero)), vceqq_u8(b2, one));
+        // Narrow each byte of the match vector to a nibble of a 64-bit mask
+        const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+        if (mask) {
+            return i + (CountTrailingZeros64(mask) >> 2);
+        }
+    }
+    const size_t tail = FindStartCodeScalar(pdatain + i, datasize - i);
+    return i + tail;
+}
+#endif // NV_STARTCODE_SCAN_NEON
+
+typedef size_t (*FindStartCodeFunc)(const uint8_t *pdatain, size_t datasize);
+
+static FindStartCodeFunc SelectFindStartCode()
+{
+#if defined(NV_STARTCODE_SCAN_X86)
+    return CpuSupportsAVX2() ? FindStartCodeAVX2 : FindStartCodeSSE2;
+#elif defined(NV_STARTCODE_SCAN_NEON)
+    return FindStartCodeNEON;
+#else
+    return FindStartCodeScalar;
+#endif
+}
+
+static const FindStartCodeFunc gFindStartCode = SelectFindStartCode();
+
 size_t VulkanVideoDecoder::next_start_code(const uint8_t *pdatain, size_t datasize, bool& found_start_code)
 {
     uint32_t bfr = m_BitBfr;
     size_t i = 0;
+
+    // A start code may straddle the previous packet: check the first two bytes against the carried-over bits
+    const size_t carryOverBytes = std::min<size_t>(datasize, 2);
     do
     {
         bfr = (bfr << 8) | pdatain[i++];
         if ((bfr & 0x00ffffff) == 1) {
-            break;
+            m_BitBfr = bfr;
+            found_start_code = true;
+            return i;
         }
-    } while (i < datasize);
+    } while (i < carryOverBytes);
+
+    if (datasize > carryOverBytes) {
+        const size_t startCodeOffset = gFindStartCode(pdatain, datasize);
+        i = (startCodeOffset < datasize) ? (startCodeOffset + 3) : datasize;
+        // Keep the last (up to) four consumed bytes for the next call
+        for (size_t j = (i > (carryOverBytes + 4)) ? (i - 4) : carryOverBytes; j < i; j++) {
+            bfr = (bfr << 8) | pdatain[j];
+        }
+    }
     m_BitBfr = bfr;
     found_start_code = ((bfr & 0x00ffffff) == 1);
     return i;
 }
 
+// Same as next_start_code(), but using the start code table that came with the packet
+size_t VulkanVideoDecoder::lookup_start_code(const VkParserBitstreamPacket* pck, size_t packetOffset, size_t datasize,
+                                             uint32_t& startCodeIndex, bool& found_start_code)
+{
+    while ((startCodeIndex < pck->nStartCodeOffsets) && (pck->pStartCodeOffsets[startCodeIndex] <= packetOffset)) {
+        startCodeIndex++;
+    }
+    size_t i = datasize;
+    found_start_code = false;
+    if ((startCodeIndex < pck->nStartCodeOffsets) && (pck->pStartCodeOffsets[startCodeIndex] <= (packetOffset + datasize))) {
+        i = pck->pStartCodeOffsets[startCodeIndex] - packetOffset;
+        found_start_code = true;
+    }
+    // Keep the bit buffer in sync for the next_start_code() calls past the end of the table
+    const uint8_t* pdatain = pck->pByteStream + packetOffset;
+    uint32_t bfr = m_BitBfr;
+    for (size_t j = (i > 4) ? (i - 4) : 0; j < i; j++) {
+        bfr = (bfr << 8) | pdatain[j];
+    }
+    m_BitBfr = bfr;
+    return i;
+}
+
 bool VulkanVideoDecoder::resizeBitstreamBuffer(VkDeviceSize extraBytes)
 {
-    // increasing min 2MB size per resizeBitstreamBuffer()
-    VkDeviceSize newBitstreamDataLen = m_bitstreamDataLen + std::max<VkDeviceSize>(extraBytes, (2 * 1024 * 1024));
+    const VkDeviceSize requiredDataLen = m_bitstreamDataLen + extraBytes;
+    if (m_bZeroCopyBitstream) {
+        // Don't copy the rest of the input along with a buffer referencing it in place
+        if (!detachBitstreamBuffer()) {
+            return false;
+        }
+        if (requiredDataLen <= m_bitstreamDataLen) {
+            return true;
+        }
+    }
+
+    // Grow at least twice as large, or as large as recent pictures needed, so that a large picture
+    // doesn't keep reallocating and copying its data. Only the data of the current picture is copied.
+    VkDeviceSize newBitstreamDataLen = getBitstreamBufferSize(std::max<VkDeviceSize>(requiredDataLen, 2 * m_bitstreamDataLen));
 
-    VkDeviceSize retSize = m_bitstreamData.ResizeBitstreamBuffer(newBitstreamDataLen, m_bitstreamDataLen, 0);
+    VkDeviceSize retSize = m_bitstreamData.ResizeBitstreamBuffer(newBitstreamDataLen, m_nalu.end_offset, 0);
     if (retSize < newBitstreamDataLen)
     {
         assert(!"bitstream buffer resize failed");
@@ -285,6 +548,10 @@ bool VulkanVideoDecoder::resizeBitstreamBuffer(VkDeviceSize extraBytes)
         return false;
     }
 
+    m_pictureSizes.numResizes++;
+    m_pictureSizes.resizeCopyBytes += m_nalu.end_offset;
+    m_pictureSizes.picturesSinceResize = 0;
+
     m_bitstreamDataLen = (VkDeviceSize)retSize;
     return true;
 }
@@ -293,11 +560,16 @@ VkDeviceSize VulkanVideoDecoder::swapBitstreamBuffer(VkDeviceSize copyCurrBuffOf
 {
     VkSharedBaseObj<VulkanBitstreamBuffer> currentBitstreamBuffer(m_bitstreamData.GetBitstreamBuffer());
     VkSharedBaseObj<VulkanBitstreamBuffer> newBitstreamBuffer;
-    VkDeviceSize newBufferSize = currentBitstreamBuffer->GetMaxSize();
+    VkDeviceSize newBufferSize = getBitstreamBufferSize(copyCurrBuffSize);
     const uint8_t* pCopyData = nullptr;
+    const uint8_t* pSourceData = nullptr;
     if (copyCurrBuffSize) {
+        // Prefer the input the data came from, so that the client can reference it in place,
+        // unless the current buffer can be continued in place by the next one
+        pSourceData = getBitstreamSource(copyCurrBuffOffset, copyCurrBuffSize);
         VkDeviceSize maxSize = 0;
-        pCopyData = currentBitstreamBuffer->GetReadOnlyDataPtr(copyCurrBuffOffset, maxSize);
+        pCopyData = ((pSourceData != nullptr) && !currentBitstreamBuffer->ContinuesInPlace()) ? pSourceData :
+                        currentBitstreamBuffer->GetReadOnlyDataPtr(copyCurrBuffOffset, maxSize);
     }
     m_pClient->GetBitstreamBuffer(newBufferSize,
                                   m_bufferOffsetAlignment, m_bufferSizeAlignment,
@@ -307,10 +579,226 @@ VkDeviceSize VulkanVideoDecoder::swapBitstreamBuffer(VkDeviceSize copyCurrBuffOf
         assert(!"Cound't GetBitstreamBuffer()!");
         return false;
     }
+    VkDeviceSize maxSize = 0;
+    // A buffer continuing the previous one in place is not referencing the input
+    m_bZeroCopyBitstream = (pCopyData != nullptr) && !newBitstreamBuffer->ContinuesInPlace() &&
+                           (newBitstreamBuffer->GetReadOnlyDataPtr(0, maxSize) == pCopyData);
+    m_pBitstreamSource = pSourceData;
+    m_bitstreamSourceOffset = 0;
     // m_bitstreamDataLen = newBufferSize;
     return m_bitstreamData.SetBitstreamBuffer(newBitstreamBuffer);
 }
 
+void VulkanVideoDecoder::updatePictureSizeHistory(VkDeviceSize pictureSize, bool intraPicture)
+{
+    NvVkPictureSizeHistory& history = m_pictureSizes;
+    const uint32_t type = intraPicture ? 1 : 0;
+
+    history.sizes[type][history.numSizes[type] % NvVkPictureSizeHistory::HISTORY_SIZE] =
+            (uint32_t)std::min<VkDeviceSize>(pictureSize, std::numeric_limits<uint32_t>::max());
+    history.numSizes[type]++;
+    const uint32_t numSizes = std::min<uint32_t>(history.numSizes[type], NvVkPictureSizeHistory::HISTORY_SIZE);
+    history.maxSize[type] = *std::max_element(history.sizes[type], history.sizes[type] + numSizes);
+
+    if (intraPicture) {
+        if (history.numSizes[1] > 1) {
+            history.intraPeriod = history.picturesSinceIntra + 1;
+        }
+        history.picturesSinceIntra = 0;
+    } else {
+        history.picturesSinceIntra++;
+    }
+    history.picturesSinceResize++;
+}
+
+// Size of the bitstream buffer for the next picture, holding at least minSize bytes
+VkDeviceSize VulkanVideoDecoder::getBitstreamBufferSize(VkDeviceSize minSize) const
+{
+    const NvVkPictureSizeHistory& history = m_pictureSizes;
+
+    VkDeviceSize size = history.maxSize[0];
+    if (history.intraPeriod > 0) {
+        // Expect an intra picture at the intra period
+        if ((history.picturesSinceIntra + 1) >= history.intraPeriod) {
+            size = history.maxSize[1];
+        }
+    } else if (history.picturesSinceIntra < NvVkPictureSizeHistory::HISTORY_SIZE) {
+        // Soon after an intra picture without a known period, be ready for another one
+        size = std::max(history.maxSize[0], history.maxSize[1]);
+    }
+    size += size / 8; // headroom for the picture sizes to vary
+
+    size = std::max<VkDeviceSize>(std::max<VkDeviceSize>(size, minSize), m_defaultMinBufferSize);
+
+    // Round up to a power of two, keeping the number of distinct buffer sizes small
+    VkDeviceSize bufferSize = 1;
+    while (bufferSize < size) {
+        bufferSize <<= 1;
+    }
+    return bufferSize;
+}
+
+// Moves the data of a buffer referencing the input in place to a regular buffer
+bool VulkanVideoDecoder::detachBitstreamBuffer()
+{
+    VkSharedBaseObj<VulkanBitstreamBuffer> currentBitstreamBuffer(m_bitstreamData.GetBitstreamBuffer());
+    VkSharedBaseObj<VulkanBitstreamBuffer> newBitstreamBuffer;
+    const VkDeviceSize newBufferSize = std::max<VkDeviceSize>(m_defaultMinBufferSize, m_nalu.end_offset + 3);
+    VkDeviceSize retSize = currentBitstreamBuffer->Clone(newBufferSize, m_nalu.end_offset, 0, newBitstreamBuffer);
+    if (retSize < newBufferSize)
+    {
+        assert(!"bitstream buffer detach failed");
+        nvParserLog("ERROR: bitstream buffer detach failed\n");
+        return false;
+    }
+
+    const uint32_t numStreamMarkers = currentBitstreamBuffer->GetStreamMarkersCount();
+    newBitstreamBuffer->ResetStreamMarkers();
+    for (uint32_t i = 0; i < numStreamMarkers; i++) {
+        newBitstreamBuffer->AddStreamMarker(currentBitstreamBuffer->GetStreamMarker(i));
+    }
+
+    m_bZeroCopyBitstream = false;
+    m_bitstreamDataLen = m_bitstreamData.SetBitstreamBuffer(newBitstreamBuffer, false);
+    return true;
+}
+
+// Returns the input location of the bitstream data at offset, if it's still the same and available
+const uint8_t* VulkanVideoDecoder::getBitstreamSource(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if ((m_pBitstreamSource == nullptr) || (offset < m_bitstreamSourceOffset)) {
+        return nullptr;
+    }
+    const uintptr_t source = reinterpret_cast<uintptr_t>(m_pBitstreamSource) + (uintptr_t)(offset - m_bitstreamSourceOffset);
+    if (!m_bZeroCopyBitstream) {
+        // The input of previous packets may be gone
+        const uintptr_t packetData = reinterpret_cast<uintptr_t>(m_pPacketData);
+        if ((source < packetData) || ((source + size) > (packetData + m_packetDataSize))) {
+            return nullptr;
+        }
+    }
+    return reinterpret_cast<const uint8_t*>(source);
+}
+
+// Called before appending the input at pdatain to the bitstream data at dstOffset
+void VulkanVideoDecoder::setBitstreamSource(const uint8_t* pdatain, VkDeviceSize dstOffset)
+{
+    if ((m_pBitstreamSource != nullptr) && (dstOffset >= m_bitstreamSourceOffset) &&
+        (reinterpret_cast<uintptr_t>(pdatain) ==
+            (reinterpret_cast<uintptr_t>(m_pBitstreamSource) + (uintptr_t)(dstOffset - m_bitstreamSourceOffset)))) {
+        return; // contiguous
+    }
+
+    if (m_bZeroCopyBitstream) {
+        // The bytes of discarded NAL units can't be dropped from a buffer referencing the input, move an empty
+        // NAL unit to its start code in the input instead. The bytes skipped are not referenced by any slice.
+        const uintptr_t bufferData = reinterpret_cast<uintptr_t>(m_bitstreamData.GetBitstreamPtr());
+        const uintptr_t inputData = reinterpret_cast<uintptr_t>(pdatain);
+        if ((m_nalu.end_offset == (m_nalu.start_offset + 3)) && (dstOffset == (VkDeviceSize)m_nalu.end_offset) &&
+            (inputData > (bufferData + dstOffset)) && (inputData < (bufferData + m_bitstreamDataLen)) &&
+            m_bitstreamData.HasSliceStartCodeAtOffset(inputData - bufferData - 3)) {
+            if (m_nalu.start_offset == 0) {
+                m_llNaluStartLocation = m_llParsedBytes - 3;
+            }
+            m_nalu.end_offset = (int64_t)(inputData - bufferData);
+            m_nalu.start_offset = m_nalu.end_offset - 3;
+            return;
+        }
+        detachBitstreamBuffer();
+    }
+
+    m_pBitstreamSource = pdatain;
+    m_bitstreamSourceOffset = dstOffset;
+}
+
+// Writes a start code prefix at offset, unless the data already has one there
+void VulkanVideoDecoder::setSliceStartCode(VkDeviceSize offset)
+{
+    if (!m_bitstreamData.HasSliceStartCodeAtOffset(offset)) {
+        if (m_bZeroCopyBitstream) {
+            detachBitstreamBuffer();
+        }
+        if ((m_pBitstreamSource != nullptr) && ((offset + 3) > m_bitstreamSourceOffset)) {
+            // No longer a copy of the input
+            m_pBitstreamSource = nullptr;
+        }
+    }
+    m_bitstreamData.SetSliceStartCodeAtOffset(offset);
+}
+
+// The slice header bytes left are copied, so that the check does not depend on the bitstream buffer or the parser state
+void VulkanVideoDecoder::defer_slice_header_check(std::function<bool(NvVkRbspReader&)>&& check)
+{
+    fill_rbsp(MAX_DEFERRED_SLICE_HEADER_BYTES);
+    const size_t byteOffset = (size_t)(m_nalu.rbsp_bitpos >> 3);
+    const size_t rbspSize = std::min<size_t>((size_t)m_nalu.rbsp_size, MAX_DEFERRED_SLICE_HEADER_BYTES);
+    if (byteOffset >= rbspSize) {
+        return;
+    }
+    std::vector<uint8_t> rbsp(m_rbspData.begin() + byteOffset, m_rbspData.begin() + rbspSize);
+    const size_t bitpos = (size_t)(m_nalu.rbsp_bitpos & 7);
+
+    std::lock_guard<std::mutex> lock(m_sliceHeaderMutex);
+    m_sliceHeaderChecks.emplace_back([this, rbsp = std::move(rbsp), bitpos, check = std::move(check)]() mutable {
+        NvVkRbspReader reader(std::move(rbsp), bitpos);
+        // A header longer than the bytes copied is not checked
+        if (!check(reader) && !reader.overrun()) {
+            m_sliceHeaderMismatches++;
+        }
+    });
+    if (!m_sliceHeaderThread.joinable()) {
+        m_sliceHeaderThreadExit = false;
+        m_sliceHeaderThread = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(m_sliceHeaderMutex);
+            for (;;) {
+                m_sliceHeaderCond.wait(lock, [this]() { return m_sliceHeaderThreadExit || !m_sliceHeaderChecks.empty(); });
+                if (m_sliceHeaderChecks.empty()) {
+                    break; // exit requested, with all the checks done
+                }
+                std::function<void()> sliceHeaderCheck = std::move(m_sliceHeaderChecks.front());
+                m_sliceHeaderChecks.pop_front();
+                lock.unlock();
+                sliceHeaderCheck();
+                lock.lock();
+            }
+        });
+    }
+    m_sliceHeaderCond.notify_one();
+}
+
+void VulkanVideoDecoder::stop_slice_header_checks()
+{
+    if (!m_sliceHeaderThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sliceHeaderMutex);
+        m_sliceHeaderThreadExit = true;
+    }
+    m_sliceHeaderCond.notify_one();
+    m_sliceHeaderThread.join();
+    if (m_sliceHeaderMismatches > 0) {
+        nvParserErrorLog("%u slice headers are inconsistent with the first slice of their picture\n",
+                         m_sliceHeaderMismatches.exchange(0));
+    }
+}
+
+// Remember the packet PTS and its location in the byte stream
+void VulkanVideoDecoder::queue_packet_pts(const VkParserBitstreamPacket* pck)
+{
+    if (pck->bPTSValid)
+    {
+        m_PTSQueue[m_lPTSPos].bPTSValid = true;
+        m_PTSQueue[m_lPTSPos].llPTS = pck->llPTS;
+        m_PTSQueue[m_lPTSPos].llPTSPos = m_llParsedBytes;
+        m_PTSQueue[m_lPTSPos].bDTSValid = pck->bDTSValid;
+        m_PTSQueue[m_lPTSPos].llDTS = pck->llDTS;
+        m_PTSQueue[m_lPTSPos].bDiscontinuity = m_bDiscontinuityReported;
+        m_bDiscontinuityReported = false;
+        m_lPTSPos = (m_lPTSPos + 1) % MAX_QUEUED_PTS;
+    }
+}
+
 bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, size_t *pParsedBytes)
 {
     VkDeviceSize curr_data_size = pck->nDataLength;
@@ -321,6 +809,12 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
         return false;
     }
 
+    m_pPacketData = pck->pByteStream;
+    m_packetDataSize = pck->nDataLength;
+    if (!m_bZeroCopyBitstream) {
+        m_pBitstreamSource = nullptr;
+    }
+
     m_eError = NV_NO_ERROR; // Reset the flag to catch errors if any in current frame
 
     m_nCallbackEventCount = 0;
@@ -338,7 +832,7 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
                     !resizeBitstreamBuffer(m_nalu.end_offset + 3 - m_bitstreamDataLen)) {
                 return false;
             }
-            m_bitstreamData.SetSliceStartCodeAtOffset(m_nalu.end_offset);
+            setSliceStartCode(m_nalu.end_offset);
 
             // Complete the current NAL unit (if not empty)
             nal_unit();
@@ -353,19 +847,14 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
         memset(&m_PTSQueue, 0, sizeof(m_PTSQueue));
         m_bDiscontinuityReported = true;
     }
-    // Remember the packet PTS and its location in the byte stream
-    if (pck->bPTSValid)
-    {
-        m_PTSQueue[m_lPTSPos].bPTSValid = true;
-        m_PTSQueue[m_lPTSPos].llPTS = pck->llPTS;
-        m_PTSQueue[m_lPTSPos].llPTSPos = m_llParsedBytes;
-        m_PTSQueue[m_lPTSPos].bDiscontinuity = m_bDiscontinuityReported;
-        m_bDiscontinuityReported = false;
-        m_lPTSPos = (m_lPTSPos + 1) % MAX_QUEUED_PTS;
-    }
+    queue_packet_pts(pck);
     // In case the bitstream is not startcode-based, the input always only contains a single frame
     if (m_bNoStartCodes)
     {
+        if (curr_data_size > 0)
+        {
+            setBitstreamSource(pdatain, 0);
+        }
         if (curr_data_size > m_bitstreamDataLen - 4)
         {
             if (!resizeBitstreamBuffer(curr_data_size - (m_bitstreamDataLen - 4)))
@@ -409,8 +898,68 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
 
         return (m_eError == NV_NO_ERROR ? true : false);
     }
+    if (pck->nNalLengthSize > 0) {
+        // Length-prefixed NAL units (ISO/IEC 14496-15): no start code to look for, one is written in the bitstream
+        // buffer in front of each NAL unit instead of its length. The packets only contain complete NAL units.
+        if (m_bZeroCopyBitstream) {
+            detachBitstreamBuffer();
+        }
+        m_pBitstreamSource = nullptr;
+        const uint32_t nalLengthSize = pck->nNalLengthSize;
+        while (curr_data_size > 0) {
+
+            // If bPartialParsing is set, we return immediately once we decoded or displayed a frame
+            if ((pck->bPartialParsing) && (m_nCallbackEventCount != 0))
+            {
+                break;
+            }
+            if (curr_data_size < nalLengthSize)
+            {
+                nvParserLog("Discarding truncated NAL unit length\n");
+                pdatain += curr_data_size;
+                curr_data_size = 0;
+                break;
+            }
+            VkDeviceSize nalSize = 0;
+            for (uint32_t i = 0; i < nalLengthSize; i++) {
+                nalSize = (nalSize << 8) | pdatain[i];
+            }
+            pdatain += nalLengthSize;
+            curr_data_size -= nalLengthSize;
+            if (nalSize > curr_data_size)
+            {
+                nvParserLog("Truncated NAL unit (%d/%d bytes)\n", (int32_t)curr_data_size, (int32_t)nalSize);
+                nalSize = curr_data_size;
+            }
+
+            const VkDeviceSize requiredDataLen = m_nalu.end_offset + 3 + nalSize;
+            if ((requiredDataLen > m_bitstreamDataLen) && !resizeBitstreamBuffer(requiredDataLen - m_bitstreamDataLen)) {
+                return false;
+            }
+            if (m_nalu.start_offset == 0) {
+                m_llNaluStartLocation = m_llParsedBytes - m_nalu.end_offset;
+            }
+            setSliceStartCode(m_nalu.end_offset);
+            m_nalu.end_offset += 3;
+            if (nalSize > 0) {
+                VkSharedBaseObj<VulkanBitstreamBuffer> bitstreamBuffer(m_bitstreamData.GetBitstreamBuffer());
+                bitstreamBuffer->CopyDataFromBuffer(pdatain, 0, m_nalu.end_offset, nalSize);
+            }
+            m_nalu.end_offset += nalSize;
+            // Counted as the Annex-B stream, for the picture locations to match the ones of the timestamps
+            m_llParsedBytes += 3 + nalSize;
+            pdatain += nalSize;
+            curr_data_size -= nalSize;
+            nal_unit();
+            if (m_bDecoderInitFailed)
+            {
+                return false;
+            }
+        }
+    }
     // Parse start codes
-    while (curr_data_size > 0) {
+    uint32_t startCodeIndex = 0; // next entry of the packet start code table, if any
+    while ((pck->nNalLengthSize == 0) && (curr_data_size > 0)) {
 
         VkDeviceSize buflen = curr_data_size;
 
@@ -424,10 +973,19 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
             buflen = std::min<VkDeviceSize>(buflen, (m_lMinBytesForBoundaryDetection - (m_nalu.end_offset - m_nalu.start_offset)));
         }
         bool found_start_code = false;
-        VkDeviceSize start_offset = next_start_code(pdatain, (size_t)buflen, found_start_code);
+        VkDeviceSize start_offset = 0;
+        const size_t packetOffset = (size_t)(pdatain - pck->pByteStream);
+        if (packetOffset < pck->nStartCodeScanLength) {
+            const size_t scanLength = std::min<size_t>((size_t)buflen, pck->nStartCodeScanLength - packetOffset);
+            start_offset = lookup_start_code(pck, packetOffset, scanLength, startCodeIndex, found_start_code);
+            buflen = scanLength;
+        } else {
+            start_offset = next_start_code(pdatain, (size_t)buflen, found_start_code);
+        }
         VkDeviceSize data_used = found_start_code ? start_offset : buflen;
         if (data_used > 0)
         {
+            setBitstreamSource(pdatain, m_nalu.end_offset);
             if (data_used > (m_bitstreamDataLen - m_nalu.end_offset))
             {
                 resizeBitstreamBuffer(data_used - (m_bitstreamDataLen - m_nalu.end_offset));
@@ -475,7 +1033,7 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
                 return false;
             }
             // Add back the start code prefix for the next NAL unit
-            m_bitstreamData.SetSliceStartCodeAtOffset(m_nalu.end_offset);
+            setSliceStartCode(m_nalu.end_offset);
             m_nalu.end_offset += 3;
         }
     }
@@ -502,7 +1060,7 @@ bool VulkanVideoDecoder::ParseByteStream(const VkParserBitstreamPacket* pck, siz
                 !resizeBitstreamBuffer(m_nalu.end_offset + 3 - m_bitstreamDataLen)) {
             return false;
         }
-        m_bitstreamData.SetSliceStartCodeAtOffset(m_nalu.end_offset);
+        setSliceStartCode(m_nalu.end_offset);
         m_nalu.end_offset += 3;
 
         // Decode the current picture
@@ -549,7 +1107,13 @@ void VulkanVideoDecoder::nal_unit()
             }
         }
         init_dbits();
-        nal_type = ParseNalUnit();
+        if (DropNalUnit()) {
+            // The pictures dropped are not referred to by the ones decoded, the DPB is left as it is
+            nal_type = NALU_DISCARD;
+        } else {
+            init_dbits();
+            nal_type = ParseNalUnit();
+        }
         switch(nal_type)
         {
         case NALU_SLICE:
@@ -641,7 +1205,9 @@ void VulkanVideoDecoder::end_of_picture()
         assert((uint64_t)m_nalu.start_offset < (uint64_t)std::numeric_limits<size_t>::max());
         m_pVkPictureData->bitstreamDataLen = (size_t)m_nalu.start_offset;
         m_pVkPictureData->numSlices = m_bitstreamData.GetStreamMarkersCount();
-        if(BeginPicture(m_pVkPictureData))
+        const bool beginPicture = BeginPicture(m_pVkPictureData);
+        updatePictureSizeHistory(m_pVkPictureData->bitstreamDataLen, beginPicture && m_pVkPictureData->intra_pic_flag);
+        if (beginPicture)
         {
             if ((m_pVkPictureData + m_iTargetLayer)->pCurrPic)
             {
@@ -681,6 +1247,8 @@ void VulkanVideoDecoder::end_of_picture()
                             m_DispInfo[lDisp].bPTSValid = true;
                             m_DispInfo[lDisp].llPTS = m_PTSQueue[ndx].llPTS;
                             m_DispInfo[lDisp].bDiscontinuity = m_PTSQueue[ndx].bDiscontinuity;
+                            (m_pVkPictureData + m_iTargetLayer)->bDTSValid = m_PTSQueue[ndx].bDTSValid;
+                            (m_pVkPictureData + m_iTargetLayer)->llDTS = m_PTSQueue[ndx].llDTS;
                             m_PTSQueue[ndx].bPTSValid = false;
                         }
                         ndx = (ndx+1) % MAX_QUEUED_PTS;
@@ -801,6 +1369,10 @@ void VulkanVideoDecoder::display_picture(VkPicIf *pPicBuf, bool bEvict)
 void VulkanVideoDecoder::end_of_stream()
 {
     EndOfStream();
+    stop_slice_header_checks();
+    nvParserLog("Bitstream buffer resizes: %u (%llu bytes copied), none in the last %u pictures\n",
+                m_pictureSizes.numResizes, (unsigned long long)m_pictureSizes.resizeCopyBytes,
+                m_pictureSizes.picturesSinceResize);
     // Reset common parser state
     memset(&m_nalu, 0, sizeof(m_nalu));
     memset(&m_PrevSeqInfo, 0, sizeof(m_PrevSeqInfo));
@@ -824,6 +1396,7 @@ void VulkanVideoDecoder::end_of_stream()
 #include "nvVulkanh265ScalingList.h"
 #include "VulkanH264Decoder.h"
 #include "VulkanH265Decoder.h"
+#include "VulkanAV1Decoder.h"
 
 static nvParserLogFuncType gParserLogFunc = nullptr;
 static int gLogLevel = 1;
@@ -906,6 +1479,25 @@ VkResult CreateVulkanVideoDecodeParser(VkVideoCodecOperationFlagBitsKHR videoCod
         nvVideoDecodeParser = nvVideoH265DecodeParser;
     }
         break;
+#ifdef VK_EXT_video_decode_av1
+    case VK_VIDEO_CODEC_OPERATION_DECODE_AV1_BIT_KHR:
+    {
+        if ((pStdExtensionVersion == nullptr) ||
+                (0 != strcmp(pStdExtensionVersion->extensionName, VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_EXTENSION_NAME)) ||
+                (pStdExtensionVersion->specVersion != VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_SPEC_VERSION)) {
+            nvParserErrorLog("The requested decoder AV1 Codec STD version is NOT supported\n");
+            nvParserErrorLog("The supported decoder AV1 Codec STD version is version %d of %s\n",
+                    VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_SPEC_VERSION, VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_EXTENSION_NAME);
+            return VK_ERROR_INCOMPATIBLE_DRIVER;
+        }
+        VkSharedBaseObj<VulkanAV1Decoder> nvVideoAV1DecodeParser(new VulkanAV1Decoder(videoCodecOperation));
+        if (!nvVideoAV1DecodeParser) {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        nvVideoDecodeParser = nvVideoAV1DecodeParser;
+    }
+        break;
+#endif // VK_EXT_video_decode_av1
     default:
         nvParserErrorLog("Unsupported codec type!!!\n");
     }
@@ -15,7 +15,12 @@
  */
 
 #include <string.h>
+#include <algorithm>
 #include <fstream>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "mio/mio.hpp"
 #include "VkDecoderUtils/VideoStreamDemuxer.h"
 
@@ -35,7 +40,8 @@ public:
         , m_inputVideoStreamMmap()
         , m_pBitstreamData(nullptr)
         , m_bitstreamDataSize(0)
-        , m_bytesRead(0) {
+        , m_bytesRead(0)
+        , m_discardedSize(0) {
 
         std::error_code error;
         m_inputVideoStreamMmap.map(pFilePath, 0, mio::map_entire_file, error);
@@ -46,6 +52,13 @@ public:
         m_bitstreamDataSize = m_inputVideoStreamMmap.mapped_length();
 
         m_pBitstreamData = m_inputVideoStreamMmap.data();
+
+#ifndef _WIN32
+        if (m_inputVideoStreamMmap.is_mapped()) {
+            // Parsed from start to end: for the kernel to read ahead further, and to reclaim the pages behind
+            madvise((void*)m_pBitstreamData, (size_t)m_bitstreamDataSize, MADV_SEQUENTIAL);
+        }
+#endif
     }
 
     ElementaryStream(const uint8_t *pInput, const size_t len,
@@ -57,7 +70,8 @@ public:
         , m_inputVideoStreamMmap()
         , m_pBitstreamData(pInput)
         , m_bitstreamDataSize(0)
-        , m_bytesRead(0) {
+        , m_bytesRead(0)
+        , m_discardedSize(0) {
 
     }
 
@@ -88,6 +102,10 @@ public:
 
     virtual bool IsStreamDemuxerEnabled() const { return false; }
     virtual bool HasFramePreparser() const { return false; }
+    virtual uint32_t GetNalLengthSize() const { return 0; }
+    virtual int64_t GetParameterSets(const uint8_t **ppData) const { return 0; }
+    // The whole stream is memory mapped, the decoder references it in place
+    virtual void SetPacketAllocator(VideoStreamPacketAllocator* pPacketAllocator) { }
     virtual void Rewind() { m_bytesRead = 0; }
     virtual VkVideoCodecOperationFlagBitsKHR GetVideoCodec() const { return m_videoCodecType; }
 
@@ -144,6 +162,9 @@ public:
     virtual int64_t DemuxFrame(const uint8_t **ppVideo) {
         return -1;
     }
+    virtual bool GetFrameTimestamps(int64_t* pPresentationTimestamp, int64_t* pDecodeTimestamp) const {
+        return false;
+    }
     virtual int64_t ReadBitstreamData(const uint8_t **ppVideo, int64_t offset)
     {
         assert(m_bitstreamDataSize != 0);
@@ -154,6 +175,24 @@ public:
         return m_bitstreamDataSize - offset;
     }
 
+    virtual void DiscardBitstreamData(int64_t offset)
+    {
+#ifndef _WIN32
+        if (!m_inputVideoStreamMmap.is_mapped()) {
+            return;
+        }
+        // The pages of the mapping are dropped, they are read from the file again if they are accessed
+        const VkDeviceSize pageSize = (VkDeviceSize)sysconf(_SC_PAGESIZE);
+        const VkDeviceSize discardSize = (std::min<VkDeviceSize>((VkDeviceSize)std::max<int64_t>(offset, 0),
+                                                                 m_bitstreamDataSize) / pageSize) * pageSize;
+        if (discardSize > m_discardedSize) {
+            madvise((void*)(m_pBitstreamData + m_discardedSize), (size_t)(discardSize - m_discardedSize), MADV_DONTNEED);
+        }
+        // After a rewind or a seek, the pages are discarded again from the new offset on
+        m_discardedSize = discardSize;
+#endif
+    }
+
     virtual void DumpStreamParameters() const {
     }
 
@@ -164,6 +203,7 @@ private:
     const uint8_t* m_pBitstreamData;
     VkDeviceSize   m_bitstreamDataSize;
     VkDeviceSize   m_bytesRead;
+    VkDeviceSize   m_discardedSize; // of the mapping, from its start
 };
 
 VkResult ElementaryStreamCreate(const char *pFilePath,
@@ -15,6 +15,11 @@
 */
 
 #include <iostream>
+#include <limits>
+#include <vector>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "VkDecoderUtils/VideoStreamDemuxer.h"
 
 extern "C" {
@@ -36,6 +41,34 @@ inline bool check(int e, int iLine, const char *szFile) {
 
 #define ck(call) check(call, __LINE__, __FILE__)
 
+static AVPacket* AllocPacket()
+{
+#if (LIBAVCODEC_VERSION_MAJOR < 58)
+    AVPacket* pPacket = (AVPacket *)av_malloc(sizeof(AVPacket));
+    av_init_packet(pPacket);
+#else
+    AVPacket* pPacket = av_packet_alloc();
+#endif // (LIBAVCODEC_VERSION_MAJOR < 58)
+    pPacket->data = NULL;
+    pPacket->size = 0;
+    return pPacket;
+}
+
+static void FreePacket(AVPacket*& pPacket)
+{
+    if (pPacket) {
+#if (LIBAVCODEC_VERSION_MAJOR < 58)
+        if (pPacket->data) {
+            av_packet_unref(pPacket);
+        }
+        av_free(pPacket);
+#else // (LIBAVCODEC_VERSION_MAJOR < 58)
+        av_packet_free(&pPacket);
+#endif // (LIBAVCODEC_VERSION_MAJOR < 58)
+        pPacket = nullptr;
+    }
+}
+
 class FFmpegDemuxer : public VideoStreamDemuxer {
 
 public:
@@ -114,24 +147,26 @@ private:
         colorSpace = fmtc->streams[videoStream]->codecpar->color_space;
         chromaLocation = fmtc->streams[videoStream]->codecpar->chroma_location;
 
-#if (LIBAVCODEC_VERSION_MAJOR < 58)
-        pPkt = (AVPacket *)av_malloc(sizeof(AVPacket));
-        av_init_packet(pPkt);
-#else
-        pPkt = av_packet_alloc();
-#endif // (LIBAVCODEC_VERSION_MAJOR < 58)
-        pPkt->data = NULL;
-        pPkt->size = 0;
-#if (LIBAVCODEC_VERSION_MAJOR < 58)
-        pktFiltered = (AVPacket *)av_malloc(sizeof(AVPacket));
-        av_init_packet(pktFiltered);
-#else
-        pktFiltered = av_packet_alloc();
-#endif
-        pktFiltered->data = NULL;
-        pktFiltered->size = 0;
+        pPkt = AllocPacket();
+        for (uint32_t i = 0; i < READ_AHEAD_PACKETS; i++) {
+            readAheadPackets[i] = AllocPacket();
+            readAheadResults[i] = 0;
+            readAheadTimestamps[i][0] = AV_NOPTS_VALUE;
+            readAheadTimestamps[i][1] = AV_NOPTS_VALUE;
+        }
+
+        // The length-prefixed NAL units of the containers are parsed as they are, with the parameter sets of
+        // their configuration record, instead of being rewritten with start codes by the bitstream filter.
+        const AVCodecParameters* codecpar = fmtc->streams[videoStream]->codecpar;
+        if (isStreamDemuxer && (codecpar->extradata != NULL)) {
+            if (videoCodec == AV_CODEC_ID_H264) {
+                ParseAvcDecoderConfigurationRecord(codecpar->extradata, codecpar->extradata_size);
+            } else if (videoCodec == AV_CODEC_ID_HEVC) {
+                ParseHevcDecoderConfigurationRecord(codecpar->extradata, codecpar->extradata_size);
+            }
+        }
 
-        if (isStreamDemuxer) {
+        if (isStreamDemuxer && (nalLengthSize == 0)) {
             const AVBitStreamFilter *bsf = NULL;
 
             if (videoCodec == AV_CODEC_ID_H264) {
@@ -207,8 +242,23 @@ private:
           fmtc()
         , avioc()
         , pPkt()
-        , pktFiltered()
         , bsfc()
+        , nalLengthSize()
+        , parameterSets()
+        , readAheadThread()
+        , readAheadMutex()
+        , readAheadSpaceCondition()
+        , readAheadPacketCondition()
+        , readAheadPackets()
+        , readAheadResults()
+        , readAheadPacketMemory()
+        , readAheadData()
+        , readAheadSizes()
+        , packetAllocator()
+        , readAheadReadIndex()
+        , readAheadWriteIndex()
+        , readAheadPacketInUse()
+        , stopReadAhead()
         , videoStream()
         , isStreamDemuxer()
         , videoCodec()
@@ -232,28 +282,11 @@ private:
 
     virtual ~FFmpegDemuxer() {
 
-        if (pPkt) {
-#if (LIBAVCODEC_VERSION_MAJOR < 58)
-            if (pPkt->data) {
-                av_packet_unref(pPkt);
-            }
-            av_free(pPkt);
-#else // (LIBAVCODEC_VERSION_MAJOR < 58)
-            av_packet_free(&pPkt);
-#endif // (LIBAVCODEC_VERSION_MAJOR < 58)
-            pPkt = nullptr;
-        }
+        StopReadAhead();
 
-        if (pktFiltered) {
-#if (LIBAVCODEC_VERSION_MAJOR < 58)
-            if (pktFiltered->data) {
-                av_packet_unref(pktFiltered);
-            }
-            av_free(pktFiltered);
-#else // (LIBAVCODEC_VERSION_MAJOR < 58)
-            av_packet_free(&pktFiltered);
-#endif // (LIBAVCODEC_VERSION_MAJOR < 58)
-            pktFiltered = nullptr;
+        FreePacket(pPkt);
+        for (uint32_t i = 0; i < READ_AHEAD_PACKETS; i++) {
+            FreePacket(readAheadPackets[i]);
         }
 
         if (fmtc) {
@@ -308,6 +341,9 @@ public:
     #ifdef VK_EXT_video_decode_vp9
         case AV_CODEC_ID_VP9        : return VK_VIDEO_CODEC_OPERATION_DECODE_VP9_BIT_KHR;
     #endif // VK_EXT_video_decode_vp9
+    #ifdef VK_EXT_video_decode_av1
+        case AV_CODEC_ID_AV1        : return VK_VIDEO_CODEC_OPERATION_DECODE_AV1_BIT_KHR;
+    #endif // VK_EXT_video_decode_av1
         case AV_CODEC_ID_MJPEG      : assert(false); return VkVideoCodecOperationFlagBitsKHR(0);
         default                     : assert(false); return VkVideoCodecOperationFlagBitsKHR(0);
         }
@@ -432,50 +468,85 @@ public:
 
     virtual bool IsStreamDemuxerEnabled() const { return isStreamDemuxer; }
     virtual bool HasFramePreparser() const { return true; }
+    virtual uint32_t GetNalLengthSize() const { return nalLengthSize; }
+
+    virtual int64_t GetParameterSets(const uint8_t **ppData) const {
+        *ppData = parameterSets.data();
+        return (int64_t)parameterSets.size();
+    }
+
+    virtual void SetPacketAllocator(VideoStreamPacketAllocator* pPacketAllocator) {
+        // The packets read ahead with the previous allocator are dropped
+        StopReadAhead();
+        packetAllocator = pPacketAllocator;
+    }
 
+    // The packets are read and filtered ahead on a thread of their own, the data returned is valid until the next call
     virtual int64_t DemuxFrame(const uint8_t **ppVideo) {
 
         if (!fmtc) {
             return -1;
         }
 
-        if (pPkt->data) {
-            av_packet_unref(pPkt);
+        if (!readAheadThread.joinable()) {
+            stopReadAhead = false;
+            readAheadThread = std::thread(&FFmpegDemuxer::ReadAheadThread, this);
         }
 
-        int e = 0;
-        while ((e = av_read_frame(fmtc, pPkt)) >= 0 && pPkt->stream_index != videoStream) {
-            av_packet_unref(pPkt);
+        std::unique_lock<std::mutex> lock(readAheadMutex);
+        if (readAheadPacketInUse) {
+            // The packet returned by the previous call goes back to the read-ahead thread
+            av_packet_unref(readAheadPackets[readAheadReadIndex % READ_AHEAD_PACKETS]);
+            readAheadPacketMemory[readAheadReadIndex % READ_AHEAD_PACKETS] = nullptr;
+            readAheadReadIndex++;
+            readAheadPacketInUse = false;
+            readAheadSpaceCondition.notify_one();
         }
-        if (e < 0) {
-            return e;
+
+        readAheadPacketCondition.wait(lock, [this]() { return (readAheadWriteIndex != readAheadReadIndex); });
+
+        const uint32_t packetIndex = readAheadReadIndex % READ_AHEAD_PACKETS;
+        if (readAheadResults[packetIndex] < 0) {
+            // The end of the stream, or an error, is returned until the stream is rewound
+            return readAheadResults[packetIndex];
         }
 
-        if (isStreamDemuxer) {
-            if (pktFiltered->data) {
-                av_packet_unref(pktFiltered);
-            }
-            ck(av_bsf_send_packet(bsfc, pPkt));
-            ck(av_bsf_receive_packet(bsfc, pktFiltered));
-            *ppVideo = pktFiltered->data;
-            return pktFiltered->size;
-        } else {
-            *ppVideo = pPkt->data;
-            return pPkt->size;
+        readAheadPacketInUse = true;
+        *ppVideo = readAheadData[packetIndex];
+        return readAheadSizes[packetIndex];
+    }
+
+    virtual bool GetFrameTimestamps(int64_t* pPresentationTimestamp, int64_t* pDecodeTimestamp) const {
+
+        if (!readAheadPacketInUse) {
+            return false;
         }
+
+        const uint32_t packetIndex = readAheadReadIndex % READ_AHEAD_PACKETS;
+        *pPresentationTimestamp = readAheadTimestamps[packetIndex][0];
+        *pDecodeTimestamp = readAheadTimestamps[packetIndex][1];
+        return (*pPresentationTimestamp != AV_NOPTS_VALUE);
     }
 
     virtual int64_t ReadBitstreamData(const uint8_t **ppVideo, int64_t offset) {
         return -1;
     }
 
+    virtual void DiscardBitstreamData(int64_t offset) { }
+
     static int ReadPacket(void *opaque, uint8_t *pBuf, int nBuf) {
         return ((DataProvider *)opaque)->GetData(pBuf, nBuf);
     }
 
     virtual void Rewind()
     {
+        StopReadAhead();
         av_seek_frame(fmtc, videoStream, 0, isStreamDemuxer ? AVSEEK_FLAG_ANY : AVSEEK_FLAG_BYTE);
+#if (LIBAVCODEC_VERSION_MAJOR >= 58)
+        if (bsfc) {
+            av_bsf_flush(bsfc);
+        }
+#endif // (LIBAVCODEC_VERSION_MAJOR >= 58)
     }
 
     virtual void DumpStreamParameters() const {
@@ -583,10 +654,257 @@ public:
     }
 
 private:
+    void AppendParameterSet(const uint8_t* pNalUnit, uint32_t size) {
+        const uint8_t length[4] = { (uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size };
+        parameterSets.insert(parameterSets.end(), length, length + sizeof(length));
+        parameterSets.insert(parameterSets.end(), pNalUnit, pNalUnit + size);
+    }
+
+    // Appends numNalUnits parameter sets with a 2 bytes length each, returns the offset after them or -1
+    int AppendParameterSets(const uint8_t* pData, int size, int offset, uint32_t numNalUnits) {
+        for (uint32_t i = 0; i < numNalUnits; i++) {
+            if ((offset + 2) > size) {
+                return -1;
+            }
+            const uint32_t nalUnitSize = (pData[offset] << 8) | pData[offset + 1];
+            offset += 2;
+            if ((offset + (int)nalUnitSize) > size) {
+                return -1;
+            }
+            AppendParameterSet(&pData[offset], nalUnitSize);
+            offset += nalUnitSize;
+        }
+        return offset;
+    }
+
+    // AVCDecoderConfigurationRecord of ISO/IEC 14496-15 5.3.3.1, the extradata of avcC
+    void ParseAvcDecoderConfigurationRecord(const uint8_t* pData, int size) {
+        if ((size < 7) || (pData[0] != 1)) {
+            return; // Annex-B extradata
+        }
+        const uint32_t numSps = pData[5] & 0x1f;
+        int offset = AppendParameterSets(pData, size, 6, numSps);
+        if ((offset >= 0) && (offset < size)) {
+            const uint32_t numPps = pData[offset];
+            offset = AppendParameterSets(pData, size, offset + 1, numPps);
+        }
+        if (offset < 0) {
+            std::cerr << "Invalid avcC configuration record, using the h264_mp4toannexb filter" << std::endl;
+            parameterSets.clear();
+            return;
+        }
+        nalLengthSize = (pData[4] & 3) + 1; // lengthSizeMinusOne
+    }
+
+    // HEVCDecoderConfigurationRecord of ISO/IEC 14496-15 8.3.3.1, the extradata of hvcC
+    void ParseHevcDecoderConfigurationRecord(const uint8_t* pData, int size) {
+        if ((size < 23) || (pData[0] != 1)) {
+            return; // Annex-B extradata
+        }
+        const uint32_t numOfArrays = pData[22];
+        int offset = 23;
+        for (uint32_t i = 0; (i < numOfArrays) && (offset >= 0); i++) {
+            if ((offset + 3) > size) {
+                offset = -1;
+                break;
+            }
+            const uint32_t numNalus = (pData[offset + 1] << 8) | pData[offset + 2]; // after the NAL_unit_type
+            offset = AppendParameterSets(pData, size, offset + 3, numNalus);
+        }
+        if (offset < 0) {
+            std::cerr << "Invalid hvcC configuration record, using the hevc_mp4toannexb filter" << std::endl;
+            parameterSets.clear();
+            return;
+        }
+        nalLengthSize = (pData[21] & 3) + 1; // lengthSizeMinusOne
+    }
+
+    // Reads the next packet of the video stream, through the bitstream filter of the stream demuxers
+    int ReadFilteredPacket(AVPacket* pFilteredPkt) {
+
+        while (true) {
+
+            if (bsfc) {
+                // A packet sent to the filter may be split in several ones, or be held for the next one
+                const int e = av_bsf_receive_packet(bsfc, pFilteredPkt);
+                if (e != AVERROR(EAGAIN)) {
+                    return e;
+                }
+            }
+
+            int e = 0;
+            while ((e = av_read_frame(fmtc, pPkt)) >= 0 && pPkt->stream_index != videoStream) {
+                av_packet_unref(pPkt);
+            }
+            if (e < 0) {
+                return e;
+            }
+
+            if (!bsfc) {
+                av_packet_move_ref(pFilteredPkt, pPkt);
+                return 0;
+            }
+
+            // The filter takes the ownership of the packet data
+            if (!ck(av_bsf_send_packet(bsfc, pPkt))) {
+                av_packet_unref(pPkt);
+            }
+        }
+    }
+
+    // Rewrites the length-prefixed NAL units of a packet with start codes to pDst, if not nullptr. Returns the size
+    // of the data rewritten, 0 if the NAL units overrun the packet.
+    static size_t WriteAnnexBNalUnits(const uint8_t* pSrc, size_t srcSize, uint32_t nalLengthSize, uint8_t* pDst) {
+        static const uint8_t startCode[3] = { 0x00, 0x00, 0x01 };
+        size_t dstSize = 0;
+        size_t offset = 0;
+        while ((offset + nalLengthSize) <= srcSize) {
+            size_t nalUnitSize = 0;
+            for (uint32_t i = 0; i < nalLengthSize; i++) {
+                nalUnitSize = (nalUnitSize << 8) | pSrc[offset + i];
+            }
+            offset += nalLengthSize;
+            if (nalUnitSize > (srcSize - offset)) {
+                return 0;
+            }
+            if (pDst != nullptr) {
+                memcpy(pDst + dstSize, startCode, sizeof(startCode));
+                memcpy(pDst + dstSize + sizeof(startCode), pSrc + offset, nalUnitSize);
+            }
+            dstSize += sizeof(startCode) + nalUnitSize;
+            offset += nalUnitSize;
+        }
+        return dstSize;
+    }
+
+    // Moves the packet of a slot of the ring to the memory of the packet allocator, if any, with start codes. The
+    // packets written to the same block of memory follow each other, for the parser to reference their pictures in
+    // place, across packets too, the way it does with a memory mapped elementary stream.
+    void CopyToPacketMemory(uint32_t packetIndex) {
+
+        AVPacket* pPacket = readAheadPackets[packetIndex];
+        // In the 10 MHz clock of the parser, from the time base of the stream
+        const AVRational parserTimeBase = { 1, 10000000 };
+        const AVRational streamTimeBase = fmtc->streams[videoStream]->time_base;
+        readAheadTimestamps[packetIndex][0] = (pPacket->pts != AV_NOPTS_VALUE) ?
+                av_rescale_q(pPacket->pts, streamTimeBase, parserTimeBase) : AV_NOPTS_VALUE;
+        readAheadTimestamps[packetIndex][1] = (pPacket->dts != AV_NOPTS_VALUE) ?
+                av_rescale_q(pPacket->dts, streamTimeBase, parserTimeBase) : AV_NOPTS_VALUE;
+        readAheadData[packetIndex] = pPacket->data;
+        readAheadSizes[packetIndex] = pPacket->size;
+        if ((packetAllocator == nullptr) || (pPacket->data == NULL) || (pPacket->size <= 0)) {
+            return;
+        }
+
+        const size_t size = (nalLengthSize > 0) ? WriteAnnexBNalUnits(pPacket->data, pPacket->size, nalLengthSize, nullptr) :
+                                                  (size_t)pPacket->size;
+        if ((size == 0) || (size > (size_t)std::numeric_limits<int>::max())) {
+            return; // for the parser to handle the invalid lengths
+        }
+
+        uint8_t* pData = packetAllocator->AllocatePacketMemory(size, readAheadPacketMemory[packetIndex]);
+        if (pData == nullptr) {
+            return;
+        }
+
+        if (nalLengthSize > 0) {
+            WriteAnnexBNalUnits(pPacket->data, pPacket->size, nalLengthSize, pData);
+        } else {
+            memcpy(pData, pPacket->data, size);
+        }
+        av_packet_unref(pPacket);
+        readAheadData[packetIndex] = pData;
+        readAheadSizes[packetIndex] = (int)size;
+    }
+
+    // Keeps the ring of packets full ahead of DemuxFrame(), for the container parsing and the latency of the
+    // file or network reads to stay off the decode thread. It exits at the end of the stream.
+    void ReadAheadThread() {
+
+        while (true) {
+
+            {
+                std::unique_lock<std::mutex> lock(readAheadMutex);
+                readAheadSpaceCondition.wait(lock, [this]() {
+                    return stopReadAhead || ((readAheadWriteIndex - readAheadReadIndex) < READ_AHEAD_PACKETS);
+                });
+                if (stopReadAhead) {
+                    break;
+                }
+            }
+
+            // The slot at the write index is only accessed by this thread until the index moves past it
+            const uint32_t packetIndex = readAheadWriteIndex % READ_AHEAD_PACKETS;
+            const int result = ReadFilteredPacket(readAheadPackets[packetIndex]);
+            if (result >= 0) {
+                CopyToPacketMemory(packetIndex);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(readAheadMutex);
+                readAheadResults[packetIndex] = result;
+                readAheadWriteIndex++;
+            }
+            readAheadPacketCondition.notify_one();
+
+            if (result < 0) {
+                break;
+            }
+        }
+    }
+
+    void StopReadAhead() {
+
+        if (readAheadThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(readAheadMutex);
+                stopReadAhead = true;
+            }
+            readAheadSpaceCondition.notify_one();
+            readAheadThread.join();
+        }
+
+        for (uint32_t i = 0; i < READ_AHEAD_PACKETS; i++) {
+            if (readAheadPackets[i] && readAheadPackets[i]->data) {
+                av_packet_unref(readAheadPackets[i]);
+            }
+            readAheadPacketMemory[i] = nullptr;
+            readAheadData[i] = nullptr;
+            readAheadSizes[i] = 0;
+            readAheadResults[i] = 0;
+            readAheadTimestamps[i][0] = AV_NOPTS_VALUE;
+            readAheadTimestamps[i][1] = AV_NOPTS_VALUE;
+        }
+        readAheadReadIndex = 0;
+        readAheadWriteIndex = 0;
+        readAheadPacketInUse = false;
+    }
+
+private:
+    enum { READ_AHEAD_PACKETS = 16 };
+
     AVFormatContext *fmtc = NULL;
     AVIOContext *avioc = NULL;
-    AVPacket *pPkt, *pktFiltered;
+    AVPacket *pPkt;
     AVBSFContext *bsfc = NULL;
+    uint32_t nalLengthSize;             // of the packets, 0 if they have start codes
+    std::vector<uint8_t> parameterSets; // of the configuration record, with 4 bytes lengths
+
+    std::thread             readAheadThread;
+    std::mutex              readAheadMutex;
+    std::condition_variable readAheadSpaceCondition;  // signaled when a packet is returned to the ring
+    std::condition_variable readAheadPacketCondition; // signaled when a packet is added to the ring
+    AVPacket*               readAheadPackets[READ_AHEAD_PACKETS];
+    int                     readAheadResults[READ_AHEAD_PACKETS]; // 0, or the error of av_read_frame()
+    VkSharedBaseObj<VkVideoRefCountBase> readAheadPacketMemory[READ_AHEAD_PACKETS]; // of the packet allocator
+    const uint8_t*          readAheadData[READ_AHEAD_PACKETS]; // of the packet, or in the packet allocator memory
+    int                     readAheadSizes[READ_AHEAD_PACKETS];
+    int64_t                 readAheadTimestamps[READ_AHEAD_PACKETS][2]; // pts and dts, AV_NOPTS_VALUE if unknown
+    VideoStreamPacketAllocator* packetAllocator; // the frames are written to its memory with start codes, if set
+    uint32_t                readAheadReadIndex;  // of the oldest packet in the ring
+    uint32_t                readAheadWriteIndex; // of the next packet read ahead
+    bool                    readAheadPacketInUse; // the oldest packet is still referenced by the caller
+    bool                    stopReadAhead;
 
     int videoStream;
     bool isStreamDemuxer;
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <stdio.h>
+#else
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "VkDecoderUtils/VideoStreamDemuxer.h"
+
+// An elementary stream read as it arrives from stdin ("-"), a FIFO, a character device or a TCP connection
+// ("tcp://host:port"), instead of being memory mapped. A thread reads the input ahead into a ring buffer of a
+// fixed size and blocks while it is full, so the memory used doesn't depend on the length of the stream. The
+// stream is returned in the chunks of the ring it arrived in, and the parser finds the picture boundaries.
+class StreamingElementaryStream : public VideoStreamDemuxer {
+
+public:
+    enum { RING_BUFFER_SIZE = 16 * 1024 * 1024, MAX_READ_SIZE = 1024 * 1024 };
+
+    static VkResult Create(const char *pFilePath,
+                           VkVideoCodecOperationFlagBitsKHR codecType,
+                           int32_t defaultWidth,
+                           int32_t defaultHeight,
+                           int32_t defaultBitDepth,
+                           VkSharedBaseObj<StreamingElementaryStream>& streamingElementaryStream)
+    {
+        VkSharedBaseObj<StreamingElementaryStream> newStream(new StreamingElementaryStream(codecType,
+                                                                                           defaultWidth,
+                                                                                           defaultHeight,
+                                                                                           defaultBitDepth));
+
+        if ((newStream) && (newStream->Initialize(pFilePath) >= 0)) {
+            streamingElementaryStream = newStream;
+            return VK_SUCCESS;
+        }
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    virtual bool IsStreamDemuxerEnabled() const { return false; }
+    // The chunks are parsed as they arrive, the input can't be mapped or scanned ahead
+    virtual bool HasFramePreparser() const { return true; }
+    virtual uint32_t GetNalLengthSize() const { return 0; }
+    virtual int64_t GetParameterSets(const uint8_t **ppData) const { return 0; }
+    // Returned from the ring buffer, the parser copies the chunks
+    virtual void SetPacketAllocator(VideoStreamPacketAllocator* pPacketAllocator) { }
+    // The input can't be read again
+    virtual void Rewind() { }
+    virtual VkVideoCodecOperationFlagBitsKHR GetVideoCodec() const { return m_videoCodecType; }
+
+    virtual VkVideoComponentBitDepthFlagsKHR GetLumaBitDepth() const
+    {
+        switch (m_bitDepth) {
+        case 8:
+            return VK_VIDEO_COMPONENT_BIT_DEPTH_8_BIT_KHR;
+        case 10:
+            return VK_VIDEO_COMPONENT_BIT_DEPTH_10_BIT_KHR;
+        case 12:
+            return VK_VIDEO_COMPONENT_BIT_DEPTH_12_BIT_KHR;
+        default:
+            assert(!"Unknown Luma Bit Depth!");
+        }
+        return VK_VIDEO_COMPONENT_BIT_DEPTH_INVALID_KHR;
+    }
+
+    virtual VkVideoChromaSubsamplingFlagsKHR GetChromaSubsampling() const
+    {
+        return VK_VIDEO_CHROMA_SUBSAMPLING_420_BIT_KHR;
+    }
+
+    virtual VkVideoComponentBitDepthFlagsKHR GetChromaBitDepth() const
+    {
+        return GetLumaBitDepth();
+    }
+
+    virtual uint32_t GetProfileIdc() const
+    {
+        return STD_VIDEO_H264_PROFILE_IDC_MAIN;
+    }
+
+    virtual int32_t GetWidth() const { return m_width; }
+    virtual int32_t GetHeight() const { return m_height; }
+    virtual int32_t GetBitDepth() const { return m_bitDepth; }
+
+    // Blocks until the input has more data, which is valid until the next call. Returns 0 at the end of the input.
+    virtual int64_t DemuxFrame(const uint8_t **ppVideo)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_chunkSize > 0) {
+            // The chunk returned by the previous call goes back to the reader
+            m_readOffset += m_chunkSize;
+            m_chunkSize = 0;
+            m_spaceCondition.notify_one();
+        }
+
+        m_dataCondition.wait(lock, [this]() { return (m_writeOffset != m_readOffset) || m_endOfInput; });
+        if (m_writeOffset == m_readOffset) {
+            return 0;
+        }
+
+        // Up to the end of the ring, the rest follows from its start on the next call
+        const size_t ringOffset = (size_t)(m_readOffset % RING_BUFFER_SIZE);
+        m_chunkSize = (size_t)std::min<uint64_t>(m_writeOffset - m_readOffset, RING_BUFFER_SIZE - ringOffset);
+        *ppVideo = &m_ringBuffer[ringOffset];
+        return (int64_t)m_chunkSize;
+    }
+
+    // No random access to the input
+    virtual bool GetFrameTimestamps(int64_t* pPresentationTimestamp, int64_t* pDecodeTimestamp) const
+    {
+        return false;
+    }
+
+    virtual int64_t ReadBitstreamData(const uint8_t **ppVideo, int64_t offset)
+    {
+        return -1;
+    }
+
+    // The chunks go back to the ring on the next DemuxFrame()
+    virtual void DiscardBitstreamData(int64_t offset) { }
+
+    virtual void DumpStreamParameters() const {
+    }
+
+private:
+    StreamingElementaryStream(VkVideoCodecOperationFlagBitsKHR codecType,
+                              int32_t defaultWidth,
+                              int32_t defaultHeight,
+                              int32_t defaultBitDepth)
+        : VideoStreamDemuxer()
+        , m_width(defaultWidth)
+        , m_height(defaultHeight)
+        , m_bitDepth(defaultBitDepth)
+        , m_videoCodecType(codecType)
+        , m_fd(-1)
+        , m_ringBuffer()
+        , m_readOffset(0)
+        , m_writeOffset(0)
+        , m_chunkSize(0)
+        , m_endOfInput(false)
+        , m_stop(false)
+        , m_mutex()
+        , m_spaceCondition()
+        , m_dataCondition()
+        , m_readThread() { }
+
+    virtual ~StreamingElementaryStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_spaceCondition.notify_one();
+        if (m_readThread.joinable()) {
+            m_readThread.join();
+        }
+        // The caller's stdin stays open
+        if (m_fd > 0) {
+#ifdef _WIN32
+            _close(m_fd);
+#else
+            close(m_fd);
+#endif
+        }
+    }
+
+    int32_t Initialize(const char *pFilePath)
+    {
+        if (strcmp(pFilePath, "-") == 0) {
+#ifdef _WIN32
+            m_fd = _fileno(stdin);
+            _setmode(m_fd, _O_BINARY);
+#else
+            m_fd = STDIN_FILENO;
+#endif
+        } else if (strncmp(pFilePath, "tcp://", 6) == 0) {
+            m_fd = ConnectTcp(pFilePath + 6);
+        } else {
+#ifdef _WIN32
+            m_fd = _open(pFilePath, _O_RDONLY | _O_BINARY);
+#else
+            m_fd = open(pFilePath, O_RDONLY);
+#endif
+        }
+
+        if (m_fd < 0) {
+            std::cerr << "Unable to open the input stream: " << pFilePath << std::endl;
+            return -1;
+        }
+
+        m_ringBuffer.resize(RING_BUFFER_SIZE);
+        m_readThread = std::thread(&StreamingElementaryStream::ReadThread, this);
+        return 0;
+    }
+
+    // Connects to host:port, returns the socket or -1
+    static int ConnectTcp(const char* pAddress)
+    {
+#ifdef _WIN32
+        std::cerr << "TCP input streams are not supported on this platform" << std::endl;
+        return -1;
+#else
+        const char* pPort = strrchr(pAddress, ':');
+        if (pPort == nullptr) {
+            std::cerr << "The TCP input stream needs a port: tcp://host:port" << std::endl;
+            return -1;
+        }
+        const std::string host(pAddress, pPort - pAddress);
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* pAddresses = nullptr;
+        if (getaddrinfo(host.c_str(), pPort + 1, &hints, &pAddresses) != 0) {
+            return -1;
+        }
+
+        int fd = -1;
+        for (struct addrinfo* pAddr = pAddresses; (pAddr != nullptr) && (fd < 0); pAddr = pAddr->ai_next) {
+            fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+            if ((fd >= 0) && (connect(fd, pAddr->ai_addr, pAddr->ai_addrlen) != 0)) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(pAddresses);
+        return fd;
+#endif
+    }
+
+    // Fills the ring buffer, blocking while it's full, until the end of the input or the destruction
+    void ReadThread()
+    {
+        while (true) {
+
+            size_t readSize = 0;
+            size_t ringOffset = 0;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_spaceCondition.wait(lock, [this]() {
+                    return m_stop || ((m_writeOffset - m_readOffset) < RING_BUFFER_SIZE);
+                });
+                if (m_stop) {
+                    break;
+                }
+                // Up to the end of the ring, or to the data not returned yet
+                ringOffset = (size_t)(m_writeOffset % RING_BUFFER_SIZE);
+                const size_t freeSize = (size_t)(RING_BUFFER_SIZE - (m_writeOffset - m_readOffset));
+                readSize = std::min<size_t>(std::min<size_t>(freeSize, RING_BUFFER_SIZE - ringOffset), MAX_READ_SIZE);
+            }
+
+            // Only the reader writes the free part of the ring
+#ifdef _WIN32
+            const int64_t bytesRead = _read(m_fd, &m_ringBuffer[ringOffset], (unsigned int)readSize);
+#else
+            // Waits for the input in steps, for the destructor not to wait on an idle input
+            struct pollfd pollFd = { m_fd, POLLIN, 0 };
+            const int ready = poll(&pollFd, 1, 100);
+            if ((ready == 0) || ((ready < 0) && (errno == EINTR))) {
+                continue;
+            }
+            const int64_t bytesRead = read(m_fd, &m_ringBuffer[ringOffset], readSize);
+            if ((bytesRead < 0) && (errno == EINTR)) {
+                continue;
+            }
+#endif
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (bytesRead > 0) {
+                    m_writeOffset += (uint64_t)bytesRead;
+                } else {
+                    m_endOfInput = true;
+                }
+            }
+            m_dataCondition.notify_one();
+
+            if (bytesRead <= 0) {
+                break;
+            }
+        }
+    }
+
+private:
+    int32_t    m_width, m_height, m_bitDepth;
+    VkVideoCodecOperationFlagBitsKHR m_videoCodecType;
+    int                     m_fd;
+    std::vector<uint8_t>    m_ringBuffer;
+    uint64_t                m_readOffset;  // in the input, of the data not returned yet
+    uint64_t                m_writeOffset; // in the input, of the end of the data read
+    size_t                  m_chunkSize;   // returned by the last DemuxFrame(), still in use
+    bool                    m_endOfInput;
+    bool                    m_stop;
+    std::mutex              m_mutex;
+    std::condition_variable m_spaceCondition; // signaled when a chunk is returned to the reader
+    std::condition_variable m_dataCondition;  // signaled when data is read, or at the end of the input
+    std::thread             m_readThread;
+};
+
+VkResult StreamingElementaryStreamCreate(const char *pFilePath,
+                                         VkVideoCodecOperationFlagBitsKHR codecType,
+                                         int32_t defaultWidth,
+                                         int32_t defaultHeight,
+                                         int32_t defaultBitDepth,
+                                         VkSharedBaseObj<VideoStreamDemuxer>& videoStreamDemuxer)
+{
+    VkSharedBaseObj<StreamingElementaryStream> streamingElementaryStream;
+    VkResult result = StreamingElementaryStream::Create(pFilePath,
+                                                        codecType,
+                                                        defaultWidth,
+                                                        defaultHeight,
+                                                        defaultBitDepth,
+                                                        streamingElementaryStream);
+    if (result == VK_SUCCESS) {
+        videoStreamDemuxer = streamingElementaryStream;
+    }
+
+    return result;
+}
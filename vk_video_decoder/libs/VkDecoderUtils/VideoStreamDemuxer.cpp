@@ -14,6 +14,8 @@
 * limitations under the License.
 */
 
+#include <string.h>
+#include <sys/stat.h>
 #include "VkDecoderUtils/VideoStreamDemuxer.h"
 
 VkResult FFmpegDemuxerCreate(const char *pFilePath,
@@ -31,6 +33,27 @@ VkResult ElementaryStreamCreate(const char *pFilePath,
                                 int32_t defaultBitDepth,
                                 VkSharedBaseObj<VideoStreamDemuxer>& videoStreamDemuxer);
 
+VkResult StreamingElementaryStreamCreate(const char *pFilePath,
+                                         VkVideoCodecOperationFlagBitsKHR codecType,
+                                         int32_t defaultWidth,
+                                         int32_t defaultHeight,
+                                         int32_t defaultBitDepth,
+                                         VkSharedBaseObj<VideoStreamDemuxer>& videoStreamDemuxer);
+
+bool VideoStreamDemuxer::IsStreamingInput(const char *pFilePath)
+{
+    if ((strcmp(pFilePath, "-") == 0) || (strncmp(pFilePath, "tcp://", 6) == 0)) {
+        return true;
+    }
+#ifndef _WIN32
+    struct stat fileStat;
+    if ((stat(pFilePath, &fileStat) == 0) && !S_ISREG(fileStat.st_mode) && !S_ISDIR(fileStat.st_mode)) {
+        return true;
+    }
+#endif
+    return false;
+}
+
 VkResult VideoStreamDemuxer::Create(const char *pFilePath,
                                     VkVideoCodecOperationFlagBitsKHR codecType,
                                     bool requiresStreamDemuxing,
@@ -47,6 +70,13 @@ VkResult VideoStreamDemuxer::Create(const char *pFilePath,
                                    defaultHeight,
                                    defaultBitDepth,
                                    videoStreamDemuxer);
+    } else if (IsStreamingInput(pFilePath)) {
+        return StreamingElementaryStreamCreate(pFilePath,
+                                               codecType,
+                                               defaultWidth,
+                                               defaultHeight,
+                                               defaultBitDepth,
+                                               videoStreamDemuxer);
     }  else {
         return ElementaryStreamCreate(pFilePath,
                                       codecType,
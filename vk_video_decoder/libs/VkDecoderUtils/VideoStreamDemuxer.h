@@ -20,6 +20,17 @@
 #include <vulkan_interfaces.h>
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 
+// Provides the memory the demuxed frames are written to, for the decoder to reference them in place
+class VideoStreamPacketAllocator {
+public:
+    // Called from the demux thread. Returns size bytes, valid while packetMemory is referenced, or nullptr
+    // for the frame to stay in the memory of the demuxer.
+    virtual uint8_t* AllocatePacketMemory(size_t size, VkSharedBaseObj<VkVideoRefCountBase>& packetMemory) = 0;
+
+protected:
+    virtual ~VideoStreamPacketAllocator() { }
+};
+
 class VideoStreamDemuxer : public VkVideoRefCountBase {
 
     static VkSharedBaseObj<VideoStreamDemuxer>& invalidDemuxer;
@@ -34,6 +45,10 @@ public:
                            int32_t defaultBitDepth = 12,
                            VkSharedBaseObj<VideoStreamDemuxer>& videoStreamDemuxer = invalidDemuxer);
 
+    // stdin ("-"), a TCP connection ("tcp://host:port"), or a file that isn't a regular one (e.g. a FIFO):
+    // its elementary stream is read as it arrives instead of being memory mapped
+    static bool IsStreamingInput(const char *pFilePath);
+
     virtual int32_t AddRef()
     {
         return ++m_refCount;
@@ -62,7 +77,20 @@ public:
     virtual bool IsStreamDemuxerEnabled() const = 0;
     virtual bool HasFramePreparser() const = 0;
     virtual int64_t DemuxFrame(const uint8_t **ppVideo) = 0;
+    // The container time stamps of the frame returned by the last DemuxFrame(), in 100 ns units (the default
+    // clock of the parser). Returns false if the frame has no presentation time stamp, the decode time stamp is
+    // INT64_MIN if the frame has none.
+    virtual bool GetFrameTimestamps(int64_t* pPresentationTimestamp, int64_t* pDecodeTimestamp) const = 0;
+    // 0 if the frames demuxed have start codes, else the size of the length in front of each of their NAL units
+    virtual uint32_t GetNalLengthSize() const = 0;
+    // The parameter sets of the container, with a 4 bytes length in front of each NAL unit, if it has any
+    virtual int64_t GetParameterSets(const uint8_t **ppData) const = 0;
+    // The frames demuxed from then on are written with start codes to the memory of the allocator, when it has
+    // enough. Set before the first frame is demuxed, and reset to nullptr before the allocator goes away.
+    virtual void SetPacketAllocator(VideoStreamPacketAllocator* pPacketAllocator) = 0;
     virtual int64_t ReadBitstreamData(const uint8_t **ppVideo, int64_t offset) = 0;
+    // The bitstream data before offset is not expected to be read again, its memory can be released
+    virtual void DiscardBitstreamData(int64_t offset) = 0;
     virtual void Rewind() = 0;
 
     virtual void DumpStreamParameters() const = 0;
@@ -231,8 +231,8 @@ VkResult VkParserVideoPictureParameters::UpdateParametersObject(const StdVideoPi
             return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    updateInfo.updateSequenceCount = std::max(pStdVideoPictureParametersSet->GetUpdateSequenceCount(), updateInfo.updateSequenceCount);
-
+    // Each update of the object must increment its update sequence count by one
+    updateInfo.updateSequenceCount = m_updateSequenceCount + 1;
 
     VkResult result = m_vkDevCtx->UpdateVideoSessionParametersKHR(*m_vkDevCtx,
                                                                   m_sessionParameters,
@@ -240,6 +240,8 @@ VkResult VkParserVideoPictureParameters::UpdateParametersObject(const StdVideoPi
 
     if (result == VK_SUCCESS) {
 
+        m_updateSequenceCount = updateInfo.updateSequenceCount;
+
         assert (currentId >= 0);
         switch (pStdVideoPictureParametersSet->GetParameterType()) {
             case StdVideoPictureParametersSet::PPS_TYPE:
@@ -404,30 +406,107 @@ int32_t VkParserVideoPictureParameters::FlushPictureParametersQueue(VkSharedBase
     return numQueueItems;
 }
 
-bool VkParserVideoPictureParameters::CheckStdObjectBeforeUpdate(VkSharedBaseObj<StdVideoPictureParametersSet>& stdPictureParametersSet,
-                                                                VkSharedBaseObj<VkParserVideoPictureParameters>& currentVideoPictureParameters)
+bool VkParserVideoPictureParameters::SetStdObjectAdded(const StdVideoPictureParametersSet* pStdPictureParametersSet)
 {
-    if (!stdPictureParametersSet) {
+    bool isId = false;
+    switch (pStdPictureParametersSet->GetParameterType()) {
+    case StdVideoPictureParametersSet::PPS_TYPE:
+    {
+        const uint32_t ppsId = (uint32_t)pStdPictureParametersSet->GetPpsId(isId);
+        if (!(ppsId < MAX_PPS_IDS)) {
+            return false;
+        }
+        m_ppsIdsAdded.set(ppsId, true);
+        m_ppsContentHash[ppsId] = pStdPictureParametersSet->GetContentHash();
+    }
+        break;
+    case StdVideoPictureParametersSet::SPS_TYPE:
+    {
+        const uint32_t spsId = (uint32_t)pStdPictureParametersSet->GetSpsId(isId);
+        if (!(spsId < MAX_SPS_IDS)) {
+            return false;
+        }
+        m_spsIdsAdded.set(spsId, true);
+        m_spsContentHash[spsId] = pStdPictureParametersSet->GetContentHash();
+    }
+        break;
+    case StdVideoPictureParametersSet::VPS_TYPE:
+    {
+        const uint32_t vpsId = (uint32_t)pStdPictureParametersSet->GetVpsId(isId);
+        if (!(vpsId < MAX_VPS_IDS)) {
+            return false;
+        }
+        m_vpsIdsAdded.set(vpsId, true);
+        m_vpsContentHash[vpsId] = pStdPictureParametersSet->GetContentHash();
+    }
+        break;
+    default:
+        assert(!"Invalid StdVideoPictureParametersSet Parameter Type!");
         return false;
     }
+    assert(isId);
+    return true;
+}
 
-    bool stdObjectUpdate = (stdPictureParametersSet->GetUpdateSequenceCount() > 0);
-
-    if (!currentVideoPictureParameters || stdObjectUpdate) {
+VkParserVideoPictureParameters::StdObjectUpdate
+VkParserVideoPictureParameters::CheckStdObjectBeforeUpdate(VkSharedBaseObj<StdVideoPictureParametersSet>& stdPictureParametersSet,
+                                                           VkSharedBaseObj<VkParserVideoPictureParameters>& currentVideoPictureParameters)
+{
+    if (!currentVideoPictureParameters) {
+        // Create the first Vulkan Picture Parameters object
+        return STD_OBJECT_REPLACE;
+    }
 
-        // Create new Vulkan Picture Parameters object
-        return true;
+    // The IDs new to the object are added to it in place. Only a content change of an ID the object
+    // already has needs a new object, since the session parameters entries can't be replaced.
+    bool isAdded = false;
+    uint64_t addedContentHash = 0;
+    bool isId = false;
+    switch (stdPictureParametersSet->GetParameterType()) {
+    case StdVideoPictureParametersSet::PPS_TYPE:
+    {
+        const uint32_t ppsId = (uint32_t)stdPictureParametersSet->GetPpsId(isId);
+        if (ppsId < MAX_PPS_IDS) {
+            isAdded = currentVideoPictureParameters->m_ppsIdsAdded[ppsId];
+            addedContentHash = currentVideoPictureParameters->m_ppsContentHash[ppsId];
+        }
+    }
+        break;
+    case StdVideoPictureParametersSet::SPS_TYPE:
+    {
+        const uint32_t spsId = (uint32_t)stdPictureParametersSet->GetSpsId(isId);
+        if (spsId < MAX_SPS_IDS) {
+            isAdded = currentVideoPictureParameters->m_spsIdsAdded[spsId];
+            addedContentHash = currentVideoPictureParameters->m_spsContentHash[spsId];
+        }
+    }
+        break;
+    case StdVideoPictureParametersSet::VPS_TYPE:
+    {
+        const uint32_t vpsId = (uint32_t)stdPictureParametersSet->GetVpsId(isId);
+        if (vpsId < MAX_VPS_IDS) {
+            isAdded = currentVideoPictureParameters->m_vpsIdsAdded[vpsId];
+            addedContentHash = currentVideoPictureParameters->m_vpsContentHash[vpsId];
+        }
+    }
+        break;
+    default:
+        assert(!"Invalid StdVideoPictureParametersSet Parameter Type!");
+    }
 
-    } else { // existing VkParserVideoPictureParameters object
-        assert(currentVideoPictureParameters);
-        // Update with the existing Vulkan Picture Parameters object
+    if (!isAdded) {
+        VkSharedBaseObj<VkVideoRefCountBase> clientObject;
+        stdPictureParametersSet->GetClientObject(clientObject);
+        assert(!clientObject);
+        return STD_OBJECT_ADD;
     }
 
-    VkSharedBaseObj<VkVideoRefCountBase> clientObject;
-    stdPictureParametersSet->GetClientObject(clientObject);
-    assert(!clientObject);
+    // A content hash of 0 is unknown content
+    if ((addedContentHash != 0) && (addedContentHash == stdPictureParametersSet->GetContentHash())) {
+        return STD_OBJECT_SAME;
+    }
 
-    return false;
+    return STD_OBJECT_REPLACE;
 }
 
 VkResult
@@ -446,10 +525,20 @@ VkParserVideoPictureParameters::AddPictureParameters(const VulkanDeviceContext*
     }
 
     VkResult result;
-    if (CheckStdObjectBeforeUpdate(stdPictureParametersSet, currentVideoPictureParameters)) {
+    const StdObjectUpdate stdObjectUpdate = CheckStdObjectBeforeUpdate(stdPictureParametersSet, currentVideoPictureParameters);
+    if (stdObjectUpdate == STD_OBJECT_SAME) {
+        return VK_SUCCESS;
+    } else if (stdObjectUpdate == STD_OBJECT_REPLACE) {
         result = VkParserVideoPictureParameters::Create(vkDevCtx,
                                                         currentVideoPictureParameters,
                                                         currentVideoPictureParameters);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    if (!currentVideoPictureParameters->SetStdObjectAdded(stdPictureParametersSet)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
     }
 
     if (videoSession) {
@@ -18,6 +18,7 @@
 #define _VKVIDEODECODER_VKPARSERVIDEOPICTUREPARAMETERS_H_
 
 #include <bitset>
+#include <string.h>
 #include <assert.h>
 #include <atomic>
 #include <queue>
@@ -58,8 +59,14 @@ public:
                                          VkSharedBaseObj<StdVideoPictureParametersSet>& stdPictureParametersSet,
                                          VkSharedBaseObj<VkParserVideoPictureParameters>& currentVideoPictureParameters);
 
-    static bool CheckStdObjectBeforeUpdate(VkSharedBaseObj<StdVideoPictureParametersSet>& pictureParametersSet,
-                                           VkSharedBaseObj<VkParserVideoPictureParameters>& currentVideoPictureParameters);
+    enum StdObjectUpdate {
+        STD_OBJECT_ADD = 0,   // New ID, added with vkUpdateVideoSessionParametersKHR
+        STD_OBJECT_SAME,      // Same content as the set already added for the ID, nothing to do
+        STD_OBJECT_REPLACE,   // The content of an added ID changes, needs a new parameters object
+    };
+
+    static StdObjectUpdate CheckStdObjectBeforeUpdate(VkSharedBaseObj<StdVideoPictureParametersSet>& pictureParametersSet,
+                                                      VkSharedBaseObj<VkParserVideoPictureParameters>& currentVideoPictureParameters);
 
     static VkResult Create(const VulkanDeviceContext* vkDevCtx,
                            VkSharedBaseObj<VkParserVideoPictureParameters>& templatePictureParameters,
@@ -93,6 +100,10 @@ public:
 
     int32_t GetId() const { return m_Id; }
 
+    // Number of times the parameters object had to be recreated, for a content change of an existing ID,
+    // since the first object of the template chain.
+    uint32_t GetRecreationCount() const { return m_recreationCount; }
+
     bool HasVpsId(uint32_t vpsId) const {
         return m_vpsIdsUsed[vpsId];
     }
@@ -119,11 +130,30 @@ protected:
           m_vkDevCtx(vkDevCtx),
           m_videoSession(),
           m_sessionParameters(),
-          m_templatePictureParameters(templatePictureParameters) { }
+          m_updateSequenceCount(0),
+          m_recreationCount(templatePictureParameters ? (templatePictureParameters->m_recreationCount + 1) : 0),
+          m_vpsIdsAdded(templatePictureParameters ? templatePictureParameters->m_vpsIdsAdded : std::bitset<MAX_VPS_IDS>()),
+          m_spsIdsAdded(templatePictureParameters ? templatePictureParameters->m_spsIdsAdded : std::bitset<MAX_SPS_IDS>()),
+          m_ppsIdsAdded(templatePictureParameters ? templatePictureParameters->m_ppsIdsAdded : std::bitset<MAX_PPS_IDS>()),
+          m_templatePictureParameters(templatePictureParameters)
+    {
+        if (templatePictureParameters) {
+            memcpy(m_vpsContentHash, templatePictureParameters->m_vpsContentHash, sizeof(m_vpsContentHash));
+            memcpy(m_spsContentHash, templatePictureParameters->m_spsContentHash, sizeof(m_spsContentHash));
+            memcpy(m_ppsContentHash, templatePictureParameters->m_ppsContentHash, sizeof(m_ppsContentHash));
+        } else {
+            memset(m_vpsContentHash, 0, sizeof(m_vpsContentHash));
+            memset(m_spsContentHash, 0, sizeof(m_spsContentHash));
+            memset(m_ppsContentHash, 0, sizeof(m_ppsContentHash));
+        }
+    }
 
     virtual ~VkParserVideoPictureParameters();
 
 private:
+    // Records the set as added to this object (applied or queued), returns false if its ID is out of range
+    bool SetStdObjectAdded(const StdVideoPictureParametersSet* pStdPictureParametersSet);
+
     static const char*              m_refClassId;
     static int32_t                  m_currentId;
     const char*                     m_classId;
@@ -132,6 +162,15 @@ private:
     const VulkanDeviceContext*      m_vkDevCtx;
     VkSharedBaseObj<VulkanVideoSession> m_videoSession;
     VkVideoSessionParametersKHR     m_sessionParameters;
+    uint32_t                        m_updateSequenceCount;
+    uint32_t                        m_recreationCount;
+    // The IDs and the content hashes of all the sets added to the object, including the queued ones
+    std::bitset<MAX_VPS_IDS>        m_vpsIdsAdded;
+    std::bitset<MAX_SPS_IDS>        m_spsIdsAdded;
+    std::bitset<MAX_PPS_IDS>        m_ppsIdsAdded;
+    uint64_t                        m_vpsContentHash[MAX_VPS_IDS];
+    uint64_t                        m_spsContentHash[MAX_SPS_IDS];
+    uint64_t                        m_ppsContentHash[MAX_PPS_IDS];
     std::bitset<MAX_VPS_IDS>        m_vpsIdsUsed;
     std::bitset<MAX_SPS_IDS>        m_spsIdsUsed;
     std::bitset<MAX_PPS_IDS>        m_ppsIdsUsed;
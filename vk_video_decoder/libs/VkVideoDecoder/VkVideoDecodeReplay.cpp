@@ -0,0 +1,867 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include "VkVideoDecodeReplay.h"
+
+static const char captureMagic[8] = { 'V', 'K', 'D', 'E', 'C', 'C', 'A', 'P' };
+
+static void AppendData(std::vector<uint8_t>& payload, const void* pData, size_t size)
+{
+    const uint8_t* pBytes = (const uint8_t*)pData;
+    payload.insert(payload.end(), pBytes, pBytes + size);
+}
+
+// The count of the array, 0 without it, followed by its elements
+template<class T>
+static void AppendArray(std::vector<uint8_t>& payload, const T* pArray, uint32_t count)
+{
+    if (pArray == nullptr) {
+        count = 0;
+    }
+    AppendData(payload, &count, sizeof(count));
+    if (count != 0) {
+        AppendData(payload, pArray, count * sizeof(T));
+    }
+}
+
+// Reads the payload of a record, any read past its end fails
+class CaptureRecordReader {
+public:
+    CaptureRecordReader(const uint8_t* pData, size_t size)
+        : m_pData(pData)
+        , m_size(size)
+        , m_offset(0)
+        , m_failed(false) { }
+
+    bool Read(void* pDst, size_t size)
+    {
+        if (m_failed || (size > (m_size - m_offset))) {
+            m_failed = true;
+            return false;
+        }
+        memcpy(pDst, m_pData + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+    // An array of AppendArray(), up to maxCount elements. Returns pDst, nullptr if the array was not recorded.
+    template<class T>
+    const T* ReadArray(T* pDst, uint32_t maxCount)
+    {
+        uint32_t count = 0;
+        if (!Read(&count, sizeof(count)) || (count > maxCount)) {
+            m_failed = true;
+            return nullptr;
+        }
+        if ((count == 0) || !Read(pDst, count * sizeof(T))) {
+            return nullptr;
+        }
+        return pDst;
+    }
+
+    bool IsComplete() const { return !m_failed && (m_offset == m_size); }
+
+private:
+    const uint8_t* m_pData;
+    const size_t   m_size;
+    size_t         m_offset;
+    bool           m_failed;
+};
+
+// A picture parameter set of a capture, with the std structure of its type and the arrays it points to
+class VkVideoDecodeReplayParameters : public StdVideoPictureParametersSet {
+public:
+    static const char* m_refClassId;
+
+    static VkResult Create(const uint8_t* pPayload, size_t payloadSize,
+                           VkSharedBaseObj<VkVideoDecodeReplayParameters>& parameterSet)
+    {
+        VkVideoDecodeCaptureFormat::ParametersRecord record;
+        if (payloadSize < sizeof(record)) {
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+        memcpy(&record, pPayload, sizeof(record));
+        if (record.stdType > TYPE_H265_PPS) {
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+
+        VkSharedBaseObj<VkVideoDecodeReplayParameters> newParameterSet(new VkVideoDecodeReplayParameters(record));
+        if (!newParameterSet) {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        CaptureRecordReader reader(pPayload + sizeof(record), payloadSize - sizeof(record));
+        if (!newParameterSet->Load(reader)) {
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+        parameterSet = newParameterSet;
+        return VK_SUCCESS;
+    }
+
+    uint32_t GetId() const { return m_record.id; }
+
+    virtual int32_t GetVpsId(bool& isVps) const
+    {
+        isVps = (m_record.isVps != 0);
+        return m_record.vpsId;
+    }
+
+    virtual int32_t GetSpsId(bool& isSps) const
+    {
+        isSps = (m_record.isSps != 0);
+        return m_record.spsId;
+    }
+
+    virtual int32_t GetPpsId(bool& isPps) const
+    {
+        isPps = (m_record.isPps != 0);
+        return m_record.ppsId;
+    }
+
+    virtual const StdVideoH264SequenceParameterSet* GetStdH264Sps() const
+    {
+        return (GetStdType() == TYPE_H264_SPS) ? &m_h264Sps : nullptr;
+    }
+
+    virtual const StdVideoH264PictureParameterSet* GetStdH264Pps() const
+    {
+        return (GetStdType() == TYPE_H264_PPS) ? &m_h264Pps : nullptr;
+    }
+
+    virtual const StdVideoH265VideoParameterSet* GetStdH265Vps() const
+    {
+        return (GetStdType() == TYPE_H265_VPS) ? &m_h265Vps : nullptr;
+    }
+
+    virtual const StdVideoH265SequenceParameterSet* GetStdH265Sps() const
+    {
+        return (GetStdType() == TYPE_H265_SPS) ? &m_h265Sps : nullptr;
+    }
+
+    virtual const StdVideoH265PictureParameterSet* GetStdH265Pps() const
+    {
+        return (GetStdType() == TYPE_H265_PPS) ? &m_h265Pps : nullptr;
+    }
+
+    virtual const char* GetRefClassId() const { return m_refClassId; }
+
+    virtual bool GetClientObject(VkSharedBaseObj<VkVideoRefCountBase>& clientObject) const
+    {
+        clientObject = client;
+        return !!clientObject;
+    }
+
+    virtual VkVideoRefCountBase* GetClientObjectPtr() const { return client; }
+
+    VkSharedBaseObj<VkVideoRefCountBase> client;
+
+private:
+    static ParameterType GetParameterType(StdType stdType)
+    {
+        switch (stdType) {
+        case TYPE_H264_SPS:
+        case TYPE_H265_SPS:
+            return SPS_TYPE;
+        case TYPE_H264_PPS:
+        case TYPE_H265_PPS:
+            return PPS_TYPE;
+        case TYPE_H265_VPS:
+            return VPS_TYPE;
+        default:
+            break;
+        }
+        return INVALID_TYPE;
+    }
+
+    VkVideoDecodeReplayParameters(const VkVideoDecodeCaptureFormat::ParametersRecord& record)
+        : StdVideoPictureParametersSet((StdType)record.stdType, GetParameterType((StdType)record.stdType),
+                                       m_refClassId, record.updateSequenceCount)
+        , client()
+        , m_record(record)
+        , m_h264Sps()
+        , m_h264Pps()
+        , m_h264ScalingLists()
+        , m_h264OffsetForRefFrame()
+        , m_h264Vui()
+        , m_h264Hrd()
+        , m_h265Vps()
+        , m_h265Sps()
+        , m_h265Pps()
+        , m_h265ProfileTierLevel()
+        , m_h265DecPicBufMgr()
+        , m_h265ScalingLists()
+        , m_h265ShortTermRefPicSets()
+        , m_h265LongTermRefPicsSps()
+        , m_h265Vui()
+        , m_h265PredictorPaletteEntries() { }
+
+    virtual ~VkVideoDecodeReplayParameters()
+    {
+        client = nullptr;
+    }
+
+    // The pointers of the std structure read are replaced by the arrays read after it
+    bool Load(CaptureRecordReader& reader)
+    {
+        switch (GetStdType()) {
+        case TYPE_H264_SPS:
+            reader.Read(&m_h264Sps, sizeof(m_h264Sps));
+            m_h264Sps.pOffsetForRefFrame = reader.ReadArray(m_h264OffsetForRefFrame, 255);
+            m_h264Sps.pScalingLists = reader.ReadArray(&m_h264ScalingLists, 1);
+            m_h264Sps.pSequenceParameterSetVui = reader.ReadArray(&m_h264Vui, 1);
+            m_h264Vui.pHrdParameters = reader.ReadArray(&m_h264Hrd, 1);
+            break;
+        case TYPE_H264_PPS:
+            reader.Read(&m_h264Pps, sizeof(m_h264Pps));
+            m_h264Pps.pScalingLists = reader.ReadArray(&m_h264ScalingLists, 1);
+            break;
+        case TYPE_H265_VPS:
+            reader.Read(&m_h265Vps, sizeof(m_h265Vps));
+            m_h265Vps.pDecPicBufMgr = reader.ReadArray(&m_h265DecPicBufMgr, 1);
+            m_h265Vps.pProfileTierLevel = reader.ReadArray(&m_h265ProfileTierLevel, 1);
+            // The HRD parameters are not recorded, they do not take part in the decoding
+            m_h265Vps.pHrdParameters = nullptr;
+            break;
+        case TYPE_H265_SPS:
+            reader.Read(&m_h265Sps, sizeof(m_h265Sps));
+            m_h265Sps.pProfileTierLevel = reader.ReadArray(&m_h265ProfileTierLevel, 1);
+            m_h265Sps.pDecPicBufMgr = reader.ReadArray(&m_h265DecPicBufMgr, 1);
+            m_h265Sps.pScalingLists = reader.ReadArray(&m_h265ScalingLists, 1);
+            m_h265Sps.pShortTermRefPicSet = reader.ReadArray(m_h265ShortTermRefPicSets,
+                                                             STD_VIDEO_H265_MAX_SHORT_TERM_REF_PIC_SETS);
+            m_h265Sps.pLongTermRefPicsSps = reader.ReadArray(&m_h265LongTermRefPicsSps, 1);
+            m_h265Sps.pSequenceParameterSetVui = reader.ReadArray(&m_h265Vui, 1);
+            m_h265Vui.flags.vui_hrd_parameters_present_flag = 0;
+            m_h265Vui.pHrdParameters = nullptr;
+            m_h265Sps.pPredictorPaletteEntries = reader.ReadArray(&m_h265PredictorPaletteEntries, 1);
+            break;
+        case TYPE_H265_PPS:
+            reader.Read(&m_h265Pps, sizeof(m_h265Pps));
+            m_h265Pps.pScalingLists = reader.ReadArray(&m_h265ScalingLists, 1);
+            m_h265Pps.pPredictorPaletteEntries = reader.ReadArray(&m_h265PredictorPaletteEntries, 1);
+            break;
+        default:
+            return false;
+        }
+        return reader.IsComplete();
+    }
+
+private:
+    const VkVideoDecodeCaptureFormat::ParametersRecord m_record;
+    StdVideoH264SequenceParameterSet    m_h264Sps;
+    StdVideoH264PictureParameterSet     m_h264Pps;
+    StdVideoH264ScalingLists            m_h264ScalingLists;
+    int32_t                             m_h264OffsetForRefFrame[255];
+    StdVideoH264SequenceParameterSetVui m_h264Vui;
+    StdVideoH264HrdParameters           m_h264Hrd;
+    StdVideoH265VideoParameterSet       m_h265Vps;
+    StdVideoH265SequenceParameterSet    m_h265Sps;
+    StdVideoH265PictureParameterSet     m_h265Pps;
+    StdVideoH265ProfileTierLevel        m_h265ProfileTierLevel;
+    StdVideoH265DecPicBufMgr            m_h265DecPicBufMgr;
+    StdVideoH265ScalingLists            m_h265ScalingLists;
+    StdVideoH265ShortTermRefPicSet      m_h265ShortTermRefPicSets[STD_VIDEO_H265_MAX_SHORT_TERM_REF_PIC_SETS];
+    StdVideoH265LongTermRefPicsSps      m_h265LongTermRefPicsSps;
+    StdVideoH265SequenceParameterSetVui m_h265Vui;
+    StdVideoH265PredictorPaletteEntries m_h265PredictorPaletteEntries;
+};
+
+const char* VkVideoDecodeReplayParameters::m_refClassId = "VkVideoDecodeReplayParameters";
+
+VkResult VkVideoDecodeCapture::Create(const char* fileName,
+                                      VkVideoCodecOperationFlagBitsKHR codec,
+                                      VkSharedBaseObj<IVulkanVideoDecoderHandler>& decoderHandler,
+                                      VkSharedBaseObj<IVulkanVideoDecoderHandler>& captureHandler)
+{
+    if ((codec != VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) &&
+            (codec != VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR)) {
+        fprintf(stderr, "\nERROR: Only the H.264 and H.265 streams can be captured\n");
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    FILE* captureFile = fopen(fileName, "wb");
+    if (captureFile == nullptr) {
+        fprintf(stderr, "\nERROR: Can't open the decode capture file %s\n", fileName);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkVideoDecodeCaptureFormat::FileHeader fileHeader = VkVideoDecodeCaptureFormat::FileHeader();
+    memcpy(fileHeader.magic, captureMagic, sizeof(fileHeader.magic));
+    fileHeader.version = VkVideoDecodeCaptureFormat::VERSION;
+    fileHeader.codec = (uint32_t)codec;
+    fileHeader.formatSize = (uint32_t)sizeof(VkParserDetectedVideoFormat);
+    fileHeader.parametersRecordSize = (uint32_t)sizeof(VkVideoDecodeCaptureFormat::ParametersRecord);
+    fileHeader.pictureRecordSize = (uint32_t)sizeof(VkVideoDecodeCaptureFormat::PictureRecord);
+    if (fwrite(&fileHeader, sizeof(fileHeader), 1, captureFile) != 1) {
+        fprintf(stderr, "\nERROR: Can't write the decode capture file %s\n", fileName);
+        fclose(captureFile);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VkVideoDecodeCapture> capture(new VkVideoDecodeCapture(captureFile, codec, decoderHandler));
+    if (!capture) {
+        assert(!"Couldn't allocate host memory!");
+        fclose(captureFile);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    captureHandler = capture;
+    return VK_SUCCESS;
+}
+
+VkVideoDecodeCapture::VkVideoDecodeCapture(FILE* captureFile, VkVideoCodecOperationFlagBitsKHR codec,
+                                           VkSharedBaseObj<IVulkanVideoDecoderHandler>& decoderHandler)
+    : m_refCount(0)
+    , m_captureFile(captureFile)
+    , m_codec(codec)
+    , m_decoderHandler(decoderHandler)
+    , m_parametersIds()
+    , m_nextParametersId(0)
+    , m_numPictures(0)
+    , m_numPicturesSkipped(0)
+    , m_bitstreamBytes(0)
+    , m_writeFailed(false)
+    , m_payload()
+{
+}
+
+VkVideoDecodeCapture::~VkVideoDecodeCapture()
+{
+    if (fclose(m_captureFile) != 0) {
+        m_writeFailed = true;
+    }
+    printf("Decode capture: %llu pictures, %llu bitstream bytes, %u parameter sets\n",
+           (unsigned long long)m_numPictures, (unsigned long long)m_bitstreamBytes, m_nextParametersId);
+    if (m_numPicturesSkipped != 0) {
+        fprintf(stderr, "\nWARNING: %llu pictures of parameter sets never updated were not captured\n",
+                (unsigned long long)m_numPicturesSkipped);
+    }
+    if (m_writeFailed) {
+        fprintf(stderr, "\nERROR: Failed to write the decode capture, it is incomplete\n");
+    }
+    m_decoderHandler = nullptr;
+}
+
+bool VkVideoDecodeCapture::WriteRecord(VkVideoDecodeCaptureFormat::RecordType type, const std::vector<uint8_t>& payload)
+{
+    if (m_writeFailed) {
+        return false;
+    }
+    VkVideoDecodeCaptureFormat::RecordHeader recordHeader;
+    recordHeader.type = (uint32_t)type;
+    recordHeader.size = (uint32_t)payload.size();
+    if ((fwrite(&recordHeader, sizeof(recordHeader), 1, m_captureFile) != 1) ||
+            (!payload.empty() && (fwrite(payload.data(), payload.size(), 1, m_captureFile) != 1))) {
+        m_writeFailed = true;
+        return false;
+    }
+    return true;
+}
+
+int32_t VkVideoDecodeCapture::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFormat)
+{
+    m_payload.clear();
+    AppendData(m_payload, pVideoFormat, sizeof(*pVideoFormat));
+    WriteRecord(VkVideoDecodeCaptureFormat::RECORD_SEQUENCE, m_payload);
+
+    return m_decoderHandler->StartVideoSequence(pVideoFormat);
+}
+
+bool VkVideoDecodeCapture::UpdatePictureParameters(VkSharedBaseObj<StdVideoPictureParametersSet>& pictureParametersObject,
+                                                   VkSharedBaseObj<VkVideoRefCountBase>& client)
+{
+    if (pictureParametersObject) {
+        WriteParameters(pictureParametersObject);
+    }
+    return m_decoderHandler->UpdatePictureParameters(pictureParametersObject, client);
+}
+
+int32_t VkVideoDecodeCapture::DecodePictureWithParameters(VkParserPerFrameDecodeParameters* pPicParams,
+                                                          VkParserDecodePictureInfo* pDecodePictureInfo)
+{
+    // Before the decoder, which completes the parameters with its resources
+    if (WritePicture(pPicParams, pDecodePictureInfo)) {
+        m_numPictures++;
+        m_bitstreamBytes += pPicParams->bitstreamDataLen;
+    }
+    return m_decoderHandler->DecodePictureWithParameters(pPicParams, pDecodePictureInfo);
+}
+
+bool VkVideoDecodeCapture::WriteParameters(const StdVideoPictureParametersSet* pParameterSet)
+{
+    VkVideoDecodeCaptureFormat::ParametersRecord record;
+    memset(&record, 0, sizeof(record));
+    record.id = m_nextParametersId;
+    record.stdType = (uint32_t)pParameterSet->GetStdType();
+    record.updateSequenceCount = pParameterSet->GetUpdateSequenceCount();
+    bool isId = false;
+    record.vpsId = pParameterSet->GetVpsId(isId);
+    record.isVps = isId;
+    record.spsId = pParameterSet->GetSpsId(isId);
+    record.isSps = isId;
+    record.ppsId = pParameterSet->GetPpsId(isId);
+    record.isPps = isId;
+
+    m_payload.clear();
+    AppendData(m_payload, &record, sizeof(record));
+    switch (pParameterSet->GetStdType()) {
+    case StdVideoPictureParametersSet::TYPE_H264_SPS: {
+        const StdVideoH264SequenceParameterSet* pSps = pParameterSet->GetStdH264Sps();
+        AppendData(m_payload, pSps, sizeof(*pSps));
+        AppendArray(m_payload, pSps->pOffsetForRefFrame, pSps->num_ref_frames_in_pic_order_cnt_cycle);
+        AppendArray(m_payload, pSps->pScalingLists, 1);
+        AppendArray(m_payload, pSps->pSequenceParameterSetVui, 1);
+        AppendArray(m_payload, pSps->pSequenceParameterSetVui ? pSps->pSequenceParameterSetVui->pHrdParameters : nullptr, 1);
+        break;
+    }
+    case StdVideoPictureParametersSet::TYPE_H264_PPS: {
+        const StdVideoH264PictureParameterSet* pPps = pParameterSet->GetStdH264Pps();
+        AppendData(m_payload, pPps, sizeof(*pPps));
+        AppendArray(m_payload, pPps->pScalingLists, 1);
+        break;
+    }
+    case StdVideoPictureParametersSet::TYPE_H265_VPS: {
+        const StdVideoH265VideoParameterSet* pVps = pParameterSet->GetStdH265Vps();
+        AppendData(m_payload, pVps, sizeof(*pVps));
+        AppendArray(m_payload, pVps->pDecPicBufMgr, 1);
+        AppendArray(m_payload, pVps->pProfileTierLevel, 1);
+        break;
+    }
+    case StdVideoPictureParametersSet::TYPE_H265_SPS: {
+        const StdVideoH265SequenceParameterSet* pSps = pParameterSet->GetStdH265Sps();
+        AppendData(m_payload, pSps, sizeof(*pSps));
+        AppendArray(m_payload, pSps->pProfileTierLevel, 1);
+        AppendArray(m_payload, pSps->pDecPicBufMgr, 1);
+        AppendArray(m_payload, pSps->pScalingLists, 1);
+        AppendArray(m_payload, pSps->pShortTermRefPicSet, pSps->num_short_term_ref_pic_sets);
+        AppendArray(m_payload, pSps->pLongTermRefPicsSps, 1);
+        AppendArray(m_payload, pSps->pSequenceParameterSetVui, 1);
+        AppendArray(m_payload, pSps->pPredictorPaletteEntries, 1);
+        break;
+    }
+    case StdVideoPictureParametersSet::TYPE_H265_PPS: {
+        const StdVideoH265PictureParameterSet* pPps = pParameterSet->GetStdH265Pps();
+        AppendData(m_payload, pPps, sizeof(*pPps));
+        AppendArray(m_payload, pPps->pScalingLists, 1);
+        AppendArray(m_payload, pPps->pPredictorPaletteEntries, 1);
+        break;
+    }
+    default:
+        return false;
+    }
+
+    if (!WriteRecord(VkVideoDecodeCaptureFormat::RECORD_PARAMETERS, m_payload)) {
+        return false;
+    }
+    // The storage of a released set can come back as a new one, the last record of an address is the one in use
+    m_parametersIds[pParameterSet] = m_nextParametersId++;
+    return true;
+}
+
+uint32_t VkVideoDecodeCapture::GetParametersId(const StdVideoPictureParametersSet* pParameterSet) const
+{
+    if (pParameterSet == nullptr) {
+        return VkVideoDecodeCaptureFormat::NO_PARAMETERS;
+    }
+    std::unordered_map<const StdVideoPictureParametersSet*, uint32_t>::const_iterator it = m_parametersIds.find(pParameterSet);
+    return (it != m_parametersIds.end()) ? it->second : VkVideoDecodeCaptureFormat::NO_PARAMETERS;
+}
+
+// Copies the std reference info of a DPB slot, false if the slot has none
+static bool GetStdReferenceInfo(const VkVideoReferenceSlotInfoKHR* pSlot,
+                                VkVideoDecodeCaptureFormat::StdReferenceInfo& stdReferenceInfo)
+{
+    for (const VkBaseInStructure* pNext = (const VkBaseInStructure*)pSlot->pNext; pNext != nullptr; pNext = pNext->pNext) {
+        if (pNext->sType == VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_DPB_SLOT_INFO_KHR) {
+            stdReferenceInfo.h264 = *((const VkVideoDecodeH264DpbSlotInfoKHR*)pNext)->pStdReferenceInfo;
+            return true;
+        } else if (pNext->sType == VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_DPB_SLOT_INFO_KHR) {
+            stdReferenceInfo.h265 = *((const VkVideoDecodeH265DpbSlotInfoKHR*)pNext)->pStdReferenceInfo;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VkVideoDecodeCapture::WritePicture(const VkParserPerFrameDecodeParameters* pPicParams,
+                                        const VkParserDecodePictureInfo* pDecodePictureInfo)
+{
+    // Zeroed with the padding, for the captures of a stream to be identical
+    VkVideoDecodeCaptureFormat::PictureRecord picture;
+    memset(&picture, 0, sizeof(picture));
+    picture.currPicIdx = pPicParams->currPicIdx;
+    picture.vpsId = GetParametersId(pPicParams->pStdVps);
+    picture.spsId = GetParametersId(pPicParams->pStdSps);
+    picture.ppsId = GetParametersId(pPicParams->pStdPps);
+    if (((pPicParams->pStdVps != nullptr) && (picture.vpsId == VkVideoDecodeCaptureFormat::NO_PARAMETERS)) ||
+            ((pPicParams->pStdSps != nullptr) && (picture.spsId == VkVideoDecodeCaptureFormat::NO_PARAMETERS)) ||
+            (picture.ppsId == VkVideoDecodeCaptureFormat::NO_PARAMETERS)) {
+        m_numPicturesSkipped++;
+        return false;
+    }
+
+    assert(pPicParams->numGopReferenceSlots <= (int32_t)VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS);
+    picture.numGopReferenceSlots = pPicParams->numGopReferenceSlots;
+    memcpy(picture.gopReferenceImagesIndexes, pPicParams->pGopReferenceImagesIndexes,
+           sizeof(picture.gopReferenceImagesIndexes));
+
+    const uint32_t* pSliceOffsets = nullptr;
+    for (const VkBaseInStructure* pNext = (const VkBaseInStructure*)pPicParams->decodeFrameInfo.pNext;
+            pNext != nullptr; pNext = pNext->pNext) {
+        if (pNext->sType == VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_PICTURE_INFO_KHR) {
+            const VkVideoDecodeH264PictureInfoKHR* pPictureInfo = (const VkVideoDecodeH264PictureInfoKHR*)pNext;
+            picture.stdPictureInfo.h264 = *pPictureInfo->pStdPictureInfo;
+            picture.sliceCount = pPictureInfo->sliceCount;
+            pSliceOffsets = pPictureInfo->pSliceOffsets;
+        } else if (pNext->sType == VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_PICTURE_INFO_KHR) {
+            const VkVideoDecodeH265PictureInfoKHR* pPictureInfo = (const VkVideoDecodeH265PictureInfoKHR*)pNext;
+            picture.stdPictureInfo.h265 = *pPictureInfo->pStdPictureInfo;
+            picture.sliceCount = pPictureInfo->sliceSegmentCount;
+            pSliceOffsets = pPictureInfo->pSliceSegmentOffsets;
+        }
+    }
+    if ((pSliceOffsets == nullptr) && (picture.sliceCount != 0)) {
+        m_numPicturesSkipped++;
+        return false;
+    }
+
+    const VkVideoReferenceSlotInfoKHR* pSetupReferenceSlot = pPicParams->decodeFrameInfo.pSetupReferenceSlot;
+    picture.slotIndexes[0] = (pSetupReferenceSlot != nullptr) ? pSetupReferenceSlot->slotIndex : -1;
+    if (pSetupReferenceSlot != nullptr) {
+        picture.hasStdReferenceInfo[0] = GetStdReferenceInfo(pSetupReferenceSlot, picture.stdReferenceInfos[0]);
+    }
+    picture.referenceSlotCount = std::min<uint32_t>(pPicParams->decodeFrameInfo.referenceSlotCount,
+                                                    VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS);
+    for (uint32_t slot = 0; slot < picture.referenceSlotCount; slot++) {
+        const VkVideoReferenceSlotInfoKHR* pReferenceSlot = &pPicParams->decodeFrameInfo.pReferenceSlots[slot];
+        picture.slotIndexes[slot + 1] = pReferenceSlot->slotIndex;
+        picture.hasStdReferenceInfo[slot + 1] = GetStdReferenceInfo(pReferenceSlot, picture.stdReferenceInfos[slot + 1]);
+    }
+
+    picture.decodePictureInfo = *pDecodePictureInfo;
+    picture.decodePictureInfo.frameSyncinfo.pDebugInterface = nullptr;
+
+    // The data of the buffers referencing the input in place starts at their data offset, as do their slice offsets
+    const VulkanBitstreamBuffer* pBitstreamData = pPicParams->bitstreamData;
+    const uint32_t dataOffset = (uint32_t)pBitstreamData->GetDataOffset();
+    VkDeviceSize maxSize = 0;
+    const uint8_t* pData = pBitstreamData->GetReadOnlyDataPtr(pPicParams->bitstreamDataOffset, maxSize);
+    if ((pData == nullptr) || (maxSize < pPicParams->bitstreamDataLen)) {
+        m_numPicturesSkipped++;
+        return false;
+    }
+    picture.bitstreamSize = (uint32_t)pPicParams->bitstreamDataLen;
+    picture.bitstreamOffsetAlignment = (uint32_t)pBitstreamData->GetOffsetAlignment();
+    picture.bitstreamSizeAlignment = (uint32_t)pBitstreamData->GetSizeAlignment();
+
+    m_payload.clear();
+    AppendData(m_payload, &picture, sizeof(picture));
+    for (uint32_t slice = 0; slice < picture.sliceCount; slice++) {
+        const uint32_t sliceOffset = pSliceOffsets[slice] - dataOffset;
+        AppendData(m_payload, &sliceOffset, sizeof(sliceOffset));
+    }
+    AppendData(m_payload, pData, picture.bitstreamSize);
+    return WriteRecord(VkVideoDecodeCaptureFormat::RECORD_PICTURE, m_payload);
+}
+
+VkResult VkVideoDecodeReplay::Create(const char* fileName, VkSharedBaseObj<VkVideoDecodeReplay>& decodeReplay)
+{
+    VkSharedBaseObj<VkVideoDecodeReplay> replay(new VkVideoDecodeReplay());
+    if (!replay) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = replay->Load(fileName);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    decodeReplay = replay;
+    return VK_SUCCESS;
+}
+
+VkVideoDecodeReplay::VkVideoDecodeReplay()
+    : m_refCount(0)
+    , m_codec(VK_VIDEO_CODEC_OPERATION_NONE_KHR)
+    , m_fileData()
+    , m_records()
+    , m_numPictures(0)
+    , m_bitstreamBytes(0)
+    , m_numParameterSets(0)
+    , m_sliceOffsets()
+{
+}
+
+VkResult VkVideoDecodeReplay::Load(const char* fileName)
+{
+    FILE* captureFile = fopen(fileName, "rb");
+    if (captureFile == nullptr) {
+        fprintf(stderr, "\nERROR: Can't open the decode capture file %s\n", fileName);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // The whole file is read ahead, the replay is not held back by the disk
+    const size_t readBlockSize = 4 * 1024 * 1024;
+    size_t fileSize = 0;
+    for (;;) {
+        m_fileData.resize(fileSize + readBlockSize);
+        const size_t readSize = fread(m_fileData.data() + fileSize, 1, readBlockSize, captureFile);
+        fileSize += readSize;
+        if (readSize < readBlockSize) {
+            break;
+        }
+    }
+    m_fileData.resize(fileSize);
+    const bool readFailed = (ferror(captureFile) != 0);
+    fclose(captureFile);
+    if (readFailed) {
+        fprintf(stderr, "\nERROR: Can't read the decode capture file %s\n", fileName);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkVideoDecodeCaptureFormat::FileHeader fileHeader;
+    if ((fileSize < sizeof(fileHeader)) ||
+            (memcpy(&fileHeader, m_fileData.data(), sizeof(fileHeader)) == nullptr) ||
+            (memcmp(fileHeader.magic, captureMagic, sizeof(captureMagic)) != 0) ||
+            (fileHeader.version != VkVideoDecodeCaptureFormat::VERSION)) {
+        fprintf(stderr, "\nERROR: %s is not a decode capture\n", fileName);
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+    if ((fileHeader.formatSize != sizeof(VkParserDetectedVideoFormat)) ||
+            (fileHeader.parametersRecordSize != sizeof(VkVideoDecodeCaptureFormat::ParametersRecord)) ||
+            (fileHeader.pictureRecordSize != sizeof(VkVideoDecodeCaptureFormat::PictureRecord))) {
+        fprintf(stderr, "\nERROR: The decode capture %s was written by a different build\n", fileName);
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+    m_codec = (VkVideoCodecOperationFlagBitsKHR)fileHeader.codec;
+    if ((m_codec != VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) &&
+            (m_codec != VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR)) {
+        fprintf(stderr, "\nERROR: Unsupported codec 0x%x of the decode capture %s\n", fileHeader.codec, fileName);
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    // Only the framing and the references of the records are checked here, their content when they are replayed
+    size_t offset = sizeof(fileHeader);
+    while (offset < fileSize) {
+        VkVideoDecodeCaptureFormat::RecordHeader recordHeader;
+        if ((fileSize - offset) < sizeof(recordHeader)) {
+            break;
+        }
+        memcpy(&recordHeader, &m_fileData[offset], sizeof(recordHeader));
+        offset += sizeof(recordHeader);
+        if (recordHeader.size > (fileSize - offset)) {
+            break;
+        }
+
+        Record record;
+        record.type = (VkVideoDecodeCaptureFormat::RecordType)recordHeader.type;
+        record.payloadOffset = offset;
+        record.payloadSize = recordHeader.size;
+        offset += recordHeader.size;
+
+        bool valid = false;
+        switch (record.type) {
+        case VkVideoDecodeCaptureFormat::RECORD_SEQUENCE:
+            valid = (record.payloadSize == sizeof(VkParserDetectedVideoFormat));
+            break;
+        case VkVideoDecodeCaptureFormat::RECORD_PARAMETERS: {
+            VkVideoDecodeCaptureFormat::ParametersRecord parameters;
+            if (record.payloadSize >= sizeof(parameters)) {
+                memcpy(&parameters, &m_fileData[record.payloadOffset], sizeof(parameters));
+                valid = (parameters.id == m_numParameterSets++);
+            }
+            break;
+        }
+        case VkVideoDecodeCaptureFormat::RECORD_PICTURE: {
+            VkVideoDecodeCaptureFormat::PictureRecord picture;
+            if (record.payloadSize >= sizeof(picture)) {
+                memcpy(&picture, &m_fileData[record.payloadOffset], sizeof(picture));
+                const uint64_t payloadSize = sizeof(picture) + (uint64_t)picture.sliceCount * sizeof(uint32_t) +
+                                             picture.bitstreamSize;
+                valid = (payloadSize == record.payloadSize) &&
+                        (picture.referenceSlotCount <= VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS) &&
+                        (picture.numGopReferenceSlots >= 0) &&
+                        (picture.numGopReferenceSlots <= (int32_t)VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS) &&
+                        (picture.ppsId < m_numParameterSets) &&
+                        ((picture.spsId == VkVideoDecodeCaptureFormat::NO_PARAMETERS) || (picture.spsId < m_numParameterSets)) &&
+                        ((picture.vpsId == VkVideoDecodeCaptureFormat::NO_PARAMETERS) || (picture.vpsId < m_numParameterSets));
+                m_numPictures++;
+                m_bitstreamBytes += picture.bitstreamSize;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (!valid) {
+            fprintf(stderr, "\nERROR: Invalid record %zu of type %u in the decode capture %s\n",
+                    m_records.size(), recordHeader.type, fileName);
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+        m_records.push_back(record);
+    }
+    if (offset != fileSize) {
+        // The capture of a run that did not end cleanly, the complete records are replayed
+        fprintf(stderr, "\nWARNING: The decode capture %s is truncated after %zu records\n", fileName, m_records.size());
+    }
+
+    return VK_SUCCESS;
+}
+
+int64_t VkVideoDecodeReplay::Run(VkSharedBaseObj<IVulkanVideoDecoderHandler>& decoderHandler)
+{
+    // The sets by their id, each kept until the end of the replay like the parser keeps the ones in use
+    std::vector<VkSharedBaseObj<StdVideoPictureParametersSet>> parameterSets(m_numParameterSets);
+    int64_t numPictures = 0;
+    uint64_t numRejected = 0;
+
+    for (const Record& record : m_records) {
+        const uint8_t* pPayload = &m_fileData[record.payloadOffset];
+        switch (record.type) {
+        case VkVideoDecodeCaptureFormat::RECORD_SEQUENCE: {
+            VkParserDetectedVideoFormat videoFormat;
+            memcpy(&videoFormat, pPayload, sizeof(videoFormat));
+            if (decoderHandler->StartVideoSequence(&videoFormat) <= 0) {
+                fprintf(stderr, "\nERROR: The decoder rejected the sequence of the decode capture\n");
+                return -1;
+            }
+            break;
+        }
+        case VkVideoDecodeCaptureFormat::RECORD_PARAMETERS: {
+            VkSharedBaseObj<VkVideoDecodeReplayParameters> parameterSet;
+            VkResult result = VkVideoDecodeReplayParameters::Create(pPayload, record.payloadSize, parameterSet);
+            if (result != VK_SUCCESS) {
+                fprintf(stderr, "\nERROR: Invalid parameter set in the decode capture, result: 0x%x\n", result);
+                return -1;
+            }
+            VkSharedBaseObj<StdVideoPictureParametersSet> stdParameterSet(parameterSet);
+            if (!decoderHandler->UpdatePictureParameters(stdParameterSet, parameterSet->client)) {
+                numRejected++;
+            }
+            parameterSets[parameterSet->GetId()] = stdParameterSet;
+            break;
+        }
+        case VkVideoDecodeCaptureFormat::RECORD_PICTURE:
+            if (DecodePicture(decoderHandler, record, parameterSets) >= 0) {
+                numPictures++;
+            } else {
+                numRejected++;
+            }
+            break;
+        default:
+            assert(!"Unknown record type");
+            break;
+        }
+    }
+
+    if (numRejected != 0) {
+        fprintf(stderr, "\nWARNING: The decoder rejected %llu calls of the decode capture\n",
+                (unsigned long long)numRejected);
+    }
+    return numPictures;
+}
+
+int32_t VkVideoDecodeReplay::DecodePicture(IVulkanVideoDecoderHandler* pDecoderHandler, const Record& record,
+                                           const std::vector<VkSharedBaseObj<StdVideoPictureParametersSet>>& parameterSets)
+{
+    enum { MAX_SLOTS = VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS + 1 };
+
+    // Copied out of the file data, for the alignment of the structures
+    VkVideoDecodeCaptureFormat::PictureRecord picture;
+    const uint8_t* pPayload = &m_fileData[record.payloadOffset];
+    memcpy(&picture, pPayload, sizeof(picture));
+    pPayload += sizeof(picture);
+    m_sliceOffsets.resize(picture.sliceCount);
+    if (picture.sliceCount != 0) {
+        memcpy(m_sliceOffsets.data(), pPayload, picture.sliceCount * sizeof(uint32_t));
+    }
+    const uint8_t* pBitstreamData = pPayload + picture.sliceCount * sizeof(uint32_t);
+
+    VkParserPerFrameDecodeParameters picParams = VkParserPerFrameDecodeParameters();
+    picParams.currPicIdx = picture.currPicIdx;
+    picParams.pStdVps = (picture.vpsId != VkVideoDecodeCaptureFormat::NO_PARAMETERS) ? parameterSets[picture.vpsId].Get() : nullptr;
+    picParams.pStdSps = (picture.spsId != VkVideoDecodeCaptureFormat::NO_PARAMETERS) ? parameterSets[picture.spsId].Get() : nullptr;
+    picParams.pStdPps = parameterSets[picture.ppsId];
+    picParams.useInlinedPictureParameters = false;
+    picParams.firstSliceIndex = 0;
+    picParams.numSlices = picture.sliceCount;
+    picParams.bitstreamDataOffset = 0;
+    picParams.bitstreamDataLen = picture.bitstreamSize;
+
+    // A buffer of the decoder like the parser gets one, with the data copied at the start
+    const VkDeviceSize sizeAlignment = std::max<VkDeviceSize>(picture.bitstreamSizeAlignment, 1);
+    const VkDeviceSize bufferSize = ((picture.bitstreamSize + sizeAlignment - 1) / sizeAlignment) * sizeAlignment;
+    pDecoderHandler->GetBitstreamBuffer(bufferSize, picture.bitstreamOffsetAlignment, sizeAlignment,
+                                        pBitstreamData, picture.bitstreamSize, picParams.bitstreamData);
+    if (!picParams.bitstreamData || (picParams.bitstreamData->GetMaxSize() < picture.bitstreamSize)) {
+        return -1;
+    }
+
+    VkVideoDecodeH264PictureInfoKHR h264PictureInfo = { VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_PICTURE_INFO_KHR };
+    VkVideoDecodeH265PictureInfoKHR h265PictureInfo = { VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_PICTURE_INFO_KHR };
+    VkVideoDecodeH264DpbSlotInfoKHR h264DpbSlotInfos[MAX_SLOTS];
+    VkVideoDecodeH265DpbSlotInfoKHR h265DpbSlotInfos[MAX_SLOTS];
+    VkVideoReferenceSlotInfoKHR referenceSlots[MAX_SLOTS];
+    if (m_codec == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
+        h264PictureInfo.pStdPictureInfo = &picture.stdPictureInfo.h264;
+        h264PictureInfo.sliceCount = picture.sliceCount;
+        h264PictureInfo.pSliceOffsets = m_sliceOffsets.data();
+        picParams.decodeFrameInfo.pNext = &h264PictureInfo;
+    } else {
+        h265PictureInfo.pStdPictureInfo = &picture.stdPictureInfo.h265;
+        h265PictureInfo.sliceSegmentCount = picture.sliceCount;
+        h265PictureInfo.pSliceSegmentOffsets = m_sliceOffsets.data();
+        picParams.decodeFrameInfo.pNext = &h265PictureInfo;
+    }
+
+    // Slot 0 is the setup slot, the picture resources are filled by the decoder from the frame buffer
+    for (uint32_t slot = 0; slot <= picture.referenceSlotCount; slot++) {
+        referenceSlots[slot] = VkVideoReferenceSlotInfoKHR { VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR };
+        referenceSlots[slot].slotIndex = picture.slotIndexes[slot];
+        referenceSlots[slot].pPictureResource = (slot == 0) ? &picParams.dpbSetupPictureResource :
+                                                              &picParams.pictureResources[slot - 1];
+        if (!picture.hasStdReferenceInfo[slot]) {
+            continue;
+        }
+        if (m_codec == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
+            h264DpbSlotInfos[slot] = VkVideoDecodeH264DpbSlotInfoKHR { VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_DPB_SLOT_INFO_KHR };
+            h264DpbSlotInfos[slot].pStdReferenceInfo = &picture.stdReferenceInfos[slot].h264;
+            referenceSlots[slot].pNext = &h264DpbSlotInfos[slot];
+        } else {
+            h265DpbSlotInfos[slot] = VkVideoDecodeH265DpbSlotInfoKHR { VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_DPB_SLOT_INFO_KHR };
+            h265DpbSlotInfos[slot].pStdReferenceInfo = &picture.stdReferenceInfos[slot].h265;
+            referenceSlots[slot].pNext = &h265DpbSlotInfos[slot];
+        }
+    }
+    for (uint32_t resource = 0; resource < VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS; resource++) {
+        picParams.pictureResources[resource].sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+    }
+    picParams.dpbSetupPictureResource.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+    picParams.decodeFrameInfo.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_INFO_KHR;
+    picParams.decodeFrameInfo.dstPictureResource.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+    picParams.decodeFrameInfo.pSetupReferenceSlot = (picture.slotIndexes[0] >= 0) ? &referenceSlots[0] : nullptr;
+    picParams.decodeFrameInfo.referenceSlotCount = picture.referenceSlotCount;
+    picParams.decodeFrameInfo.pReferenceSlots = (picture.referenceSlotCount != 0) ? &referenceSlots[1] : nullptr;
+    picParams.numGopReferenceSlots = picture.numGopReferenceSlots;
+    memcpy(picParams.pGopReferenceImagesIndexes, picture.gopReferenceImagesIndexes,
+           sizeof(picParams.pGopReferenceImagesIndexes));
+
+    VkParserDecodePictureInfo decodePictureInfo = picture.decodePictureInfo;
+    return pDecoderHandler->DecodePictureWithParameters(&picParams, &decodePictureInfo);
+}
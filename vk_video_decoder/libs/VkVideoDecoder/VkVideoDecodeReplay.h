@@ -0,0 +1,230 @@
+/*
+* Copyright 2024 NVIDIA Corporation.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _VKVIDEODECODER_VKVIDEODECODEREPLAY_H_
+#define _VKVIDEODECODER_VKVIDEODECODEREPLAY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include "vulkan_interfaces.h"
+#include "vkvideo_parser/VulkanVideoParser.h"
+#include "vkvideo_parser/StdVideoPictureParametersSet.h"
+
+// The calls of the parser to the decoder, as recorded by VkVideoDecodeCapture and fed back by VkVideoDecodeReplay.
+// The file starts with a FileHeader, followed by the records in the order of the calls, each a RecordHeader and its
+// payload. The structures are written as they are in memory, a capture is only replayed by a build of the same
+// Vulkan Video std headers on the same architecture, which the header checks.
+struct VkVideoDecodeCaptureFormat {
+    enum { VERSION = 1 };
+    enum { NO_PARAMETERS = ~0U };
+
+    enum RecordType {
+        RECORD_SEQUENCE = 1,   // a VkParserDetectedVideoFormat
+        RECORD_PARAMETERS,     // a ParametersRecord, the std structure of its type and the arrays it points to
+        RECORD_PICTURE,        // a PictureRecord, the slice offsets and the bitstream data
+    };
+
+    struct FileHeader {
+        char     magic[8];             // "VKDECCAP"
+        uint32_t version;
+        uint32_t codec;                // VkVideoCodecOperationFlagBitsKHR
+        uint32_t formatSize;           // sizeof(VkParserDetectedVideoFormat)
+        uint32_t parametersRecordSize; // sizeof(ParametersRecord)
+        uint32_t pictureRecordSize;    // sizeof(PictureRecord)
+        uint32_t reserved;
+    };
+
+    struct RecordHeader {
+        uint32_t type;
+        uint32_t size; // of the payload
+    };
+
+    struct ParametersRecord {
+        uint32_t id;                  // of the set, referenced by the pictures, a set updated gets a new one
+        uint32_t stdType;             // StdVideoPictureParametersSet::StdType
+        uint32_t updateSequenceCount;
+        int32_t  vpsId;
+        int32_t  spsId;
+        int32_t  ppsId;
+        uint8_t  isVps;
+        uint8_t  isSps;
+        uint8_t  isPps;
+        uint8_t  reserved;
+    };
+
+    union StdPictureInfo {
+        StdVideoDecodeH264PictureInfo h264;
+        StdVideoDecodeH265PictureInfo h265;
+    };
+
+    union StdReferenceInfo {
+        StdVideoDecodeH264ReferenceInfo h264;
+        StdVideoDecodeH265ReferenceInfo h265;
+    };
+
+    struct PictureRecord {
+        int32_t                   currPicIdx;
+        uint32_t                  vpsId;   // of the ParametersRecord, NO_PARAMETERS for none
+        uint32_t                  spsId;
+        uint32_t                  ppsId;
+        int32_t                   numGopReferenceSlots;
+        int8_t                    gopReferenceImagesIndexes[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS];
+        int8_t                    reserved[3];
+        uint32_t                  sliceCount;
+        uint32_t                  bitstreamSize;
+        uint32_t                  bitstreamOffsetAlignment;
+        uint32_t                  bitstreamSizeAlignment;
+        uint32_t                  referenceSlotCount;
+        // Slot 0 is the setup slot, followed by the reference slots. A slot index of -1 for no setup slot.
+        int32_t                   slotIndexes[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS + 1];
+        uint8_t                   hasStdReferenceInfo[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS + 1];
+        VkParserDecodePictureInfo decodePictureInfo;
+        StdPictureInfo            stdPictureInfo;
+        StdReferenceInfo          stdReferenceInfos[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS + 1];
+    };
+};
+
+// Forwards the calls of the parser to the decoder and records them to a file: the sequences, the picture parameter
+// sets and the pictures, with their std structures, references, slice offsets and bitstream data. Only the
+// H.264 and H.265 pictures are recorded. The file is closed when the parser releases the capture.
+class VkVideoDecodeCapture : public IVulkanVideoDecoderHandler {
+public:
+
+    static VkResult Create(const char* fileName,
+                           VkVideoCodecOperationFlagBitsKHR codec,
+                           VkSharedBaseObj<IVulkanVideoDecoderHandler>& decoderHandler,
+                           VkSharedBaseObj<IVulkanVideoDecoderHandler>& captureHandler);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the capture if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    virtual int32_t StartVideoSequence(VkParserDetectedVideoFormat* pVideoFormat);
+
+    virtual bool UpdatePictureParameters(VkSharedBaseObj<StdVideoPictureParametersSet>& pictureParametersObject,
+                                         VkSharedBaseObj<VkVideoRefCountBase>& client);
+
+    virtual int32_t DecodePictureWithParameters(VkParserPerFrameDecodeParameters* pPicParams,
+                                                VkParserDecodePictureInfo* pDecodePictureInfo);
+
+    virtual VkDeviceSize GetBitstreamBuffer(VkDeviceSize size,
+                                            VkDeviceSize minBitstreamBufferOffsetAlignment,
+                                            VkDeviceSize minBitstreamBufferSizeAlignment,
+                                            const uint8_t* pInitializeBufferMemory,
+                                            VkDeviceSize initializeBufferMemorySize,
+                                            VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer)
+    {
+        return m_decoderHandler->GetBitstreamBuffer(size, minBitstreamBufferOffsetAlignment,
+                                                    minBitstreamBufferSizeAlignment, pInitializeBufferMemory,
+                                                    initializeBufferMemorySize, bitstreamBuffer);
+    }
+
+private:
+    VkVideoDecodeCapture(FILE* captureFile, VkVideoCodecOperationFlagBitsKHR codec,
+                         VkSharedBaseObj<IVulkanVideoDecoderHandler>& decoderHandler);
+    virtual ~VkVideoDecodeCapture();
+
+    bool WriteRecord(VkVideoDecodeCaptureFormat::RecordType type, const std::vector<uint8_t>& payload);
+    bool WriteParameters(const StdVideoPictureParametersSet* pParameterSet);
+    bool WritePicture(const VkParserPerFrameDecodeParameters* pPicParams,
+                      const VkParserDecodePictureInfo* pDecodePictureInfo);
+    uint32_t GetParametersId(const StdVideoPictureParametersSet* pParameterSet) const;
+
+private:
+    std::atomic<int32_t>                                           m_refCount;
+    FILE*                                                          m_captureFile;
+    const VkVideoCodecOperationFlagBitsKHR                         m_codec;
+    VkSharedBaseObj<IVulkanVideoDecoderHandler>                    m_decoderHandler;
+    std::unordered_map<const StdVideoPictureParametersSet*, uint32_t> m_parametersIds; // of the sets last recorded
+    uint32_t                                                       m_nextParametersId;
+    uint64_t                                                       m_numPictures;
+    uint64_t                                                       m_numPicturesSkipped; // without a recorded set
+    uint64_t                                                       m_bitstreamBytes;
+    bool                                                           m_writeFailed;
+    std::vector<uint8_t>                                           m_payload; // of the record being written
+};
+
+// Loads a file of VkVideoDecodeCapture and feeds its calls to a decoder, without the parser, for the throughput of
+// the decoder alone. The parameter sets are always given out of band. The pictures are decoded in the frame buffer
+// slots they had in the capture, so the decoder must be configured like the one of the capture.
+class VkVideoDecodeReplay : public VkVideoRefCountBase {
+public:
+
+    static VkResult Create(const char* fileName, VkSharedBaseObj<VkVideoDecodeReplay>& decodeReplay);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the replay if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    VkVideoCodecOperationFlagBitsKHR GetCodec() const { return m_codec; }
+    uint64_t GetNumPictures() const { return m_numPictures; }
+    uint64_t GetBitstreamBytes() const { return m_bitstreamBytes; }
+
+    // Makes the calls of the capture to the decoder, in their order. Returns the number of pictures decoded,
+    // negative if the decoder rejected a call. The pictures may still be in flight on return.
+    int64_t Run(VkSharedBaseObj<IVulkanVideoDecoderHandler>& decoderHandler);
+
+private:
+    struct Record {
+        VkVideoDecodeCaptureFormat::RecordType type;
+        size_t                                 payloadOffset; // in m_fileData
+        uint32_t                               payloadSize;
+    };
+
+    VkVideoDecodeReplay();
+    virtual ~VkVideoDecodeReplay() {}
+
+    VkResult Load(const char* fileName);
+    int32_t DecodePicture(IVulkanVideoDecoderHandler* pDecoderHandler, const Record& record,
+                          const std::vector<VkSharedBaseObj<StdVideoPictureParametersSet>>& parameterSets);
+
+private:
+    std::atomic<int32_t>             m_refCount;
+    VkVideoCodecOperationFlagBitsKHR m_codec;
+    std::vector<uint8_t>             m_fileData;  // the whole capture, read ahead of the replay
+    std::vector<Record>              m_records;
+    uint64_t                         m_numPictures;
+    uint64_t                         m_bitstreamBytes;
+    uint32_t                         m_numParameterSets;
+    std::vector<uint32_t>            m_sliceOffsets; // of the picture being decoded, aligned for the decoder
+};
+
+#endif /* _VKVIDEODECODER_VKVIDEODECODEREPLAY_H_ */
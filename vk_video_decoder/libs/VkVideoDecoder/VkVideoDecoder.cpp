@@ -16,10 +16,18 @@
 
 #include <algorithm>
 #include <chrono>
+#include <future>
 #include <iostream>
+#include <utility>
 
 #include "VkVideoCore/VulkanVideoCapabilities.h"
 #include "VkVideoDecoder/VkVideoDecoder.h"
+#include "VkCodecUtils/VulkanVideoSessionPool.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VkFrameLatency.h"
+#include "VkCodecUtils/VkThreadPool.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
 #include "nvidia_utils/vulkan/ycbcrvkinfo.h"
 
 #undef max
@@ -30,6 +38,25 @@
 const uint64_t gFenceTimeout = 100 * 1000 * 1000 /* 100 mSec */;
 const uint64_t gLongTimeout  = 1000 * 1000 * 1000 /* 1000 mSec */;
 
+VkVideoDecoder::DecoderMetrics::DecoderMetrics(const std::string& streamLabels)
+    : labels(streamLabels)
+    , framesDecoded(VkMetrics::GetCounter("vkvideo_decoder_frames_decoded_total",
+                                          "Pictures submitted for decode", labels))
+    , decodePictureUs(VkMetrics::GetHistogram("vkvideo_decoder_decode_picture_us",
+                                              "Host time of recording and submitting a picture, in microseconds", labels))
+    , sequenceChanges(VkMetrics::GetCounter("vkvideo_decoder_sequence_changes_total",
+                                            "Resolution or format changes of the stream", labels))
+    , sessionRecreations(VkMetrics::GetCounter("vkvideo_decoder_session_recreations_total",
+                                               "Video sessions created for a change of the stream", labels))
+    , parametersRecreations(VkMetrics::GetCounter("vkvideo_decoder_parameters_recreations_total",
+                                                  "Session parameters objects recreated for a changed parameter set", labels))
+    , bitstreamBufferAllocations(VkMetrics::GetCounter("vkvideo_decoder_bitstream_buffer_allocations_total",
+                                                       "Bitstream buffers allocated when the pool had none free", labels))
+    , bitstreamBuffersAvailable(VkMetrics::GetGauge("vkvideo_decoder_bitstream_buffers_available",
+                                                    "Bitstream buffers of the pool free for reuse", labels))
+{
+}
+
 const char* VkVideoDecoder::GetVideoCodecString(VkVideoCodecOperationFlagBitsKHR codec)
 {
     static struct {
@@ -75,6 +102,29 @@ const char* VkVideoDecoder::GetVideoChromaFormatString(VkVideoChromaSubsamplingF
     return "Unknown";
 }
 
+bool VkVideoDecoder::IsSameSequence(const VkParserDetectedVideoFormat& a, const VkParserDetectedVideoFormat& b)
+{
+    // The frame rate, the bitrate and the update flags do not change the session or the images
+    return (a.codec == b.codec) &&
+           (a.lumaBitDepth == b.lumaBitDepth) &&
+           (a.chromaBitDepth == b.chromaBitDepth) &&
+           (a.chromaSubsampling == b.chromaSubsampling) &&
+           (a.codecProfile == b.codecProfile) &&
+           (a.progressive_sequence == b.progressive_sequence) &&
+           (a.coded_width == b.coded_width) &&
+           (a.coded_height == b.coded_height) &&
+           (a.display_area.left == b.display_area.left) &&
+           (a.display_area.top == b.display_area.top) &&
+           (a.display_area.right == b.display_area.right) &&
+           (a.display_area.bottom == b.display_area.bottom) &&
+           (a.minNumDecodeSurfaces == b.minNumDecodeSurfaces) &&
+           (a.maxNumDpbSlots == b.maxNumDpbSlots) &&
+           (a.video_signal_description.video_full_range_flag == b.video_signal_description.video_full_range_flag) &&
+           (a.video_signal_description.color_primaries == b.video_signal_description.color_primaries) &&
+           (a.video_signal_description.transfer_characteristics == b.video_signal_description.transfer_characteristics) &&
+           (a.video_signal_description.matrix_coefficients == b.video_signal_description.matrix_coefficients);
+}
+
 /* Callback function to be registered for getting a callback when decoding of
  * sequence starts. Return value from HandleVideoSequence() are interpreted as :
  *  0: fail, 1: suceeded, > 1: override dpb size of parser (set by
@@ -87,6 +137,10 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
     const uint32_t surfaceMinWidthExtent  = 4096;
     const uint32_t surfaceMinHeightExtent = 4096;
 
+    // A new sequence does not continue the field pair of the previous one
+    FlushDecodeSubmitBatch();
+    FlushPendingFirstField();
+
     VkExtent2D codedExtent = { pVideoFormat->coded_width, pVideoFormat->coded_height };
 
     // Width and height of the image surface
@@ -111,6 +165,23 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
               << "\tChroma       : " << GetVideoChromaFormatString(pVideoFormat->chromaSubsampling) << std::endl
               << "\tBit depth    : " << pVideoFormat->bit_depth_luma_minus8 + 8 << std::endl;
 
+    // CreateDecoder() has been called before, and now there's possible config change
+    const bool sequenceChange = (m_videoFormat.coded_width && m_videoFormat.coded_height);
+
+    // The parser starts the sequence again after the end of the stream, e.g. on a loop restart or a seek. The same
+    // sequence keeps the session, the images, the filter and the bitstream buffers as they are, without waiting for
+    // the pictures still in flight: those are ordered before the reset of the session on the decode queue.
+    if (sequenceChange && m_videoSession && IsSameSequence(*pVideoFormat, m_videoFormat)) {
+        std::cout << "Video Decoding Params:" << std::endl
+                  << "\tNum Surfaces : " << m_numDecodeSurfaces << std::endl
+                  << "\tSession      : kept, with its images and buffers, for the same sequence" << std::endl;
+        // The DPB slots of the session still refer to the pictures of the previous sequence
+        m_resetDecoder = true;
+        m_videoFormat = *pVideoFormat;
+        return m_numDecodeSurfaces;
+    }
+
+    const uint32_t prevNumDecodeSurfaces = m_numDecodeSurfaces;
     m_numDecodeSurfaces = std::max(m_numDecodeSurfaces, (pVideoFormat->minNumDecodeSurfaces + m_numDecodeImagesInFlight));
 
     int32_t videoQueueFamily = m_vkDevCtx->GetVideoDecodeQueueFamilyIdx();
@@ -141,19 +212,6 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
         return -1;
     }
 
-    if (m_videoFormat.coded_width && m_videoFormat.coded_height) {
-        // CreateDecoder() has been called before, and now there's possible config change
-        m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::DECODE, m_currentVideoQueueIndx);
-
-        if (*m_vkDevCtx) {
-            m_vkDevCtx->DeviceWaitIdle();
-        }
-    }
-
-    std::cout << "Video Decoding Params:" << std::endl
-              << "\tNum Surfaces : " << m_numDecodeSurfaces << std::endl
-              << "\tResize       : " << codedExtent.width << " x " << codedExtent.height << std::endl;
-
     uint32_t maxDpbSlotCount = pVideoFormat->maxNumDpbSlots;
 
     assert(VK_VIDEO_CHROMA_SUBSAMPLING_MONOCHROME_BIT_KHR == pVideoFormat->chromaSubsampling ||
@@ -186,6 +244,19 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
         return -1;
     }
 
+    // The copy of the post-process filter would only duplicate the decoded picture when the DPB and the output
+    // coincide: the consumers sample the DPB slot instead, which the frame buffer keeps until they release it
+    if (m_decodeFilterRequested) {
+        const bool bypassDecodeFilter = m_dpbAndOutputCoincide &&
+                                        (m_filterType == VulkanFilterYuvCompute::YCBCRCOPY) &&
+                                        (outImageFormat == dpbImageFormat);
+        m_enableDecodeFilter = !bypassDecodeFilter;
+        m_useSeparateOutputImages = m_enableDecodeFilter || m_useLinearOutput || m_exportOutputImages;
+        if (bypassDecodeFilter) {
+            m_yuvFilter = nullptr;
+        }
+    }
+
     imageExtent.width  = std::max(imageExtent.width, videoCapabilities.minCodedExtent.width);
     imageExtent.height = std::max(imageExtent.height, videoCapabilities.minCodedExtent.height);
 
@@ -194,6 +265,23 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
     uint32_t alignHeight = videoCapabilities.pictureAccessGranularity.height - 1;
     imageExtent.height = ((imageExtent.height + alignHeight) & ~alignHeight);
 
+    if (!sequenceChange) {
+        // The admission control of the new stream against the device memory available, most of it is the decode
+        // surfaces. The surfaces of the frames in flight are dropped to fit, down to 4 of them, before the stream fails.
+        const bool separateOutputImages = m_useSeparateOutputImages || !m_dpbAndOutputCoincide;
+        const VkDeviceSize surfaceSize = VulkanDeviceMemoryBudget::EstimateImageSize(dpbImageFormat, imageExtent) +
+                (separateOutputImages ? VulkanDeviceMemoryBudget::EstimateImageSize(outImageFormat, imageExtent) : 0);
+        const uint32_t numDecodeImagesInFlight = m_numDecodeSurfaces - pVideoFormat->minNumDecodeSurfaces;
+        const int32_t admittedImagesInFlight = VulkanDeviceMemoryBudget::Admit(m_vkDevCtx, "decoder",
+                pVideoFormat->minNumDecodeSurfaces * surfaceSize, surfaceSize,
+                std::min<uint32_t>(numDecodeImagesInFlight, 4), numDecodeImagesInFlight);
+        if (admittedImagesInFlight < 0) {
+            fprintf(stderr, "\nERROR: The decoder does not fit in the device memory available\n");
+            return -1;
+        }
+        m_numDecodeSurfaces = pVideoFormat->minNumDecodeSurfaces + (uint32_t)admittedImagesInFlight;
+    }
+
     VkVideoSessionCreateFlagsKHR sessionCreateFlags{};
 
 #ifdef VK_KHR_video_maintenance1
@@ -202,17 +290,91 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
         sessionCreateFlags |= VK_VIDEO_SESSION_CREATE_INLINE_QUERIES_BIT_KHR;
     }
 #endif // VK_KHR_video_maintenance1
-    if (!m_videoSession ||
-            !m_videoSession->IsCompatible( m_vkDevCtx,
-                                           sessionCreateFlags,
-                                           m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
-                                           &videoProfile,
-                                           outImageFormat,
-                                           imageExtent,
-                                           dpbImageFormat,
-                                           maxDpbSlotCount,
-                                           std::max<uint32_t>(maxDpbSlotCount, VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS)) ) {
+    const bool keepVideoSession = m_videoSession &&
+            m_videoSession->IsCompatible( m_vkDevCtx,
+                                          sessionCreateFlags,
+                                          m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                          &videoProfile,
+                                          outImageFormat,
+                                          imageExtent,
+                                          dpbImageFormat,
+                                          maxDpbSlotCount,
+                                          std::min<uint32_t>(maxDpbSlotCount, VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS));
+
+    // The filter depends on the color description and the number of images, not on the extent
+    const bool recreateYuvFilter = m_enableDecodeFilter &&
+            (!m_yuvFilter || !keepVideoSession || (m_numDecodeSurfaces != prevNumDecodeSurfaces) ||
+             (pVideoFormat->video_signal_description.video_full_range_flag !=
+                  m_videoFormat.video_signal_description.video_full_range_flag) ||
+             (pVideoFormat->video_signal_description.color_primaries !=
+                  m_videoFormat.video_signal_description.color_primaries) ||
+             (pVideoFormat->video_signal_description.matrix_coefficients !=
+                  m_videoFormat.video_signal_description.matrix_coefficients) ||
+             (VulkanFilterYuvCompute::IsDeinterlaceFilter(m_filterType) &&
+                  (pVideoFormat->progressive_sequence != m_videoFormat.progressive_sequence)));
+
+    // A resolution change within the extent of the session keeps the session and the filter. The image pool keeps
+    // the images large enough and recreates the others on their next use, so the pictures of the previous sequence
+    // still in flight complete on their own instead of being waited for. The arrays of images are recreated by
+    // InitImagePool(), those still need the idle device.
+    const bool seamlessChange = sequenceChange && keepVideoSession && !recreateYuvFilter &&
+            ((videoCapabilities.flags & VK_VIDEO_CAPABILITY_SEPARATE_REFERENCE_IMAGES_BIT_KHR) != 0);
+    if (sequenceChange && !seamlessChange) {
+        m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::DECODE, m_currentVideoQueueIndx);
+
+        if (*m_vkDevCtx) {
+            m_vkDevCtx->DeviceWaitIdle();
+        }
+    }
+
+    // The filter, with the compilation of its shaders, and the bitstream buffers do not depend on the session or
+    // on the images. They are created on the startup pool while this thread creates those.
+    VkThreadPool startupThreadPool(2);
+    VkSharedBaseObj<VulkanFilter> yuvFilter;
+    std::future<VkResult> yuvFilterResult;
+    if (recreateYuvFilter) {
+        yuvFilterResult = startupThreadPool.enqueue([this, pVideoFormat, dpbImageFormat, outImageFormat, &yuvFilter]() {
+            return CreateYuvFilter(pVideoFormat, dpbImageFormat, outImageFormat, yuvFilter);
+        });
+    }
+    std::future<void> bitstreamBuffersResult = startupThreadPool.enqueue([this, &videoCapabilities]() {
+        PreallocateBitstreamBuffers(videoCapabilities);
+    });
+
+    std::cout << "Video Decoding Params:" << std::endl
+              << "\tNum Surfaces : " << m_numDecodeSurfaces << std::endl
+              << "\tResize       : " << codedExtent.width << " x " << codedExtent.height << std::endl
+              << "\tSession      : " << (keepVideoSession ? "kept" : "new")
+              << (seamlessChange ? ", without waiting for the previous sequence" : "") << std::endl;
+
+    if (sequenceChange) {
+        m_metrics.sequenceChanges.Add();
+        if (!keepVideoSession) {
+            m_metrics.sessionRecreations.Add();
+        }
+    }
 
+    if (keepVideoSession) {
+        // The DPB slots of the session still refer to the pictures of the previous sequence
+        m_resetDecoder = true;
+    } else if (m_vkDevCtx->GetVideoSessionPool() != nullptr) {
+        VulkanVideoSessionPool* pSessionPool = m_vkDevCtx->GetVideoSessionPool();
+        // The device is idle with the previous session here, another decoder may take it
+        pSessionPool->ReturnVideoSession(m_videoSession);
+        result = pSessionPool->GetVideoSession(sessionCreateFlags,
+                                               m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                               &videoProfile,
+                                               outImageFormat,
+                                               imageExtent,
+                                               dpbImageFormat,
+                                               maxDpbSlotCount,
+                                               std::min<uint32_t>(maxDpbSlotCount, VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS),
+                                               m_videoSession);
+
+        // A session of the pool is reset like a new one
+        m_resetDecoder = true;
+        assert(result == VK_SUCCESS);
+    } else {
         result = VulkanVideoSession::Create( m_vkDevCtx,
                                              sessionCreateFlags,
                                              m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
@@ -249,61 +411,6 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
         m_useImageViewArray = true;
     }
 
-    if (m_enableDecodeFilter) {
-
-        const VkSamplerYcbcrRange ycbcrRange = VkVideoCoreProfile::CodecFullRangeToYCbCrRange(
-                pVideoFormat->video_signal_description.video_full_range_flag);
-        const VkSamplerYcbcrModelConversion ycbcrModelConversion = VkVideoCoreProfile::CodecColorPrimariesToYCbCrModel(
-                pVideoFormat->video_signal_description.color_primaries);
-        const YcbcrPrimariesConstants ycbcrPrimariesConstants = VkVideoCoreProfile::CodecGetMatrixCoefficients(
-                pVideoFormat->video_signal_description.matrix_coefficients);
-
-        const VkFormat inputFormat = dpbImageFormat;
-        const VkFormat outputFormat = outImageFormat;
-
-        const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
-                   VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
-                   nullptr,
-                   inputFormat,
-                   ycbcrModelConversion,
-                   ycbcrRange,
-                   { VK_COMPONENT_SWIZZLE_IDENTITY,
-                     VK_COMPONENT_SWIZZLE_IDENTITY,
-                     VK_COMPONENT_SWIZZLE_IDENTITY,
-                     VK_COMPONENT_SWIZZLE_IDENTITY
-                   },
-                   VK_CHROMA_LOCATION_MIDPOINT,
-                   VK_CHROMA_LOCATION_MIDPOINT,
-                   VK_FILTER_LINEAR,
-                   false
-                   };
-
-        static const VkSamplerCreateInfo samplerInfo = {
-                   VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-                   nullptr,
-                   0,
-                   VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
-                   VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-                   // mipLodBias  anisotropyEnable  maxAnisotropy  compareEnable      compareOp         minLod  maxLod          borderColor
-                   // unnormalizedCoordinates
-                   0.0, false, 0.00, false, VK_COMPARE_OP_NEVER, 0.0, 16.0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false
-        };
-
-        result = VulkanFilterYuvCompute::Create(m_vkDevCtx,
-                                                m_vkDevCtx->GetComputeQueueFamilyIdx(),
-                                                0,
-                                                m_filterType,
-                                                m_numDecodeSurfaces,
-                                                inputFormat,
-                                                outputFormat,
-                                                &ycbcrConversionCreateInfo,
-                                                &ycbcrPrimariesConstants,
-                                                &samplerInfo,
-                                                m_yuvFilter);
-        assert(result == VK_SUCCESS);
-
-    }
-
     int32_t ret = m_videoFrameBuffer->InitImagePool(videoProfile.GetProfile(),
                                                     m_numDecodeSurfaces,
                                                     dpbImageFormat,
@@ -315,7 +422,9 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
                                                     m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
                                                     m_numDecodeImagesToPreallocate,
                                                     m_useImageArray, m_useImageViewArray,
-                                                    m_useSeparateOutputImages, m_useLinearOutput);
+                                                    m_useSeparateOutputImages, m_useLinearOutput,
+                                                    m_exportOutputImages ?
+                                                        (VkExternalMemoryHandleTypeFlags)VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT : 0);
 
     assert((uint32_t)ret == m_numDecodeSurfaces);
     if ((uint32_t)ret != m_numDecodeSurfaces) {
@@ -331,8 +440,109 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
     m_maxDecodeFramesCount = m_numDecodeSurfaces;
 
     // There will be no more than 32 frames in the queue.
-    m_decodeFramesData.resize(std::max<uint32_t>(m_maxDecodeFramesCount, 32));
+    // The second fields get their own command buffers, the first field one may still be pending.
+    const uint32_t commandBuffersPerFrame = (m_fieldPairSemaphore != VK_NULL_HANDLE) ? 2 : 1;
+    m_decodeFramesData.resize(std::max<uint32_t>(m_maxDecodeFramesCount, 32) * commandBuffersPerFrame);
+
+    if (m_enableGpuTimestamps) {
+        VkResult timestampsResult = VK_SUCCESS;
+        if (!m_gpuTimestamps) {
+            timestampsResult = VulkanVideoGpuTimestamps::Create(m_vkDevCtx, m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                                                (uint32_t)m_decodeFramesData.size(), "Decode",
+                                                                m_gpuTimestampsCsvFileName.c_str(), m_gpuTimestamps);
+        } else {
+            timestampsResult = m_gpuTimestamps->SetNumSlots((uint32_t)m_decodeFramesData.size());
+        }
+        if (timestampsResult != VK_SUCCESS) {
+            fprintf(stderr, "\nWARNING: GPU timestamps are not available on the decode queue (%d)\n", timestampsResult);
+            m_gpuTimestamps = nullptr;
+            m_enableGpuTimestamps = false;
+        }
+    }
+
+    if (m_deviceLocalBitstream && (m_deviceBitstreamBuffers.size() < m_decodeFramesData.size())) {
+        VkResult uploadResult = InitBitstreamUpload((uint32_t)m_decodeFramesData.size());
+        if (uploadResult != VK_SUCCESS) {
+            fprintf(stderr, "\nWARNING: The bitstream can't be uploaded on the transfer queue (%d), "
+                            "decoding from the host visible buffers\n", uploadResult);
+            m_deviceLocalBitstream = false;
+        }
+    }
+
+    // The image pool and the command buffers are ready, the filter and the bitstream buffers are joined before the
+    // first picture is decoded
+    if (yuvFilterResult.valid()) {
+        if (yuvFilterResult.get() == VK_SUCCESS) {
+            m_yuvFilter = yuvFilter;
+        }
+    }
+    bitstreamBuffersResult.get();
 
+    // Save the original config
+    m_videoFormat = *pVideoFormat;
+    return m_numDecodeSurfaces;
+}
+
+VkResult VkVideoDecoder::CreateYuvFilter(const VkParserDetectedVideoFormat* pVideoFormat, VkFormat inputFormat,
+                                         VkFormat outputFormat, VkSharedBaseObj<VulkanFilter>& yuvFilter)
+{
+    const VkSamplerYcbcrRange ycbcrRange = VkVideoCoreProfile::CodecFullRangeToYCbCrRange(
+            pVideoFormat->video_signal_description.video_full_range_flag);
+    const VkSamplerYcbcrModelConversion ycbcrModelConversion = VkVideoCoreProfile::CodecColorPrimariesToYCbCrModel(
+            pVideoFormat->video_signal_description.color_primaries);
+    const YcbcrPrimariesConstants ycbcrPrimariesConstants = VkVideoCoreProfile::CodecGetMatrixCoefficients(
+            pVideoFormat->video_signal_description.matrix_coefficients);
+
+    const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
+               VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+               nullptr,
+               inputFormat,
+               ycbcrModelConversion,
+               ycbcrRange,
+               { VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY,
+                 VK_COMPONENT_SWIZZLE_IDENTITY
+               },
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_CHROMA_LOCATION_MIDPOINT,
+               VK_FILTER_LINEAR,
+               false
+               };
+
+    static const VkSamplerCreateInfo samplerInfo = {
+               VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+               nullptr,
+               0,
+               VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+               VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+               // mipLodBias  anisotropyEnable  maxAnisotropy  compareEnable      compareOp         minLod  maxLod          borderColor
+               // unnormalizedCoordinates
+               0.0, false, 0.00, false, VK_COMPARE_OP_NEVER, 0.0, 16.0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false
+    };
+
+    // The frames of the progressive sequences have no fields to deinterlace, they are only copied
+    const VulkanFilterYuvCompute::FilterType filterType =
+            (VulkanFilterYuvCompute::IsDeinterlaceFilter(m_filterType) && pVideoFormat->progressive_sequence) ?
+                    VulkanFilterYuvCompute::YCBCRCOPY : m_filterType;
+
+    VkResult result = VulkanFilterYuvCompute::Create(m_vkDevCtx,
+                                                     m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                                     0,
+                                                     filterType,
+                                                     m_numDecodeSurfaces,
+                                                     inputFormat,
+                                                     outputFormat,
+                                                     &ycbcrConversionCreateInfo,
+                                                     &ycbcrPrimariesConstants,
+                                                     &samplerInfo,
+                                                     yuvFilter);
+    assert(result == VK_SUCCESS);
+    return result;
+}
+
+void VkVideoDecoder::PreallocateBitstreamBuffers(const VkVideoCapabilitiesKHR& videoCapabilities)
+{
     int32_t availableBuffers = (int32_t)m_decodeFramesData.GetBitstreamBuffersQueue().
                                                       GetAvailableNodesNumber();
     if (availableBuffers < m_numBitstreamBuffersToPreallocate) {
@@ -341,15 +551,17 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
                 m_decodeFramesData.GetBitstreamBuffersQueue().GetMaxNodes(),
                 (m_numBitstreamBuffersToPreallocate - availableBuffers));
 
+        const VkDeviceSize allocSize = NvVkDecodeFrameData::VulkanBitstreamBufferPool::GetAllocationSize(
+                std::max<VkDeviceSize>(m_maxStreamBufferSize, 2 * 1024 * 1024));
+
         allocateNumBuffers = std::min<uint32_t>(allocateNumBuffers,
-                m_decodeFramesData.GetBitstreamBuffersQueue().GetFreeNodesNumber());
+                m_decodeFramesData.GetBitstreamBuffersQueue().GetFreeNodesNumber(allocSize));
 
         for (uint32_t i = 0; i < allocateNumBuffers; i++) {
 
             VkSharedBaseObj<VulkanBitstreamBufferImpl> bitstreamBuffer;
-            VkDeviceSize allocSize = std::max<VkDeviceSize>(m_maxStreamBufferSize, 2 * 1024 * 1024);
 
-            result = VulkanBitstreamBufferImpl::Create(m_vkDevCtx,
+            VkResult result = VulkanBitstreamBufferImpl::Create(m_vkDevCtx,
                     m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
                     allocSize,
                     videoCapabilities.minBitstreamBufferOffsetAlignment,
@@ -369,20 +581,25 @@ int32_t VkVideoDecoder::StartVideoSequence(VkParserDetectedVideoFormat* pVideoFo
             }
         }
     }
-
-    // Save the original config
-    m_videoFormat = *pVideoFormat;
-    return m_numDecodeSurfaces;
 }
 
 bool VkVideoDecoder::UpdatePictureParameters(VkSharedBaseObj<StdVideoPictureParametersSet>& pictureParametersObject,
                                              VkSharedBaseObj<VkVideoRefCountBase>& client)
 {
+    const uint32_t recreationCount = GetPictureParametersRecreationCount();
     VkResult result = VkParserVideoPictureParameters::AddPictureParameters(m_vkDevCtx,
                                                                            m_videoSession,
                                                                            pictureParametersObject,
                                                                            m_currentPictureParameters);
 
+    if (GetPictureParametersRecreationCount() != recreationCount) {
+        m_metrics.parametersRecreations.Add(GetPictureParametersRecreationCount() - recreationCount);
+    }
+    if (m_dumpDecodeData && (GetPictureParametersRecreationCount() != recreationCount)) {
+        std::cout << "\tRecreated the session parameters object, " << GetPictureParametersRecreationCount()
+                  << " recreations in the stream" << std::endl;
+    }
+
     client = m_currentPictureParameters;
     return (result == VK_SUCCESS);
 }
@@ -452,6 +669,102 @@ int VkVideoDecoder::CopyOptimalToLinearImage(VkCommandBuffer& commandBuffer,
     return 0;
 }
 
+bool VkVideoDecoder::CanFillGrayReferences()
+{
+    // The separate DPB images only have the video usage, and the copies need a decode queue with transfers
+    if (m_dpbAndOutputCoincide && ((m_vkDevCtx->GetVideoDecodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) != 0)) {
+        return true;
+    }
+    if (!m_grayReferenceWarned) {
+        std::cout << "\t WARNING: The missing references can't be filled with gray on this decode queue" << std::endl;
+        m_grayReferenceWarned = true;
+    }
+    return false;
+}
+
+void VkVideoDecoder::RecordGrayReferences(VkCommandBuffer commandBuffer,
+                                          const VkVideoPictureResourceInfoKHR* pPictureResources,
+                                          const VulkanVideoFrameBuffer::PictureResourceInfo* pPictureResourcesInfo,
+                                          const int32_t* pReferenceIds, uint32_t numReferences)
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(pPictureResourcesInfo[pReferenceIds[0]].imageFormat);
+    const VkExtent2D codedExtent = pPictureResources[pReferenceIds[0]].codedExtent;
+    const VkDeviceSize bytesPerSample = (mpInfo->planesLayout.bpp == YCBCRA_8BPP) ? 1 : 2;
+    // The largest plane is the luma one, or the interleaved CbCr one of 4:4:4
+    const VkDeviceSize grayBufferSize = 2 * bytesPerSample * codedExtent.width * codedExtent.height;
+
+    if (!m_grayReferenceBuffer || (m_grayReferenceBuffer->GetMaxSize() < grayBufferSize)) {
+        m_grayReferenceBuffer = nullptr;
+        VkResult result = VkBufferResource::Create(m_vkDevCtx, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                   grayBufferSize, m_grayReferenceBuffer);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: VkBufferResource::Create() of the gray references result: 0x%x\n", result);
+            return;
+        }
+        VkDeviceSize maxSize = 0;
+        uint8_t* pGray = m_grayReferenceBuffer->GetDataPtr(0, maxSize);
+        if (bytesPerSample == 1) {
+            memset(pGray, 0x80, (size_t)grayBufferSize);
+        } else {
+            // The high bits hold the samples of the 10 and 12-bit formats
+            uint16_t* pGray16 = (uint16_t*)pGray;
+            for (VkDeviceSize i = 0; i < (grayBufferSize / 2); i++) {
+                pGray16[i] = 0x8000;
+            }
+        }
+    }
+
+    VkImageMemoryBarrier2KHR imageBarriers[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS];
+    for (uint32_t i = 0; i < numReferences; i++) {
+        const int32_t resId = pReferenceIds[i];
+        imageBarriers[i] = VkImageMemoryBarrier2KHR();
+        imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        imageBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+        imageBarriers[i].dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+        imageBarriers[i].dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+        imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarriers[i].image = pPictureResourcesInfo[resId].image;
+        imageBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBarriers[i].subresourceRange.levelCount = 1;
+        imageBarriers[i].subresourceRange.baseArrayLayer = pPictureResources[resId].baseArrayLayer;
+        imageBarriers[i].subresourceRange.layerCount = 1;
+    }
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.imageMemoryBarrierCount = numReferences;
+    dependencyInfo.pImageMemoryBarriers = imageBarriers;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+
+    // Both planes read the same samples from the start of the buffer, tightly packed
+    VkBufferImageCopy copyRegions[2];
+    memset(copyRegions, 0, sizeof(copyRegions));
+    copyRegions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+    copyRegions[0].imageSubresource.layerCount = 1;
+    copyRegions[0].imageExtent.width = codedExtent.width;
+    copyRegions[0].imageExtent.height = codedExtent.height;
+    copyRegions[0].imageExtent.depth = 1;
+    copyRegions[1] = copyRegions[0];
+    copyRegions[1].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) {
+        copyRegions[1].imageExtent.width = (codedExtent.width + 1) / 2;
+    }
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) {
+        copyRegions[1].imageExtent.height = (codedExtent.height + 1) / 2;
+    }
+    for (uint32_t i = 0; i < numReferences; i++) {
+        const int32_t resId = pReferenceIds[i];
+        copyRegions[0].imageSubresource.baseArrayLayer = pPictureResources[resId].baseArrayLayer;
+        copyRegions[1].imageSubresource.baseArrayLayer = pPictureResources[resId].baseArrayLayer;
+        m_vkDevCtx->CmdCopyBufferToImage(commandBuffer, m_grayReferenceBuffer->GetBuffer(),
+                                         pPictureResourcesInfo[resId].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                         2, copyRegions);
+    }
+    m_numGrayReferences += numReferences;
+}
+
 /* Callback function to be registered for getting a callback when a decoded
  * frame is ready to be decoded. Return value from HandlePictureDecode() are
  * interpreted as: 0: fail, >=1: suceeded
@@ -464,14 +777,19 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         return -1;
     }
 
+    VK_TRACE_ZONE_FRAME("DecodePicture", m_decodePicCount);
+    VkMetricScopedTimer decodePictureTimer(m_metrics.decodePictureUs);
     int32_t currPicIdx = pPicParams->currPicIdx;
     assert((uint32_t)currPicIdx < m_numDecodeSurfaces);
 
     int32_t picNumInDecodeOrder = (int32_t)(uint32_t)m_decodePicCount;
     if (m_dumpDecodeData) {
-        std::cout << "currPicIdx: " << currPicIdx << ", currentVideoQueueIndx: " << m_currentVideoQueueIndx << ", decodePicCount: " << m_decodePicCount << std::endl;
+        VK_LOG_DEBUG("currPicIdx: %d, currentVideoQueueIndx: %d, decodePicCount: %llu\n",
+                     currPicIdx, m_currentVideoQueueIndx, (unsigned long long)m_decodePicCount);
     }
     m_videoFrameBuffer->SetPicNumInDecodeOrder(currPicIdx, picNumInDecodeOrder);
+    VkFrameLatency::RecordDemuxed((uint64_t)picNumInDecodeOrder);
+    VkFrameLatency::Record(VK_FRAME_LATENCY_PARSED, (uint64_t)picNumInDecodeOrder);
 
     NvVkDecodeFrameDataSlot frameDataSlot;
     int32_t retPicIdx = GetCurrentFrameData((uint32_t)currPicIdx, frameDataSlot);
@@ -486,8 +804,11 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
     pPicParams->decodeFrameInfo.srcBuffer = pPicParams->bitstreamData->GetBuffer();
     assert(pPicParams->bitstreamDataOffset == 0);
     assert(pPicParams->firstSliceIndex == 0);
-    pPicParams->decodeFrameInfo.srcBufferOffset = pPicParams->bitstreamDataOffset;
-    pPicParams->decodeFrameInfo.srcBufferRange = pPicParams->bitstreamDataLen;
+    // Non-zero for buffers referencing the input in place, the slice offsets are relative to that range
+    pPicParams->decodeFrameInfo.srcBufferOffset = pPicParams->bitstreamData->GetBufferOffset() +
+                                                  pPicParams->bitstreamDataOffset;
+    pPicParams->decodeFrameInfo.srcBufferRange = pPicParams->bitstreamData->GetDataOffset() +
+                                                 pPicParams->bitstreamDataLen;
     // pPicParams->decodeFrameInfo.dstImageView = VkImageView();
 
     VkVideoBeginCodingInfoKHR decodeBeginInfo = { VK_STRUCTURE_TYPE_VIDEO_BEGIN_CODING_INFO_KHR };
@@ -496,7 +817,7 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
     decodeBeginInfo.videoSession = m_videoSession->GetVideoSession();
 
     assert(pPicParams->decodeFrameInfo.srcBuffer);
-    const VkBufferMemoryBarrier2KHR bitstreamBufferMemoryBarrier = {
+    VkBufferMemoryBarrier2KHR bitstreamBufferMemoryBarrier = {
         VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
         nullptr,
         VK_PIPELINE_STAGE_2_NONE_KHR,
@@ -548,7 +869,7 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         // Output Distinct will use the decodeFrameInfo.dstPictureResource directly.
         pOutputPictureResource = &pPicParams->decodeFrameInfo.dstPictureResource;
 
-    } else if (m_useLinearOutput || m_enableDecodeFilter) {
+    } else if (m_useLinearOutput || m_enableDecodeFilter || m_exportOutputImages) {
 
         // Output Coincide needs the output only if we are processing linear images that we need to copy to below.
         pOutputPictureResource = &currentOutputPictureResource;
@@ -562,14 +883,22 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
 
     }
 
-    if (pPicParams->currPicIdx !=
-            m_videoFrameBuffer->GetCurrentImageResourceByIndex(pPicParams->currPicIdx,
-                                                               &pPicParams->dpbSetupPictureResource,
-                                                               &currentDpbPictureResourceInfo,
-                                                               VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR,
-                                                               pOutputPictureResource,
-                                                               pOutputPictureResourceInfo,
-                                                               VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR)) {
+    // The setup picture and all of the references are looked up with a single frame buffer call
+    VulkanVideoFrameBuffer::PictureResourceInfo pictureResourcesInfo[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS];
+    memset(&pictureResourcesInfo[0], 0, sizeof(pictureResourcesInfo));
+    const int8_t* pGopReferenceImagesIndexes = pPicParams->pGopReferenceImagesIndexes;
+    if (pPicParams->numGopReferenceSlots !=
+            m_videoFrameBuffer->GetCurrentAndDpbImageResourcesByIndex(pPicParams->currPicIdx,
+                                                                      &pPicParams->dpbSetupPictureResource,
+                                                                      &currentDpbPictureResourceInfo,
+                                                                      pOutputPictureResource,
+                                                                      pOutputPictureResourceInfo,
+                                                                      pPicParams->numGopReferenceSlots,
+                                                                      pGopReferenceImagesIndexes,
+                                                                      pPicParams->pictureResources,
+                                                                      pictureResourcesInfo,
+                                                                      VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR,
+                                                                      VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR)) {
 
         assert(!"GetImageResourcesByIndex has failed");
     }
@@ -607,18 +936,10 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         numDpbBarriers++;
     }
 
-    VulkanVideoFrameBuffer::PictureResourceInfo pictureResourcesInfo[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS];
-    memset(&pictureResourcesInfo[0], 0, sizeof(pictureResourcesInfo));
-    const int8_t* pGopReferenceImagesIndexes = pPicParams->pGopReferenceImagesIndexes;
+    // The references still in the undefined layout were never decoded, they stand in for the lost ones
+    int32_t grayReferenceIds[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS];
+    uint32_t numGrayReferences = 0;
     if (pPicParams->numGopReferenceSlots) {
-        if (pPicParams->numGopReferenceSlots != m_videoFrameBuffer->GetDpbImageResourcesByIndex(
-                                                                        pPicParams->numGopReferenceSlots,
-                                                                        pGopReferenceImagesIndexes,
-                                                                        pPicParams->pictureResources,
-                                                                        pictureResourcesInfo,
-                                                                        VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR)) {
-            assert(!"GetImageResourcesByIndex has failed");
-        }
         for (int32_t resId = 0; resId < pPicParams->numGopReferenceSlots; resId++) {
             // slotLayer requires NVIDIA specific extension VK_KHR_video_layers, not enabled, just yet.
             // pGopReferenceSlots[resId].slotLayerIndex = 0;
@@ -628,6 +949,14 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
                 imageBarriers[numDpbBarriers].oldLayout = pictureResourcesInfo[resId].currentImageLayout;
                 imageBarriers[numDpbBarriers].newLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR;
                 imageBarriers[numDpbBarriers].image = pictureResourcesInfo[resId].image;
+                if (m_errorResilient && (pictureResourcesInfo[resId].currentImageLayout == VK_IMAGE_LAYOUT_UNDEFINED) &&
+                        CanFillGrayReferences()) {
+                    grayReferenceIds[numGrayReferences++] = resId;
+                    imageBarriers[numDpbBarriers].srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+                    imageBarriers[numDpbBarriers].srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+                    imageBarriers[numDpbBarriers].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                    imageBarriers[numDpbBarriers].subresourceRange.baseArrayLayer = pPicParams->pictureResources[resId].baseArrayLayer;
+                }
                 assert(imageBarriers[numDpbBarriers].image);
                 numDpbBarriers++;
             }
@@ -644,18 +973,33 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
     // FIXME: the below sequence for interlaced synchronization.
     pDecodePictureInfo->flags.syncToFirstField = false;
 
+    // With the field pair semaphore, the first field of a frame leaves the frame complete fence and semaphore
+    // to its second field, so the second field must neither wait on, nor reset, the fence of the picture.
+    const bool deferFrameComplete = (m_fieldPairSemaphore != VK_NULL_HANDLE) &&
+                                    pDecodePictureInfo->flags.fieldPic && !pDecodePictureInfo->flags.secondField;
+    const bool pairWithFirstField = (m_fieldPairSemaphore != VK_NULL_HANDLE) &&
+                                    pDecodePictureInfo->flags.fieldPic && pDecodePictureInfo->flags.secondField &&
+                                    (m_pendingFirstField.pictureIndex == currPicIdx);
+    if (!pairWithFirstField) {
+        // A batched picture must be submitted before its fence is waited on again
+        FlushDecodeSubmitBatch(currPicIdx);
+        // The pending first field, if any, is not going to get its pair
+        FlushPendingFirstField();
+    } else {
+        GetCurrentFrameData((uint32_t)(currPicIdx + (m_decodeFramesData.size() / 2)), frameDataSlot);
+    }
+
     VulkanVideoFrameBuffer::FrameSynchronizationInfo frameSynchronizationInfo = VulkanVideoFrameBuffer::FrameSynchronizationInfo();
     frameSynchronizationInfo.hasFrameCompleteSignalFence = true;
     frameSynchronizationInfo.hasFrameCompleteSignalSemaphore = true;
-    frameSynchronizationInfo.syncOnFrameCompleteFence = true;
+    frameSynchronizationInfo.syncOnFrameCompleteFence = !pairWithFirstField;
     frameSynchronizationInfo.syncOnFrameConsumerDoneFence = true;
 
     if (pPicParams->useInlinedPictureParameters == false) {
-        // out of band parameters
-        VkSharedBaseObj<VkVideoRefCountBase> currentVkPictureParameters;
-        bool valid = pPicParams->pStdPps->GetClientObject(currentVkPictureParameters);
-        assert(currentVkPictureParameters && valid);
-        if (!(currentVkPictureParameters && valid)) {
+        // out of band parameters, kept alive by the PPS of the picture for the duration of the call
+        VkVideoRefCountBase* currentVkPictureParameters = pPicParams->pStdPps->GetClientObjectPtr();
+        assert(currentVkPictureParameters);
+        if (currentVkPictureParameters == nullptr) {
             return -1;
         }
         VkParserVideoPictureParameters* pOwnerPictureParameters =
@@ -700,11 +1044,25 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         assert(!"QueuePictureForDecode has failed");
     }
 
+    // The frame buffer only keeps the bitstream of the last field, the first one must stay
+    // alive until the picture fence is waited on again.
+    if (!pairWithFirstField && ((uint32_t)currPicIdx < m_firstFieldBitstreamData.size())) {
+        m_firstFieldBitstreamData[currPicIdx] = nullptr;
+    }
+    if (deferFrameComplete) {
+        if ((uint32_t)currPicIdx >= m_firstFieldBitstreamData.size()) {
+            m_firstFieldBitstreamData.resize(currPicIdx + 1);
+        }
+        // Not used past this point, the reference of the parser moves over
+        m_firstFieldBitstreamData[currPicIdx] = std::move(pPicParams->bitstreamData);
+    }
+
     assert(VK_NOT_READY == m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, frameSynchronizationInfo.frameCompleteFence));
 
     VkFence frameCompleteFence = frameSynchronizationInfo.frameCompleteFence;
     VkSemaphore frameCompleteSemaphore = frameSynchronizationInfo.frameCompleteSemaphore;
     VkSemaphore frameConsumerDoneSemaphore = frameSynchronizationInfo.frameConsumerDoneSemaphore;
+    VkSemaphore frameConsumerDoneTimelineSemaphore = frameSynchronizationInfo.frameConsumerDoneTimelineSemaphore;
     // By default, the frameCompleteSemaphore is the videoDecodeCompleteSemaphore.
     // If the video frame filter is enabled, since it is executed after the decoder's queue,
     // the filter will provide its own semaphore for the video decoder to signal, instead.
@@ -713,27 +1071,68 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
     VkSemaphore videoDecodeCompleteSemaphore = frameCompleteSemaphore;
 
 
-    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    beginInfo.pInheritanceInfo = nullptr;
+    // From the command buffer slot of the picture, the second field has its own. The previous decode of the slot
+    // is complete, so is its read of the device-local copy.
+    const VkSemaphore bitstreamUploadSemaphore = m_deviceLocalBitstream ?
+            UploadBitstream(frameDataSlot.slot, pPicParams->decodeFrameInfo,
+                            pPicParams->bitstreamData->GetOffsetAlignment(),
+                            pPicParams->bitstreamData->GetSizeAlignment()) : VK_NULL_HANDLE;
+    if (bitstreamUploadSemaphore != VK_NULL_HANDLE) {
+        // Written on the transfer queue, ordered by the semaphore
+        bitstreamBufferMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+        bitstreamBufferMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE_KHR;
+        bitstreamBufferMemoryBarrier.buffer = pPicParams->decodeFrameInfo.srcBuffer;
+        bitstreamBufferMemoryBarrier.offset = pPicParams->decodeFrameInfo.srcBufferOffset;
+    }
 
-    m_vkDevCtx->BeginCommandBuffer(frameDataSlot.commandBuffer, &beginInfo);
+    // With the command batches of the device, the picture is recorded after those of the other decoders on the
+    // queue, into the command buffer they are submitted with. Not with the queue selected after the recording,
+    // the post-process filter, the field pairs ordered by their semaphore, the submit batches of this decoder, or
+    // the wait on the timeline semaphore of the consumer, the batches having no semaphore values.
+    VulkanVideoDecodeCommandBatch* pCommandBatch = ((m_hwLoadBalancingNumQueues > 0) || m_enableDecodeFilter ||
+                                                    (m_submitBatchSize > 1) || deferFrameComplete || pairWithFirstField ||
+                                                    (frameConsumerDoneTimelineSemaphore != VK_NULL_HANDLE)) ?
+            nullptr : m_vkDevCtx->GetVideoDecodeCommandBatch(m_currentVideoQueueIndx);
+    VkCommandBuffer commandBuffer = (pCommandBatch != nullptr) ? pCommandBatch->BeginPicture() : VK_NULL_HANDLE;
+    if (commandBuffer == VK_NULL_HANDLE) {
+        pCommandBatch = nullptr;
+        // After the pictures of this decoder still pending in a command batch
+        FlushDecodeCommandBatch();
+
+        commandBuffer = frameDataSlot.commandBuffer;
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = nullptr;
+
+        m_vkDevCtx->BeginCommandBuffer(commandBuffer, &beginInfo);
+    }
 
     if (frameSynchronizationInfo.queryPool) {
-        m_vkDevCtx->CmdResetQueryPool(frameDataSlot.commandBuffer, frameSynchronizationInfo.queryPool,
+        m_vkDevCtx->CmdResetQueryPool(commandBuffer, frameSynchronizationInfo.queryPool,
                                       frameSynchronizationInfo.startQueryId, frameSynchronizationInfo.numQueries);
     }
 
-    m_vkDevCtx->CmdBeginVideoCodingKHR(frameDataSlot.commandBuffer, &decodeBeginInfo);
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->CmdResetSlot(commandBuffer, frameDataSlot.slot);
+    }
 
+    // Outside of the video coding scope, the copies are transitioned to the DPB layout with the barriers below
+    if (numGrayReferences > 0) {
+        RecordGrayReferences(commandBuffer, pPicParams->pictureResources, pictureResourcesInfo,
+                             grayReferenceIds, numGrayReferences);
+    }
+
+    m_vkDevCtx->CmdBeginVideoCodingKHR(commandBuffer, &decodeBeginInfo);
+
+    const bool resetsDecoder = (m_resetDecoder != false);
     if (m_resetDecoder != false) {
         VkVideoCodingControlInfoKHR codingControlInfo = { VK_STRUCTURE_TYPE_VIDEO_CODING_CONTROL_INFO_KHR,
                                                           nullptr,
                                                           VK_VIDEO_CODING_CONTROL_RESET_BIT_KHR };
 
         // Video spec requires mandatory codec reset before the first frame.
-        m_vkDevCtx->CmdControlVideoCodingKHR(frameDataSlot.commandBuffer, &codingControlInfo);
+        m_vkDevCtx->CmdControlVideoCodingKHR(commandBuffer, &codingControlInfo);
         // Done with the reset
         m_resetDecoder = false;
     }
@@ -749,7 +1148,7 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         numDpbBarriers,
         imageBarriers,
     };
-    m_vkDevCtx->CmdPipelineBarrier2KHR(frameDataSlot.commandBuffer, &dependencyInfo);
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
 
 #ifdef VK_KHR_video_maintenance1
     VkVideoInlineQueryInfoKHR inlineQueryInfo { VK_STRUCTURE_TYPE_VIDEO_INLINE_QUERY_INFO_KHR,
@@ -768,23 +1167,31 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         } else
 #endif // VK_KHR_video_maintenance1
         {
-            m_vkDevCtx->CmdBeginQuery(frameDataSlot.commandBuffer, frameSynchronizationInfo.queryPool,
+            m_vkDevCtx->CmdBeginQuery(commandBuffer, frameSynchronizationInfo.queryPool,
                                       frameSynchronizationInfo.startQueryId, VkQueryControlFlags());
         }
     }
 
-    m_vkDevCtx->CmdDecodeVideoKHR(frameDataSlot.commandBuffer, &pPicParams->decodeFrameInfo);
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->CmdWriteBegin(commandBuffer, frameDataSlot.slot);
+    }
+
+    m_vkDevCtx->CmdDecodeVideoKHR(commandBuffer, &pPicParams->decodeFrameInfo);
+
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->CmdWriteEnd(commandBuffer, frameDataSlot.slot);
+    }
 
     if ((frameSynchronizationInfo.queryPool != VK_NULL_HANDLE) && (m_videoMaintenance1FeaturesSupported == 0)) {
-        m_vkDevCtx->CmdEndQuery(frameDataSlot.commandBuffer, frameSynchronizationInfo.queryPool,
+        m_vkDevCtx->CmdEndQuery(commandBuffer, frameSynchronizationInfo.queryPool,
                                 frameSynchronizationInfo.startQueryId);
     }
 
     VkVideoEndCodingInfoKHR decodeEndInfo = { VK_STRUCTURE_TYPE_VIDEO_END_CODING_INFO_KHR };
-    m_vkDevCtx->CmdEndVideoCodingKHR(frameDataSlot.commandBuffer, &decodeEndInfo);
+    m_vkDevCtx->CmdEndVideoCodingKHR(commandBuffer, &decodeEndInfo);
 
     if (m_dpbAndOutputCoincide && !m_enableDecodeFilter && (m_useSeparateOutputImages || m_useLinearOutput)) {
-        CopyOptimalToLinearImage(frameDataSlot.commandBuffer,
+        CopyOptimalToLinearImage(commandBuffer,
                                  pPicParams->decodeFrameInfo.dstPictureResource,
                                  currentDpbPictureResourceInfo,
                                  *pOutputPictureResource,
@@ -792,7 +1199,9 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
                                  &frameSynchronizationInfo);
     }
 
-    m_vkDevCtx->EndCommandBuffer(frameDataSlot.commandBuffer);
+    if (pCommandBatch == nullptr) {
+        m_vkDevCtx->EndCommandBuffer(commandBuffer);
+    }
 
     if (m_enableDecodeFilter) {
 
@@ -800,54 +1209,102 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         // The videoDecodeCompleteSemaphore semaphore will be signaled by the decoder and then used by the filter to wait on.
         videoDecodeCompleteFence     = m_yuvFilter->GetFilterSignalFence(currPicIdx);
         videoDecodeCompleteSemaphore = m_yuvFilter->GetFilterWaitSemaphore(currPicIdx);
+        if (!pairWithFirstField) {
+            // The frame complete fence waited on above was signaled by the filter of the previous decode of the
+            // picture, after that decode signaled this fence: it is signaled and no longer in use.
+            VkResult resetResult = m_vkDevCtx->ResetFences(*m_vkDevCtx, 1, &videoDecodeCompleteFence);
+            assert(resetResult == VK_SUCCESS);
+            (void)resetResult;
+        }
     }
 
-    const uint32_t waitSemaphoreMaxCount = 3;
+    const uint32_t waitSemaphoreMaxCount = MAX_DECODE_WAIT_SEMAPHORES;
     VkSemaphore waitSemaphores[waitSemaphoreMaxCount] = { VK_NULL_HANDLE };
 
-    const uint32_t signalSemaphoreMaxCount = 3;
+    const uint32_t signalSemaphoreMaxCount = MAX_DECODE_SIGNAL_SEMAPHORES;
     VkSemaphore signalSemaphores[signalSemaphoreMaxCount] = { VK_NULL_HANDLE };
 
+    uint64_t waitTlSemaphoresValues[waitSemaphoreMaxCount] = { 0 /* ignored for binary semaphores */ };
+    uint64_t signalTlSemaphoresValues[signalSemaphoreMaxCount] = { 0 /* ignored for binary semaphores */ };
+
     uint32_t waitSemaphoreCount = 0;
+    uint64_t hwLoadBalancingSignalValue = 0;
+    if (m_hwLoadBalancingNumQueues > 0) {
+        // Selects m_currentVideoQueueIndx for this picture
+        hwLoadBalancingSignalValue = ScheduleHwLoadBalancedDecode(currPicIdx,
+                                                                  pPicParams->pGopReferenceImagesIndexes,
+                                                                  pPicParams->numGopReferenceSlots,
+                                                                  resetsDecoder,
+                                                                  waitSemaphores, waitTlSemaphoresValues,
+                                                                  waitSemaphoreCount, waitSemaphoreMaxCount - 4);
+    }
+
     if (frameConsumerDoneSemaphore != VK_NULL_HANDLE) {
         waitSemaphores[waitSemaphoreCount] = frameConsumerDoneSemaphore;
         waitSemaphoreCount++;
     }
 
+    if (frameConsumerDoneTimelineSemaphore != VK_NULL_HANDLE) {
+        // The consumer released the picture ahead of its last use of it on the device
+        waitSemaphores[waitSemaphoreCount] = frameConsumerDoneTimelineSemaphore;
+        waitTlSemaphoresValues[waitSemaphoreCount] = frameSynchronizationInfo.frameConsumerDoneTimelineValue;
+        waitSemaphoreCount++;
+    }
+
+    if (bitstreamUploadSemaphore != VK_NULL_HANDLE) {
+        waitSemaphores[waitSemaphoreCount] = bitstreamUploadSemaphore;
+        waitSemaphoreCount++;
+    }
+
+    if (pairWithFirstField) {
+        // The second field is ordered after the first one on the device, instead of on the host.
+        waitSemaphores[waitSemaphoreCount] = m_fieldPairSemaphore;
+        waitSemaphoreCount++;
+        m_pendingFirstField.pictureIndex = -1;
+    }
+
     uint32_t signalSemaphoreCount = 0;
-    if (videoDecodeCompleteSemaphore != VK_NULL_HANDLE) {
+    if (deferFrameComplete) {
+        signalSemaphores[signalSemaphoreCount] = m_fieldPairSemaphore;
+        signalSemaphoreCount++;
+
+        m_pendingFirstField.pictureIndex = currPicIdx;
+        m_pendingFirstField.videoQueueIndx = m_currentVideoQueueIndx;
+        m_pendingFirstField.frameCompleteFence = videoDecodeCompleteFence;
+        m_pendingFirstField.frameCompleteSemaphore = videoDecodeCompleteSemaphore;
+        videoDecodeCompleteFence = VK_NULL_HANDLE;
+    } else if (videoDecodeCompleteSemaphore != VK_NULL_HANDLE) {
         signalSemaphores[signalSemaphoreCount] = videoDecodeCompleteSemaphore;
         signalSemaphoreCount++;
     }
 
-    uint64_t waitTlSemaphoresValues[waitSemaphoreMaxCount] = { 0 /* ignored for binary semaphores */ };
-    uint64_t signalTlSemaphoresValues[signalSemaphoreMaxCount] = { 0 /* ignored for binary semaphores */ };
+    // The values of the binary semaphores are ignored
+    const bool hasTimelineSemaphores = (m_hwLoadBalancingNumQueues > 0) ||
+                                       (frameConsumerDoneTimelineSemaphore != VK_NULL_HANDLE);
     VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfos = {};
-    if (m_hwLoadBalancingTimelineSemaphore != VK_NULL_HANDLE) {
+    if (m_hwLoadBalancingNumQueues > 0) {
 
         if (m_dumpDecodeData) {
             uint64_t  currSemValue = 0;
-            VkResult semResult = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphore, &currSemValue);
+            VkResult semResult = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphores[m_currentVideoQueueIndx], &currSemValue);
             std::cout << "\t TL semaphore value: " << currSemValue << ", status: " << semResult << std::endl;
         }
 
-        waitSemaphores[waitSemaphoreCount] = m_hwLoadBalancingTimelineSemaphore;
-        waitTlSemaphoresValues[waitSemaphoreCount] = m_decodePicCount - 1; // wait for the previous value to be signaled
-        waitSemaphoreCount++;
-
-        signalSemaphores[signalSemaphoreCount] = m_hwLoadBalancingTimelineSemaphore;
-        signalTlSemaphoresValues[signalSemaphoreCount] = m_decodePicCount; // signal the current m_decodePicCount value
+        signalSemaphores[signalSemaphoreCount] = m_hwLoadBalancingTimelineSemaphores[m_currentVideoQueueIndx];
+        signalTlSemaphoresValues[signalSemaphoreCount] = hwLoadBalancingSignalValue;
         signalSemaphoreCount++;
+    }
 
+    if (hasTimelineSemaphores) {
         timelineSemaphoreInfos.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
         timelineSemaphoreInfos.pNext = NULL;
-        assert(waitSemaphoreCount < waitSemaphoreMaxCount);
+        assert(waitSemaphoreCount <= waitSemaphoreMaxCount);
         timelineSemaphoreInfos.waitSemaphoreValueCount = waitSemaphoreCount;
         timelineSemaphoreInfos.pWaitSemaphoreValues = waitTlSemaphoresValues;
-        assert(signalSemaphoreCount < signalSemaphoreMaxCount);
+        assert(signalSemaphoreCount <= signalSemaphoreMaxCount);
         timelineSemaphoreInfos.signalSemaphoreValueCount = signalSemaphoreCount;
         timelineSemaphoreInfos.pSignalSemaphoreValues = signalTlSemaphoresValues;
-        if (m_dumpDecodeData) {
+        if (m_dumpDecodeData && (m_hwLoadBalancingNumQueues > 0)) {
             std::cout << "\t Wait for: " << (waitSemaphoreCount ? waitTlSemaphoresValues[waitSemaphoreCount - 1] : 0) <<
                              ", signal at " << signalTlSemaphoresValues[signalSemaphoreCount - 1] << std::endl;
         }
@@ -857,18 +1314,21 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
     assert(signalSemaphoreCount <= signalSemaphoreMaxCount);
 
     VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
-    const VkPipelineStageFlags videoDecodeSubmitWaitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-    submitInfo.pNext = (m_hwLoadBalancingTimelineSemaphore != VK_NULL_HANDLE) ? &timelineSemaphoreInfos : nullptr;
+    VkPipelineStageFlags videoDecodeSubmitWaitStages[waitSemaphoreMaxCount];
+    for (uint32_t i = 0; i < waitSemaphoreMaxCount; i++) {
+        videoDecodeSubmitWaitStages[i] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    submitInfo.pNext = hasTimelineSemaphores ? &timelineSemaphoreInfos : nullptr;
     submitInfo.waitSemaphoreCount = waitSemaphoreCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = &videoDecodeSubmitWaitStages;
+    submitInfo.pWaitDstStageMask = videoDecodeSubmitWaitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &frameDataSlot.commandBuffer;
+    submitInfo.pCommandBuffers = &commandBuffer;
     submitInfo.signalSemaphoreCount = signalSemaphoreCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     if (m_dumpDecodeData) {
-        if (m_hwLoadBalancingTimelineSemaphore != VK_NULL_HANDLE) {
+        if (m_hwLoadBalancingNumQueues > 0) {
             std::cout << "\t\t waitSemaphoreValueCount: " << timelineSemaphoreInfos.waitSemaphoreValueCount << std::endl;
             std::cout << "\t pWaitSemaphoreValues: " << timelineSemaphoreInfos.pWaitSemaphoreValues[0] << ", " <<
 		                                        timelineSemaphoreInfos.pWaitSemaphoreValues[1] << ", " <<
@@ -889,9 +1349,44 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
 					         submitInfo.pSignalSemaphores[2] << std::endl << std::endl;
     }
 
-    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::DECODE, m_currentVideoQueueIndx,
-                                                           1, &submitInfo, videoDecodeCompleteFence);
+    // The submissions of the post-process filter wait on the decode ones, which must be on the queue first
+    VulkanQueueSubmitThread* pSubmitThread = m_enableDecodeFilter ? nullptr :
+            m_vkDevCtx->GetVideoDecodeSubmitThread(m_currentVideoQueueIndx);
+
+    if ((uint32_t)currPicIdx >= m_commandBatchIds.size()) {
+        m_commandBatchIds.resize(currPicIdx + 1, UINT64_MAX);
+    }
+    m_commandBatchIds[currPicIdx] = UINT64_MAX;
+
+    VkResult result = VK_SUCCESS;
+    if (pCommandBatch != nullptr) {
+        // Submitted with the batch, which signals the fence and semaphores of the picture
+        submitInfo.commandBufferCount = 0;
+        submitInfo.pCommandBuffers = nullptr;
+        result = pCommandBatch->EndPicture(submitInfo, videoDecodeCompleteFence, m_commandBatchIds[currPicIdx]);
+        m_lastCommandBatch = pCommandBatch;
+        m_lastCommandBatchId = m_commandBatchIds[currPicIdx];
+    } else if (m_submitBatchSize > 1) {
+        result = QueueDecodeSubmit(currPicIdx, submitInfo, videoDecodeCompleteFence);
+    } else if (pSubmitThread != nullptr) {
+        result = pSubmitThread->Submit(submitInfo, videoDecodeCompleteFence,
+                                       m_submitThreadCounters[m_currentVideoQueueIndx]);
+        if ((uint32_t)currPicIdx >= m_submitThreadPictures.size()) {
+            m_submitThreadPictures.resize(currPicIdx + 1);
+        }
+        m_submitThreadPictures[currPicIdx].queueIndx = m_currentVideoQueueIndx;
+        m_submitThreadPictures[currPicIdx].numQueued = m_submitThreadCounters[m_currentVideoQueueIndx].numQueued;
+    } else {
+        result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::DECODE, m_currentVideoQueueIndx,
+                                                      1, &submitInfo, videoDecodeCompleteFence);
+    }
     assert(result == VK_SUCCESS);
+    VkFrameLatency::Record(VK_FRAME_LATENCY_SUBMITTED, (uint64_t)picNumInDecodeOrder);
+
+    if (m_gpuTimestamps) {
+        // A batched submission is pending on the host, that time is accounted as queue wait.
+        m_gpuTimestamps->SetSubmitted(frameDataSlot.slot, picNumInDecodeOrder, videoDecodeCompleteFence);
+    }
 
     if (m_dumpDecodeData) {
         std::cout << "\t +++++++++++++++++++++++++++< " << currPicIdx << " >++++++++++++++++++++++++++++++" << std::endl;
@@ -916,26 +1411,28 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         }
     }
 
-    if (m_dumpDecodeData && (m_hwLoadBalancingTimelineSemaphore != VK_NULL_HANDLE)) { // For TL semaphore debug
+    if (m_dumpDecodeData && (m_hwLoadBalancingNumQueues > 0)) { // For TL semaphore debug
+       VkSemaphore hwLoadBalancingTimelineSemaphore = m_hwLoadBalancingTimelineSemaphores[m_currentVideoQueueIndx];
        uint64_t  currSemValue = 0;
-       VkResult semResult = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphore, &currSemValue);
+       VkResult semResult = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, hwLoadBalancingTimelineSemaphore, &currSemValue);
        std::cout << "\t TL semaphore value ater submit: " << currSemValue << ", status: " << semResult << std::endl;
 
        const bool waitOnTlSemaphore = false;
        if (waitOnTlSemaphore) {
-           uint64_t value = m_decodePicCount;
+           uint64_t value = hwLoadBalancingSignalValue;
            VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, nullptr, VK_SEMAPHORE_WAIT_ANY_BIT, 1,
-	                                    &m_hwLoadBalancingTimelineSemaphore, &value };
+	                                    &hwLoadBalancingTimelineSemaphore, &value };
            std::cout << "\t TL semaphore wait for value: " << value << std::endl;
            semResult = m_vkDevCtx->WaitSemaphores(*m_vkDevCtx, &waitInfo, gLongTimeout);
 
-           semResult = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphore, &currSemValue);
+           semResult = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, hwLoadBalancingTimelineSemaphore, &currSemValue);
            std::cout << "\t TL semaphore value: " << currSemValue << ", status: " << semResult << std::endl;
        }
     }
 
-    // For fence/sync debugging
-    if (pDecodePictureInfo->flags.fieldPic) {
+    // Without the field pair semaphore, the fields of a frame are synchronized on the host
+    if (pDecodePictureInfo->flags.fieldPic && (m_fieldPairSemaphore == VK_NULL_HANDLE)) {
+        VK_TRACE_ZONE("WaitForFences");
         result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &videoDecodeCompleteFence, true, gFenceTimeout);
         assert(result == VK_SUCCESS);
         result = m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, videoDecodeCompleteFence);
@@ -964,10 +1461,6 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
         }
     }
 
-    if (m_hwLoadBalancingTimelineSemaphore != VK_NULL_HANDLE) {
-        m_currentVideoQueueIndx++;
-        m_currentVideoQueueIndx %= m_vkDevCtx->GetVideoDecodeNumQueues();
-    }
     m_decodePicCount++;
 
     if (m_enableDecodeFilter) {
@@ -994,16 +1487,425 @@ int VkVideoDecoder::DecodePictureWithParameters(VkParserPerFrameDecodeParameters
 
         if (false) std::cout << currPicIdx << " : OUT view: " << outputImageView->GetImageView() << ", signalSem: " <<  frameCompleteSemaphore << std::endl << std::flush;
         assert(videoDecodeCompleteSemaphore != frameCompleteSemaphore);
+        // The filter runs on the compute queue, after the decode of the frame on the device, while the decode of
+        // the next frames is submitted. The consumers wait on the timeline value of the filter of the frame.
         result = m_yuvFilter->SubmitCommandBuffer(currPicIdx,
                                                   1, &videoDecodeCompleteSemaphore,
                                                   1, &frameCompleteSemaphore,
                                                   frameCompleteFence);
         assert(result == VK_SUCCESS);
+
+        m_videoFrameBuffer->SetFrameCompleteTimelineValue(currPicIdx, m_yuvFilter->GetFilterCompleteTimelineSemaphore(),
+                                                          m_yuvFilter->GetFilterCompleteTimelineValue(currPicIdx));
     }
 
+    m_metrics.framesDecoded.Add();
     return currPicIdx;
 }
 
+void VkVideoDecoder::FlushPendingFirstField()
+{
+    if (m_pendingFirstField.pictureIndex < 0) {
+        return;
+    }
+
+    // The wait on the field pair semaphore can't be submitted before its signal
+    FlushDecodeSubmitBatch();
+    WaitDecodeSubmitThreads();
+
+    // An empty batch consumes the field pair semaphore and signals the frame complete objects of the first field.
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &m_fieldPairSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 0;
+    submitInfo.signalSemaphoreCount = (m_pendingFirstField.frameCompleteSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    submitInfo.pSignalSemaphores = &m_pendingFirstField.frameCompleteSemaphore;
+
+    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::DECODE, m_pendingFirstField.videoQueueIndx,
+                                                           1, &submitInfo, m_pendingFirstField.frameCompleteFence);
+    assert(result == VK_SUCCESS);
+    (void)result;
+
+    if (m_dumpDecodeData) {
+        VK_LOG_DEBUG("\t => Unpaired field completed for CurrPicIdx: %d\n", m_pendingFirstField.pictureIndex);
+    }
+
+    m_pendingFirstField.pictureIndex = -1;
+}
+
+uint64_t VkVideoDecoder::ScheduleHwLoadBalancedDecode(int32_t currPicIdx, const int8_t* pReferenceIndexes, int32_t numReferences,
+                                                      bool resetsDecoder, VkSemaphore* pWaitSemaphores, uint64_t* pWaitValues,
+                                                      uint32_t& waitSemaphoreCount, uint32_t waitSemaphoreMaxCount)
+{
+    assert(m_hwLoadBalancingNumQueues > 0);
+
+    // The queue with the least decodes still in flight, the ties go round-robin after the last queue used.
+    int32_t selectedQueueIndx = -1;
+    uint64_t minPendingDecodes = (uint64_t)-1;
+    for (uint32_t i = 1; i <= m_hwLoadBalancingNumQueues; i++) {
+        const uint32_t queueIndx = ((uint32_t)m_currentVideoQueueIndx + i) % m_hwLoadBalancingNumQueues;
+        uint64_t completedValue = 0;
+        VkResult result = m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphores[queueIndx],
+                                                               &completedValue);
+        if (result != VK_SUCCESS) {
+            continue;
+        }
+        const uint64_t pendingDecodes = m_hwLoadBalancingTimelineValues[queueIndx] - std::min(completedValue,
+                                                                                              m_hwLoadBalancingTimelineValues[queueIndx]);
+        if (pendingDecodes < minPendingDecodes) {
+            minPendingDecodes = pendingDecodes;
+            selectedQueueIndx = (int32_t)queueIndx;
+        }
+    }
+    if (selectedQueueIndx < 0) {
+        selectedQueueIndx = ((uint32_t)m_currentVideoQueueIndx + 1) % m_hwLoadBalancingNumQueues;
+    }
+    m_currentVideoQueueIndx = selectedQueueIndx;
+
+    // Only the pictures this one depends on serialize with it: its references, the previous decode
+    // into the same picture and the last video coding reset. Work on the same queue is already in order.
+    uint64_t waitValues[MAX_DECODE_QUEUES] = { 0 };
+    if ((uint32_t)currPicIdx >= m_pictureDecodeTimelinePoints.size()) {
+        m_pictureDecodeTimelinePoints.resize(currPicIdx + 1, DecodeTimelinePoint());
+    }
+    const DecodeTimelinePoint& previousDecode = m_pictureDecodeTimelinePoints[currPicIdx];
+    waitValues[previousDecode.queueIndx] = previousDecode.timelineValue;
+    waitValues[m_resetDecodeTimelinePoint.queueIndx] = std::max(waitValues[m_resetDecodeTimelinePoint.queueIndx],
+                                                                m_resetDecodeTimelinePoint.timelineValue);
+    for (int32_t i = 0; i < numReferences; i++) {
+        const int32_t refPicIdx = pReferenceIndexes[i];
+        if ((refPicIdx < 0) || ((uint32_t)refPicIdx >= m_pictureDecodeTimelinePoints.size())) {
+            continue;
+        }
+        const DecodeTimelinePoint& referenceDecode = m_pictureDecodeTimelinePoints[refPicIdx];
+        waitValues[referenceDecode.queueIndx] = std::max(waitValues[referenceDecode.queueIndx],
+                                                         referenceDecode.timelineValue);
+    }
+
+    for (uint32_t queueIndx = 0; queueIndx < m_hwLoadBalancingNumQueues; queueIndx++) {
+        if ((queueIndx == (uint32_t)selectedQueueIndx) || (waitValues[queueIndx] == 0)) {
+            continue;
+        }
+        assert(waitSemaphoreCount < waitSemaphoreMaxCount);
+        if (waitSemaphoreCount >= waitSemaphoreMaxCount) {
+            break;
+        }
+        pWaitSemaphores[waitSemaphoreCount] = m_hwLoadBalancingTimelineSemaphores[queueIndx];
+        pWaitValues[waitSemaphoreCount] = waitValues[queueIndx];
+        waitSemaphoreCount++;
+    }
+
+    const uint64_t signalValue = ++m_hwLoadBalancingTimelineValues[selectedQueueIndx];
+    m_pictureDecodeTimelinePoints[currPicIdx].queueIndx = selectedQueueIndx;
+    m_pictureDecodeTimelinePoints[currPicIdx].timelineValue = signalValue;
+    if (resetsDecoder) {
+        m_resetDecodeTimelinePoint.queueIndx = selectedQueueIndx;
+        m_resetDecodeTimelinePoint.timelineValue = signalValue;
+    }
+
+    if (m_dumpDecodeData) {
+        VK_LOG_DEBUG("\t Scheduled CurrPicIdx: %d on queue %d with %llu decodes in flight, signal at %llu\n",
+                     currPicIdx, selectedQueueIndx, (unsigned long long)minPendingDecodes,
+                     (unsigned long long)signalValue);
+    }
+
+    return signalValue;
+}
+
+void VkVideoDecoder::SetDecodeSubmitBatching(uint32_t batchSize, uint32_t maxLatencyMs)
+{
+    FlushDecodeSubmitBatch();
+
+    m_submitBatchSize = m_enableDecodeFilter ? 1 : std::min<uint32_t>(std::max<uint32_t>(batchSize, 1),
+                                                                      MAX_DECODE_SUBMIT_BATCH_SIZE);
+    m_submitBatchMaxLatency = std::chrono::milliseconds(maxLatencyMs);
+}
+
+void VkVideoDecoder::EnableGpuTimestamps(const char* csvFileName)
+{
+    m_enableGpuTimestamps = true;
+    m_gpuTimestampsCsvFileName = (csvFileName != nullptr) ? csvFileName : "";
+}
+
+VkResult VkVideoDecoder::PreallocateVideoSession(VkVideoCodecOperationFlagBitsKHR codec,
+                                                 VkVideoChromaSubsamplingFlagBitsKHR chromaSubsampling,
+                                                 VkVideoComponentBitDepthFlagsKHR lumaBitDepth,
+                                                 VkVideoComponentBitDepthFlagsKHR chromaBitDepth,
+                                                 uint32_t codecProfile,
+                                                 const VkExtent2D& maxCodedExtent,
+                                                 uint32_t maxDpbSlots)
+{
+    if (m_videoFormat.coded_width && m_videoFormat.coded_height) {
+        // A sequence has started already
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // The largest sequence of the profile, the first one of the stream is then a resolution change
+    VkParserDetectedVideoFormat maxVideoFormat = VkParserDetectedVideoFormat();
+    maxVideoFormat.codec = codec;
+    maxVideoFormat.codecProfile = codecProfile;
+    maxVideoFormat.lumaBitDepth = lumaBitDepth;
+    maxVideoFormat.chromaBitDepth = chromaBitDepth;
+    maxVideoFormat.chromaSubsampling = chromaSubsampling;
+    maxVideoFormat.progressive_sequence = 1;
+    maxVideoFormat.bit_depth_luma_minus8 = (lumaBitDepth == VK_VIDEO_COMPONENT_BIT_DEPTH_12_BIT_KHR) ? 4 :
+                                           (lumaBitDepth == VK_VIDEO_COMPONENT_BIT_DEPTH_10_BIT_KHR) ? 2 : 0;
+    maxVideoFormat.bit_depth_chroma_minus8 = (chromaBitDepth == VK_VIDEO_COMPONENT_BIT_DEPTH_12_BIT_KHR) ? 4 :
+                                             (chromaBitDepth == VK_VIDEO_COMPONENT_BIT_DEPTH_10_BIT_KHR) ? 2 : 0;
+    maxVideoFormat.coded_width = maxCodedExtent.width;
+    maxVideoFormat.coded_height = maxCodedExtent.height;
+    maxVideoFormat.display_area.right = (int32_t)maxCodedExtent.width;
+    maxVideoFormat.display_area.bottom = (int32_t)maxCodedExtent.height;
+    maxVideoFormat.minNumDecodeSurfaces = maxDpbSlots;
+    maxVideoFormat.maxNumDpbSlots = maxDpbSlots;
+
+    if (StartVideoSequence(&maxVideoFormat) <= 0) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    return m_videoSession ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+}
+
+VkResult VkVideoDecoder::QueueDecodeSubmit(int32_t pictureIndex, const VkSubmitInfo& submitInfo, VkFence fence)
+{
+    assert(submitInfo.commandBufferCount == 1);
+    assert(submitInfo.waitSemaphoreCount <= MAX_DECODE_WAIT_SEMAPHORES);
+    assert(submitInfo.signalSemaphoreCount <= MAX_DECODE_SIGNAL_SEMAPHORES);
+
+    // With HW load balancing the pictures go to different queues, a batch is for one queue.
+    if ((m_submitBatchCount > 0) && (m_submitBatchQueueIndx != m_currentVideoQueueIndx)) {
+        VkResult result = FlushDecodeSubmitBatch();
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (m_submitBatchCount == 0) {
+        m_submitBatchQueueIndx = m_currentVideoQueueIndx;
+        m_submitBatchStartTime = now;
+    }
+
+    DecodeSubmit& decodeSubmit = m_submitBatch[m_submitBatchCount];
+    VkSubmitInfo& batchSubmitInfo = m_submitBatchInfos[m_submitBatchCount];
+    batchSubmitInfo = submitInfo;
+
+    for (uint32_t i = 0; i < submitInfo.waitSemaphoreCount; i++) {
+        decodeSubmit.waitSemaphores[i] = submitInfo.pWaitSemaphores[i];
+        decodeSubmit.waitDstStageMasks[i] = submitInfo.pWaitDstStageMask[i];
+    }
+    for (uint32_t i = 0; i < submitInfo.signalSemaphoreCount; i++) {
+        decodeSubmit.signalSemaphores[i] = submitInfo.pSignalSemaphores[i];
+    }
+    decodeSubmit.commandBuffer = submitInfo.pCommandBuffers[0];
+    decodeSubmit.pictureIndex = pictureIndex;
+
+    batchSubmitInfo.pWaitSemaphores = decodeSubmit.waitSemaphores;
+    batchSubmitInfo.pWaitDstStageMask = decodeSubmit.waitDstStageMasks;
+    batchSubmitInfo.pSignalSemaphores = decodeSubmit.signalSemaphores;
+    batchSubmitInfo.pCommandBuffers = &decodeSubmit.commandBuffer;
+
+    if (submitInfo.pNext != nullptr) {
+        // The only chained structure is the timeline semaphore values, of the HW load balancing or the consumer
+        const VkTimelineSemaphoreSubmitInfo* pTimelineSemaphoreInfo = (const VkTimelineSemaphoreSubmitInfo*)submitInfo.pNext;
+        assert(pTimelineSemaphoreInfo->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
+        decodeSubmit.timelineSemaphoreInfo = *pTimelineSemaphoreInfo;
+        for (uint32_t i = 0; i < pTimelineSemaphoreInfo->waitSemaphoreValueCount; i++) {
+            decodeSubmit.waitSemaphoreValues[i] = pTimelineSemaphoreInfo->pWaitSemaphoreValues[i];
+        }
+        for (uint32_t i = 0; i < pTimelineSemaphoreInfo->signalSemaphoreValueCount; i++) {
+            decodeSubmit.signalSemaphoreValues[i] = pTimelineSemaphoreInfo->pSignalSemaphoreValues[i];
+        }
+        decodeSubmit.timelineSemaphoreInfo.pWaitSemaphoreValues = decodeSubmit.waitSemaphoreValues;
+        decodeSubmit.timelineSemaphoreInfo.pSignalSemaphoreValues = decodeSubmit.signalSemaphoreValues;
+        batchSubmitInfo.pNext = &decodeSubmit.timelineSemaphoreInfo;
+    }
+
+    m_submitBatchFences[m_submitBatchCount] = fence;
+    m_submitBatchCount++;
+
+    if ((m_submitBatchCount >= m_submitBatchSize) || ((now - m_submitBatchStartTime) >= m_submitBatchMaxLatency)) {
+        return FlushDecodeSubmitBatch();
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoDecoder::FlushDecodeCommandBatch(int32_t pictureIndex)
+{
+    if (m_lastCommandBatch == nullptr) {
+        return VK_SUCCESS;
+    }
+
+    uint64_t batchId = m_lastCommandBatchId;
+    if (pictureIndex >= 0) {
+        batchId = ((uint32_t)pictureIndex < m_commandBatchIds.size()) ? m_commandBatchIds[pictureIndex] : UINT64_MAX;
+        if (batchId == UINT64_MAX) {
+            return VK_SUCCESS;
+        }
+    }
+
+    // The batches before the one of the picture are submitted already
+    VkResult result = m_lastCommandBatch->Flush(batchId);
+    if (batchId == m_lastCommandBatchId) {
+        m_lastCommandBatch = nullptr;
+        m_lastCommandBatchId = UINT64_MAX;
+    }
+    return result;
+}
+
+VkResult VkVideoDecoder::FlushDecodeSubmitBatch(int32_t pictureIndex)
+{
+    // The pictures of the command batches, before their fence is waited on
+    VkResult result = FlushDecodeCommandBatch(pictureIndex);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    if (m_submitBatchCount == 0) {
+        return VK_SUCCESS;
+    }
+
+    if (pictureIndex >= 0) {
+        uint32_t i = 0;
+        while ((i < m_submitBatchCount) && (m_submitBatch[i].pictureIndex != pictureIndex)) {
+            i++;
+        }
+        if (i == m_submitBatchCount) {
+            return VK_SUCCESS;
+        }
+    }
+
+    result = m_vkDevCtx->MultiThreadedQueueSubmitBatches(VulkanDeviceContext::DECODE, m_submitBatchQueueIndx,
+                                                         m_submitBatchCount, m_submitBatchInfos,
+                                                         m_submitBatchFences);
+    assert(result == VK_SUCCESS);
+
+    if (m_dumpDecodeData) {
+        VK_LOG_DEBUG("\t => Decode batch of %u pictures submitted\n", m_submitBatchCount);
+    }
+
+    m_submitBatchCount = 0;
+    return result;
+}
+
+VkResult VkVideoDecoder::WaitDecodeSubmitThreads(int32_t pictureIndex)
+{
+    if (pictureIndex >= 0) {
+        if ((uint32_t)pictureIndex >= m_submitThreadPictures.size()) {
+            return VK_SUCCESS;
+        }
+        const SubmitThreadPicture& picture = m_submitThreadPictures[pictureIndex];
+        if (picture.numQueued == 0) {
+            return VK_SUCCESS;
+        }
+        VulkanQueueSubmitThread* pSubmitThread = m_vkDevCtx->GetVideoDecodeSubmitThread(picture.queueIndx);
+        assert(pSubmitThread != nullptr);
+        return pSubmitThread->WaitSubmitted(m_submitThreadCounters[picture.queueIndx], picture.numQueued);
+    }
+
+    VkResult result = VK_SUCCESS;
+    for (int32_t queueIndx = 0; queueIndx < VulkanDeviceContext::MAX_QUEUE_INSTANCES; queueIndx++) {
+        if (m_submitThreadCounters[queueIndx].numQueued == 0) {
+            continue;
+        }
+        VulkanQueueSubmitThread* pSubmitThread = m_vkDevCtx->GetVideoDecodeSubmitThread(queueIndx);
+        assert(pSubmitThread != nullptr);
+        const VkResult queueResult = pSubmitThread->WaitSubmitted(m_submitThreadCounters[queueIndx]);
+        if (queueResult != VK_SUCCESS) {
+            result = queueResult;
+        }
+    }
+    return result;
+}
+
+VkResult VkVideoDecoder::InitBitstreamUpload(uint32_t numSlots)
+{
+    if (m_vkDevCtx->GetTransferQueue() == VK_NULL_HANDLE) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VkResult result = m_bitstreamUploadCommandBuffers.CreateCommandBufferPool(m_vkDevCtx,
+                                                                              m_vkDevCtx->GetTransferQueueFamilyIdx(),
+                                                                              numSlots);
+    if (result == VK_SUCCESS) {
+        result = m_bitstreamUploadSemaphores.CreateSet(m_vkDevCtx, numSlots);
+    }
+    if (result != VK_SUCCESS) {
+        m_bitstreamUploadCommandBuffers.DestroyCommandBuffer();
+        m_bitstreamUploadCommandBuffers.DestroyCommandBufferPool();
+        m_bitstreamUploadSemaphores.DestroySet();
+        return result;
+    }
+
+    m_deviceBitstreamBuffers.resize(numSlots);
+    return VK_SUCCESS;
+}
+
+VkSemaphore VkVideoDecoder::UploadBitstream(uint32_t slot, VkVideoDecodeInfoKHR& decodeFrameInfo,
+                                            VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment)
+{
+    assert(slot < m_deviceBitstreamBuffers.size());
+    const VkDeviceSize uploadSize = decodeFrameInfo.srcBufferRange;
+
+    // Grown to the size class of the picture, like the host buffers, and kept for the next pictures of the slot
+    VkSharedBaseObj<VkBufferResource>& deviceBitstreamBuffer = m_deviceBitstreamBuffers[slot];
+    if (!deviceBitstreamBuffer || (deviceBitstreamBuffer->GetMaxSize() < uploadSize)) {
+        deviceBitstreamBuffer = nullptr;
+        // Written on the transfer queue and read on the decode one, without ownership transfers
+        uint32_t queueFamilyIndexes[2] = { (uint32_t)m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                           (uint32_t)m_vkDevCtx->GetTransferQueueFamilyIdx() };
+        const uint32_t queueFamilyCount = (queueFamilyIndexes[0] != queueFamilyIndexes[1]) ? 2 : 1;
+        VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_BITSTREAM);
+        VkResult result = VkBufferResource::Create(m_vkDevCtx,
+                                                   VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR |
+                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                   NvVkDecodeFrameData::VulkanBitstreamBufferPool::GetAllocationSize(uploadSize),
+                                                   deviceBitstreamBuffer,
+                                                   bufferOffsetAlignment, bufferSizeAlignment,
+                                                   0, nullptr, queueFamilyCount, queueFamilyIndexes);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nWARNING: Failed to create the device-local bitstream buffer (%d), "
+                            "decoding from the host visible one\n", result);
+            deviceBitstreamBuffer = nullptr;
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    const VkCommandBuffer commandBuffer = *m_bitstreamUploadCommandBuffers.GetCommandBuffer(slot);
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    m_vkDevCtx->BeginCommandBuffer(commandBuffer, &beginInfo);
+
+    const VkBufferCopy copyRegion = { decodeFrameInfo.srcBufferOffset, 0, uploadSize };
+    m_vkDevCtx->CmdCopyBuffer(commandBuffer, decodeFrameInfo.srcBuffer, deviceBitstreamBuffer->GetBuffer(),
+                              1, &copyRegion);
+
+    VkResult result = m_vkDevCtx->EndCommandBuffer(commandBuffer);
+    const VkSemaphore uploadSemaphore = m_bitstreamUploadSemaphores.GetSemaphore(slot);
+    if (result == VK_SUCCESS) {
+        // Submitted ahead of the decode that waits on it. The host buffer stays referenced by the frame buffer
+        // until the decode of the picture is complete.
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &uploadSemaphore;
+        result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::TRANSFER, 0, 1, &submitInfo, VK_NULL_HANDLE);
+    }
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nWARNING: Failed to upload the bitstream (%d), decoding from the host visible buffer\n",
+                result);
+        return VK_NULL_HANDLE;
+    }
+
+    decodeFrameInfo.srcBuffer = deviceBitstreamBuffer->GetBuffer();
+    decodeFrameInfo.srcBufferOffset = 0;
+    return uploadSemaphore;
+}
+
 VkDeviceSize VkVideoDecoder::GetBitstreamBuffer(VkDeviceSize size,
                                                 VkDeviceSize minBitstreamBufferOffsetAlignment,
                                                 VkDeviceSize minBitstreamBufferSizeAlignment,
@@ -1013,18 +1915,64 @@ VkDeviceSize VkVideoDecoder::GetBitstreamBuffer(VkDeviceSize size,
 {
     assert(initializeBufferMemorySize <= size);
     // size_t newSize = 4 * 1024 * 1024;
-    VkDeviceSize newSize = size;
+    // Allocate the full size class, so the buffer can go back to the pool for any request of the class
+    VkDeviceSize newSize = NvVkDecodeFrameData::VulkanBitstreamBufferPool::GetAllocationSize(size);
     assert(m_vkDevCtx);
 
+    if (m_hostMappedBitstream && (initializeBufferMemorySize > 0) &&
+            m_hostMappedBitstream->Contains(pInitializeBufferMemory, initializeBufferMemorySize)) {
+        // The data is in the imported input, reference it in place instead of copying
+        VkSharedBaseObj<VulkanHostMappedBitstreamBuffer> hostMappedBitstreamBuffer;
+        VkResult result = VulkanHostMappedBitstreamBuffer::Create(m_hostMappedBitstream, pInitializeBufferMemory,
+                                                                  minBitstreamBufferOffsetAlignment,
+                                                                  minBitstreamBufferSizeAlignment,
+                                                                  hostMappedBitstreamBuffer);
+        if (result == VK_SUCCESS) {
+            bitstreamBuffer = hostMappedBitstreamBuffer;
+            return bitstreamBuffer->GetMaxSize();
+        }
+    }
+
+    if (m_bitstreamRingBufferSize > 0) {
+        if (!m_bitstreamRingBuffer ||
+                !m_bitstreamRingBuffer->IsCompatible(minBitstreamBufferOffsetAlignment, minBitstreamBufferSizeAlignment)) {
+            // The regions of a previous ring keep it until their decode is complete
+            m_bitstreamRingBuffer = nullptr;
+            VkResult result = VulkanBitstreamRingBuffer::Create(m_vkDevCtx, m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                                                m_bitstreamRingBufferSize,
+                                                                minBitstreamBufferOffsetAlignment,
+                                                                minBitstreamBufferSizeAlignment,
+                                                                m_bitstreamRingBuffer);
+            if (result != VK_SUCCESS) {
+                fprintf(stderr, "\nERROR: VulkanBitstreamRingBuffer::Create() result: 0x%x, "
+                                "using a bitstream buffer per picture\n", result);
+                m_bitstreamRingBufferSize = 0;
+            }
+        }
+
+        VkSharedBaseObj<VulkanRingBitstreamBuffer> ringBitstreamBuffer;
+        if (m_bitstreamRingBuffer &&
+                (m_bitstreamRingBuffer->Allocate(size, pInitializeBufferMemory, initializeBufferMemorySize,
+                                                 ringBitstreamBuffer) == VK_SUCCESS)) {
+            bitstreamBuffer = ringBitstreamBuffer;
+            return bitstreamBuffer->GetMaxSize();
+        }
+        // Else the ring is full of pictures still being decoded, or the picture is too large for it
+    }
+
     VkSharedBaseObj<VulkanBitstreamBufferImpl> newBitstreamBuffer;
 
     const bool enablePool = true;
     const bool debugBitstreamBufferDumpAlloc = false;
     int32_t availablePoolNode = -1;
     if (enablePool) {
-        availablePoolNode = m_decodeFramesData.GetBitstreamBuffersQueue().GetAvailableNodeFromPool(newBitstreamBuffer);
+        availablePoolNode = m_decodeFramesData.GetBitstreamBuffersQueue().GetAvailableNodeFromPool(size, newBitstreamBuffer);
+    }
+    if (enablePool && VkMetrics::IsEnabled()) {
+        m_metrics.bitstreamBuffersAvailable.Set(m_decodeFramesData.GetBitstreamBuffersQueue().GetAvailableNodesNumber());
     }
     if (!(availablePoolNode >= 0)) {
+        m_metrics.bitstreamBufferAllocations.Add();
         VkResult result = VulkanBitstreamBufferImpl::Create(m_vkDevCtx,
                 m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
                 newSize, minBitstreamBufferOffsetAlignment,
@@ -1048,7 +1996,8 @@ VkDeviceSize VkVideoDecoder::GetBitstreamBuffer(VkDeviceSize size,
 
     } else {
 
-        assert(newBitstreamBuffer);
+        // The pool only returns buffers from the size classes that fit
+        assert(newBitstreamBuffer && (newBitstreamBuffer->GetMaxSize() >= size));
         newSize = newBitstreamBuffer->GetMaxSize();
         assert(initializeBufferMemorySize <= newSize);
 
@@ -1065,7 +2014,7 @@ VkDeviceSize VkVideoDecoder::GetBitstreamBuffer(VkDeviceSize size,
             std::cout << "\t\tFrom bitstream buffer pool with size " << newSize << " B, " <<
                              newSize/1024 << " KB, " << newSize/1024/1024 << " MB" << std::endl;
 
-            std::cout << "\t\t\t FreeNodes " << m_decodeFramesData.GetBitstreamBuffersQueue().GetFreeNodesNumber();
+            std::cout << "\t\t\t FreeNodes " << m_decodeFramesData.GetBitstreamBuffersQueue().GetFreeNodesNumber(newSize);
             std::cout << " of MaxNodes " << m_decodeFramesData.GetBitstreamBuffersQueue().GetMaxNodes();
             std::cout << ", AvailableNodes " << m_decodeFramesData.GetBitstreamBuffersQueue().GetAvailableNodesNumber();
             std::cout << std::endl;
@@ -1080,6 +2029,22 @@ VkDeviceSize VkVideoDecoder::GetBitstreamBuffer(VkDeviceSize size,
     return bitstreamBuffer->GetMaxSize();
 }
 
+VkResult VkVideoDecoder::SetHostMappedBitstream(const uint8_t* pData, VkDeviceSize dataSize)
+{
+    m_hostMappedBitstream = nullptr;
+    if ((pData == nullptr) || (dataSize == 0)) {
+        return VK_SUCCESS;
+    }
+
+    VkResult result = VulkanHostMappedMemory::Create(m_vkDevCtx, m_vkDevCtx->GetVideoDecodeQueueFamilyIdx(),
+                                                     pData, dataSize, m_hostMappedBitstream);
+    if ((result != VK_SUCCESS) && (result != VK_ERROR_EXTENSION_NOT_PRESENT)) {
+        std::cout << "\tCan't import the input bitstream memory (result: 0x" << std::hex << result << std::dec <<
+                     "), copying the bitstream data." << std::endl;
+    }
+    return result;
+}
+
 VkResult VkVideoDecoder::Create(const VulkanDeviceContext* vkDevCtx,
                                 VkSharedBaseObj<VulkanVideoFrameBuffer>& videoFrameBuffer,
                                 int32_t videoQueueIndx,
@@ -1111,6 +2076,10 @@ void VkVideoDecoder::Deinitialize()
         return;
     }
 
+    FlushDecodeSubmitBatch();
+    FlushPendingFirstField();
+    WaitDecodeSubmitThreads();
+
     if (m_vkDevCtx->GetVideoDecodeNumQueues() > 1) {
         for (uint32_t queueId = 0; queueId <  (uint32_t)m_vkDevCtx->GetVideoDecodeNumQueues(); queueId++) {
             m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::DECODE, queueId);
@@ -1119,13 +2088,46 @@ void VkVideoDecoder::Deinitialize()
         m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::DECODE, m_currentVideoQueueIndx);
     }
 
-    if (m_hwLoadBalancingTimelineSemaphore != VK_NULL_HANDLE) {
-        m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphore, NULL);
-        m_hwLoadBalancingTimelineSemaphore = VK_NULL_HANDLE;
+    for (uint32_t queueIndx = 0; queueIndx < MAX_DECODE_QUEUES; queueIndx++) {
+        if (m_hwLoadBalancingTimelineSemaphores[queueIndx] != VK_NULL_HANDLE) {
+            m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_hwLoadBalancingTimelineSemaphores[queueIndx], NULL);
+            m_hwLoadBalancingTimelineSemaphores[queueIndx] = VK_NULL_HANDLE;
+        }
+    }
+    m_hwLoadBalancingNumQueues = 0;
+
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->PrintStats();
+        m_gpuTimestamps = nullptr;
+    }
+
+    if (m_fieldPairSemaphore != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroySemaphore(*m_vkDevCtx, m_fieldPairSemaphore, NULL);
+        m_fieldPairSemaphore = VK_NULL_HANDLE;
+    }
+
+    if (m_numGrayReferences > 0) {
+        std::cout << "\t " << m_numGrayReferences << " missing references were filled with gray" << std::endl;
     }
+    m_grayReferenceBuffer = nullptr;
 
+    m_firstFieldBitstreamData.clear();
     m_videoFrameBuffer = nullptr;
     m_decodeFramesData.deinit();
+    m_hostMappedBitstream = nullptr;
+    m_bitstreamRingBuffer = nullptr;
+    if (!m_deviceBitstreamBuffers.empty()) {
+        // The decodes waited on the uploads, an upload not followed by its decode is waited on here
+        m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::TRANSFER, 0);
+        m_deviceBitstreamBuffers.clear();
+        m_bitstreamUploadCommandBuffers.DestroyCommandBuffer();
+        m_bitstreamUploadCommandBuffers.DestroyCommandBufferPool();
+        m_bitstreamUploadSemaphores.DestroySet();
+    }
+    if (m_videoSession && (m_vkDevCtx->GetVideoSessionPool() != nullptr)) {
+        // The decode queues are idle, the next stream of the device can take the session
+        m_vkDevCtx->GetVideoSessionPool()->ReturnVideoSession(m_videoSession);
+    }
     m_videoSession = nullptr;
     m_yuvFilter = nullptr;
     m_vkDevCtx = nullptr;
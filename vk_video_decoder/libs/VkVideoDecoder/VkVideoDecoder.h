@@ -18,6 +18,7 @@
 
 #include <assert.h>
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <queue>
 #include <sstream>
@@ -28,10 +29,20 @@
 
 #include "vulkan_interfaces.h"
 #include "VkCodecUtils/VulkanVideoReferenceCountedPool.h"
+#include "VkCodecUtils/VulkanVideoSizeClassRefCountedPool.h"
 #include "VkCodecUtils/VulkanDeviceContext.h"
 #include "VkCodecUtils/Helpers.h"
 #include "VkCodecUtils/VulkanFilterYuvCompute.h"
 #include "VkCodecUtils/VulkanBistreamBufferImpl.h"
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VulkanHostMappedBitstream.h"
+#include "VkCodecUtils/VulkanBitstreamRingBuffer.h"
+#include "VkCodecUtils/VulkanCommandBuffersSet.h"
+#include "VkCodecUtils/VulkanSemaphoreSet.h"
+#include "VkCodecUtils/VulkanVideoGpuTimestamps.h"
+#include "VkCodecUtils/VkMetrics.h"
+#include "VkCodecUtils/VulkanQueueSubmitThread.h"
+#include "VkCodecUtils/VulkanVideoDecodeCommandBatch.h"
 #include "VkVideoCore/VkVideoCoreProfile.h"
 #include "VkCodecUtils/VulkanVideoSession.h"
 #include "VulkanVideoFrameBuffer/VulkanVideoFrameBuffer.h"
@@ -58,9 +69,9 @@ struct NvVkDecodeFrameDataSlot {
 
 class NvVkDecodeFrameData {
 
-    using VulkanBitstreamBufferPool = VulkanVideoRefCountedPool<VulkanBitstreamBufferImpl, 64>;
-
 public:
+    using VulkanBitstreamBufferPool = VulkanVideoSizeClassRefCountedPool<VulkanBitstreamBufferImpl, 64>;
+
     NvVkDecodeFrameData(const VulkanDeviceContext* vkDevCtx)
        : m_vkDevCtx(vkDevCtx),
          m_videoCommandPool(),
@@ -143,12 +154,15 @@ class VkVideoDecoder : public IVulkanVideoDecoderHandler {
 public:
     VkPhysicalDevice GetPhysDevice() { return m_vkDevCtx ? m_vkDevCtx->getPhysicalDevice() : VK_NULL_HANDLE; }
     enum { MAX_RENDER_TARGETS = 32 }; // Must be 32 or less (used as uint32_t bitmask of active render targets)
+    enum { MAX_DECODE_SUBMIT_BATCH_SIZE = 16 };
 
     static VkSharedBaseObj<VkVideoDecoder> invalidVkDecoder;
 
     enum DecoderFeatures { ENABLE_LINEAR_OUTPUT       = (1 << 0),
                            ENABLE_HW_LOAD_BALANCING   = (1 << 1),
                            ENABLE_POST_PROCESS_FILTER = (1 << 2),
+                           ENABLE_EXPORT_OUTPUT       = (1 << 3), // separate output images exported as opaque FDs
+                           ENABLE_ERROR_RESILIENCE    = (1 << 4), // fill the references never decoded with gray
                          };
 
     static VkResult Create(const VulkanDeviceContext* vkDevCtx,
@@ -163,6 +177,8 @@ public:
 
     static const char* GetVideoCodecString(VkVideoCodecOperationFlagBitsKHR codec);
     static const char* GetVideoChromaFormatString(VkVideoChromaSubsamplingFlagBitsKHR chromaFormat);
+    // The sequences decode with the same session and images, only the timing of the streams may differ
+    static bool IsSameSequence(const VkParserDetectedVideoFormat& a, const VkParserDetectedVideoFormat& b);
 
     virtual int32_t AddRef();
     virtual int32_t Release();
@@ -195,6 +211,131 @@ public:
                                       const uint8_t* pInitializeBufferMemory,
                                       VkDeviceSize initializeBufferMemorySize,
                                       VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer);
+
+    /**
+     *   @brief  Imports the host memory the parser input is read from (e.g. a memory mapped file), so that
+     *           the bitstream buffers can reference it in place for decoding instead of copying it.
+     *           Requires VK_EXT_external_memory_host. The memory must stay valid until the decoder is destroyed
+     *           or SetHostMappedBitstream(nullptr, 0) is called.
+     */
+    VkResult SetHostMappedBitstream(const uint8_t* pData, VkDeviceSize dataSize);
+
+    /**
+     *   @brief  Same, with host memory already imported (e.g. a block of a VulkanHostMappedMemoryPool the
+     *           parser input was written to). The memory is referenced until the next call.
+     */
+    void SetHostMappedBitstream(VkSharedBaseObj<VulkanHostMappedMemory>& hostMappedMemory)
+    {
+        m_hostMappedBitstream = hostMappedMemory;
+    }
+
+    /**
+     *   @brief  Places the bitstream data of consecutive pictures in a single ring buffer of that size, so that
+     *           the NAL unit that follows a picture is continued in place instead of copied to a new buffer.
+     *           Zero uses a separate buffer from the pool for each picture.
+     */
+    void SetBitstreamRingBufferSize(VkDeviceSize ringBufferSize)
+    {
+        m_bitstreamRingBufferSize = ringBufferSize;
+        m_bitstreamRingBuffer = nullptr;
+    }
+
+    /**
+     *   @brief  Decodes each picture from a device-local copy of its bitstream, uploaded on the transfer queue
+     *           of the device ahead of the decode, instead of reading the host visible buffer across the bus.
+     *           Without a transfer queue, the pictures are decoded from the host visible buffers.
+     */
+    void SetDeviceLocalBitstream(bool deviceLocalBitstream)
+    {
+        m_deviceLocalBitstream = deviceLocalBitstream;
+    }
+
+    /**
+     *   @brief  Sets how long a bitstream buffer size class can go unused before its free buffers are released.
+     *           Zero keeps all the buffers until the decoder is destroyed.
+     */
+    void SetBitstreamBufferIdleTrimPeriod(uint32_t idleTrimPeriodMs)
+    {
+        m_decodeFramesData.GetBitstreamBuffersQueue().SetIdleTrimPeriod(idleTrimPeriodMs);
+    }
+
+    /**
+     *   @brief  Returns how many times the video session parameters object had to be recreated in the stream,
+     *           because the content of a VPS, SPS or PPS ID already in use changed.
+     */
+    uint32_t GetPictureParametersRecreationCount() const
+    {
+        return m_currentPictureParameters ? m_currentPictureParameters->GetRecreationCount() : 0;
+    }
+
+    /**
+     *   @brief  Signals the frame complete fence and semaphore of a first field that is still waiting for its
+     *           second field, i.e. when the stream ends on an unpaired field. Must be called from the decode thread.
+     */
+    void FlushPendingFirstField();
+
+    /**
+     *   @brief  Accumulates up to batchSize decoded pictures before submitting them to the decode queue in one call.
+     *           A batch is also submitted maxLatencyMs after its first picture was added, or when the display
+     *           needs one of its pictures. A batch size of 1 submits each picture right away.
+     *           Batching is not used with the post-process filter, its submissions wait on the decode ones.
+     */
+    void SetDecodeSubmitBatching(uint32_t batchSize, uint32_t maxLatencyMs);
+
+    /**
+     *   @brief  Submits the pending batch of decoded pictures. With a picture index, only if that picture is in it.
+     *           Must be called from the decode thread.
+     */
+    VkResult FlushDecodeSubmitBatch(int32_t pictureIndex = -1);
+
+    /**
+     *   @brief  Submits the command batch of the device the picture was recorded into, the last one by default.
+     *           Must be called from the decode thread.
+     */
+    VkResult FlushDecodeCommandBatch(int32_t pictureIndex = -1);
+
+    /**
+     *   @brief  Without batching or the post-process filter, the pictures are submitted through the submit threads
+     *           of the device if it has them. Blocks until the pictures handed to them are on the decode queues.
+     *           With a picture index, only until the last submission of that picture is.
+     *           Must be called from the decode thread.
+     */
+    VkResult WaitDecodeSubmitThreads(int32_t pictureIndex = -1);
+
+    /**
+     *   @brief  Measures the device time of each decode command with timestamps, reported on Deinitialize().
+     *           With a CSV file name, the per frame results are also written to that file.
+     */
+    void EnableGpuTimestamps(const char* csvFileName = nullptr);
+
+    /**
+     *   @brief  Creates the video session of the profile and its images ahead of the bitstream, for an extent up to
+     *           maxCodedExtent, as many images as numDecodeImagesToPreallocate. The sequences that fit in them then
+     *           start without creating a session or waiting for the device.
+     */
+    VkResult PreallocateVideoSession(VkVideoCodecOperationFlagBitsKHR codec,
+                                     VkVideoChromaSubsamplingFlagBitsKHR chromaSubsampling,
+                                     VkVideoComponentBitDepthFlagsKHR lumaBitDepth,
+                                     VkVideoComponentBitDepthFlagsKHR chromaBitDepth,
+                                     uint32_t codecProfile,
+                                     const VkExtent2D& maxCodedExtent,
+                                     uint32_t maxDpbSlots);
+
+    /**
+     *   @brief  The device time of the decode commands completed so far, 0 without EnableGpuTimestamps().
+     */
+    double GetTotalGpuTimeMs()
+    {
+        return m_gpuTimestamps ? m_gpuTimestamps->GetTotalGpuTimeMs() : 0.0;
+    }
+
+    /**
+     *   @brief  The labels of the runtime metrics of this decoder, for the other metrics of its stream.
+     */
+    const std::string& GetMetricsLabels() const
+    {
+        return m_metrics.labels;
+    }
 private:
 
     VkVideoDecoder(const VulkanDeviceContext* vkDevCtx,
@@ -218,19 +359,58 @@ private:
         , m_videoFrameBuffer(videoFrameBuffer)
         , m_decodeFramesData(vkDevCtx)
         , m_decodePicCount(0)
-        , m_hwLoadBalancingTimelineSemaphore()
+        , m_hwLoadBalancingTimelineSemaphores()
+        , m_hwLoadBalancingTimelineValues()
+        , m_hwLoadBalancingNumQueues(0)
+        , m_pictureDecodeTimelinePoints()
+        , m_resetDecodeTimelinePoint()
+        , m_fieldPairSemaphore()
+        , m_pendingFirstField()
+        , m_firstFieldBitstreamData()
+        , m_submitBatch()
+        , m_submitBatchInfos()
+        , m_submitBatchFences()
+        , m_submitBatchCount(0)
+        , m_submitBatchSize(1)
+        , m_submitBatchQueueIndx(0)
+        , m_submitBatchMaxLatency()
+        , m_submitBatchStartTime()
+        , m_submitThreadCounters()
+        , m_submitThreadPictures()
+        , m_commandBatchIds()
+        , m_lastCommandBatch()
+        , m_lastCommandBatchId(UINT64_MAX)
+        , m_gpuTimestamps()
+        , m_gpuTimestampsCsvFileName()
+        , m_enableGpuTimestamps(false)
         , m_dpbAndOutputCoincide(true)
         , m_videoMaintenance1FeaturesSupported(false)
+        , m_decodeFilterRequested((enableDecoderFeatures & ENABLE_POST_PROCESS_FILTER) != 0)
         , m_enableDecodeFilter((enableDecoderFeatures & ENABLE_POST_PROCESS_FILTER) != 0)
         , m_useImageArray(false)
         , m_useImageViewArray(false)
-        , m_useSeparateOutputImages(((enableDecoderFeatures & ENABLE_LINEAR_OUTPUT) != 0) || m_enableDecodeFilter)
+        , m_useSeparateOutputImages(((enableDecoderFeatures & (ENABLE_LINEAR_OUTPUT | ENABLE_EXPORT_OUTPUT)) != 0) ||
+                                    m_enableDecodeFilter)
         , m_useLinearOutput((enableDecoderFeatures & ENABLE_LINEAR_OUTPUT) != 0)
+        , m_exportOutputImages((enableDecoderFeatures & ENABLE_EXPORT_OUTPUT) != 0)
+        , m_errorResilient((enableDecoderFeatures & ENABLE_ERROR_RESILIENCE) != 0)
+        , m_grayReferenceWarned(false)
         , m_resetDecoder(true)
         , m_dumpDecodeData(false)
+        , m_deviceLocalBitstream(false)
         , m_numBitstreamBuffersToPreallocate(numBitstreamBuffersToPreallocate)
         , m_maxStreamBufferSize()
+        , m_hostMappedBitstream()
+        , m_bitstreamRingBufferSize(0)
+        , m_bitstreamRingBuffer()
+        , m_deviceBitstreamBuffers()
+        , m_bitstreamUploadCommandBuffers()
+        , m_bitstreamUploadSemaphores()
         , m_filterType(filterType)
+        , m_yuvFilter()
+        , m_grayReferenceBuffer()
+        , m_numGrayReferences(0)
+        , m_metrics(VkMetrics::NewStreamLabels())
     {
 
         assert(m_vkDevCtx->GetVideoDecodeQueueFamilyIdx() != -1);
@@ -253,26 +433,44 @@ private:
                         m_vkDevCtx->GetVideoDecodeNumQueues() << " queue!!!" << std::endl;
             }
 
-            // Create the timeline semaphore object for the HW LoadBalancing Timeline Semaphore
+            // Create one timeline semaphore per decode queue, the pictures wait only on the queues
+            // their references were decoded on.
             VkSemaphoreTypeCreateInfo timelineCreateInfo;
             timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
             timelineCreateInfo.pNext = NULL;
             timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
-            timelineCreateInfo.initialValue = (uint64_t)-1; // assuming m_decodePicCount starts at 0.
+            timelineCreateInfo.initialValue = 0; // the first decode on a queue signals 1
 
             VkSemaphoreCreateInfo createInfo;
             createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
             createInfo.pNext = &timelineCreateInfo;
             createInfo.flags = 0;
 
-            VkResult result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &createInfo, NULL, &m_hwLoadBalancingTimelineSemaphore);
+            const uint32_t numQueues = std::min<uint32_t>((uint32_t)m_vkDevCtx->GetVideoDecodeNumQueues(), MAX_DECODE_QUEUES);
+            VkResult result = VK_SUCCESS;
+            for (uint32_t queueIndx = 0; (queueIndx < numQueues) && (result == VK_SUCCESS); queueIndx++) {
+                result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &createInfo, NULL, &m_hwLoadBalancingTimelineSemaphores[queueIndx]);
+                m_hwLoadBalancingTimelineValues[queueIndx] = 0;
+            }
             if (result == VK_SUCCESS) {
+                m_hwLoadBalancingNumQueues = numQueues;
                 m_currentVideoQueueIndx = 0; // start with index zero
             }
             std::cout << "\t Enabling HW Load Balancing for device with "
-                      << m_vkDevCtx->GetVideoDecodeNumQueues() << " queues" << std::endl;
+                      << m_hwLoadBalancingNumQueues << " queues" << std::endl;
         }
 
+        // The first field of a frame signals this semaphore instead of the frame complete fence and semaphore,
+        // the second field waits on it and then signals those for the whole frame. The post-process filter
+        // runs on complete frames only, so with it enabled the fields are still synchronized on the host.
+        if (!m_enableDecodeFilter) {
+            VkSemaphoreCreateInfo createInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+            VkResult result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &createInfo, NULL, &m_fieldPairSemaphore);
+            assert(result == VK_SUCCESS);
+            (void)result;
+        }
+        m_pendingFirstField.pictureIndex = -1;
+
     }
 
     virtual ~VkVideoDecoder();
@@ -285,6 +483,33 @@ private:
                                  VulkanVideoFrameBuffer::PictureResourceInfo& dstPictureResourceInfo,
                                  VulkanVideoFrameBuffer::FrameSynchronizationInfo *pFrameSynchronizationInfo);
 
+    // Whether the references never decoded can be filled with gray ahead of the decode, once per decoder
+    bool CanFillGrayReferences();
+    // Fills the planes of the references with mid-level samples, leaving them in the transfer destination layout
+    void RecordGrayReferences(VkCommandBuffer commandBuffer, const VkVideoPictureResourceInfoKHR* pPictureResources,
+                              const VulkanVideoFrameBuffer::PictureResourceInfo* pPictureResourcesInfo,
+                              const int32_t* pReferenceIds, uint32_t numReferences);
+
+    VkResult QueueDecodeSubmit(int32_t pictureIndex, const VkSubmitInfo& submitInfo, VkFence fence);
+
+    // The parts of StartVideoSequence() independent of the session and the images, run on its startup pool
+    VkResult CreateYuvFilter(const VkParserDetectedVideoFormat* pVideoFormat, VkFormat inputFormat,
+                             VkFormat outputFormat, VkSharedBaseObj<VulkanFilter>& yuvFilter);
+    void PreallocateBitstreamBuffers(const VkVideoCapabilitiesKHR& videoCapabilities);
+
+    // With m_deviceLocalBitstream, the upload command buffers and semaphores of the decode command buffer slots
+    VkResult InitBitstreamUpload(uint32_t numSlots);
+    // Copies the bitstream range of the decode to the device-local buffer of the slot on the transfer queue and
+    // points the decode to it. Returns the semaphore the decode waits on, none if decoded from the host buffer.
+    VkSemaphore UploadBitstream(uint32_t slot, VkVideoDecodeInfoKHR& decodeFrameInfo,
+                                VkDeviceSize bufferOffsetAlignment, VkDeviceSize bufferSizeAlignment);
+
+    // Picks the decode queue for the picture and adds the timeline semaphore waits for its dependencies
+    // on the other queues. Returns the timeline value the picture has to signal on the selected queue.
+    uint64_t ScheduleHwLoadBalancedDecode(int32_t currPicIdx, const int8_t* pReferenceIndexes, int32_t numReferences,
+                                          bool resetsDecoder, VkSemaphore* pWaitSemaphores, uint64_t* pWaitValues,
+                                          uint32_t& waitSemaphoreCount, uint32_t waitSemaphoreMaxCount);
+
     int32_t GetCurrentFrameData(uint32_t slotId, NvVkDecodeFrameDataSlot& frameDataSlot)
     {
         if (slotId < m_decodeFramesData.size()) {
@@ -311,20 +536,98 @@ private:
     VkSharedBaseObj<VulkanVideoFrameBuffer> m_videoFrameBuffer;
     NvVkDecodeFrameData                     m_decodeFramesData;
 
-    uint64_t                                         m_decodePicCount; // Also used for the HW load balancing timeline semaphore
+    uint64_t                                         m_decodePicCount;
     VkSharedBaseObj<VkParserVideoPictureParameters>  m_currentPictureParameters;
-    VkSemaphore m_hwLoadBalancingTimelineSemaphore;
+    enum { MAX_DECODE_QUEUES = 8 };
+    struct DecodeTimelinePoint { // where a decode was submitted, a zero value is for none
+        int32_t  queueIndx;
+        uint64_t timelineValue;
+    };
+    VkSemaphore m_hwLoadBalancingTimelineSemaphores[MAX_DECODE_QUEUES];
+    uint64_t    m_hwLoadBalancingTimelineValues[MAX_DECODE_QUEUES]; // the last value submitted to be signaled
+    uint32_t    m_hwLoadBalancingNumQueues; // zero if the HW load balancing is not enabled
+    std::vector<DecodeTimelinePoint> m_pictureDecodeTimelinePoints; // the last decode of each picture index
+    DecodeTimelinePoint              m_resetDecodeTimelinePoint; // the last decode with a video coding reset
+    VkSemaphore m_fieldPairSemaphore;
+    struct PendingFirstField {
+        int32_t     pictureIndex; // -1 if there is no first field waiting for its pair
+        int32_t     videoQueueIndx;
+        VkFence     frameCompleteFence;
+        VkSemaphore frameCompleteSemaphore;
+    } m_pendingFirstField;
+    std::vector<VkSharedBaseObj<VulkanBitstreamBuffer>> m_firstFieldBitstreamData; // indexed by the picture index
+    // The frame consumer done (binary and timeline), the field pair and the bitstream upload semaphores, plus a
+    // timeline semaphore per other decode queue
+    enum { MAX_DECODE_WAIT_SEMAPHORES = 4 + MAX_DECODE_QUEUES, MAX_DECODE_SIGNAL_SEMAPHORES = 3 };
+    struct DecodeSubmit { // the storage the batched VkSubmitInfo entries point to
+        VkSemaphore                   waitSemaphores[MAX_DECODE_WAIT_SEMAPHORES];
+        uint64_t                      waitSemaphoreValues[MAX_DECODE_WAIT_SEMAPHORES];
+        VkPipelineStageFlags          waitDstStageMasks[MAX_DECODE_WAIT_SEMAPHORES];
+        VkSemaphore                   signalSemaphores[MAX_DECODE_SIGNAL_SEMAPHORES];
+        uint64_t                      signalSemaphoreValues[MAX_DECODE_SIGNAL_SEMAPHORES];
+        VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo;
+        VkCommandBuffer               commandBuffer;
+        int32_t                       pictureIndex;
+    };
+    DecodeSubmit                          m_submitBatch[MAX_DECODE_SUBMIT_BATCH_SIZE];
+    VkSubmitInfo                          m_submitBatchInfos[MAX_DECODE_SUBMIT_BATCH_SIZE];
+    VkFence                               m_submitBatchFences[MAX_DECODE_SUBMIT_BATCH_SIZE];
+    uint32_t                              m_submitBatchCount;
+    uint32_t                              m_submitBatchSize;
+    int32_t                               m_submitBatchQueueIndx;
+    std::chrono::milliseconds             m_submitBatchMaxLatency;
+    std::chrono::steady_clock::time_point m_submitBatchStartTime;
+    // The pictures of this decoder handed to the submit thread of each decode queue
+    VulkanQueueSubmitThread::SubmitCounter m_submitThreadCounters[VulkanDeviceContext::MAX_QUEUE_INSTANCES];
+    struct SubmitThreadPicture {
+        int32_t  queueIndx;
+        uint64_t numQueued; // the count of the queue counter with the picture
+    };
+    std::vector<SubmitThreadPicture> m_submitThreadPictures; // indexed by the picture index
+    // The pictures of this decoder recorded into the command batches of the device, if it has them
+    std::vector<uint64_t> m_commandBatchIds; // indexed by the picture index, UINT64_MAX if not recorded into one
+    VulkanVideoDecodeCommandBatch* m_lastCommandBatch; // of the last picture recorded into one
+    uint64_t m_lastCommandBatchId;
+    VkSharedBaseObj<VulkanVideoGpuTimestamps> m_gpuTimestamps; // one slot per decode command buffer
+    std::string m_gpuTimestampsCsvFileName;
+    uint32_t m_enableGpuTimestamps : 1;
     uint32_t m_dpbAndOutputCoincide : 1;
     uint32_t m_videoMaintenance1FeaturesSupported : 1;
-    uint32_t m_enableDecodeFilter : 1;
+    uint32_t m_decodeFilterRequested : 1;
+    uint32_t m_enableDecodeFilter : 1; // unless the requested filter is bypassed for the sequence
     uint32_t m_useImageArray : 1;
     uint32_t m_useImageViewArray : 1;
     uint32_t m_useSeparateOutputImages : 1;
     uint32_t m_useLinearOutput : 1;
+    uint32_t m_exportOutputImages : 1;
+    uint32_t m_errorResilient : 1;
+    uint32_t m_grayReferenceWarned : 1; // the references can't be filled on this device or decode queue
     uint32_t m_resetDecoder : 1;
     uint32_t m_dumpDecodeData : 1;
+    uint32_t m_deviceLocalBitstream : 1;
     int32_t  m_numBitstreamBuffersToPreallocate;
     VkDeviceSize   m_maxStreamBufferSize;
+    VkSharedBaseObj<VulkanHostMappedMemory> m_hostMappedBitstream;
+    VkDeviceSize   m_bitstreamRingBufferSize;
+    VkSharedBaseObj<VulkanBitstreamRingBuffer> m_bitstreamRingBuffer; // created on first use, with the parser alignments
+    // With m_deviceLocalBitstream, by decode command buffer slot: reused with the command buffer of the slot
+    std::vector<VkSharedBaseObj<VkBufferResource>> m_deviceBitstreamBuffers;
+    VulkanCommandBuffersSet m_bitstreamUploadCommandBuffers; // of the transfer queue
+    VulkanSemaphoreSet m_bitstreamUploadSemaphores;          // signaled by the upload, waited on by the decode
     VulkanFilterYuvCompute::FilterType m_filterType;
     VkSharedBaseObj<VulkanFilter> m_yuvFilter;
+    VkSharedBaseObj<VkBufferResource> m_grayReferenceBuffer; // mid-level samples, copied to each plane
+    uint64_t m_numGrayReferences;
+    struct DecoderMetrics {
+        explicit DecoderMetrics(const std::string& streamLabels);
+
+        const std::string  labels;
+        VkMetricCounter&   framesDecoded;
+        VkMetricHistogram& decodePictureUs;      // the host time of DecodePictureWithParameters()
+        VkMetricCounter&   sequenceChanges;      // resolution and format changes
+        VkMetricCounter&   sessionRecreations;
+        VkMetricCounter&   parametersRecreations;
+        VkMetricCounter&   bitstreamBufferAllocations; // the requests the pool had no buffer for
+        VkMetricGauge&     bitstreamBuffersAvailable;  // sampled while the metrics are enabled
+    } m_metrics;
 };
@@ -23,7 +23,7 @@
 #include <algorithm>
 #include <atomic>
 #include <iostream>
-#include <queue> // std::queue
+#include <utility>
 
 #include "vkvideo_parser/VulkanVideoParserIf.h"
 #include "NvVideoParser/nvVulkanVideoParser.h"
@@ -33,6 +33,7 @@
 #include "vkvideo_parser/StdVideoPictureParametersSet.h"
 
 #include "vkvideo_parser/VulkanVideoParser.h"
+#include "VkCodecUtils/VkTrace.h"
 
 #undef min
 #undef max
@@ -48,6 +49,19 @@ static const uint32_t MAX_DPB_REF_AND_SETUP_SLOTS = MAX_DPB_REF_SLOTS + 1; // pl
 
 #define COPYFIELD(pout, pin, name) pout->name = pin->name
 
+// The mask must not be zero
+static inline uint32_t CountTrailingZeros32(uint32_t mask)
+{
+    assert(mask != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
 namespace NvVulkanDecoder
 {
 
@@ -134,6 +148,20 @@ struct nvVideoH265PicParameters {
     nvVideoDecodeH265DpbSlotInfo dpbRefList[MAX_REF_PICTURES_LIST_ENTRIES];
 };
 
+/*******************************************************/
+//! \struct nvVideoPerFrameDecodeArena
+//! The structures the decode of a picture points to, owned by the parser
+//! for the duration of the frame instead of the stack of DecodePicture().
+//! Only the codec in use is reset for each picture.
+/*******************************************************/
+struct nvVideoPerFrameDecodeArena {
+    VkParserPerFrameDecodeParameters pictureParams;
+    VkVideoReferenceSlotInfoKHR referenceSlots[MAX_DPB_REF_AND_SETUP_SLOTS];
+    VkVideoReferenceSlotInfoKHR setupReferenceSlot;
+    nvVideoH264PicParameters h264;
+    nvVideoH265PicParameters hevc;
+};
+
 static vkPicBuffBase* GetPic(VkPicIf* pPicBuf)
 {
     return (vkPicBuffBase*)pPicBuf;
@@ -201,6 +229,8 @@ public:
         : m_dpbMaxSize(0)
         , m_slotInUseMask(0)
         , m_dpb(m_dpbMaxSize)
+        , m_numSlotsAvailable(0)
+        , m_firstSlotAvailable(0)
         , m_dpbSlotsAvailable()
     {
         Init(dpbMaxSize, false);
@@ -228,7 +258,7 @@ public:
         }
 
         for (uint8_t dpbIndx = oldDpbMaxSize; dpbIndx < m_dpbMaxSize; dpbIndx++) {
-            m_dpbSlotsAvailable.push(dpbIndx);
+            PushSlotAvailable(dpbIndx);
         }
 
         return m_dpbMaxSize;
@@ -240,9 +270,8 @@ public:
             m_dpb[ndx].Invalidate();
         }
 
-        while (!m_dpbSlotsAvailable.empty()) {
-            m_dpbSlotsAvailable.pop();
-        }
+        m_numSlotsAvailable = 0;
+        m_firstSlotAvailable = 0;
 
         m_dpbMaxSize = 0;
         m_slotInUseMask = 0;
@@ -252,14 +281,15 @@ public:
 
     int8_t AllocateSlot()
     {
-        if (m_dpbSlotsAvailable.empty()) {
+        if (m_numSlotsAvailable == 0) {
             assert(!"No more h.264/5 DPB slots are available");
             return -1;
         }
-        int8_t slot = (int8_t)m_dpbSlotsAvailable.front();
+        int8_t slot = (int8_t)m_dpbSlotsAvailable[m_firstSlotAvailable];
         assert((slot >= 0) && ((uint8_t)slot < m_dpbMaxSize));
         m_slotInUseMask |= (1 << slot);
-        m_dpbSlotsAvailable.pop();
+        m_firstSlotAvailable = (m_firstSlotAvailable + 1) % MAX_DPB_REF_AND_SETUP_SLOTS;
+        m_numSlotsAvailable--;
         m_dpb[slot].Reserve();
         return slot;
     }
@@ -271,7 +301,7 @@ public:
         assert(m_slotInUseMask & (1 << slot));
 
         m_dpb[slot].Invalidate();
-        m_dpbSlotsAvailable.push(slot);
+        PushSlotAvailable((uint8_t)slot);
         m_slotInUseMask &= ~(1 << slot);
     }
 
@@ -310,11 +340,22 @@ public:
 
     uint32_t getMaxSize() { return m_dpbMaxSize; }
 
+private:
+    void PushSlotAvailable(uint8_t slot)
+    {
+        assert(m_numSlotsAvailable < MAX_DPB_REF_AND_SETUP_SLOTS);
+        m_dpbSlotsAvailable[(m_firstSlotAvailable + m_numSlotsAvailable) % MAX_DPB_REF_AND_SETUP_SLOTS] = slot;
+        m_numSlotsAvailable++;
+    }
+
 private:
     uint32_t m_dpbMaxSize;
     uint32_t m_slotInUseMask;
     std::vector<DpbSlot> m_dpb;
-    std::queue<uint8_t> m_dpbSlotsAvailable;
+    // The free slots, oldest freed first, in a ring instead of the nodes of a std::queue allocated per picture
+    uint32_t m_numSlotsAvailable;
+    uint32_t m_firstSlotAvailable;
+    uint8_t  m_dpbSlotsAvailable[MAX_DPB_REF_AND_SETUP_SLOTS];
 };
 
 class VulkanVideoParser : public VkParserVideoDecodeClient,
@@ -552,7 +593,8 @@ protected:
         uint32_t bufferOffsetAlignment,
         uint32_t bufferSizeAlignment,
         bool outOfBandPictureParameters,
-        uint32_t errorThreshold);
+        uint32_t errorThreshold,
+        const VkParserDecodeFilter* pDecodeFilter);
 
     VulkanVideoParser(VkVideoCodecOperationFlagBitsKHR codecType,
         uint32_t maxNumDecodeSurfaces, uint32_t maxNumDpbSurfaces,
@@ -567,6 +609,16 @@ protected:
         vkPicBuffBase* pVkPicBuff,
         VkParserDecodePictureInfo* pDecodePictureInfo);
 
+    // The codec specific part of DecodePicture(), specialized per codec
+    template<VkVideoCodecOperationFlagBitsKHR codec>
+    bool FillPictureParameters(VkParserPictureData* pd,
+        VkParserPerFrameDecodeParameters* pCurrFrameDecParams,
+        VkParserDecodePictureInfo* pDecodePictureInfo);
+
+    typedef bool (VulkanVideoParser::*FillPictureParametersFunc)(VkParserPictureData* pd,
+        VkParserPerFrameDecodeParameters* pCurrFrameDecParams,
+        VkParserDecodePictureInfo* pDecodePictureInfo);
+
     int8_t GetPicIdx(vkPicBuffBase*);
     int8_t GetPicIdx(VkPicIf* pPicBuf);
     int8_t GetPicDpbSlot(vkPicBuffBase*);
@@ -607,6 +659,7 @@ protected:
     VkSharedBaseObj<IVulkanVideoFrameBufferParserCb> m_videoFrameBufferCb;
     std::atomic<int32_t> m_refCount;
     VkVideoCodecOperationFlagBitsKHR m_codecType;
+    FillPictureParametersFunc m_fillPictureParameters; // of the codec of the sequence
     uint32_t m_maxNumDecodeSurfaces;
     uint32_t m_maxNumDpbSlots;
     uint64_t m_clockRate;
@@ -618,6 +671,7 @@ protected:
     uint32_t m_outOfBandPictureParameters : 1;
     uint32_t m_inlinedPictureParametersUseBeginCoding : 1;
     int8_t m_pictureToDpbSlotMap[MAX_FRM_CNT];
+    nvVideoPerFrameDecodeArena m_frameArena;
 
 public:
     static bool m_dumpParserData;
@@ -627,6 +681,15 @@ public:
 bool VulkanVideoParser::m_dumpParserData = false;
 bool VulkanVideoParser::m_dumpDpbData = false;
 
+template<>
+bool VulkanVideoParser::FillPictureParameters<VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR>(
+    VkParserPictureData* pd, VkParserPerFrameDecodeParameters* pCurrFrameDecParams,
+    VkParserDecodePictureInfo* pDecodePictureInfo);
+template<>
+bool VulkanVideoParser::FillPictureParameters<VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR>(
+    VkParserPictureData* pd, VkParserPerFrameDecodeParameters* pCurrFrameDecParams,
+    VkParserDecodePictureInfo* pDecodePictureInfo);
+
 bool VulkanVideoParser::DecodePicture(VkParserPictureData* pd)
 {
     bool result = false;
@@ -670,6 +733,9 @@ bool VulkanVideoParser::DecodePicture(VkParserPictureData* pd)
     decodePictureInfo.flags.repeatFirstField = pd->repeat_first_field; // For 3:2 pulldown (number of additional fields,
         // 2 = frame doubling, 4 = frame tripling)
     decodePictureInfo.flags.refPic = pd->ref_pic_flag; // Frame is a reference frame
+    if (pd->bDTSValid) {
+        decodePictureInfo.timestamp = pd->llDTS;
+    }
 
     // Mark the first field as unpaired Detect unpaired fields
     if (pd->field_pic_flag) {
@@ -791,6 +857,7 @@ VulkanVideoParser::VulkanVideoParser(VkVideoCodecOperationFlagBitsKHR codecType,
     , m_videoFrameBufferCb()
     , m_refCount(0)
     , m_codecType(codecType)
+    , m_fillPictureParameters(nullptr)
     , m_maxNumDecodeSurfaces(maxNumDecodeSurfaces)
     , m_maxNumDpbSlots(maxNumDpbSurfaces)
     , m_clockRate(clockRate)
@@ -800,6 +867,7 @@ VulkanVideoParser::VulkanVideoParser(VkVideoCodecOperationFlagBitsKHR codecType,
     , m_dpb(3)
     , m_outOfBandPictureParameters(true)
     , m_inlinedPictureParametersUseBeginCoding(false)
+    , m_frameArena()
 {
     memset(&m_nvsi, 0, sizeof(m_nvsi));
     for (uint32_t picId = 0; picId < MAX_FRM_CNT; picId++) {
@@ -822,7 +890,8 @@ VkResult VulkanVideoParser::Initialize(
     uint32_t bufferOffsetAlignment,
     uint32_t bufferSizeAlignment,
     bool outOfBandPictureParameters,
-    uint32_t errorThreshold)
+    uint32_t errorThreshold,
+    const VkParserDecodeFilter* pDecodeFilter)
 {
     Deinitialize();
 
@@ -845,15 +914,25 @@ VkResult VulkanVideoParser::Initialize(
     nvdp.referenceClockRate = m_clockRate;
     nvdp.errorThreshold = errorThreshold;
     nvdp.outOfBandPictureParameters = outOfBandPictureParameters;
+    if (pDecodeFilter != nullptr) {
+        nvdp.decodeFilter = *pDecodeFilter;
+    }
 
     static const VkExtensionProperties h264StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H264_DECODE_SPEC_VERSION };
     static const VkExtensionProperties h265StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_H265_DECODE_SPEC_VERSION };
+#ifdef VK_EXT_video_decode_av1
+    static const VkExtensionProperties av1StdExtensionVersion = { VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_EXTENSION_NAME, VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_SPEC_VERSION };
+#endif // VK_EXT_video_decode_av1
 
     const VkExtensionProperties* pStdExtensionVersion = NULL;
     if (m_codecType == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
         pStdExtensionVersion = &h264StdExtensionVersion;
     } else if (m_codecType == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR) {
         pStdExtensionVersion = &h265StdExtensionVersion;
+#ifdef VK_EXT_video_decode_av1
+    } else if (m_codecType == VK_VIDEO_CODEC_OPERATION_DECODE_AV1_BIT_KHR) {
+        pStdExtensionVersion = &av1StdExtensionVersion;
+#endif // VK_EXT_video_decode_av1
     } else {
         assert(!"Unsupported codec type");
         return VK_ERROR_VIDEO_PROFILE_CODEC_NOT_SUPPORTED_KHR;
@@ -873,6 +952,8 @@ VkResult VulkanVideoParser::ParseVideoData(VkParserSourceDataPacket* pPacket,
                                            size_t *pParsedBytes,
                                            bool doPartialParsing)
 {
+    // Also has the decode of the pictures completed by the packet
+    VK_TRACE_ZONE("ParseByteStream");
     VkParserBitstreamPacket pkt;
     VkResult result;
 
@@ -889,7 +970,13 @@ VkResult VulkanVideoParser::ParseVideoData(VkParserSourceDataPacket* pPacket,
     pkt.bEOP = !!(pPacket->flags & VK_PARSER_PKT_ENDOFPICTURE);
     pkt.bPTSValid = !!(pPacket->flags & VK_PARSER_PKT_TIMESTAMP);
     pkt.llPTS = pPacket->timestamp;
+    pkt.bDTSValid = !!(pPacket->flags & VK_PARSER_PKT_DECODE_TIMESTAMP);
+    pkt.llDTS = pPacket->decodeTimestamp;
     pkt.bPartialParsing = doPartialParsing;
+    pkt.pStartCodeOffsets = pPacket->startCodeOffsets;
+    pkt.nStartCodeOffsets = pPacket->startCodeOffsetsCount;
+    pkt.nStartCodeScanLength = pPacket->startCodeScanLength;
+    pkt.nNalLengthSize = pPacket->nalLengthSize;
     if (m_vkParser->ParseByteStream(&pkt, pParsedBytes)) {
         result = VK_SUCCESS;
     } else {
@@ -976,14 +1063,14 @@ int8_t VulkanVideoParser::SetPicDpbSlot(vkPicBuffBase* pPicBuf,
 uint32_t VulkanVideoParser::ResetPicDpbSlots(uint32_t picIndexSlotValidMask)
 {
     uint32_t resetSlotsMask = ~(picIndexSlotValidMask | ~m_dpbSlotsMask);
-    if (resetSlotsMask != 0) {
-        for (uint32_t picIdx = 0;
-             ((picIdx < m_maxNumDecodeSurfaces) && resetSlotsMask); picIdx++) {
-            if (resetSlotsMask & (1 << picIdx)) {
-                resetSlotsMask &= ~(1 << picIdx);
-                SetPicDpbSlot(picIdx, -1);
-            }
+    // Only the pictures with a slot are visited
+    while (resetSlotsMask != 0) {
+        const uint32_t picIdx = CountTrailingZeros32(resetSlotsMask);
+        resetSlotsMask &= resetSlotsMask - 1;
+        if (picIdx >= m_maxNumDecodeSurfaces) {
+            break;
         }
+        SetPicDpbSlot((int8_t)picIdx, -1);
     }
     return m_dpbSlotsMask;
 }
@@ -1115,6 +1202,19 @@ int32_t VulkanVideoParser::BeginSequence(const VkParserSequenceInfo* pnvsi)
 
     m_maxNumDpbSlots = m_dpb.Init(configDpbSlots, sequenceUpdate /* reconfigure the DPB size if true */);
 
+    switch (pnvsi->eCodec) {
+    case VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR:
+        m_fillPictureParameters = &VulkanVideoParser::FillPictureParameters<VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR>;
+        break;
+    case VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR:
+        m_fillPictureParameters = &VulkanVideoParser::FillPictureParameters<VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR>;
+        break;
+    default:
+        // The other codecs fill their picture parameters in their parser
+        m_fillPictureParameters = nullptr;
+        break;
+    }
+
     return m_maxNumDecodeSurfaces;
 }
 
@@ -1272,18 +1372,16 @@ uint32_t VulkanVideoParser::FillDpbH264State(
 
     if (refDpbUsedAndValidMask) {
         // Find or allocate slots for non existing dpb items and populate the slots.
-        uint32_t dpbInUseMask = m_dpb.getSlotInUseMask();
-        int8_t firstNonExistingDpbSlot = 0;
+        // Each non existing item takes the lowest slot neither in use nor taken by a previous one.
+        uint32_t nonExistingDpbSlotsMask = ~m_dpb.getSlotInUseMask() & ((1U << m_maxNumDpbSlots) - 1);
         for (uint32_t dpbIdx = 0; dpbIdx < numUsedRef; dpbIdx++) {
             int8_t dpbSlot = -1;
             int8_t picIdx = -1;
             if (refOnlyDpbIn[dpbIdx].is_non_existing) {
                 assert(refOnlyDpbIn[dpbIdx].m_picBuff == NULL);
-                while (((uint32_t)firstNonExistingDpbSlot < m_maxNumDpbSlots) && (dpbSlot == -1)) {
-                    if (!(dpbInUseMask & (1 << firstNonExistingDpbSlot))) {
-                        dpbSlot = firstNonExistingDpbSlot;
-                    }
-                    firstNonExistingDpbSlot++;
+                if (nonExistingDpbSlotsMask != 0) {
+                    dpbSlot = (int8_t)CountTrailingZeros32(nonExistingDpbSlotsMask);
+                    nonExistingDpbSlotsMask &= nonExistingDpbSlotsMask - 1;
                 }
                 assert((dpbSlot >= 0) && ((uint32_t)dpbSlot < m_maxNumDpbSlots));
                 picIdx = bestNonExistingPicIdx;
@@ -1654,304 +1752,329 @@ bool VulkanVideoParser::UpdatePictureParameters(
     return false;
 }
 
-bool VulkanVideoParser::DecodePicture(
-    VkParserPictureData* pd, vkPicBuffBase* pVkPicBuff,
+// The codec paths of DecodePicture(), one per codec, the one of the stream is selected by BeginSequence(). The
+// DPB and the picture parameters of a codec are filled without branching on the codec per picture.
+template<>
+bool VulkanVideoParser::FillPictureParameters<VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR>(
+    VkParserPictureData* pd, VkParserPerFrameDecodeParameters* pCurrFrameDecParams,
     VkParserDecodePictureInfo* pDecodePictureInfo)
 {
-    bool bRet = false;
+    nvVideoH264PicParameters& h264 = m_frameArena.h264;
+    VkVideoReferenceSlotInfoKHR* const referenceSlots = m_frameArena.referenceSlots;
+    VkVideoReferenceSlotInfoKHR& setupReferenceSlot = m_frameArena.setupReferenceSlot;
 
-    // union {
-    nvVideoH264PicParameters h264;
-    nvVideoH265PicParameters hevc;
-    // };
+    const VkParserH264PictureData* const pin = &pd->CodecSpecific.h264;
 
-    if (m_decoderHandler == NULL) {
-        assert(!"m_pDecoderHandler is NULL");
-        return false;
-    }
+    h264 = nvVideoH264PicParameters();
 
-    if (!pd->pCurrPic) {
-        return false;
-    }
+    nvVideoH264PicParameters* const pout = &h264;
+    VkVideoDecodeH264PictureInfoKHR* pPictureInfo = &h264.pictureInfo;
+    nvVideoDecodeH264DpbSlotInfo* pDpbRefList = h264.dpbRefList;
+    StdVideoDecodeH264PictureInfo* pStdPictureInfo = &h264.stdPictureInfo;
 
-    const uint32_t PicIdx = GetPicIdx(pd->pCurrPic);
-    if (PicIdx >= MAX_FRM_CNT) {
-        assert(0);
-        return false;
+    pCurrFrameDecParams->pStdPps = pin->pStdPps;
+    pCurrFrameDecParams->pStdSps = pin->pStdSps;
+    pCurrFrameDecParams->pStdVps = nullptr;
+    if (false) {
+        std::cout << "\n\tCurrent h.264 Picture SPS update : "
+                << pin->pStdSps->GetUpdateSequenceCount() << std::endl;
+        std::cout << "\tCurrent h.264 Picture PPS update : "
+                << pin->pStdPps->GetUpdateSequenceCount() << std::endl;
     }
 
-    VkParserPerFrameDecodeParameters pictureParams = VkParserPerFrameDecodeParameters();
-    VkParserPerFrameDecodeParameters* pCurrFrameDecParams = &pictureParams;
-    pCurrFrameDecParams->currPicIdx = PicIdx;
-    pCurrFrameDecParams->numSlices = pd->numSlices;
-    pCurrFrameDecParams->firstSliceIndex = pd->firstSliceIndex;
-    pCurrFrameDecParams->bitstreamDataOffset = pd->bitstreamDataOffset;
-    pCurrFrameDecParams->bitstreamDataLen = pd->bitstreamDataLen;
-    pCurrFrameDecParams->bitstreamData = pd->bitstreamData;
-
-    VkVideoReferenceSlotInfoKHR
-        referenceSlots[VkParserPerFrameDecodeParameters::MAX_DPB_REF_AND_SETUP_SLOTS];
-    VkVideoReferenceSlotInfoKHR setupReferenceSlot = {
-        VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR, NULL,
-        -1, // slotIndex
-        NULL // pPictureResource
-    };
-
-    pCurrFrameDecParams->decodeFrameInfo.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_INFO_KHR;
-    pCurrFrameDecParams->decodeFrameInfo.dstPictureResource.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
-    pCurrFrameDecParams->dpbSetupPictureResource.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
-
-    if (m_codecType == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
-        const VkParserH264PictureData* const pin = &pd->CodecSpecific.h264;
-
-        h264 = nvVideoH264PicParameters();
-
-        nvVideoH264PicParameters* const pout = &h264;
-        VkVideoDecodeH264PictureInfoKHR* pPictureInfo = &h264.pictureInfo;
-        nvVideoDecodeH264DpbSlotInfo* pDpbRefList = h264.dpbRefList;
-        StdVideoDecodeH264PictureInfo* pStdPictureInfo = &h264.stdPictureInfo;
-
-        pCurrFrameDecParams->pStdPps = pin->pStdPps;
-        pCurrFrameDecParams->pStdSps = pin->pStdSps;
-        pCurrFrameDecParams->pStdVps = nullptr;
-        if (false) {
-            std::cout << "\n\tCurrent h.264 Picture SPS update : "
-                    << pin->pStdSps->GetUpdateSequenceCount() << std::endl;
-            std::cout << "\tCurrent h.264 Picture PPS update : "
-                    << pin->pStdPps->GetUpdateSequenceCount() << std::endl;
-        }
-
-        pDecodePictureInfo->videoFrameType = 0; // pd->CodecSpecific.h264.slice_type;
-        // FIXME: If mvcext is enabled.
-        pDecodePictureInfo->viewId = pd->CodecSpecific.h264.mvcext.view_id;
+    pDecodePictureInfo->videoFrameType = 0; // pd->CodecSpecific.h264.slice_type;
+    // FIXME: If mvcext is enabled.
+    pDecodePictureInfo->viewId = pd->CodecSpecific.h264.mvcext.view_id;
 
-        pPictureInfo->pStdPictureInfo = &h264.stdPictureInfo;
+    pPictureInfo->pStdPictureInfo = &h264.stdPictureInfo;
 
-        pPictureInfo->sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_PICTURE_INFO_KHR;
+    pPictureInfo->sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_PICTURE_INFO_KHR;
 
-        if (!m_outOfBandPictureParameters) {
-            // In-band h264 Picture Parameters for testing
-            h264.pictureParameters.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_SESSION_PARAMETERS_ADD_INFO_KHR;
-            h264.pictureParameters.stdSPSCount = 1;
-            h264.pictureParameters.pStdSPSs = pin->pStdSps->GetStdH264Sps();
-            h264.pictureParameters.stdPPSCount = 1;
-            h264.pictureParameters.pStdPPSs = pin->pStdPps->GetStdH264Pps();
-            if (m_inlinedPictureParametersUseBeginCoding) {
-                pCurrFrameDecParams->beginCodingInfoPictureParametersExt = &h264.pictureParameters;
-                pPictureInfo->pNext = nullptr;
-            } else {
-                pPictureInfo->pNext = &h264.pictureParameters;
-            }
-            pCurrFrameDecParams->useInlinedPictureParameters = true;
-        } else {
+    if (!m_outOfBandPictureParameters) {
+        // In-band h264 Picture Parameters for testing
+        h264.pictureParameters.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_SESSION_PARAMETERS_ADD_INFO_KHR;
+        h264.pictureParameters.stdSPSCount = 1;
+        h264.pictureParameters.pStdSPSs = pin->pStdSps->GetStdH264Sps();
+        h264.pictureParameters.stdPPSCount = 1;
+        h264.pictureParameters.pStdPPSs = pin->pStdPps->GetStdH264Pps();
+        if (m_inlinedPictureParametersUseBeginCoding) {
+            pCurrFrameDecParams->beginCodingInfoPictureParametersExt = &h264.pictureParameters;
             pPictureInfo->pNext = nullptr;
-        }
-
-        pCurrFrameDecParams->decodeFrameInfo.pNext = &h264.pictureInfo;
-
-        pStdPictureInfo->pic_parameter_set_id = pin->pic_parameter_set_id; // PPS ID
-        pStdPictureInfo->seq_parameter_set_id = pin->seq_parameter_set_id; // SPS ID;
-
-        pStdPictureInfo->frame_num = (uint16_t)pin->frame_num;
-        pPictureInfo->sliceCount = pd->numSlices;
-        uint32_t maxSliceCount = 0;
-        assert(pd->firstSliceIndex == 0); // No slice and MV modes are supported yet
-        pPictureInfo->pSliceOffsets = pd->bitstreamData->GetStreamMarkersPtr(pd->firstSliceIndex, maxSliceCount);
-        assert(maxSliceCount == pd->numSlices);
-
-        StdVideoDecodeH264PictureInfoFlags currPicFlags = StdVideoDecodeH264PictureInfoFlags();
-        currPicFlags.is_intra = (pd->intra_pic_flag != 0);
-        // 0 = frame picture, 1 = field picture
-        if (pd->field_pic_flag) {
-            // 0 = top field, 1 = bottom field (ignored if field_pic_flag = 0)
-            currPicFlags.field_pic_flag = true;
-            if (pd->bottom_field_flag) {
-                currPicFlags.bottom_field_flag = true;
-            }
-        }
-        // Second field of a complementary field pair
-        if (pd->second_field) {
-            currPicFlags.complementary_field_pair = true;
-        }
-        // Frame is a reference frame
-        if (pd->ref_pic_flag) {
-            currPicFlags.is_reference = true;
-        }
-        pStdPictureInfo->flags = currPicFlags;
-        if (!pd->field_pic_flag) {
-            pStdPictureInfo->PicOrderCnt[0] = pin->CurrFieldOrderCnt[0];
-            pStdPictureInfo->PicOrderCnt[1] = pin->CurrFieldOrderCnt[1];
         } else {
-            pStdPictureInfo->PicOrderCnt[pd->bottom_field_flag] = pin->CurrFieldOrderCnt[pd->bottom_field_flag];
+            pPictureInfo->pNext = &h264.pictureParameters;
         }
+        pCurrFrameDecParams->useInlinedPictureParameters = true;
+    } else {
+        pPictureInfo->pNext = nullptr;
+    }
 
-        const uint32_t maxDpbInputSlots = sizeof(pin->dpb) / sizeof(pin->dpb[0]);
-        pCurrFrameDecParams->numGopReferenceSlots = FillDpbH264State(
-            pd, pin->dpb, maxDpbInputSlots, pDpbRefList,
-            VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS, // 16 reference pictures
-            referenceSlots, pCurrFrameDecParams->pGopReferenceImagesIndexes,
-            h264.stdPictureInfo.flags, &setupReferenceSlot.slotIndex);
-        // TODO: Remove it is for debugging only. Reserved fields must be set to "0".
-        pout->stdPictureInfo.reserved1 = pCurrFrameDecParams->numGopReferenceSlots;
-        assert(!pd->ref_pic_flag || (setupReferenceSlot.slotIndex >= 0));
-        if (setupReferenceSlot.slotIndex >= 0) {
-            setupReferenceSlot.pPictureResource = &pCurrFrameDecParams->dpbSetupPictureResource;
-            pCurrFrameDecParams->decodeFrameInfo.pSetupReferenceSlot = &setupReferenceSlot;
-        }
-        if (pCurrFrameDecParams->numGopReferenceSlots) {
-            assert(pCurrFrameDecParams->numGopReferenceSlots <= (int32_t)MAX_DPB_REF_SLOTS);
-            for (uint32_t dpbEntryIdx = 0; dpbEntryIdx < (uint32_t)pCurrFrameDecParams->numGopReferenceSlots;
-                 dpbEntryIdx++) {
-                pCurrFrameDecParams->pictureResources[dpbEntryIdx].sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
-                referenceSlots[dpbEntryIdx].pPictureResource = &pCurrFrameDecParams->pictureResources[dpbEntryIdx];
-                assert(pDpbRefList[dpbEntryIdx].IsReference());
-            }
+    pCurrFrameDecParams->decodeFrameInfo.pNext = &h264.pictureInfo;
 
-            pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = referenceSlots;
-            pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = pCurrFrameDecParams->numGopReferenceSlots;
-        } else {
-            pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = NULL;
-            pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = 0;
-        }
+    pStdPictureInfo->pic_parameter_set_id = pin->pic_parameter_set_id; // PPS ID
+    pStdPictureInfo->seq_parameter_set_id = pin->seq_parameter_set_id; // SPS ID;
 
-    } else if (m_codecType == VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR) {
-        const VkParserHevcPictureData* const pin = &pd->CodecSpecific.hevc;
-        hevc = nvVideoH265PicParameters();
-        VkVideoDecodeH265PictureInfoKHR* pPictureInfo = &hevc.pictureInfo;
-        StdVideoDecodeH265PictureInfo* pStdPictureInfo = &hevc.stdPictureInfo;
-        nvVideoDecodeH265DpbSlotInfo* pDpbRefList = hevc.dpbRefList;
-
-        pCurrFrameDecParams->pStdPps = pin->pStdPps;
-        pCurrFrameDecParams->pStdSps = pin->pStdSps;
-        pCurrFrameDecParams->pStdVps = pin->pStdVps;
-        if (false) {
-            std::cout << "\n\tCurrent h.265 Picture VPS update : "
-                    << pin->pStdVps->GetUpdateSequenceCount() << std::endl;
-            std::cout << "\n\tCurrent h.265 Picture SPS update : "
-                    << pin->pStdSps->GetUpdateSequenceCount() << std::endl;
-            std::cout << "\tCurrent h.265 Picture PPS update : "
-                    << pin->pStdPps->GetUpdateSequenceCount() << std::endl;
+    pStdPictureInfo->frame_num = (uint16_t)pin->frame_num;
+    pPictureInfo->sliceCount = pd->numSlices;
+    uint32_t maxSliceCount = 0;
+    assert(pd->firstSliceIndex == 0); // No slice and MV modes are supported yet
+    pPictureInfo->pSliceOffsets = pCurrFrameDecParams->bitstreamData->GetStreamMarkersPtr(
+        pd->firstSliceIndex, maxSliceCount);
+    assert(maxSliceCount == pd->numSlices);
+
+    StdVideoDecodeH264PictureInfoFlags currPicFlags = StdVideoDecodeH264PictureInfoFlags();
+    currPicFlags.is_intra = (pd->intra_pic_flag != 0);
+    // 0 = frame picture, 1 = field picture
+    if (pd->field_pic_flag) {
+        // 0 = top field, 1 = bottom field (ignored if field_pic_flag = 0)
+        currPicFlags.field_pic_flag = true;
+        if (pd->bottom_field_flag) {
+            currPicFlags.bottom_field_flag = true;
         }
+    }
+    // Second field of a complementary field pair
+    if (pd->second_field) {
+        currPicFlags.complementary_field_pair = true;
+    }
+    // Frame is a reference frame
+    if (pd->ref_pic_flag) {
+        currPicFlags.is_reference = true;
+    }
+    pStdPictureInfo->flags = currPicFlags;
+    if (!pd->field_pic_flag) {
+        pStdPictureInfo->PicOrderCnt[0] = pin->CurrFieldOrderCnt[0];
+        pStdPictureInfo->PicOrderCnt[1] = pin->CurrFieldOrderCnt[1];
+    } else {
+        pStdPictureInfo->PicOrderCnt[pd->bottom_field_flag] = pin->CurrFieldOrderCnt[pd->bottom_field_flag];
+    }
+
+    const uint32_t maxDpbInputSlots = sizeof(pin->dpb) / sizeof(pin->dpb[0]);
+    pCurrFrameDecParams->numGopReferenceSlots = FillDpbH264State(
+        pd, pin->dpb, maxDpbInputSlots, pDpbRefList,
+        VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS, // 16 reference pictures
+        referenceSlots, pCurrFrameDecParams->pGopReferenceImagesIndexes,
+        h264.stdPictureInfo.flags, &setupReferenceSlot.slotIndex);
+    // TODO: Remove it is for debugging only. Reserved fields must be set to "0".
+    pout->stdPictureInfo.reserved1 = pCurrFrameDecParams->numGopReferenceSlots;
+    assert(!pd->ref_pic_flag || (setupReferenceSlot.slotIndex >= 0));
+    if (setupReferenceSlot.slotIndex >= 0) {
+        setupReferenceSlot.pPictureResource = &pCurrFrameDecParams->dpbSetupPictureResource;
+        pCurrFrameDecParams->decodeFrameInfo.pSetupReferenceSlot = &setupReferenceSlot;
+    }
+    if (pCurrFrameDecParams->numGopReferenceSlots) {
+        assert(pCurrFrameDecParams->numGopReferenceSlots <= (int32_t)MAX_DPB_REF_SLOTS);
+        for (uint32_t dpbEntryIdx = 0; dpbEntryIdx < (uint32_t)pCurrFrameDecParams->numGopReferenceSlots;
+             dpbEntryIdx++) {
+            pCurrFrameDecParams->pictureResources[dpbEntryIdx].sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+            referenceSlots[dpbEntryIdx].pPictureResource = &pCurrFrameDecParams->pictureResources[dpbEntryIdx];
+            assert(pDpbRefList[dpbEntryIdx].IsReference());
+        }
+
+        pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = referenceSlots;
+        pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = pCurrFrameDecParams->numGopReferenceSlots;
+    } else {
+        pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = NULL;
+        pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = 0;
+    }
+    return true;
+}
 
-        pPictureInfo->sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_PICTURE_INFO_KHR;
-
-        if (!m_outOfBandPictureParameters) {
-            // In-band h265 Picture Parameters for testing
-            hevc.pictureParameters.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_SESSION_PARAMETERS_ADD_INFO_KHR;
-            hevc.pictureParameters.stdVPSCount = 1;
-            hevc.pictureParameters.pStdVPSs = pin->pStdVps->GetStdH265Vps();
-            hevc.pictureParameters.stdSPSCount = 1;
-            hevc.pictureParameters.pStdSPSs = pin->pStdSps->GetStdH265Sps();
-            hevc.pictureParameters.stdPPSCount = 1;
-            hevc.pictureParameters.pStdPPSs = pin->pStdPps->GetStdH265Pps();
-            if (m_inlinedPictureParametersUseBeginCoding) {
-                pCurrFrameDecParams->beginCodingInfoPictureParametersExt = &hevc.pictureParameters;
-                pPictureInfo->pNext = nullptr;
-            } else {
-                pPictureInfo->pNext = &hevc.pictureParameters;
-            }
-            pCurrFrameDecParams->useInlinedPictureParameters = true;
-        } else {
+template<>
+bool VulkanVideoParser::FillPictureParameters<VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR>(
+    VkParserPictureData* pd, VkParserPerFrameDecodeParameters* pCurrFrameDecParams,
+    VkParserDecodePictureInfo* pDecodePictureInfo)
+{
+    nvVideoH265PicParameters& hevc = m_frameArena.hevc;
+    VkVideoReferenceSlotInfoKHR* const referenceSlots = m_frameArena.referenceSlots;
+    VkVideoReferenceSlotInfoKHR& setupReferenceSlot = m_frameArena.setupReferenceSlot;
+
+    const VkParserHevcPictureData* const pin = &pd->CodecSpecific.hevc;
+    hevc = nvVideoH265PicParameters();
+    VkVideoDecodeH265PictureInfoKHR* pPictureInfo = &hevc.pictureInfo;
+    StdVideoDecodeH265PictureInfo* pStdPictureInfo = &hevc.stdPictureInfo;
+    nvVideoDecodeH265DpbSlotInfo* pDpbRefList = hevc.dpbRefList;
+
+    pCurrFrameDecParams->pStdPps = pin->pStdPps;
+    pCurrFrameDecParams->pStdSps = pin->pStdSps;
+    pCurrFrameDecParams->pStdVps = pin->pStdVps;
+    if (false) {
+        std::cout << "\n\tCurrent h.265 Picture VPS update : "
+                << pin->pStdVps->GetUpdateSequenceCount() << std::endl;
+        std::cout << "\n\tCurrent h.265 Picture SPS update : "
+                << pin->pStdSps->GetUpdateSequenceCount() << std::endl;
+        std::cout << "\tCurrent h.265 Picture PPS update : "
+                << pin->pStdPps->GetUpdateSequenceCount() << std::endl;
+    }
+
+    pPictureInfo->sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_PICTURE_INFO_KHR;
+
+    if (!m_outOfBandPictureParameters) {
+        // In-band h265 Picture Parameters for testing
+        hevc.pictureParameters.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H265_SESSION_PARAMETERS_ADD_INFO_KHR;
+        hevc.pictureParameters.stdVPSCount = 1;
+        hevc.pictureParameters.pStdVPSs = pin->pStdVps->GetStdH265Vps();
+        hevc.pictureParameters.stdSPSCount = 1;
+        hevc.pictureParameters.pStdSPSs = pin->pStdSps->GetStdH265Sps();
+        hevc.pictureParameters.stdPPSCount = 1;
+        hevc.pictureParameters.pStdPPSs = pin->pStdPps->GetStdH265Pps();
+        if (m_inlinedPictureParametersUseBeginCoding) {
+            pCurrFrameDecParams->beginCodingInfoPictureParametersExt = &hevc.pictureParameters;
             pPictureInfo->pNext = nullptr;
+        } else {
+            pPictureInfo->pNext = &hevc.pictureParameters;
         }
+        pCurrFrameDecParams->useInlinedPictureParameters = true;
+    } else {
+        pPictureInfo->pNext = nullptr;
+    }
 
-        pPictureInfo->pStdPictureInfo = &hevc.stdPictureInfo;
-        pCurrFrameDecParams->decodeFrameInfo.pNext = &hevc.pictureInfo;
+    pPictureInfo->pStdPictureInfo = &hevc.stdPictureInfo;
+    pCurrFrameDecParams->decodeFrameInfo.pNext = &hevc.pictureInfo;
 
-        pDecodePictureInfo->videoFrameType = 0; // pd->CodecSpecific.hevc.SliceType;
-        if (pd->CodecSpecific.hevc.mv_hevc_enable) {
-            pDecodePictureInfo->viewId = pd->CodecSpecific.hevc.nuh_layer_id;
-        } else {
-            pDecodePictureInfo->viewId = 0;
-        }
+    pDecodePictureInfo->videoFrameType = 0; // pd->CodecSpecific.hevc.SliceType;
+    if (pd->CodecSpecific.hevc.mv_hevc_enable) {
+        pDecodePictureInfo->viewId = pd->CodecSpecific.hevc.nuh_layer_id;
+    } else {
+        pDecodePictureInfo->viewId = 0;
+    }
 
-        pPictureInfo->sliceSegmentCount = pd->numSlices;
-        uint32_t maxSliceCount = 0;
-        assert(pd->firstSliceIndex == 0); // No slice and MV modes are supported yet
-        pPictureInfo->pSliceSegmentOffsets = pd->bitstreamData->GetStreamMarkersPtr(pd->firstSliceIndex, maxSliceCount);
-        assert(maxSliceCount == pd->numSlices);
+    pPictureInfo->sliceSegmentCount = pd->numSlices;
+    uint32_t maxSliceCount = 0;
+    assert(pd->firstSliceIndex == 0); // No slice and MV modes are supported yet
+    pPictureInfo->pSliceSegmentOffsets = pCurrFrameDecParams->bitstreamData->GetStreamMarkersPtr(
+        pd->firstSliceIndex, maxSliceCount);
+    assert(maxSliceCount == pd->numSlices);
 
-        pStdPictureInfo->pps_pic_parameter_set_id   = pin->pic_parameter_set_id;       // PPS ID
-        pStdPictureInfo->pps_seq_parameter_set_id   = pin->seq_parameter_set_id;       // SPS ID
-        pStdPictureInfo->sps_video_parameter_set_id = pin->vps_video_parameter_set_id; // VPS ID
+    pStdPictureInfo->pps_pic_parameter_set_id   = pin->pic_parameter_set_id;       // PPS ID
+    pStdPictureInfo->pps_seq_parameter_set_id   = pin->seq_parameter_set_id;       // SPS ID
+    pStdPictureInfo->sps_video_parameter_set_id = pin->vps_video_parameter_set_id; // VPS ID
 
-        // hevc->irapPicFlag = m_slh.nal_unit_type >= NUT_BLA_W_LP &&
-        // m_slh.nal_unit_type <= NUT_CRA_NUT;
-        pStdPictureInfo->flags.IrapPicFlag = pin->IrapPicFlag; // Intra Random Access Point for current picture.
-        // hevc->idrPicFlag = m_slh.nal_unit_type == NUT_IDR_W_RADL ||
-        // m_slh.nal_unit_type == NUT_IDR_N_LP;
-        pStdPictureInfo->flags.IdrPicFlag = pin->IdrPicFlag; // Instantaneous Decoding Refresh for current picture.
+    // hevc->irapPicFlag = m_slh.nal_unit_type >= NUT_BLA_W_LP &&
+    // m_slh.nal_unit_type <= NUT_CRA_NUT;
+    pStdPictureInfo->flags.IrapPicFlag = pin->IrapPicFlag; // Intra Random Access Point for current picture.
+    // hevc->idrPicFlag = m_slh.nal_unit_type == NUT_IDR_W_RADL ||
+    // m_slh.nal_unit_type == NUT_IDR_N_LP;
+    pStdPictureInfo->flags.IdrPicFlag = pin->IdrPicFlag; // Instantaneous Decoding Refresh for current picture.
 
-        // NumBitsForShortTermRPSInSlice = s->sh.short_term_rps ?
-        // s->sh.short_term_ref_pic_set_size : 0
-        pStdPictureInfo->NumBitsForSTRefPicSetInSlice = pin->NumBitsForShortTermRPSInSlice;
+    // NumBitsForShortTermRPSInSlice = s->sh.short_term_rps ?
+    // s->sh.short_term_ref_pic_set_size : 0
+    pStdPictureInfo->NumBitsForSTRefPicSetInSlice = pin->NumBitsForShortTermRPSInSlice;
 
-        // NumDeltaPocsOfRefRpsIdx = s->sh.short_term_rps ?
-        // s->sh.short_term_rps->rps_idx_num_delta_pocs : 0
-        pStdPictureInfo->NumDeltaPocsOfRefRpsIdx = pin->NumDeltaPocsOfRefRpsIdx;
-        pStdPictureInfo->PicOrderCntVal = pin->CurrPicOrderCntVal;
+    // NumDeltaPocsOfRefRpsIdx = s->sh.short_term_rps ?
+    // s->sh.short_term_rps->rps_idx_num_delta_pocs : 0
+    pStdPictureInfo->NumDeltaPocsOfRefRpsIdx = pin->NumDeltaPocsOfRefRpsIdx;
+    pStdPictureInfo->PicOrderCntVal = pin->CurrPicOrderCntVal;
 
-        if (m_dumpParserData)
-            std::cout << "\tnumPocStCurrBefore: " << (int32_t)pin->NumPocStCurrBefore
-                      << " numPocStCurrAfter: " << (int32_t)pin->NumPocStCurrAfter
-                      << " numPocLtCurr: " << (int32_t)pin->NumPocLtCurr << std::endl;
-
-        pCurrFrameDecParams->numGopReferenceSlots = FillDpbH265State(pd, pin, pDpbRefList, pStdPictureInfo,
-                VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS, // max 16 reference pictures
-            referenceSlots, pCurrFrameDecParams->pGopReferenceImagesIndexes,
-            &setupReferenceSlot.slotIndex);
-
-        assert(!pd->ref_pic_flag || (setupReferenceSlot.slotIndex >= 0));
-        if (setupReferenceSlot.slotIndex >= 0) {
-            setupReferenceSlot.pPictureResource = &pCurrFrameDecParams->dpbSetupPictureResource;
-            pCurrFrameDecParams->decodeFrameInfo.pSetupReferenceSlot = &setupReferenceSlot;
-        }
+    if (m_dumpParserData)
+        std::cout << "\tnumPocStCurrBefore: " << (int32_t)pin->NumPocStCurrBefore
+                  << " numPocStCurrAfter: " << (int32_t)pin->NumPocStCurrAfter
+                  << " numPocLtCurr: " << (int32_t)pin->NumPocLtCurr << std::endl;
 
-        if (pCurrFrameDecParams->numGopReferenceSlots) {
-            assert(pCurrFrameDecParams->numGopReferenceSlots <= (int32_t)MAX_DPB_REF_SLOTS);
-            for (uint32_t dpbEntryIdx = 0; dpbEntryIdx < (uint32_t)pCurrFrameDecParams->numGopReferenceSlots;
-                 dpbEntryIdx++) {
-                pCurrFrameDecParams->pictureResources[dpbEntryIdx].sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
-                referenceSlots[dpbEntryIdx].pPictureResource = &pCurrFrameDecParams->pictureResources[dpbEntryIdx];
-                assert(pDpbRefList[dpbEntryIdx].IsReference());
-            }
+    pCurrFrameDecParams->numGopReferenceSlots = FillDpbH265State(pd, pin, pDpbRefList, pStdPictureInfo,
+            VkParserPerFrameDecodeParameters::MAX_DPB_REF_SLOTS, // max 16 reference pictures
+        referenceSlots, pCurrFrameDecParams->pGopReferenceImagesIndexes,
+        &setupReferenceSlot.slotIndex);
 
-            pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = referenceSlots;
-            pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = pCurrFrameDecParams->numGopReferenceSlots;
-        } else {
-            pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = NULL;
-            pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = 0;
+    assert(!pd->ref_pic_flag || (setupReferenceSlot.slotIndex >= 0));
+    if (setupReferenceSlot.slotIndex >= 0) {
+        setupReferenceSlot.pPictureResource = &pCurrFrameDecParams->dpbSetupPictureResource;
+        pCurrFrameDecParams->decodeFrameInfo.pSetupReferenceSlot = &setupReferenceSlot;
+    }
+
+    if (pCurrFrameDecParams->numGopReferenceSlots) {
+        assert(pCurrFrameDecParams->numGopReferenceSlots <= (int32_t)MAX_DPB_REF_SLOTS);
+        for (uint32_t dpbEntryIdx = 0; dpbEntryIdx < (uint32_t)pCurrFrameDecParams->numGopReferenceSlots;
+             dpbEntryIdx++) {
+            pCurrFrameDecParams->pictureResources[dpbEntryIdx].sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+            referenceSlots[dpbEntryIdx].pPictureResource = &pCurrFrameDecParams->pictureResources[dpbEntryIdx];
+            assert(pDpbRefList[dpbEntryIdx].IsReference());
         }
 
-        if (m_dumpParserData) {
-            for (int32_t i = 0; i < HEVC_MAX_DPB_SLOTS; i++) {
-                std::cout << "\tdpbIndex: " << i;
-                if (pDpbRefList[i]) {
-                    std::cout << " REFERENCE FRAME";
+        pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = referenceSlots;
+        pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = pCurrFrameDecParams->numGopReferenceSlots;
+    } else {
+        pCurrFrameDecParams->decodeFrameInfo.pReferenceSlots = NULL;
+        pCurrFrameDecParams->decodeFrameInfo.referenceSlotCount = 0;
+    }
 
-                    std::cout << " picOrderCntValList: "
-                              << (int32_t)pDpbRefList[i]
-                                     .dpbSlotInfo.pStdReferenceInfo->PicOrderCntVal;
+    if (m_dumpParserData) {
+        for (int32_t i = 0; i < HEVC_MAX_DPB_SLOTS; i++) {
+            std::cout << "\tdpbIndex: " << i;
+            if (pDpbRefList[i]) {
+                std::cout << " REFERENCE FRAME";
 
-                    std::cout << "\t\t Flags: ";
-                    if (pDpbRefList[i]
-                            .dpbSlotInfo.pStdReferenceInfo->flags.used_for_long_term_reference) {
-                        std::cout << "IS LONG TERM ";
-                    }
+                std::cout << " picOrderCntValList: "
+                          << (int32_t)pDpbRefList[i]
+                                 .dpbSlotInfo.pStdReferenceInfo->PicOrderCntVal;
 
-                } else {
-                    std::cout << " NOT A REFERENCE ";
+                std::cout << "\t\t Flags: ";
+                if (pDpbRefList[i]
+                        .dpbSlotInfo.pStdReferenceInfo->flags.used_for_long_term_reference) {
+                    std::cout << "IS LONG TERM ";
                 }
-                std::cout << std::endl;
+
+            } else {
+                std::cout << " NOT A REFERENCE ";
             }
+            std::cout << std::endl;
         }
+    }
+    return true;
+}
+
+bool VulkanVideoParser::DecodePicture(
+    VkParserPictureData* pd, vkPicBuffBase* pVkPicBuff,
+    VkParserDecodePictureInfo* pDecodePictureInfo)
+{
+    bool bRet = false;
 
+    if (m_decoderHandler == NULL) {
+        assert(!"m_pDecoderHandler is NULL");
+        return false;
+    }
+
+    if (!pd->pCurrPic) {
+        return false;
+    }
+
+    const uint32_t PicIdx = GetPicIdx(pd->pCurrPic);
+    if (PicIdx >= MAX_FRM_CNT) {
+        assert(0);
+        return false;
+    }
+
+    VkVideoReferenceSlotInfoKHR& setupReferenceSlot = m_frameArena.setupReferenceSlot;
+
+    m_frameArena.pictureParams = VkParserPerFrameDecodeParameters();
+    VkParserPerFrameDecodeParameters* pCurrFrameDecParams = &m_frameArena.pictureParams;
+    pCurrFrameDecParams->currPicIdx = PicIdx;
+    pCurrFrameDecParams->numSlices = pd->numSlices;
+    pCurrFrameDecParams->firstSliceIndex = pd->firstSliceIndex;
+    pCurrFrameDecParams->bitstreamDataOffset = pd->bitstreamDataOffset;
+    pCurrFrameDecParams->bitstreamDataLen = pd->bitstreamDataLen;
+    // The picture data is not used past its decode, its reference to the bitstream moves to the frame.
+    // The slice offsets below point into the buffer, valid as long as the frame holds it.
+    pCurrFrameDecParams->bitstreamData = std::move(pd->bitstreamData);
+
+    setupReferenceSlot.sType = VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR;
+    setupReferenceSlot.pNext = NULL;
+    setupReferenceSlot.slotIndex = -1;
+    setupReferenceSlot.pPictureResource = NULL;
+
+    pCurrFrameDecParams->decodeFrameInfo.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_INFO_KHR;
+    pCurrFrameDecParams->decodeFrameInfo.dstPictureResource.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+    pCurrFrameDecParams->dpbSetupPictureResource.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+
+    if ((m_fillPictureParameters != nullptr) &&
+            !(this->*m_fillPictureParameters)(pd, pCurrFrameDecParams, pDecodePictureInfo)) {
+        return false;
     }
 
     pDecodePictureInfo->displayWidth  = m_nvsi.nDisplayWidth;
     pDecodePictureInfo->displayHeight = m_nvsi.nDisplayHeight;
 
     bRet = (m_decoderHandler->DecodePictureWithParameters(pCurrFrameDecParams, pDecodePictureInfo) >= 0);
+    // The frame buffer holds its own reference to the bitstream once the picture is queued
+    pCurrFrameDecParams->bitstreamData = nullptr;
 
     if (m_dumpParserData) {
         std::cout << "\t <== VulkanVideoParser::DecodePicture " << PicIdx << std::endl;
@@ -1972,6 +2095,7 @@ VkResult IVulkanVideoParser::Create(
     uint32_t bufferSizeAlignment,
     uint64_t clockRate,
     uint32_t errorThreshold,
+    const VkParserDecodeFilter* pDecodeFilter,
     VkSharedBaseObj<IVulkanVideoParser>& vulkanVideoParser)
 {
     if (!decoderHandler || !videoFrameBufferCb) {
@@ -1992,7 +2116,8 @@ VkResult IVulkanVideoParser::Create(
                                                           bufferOffsetAlignment,
                                                           bufferSizeAlignment,
                                                           outOfBandPictureParameters,
-                                                          errorThreshold);
+                                                          errorThreshold,
+                                                          pDecodeFilter);
 
         if (result != VK_SUCCESS) {
             return result;
@@ -2017,6 +2142,7 @@ VkResult vulkanCreateVideoParser(
             uint32_t bufferOffsetAlignment,
             uint32_t bufferSizeAlignment,
             uint64_t clockRate,
+            const VkParserDecodeFilter* pDecodeFilter,
             VkSharedBaseObj<IVulkanVideoParser>& vulkanVideoParser)
 {
     if (videoCodecOperation == VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR) {
@@ -2029,6 +2155,13 @@ VkResult vulkanCreateVideoParser(
             assert(!"Decoder h265 Codec version is NOT supported");
             return VK_ERROR_VIDEO_STD_VERSION_NOT_SUPPORTED_KHR;
         }
+#ifdef VK_EXT_video_decode_av1
+    } else if (videoCodecOperation == VK_VIDEO_CODEC_OPERATION_DECODE_AV1_BIT_KHR) {
+        if (!pStdExtensionVersion || strcmp(pStdExtensionVersion->extensionName, VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_EXTENSION_NAME) || (pStdExtensionVersion->specVersion != VK_STD_VULKAN_VIDEO_CODEC_AV1_DECODE_SPEC_VERSION)) {
+            assert(!"Decoder AV1 Codec version is NOT supported");
+            return VK_ERROR_VIDEO_STD_VERSION_NOT_SUPPORTED_KHR;
+        }
+#endif // VK_EXT_video_decode_av1
     } else {
         assert(!"Decoder Codec is NOT supported");
         return VK_ERROR_VIDEO_PROFILE_CODEC_NOT_SUPPORTED_KHR;
@@ -2043,5 +2176,6 @@ VkResult vulkanCreateVideoParser(
                                       bufferSizeAlignment,
                                       clockRate,
                                       0, // errorThreshold
+                                      pDecodeFilter,
                                       vulkanVideoParser);
 }
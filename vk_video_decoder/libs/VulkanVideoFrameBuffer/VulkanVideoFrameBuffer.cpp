@@ -15,6 +15,7 @@
 */
 
 #include <algorithm>
+#include <bitset>
 #include <atomic>
 #include <chrono>
 #include <iostream>
@@ -32,6 +33,9 @@
 #include "VkVideoCore/VkVideoCoreProfile.h"
 #include "VulkanVideoFrameBuffer.h"
 #include "VkCodecUtils/VkImageResource.h"
+#include "VkCodecUtils/VulkanVideoSharedImagePool.h"
+#include "VkCodecUtils/VulkanSpscRingQueue.h"
+#include "VkCodecUtils/VulkanAtomicBitMask.h"
 
 static VkSharedBaseObj<VkImageResourceView> emptyImageView;
 
@@ -43,6 +47,10 @@ public:
         , m_frameCompleteSemaphore()
         , m_frameConsumerDoneFence()
         , m_frameConsumerDoneSemaphore()
+        , m_frameCompleteTimelineSemaphore()
+        , m_frameCompleteTimelineValue(0)
+        , m_consumerDoneTimelineSemaphore()
+        , m_consumerDoneTimelineValue(0)
         , m_hasFrameCompleteSignalFence(false)
         , m_hasFrameCompleteSignalSemaphore(false)
         , m_hasConsummerSignalFence(false)
@@ -51,14 +59,23 @@ public:
         , m_inDisplayQueue(false)
         , m_ownedByDisplay(false)
         , m_recreateImage(false)
+        , m_lastReserveNum(0)
         , m_currentDpbImageLayerLayout(VK_IMAGE_LAYOUT_UNDEFINED)
         , m_currentOutputImageLayout(VK_IMAGE_LAYOUT_UNDEFINED)
         , m_vkDevCtx()
         , m_frameDpbImageView()
         , m_outImageView()
+        , m_availablePictures()
+        , m_imageIndex(0)
     {
     }
 
+    void SetAvailablePicturesMask(VulkanAtomicBitMask* availablePictures, uint32_t imageIndex)
+    {
+        m_availablePictures = availablePictures;
+        m_imageIndex = imageIndex;
+    }
+
     VkResult CreateImage( const VulkanDeviceContext* vkDevCtx,
                           const VkImageCreateInfo* pDpbImageCreateInfo,
                           const VkImageCreateInfo* pOutImageCreateInfo,
@@ -68,9 +85,10 @@ public:
                           VkSharedBaseObj<VkImageResource>&  imageArrayParent,
                           VkSharedBaseObj<VkImageResourceView>& imageViewArrayParent,
                           bool useSeparateOutputImage = false,
-                          bool useLinearOutput = false);
+                          bool useLinearOutput = false,
+                          VkExternalMemoryHandleTypeFlags exportMemoryHandleTypes = 0);
 
-    VkResult init( const VulkanDeviceContext* vkDevCtx);
+    VkResult init( const VulkanDeviceContext* vkDevCtx, bool exportFrameCompleteSemaphore = false);
 
     void Deinit();
 
@@ -103,6 +121,67 @@ public:
         return (!!m_frameDpbImageView && (m_frameDpbImageView->GetImageView() != VK_NULL_HANDLE));
     }
 
+    // Drops the images of an idle picture, they are created again on the next use.
+    // Views handed out to the display are reference counted and stay valid.
+    void ReleaseImage() {
+        ReturnImagesToPool();
+        m_frameDpbImageView = nullptr;
+        m_outImageView = nullptr;
+        m_currentDpbImageLayerLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_currentOutputImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_recreateImage = false;
+    }
+
+    // The GPU is done with the images: the decode has completed and the consumer, if it signals, too.
+    bool IsIdleOnDevice() {
+        if (m_vkDevCtx == nullptr) {
+            return true;
+        }
+        if ((m_frameCompleteFence != VK_NULL_HANDLE) &&
+                (m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, m_frameCompleteFence) != VK_SUCCESS)) {
+            return false;
+        }
+        if (m_hasConsummerSignalFence && (m_frameConsumerDoneFence != VK_NULL_HANDLE) &&
+                (m_vkDevCtx->GetFenceStatus(*m_vkDevCtx, m_frameConsumerDoneFence) != VK_SUCCESS)) {
+            return false;
+        }
+        if (m_consumerDoneTimelineSemaphore != VK_NULL_HANDLE) {
+            uint64_t consumerDoneValue = 0;
+            if ((m_vkDevCtx->GetSemaphoreCounterValue(*m_vkDevCtx, m_consumerDoneTimelineSemaphore,
+                                                      &consumerDoneValue) != VK_SUCCESS) ||
+                    (consumerDoneValue < m_consumerDoneTimelineValue)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Hands the images over to the shared image pool of the device, if there is one, for any decoder to reuse.
+    // Only the images no longer in use on the device are handed over, the others are just released.
+    void ReturnImagesToPool() {
+        VulkanVideoSharedImagePool* pSharedImagePool = (m_vkDevCtx != nullptr) ? m_vkDevCtx->GetVideoSharedImagePool() : nullptr;
+        if ((pSharedImagePool == nullptr) || !ImageExist() || m_ownedByDisplay || !IsIdleOnDevice()) {
+            return;
+        }
+
+        VkSharedBaseObj<VkImageResource> dpbImageResource(m_frameDpbImageView->GetImageResource());
+        VkSharedBaseObj<VkImageResource> outImageResource;
+        if (m_outImageView && (m_outImageView->GetImageResource() != dpbImageResource)) {
+            outImageResource = m_outImageView->GetImageResource();
+            // The exported images are not shared, they are destroyed with their last reference
+            if (outImageResource->GetMemory()->GetExportHandleTypes() != 0) {
+                outImageResource = nullptr;
+            }
+        }
+
+        // The views must be gone before any other picture can get the images
+        m_frameDpbImageView = nullptr;
+        m_outImageView = nullptr;
+
+        pSharedImagePool->ReturnImage(dpbImageResource);
+        pSharedImagePool->ReturnImage(outImageResource);
+    }
+
     bool GetImageSetNewLayout(VkImageLayout newDpbImageLayout,
                               VkVideoPictureResourceInfoKHR* pDpbPictureResource,
                               VulkanVideoFrameBuffer::PictureResourceInfo* pDpbPictureResourceInfo,
@@ -146,19 +225,41 @@ public:
         return true;
     }
 
+protected:
+    // The last reference is gone, from the decoder or from the display thread
+    virtual void OnAvailable()
+    {
+        if (m_availablePictures) {
+            m_availablePictures->ReleaseBit(m_imageIndex);
+        }
+    }
+
+public:
     VkParserDecodePictureInfo m_picDispInfo;
     VkFence m_frameCompleteFence;
     VkSemaphore m_frameCompleteSemaphore;
     VkFence m_frameConsumerDoneFence;
     VkSemaphore m_frameConsumerDoneSemaphore;
-    uint32_t m_hasFrameCompleteSignalFence : 1;
-    uint32_t m_hasFrameCompleteSignalSemaphore : 1;
-    uint32_t m_hasConsummerSignalFence : 1;
-    uint32_t m_hasConsummerSignalSemaphore : 1;
-    uint32_t m_inDecodeQueue : 1;
-    uint32_t m_inDisplayQueue : 1;
-    uint32_t m_ownedByDisplay : 1;
-    uint32_t m_recreateImage : 1;
+    // Of the post-process filter of the frame, set by the decoder after the frame complete fence and semaphore
+    VkSemaphore m_frameCompleteTimelineSemaphore;
+    uint64_t m_frameCompleteTimelineValue;
+    // Of the consumer, set by the display when it releases the picture before it is done with it
+    VkSemaphore m_consumerDoneTimelineSemaphore;
+    uint64_t m_consumerDoneTimelineValue;
+    // The flags are not bit-fields: the decoder and the display threads write different flags of the
+    // same picture concurrently. The frame complete flags are set by the decoder and handed over
+    // to the display with the display queue, the consumer flags are set by the display before
+    // it releases the picture and read by the decoder after the picture has been reserved again.
+    bool m_hasFrameCompleteSignalFence;
+    bool m_hasFrameCompleteSignalSemaphore;
+    bool m_hasConsummerSignalFence;
+    bool m_hasConsummerSignalSemaphore;
+    std::atomic<bool> m_inDecodeQueue;
+    std::atomic<bool> m_inDisplayQueue;
+    std::atomic<bool> m_ownedByDisplay;
+    bool m_recreateImage;
+    // The frame buffer reserve count when the picture was last reserved, for the idle image release
+    uint64_t m_lastReserveNum;
     // VPS
     VkSharedBaseObj<VkVideoRefCountBase>  stdVps;
     // SPS
@@ -174,6 +275,8 @@ private:
     const VulkanDeviceContext*           m_vkDevCtx;
     VkSharedBaseObj<VkImageResourceView> m_frameDpbImageView;
     VkSharedBaseObj<VkImageResourceView> m_outImageView;
+    VulkanAtomicBitMask*                 m_availablePictures;
+    uint32_t                             m_imageIndex;
 };
 
 class NvPerFrameDecodeImageSet {
@@ -192,10 +295,15 @@ public:
         , m_usesImageViewArray(false)
         , m_usesSeparateOutputImage(false)
         , m_usesLinearOutput(false)
+        , m_exportMemoryHandleTypes(0)
         , m_perFrameDecodeResources(maxImages)
         , m_imageArray()
         , m_imageViewArray()
+        , m_availablePictures()
     {
+        for (uint32_t imageIndex = 0; imageIndex < maxImages; imageIndex++) {
+            m_perFrameDecodeResources[imageIndex].SetAvailablePicturesMask(&m_availablePictures, imageIndex);
+        }
     }
 
     int32_t init(const VulkanDeviceContext* vkDevCtx,
@@ -207,12 +315,14 @@ public:
         VkImageUsageFlags     dpbImageUsage,
         VkImageUsageFlags     outImageUsage,
         uint32_t              queueFamilyIndex,
+        int32_t               numImagesToPreallocate = -1,
         VkMemoryPropertyFlags dpbRequiredMemProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         VkMemoryPropertyFlags outRequiredMemProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         bool useImageArray = false,
         bool useImageViewArray = false,
         bool useSeparateOutputImages = false,
-        bool useLinearOutput = false);
+        bool useLinearOutput = false,
+        VkExternalMemoryHandleTypeFlags exportMemoryHandleTypes = 0);
 
     void Deinit();
 
@@ -229,7 +339,50 @@ public:
 
     size_t size()
     {
-        return m_numImages;
+        return m_numImages.load(std::memory_order_acquire);
+    }
+
+    // Takes the first available picture at or after startIndex, wrapping around. Returns -1 if none is available.
+    int32_t AcquireAvailablePicture(uint32_t startIndex)
+    {
+        int32_t imageIndex;
+        while ((imageIndex = m_availablePictures.AcquireFirstSetBit(startIndex)) >= 0) {
+            if (((uint32_t)imageIndex < size()) && m_perFrameDecodeResources[imageIndex].IsAvailable()) {
+                return imageIndex;
+            }
+            // A stale bit of a picture beyond the current number of images, it is set again when that picture is released.
+        }
+        return -1;
+    }
+
+    void SetPictureAvailable(uint32_t imageIndex)
+    {
+        m_availablePictures.ReleaseBit(imageIndex);
+    }
+
+    uint32_t GetNumAvailablePictures()
+    {
+        return (uint32_t)std::bitset<64>(m_availablePictures.Get()).count();
+    }
+
+    // Releases the images of the available pictures not reserved in the last idleReserves reserves.
+    // The layers of an image array can not be released separately, so nothing is released then.
+    uint32_t ReleaseIdleImages(uint64_t reserveNum, uint32_t idleReserves)
+    {
+        if (m_usesImageArray) {
+            return 0;
+        }
+
+        uint32_t numReleasedImages = 0;
+        for (uint32_t imageIndex = 0; imageIndex < size(); imageIndex++) {
+            NvPerFrameDecodeResources& picture = m_perFrameDecodeResources[imageIndex];
+            if (picture.IsAvailable() && !picture.m_ownedByDisplay && picture.ImageExist() &&
+                    ((reserveNum - picture.m_lastReserveNum) > idleReserves) && picture.IsIdleOnDevice()) {
+                picture.ReleaseImage();
+                numReleasedImages++;
+            }
+        }
+        return numReleasedImages;
     }
 
     VkResult GetImageSetNewLayout(const VulkanDeviceContext* vkDevCtx,
@@ -278,7 +431,8 @@ public:
                                m_imageArray,
                                m_imageViewArray,
                                m_usesSeparateOutputImage,
-                               m_usesLinearOutput);
+                               m_usesLinearOutput,
+                               m_exportMemoryHandleTypes);
 
             if (result == VK_SUCCESS) {
                 validImage = m_perFrameDecodeResources[imageIndex].GetImageSetNewLayout(
@@ -303,29 +457,39 @@ private:
     VkImageCreateInfo                    m_outImageCreateInfo;
     VkMemoryPropertyFlags                m_dpbRequiredMemProps;
     VkMemoryPropertyFlags                m_outRequiredMemProps;
-    uint32_t                             m_numImages;
+    std::atomic<uint32_t>                m_numImages; // read by the display thread
     uint32_t                             m_usesImageArray:1;
     uint32_t                             m_usesImageViewArray:1;
     uint32_t                             m_usesSeparateOutputImage:1;
     uint32_t                             m_usesLinearOutput:1;
+    VkExternalMemoryHandleTypeFlags      m_exportMemoryHandleTypes; // of the output images, 0 if not exported
     std::vector<NvPerFrameDecodeResources> m_perFrameDecodeResources;
     VkSharedBaseObj<VkImageResource>     m_imageArray;     // must be valid if m_usesImageArray is true
     VkSharedBaseObj<VkImageResourceView> m_imageViewArray; // must be valid if m_usesImageViewArray is true
+    // A set bit for each picture with no references, replaces a scan of all pictures on reserve
+    VulkanAtomicBitMask                  m_availablePictures;
 };
 
+// The frame buffer takes no lock. The pictures are reserved, set up and queued by a single decoder
+// thread and dequeued and released by a single display thread. The ownership of a picture moves
+// between the two with its atomic reference count and the lock-free display queue.
 class VkVideoFrameBuffer : public VulkanVideoFrameBuffer {
 public:
 
     static constexpr size_t maxFramebufferImages = 32;
+    // How often, in reserved pictures, to look for idle images to release
+    static constexpr uint64_t IDLE_IMAGE_RELEASE_CHECK_INTERVAL = 16;
 
     VkVideoFrameBuffer(const VulkanDeviceContext* vkDevCtx)
         : m_vkDevCtx(vkDevCtx)
         , m_refCount(0)
-        , m_displayQueueMutex()
         , m_perFrameDecodeImageSet()
         , m_displayFrames()
         , m_queryPool()
         , m_ownedByDisplayMask(0)
+        , m_nextPictureToReserve(0)
+        , m_reserveNum(0)
+        , m_idleImageReleaseFrames(DEFAULT_IDLE_IMAGE_RELEASE_FRAMES)
         , m_frameNumInDisplayOrder(0)
         , m_codedExtent { 0, 0 }
         , m_numberParameterUpdates(0)
@@ -361,15 +525,13 @@ public:
         }
     }
 
+    // Runs on the display side of the display queue, the display thread must be done.
     uint32_t  FlushDisplayQueue()
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
-
         uint32_t flushedImages = 0;
-        while (!m_displayFrames.empty()) {
-            int8_t pictureIndex = m_displayFrames.front();
-            assert((pictureIndex >= 0) && ((uint32_t)pictureIndex < m_perFrameDecodeImageSet.size()));
-            m_displayFrames.pop();
+        uint8_t pictureIndex = 0;
+        while (m_displayFrames.Pop(pictureIndex)) {
+            assert((uint32_t)pictureIndex < m_perFrameDecodeImageSet.size());
             if (m_perFrameDecodeImageSet[(uint32_t)pictureIndex].IsAvailable()) {
                 // The frame is not released yet - force release it.
                 m_perFrameDecodeImageSet[(uint32_t)pictureIndex].Release();
@@ -393,10 +555,9 @@ public:
                                   bool                     useImageArray = false,
                                   bool                     useImageViewArray = false,
                                   bool                     useSeparateOutputImage = false,
-                                  bool                     useLinearOutput = false)
+                                  bool                     useLinearOutput = false,
+                                  VkExternalMemoryHandleTypeFlags exportMemoryHandleTypes = 0)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
-
         assert(numImages && (numImages <= maxFramebufferImages) && pDecodeProfile);
 
         VkResult result = CreateVideoQueries(numImages, m_vkDevCtx, pDecodeProfile);
@@ -417,13 +578,15 @@ public:
                                               dpbImageUsage,
                                               outImageUsage,
                                               queueFamilyIndex,
+                                              numImagesToPreallocate,
                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                               useLinearOutput ? ( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  |
                                                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
                                                                   VK_MEMORY_PROPERTY_HOST_CACHED_BIT)  :
                                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                               useImageArray, useImageViewArray,
-                                              useSeparateOutputImage, useLinearOutput);
+                                              useSeparateOutputImage, useLinearOutput,
+                                              exportMemoryHandleTypes);
         m_numberParameterUpdates++;
 
         return imageSetCreateResult;
@@ -436,6 +599,7 @@ public:
         DestroyVideoQueries();
 
         m_ownedByDisplayMask = 0;
+        m_nextPictureToReserve = 0;
         m_frameNumInDisplayOrder = 0;
 
         m_perFrameDecodeImageSet.Deinit();
@@ -450,13 +614,15 @@ public:
     {
         assert((uint32_t)picId < m_perFrameDecodeImageSet.size());
 
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         m_perFrameDecodeImageSet[picId].m_displayOrder = m_frameNumInDisplayOrder++;
         m_perFrameDecodeImageSet[picId].m_timestamp = pDispInfo->timestamp;
         m_perFrameDecodeImageSet[picId].m_inDisplayQueue = true;
         m_perFrameDecodeImageSet[picId].AddRef();
 
-        m_displayFrames.push((uint8_t)picId);
+        // A picture is in the queue at most once, so the queue can not be full.
+        bool queued = m_displayFrames.Push((uint8_t)picId);
+        assert(queued);
+        (void)queued;
 
         if (m_debug) {
             std::cout << "==> Queue Display Picture picIdx: " << (uint32_t)picId
@@ -493,8 +659,9 @@ public:
 
         }
 
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         m_perFrameDecodeImageSet[picId].m_picDispInfo = *pDecodePictureInfo;
+        m_perFrameDecodeImageSet[picId].m_frameCompleteTimelineSemaphore = VK_NULL_HANDLE;
+        m_perFrameDecodeImageSet[picId].m_frameCompleteTimelineValue = 0;
         m_perFrameDecodeImageSet[picId].m_inDecodeQueue = true;
         m_perFrameDecodeImageSet[picId].stdPps = const_cast<VkVideoRefCountBase*>(pReferencedObjectsInfo->pStdPps);
         m_perFrameDecodeImageSet[picId].stdSps = const_cast<VkVideoRefCountBase*>(pReferencedObjectsInfo->pStdSps);
@@ -531,6 +698,12 @@ public:
             m_perFrameDecodeImageSet[picId].m_hasConsummerSignalSemaphore = false;
         }
 
+        if (m_perFrameDecodeImageSet[picId].m_consumerDoneTimelineSemaphore != VK_NULL_HANDLE) {
+            pFrameSynchronizationInfo->frameConsumerDoneTimelineSemaphore = m_perFrameDecodeImageSet[picId].m_consumerDoneTimelineSemaphore;
+            pFrameSynchronizationInfo->frameConsumerDoneTimelineValue = m_perFrameDecodeImageSet[picId].m_consumerDoneTimelineValue;
+            m_perFrameDecodeImageSet[picId].m_consumerDoneTimelineSemaphore = VK_NULL_HANDLE;
+        }
+
         pFrameSynchronizationInfo->queryPool = m_queryPool;
         pFrameSynchronizationInfo->startQueryId = picId;
         pFrameSynchronizationInfo->numQueries = 1;
@@ -541,16 +714,15 @@ public:
     // dequeue
     virtual int32_t DequeueDecodedPicture(VulkanDecodedFrame* pDecodedFrame)
     {
-        int numberofPendingFrames = 0;
+        int numberofPendingFrames = (int)m_displayFrames.Size();
         int pictureIndex = -1;
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
-        if (!m_displayFrames.empty()) {
-            numberofPendingFrames = (int)m_displayFrames.size();
-            pictureIndex = m_displayFrames.front();
-            assert((pictureIndex >= 0) && ((uint32_t)pictureIndex < m_perFrameDecodeImageSet.size()));
-            assert(!(m_ownedByDisplayMask & (1 << pictureIndex)));
-            m_ownedByDisplayMask |= (1 << pictureIndex);
-            m_displayFrames.pop();
+        uint8_t displayPictureIndex = 0;
+        if (m_displayFrames.Pop(displayPictureIndex)) {
+            pictureIndex = displayPictureIndex;
+            assert((uint32_t)pictureIndex < m_perFrameDecodeImageSet.size());
+            const uint32_t prevOwnedByDisplayMask = m_ownedByDisplayMask.fetch_or(1 << pictureIndex);
+            assert(!(prevOwnedByDisplayMask & (1 << pictureIndex)));
+            (void)prevOwnedByDisplayMask;
             m_perFrameDecodeImageSet[pictureIndex].m_inDisplayQueue = false;
             m_perFrameDecodeImageSet[pictureIndex].m_ownedByDisplay = true;
         }
@@ -580,10 +752,14 @@ public:
                 pDecodedFrame->frameCompleteSemaphore = VkSemaphore();
             }
 
+            pDecodedFrame->frameCompleteTimelineSemaphore = m_perFrameDecodeImageSet[pictureIndex].m_frameCompleteTimelineSemaphore;
+            pDecodedFrame->frameCompleteTimelineValue = m_perFrameDecodeImageSet[pictureIndex].m_frameCompleteTimelineValue;
+
             pDecodedFrame->frameConsumerDoneFence = m_perFrameDecodeImageSet[pictureIndex].m_frameConsumerDoneFence;
             pDecodedFrame->frameConsumerDoneSemaphore = m_perFrameDecodeImageSet[pictureIndex].m_frameConsumerDoneSemaphore;
 
             pDecodedFrame->timestamp = m_perFrameDecodeImageSet[pictureIndex].m_timestamp;
+            pDecodedFrame->decodeTimestamp = m_perFrameDecodeImageSet[pictureIndex].m_picDispInfo.timestamp;
             pDecodedFrame->decodeOrder = m_perFrameDecodeImageSet[pictureIndex].m_decodeOrder;
             pDecodedFrame->displayOrder = m_perFrameDecodeImageSet[pictureIndex].m_displayOrder;
 
@@ -599,9 +775,10 @@ public:
         return numberofPendingFrames;
     }
 
+    // The pictures of the array are released in one call, without a lock: the display can hand back all the
+    // pictures it is done with, or about to be done with on the device, at once.
     virtual int32_t ReleaseDisplayedPicture(DecodedFrameRelease** pDecodedFramesRelease, uint32_t numFramesToRelease)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         for (uint32_t i = 0; i < numFramesToRelease; i++) {
             const DecodedFrameRelease* pDecodedFrameRelease = pDecodedFramesRelease[i];
             int picId = pDecodedFrameRelease->pictureIndex;
@@ -610,14 +787,18 @@ public:
             assert(m_perFrameDecodeImageSet[picId].m_decodeOrder == pDecodedFrameRelease->decodeOrder);
             assert(m_perFrameDecodeImageSet[picId].m_displayOrder == pDecodedFrameRelease->displayOrder);
 
-            assert(m_ownedByDisplayMask & (1 << picId));
-            m_ownedByDisplayMask &= ~(1 << picId);
+            const uint32_t prevOwnedByDisplayMask = m_ownedByDisplayMask.fetch_and(~(1 << picId));
+            assert(prevOwnedByDisplayMask & (1 << picId));
+            (void)prevOwnedByDisplayMask;
             m_perFrameDecodeImageSet[picId].m_inDecodeQueue = false;
             m_perFrameDecodeImageSet[picId].m_ownedByDisplay = false;
-            m_perFrameDecodeImageSet[picId].Release();
 
+            // The consumer flags must be set before the release, the decoder may reserve the picture right after it.
             m_perFrameDecodeImageSet[picId].m_hasConsummerSignalFence = pDecodedFrameRelease->hasConsummerSignalFence;
             m_perFrameDecodeImageSet[picId].m_hasConsummerSignalSemaphore = pDecodedFrameRelease->hasConsummerSignalSemaphore;
+            m_perFrameDecodeImageSet[picId].m_consumerDoneTimelineSemaphore = pDecodedFrameRelease->consumerDoneTimelineSemaphore;
+            m_perFrameDecodeImageSet[picId].m_consumerDoneTimelineValue = pDecodedFrameRelease->consumerDoneTimelineValue;
+            m_perFrameDecodeImageSet[picId].Release();
         }
         return 0;
     }
@@ -628,7 +809,6 @@ public:
                                                 VkImageLayout newDpbImageLayerLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR)
     {
         assert(dpbPictureResources);
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         for (unsigned int resId = 0; resId < numResources; resId++) {
             if ((uint32_t)referenceSlotIndexes[resId] < m_perFrameDecodeImageSet.size()) {
 
@@ -660,7 +840,6 @@ public:
                                                    VkImageLayout newOutputImageLayerLayout = VK_IMAGE_LAYOUT_MAX_ENUM)
     {
         assert(dpbPictureResource);
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         if ((uint32_t)referenceSlotIndex < m_perFrameDecodeImageSet.size()) {
 
             VkResult result = m_perFrameDecodeImageSet.GetImageSetNewLayout(m_vkDevCtx,
@@ -690,11 +869,40 @@ public:
         return referenceSlotIndex;
     }
 
+    virtual int32_t GetCurrentAndDpbImageResourcesByIndex(int8_t currentSlotIndex,
+                                                          VkVideoPictureResourceInfoKHR* dpbSetupPictureResource,
+                                                          PictureResourceInfo* dpbSetupPictureResourceInfo,
+                                                          VkVideoPictureResourceInfoKHR* outputPictureResource,
+                                                          PictureResourceInfo* outputPictureResourceInfo,
+                                                          uint32_t numReferences, const int8_t* referenceSlotIndexes,
+                                                          VkVideoPictureResourceInfoKHR* dpbPictureResources,
+                                                          PictureResourceInfo* dpbPictureResourcesInfo,
+                                                          VkImageLayout newDpbImageLayerLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR,
+                                                          VkImageLayout newOutputImageLayerLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR)
+    {
+        if (currentSlotIndex != VkVideoFrameBuffer::GetCurrentImageResourceByIndex(currentSlotIndex,
+                                                                                    dpbSetupPictureResource,
+                                                                                    dpbSetupPictureResourceInfo,
+                                                                                    newDpbImageLayerLayout,
+                                                                                    outputPictureResource,
+                                                                                    outputPictureResourceInfo,
+                                                                                    newOutputImageLayerLayout)) {
+            return -1;
+        }
+
+        if (numReferences == 0) {
+            return 0;
+        }
+
+        return VkVideoFrameBuffer::GetDpbImageResourcesByIndex(numReferences, referenceSlotIndexes,
+                                                               dpbPictureResources, dpbPictureResourcesInfo,
+                                                               newDpbImageLayerLayout);
+    }
+
     virtual int32_t GetCurrentImageResourceByIndex(int8_t referenceSlotIndex,
                                                    VkSharedBaseObj<VkImageResourceView>& decodedImageView,
                                                    VkSharedBaseObj<VkImageResourceView>& outputImageView)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         if ((uint32_t)referenceSlotIndex < m_perFrameDecodeImageSet.size()) {
             decodedImageView = m_perFrameDecodeImageSet[referenceSlotIndex].GetFrameImageView();
             outputImageView  = m_perFrameDecodeImageSet[referenceSlotIndex].GetDisplayImageView();
@@ -705,10 +913,11 @@ public:
 
     virtual int32_t ReleaseImageResources(uint32_t numResources, const uint32_t* indexes)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         for (unsigned int resId = 0; resId < numResources; resId++) {
             if ((uint32_t)indexes[resId] < m_perFrameDecodeImageSet.size()) {
                 m_perFrameDecodeImageSet[indexes[resId]].Deinit();
+                // Deinit() drops any references without a release
+                m_perFrameDecodeImageSet.SetPictureAvailable(indexes[resId]);
             }
         }
         return (int32_t)m_perFrameDecodeImageSet.size();
@@ -716,7 +925,6 @@ public:
 
     virtual uint64_t SetPicNumInDecodeOrder(int32_t picId, uint64_t picNumInDecodeOrder)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         if ((uint32_t)picId < m_perFrameDecodeImageSet.size()) {
             uint64_t oldPicNumInDecodeOrder = m_perFrameDecodeImageSet[picId].m_decodeOrder;
             m_perFrameDecodeImageSet[picId].m_decodeOrder = picNumInDecodeOrder;
@@ -728,7 +936,6 @@ public:
 
     virtual int32_t SetPicNumInDisplayOrder(int32_t picId, int32_t picNumInDisplayOrder)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         if ((uint32_t)picId < m_perFrameDecodeImageSet.size()) {
             int32_t oldPicNumInDisplayOrder = m_perFrameDecodeImageSet[picId].m_displayOrder;
             m_perFrameDecodeImageSet[picId].m_displayOrder = picNumInDisplayOrder;
@@ -738,9 +945,18 @@ public:
         return -1;
     }
 
+    virtual void SetFrameCompleteTimelineValue(int32_t picId, VkSemaphore timelineSemaphore, uint64_t timelineValue)
+    {
+        if ((uint32_t)picId < m_perFrameDecodeImageSet.size()) {
+            m_perFrameDecodeImageSet[picId].m_frameCompleteTimelineSemaphore = timelineSemaphore;
+            m_perFrameDecodeImageSet[picId].m_frameCompleteTimelineValue = timelineValue;
+            return;
+        }
+        assert(false);
+    }
+
     virtual const VkSharedBaseObj<VkImageResourceView>& GetImageResourceByIndex(int8_t picId)
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         if ((uint32_t)picId < m_perFrameDecodeImageSet.size()) {
             return m_perFrameDecodeImageSet[picId].GetFrameImageView();
         }
@@ -750,27 +966,31 @@ public:
 
     virtual vkPicBuffBase* ReservePictureBuffer()
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
-        int32_t foundPicId = -1;
-        int64_t minDecodeOrder = m_perFrameDecodeImageSet[0].m_decodeOrder + 1000;
-        uint32_t numAvailablePictures = 0;
-        for (uint32_t picId = 0; picId < m_perFrameDecodeImageSet.size(); picId++) {
-            if (m_perFrameDecodeImageSet[picId].IsAvailable()) {
-                numAvailablePictures++;
-                if ((int64_t)m_perFrameDecodeImageSet[picId].m_decodeOrder < minDecodeOrder) {
-                    foundPicId = picId;
-                    minDecodeOrder = (int64_t)m_perFrameDecodeImageSet[picId].m_decodeOrder;
-                }
+        // Round-robin over the available pictures, so that the picture reserved is the one released the longest ago
+        // in the common case, like the lowest decode order of the available pictures.
+        const int32_t foundPicId = m_perFrameDecodeImageSet.AcquireAvailablePicture(m_nextPictureToReserve);
+
+        m_reserveNum++;
+        if (foundPicId >= 0) {
+            m_perFrameDecodeImageSet[foundPicId].m_lastReserveNum = m_reserveNum;
+        }
+
+        if ((m_idleImageReleaseFrames != 0) && ((m_reserveNum % IDLE_IMAGE_RELEASE_CHECK_INTERVAL) == 0)) {
+            uint32_t numReleasedImages = m_perFrameDecodeImageSet.ReleaseIdleImages(m_reserveNum, m_idleImageReleaseFrames);
+            if (m_debug && numReleasedImages) {
+                std::cout << "==> Released the images of " << numReleasedImages << " idle pictures" << std::endl;
             }
         }
 
         if (foundPicId >= 0) {
+            m_nextPictureToReserve = foundPicId + 1;
             m_perFrameDecodeImageSet[foundPicId].Reset();
             m_perFrameDecodeImageSet[foundPicId].AddRef();
             m_perFrameDecodeImageSet[foundPicId].m_picIdx = foundPicId;
 
             if (m_debug) {
-                std::cout << "==> ReservePictureBuffer picIdx: " << (uint32_t)foundPicId << " of " << numAvailablePictures
+                std::cout << "==> ReservePictureBuffer picIdx: " << (uint32_t)foundPicId << " of "
+                          << (m_perFrameDecodeImageSet.GetNumAvailablePictures() + 1)
                           << "\t\tdisplayOrder: " << m_perFrameDecodeImageSet[foundPicId].m_decodeOrder << "\tdecodeOrder: "
                           << m_perFrameDecodeImageSet[foundPicId].m_decodeOrder
                           << "\ttimestamp " << m_perFrameDecodeImageSet[foundPicId].m_timestamp << std::endl;
@@ -783,9 +1003,13 @@ public:
         return NULL;
     }
 
+    virtual void SetIdleImageReleaseFrames(uint32_t numFrames)
+    {
+        m_idleImageReleaseFrames = numFrames;
+    }
+
     virtual size_t GetSize()
     {
-        std::lock_guard<std::mutex> lock(m_displayQueueMutex);
         return m_perFrameDecodeImageSet.size();
     }
 
@@ -797,11 +1021,14 @@ public:
 private:
     const VulkanDeviceContext* m_vkDevCtx;
     std::atomic<int32_t>     m_refCount;
-    std::mutex               m_displayQueueMutex;
     NvPerFrameDecodeImageSet m_perFrameDecodeImageSet;
-    std::queue<uint8_t>      m_displayFrames;
+    // Produced by the decoder thread, consumed by the display thread
+    VulkanSpscRingQueue<uint8_t, 2 * maxFramebufferImages> m_displayFrames;
     VkQueryPool              m_queryPool;
-    uint32_t                 m_ownedByDisplayMask;
+    std::atomic<uint32_t>    m_ownedByDisplayMask;
+    uint32_t                 m_nextPictureToReserve;
+    uint64_t                 m_reserveNum;
+    uint32_t                 m_idleImageReleaseFrames;
     int32_t                  m_frameNumInDisplayOrder;
     VkExtent2D               m_codedExtent;               // for the codedExtent, not the max image resolution
     uint32_t                 m_numberParameterUpdates;
@@ -844,7 +1071,8 @@ VkResult NvPerFrameDecodeResources::CreateImage( const VulkanDeviceContext* vkDe
                                                  VkSharedBaseObj<VkImageResource>& imageArrayParent,
                                                  VkSharedBaseObj<VkImageResourceView>& imageViewArrayParent,
                                                  bool useSeparateOutputImage,
-                                                 bool useLinearOutput)
+                                                 bool useLinearOutput,
+                                                 VkExternalMemoryHandleTypeFlags exportMemoryHandleTypes)
 {
     VkResult result = VK_SUCCESS;
 
@@ -852,15 +1080,25 @@ VkResult NvPerFrameDecodeResources::CreateImage( const VulkanDeviceContext* vkDe
 
         assert(m_vkDevCtx != nullptr);
 
+        // The images of the previous configuration can still be used by another decoder or a later stream
+        ReturnImagesToPool();
+
         m_currentDpbImageLayerLayout = pDpbImageCreateInfo->initialLayout;
         m_currentOutputImageLayout   = pOutImageCreateInfo->initialLayout;
 
+        VulkanVideoSharedImagePool* pSharedImagePool = vkDevCtx->GetVideoSharedImagePool();
+
         VkSharedBaseObj<VkImageResource> imageResource;
         if (!imageArrayParent) {
-            result = VkImageResource::Create(vkDevCtx,
-                                             pDpbImageCreateInfo,
-                                             dpbRequiredMemProps,
-                                             imageResource);
+            VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_DPB);
+            result = (pSharedImagePool != nullptr) ?
+                         pSharedImagePool->GetImage(pDpbImageCreateInfo,
+                                                   dpbRequiredMemProps,
+                                                   imageResource) :
+                         VkImageResource::Create(vkDevCtx,
+                                                 pDpbImageCreateInfo,
+                                                 dpbRequiredMemProps,
+                                                 imageResource);
             if (result != VK_SUCCESS) {
                 return result;
             }
@@ -902,11 +1140,23 @@ VkResult NvPerFrameDecodeResources::CreateImage( const VulkanDeviceContext* vkDe
 
         if (useSeparateOutputImage || useLinearOutput) {
 
+            // The exported images are not shared with the other decoders, their consumers keep them
+            VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_OUTPUT);
             VkSharedBaseObj<VkImageResource> displayImageResource;
-            result = VkImageResource::Create(vkDevCtx,
-                                             pOutImageCreateInfo,
-                                             outRequiredMemProps,
-                                             displayImageResource);
+            result = (exportMemoryHandleTypes != 0) ?
+                         VkImageResource::CreateExportable(vkDevCtx,
+                                                           pOutImageCreateInfo,
+                                                           outRequiredMemProps,
+                                                           exportMemoryHandleTypes,
+                                                           displayImageResource) :
+                     (pSharedImagePool != nullptr) ?
+                         pSharedImagePool->GetImage(pOutImageCreateInfo,
+                                                   outRequiredMemProps,
+                                                   displayImageResource) :
+                         VkImageResource::Create(vkDevCtx,
+                                                 pOutImageCreateInfo,
+                                                 outRequiredMemProps,
+                                                 displayImageResource);
             if (result != VK_SUCCESS) {
                 return result;
             }
@@ -928,7 +1178,7 @@ VkResult NvPerFrameDecodeResources::CreateImage( const VulkanDeviceContext* vkDe
     return result;
 }
 
-VkResult NvPerFrameDecodeResources::init(const VulkanDeviceContext* vkDevCtx)
+VkResult NvPerFrameDecodeResources::init(const VulkanDeviceContext* vkDevCtx, bool exportFrameCompleteSemaphore)
 {
 
     m_vkDevCtx = vkDevCtx;
@@ -943,7 +1193,12 @@ VkResult NvPerFrameDecodeResources::init(const VulkanDeviceContext* vkDevCtx)
     assert(result == VK_SUCCESS);
 
     const VkSemaphoreCreateInfo semInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, nullptr };
-    result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &semInfo, nullptr, &m_frameCompleteSemaphore);
+    // The consumers of the exported frames in other processes wait on a sync file of the decode completion
+    const VkExportSemaphoreCreateInfo exportSemInfo = { VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO, nullptr,
+                                                        VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT };
+    const VkSemaphoreCreateInfo frameCompleteSemInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                                                         exportFrameCompleteSemaphore ? &exportSemInfo : nullptr };
+    result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &frameCompleteSemInfo, nullptr, &m_frameCompleteSemaphore);
     assert(result == VK_SUCCESS);
     result = m_vkDevCtx->CreateSemaphore(*m_vkDevCtx, &semInfo, nullptr, &m_frameConsumerDoneSemaphore);
     assert(result == VK_SUCCESS);
@@ -970,6 +1225,9 @@ void NvPerFrameDecodeResources::Deinit()
         return;
     }
 
+    // Before the fences are gone, they tell if the device is done with the images
+    ReturnImagesToPool();
+
     if (m_frameCompleteFence != VkFence()) {
         m_vkDevCtx->DestroyFence(*m_vkDevCtx, m_frameCompleteFence, nullptr);
         m_frameCompleteFence = VkFence();
@@ -1007,12 +1265,14 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
                                        VkImageUsageFlags        dpbImageUsage,
                                        VkImageUsageFlags        outImageUsage,
                                        uint32_t                 queueFamilyIndex,
+                                       int32_t                  numImagesToPreallocate,
                                        VkMemoryPropertyFlags    dpbRequiredMemProps,
                                        VkMemoryPropertyFlags    outRequiredMemProps,
                                        bool                     useImageArray,
                                        bool                     useImageViewArray,
                                        bool                     useSeparateOutputImage,
-                                       bool                     useLinearOutput)
+                                       bool                     useLinearOutput,
+                                       VkExternalMemoryHandleTypeFlags exportMemoryHandleTypes)
 {
     if (numImages > m_perFrameDecodeResources.size()) {
         assert(!"Number of requested images exceeds the max size of the image array");
@@ -1026,7 +1286,9 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
                (m_dpbImageCreateInfo.extent.height < maxImageExtent.height));
 
     for (uint32_t imageIndex = m_numImages; imageIndex < numImages; imageIndex++) {
-        VkResult result = m_perFrameDecodeResources[imageIndex].init(vkDevCtx);
+        VkResult result = m_perFrameDecodeResources[imageIndex].init(vkDevCtx,
+                useSeparateOutputImage && (exportMemoryHandleTypes != 0) &&
+                (vkDevCtx->FindRequiredDeviceExtension(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME) != nullptr));
         assert(result == VK_SUCCESS);
         if (result != VK_SUCCESS) {
             return -1;
@@ -1040,6 +1302,7 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
     m_videoProfile.InitFromProfile(pDecodeProfile);
 
     m_queueFamilyIndex = queueFamilyIndex;
+    m_exportMemoryHandleTypes = useSeparateOutputImage ? exportMemoryHandleTypes : 0;
     m_dpbRequiredMemProps = dpbRequiredMemProps;
     m_outRequiredMemProps = outRequiredMemProps;
 
@@ -1077,6 +1340,7 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
 
     if (useImageArray) {
         // Create an image that has the same number of layers as the DPB images required.
+        VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_DPB);
         VkResult result = VkImageResource::Create(vkDevCtx,
                                                   &m_dpbImageCreateInfo,
                                                   m_dpbRequiredMemProps,
@@ -1102,15 +1366,18 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
         }
     }
 
-    uint32_t firstIndex = reconfigureImages ? 0 : m_numImages;
-    uint32_t maxNumImages = std::max(m_numImages, numImages);
+    uint32_t firstIndex = reconfigureImages ? 0 : m_numImages.load();
+    uint32_t maxNumImages = std::max(m_numImages.load(), numImages);
     for (uint32_t imageIndex = firstIndex; imageIndex < maxNumImages; imageIndex++) {
 
         if (m_perFrameDecodeResources[imageIndex].ImageExist() && reconfigureImages) {
 
             m_perFrameDecodeResources[imageIndex].m_recreateImage = true;
 
-        } else if (!m_perFrameDecodeResources[imageIndex].ImageExist()) {
+        } else if (!m_perFrameDecodeResources[imageIndex].ImageExist() &&
+                   ((numImagesToPreallocate < 0) || (imageIndex < (uint32_t)numImagesToPreallocate))) {
+
+            // The images beyond numImagesToPreallocate are created on their first use by GetImageSetNewLayout()
 
             VkResult result =
                      m_perFrameDecodeResources[imageIndex].CreateImage(vkDevCtx,
@@ -1122,7 +1389,8 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
                                                                   m_imageArray,
                                                                   m_imageViewArray,
                                                                   useSeparateOutputImage,
-                                                                  useLinearOutput);
+                                                                  useLinearOutput,
+                                                                  m_exportMemoryHandleTypes);
 
             assert(result == VK_SUCCESS);
             if (result != VK_SUCCESS) {
@@ -1131,6 +1399,12 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
         }
     }
 
+    for (uint32_t imageIndex = 0; imageIndex < numImages; imageIndex++) {
+        if (m_perFrameDecodeResources[imageIndex].IsAvailable()) {
+            m_availablePictures.ReleaseBit(imageIndex);
+        }
+    }
+
     m_numImages               = numImages;
     m_usesImageArray          = useImageArray;
     m_usesImageViewArray      = useImageViewArray;
@@ -1142,6 +1416,7 @@ int32_t NvPerFrameDecodeImageSet::init(const VulkanDeviceContext* vkDevCtx,
 
 void NvPerFrameDecodeImageSet::Deinit()
 {
+    m_availablePictures.Set(0);
     for (size_t ndx = 0; ndx < m_numImages; ndx++) {
         m_perFrameDecodeResources[ndx].Deinit();
     }
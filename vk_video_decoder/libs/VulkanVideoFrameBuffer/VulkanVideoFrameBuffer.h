@@ -31,6 +31,10 @@ struct DecodedFrameRelease {
     VkVideotimestamp timestamp;
     uint32_t hasConsummerSignalFence : 1;
     uint32_t hasConsummerSignalSemaphore : 1;
+    // If valid, the next decode to the picture waits on the device for the consumer to bring the timeline
+    // semaphore to consumerDoneTimelineValue, so the picture can be released before the consumer is done with it.
+    VkSemaphore consumerDoneTimelineSemaphore;
+    uint64_t consumerDoneTimelineValue;
     // For debugging
     uint64_t displayOrder;
     uint64_t decodeOrder;
@@ -40,12 +44,17 @@ class VkParserVideoPictureParameters;
 
 class VulkanVideoFrameBuffer : public IVulkanVideoFrameBufferParserCb {
 public:
+
+    enum { DEFAULT_IDLE_IMAGE_RELEASE_FRAMES = 120 };
+
     // Synchronization
     struct FrameSynchronizationInfo {
         VkFence frameCompleteFence;
         VkSemaphore frameCompleteSemaphore;
         VkFence frameConsumerDoneFence;
         VkSemaphore frameConsumerDoneSemaphore;
+        VkSemaphore frameConsumerDoneTimelineSemaphore; // waited for frameConsumerDoneTimelineValue
+        uint64_t frameConsumerDoneTimelineValue;
         VkQueryPool queryPool;
         uint32_t startQueryId;
         uint32_t numQueries;
@@ -95,7 +104,9 @@ public:
                                   bool                     useImageArray = false,
                                   bool                     useImageViewArray = false,
                                   bool                     useSeparateOutputImage = false,
-                                  bool                     useLinearOutput = false) = 0;
+                                  bool                     useLinearOutput = false,
+                                  // the output images can be exported to the consumers in other processes
+                                  VkExternalMemoryHandleTypeFlags exportMemoryHandleTypes = 0) = 0;
 
     virtual int32_t QueuePictureForDecode(int8_t picId, VkParserDecodePictureInfo* pDecodePictureInfo,
                                           ReferencedObjectsInfo* pReferencedObjectsInfo,
@@ -113,12 +124,29 @@ public:
                                                    VkVideoPictureResourceInfoKHR* outputPictureResource = nullptr,
                                                    PictureResourceInfo* outputPictureResourceInfo = nullptr,
                                                    VkImageLayout newOutputImageLayerLayout = VK_IMAGE_LAYOUT_MAX_ENUM) = 0;
+    // Looks up the setup picture, with its output, and all of the DPB references of a decode in one call.
+    // Returns the number of references, or -1 if the setup picture is not valid.
+    virtual int32_t GetCurrentAndDpbImageResourcesByIndex(int8_t currentSlotIndex,
+                                                          VkVideoPictureResourceInfoKHR* dpbSetupPictureResource,
+                                                          PictureResourceInfo* dpbSetupPictureResourceInfo,
+                                                          VkVideoPictureResourceInfoKHR* outputPictureResource,
+                                                          PictureResourceInfo* outputPictureResourceInfo,
+                                                          uint32_t numReferences, const int8_t* referenceSlotIndexes,
+                                                          VkVideoPictureResourceInfoKHR* dpbPictureResources,
+                                                          PictureResourceInfo* dpbPictureResourcesInfo,
+                                                          VkImageLayout newDpbImageLayerLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR,
+                                                          VkImageLayout newOutputImageLayerLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR) = 0;
     virtual int32_t GetCurrentImageResourceByIndex(int8_t referenceSlotIndex,
                                                    VkSharedBaseObj<VkImageResourceView>& decodedImageView,
                                                    VkSharedBaseObj<VkImageResourceView>& outputImageView) = 0;
     virtual int32_t ReleaseImageResources(uint32_t numResources, const uint32_t* indexes) = 0;
     virtual uint64_t SetPicNumInDecodeOrder(int32_t picId, uint64_t picNumInDecodeOrder) = 0;
     virtual int32_t SetPicNumInDisplayOrder(int32_t picId, int32_t picNumInDisplayOrder) = 0;
+    // The timeline semaphore and value the consumers of the picture wait on, instead of the frame complete fence
+    virtual void SetFrameCompleteTimelineValue(int32_t picId, VkSemaphore timelineSemaphore, uint64_t timelineValue) = 0;
+    // The images of a picture not reserved for numFrames frames are released, and created again on the next use.
+    // Zero keeps the images until the pool is reinitialized.
+    virtual void SetIdleImageReleaseFrames(uint32_t numFrames) = 0;
     virtual size_t GetSize() = 0;
 
     virtual ~VulkanVideoFrameBuffer() { }
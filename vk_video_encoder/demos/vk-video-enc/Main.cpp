@@ -19,6 +19,12 @@
 #include "VkCodecUtils/VulkanVideoDisplayQueue.h"
 #include "VkCodecUtils/VulkanVideoEncodeDisplayQueue.h"
 #include "VkCodecUtils/VulkanEncoderFrameProcessor.h"
+#include "VkCodecUtils/VulkanVideoProcessor.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VkMetrics.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
+#include "VkCodecUtils/VkCapacityBenchmark.h"
 #include "VkShell/Shell.h"
 
 #define INPUT_FRAME_BUFFER_SIZE 16
@@ -30,13 +36,472 @@ int32_t handle_error(const std::error_code& error)
     return error.value();
 }
 
+// Encodes the input frames of the configuration, returns the number of frames processed
+static uint32_t EncodeFrames(VkSharedBaseObj<EncoderConfig>& encoderConfig, VkSharedBaseObj<VkVideoEncoder>& encoder)
+{
+    uint32_t curFrameIndex = 0;
+    for(; curFrameIndex < encoderConfig->numFrames; curFrameIndex++) {
+
+        if (encoderConfig->verboseFrameStruct) {
+            std::cout << "####################################################################################" << std::endl
+                      << "Start processing current input frame index: " << curFrameIndex << std::endl;
+        }
+
+        VkSharedBaseObj<VkVideoEncoder::VkVideoEncodeFrameInfo> encodeFrameInfo;
+        encoder->GetAvailablePoolNode(encodeFrameInfo);
+        assert(encodeFrameInfo);
+        // load frame data from the file
+        VkResult result = encoder->LoadNextFrame(encodeFrameInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // The streamed input ended, without its last frame known ahead in low-latency mode
+            break;
+        }
+        if (result != VK_SUCCESS) {
+            std::cout << "ERROR processing input frame index: " << curFrameIndex << std::endl;
+            break;
+        }
+
+        if (encoderConfig->verboseFrameStruct) {
+            std::cout << "End processing current input frame index: " << curFrameIndex << std::endl;
+        }
+
+        if (encodeFrameInfo->lastFrame) {
+            // The end of a streamed input may come before numFrames
+            curFrameIndex++;
+            break;
+        }
+    }
+    return curFrameIndex;
+}
+
+// Waits for the next decoded frame, returns false at the end of the stream
+static bool GetNextDecodedFrame(VkSharedBaseObj<VulkanVideoProcessor>& videoProcessor, VulkanDecodedFrame& decodedFrame)
+{
+    bool endOfStream = false;
+    while (!endOfStream) {
+        if (videoProcessor->GetNextFrame(&decodedFrame, &endOfStream) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decodes the --transcode stream on the device and encodes its frames, copied from the decoded pictures on the
+// device as well, without a round trip through the host. Returns the number of frames processed.
+static uint32_t TranscodeFrames(const VulkanDeviceContext* vkDevCtx, VkSharedBaseObj<EncoderConfig>& encoderConfig,
+                                VkSharedBaseObj<VkVideoEncoder>& encoder)
+{
+    ProgramConfig decoderConfig(encoderConfig->appName.c_str());
+    decoderConfig.videoFileName = encoderConfig->transcodeFileName;
+    decoderConfig.verbose = encoderConfig->verbose;
+
+    VkSharedBaseObj<VulkanVideoProcessor> videoProcessor;
+    if ((VulkanVideoProcessor::Create(vkDevCtx, videoProcessor) != VK_SUCCESS) ||
+            (videoProcessor->Initialize(vkDevCtx, decoderConfig) < 0)) {
+        std::cout << "ERROR: Failed to create the decoder of " << encoderConfig->transcodeFileName << std::endl;
+        return 0;
+    }
+
+    // Each frame is held back until the next one is decoded, which tells whether it is the last one
+    VulkanDecodedFrame decodedFrame;
+    bool hasFrame = GetNextDecodedFrame(videoProcessor, decodedFrame);
+    uint32_t curFrameIndex = 0;
+    while (hasFrame) {
+
+        VulkanDecodedFrame nextFrame;
+        const bool hasNextFrame = ((curFrameIndex + 1) < encoderConfig->numFrames) &&
+                                      GetNextDecodedFrame(videoProcessor, nextFrame);
+
+        VkSharedBaseObj<VkVideoEncoder::VkVideoEncodeFrameInfo> encodeFrameInfo;
+        encoder->GetAvailablePoolNode(encodeFrameInfo);
+        assert(encodeFrameInfo);
+        VkResult result = encoder->LoadDecodedFrame(encodeFrameInfo, decodedFrame, !hasNextFrame);
+        // The decoder waits for the copy of the frame before decoding into its image again
+        videoProcessor->ReleaseFrame(&decodedFrame);
+        if (result != VK_SUCCESS) {
+            std::cout << "ERROR processing transcoded frame index: " << curFrameIndex << std::endl;
+            if (hasNextFrame) {
+                videoProcessor->ReleaseFrame(&nextFrame);
+            }
+            break;
+        }
+
+        curFrameIndex++;
+        decodedFrame = nextFrame;
+        hasFrame = hasNextFrame;
+    }
+
+    // The decoder goes away before the device, once the encoder is done with the copies
+    encoder->WaitForThreadsToComplete();
+    vkDevCtx->DeviceWaitIdle();
+    return curFrameIndex;
+}
+
+// Splits the mapped input at IDR period boundaries into independent segments, encodes them with concurrent
+// sessions spread over the encode queues and stitches their bitstreams in order into the output file.
+static int EncodeSegmentsInParallel(const VulkanDeviceContext* vkDevCtx, int argc, char** argv,
+                                    VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    const uint64_t numMappedFrames = encoderConfig->inputFileHandler.GetNumMappedFrames(encoderConfig->input.fullImageSize);
+    const uint32_t idrPeriod = (uint32_t)std::max<int32_t>(encoderConfig->gopStructure.GetIdrPeriod(), 0);
+    if ((numMappedFrames <= encoderConfig->startFrame) || (idrPeriod == 0)) {
+        fprintf(stderr, "\nERROR: The parallel segments need a mapped input file and an IDR period\n");
+        return -1;
+    }
+
+    // Each segment starts with an IDR picture, so it doesn't reference the others
+    const uint64_t numFrames = std::min<uint64_t>(encoderConfig->numFrames, numMappedFrames - encoderConfig->startFrame);
+    uint64_t segmentFrames = (numFrames + encoderConfig->numParallelSegments - 1) / encoderConfig->numParallelSegments;
+    segmentFrames = ((segmentFrames + idrPeriod - 1) / idrPeriod) * idrPeriod;
+    const uint32_t numSegments = (uint32_t)((numFrames + segmentFrames - 1) / segmentFrames);
+
+    struct Segment {
+        VkSharedBaseObj<EncoderConfig> encoderConfig;
+        std::string                    outputFileName;
+        uint32_t                       numFramesProcessed;
+        bool                           success;
+    };
+    std::vector<Segment> segments(numSegments);
+
+    // The configurations are parsed again, with their own input mapping and output file
+    for (uint32_t segmentIndex = 0; segmentIndex < numSegments; segmentIndex++) {
+        Segment& segment = segments[segmentIndex];
+        if (VK_SUCCESS != EncoderConfig::CreateCodecConfig(argc, argv, segment.encoderConfig)) {
+            return -1;
+        }
+        segment.encoderConfig->startFrame = encoderConfig->startFrame + (uint32_t)(segmentIndex * segmentFrames);
+        segment.encoderConfig->numFrames = (uint32_t)std::min<uint64_t>(segmentFrames, numFrames - segmentIndex * segmentFrames);
+        segment.encoderConfig->numParallelSegments = 0;
+        segment.encoderConfig->queueId = (int32_t)segmentIndex;
+        // The rate control changes before the segment apply from its first frame on
+        for (RateControlChange& rateControlChange : segment.encoderConfig->rateControlChanges) {
+            rateControlChange.frameNum -= std::min<uint64_t>(rateControlChange.frameNum, segmentIndex * segmentFrames);
+        }
+        // Only the frames lost within the segment invalidate its references
+        std::vector<uint64_t>& lostFrames = segment.encoderConfig->lostFrames;
+        const uint64_t segmentStartFrame = segmentIndex * segmentFrames;
+        lostFrames.erase(std::remove_if(lostFrames.begin(), lostFrames.end(),
+                                        [segmentStartFrame, segmentFrames](uint64_t lostFrame) {
+                                            return (lostFrame < segmentStartFrame) ||
+                                                   (lostFrame >= segmentStartFrame + segmentFrames); }),
+                         lostFrames.end());
+        for (uint64_t& lostFrame : lostFrames) {
+            lostFrame -= segmentStartFrame;
+        }
+        segment.outputFileName = std::string(encoderConfig->outputFileHandler.GetFileName()) +
+                                     ".segment" + std::to_string(segmentIndex);
+        if (!segment.encoderConfig->outputFileHandler.SetFileName(segment.outputFileName.c_str())) {
+            return -1;
+        }
+        segment.numFramesProcessed = 0;
+        segment.success = false;
+    }
+
+    std::cout << "Encoding " << numFrames << " frames in " << numSegments << " segments of " << segmentFrames
+              << " frames over " << vkDevCtx->GetVideoEncodeNumQueues() << " encode queues" << std::endl;
+
+    std::vector<std::thread> sessionThreads;
+    for (Segment& segment : segments) {
+        sessionThreads.push_back(std::thread([vkDevCtx, &segment]() {
+            VkSharedBaseObj<VkVideoEncoder> encoder;
+            if (VkVideoEncoder::CreateVideoEncoder(vkDevCtx, segment.encoderConfig, encoder) != VK_SUCCESS) {
+                return;
+            }
+            segment.numFramesProcessed = EncodeFrames(segment.encoderConfig, encoder);
+            segment.success = encoder->WaitForThreadsToComplete() &&
+                              (segment.numFramesProcessed == segment.encoderConfig->numFrames);
+        }));
+    }
+    for (std::thread& sessionThread : sessionThreads) {
+        sessionThread.join();
+    }
+
+    // Stitch the segment bitstreams in order
+    FILE* outputFile = encoderConfig->outputFileHandler.GetFileHandle();
+    std::vector<uint8_t> copyBuffer(1024 * 1024);
+    uint32_t numFramesProcessed = 0;
+    bool success = true;
+    for (Segment& segment : segments) {
+        // Closes the segment's output file
+        segment.encoderConfig = nullptr;
+
+        FILE* segmentFile = fopen(segment.outputFileName.c_str(), "rb");
+        if (!segment.success || (segmentFile == nullptr)) {
+            fprintf(stderr, "\nERROR: Failed to encode the segment %s\n", segment.outputFileName.c_str());
+            success = false;
+        }
+        while (success && (segmentFile != nullptr)) {
+            const size_t readSize = fread(copyBuffer.data(), 1, copyBuffer.size(), segmentFile);
+            if ((readSize == 0) || (fwrite(copyBuffer.data(), 1, readSize, outputFile) != readSize)) {
+                break;
+            }
+        }
+        if (segmentFile != nullptr) {
+            fclose(segmentFile);
+        }
+        remove(segment.outputFileName.c_str());
+        numFramesProcessed += segment.numFramesProcessed;
+    }
+    fflush(outputFile);
+
+    std::cout << "Done processing " << numFramesProcessed << " input frames in " << numSegments << " segments!" << std::endl
+              << "Encoded file's location is at " << encoderConfig->outputFileHandler.GetFileName()
+              << std::endl;
+    return success ? 0 : -1;
+}
+
+// Encodes the jobs of the --jobList on the device, the encoders of numParallelJobs of them at a time. The device,
+// its queues and the pipeline cache of the shaders are shared, each job creates the sessions of its own codec and size.
+static int EncodeJobList(const VulkanDeviceContext* vkDevCtx, const std::vector<std::vector<std::string>>& jobArgs,
+                         uint32_t numParallelJobs)
+{
+    std::vector<uint8_t> jobSuccess(jobArgs.size(), 0); // not a vector<bool>, written by the threads concurrently
+    std::atomic<uint32_t> nextJobIndex(0);
+
+    std::cout << "Encoding " << jobArgs.size() << " jobs, " << numParallelJobs << " at a time" << std::endl;
+
+    std::vector<std::thread> jobThreads;
+    for (uint32_t threadIndex = 0; threadIndex < std::min<size_t>(numParallelJobs, jobArgs.size()); threadIndex++) {
+        jobThreads.push_back(std::thread([vkDevCtx, &jobArgs, &jobSuccess, &nextJobIndex]() {
+            for (uint32_t jobIndex = nextJobIndex++; jobIndex < jobArgs.size(); jobIndex = nextJobIndex++) {
+                std::vector<char*> argv;
+                for (const std::string& arg : jobArgs[jobIndex]) {
+                    argv.push_back(const_cast<char*>(arg.c_str()));
+                }
+                argv.push_back(nullptr);
+
+                VkSharedBaseObj<EncoderConfig> encoderConfig;
+                VkSharedBaseObj<VkVideoEncoder> encoder;
+                if ((EncoderConfig::CreateCodecConfig((int)argv.size() - 1, argv.data(), encoderConfig) != VK_SUCCESS) ||
+                        (VkVideoEncoder::CreateVideoEncoder(vkDevCtx, encoderConfig, encoder) != VK_SUCCESS)) {
+                    fprintf(stderr, "\nERROR: Failed to create the encoder of the job %u\n", jobIndex);
+                    continue;
+                }
+                const uint32_t numFramesProcessed = encoderConfig->transcodeFileName.empty() ?
+                                                        EncodeFrames(encoderConfig, encoder) :
+                                                        TranscodeFrames(vkDevCtx, encoderConfig, encoder);
+                jobSuccess[jobIndex] = encoder->WaitForThreadsToComplete() && (numFramesProcessed > 0);
+                std::cout << "Job " << jobIndex << ": " << numFramesProcessed << " frames encoded to "
+                          << encoderConfig->outputFileHandler.GetFileName() << std::endl;
+            }
+        }));
+    }
+    for (std::thread& jobThread : jobThreads) {
+        jobThread.join();
+    }
+
+    const size_t numFailedJobs = std::count(jobSuccess.begin(), jobSuccess.end(), 0);
+    std::cout << "Done processing " << (jobArgs.size() - numFailedJobs) << " of " << jobArgs.size() << " jobs!" << std::endl;
+    return (numFailedJobs == 0) ? 0 : -1;
+}
+
+// Encodes the input frames of the configuration as a live source at the target rate would feed them, a frame is
+// only loaded once due. Returns the number of frames processed.
+static uint32_t EncodePacedFrames(VkSharedBaseObj<EncoderConfig>& encoderConfig, VkSharedBaseObj<VkVideoEncoder>& encoder,
+                                  double targetFps)
+{
+    const std::chrono::duration<double> frameInterval(1.0 / targetFps);
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    uint32_t curFrameIndex = 0;
+    for (; curFrameIndex < encoderConfig->numFrames; curFrameIndex++) {
+        std::this_thread::sleep_until(startTime +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameInterval * (double)curFrameIndex));
+
+        VkSharedBaseObj<VkVideoEncoder::VkVideoEncodeFrameInfo> encodeFrameInfo;
+        encoder->GetAvailablePoolNode(encodeFrameInfo);
+        assert(encodeFrameInfo);
+        VkResult result = encoder->LoadNextFrame(encodeFrameInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            break;
+        }
+        if (result != VK_SUCCESS) {
+            std::cout << "ERROR processing input frame index: " << curFrameIndex << std::endl;
+            break;
+        }
+        if (encodeFrameInfo->lastFrame) {
+            curFrameIndex++;
+            break;
+        }
+    }
+    return curFrameIndex;
+}
+
+// The cumulative counts of the buckets of the frame latency histograms of all the encoders so far
+static std::vector<uint64_t> GetFrameLatencyBuckets()
+{
+    std::vector<VkMetricSample> samples;
+    VkMetrics::GetSamples(samples);
+    std::vector<uint64_t> buckets(VkMetricHistogram::numBuckets, 0);
+    for (const VkMetricSample& sample : samples) {
+        if ((sample.type != VK_METRIC_TYPE_HISTOGRAM) || (sample.name != "vkvideo_encoder_frame_latency_us")) {
+            continue;
+        }
+        for (size_t bucket = 0; bucket < std::min(sample.buckets.size(), buckets.size()); bucket++) {
+            buckets[bucket] += sample.buckets[bucket];
+        }
+    }
+    return buckets;
+}
+
+// Encodes the sessions of a step of the capacity benchmark concurrently on the device, each with the configuration
+// of the command line parsed again, its own output file and a thread. The latency of the frames is from their input
+// ready to their bitstream, the p99 is the bound of its bucket of the histograms of the encoders.
+static void RunEncodeCapacityStep(const VulkanDeviceContext* vkDevCtx, int argc, char** argv,
+                                  VkSharedBaseObj<EncoderConfig>& encoderConfig, double targetFps,
+                                  VkCapacityBenchmark::Step& step)
+{
+    struct Session {
+        VkSharedBaseObj<EncoderConfig> encoderConfig;
+        std::string                    outputFileName;
+        uint32_t                       numFramesProcessed;
+        double                         wallTimeMs;
+        bool                           started;
+    };
+    std::vector<Session> sessions(step.numSessions);
+    for (uint32_t sessionIndex = 0; sessionIndex < step.numSessions; sessionIndex++) {
+        Session& session = sessions[sessionIndex];
+        if (VK_SUCCESS != EncoderConfig::CreateCodecConfig(argc, argv, session.encoderConfig)) {
+            return;
+        }
+        session.encoderConfig->queueId = (int32_t)sessionIndex;
+        session.outputFileName = std::string(encoderConfig->outputFileHandler.GetFileName()) +
+                                     ".session" + std::to_string(sessionIndex);
+        if (!session.encoderConfig->outputFileHandler.SetFileName(session.outputFileName.c_str())) {
+            return;
+        }
+        session.numFramesProcessed = 0;
+        session.wallTimeMs = 0.0;
+        session.started = false;
+    }
+
+    const std::vector<uint64_t> startBuckets = GetFrameLatencyBuckets();
+    std::vector<std::thread> sessionThreads;
+    for (Session& session : sessions) {
+        sessionThreads.push_back(std::thread([vkDevCtx, targetFps, &session]() {
+            VkSharedBaseObj<VkVideoEncoder> encoder;
+            if (VkVideoEncoder::CreateVideoEncoder(vkDevCtx, session.encoderConfig, encoder) != VK_SUCCESS) {
+                return;
+            }
+            session.started = true;
+            const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+            session.numFramesProcessed = EncodePacedFrames(session.encoderConfig, encoder, targetFps);
+            encoder->WaitForThreadsToComplete();
+            session.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                           startTime).count();
+        }));
+    }
+    for (std::thread& sessionThread : sessionThreads) {
+        sessionThread.join();
+    }
+    const std::vector<uint64_t> endBuckets = GetFrameLatencyBuckets();
+
+    step.sessionsStarted = true;
+    step.minSessionFps = targetFps * 1000.0;
+    for (Session& session : sessions) {
+        step.sessionsStarted = step.sessionsStarted && session.started && (session.numFramesProcessed > 0);
+        step.numFrames += session.numFramesProcessed;
+        step.minSessionFps = std::min(step.minSessionFps, (session.wallTimeMs > 0.0) ?
+                                          (1000.0 * session.numFramesProcessed) / session.wallTimeMs : 0.0);
+        // Closes the output file of the session
+        session.encoderConfig = nullptr;
+        remove(session.outputFileName.c_str());
+    }
+
+    const uint64_t numLatencies = endBuckets.back() - startBuckets.back();
+    for (uint32_t bucket = 0; (numLatencies > 0) && (bucket < endBuckets.size()); bucket++) {
+        if ((endBuckets[bucket] - startBuckets[bucket]) >= ((numLatencies * 99 + 99) / 100)) {
+            step.p99LatencyMs = (double)VkMetricHistogram::GetBucketBound(bucket) / 1000.0;
+            break;
+        }
+    }
+    // The encode queues are not timed, the engine is what is left of the limits
+    step.engineBusy = -1.0;
+}
+
+// Ramps the number of concurrent sessions of the encode of the command line on the device for the most that sustain
+// the target frame rate within the latency bound, see VkCapacityBenchmark.
+static int RunEncodeCapacityBenchmark(const VulkanDeviceContext* vkDevCtx, int argc, char** argv,
+                                      VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    VkCapacityBenchmark capacityBenchmark("encode", encoderConfig->capacityTargetFps,
+                                          encoderConfig->capacityMaxLatencyMs, encoderConfig->capacityMaxSessions);
+    const double targetFps = capacityBenchmark.GetTargetFps();
+    const uint32_t numSessions = capacityBenchmark.Run([vkDevCtx, argc, argv, &encoderConfig, targetFps]
+                                                       (VkCapacityBenchmark::Step& step) {
+        RunEncodeCapacityStep(vkDevCtx, argc, argv, encoderConfig, targetFps, step);
+    });
+    return (numSessions > 0) ? 0 : -1;
+}
+
+// The first pass of the --twoPass encode, writing the stats file the encoder of the second pass allocates the
+// target size with. The device, its queues, the pipeline cache and the device memory arena are kept for the second
+// pass, its sessions and images are created again from the blocks the first pass released to the arena.
+static int EncodeFirstPass(const VulkanDeviceContext* vkDevCtx, int argc, char** argv)
+{
+    VkSharedBaseObj<EncoderConfig> firstPassConfig;
+    VkSharedBaseObj<VkVideoEncoder> encoder;
+    if ((EncoderConfig::CreateCodecConfig(argc, argv, firstPassConfig) != VK_SUCCESS) ||
+            !firstPassConfig->SetFirstPass()) {
+        fprintf(stderr, "\nERROR: Failed to configure the first pass\n");
+        return -1;
+    }
+    if (firstPassConfig->inputFileHandler.IsStream()) {
+        fprintf(stderr, "\nERROR: The input of --twoPass is read twice, it can't be a stream\n");
+        return -1;
+    }
+    if (VkVideoEncoder::CreateVideoEncoder(vkDevCtx, firstPassConfig, encoder) != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: Failed to create the encoder of the first pass\n");
+        return -1;
+    }
+
+    const uint32_t numFramesProcessed = firstPassConfig->transcodeFileName.empty() ?
+                                            EncodeFrames(firstPassConfig, encoder) :
+                                            TranscodeFrames(vkDevCtx, firstPassConfig, encoder);
+    const bool success = encoder->WaitForThreadsToComplete() && (numFramesProcessed > 0);
+    // The stats are written as the encoder is released
+    encoder = nullptr;
+
+    const std::string firstPassFileName = firstPassConfig->outputFileHandler.GetFileName();
+    firstPassConfig->outputFileHandler.Destroy();
+    remove(firstPassFileName.c_str());
+
+    std::cout << "First pass: " << numFramesProcessed << " frames analyzed into "
+              << firstPassConfig->twoPassStatsFileName << std::endl;
+    return success ? 0 : -1;
+}
+
 int main(int argc, char** argv)
 {
+    // The device is set up with the configuration of the first job of a --jobList
+    std::vector<std::vector<std::string>> jobArgs;
+    if (!EncoderConfig::GetJobList(argc, argv, jobArgs)) {
+        return -1;
+    }
+    std::vector<char*> firstJobArgv;
+    if (!jobArgs.empty()) {
+        for (const std::string& arg : jobArgs[0]) {
+            firstJobArgv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        firstJobArgv.push_back(nullptr);
+    }
+
     VkSharedBaseObj<EncoderConfig> encoderConfig;
-    if (VK_SUCCESS != EncoderConfig::CreateCodecConfig(argc, argv, encoderConfig)) {
+    if (VK_SUCCESS != EncoderConfig::CreateCodecConfig(jobArgs.empty() ? argc : (int)firstJobArgv.size() - 1,
+                                                       jobArgs.empty() ? argv : firstJobArgv.data(),
+                                                       encoderConfig)) {
         return -1;
     }
 
+    // The queued console messages are printed once everything declared after it is torn down
+    VkLogSession logSession(encoderConfig->verbose);
+    // Written once everything declared after it is torn down
+    VkTraceSession traceSession(encoderConfig->traceFileName.c_str());
+    VkTrace::SetThreadName("Encoder main");
+    VkMetricsServer metricsServer((uint16_t)encoderConfig->metricsPort);
+    VkMetricsFile metricsFile(encoderConfig->metricsFileName.c_str());
+    VulkanDeviceMemoryReport deviceMemoryReport(encoderConfig->deviceMemoryReport);
+    VulkanDeviceMemoryBudget::SetLimit((VkDeviceSize)encoderConfig->deviceMemoryBudgetMB * 1024 * 1024);
+
     static const char* const requiredInstanceLayerExtensions[] = {
         "VK_LAYER_KHRONOS_validation",
         VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
@@ -74,6 +539,16 @@ int main(int argc, char** argv)
         VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME,
         VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
         VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+        // The admission control of the encoders, see VulkanDeviceMemoryBudget
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        // The import of the mapped input file with --inputHostImport, see VulkanHostMappedMemory
+        VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+#if defined(__linux) || defined(__linux__) || defined(linux)
+        // The import of the dma-buf input frames, see VkImageResource::CreateFromFd()
+        VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+        VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+        VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME,
+#endif
         nullptr
     };
 
@@ -121,6 +596,9 @@ int main(int argc, char** argv)
         }
         reqDeviceExtensions.push_back(name);
     }
+    if (encoderConfig->enableVideoDecoder) {
+        reqDeviceExtensions.push_back(VK_KHR_VIDEO_DECODE_QUEUE_EXTENSION_NAME);
+    }
     // terminate the reqDeviceExtensions list with nullptr
     reqDeviceExtensions.push_back(nullptr);
 
@@ -131,6 +609,10 @@ int main(int argc, char** argv)
             optinalDeviceExtension);
 
 
+    if (!encoderConfig->deviceCacheFileName.empty()) {
+        vkDevCtxt.SetFastStartup(encoderConfig->deviceCacheFileName.c_str());
+    }
+
     VkResult result = vkDevCtxt.InitVulkanDevice(encoderConfig->appName.c_str(),
                                                  encoderConfig->verbose);
     if (result != VK_SUCCESS) {
@@ -146,7 +628,12 @@ int main(int argc, char** argv)
 
     const bool supportsDisplay = true;
     const int32_t numEncodeQueues = ((encoderConfig->queueId != 0) ||
-                                     (encoderConfig->enableHwLoadBalancing != 0)) ?
+                                     (encoderConfig->enableHwLoadBalancing != 0) ||
+                                     (encoderConfig->numParallelSegments > 1) ||
+                                     encoderConfig->enableAllIntraMultiQueue ||
+                                     (encoderConfig->splitFrameBands > 1) ||
+                                     !jobArgs.empty() || encoderConfig->enableCapacityBenchmark ||
+                                     !encoderConfig->simulcastRungs.empty()) ?
                                      -1 : // all available HW encoders
                                       1;  // only one HW encoder instance
 
@@ -165,6 +652,18 @@ int main(int argc, char** argv)
         }
     }
 
+    // The input frames are converted, generated for the benchmark and scaled for the simulcast rungs on a compute queue
+    const bool useComputeQueue = (encoderConfig->enableInputComputeConversion == 1) ||
+                                 (encoderConfig->enableBenchmark == 1) || !encoderConfig->simulcastRungs.empty();
+    const VkQueueFlags requestComputeQueueMask = useComputeQueue ? VK_QUEUE_COMPUTE_BIT : 0;
+    const bool createComputeQueue = (encoderConfig->selectVideoWithComputeQueue == 1) || useComputeQueue;
+
+    VkVideoCodecOperationFlagsKHR requestVideoEncodeCodecOperations = VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR |
+                                                                     VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR;
+#ifdef VK_KHR_video_encode_av1
+    requestVideoEncodeCodecOperations |= VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR;
+#endif
+
     VkSharedBaseObj<VulkanVideoDisplayQueue<VulkanEncoderInputFrame>> videoDispayQueue;
     result = CreateVulkanVideoEncodeDisplayQueue(&vkDevCtxt,
                                                  encoderConfig->input.width,
@@ -184,7 +683,8 @@ int main(int argc, char** argv)
     }
 
     VkSharedBaseObj<VkVideoEncoder> encoder; // the encoder's instance
-    if (supportsDisplay && encoderConfig->enableFramePresent) {
+    if (supportsDisplay && encoderConfig->enableFramePresent && jobArgs.empty() &&
+            !encoderConfig->enableCapacityBenchmark) {
 
         const Shell::Configuration configuration(encoderConfig->appName.c_str(),
                                                  4, // the display queue size
@@ -196,14 +696,13 @@ int main(int argc, char** argv)
             return -1;
         }
 
-        result = vkDevCtxt.InitPhysicalDevice((VK_QUEUE_GRAPHICS_BIT | requestVideoDecodeQueueMask | requestVideoEncodeQueueMask),
+        result = vkDevCtxt.InitPhysicalDevice((VK_QUEUE_GRAPHICS_BIT | requestVideoDecodeQueueMask | requestVideoEncodeQueueMask | requestComputeQueueMask),
                                                displayShell,
                                                requestVideoDecodeQueueMask,
                                                (VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR |
                                                 VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR),
                                                requestVideoEncodeQueueMask,
-                                                VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR |
-                                                VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR);
+                                               requestVideoEncodeCodecOperations);
         if (result != VK_SUCCESS) {
 
             assert(!"Can't initialize the Vulkan physical device!");
@@ -217,7 +716,7 @@ int main(int argc, char** argv)
                                               false,             // createTransferQueue
                                               true,              // createGraphicsQueue
                                               true,              // createDisplayQueue
-                                              (encoderConfig->selectVideoWithComputeQueue == 1)  // createComputeQueue
+                                              createComputeQueue  // createComputeQueue
                                               );
         if (result != VK_SUCCESS) {
 
@@ -225,6 +724,24 @@ int main(int argc, char** argv)
             return -1;
         }
 
+        result = vkDevCtxt.CreateDeviceMemoryArena((VkDeviceSize)encoderConfig->deviceMemoryArenaBlockSizeMB * 1024 * 1024);
+        if (result != VK_SUCCESS) {
+
+            assert(!"Failed to create the device memory arena!");
+            return -1;
+        }
+        vkDevCtxt.SetHugePageStaging(encoderConfig->enableHugePageStaging);
+
+        result = vkDevCtxt.InitPipelineCache(encoderConfig->pipelineCacheDir.c_str());
+        if (result != VK_SUCCESS) {
+
+            assert(!"Failed to create the pipeline cache!");
+            return -1;
+        }
+        if (!encoderConfig->deviceCacheFileName.empty()) {
+            vkDevCtxt.PrintStartupTimes();
+        }
+
         result = VkVideoEncoder::CreateVideoEncoder(&vkDevCtxt, encoderConfig, encoder);
         if (result != VK_SUCCESS) {
             assert(!"Can't initialize the Vulkan physical device!");
@@ -240,14 +757,13 @@ int main(int argc, char** argv)
     } else {
 
         // No display presentation and no decoder - just the encoder
-        result = vkDevCtxt.InitPhysicalDevice((requestVideoDecodeQueueMask | requestVideoEncodeQueueMask | VK_QUEUE_TRANSFER_BIT),
+        result = vkDevCtxt.InitPhysicalDevice((requestVideoDecodeQueueMask | requestVideoEncodeQueueMask | VK_QUEUE_TRANSFER_BIT | requestComputeQueueMask),
                                                nullptr,
                                                requestVideoDecodeQueueMask,
                                                (VK_VIDEO_CODEC_OPERATION_DECODE_H264_BIT_KHR |
                                                 VK_VIDEO_CODEC_OPERATION_DECODE_H265_BIT_KHR),
                                                requestVideoEncodeQueueMask,
-                                                VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR |
-                                                VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR);
+                                               requestVideoEncodeCodecOperations);
         if (result != VK_SUCCESS) {
 
             assert(!"Can't initialize the Vulkan physical device!");
@@ -262,7 +778,7 @@ int main(int argc, char** argv)
                                               ((vkDevCtxt.GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) == 0), //  createTransferQueue
                                               false, // createGraphicsQueue
                                               false, // createDisplayQueue
-                                              (encoderConfig->selectVideoWithComputeQueue == 1)  // createComputeQueue
+                                              createComputeQueue  // createComputeQueue
                                               );
         if (result != VK_SUCCESS) {
 
@@ -270,37 +786,80 @@ int main(int argc, char** argv)
             return -1;
         }
 
-        result = VkVideoEncoder::CreateVideoEncoder(&vkDevCtxt, encoderConfig, encoder);
+        result = vkDevCtxt.CreateDeviceMemoryArena((VkDeviceSize)encoderConfig->deviceMemoryArenaBlockSizeMB * 1024 * 1024);
         if (result != VK_SUCCESS) {
-            assert(!"Can't initialize the Vulkan physical device!");
+
+            assert(!"Failed to create the device memory arena!");
             return -1;
         }
-    }
+        vkDevCtxt.SetHugePageStaging(encoderConfig->enableHugePageStaging);
 
-    // Enter the encoding frame loop
-    uint32_t curFrameIndex = 0;
-    for(; curFrameIndex < encoderConfig->numFrames; curFrameIndex++) {
+        result = vkDevCtxt.InitPipelineCache(encoderConfig->pipelineCacheDir.c_str());
+        if (result != VK_SUCCESS) {
 
-        if (encoderConfig->verboseFrameStruct) {
-            std::cout << "####################################################################################" << std::endl
-                      << "Start processing current input frame index: " << curFrameIndex << std::endl;
+            assert(!"Failed to create the pipeline cache!");
+            return -1;
+        }
+        if (!encoderConfig->deviceCacheFileName.empty()) {
+            vkDevCtxt.PrintStartupTimes();
         }
 
-        VkSharedBaseObj<VkVideoEncoder::VkVideoEncodeFrameInfo> encodeFrameInfo;
-        encoder->GetAvailablePoolNode(encodeFrameInfo);
-        assert(encodeFrameInfo);
-        // load frame data from the file
-        result = encoder->LoadNextFrame(encodeFrameInfo);
+        if (!jobArgs.empty()) {
+            return EncodeJobList(&vkDevCtxt, jobArgs, encoderConfig->numParallelJobs);
+        }
+
+        if (encoderConfig->enableCapacityBenchmark) {
+            return RunEncodeCapacityBenchmark(&vkDevCtxt, argc, argv, encoderConfig);
+        }
+
+        if (encoderConfig->numParallelSegments > 1) {
+            return EncodeSegmentsInParallel(&vkDevCtxt, argc, argv, encoderConfig);
+        }
+
+        if (!encoderConfig->twoPassStatsFileName.empty() && (EncodeFirstPass(&vkDevCtxt, argc, argv) != 0)) {
+            return -1;
+        }
+
+        result = VkVideoEncoder::CreateVideoEncoder(&vkDevCtxt, encoderConfig, encoder);
         if (result != VK_SUCCESS) {
-            std::cout << "ERROR processing input frame index: " << curFrameIndex << std::endl;
-            break;
+            assert(!"Can't initialize the Vulkan physical device!");
+            return -1;
         }
+    }
 
-        if (encoderConfig->verboseFrameStruct) {
-            std::cout << "End processing current input frame index: " << curFrameIndex << std::endl;
+    // The configurations of the simulcast rungs are parsed again, their encoders are fed by the main one
+    for (uint32_t rungIndex = 0; rungIndex < encoderConfig->simulcastRungs.size(); rungIndex++) {
+        const SimulcastRung& rung = encoderConfig->simulcastRungs[rungIndex];
+        VkSharedBaseObj<EncoderConfig> rungConfig;
+        VkSharedBaseObj<VkVideoEncoder> rungEncoder;
+        if ((EncoderConfig::CreateCodecConfig(argc, argv, rungConfig, (int32_t)rungIndex) != VK_SUCCESS) ||
+                (VkVideoEncoder::CreateVideoEncoder(&vkDevCtxt, rungConfig, rungEncoder) != VK_SUCCESS) ||
+                (encoder->AttachSimulcastEncoder(rungEncoder) != VK_SUCCESS)) {
+            fprintf(stderr, "\nERROR: Failed to create the simulcast encoder of %ux%u\n", rung.width, rung.height);
+            return -1;
         }
+        std::cout << "Simulcast " << rung.width << "x" << rung.height << " encoded to "
+                  << rungConfig->outputFileHandler.GetFileName() << std::endl;
     }
 
+    // The same for the bands of the split frames after the first one, coded by the main encoder
+    for (uint32_t bandIndex = 1; bandIndex < encoderConfig->splitFrameBands; bandIndex++) {
+        VkSharedBaseObj<EncoderConfig> bandConfig;
+        VkSharedBaseObj<VkVideoEncoder> bandEncoder;
+        if ((EncoderConfig::CreateCodecConfig(argc, argv, bandConfig, -1, (int32_t)bandIndex) != VK_SUCCESS) ||
+                (VkVideoEncoder::CreateVideoEncoder(&vkDevCtxt, bandConfig, bandEncoder) != VK_SUCCESS) ||
+                (encoder->AttachSplitFrameEncoder(bandEncoder) != VK_SUCCESS)) {
+            fprintf(stderr, "\nERROR: Failed to create the encoder of the band %u of the split frames\n", bandIndex);
+            return -1;
+        }
+        std::cout << "Split frame band " << bandIndex << " of " << bandConfig->encodeWidth << "x"
+                  << bandConfig->encodeHeight << " encoded on the queue " << bandConfig->queueId << std::endl;
+    }
+
+    // Enter the encoding frame loop
+    uint32_t curFrameIndex = encoderConfig->transcodeFileName.empty() ? EncodeFrames(encoderConfig, encoder) :
+                                                                        TranscodeFrames(&vkDevCtxt, encoderConfig, encoder);
+
     encoder->WaitForThreadsToComplete();
 
     std::cout << "Done processing " << curFrameIndex << " input frames!" << std::endl
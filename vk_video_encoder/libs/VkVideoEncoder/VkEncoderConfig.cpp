@@ -14,26 +14,188 @@
  * limitations under the License.
  */
 
+#include <fstream>
 #include "VkVideoEncoder/VkEncoderConfig.h"
 #include "VkVideoEncoder/VkEncoderConfigH264.h"
 #include "VkVideoEncoder/VkEncoderConfigH265.h"
+#include "VkVideoEncoder/VkEncoderConfigAV1.h"
+#include "VkCodecUtils/VkThreadAffinity.h"
+#include "VkDecoderUtils/VideoStreamDemuxer.h"
 
 void printHelp()
 {
     fprintf(stderr,
             "Usage : EncodeApp \n\
     -i                              .yuv Input YUV File Name (YUV420p 8bpp only) \n\
-    -o                              .264/5 Output H264/5 File Name \n\
-    --codec                         <sting> select codec type: avc (h264) or hevc (h265)   \n\
+    -o                              .264/5 Output H264/5 File Name, - for stdout or unix:<path> for a stream socket \n\
+    --codec                         <sting> select codec type: avc (h264), hevc (h265) or av1   \n\
+    --av1Tiles                      <cols>x<rows> : The uniformly spaced tiles of the AV1 frames, powers of two \n\
+    --av1NumRefs                    <integer> : The references of the AV1 inter frames, from LAST_FRAME up to GOLDEN_FRAME \n\
+    --av1DisableCdef                Disable the CDEF of the AV1 frames \n\
     --startFrame                    <integer> : Start Frame Number to be Encoded \n\
     --numFrames                     <integer> : End Frame Number to be Encoded \n\
     --inputWidth                         <integer> : Encode Width \n\
     --inputHeight                        <integer> : Encode Height \n\
     --minQp                         <integer> : Minimum QP value in the range [0, 51] \n\
+    --bitstreamBufferIdleTrimMs     <integer> : Release the free bitstream buffers of a size unused for that long, 0 never \n\
+    --rightSizedBitstreamBuffers    Size the output bitstream buffers of the intra and inter frames from the rate \n\
+                                    control and the coded sizes, growing them past an overflow. Needs the overflow \n\
+                                    detection of the device \n\
+    --deviceLocalBitstream          Encode into device-local buffers, copied to the cached host buffers of the \n\
+                                    frames after the encode, in the same submission. Needs an encode queue with \n\
+                                    transfers \n\
+    --dpbImageArray                 Allocate the DPB as a single image with a layer per slot, which is always \n\
+                                    done without the separate reference images capability \n\
+    --deviceMemoryArenaBlockSizeMB  <integer> : Sub-allocate the images and buffers from blocks of that size, 0 disables \n\
+    --deviceMemoryBudgetMB          <integer> : Cap the device local memory of the encoder, on top of the budget of \n\
+                                    the device. The frames in flight are reduced to fit, else the encoder fails \n\
+    --deviceMemoryReport            Print the current and the peak device memory of each owner, e.g. the DPB, at exit \n\
+    --gpuTimestamps                 Time the encode commands on the device, reported at the end of the run \n\
+    --gpuTimestampsCsv              <string> : Same as --gpuTimestamps, also writing the per frame times to that CSV file \n\
+    --traceFile                     <string> : Write a timeline of the encoder stages and their waits, in the Chrome \n\
+                                    trace JSON format, with the device time of the frames with --gpuTimestamps \n\
+    --metricsPort                   <integer> : Serve the runtime metrics of the encoder on that TCP port, on \n\
+                                    /metrics in the Prometheus text format, 0 disables \n\
+    --metricsFile                   <string> : Write the metrics and the run time to that file in JSON at the end \n\
+                                    of the run, e.g. for scripts/perf_regression.py \n\
+    --benchmark                     Encode moving content generated on the GPU into the input images instead of the \n\
+                                    -i input, 600 frames without --numFrames. Reports the encode frame rate, the \n\
+                                    device utilization, the CPU time per stage and the bitstream size. Implies \n\
+                                    --gpuTimestamps \n\
+    --autoQualityLevel              <fps> : Steps the encode quality level up or down at each IDR frame, to the \n\
+                                    highest one whose device time per frame still sustains that frame rate. \n\
+                                    Implies --gpuTimestamps \n\
+    --inputComputeConversion        Convert the 3-plane 4:2:0 input to the encoder input format with a compute shader \n\
+    --inputBufferUpload             Upload the input frames from a buffer, without the linear staging images \n\
+    --autoInputConversion           Convert the input on the CPU or with the compute shader, whichever converts a \n\
+                                    frame faster, timed at the start and again when the encoder queue occupancy changes \n\
+    --conversionCalibrationCache    <string> : Cache the times of the input conversions in that file, per device, size \n\
+                                    and format, instead of timing them at each start with --autoInputConversion \n\
+    --inputHostImport               Import the mapped input file as host memory with VK_EXT_external_memory_host, \n\
+                                    for the compute shader to read the frames in place. Implies --inputComputeConversion \n\
+    --inputLoadAhead                <integer> : Read and convert the input frames that far ahead of the encoder, on loader threads \n\
+    --inputStreaming                Read the input file in order through a bounded window instead of mapping it, \n\
+                                    always done for pipes, FIFOs and stdin (-i -). Without --numFrames, encodes to the end \n\
+    --inputReadAhead                <integer> : Frames read ahead of the encoder when streaming the input, 4 by default \n\
+    --inputPrefault                 <integer> : Frames of the mapped input file faulted in ahead of the encoder, on a thread \n\
+    --inputHugePages                Back the mapped input file with transparent huge pages, where the file system allows it \n\
+    --hugePageStaging               Allocate the staging buffers of the host copies in 2 MB huge pages of host memory, \n\
+                                    imported with VK_EXT_external_memory_host \n\
+    --transcode                     <string> : Decode that H.264 or H.265 stream on the GPU and encode its frames, \n\
+                                    copied to the encoder input images on the GPU, instead of the -i input. The input \n\
+                                    size and bit depth are those of the container without --inputWidth and --inputHeight \n\
+    --encodeInFlightFrames          <integer> : Frames left encoding on the device before their bitstream is assembled, \n\
+                                    retired in order as their queries complete. 0 assembles each batch after its submission \n\
+    --stagePipeline                 Record and submit, then assemble the bitstream of the frames on two threads, \n\
+                                    overlapping the DPB processing of the next frames. --encodeInFlightFrames sets the \n\
+                                    frames waiting for their assembly, 4 by default \n\
+    --lowLatency                    Encode and write out each frame before the next is loaded, without B-frames, \n\
+                                    reordering, look-ahead or output buffering. Reports the input to bitstream latency \n\
+    --lowLatencyCsv                 <string> : Same as --lowLatency, also writing the per frame latencies to that CSV file \n\
+    --allIntraMultiQueue            Code all the frames as I or IDR frames, without references, and spread them over \n\
+                                    all the encode queues, the bitstream kept in the input order. Needs \n\
+                                    --rateControlMode disabled, the rate control state doesn't carry across the queues \n\
+    --packetFraming                 Write a packet header before each coded frame, with its size, PTS, DTS, key frame \n\
+                                    flag, picture type and temporal ID, for a packager not parsing the bitstream \n\
+    --qualityMetricsCsv             <string> : Compare the reconstructed frames with the input on the GPU, writing the \n\
+                                    per frame PSNR and SSIM to that CSV file and reporting their averages \n\
+    --frameStatsCsv                 <string> : Write the picture type, POC, size, QP, feedback status, device time, \n\
+                                    queue wait and latency of each frame to that CSV file, from a writer thread, \n\
+                                    and report them per picture type. Implies --gpuTimestamps \n\
+    --parallelSegments              <integer> : Split a mapped input file at IDR boundaries into that many segments, \n\
+                                    encoded by concurrent sessions over the encode queues and stitched in order \n\
+    --jobList                       <string> : Encode the jobs of that file on one device, one job per line with its \n\
+                                    options (-i, -o, --codec, ...) following those of the command line. The lines \n\
+                                    starting with # are comments \n\
+    --parallelJobs                  <integer> : The jobs of the --jobList encoded concurrently, 1 by default \n\
+    --capacityBenchmark                       : Ramp the number of concurrent sessions of this encode on the device \n\
+                                    for the most that sustain the target frame rate within the latency bound, \n\
+                                    reporting the memory and the CPU per session and the limiting resource \n\
+    --capacityTargetFps             <float> : The frame rate of each session of --capacityBenchmark, 30 by default \n\
+    --capacityMaxLatencyMs          <float> : The p99 latency of the frames of --capacityBenchmark, two frame \n\
+                                    intervals by default \n\
+    --capacityMaxSessions           <integer> : The most sessions of --capacityBenchmark, 64 by default \n\
+    --twoPass                       <string> : Encode twice, first at the fastest quality level with the constant QP, \n\
+                                    writing the per frame bits and complexity to that stats file, then with a QP per \n\
+                                    frame allocating the --targetSize over the frames. Forces --rateControlMode disabled \n\
+    --targetSize                    <integer> : The size of the --twoPass output, in bytes \n\
+    --rateControlMode               <string> : default, disabled (constant QP), cbr or vbr \n\
+    --lookAheadFrames               <integer> : Analyze the complexity of the input frames that far ahead on the GPU, \n\
+                                    adapting the QP of each frame to the window with --rateControlMode disabled \n\
+    --temporalFilter                <float> : Denoise the input frames on the GPU with a motion compensated temporal \n\
+                                    filter of that strength, from 0 (off) to 1 \n\
+    --rateControlChange             <frame>,<averageBitrate>,<maxBitrate>,<minQp>,<maxQp> : Change the rate control \n\
+                                    in-band from that input frame on, without an IDR. 0 or -1 keeps a value, can be repeated \n\
+    --adaptiveGop                   Code the scene cuts found by the look-ahead as IDR frames and shorten the B-frame \n\
+                                    runs of each GOP with the motion ahead, 8 frames of look-ahead by default \n\
+    --temporalLayers                <integer> : Code the frames in a dyadic hierarchy of that many temporal layers, \n\
+                                    up to 4, with a rate control layer each and without B-frames \n\
+    --gopPyramid                    Code the B-frames between the I and P frames as a dyadic pyramid, the middle one \n\
+                                    first as a reference for the B-frames of each half, and so on \n\
+    --pyramidQpOffset               <integer> : The constant QP offset of each B-frame level of the pyramid \n\
+                                    below the first one, 1 by default. With --rateControlMode disabled \n\
+    --simulcast                     <width>x<height>[,<averageBitrate>] : Also encode a copy of the input scaled on the \n\
+                                    GPU to that size, with its own session, into <output>.<width>x<height>. Can be repeated \n\
+    --simulcastScaler               <box|bilinear|bicubic|lanczos> : The kernel the --simulcast copies are scaled \n\
+                                    with, box (the average of the covered samples) by default \n\
+    --splitFrameBands               <integer> : Split the pictures into that many bands of CTB rows, up to 4, each \n\
+                                    encoded by its own session on its own encode queue, their slices stitched into \n\
+                                    the picture. H.265 with all the frames intra coded, the bands don't predict \n\
+                                    across each other \n\
+    --longTermRefInterval           <integer> : Keep the IDR frames, and then a P frame every that many frames, as the \n\
+                                    long-term reference to recover from lost frames with (H.264, IPPP without temporal layers) \n\
+    --lostFrame                     <frame> : Invalidate the references from that input frame on, as the receiver feedback \n\
+                                    of a lost frame would, with the next frame. Can be repeated \n\
+    --intraRefresh                  <integer> : Refresh the picture over that many P frames, intra coding one slice of \n\
+                                    each, instead of the periodic IDR and I frames. Without B-frames \n\
+    --sliceRows                     <integer> : Split the pictures in slices of that many MB (H.264) or CTB (H.265) rows \n\
+    --sliceBytes                    <integer> : Split the pictures in slices of about that many bytes, estimated from \n\
+                                    the average bitrate. The slice offsets are printed with --verboseFrameStruct \n\
+    --outputWriterThread            Write the output bitstream in large blocks from a dedicated thread \n\
+    --inputConversionThreads        <integer> : Split the CPU conversion of each input frame in row bands over that many threads \n\
+    --consumerCpus                  <cpulist> : Run the encoder queue consumer and the stage pipeline threads on these \n\
+                                    CPUs, e.g. 0-7,16 \n\
+    --loaderCpus                    <cpulist> : Pin the --inputLoadAhead threads to these CPUs, one each, with their \n\
+                                    staging buffers on the NUMA node of the first one \n\
+    --writerCpus                    <cpulist> : Run the --outputWriterThread thread on these CPUs \n\
+    --pipelineCacheDir              <directory> : Keep the pipeline cache and the SPIR-V of the compute filters \n\
+                                    in this directory between the runs \n\
+    --fastStartup                   <string> : Select the physical device and its queues from that cache file, \n\
+                                    written by the first run, without enumerating them. Reports the startup times \n\
     --logBatchEncoding              Enable verbose logging of batch recording and submission of commands \n"
     );
 }
 
+// The input size and bit depth of --transcode, from the container of the stream unless they are given
+static bool GetTranscodeInputParameters(EncoderConfig *encoderConfig)
+{
+    if ((encoderConfig->input.width != 0) && (encoderConfig->input.height != 0)) {
+        return true;
+    }
+
+    const char* fileName = encoderConfig->transcodeFileName.c_str();
+    VkSharedBaseObj<VideoStreamDemuxer> videoStreamDemuxer;
+    if (VideoStreamDemuxer::IsStreamingInput(fileName) ||
+            (VideoStreamDemuxer::Create(fileName, VK_VIDEO_CODEC_OPERATION_NONE_KHR, true,
+                                        0, 0, 0, videoStreamDemuxer) != VK_SUCCESS) ||
+            (videoStreamDemuxer->GetWidth() <= 0) || (videoStreamDemuxer->GetHeight() <= 0)) {
+        fprintf(stderr, "The size of the transcoded stream %s is not known, specify --inputWidth and --inputHeight\n",
+                fileName);
+        return false;
+    }
+
+    // The decoded pictures are semi-planar
+    encoderConfig->input.width = (uint32_t)videoStreamDemuxer->GetWidth();
+    encoderConfig->input.height = (uint32_t)videoStreamDemuxer->GetHeight();
+    encoderConfig->input.bpp = (uint32_t)std::max(videoStreamDemuxer->GetBitDepth(), 8);
+    if (videoStreamDemuxer->GetChromaSubsampling() != 0) {
+        encoderConfig->input.chromaSubsampling =
+                (VkVideoChromaSubsamplingFlagBitsKHR)videoStreamDemuxer->GetChromaSubsampling();
+    }
+    encoderConfig->input.numPlanes = 2;
+    return true;
+}
+
 static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
 {
     encoderConfig->appName = argv[0];
@@ -45,9 +207,8 @@ static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
                 fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
                 return -1;
             }
-            size_t fileSize = encoderConfig->inputFileHandler.SetFileName(argv[i]);
-            if (fileSize <= 0) {
-                return (int)fileSize;
+            if (!encoderConfig->inputFileHandler.SetFileName(argv[i])) {
+                return -1;
             }
         } else if (strcmp(argv[i], "-o") == 0) {
             if (++i >= argc) {
@@ -67,6 +228,10 @@ static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
                 encoderConfig->codec = VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR;
             } else if ((strcmp(codec, "hevc") == 0) || (strcmp(codec, "h265") == 0)) {
                 encoderConfig->codec = VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR;
+#ifdef VK_KHR_video_encode_av1
+            } else if (strcmp(codec, "av1") == 0) {
+                encoderConfig->codec = VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR;
+#endif
             } else {
                 // Invalid codec
                 fprintf(stderr, "Invalid codec: %s\n", codec);
@@ -74,6 +239,32 @@ static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
             }
             printf("Selected codec: %s\n", codec);
             i++; // Skip the next argument since it's the codec value
+#ifdef VK_KHR_video_encode_av1
+        } else if ((strcmp(argv[i], "--av1Tiles") == 0) || (strcmp(argv[i], "--av1NumRefs") == 0) ||
+                   (strcmp(argv[i], "--av1DisableCdef") == 0)) {
+            EncoderConfigAV1* pEncoderConfigAV1 = encoderConfig->GetEncoderConfigAV1();
+            if (pEncoderConfigAV1 == nullptr) {
+                fprintf(stderr, "%s is only valid with --codec av1\n", argv[i]);
+                return -1;
+            }
+            if (strcmp(argv[i], "--av1DisableCdef") == 0) {
+                pEncoderConfigAV1->enableCdef = false;
+            } else if (strcmp(argv[i], "--av1Tiles") == 0) {
+                if ((++i >= argc) || (sscanf(argv[i], "%ux%u", &pEncoderConfigAV1->tileColumns,
+                                             &pEncoderConfigAV1->tileRows) != 2)) {
+                    fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                    return -1;
+                }
+            } else {
+                uint32_t numRefs = 0;
+                if ((++i >= argc) || (sscanf(argv[i], "%u", &numRefs) != 1) ||
+                        (numRefs < 1) || (numRefs > EncoderConfigAV1::MAX_NUM_REFS)) {
+                    fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                    return -1;
+                }
+                pEncoderConfigAV1->numRefL0 = (uint8_t)numRefs;
+            }
+#endif
         } else if ((strcmp(argv[i], "--inputWidth") == 0)) {
             if ((++i >= argc) || (sscanf(argv[i], "%u", &encoderConfig->input.width) != 1)) {
                 fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
@@ -136,8 +327,336 @@ static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
                 fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
                 return -1;
             }
+        } else if (strcmp(argv[i], "--bitstreamBufferIdleTrimMs") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->bitstreamBufferIdleTrimMs) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--deviceMemoryArenaBlockSizeMB") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->deviceMemoryArenaBlockSizeMB) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--deviceMemoryBudgetMB") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->deviceMemoryBudgetMB) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--deviceMemoryReport") == 0) {
+            encoderConfig->deviceMemoryReport = true;
+        } else if (strcmp(argv[i], "--gpuTimestamps") == 0) {
+            encoderConfig->gpuTimestamps = true;
+        } else if (strcmp(argv[i], "--gpuTimestampsCsv") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->gpuTimestamps = true;
+            encoderConfig->gpuTimestampsCsvFileName = argv[i];
+        } else if (strcmp(argv[i], "--traceFile") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->traceFileName = argv[i];
+        } else if (strcmp(argv[i], "--metricsFile") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->metricsFileName = argv[i];
+        } else if (strcmp(argv[i], "--metricsPort") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->metricsPort) != 1 ||
+                    (encoderConfig->metricsPort > 65535)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--benchmark") == 0) {
+            encoderConfig->enableBenchmark = true;
+            encoderConfig->gpuTimestamps = true;
+        } else if (strcmp(argv[i], "--autoQualityLevel") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%lf", &encoderConfig->autoQualityLevelFps) != 1) ||
+                    (encoderConfig->autoQualityLevelFps <= 0.0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->gpuTimestamps = true;
+        } else if (strcmp(argv[i], "--inputComputeConversion") == 0) {
+            encoderConfig->enableInputComputeConversion = true;
+        } else if (strcmp(argv[i], "--inputBufferUpload") == 0) {
+            encoderConfig->enableInputBufferUpload = true;
+        } else if (strcmp(argv[i], "--autoInputConversion") == 0) {
+            encoderConfig->enableInputConversionAuto = true;
+        } else if (strcmp(argv[i], "--conversionCalibrationCache") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->conversionCalibrationCacheFileName = argv[i];
+        } else if (strcmp(argv[i], "--inputHostImport") == 0) {
+            encoderConfig->enableInputHostImport = true;
+            encoderConfig->enableInputComputeConversion = true;
+        } else if (strcmp(argv[i], "--transcode") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->transcodeFileName = argv[i];
+            encoderConfig->enableVideoDecoder = true;
+        } else if (strcmp(argv[i], "--inputConversionThreads") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->inputConversionThreads) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--encodeInFlightFrames") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->encodeInFlightFrames) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--stagePipeline") == 0) {
+            encoderConfig->enableStagePipeline = true;
+        } else if (strcmp(argv[i], "--lowLatency") == 0) {
+            encoderConfig->enableLowLatency = true;
+        } else if (strcmp(argv[i], "--lowLatencyCsv") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->enableLowLatency = true;
+            encoderConfig->lowLatencyCsvFileName = argv[i];
+        } else if (strcmp(argv[i], "--allIntraMultiQueue") == 0) {
+            encoderConfig->enableAllIntraMultiQueue = true;
+        } else if (strcmp(argv[i], "--packetFraming") == 0) {
+            encoderConfig->enablePacketFraming = true;
+        } else if (strcmp(argv[i], "--rightSizedBitstreamBuffers") == 0) {
+            encoderConfig->enableRightSizedBitstreamBuffers = true;
+        } else if (strcmp(argv[i], "--deviceLocalBitstream") == 0) {
+            encoderConfig->enableDeviceLocalBitstream = true;
+        } else if (strcmp(argv[i], "--dpbImageArray") == 0) {
+            encoderConfig->enableDpbImageArray = true;
+        } else if (strcmp(argv[i], "--qualityMetricsCsv") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->qualityMetricsCsvFileName = argv[i];
+        } else if (strcmp(argv[i], "--frameStatsCsv") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->frameStatsCsvFileName = argv[i];
+            encoderConfig->gpuTimestamps = true;
+        } else if (strcmp(argv[i], "--parallelSegments") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->numParallelSegments) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--jobList") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->jobListFileName = argv[i];
+        } else if (strcmp(argv[i], "--parallelJobs") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->numParallelJobs) != 1 ||
+                    (encoderConfig->numParallelJobs == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--capacityBenchmark") == 0) {
+            encoderConfig->enableCapacityBenchmark = true;
+        } else if (strcmp(argv[i], "--capacityTargetFps") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%lf", &encoderConfig->capacityTargetFps) != 1) ||
+                    (encoderConfig->capacityTargetFps <= 0.0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--capacityMaxLatencyMs") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%lf", &encoderConfig->capacityMaxLatencyMs) != 1) ||
+                    (encoderConfig->capacityMaxLatencyMs < 0.0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--capacityMaxSessions") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->capacityMaxSessions) != 1 ||
+                    (encoderConfig->capacityMaxSessions == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--twoPass") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->twoPassStatsFileName = argv[i];
+        } else if (strcmp(argv[i], "--targetSize") == 0) {
+            unsigned long long targetSizeBytes = 0;
+            if (++i >= argc || sscanf(argv[i], "%llu", &targetSizeBytes) != 1 || (targetSizeBytes == 0)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->targetSizeBytes = targetSizeBytes;
+        } else if (strcmp(argv[i], "--rateControlMode") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            if (strcmp(argv[i], "default") == 0) {
+                encoderConfig->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DEFAULT_KHR;
+            } else if (strcmp(argv[i], "disabled") == 0) {
+                encoderConfig->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR;
+            } else if (strcmp(argv[i], "cbr") == 0) {
+                encoderConfig->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_CBR_BIT_KHR;
+            } else if (strcmp(argv[i], "vbr") == 0) {
+                encoderConfig->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_VBR_BIT_KHR;
+            } else {
+                fprintf(stderr, "Invalid rate control mode: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--lookAheadFrames") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->lookAheadFrames) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--temporalFilter") == 0) {
+            if ((++i >= argc) || (sscanf(argv[i], "%f", &encoderConfig->temporalFilterStrength) != 1) ||
+                    (encoderConfig->temporalFilterStrength < 0.0f) || (encoderConfig->temporalFilterStrength > 1.0f)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--rateControlChange") == 0) {
+            unsigned long long frameNum = 0;
+            RateControlChange rateControlChange = RateControlChange();
+            if (++i >= argc || sscanf(argv[i], "%llu,%u,%u,%d,%d", &frameNum,
+                                      &rateControlChange.averageBitrate, &rateControlChange.maxBitrate,
+                                      &rateControlChange.minQp, &rateControlChange.maxQp) != 5) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            rateControlChange.frameNum = frameNum;
+            encoderConfig->rateControlChanges.push_back(rateControlChange);
+        } else if (strcmp(argv[i], "--adaptiveGop") == 0) {
+            encoderConfig->enableAdaptiveGop = true;
+        } else if (strcmp(argv[i], "--temporalLayers") == 0) {
+            uint32_t temporalLayerCount = 0;
+            if (++i >= argc || sscanf(argv[i], "%u", &temporalLayerCount) != 1 ||
+                    (temporalLayerCount < 1) || (temporalLayerCount > EncoderConfig::MAX_TEMPORAL_LAYER_COUNT)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->gopStructure.SetTemporalLayerCount((int8_t)temporalLayerCount);
+        } else if (strcmp(argv[i], "--gopPyramid") == 0) {
+            encoderConfig->gopStructure.SetPyramid(true);
+        } else if (strcmp(argv[i], "--pyramidQpOffset") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%d", &encoderConfig->pyramidQpOffset) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--simulcast") == 0) {
+            SimulcastRung simulcastRung = SimulcastRung();
+            if (++i >= argc || sscanf(argv[i], "%ux%u,%u", &simulcastRung.width, &simulcastRung.height,
+                                      &simulcastRung.averageBitrate) < 2 ||
+                    (simulcastRung.width == 0) || (simulcastRung.height == 0) ||
+                    (encoderConfig->simulcastRungs.size() >= EncoderConfig::MAX_SIMULCAST_RUNGS)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->simulcastRungs.push_back(simulcastRung);
+        } else if (strcmp(argv[i], "--simulcastScaler") == 0) {
+            static const char* const scalerNames[] = { "box", "bilinear", "bicubic", "lanczos" };
+            const uint32_t numScalers = sizeof(scalerNames) / sizeof(scalerNames[0]);
+            uint32_t scaler = 0;
+            if (++i < argc) {
+                while ((scaler < numScalers) && (strcmp(argv[i], scalerNames[scaler]) != 0)) {
+                    scaler++;
+                }
+            }
+            if ((i >= argc) || (scaler >= numScalers)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->simulcastScaler = scaler;
+        } else if (strcmp(argv[i], "--splitFrameBands") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->splitFrameBands) != 1 ||
+                    (encoderConfig->splitFrameBands == 0) ||
+                    (encoderConfig->splitFrameBands > EncoderConfig::MAX_SPLIT_FRAME_BANDS)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--longTermRefInterval") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->longTermRefInterval) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--lostFrame") == 0) {
+            unsigned long long lostFrame = 0;
+            if (++i >= argc || sscanf(argv[i], "%llu", &lostFrame) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->lostFrames.push_back(lostFrame);
+        } else if (strcmp(argv[i], "--intraRefresh") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->intraRefreshPeriod) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--sliceRows") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->sliceRows) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--sliceBytes") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->sliceBytes) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if ((strcmp(argv[i], "--consumerCpus") == 0) || (strcmp(argv[i], "--loaderCpus") == 0) ||
+                   (strcmp(argv[i], "--writerCpus") == 0)) {
+            std::vector<uint32_t>& cpus = (strcmp(argv[i], "--consumerCpus") == 0) ? encoderConfig->consumerCpus :
+                                          (strcmp(argv[i], "--loaderCpus") == 0) ? encoderConfig->loaderCpus :
+                                                                                    encoderConfig->writerCpus;
+            if (++i >= argc || !VkParseCpuList(argv[i], cpus)) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--pipelineCacheDir") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->pipelineCacheDir = argv[i];
+        } else if (strcmp(argv[i], "--fastStartup") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+            encoderConfig->deviceCacheFileName = argv[i];
+        } else if (strcmp(argv[i], "--outputWriterThread") == 0) {
+            encoderConfig->enableOutputWriterThread = true;
+        } else if (strcmp(argv[i], "--inputStreaming") == 0) {
+            encoderConfig->enableInputStreaming = true;
+        } else if (strcmp(argv[i], "--inputReadAhead") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->inputReadAheadFrames) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--inputPrefault") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->inputPrefaultFrames) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--inputHugePages") == 0) {
+            encoderConfig->enableInputHugePages = true;
+        } else if (strcmp(argv[i], "--hugePageStaging") == 0) {
+            encoderConfig->enableHugePageStaging = true;
+        } else if (strcmp(argv[i], "--inputLoadAhead") == 0) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->inputLoadAheadFrames) != 1) {
+                fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
+                return -1;
+            }
         } else if (strcmp(argv[i], "--maxQp") == 0) {
-            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->minQp) != 1) {
+            if (++i >= argc || sscanf(argv[i], "%u", &encoderConfig->maxQp) != 1) {
                 fprintf(stderr, "invalid parameter for %s\n", argv[i - 1]);
                 return -1;
             }
@@ -148,7 +667,11 @@ static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
         }
     }
 
-    if (!encoderConfig->inputFileHandler.HasFileName()) {
+    if (!encoderConfig->transcodeFileName.empty()) {
+        if (!GetTranscodeInputParameters(encoderConfig)) {
+            return -1;
+        }
+    } else if (!encoderConfig->enableBenchmark && !encoderConfig->inputFileHandler.HasFileName()) {
         fprintf(stderr, "An input file was not specified\n");
         return -1;
     }
@@ -180,13 +703,234 @@ static int parseArguments(EncoderConfig *encoderConfig, int argc, char *argv[])
         encoderConfig->minQp = 20;
     }
 
+    if (!encoderConfig->twoPassStatsFileName.empty()) {
+        if (encoderConfig->targetSizeBytes == 0) {
+            fprintf(stderr, "--twoPass needs a --targetSize\n");
+            return -1;
+        }
+        // The QP of each frame is set by the second pass
+        encoderConfig->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR;
+    }
+
+    if (encoderConfig->splitFrameBands > 1) {
+        // The slice headers of the bands are rewritten for the whole picture, which is only done for H.265
+        if (encoderConfig->codec != VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR) {
+            fprintf(stderr, "--splitFrameBands is only supported with --codec hevc\n");
+            return -1;
+        }
+        if ((encoderConfig->intraRefreshPeriod > 0) || !encoderConfig->simulcastRungs.empty() ||
+                (encoderConfig->numParallelSegments > 1) || !encoderConfig->twoPassStatsFileName.empty()) {
+            fprintf(stderr, "--splitFrameBands can't be combined with --intraRefresh, --simulcast, "
+                            "--parallelSegments or --twoPass\n");
+            return -1;
+        }
+    }
+
     encoderConfig->codecBlockAlignment = H264MbSizeAlignment; // H264
 
     return 0;
 }
 
+bool EncoderConfig::SetSimulcastRung(uint32_t rungIndex)
+{
+    if (rungIndex >= simulcastRungs.size()) {
+        return false;
+    }
+    const SimulcastRung rung = simulcastRungs[rungIndex];
+
+    // The input of the rung is the scaled image, the encode size follows it in InitializeParameters()
+    input.width = rung.width;
+    input.height = rung.height;
+    encodeWidth = 0;
+    encodeHeight = 0;
+    if (rung.averageBitrate > 0) {
+        if ((maxBitrate > 0) && (averageBitrate > 0)) {
+            // Keep the ratio of the peak to the average bitrate
+            maxBitrate = (uint32_t)std::min<uint64_t>((uint64_t)maxBitrate * rung.averageBitrate / averageBitrate,
+                                                      UINT32_MAX);
+        }
+        averageBitrate = rung.averageBitrate;
+    }
+
+    // Nothing is loaded, displayed or analyzed on the input of the rung
+    simulcastRung = true;
+    simulcastRungs.clear();
+    rateControlChanges.clear();
+    lostFrames.clear();
+    queueId = (int32_t)rungIndex + 1;
+    enableAllIntraMultiQueue = false; // the rungs are spread over the queues instead
+    numParallelSegments = 0;
+    inputLoadAheadFrames = 0;
+    inputConversionThreads = 1;
+    lookAheadFrames = 0;
+    temporalFilterStrength = 0.0f; // the rungs are scaled from the filtered input
+    enableAdaptiveGop = false;
+    enableBenchmark = false; // the main encoder generates the frames scaled for the rung
+    enableInputComputeConversion = false;
+    enableInputBufferUpload = false;
+    enableInputHostImport = false;
+    enableInputConversionAuto = false;
+    enableFramePresent = false;
+    gpuTimestampsCsvFileName.clear();
+    lowLatencyCsvFileName.clear();
+    qualityMetricsCsvFileName.clear();
+    frameStatsCsvFileName.clear();
+
+    const std::string outputFileName = std::string(outputFileHandler.GetFileName()) + "." +
+                                           std::to_string(rung.width) + "x" + std::to_string(rung.height);
+    return (outputFileHandler.SetFileName(outputFileName.c_str()) > 0);
+}
+
+bool EncoderConfig::GetSplitFrameBand(uint32_t bandIndex, uint32_t& bandY, uint32_t& bandHeight) const
+{
+    const uint32_t rowHeight = GetSliceRowHeight();
+    const uint32_t bandRows = DivUp<uint32_t>(DivUp<uint32_t>(splitFrameHeight, rowHeight), splitFrameBands);
+    bandY = bandIndex * bandRows * rowHeight;
+    if ((bandIndex >= splitFrameBands) || (bandY >= splitFrameHeight)) {
+        return false;
+    }
+    bandHeight = std::min(bandRows * rowHeight, splitFrameHeight - bandY);
+    return true;
+}
+
+bool EncoderConfig::SetSplitFrameBand(uint32_t bandIndex)
+{
+    splitFrameHeight = encodeHeight;
+    uint32_t bandY = 0;
+    uint32_t bandHeight = 0;
+    if (!GetSplitFrameBand(bandIndex, bandY, bandHeight)) {
+        fprintf(stderr, "The picture height of %u can't be split into %u bands of CTB rows\n",
+                splitFrameHeight, splitFrameBands);
+        return false;
+    }
+
+    // The bands share the bitrate by their height
+    averageBitrate = (uint32_t)(((uint64_t)averageBitrate * bandHeight) / splitFrameHeight);
+    maxBitrate = (uint32_t)(((uint64_t)maxBitrate * bandHeight) / splitFrameHeight);
+    splitFrameBandIndex = bandIndex;
+    encodeHeight = bandHeight;
+    enableAllIntraMultiQueue = false; // the bands are spread over the queues instead
+    // The slices of a picture have the same type, no band codes an IDR picture of its own
+    enableAdaptiveGop = false;
+    lostFrames.clear();
+    if (bandIndex == 0) {
+        // The main encoder loads the whole frames and codes the first band of them
+        return true;
+    }
+
+    // The input of the band is copied from the main encoder's input image, nothing is loaded, displayed or
+    // analyzed on it. Its coded slices are handed over to the main encoder, which writes the bitstream.
+    input.height = bandHeight;
+    rateControlChanges.clear();
+    queueId = (int32_t)bandIndex;
+    inputLoadAheadFrames = 0;
+    inputConversionThreads = 1;
+    lookAheadFrames = 0;
+    temporalFilterStrength = 0.0f; // the bands are copied from the filtered input
+    enableBenchmark = false; // the main encoder generates the frames the bands are copied from
+    enableInputComputeConversion = false;
+    enableInputBufferUpload = false;
+    enableInputHostImport = false;
+    enableInputConversionAuto = false;
+    enableFramePresent = false;
+    enableLowLatency = false;
+    enablePacketFraming = false;
+    enableOutputWriterThread = false;
+    // Assembled on its own thread, for the main encoder not to wait on the band's encode before submitting its own
+    enableStagePipeline = true;
+    encodeInFlightFrames = 0;
+    gpuTimestampsCsvFileName.clear();
+    lowLatencyCsvFileName.clear();
+    qualityMetricsCsvFileName.clear();
+    frameStatsCsvFileName.clear();
+    outputFileHandler.Destroy();
+    return true;
+}
+
+bool EncoderConfig::SetFirstPass()
+{
+    // Only the bits of the frames at the constant QP are of interest
+    firstPass = true;
+    qualityLevel = 0;
+    simulcastRungs.clear();
+    rateControlChanges.clear();
+    enableFramePresent = false;
+    enablePacketFraming = false;
+    gpuTimestampsCsvFileName.clear();
+    lowLatencyCsvFileName.clear();
+    qualityMetricsCsvFileName.clear();
+    frameStatsCsvFileName.clear();
+    metricsFileName.clear();
+    traceFileName.clear();
+
+    const std::string outputFileName = std::string(outputFileHandler.GetFileName()) + ".pass1";
+    return (outputFileHandler.SetFileName(outputFileName.c_str()) > 0);
+}
+
+bool EncoderConfig::GetJobList(int argc, char *argv[], std::vector<std::vector<std::string>>& jobArgs)
+{
+    jobArgs.clear();
+
+    std::vector<std::string> commonArgs;
+    const char* jobListFileName = nullptr;
+    for (int32_t i = 0; i < argc; i++) {
+        if ((strcmp(argv[i], "--jobList") == 0) && ((i + 1) < argc)) {
+            jobListFileName = argv[++i];
+        } else {
+            commonArgs.push_back(argv[i]);
+        }
+    }
+    if (jobListFileName == nullptr) {
+        return true;
+    }
+
+    std::ifstream jobListFile(jobListFileName);
+    if (!jobListFile.is_open()) {
+        fprintf(stderr, "Failed to open the job list %s\n", jobListFileName);
+        return false;
+    }
+
+    // The options are separated by blanks, those with blanks in double quotes
+    std::string line;
+    while (std::getline(jobListFile, line)) {
+        std::vector<std::string> args(commonArgs);
+        std::string arg;
+        bool quoted = false, hasArg = false;
+        for (const char c : line) {
+            if (c == '"') {
+                quoted = !quoted;
+                hasArg = true;
+            } else if (!quoted && ((c == ' ') || (c == '\t') || (c == '\r'))) {
+                if (hasArg) {
+                    args.push_back(arg);
+                }
+                arg.clear();
+                hasArg = false;
+            } else if (!quoted && !hasArg && (c == '#')) {
+                break;
+            } else {
+                arg.push_back(c);
+                hasArg = true;
+            }
+        }
+        if (hasArg) {
+            args.push_back(arg);
+        }
+        if (args.size() > commonArgs.size()) {
+            jobArgs.push_back(args);
+        }
+    }
+
+    if (jobArgs.empty()) {
+        fprintf(stderr, "No job in the job list %s\n", jobListFileName);
+        return false;
+    }
+    return true;
+}
+
 VkResult EncoderConfig::CreateCodecConfig(int argc, char *argv[],
-                                          VkSharedBaseObj<EncoderConfig>& encoderConfig)
+                                          VkSharedBaseObj<EncoderConfig>& encoderConfig,
+                                          int32_t simulcastRungIndex, int32_t splitFrameBandIndex)
 {
 
     VkVideoCodecOperationFlagBitsKHR codec = VK_VIDEO_CODEC_OPERATION_NONE_KHR;
@@ -199,10 +943,14 @@ VkResult EncoderConfig::CreateCodecConfig(int argc, char *argv[],
                 codec = VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR;
             } else if ((strcmp(codecStr, "hevc") == 0) || (strcmp(codecStr, "h265") == 0)) {
                 codec = VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR;
+#ifdef VK_KHR_video_encode_av1
+            } else if (strcmp(codecStr, "av1") == 0) {
+                codec = VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR;
+#endif
             } else {
                 // Invalid codec
                 fprintf(stderr, "Invalid codec: %s\n", codecStr);
-                fprintf(stderr, "Supported codecs are: avc and hevc\n");
+                fprintf(stderr, "Supported codecs are: avc, hevc and av1\n");
                 return VK_ERROR_VIDEO_PROFILE_CODEC_NOT_SUPPORTED_KHR;
             }
         }
@@ -217,6 +965,10 @@ VkResult EncoderConfig::CreateCodecConfig(int argc, char *argv[],
             return VK_ERROR_INITIALIZATION_FAILED;
         }
 
+        if ((simulcastRungIndex >= 0) && !vkEncoderConfigh264->SetSimulcastRung((uint32_t)simulcastRungIndex)) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
         VkResult result = vkEncoderConfigh264->InitializeParameters();
         if (result != VK_SUCCESS) {
             assert(!"InitializeParameters failed");
@@ -235,6 +987,16 @@ VkResult EncoderConfig::CreateCodecConfig(int argc, char *argv[],
             return VK_ERROR_INITIALIZATION_FAILED;
         }
 
+        if ((simulcastRungIndex >= 0) && !vkEncoderConfigh265->SetSimulcastRung((uint32_t)simulcastRungIndex)) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        // Without a band index, the main encoder of the split frames, coding the first band
+        if ((vkEncoderConfigh265->splitFrameBands > 1) &&
+                !vkEncoderConfigh265->SetSplitFrameBand((splitFrameBandIndex > 0) ? (uint32_t)splitFrameBandIndex : 0)) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
         VkResult result = vkEncoderConfigh265->InitializeParameters();
         if (result != VK_SUCCESS) {
             assert(!"InitializeParameters failed");
@@ -244,6 +1006,30 @@ VkResult EncoderConfig::CreateCodecConfig(int argc, char *argv[],
         encoderConfig = vkEncoderConfigh265;
         return VK_SUCCESS;
 
+#ifdef VK_KHR_video_encode_av1
+    } else if (codec == VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR) {
+
+        VkSharedBaseObj<EncoderConfigAV1> vkEncoderConfigAV1(new EncoderConfigAV1());
+        int ret = parseArguments(vkEncoderConfigAV1, argc, argv);
+        if (ret != 0) {
+            assert(!"Invalid arguments");
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        if ((simulcastRungIndex >= 0) && !vkEncoderConfigAV1->SetSimulcastRung((uint32_t)simulcastRungIndex)) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        VkResult result = vkEncoderConfigAV1->InitializeParameters();
+        if (result != VK_SUCCESS) {
+            assert(!"InitializeParameters failed");
+            return result;
+        }
+
+        encoderConfig = vkEncoderConfigAV1;
+        return VK_SUCCESS;
+#endif
+
     } else {
         fprintf(stderr, "Codec type is not selected\n. Please select it with --codec <avc or hevc> parameters\n");
         return VK_ERROR_VIDEO_PROFILE_CODEC_NOT_SUPPORTED_KHR;
@@ -295,3 +1081,59 @@ bool EncoderConfig::InitRateControl()
 
     return true;
 }
+
+void EncoderConfig::InitSliceCount()
+{
+    // A slice per row at most
+    const uint32_t picHeightInSliceRows = std::max<uint32_t>(GetPicHeightInSliceRows(), 1);
+    const uint32_t maxSlices = std::min<uint32_t>(std::min<uint32_t>(maxSliceCount, picHeightInSliceRows),
+                                                  MAX_NUM_SLICES_PER_PICTURE);
+
+    if (intraRefreshPeriod > maxSlices) {
+        std::cout << "The intra refresh period is limited to " << maxSlices << " by the device" << std::endl;
+        intraRefreshPeriod = maxSlices;
+    }
+
+    sliceCount = 1;
+    if (intraRefreshPeriod > 0) {
+        // The intra refresh codes one of its slices per frame
+        sliceCount = intraRefreshPeriod;
+    } else if (sliceRows > 0) {
+        sliceCount = DivUp<uint32_t>(picHeightInSliceRows, sliceRows);
+    } else if ((sliceBytes > 0) && (averageBitrate > 0) && (frameRateNumerator > 0)) {
+        // The device splits the pictures in slices of whole rows, not by size: from the average frame size
+        const uint64_t averageFrameBytes = (uint64_t)averageBitrate * std::max<uint32_t>(frameRateDenominator, 1) /
+                                           (8ULL * frameRateNumerator);
+        sliceCount = (uint32_t)std::min<uint64_t>(DivUp<uint64_t>(averageFrameBytes, sliceBytes), maxSlices);
+    }
+
+    if (sliceCount > maxSlices) {
+        std::cout << "The slices are limited to " << maxSlices << " per picture by the device" << std::endl;
+        sliceCount = maxSlices;
+    }
+}
+
+uint32_t EncoderConfig::GetRateControlLayers(VkVideoEncodeRateControlLayerInfoKHR* pRateControlLayersInfo) const
+{
+    // The cumulative share of the bitrate, in percent, of the layers up to each one of the dyadic hierarchy
+    static const uint32_t layerBitratePercent[MAX_TEMPORAL_LAYER_COUNT][MAX_TEMPORAL_LAYER_COUNT] = {
+        { 100,   0,   0,   0 },
+        {  60, 100,   0,   0 },
+        {  40,  60, 100,   0 },
+        {  25,  40,  60, 100 },
+    };
+
+    const uint32_t layerCount = std::min<uint32_t>(std::max<int32_t>(gopStructure.GetTemporalLayerCount(), 1),
+                                                   MAX_TEMPORAL_LAYER_COUNT);
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+        // Each layer above the base one doubles the frame rate
+        const uint32_t frameRateDivider = 1 << (layerCount - 1 - layer);
+        pRateControlLayersInfo[layer].frameRateNumerator = frameRateNumerator;
+        pRateControlLayersInfo[layer].frameRateDenominator = frameRateDenominator * frameRateDivider;
+        const uint64_t bitratePercent = layerBitratePercent[layerCount - 1][layer];
+        pRateControlLayersInfo[layer].averageBitrate = averageBitrate * bitratePercent / 100;
+        pRateControlLayersInfo[layer].maxBitrate = hrdBitrate * bitratePercent / 100;
+    }
+
+    return layerCount;
+}
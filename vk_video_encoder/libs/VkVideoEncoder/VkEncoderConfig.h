@@ -19,7 +19,25 @@
 
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 #include "mio/mio.hpp"
 #include "vk_video/vulkan_video_codecs_common.h"
 #include "vk_video/vulkan_video_codec_h264std.h"
@@ -33,6 +51,7 @@
 
 struct EncoderConfigH264;
 struct EncoderConfigH265;
+struct EncoderConfigAV1;
 class VulkanDeviceContext;
 
 static VkVideoComponentBitDepthFlagBitsKHR GetComponentBitDepthFlagBits(uint32_t bpp)
@@ -145,13 +164,33 @@ public:
     }
 };
 
+// Maps the input file, or streams it through a bounded window of frames read in order.
+// Pipes, FIFOs and stdin ("-") are always streamed, a regular file only with SetStreaming().
+// The frames of a mapped file can be faulted in ahead of the encoder with StartPrefault().
 class EncoderInputFileHandler
 {
 public:
     EncoderInputFileHandler()
     : m_fileName{},
       m_fileHandle(),
-      m_memMapedFile()
+      m_memMapedFile(),
+      m_mutex(),
+      m_isStdin(false),
+      m_isRegularFile(false),
+      m_streaming(false),
+      m_endOfStream(false),
+      m_windowFrames(0),
+      m_frameSize(0),
+      m_nextFrameToRead(0),
+      m_window(),
+      m_prefaultThread(),
+      m_prefaultMutex(),
+      m_prefaultCond(),
+      m_prefaultExit(false),
+      m_prefaultFrames(0),
+      m_readFrame(0),
+      m_majorFaultsAtMap(0),
+      m_prefaultMajorFaults(0)
     {
 
     }
@@ -163,15 +202,22 @@ public:
 
     void Destroy()
     {
+        StopPrefault();
         m_memMapedFile.unmap();
 
-        if (m_fileHandle != nullptr) {
+        if ((m_fileHandle != nullptr) && !m_isStdin) {
             if(fclose(m_fileHandle)) {
                 fprintf(stderr, "Failed to close input file %s", m_fileName);
             }
-
-            m_fileHandle = nullptr;
         }
+        m_fileHandle = nullptr;
+
+        m_isStdin = false;
+        m_isRegularFile = false;
+        m_streaming = false;
+        m_endOfStream = false;
+        m_nextFrameToRead = 0;
+        m_window.clear();
     }
 
     bool HasFileName()
@@ -179,7 +225,8 @@ public:
         return m_fileName[0] != 0;
     }
 
-    size_t SetFileName(const char* inputFileName)
+    // Returns false if the file can't be opened or mapped
+    bool SetFileName(const char* inputFileName)
     {
         Destroy();
         strcpy(m_fileName, inputFileName);
@@ -215,37 +262,305 @@ public:
         return m_memMapedFile.data() + fileOffset;
     }
 
+    // True if the input can't be mapped, it must then be streamed.
+    bool IsStream() const {
+        return !m_memMapedFile.is_mapped() && (m_fileHandle != nullptr);
+    }
+
+    bool IsStreaming() const {
+        return m_streaming;
+    }
+
+    // The number of whole frames of the mapped file, 0 when streaming
+    uint64_t GetNumMappedFrames(size_t frameSize) const {
+        if (m_streaming || !m_memMapedFile.is_mapped() || (frameSize == 0)) {
+            return 0;
+        }
+        return m_memMapedFile.mapped_length() / frameSize;
+    }
+
+    // Reads the frames of frameSize in order through a window of windowFrames frames, the file is unmapped.
+    bool SetStreaming(uint32_t windowFrames, size_t frameSize)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if ((m_fileHandle == nullptr) || (windowFrames == 0) || (frameSize == 0)) {
+            return false;
+        }
+
+        StopPrefault();
+        m_memMapedFile.unmap();
+
+        m_windowFrames = windowFrames;
+        m_frameSize = frameSize;
+        m_nextFrameToRead = 0;
+        m_endOfStream = false;
+        m_window.resize((size_t)windowFrames * frameSize);
+        m_streaming = true;
+
+        AdviseSequential();
+        return true;
+    }
+
+    // Returns the data of the frame, or nullptr past the end of the input. When streaming, the frames
+    // are read up to this one and the data stays valid until windowFrames - 1 later frames are read.
+    const uint8_t* GetFramePtr(uint64_t frameIndex, size_t frameSize)
+    {
+        if (!m_streaming) {
+            const size_t fileOffset = (size_t)(frameIndex * frameSize);
+            if (m_memMapedFile.mapped_length() < (fileOffset + frameSize)) {
+                return nullptr;
+            }
+            if ((m_prefaultFrames > 0) && (frameIndex > m_readFrame.load(std::memory_order_relaxed))) {
+                m_readFrame.store(frameIndex, std::memory_order_relaxed);
+                m_prefaultCond.notify_one();
+            }
+            return m_memMapedFile.data() + fileOffset;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        assert(frameSize == m_frameSize);
+
+        while (!m_endOfStream && (m_nextFrameToRead <= frameIndex)) {
+            ReadNextFrame();
+        }
+
+        if ((frameIndex >= m_nextFrameToRead) || ((frameIndex + m_windowFrames) < m_nextFrameToRead)) {
+            // Past the end of the stream, or already dropped from the window
+            assert((frameIndex >= m_nextFrameToRead) || !"The input frame is out of the streaming window");
+            return nullptr;
+        }
+        return &m_window[(size_t)(frameIndex % m_windowFrames) * m_frameSize];
+    }
+
+    // Backs the mapping with transparent huge pages, where the kernel and the file system of the input support
+    // them for the page cache. Fewer, larger faults and TLB entries cover the frames.
+    bool AdviseHugePages()
+    {
+#if defined(MADV_HUGEPAGE)
+        if (m_streaming || !m_memMapedFile.is_mapped()) {
+            return false;
+        }
+        if (madvise((void*)m_memMapedFile.data(), m_memMapedFile.mapped_length(), MADV_HUGEPAGE) != 0) {
+            fprintf(stderr, "The input file mapping can't use huge pages: %s\n", strerror(errno));
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Faults the frames of frameSize of the mapped file in on a thread, up to prefaultFrames ahead of the
+    // last one returned by GetFramePtr(), so that the encode thread does not wait for the reads of the file.
+    bool StartPrefault(uint32_t prefaultFrames, size_t frameSize)
+    {
+#ifndef _WIN32
+        if (m_streaming || !m_memMapedFile.is_mapped() || (prefaultFrames == 0) || (frameSize == 0)) {
+            return false;
+        }
+        StopPrefault();
+        m_prefaultFrames = prefaultFrames;
+        m_frameSize = frameSize;
+        m_readFrame = 0;
+        m_prefaultExit = false;
+        m_prefaultThread = std::thread(&EncoderInputFileHandler::PrefaultThread, this);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void StopPrefault()
+    {
+        if (!m_prefaultThread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_prefaultMutex);
+            m_prefaultExit = true;
+        }
+        m_prefaultCond.notify_one();
+        m_prefaultThread.join();
+        m_prefaultFrames = 0;
+    }
+
+    // The major page faults of the process since the file was mapped, and those the prefault thread took.
+    // Both are 0 where the platform does not count them.
+    uint64_t GetMajorFaults(uint64_t* pPrefaultMajorFaults = nullptr) const
+    {
+        if (pPrefaultMajorFaults != nullptr) {
+            *pPrefaultMajorFaults = m_prefaultMajorFaults;
+        }
+        const uint64_t majorFaults = GetProcessMajorFaults();
+        return (majorFaults > m_majorFaultsAtMap) ? (majorFaults - m_majorFaultsAtMap) : 0;
+    }
+
+    bool IsMapped() const {
+        return !m_streaming && m_memMapedFile.is_mapped();
+    }
+
+    // The whole mapping of the input file, nullptr when it is streamed
+    const uint8_t* GetMappedData(size_t& mappedLength) const {
+        if (!IsMapped()) {
+            mappedLength = 0;
+            return nullptr;
+        }
+        mappedLength = m_memMapedFile.mapped_length();
+        return m_memMapedFile.data();
+    }
+
 private:
-    size_t OpenFile()
+    static uint64_t GetProcessMajorFaults()
+    {
+#ifndef _WIN32
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            return (uint64_t)usage.ru_majflt;
+        }
+#endif
+        return 0;
+    }
+
+    void PrefaultThread()
     {
+#ifndef _WIN32
+        const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        const uint8_t* const pData = m_memMapedFile.data();
+        const uint64_t numFrames = m_memMapedFile.mapped_length() / m_frameSize;
+        uint64_t nextFrame = 0;
+        uint8_t sum = 0;
+        std::unique_lock<std::mutex> lock(m_prefaultMutex);
+        while (!m_prefaultExit) {
+            const uint64_t readFrame = m_readFrame.load(std::memory_order_relaxed);
+            const uint64_t endFrame = std::min<uint64_t>(readFrame + m_prefaultFrames + 1, numFrames);
+            nextFrame = std::max(nextFrame, readFrame);
+            if (nextFrame >= endFrame) {
+                // Woken up by GetFramePtr(), the timeout covers the notifications sent without the lock
+                m_prefaultCond.wait_for(lock, std::chrono::milliseconds(5));
+                continue;
+            }
+            lock.unlock();
+            // Read the frame into the page cache in one request, then map its pages in
+            const size_t frameOffset = (size_t)(nextFrame * m_frameSize);
+            const size_t alignedOffset = frameOffset & ~(pageSize - 1);
+            madvise((void*)(pData + alignedOffset), m_frameSize + (frameOffset - alignedOffset), MADV_WILLNEED);
+            for (size_t offset = alignedOffset; offset < (frameOffset + m_frameSize); offset += pageSize) {
+                sum += *(const volatile uint8_t*)(pData + offset);
+            }
+            nextFrame++;
+#if defined(RUSAGE_THREAD)
+            struct rusage usage;
+            if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+                m_prefaultMajorFaults = (uint64_t)usage.ru_majflt;
+            }
+#endif
+            lock.lock();
+        }
+        (void)sum;
+#endif
+    }
+
+    bool OpenFile()
+    {
+        if (strcmp(m_fileName, "-") == 0) {
+            m_fileHandle = stdin;
+            m_isStdin = true;
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            printf("Input is streamed from stdin\n");
+            return true;
+        }
+
         m_fileHandle = fopen(m_fileName, "rb");
         if (m_fileHandle == nullptr) {
             fprintf(stderr, "Failed to open input file %s", m_fileName);
-            return 0;
+            return false;
         }
 
+#ifndef _WIN32
+        struct stat fileStat;
+        m_isRegularFile = (fstat(fileno(m_fileHandle), &fileStat) == 0) && S_ISREG(fileStat.st_mode);
+        if (!m_isRegularFile) {
+            // Pipes, FIFOs and devices can't be mapped
+            printf("Input file %s is streamed\n", m_fileName);
+            return true;
+        }
+#else
+        m_isRegularFile = true;
+#endif
+
         std::error_code error;
         m_memMapedFile.map(m_fileName, 0, mio::map_entire_file, error);
         if (error) {
             fprintf(stderr, "Failed to map the input file %s", m_fileName);
             const auto& errmsg = error.message();
             std::printf("error mapping file: %s, exiting...\n", errmsg.c_str());
-            return error.value();
+            return false;
         }
 
         printf("Input file size is: %zd\n", m_memMapedFile.length());
+        m_majorFaultsAtMap = GetProcessMajorFaults();
+        m_prefaultMajorFaults = 0;
 
-        return m_memMapedFile.length();
+        return (m_memMapedFile.length() > 0);
     }
 
-    size_t GetFileSize() const {
-        return m_memMapedFile.length();
+    // Called with m_mutex held
+    void ReadNextFrame()
+    {
+        uint8_t* pFrame = &m_window[(size_t)(m_nextFrameToRead % m_windowFrames) * m_frameSize];
+        if (fread(pFrame, 1, m_frameSize, m_fileHandle) != m_frameSize) {
+            m_endOfStream = true;
+            return;
+        }
+        m_nextFrameToRead++;
+
+#if defined(POSIX_FADV_DONTNEED)
+        if (m_isRegularFile) {
+            // Drop the frame leaving the window from the page cache and read the next window ahead
+            const int fd = fileno(m_fileHandle);
+            const off_t readOffset = (off_t)(m_nextFrameToRead * m_frameSize);
+            const off_t windowSize = (off_t)(m_windowFrames * m_frameSize);
+            if (readOffset > windowSize) {
+                posix_fadvise(fd, readOffset - windowSize - (off_t)m_frameSize, (off_t)m_frameSize, POSIX_FADV_DONTNEED);
+            }
+            posix_fadvise(fd, readOffset, windowSize, POSIX_FADV_WILLNEED);
+        }
+#endif
+    }
+
+    void AdviseSequential()
+    {
+#if defined(POSIX_FADV_SEQUENTIAL)
+        if (m_isRegularFile) {
+            posix_fadvise(fileno(m_fileHandle), 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
     }
 
 private:
     char  m_fileName[256];
     FILE* m_fileHandle;
     mio::basic_mmap<mio::access_mode::read, uint8_t> m_memMapedFile;
+    std::mutex           m_mutex;
+    bool                 m_isStdin;
+    bool                 m_isRegularFile;
+    bool                 m_streaming;
+    bool                 m_endOfStream;
+    uint32_t             m_windowFrames;
+    size_t               m_frameSize;
+    uint64_t             m_nextFrameToRead;
+    std::vector<uint8_t> m_window;
+    std::thread             m_prefaultThread;
+    std::mutex              m_prefaultMutex;
+    std::condition_variable m_prefaultCond;
+    bool                    m_prefaultExit;
+    uint64_t                m_prefaultFrames;     // faulted in ahead of m_readFrame, 0 without the prefault thread
+    std::atomic<uint64_t>   m_readFrame;          // the last mapped frame returned by GetFramePtr()
+    uint64_t                m_majorFaultsAtMap;
+    std::atomic<uint64_t>   m_prefaultMajorFaults;
 };
 
 class EncoderOutputFileHandler
@@ -316,6 +631,59 @@ public:
 private:
     size_t OpenFile()
     {
+        if (strcmp(m_fileName, "-") == 0) {
+            // The bitstream goes to stdout, and the console messages to stderr so as not to mix with it
+            fflush(stdout);
+#ifndef _WIN32
+            const int outputFd = dup(STDOUT_FILENO);
+            if ((outputFd < 0) || (dup2(STDERR_FILENO, STDOUT_FILENO) < 0)) {
+                fprintf(stderr, "Failed to redirect stdout for the output");
+                return 0;
+            }
+            m_fileHandle = fdopen(outputFd, "wb");
+#else
+            const int outputFd = _dup(_fileno(stdout));
+            if ((outputFd < 0) || (_dup2(_fileno(stderr), _fileno(stdout)) < 0)) {
+                fprintf(stderr, "Failed to redirect stdout for the output");
+                return 0;
+            }
+            _setmode(outputFd, _O_BINARY);
+            m_fileHandle = _fdopen(outputFd, "wb");
+#endif
+            if (m_fileHandle == nullptr) {
+                fprintf(stderr, "Failed to open stdout for the output");
+                return 0;
+            }
+            return 1;
+        }
+
+#ifndef _WIN32
+        if (strncmp(m_fileName, "unix:", 5) == 0) {
+            // A stream socket a packager or a server is listening on
+            struct sockaddr_un address;
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, m_fileName + 5, sizeof(address.sun_path) - 1);
+            const int socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if ((socketFd < 0) || (connect(socketFd, (const struct sockaddr*)&address, sizeof(address)) != 0)) {
+                fprintf(stderr, "Failed to connect to the output socket %s", m_fileName + 5);
+                if (socketFd >= 0) {
+                    close(socketFd);
+                }
+                return 0;
+            }
+            // A write failure instead of the end of the process, once the reader is gone
+            signal(SIGPIPE, SIG_IGN);
+            m_fileHandle = fdopen(socketFd, "wb");
+            if (m_fileHandle == nullptr) {
+                close(socketFd);
+                fprintf(stderr, "Failed to open the output socket %s", m_fileName + 5);
+                return 0;
+            }
+            return 1;
+        }
+#endif
+
         m_fileHandle = fopen(m_fileName, "wb");
         if (m_fileHandle == nullptr) {
             fprintf(stderr, "Failed to open output file %s", m_fileName);
@@ -335,6 +703,27 @@ private:
     mio::basic_mmap<mio::access_mode::write, uint8_t> m_memMapedFile;
 };
 
+// A mid-stream rate control change, from the frame with that input order number on.
+// The zero bitrates and frame rate, and the negative QPs, keep their current values.
+struct RateControlChange
+{
+    uint64_t frameNum;
+    uint32_t averageBitrate;
+    uint32_t maxBitrate;
+    int32_t  minQp; // also the constant QP with the rate control disabled
+    int32_t  maxQp;
+    uint32_t frameRateNumerator;
+    uint32_t frameRateDenominator;
+};
+
+// A scaled copy of the input, encoded by its own session from the input frames uploaded for the main one.
+struct SimulcastRung
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t averageBitrate; // 0 keeps the bitrate of the main encoder
+};
+
 struct EncoderConfig : public VkVideoRefCountBase {
 
     enum { DEFAULT_NUM_INPUT_IMAGES = 16 };
@@ -342,7 +731,14 @@ struct EncoderConfig : public VkVideoRefCountBase {
     enum { DEFAULT_GOP_IDR_PERIOD  = 60 };
     enum { DEFAULT_CONSECUTIVE_B_FRAME_COUNT = 3 };
     enum { DEFAULT_TEMPORAL_LAYER_COUNT = 1 };
+    enum { MAX_TEMPORAL_LAYER_COUNT = 4 };
+    enum { MAX_SIMULCAST_RUNGS = 8 };
+    enum { MAX_SPLIT_FRAME_BANDS = 4 };
+    enum { DEFAULT_NUM_BENCHMARK_FRAMES = 600 };
+    enum SimulcastScaler { SIMULCAST_SCALER_BOX, SIMULCAST_SCALER_BILINEAR, SIMULCAST_SCALER_BICUBIC,
+                           SIMULCAST_SCALER_LANCZOS };
     enum { DEFAULT_NUM_SLICES_PER_PICTURE = 4 };
+    enum { MAX_NUM_SLICES_PER_PICTURE = 64 };
     enum { DEFAULT_MAX_NUM_REF_FRAMES = 16 };
 
 private:
@@ -355,11 +751,39 @@ public:
     VkVideoCodecOperationFlagBitsKHR codec;
     uint32_t videoProfileIdc;
     uint32_t numInputImages;
+    uint32_t inputLoadAheadFrames;
+    uint32_t inputConversionThreads;
+    uint32_t inputReadAheadFrames;
+    uint32_t inputPrefaultFrames; // of the mapped input file, faulted in ahead of the encoder on a thread, 0 without
+    uint32_t encodeInFlightFrames;
+    uint32_t numParallelSegments;
+    uint32_t numParallelJobs;     // of the --jobList, encoded concurrently on the same device
+    uint32_t capacityMaxSessions; // the most sessions --capacityBenchmark ramps up to
+    double   capacityTargetFps;   // the frame rate each session of --capacityBenchmark must sustain
+    double   capacityMaxLatencyMs; // the p99 latency of the frames of --capacityBenchmark, 0 for two frame intervals
+    uint32_t lookAheadFrames;
+    float    temporalFilterStrength; // of the motion compensated denoise of the input, 0 without
+    uint32_t longTermRefInterval; // frames between the long-term references, 0 without them
+    uint32_t intraRefreshPeriod;  // frames to refresh the picture in, a slice each, 0 with periodic IDRs
+    int32_t  pyramidQpOffset;     // added per level of the B-frame pyramid to the constant QP
+    uint32_t sliceRows;           // MB or CTB rows per slice, 0 without
+    uint32_t sliceBytes;          // average bytes per slice, with the slice count estimated from the bitrate, 0 without
+    uint32_t simulcastScaler;     // SimulcastScaler kernel of the GPU scaling of the rungs
+    uint32_t splitFrameBands;     // row bands of the picture, each coded by its own session and encode queue, 1 without
+    uint32_t splitFrameBandIndex; // of the band coded by this encoder, 0 for the main encoder
+    uint32_t splitFrameHeight;    // the encode height of the whole picture, with the split frame bands
+    uint32_t maxSliceCount;       // of the device
+    bool     perSliceConstantQp;  // of the device, for the QP delta maps
+    uint32_t sliceCount;          // per picture, from InitSliceCount()
     EncoderInputImageParameters input;
     uint8_t  encodeBitDepthLuma;
     uint8_t  encodeBitDepthChroma;
     uint8_t  encodeNumPlanes;
     uint8_t  numBitstreamBuffersToPreallocate;
+    uint32_t bitstreamBufferIdleTrimMs;
+    uint32_t deviceMemoryArenaBlockSizeMB;
+    uint32_t deviceMemoryBudgetMB; // the device local memory the encoders of the process may take, 0 for the device budget
+    uint32_t metricsPort; // serving the runtime metrics, 0 without it
     VkVideoChromaSubsamplingFlagBitsKHR  encodeChromaSubsampling;
     uint32_t encodeWidth;
     uint32_t encodeHeight;
@@ -367,6 +791,7 @@ public:
     uint32_t numFrames;
     uint32_t codecBlockAlignment;
     uint32_t qualityLevel;
+    double   autoQualityLevelFps; // the frame rate the quality level is adapted to at the IDR frames, 0 to keep it
     VkVideoCoreProfile videoCoreProfile;
     VkVideoCapabilitiesKHR videoCapabilities;
     VkVideoEncodeCapabilitiesKHR videoEncodeCapabilities;
@@ -389,6 +814,7 @@ public:
     VkComponentMapping                         components;
     VkChromaLocation                           xChromaOffset;
     VkChromaLocation                           yChromaOffset;
+    VkFormat                                   inputRgbaFormat; // of the EncodeImage() images converted on the GPU
 
     // VuiParameters
     uint32_t darWidth;  // Specifies the display aspect ratio width.
@@ -411,6 +837,25 @@ public:
 
     EncoderInputFileHandler inputFileHandler;
     EncoderOutputFileHandler outputFileHandler;
+    std::string gpuTimestampsCsvFileName;
+    std::string traceFileName;
+    std::string metricsFileName;
+    std::string lowLatencyCsvFileName;
+    std::string qualityMetricsCsvFileName;
+    std::string frameStatsCsvFileName; // the type, size, QP, status and times of each frame, with --frameStatsCsv
+    std::string pipelineCacheDir; // the pipeline cache and the SPIR-V of the shaders, kept between the runs
+    std::string deviceCacheFileName; // the selected physical device and its queue families, with --fastStartup
+    std::string conversionCalibrationCacheFileName; // the times of the input conversion paths, with --autoInputConversion
+    std::string transcodeFileName; // the stream decoded on the GPU into the input frames, instead of the input file
+    std::string jobListFileName; // the jobs encoded one after the other by the process, one command line per line
+    std::string twoPassStatsFileName; // the per frame stats of the first pass, read by the second one
+    uint64_t targetSizeBytes; // of the two-pass output
+    std::vector<RateControlChange> rateControlChanges;
+    std::vector<SimulcastRung> simulcastRungs;
+    std::vector<uint64_t> lostFrames; // by input order number, to simulate the receiver feedback
+    std::vector<uint32_t> consumerCpus; // of the encoder queue consumer and the stage pipeline threads
+    std::vector<uint32_t> loaderCpus;   // of the input loader threads, one each
+    std::vector<uint32_t> writerCpus;   // of the output bitstream writer thread
     uint32_t validate : 1;
     uint32_t validateVerbose : 1;
     uint32_t verbose : 1;
@@ -421,6 +866,28 @@ public:
     uint32_t enableVideoDecoder : 1;
     uint32_t enableHwLoadBalancing : 1;
     uint32_t selectVideoWithComputeQueue : 1;
+    uint32_t gpuTimestamps : 1;
+    uint32_t enableInputComputeConversion : 1;
+    uint32_t enableInputBufferUpload : 1;
+    uint32_t enableInputHostImport : 1; // the compute conversion reads the mapped input file imported as host memory
+    uint32_t enableInputConversionAuto : 1; // the input conversion on the CPU or the GPU, whichever is faster
+    uint32_t enableInputStreaming : 1;
+    uint32_t enableInputHugePages : 1; // the mapped input file backed by transparent huge pages
+    uint32_t enableHugePageStaging : 1; // the staging buffers in imported huge pages of host memory
+    uint32_t enableOutputWriterThread : 1;
+    uint32_t enableStagePipeline : 1;
+    uint32_t enableLowLatency : 1;
+    uint32_t enablePacketFraming : 1; // a VkVideoEncodePacketHeader before each coded frame
+    uint32_t enableAllIntraMultiQueue : 1; // intra coded frames only, spread over all the encode queues
+    uint32_t enableRightSizedBitstreamBuffers : 1; // sized per frame type instead of the worst case
+    uint32_t enableDeviceLocalBitstream : 1; // encoded into device memory, copied to the host buffers
+    uint32_t enableDpbImageArray : 1; // the DPB slots are the layers of a single image
+    uint32_t enableAdaptiveGop : 1;
+    uint32_t simulcastRung : 1; // the input frames are scaled and handed over by the main encoder
+    uint32_t enableBenchmark : 1; // generated input frames on the GPU, with a throughput report
+    uint32_t enableCapacityBenchmark : 1; // ramp the concurrent encode sessions for the most that sustain the target fps
+    uint32_t deviceMemoryReport : 1; // the device memory by owner, printed at exit
+    uint32_t firstPass : 1; // of the --twoPass encode, writing the stats file instead of reading it
 
     EncoderConfig()
     : refCount(0)
@@ -430,11 +897,39 @@ public:
     , codec(VK_VIDEO_CODEC_OPERATION_NONE_KHR)
     , videoProfileIdc((uint32_t)-1)
     , numInputImages(DEFAULT_NUM_INPUT_IMAGES)
+    , inputLoadAheadFrames(0)
+    , inputConversionThreads(1)
+    , inputReadAheadFrames(4)
+    , inputPrefaultFrames(0)
+    , encodeInFlightFrames(0)
+    , numParallelSegments(0)
+    , numParallelJobs(1)
+    , capacityMaxSessions(64)
+    , capacityTargetFps(30.0)
+    , capacityMaxLatencyMs(0.0)
+    , lookAheadFrames(0)
+    , temporalFilterStrength(0.0f)
+    , longTermRefInterval(0)
+    , intraRefreshPeriod(0)
+    , pyramidQpOffset(1)
+    , sliceRows(0)
+    , sliceBytes(0)
+    , simulcastScaler(SIMULCAST_SCALER_BOX)
+    , splitFrameBands(1)
+    , splitFrameBandIndex(0)
+    , splitFrameHeight(0)
+    , maxSliceCount(1)
+    , perSliceConstantQp(false)
+    , sliceCount(1)
     , input()
     , encodeBitDepthLuma(input.bpp)
     , encodeBitDepthChroma(input.bpp)
     , encodeNumPlanes(2)
     , numBitstreamBuffersToPreallocate(8)
+    , bitstreamBufferIdleTrimMs(2000)
+    , deviceMemoryArenaBlockSizeMB(64)
+    , deviceMemoryBudgetMB(0)
+    , metricsPort(0)
     , encodeChromaSubsampling(VK_VIDEO_CHROMA_SUBSAMPLING_420_BIT_KHR)
     , encodeWidth(0)
     , encodeHeight(0)
@@ -442,6 +937,7 @@ public:
     , numFrames(0)
     , codecBlockAlignment(16)
     , qualityLevel(0) // FIXME: qualityLevel
+    , autoQualityLevelFps(0.0)
     , videoCoreProfile(codec, encodeChromaSubsampling, encodeBitDepthLuma, encodeBitDepthChroma)
     , videoCapabilities()
     , videoEncodeCapabilities()
@@ -466,6 +962,7 @@ public:
                  VK_COMPONENT_SWIZZLE_IDENTITY}
     , xChromaOffset(VK_CHROMA_LOCATION_MIDPOINT)
     , yChromaOffset(VK_CHROMA_LOCATION_MIDPOINT)
+    , inputRgbaFormat(VK_FORMAT_UNDEFINED)
     , darWidth()
     , darHeight()
     , aspect_ratio_info_present_flag()
@@ -484,6 +981,17 @@ public:
     , max_dec_frame_buffering()
     , chroma_sample_loc_type()
     , inputFileHandler()
+    , gpuTimestampsCsvFileName()
+    , traceFileName()
+    , metricsFileName()
+    , lowLatencyCsvFileName()
+    , qualityMetricsCsvFileName()
+    , frameStatsCsvFileName()
+    , twoPassStatsFileName()
+    , targetSizeBytes(0)
+    , rateControlChanges()
+    , simulcastRungs()
+    , lostFrames()
     , validate(false)
     , validateVerbose(false)
     , verbose(false)
@@ -494,6 +1002,28 @@ public:
     , enableVideoDecoder(false)
     , enableHwLoadBalancing(false)
     , selectVideoWithComputeQueue(false)
+    , gpuTimestamps(false)
+    , enableInputComputeConversion(false)
+    , enableInputBufferUpload(false)
+    , enableInputHostImport(false)
+    , enableInputConversionAuto(false)
+    , enableInputStreaming(false)
+    , enableInputHugePages(false)
+    , enableHugePageStaging(false)
+    , enableOutputWriterThread(false)
+    , enableStagePipeline(false)
+    , enableLowLatency(false)
+    , enablePacketFraming(false)
+    , enableAllIntraMultiQueue(false)
+    , enableRightSizedBitstreamBuffers(false)
+    , enableDeviceLocalBitstream(false)
+    , enableDpbImageArray(false)
+    , enableAdaptiveGop(false)
+    , simulcastRung(false)
+    , enableBenchmark(false)
+    , enableCapacityBenchmark(false)
+    , deviceMemoryReport(false)
+    , firstPass(false)
     { }
 
     virtual ~EncoderConfig() {}
@@ -521,8 +1051,31 @@ public:
         return nullptr;
     }
 
-    // Factory Function
-    static VkResult CreateCodecConfig(int argc, char *argv[], VkSharedBaseObj<EncoderConfig>& encoderConfig);
+    virtual EncoderConfigAV1* GetEncoderConfigAV1() {
+        return nullptr;
+    }
+
+    // Factory Function. With a simulcast rung index, the configuration of the --simulcast rung's encoder, with
+    // a split frame band index, that of the band's encoder.
+    static VkResult CreateCodecConfig(int argc, char *argv[], VkSharedBaseObj<EncoderConfig>& encoderConfig,
+                                      int32_t simulcastRungIndex = -1, int32_t splitFrameBandIndex = -1);
+
+    // The command lines of the jobs of the --jobList file: the options of the process followed by those of the
+    // job's line. Empty without a --jobList, false if the file can't be read.
+    static bool GetJobList(int argc, char *argv[], std::vector<std::vector<std::string>>& jobArgs);
+
+    // Encodes the rung's size and bitrate into its own output file, from the frames of the main encoder
+    bool SetSimulcastRung(uint32_t rungIndex);
+
+    // Encodes the band of the --splitFrameBands picture, from the frames of the main encoder for the bands after
+    // the first one, which the main encoder codes itself. Its slices are stitched into those of the main encoder.
+    bool SetSplitFrameBand(uint32_t bandIndex);
+
+    // The first row and the height of the band, in whole slice rows, the last band taking what is left
+    bool GetSplitFrameBand(uint32_t bandIndex, uint32_t& bandY, uint32_t& bandHeight) const;
+
+    // The first pass of the --twoPass encode, at the fastest quality level into <output>.pass1
+    bool SetFirstPass();
 
     void InitVideoProfile();
 
@@ -532,6 +1085,34 @@ public:
             return VK_ERROR_INVALID_VIDEO_STD_PARAMETERS_KHR;
         }
 
+        if (enableInputStreaming || inputFileHandler.IsStream()) {
+            // The loader threads may still convert frames that far behind the read-ahead
+            const uint32_t windowFrames = std::max<uint32_t>(inputReadAheadFrames, 1) + inputLoadAheadFrames + 2;
+            if (!inputFileHandler.SetStreaming(windowFrames, input.fullImageSize)) {
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+            if (numFrames == 0) {
+                // Until the end of the stream
+                numFrames = UINT32_MAX;
+            }
+        } else if (inputFileHandler.IsMapped()) {
+            if (enableInputHugePages) {
+                inputFileHandler.AdviseHugePages();
+            }
+            if (inputPrefaultFrames > 0) {
+                inputFileHandler.StartPrefault(inputPrefaultFrames, input.fullImageSize);
+            }
+        }
+
+        if (!transcodeFileName.empty() && (numFrames == 0)) {
+            // Until the end of the transcoded stream
+            numFrames = UINT32_MAX;
+        }
+
+        if (enableBenchmark && (numFrames == 0)) {
+            numFrames = DEFAULT_NUM_BENCHMARK_FRAMES;
+        }
+
         if (encodeWidth == 0) {
             encodeWidth = input.width;
         }
@@ -550,7 +1131,21 @@ public:
 
     virtual int8_t InitDpbCount() { return 16; };
 
+    // The MB or CTB rows of the picture, the slices are made of whole rows.
+    virtual uint32_t GetPicHeightInSliceRows() const { return 1; };
+
+    // The height of the MB or CTB rows, in luma samples
+    virtual uint32_t GetSliceRowHeight() const { return 16; };
+
     virtual bool InitRateControl();
+
+    // The slices per picture, from the intra refresh period, the rows or the bytes per slice, after
+    // InitDeviceCapbilities() and InitRateControl().
+    void InitSliceCount();
+
+    // Fills one rate control layer per temporal layer, with the frame rate and the bitrate of the temporal
+    // layers up to it, and returns the number of layers.
+    uint32_t GetRateControlLayers(VkVideoEncodeRateControlLayerInfoKHR* pRateControlLayersInfo) const;
 };
 
 // Create codec configuration for H.264 encoder
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VkVideoEncoder/VkEncoderConfigAV1.h"
+#include "VkVideoEncoder/VkEncoderDpbAV1.h"
+
+#ifdef VK_KHR_video_encode_av1
+
+VkResult EncoderConfigAV1::InitDeviceCapbilities(const VulkanDeviceContext* vkDevCtx)
+{
+    VkResult result = VulkanVideoCapabilities::GetVideoEncodeCapabilities<VkVideoEncodeAV1CapabilitiesKHR, VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_CAPABILITIES_KHR>
+                                                                (vkDevCtx, videoCoreProfile,
+                                                                 videoCapabilities,
+                                                                 videoEncodeCapabilities,
+                                                                 av1EncodeCapabilities);
+    if (result != VK_SUCCESS) {
+        std::cout << "*** Could not get Video Capabilities :" << result << " ***" << std::endl;
+        assert(!"Could not get Video Capabilities!");
+        return result;
+    }
+
+    if (verboseMsg) {
+        std::cout << "\t\t\t" << VkVideoCoreProfile::CodecToName(codec) << "encode capabilities: " << std::endl;
+        std::cout << "\t\t\t" << "minBitstreamBufferOffsetAlignment: " << videoCapabilities.minBitstreamBufferOffsetAlignment << std::endl;
+        std::cout << "\t\t\t" << "minBitstreamBufferSizeAlignment: " << videoCapabilities.minBitstreamBufferSizeAlignment << std::endl;
+        std::cout << "\t\t\t" << "pictureAccessGranularity: " << videoCapabilities.pictureAccessGranularity.width << " x " << videoCapabilities.pictureAccessGranularity.height << std::endl;
+        std::cout << "\t\t\t" << "minExtent: " << videoCapabilities.minCodedExtent.width << " x " << videoCapabilities.minCodedExtent.height << std::endl;
+        std::cout << "\t\t\t" << "maxExtent: " << videoCapabilities.maxCodedExtent.width  << " x " << videoCapabilities.maxCodedExtent.height << std::endl;
+        std::cout << "\t\t\t" << "maxDpbSlots: " << videoCapabilities.maxDpbSlots << std::endl;
+        std::cout << "\t\t\t" << "maxActiveReferencePictures: " << videoCapabilities.maxActiveReferencePictures << std::endl;
+        std::cout << "\t\t\t" << "maxSingleReferenceCount: " << av1EncodeCapabilities.maxSingleReferenceCount << std::endl;
+        std::cout << "\t\t\t" << "maxTiles: " << av1EncodeCapabilities.maxTiles.width << " x " << av1EncodeCapabilities.maxTiles.height << std::endl;
+    }
+
+    // Neither the OBU extension headers of the temporal layers nor the intra refresh are coded
+    if (gopStructure.GetTemporalLayerCount() > 1) {
+        std::cout << "The temporal layers are not supported with AV1" << std::endl;
+        gopStructure.SetTemporalLayerCount(1);
+    }
+    if (intraRefreshPeriod > 0) {
+        std::cout << "The intra refresh is not supported with AV1, using periodic key frames" << std::endl;
+        intraRefreshPeriod = 0;
+    }
+    // The tiles take the place of the slices
+    maxSliceCount = 1;
+    perSliceConstantQp = false;
+
+    if (level > av1EncodeCapabilities.maxLevel) {
+        level = av1EncodeCapabilities.maxLevel;
+    }
+
+    const uint32_t maxSingleReferenceCount = std::max<uint32_t>(av1EncodeCapabilities.maxSingleReferenceCount, 1);
+    numRefL0 = (uint8_t)std::min<uint32_t>(std::min<uint32_t>(std::max<uint32_t>(numRefL0, 1), MAX_NUM_REFS),
+                                           maxSingleReferenceCount);
+
+    use128x128Superblock = ((av1EncodeCapabilities.superblockSizes & VK_VIDEO_ENCODE_AV1_SUPERBLOCK_SIZE_64_BIT_KHR) == 0);
+
+    // Uniformly spaced tiles, a power of two of them across and down the picture
+    while ((tileColumns > 1) && (((tileColumns & (tileColumns - 1)) != 0) ||
+                                 (tileColumns > std::max<uint32_t>(av1EncodeCapabilities.maxTiles.width, 1)))) {
+        tileColumns--;
+    }
+    while ((tileRows > 1) && (((tileRows & (tileRows - 1)) != 0) ||
+                              (tileRows > std::max<uint32_t>(av1EncodeCapabilities.maxTiles.height, 1)))) {
+        tileRows--;
+    }
+    tileColumns = std::max<uint32_t>(tileColumns, 1);
+    tileRows = std::max<uint32_t>(tileRows, 1);
+
+    minQIndex = std::max<uint32_t>(minQIndex, av1EncodeCapabilities.minQIndex);
+    maxQIndex = std::min<uint32_t>(maxQIndex, std::max<uint32_t>(av1EncodeCapabilities.maxQIndex, minQIndex));
+
+    return VK_SUCCESS;
+}
+
+int8_t EncoderConfigAV1::InitDpbCount()
+{
+    // The references and the current picture
+    if (dpbCount < 1) {
+        dpbCount = numRefL0 + 1;
+    }
+    dpbCount = (int8_t)std::min<int32_t>(std::max<int32_t>(dpbCount, numRefL0 + 1), VkEncDpbAV1::MAX_DPB_SLOTS);
+
+    return dpbCount;
+}
+
+bool EncoderConfigAV1::GetRateControlParameters(VkVideoEncodeRateControlInfoKHR *rcInfo,
+                                                VkVideoEncodeRateControlLayerInfoKHR *pRcLayerInfo,
+                                                VkVideoEncodeAV1RateControlInfoKHR *rcInfoAV1,
+                                                VkVideoEncodeAV1RateControlLayerInfoKHR *rcLayerInfoAV1)
+{
+    if (rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DEFAULT_KHR) {
+        rcInfo->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_VBR_BIT_KHR;
+    } else {
+        rcInfo->rateControlMode = rateControlMode;
+    }
+
+    const uint32_t layerCount = GetRateControlLayers(pRcLayerInfo);
+
+    rcInfoAV1->flags = VK_VIDEO_ENCODE_AV1_RATE_CONTROL_REGULAR_GOP_BIT_KHR |
+                       VK_VIDEO_ENCODE_AV1_RATE_CONTROL_REFERENCE_PATTERN_FLAT_BIT_KHR;
+    rcInfoAV1->consecutiveBipredictiveFrameCount = 0;
+    rcInfoAV1->gopFrameCount = (gopStructure.GetGopFrameCount() > 0) ? gopStructure.GetGopFrameCount() : uint32_t(DEFAULT_GOP_FRAME_COUNT);
+    rcInfoAV1->keyFramePeriod = (gopStructure.GetIdrPeriod() > 0) ? gopStructure.GetIdrPeriod() : uint32_t(DEFAULT_GOP_IDR_PERIOD);
+    rcInfoAV1->temporalLayerCount = layerCount;
+
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+        const uint32_t layerMinQIndex = (minQp >= 0) ? std::max(QpToQIndex(minQp), minQIndex) : minQIndex;
+        const uint32_t layerMaxQIndex = (maxQp >= 0) ? std::min(QpToQIndex(maxQp), maxQIndex) : maxQIndex;
+        if (rcInfo->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+            rcLayerInfoAV1[layer].minQIndex = rcLayerInfoAV1[layer].maxQIndex =
+                { layerMinQIndex, layerMinQIndex, layerMinQIndex };
+        } else {
+            rcLayerInfoAV1[layer].minQIndex = { layerMinQIndex, layerMinQIndex, layerMinQIndex };
+            rcLayerInfoAV1[layer].maxQIndex = { layerMaxQIndex, layerMaxQIndex, layerMaxQIndex };
+        }
+    }
+
+    return true;
+}
+
+bool EncoderConfigAV1::InitSequenceHeader(StdVideoAV1SequenceHeader *seqHdr, StdVideoAV1ColorConfig *colorConfig)
+{
+    memset(colorConfig, 0, sizeof(*colorConfig));
+    colorConfig->BitDepth = encodeBitDepthLuma;
+    colorConfig->subsampling_x = (encodeChromaSubsampling != VK_VIDEO_CHROMA_SUBSAMPLING_444_BIT_KHR) ? 1 : 0;
+    colorConfig->subsampling_y = (encodeChromaSubsampling == VK_VIDEO_CHROMA_SUBSAMPLING_420_BIT_KHR) ? 1 : 0;
+    colorConfig->flags.mono_chrome = (encodeChromaSubsampling == VK_VIDEO_CHROMA_SUBSAMPLING_MONOCHROME_BIT_KHR) ? 1 : 0;
+    colorConfig->flags.color_range = video_full_range_flag;
+    colorConfig->flags.color_description_present_flag = color_description_present_flag;
+    colorConfig->color_primaries = (StdVideoAV1ColorPrimaries)colour_primaries;
+    colorConfig->transfer_characteristics = (StdVideoAV1TransferCharacteristics)transfer_characteristics;
+    colorConfig->matrix_coefficients = (StdVideoAV1MatrixCoefficients)matrix_coefficients;
+    colorConfig->chroma_sample_position = STD_VIDEO_AV1_CHROMA_SAMPLE_POSITION_UNKNOWN;
+
+    memset(seqHdr, 0, sizeof(*seqHdr));
+    seqHdr->seq_profile = profile;
+    seqHdr->frame_width_bits_minus_1 = 15;
+    seqHdr->frame_height_bits_minus_1 = 15;
+    seqHdr->max_frame_width_minus_1 = encodeWidth - 1;
+    seqHdr->max_frame_height_minus_1 = encodeHeight - 1;
+    seqHdr->order_hint_bits_minus_1 = orderHintBits - 1;
+    seqHdr->seq_force_integer_mv = 2;            // SELECT_INTEGER_MV
+    seqHdr->seq_force_screen_content_tools = 2;  // SELECT_SCREEN_CONTENT_TOOLS
+    seqHdr->flags.use_128x128_superblock = use128x128Superblock;
+    seqHdr->flags.enable_filter_intra = 1;
+    seqHdr->flags.enable_intra_edge_filter = 1;
+    seqHdr->flags.enable_order_hint = 1;
+    seqHdr->flags.enable_ref_frame_mvs = 1;
+    seqHdr->flags.enable_cdef = enableCdef;
+    seqHdr->pColorConfig = colorConfig;
+    seqHdr->pTimingInfo = nullptr;
+
+    return true;
+}
+
+#endif // VK_KHR_video_encode_av1
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VKVIDEOENCODER_VKENCODERCONFIG_AV1_H_
+#define VKVIDEOENCODER_VKENCODERCONFIG_AV1_H_
+
+#include "VkVideoEncoder/VkEncoderConfig.h"
+
+#ifdef VK_KHR_video_encode_av1
+
+#include "vk_video/vulkan_video_codec_av1std.h"
+#include "vk_video/vulkan_video_codec_av1std_encode.h"
+
+struct EncoderConfigAV1 : public EncoderConfig {
+
+    enum { MAX_NUM_REFS = 4 };           // LAST_FRAME to GOLDEN_FRAME, without the B-frames
+    enum { DEFAULT_ORDER_HINT_BITS = 7 };
+    enum { MAX_QINDEX = 255 };
+
+    StdVideoAV1Profile     profile;
+    StdVideoAV1Level       level;
+    uint8_t                tier;
+    VkVideoEncodeAV1CapabilitiesKHR av1EncodeCapabilities;
+    uint8_t                numRefL0;              // Specifies max number of references used for prediction of a frame.
+    uint8_t                orderHintBits;
+    uint32_t               tileColumns;           // Uniformly spaced, a power of two
+    uint32_t               tileRows;
+    bool                   use128x128Superblock;
+    bool                   enableCdef;
+    uint32_t               minQIndex;             // Specifies the const or minimum q_idx used for rate control.
+    uint32_t               maxQIndex;             // Specifies the maximum q_idx used for rate control.
+
+    EncoderConfigAV1()
+      : profile(STD_VIDEO_AV1_PROFILE_MAIN)
+      , level(STD_VIDEO_AV1_LEVEL_5_1)
+      , tier(0)
+      , av1EncodeCapabilities()
+      , numRefL0(1)
+      , orderHintBits(DEFAULT_ORDER_HINT_BITS)
+      , tileColumns(1)
+      , tileRows(1)
+      , use128x128Superblock(false)
+      , enableCdef(true)
+      , minQIndex(0)
+      , maxQIndex(MAX_QINDEX)
+    {
+    }
+
+    virtual ~EncoderConfigAV1() {}
+
+    virtual EncoderConfigAV1* GetEncoderConfigAV1() {
+        return this;
+    }
+
+    virtual VkResult InitializeParameters()
+    {
+        VkResult result = EncoderConfig::InitializeParameters();
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        // The frames are coded in their input order, each predicted from the previous ones
+        gopStructure.SetConsecutiveBFrameCount(0);
+        codecBlockAlignment = 8; // MI size
+        return VK_SUCCESS;
+    }
+
+    virtual VkResult InitDeviceCapbilities(const VulkanDeviceContext* vkDevCtx);
+
+    virtual uint32_t GetDefaultVideoProfileIdc() { return STD_VIDEO_AV1_PROFILE_MAIN; };
+
+    // 1. First AV1 determine the number of the Dpb buffers required
+    virtual int8_t InitDpbCount();
+
+    // 2. The rate control parameters, the H.26x QP of the options mapped to the q_idx
+    bool GetRateControlParameters(VkVideoEncodeRateControlInfoKHR *rcInfo,
+                                  VkVideoEncodeRateControlLayerInfoKHR *pRcLayerInfo,
+                                  VkVideoEncodeAV1RateControlInfoKHR *rcInfoAV1,
+                                  VkVideoEncodeAV1RateControlLayerInfoKHR *rcLayerInfoAV1);
+
+    // 3. Init the AV1 sequence header
+    bool InitSequenceHeader(StdVideoAV1SequenceHeader *seqHdr, StdVideoAV1ColorConfig *colorConfig);
+
+    static uint32_t QpToQIndex(int32_t qp) {
+        return (uint32_t)std::min<int32_t>(std::max<int32_t>(qp, 0) * MAX_QINDEX / 51, MAX_QINDEX);
+    }
+};
+
+#endif // VK_KHR_video_encode_av1
+
+#endif /* VKVIDEOENCODER_VKENCODERCONFIG_AV1_H_ */
@@ -223,6 +223,8 @@ bool EncoderConfigH264::InitSpsPpsParameters(StdVideoH264SequenceParameterSet *s
     sps->log2_max_pic_order_cnt_lsb_minus4 = 4;
 
     sps->max_num_ref_frames = dpbCount;
+    // Dropping the upper temporal layers leaves gaps in frame_num
+    sps->flags.gaps_in_frame_num_value_allowed_flag = (gopStructure.GetTemporalLayerCount() > 2);
 
     // Initialize PPS values
     pps->seq_parameter_set_id = sps->seq_parameter_set_id;
@@ -369,8 +371,25 @@ VkResult EncoderConfigH264::InitDeviceCapbilities(const VulkanDeviceContext* vkD
         std::cout << "\t\t\t" << "maxExtent: " << videoCapabilities.maxCodedExtent.width  << " x " << videoCapabilities.maxCodedExtent.height << std::endl;
         std::cout << "\t\t\t" << "maxDpbSlots: " << videoCapabilities.maxDpbSlots << std::endl;
         std::cout << "\t\t\t" << "maxActiveReferencePictures: " << videoCapabilities.maxActiveReferencePictures << std::endl;
+        std::cout << "\t\t\t" << "maxTemporalLayerCount: " << h264EncodeCapabilities.maxTemporalLayerCount << std::endl;
     }
 
+    const uint32_t maxTemporalLayerCount = std::max<uint32_t>(h264EncodeCapabilities.maxTemporalLayerCount, 1);
+    if ((uint32_t)gopStructure.GetTemporalLayerCount() > maxTemporalLayerCount) {
+        std::cout << "The temporal layers are limited to " << maxTemporalLayerCount << " by the device" << std::endl;
+        gopStructure.SetTemporalLayerCount((int8_t)maxTemporalLayerCount);
+    }
+
+    // The intra refresh codes a slice of each P frame as an I slice
+    if ((intraRefreshPeriod > 0) &&
+            ((h264EncodeCapabilities.flags & VK_VIDEO_ENCODE_H264_CAPABILITY_DIFFERENT_SLICE_TYPE_BIT_KHR) == 0)) {
+        std::cout << "The intra refresh is not supported by the device, using periodic IDR frames" << std::endl;
+        intraRefreshPeriod = 0;
+    }
+    maxSliceCount = std::max<uint32_t>(h264EncodeCapabilities.maxSliceCount, 1);
+    perSliceConstantQp = ((h264EncodeCapabilities.flags &
+                           VK_VIDEO_ENCODE_H264_CAPABILITY_PER_SLICE_CONSTANT_QP_BIT_KHR) != 0);
+
     return VK_SUCCESS;
 }
 
@@ -380,6 +399,16 @@ int8_t EncoderConfigH264::InitDpbCount()
         dpbCount = (gopStructure.GetConsecutiveBFrameCount() > 0) ? gopStructure.GetConsecutiveBFrameCount() : 1;
     }
 
+    if (gopStructure.GetTemporalLayerCount() > 2) {
+        // The sliding window must keep the last base layer frame, up to half a temporal pattern of references ago
+        dpbCount = (int8_t)std::max<int32_t>(dpbCount, 1 << (gopStructure.GetTemporalLayerCount() - 2));
+    }
+
+    if (gopStructure.GetPyramid()) {
+        // Both anchors and the reference B-frames of the pyramid between them
+        dpbCount = (int8_t)std::max<int32_t>(dpbCount, 2 + gopStructure.GetNumPyramidReferences());
+    }
+
     // spsInfo->level represents the smallest level that we require for the
     // given stream. This level constrains the maximum size (in terms of
     // number of frames) that the DPB can have. levelDpbSize is this maximum
@@ -478,8 +507,7 @@ bool EncoderConfigH264::GetRateControlParameters(VkVideoEncodeRateControlInfoKHR
                                                  VkVideoEncodeH264RateControlInfoKHR *pRateControlInfoH264,
                                                  VkVideoEncodeH264RateControlLayerInfoKHR *pRateControlLayerInfoH264)
 {
-    pRateControlLayersInfo->frameRateNumerator = frameRateNumerator;
-    pRateControlLayersInfo->frameRateDenominator = frameRateDenominator;
+    const uint32_t layerCount = GetRateControlLayers(pRateControlLayersInfo);
 
     if (rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DEFAULT_KHR) {
         pRateControlInfo->rateControlMode = VK_VIDEO_ENCODE_RATE_CONTROL_MODE_VBR_BIT_KHR;
@@ -487,16 +515,15 @@ bool EncoderConfigH264::GetRateControlParameters(VkVideoEncodeRateControlInfoKHR
         pRateControlInfo->rateControlMode = rateControlMode;
     }
 
-    if (pRateControlInfo->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
-        pRateControlLayerInfoH264->minQp = pRateControlLayerInfoH264->maxQp = minQp;
-    } else {
-        pRateControlLayerInfoH264->minQp = minQp;
-        pRateControlLayerInfoH264->maxQp = maxQp;
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+        if (pRateControlInfo->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+            pRateControlLayerInfoH264[layer].minQp = pRateControlLayerInfoH264[layer].maxQp = minQp;
+        } else {
+            pRateControlLayerInfoH264[layer].minQp = minQp;
+            pRateControlLayerInfoH264[layer].maxQp = maxQp;
+        }
     }
 
-    pRateControlLayersInfo->averageBitrate = averageBitrate;
-    pRateControlLayersInfo->maxBitrate = hrdBitrate;
-
     if (averageBitrate > 0 || hrdBitrate > 0) {
        pRateControlInfo->virtualBufferSizeInMs = vbvBufferSize * 1000ull / (hrdBitrate ? hrdBitrate : averageBitrate);
        pRateControlInfo->initialVirtualBufferSizeInMs = vbvInitialDelay * 1000ull / (hrdBitrate ? hrdBitrate : averageBitrate);
@@ -506,6 +533,16 @@ bool EncoderConfigH264::GetRateControlParameters(VkVideoEncodeRateControlInfoKHR
 
     pRateControlInfoH264->gopFrameCount = (gopStructure.GetGopFrameCount() > 0) ? gopStructure.GetGopFrameCount() : (uint32_t)GOP_LENGTH_DEFAULT;
     pRateControlInfoH264->idrPeriod = (gopStructure.GetIdrPeriod() > 0) ? gopStructure.GetIdrPeriod() : (uint32_t)IDR_PERIOD_DEFAULT;
+    if (gopStructure.GetIntraRefresh()) {
+        // Without the periodic IDR and I frames, the GOP and the IDR period are infinite
+        pRateControlInfoH264->gopFrameCount = UINT32_MAX;
+        pRateControlInfoH264->idrPeriod = UINT32_MAX;
+    }
+
+    pRateControlInfoH264->temporalLayerCount = layerCount;
+    if (layerCount > 1) {
+        pRateControlInfoH264->flags |= VK_VIDEO_ENCODE_H264_RATE_CONTROL_TEMPORAL_LAYER_PATTERN_DYADIC_BIT_KHR;
+    }
 
     return true;
 }
@@ -178,6 +178,8 @@ struct EncoderConfigH264 : public EncoderConfig {
 
     virtual uint32_t GetDefaultVideoProfileIdc() { return STD_VIDEO_H264_PROFILE_IDC_HIGH; };
 
+    virtual uint32_t GetPicHeightInSliceRows() const { return pic_height_in_map_units; };
+
     // 1. First h.264 determine the number of the Dpb buffers required
     virtual int8_t InitDpbCount();
 
@@ -89,8 +89,25 @@ VkResult EncoderConfigH265::InitDeviceCapbilities(const VulkanDeviceContext* vkD
         std::cout << "\t\t\t" << "maxExtent: " << videoCapabilities.maxCodedExtent.width  << " x " << videoCapabilities.maxCodedExtent.height << std::endl;
         std::cout << "\t\t\t" << "maxDpbSlots: " << videoCapabilities.maxDpbSlots << std::endl;
         std::cout << "\t\t\t" << "maxActiveReferencePictures: " << videoCapabilities.maxActiveReferencePictures << std::endl;
+        std::cout << "\t\t\t" << "maxSubLayerCount: " << h265EncodeCapabilities.maxSubLayerCount << std::endl;
     }
 
+    const uint32_t maxTemporalLayerCount = std::max<uint32_t>(h265EncodeCapabilities.maxSubLayerCount, 1);
+    if ((uint32_t)gopStructure.GetTemporalLayerCount() > maxTemporalLayerCount) {
+        std::cout << "The temporal layers are limited to " << maxTemporalLayerCount << " by the device" << std::endl;
+        gopStructure.SetTemporalLayerCount((int8_t)maxTemporalLayerCount);
+    }
+
+    // The intra refresh codes a slice segment of each P frame as an I slice
+    if ((intraRefreshPeriod > 0) &&
+            ((h265EncodeCapabilities.flags & VK_VIDEO_ENCODE_H265_CAPABILITY_DIFFERENT_SLICE_SEGMENT_TYPE_BIT_KHR) == 0)) {
+        std::cout << "The intra refresh is not supported by the device, using periodic IDR frames" << std::endl;
+        intraRefreshPeriod = 0;
+    }
+    maxSliceCount = std::max<uint32_t>(h265EncodeCapabilities.maxSliceSegmentCount, 1);
+    perSliceConstantQp = ((h265EncodeCapabilities.flags &
+                           VK_VIDEO_ENCODE_H265_CAPABILITY_PER_SLICE_SEGMENT_CONSTANT_QP_BIT_KHR) != 0);
+
     return VK_SUCCESS;
 }
 
@@ -100,6 +117,16 @@ int8_t EncoderConfigH265::InitDpbCount()
         dpbCount = (gopStructure.GetConsecutiveBFrameCount() > 0) ? gopStructure.GetConsecutiveBFrameCount() : ((numRefL0 > 1) ? 2 : 1);
     }
 
+    if (gopStructure.GetTemporalLayerCount() > 1) {
+        // The last reference frame of each layer below the top one stays in the DPB
+        dpbCount = (int8_t)std::max<int32_t>(dpbCount, gopStructure.GetTemporalLayerCount() - 1);
+    }
+
+    if (gopStructure.GetPyramid()) {
+        // Both anchors, the reference B-frames of the pyramid between them and the current picture
+        dpbCount = (int8_t)std::max<int32_t>(dpbCount, 3 + gopStructure.GetNumPyramidReferences());
+    }
+
     return VerifyDpbSize();
 }
 
@@ -480,10 +507,7 @@ bool EncoderConfigH265::GetRateControlParameters(VkVideoEncodeRateControlInfoKHR
         rcInfo->rateControlMode = rateControlMode;
     }
 
-    pRcLayerInfo->frameRateNumerator = frameRateNumerator;
-    pRcLayerInfo->frameRateDenominator = frameRateDenominator;
-    pRcLayerInfo->averageBitrate = averageBitrate;
-    pRcLayerInfo->maxBitrate = hrdBitrate;
+    const uint32_t layerCount = GetRateControlLayers(pRcLayerInfo);
 
     if ((averageBitrate > 0) || (hrdBitrate > 0)) {
         rcInfo->virtualBufferSizeInMs = vbvBufferSize * 1000ull / (hrdBitrate ? hrdBitrate : averageBitrate);
@@ -494,12 +518,24 @@ bool EncoderConfigH265::GetRateControlParameters(VkVideoEncodeRateControlInfoKHR
 
     rcInfoH265->gopFrameCount = (gopStructure.GetGopFrameCount() > 0) ? gopStructure.GetGopFrameCount() : uint32_t(DEFAULT_GOP_FRAME_COUNT);
     rcInfoH265->idrPeriod = (gopStructure.GetIdrPeriod() > 0) ? gopStructure.GetIdrPeriod() : uint32_t(DEFAULT_GOP_IDR_PERIOD);
+    if (gopStructure.GetIntraRefresh()) {
+        // Without the periodic IDR and I frames, the GOP and the IDR period are infinite
+        rcInfoH265->gopFrameCount = UINT32_MAX;
+        rcInfoH265->idrPeriod = UINT32_MAX;
+    }
 
-    if (rcInfo->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
-        rcLayerInfoH265->minQp = rcLayerInfoH265->maxQp = minQp;
-    } else {
-        rcLayerInfoH265->minQp = minQp;
-        rcLayerInfoH265->maxQp = maxQp;
+    rcInfoH265->subLayerCount = layerCount;
+    if (layerCount > 1) {
+        rcInfoH265->flags |= VK_VIDEO_ENCODE_H265_RATE_CONTROL_TEMPORAL_SUB_LAYER_PATTERN_DYADIC_BIT_KHR;
+    }
+
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+        if (rcInfo->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+            rcLayerInfoH265[layer].minQp = rcLayerInfoH265[layer].maxQp = minQp;
+        } else {
+            rcLayerInfoH265[layer].minQp = minQp;
+            rcLayerInfoH265[layer].maxQp = maxQp;
+        }
     }
 
     return true;
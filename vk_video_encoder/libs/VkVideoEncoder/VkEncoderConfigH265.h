@@ -143,6 +143,10 @@ struct EncoderConfigH265 : public EncoderConfig {
 
     virtual uint32_t GetDefaultVideoProfileIdc() { return STD_VIDEO_H265_PROFILE_IDC_MAIN; };
 
+    virtual uint32_t GetPicHeightInSliceRows() const { return DivUp<uint32_t>(encodeHeight, 1U << (cuSize + 3)); };
+
+    virtual uint32_t GetSliceRowHeight() const { return 1U << (cuSize + 3); };
+
     // 1. First h.265 determine the number of the Dpb buffers required
     virtual int8_t InitDpbCount();
 
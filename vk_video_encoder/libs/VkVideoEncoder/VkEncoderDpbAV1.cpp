@@ -0,0 +1,185 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include <algorithm>
+
+#include "VkEncoderDpbAV1.h"
+
+// The forward reference names, LAST_FRAME to GOLDEN_FRAME, the backward ones are left for the B-frames
+static const uint32_t maxForwardRefs = 4;
+
+VkEncDpbAV1::VkEncDpbAV1()
+    : m_vbiToDpbSlot()
+    , m_curDpbIndex(-1)
+    , m_dpbSize(0)
+    , m_numRefVbis(1)
+    , m_nextVbi(0)
+    , m_refreshFrameFlags(0)
+{
+    for (uint32_t i = 0; i < MAX_DPB_SLOTS; i++) {
+        m_stDpb[i] = DpbEntryAV1();
+    }
+    memset(m_vbiToDpbSlot, -1, sizeof(m_vbiToDpbSlot));
+}
+
+bool VkEncDpbAV1::DpbSequenceStart(int32_t dpbSize, int32_t numRefs)
+{
+    assert(dpbSize >= 0);
+    m_dpbSize = (int8_t)std::min<uint32_t>((uint32_t)dpbSize, MAX_DPB_SLOTS);
+    // The references and the current picture
+    m_numRefVbis = (uint8_t)std::min<int32_t>(std::max<int32_t>(numRefs, 1), std::max<int32_t>(m_dpbSize - 1, 1));
+    m_numRefVbis = std::min<uint8_t>(m_numRefVbis, NUM_REF_FRAMES);
+
+    FlushDpb();
+
+    return true;
+}
+
+void VkEncDpbAV1::FlushDpb()
+{
+    for (uint32_t i = 0; i < MAX_DPB_SLOTS; i++) {
+        m_stDpb[i] = DpbEntryAV1();
+    }
+    memset(m_vbiToDpbSlot, -1, sizeof(m_vbiToDpbSlot));
+    m_curDpbIndex = -1;
+    m_nextVbi = 0;
+    m_refreshFrameFlags = 0;
+}
+
+int8_t VkEncDpbAV1::GetFreeSlot() const
+{
+    for (int8_t i = 0; i < m_dpbSize; i++) {
+        if (m_stDpb[i].refCount == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int8_t VkEncDpbAV1::DpbPictureStart(uint64_t frameId, bool isKeyFrame, uint32_t orderHint, bool isReference,
+                                    uint32_t numActiveRefs, RefFrames* pRefFrames)
+{
+    assert(pRefFrames != nullptr);
+    memset(pRefFrames, 0, sizeof(*pRefFrames));
+    memset(pRefFrames->refNameSlotIndex, -1, sizeof(pRefFrames->refNameSlotIndex));
+
+    if (isKeyFrame) {
+        // A shown key frame resets the references
+        FlushDpb();
+        m_refreshFrameFlags = 0xFF;
+    } else if (isReference) {
+        const uint8_t followingVbis = (uint8_t)(0xFF & ~((1u << m_numRefVbis) - 1));
+        m_refreshFrameFlags = (uint8_t)((1u << m_nextVbi) | followingVbis);
+        m_nextVbi = (uint8_t)((m_nextVbi + 1) % m_numRefVbis);
+    } else {
+        m_refreshFrameFlags = 0;
+    }
+    pRefFrames->refreshFrameFlags = m_refreshFrameFlags;
+
+    for (uint32_t vbi = 0; vbi < NUM_REF_FRAMES; vbi++) {
+        const int8_t dpbIndex = m_vbiToDpbSlot[vbi];
+        pRefFrames->refOrderHint[vbi] = (dpbIndex >= 0) ? m_stDpb[dpbIndex].orderHint : 0;
+    }
+
+    if (!isKeyFrame) {
+        // The distinct pictures of the rotated VBIs, the most recent first
+        uint8_t refVbis[NUM_REF_FRAMES];
+        uint32_t numRefVbis = 0;
+        for (uint8_t vbi = 0; vbi < m_numRefVbis; vbi++) {
+            const int8_t dpbIndex = m_vbiToDpbSlot[vbi];
+            if (dpbIndex < 0) {
+                continue;
+            }
+            bool duplicate = false;
+            for (uint32_t i = 0; i < numRefVbis; i++) {
+                duplicate = duplicate || (m_vbiToDpbSlot[refVbis[i]] == dpbIndex);
+            }
+            if (!duplicate) {
+                refVbis[numRefVbis++] = vbi;
+            }
+        }
+        std::sort(refVbis, refVbis + numRefVbis, [this](uint8_t a, uint8_t b) {
+            return m_stDpb[m_vbiToDpbSlot[a]].frameId > m_stDpb[m_vbiToDpbSlot[b]].frameId;
+        });
+
+        const uint32_t numRefs = std::min(std::min(std::max(numActiveRefs, 1u), maxForwardRefs), numRefVbis);
+        assert(numRefs > 0);
+        for (uint32_t name = 0; name < REFS_PER_FRAME; name++) {
+            // The names without a picture of their own point to LAST_FRAME in the frame header
+            pRefFrames->refFrameIdx[name] = (name < numRefs) ? refVbis[name] : refVbis[0];
+            if (name < numRefs) {
+                pRefFrames->refNameSlotIndex[name] = m_vbiToDpbSlot[refVbis[name]];
+                pRefFrames->refSlots[pRefFrames->numRefSlots++] = m_vbiToDpbSlot[refVbis[name]];
+            }
+        }
+    }
+
+    m_curDpbIndex = GetFreeSlot();
+    assert(m_curDpbIndex >= 0);
+    if (m_curDpbIndex < 0) {
+        return -1;
+    }
+
+    DpbEntryAV1& entry = m_stDpb[m_curDpbIndex];
+    entry.dpbImageView = nullptr;
+    entry.frameId = frameId;
+    entry.orderHint = orderHint;
+    entry.frameType = isKeyFrame ? 0 : 1;
+
+    return m_curDpbIndex;
+}
+
+void VkEncDpbAV1::DpbPictureEnd(VkSharedBaseObj<VulkanVideoImagePoolNode>& dpbImageView)
+{
+    assert(m_curDpbIndex >= 0);
+    m_stDpb[m_curDpbIndex].dpbImageView = dpbImageView;
+
+    for (uint32_t vbi = 0; vbi < NUM_REF_FRAMES; vbi++) {
+        if ((m_refreshFrameFlags & (1 << vbi)) == 0) {
+            continue;
+        }
+        const int8_t prevDpbIndex = m_vbiToDpbSlot[vbi];
+        if (prevDpbIndex >= 0) {
+            assert(m_stDpb[prevDpbIndex].refCount > 0);
+            if (--m_stDpb[prevDpbIndex].refCount == 0) {
+                // Back to the pool of the DPB images
+                m_stDpb[prevDpbIndex].dpbImageView = nullptr;
+            }
+        }
+        m_vbiToDpbSlot[vbi] = m_curDpbIndex;
+        m_stDpb[m_curDpbIndex].refCount++;
+    }
+
+    if (m_stDpb[m_curDpbIndex].refCount == 0) {
+        // Not a reference, its slot is free again
+        m_stDpb[m_curDpbIndex].dpbImageView = nullptr;
+    }
+}
+
+bool VkEncDpbAV1::GetRefPicture(int8_t dpbIndex, VkSharedBaseObj<VulkanVideoImagePoolNode>& dpbImageView)
+{
+    assert((dpbIndex >= 0) && (dpbIndex < m_dpbSize));
+
+    if (!((dpbIndex >= 0) && (dpbIndex < m_dpbSize))) {
+        return false;
+    }
+
+    dpbImageView = m_stDpb[dpbIndex].dpbImageView;
+    return (dpbImageView != nullptr) ? true : false;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(VKENC_AV1_DPB_H)
+#define VKENC_AV1_DPB_H
+
+#include <stdint.h>
+#include "VkCodecUtils/VulkanVideoImagePool.h"
+
+struct DpbEntryAV1 {
+    // The YCbCr dpb image resource
+    VkSharedBaseObj<VulkanVideoImagePoolNode>  dpbImageView;
+    uint64_t frameId;      // internal unique id
+    uint32_t orderHint;
+    uint32_t frameType;    // 0: key frame, 1: inter frame
+    uint32_t refCount;     // of the virtual buffers holding the picture
+};
+
+//
+// The AV1 references are the 8 virtual buffers (VBI) of the frame header, the refresh_frame_flags
+// of each frame replacing some of them. The VBIs map to the DPB slots holding the pictures, a slot
+// being reused once no VBI holds its picture anymore.
+//
+// A shown key frame refreshes all the VBIs. The reference frames then rotate over the first numRefs
+// VBIs, the VBIs above them following the latest reference, so that the DPB holds the last numRefs
+// reference frames and the current picture.
+//
+class VkEncDpbAV1 {
+
+public:
+    enum { NUM_REF_FRAMES = 8 };
+    enum { REFS_PER_FRAME = 7 }; // LAST_FRAME to ALTREF_FRAME
+    enum { MAX_DPB_SLOTS = NUM_REF_FRAMES + 1 };
+
+    struct RefFrames {
+        uint8_t  refreshFrameFlags;
+        uint8_t  refFrameIdx[REFS_PER_FRAME];            // the VBI of each reference name
+        int8_t   refNameSlotIndex[REFS_PER_FRAME];       // the DPB slot of each reference name used, -1 if unused
+        uint32_t refOrderHint[NUM_REF_FRAMES];           // of the picture in each VBI
+        int8_t   refSlots[REFS_PER_FRAME];               // the distinct DPB slots referenced
+        uint32_t numRefSlots;
+    };
+
+    VkEncDpbAV1();
+    ~VkEncDpbAV1() {}
+
+    bool DpbSequenceStart(int32_t dpbSize, int32_t numRefs);
+
+    // Returns the DPB slot of the current picture, with its references from the most recent, one per
+    // reference name from LAST_FRAME up to numActiveRefs.
+    int8_t DpbPictureStart(uint64_t frameId, bool isKeyFrame, uint32_t orderHint, bool isReference,
+                           uint32_t numActiveRefs, RefFrames* pRefFrames);
+    void DpbPictureEnd(VkSharedBaseObj<VulkanVideoImagePoolNode>& dpbImageView);
+
+    bool GetRefPicture(int8_t dpbIndex, VkSharedBaseObj<VulkanVideoImagePoolNode>& dpbImageView);
+
+    const DpbEntryAV1* GetDpbEntry(int8_t dpbIndex) const {
+        return ((dpbIndex >= 0) && (dpbIndex < m_dpbSize)) ? &m_stDpb[dpbIndex] : nullptr;
+    }
+
+private:
+    void FlushDpb();
+    int8_t GetFreeSlot() const;
+
+private:
+    DpbEntryAV1                    m_stDpb[MAX_DPB_SLOTS];
+    int8_t                         m_vbiToDpbSlot[NUM_REF_FRAMES]; // -1 before the first key frame
+    int8_t                         m_curDpbIndex;
+    int8_t                         m_dpbSize;
+    uint8_t                        m_numRefVbis;                   // rotated over by the reference frames
+    uint8_t                        m_nextVbi;                      // refreshed by the next reference frame
+    uint8_t                        m_refreshFrameFlags;            // of the current picture
+};
+
+#endif // !defined(VKENC_AV1_DPB_H)
@@ -89,9 +89,13 @@ VkEncDpbH264::VkEncDpbH264()
       m_prevFrameNum(0),
       m_PrevRefFrameNum(0),
       m_currDpbIdx(0),
-      m_lastIDRTimeStamp(0)
+      m_numRefSlots(0),
+      m_lastIDRTimeStamp(0),
+      m_lastRecoveryTimeStamp(0),
+      m_lastRecoveryRefTimeStamp(0)
 {
     memset(m_max_num_list, 0, sizeof(m_max_num_list));
+    memset(m_refSlots, -1, sizeof(m_refSlots));
 }
 
 VkEncDpbH264::~VkEncDpbH264() {}
@@ -124,6 +128,8 @@ void VkEncDpbH264::DpbDeinit()
     m_max_dpb_size = 0;
     m_currDpbIdx = 0;
     m_lastIDRTimeStamp = 0;
+    m_lastRecoveryTimeStamp = 0;
+    m_lastRecoveryRefTimeStamp = 0;
     m_currDpbIdx = -1;
 };
 
@@ -220,7 +226,7 @@ int8_t VkEncDpbH264::DpbPictureStart(const PicInfoH264 *pPicInfo,
 
     CalculatePOC(pPicInfo, sps);
     CalculatePicNum(pPicInfo, sps);
-
+    UpdateRefSlots();
 
     return m_currDpbIdx;
 }
@@ -389,6 +395,8 @@ int8_t VkEncDpbH264::DpbPictureEnd(const PicInfoH264 *pPicInfo,
         pCurDPBEntry->dpbImageView = dpbImageView;
     }
 
+    UpdateRefSlots();
+
     return m_currDpbIdx;
 }
 
@@ -972,6 +980,23 @@ void VkEncDpbH264::FlushDpb()
         }
     }
     while (!IsDpbEmpty()) DpbBumping(true);
+
+    UpdateRefSlots();
+}
+
+void VkEncDpbH264::UpdateRefSlots()
+{
+    m_numRefSlots = 0;
+    for (int32_t i = 0; i < MAX_DPB_SLOTS; i++) {
+        if ((m_DPB[i].top_field_marking != MARKING_UNUSED) || (m_DPB[i].bottom_field_marking != MARKING_UNUSED)) {
+            m_refSlots[m_numRefSlots++] = (int8_t)i;
+        }
+    }
+    // The most recent short-term references first, as in the list of the P frames
+    std::sort(m_refSlots, m_refSlots + m_numRefSlots, [this](int8_t a, int8_t b) {
+        return (m_DPB[a].frameNumWrap > m_DPB[b].frameNumWrap) ||
+               ((m_DPB[a].frameNumWrap == m_DPB[b].frameNumWrap) && (a > b));
+    });
 }
 
 bool VkEncDpbH264::GetRefPicture(int8_t dpbIdx, VkSharedBaseObj<VulkanVideoImagePoolNode>& dpbImageView)
@@ -1252,68 +1277,66 @@ int32_t VkEncDpbH264::RefPicListInitializationBFrameListX(RefPicListEntry *RefPi
     return k;
 }
 
-int32_t VkEncDpbH264::SortListDescending(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin,
-        int32_t n, ptrFuncDpbSort sort_check, bool bSkipCorruptFrames)
+// The references passing sort_check, in the order of their value, one per value: the last DPB entry of those with the
+// same one. Only the entries used for reference are sorted, instead of selecting each of the list among all the DPB.
+int32_t VkEncDpbH264::SortRefSlots(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin,
+                                   ptrFuncDpbSort sort_check, bool bSkipCorruptFrames, bool descending,
+                                   int32_t minValue, int32_t maxValue)
 {
-    int32_t k = kmin;
-    for ( ; k < MAX_DPB_SLOTS; k++) {
-        int32_t m = INF_MIN;
-        int32_t i1 = -1;
-        int32_t v = -1;
-        // find largest entry less than or equal to n
-        for (int32_t i = 0; i < MAX_DPB_SLOTS; i++) {
-            if (m_DPB[i].view_id != m_DPB[m_currDpbIdx].view_id) {
-                continue;
-            }
+    struct SortEntry {
+        int32_t value;
+        int32_t dpbIndex;
+    } entries[MAX_DPB_SLOTS];
+    int32_t numEntries = 0;
 
-            if ((m_DPB[i].frame_is_corrupted == true) && (bSkipCorruptFrames == true)) {
-                continue;
-            }
+    for (int32_t r = 0; r < m_numRefSlots; r++) {
+        const int32_t i = m_refSlots[r];
+        if (m_DPB[i].view_id != m_DPB[m_currDpbIdx].view_id) {
+            continue;
+        }
 
-            if (sort_check(&m_DPB[i], sps->pic_order_cnt_type, &v) && (v >= m) && (v <= n)) {
-                i1 = i;
-                m = v;
-            }
+        if ((m_DPB[i].frame_is_corrupted == true) && (bSkipCorruptFrames == true)) {
+            continue;
         }
-        if (i1 < 0) break;  // no more entries
-        RefPicListX[k].dpbIndex = i1;
-        if (m == INF_MIN) { // smallest possible entry, exit early to avoid underflow
-            k++;
-            break;
+
+        int32_t v = -1;
+        if (sort_check(&m_DPB[i], sps->pic_order_cnt_type, &v) && (v >= minValue) && (v <= maxValue)) {
+            entries[numEntries++] = { v, i };
+        }
+    }
+
+    std::sort(entries, entries + numEntries, [descending](const SortEntry& a, const SortEntry& b) {
+        if (a.value != b.value) {
+            return descending ? (a.value > b.value) : (a.value < b.value);
+        }
+        return (a.dpbIndex > b.dpbIndex);
+    });
+
+    int32_t k = kmin;
+    for (int32_t e = 0; (e < numEntries) && (k < MAX_DPB_SLOTS); e++) {
+        if ((e > 0) && (entries[e].value == entries[e - 1].value)) {
+            continue;
         }
-        n = m - 1;
+        RefPicListX[k++].dpbIndex = entries[e].dpbIndex;
     }
     return k;
 }
 
+int32_t VkEncDpbH264::SortListDescending(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin,
+        int32_t n, ptrFuncDpbSort sort_check, bool bSkipCorruptFrames)
+{
+    // largest entries less than or equal to n first
+    return SortRefSlots(RefPicListX, sps, kmin, sort_check, bSkipCorruptFrames, true, INF_MIN, n);
+}
+
 int32_t VkEncDpbH264::SortListAscending(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin,
                                         int32_t n, ptrFuncDpbSort sort_check, bool bSkipCorruptFrames)
 {
-    int32_t m, k, i, i1, v;
-
-    for (k = kmin; k < MAX_DPB_SLOTS; k++) {
-        m = INF_MAX;
-        i1 = -1;
-        // find smallest entry greater than n
-        for (i = 0; i < MAX_DPB_SLOTS; i++) {
-            if (m_DPB[i].view_id != m_DPB[m_currDpbIdx].view_id) {
-                continue;
-            }
-
-            if ((m_DPB[i].frame_is_corrupted == true) && (bSkipCorruptFrames == true)) {
-                continue;
-            }
-
-            if (sort_check(&m_DPB[i], sps->pic_order_cnt_type, &v) && v <= m && v > n) {
-                i1 = i;
-                m = v;
-            }
-        }
-        if (i1 < 0) break;  // no more entries
-        RefPicListX[k].dpbIndex = i1;
-        n = m;
+    // smallest entries greater than n first
+    if (n == INF_MAX) {
+        return kmin;
     }
-    return k;
+    return SortRefSlots(RefPicListX, sps, kmin, sort_check, bSkipCorruptFrames, false, n + 1, INF_MAX);
 }
 
 // 8.2.4.3
@@ -1499,15 +1522,16 @@ int32_t VkEncDpbH264::GetPicNumXWithMinPOC(uint32_t view_id, int32_t field_pic_f
 {
     int32_t pocMin = INF_MAX;
     int32_t min = -1;
-    int32_t i = 0;
-    for (i = 0; i < MAX_DPB_SLOTS; i++) {
+    for (int32_t r = 0; r < m_numRefSlots; r++) {
+        const int32_t i = m_refSlots[r];
+        // The lowest DPB index of those with the same POC
         if ((m_DPB[i].state & DPB_TOP) && (m_DPB[i].top_field_marking == MARKING_SHORT) &&
-                (m_DPB[i].topFOC < pocMin) && (m_DPB[i].view_id == view_id)) {
+                ((m_DPB[i].topFOC < pocMin) || ((m_DPB[i].topFOC == pocMin) && (i < min))) && (m_DPB[i].view_id == view_id)) {
             pocMin = m_DPB[i].topFOC;
             min = i;
         }
         if ((m_DPB[i].state & DPB_BOTTOM) && (m_DPB[i].top_field_marking == MARKING_SHORT) &&
-                (m_DPB[i].bottomFOC < pocMin) && (m_DPB[i].view_id == view_id)) {
+                ((m_DPB[i].bottomFOC < pocMin) || ((m_DPB[i].bottomFOC == pocMin) && (i < min))) && (m_DPB[i].view_id == view_id)) {
             pocMin = m_DPB[i].bottomFOC;
             min = i;
         }
@@ -1525,18 +1549,16 @@ int32_t VkEncDpbH264::GetPicNumXWithMinPOC(uint32_t view_id, int32_t field_pic_f
 
 int32_t VkEncDpbH264::GetPicNumXWithMinFrameNumWrap(uint32_t view_id, int32_t field_pic_flag, int32_t bottom_field)
 {
-    int32_t minFrameNumWrap = 65536;
     int32_t minFrameNum = -1;
-    int32_t i = 0;
 
-    for (i = 0; i < MAX_DPB_SLOTS; i++) {
-        if (m_DPB[i].view_id == view_id) {
-            if (((m_DPB[i].top_field_marking == MARKING_SHORT) || (m_DPB[i].bottom_field_marking == MARKING_SHORT))) {
-                if (m_DPB[i].frameNumWrap < minFrameNumWrap) {
-                    minFrameNum = i;
-                    minFrameNumWrap = m_DPB[i].frameNumWrap;
-                }
-            }
+    // The references are sorted by FrameNumWrap descending, the lowest DPB index last of those with the same one
+    for (int32_t r = m_numRefSlots - 1; r >= 0; r--) {
+        const int32_t i = m_refSlots[r];
+        if ((m_DPB[i].view_id == view_id) &&
+                ((m_DPB[i].top_field_marking == MARKING_SHORT) || (m_DPB[i].bottom_field_marking == MARKING_SHORT)) &&
+                (m_DPB[i].frameNumWrap < 65536)) {
+            minFrameNum = i;
+            break;
         }
     }
 
@@ -1550,6 +1572,28 @@ int32_t VkEncDpbH264::GetPicNumXWithMinFrameNumWrap(uint32_t view_id, int32_t fi
     return -1;
 }
 
+int32_t VkEncDpbH264::GetPicNumsExceptMaxPOC(uint32_t view_id, int32_t* picNums, int32_t maxPicNums)
+{
+    int32_t pocMax = -INF_MAX;
+    int32_t max = -1;
+    for (int32_t i = 0; i < MAX_DPB_SLOTS; i++) {
+        if ((m_DPB[i].state & DPB_TOP) && (m_DPB[i].top_field_marking == MARKING_SHORT) &&
+                (m_DPB[i].topFOC > pocMax) && (m_DPB[i].view_id == view_id)) {
+            pocMax = m_DPB[i].topFOC;
+            max = i;
+        }
+    }
+
+    int32_t numPicNums = 0;
+    for (int32_t i = 0; (i < MAX_DPB_SLOTS) && (numPicNums < maxPicNums); i++) {
+        if ((i != max) && (m_DPB[i].state & DPB_TOP) && (m_DPB[i].top_field_marking == MARKING_SHORT) &&
+                (m_DPB[i].view_id == view_id)) {
+            picNums[numPicNums++] = m_DPB[i].topPicNum;
+        }
+    }
+    return numPicNums;
+}
+
 int32_t VkEncDpbH264::GetPicNum(int32_t dpb_idx, bool bottomField)
 {
     if ((dpb_idx >= 0) && (dpb_idx < MAX_DPB_SLOTS) && (m_DPB[dpb_idx].state != DPB_EMPTY)) {
@@ -1561,6 +1605,7 @@ int32_t VkEncDpbH264::GetPicNum(int32_t dpb_idx, bool bottomField)
 }
 
 // Currently we support it only for IPPP gop pattern
+// Returns false if the request is ignored, for a frame before the last IDR or already invalidated.
 bool VkEncDpbH264::InvalidateReferenceFrames(uint64_t timeStamp)
 {
     bool isValidReqest = true;
@@ -1574,16 +1619,25 @@ bool VkEncDpbH264::InvalidateReferenceFrames(uint64_t timeStamp)
         }
     }
 
-    if ((timeStamp >= m_lastIDRTimeStamp) && isValidReqest) {
-        for (uint32_t i = 0; i < MAX_DPB_SLOTS; i++) {
-            if ((m_DPB[i].state != DPB_EMPTY) && ((timeStamp <= m_DPB[i].refFrameTimeStamp) || (timeStamp == m_DPB[i].timeStamp))) {
-                if ((m_DPB[i].top_field_marking == MARKING_SHORT) || (m_DPB[i].bottom_field_marking == MARKING_SHORT)) {
-                    m_DPB[i].frame_is_corrupted = true;
-                }
+    if ((timeStamp < m_lastIDRTimeStamp) || !isValidReqest) {
+        return false;
+    }
 
-                if ((m_DPB[i].top_field_marking == MARKING_LONG) || (m_DPB[i].bottom_field_marking == MARKING_LONG)) {
-                    m_DPB[i].frame_is_corrupted = true;
-                }
+    // The frames from the last recovery frame on don't predict from the ones between it and its reference
+    uint64_t maxTimeStamp = UINT64_MAX;
+    if ((timeStamp > m_lastRecoveryRefTimeStamp) && (timeStamp < m_lastRecoveryTimeStamp)) {
+        maxTimeStamp = m_lastRecoveryTimeStamp;
+    }
+
+    for (uint32_t i = 0; i < MAX_DPB_SLOTS; i++) {
+        if ((m_DPB[i].state != DPB_EMPTY) && (m_DPB[i].timeStamp < maxTimeStamp) &&
+                ((timeStamp <= m_DPB[i].refFrameTimeStamp) || (timeStamp == m_DPB[i].timeStamp))) {
+            if ((m_DPB[i].top_field_marking == MARKING_SHORT) || (m_DPB[i].bottom_field_marking == MARKING_SHORT)) {
+                m_DPB[i].frame_is_corrupted = true;
+            }
+
+            if ((m_DPB[i].top_field_marking == MARKING_LONG) || (m_DPB[i].bottom_field_marking == MARKING_LONG)) {
+                m_DPB[i].frame_is_corrupted = true;
             }
         }
     }
@@ -1653,6 +1707,12 @@ void VkEncDpbH264::SetCurRefFrameTimeStamp(uint64_t refFrameTimeStamp)
     m_DPB[m_currDpbIdx].refFrameTimeStamp = refFrameTimeStamp;
 }
 
+void VkEncDpbH264::SetCurRecoveryFrame()
+{
+    m_lastRecoveryTimeStamp = m_DPB[m_currDpbIdx].timeStamp;
+    m_lastRecoveryRefTimeStamp = m_DPB[m_currDpbIdx].refFrameTimeStamp;
+}
+
 // Returns a "view" of the DPB in terms of the entries holding valid reference
 // pictures.
 int32_t VkEncDpbH264::GetValidEntries(DpbEntryH264 entries[MAX_DPB_SLOTS])
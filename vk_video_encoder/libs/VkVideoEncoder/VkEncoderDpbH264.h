@@ -122,6 +122,8 @@ public:
     int32_t GetNumRefFramesInDPB(uint32_t viewid, int32_t *numShortTermRefs = NULL, int32_t *numLongTermRefs = NULL);
     int32_t GetPicNumXWithMinPOC(uint32_t view_id, int32_t field_pic_flag, int32_t bottom_field);
     int32_t GetPicNumXWithMinFrameNumWrap(uint32_t view_id, int32_t field_pic_flag, int32_t bottom_field);
+    // The pic nums of the short-term reference frames but the one with the highest POC, up to maxPicNums of them
+    int32_t GetPicNumsExceptMaxPOC(uint32_t view_id, int32_t* picNums, int32_t maxPicNums);
     int32_t GetPicNum(int32_t picIndex, bool bottomField = false);
     bool InvalidateReferenceFrames(uint64_t timeStamp);
     bool IsRefFramesCorrupted();
@@ -129,6 +131,8 @@ public:
     int32_t GetPicNumFromDpbIdx(int32_t dpbIdx, bool *shortterm, bool *longterm);
     uint64_t GetPictureTimestamp(int32_t picIdx);
     void SetCurRefFrameTimeStamp(uint64_t timeStamp);
+    // The current picture predicts from no corrupted frame, after SetCurRefFrameTimeStamp()
+    void SetCurRecoveryFrame();
 
     const StdVideoEncodeH264PictureInfo *GetCurrentDpbEntry(void)
     {
@@ -170,6 +174,8 @@ private:
     void CalculatePicNum(const PicInfoH264 *pPicInfo, const StdVideoH264SequenceParameterSet *sps);
     void OutputPicture(int32_t dpb_index, bool release);
     void FlushDpb();
+    // Keeps the set of the entries marked as used for reference, after each change of the marking
+    void UpdateRefSlots();
 
     // void flush();
 
@@ -189,6 +195,8 @@ private:
                                                bool bottomField, bool bSkipCorruptFrames);
     int32_t RefPicListInitializationBFrameListX(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps,
             bool list1, bool bSkipCorruptFrames);
+    int32_t SortRefSlots(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin,
+                         ptrFuncDpbSort sort_check, bool bSkipCorruptFrames, bool descending, int32_t minValue, int32_t maxValue);
     int32_t SortListDescending(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin, int32_t n,
                                ptrFuncDpbSort sort_check, bool bSkipCorruptFrames);
     int32_t SortListAscending(RefPicListEntry *RefPicListX, const StdVideoH264SequenceParameterSet *sps, int32_t kmin, int32_t n,
@@ -218,8 +226,12 @@ private:
     int32_t  m_max_num_list[2];
     int8_t   m_currDpbIdx;
     DpbEntryH264 m_DPB[MAX_DPB_SLOTS + 1]; // 1 for the current
+    int8_t   m_refSlots[MAX_DPB_SLOTS];    // the entries used for short or long-term reference, by FrameNumWrap descending
+    int32_t  m_numRefSlots;
 
     uint64_t m_lastIDRTimeStamp;
+    uint64_t m_lastRecoveryTimeStamp;
+    uint64_t m_lastRecoveryRefTimeStamp;
 };
 
 #endif  // VK_ENCODER_DPB_264_H
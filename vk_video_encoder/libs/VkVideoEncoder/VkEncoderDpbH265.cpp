@@ -42,6 +42,8 @@ VkEncDpbH265::VkEncDpbH265()
     , m_refreshPending(false)
     , m_longTermFlags(0)
     , m_useMultipleRefs()
+    , m_rpsCache()
+    , m_rpsCacheNext(0)
 {
         for (uint32_t i = 0; i < STD_VIDEO_H265_MAX_DPB_SIZE; i++) {
             m_stDpb[i] = DpbEntryH265();
@@ -64,6 +66,10 @@ bool VkEncDpbH265::DpbSequenceStart(int32_t dpbSize, bool useMultipleReferences)
     // so make use of that ability.
     m_useMultipleRefs = useMultipleReferences;
 
+    // The SPS of the new sequence may have other short-term RPS
+    memset(m_rpsCache, 0, sizeof(m_rpsCache));
+    m_rpsCacheNext = 0;
+
     return true;
 }
 
@@ -689,7 +695,38 @@ void VkEncDpbH265::InitializeShortTermRPSPFrame(int32_t numPocLtCurr,
                 }
             }
         }
+    }
+
+    // The rest only depends on the references found and the type of the picture
+    RpsCacheKey rpsKey;
+    memset(&rpsKey, 0, sizeof(rpsKey));
+    rpsKey.pSpsShortTermRps = pSpsShortTermRps;
+    rpsKey.spsNumShortTermRefPicSets = spsNumShortTermRefPicSets;
+    rpsKey.picType = pPicInfo->pic_type;
+    rpsKey.irapPicFlag = isIrapPic;
+    rpsKey.numRefL0 = numRefL0;
+    rpsKey.numRefL1 = numRefL1;
+    rpsKey.numPocLtCurr = numPocLtCurr;
+    rpsKey.numLongTermRefPic = numLongTermRefPic;
+    rpsKey.numNegativeRefPics = numNegativeRefPics;
+    rpsKey.numPositiveRefPics = numPositiveRefPics;
+    memcpy(rpsKey.deltaPocS0, deltaPocS0, numNegativeRefPics * sizeof(deltaPocS0[0]));
+    memcpy(rpsKey.deltaPocS1, deltaPocS1, numPositiveRefPics * sizeof(deltaPocS1[0]));
+    for (uint32_t entry = 0; entry < RPS_CACHE_SIZE; entry++) {
+        const RpsCacheEntry& rpsCacheEntry = m_rpsCache[entry];
+        if (rpsCacheEntry.valid && (memcmp(&rpsCacheEntry.key, &rpsKey, sizeof(rpsKey)) == 0)) {
+            if (rpsCacheEntry.spsShortTermRpsIdx >= 0) {
+                pPicInfo->flags.short_term_ref_pic_set_sps_flag = 1;
+                pPicInfo->short_term_ref_pic_set_idx = (uint8_t)rpsCacheEntry.spsShortTermRpsIdx;
+            } else {
+                pPicInfo->flags.short_term_ref_pic_set_sps_flag = 0;
+                *pShortTermRefPicSet = rpsCacheEntry.shortTermRefPicSet;
+            }
+            return;
+        }
+    }
 
+    if (m_useMultipleRefs) {
         // check if we exceed max num ref frames, try removing older  short term negative ref pics
         // since the negative list is sorted in decreasing order of POC , just decrease the numNegativeRefPics
         while ((numPocLtCurr + numNegativeRefPics + numPositiveRefPics) > (m_dpbSize - 1)) {
@@ -826,10 +863,17 @@ void VkEncDpbH265::InitializeShortTermRPSPFrame(int32_t numPocLtCurr,
         pPicInfo->flags.short_term_ref_pic_set_sps_flag = 0;
         *pShortTermRefPicSet = tmpSTRPS;
     }
+
+    RpsCacheEntry& rpsCacheEntry = m_rpsCache[m_rpsCacheNext];
+    m_rpsCacheNext = (m_rpsCacheNext + 1) % RPS_CACHE_SIZE;
+    rpsCacheEntry.key = rpsKey;
+    rpsCacheEntry.shortTermRefPicSet = tmpSTRPS;
+    rpsCacheEntry.spsShortTermRpsIdx = iSPSSTRpsIdx;
+    rpsCacheEntry.valid = true;
 }
 
 void VkEncDpbH265::ReferencePictureMarking(int32_t curPOC, StdVideoH265PictureType picType,
-                                           bool longTermRefPicsPresentFlag) {
+                                           bool longTermRefPicsPresentFlag, bool keepLatestReferenceOnly) {
     if (picType == STD_VIDEO_H265_PICTURE_TYPE_IDR) {
         for (int32_t i = 0; i < m_dpbSize; i++)
             m_stDpb[i].marking = 0;
@@ -849,6 +893,21 @@ void VkEncDpbH265::ReferencePictureMarking(int32_t curPOC, StdVideoH265PictureTy
             m_picOrderCntCRA = curPOC;
         }
 
+        if (keepLatestReferenceOnly) {
+            int32_t maxPOCSTIdx = -1;
+            for (int32_t i = 0; i < m_dpbSize; i++) {
+                if ((m_stDpb[i].state == 1) && (m_stDpb[i].marking == 1) &&
+                        ((maxPOCSTIdx < 0) || (m_stDpb[i].picOrderCntVal > m_stDpb[maxPOCSTIdx].picOrderCntVal))) {
+                    maxPOCSTIdx = i;
+                }
+            }
+            for (int32_t i = 0; i < m_dpbSize; i++) {
+                if ((i != maxPOCSTIdx) && (m_stDpb[i].marking == 1)) {
+                    m_stDpb[i].marking = 0;
+                }
+            }
+        }
+
         if (m_useMultipleRefs) {
             int32_t numLongTermRefPics = 0;
             int32_t numShortTermRefPics = 0;
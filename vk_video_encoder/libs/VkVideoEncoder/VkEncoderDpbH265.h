@@ -60,8 +60,9 @@ public:
 
     bool DpbSequenceStart(int32_t dpbSize, bool useMultipleReferences);
 
+    // With keepLatestReferenceOnly, the short-term references but the one with the highest POC are dropped first
     void ReferencePictureMarking(int32_t curPOC, StdVideoH265PictureType picType,
-                                 bool longTermRefPicsPresentFlag);
+                                 bool longTermRefPicsPresentFlag, bool keepLatestReferenceOnly = false);
     void InitializeRPS(const StdVideoH265ShortTermRefPicSet *pSpsShortTermRps,
                        uint8_t spsNumShortTermRefPicSets,
                        StdVideoEncodeH265PictureInfo *pPicInfo,
@@ -86,6 +87,32 @@ public:
     void ReferencePictureListIntializationLx(int32_t refPicListLx[2][STD_VIDEO_H265_MAX_NUM_LIST_REF], int32_t refPicListSize[2], const StdVideoEncodeH265SliceSegmentHeader *slh);
 
 private:
+    enum { RPS_CACHE_SIZE = 16 };
+
+    // What the short-term RPS of a picture depends on, zeroed before it is filled to be compared as a whole
+    struct RpsCacheKey {
+        const StdVideoH265ShortTermRefPicSet* pSpsShortTermRps;
+        uint32_t                              spsNumShortTermRefPicSets;
+        uint32_t                              picType;
+        uint32_t                              irapPicFlag;
+        uint32_t                              numRefL0;
+        uint32_t                              numRefL1;
+        int32_t                               numPocLtCurr;
+        int32_t                               numLongTermRefPic;
+        int32_t                               numNegativeRefPics;
+        int32_t                               numPositiveRefPics;
+        uint32_t                              deltaPocS0[STD_VIDEO_H265_MAX_DPB_SIZE]; // sorted, before the trim
+        uint32_t                              deltaPocS1[STD_VIDEO_H265_MAX_DPB_SIZE];
+    };
+
+    // The RPS of the pictures at the same position of the GOP is the same once the DPB is in its steady state
+    struct RpsCacheEntry {
+        RpsCacheKey                    key;
+        StdVideoH265ShortTermRefPicSet shortTermRefPicSet; // if not signaled in the SPS
+        int32_t                        spsShortTermRpsIdx; // -1 if not signaled in the SPS
+        bool                           valid;
+    };
+
     void FlushDpb();
     void DpbBumping();
     bool IsDpbEmpty();
@@ -120,6 +147,8 @@ private:
     bool                           m_refreshPending;
     uint32_t                       m_longTermFlags;
     bool                           m_useMultipleRefs;
+    RpsCacheEntry                  m_rpsCache[RPS_CACHE_SIZE]; // cleared by DpbSequenceStart()
+    uint32_t                       m_rpsCacheNext;             // the entry replaced next
 };
 
 #endif // !defined(NVENC_HEVC_DPB_H)
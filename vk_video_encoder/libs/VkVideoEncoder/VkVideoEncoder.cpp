@@ -23,6 +23,11 @@
 #include "VkVideoEncoder/VkEncoderConfigH264.h"
 #include "VkVideoEncoder/VkEncoderConfigH265.h"
 #include "VkCodecUtils/YCbCrConvUtilsCpu.h"
+#include "VkCodecUtils/VkThreadAffinity.h"
+#include "VkCodecUtils/VkTrace.h"
+#include "VkCodecUtils/VkLog.h"
+#include "VkCodecUtils/VkImageBarrierBatch.h"
+#include "VkCodecUtils/VulkanDeviceMemoryBudget.h"
 
 VkResult VkVideoEncoder::CreateVideoEncoder(const VulkanDeviceContext* vkDevCtx,
                                             VkSharedBaseObj<EncoderConfig>& encoderConfig,
@@ -32,10 +37,43 @@ VkResult VkVideoEncoder::CreateVideoEncoder(const VulkanDeviceContext* vkDevCtx,
         return CreateVideoEncoderH264(vkDevCtx, encoderConfig, encoder);
     } else if (encoderConfig->codec == VK_VIDEO_CODEC_OPERATION_ENCODE_H265_BIT_KHR) {
         return CreateVideoEncoderH265(vkDevCtx, encoderConfig, encoder);
+#ifdef VK_KHR_video_encode_av1
+    } else if (encoderConfig->codec == VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR) {
+        return CreateVideoEncoderAV1(vkDevCtx, encoderConfig, encoder);
+#endif
     }
     return VK_ERROR_VIDEO_PROFILE_CODEC_NOT_SUPPORTED_KHR;
 }
 
+VkVideoEncoder::EncoderMetrics::EncoderMetrics(const std::string& labels)
+    : framesEncoded(VkMetrics::GetCounter("vkvideo_encoder_frames_encoded_total",
+                                          "Frames encoded and written to the bitstream", labels))
+    , bitstreamBytes(VkMetrics::GetCounter("vkvideo_encoder_bitstream_bytes_total",
+                                           "Bytes of bitstream written, with the parameter sets", labels))
+    , frameLatencyUs(VkMetrics::GetHistogram("vkvideo_encoder_frame_latency_us",
+                                             "Time from the input frame ready to its bitstream, in microseconds", labels))
+    , fps(VkMetrics::GetGauge("vkvideo_encoder_fps", "Encoded frame rate over the last second", labels))
+    , encoderQueueDepth(VkMetrics::GetGauge("vkvideo_encoder_queue_depth", "Batches or frames waiting in a stage queue",
+                                            labels + ",queue=\"encoder\""))
+    , recordQueueDepth(VkMetrics::GetGauge("vkvideo_encoder_queue_depth", "Batches or frames waiting in a stage queue",
+                                           labels + ",queue=\"record\""))
+    , assembleQueueDepth(VkMetrics::GetGauge("vkvideo_encoder_queue_depth", "Batches or frames waiting in a stage queue",
+                                             labels + ",queue=\"assemble\""))
+    , inFlightFrames(VkMetrics::GetGauge("vkvideo_encoder_in_flight_frames",
+                                         "Frames submitted and not assembled yet", labels))
+    , bitstreamOverflows(VkMetrics::GetCounter("vkvideo_encoder_bitstream_overflows_total",
+                                               "Frames that overflowed their bitstream buffer", labels))
+    , bitstreamBufferAllocations(VkMetrics::GetCounter("vkvideo_encoder_bitstream_buffer_allocations_total",
+                                                       "Bitstream buffers allocated when the pool had none free", labels))
+    , bitstreamBuffersAvailable(VkMetrics::GetGauge("vkvideo_encoder_bitstream_buffers_available",
+                                                    "Bitstream buffers of the pool free for reuse", labels))
+    , fenceTimeouts(VkMetrics::GetCounter("vkvideo_encoder_fence_timeouts_total",
+                                          "Timeouts waiting for the completion of an input frame", labels))
+    , fpsStartTime()
+    , fpsStartFrame(0)
+{
+}
+
 const uint8_t* VkVideoEncoder::setPlaneOffset(const uint8_t* pFrameData, size_t bufferSize, size_t &currentReadOffset)
 {
     const uint8_t* buf = pFrameData + currentReadOffset;
@@ -43,130 +81,1164 @@ const uint8_t* VkVideoEncoder::setPlaneOffset(const uint8_t* pFrameData, size_t
     return buf;
 }
 
-// 1. Load current input frame from file
-// 2. Convert yuv image to nv12 (TODO: switch to Vulkan compute next, instead of using the CPU for that)
-// 3. Copy the nv12 input linear image to the optimal input image
-VkResult VkVideoEncoder::LoadNextFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+// 1. Load current input frame from file
+// 2. Convert yuv image to nv12, on the CPU or with Vulkan compute when m_useInputComputeConversion is set
+// 3. Copy the nv12 input linear image, or buffer with m_useInputBufferUpload, to the optimal input image
+// With the input loader, 1. and the CPU conversion run on its threads, up to inputLoadAheadFrames ahead of 3.
+VkResult VkVideoEncoder::LoadNextFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    assert(encodeFrameInfo);
+
+    VK_TRACE_ZONE_FRAME("LoadNextFrame", m_inputFrameNum);
+    encodeFrameInfo->frameInputOrderNum = m_inputFrameNum++;
+    encodeFrameInfo->inputTimeStamp = encodeFrameInfo->frameInputOrderNum;
+    encodeFrameInfo->lastFrame = !(encodeFrameInfo->frameInputOrderNum < (m_encoderConfig->numFrames - 1));
+
+    if (m_syntheticInput) {
+        // Generated on the device by the input submission, nothing is read or staged on the host
+        encodeFrameInfo->inputReadyTime = std::chrono::steady_clock::now();
+        if (encodeFrameInfo->frameInputOrderNum == 0) {
+            m_benchmarkStartTime = encodeFrameInfo->inputReadyTime;
+        }
+        return StageInputFrame(encodeFrameInfo);
+    }
+
+    EncoderInputFileHandler& inputFileHandler = m_encoderConfig->inputFileHandler;
+    if (inputFileHandler.IsStreaming()) {
+        const size_t frameSize = m_encoderConfig->input.fullImageSize;
+        const uint64_t inputFrameIndex = m_encoderConfig->startFrame + encodeFrameInfo->frameInputOrderNum;
+        if (!m_lowLatency) {
+            // Read ahead, which also finds the last frame of the stream
+            inputFileHandler.GetFramePtr(inputFrameIndex + std::max<uint32_t>(m_encoderConfig->inputReadAheadFrames, 1),
+                                         frameSize);
+        }
+        if (inputFileHandler.GetFramePtr(inputFrameIndex, frameSize) == nullptr) {
+            return VK_ERROR_OUT_OF_DATE_KHR;
+        }
+        // In low-latency mode, the frame is not held back for the next one to arrive. The end of the stream is
+        // found once the next frame is missing, which nothing is waiting for without B-frames.
+        if (!m_lowLatency && (inputFileHandler.GetFramePtr(inputFrameIndex + 1, frameSize) == nullptr)) {
+            encodeFrameInfo->lastFrame = true;
+        }
+    }
+    encodeFrameInfo->inputReadyTime = std::chrono::steady_clock::now();
+
+    // The staging resources are taken from the pools on this thread, the loader only writes to them
+    VkResult result = AcquireInputStaging(encodeFrameInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    if (m_inputConversionSelector) {
+        result = SelectInputConversionPath(encodeFrameInfo);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    if (m_inputLoaderThreadPool) {
+
+        PendingInputFrame pendingInputFrame;
+        pendingInputFrame.encodeFrameInfo = encodeFrameInfo;
+        pendingInputFrame.loadResult = m_inputLoaderThreadPool->enqueue([this, encodeFrameInfo]() mutable {
+                                                                            return ConvertInputFrame(encodeFrameInfo);
+                                                                        });
+        m_pendingInputFrames.push_back(std::move(pendingInputFrame));
+
+        return StagePendingInputFrames(encodeFrameInfo->lastFrame ? 0 : m_encoderConfig->inputLoadAheadFrames);
+    }
+
+    result = ConvertInputFrame(encodeFrameInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // On success, stage the input frame for the encoder video input
+    StageInputFrame(encodeFrameInfo);
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::EncodeImage(const VkVideoEncodeInputImage& inputImage, uint64_t pts, bool lastFrame)
+{
+    // The RGBA images are converted on the compute queue, see InitInputRgbaConversion()
+    const bool isRgbaInput = m_inputRgbaFilter && (inputImage.format == m_encoderConfig->inputRgbaFormat);
+    if ((inputImage.image == VK_NULL_HANDLE) || ((inputImage.format != m_imageInFormat) && !isRgbaInput)) {
+        fprintf(stderr, "\nEncodeImage Error: The image is not in the encoder input format.\n");
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkSharedBaseObj<VkVideoEncodeFrameInfo> encodeFrameInfo;
+    if (!GetAvailablePoolNode(encodeFrameInfo)) {
+        fprintf(stderr, "\nEncodeImage Error: No encode frame is available.\n");
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    if (inputImage.pQpDeltaMap != nullptr) {
+        encodeFrameInfo->SetQpDeltaMap(inputImage.pQpDeltaMap, inputImage.qpDeltaMapWidth, inputImage.qpDeltaMapHeight);
+    }
+
+    return LoadInputImage(encodeFrameInfo, inputImage, pts, lastFrame);
+}
+
+VkResult VkVideoEncoder::LoadDecodedFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                          VulkanDecodedFrame& decodedFrame, bool lastFrame)
+{
+    assert(encodeFrameInfo);
+
+    if (!decodedFrame.imageView ||
+            (decodedFrame.imageView->GetImageResource()->GetImageCreateInfo().format != m_imageInFormat)) {
+        fprintf(stderr, "\nLoadDecodedFrame Error: The decoded picture is not in the encoder input format.\n");
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    const VkImageCreateInfo& imageCreateInfo = decodedFrame.imageView->GetImageResource()->GetImageCreateInfo();
+    VkVideoEncodeInputImage inputImage;
+    inputImage.image = decodedFrame.imageView->GetImageResource()->GetImage();
+    inputImage.format = imageCreateInfo.format;
+    inputImage.baseArrayLayer = decodedFrame.imageLayerIndex;
+    inputImage.imageLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DST_KHR;
+    inputImage.extent = { std::min((uint32_t)decodedFrame.displayWidth, imageCreateInfo.extent.width),
+                          std::min((uint32_t)decodedFrame.displayHeight, imageCreateInfo.extent.height) };
+    if (decodedFrame.frameCompleteSemaphore != VK_NULL_HANDLE) {
+        inputImage.waitSemaphore = decodedFrame.frameCompleteSemaphore;
+    } else if (decodedFrame.frameCompleteTimelineSemaphore != VK_NULL_HANDLE) {
+        inputImage.waitSemaphore = decodedFrame.frameCompleteTimelineSemaphore;
+        inputImage.waitValue = decodedFrame.frameCompleteTimelineValue;
+    } else if (decodedFrame.frameCompleteFence != VK_NULL_HANDLE) {
+        const uint64_t fenceTimeout = 100ULL * 1000 * 1000 * 1000; // 100 seconds
+        VK_TRACE_ZONE("WaitForFences");
+        VkResult result = m_vkDevCtx->WaitForFences(*m_vkDevCtx, 1, &decodedFrame.frameCompleteFence, true, fenceTimeout);
+        if (result == VK_TIMEOUT) {
+            m_metrics.fenceTimeouts.Add();
+        }
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nLoadDecodedFrame Error: WaitForFences() result: 0x%x\n", result);
+            return result;
+        }
+    }
+    inputImage.signalSemaphore = decodedFrame.frameConsumerDoneSemaphore;
+
+    // The timestamps of the decoder are in the presentation order, the input order is kept for the references
+    VkResult result = LoadInputImage(encodeFrameInfo, inputImage, m_inputFrameNum, lastFrame);
+    if ((result == VK_SUCCESS) && (inputImage.signalSemaphore != VK_NULL_HANDLE)) {
+        // The next decode into the image waits for the copy
+        decodedFrame.hasConsummerSignalSemaphore = true;
+    }
+    return result;
+}
+
+VkResult VkVideoEncoder::LoadInputImage(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                        const VkVideoEncodeInputImage& inputImage, uint64_t timeStamp, bool lastFrame)
+{
+    assert(encodeFrameInfo);
+
+    // The staged frames of the input loader threads come first
+    if (m_inputLoaderThreadPool) {
+        StagePendingInputFrames(0);
+    }
+
+    encodeFrameInfo->frameInputOrderNum = m_inputFrameNum++;
+    encodeFrameInfo->inputTimeStamp = timeStamp;
+    encodeFrameInfo->lastFrame = lastFrame || !(encodeFrameInfo->frameInputOrderNum < (m_encoderConfig->numFrames - 1));
+    encodeFrameInfo->inputReadyTime = std::chrono::steady_clock::now();
+
+    return StageInputFrame(encodeFrameInfo, &inputImage);
+}
+
+VkResult VkVideoEncoder::StagePendingInputFrames(size_t maxPendingFrames)
+{
+    VkResult result = VK_SUCCESS;
+    while (m_pendingInputFrames.size() > maxPendingFrames) {
+
+        PendingInputFrame pendingInputFrame(std::move(m_pendingInputFrames.front()));
+        m_pendingInputFrames.pop_front();
+
+        // The frames are staged and encoded in their input order
+        VkResult loadResult = pendingInputFrame.loadResult.get();
+        if (loadResult != VK_SUCCESS) {
+            result = loadResult;
+            continue;
+        }
+
+        if (result == VK_SUCCESS) {
+            StageInputFrame(pendingInputFrame.encodeFrameInfo);
+        }
+    }
+    return result;
+}
+
+VkResult VkVideoEncoder::AcquireInputStaging(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    if (m_useInputComputeConversion || m_useInputBufferUpload) {
+
+        // Unless the selector picks the path of each frame
+        encodeFrameInfo->inputComputeConversion = m_useInputComputeConversion;
+
+        // The frames read in place from the imported input file only take their input image
+        if (m_useInputHostImport && ImportInputFrame(encodeFrameInfo)) {
+            return AcquireInputImage(encodeFrameInfo);
+        }
+
+        // Both paths go through the staging buffers when the selector picks them
+        VkBufferUsageFlags usage = 0;
+        VkDeviceSize size = 0;
+        if (m_useInputComputeConversion) {
+            usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            size = std::max(size, (VkDeviceSize)m_encoderConfig->input.fullImageSize);
+        }
+        if (m_useInputBufferUpload) {
+            usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            size = std::max(size, m_inputUploadFrameSize);
+        }
+        VkSharedBaseObj<VkBufferResource> stagingBuffer;
+        return GetInputStagingBuffer(encodeFrameInfo, usage, size, stagingBuffer);
+    }
+
+    if (encodeFrameInfo->srcStagingImageView == nullptr) {
+        bool success = m_linearInputImagePool->GetAvailableImage(encodeFrameInfo->srcStagingImageView,
+                                                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                                 GetInputImageAcquireTimeout());
+        if (!success) {
+            fprintf(stderr, "\nAcquireInputStaging Error: No staging image was released in time.\n");
+            return VK_ERROR_OUT_OF_POOL_MEMORY;
+        }
+        assert(encodeFrameInfo->srcStagingImageView != nullptr);
+    }
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::ConvertInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    if (encodeFrameInfo->inputHostImport) {
+        // Nothing to copy, the compute conversion reads the frame from the imported input file
+        return VK_SUCCESS;
+    }
+
+    // The input frames are counted from startFrame
+    const uint8_t* pInputFrameData = m_encoderConfig->inputFileHandler.GetFramePtr(m_encoderConfig->startFrame +
+                                                                                       encodeFrameInfo->frameInputOrderNum,
+                                                                                   m_encoderConfig->input.fullImageSize);
+    if (pInputFrameData == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    uint8_t* writeImagePtr = nullptr;
+    const VkSubresourceLayout* dstSubresourceLayout = nullptr;
+    if (m_useInputComputeConversion || m_useInputBufferUpload) {
+
+        const uint32_t imageIndex = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+        VkSharedBaseObj<VkBufferResource>& stagingBuffer = m_inputStagingBuffers[imageIndex];
+
+        // The host writes are made visible to the device by the queue submission
+        VkDeviceSize maxSize = 0;
+        writeImagePtr = stagingBuffer->GetDataPtr(0, maxSize);
+        assert(writeImagePtr != nullptr);
+
+        if (encodeFrameInfo->inputComputeConversion) {
+            // The frame is uploaded as is, the compute shader converts it
+            const VkDeviceSize frameSize = m_encoderConfig->input.fullImageSize;
+            assert(maxSize >= frameSize);
+            memcpy(writeImagePtr, pInputFrameData, (size_t)frameSize);
+            return VK_SUCCESS;
+        }
+
+        // The NV12 frame is written to the upload buffer and copied from there to the input image
+        assert(maxSize >= m_inputUploadFrameSize);
+        dstSubresourceLayout = m_inputUploadPlaneLayouts;
+
+    } else {
+
+        VkSharedBaseObj<VkImageResourceView> linearInputImageView;
+        encodeFrameInfo->srcStagingImageView->GetImageView(linearInputImageView);
+
+        const VkSharedBaseObj<VkImageResource>& dstImageResource = linearInputImageView->GetImageResource();
+        VkSharedBaseObj<VulkanDeviceMemoryImpl> srcImageDeviceMemory(dstImageResource->GetMemory());
+
+        // Map the image and read the image data.
+        VkDeviceSize imageOffset = dstImageResource->GetImageDeviceMemoryOffset();
+        VkDeviceSize maxSize = 0;
+        writeImagePtr = srcImageDeviceMemory->GetDataPtr(imageOffset, maxSize);
+        assert(writeImagePtr != nullptr);
+
+        dstSubresourceLayout = dstImageResource->GetSubresourceLayout();
+    }
+
+    const int numConversionBands = m_inputConversionThreadPool ? (int)m_encoderConfig->inputConversionThreads : 1;
+    if (m_encoderConfig->input.bpp > 8) {
+
+        // Load current frame from file and convert to P010/P012, the strides are in 16-bit samples
+        const uint16_t* pInputFrameData16 = (const uint16_t*)pInputFrameData;
+        uint16_t* writeImagePtr16 = (uint16_t*)writeImagePtr;
+        if (0 == YCbCrConvUtilsCpu::I010ToP010(
+                    pInputFrameData16 + m_encoderConfig->input.planeLayouts[0].offset / 2,  // src_y,
+                    (int)m_encoderConfig->input.planeLayouts[0].rowPitch / 2,               // src_stride_y,
+                    pInputFrameData16 + m_encoderConfig->input.planeLayouts[1].offset / 2,  // src_u,
+                    (int)m_encoderConfig->input.planeLayouts[1].rowPitch / 2,               // src_stride_u,
+                    pInputFrameData16 + m_encoderConfig->input.planeLayouts[2].offset / 2,  // src_v,
+                    (int)m_encoderConfig->input.planeLayouts[2].rowPitch / 2,               // src_stride_v,
+                    writeImagePtr16 + dstSubresourceLayout[0].offset / 2,                   // dst_y,
+                    (int)dstSubresourceLayout[0].rowPitch / 2,                              // dst_stride_y,
+                    writeImagePtr16 + dstSubresourceLayout[1].offset / 2,                   // dst_uv,
+                    (int)dstSubresourceLayout[1].rowPitch / 2,                              // dst_stride_uv,
+                    (int)m_encoderConfig->input.bpp,
+                    m_encoderConfig->input.width,
+                    m_encoderConfig->input.height,
+                    m_inputConversionThreadPool.get(),
+                    numConversionBands)) {
+
+            return VK_SUCCESS;
+        }
+
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Load current frame from file and convert to NV12
+    if (0 == YCbCrConvUtilsCpu::I420ToNV12(
+                pInputFrameData + m_encoderConfig->input.planeLayouts[0].offset,      // src_y,
+                (int)m_encoderConfig->input.planeLayouts[0].rowPitch,                 // src_stride_y,
+                pInputFrameData + m_encoderConfig->input.planeLayouts[1].offset,      // src_u,
+                (int)m_encoderConfig->input.planeLayouts[1].rowPitch,                 // src_stride_u,
+                pInputFrameData + m_encoderConfig->input.planeLayouts[2].offset, // src_v,
+                (int)m_encoderConfig->input.planeLayouts[2].rowPitch,                 // src_stride_v,
+                writeImagePtr + dstSubresourceLayout[0].offset,                       // dst_y,
+                (int)dstSubresourceLayout[0].rowPitch,                                // dst_stride_y,
+                writeImagePtr + dstSubresourceLayout[1].offset,                       // dst_uv,
+                (int)dstSubresourceLayout[1].rowPitch,                                // dst_stride_uv,
+                m_encoderConfig->input.width,
+                m_encoderConfig->input.height,
+                m_inputConversionThreadPool.get(),
+                numConversionBands)) {
+
+        return VK_SUCCESS;
+    }
+
+    return VK_ERROR_INITIALIZATION_FAILED;
+}
+
+std::chrono::nanoseconds VkVideoEncoder::GetInputImageAcquireTimeout() const
+{
+    // The images in flight are released by the consumer or the stage threads, the input is throttled by them
+    const bool hasReleaseThread = m_encoderQueueConsumerThread.joinable() || m_recordStageThread.joinable() ||
+                                  m_assembleStageThread.joinable();
+    return hasReleaseThread ? std::chrono::nanoseconds(std::chrono::seconds(5)) : std::chrono::nanoseconds(0);
+}
+
+VkResult VkVideoEncoder::AcquireInputImage(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    if (encodeFrameInfo->srcEncodeImageResource == nullptr) {
+        bool success = m_inputImagePool->GetAvailableImage(encodeFrameInfo->srcEncodeImageResource,
+                                                           VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR,
+                                                           GetInputImageAcquireTimeout());
+        if (!success) {
+            fprintf(stderr, "\nAcquireInputImage Error: No input image was released in time.\n");
+            return VK_ERROR_OUT_OF_POOL_MEMORY;
+        }
+        assert(encodeFrameInfo->srcEncodeImageResource != nullptr);
+    }
+    return VK_SUCCESS;
+}
+
+bool VkVideoEncoder::ImportInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    EncoderInputFileHandler& inputFileHandler = m_encoderConfig->inputFileHandler;
+    const size_t frameSize = m_encoderConfig->input.fullImageSize;
+    const uint64_t inputFrameIndex = m_encoderConfig->startFrame + encodeFrameInfo->frameInputOrderNum;
+    const uint8_t* pInputFrameData = inputFileHandler.GetFramePtr(inputFrameIndex, frameSize);
+    if (pInputFrameData == nullptr) {
+        return false;
+    }
+
+    // The frames are loaded in order, the window of the previous one is released with its last frame
+    if (!m_inputHostImport || !m_inputHostImport->Contains(pInputFrameData, frameSize)) {
+
+        m_inputHostImport = nullptr;
+
+        size_t mappedLength = 0;
+        const uint8_t* pMappedData = inputFileHandler.GetMappedData(mappedLength);
+        const size_t windowOffset = (size_t)(inputFrameIndex / m_inputHostImportWindowFrames) *
+                                        m_inputHostImportWindowFrames * frameSize;
+        assert((pMappedData != nullptr) && (windowOffset < mappedLength));
+        const size_t windowSize = std::min<size_t>((size_t)m_inputHostImportWindowFrames * frameSize,
+                                                   mappedLength - windowOffset);
+
+        VkResult result = VulkanHostMappedMemory::Create(m_vkDevCtx, m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                                         pMappedData + windowOffset, windowSize,
+                                                         m_inputHostImport, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nImportInputFrame Warning: The input file can't be imported (%d), "
+                            "the frames are copied to the staging buffers.\n", result);
+            m_inputHostImport = nullptr;
+            m_useInputHostImport = false;
+            return false;
+        }
+    }
+
+    encodeFrameInfo->inputHostImport = m_inputHostImport;
+    encodeFrameInfo->inputHostImportOffset = m_inputHostImport->GetBufferOffset(pInputFrameData);
+    m_numInputHostImportFrames++;
+    return true;
+}
+
+VkResult VkVideoEncoder::GetInputStagingBuffer(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                               VkBufferUsageFlags usage, VkDeviceSize size,
+                                               VkSharedBaseObj<VkBufferResource>& stagingBuffer)
+{
+    // The staging buffer is indexed by the input image, it is reused only after that image's previous encode.
+    VkResult result = AcquireInputImage(encodeFrameInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    const uint32_t imageIndex = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+    assert(imageIndex < m_inputStagingBuffers.size());
+
+    if (!m_inputStagingBuffers[imageIndex]) {
+        result = VkBufferResource::Create(m_vkDevCtx,
+                                          usage,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          size,
+                                          m_inputStagingBuffers[imageIndex]);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nGetInputStagingBuffer Error: Failed to create the input staging buffer.\n");
+            return result;
+        }
+
+        // Created here, but filled by the loader threads, on their NUMA node when the OS can move the pages
+        if (m_inputStagingNumaNode >= 0) {
+            VkDeviceSize maxSize = 0;
+            uint8_t* pStagingData = m_inputStagingBuffers[imageIndex]->GetDataPtr(0, maxSize);
+            VkBindMemoryToNumaNode(pStagingData, (size_t)maxSize, m_inputStagingNumaNode);
+        }
+    }
+
+    stagingBuffer = m_inputStagingBuffers[imageIndex];
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::SelectInputConversionPath(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    // The frames in flight from their staging to the end of their encode
+    const double queueOccupancy = (double)m_inputImagePool->GetNumImagesInUse();
+
+    if (m_inputConversionSelector->NeedsCalibration()) {
+        // Timed again at the next frame when all the command buffers are in flight
+        VkSharedBaseObj<VulkanCommandBufferPool::PoolNode> cmdBuffer;
+        if (m_inputCommandBufferPool->GetAvailablePoolNode(cmdBuffer)) {
+            const bool calibrated = m_inputConversionSelector->Calibrate([&](VkConversionPathSelector::Path path) {
+                return RunInputConversion(encodeFrameInfo, (path == VkConversionPathSelector::PATH_GPU), cmdBuffer);
+            }, queueOccupancy);
+            if (!calibrated) {
+                fprintf(stderr, "\nSelectInputConversionPath Error: The input frame can't be converted.\n");
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+        }
+    }
+
+    encodeFrameInfo->inputComputeConversion = (m_inputConversionSelector->GetPath() == VkConversionPathSelector::PATH_GPU);
+    m_inputConversionSelector->OnFrame(queueOccupancy);
+    return VK_SUCCESS;
+}
+
+bool VkVideoEncoder::RunInputConversion(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, bool computeConversion,
+                                        VkSharedBaseObj<VulkanCommandBufferPool::PoolNode>& cmdBuffer)
+{
+    encodeFrameInfo->inputComputeConversion = computeConversion;
+    if (ConvertInputFrame(encodeFrameInfo) != VK_SUCCESS) {
+        return false;
+    }
+
+    cmdBuffer->ResetCommandBuffer(true);
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkCommandBuffer cmdBuf = cmdBuffer->BeginCommandBufferRecording(beginInfo);
+    RecordInputUpload(cmdBuf, encodeFrameInfo, nullptr);
+    if (cmdBuffer->EndCommandBufferRecording(cmdBuf) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = cmdBuffer->GetCommandBuffer();
+    const VulkanDeviceContext::QueueFamilySubmitType submitType = GetInputSubmitType();
+    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(submitType,
+                                                           (submitType == VulkanDeviceContext::ENCODE) ? m_encodeQueueIndex : 0,
+                                                           1, &submitInfo, cmdBuffer->GetFence());
+    if (result != VK_SUCCESS) {
+        cmdBuffer->ResetCommandBuffer(false);
+        return false;
+    }
+    cmdBuffer->SetCommandBufferSubmitted();
+    return (cmdBuffer->SyncHostOnCmdBuffComplete() == VK_SUCCESS);
+}
+
+void VkVideoEncoder::RecordInputComputeConversion(VkCommandBuffer cmdBuf,
+                                                  VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+    encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+    VkImageMemoryBarrier2KHR imageBarrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_NONE_KHR, // VkPipelineStageFlags2KHR srcStageMask
+            0, // VkAccessFlags2KHR        srcAccessMask
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR, // VkAccessFlags   dstAccessMask
+            VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout   oldLayout, the whole frame is overwritten
+            VK_IMAGE_LAYOUT_GENERAL, // VkImageLayout   newLayout
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+            srcEncodeImageView->GetImageResource()->GetImage(), // VkImage         image;
+            {
+                // VkImageSubresourceRange   subresourceRange
+                VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                0, // uint32_t           baseMipLevel
+                1, // uint32_t           levelCount
+                0, // uint32_t           baseArrayLayer
+                1, // uint32_t           layerCount;
+            },
+    };
+
+    const VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &imageBarrier,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    const VkExtent2D inputExtent { m_encoderConfig->input.width, m_encoderConfig->input.height };
+    VulkanFilterYuvCompute* pInputComputeFilter = static_cast<VulkanFilterYuvCompute*>(m_inputComputeFilter.Get());
+    if (encodeFrameInfo->inputHostImport) {
+
+        // The planes of the frame are read at its offset in the imported window of the input file
+        VkSubresourceLayout inputPlaneLayouts[3];
+        for (uint32_t plane = 0; plane < 3; plane++) {
+            inputPlaneLayouts[plane] = m_encoderConfig->input.planeLayouts[plane];
+            inputPlaneLayouts[plane].offset += encodeFrameInfo->inputHostImportOffset;
+        }
+        pInputComputeFilter->RecordCommandBuffer(cmdBuf,
+                                                 encodeFrameInfo->inputHostImport->GetBuffer(),
+                                                 inputPlaneLayouts,
+                                                 inputExtent,
+                                                 srcEncodeImageView,
+                                                 encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo());
+    } else {
+
+        const uint32_t imageIndex = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+        pInputComputeFilter->RecordCommandBuffer(cmdBuf,
+                                                 m_inputStagingBuffers[imageIndex],
+                                                 m_encoderConfig->input.planeLayouts,
+                                                 inputExtent,
+                                                 srcEncodeImageView,
+                                                 encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo());
+    }
+
+    // The encode submission waits on the input semaphore, which makes the shader writes available
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+}
+
+void VkVideoEncoder::RecordInputUpload(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                       const VkVideoEncodeInputImage* pInputImage)
+{
+    if (pInputImage != nullptr) {
+
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+        if (pInputImage->format != m_imageInFormat) {
+            ConvertInputImageToOptimalImage(cmdBuf, *pInputImage, encodeFrameInfo);
+        } else {
+            CopyInputImageToOptimalImage(cmdBuf, *pInputImage, srcEncodeImageView,
+                                         encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo()->baseArrayLayer);
+        }
+
+    } else if (m_syntheticInput) {
+
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+        const uint32_t baseArrayLayer = encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo()->baseArrayLayer;
+        m_syntheticInput->RecordCommandBuffer(cmdBuf, srcEncodeImageView, baseArrayLayer,
+                                              encodeFrameInfo->frameInputOrderNum);
+
+    } else if (encodeFrameInfo->inputComputeConversion) {
+
+        RecordInputComputeConversion(cmdBuf, encodeFrameInfo);
+
+    } else if (m_useInputBufferUpload) {
+
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+        const uint32_t imageIndex = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+        CopyBufferToOptimalImage(cmdBuf, m_inputStagingBuffers[imageIndex], m_inputUploadPlaneLayouts, srcEncodeImageView);
+
+    } else {
+
+        VkSharedBaseObj<VkImageResourceView> linearInputImageView;
+        encodeFrameInfo->srcStagingImageView->GetImageView(linearInputImageView);
+
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+        CopyLinearToOptimalImage(cmdBuf, linearInputImageView, srcEncodeImageView);
+    }
+}
+
+const VkCommandBuffer* VkVideoEncoder::GetPreRecordedInputCmdBuffer(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                                                    const VkVideoEncodeInputImage* pInputImage)
+{
+    // The frames copied from the input images of the application, scaled for the attached encoders,
+    // or read from the imported input file at their own offsets, are recorded each time
+    if (m_preRecordedInputCmdBuffersValid.empty() || (pInputImage != nullptr) || !m_simulcastEncoders.empty() ||
+            !m_splitFrameEncoders.empty() || encodeFrameInfo->inputHostImport) {
+        return nullptr;
+    }
+
+    const uint32_t imageIndex = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+    const uint32_t stagingIndex = (encodeFrameInfo->srcStagingImageView != nullptr) ?
+                                      (uint32_t)encodeFrameInfo->srcStagingImageView->GetImageIndex() : 0;
+    assert(stagingIndex < m_numPreRecordedStagingSlots);
+    const uint32_t cmdBufIndex = (imageIndex * m_numPreRecordedStagingSlots) + stagingIndex;
+    const VkCommandBuffer* pCmdBuf = m_preRecordedInputCmdBuffers.GetCommandBuffer(cmdBufIndex);
+    if (pCmdBuf == nullptr) {
+        return nullptr;
+    }
+
+    if (!m_preRecordedInputCmdBuffersValid[cmdBufIndex]) {
+        // Resubmitted for the next frames of the pair of images, possibly while the previous submission is pending
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        VkResult result = m_vkDevCtx->BeginCommandBuffer(*pCmdBuf, &beginInfo);
+        if (result != VK_SUCCESS) {
+            return nullptr;
+        }
+        RecordInputUpload(*pCmdBuf, encodeFrameInfo, nullptr);
+        result = m_vkDevCtx->EndCommandBuffer(*pCmdBuf);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nERROR: EndCommandBuffer() result: 0x%x\n", result);
+            return nullptr;
+        }
+        m_preRecordedInputCmdBuffersValid[cmdBufIndex] = true;
+    }
+    return pCmdBuf;
+}
+
+VkResult VkVideoEncoder::StageInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                         const VkVideoEncodeInputImage* pInputImage)
+{
+    assert(encodeFrameInfo);
+
+    const std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+
+    VkResult acquireResult = AcquireInputImage(encodeFrameInfo);
+    if (acquireResult != VK_SUCCESS) {
+        return acquireResult;
+    }
+
+    m_inputCommandBufferPool->GetAvailablePoolNode(encodeFrameInfo->inputCmdBuffer);
+    assert(encodeFrameInfo->inputCmdBuffer != nullptr);
+
+    // Make sure command buffer is not in use anymore and reset
+    encodeFrameInfo->inputCmdBuffer->ResetCommandBuffer();
+
+    // The same upload of the staged frame is resubmitted, the node of the pool only synchronizes it
+    const VkCommandBuffer* pPreRecordedCmdBuf = GetPreRecordedInputCmdBuffer(encodeFrameInfo, pInputImage);
+    if (pPreRecordedCmdBuf != nullptr) {
+        VkResult result = SubmitStagedInputFrame(encodeFrameInfo, pInputImage, pPreRecordedCmdBuf);
+        AddBenchmarkStageTime(BENCHMARK_STAGE_INPUT, stageStart);
+        EncodeFrame(encodeFrameInfo);
+        return result;
+    }
+
+    // The encoders of the other bands get them from the same submission. Without all of them, this frame
+    // couldn't be stitched.
+    assert(m_splitFrameFrames.empty());
+    for (VkSharedBaseObj<VkVideoEncoder>& splitFrameEncoder : m_splitFrameEncoders) {
+        VkSharedBaseObj<VkVideoEncodeFrameInfo> bandFrame;
+        VkResult result = splitFrameEncoder->AcquireSimulcastFrame(encodeFrameInfo, bandFrame);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nStageInputFrame Error: Failed to acquire the band %u of the frame (%d).\n",
+                    (uint32_t)m_splitFrameFrames.size() + 1, result);
+            m_splitFrameFrames.clear();
+            return result;
+        }
+        m_splitFrameFrames.push_back(bandFrame.Detach());
+    }
+
+    // Begin command buffer
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkCommandBuffer cmdBuf = encodeFrameInfo->inputCmdBuffer->BeginCommandBufferRecording(beginInfo);
+
+    RecordInputUpload(cmdBuf, encodeFrameInfo, pInputImage);
+
+    // The copy from the linear image leaves the input image in the transfer layout
+    const VkImageLayout imageLayout = ((pInputImage != nullptr) || m_syntheticInput || m_useInputComputeConversion ||
+                                       m_useInputBufferUpload) ?
+                                          VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+    // The denoised input is analyzed, scaled for the simulcast rungs, split into the bands and encoded
+    if (m_temporalFilter) {
+
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+        const uint32_t baseArrayLayer = encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo()->baseArrayLayer;
+        m_temporalFilter->RecordCommandBuffer(cmdBuf, srcEncodeImageView, baseArrayLayer, imageLayout);
+    }
+
+    if (m_preAnalysis) {
+
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+        m_preAnalysis->RecordCommandBuffer(cmdBuf,
+                                           (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex(),
+                                           srcEncodeImageView,
+                                           encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo()->baseArrayLayer,
+                                           imageLayout);
+    }
+
+    if (!m_simulcastEncoders.empty()) {
+        // The attached encoders get their scaled copies of the input image from the same submission
+        assert(m_simulcastFrames.empty());
+        for (VkSharedBaseObj<VkVideoEncoder>& simulcastEncoder : m_simulcastEncoders) {
+            VkSharedBaseObj<VkVideoEncodeFrameInfo> simulcastFrame;
+            if (simulcastEncoder->AcquireSimulcastFrame(encodeFrameInfo, simulcastFrame) != VK_SUCCESS) {
+                break;
+            }
+            m_simulcastFrames.push_back(simulcastFrame.Detach());
+        }
+        if (m_simulcastFrames.size() == m_simulcastEncoders.size()) {
+            RecordSimulcastScaling(cmdBuf, encodeFrameInfo, imageLayout);
+        } else {
+            m_simulcastFrames.clear();
+        }
+    }
+
+    if (!m_splitFrameFrames.empty()) {
+        RecordSplitFrameBandCopies(cmdBuf, encodeFrameInfo, imageLayout);
+    }
+
+    VkResult result = encodeFrameInfo->inputCmdBuffer->EndCommandBufferRecording(cmdBuf);
+
+    // Now submit the staged input to the queue
+    VkResult submitResult = SubmitStagedInputFrame(encodeFrameInfo, pInputImage);
+    if (result == VK_SUCCESS) {
+        result = submitResult;
+    }
+    AddBenchmarkStageTime(BENCHMARK_STAGE_INPUT, stageStart);
+
+    // Submitted after the semaphores they wait on are signaled
+    for (size_t i = 0; i < m_simulcastFrames.size(); i++) {
+        m_simulcastEncoders[i]->EncodeFrame(m_simulcastFrames[i]);
+    }
+    m_simulcastFrames.clear();
+    for (size_t i = 0; i < m_splitFrameFrames.size(); i++) {
+        m_splitFrameEncoders[i]->EncodeFrame(m_splitFrameFrames[i]);
+    }
+    m_splitFrameFrames.clear();
+
+    if (m_preAnalysis) {
+        // The frame is held back until the frames following it are analyzed
+        m_lookAheadFrames.push_back(encodeFrameInfo);
+        EncodeLookAheadFrames(encodeFrameInfo->lastFrame ? 0 : m_encoderConfig->lookAheadFrames);
+        return result;
+    }
+
+    // and encode the input frame with the encoder next
+    EncodeFrame(encodeFrameInfo);
+
+    return result;
+}
+
+// The QP range of the 8-bit H.264 and H.265 profiles
+static uint32_t OffsetQp(uint32_t qp, int32_t qpDelta)
+{
+    const int32_t maxQp = 51;
+    return (uint32_t)std::min(std::max((int32_t)qp + qpDelta, 0), maxQp);
+}
+
+int32_t VkVideoEncoder::GetSliceConstantQp(const VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                           int32_t constantQp, uint32_t sliceIndex, uint32_t sliceCount) const
+{
+    const std::vector<int8_t>& qpDeltaMap = encodeFrameInfo->qpDeltaMap;
+    if (!m_encoderConfig->perSliceConstantQp || qpDeltaMap.empty() || (sliceCount == 0)) {
+        return constantQp;
+    }
+
+    // The device splits the picture in slices of whole rows, as evenly as it can
+    const uint32_t picHeightInSliceRows = std::max<uint32_t>(m_encoderConfig->GetPicHeightInSliceRows(), 1);
+    const uint32_t firstSliceRow = (sliceIndex * picHeightInSliceRows) / sliceCount;
+    const uint32_t endSliceRow = ((sliceIndex + 1) * picHeightInSliceRows) / sliceCount;
+    const uint32_t firstMapRow = std::min((firstSliceRow * encodeFrameInfo->qpDeltaMapHeight) / picHeightInSliceRows,
+                                          encodeFrameInfo->qpDeltaMapHeight - 1);
+    const uint32_t endMapRow = std::max((endSliceRow * encodeFrameInfo->qpDeltaMapHeight) / picHeightInSliceRows,
+                                        firstMapRow + 1);
+
+    int32_t qpDeltaSum = 0;
+    const size_t firstDelta = (size_t)firstMapRow * encodeFrameInfo->qpDeltaMapWidth;
+    const size_t endDelta = (size_t)endMapRow * encodeFrameInfo->qpDeltaMapWidth;
+    for (size_t i = firstDelta; i < endDelta; i++) {
+        qpDeltaSum += qpDeltaMap[i];
+    }
+    const int32_t numDeltas = (int32_t)(endDelta - firstDelta);
+    const int32_t qpDelta = (qpDeltaSum + ((qpDeltaSum >= 0) ? (numDeltas / 2) : -(numDeltas / 2))) / numDeltas;
+    return (int32_t)OffsetQp((uint32_t)constantQp, qpDelta);
+}
+
+VkResult VkVideoEncoder::ChangeRateControl(const RateControlChange& rateControlChange)
+{
+    std::lock_guard<std::mutex> lock(m_rateControlChangesMutex);
+
+    // The changes for the same frame are applied in the order they were made
+    std::vector<RateControlChange>::iterator it =
+        std::upper_bound(m_rateControlChanges.begin(), m_rateControlChanges.end(), rateControlChange,
+                         [](const RateControlChange& a, const RateControlChange& b) { return a.frameNum < b.frameNum; });
+    m_rateControlChanges.insert(it, rateControlChange);
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::InvalidateReferenceFrames(uint64_t timeStamp)
+{
+    std::lock_guard<std::mutex> lock(m_referenceInvalidationsMutex);
+    m_referenceInvalidations.push_back(timeStamp);
+    return VK_SUCCESS;
+}
+
+bool VkVideoEncoder::GetReferenceInvalidation(uint64_t frameTimeStamp, uint64_t& timeStamp)
 {
-    assert(encodeFrameInfo);
-
-    encodeFrameInfo->frameInputOrderNum = m_inputFrameNum++;
-    encodeFrameInfo->lastFrame = !(encodeFrameInfo->frameInputOrderNum < (m_encoderConfig->numFrames - 1));
-
-    if (encodeFrameInfo->srcStagingImageView == nullptr) {
-        bool success = m_linearInputImagePool->GetAvailableImage(encodeFrameInfo->srcStagingImageView,
-                                                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-        assert(success);
-        assert(encodeFrameInfo->srcStagingImageView != nullptr);
+    std::lock_guard<std::mutex> lock(m_referenceInvalidationsMutex);
+
+    // The lost frame must be in the DPB, or gone from it
+    std::vector<uint64_t>::iterator it =
+        std::find_if(m_referenceInvalidations.begin(), m_referenceInvalidations.end(),
+                     [frameTimeStamp](uint64_t invalidTimeStamp) { return invalidTimeStamp < frameTimeStamp; });
+    if (it == m_referenceInvalidations.end()) {
+        return false;
     }
+    timeStamp = *it;
+    m_referenceInvalidations.erase(it);
+    return true;
+}
 
-    VkSharedBaseObj<VkImageResourceView> linearInputImageView;
-    encodeFrameInfo->srcStagingImageView->GetImageView(linearInputImageView);
-
-    const VkSharedBaseObj<VkImageResource>& dstImageResource = linearInputImageView->GetImageResource();
-    VkSharedBaseObj<VulkanDeviceMemoryImpl> srcImageDeviceMemory(dstImageResource->GetMemory());
-
-    // Map the image and read the image data.
-    VkDeviceSize imageOffset = dstImageResource->GetImageDeviceMemoryOffset();
-    VkDeviceSize maxSize = 0;
-    uint8_t* writeImagePtr = srcImageDeviceMemory->GetDataPtr(imageOffset, maxSize);
-    assert(writeImagePtr != nullptr);
+void VkVideoEncoder::UpdateFrameRateControl(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    std::unique_lock<std::mutex> lock(m_rateControlChangesMutex);
+
+    size_t numChanges = 0;
+    for (; (numChanges < m_rateControlChanges.size()) &&
+               (m_rateControlChanges[numChanges].frameNum <= encodeFrameInfo->frameInputOrderNum); numChanges++) {
+
+        const RateControlChange& rateControlChange = m_rateControlChanges[numChanges];
+        if (rateControlChange.averageBitrate > 0) {
+            if ((rateControlChange.maxBitrate == 0) && (m_encoderConfig->averageBitrate > 0)) {
+                // Keep the ratio of the peak to the average bitrate
+                m_encoderConfig->hrdBitrate = (uint32_t)std::min<uint64_t>((uint64_t)m_encoderConfig->hrdBitrate *
+                                                                               rateControlChange.averageBitrate /
+                                                                               m_encoderConfig->averageBitrate,
+                                                                           UINT32_MAX);
+            }
+            m_encoderConfig->averageBitrate = rateControlChange.averageBitrate;
+        }
+        if (rateControlChange.maxBitrate > 0) {
+            m_encoderConfig->hrdBitrate = rateControlChange.maxBitrate;
+        }
+        m_encoderConfig->averageBitrate = std::min(m_encoderConfig->averageBitrate, m_encoderConfig->hrdBitrate);
+        if (m_rateControlInfo.rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_CBR_BIT_KHR) {
+            m_encoderConfig->hrdBitrate = m_encoderConfig->averageBitrate;
+        }
 
-    size_t fileOffset = ((uint64_t)m_encoderConfig->input.fullImageSize * encodeFrameInfo->frameInputOrderNum);
-    const uint8_t* pInputFrameData = m_encoderConfig->inputFileHandler.GetMappedPtr(fileOffset);
+        if ((rateControlChange.frameRateNumerator > 0) && (rateControlChange.frameRateDenominator > 0)) {
+            m_encoderConfig->frameRateNumerator = rateControlChange.frameRateNumerator;
+            m_encoderConfig->frameRateDenominator = rateControlChange.frameRateDenominator;
+        }
 
-    const VkSubresourceLayout* dstSubresourceLayout = dstImageResource->GetSubresourceLayout();
+        if (rateControlChange.minQp >= 0) {
+            m_encoderConfig->minQp = m_rateControlMinQp = rateControlChange.minQp;
+        }
+        if (rateControlChange.maxQp >= 0) {
+            m_encoderConfig->maxQp = m_rateControlMaxQp = rateControlChange.maxQp;
+        }
 
-    // Load current frame from file and convert to NV12
-    if (0 == YCbCrConvUtilsCpu::I420ToNV12(
-                pInputFrameData + m_encoderConfig->input.planeLayouts[0].offset,      // src_y,
-                (int)m_encoderConfig->input.planeLayouts[0].rowPitch,                 // src_stride_y,
-                pInputFrameData + m_encoderConfig->input.planeLayouts[1].offset,      // src_u,
-                (int)m_encoderConfig->input.planeLayouts[1].rowPitch,                 // src_stride_u,
-                pInputFrameData + m_encoderConfig->input.planeLayouts[2].offset, // src_v,
-                (int)m_encoderConfig->input.planeLayouts[2].rowPitch,                 // src_stride_v,
-                writeImagePtr + dstSubresourceLayout[0].offset,                       // dst_y,
-                (int)dstSubresourceLayout[0].rowPitch,                                // dst_stride_y,
-                writeImagePtr + dstSubresourceLayout[1].offset,                       // dst_uv,
-                (int)dstSubresourceLayout[1].rowPitch,                                // dst_stride_uv,
-                m_encoderConfig->input.width,
-                m_encoderConfig->input.height)) {
+        if (m_verbose) {
+            std::cout << "Rate control change at frame " << encodeFrameInfo->frameInputOrderNum
+                      << ": average bitrate " << m_encoderConfig->averageBitrate
+                      << ", max bitrate " << m_encoderConfig->hrdBitrate
+                      << ", QP range " << m_rateControlMinQp << " to " << m_rateControlMaxQp << std::endl;
+        }
+    }
 
+    if (numChanges > 0) {
+        m_rateControlChanges.erase(m_rateControlChanges.begin(), m_rateControlChanges.begin() + numChanges);
+        lock.unlock();
 
-        // On success, stage the input frame for the encoder video input
-        StageInputFrame(encodeFrameInfo);
-        return VK_SUCCESS;
+        // Sent with the control command of this frame, the session state and the references are kept
+        UpdateRateControlParameters(m_rateControlMinQp, m_rateControlMaxQp);
+        m_sendControlCmd = true;
+        m_sendRateControlCmd = true;
+    } else {
+        lock.unlock();
     }
 
-    return VK_ERROR_INITIALIZATION_FAILED;
+    // The constant QP of the rate control disabled mode, adapted by the look-ahead
+    const uint32_t constQp = (uint32_t)std::max(m_encoderConfig->minQp, 0);
+    encodeFrameInfo->constQp.qpIntra  = OffsetQp(constQp, encodeFrameInfo->lookAheadQpDeltas.intra);
+    encodeFrameInfo->constQp.qpInterP = OffsetQp(constQp, encodeFrameInfo->lookAheadQpDeltas.interP);
+    encodeFrameInfo->constQp.qpInterB = OffsetQp(constQp, encodeFrameInfo->lookAheadQpDeltas.interB);
+
+    // The second pass offsets the QP the first pass coded the frame with
+    if (encodeFrameInfo->frameInputOrderNum < m_twoPassQpDeltas.size()) {
+        const int32_t qpDelta = m_twoPassQpDeltas[(size_t)encodeFrameInfo->frameInputOrderNum];
+        encodeFrameInfo->constQp.qpIntra  = OffsetQp(encodeFrameInfo->constQp.qpIntra, qpDelta);
+        encodeFrameInfo->constQp.qpInterP = OffsetQp(encodeFrameInfo->constQp.qpInterP, qpDelta);
+        encodeFrameInfo->constQp.qpInterB = OffsetQp(encodeFrameInfo->constQp.qpInterB, qpDelta);
+    }
 }
 
-VkResult VkVideoEncoder::StageInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+uint8_t VkVideoEncoder::GetPositionInGop(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                         uint8_t& positionInGopInDisplayOrder)
 {
-    assert(encodeFrameInfo);
+    VkVideoGopStructure& gopStructure = m_encoderConfig->gopStructure;
+
+    // A scene cut restarts the GOP, the frames deferred before it are flushed ahead of the IDR frame.
+    // So does a reference invalidation that left nothing to recover from.
+    const bool forceIdr = (encodeFrameInfo->frameEncodeOrderNum == 0) || encodeFrameInfo->sceneCut ||
+                          m_forceIdrFrame.exchange(false);
+    const uint8_t positionInGop = gopStructure.GetPositionInGOP(positionInGopInDisplayOrder,
+                                                                encodeFrameInfo->pictureType,
+                                                                forceIdr,
+                                                                encodeFrameInfo->lastFrame);
+    m_framesSinceIdr = (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) ? 0 : (m_framesSinceIdr + 1);
+
+    if (m_adaptiveGop && (encodeFrameInfo->adaptiveBFrameCount >= 0) &&
+            (encodeFrameInfo->pictureType >= VkVideoGopStructure::FRAME_TYPE_I)) {
+        // The frames before the intra frame already have their decode order positions
+        if (m_verbose && (encodeFrameInfo->adaptiveBFrameCount != gopStructure.GetAdaptiveBFrameCount())) {
+            std::cout << "Adaptive GOP: " << (uint32_t)encodeFrameInfo->adaptiveBFrameCount
+                      << " consecutive B frames from frame " << encodeFrameInfo->frameInputOrderNum << std::endl;
+        }
+        gopStructure.SetAdaptiveBFrameCount(encodeFrameInfo->adaptiveBFrameCount);
+    }
 
-    if (encodeFrameInfo->srcEncodeImageResource == nullptr) {
-        bool success = m_inputImagePool->GetAvailableImage(encodeFrameInfo->srcEncodeImageResource,
-                                                                 VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR);
-        assert(success);
-        assert(encodeFrameInfo->srcEncodeImageResource != nullptr);
+    if ((m_encoderConfig->autoQualityLevelFps > 0.0) &&
+            (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) &&
+            (encodeFrameInfo->frameEncodeOrderNum > 0)) {
+        UpdateAutoQualityLevel(encodeFrameInfo);
     }
 
-    m_inputCommandBufferPool->GetAvailablePoolNode(encodeFrameInfo->inputCmdBuffer);
-    assert(encodeFrameInfo->inputCmdBuffer != nullptr);
+    if (gopStructure.GetPyramid() && (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_B)) {
+        // The deeper the B-frame in the pyramid, the fewer frames predict from it
+        const uint8_t pyramidLevel = gopStructure.GetPyramidLevel(positionInGop);
+        if (pyramidLevel > 1) {
+            encodeFrameInfo->constQp.qpInterB = OffsetQp(encodeFrameInfo->constQp.qpInterB,
+                                                         (pyramidLevel - 1) * m_encoderConfig->pyramidQpOffset);
+        }
+    }
 
-    // Make sure command buffer is not in use anymore and reset
-    encodeFrameInfo->inputCmdBuffer->ResetCommandBuffer();
+    return positionInGop;
+}
 
-    // Begin command buffer
-    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr };
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    VkCommandBuffer cmdBuf = encodeFrameInfo->inputCmdBuffer->BeginCommandBufferRecording(beginInfo);
+VkResult VkVideoEncoder::UpdateAutoQualityLevel(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    if (!m_gpuTimestamps) {
+        return VK_SUCCESS;
+    }
+
+    // The frames still in flight are counted with the next IDR period
+    size_t numSamples = 0;
+    const double totalGpuTimeMs = m_gpuTimestamps->GetTotalGpuTimeMs(&numSamples);
+    if (numSamples <= m_autoQualityNumSamples) {
+        return VK_SUCCESS;
+    }
+    const double frameGpuTimeMs = (totalGpuTimeMs - m_autoQualityGpuTimeMs) / (numSamples - m_autoQualityNumSamples);
+    m_autoQualityGpuTimeMs = totalGpuTimeMs;
+    m_autoQualityNumSamples = numSamples;
+
+    // The higher quality levels trade the throughput for the quality. Some headroom is kept for the load of the
+    // other streams, and a level once found too slow isn't tried again, not to swing between two levels.
+    const double frameBudgetMs = 1000.0 / m_encoderConfig->autoQualityLevelFps;
+    const uint32_t maxQualityLevels = std::min(m_autoQualityLevelLimit,
+                                               m_encoderConfig->videoEncodeCapabilities.maxQualityLevels);
+    uint32_t qualityLevel = m_encoderConfig->qualityLevel;
+    if ((frameGpuTimeMs > (0.9 * frameBudgetMs)) && (qualityLevel > 0)) {
+        m_autoQualityLevelLimit = qualityLevel;
+        qualityLevel--;
+    } else if ((frameGpuTimeMs < (0.6 * frameBudgetMs)) && ((qualityLevel + 1) < maxQualityLevels)) {
+        qualityLevel++;
+    }
+    if (qualityLevel == m_encoderConfig->qualityLevel) {
+        return VK_SUCCESS;
+    }
 
-    VkSharedBaseObj<VkImageResourceView> linearInputImageView;
-    encodeFrameInfo->srcStagingImageView->GetImageView(linearInputImageView);
+    // The parameter sets written ahead of this IDR frame are encoded again from the new session parameters
+    VkResult result = CreateVideoSessionParameters(qualityLevel);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nUpdateAutoQualityLevel Error: Failed to create the session parameters (%d).\n", result);
+        return result;
+    }
+    if (m_verbose) {
+        std::cout << "Quality level " << qualityLevel << " from frame " << encodeFrameInfo->frameInputOrderNum
+                  << ", at " << frameGpuTimeMs << " ms per frame of " << frameBudgetMs << " ms" << std::endl;
+    }
+    m_encoderConfig->qualityLevel = qualityLevel;
+    m_sendControlCmd = true;
+    m_sendQualityLevelCmd = true;
+    m_sendRateControlCmd = true;
+    return VK_SUCCESS;
+}
 
-    VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
-    encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+VkResult VkVideoEncoder::EncodeLookAheadFrames(size_t maxLookAheadFrames)
+{
+    while (m_lookAheadFrames.size() > maxLookAheadFrames) {
+
+        // The window is the frame to encode and the frames following it, as far as they are loaded
+        const size_t windowSize = std::min<size_t>(m_lookAheadFrames.size(), m_encoderConfig->lookAheadFrames + 1);
+        m_lookAheadWindow.clear();
+        for (size_t i = 0; i < windowSize; i++) {
+            VkSharedBaseObj<VkVideoEncodeFrameInfo>& lookAheadFrame = m_lookAheadFrames[i];
+            if (!lookAheadFrame->hasLookAheadComplexity) {
+                // The analysis was recorded into the input command buffer of the frame, its completion is not reset
+                lookAheadFrame->inputCmdBuffer->SyncHostOnCmdBuffComplete(false);
+                m_preAnalysis->GetFrameComplexity((uint32_t)lookAheadFrame->srcEncodeImageResource->GetImageIndex(),
+                                                  lookAheadFrame->lookAheadComplexity);
+                lookAheadFrame->hasLookAheadComplexity = true;
+            }
+            m_lookAheadWindow.push_back(lookAheadFrame->lookAheadComplexity);
+        }
 
-    CopyLinearToOptimalImage(cmdBuf, linearInputImageView, srcEncodeImageView);
+        VkSharedBaseObj<VkVideoEncodeFrameInfo> encodeFrameInfo(m_lookAheadFrames.front().Detach());
+        m_lookAheadFrames.pop_front();
 
-    VkResult result = encodeFrameInfo->inputCmdBuffer->EndCommandBufferRecording(cmdBuf);
+        if (m_encoderConfig->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+            // The picture type is only known once the frame is encoded, the QP of each type is adapted
+            encodeFrameInfo->lookAheadQpDeltas =
+                VkVideoEncoderPreAnalysis::GetQpDeltas(m_lookAheadWindow.data(), (uint32_t)m_lookAheadWindow.size());
+        }
 
-    // Now submit the staged input to the queue
-    SubmitStagedInputFrame(encodeFrameInfo);
+        if (m_adaptiveGop) {
+            // The cuts are spaced, so that a flash isn't coded as two IDR frames
+            encodeFrameInfo->sceneCut = (encodeFrameInfo->frameInputOrderNum > 0) &&
+                                        (m_framesSinceSceneCut >= VkVideoEncoderPreAnalysis::MIN_SCENE_CUT_DISTANCE) &&
+                                        VkVideoEncoderPreAnalysis::IsSceneCut(m_lastLookAheadComplexity,
+                                                                              encodeFrameInfo->lookAheadComplexity);
+            m_framesSinceSceneCut = encodeFrameInfo->sceneCut ? 0 : (m_framesSinceSceneCut + 1);
+            m_lastLookAheadComplexity = encodeFrameInfo->lookAheadComplexity;
+
+            // Applied if the frame starts a GOP, to the frames following it
+            if (m_lookAheadWindow.size() > 1) {
+                const uint32_t maxBFrameCount = m_encoderConfig->gopStructure.GetConsecutiveBFrameCount();
+                encodeFrameInfo->adaptiveBFrameCount =
+                    (int8_t)VkVideoEncoderPreAnalysis::GetBFrameCount(&m_lookAheadWindow[1],
+                                                                      (uint32_t)m_lookAheadWindow.size() - 1,
+                                                                      maxBFrameCount);
+            }
+        }
 
-    // and encode the input frame with the encoder next
-    EncodeFrame(encodeFrameInfo);
+        if (m_verbose) {
+            std::cout << "Look-ahead frame " << encodeFrameInfo->frameInputOrderNum
+                      << " intra cost " << encodeFrameInfo->lookAheadComplexity.intraCost
+                      << " inter cost " << encodeFrameInfo->lookAheadComplexity.interCost
+                      << " QP offsets I/P/B " << encodeFrameInfo->lookAheadQpDeltas.intra
+                      << "/" << encodeFrameInfo->lookAheadQpDeltas.interP
+                      << "/" << encodeFrameInfo->lookAheadQpDeltas.interB
+                      << (encodeFrameInfo->sceneCut ? " scene cut" : "") << std::endl;
+        }
 
-    return result;
+        EncodeFrame(encodeFrameInfo);
+    }
+    return VK_SUCCESS;
 }
 
-VkResult VkVideoEncoder::SubmitStagedInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+VkResult VkVideoEncoder::SubmitStagedInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                                const VkVideoEncodeInputImage* pInputImage,
+                                                const VkCommandBuffer* pPreRecordedCmdBuf)
 {
     assert(encodeFrameInfo);
     assert(encodeFrameInfo->inputCmdBuffer != nullptr);
 
-    const VkCommandBuffer* pCmdBuf = encodeFrameInfo->inputCmdBuffer->GetCommandBuffer();
+    const VkCommandBuffer* pCmdBuf = (pPreRecordedCmdBuf != nullptr) ? pPreRecordedCmdBuf :
+                                                                        encodeFrameInfo->inputCmdBuffer->GetCommandBuffer();
     VkSemaphore frameCompleteSemaphore = encodeFrameInfo->inputCmdBuffer->GetSemaphore();
+    const uint64_t frameCompleteValue = encodeFrameInfo->inputCmdBuffer->AssignSignalValue();
+
+    // Also signals the input semaphores of the simulcast frames scaled and the band frames copied by the command
+    // buffer, and the semaphore of the input image once the frame is copied from it.
+    // The values are only used by the timeline semaphores, the binary ones ignore them.
+    VkSemaphore signalSemaphores[2 + EncoderConfig::MAX_SIMULCAST_RUNGS + EncoderConfig::MAX_SPLIT_FRAME_BANDS];
+    uint64_t signalSemaphoreValues[2 + EncoderConfig::MAX_SIMULCAST_RUNGS + EncoderConfig::MAX_SPLIT_FRAME_BANDS]{};
+    uint32_t signalSemaphoreCount = 0;
+    bool hasSignalValues = (frameCompleteValue > 0);
+    if (frameCompleteSemaphore != VK_NULL_HANDLE) {
+        signalSemaphoreValues[signalSemaphoreCount] = frameCompleteValue;
+        signalSemaphores[signalSemaphoreCount++] = frameCompleteSemaphore;
+    }
+    for (VkSharedBaseObj<VkVideoEncodeFrameInfo>& simulcastFrame : m_simulcastFrames) {
+        signalSemaphoreValues[signalSemaphoreCount] = simulcastFrame->inputCmdBuffer->AssignSignalValue();
+        hasSignalValues = hasSignalValues || (signalSemaphoreValues[signalSemaphoreCount] > 0);
+        signalSemaphores[signalSemaphoreCount++] = simulcastFrame->inputCmdBuffer->GetSemaphore();
+    }
+    for (VkSharedBaseObj<VkVideoEncodeFrameInfo>& bandFrame : m_splitFrameFrames) {
+        signalSemaphoreValues[signalSemaphoreCount] = bandFrame->inputCmdBuffer->AssignSignalValue();
+        hasSignalValues = hasSignalValues || (signalSemaphoreValues[signalSemaphoreCount] > 0);
+        signalSemaphores[signalSemaphoreCount++] = bandFrame->inputCmdBuffer->GetSemaphore();
+    }
+    if ((pInputImage != nullptr) && (pInputImage->signalSemaphore != VK_NULL_HANDLE)) {
+        hasSignalValues = hasSignalValues || (pInputImage->signalValue > 0);
+        signalSemaphoreValues[signalSemaphoreCount] = pInputImage->signalValue;
+        signalSemaphores[signalSemaphoreCount++] = pInputImage->signalSemaphore;
+    }
 
-    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
+    // The copy from an input image waits for the frame to be written to it
+    const bool waitInputImage = (pInputImage != nullptr) && (pInputImage->waitSemaphore != VK_NULL_HANDLE);
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    if (waitInputImage && (pInputImage->waitValue > 0)) {
+        timelineSemaphoreInfo.waitSemaphoreValueCount = 1;
+        timelineSemaphoreInfo.pWaitSemaphoreValues = &pInputImage->waitValue;
+    }
+    if (hasSignalValues) {
+        timelineSemaphoreInfo.signalSemaphoreValueCount = signalSemaphoreCount;
+        timelineSemaphoreInfo.pSignalSemaphoreValues = signalSemaphoreValues;
+    }
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                                ((timelineSemaphoreInfo.waitSemaphoreValueCount > 0) ||
+                                 (timelineSemaphoreInfo.signalSemaphoreValueCount > 0)) ? &timelineSemaphoreInfo : nullptr };
     const VkPipelineStageFlags videoTransferSubmitWaitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = nullptr;
+    submitInfo.waitSemaphoreCount = waitInputImage ? 1 : 0;
+    submitInfo.pWaitSemaphores = waitInputImage ? &pInputImage->waitSemaphore : nullptr;
     submitInfo.pWaitDstStageMask = &videoTransferSubmitWaitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = pCmdBuf;
-    submitInfo.pSignalSemaphores = (frameCompleteSemaphore != VK_NULL_HANDLE) ? &frameCompleteSemaphore : nullptr;
-    submitInfo.signalSemaphoreCount = (frameCompleteSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    submitInfo.pSignalSemaphores = (signalSemaphoreCount > 0) ? signalSemaphores : nullptr;
+    submitInfo.signalSemaphoreCount = signalSemaphoreCount;
 
     VkFence queueCompleteFence = encodeFrameInfo->inputCmdBuffer->GetFence();
-    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(((m_vkDevCtx->GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) != 0) ?
-                                                               VulkanDeviceContext::ENCODE : VulkanDeviceContext::TRANSFER,
-                                                           0, 1, &submitInfo,
+    const VulkanDeviceContext::QueueFamilySubmitType submitType = GetInputSubmitType();
+    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(submitType,
+                                                           (submitType == VulkanDeviceContext::ENCODE) ? m_encodeQueueIndex : 0,
+                                                           1, &submitInfo,
                                                            queueCompleteFence);
 
-    encodeFrameInfo->inputCmdBuffer->SetCommandBufferSubmitted();
+    if (pPreRecordedCmdBuf != nullptr) {
+        encodeFrameInfo->inputCmdBuffer->SetExternalCommandBufferSubmitted();
+    } else {
+        encodeFrameInfo->inputCmdBuffer->SetCommandBufferSubmitted();
+    }
     bool syncCpuAfterStaging = false;
     if (syncCpuAfterStaging) {
         encodeFrameInfo->inputCmdBuffer->SyncHostOnCmdBuffComplete();
@@ -180,7 +1252,12 @@ VkResult VkVideoEncoder::SubmitStagedInputFrame(VkSharedBaseObj<VkVideoEncodeFra
             VulkanEncoderInputFrame displayEncoderInputFrame;
             displayEncoderInputFrame.pictureIndex = (int32_t)encodeFrameInfo->frameInputOrderNum;
             displayEncoderInputFrame.displayOrder = encodeFrameInfo->positionInGopInDecodeOrder;
-            displayEncoderInputFrame.frameCompleteSemaphore = frameCompleteSemaphore;
+            if (frameCompleteValue > 0) {
+                displayEncoderInputFrame.frameCompleteTimelineSemaphore = frameCompleteSemaphore;
+                displayEncoderInputFrame.frameCompleteTimelineValue = frameCompleteValue;
+            } else {
+                displayEncoderInputFrame.frameCompleteSemaphore = frameCompleteSemaphore;
+            }
             // displayEncoderInputFrame.frameCompleteFence = currentEncodeFrameData->m_frameCompleteFence;
             encodeFrameInfo->srcEncodeImageResource->GetImageView(displayEncoderInputFrame.imageView );
             // One can also look at the linear input instead
@@ -195,69 +1272,401 @@ VkResult VkVideoEncoder::SubmitStagedInputFrame(VkSharedBaseObj<VkVideoEncodeFra
     return result;
 }
 
-VkResult VkVideoEncoder::AssembleBitstreamData(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
-                                               uint32_t frameIdx, uint32_t ofTotalFrames)
+size_t VkVideoEncoder::WriteBitstream(const uint8_t* data, size_t size)
 {
-    assert(encodeFrameInfo->outputBitstreamBuffer != nullptr);
-    assert(encodeFrameInfo->encodeCmdBuffer != nullptr);
+    if (m_bitstreamWriter) {
+        // Copied, the writer thread writes it out with the following frames
+        return m_bitstreamWriter->Write(data, size) ? size : 0;
+    }
+    return fwrite(data, 1, size, m_encoderConfig->outputFileHandler.GetFileHandle());
+}
 
-    if(encodeFrameInfo->bitstreamHeaderBufferSize > 0) {
-        size_t nonVcl = fwrite(encodeFrameInfo->bitstreamHeaderBuffer + encodeFrameInfo->bitstreamHeaderOffset,
-               1, encodeFrameInfo->bitstreamHeaderBufferSize,
-               m_encoderConfig->outputFileHandler.GetFileHandle());
+size_t VkVideoEncoder::WritePacketHeader(const VkVideoEncodeFrameInfo* encodeFrameInfo, size_t accessUnitSize)
+{
+    VkVideoEncodePacketHeader packetHeader;
+    memset(&packetHeader, 0, sizeof(packetHeader));
+    packetHeader.magic = VkVideoEncodePacketHeader::MAGIC;
+    packetHeader.size = (uint32_t)accessUnitSize;
+    packetHeader.pts = encodeFrameInfo->inputTimeStamp;
+    packetHeader.dts = m_numPacketsWritten++;
+    if ((encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) || encodeFrameInfo->sceneCut) {
+        packetHeader.flags |= VkVideoEncodePacketHeader::FLAG_KEYFRAME;
+    }
+    if (encodeFrameInfo->bitstreamHeaderBufferSize > 0) {
+        packetHeader.flags |= VkVideoEncodePacketHeader::FLAG_PARAMETER_SETS;
+    }
+    if (encodeFrameInfo->lastFrame) {
+        packetHeader.flags |= VkVideoEncodePacketHeader::FLAG_LAST_FRAME;
+    }
+    packetHeader.pictureType = (uint8_t)encodeFrameInfo->pictureType;
+    packetHeader.temporalId = m_encoderConfig->gopStructure.GetTemporalId(encodeFrameInfo->positionInGopInDisplayOrder);
+    packetHeader.headerSize = (uint16_t)sizeof(packetHeader);
+    return WriteBitstream((const uint8_t*)&packetHeader, sizeof(packetHeader));
+}
 
-        if (m_encoderConfig->verboseFrameStruct) {
-            std::cout << ">>>>>> Non-Vcl data" << (nonVcl ? "SUCCESS" : "FAIL")
-                      << " File Output non-VCL data with size: " << encodeFrameInfo->bitstreamHeaderBufferSize
-                      << ", Display Order: " << (uint32_t)encodeFrameInfo->positionInGopInDisplayOrder
-                      << ", Decode  Order: " << (uint32_t)encodeFrameInfo->positionInGopInDecodeOrder
-                      << std::endl << std::flush;
+VkResult VkVideoEncoder::GetEncodedSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    assert(encodeFrameInfo->videoSessionParameters);
+    const VkVideoSessionParametersKHR sessionParameters = *encodeFrameInfo->videoSessionParameters;
+
+    if (m_encodedSessionParameters.empty() || (m_encodedSessionParametersHandle != sessionParameters)) {
+        // New session parameters, from the driver
+        VkResult result = EncodeVideoSessionParameters(encodeFrameInfo);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        m_encodedSessionParameters.assign(encodeFrameInfo->bitstreamHeaderBuffer,
+                                          encodeFrameInfo->bitstreamHeaderBuffer + encodeFrameInfo->bitstreamHeaderBufferSize);
+        m_encodedSessionParametersHandle = sessionParameters;
+        return VK_SUCCESS;
+    }
+
+    assert(m_encodedSessionParameters.size() <= sizeof(encodeFrameInfo->bitstreamHeaderBuffer));
+    memcpy(encodeFrameInfo->bitstreamHeaderBuffer, m_encodedSessionParameters.data(), m_encodedSessionParameters.size());
+    encodeFrameInfo->bitstreamHeaderBufferSize = m_encodedSessionParameters.size();
+    encodeFrameInfo->bitstreamHeaderOffset = 0;
+
+    return VK_SUCCESS;
+}
+
+uint32_t VkVideoEncoder::GetSliceOffsets(const uint8_t* data, size_t size, std::vector<uint32_t>& sliceOffsets) const
+{
+    const bool isH264 = (m_encoderConfig->codec == VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR);
+
+    sliceOffsets.clear();
+    for (size_t i = 0; (i + 3) < size; i++) {
+        if ((data[i] != 0) || (data[i + 1] != 0) || (data[i + 2] != 1)) {
+            continue;
         }
+        const uint8_t nalUnitType = isH264 ? (data[i + 3] & 0x1F) : ((data[i + 3] >> 1) & 0x3F);
+        const bool isSlice = isH264 ? ((nalUnitType >= 1) && (nalUnitType <= 5)) : (nalUnitType < 32); // VCL NAL units
+        if (isSlice) {
+            // With the zero_byte of a 4-byte start code
+            sliceOffsets.push_back((uint32_t)(((i > 0) && (data[i - 1] == 0)) ? (i - 1) : i));
+        }
+        i += 2;
     }
 
+    return (uint32_t)sliceOffsets.size();
+}
+
+VkResult VkVideoEncoder::AssembleBitstreamData(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                               uint32_t frameIdx, uint32_t ofTotalFrames, bool waitForResults)
+{
+    assert(encodeFrameInfo->outputBitstreamBuffer != nullptr);
+    assert(encodeFrameInfo->encodeCmdBuffer != nullptr);
+
+    VK_TRACE_ZONE_FRAME("AssembleBitstreamData", encodeFrameInfo->frameInputOrderNum);
     uint32_t querySlotId = (uint32_t)-1;
     VkQueryPool queryPool = encodeFrameInfo->encodeCmdBuffer->GetQueryPool(querySlotId);
 
     // Since we can use a single command buffer from multiple frames,
     // we can't just use the querySlotId from the command buffer.
-    // Instead we use the input image index that should be unique for each frame.
-    querySlotId = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+    // Instead we use the feedback query slot the frame was recorded with.
+    querySlotId = encodeFrameInfo->feedbackQuerySlot;
 
     // get output results
-    struct VulkanVideoEncodeStatus {
-        uint32_t bitstreamStartOffset;
-        uint32_t bitstreamSize;
-        VkQueryResultStatusKHR status;
-    } encodeResult{};
+    VkVideoEncodeStatus encodeResult{};
 
-    // Fetch the coded VCL data and its information
-    VkResult result = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx, queryPool, querySlotId,
-                                                      1, sizeof(encodeResult), &encodeResult, sizeof(encodeResult),
-                                                      VK_QUERY_RESULT_WITH_STATUS_BIT_KHR | VK_QUERY_RESULT_WAIT_BIT);
+    // Fetch the coded VCL data and its information, before anything of the frame is written
+    VkResult result = VK_SUCCESS;
+    if (encodeFrameInfo->encodeStatusFetched) {
+        // Already read along with the frames before it
+        encodeResult = encodeFrameInfo->encodeStatus;
+    } else {
+        VkQueryResultFlags queryResultFlags = VK_QUERY_RESULT_WITH_STATUS_BIT_KHR;
+        if (waitForResults) {
+            queryResultFlags |= VK_QUERY_RESULT_WAIT_BIT;
+        }
+        result = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx, queryPool, querySlotId,
+                                                 1, sizeof(encodeResult), &encodeResult, sizeof(encodeResult),
+                                                 queryResultFlags);
+        if (!waitForResults && (result == VK_NOT_READY)) {
+            return result;
+        }
+    }
 
     assert(result == VK_SUCCESS);
-    assert(encodeResult.status == VK_QUERY_RESULT_STATUS_COMPLETE_KHR);
+    const bool bitstreamOverflow =
+        (encodeResult.status == VK_QUERY_RESULT_STATUS_INSUFFICIENT_BITSTREAM_BUFFER_RANGE_KHR);
+    assert((encodeResult.status == VK_QUERY_RESULT_STATUS_COMPLETE_KHR) || bitstreamOverflow);
 
     if(result != VK_SUCCESS) {
         fprintf(stderr, "\nRetrieveData Error: Failed to get vcl query pool results.\n");
+        HandOverSplitFrameBandSlices(nullptr, 0);
         return result;
     }
 
+    if (m_deviceLocalBitstream) {
+        // The copy to the host buffer comes after the query of the encode, done with the command buffer
+        VK_TRACE_ZONE("WaitForEncodeCmdBuffer");
+        result = waitForResults ? encodeFrameInfo->encodeCmdBuffer->SyncHostOnCmdBuffComplete(false, UINT64_MAX) :
+                                  encodeFrameInfo->encodeCmdBuffer->GetCompletionStatus();
+        if (!waitForResults && (result == VK_NOT_READY)) {
+            return result;
+        }
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nRetrieveData Error: Failed to wait for the bitstream readback.\n");
+            HandOverSplitFrameBandSlices(nullptr, 0);
+            return result;
+        }
+    }
+
+    // The frame is not coded again, the next ones may already be predicted from it: the buffers of the type grow
+    const VkDeviceSize bitstreamBufferSize = encodeFrameInfo->outputBitstreamBuffer->GetMaxSize();
+    if (bitstreamOverflow) {
+        m_metrics.bitstreamOverflows.Add();
+        fprintf(stderr, "\nWARNING: Frame %llu overflowed its bitstream buffer of %llu bytes\n",
+                (unsigned long long)encodeFrameInfo->frameInputOrderNum, (unsigned long long)bitstreamBufferSize);
+    }
+    UpdateBitstreamBufferSize(encodeFrameInfo->pictureType, encodeResult.bitstreamSize, bitstreamBufferSize,
+                              bitstreamOverflow);
+
     VkDeviceSize maxSize;
     uint8_t* data = encodeFrameInfo->outputBitstreamBuffer->GetDataPtr(0, maxSize);
 
-    size_t vcl = fwrite(data + encodeResult.bitstreamStartOffset, 1, encodeResult.bitstreamSize,
-                        m_encoderConfig->outputFileHandler.GetFileHandle());
+    const uint8_t* vclData = data + encodeResult.bitstreamStartOffset;
+    size_t vclSize = encodeResult.bitstreamSize;
+    if (m_encoderConfig->splitFrameBandIndex > 0) {
+        // The main encoder writes the slices of the band with its own
+        HandOverSplitFrameBandSlices(vclData, vclSize);
+        return result;
+    }
+    if (!m_splitFrameEncoders.empty()) {
+        if (!StitchSplitFrameBands(vclData, vclSize)) {
+            fprintf(stderr, "\nAssembleBitstreamData Error: Failed to stitch the bands of the frame %llu.\n",
+                    (unsigned long long)encodeFrameInfo->frameInputOrderNum);
+        }
+        vclData = m_splitFrameData.data();
+        vclSize = m_splitFrameData.size();
+    }
+
+    if (m_packetFraming) {
+        // The packet boundaries, for a consumer not parsing the bitstream
+        WritePacketHeader(encodeFrameInfo, encodeFrameInfo->bitstreamHeaderBufferSize + vclSize);
+    }
+
+    if(encodeFrameInfo->bitstreamHeaderBufferSize > 0) {
+        size_t nonVcl = WriteBitstream(encodeFrameInfo->bitstreamHeaderBuffer + encodeFrameInfo->bitstreamHeaderOffset,
+                                       encodeFrameInfo->bitstreamHeaderBufferSize);
+
+        if (m_encoderConfig->verboseFrameStruct) {
+            std::cout << ">>>>>> Non-Vcl data" << (nonVcl ? "SUCCESS" : "FAIL")
+                      << " File Output non-VCL data with size: " << encodeFrameInfo->bitstreamHeaderBufferSize
+                      << ", Display Order: " << (uint32_t)encodeFrameInfo->positionInGopInDisplayOrder
+                      << ", Decode  Order: " << (uint32_t)encodeFrameInfo->positionInGopInDecodeOrder
+                      << std::endl << std::flush;
+        }
+    }
+
+    size_t vcl = 0;
+    const uint32_t numSlices = (m_encoderConfig->sliceCount > 1) ?
+                                   GetSliceOffsets(vclData, vclSize, m_sliceOffsets) : 0;
+    if (numSlices > 1) {
+        // A slice at a time, for an output packetizing them
+        for (uint32_t slice = 0; slice < numSlices; slice++) {
+            const size_t sliceStart = (slice == 0) ? 0 : m_sliceOffsets[slice];
+            const size_t sliceEnd = ((slice + 1) < numSlices) ? m_sliceOffsets[slice + 1] : vclSize;
+            vcl += WriteBitstream(vclData + sliceStart, sliceEnd - sliceStart);
+        }
+    } else {
+        vcl = WriteBitstream(vclData, vclSize);
+    }
+
+    if (encodeFrameInfo->qualityMetricsSubmitted) {
+        FrameQualityMetrics frameQualityMetrics{ encodeFrameInfo->frameInputOrderNum, {} };
+        if (m_qualityMetrics->GetFrameMetrics((uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex(),
+                                              frameQualityMetrics.metrics) == VK_SUCCESS) {
+            m_frameQualityMetrics.push_back(frameQualityMetrics);
+        }
+    }
+
+    if (m_encoderConfig->firstPass) {
+        VkVideoEncoderTwoPass::FrameStats frameStats = VkVideoEncoderTwoPass::FrameStats();
+        frameStats.frameInputOrderNum = encodeFrameInfo->frameInputOrderNum;
+        frameStats.pictureType = encodeFrameInfo->pictureType;
+        switch (encodeFrameInfo->pictureType) {
+        case VkVideoGopStructure::FRAME_TYPE_IDR:
+        case VkVideoGopStructure::FRAME_TYPE_I:
+            frameStats.qp = encodeFrameInfo->constQp.qpIntra;
+            break;
+        case VkVideoGopStructure::FRAME_TYPE_B:
+            frameStats.qp = encodeFrameInfo->constQp.qpInterB;
+            break;
+        default:
+            frameStats.qp = encodeFrameInfo->constQp.qpInterP;
+            break;
+        }
+        frameStats.bits = (uint64_t)(encodeFrameInfo->bitstreamHeaderBufferSize + vclSize) * 8;
+        if (encodeFrameInfo->hasLookAheadComplexity) {
+            frameStats.intraCost = encodeFrameInfo->lookAheadComplexity.intraCost;
+            frameStats.interCost = encodeFrameInfo->lookAheadComplexity.interCost;
+        }
+        m_twoPassFrameStats.push_back(frameStats);
+    }
+
+    UpdateOutputMetrics(encodeFrameInfo, encodeFrameInfo->bitstreamHeaderBufferSize + vclSize);
+    if (m_frameStats) {
+        AddFrameStats(encodeFrameInfo, encodeResult.status, encodeFrameInfo->bitstreamHeaderBufferSize + vclSize);
+    }
+
+    if (m_encoderConfig->enableBenchmark) {
+        m_numBenchmarkFrames++;
+        m_numBenchmarkBytes += encodeFrameInfo->bitstreamHeaderBufferSize + vclSize;
+        m_benchmarkEndTime = std::chrono::steady_clock::now();
+    }
+
+    if (m_lowLatency) {
+        fflush(m_encoderConfig->outputFileHandler.GetFileHandle());
+        m_frameLatenciesMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                               encodeFrameInfo->inputReadyTime).count());
+    }
 
     if (m_encoderConfig->verboseFrameStruct) {
-        std::cout << ">>>>>> Output VCL data " << (vcl ? "SUCCESS" : "FAIL") << " with size: " << encodeResult.bitstreamSize
+        std::cout << ">>>>>> Output VCL data " << (vcl ? "SUCCESS" : "FAIL") << " with size: " << vclSize
                   << " and offset: " << encodeResult.bitstreamStartOffset
                   << ", Display Order: " << (uint32_t)encodeFrameInfo->positionInGopInDisplayOrder
                   << ", Decode  Order: " << (uint32_t)encodeFrameInfo->positionInGopInDecodeOrder << std::endl << std::flush;
+        if (numSlices > 1) {
+            std::cout << ">>>>>> Slice offsets:";
+            for (uint32_t slice = 0; slice < numSlices; slice++) {
+                std::cout << " " << m_sliceOffsets[slice];
+            }
+            std::cout << std::endl << std::flush;
+        }
     }
     return result;
 }
 
+void VkVideoEncoder::AddFrameStats(const VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                   VkQueryResultStatusKHR status, size_t bitstreamSize)
+{
+    VkVideoEncoderFrameStats::FrameStats frameStats;
+    frameStats.frameInputOrderNum = encodeFrameInfo->frameInputOrderNum;
+    frameStats.frameEncodeOrderNum = encodeFrameInfo->frameEncodeOrderNum;
+    frameStats.pictureType = encodeFrameInfo->pictureType;
+    frameStats.picOrderCnt = encodeFrameInfo->picOrderCntVal;
+    frameStats.bytes = bitstreamSize;
+    frameStats.status = status;
+
+    // Only known with the rate control disabled, before the QP offsets of the slices or of a delta map
+    frameStats.qp = -1;
+    if (m_encoderConfig->rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+        switch (encodeFrameInfo->pictureType) {
+        case VkVideoGopStructure::FRAME_TYPE_IDR:
+        case VkVideoGopStructure::FRAME_TYPE_I:
+            frameStats.qp = encodeFrameInfo->constQp.qpIntra;
+            break;
+        case VkVideoGopStructure::FRAME_TYPE_B:
+            frameStats.qp = encodeFrameInfo->constQp.qpInterB;
+            break;
+        default:
+            frameStats.qp = encodeFrameInfo->constQp.qpInterP;
+            break;
+        }
+    }
+
+    // The encode of the frame is done, its timestamps are collected now if they have not been already
+    frameStats.gpuTimeMs = -1.0;
+    frameStats.queueWaitMs = -1.0;
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->GetFrameTimes((uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex(),
+                                       encodeFrameInfo->frameInputOrderNum,
+                                       &frameStats.gpuTimeMs, &frameStats.queueWaitMs);
+    }
+    frameStats.latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                    encodeFrameInfo->inputReadyTime).count();
+
+    if (!m_frameStats->Add(frameStats)) {
+        fprintf(stderr, "\nAssembleBitstreamData Warning: Failed to write the frame statistics, no longer written.\n");
+        m_frameStats->Close();
+        m_frameStats = nullptr;
+    }
+}
+
+void VkVideoEncoder::UpdateOutputMetrics(const VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                         size_t bitstreamSize)
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    m_metrics.framesEncoded.Add();
+    m_metrics.bitstreamBytes.Add(bitstreamSize);
+    m_metrics.frameLatencyUs.Observe((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                         now - encodeFrameInfo->inputReadyTime).count());
+
+    const uint64_t numFrames = m_metrics.framesEncoded.Get();
+    if (m_metrics.fpsStartFrame == 0) {
+        m_metrics.fpsStartTime = now;
+        m_metrics.fpsStartFrame = numFrames;
+        return;
+    }
+    const double elapsedSec = std::chrono::duration<double>(now - m_metrics.fpsStartTime).count();
+    if (elapsedSec >= 1.0) {
+        m_metrics.fps.Set((double)(numFrames - m_metrics.fpsStartFrame) / elapsedSec);
+        m_metrics.fpsStartTime = now;
+        m_metrics.fpsStartFrame = numFrames;
+    }
+}
+
+VkResult VkVideoEncoder::RetireInFlightFrames(size_t maxInFlightFrames)
+{
+    while (!m_inFlightFrames.empty()) {
+        if (!m_inFlightFrames.front()->encodeStatusFetched) {
+            FetchInFlightEncodeStatus();
+        }
+
+        // The bitstream is written in submission order, a completed frame waits for the ones before it
+        const bool waitForResults = (m_inFlightFrames.size() > maxInFlightFrames);
+        VkResult result = AssembleBitstreamData(m_inFlightFrames.front(), 0, 0, waitForResults);
+        if (result == VK_NOT_READY) {
+            return VK_SUCCESS;
+        }
+
+        // Releases the frame's input image, command buffer and bitstream buffer
+        m_inFlightFrames.pop_front();
+        m_metrics.inFlightFrames.Set((double)m_inFlightFrames.size());
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+void VkVideoEncoder::FetchInFlightEncodeStatus()
+{
+    VkVideoEncodeFrameInfo* oldestFrame = m_inFlightFrames.front().Get();
+    const uint32_t firstQuerySlot = oldestFrame->feedbackQuerySlot;
+    if (firstQuerySlot >= m_numFeedbackQuerySlots) {
+        return;
+    }
+
+    // The consecutive frames have consecutive slots, up to the wrap-around
+    uint32_t numQueries = 0;
+    while ((numQueries < m_inFlightFrames.size()) &&
+           (m_inFlightFrames[numQueries]->feedbackQuerySlot == (firstQuerySlot + numQueries))) {
+        numQueries++;
+    }
+
+    // Without the wait bit, the results of the queries not available yet are not written
+    m_feedbackQueryResults.assign(numQueries, VkVideoEncodeStatus());
+    uint32_t querySlotId = (uint32_t)-1;
+    VkQueryPool queryPool = oldestFrame->encodeCmdBuffer->GetQueryPool(querySlotId);
+    VkResult result = m_vkDevCtx->GetQueryPoolResults(*m_vkDevCtx, queryPool, firstQuerySlot, numQueries,
+                                                      numQueries * sizeof(VkVideoEncodeStatus),
+                                                      m_feedbackQueryResults.data(), sizeof(VkVideoEncodeStatus),
+                                                      VK_QUERY_RESULT_WITH_STATUS_BIT_KHR);
+    if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+        // Left to the queries of the frames one by one
+        return;
+    }
+
+    for (uint32_t i = 0; i < numQueries; i++) {
+        if (m_feedbackQueryResults[i].status != VK_QUERY_RESULT_STATUS_NOT_READY_KHR) {
+            m_inFlightFrames[i]->encodeStatus = m_feedbackQueryResults[i];
+            m_inFlightFrames[i]->encodeStatusFetched = true;
+        }
+    }
+}
+
 VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConfig)
 {
 
@@ -269,7 +1678,101 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    m_encoderConfig = encoderConfig;
+    m_encoderConfig = encoderConfig;
+
+    // Sessions encoding in parallel are spread over the encode queues
+    m_encodeQueueIndex = (uint32_t)std::max(encoderConfig->queueId, 0) %
+                             (uint32_t)std::max(m_vkDevCtx->GetVideoEncodeNumQueues(), 1);
+
+    if (encoderConfig->enableLowLatency) {
+        // Nothing is buffered between the stages, each frame is written out before the next one is loaded
+        m_lowLatency = true;
+        encoderConfig->enableOutputWriterThread = false;
+        encoderConfig->enableStagePipeline = false;
+        encoderConfig->inputLoadAheadFrames = 0;
+        encoderConfig->encodeInFlightFrames = 0;
+        encoderConfig->lookAheadFrames = 0;
+        encoderConfig->enableAdaptiveGop = false;
+        m_frameLatenciesMs.reserve(std::min<uint32_t>(encoderConfig->numFrames, 1 << 16));
+    }
+
+    m_packetFraming = encoderConfig->enablePacketFraming;
+
+    m_deviceLocalBitstream = encoderConfig->enableDeviceLocalBitstream;
+    if (m_deviceLocalBitstream && ((m_vkDevCtx->GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) == 0)) {
+        std::cout << "The bitstream is encoded into the host buffers, the encode queue has no transfers" << std::endl;
+        m_deviceLocalBitstream = false;
+    }
+    if (m_deviceLocalBitstream) {
+        // Allocated on first use
+        m_deviceBitstreamBuffers.resize(encoderConfig->numInputImages);
+    }
+
+    m_rightSizedBitstreamBuffers = encoderConfig->enableRightSizedBitstreamBuffers;
+    if (m_rightSizedBitstreamBuffers &&
+            ((encoderConfig->videoEncodeCapabilities.flags &
+              VK_VIDEO_ENCODE_CAPABILITY_INSUFFICIENT_BITSTREAM_BUFFER_RANGE_DETECTION_BIT_KHR) == 0)) {
+        // The overflows would go unnoticed
+        std::cout << "The bitstream buffers keep their worst case size, the device does not detect their overflow"
+                  << std::endl;
+        m_rightSizedBitstreamBuffers = false;
+    }
+
+    if (encoderConfig->enableOutputWriterThread) {
+        VkResult result = VkVideoEncoderBitstreamWriter::Create(encoderConfig->outputFileHandler.GetFileHandle(),
+                                                                VkVideoEncoderBitstreamWriter::DEFAULT_BLOCK_SIZE,
+                                                                VkVideoEncoderBitstreamWriter::DEFAULT_MAX_PENDING_BLOCKS,
+                                                                m_bitstreamWriter);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Error: Failed to create the bitstream writer.\n");
+            return result;
+        }
+        m_bitstreamWriter->SetWriterThreadAffinity(encoderConfig->writerCpus);
+    }
+
+    if (encoderConfig->inputConversionThreads > 1) {
+        // The calling thread converts one of the row bands
+        m_inputConversionThreadPool.reset(new VkThreadPool(encoderConfig->inputConversionThreads - 1));
+    }
+
+    uint32_t numInFlightFrames = encoderConfig->encodeInFlightFrames;
+    if (encoderConfig->enableStagePipeline) {
+        m_useStagePipeline = true;
+        const uint32_t assembleDepth = (encoderConfig->encodeInFlightFrames > 0) ?
+                                           encoderConfig->encodeInFlightFrames : (uint32_t)STAGE_PIPELINE_DEFAULT_ASSEMBLE_DEPTH;
+        m_recordStageQueue.SetMaxPendingQueueNodes(STAGE_PIPELINE_RECORD_DEPTH);
+        m_assembleStageQueue.SetMaxPendingQueueNodes(assembleDepth);
+        // Queued to each of the stage threads, plus the one being processed by each of them
+        numInFlightFrames = STAGE_PIPELINE_RECORD_DEPTH + assembleDepth + 2;
+    }
+
+    const uint32_t maxInputImages = 64;
+    if (numInFlightFrames > 0) {
+        // The in-flight frames hold their input images, command buffers and frame infos until they are retired
+        encoderConfig->numInputImages = std::min<uint32_t>(encoderConfig->numInputImages + numInFlightFrames,
+                                                           maxInputImages);
+    }
+
+    if (encoderConfig->enableAdaptiveGop && (encoderConfig->lookAheadFrames == 0)) {
+        encoderConfig->lookAheadFrames = ADAPTIVE_GOP_DEFAULT_LOOK_AHEAD;
+    }
+
+    if (encoderConfig->lookAheadFrames > 0) {
+        // The frames held back for the look-ahead keep their input images and frame infos until they are encoded
+        encoderConfig->numInputImages = std::min<uint32_t>(encoderConfig->numInputImages + encoderConfig->lookAheadFrames,
+                                                           maxInputImages);
+    }
+
+    if (encoderConfig->inputLoadAheadFrames > 0) {
+        // The frames loaded ahead hold their input images and frame infos until they are staged
+        encoderConfig->numInputImages = std::min<uint32_t>(encoderConfig->numInputImages + encoderConfig->inputLoadAheadFrames,
+                                                           maxInputImages);
+        const uint32_t maxLoaderThreads = std::max<uint32_t>(std::thread::hardware_concurrency() / 2, 1);
+        m_inputLoaderThreadPool.reset(new VkThreadPool(std::min<uint32_t>(encoderConfig->inputLoadAheadFrames,
+                                                                          maxLoaderThreads),
+                                                       encoderConfig->loaderCpus));
+        m_inputStagingNumaNode = encoderConfig->loaderCpus.empty() ? -1 : VkGetCpuNumaNode(encoderConfig->loaderCpus[0]);
+    }
 
     // Update the video profile
     encoderConfig->InitVideoProfile();
@@ -279,10 +1782,41 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
     // Reconfigure the gopStructure structure because the device may not support
     // specific GOP structure. For example it may not support B-frames.
     // gopStructure.Init() should be called after  encoderConfig->InitDeviceCapbilities().
+    if (m_lowLatency) {
+        // The frames are encoded in their input order
+        m_encoderConfig->gopStructure.SetConsecutiveBFrameCount(0);
+    }
+    if (m_encoderConfig->gopStructure.GetTemporalLayerCount() > 1) {
+        // Each temporal layer gets its own rate control layer
+        const uint32_t maxTemporalLayerCount = std::max<uint32_t>(encoderConfig->videoEncodeCapabilities.maxRateControlLayers, 1);
+        if ((uint32_t)m_encoderConfig->gopStructure.GetTemporalLayerCount() > maxTemporalLayerCount) {
+            std::cout << "The temporal layers are limited to " << maxTemporalLayerCount << " by the device" << std::endl;
+            m_encoderConfig->gopStructure.SetTemporalLayerCount((int8_t)maxTemporalLayerCount);
+        }
+        // The temporal hierarchy replaces the B-frames, the frames are coded in their input order
+        m_encoderConfig->gopStructure.SetConsecutiveBFrameCount(0);
+    }
+    if (m_encoderConfig->intraRefreshPeriod > 0) {
+        // The P frames refresh the picture in place of the periodic IDR and I frames, in their input order
+        m_encoderConfig->gopStructure.SetConsecutiveBFrameCount(0);
+        m_encoderConfig->gopStructure.SetIntraRefresh(true);
+    }
+    if (m_encoderConfig->enableAllIntraMultiQueue && (m_encoderConfig->intraRefreshPeriod > 0)) {
+        std::cout << "The intra refresh P frames can't be spread over the encode queues" << std::endl;
+        m_encoderConfig->enableAllIntraMultiQueue = false;
+    }
+    // The bands of the split frames can't predict from the pictures of the other bands' sessions
+    if (m_encoderConfig->enableAllIntraMultiQueue || (m_encoderConfig->splitFrameBands > 1)) {
+        // Each frame an I frame, the IDR ones at the IDR period, the last one too
+        m_encoderConfig->gopStructure.SetGopFrameCount(1);
+        m_encoderConfig->gopStructure.SetConsecutiveBFrameCount(0);
+        m_encoderConfig->gopStructure.SetLastFrameType(VkVideoGopStructure::FRAME_TYPE_I);
+    }
     m_encoderConfig->gopStructure.Init();
     std::cout << std::endl << "GOP frame count: " << (uint32_t)m_encoderConfig->gopStructure.GetGopFrameCount();
     std::cout << ", IDR period: " << (uint32_t)m_encoderConfig->gopStructure.GetIdrPeriod();
     std::cout << ", Consecutive B frames: " << (uint32_t)m_encoderConfig->gopStructure.GetConsecutiveBFrameCount();
+    std::cout << ", Temporal layers: " << (uint32_t)m_encoderConfig->gopStructure.GetTemporalLayerCount();
     std::cout << std::endl;
     m_encoderConfig->gopStructure.PrintGopStructure(m_encoderConfig->gopStructure.GetGopFrameCount() + 5);
 
@@ -290,6 +1824,14 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
     m_maxActiveReferencePictures = encoderConfig->InitDpbCount();
 
     encoderConfig->InitRateControl();
+    InitBitstreamBufferSizes();
+
+    encoderConfig->InitSliceCount();
+
+    const uint32_t maxQualityLevels = std::max<uint32_t>(encoderConfig->videoEncodeCapabilities.maxQualityLevels, 1);
+    if (encoderConfig->qualityLevel >= maxQualityLevels) {
+        encoderConfig->qualityLevel = maxQualityLevels - 1;
+    }
 
     VkFormat supportedDpbFormats[8];
     VkFormat supportedInFormats[8];
@@ -320,6 +1862,27 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
 
     const uint32_t maxReferencePicturesSlotsCount = EncoderConfig::DEFAULT_MAX_NUM_REF_FRAMES;
 
+    // The admission control of the session against the device memory available, most of it is the input and the
+    // DPB images. Each frame in flight holds one more of both, they are dropped to fit before the session fails.
+    // The stage pipeline needs all of its frames in flight.
+    const VkDeviceSize inputImageSize = VulkanDeviceMemoryBudget::EstimateImageSize(m_imageInFormat, m_maxCodedExtent);
+    const VkDeviceSize dpbImageSize = VulkanDeviceMemoryBudget::EstimateImageSize(m_imageDpbFormat, m_maxCodedExtent);
+    const uint32_t numInputImagesNotInFlight = (encoderConfig->numInputImages > numInFlightFrames) ?
+                                                   (encoderConfig->numInputImages - numInFlightFrames) : 1;
+    const int32_t admittedInFlightFrames = VulkanDeviceMemoryBudget::Admit(m_vkDevCtx, "encoder",
+            (numInputImagesNotInFlight * inputImageSize) + ((maxReferencePicturesSlotsCount + 4) * dpbImageSize),
+            inputImageSize + dpbImageSize,
+            m_useStagePipeline ? numInFlightFrames : 0, numInFlightFrames);
+    if (admittedInFlightFrames < 0) {
+        fprintf(stderr, "\nInitEncoder Error: The encoder does not fit in the device memory available.\n");
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    if ((uint32_t)admittedInFlightFrames < numInFlightFrames) {
+        encoderConfig->numInputImages = numInputImagesNotInFlight + (uint32_t)admittedInFlightFrames;
+        encoderConfig->encodeInFlightFrames = (uint32_t)admittedInFlightFrames;
+        numInFlightFrames = (uint32_t)admittedInFlightFrames;
+    }
+
     VkVideoSessionCreateFlagsKHR sessionCreateFlags{};
 #ifdef VK_KHR_video_maintenance1
     m_videoMaintenance1FeaturesSupported = VulkanVideoCapabilities::GetVideoMaintenance1FeatureSupported(m_vkDevCtx);
@@ -328,6 +1891,12 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
     }
 #endif // VK_KHR_video_maintenance1
 
+    // The session, with the binding of its memory, and the bitstream buffers do not depend on the filters, the
+    // images or the command buffers. They are created on the startup pool while this thread creates those, and
+    // joined before the threads submitting the frames start.
+    VkThreadPool startupThreadPool(2);
+    std::future<VkResult> videoSessionResult;
+
     if (!m_videoSession ||
             !m_videoSession->IsCompatible( m_vkDevCtx,
                                            sessionCreateFlags,
@@ -340,21 +1909,22 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
                                            std::max<uint32_t>(m_maxActiveReferencePictures,
                                                               maxReferencePicturesSlotsCount)) ) {
 
-        result = VulkanVideoSession::Create( m_vkDevCtx,
-                                             sessionCreateFlags,
-                                             m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
-                                             &encoderConfig->videoCoreProfile,
-                                             m_imageInFormat,
-                                             m_maxCodedExtent,
-                                             m_imageDpbFormat,
-                                             m_maxActiveReferencePictures,
-                                             std::max<uint32_t>(m_maxActiveReferencePictures,
-                                                                maxReferencePicturesSlotsCount),
-                                             m_videoSession);
+        videoSessionResult = startupThreadPool.enqueue([this, sessionCreateFlags, maxReferencePicturesSlotsCount, &encoderConfig]() {
+            return VulkanVideoSession::Create( m_vkDevCtx,
+                                               sessionCreateFlags,
+                                               m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
+                                               &encoderConfig->videoCoreProfile,
+                                               m_imageInFormat,
+                                               m_maxCodedExtent,
+                                               m_imageDpbFormat,
+                                               m_maxActiveReferencePictures,
+                                               std::max<uint32_t>(m_maxActiveReferencePictures,
+                                                                  maxReferencePicturesSlotsCount),
+                                               m_videoSession);
+        });
 
         // after creating a new video session, we need a codec reset.
         m_resetEncoder = true;
-        assert(result == VK_SUCCESS);
     }
 
     VkExtent2D imageExtent {
@@ -366,33 +1936,174 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
                                              VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
                                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
                                              VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-    const VkImageUsageFlags dpbImageUsage = VK_IMAGE_USAGE_VIDEO_ENCODE_DPB_BIT_KHR;
+    VkImageUsageFlags dpbImageUsage = VK_IMAGE_USAGE_VIDEO_ENCODE_DPB_BIT_KHR;
 
-    result =  VulkanVideoImagePool::Create(m_vkDevCtx, m_linearInputImagePool);
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to create linearInputImagePool.\n");
-        return result;
+    if (encoderConfig->enableInputComputeConversion || encoderConfig->enableInputConversionAuto) {
+        result = InitInputComputeConversion(encoderConfig);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: The input will be converted on the CPU (%d).\n", result);
+            m_inputComputeFilter = nullptr;
+        }
     }
 
-    result = m_linearInputImagePool->Configure( m_vkDevCtx,
-                                                encoderConfig->numInputImages,
-                                                m_imageInFormat,
-                                                imageExtent,
-                                                  ( VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                    VK_IMAGE_USAGE_STORAGE_BIT |
-                                                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
-                                                m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
-                                                  ( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  |
-                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                                                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT),
-                                                nullptr, // pVideoProfile
-                                                false,   // useImageArray
-                                                false,   // useImageViewArray
-                                                true     // useLinear
-                                              );
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to Configure linearInputImagePool.\n");
-        return result;
+    if ((!m_useInputComputeConversion && encoderConfig->enableInputBufferUpload) ||
+            (m_useInputComputeConversion && encoderConfig->enableInputConversionAuto)) {
+        InitInputBufferUpload(encoderConfig);
+    }
+
+    if (m_useInputComputeConversion && encoderConfig->enableInputConversionAuto) {
+        // The times of the paths depend on the frames, their format and the threads converting them on the CPU
+        uint8_t deviceUuid[VK_UUID_SIZE];
+        m_vkDevCtx->GetPhysicalDeviceUuid(deviceUuid);
+        const std::string cacheKey = std::to_string(encoderConfig->input.width) + "x" +
+                                     std::to_string(encoderConfig->input.height) + " " +
+                                     std::to_string(encoderConfig->input.bpp) + "-bit " +
+                                     std::to_string(encoderConfig->inputConversionThreads) + " threads";
+        m_inputConversionSelector.reset(new VkConversionPathSelector("Input conversion",
+                                                                     encoderConfig->conversionCalibrationCacheFileName.empty() ? nullptr :
+                                                                         encoderConfig->conversionCalibrationCacheFileName.c_str(),
+                                                                     deviceUuid, cacheKey));
+    }
+
+    if (encoderConfig->inputRgbaFormat != VK_FORMAT_UNDEFINED) {
+        result = InitInputRgbaConversion(encoderConfig);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: The RGBA input images are not supported (%d).\n", result);
+            m_inputRgbaFilter = nullptr;
+        }
+    }
+
+    // The frames read in place can't be converted on the CPU
+    if (m_useInputComputeConversion && encoderConfig->enableInputHostImport && !m_inputConversionSelector) {
+        result = InitInputHostImport(encoderConfig);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: The input frames will be copied to the staging buffers (%d).\n", result);
+        }
+    }
+
+    if (encoderConfig->enableBenchmark) {
+        const VkExtent2D inputExtent { encoderConfig->input.width, encoderConfig->input.height };
+        result = VkVideoEncoderSyntheticInput::Create(m_vkDevCtx, m_imageInFormat, inputExtent, m_syntheticInput);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Error: The benchmark input can't be generated on the GPU (%d).\n", result);
+            return result;
+        }
+        for (std::atomic<uint64_t>& stageTimeNs : m_benchmarkStageTimeNs) {
+            stageTimeNs = 0;
+        }
+    }
+
+    if (encoderConfig->temporalFilterStrength > 0.0f) {
+        const VkExtent2D inputExtent { encoderConfig->input.width, encoderConfig->input.height };
+        result = VkVideoEncoderTemporalFilter::Create(m_vkDevCtx, m_imageInFormat, inputExtent,
+                                                      encoderConfig->temporalFilterStrength, m_temporalFilter);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: The temporal filter is not available (%d).\n", result);
+            m_temporalFilter = nullptr;
+        }
+    }
+
+    if (encoderConfig->lookAheadFrames > 0) {
+        if ((encoderConfig->rateControlMode != VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) &&
+                !encoderConfig->enableAdaptiveGop) {
+            // The device rate control sets the QP of the frames in the other modes
+            fprintf(stderr, "\nInitEncoder Warning: The look-ahead adapts the QP with the rate control disabled only.\n");
+        } else {
+            const VkExtent2D inputExtent { encoderConfig->input.width, encoderConfig->input.height };
+            result = VkVideoEncoderPreAnalysis::Create(m_vkDevCtx, m_imageInFormat, inputExtent,
+                                                       encoderConfig->numInputImages, m_preAnalysis);
+            if (result != VK_SUCCESS) {
+                fprintf(stderr, "\nInitEncoder Warning: The look-ahead analysis is not available (%d).\n", result);
+                m_preAnalysis = nullptr;
+            }
+        }
+    }
+    m_adaptiveGop = encoderConfig->enableAdaptiveGop && m_preAnalysis;
+
+    if (!encoderConfig->qualityMetricsCsvFileName.empty()) {
+        result = InitQualityMetrics(encoderConfig);
+        if (result == VK_SUCCESS) {
+            // The reconstructed pictures are read by the compute shader
+            dpbImageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        } else {
+            fprintf(stderr, "\nInitEncoder Warning: The quality metrics are not available (%d).\n", result);
+            m_qualityMetrics = nullptr;
+        }
+    }
+
+    if (!encoderConfig->frameStatsCsvFileName.empty()) {
+        result = VkVideoEncoderFrameStats::Create(encoderConfig->frameStatsCsvFileName.c_str(), m_frameStats);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: The frame statistics are not written (%d).\n", result);
+            m_frameStats = nullptr;
+        }
+    }
+
+    if (!encoderConfig->simulcastRungs.empty()) {
+        result = InitSimulcastScaling(encoderConfig);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: The input can't be scaled for the simulcast encoders (%d).\n", result);
+            m_simulcastScaleFilter = nullptr;
+        }
+    }
+
+    if (!encoderConfig->twoPassStatsFileName.empty() && !encoderConfig->firstPass) {
+        std::vector<VkVideoEncoderTwoPass::FrameStats> frameStats;
+        if (!VkVideoEncoderTwoPass::ReadStats(encoderConfig->twoPassStatsFileName.c_str(), frameStats)) {
+            fprintf(stderr, "\nInitEncoder Error: The first pass stats can't be read from %s.\n",
+                    encoderConfig->twoPassStatsFileName.c_str());
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        const int32_t maxQp = (encoderConfig->maxQp >= 0) ? encoderConfig->maxQp : 51;
+        const uint64_t predictedBits = VkVideoEncoderTwoPass::AllocateBits(frameStats, encoderConfig->targetSizeBytes * 8,
+                                                                           0, maxQp, m_twoPassQpDeltas);
+        if (m_verbose) {
+            printf("Two-pass: %zu frames, %llu bytes predicted for a target of %llu bytes\n", frameStats.size(),
+                   (unsigned long long)(predictedBits / 8), (unsigned long long)encoderConfig->targetSizeBytes);
+        }
+    }
+
+    for (const RateControlChange& rateControlChange : encoderConfig->rateControlChanges) {
+        ChangeRateControl(rateControlChange);
+    }
+
+    // The simulated feedback arrives with the frame following the lost one
+    for (uint64_t lostFrame : encoderConfig->lostFrames) {
+        InvalidateReferenceFrames(lostFrame);
+    }
+
+    // The compute conversion and the buffer upload stage the input frames in buffers instead of linear images.
+    // The input images of a simulcast rung or of a band are written by the main encoder, the transcoded frames are
+    // copied from the decoded pictures and the benchmark frames are generated in place.
+    if (!m_useInputComputeConversion && !m_useInputBufferUpload && !encoderConfig->simulcastRung &&
+            (encoderConfig->splitFrameBandIndex == 0) && encoderConfig->transcodeFileName.empty() && !m_syntheticInput) {
+        result =  VulkanVideoImagePool::Create(m_vkDevCtx, m_linearInputImagePool);
+        if(result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Error: Failed to create linearInputImagePool.\n");
+            return result;
+        }
+        m_linearInputImagePool->SetMemoryOwner(VULKAN_MEMORY_OWNER_STAGING);
+
+        result = m_linearInputImagePool->Configure( m_vkDevCtx,
+                                                    encoderConfig->numInputImages,
+                                                    m_imageInFormat,
+                                                    imageExtent,
+                                                      ( VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                        VK_IMAGE_USAGE_STORAGE_BIT |
+                                                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
+                                                    m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
+                                                      ( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT  |
+                                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                                        VK_MEMORY_PROPERTY_HOST_CACHED_BIT),
+                                                    nullptr, // pVideoProfile
+                                                    false,   // useImageArray
+                                                    false,   // useImageViewArray
+                                                    true     // useLinear
+                                                  );
+        if(result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Error: Failed to Configure linearInputImagePool.\n");
+            return result;
+        }
     }
 
     result =  VulkanVideoImagePool::Create(m_vkDevCtx, m_inputImagePool);
@@ -400,6 +2111,7 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
         fprintf(stderr, "\nInitEncoder Error: Failed to create inputImagePool.\n");
         return result;
     }
+    m_inputImagePool->SetMemoryOwner(VULKAN_MEMORY_OWNER_INPUT);
 
     result = m_inputImagePool->Configure( m_vkDevCtx,
                                           encoderConfig->numInputImages,
@@ -423,125 +2135,814 @@ VkResult VkVideoEncoder::InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConf
         fprintf(stderr, "\nInitEncoder Error: Failed to create dpbImagePool.\n");
         return result;
     }
+    m_dpbImagePool->SetMemoryOwner(VULKAN_MEMORY_OWNER_DPB);
+
+    // A single image with a layer per slot, and a single view of all of them, like the DPB of the decoder.
+    // The implementations without separate reference images only support that.
+    m_useImageArray = encoderConfig->enableDpbImageArray ||
+                      ((encoderConfig->videoCapabilities.flags & VK_VIDEO_CAPABILITY_SEPARATE_REFERENCE_IMAGES_BIT_KHR) == 0);
+    m_useImageViewArray = m_useImageArray;
+
+    result = m_dpbImagePool->Configure(m_vkDevCtx,
+                                       maxReferencePicturesSlotsCount + 4 + numInFlightFrames,
+                                       m_imageDpbFormat,
+                                       imageExtent,
+                                       dpbImageUsage,
+                                       m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       encoderConfig->videoCoreProfile.GetProfile(), // pVideoProfile
+                                       m_useImageArray,
+                                       m_useImageViewArray,
+                                       false    // useLinear
+                                      );
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nInitEncoder Error: Failed to Configure inputImagePool.\n");
+        return result;
+    }
+
+    m_bitstreamBuffersQueue.SetIdleTrimPeriod(encoderConfig->bitstreamBufferIdleTrimMs);
+    std::future<void> bitstreamBuffersResult = startupThreadPool.enqueue([this, &encoderConfig]() {
+        int32_t availableBuffers = (int32_t)m_bitstreamBuffersQueue.GetAvailableNodesNumber();
+        if (availableBuffers < encoderConfig->numBitstreamBuffersToPreallocate) {
+
+            uint32_t allocateNumBuffers = std::min<uint32_t>(
+                    m_bitstreamBuffersQueue.GetMaxNodes(),
+                    (encoderConfig->numBitstreamBuffersToPreallocate - availableBuffers));
+
+            // Of the inter frames, the most of them
+            const VkDeviceSize allocSize = VulkanBitstreamBufferPool::GetAllocationSize(
+                    GetBitstreamBufferSize(VkVideoGopStructure::FRAME_TYPE_P));
+
+            allocateNumBuffers = std::min<uint32_t>(allocateNumBuffers,
+                    m_bitstreamBuffersQueue.GetFreeNodesNumber(allocSize));
+
+            for (uint32_t i = 0; i < allocateNumBuffers; i++) {
+
+                VkSharedBaseObj<VulkanBitstreamBufferImpl> bitstreamBuffer;
+
+                VkResult result = VulkanBitstreamBufferImpl::Create(m_vkDevCtx,
+                        m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
+                        allocSize,
+                        encoderConfig->videoCapabilities.minBitstreamBufferOffsetAlignment,
+                        encoderConfig->videoCapabilities.minBitstreamBufferSizeAlignment,
+                        nullptr, 0, bitstreamBuffer);
+                assert(result == VK_SUCCESS);
+                if (result != VK_SUCCESS) {
+                    fprintf(stderr, "\nERROR: VulkanBitstreamBufferImpl::Create() result: 0x%x\n", result);
+                    break;
+                }
+
+                int32_t nodeAddedWithIndex = m_bitstreamBuffersQueue.AddNodeToPool(bitstreamBuffer, false);
+                if (nodeAddedWithIndex < 0) {
+                    assert("Could not add the new node to the pool");
+                    break;
+                }
+            }
+        }
+    });
+
+    // The compute conversions or the benchmark input, the temporal filter, the pre-analysis and the simulcast scaling
+    // are recorded into the same command buffer as the input staging
+    const uint32_t inputQueueFamilyIndex = (m_useInputComputeConversion || m_inputRgbaFilter || m_syntheticInput ||
+                                            m_temporalFilter || m_preAnalysis || m_simulcastScaleFilter) ?
+                                               m_vkDevCtx->GetComputeQueueFamilyIdx() :
+                                           ((m_vkDevCtx->GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) != 0) ?
+                                               m_vkDevCtx->GetVideoEncodeQueueFamilyIdx() :
+                                               m_vkDevCtx->GetTransferQueueFamilyIdx();
+
+    result = VulkanCommandBufferPool::Create(m_vkDevCtx, m_inputCommandBufferPool);
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nInitEncoder Error: Failed to create m_inputCommandBufferPool.\n");
+        return result;
+    }
+
+    result = m_inputCommandBufferPool->Configure( m_vkDevCtx,
+                                                  encoderConfig->numInputImages, // numPoolNodes
+                                                  inputQueueFamilyIndex, // queueFamilyIndex
+                                                  false,    // createQueryPool - not needed for the input transfer
+                                                  nullptr,  // pVideoProfile   - not needed for the input transfer
+                                                  true,     // createSemaphores
+                                                  true,     // createFences
+                                                  1,        // numCommandPools
+                                                  true      // useTimelineSemaphore, if supported
+                                                 );
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nInitEncoder Error: Failed to Configure m_inputCommandBufferPool.\n");
+        return result;
+    }
+
+    // Without the stages depending on the frame, the upload only depends on the staging and the input images:
+    // it is recorded once per pair of them, at its first use
+    if (!m_syntheticInput && !m_temporalFilter && !m_preAnalysis && !m_simulcastScaleFilter &&
+            !encoderConfig->simulcastRung && (encoderConfig->splitFrameBands <= 1) &&
+            encoderConfig->transcodeFileName.empty()) {
+        m_numPreRecordedStagingSlots = m_linearInputImagePool ? encoderConfig->numInputImages : 1;
+        const uint32_t numPreRecordedCmdBuffers = encoderConfig->numInputImages * m_numPreRecordedStagingSlots;
+        result = m_preRecordedInputCmdBuffers.CreateCommandBufferPool(m_vkDevCtx, inputQueueFamilyIndex,
+                                                                      numPreRecordedCmdBuffers);
+        if (result == VK_SUCCESS) {
+            m_preRecordedInputCmdBuffersValid.assign(numPreRecordedCmdBuffers, false);
+        } else {
+            fprintf(stderr, "\nInitEncoder Warning: The input uploads are recorded for each frame (%d).\n", result);
+            m_preRecordedInputCmdBuffers.DestroyCommandBuffer();
+            m_preRecordedInputCmdBuffers.DestroyCommandBufferPool();
+        }
+    }
+
+    result = VulkanCommandBufferPool::Create(m_vkDevCtx, m_encodeCommandBufferPool);
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nInitEncoder Error: Failed to create m_encodeCommandBufferPool.\n");
+        return result;
+    }
+
+    VkQueryPoolVideoEncodeFeedbackCreateInfoKHR encodeFeedbackCreateInfo =
+        {VK_STRUCTURE_TYPE_QUERY_POOL_VIDEO_ENCODE_FEEDBACK_CREATE_INFO_KHR};
+
+    encodeFeedbackCreateInfo.pNext = encoderConfig->videoCoreProfile.GetProfile();
+    encodeFeedbackCreateInfo.encodeFeedbackFlags = VK_VIDEO_ENCODE_FEEDBACK_BITSTREAM_BUFFER_OFFSET_BIT_KHR |
+                                                   VK_VIDEO_ENCODE_FEEDBACK_BITSTREAM_BYTES_WRITTEN_BIT_KHR;
+
+    result = m_encodeCommandBufferPool->Configure( m_vkDevCtx,
+                                                   encoderConfig->numInputImages, // numPoolNodes
+                                                   m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(), // queueFamilyIndex
+                                                   true,      // createQueryPool - not needed for the input transfer
+                                                   &encodeFeedbackCreateInfo, // VideoEncodeFeedback + VideoProfile
+                                                   true,     // createSemaphores
+                                                   true,     // createFences
+                                                   1,        // numCommandPools
+                                                   true      // useTimelineSemaphore, if supported
+                                                  );
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nInitEncoder Error: Failed to Configure m_encodeCommandBufferPool.\n");
+        return result;
+    }
+    // The all-intra frames don't depend on each other, they are encoded round-robin on all the encode queues. Only
+    // the video coding control commands order them, the frames on the other queues wait for the last one of those
+    // on the timeline semaphore of the pool. The frames are still retired in their submission order, which keeps
+    // the bitstream in order whichever queue completes them first.
+    m_numEncodeQueues = 1;
+    m_nextEncodeQueue = 0;
+    if (encoderConfig->enableAllIntraMultiQueue) {
+        if (encoderConfig->rateControlMode != VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+            std::cout << "The frames with rate control are encoded on a single queue, "
+                         "use --rateControlMode disabled with --allIntraMultiQueue" << std::endl;
+        } else if (!m_encodeCommandBufferPool->UsesTimelineSemaphore()) {
+            std::cout << "The frames are encoded on a single queue without timeline semaphores" << std::endl;
+        } else {
+            m_numEncodeQueues = (uint32_t)std::max(m_vkDevCtx->GetVideoEncodeNumQueues(), 1);
+            std::cout << "Encoding the intra frames on " << m_numEncodeQueues << " encode queues" << std::endl;
+        }
+    }
+
+    // One feedback query per pool node, at most one per input image is in flight
+    m_numFeedbackQuerySlots = encoderConfig->numInputImages;
+    m_nextFeedbackQuerySlot = 0;
+
+    if (encoderConfig->gpuTimestamps) {
+        result = VulkanVideoGpuTimestamps::Create(m_vkDevCtx, m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
+                                                  encoderConfig->numInputImages, "Encode",
+                                                  encoderConfig->gpuTimestampsCsvFileName.c_str(), m_gpuTimestamps);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Warning: GPU timestamps are not available on the encode queue (%d).\n", result);
+            m_gpuTimestamps = nullptr;
+        }
+    }
+
+    result = CreateFrameInfoBuffersQueue(encoderConfig->numInputImages);
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nInitEncoder Error: Failed to create FrameInfoBuffersQueue.\n");
+        return result;
+    }
+
+    bitstreamBuffersResult.get();
+    if (videoSessionResult.valid()) {
+        result = videoSessionResult.get();
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nInitEncoder Error: Failed to create the video session.\n");
+            return result;
+        }
+    }
+
+    // Start the queue consumer thread
+    if (m_enableEncoderQueue) {
+
+        const uint32_t maxPendingQueueNodes = 2;
+        m_encoderQueue.SetMaxPendingQueueNodes(std::min<uint32_t>(m_encoderConfig->gopStructure.GetGopFrameCount() + 1, maxPendingQueueNodes));
+        m_encoderQueueConsumerThread = std::thread(&VkVideoEncoder::ConsumerThread, this);
+        VkSetThreadAffinity(m_encoderQueueConsumerThread, m_encoderConfig->consumerCpus);
+    }
+
+    if (m_useStagePipeline) {
+        m_recordStageThread   = std::thread(&VkVideoEncoder::RecordStageThread, this);
+        m_assembleStageThread = std::thread(&VkVideoEncoder::AssembleStageThread, this);
+        VkSetThreadAffinity(m_recordStageThread, m_encoderConfig->consumerCpus);
+        VkSetThreadAffinity(m_assembleStageThread, m_encoderConfig->consumerCpus);
+    }
+    return VK_SUCCESS;
+}
+
+// The input filters run on the compute queue, with the color description of the input
+static VkResult CreateInputComputeFilter(const VulkanDeviceContext* vkDevCtx,
+                                         VkSharedBaseObj<EncoderConfig>& encoderConfig,
+                                         VulkanFilterYuvCompute::FilterType filterType,
+                                         VkFormat inputFormat,
+                                         VkFormat outputFormat,
+                                         VkSharedBaseObj<VulkanFilter>& filter)
+{
+    const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
+               VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+               nullptr,
+               outputFormat,
+               encoderConfig->ycbcrModel,
+               encoderConfig->ycbcrRange,
+               encoderConfig->components,
+               encoderConfig->xChromaOffset,
+               encoderConfig->yChromaOffset,
+               VK_FILTER_LINEAR,
+               false
+               };
+
+    static const VkSamplerCreateInfo samplerInfo = {
+               VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+               nullptr,
+               0,
+               VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+               VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+               // mipLodBias  anisotropyEnable  maxAnisotropy  compareEnable      compareOp         minLod  maxLod          borderColor
+               // unnormalizedCoordinates
+               0.0, false, 0.00, false, VK_COMPARE_OP_NEVER, 0.0, 16.0, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, false
+    };
+
+    const YcbcrPrimariesConstants ycbcrPrimariesConstants = GetYcbcrPrimariesConstants(YcbcrBtStandardBt709);
+
+    return VulkanFilterYuvCompute::Create(vkDevCtx,
+                                          vkDevCtx->GetComputeQueueFamilyIdx(),
+                                          0,
+                                          filterType,
+                                          encoderConfig->numInputImages,
+                                          inputFormat,
+                                          outputFormat,
+                                          &ycbcrConversionCreateInfo,
+                                          &ycbcrPrimariesConstants,
+                                          &samplerInfo,
+                                          filter);
+}
+
+VkResult VkVideoEncoder::InitInputComputeConversion(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    // The compute filter reads the planes of the input file frame from a buffer, I420 or its 16-bit variants.
+    if ((encoderConfig->input.numPlanes != 3) ||
+            (encoderConfig->input.chromaSubsampling != VK_VIDEO_CHROMA_SUBSAMPLING_420_BIT_KHR) ||
+            (m_vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkResult result = CreateInputComputeFilter(m_vkDevCtx, encoderConfig, VulkanFilterYuvCompute::BUFFER2YCBCR,
+                                               encoderConfig->input.vkFormat, m_imageInFormat, m_inputComputeFilter);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The staging buffers are allocated on first use
+    m_inputStagingBuffers.resize(encoderConfig->numInputImages);
+    m_useInputComputeConversion = true;
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::InitInputRgbaConversion(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    if (m_vkDevCtx->GetComputeQueueFamilyIdx() < 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    // The model, the range and the chroma siting signaled in the stream
+    const uint8_t matrixCoefficients = encoderConfig->color_description_present_flag ?
+                                           encoderConfig->matrix_coefficients : 1;
+    const VkSamplerYcbcrModelConversion ycbcrModel =
+        ((matrixCoefficients == 5) || (matrixCoefficients == 6)) ? VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_601 :
+        ((matrixCoefficients == 9) || (matrixCoefficients == 10)) ? VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_2020 :
+                                                                     VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709;
+    const uint8_t chromaSampleLocType = encoderConfig->chroma_loc_info_present_flag ?
+                                            encoderConfig->chroma_sample_loc_type : 0;
+    const VkSamplerYcbcrConversionCreateInfo ycbcrConversionCreateInfo {
+               VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+               nullptr,
+               m_imageInFormat,
+               ycbcrModel,
+               encoderConfig->video_full_range_flag ? VK_SAMPLER_YCBCR_RANGE_ITU_FULL : VK_SAMPLER_YCBCR_RANGE_ITU_NARROW,
+               encoderConfig->components,
+               ((chromaSampleLocType & 1) == 0) ? VK_CHROMA_LOCATION_COSITED_EVEN : VK_CHROMA_LOCATION_MIDPOINT,
+               ((chromaSampleLocType == 2) || (chromaSampleLocType == 3)) ? VK_CHROMA_LOCATION_COSITED_EVEN :
+                                                                            VK_CHROMA_LOCATION_MIDPOINT,
+               VK_FILTER_LINEAR,
+               false
+               };
+
+    const YcbcrPrimariesConstants ycbcrPrimariesConstants = GetYcbcrPrimariesConstants(YcbcrBtStandardBt709);
+
+    // The RGBA image is read as a storage image, without a sampler
+    VkResult result = VulkanFilterYuvCompute::Create(m_vkDevCtx,
+                                                     m_vkDevCtx->GetComputeQueueFamilyIdx(),
+                                                     0,
+                                                     VulkanFilterYuvCompute::RGBA2YCBCR,
+                                                     encoderConfig->numInputImages,
+                                                     encoderConfig->inputRgbaFormat,
+                                                     m_imageInFormat,
+                                                     &ycbcrConversionCreateInfo,
+                                                     &ycbcrPrimariesConstants,
+                                                     nullptr,
+                                                     m_inputRgbaFilter);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // The views of the images of the application are created with each frame
+    m_inputRgbaImageViews.resize(encoderConfig->numInputImages, VK_NULL_HANDLE);
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::InitInputHostImport(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    size_t mappedLength = 0;
+    if (encoderConfig->inputFileHandler.GetMappedData(mappedLength) == nullptr) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    if (m_vkDevCtx->FindRequiredDeviceExtension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    // The file is imported in windows of whole frames, which bounds the memory pinned for the device and keeps
+    // the plane offsets in the storage buffer range. Half of the range leaves room for the import alignment.
+    VkPhysicalDeviceProperties deviceProps;
+    m_vkDevCtx->GetPhysicalDeviceProperties(m_vkDevCtx->getPhysicalDevice(), &deviceProps);
+    const size_t maxWindowSize = std::min<size_t>(deviceProps.limits.maxStorageBufferRange / 2, 256 * 1024 * 1024);
+    const size_t frameSize = encoderConfig->input.fullImageSize;
+    if ((frameSize == 0) || (frameSize > maxWindowSize)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    m_inputHostImportWindowFrames = (uint32_t)(maxWindowSize / frameSize);
+    m_numInputHostImportFrames = 0;
+    m_useInputHostImport = true;
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::InitSimulcastScaling(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    // The rungs are scaled from the 2-plane 4:2:0 input images
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_imageInFormat);
+    if ((mpInfo == nullptr) || (mpInfo->planesLayout.layout != YCBCR_SEMI_PLANAR_CBCR_INTERLEAVED) ||
+            (mpInfo->planesLayout.secondaryPlaneSubsampledX == 0) ||
+            (mpInfo->planesLayout.secondaryPlaneSubsampledY == 0) ||
+            (m_vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    static const VulkanFilterYuvCompute::FilterType scaleFilterTypes[] = {
+        VulkanFilterYuvCompute::YCBCRSCALE,          // SIMULCAST_SCALER_BOX
+        VulkanFilterYuvCompute::YCBCRSCALE_BILINEAR, // SIMULCAST_SCALER_BILINEAR
+        VulkanFilterYuvCompute::YCBCRSCALE_BICUBIC,  // SIMULCAST_SCALER_BICUBIC
+        VulkanFilterYuvCompute::YCBCRSCALE_LANCZOS,  // SIMULCAST_SCALER_LANCZOS
+    };
+    const uint32_t scaler = (encoderConfig->simulcastScaler < (sizeof(scaleFilterTypes) / sizeof(scaleFilterTypes[0]))) ?
+                                encoderConfig->simulcastScaler : (uint32_t)EncoderConfig::SIMULCAST_SCALER_BOX;
+
+    return CreateInputComputeFilter(m_vkDevCtx, encoderConfig, scaleFilterTypes[scaler],
+                                    m_imageInFormat, m_imageInFormat, m_simulcastScaleFilter);
+}
+
+VkResult VkVideoEncoder::AttachSimulcastEncoder(VkSharedBaseObj<VkVideoEncoder>& simulcastEncoder)
+{
+    if (!m_simulcastScaleFilter || !simulcastEncoder || !simulcastEncoder->m_encoderConfig->simulcastRung ||
+            (m_inputFrameNum > 0) || (m_simulcastEncoders.size() >= EncoderConfig::MAX_SIMULCAST_RUNGS)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    m_simulcastEncoders.push_back(simulcastEncoder);
+    m_simulcastFrames.reserve(m_simulcastEncoders.size());
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::AttachSplitFrameEncoder(VkSharedBaseObj<VkVideoEncoder>& splitFrameEncoder)
+{
+    if (!splitFrameEncoder || (m_encoderConfig->splitFrameBands <= 1) || (m_encoderConfig->splitFrameBandIndex != 0) ||
+            (splitFrameEncoder->m_encoderConfig->splitFrameBandIndex != (m_splitFrameEncoders.size() + 1)) ||
+            (m_inputFrameNum > 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    m_splitFrameEncoders.push_back(splitFrameEncoder);
+    m_splitFrameFrames.reserve(m_splitFrameEncoders.size());
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoder::AcquireSimulcastFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& primaryFrameInfo,
+                                               VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    GetAvailablePoolNode(encodeFrameInfo);
+    assert(encodeFrameInfo);
+    if (!encodeFrameInfo) {
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    encodeFrameInfo->frameInputOrderNum = m_inputFrameNum++;
+    encodeFrameInfo->inputTimeStamp = primaryFrameInfo->inputTimeStamp;
+    encodeFrameInfo->lastFrame = primaryFrameInfo->lastFrame;
+    encodeFrameInfo->inputReadyTime = primaryFrameInfo->inputReadyTime;
+
+    VkResult result = AcquireInputImage(encodeFrameInfo);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // Only the semaphore is used, signaled by the input submission of the main encoder
+    m_inputCommandBufferPool->GetAvailablePoolNode(encodeFrameInfo->inputCmdBuffer);
+    assert(encodeFrameInfo->inputCmdBuffer != nullptr);
+    return (encodeFrameInfo->inputCmdBuffer != nullptr) ? VK_SUCCESS : VK_ERROR_OUT_OF_POOL_MEMORY;
+}
+
+void VkVideoEncoder::RecordSimulcastScaling(VkCommandBuffer cmdBuf,
+                                            VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                            VkImageLayout imageLayout)
+{
+    VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+    encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+
+    // The input image, written by the commands before, then the images of the rungs, overwritten
+    VkImageMemoryBarrier2KHR imageBarriers[1 + EncoderConfig::MAX_SIMULCAST_RUNGS];
+    const uint32_t numImageBarriers = 1 + (uint32_t)m_simulcastFrames.size();
+    assert(numImageBarriers <= ARRAYSIZE(imageBarriers));
+    for (uint32_t i = 0; i < numImageBarriers; i++) {
+        VkSharedBaseObj<VkImageResourceView> imageView;
+        if (i == 0) {
+            imageView = srcEncodeImageView;
+        } else {
+            m_simulcastFrames[i - 1]->srcEncodeImageResource->GetImageView(imageView);
+        }
+        imageBarriers[i] = {
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+                nullptr, // const void*     pNext
+                (i == 0) ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR : VK_PIPELINE_STAGE_2_NONE_KHR, // srcStageMask
+                (i == 0) ? VK_ACCESS_2_MEMORY_WRITE_BIT_KHR : 0, // VkAccessFlags2KHR        srcAccessMask
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+                (i == 0) ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR : VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+                (i == 0) ? imageLayout : VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout   oldLayout
+                VK_IMAGE_LAYOUT_GENERAL, // VkImageLayout   newLayout
+                VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+                VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+                imageView->GetImageResource()->GetImage(), // VkImage         image;
+                {
+                    // VkImageSubresourceRange   subresourceRange
+                    VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                    0, // uint32_t           baseMipLevel
+                    1, // uint32_t           levelCount
+                    0, // uint32_t           baseArrayLayer
+                    1, // uint32_t           layerCount;
+                },
+        };
+    }
+
+    const VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        numImageBarriers,
+        imageBarriers,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    const VkExtent2D inputExtent { m_encoderConfig->input.width, m_encoderConfig->input.height };
+    VulkanFilterYuvCompute* pScaleFilter = static_cast<VulkanFilterYuvCompute*>(m_simulcastScaleFilter.Get());
+    for (size_t i = 0; i < m_simulcastFrames.size(); i++) {
+        VkSharedBaseObj<VkImageResourceView> rungImageView;
+        m_simulcastFrames[i]->srcEncodeImageResource->GetImageView(rungImageView);
+
+        const EncoderInputImageParameters& rungInput = m_simulcastEncoders[i]->m_encoderConfig->input;
+        const VkExtent2D rungExtent { rungInput.width, rungInput.height };
+        pScaleFilter->RecordCommandBuffer(cmdBuf,
+                                          srcEncodeImageView,
+                                          encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo(),
+                                          inputExtent,
+                                          rungImageView,
+                                          m_simulcastFrames[i]->srcEncodeImageResource->GetPictureResourceInfo(),
+                                          rungExtent);
+    }
 
-    result = m_dpbImagePool->Configure(m_vkDevCtx,
-                                       maxReferencePicturesSlotsCount + 4,
-                                       m_imageDpbFormat,
-                                       imageExtent,
-                                       dpbImageUsage,
-                                       m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
-                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                       encoderConfig->videoCoreProfile.GetProfile(), // pVideoProfile
-                                       false,   // useImageArray      TODO: check properties
-                                       false,   // useImageViewArray  TODO: check properties
-                                       false    // useLinear
-                                      );
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to Configure inputImagePool.\n");
-        return result;
+    // The encode submissions wait on the input semaphores, which make the shader writes available
+    for (uint32_t i = 0; i < numImageBarriers; i++) {
+        imageBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        imageBarriers[i].srcAccessMask = (i == 0) ? 0 : VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+        imageBarriers[i].dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+        imageBarriers[i].dstAccessMask = 0;
+        imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarriers[i].newLayout = (i == 0) ? imageLayout : VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
     }
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+}
 
-    int32_t availableBuffers = (int32_t)m_bitstreamBuffersQueue.GetAvailableNodesNumber();
-    if (availableBuffers < encoderConfig->numBitstreamBuffersToPreallocate) {
+void VkVideoEncoder::RecordSplitFrameBandCopies(VkCommandBuffer cmdBuf,
+                                                VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                                VkImageLayout imageLayout)
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_imageInFormat);
+    assert(mpInfo != nullptr);
+
+    // The input image, written by the commands before, then the images of the bands, overwritten
+    VkImageMemoryBarrier2KHR imageBarriers[1 + EncoderConfig::MAX_SPLIT_FRAME_BANDS];
+    const VkVideoPictureResourceInfoKHR* pictureResourceInfos[1 + EncoderConfig::MAX_SPLIT_FRAME_BANDS];
+    const uint32_t numImageBarriers = 1 + (uint32_t)m_splitFrameFrames.size();
+    assert(numImageBarriers <= ARRAYSIZE(imageBarriers));
+    for (uint32_t i = 0; i < numImageBarriers; i++) {
+        VkSharedBaseObj<VkVideoEncodeFrameInfo>& frameInfo = (i == 0) ? encodeFrameInfo : m_splitFrameFrames[i - 1];
+        VkSharedBaseObj<VkImageResourceView> imageView;
+        frameInfo->srcEncodeImageResource->GetImageView(imageView);
+        pictureResourceInfos[i] = frameInfo->srcEncodeImageResource->GetPictureResourceInfo();
+        imageBarriers[i] = {
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+                nullptr, // const void*     pNext
+                (i == 0) ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR : VK_PIPELINE_STAGE_2_NONE_KHR, // srcStageMask
+                (i == 0) ? VK_ACCESS_2_MEMORY_WRITE_BIT_KHR : 0, // VkAccessFlags2KHR        srcAccessMask
+                VK_PIPELINE_STAGE_2_COPY_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+                (i == 0) ? VK_ACCESS_2_TRANSFER_READ_BIT_KHR : VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+                (i == 0) ? imageLayout : VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout   oldLayout
+                (i == 0) ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // newLayout
+                VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+                VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+                imageView->GetImageResource()->GetImage(), // VkImage         image;
+                {
+                    // VkImageSubresourceRange   subresourceRange
+                    VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                    0, // uint32_t           baseMipLevel
+                    1, // uint32_t           levelCount
+                    pictureResourceInfos[i]->baseArrayLayer, // uint32_t           baseArrayLayer
+                    1, // uint32_t           layerCount;
+                },
+        };
+    }
 
-        uint32_t allocateNumBuffers = std::min<uint32_t>(
-                m_bitstreamBuffersQueue.GetMaxNodes(),
-                (encoderConfig->numBitstreamBuffersToPreallocate - availableBuffers));
+    const VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        numImageBarriers,
+        imageBarriers,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
 
-        allocateNumBuffers = std::min<uint32_t>(allocateNumBuffers,
-                m_bitstreamBuffersQueue.GetFreeNodesNumber());
+    for (uint32_t i = 1; i < numImageBarriers; i++) {
+        uint32_t bandY = 0;
+        uint32_t bandHeight = 0;
+        if (!m_encoderConfig->GetSplitFrameBand(i, bandY, bandHeight)) {
+            assert(!"The band is outside of the picture");
+            continue;
+        }
 
-        for (uint32_t i = 0; i < allocateNumBuffers; i++) {
+        // The rows of the band in the input image, to the top of the band's image
+        VkImageCopy copyRegion[2]{};
+        for (uint32_t plane = 0; plane < 2; plane++) {
+            const VkImageAspectFlagBits aspect = (plane == 0) ? VK_IMAGE_ASPECT_PLANE_0_BIT : VK_IMAGE_ASPECT_PLANE_1_BIT;
+            copyRegion[plane].srcSubresource = { (VkImageAspectFlags)aspect, 0, pictureResourceInfos[0]->baseArrayLayer, 1 };
+            copyRegion[plane].srcOffset = { 0, (int32_t)bandY, 0 };
+            copyRegion[plane].dstSubresource = { (VkImageAspectFlags)aspect, 0, pictureResourceInfos[i]->baseArrayLayer, 1 };
+            copyRegion[plane].extent = { m_encoderConfig->input.width, bandHeight, 1 };
+        }
+        if (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) {
+            copyRegion[1].extent.width = (copyRegion[1].extent.width + 1) / 2;
+        }
+        if (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) {
+            copyRegion[1].srcOffset.y /= 2;
+            copyRegion[1].extent.height = (copyRegion[1].extent.height + 1) / 2;
+        }
 
-            VkSharedBaseObj<VulkanBitstreamBufferImpl> bitstreamBuffer;
-            VkDeviceSize allocSize = std::max<VkDeviceSize>(m_streamBufferSize, m_minStreamBufferSize);
+        m_vkDevCtx->CmdCopyImage(cmdBuf, imageBarriers[0].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 imageBarriers[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 2, copyRegion);
+    }
 
-            result = VulkanBitstreamBufferImpl::Create(m_vkDevCtx,
-                    m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
-                    allocSize,
-                    encoderConfig->videoCapabilities.minBitstreamBufferOffsetAlignment,
-                    encoderConfig->videoCapabilities.minBitstreamBufferSizeAlignment,
-                    nullptr, 0, bitstreamBuffer);
-            assert(result == VK_SUCCESS);
-            if (result != VK_SUCCESS) {
-                fprintf(stderr, "\nERROR: VulkanBitstreamBufferImpl::Create() result: 0x%x\n", result);
-                break;
-            }
+    // The encode submissions wait on the input semaphores, which make the copy writes available
+    for (uint32_t i = 0; i < numImageBarriers; i++) {
+        imageBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+        imageBarriers[i].srcAccessMask = (i == 0) ? 0 : VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+        imageBarriers[i].dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+        imageBarriers[i].dstAccessMask = 0;
+        imageBarriers[i].oldLayout = imageBarriers[i].newLayout;
+        imageBarriers[i].newLayout = (i == 0) ? imageLayout : VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+    }
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+}
 
-            int32_t nodeAddedWithIndex = m_bitstreamBuffersQueue.AddNodeToPool(bitstreamBuffer, false);
-            if (nodeAddedWithIndex < 0) {
-                assert("Could not add the new node to the pool");
-                break;
-            }
+bool VkVideoEncoder::StitchSplitFrameBands(const uint8_t* data, size_t size)
+{
+    m_splitFrameData.clear();
+    bool stitched = AppendSplitFrameBandSlices(data, size, 0, m_splitFrameData);
+    for (size_t i = 0; i < m_splitFrameEncoders.size(); i++) {
+        // Assembled by the band encoder's own thread, in the same order as the frames of this encoder
+        std::vector<uint8_t> bandSlices;
+        if (!m_splitFrameEncoders[i]->m_splitFrameBandSlices.WaitAndPop(bandSlices)) {
+            return false;
         }
+        stitched = AppendSplitFrameBandSlices(bandSlices.data(), bandSlices.size(), (uint32_t)i + 1,
+                                              m_splitFrameData) && stitched;
     }
+    return stitched;
+}
 
-    result = VulkanCommandBufferPool::Create(m_vkDevCtx, m_inputCommandBufferPool);
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to create m_inputCommandBufferPool.\n");
-        return result;
+void VkVideoEncoder::HandOverSplitFrameBandSlices(const uint8_t* data, size_t size)
+{
+    if (m_encoderConfig->splitFrameBandIndex == 0) {
+        return;
     }
+    // Empty on a failure, for the main encoder not to wait for the band
+    std::vector<uint8_t> bandSlices(data, data + size);
+    m_splitFrameBandSlices.Push(bandSlices);
+}
 
-    result = m_inputCommandBufferPool->Configure( m_vkDevCtx,
-                                                  encoderConfig->numInputImages, // numPoolNodes
-                                                  ((m_vkDevCtx->GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) != 0) ?
-                                                      m_vkDevCtx->GetVideoEncodeQueueFamilyIdx() :
-                                                      m_vkDevCtx->GetTransferQueueFamilyIdx(), // queueFamilyIndex
-                                                  false,    // createQueryPool - not needed for the input transfer
-                                                  nullptr,  // pVideoProfile   - not needed for the input transfer
-                                                  true,     // createSemaphores
-                                                  true      // createFences
-                                                 );
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to Configure m_inputCommandBufferPool.\n");
-        return result;
+void VkVideoEncoder::InitInputBufferUpload(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_imageInFormat);
+    assert(mpInfo != nullptr);
+
+    // Tightly packed planes, the chroma plane offset is aligned for the copies on any queue
+    const VkDeviceSize planeOffsetAlignment = 256;
+    const uint32_t bytesPerSample = (mpInfo->planesLayout.bpp != YCBCRA_8BPP) ? 2 : 1;
+    const uint32_t chromaWidth = (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) ?
+                                     (encoderConfig->input.width + 1) / 2 : encoderConfig->input.width;
+    const uint32_t chromaHeight = (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) ?
+                                      (encoderConfig->input.height + 1) / 2 : encoderConfig->input.height;
+
+    m_inputUploadPlaneLayouts[0].offset = 0;
+    m_inputUploadPlaneLayouts[0].rowPitch = (VkDeviceSize)encoderConfig->input.width * bytesPerSample;
+    m_inputUploadPlaneLayouts[0].size = m_inputUploadPlaneLayouts[0].rowPitch * encoderConfig->input.height;
+
+    m_inputUploadPlaneLayouts[1].offset = (m_inputUploadPlaneLayouts[0].size + planeOffsetAlignment - 1) &
+                                              ~(planeOffsetAlignment - 1);
+    m_inputUploadPlaneLayouts[1].rowPitch = (VkDeviceSize)chromaWidth * 2 * bytesPerSample;
+    m_inputUploadPlaneLayouts[1].size = m_inputUploadPlaneLayouts[1].rowPitch * chromaHeight;
+
+    m_inputUploadFrameSize = m_inputUploadPlaneLayouts[1].offset + m_inputUploadPlaneLayouts[1].size;
+
+    // The upload buffers are allocated on first use
+    m_inputStagingBuffers.resize(encoderConfig->numInputImages);
+    m_useInputBufferUpload = true;
+}
+
+uint32_t VkVideoEncoder::GetBitstreamSizeType(VkVideoGopStructure::FrameType pictureType)
+{
+    // The intra refresh frames are P frames with an intra slice
+    const bool isIntra = (pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) ||
+                         (pictureType == VkVideoGopStructure::FRAME_TYPE_I);
+    return isIntra ? BITSTREAM_SIZE_TYPE_INTRA : BITSTREAM_SIZE_TYPE_INTER;
+}
+
+void VkVideoEncoder::InitBitstreamBufferSizes()
+{
+    // The share of the peak frame size an intra and an inter frame can take, times the average of a frame at the
+    // HRD bitrate, derived from the level limits unless given
+    static const uint32_t frameSizeRatio[BITSTREAM_SIZE_NUM_TYPES] = { 8, 2 };
+
+    uint64_t peakFrameSize = 0;
+    if ((m_encoderConfig->rateControlMode != VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) &&
+            (m_encoderConfig->frameRateNumerator > 0)) {
+        const uint64_t peakBitrate = std::max(m_encoderConfig->hrdBitrate, m_encoderConfig->averageBitrate);
+        peakFrameSize = peakBitrate * std::max<uint32_t>(m_encoderConfig->frameRateDenominator, 1) /
+                        (8ULL * m_encoderConfig->frameRateNumerator);
     }
 
-    result = VulkanCommandBufferPool::Create(m_vkDevCtx, m_encodeCommandBufferPool);
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to create m_encodeCommandBufferPool.\n");
-        return result;
+    for (uint32_t sizeType = 0; sizeType < BITSTREAM_SIZE_NUM_TYPES; sizeType++) {
+        m_rateControlFrameSize[sizeType] = peakFrameSize * frameSizeRatio[sizeType];
+        m_peakFrameSize[sizeType] = 0;
+        m_minFrameBufferSize[sizeType] = 0;
     }
+    m_numBitstreamOverflows = 0;
+}
 
-    VkQueryPoolVideoEncodeFeedbackCreateInfoKHR encodeFeedbackCreateInfo =
-        {VK_STRUCTURE_TYPE_QUERY_POOL_VIDEO_ENCODE_FEEDBACK_CREATE_INFO_KHR};
+VkDeviceSize VkVideoEncoder::GetBitstreamBufferSize(VkVideoGopStructure::FrameType pictureType) const
+{
+    if (!m_rightSizedBitstreamBuffers) {
+        return m_streamBufferSize;
+    }
 
-    encodeFeedbackCreateInfo.pNext = encoderConfig->videoCoreProfile.GetProfile();
-    encodeFeedbackCreateInfo.encodeFeedbackFlags = VK_VIDEO_ENCODE_FEEDBACK_BITSTREAM_BUFFER_OFFSET_BIT_KHR |
-                                                   VK_VIDEO_ENCODE_FEEDBACK_BITSTREAM_BYTES_WRITTEN_BIT_KHR;
+    const uint32_t sizeType = GetBitstreamSizeType(pictureType);
+    const VkDeviceSize peakFrameSize = m_peakFrameSize[sizeType];
+    VkDeviceSize size = m_rateControlFrameSize[sizeType];
+    if (peakFrameSize > 0) {
+        // Twice the recent peak of the type
+        size = std::max<VkDeviceSize>(size, 2 * peakFrameSize);
+    } else if (size == 0) {
+        // Nothing to go by before the first frame of the type without a bitrate
+        size = m_streamBufferSize;
+    }
+    // Up to the worst case, or more once a frame of the type overflowed
+    return std::max<VkDeviceSize>(std::min<VkDeviceSize>(size, m_streamBufferSize), m_minFrameBufferSize[sizeType]);
+}
 
-    result = m_encodeCommandBufferPool->Configure( m_vkDevCtx,
-                                                   encoderConfig->numInputImages, // numPoolNodes
-                                                   m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(), // queueFamilyIndex
-                                                   true,      // createQueryPool - not needed for the input transfer
-                                                   &encodeFeedbackCreateInfo, // VideoEncodeFeedback + VideoProfile
-                                                   true,     // createSemaphores
-                                                   true      // createFences
-                                                  );
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to Configure m_encodeCommandBufferPool.\n");
-        return result;
+void VkVideoEncoder::UpdateBitstreamBufferSize(VkVideoGopStructure::FrameType pictureType, VkDeviceSize codedSize,
+                                               VkDeviceSize bufferSize, bool overflow)
+{
+    // Decays over about that many frames of the type
+    static const VkDeviceSize peakFrameSizeDecay = 64;
+
+    const uint32_t sizeType = GetBitstreamSizeType(pictureType);
+    if (overflow) {
+        m_numBitstreamOverflows++;
+        m_minFrameBufferSize[sizeType] = std::max<VkDeviceSize>(m_minFrameBufferSize[sizeType], 2 * bufferSize);
+        return;
     }
 
-    result = CreateFrameInfoBuffersQueue(encoderConfig->numInputImages);
-    if(result != VK_SUCCESS) {
-        fprintf(stderr, "\nInitEncoder Error: Failed to create FrameInfoBuffersQueue.\n");
-        return result;
+    const VkDeviceSize peakFrameSize = m_peakFrameSize[sizeType];
+    m_peakFrameSize[sizeType] = std::max<VkDeviceSize>(codedSize, peakFrameSize - (peakFrameSize / peakFrameSizeDecay));
+}
+
+void VkVideoEncoder::PrintBitstreamBufferSizes()
+{
+    if (!m_rightSizedBitstreamBuffers) {
+        return;
     }
 
-    // Start the queue consumer thread
-    if (m_enableEncoderQueue) {
+    const VkDeviceSize intraSize = GetBitstreamBufferSize(VkVideoGopStructure::FRAME_TYPE_IDR);
+    const VkDeviceSize interSize = GetBitstreamBufferSize(VkVideoGopStructure::FRAME_TYPE_P);
+    std::cout << "Bitstream buffers: intra " << VulkanBitstreamBufferPool::GetAllocationSize(intraSize) / 1024
+              << " KB, inter " << VulkanBitstreamBufferPool::GetAllocationSize(interSize) / 1024
+              << " KB, " << m_numBitstreamOverflows << " overflows" << std::endl;
+}
 
-        const uint32_t maxPendingQueueNodes = 2;
-        m_encoderQueue.SetMaxPendingQueueNodes(std::min<uint32_t>(m_encoderConfig->gopStructure.GetGopFrameCount() + 1, maxPendingQueueNodes));
-        m_encoderQueueConsumerThread = std::thread(&VkVideoEncoder::ConsumerThread, this);
+VkResult VkVideoEncoder::GetDeviceBitstreamBuffer(uint32_t imageIndex, VkDeviceSize size,
+                                                  VkSharedBaseObj<VkBufferResource>& deviceBitstreamBuffer)
+{
+    // Reused only after the previous encode of the input image, grown to the size of its host buffer
+    assert(imageIndex < m_deviceBitstreamBuffers.size());
+    if (!m_deviceBitstreamBuffers[imageIndex] || (m_deviceBitstreamBuffers[imageIndex]->GetMaxSize() < size)) {
+        m_deviceBitstreamBuffers[imageIndex] = nullptr;
+        uint32_t queueFamilyIndex = (uint32_t)m_vkDevCtx->GetVideoEncodeQueueFamilyIdx();
+        VkResult result = VkBufferResource::Create(m_vkDevCtx,
+                                                   VK_BUFFER_USAGE_VIDEO_ENCODE_DST_BIT_KHR |
+                                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                   size,
+                                                   m_deviceBitstreamBuffers[imageIndex],
+                                                   m_encoderConfig->videoCapabilities.minBitstreamBufferOffsetAlignment,
+                                                   m_encoderConfig->videoCapabilities.minBitstreamBufferSizeAlignment,
+                                                   0, nullptr, 1, &queueFamilyIndex);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nGetDeviceBitstreamBuffer Error: Failed to create the device bitstream buffer.\n");
+            return result;
+        }
     }
+
+    deviceBitstreamBuffer = m_deviceBitstreamBuffers[imageIndex];
     return VK_SUCCESS;
 }
 
-VkDeviceSize VkVideoEncoder::GetBitstreamBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer)
+void VkVideoEncoder::RecordBitstreamReadback(VkCommandBuffer cmdBuf,
+                                             VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                             const VkSharedBaseObj<VkBufferResource>& deviceBitstreamBuffer)
+{
+    // The coded size is only known from the query once the encode is done, the whole range is copied.
+    // With the right-sized buffers, it stays close to the frame.
+    const VkDeviceSize copySize = encodeFrameInfo->encodeInfo.dstBufferRange;
+
+    VkBufferMemoryBarrier2KHR bufferBarrier { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR };
+    bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR;
+    bufferBarrier.srcAccessMask = VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT_KHR;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = deviceBitstreamBuffer->GetBuffer();
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = copySize;
+    VkDependencyInfoKHR dependencyInfo { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.bufferMemoryBarrierCount = 1;
+    dependencyInfo.pBufferMemoryBarriers = &bufferBarrier;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    const VkBufferCopy copyRegion = { 0, 0, copySize };
+    m_vkDevCtx->CmdCopyBuffer(cmdBuf, deviceBitstreamBuffer->GetBuffer(),
+                              encodeFrameInfo->outputBitstreamBuffer->GetBuffer(), 1, &copyRegion);
+
+    // Available to the host reads of the assembly, once the fence of the submission is waited on
+    bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+    bufferBarrier.buffer = encodeFrameInfo->outputBitstreamBuffer->GetBuffer();
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+}
+
+VkDeviceSize VkVideoEncoder::GetBitstreamBuffer(VkVideoGopStructure::FrameType pictureType,
+                                                VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer)
 {
-    VkDeviceSize newSize = m_streamBufferSize;
+    const VkDeviceSize requestSize = GetBitstreamBufferSize(pictureType);
+    // Allocate the full size class, so the buffer can go back to the pool for any request of the class
+    VkDeviceSize newSize = VulkanBitstreamBufferPool::GetAllocationSize(requestSize);
     assert(m_vkDevCtx);
 
     VkSharedBaseObj<VulkanBitstreamBufferImpl> newBitstreamBuffer;
@@ -550,9 +2951,13 @@ VkDeviceSize VkVideoEncoder::GetBitstreamBuffer(VkSharedBaseObj<VulkanBitstreamB
     const bool debugBitstreamBufferDumpAlloc = false;
     int32_t availablePoolNode = -1;
     if (enablePool) {
-        availablePoolNode = m_bitstreamBuffersQueue.GetAvailableNodeFromPool(newBitstreamBuffer);
+        availablePoolNode = m_bitstreamBuffersQueue.GetAvailableNodeFromPool(requestSize, newBitstreamBuffer);
+    }
+    if (enablePool && VkMetrics::IsEnabled()) {
+        m_metrics.bitstreamBuffersAvailable.Set(m_bitstreamBuffersQueue.GetAvailableNodesNumber());
     }
     if (!(availablePoolNode >= 0)) {
+        m_metrics.bitstreamBufferAllocations.Add();
         VkResult result = VulkanBitstreamBufferImpl::Create(m_vkDevCtx,
                 m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(),
                 newSize,
@@ -587,7 +2992,7 @@ VkDeviceSize VkVideoEncoder::GetBitstreamBuffer(VkSharedBaseObj<VulkanBitstreamB
             std::cout << "\t\tFrom bitstream buffer pool with size " << newSize << " B, " <<
                              newSize/1024 << " KB, " << newSize/1024/1024 << " MB" << std::endl;
 
-            std::cout << "\t\t\t FreeNodes " << m_bitstreamBuffersQueue.GetFreeNodesNumber();
+            std::cout << "\t\t\t FreeNodes " << m_bitstreamBuffersQueue.GetFreeNodesNumber(newSize);
             std::cout << " of MaxNodes " << m_bitstreamBuffersQueue.GetMaxNodes();
             std::cout << ", AvailableNodes " << m_bitstreamBuffersQueue.GetAvailableNodesNumber();
             std::cout << std::endl;
@@ -604,48 +3009,50 @@ VkDeviceSize VkVideoEncoder::GetBitstreamBuffer(VkSharedBaseObj<VulkanBitstreamB
 
 VkImageLayout VkVideoEncoder::TransitionImageLayout(VkCommandBuffer cmdBuf,
                                                     VkSharedBaseObj<VkImageResourceView>& imageView,
-                                                    VkImageLayout oldLayout, VkImageLayout newLayout)
+                                                    VkImageLayout newLayout,
+                                                    VkPipelineStageFlags2KHR dstStageMask,
+                                                    VkAccessFlags2KHR dstAccessMask)
 {
-    uint32_t baseArrayLayer = 0;
-    const VkImageMemoryBarrier2KHR imageBarrier = {
-
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
-            nullptr, // const void*     pNext
-            VK_PIPELINE_STAGE_2_NONE_KHR, // VkPipelineStageFlags2KHR srcStageMask
-            0, // VkAccessFlags2KHR        srcAccessMask
-            VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
-            VK_ACCESS_2_VIDEO_ENCODE_READ_BIT_KHR, // VkAccessFlags   dstAccessMask
-            oldLayout, // VkImageLayout   oldLayout // FIXME - use the real old layout
-            newLayout, // VkImageLayout   newLayout
-            VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
-            (uint32_t)m_vkDevCtx->GetVideoEncodeQueueFamilyIdx(), // uint32_t   dstQueueFamilyIndex
-            imageView->GetImageResource()->GetImage(), // VkImage         image;
-            {
-                // VkImageSubresourceRange   subresourceRange
-                VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
-                0, // uint32_t           baseMipLevel
-                1, // uint32_t           levelCount
-                baseArrayLayer, // uint32_t           baseArrayLayer
-                1, // uint32_t           layerCount;
-            },
-    };
-
-    const VkDependencyInfoKHR dependencyInfo = {
-        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
-        nullptr,
-        VK_DEPENDENCY_BY_REGION_BIT,
-        0,
-        nullptr,
-        0,
-        nullptr,
-        1,
-        &imageBarrier,
-    };
-    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+    // From the layout and the accesses tracked by the image
+    VkImageBarrierBatch barrierBatch;
+    barrierBatch.AddTransition(imageView->GetImageResource().Get(),
+                               imageView->GetImageSubresourceRange().baseArrayLayer,
+                               newLayout, dstStageMask, dstAccessMask);
+    barrierBatch.Record(m_vkDevCtx, cmdBuf);
 
     return newLayout;
 }
 
+void VkVideoEncoder::RecordDpbBarriers(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    // The setup picture and the references in one dependency, the ones already in the DPB layout elided
+    VkImageBarrierBatch barrierBatch;
+    if (encodeFrameInfo->setupImageResource != nullptr) {
+        VkSharedBaseObj<VkImageResourceView> setupImageView;
+        encodeFrameInfo->setupImageResource->GetImageView(setupImageView);
+        barrierBatch.AddTransition(setupImageView->GetImageResource().Get(),
+                                   encodeFrameInfo->setupImageResource->GetPictureResourceInfo()->baseArrayLayer,
+                                   VK_IMAGE_LAYOUT_VIDEO_ENCODE_DPB_KHR,
+                                   VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR,
+                                   VK_ACCESS_2_VIDEO_ENCODE_READ_BIT_KHR | VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR,
+                                   true);
+    }
+    for (uint32_t i = 0; i < encodeFrameInfo->numDpbImageResources; i++) {
+        // The first entry is the setup picture when there is one
+        if (encodeFrameInfo->dpbImageResources[i] == nullptr) {
+            continue;
+        }
+        VkSharedBaseObj<VkImageResourceView> dpbImageView;
+        encodeFrameInfo->dpbImageResources[i]->GetImageView(dpbImageView);
+        barrierBatch.AddTransition(dpbImageView->GetImageResource().Get(),
+                                   encodeFrameInfo->dpbImageResources[i]->GetPictureResourceInfo()->baseArrayLayer,
+                                   VK_IMAGE_LAYOUT_VIDEO_ENCODE_DPB_KHR,
+                                   VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR,
+                                   VK_ACCESS_2_VIDEO_ENCODE_READ_BIT_KHR);
+    }
+    barrierBatch.Record(m_vkDevCtx, cmdBuf);
+}
+
 VkResult VkVideoEncoder::CopyLinearToOptimalImage(VkCommandBuffer& commandBuffer,
                                                   VkSharedBaseObj<VkImageResourceView>& srcImageView,
                                                   VkSharedBaseObj<VkImageResourceView>& dstImageView,
@@ -667,49 +3074,320 @@ VkResult VkVideoEncoder::CopyLinearToOptimalImage(VkCommandBuffer& commandBuffer
     // Currently formats that have more than 2 output planes are not supported. 444 formats have a shared CbCr planes in all current tests
     assert((mpInfo->vkPlaneFormat[2] == VK_FORMAT_UNDEFINED) && (mpInfo->vkPlaneFormat[3] == VK_FORMAT_UNDEFINED));
 
-    // Copy src buffer to image.
-    VkImageCopy copyRegion[3]{};
-    copyRegion[0].extent = srcImageResource->GetImageCreateInfo().extent;
-    copyRegion[0].srcSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
-    copyRegion[0].srcSubresource.mipLevel = 0;
-    copyRegion[0].srcSubresource.baseArrayLayer = srcCopyArrayLayer;
-    copyRegion[0].srcSubresource.layerCount = 1;
-    copyRegion[0].dstSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
-    copyRegion[0].dstSubresource.mipLevel = 0;
-    copyRegion[0].dstSubresource.baseArrayLayer = dstCopyArrayLayer;
-    copyRegion[0].dstSubresource.layerCount = 1;
-    copyRegion[1].extent.width = copyRegion[0].extent.width;
+    // Copy src buffer to image.
+    VkImageCopy copyRegion[3]{};
+    copyRegion[0].extent = srcImageResource->GetImageCreateInfo().extent;
+    copyRegion[0].srcSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+    copyRegion[0].srcSubresource.mipLevel = 0;
+    copyRegion[0].srcSubresource.baseArrayLayer = srcCopyArrayLayer;
+    copyRegion[0].srcSubresource.layerCount = 1;
+    copyRegion[0].dstSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+    copyRegion[0].dstSubresource.mipLevel = 0;
+    copyRegion[0].dstSubresource.baseArrayLayer = dstCopyArrayLayer;
+    copyRegion[0].dstSubresource.layerCount = 1;
+    copyRegion[1].extent.width = copyRegion[0].extent.width;
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) {
+        copyRegion[1].extent.width /= 2;
+    }
+
+    copyRegion[1].extent.height = copyRegion[0].extent.height;
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) {
+        copyRegion[1].extent.height /= 2;
+    }
+
+    copyRegion[1].extent.depth = 1;
+    copyRegion[1].srcSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
+    copyRegion[1].srcSubresource.mipLevel = 0;
+    copyRegion[1].srcSubresource.baseArrayLayer = srcCopyArrayLayer;
+    copyRegion[1].srcSubresource.layerCount = 1;
+    copyRegion[1].dstSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
+    copyRegion[1].dstSubresource.mipLevel = 0;
+    copyRegion[1].dstSubresource.baseArrayLayer = dstCopyArrayLayer;
+    copyRegion[1].dstSubresource.layerCount = 1;
+
+    m_vkDevCtx->CmdCopyImage(commandBuffer, srcImageResource->GetImage(), srcImageLayout,
+                             dstImageResource->GetImage(), dstImageLayout,
+                             (uint32_t)2, copyRegion);
+
+    {
+        VkMemoryBarrier memoryBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        m_vkDevCtx->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                               1, &memoryBarrier, 0,
+                                0, 0, 0);
+    }
+
+    return VK_SUCCESS;
+}
+
+VulkanDeviceContext::QueueFamilySubmitType VkVideoEncoder::GetInputSubmitType() const
+{
+    return (m_useInputComputeConversion || m_inputRgbaFilter || m_syntheticInput || m_temporalFilter || m_preAnalysis ||
+            m_simulcastScaleFilter) ?
+                VulkanDeviceContext::COMPUTE :
+           ((m_vkDevCtx->GetVideoEncodeQueueFlag() & VK_QUEUE_TRANSFER_BIT) != 0) ?
+                VulkanDeviceContext::ENCODE : VulkanDeviceContext::TRANSFER;
+}
+
+void VkVideoEncoder::CopyInputImageToOptimalImage(VkCommandBuffer commandBuffer,
+                                                  const VkVideoEncodeInputImage& inputImage,
+                                                  VkSharedBaseObj<VkImageResourceView>& dstImageView,
+                                                  uint32_t dstCopyArrayLayer)
+{
+    const VkSharedBaseObj<VkImageResource>& dstImageResource = dstImageView->GetImageResource();
+    const VkImageCreateInfo& dstImageCreateInfo = dstImageResource->GetImageCreateInfo();
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(dstImageCreateInfo.format);
+
+    // Currently formats that have more than 2 output planes are not supported.
+    assert((mpInfo->vkPlaneFormat[2] == VK_FORMAT_UNDEFINED) && (mpInfo->vkPlaneFormat[3] == VK_FORMAT_UNDEFINED));
+
+    // The frame, cropped to the input image of the encoder, in whole chroma samples
+    VkExtent3D extent = { std::min(inputImage.extent.width, dstImageCreateInfo.extent.width),
+                          std::min(inputImage.extent.height, dstImageCreateInfo.extent.height),
+                          1 };
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) {
+        extent.width &= ~1U;
+    }
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) {
+        extent.height &= ~1U;
+    }
+
+    const VkImageSubresourceRange srcSubresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, inputImage.baseArrayLayer, 1 };
+    const VkImageSubresourceRange dstSubresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, dstCopyArrayLayer, 1 };
+
+    // An image owned by a foreign queue is acquired from it
+    uint32_t ownerQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    if (inputImage.ownerQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED) {
+        const VulkanDeviceContext::QueueFamilySubmitType submitType = GetInputSubmitType();
+        ownerQueueFamilyIndex = inputImage.ownerQueueFamilyIndex;
+        queueFamilyIndex = (submitType == VulkanDeviceContext::COMPUTE) ? m_vkDevCtx->GetComputeQueueFamilyIdx() :
+                           (submitType == VulkanDeviceContext::ENCODE)  ? m_vkDevCtx->GetVideoEncodeQueueFamilyIdx() :
+                                                                          m_vkDevCtx->GetTransferQueueFamilyIdx();
+    }
+
+    // The previous content of the encoder input image is discarded
+    VkImageMemoryBarrier2KHR imageBarriers[2] = {
+        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr,
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0,
+          VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR,
+          inputImage.imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          ownerQueueFamilyIndex, queueFamilyIndex,
+          inputImage.image, srcSubresourceRange },
+        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr,
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0,
+          VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+          dstImageResource->GetImage(), dstSubresourceRange },
+    };
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR, nullptr, 0, 0, nullptr, 0, nullptr,
+                                           2, imageBarriers };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+
+    VkImageCopy copyRegion[2]{};
+    for (uint32_t plane = 0; plane < 2; plane++) {
+        const VkImageAspectFlagBits planeAspect = (plane == 0) ? VK_IMAGE_ASPECT_PLANE_0_BIT : VK_IMAGE_ASPECT_PLANE_1_BIT;
+        copyRegion[plane].srcSubresource = { (VkImageAspectFlags)planeAspect, 0, inputImage.baseArrayLayer, 1 };
+        copyRegion[plane].dstSubresource = { (VkImageAspectFlags)planeAspect, 0, dstCopyArrayLayer, 1 };
+        copyRegion[plane].extent = extent;
+    }
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) {
+        copyRegion[1].extent.width /= 2;
+    }
+    if (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) {
+        copyRegion[1].extent.height /= 2;
+    }
+
+    m_vkDevCtx->CmdCopyImage(commandBuffer, inputImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             dstImageResource->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             2, copyRegion);
+
+    // The input image goes back to its producer, the copy to the encoder, the compute filters and the encode
+    imageBarriers[0].srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+    imageBarriers[0].srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT_KHR;
+    imageBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    imageBarriers[0].dstAccessMask = 0;
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarriers[0].newLayout = inputImage.imageLayout;
+    imageBarriers[0].srcQueueFamilyIndex = queueFamilyIndex;
+    imageBarriers[0].dstQueueFamilyIndex = ownerQueueFamilyIndex;
+    imageBarriers[1].srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+    imageBarriers[1].srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+    imageBarriers[1].dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    imageBarriers[1].dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT_KHR;
+    imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+}
+
+void VkVideoEncoder::ConvertInputImageToOptimalImage(VkCommandBuffer commandBuffer,
+                                                     const VkVideoEncodeInputImage& inputImage,
+                                                     VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    VkSharedBaseObj<VkImageResourceView> dstImageView;
+    encodeFrameInfo->srcEncodeImageResource->GetImageView(dstImageView);
+    const VkSharedBaseObj<VkImageResource>& dstImageResource = dstImageView->GetImageResource();
+
+    // The view of the application image replaces the one of the previous frame of the input image, which is
+    // reused only after that frame's encode
+    const uint32_t imageIndex = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
+    assert(imageIndex < m_inputRgbaImageViews.size());
+    if (m_inputRgbaImageViews[imageIndex] != VK_NULL_HANDLE) {
+        m_vkDevCtx->DestroyImageView(*m_vkDevCtx, m_inputRgbaImageViews[imageIndex], nullptr);
+        m_inputRgbaImageViews[imageIndex] = VK_NULL_HANDLE;
+    }
+
+    const VkImageSubresourceRange srcSubresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, inputImage.baseArrayLayer, 1 };
+    VkImageViewCreateInfo viewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, nullptr };
+    viewCreateInfo.image = inputImage.image;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewCreateInfo.format = inputImage.format;
+    viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                  VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+    viewCreateInfo.subresourceRange = srcSubresourceRange;
+    VkResult result = m_vkDevCtx->CreateImageView(*m_vkDevCtx, &viewCreateInfo, nullptr,
+                                                  &m_inputRgbaImageViews[imageIndex]);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nConvertInputImageToOptimalImage Error: Failed to create the view of the RGBA image.\n");
+        return;
+    }
+
+    // An image owned by a foreign queue is acquired from it
+    uint32_t ownerQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    if (inputImage.ownerQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED) {
+        ownerQueueFamilyIndex = inputImage.ownerQueueFamilyIndex;
+        queueFamilyIndex = m_vkDevCtx->GetComputeQueueFamilyIdx();
+    }
+
+    // The previous content of the encoder input image is discarded
+    const VkImageSubresourceRange dstSubresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VkImageMemoryBarrier2KHR imageBarriers[2] = {
+        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr,
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0,
+          VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR,
+          inputImage.imageLayout, VK_IMAGE_LAYOUT_GENERAL,
+          ownerQueueFamilyIndex, queueFamilyIndex,
+          inputImage.image, srcSubresourceRange },
+        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr,
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0,
+          VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+          dstImageResource->GetImage(), dstSubresourceRange },
+    };
+    VkDependencyInfoKHR dependencyInfo = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR, nullptr, 0, 0, nullptr, 0, nullptr,
+                                           2, imageBarriers };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+
+    VulkanFilterYuvCompute* pInputRgbaFilter = static_cast<VulkanFilterYuvCompute*>(m_inputRgbaFilter.Get());
+    pInputRgbaFilter->RecordCommandBuffer(commandBuffer,
+                                          m_inputRgbaImageViews[imageIndex],
+                                          0,
+                                          inputImage.extent,
+                                          dstImageView,
+                                          encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo());
+
+    // The input image goes back to its producer, the conversion to the compute filters and the encode
+    imageBarriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarriers[0].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+    imageBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    imageBarriers[0].dstAccessMask = 0;
+    imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[0].newLayout = inputImage.imageLayout;
+    imageBarriers[0].srcQueueFamilyIndex = queueFamilyIndex;
+    imageBarriers[0].dstQueueFamilyIndex = ownerQueueFamilyIndex;
+    imageBarriers[1].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarriers[1].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    imageBarriers[1].dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    imageBarriers[1].dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT_KHR;
+    imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+}
+
+VkResult VkVideoEncoder::CopyBufferToOptimalImage(VkCommandBuffer commandBuffer,
+                                                  VkSharedBaseObj<VkBufferResource>& srcBuffer,
+                                                  const VkSubresourceLayout planeLayouts[2],
+                                                  VkSharedBaseObj<VkImageResourceView>& dstImageView)
+{
+    const VkSharedBaseObj<VkImageResource>& dstImageResource = dstImageView->GetImageResource();
+    const VkFormat format = dstImageResource->GetImageCreateInfo().format;
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(format);
+
+    // Currently formats that have more than 2 output planes are not supported.
+    assert((mpInfo->vkPlaneFormat[2] == VK_FORMAT_UNDEFINED) && (mpInfo->vkPlaneFormat[3] == VK_FORMAT_UNDEFINED));
+
+    VkImageMemoryBarrier2KHR imageBarrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_NONE_KHR, // VkPipelineStageFlags2KHR srcStageMask
+            0, // VkAccessFlags2KHR        srcAccessMask
+            VK_PIPELINE_STAGE_2_COPY_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+            VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR, // VkAccessFlags   dstAccessMask
+            VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout   oldLayout, the whole frame is overwritten
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // VkImageLayout   newLayout
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+            dstImageResource->GetImage(), // VkImage         image;
+            {
+                // VkImageSubresourceRange   subresourceRange
+                VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                0, // uint32_t           baseMipLevel
+                1, // uint32_t           levelCount
+                0, // uint32_t           baseArrayLayer
+                1, // uint32_t           layerCount;
+            },
+    };
+
+    const VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &imageBarrier,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+
+    const VkExtent3D extent = dstImageResource->GetImageCreateInfo().extent;
+    VkBufferImageCopy copyRegion[2]{};
+    for (uint32_t plane = 0; plane < 2; plane++) {
+        // The buffer rows are tightly packed, bufferRowLength 0
+        copyRegion[plane].bufferOffset = planeLayouts[plane].offset;
+        copyRegion[plane].imageSubresource.aspectMask = (plane == 0) ? VK_IMAGE_ASPECT_PLANE_0_BIT :
+                                                                       VK_IMAGE_ASPECT_PLANE_1_BIT;
+        copyRegion[plane].imageSubresource.mipLevel = 0;
+        copyRegion[plane].imageSubresource.baseArrayLayer = 0;
+        copyRegion[plane].imageSubresource.layerCount = 1;
+        copyRegion[plane].imageExtent.width = m_encoderConfig->input.width;
+        copyRegion[plane].imageExtent.height = m_encoderConfig->input.height;
+        copyRegion[plane].imageExtent.depth = 1;
+    }
     if (mpInfo->planesLayout.secondaryPlaneSubsampledX != 0) {
-        copyRegion[1].extent.width /= 2;
+        copyRegion[1].imageExtent.width = (copyRegion[1].imageExtent.width + 1) / 2;
     }
-
-    copyRegion[1].extent.height = copyRegion[0].extent.height;
     if (mpInfo->planesLayout.secondaryPlaneSubsampledY != 0) {
-        copyRegion[1].extent.height /= 2;
+        copyRegion[1].imageExtent.height = (copyRegion[1].imageExtent.height + 1) / 2;
     }
+    assert((m_encoderConfig->input.width <= extent.width) && (m_encoderConfig->input.height <= extent.height));
 
-    copyRegion[1].extent.depth = 1;
-    copyRegion[1].srcSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
-    copyRegion[1].srcSubresource.mipLevel = 0;
-    copyRegion[1].srcSubresource.baseArrayLayer = srcCopyArrayLayer;
-    copyRegion[1].srcSubresource.layerCount = 1;
-    copyRegion[1].dstSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
-    copyRegion[1].dstSubresource.mipLevel = 0;
-    copyRegion[1].dstSubresource.baseArrayLayer = dstCopyArrayLayer;
-    copyRegion[1].dstSubresource.layerCount = 1;
-
-    m_vkDevCtx->CmdCopyImage(commandBuffer, srcImageResource->GetImage(), srcImageLayout,
-                             dstImageResource->GetImage(), dstImageLayout,
-                             (uint32_t)2, copyRegion);
+    m_vkDevCtx->CmdCopyBufferToImage(commandBuffer, srcBuffer->GetBuffer(), dstImageResource->GetImage(),
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 2, copyRegion);
 
-    {
-        VkMemoryBarrier memoryBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
-        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-        m_vkDevCtx->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                               1, &memoryBarrier, 0,
-                                0, 0, 0);
-    }
+    // The encode submission waits on the input semaphore, which makes the copy writes available
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
 
     return VK_SUCCESS;
 }
@@ -758,7 +3436,8 @@ VkResult VkVideoEncoder::HandleCtrlCmd(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
         }
 
         encodeFrameInfo->rateControlInfo.pLayers = encodeFrameInfo->rateControlLayersInfo;
-        encodeFrameInfo->rateControlInfo.layerCount = 1;
+        // One rate control layer per temporal layer
+        encodeFrameInfo->rateControlInfo.layerCount = std::max<uint32_t>(m_encoderConfig->gopStructure.GetTemporalLayerCount(), 1);
 
         if (pNext != nullptr) {
             encodeFrameInfo->rateControlInfo.pNext = pNext;
@@ -811,9 +3490,33 @@ VkResult VkVideoEncoder::RecordVideoCodingCmd(VkSharedBaseObj<VkVideoEncodeFrame
     // Instead we use the input image index that should be unique for each frame.
     querySlotId = (uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex();
 
-    // Clear the query results
+    VkSharedBaseObj<VkBufferResource> deviceBitstreamBuffer;
+    if (m_deviceLocalBitstream) {
+        // Encoded into device memory instead of the host buffer of the frame, copied there after the encode
+        VkResult result = GetDeviceBitstreamBuffer(querySlotId, encodeFrameInfo->encodeInfo.dstBufferRange,
+                                                   deviceBitstreamBuffer);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        encodeFrameInfo->encodeInfo.dstBuffer = deviceBitstreamBuffer->GetBuffer();
+    }
+
+    // The feedback queries are taken in turn, for the in-flight frames to be read in one call.
+    // A slot comes back after m_numFeedbackQuerySlots submissions, once its frame has released its input image.
+    const uint32_t feedbackQuerySlot = m_nextFeedbackQuerySlot;
+    m_nextFeedbackQuerySlot = (m_nextFeedbackQuerySlot + 1) % m_numFeedbackQuerySlots;
+    encodeFrameInfo->feedbackQuerySlot = feedbackQuerySlot;
+    encodeFrameInfo->encodeStatusFetched = false;
+
+    // Clear the query results, inline queries must be reset before the encode too
     const uint32_t numQuerySamples = 1;
-    vkDevCtx->CmdResetQueryPool(cmdBuf, queryPool, querySlotId, numQuerySamples);
+    vkDevCtx->CmdResetQueryPool(cmdBuf, queryPool, feedbackQuerySlot, numQuerySamples);
+
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->CmdResetSlot(cmdBuf, querySlotId);
+    }
+
+    RecordDpbBarriers(cmdBuf, encodeFrameInfo);
 
     vkDevCtx->CmdBeginVideoCodingKHR(cmdBuf, &encodeBeginInfo);
 
@@ -825,15 +3528,45 @@ VkResult VkVideoEncoder::RecordVideoCodingCmd(VkSharedBaseObj<VkVideoEncodeFrame
         vkDevCtx->CmdControlVideoCodingKHR(cmdBuf, &renderControlInfo);
     }
 
-    vkDevCtx->CmdBeginQuery(cmdBuf, queryPool, querySlotId, VkQueryControlFlags());
+    const void* pEncodeInfoNext = encodeFrameInfo->encodeInfo.pNext;
+#ifdef VK_KHR_video_maintenance1
+    // The session was created for inline queries, the feedback query is then part of the encode command
+    VkVideoInlineQueryInfoKHR inlineQueryInfo { VK_STRUCTURE_TYPE_VIDEO_INLINE_QUERY_INFO_KHR,
+                                                pEncodeInfoNext,
+                                                queryPool,
+                                                feedbackQuerySlot,
+                                                numQuerySamples };
+    if (m_videoMaintenance1FeaturesSupported == 1) {
+        encodeFrameInfo->encodeInfo.pNext = &inlineQueryInfo;
+    } else
+#endif // VK_KHR_video_maintenance1
+    {
+        vkDevCtx->CmdBeginQuery(cmdBuf, queryPool, feedbackQuerySlot, VkQueryControlFlags());
+    }
+
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->CmdWriteBegin(cmdBuf, querySlotId);
+    }
 
     vkDevCtx->CmdEncodeVideoKHR(cmdBuf, &encodeFrameInfo->encodeInfo);
 
-    vkDevCtx->CmdEndQuery(cmdBuf, queryPool, querySlotId);
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->CmdWriteEnd(cmdBuf, querySlotId);
+    }
+
+    if (m_videoMaintenance1FeaturesSupported == 0) {
+        vkDevCtx->CmdEndQuery(cmdBuf, queryPool, feedbackQuerySlot);
+    }
+    // Make sure we do not keep a dangling (on the stack) pointer in the frame
+    encodeFrameInfo->encodeInfo.pNext = pEncodeInfoNext;
 
     VkVideoEndCodingInfoKHR encodeEndInfo { VK_STRUCTURE_TYPE_VIDEO_END_CODING_INFO_KHR };
     vkDevCtx->CmdEndVideoCodingKHR(cmdBuf, &encodeEndInfo);
 
+    if (deviceBitstreamBuffer) {
+        RecordBitstreamReadback(cmdBuf, encodeFrameInfo, deviceBitstreamBuffer);
+    }
+
     // ******* End recording of the video commands *************
 
     VkResult result = encodeCmdBuffer->EndCommandBufferRecording(cmdBuf);
@@ -841,17 +3574,16 @@ VkResult VkVideoEncoder::RecordVideoCodingCmd(VkSharedBaseObj<VkVideoEncodeFrame
     return result;
 }
 
-VkResult VkVideoEncoder::RecordVideoCodingCmds(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
-                                               uint32_t numFrames)
+VkResult VkVideoEncoder::RecordVideoCodingCmds(OrderedFrames& frames)
 {
-
-    uint32_t processedFramesCount = 0; // Initialize the counter
-    VkResult result = VkVideoEncodeFrameInfo::ProcessFrames(this, encodeFrameInfo,
-                                                            processedFramesCount, numFrames,
-       [this](VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame, uint32_t frameIdx, uint32_t ofTotalFrames)
-             { return RecordVideoCodingCmd(frame, frameIdx, ofTotalFrames); });
-
-    return result;
+    const uint32_t numFrames = (uint32_t)frames.size();
+    for (uint32_t frameIdx = 0; frameIdx < numFrames; frameIdx++) {
+        VkResult result = RecordVideoCodingCmd(frames[frameIdx], frameIdx, numFrames);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+    return VK_SUCCESS;
 }
 
 VkResult VkVideoEncoder::SubmitVideoCodingCmds(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
@@ -863,29 +3595,106 @@ VkResult VkVideoEncoder::SubmitVideoCodingCmds(VkSharedBaseObj<VkVideoEncodeFram
     // If we are processing the input staging, wait for it's semaphore
     // to be done before processing the input frame with the encoder.
     VkSemaphore inputWaitSemaphore = VK_NULL_HANDLE;
+    uint64_t inputWaitValue = 0; // the value of the binary semaphore is ignored
     if (encodeFrameInfo->inputCmdBuffer) {
         inputWaitSemaphore = encodeFrameInfo->inputCmdBuffer->GetSemaphore();
+        inputWaitValue = encodeFrameInfo->inputCmdBuffer->GetSignalValue();
     }
 
     const VkCommandBuffer* pCmdBuf = encodeFrameInfo->encodeCmdBuffer->GetCommandBuffer();
     VkSemaphore frameCompleteSemaphore = encodeFrameInfo->encodeCmdBuffer->GetSemaphore();
+    const uint64_t frameCompleteValue = encodeFrameInfo->encodeCmdBuffer->AssignSignalValue();
+
+    VkSemaphore waitSemaphores[3] = { inputWaitSemaphore, VK_NULL_HANDLE, VK_NULL_HANDLE };
+    uint64_t waitSemaphoreValues[3] = { inputWaitValue, 0, 0 };
+    uint32_t waitSemaphoreCount = (inputWaitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    if (inputWaitValue > 0) {
+        timelineSemaphoreInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+        timelineSemaphoreInfo.pWaitSemaphoreValues = waitSemaphoreValues;
+    }
+    uint32_t encodeQueueIndex = m_encodeQueueIndex;
+    if (m_numEncodeQueues > 1) {
+        encodeQueueIndex = (m_encodeQueueIndex + m_nextEncodeQueue++) % m_numEncodeQueues;
+        if (encodeFrameInfo->controlCmd != VkVideoCodingControlFlagsKHR()) {
+            m_controlCmdQueue = encodeQueueIndex;
+            m_controlCmdSemaphore = frameCompleteSemaphore;
+            m_controlCmdValue = frameCompleteValue;
+        } else if ((encodeQueueIndex != m_controlCmdQueue) && (m_controlCmdValue > 0)) {
+            // After the reset and the control commands of the session, submitted on another queue
+            waitSemaphores[waitSemaphoreCount] = m_controlCmdSemaphore;
+            waitSemaphoreValues[waitSemaphoreCount] = m_controlCmdValue;
+            waitSemaphoreCount++;
+            timelineSemaphoreInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+            timelineSemaphoreInfo.pWaitSemaphoreValues = waitSemaphoreValues;
+        }
+    }
+    const bool compareQuality = m_qualityMetrics && encodeFrameInfo->setupImageResource;
+    if (m_qualityMetrics && (m_qualityMetrics->GetLastSubmittedValue() > 0)) {
+        // The comparisons change the layouts of the reconstructed pictures this frame may reference
+        waitSemaphores[waitSemaphoreCount] = m_qualityMetrics->GetCompleteTimelineSemaphore();
+        waitSemaphoreValues[waitSemaphoreCount] = m_qualityMetrics->GetLastSubmittedValue();
+        waitSemaphoreCount++;
+        timelineSemaphoreInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+        timelineSemaphoreInfo.pWaitSemaphoreValues = waitSemaphoreValues;
+    }
 
-    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr };
-    const VkPipelineStageFlags videoEncodeSubmitWaitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-    submitInfo.pWaitSemaphores = (inputWaitSemaphore != VK_NULL_HANDLE) ? &inputWaitSemaphore : nullptr;
-    submitInfo.waitSemaphoreCount = (inputWaitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
-    submitInfo.pWaitDstStageMask = &videoEncodeSubmitWaitStages;
+    if (frameCompleteValue > 0) {
+        timelineSemaphoreInfo.signalSemaphoreValueCount = 1;
+        timelineSemaphoreInfo.pSignalSemaphoreValues = &frameCompleteValue;
+    }
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                                ((timelineSemaphoreInfo.waitSemaphoreValueCount > 0) ||
+                                 (timelineSemaphoreInfo.signalSemaphoreValueCount > 0)) ? &timelineSemaphoreInfo : nullptr };
+    const VkPipelineStageFlags videoEncodeSubmitWaitStages[3] = { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+    submitInfo.pWaitSemaphores = (waitSemaphoreCount > 0) ? waitSemaphores : nullptr;
+    submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pWaitDstStageMask = videoEncodeSubmitWaitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = pCmdBuf;
     submitInfo.pSignalSemaphores = (frameCompleteSemaphore != VK_NULL_HANDLE) ? &frameCompleteSemaphore : nullptr;
     submitInfo.signalSemaphoreCount = (frameCompleteSemaphore != VK_NULL_HANDLE) ? 1 : 0;
 
     VkFence queueCompleteFence = encodeFrameInfo->encodeCmdBuffer->GetFence();
-    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::ENCODE, 0,
+    VkResult result = m_vkDevCtx->MultiThreadedQueueSubmit(VulkanDeviceContext::ENCODE, encodeQueueIndex,
                                                            1, &submitInfo,
                                                            queueCompleteFence);
 
     encodeFrameInfo->encodeCmdBuffer->SetCommandBufferSubmitted();
+
+    if ((result == VK_SUCCESS) && compareQuality) {
+        // The reconstructed picture against the input, once the frame is encoded
+        VkSharedBaseObj<VkImageResourceView> srcEncodeImageView;
+        encodeFrameInfo->srcEncodeImageResource->GetImageView(srcEncodeImageView);
+        VkSharedBaseObj<VkImageResourceView> setupImageView;
+        encodeFrameInfo->setupImageResource->GetImageView(setupImageView);
+        VkResult metricsResult = m_qualityMetrics->Submit((uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex(),
+                                                          frameCompleteSemaphore,
+                                                          frameCompleteValue,
+                                                          srcEncodeImageView,
+                                                          encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo()->baseArrayLayer,
+                                                          VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR,
+                                                          setupImageView,
+                                                          encodeFrameInfo->setupImageResource->GetPictureResourceInfo()->baseArrayLayer,
+                                                          VK_IMAGE_LAYOUT_VIDEO_ENCODE_DPB_KHR);
+        encodeFrameInfo->qualityMetricsSubmitted = (metricsResult == VK_SUCCESS);
+        if (metricsResult != VK_SUCCESS) {
+            fprintf(stderr, "\nSubmitVideoCodingCmds Warning: Failed to compare the reconstructed frame (%d).\n", metricsResult);
+        }
+    }
+
+    if (m_gpuTimestamps) {
+        if (frameCompleteValue > 0) {
+            m_gpuTimestamps->SetSubmitted((uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex(),
+                                          encodeFrameInfo->frameInputOrderNum, frameCompleteSemaphore, frameCompleteValue);
+        } else {
+            m_gpuTimestamps->SetSubmitted((uint32_t)encodeFrameInfo->srcEncodeImageResource->GetImageIndex(),
+                                          encodeFrameInfo->frameInputOrderNum, queueCompleteFence);
+        }
+    }
     bool syncCpuAfterStaging = false;
     if (syncCpuAfterStaging) {
         encodeFrameInfo->encodeCmdBuffer->SyncHostOnCmdBuffComplete();
@@ -896,50 +3705,120 @@ VkResult VkVideoEncoder::SubmitVideoCodingCmds(VkSharedBaseObj<VkVideoEncodeFram
 
 VkResult VkVideoEncoder::PushOrderedFrames()
 {
-    VkResult result = VK_SUCCESS;
-    if (m_lastDeferredFrame) {
+    if (m_numDeferredFrames == 0) {
+        return VK_SUCCESS;
+    }
 
-        if (m_enableEncoderQueue) {
+    // Collect the batch in decode order, in a single pass over the occupied slots, which hand their references over
+    m_orderedFrames.reserve(m_numDeferredFrames);
+    for (uint32_t position = m_firstDeferredFramePosition; position <= m_lastDeferredFramePosition; position++) {
+        if (m_reorderBuffer[position] != nullptr) {
+            m_orderedFrames.push_back(m_reorderBuffer[position].Detach());
+        }
+    }
+    assert(m_orderedFrames.size() == m_numDeferredFrames);
+    m_numDeferredFrames = 0;
+    m_nextDecodePosition = m_lastDeferredFramePosition + 1;
 
-            bool success = m_encoderQueue.Push(m_lastDeferredFrame);
-            if (success) {
-                m_lastDeferredFrame = nullptr;
-            } else {
-                assert(!"Queue returned not ready");
-                result = VK_NOT_READY;
-            }
+    return SubmitOrderedFrames();
+}
 
-        } else {
+VkResult VkVideoEncoder::PushReadyFrames()
+{
+    while ((m_numDeferredFrames > 0) && (m_nextDecodePosition < MAX_REORDER_FRAMES) &&
+               (m_reorderBuffer[m_nextDecodePosition] != nullptr)) {
+        m_orderedFrames.push_back(m_reorderBuffer[m_nextDecodePosition].Detach());
+        m_numDeferredFrames--;
+        m_nextDecodePosition++;
+    }
+    if (m_orderedFrames.empty()) {
+        return VK_SUCCESS;
+    }
+    // The slots left are all past the pushed ones
+    m_firstDeferredFramePosition = m_nextDecodePosition;
+
+    return SubmitOrderedFrames();
+}
 
-            result = ProcessOrderedFrames(m_lastDeferredFrame, m_numDeferredFrames);
+VkResult VkVideoEncoder::SubmitOrderedFrames()
+{
+    VkResult result = VK_SUCCESS;
+    if (m_enableEncoderQueue) {
 
-            VkVideoEncodeFrameInfo::ReleaseChildrenFrames(m_lastDeferredFrame);
-            assert(m_lastDeferredFrame == nullptr);
+        // The batch is moved to the queue
+        bool success = m_encoderQueue.Push(m_orderedFrames);
+        m_metrics.encoderQueueDepth.Set((double)m_encoderQueue.Size());
+        if (!success) {
+            assert(!"Queue returned not ready");
+            result = VK_NOT_READY;
         }
-        m_numDeferredFrames = 0;
+
+    } else {
+
+        result = ProcessOrderedFrames(m_orderedFrames);
     }
+    m_orderedFrames.clear();
     return result;
 }
 
-VkResult VkVideoEncoder::ProcessOrderedFrames(VkSharedBaseObj<VkVideoEncodeFrameInfo>& frames, uint32_t numFrames) {
+VkResult VkVideoEncoder::ProcessOrderedFrames(OrderedFrames& frames) {
+
+    const uint32_t numFrames = (uint32_t)frames.size();
+    if (m_useStagePipeline) {
+        // Each frame moves on to the stage threads once its DPB is processed, in decode order
+        for (uint32_t frameIdx = 0; frameIdx < numFrames; frameIdx++) {
+            PrintVideoCodingLink(frames[frameIdx], frameIdx, numFrames);
+            const std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+            VkResult result = VK_SUCCESS;
+            {
+                VK_TRACE_ZONE_FRAME("ProcessDpb", frames[frameIdx]->frameInputOrderNum);
+                result = ProcessDpb(frames[frameIdx], frameIdx, numFrames);
+            }
+            AddBenchmarkStageTime(BENCHMARK_STAGE_DPB, stageStart);
+            if (result != VK_SUCCESS) {
+                return result;
+            }
+            // The batch is cleared once processed, the queue takes the reference over
+            if (!m_recordStageQueue.Push(frames[frameIdx])) {
+                return VK_NOT_READY;
+            }
+            m_metrics.recordQueueDepth.Set((double)m_recordStageQueue.Size());
+        }
+        return m_stagePipelineResult;
+    }
 
-    std::vector<std::pair<std::string, std::function<VkResult(VkSharedBaseObj<VkVideoEncodeFrameInfo>&, uint32_t, uint32_t)>>> callbacks = {
-        {"PrintVideoCodingLink",  [this](VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame, uint32_t frameIdx, uint32_t ofTotalFrames) { return PrintVideoCodingLink(frame, frameIdx, ofTotalFrames); }},
-        {"ProcessDpb",            [this](VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame, uint32_t frameIdx, uint32_t ofTotalFrames) { return ProcessDpb(frame, frameIdx, ofTotalFrames); }},
-        {"RecordVideoCodingCmd",  [this](VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame, uint32_t frameIdx, uint32_t ofTotalFrames) { return RecordVideoCodingCmd(frame, frameIdx, ofTotalFrames); }},
-        {"SubmitVideoCodingCmds", [this](VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame, uint32_t frameIdx, uint32_t ofTotalFrames) { return SubmitVideoCodingCmds(frame, frameIdx, ofTotalFrames); }},
-        {"AssembleBitstreamData", [this](VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame, uint32_t frameIdx, uint32_t ofTotalFrames) { return AssembleBitstreamData(frame, frameIdx, ofTotalFrames); }}
+    // A static table, so that no callable is built per batch
+    typedef VkResult (VkVideoEncoder::*StageFunction)(VkSharedBaseObj<VkVideoEncodeFrameInfo>&, uint32_t, uint32_t);
+    static const struct {
+        const char*    description;
+        StageFunction  function;
+        BenchmarkStage benchmarkStage;
+    } stages[] = {
+        { "PrintVideoCodingLink",  &VkVideoEncoder::PrintVideoCodingLink,  BENCHMARK_NUM_STAGES }, // not timed
+        { "ProcessDpb",            &VkVideoEncoder::ProcessDpb,            BENCHMARK_STAGE_DPB },
+        { "RecordVideoCodingCmd",  &VkVideoEncoder::RecordVideoCodingCmd,  BENCHMARK_STAGE_RECORD },
+        { "SubmitVideoCodingCmds", &VkVideoEncoder::SubmitVideoCodingCmds, BENCHMARK_STAGE_SUBMIT },
+        { "AssembleBitstreamData", &VkVideoEncoder::AssembleOrRetireFrame, BENCHMARK_STAGE_ASSEMBLE },
     };
 
     VkResult result = VK_SUCCESS;
-    for (const auto& pair : callbacks) {
-        const auto& callback = pair.second;
+    for (const auto& stage : stages) {
 
+        const std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
         uint32_t processedFramesCount = 0;
-        result = VkVideoEncodeFrameInfo::ProcessFrames(this, frames, processedFramesCount, numFrames, callback);
+        for (; processedFramesCount < numFrames; processedFramesCount++) {
+            // A zone per frame and timed stage
+            VkTraceZone traceZone((stage.benchmarkStage != BENCHMARK_NUM_STAGES) ? stage.description : nullptr,
+                                  frames[processedFramesCount]->frameInputOrderNum);
+            result = (this->*stage.function)(frames[processedFramesCount], processedFramesCount, numFrames);
+            if (result != VK_SUCCESS) {
+                break;
+            }
+        }
+        AddBenchmarkStageTime(stage.benchmarkStage, stageStart);
         if (m_encoderConfig->verbose) {
-            const std::string& description = pair.first;
-            std::cout << "====== Total number of frames processed by " << description << ": " << processedFramesCount << " : " << result << std::endl;
+            VK_LOG_INFO("====== Total number of frames processed by %s: %u : %d\n",
+                        stage.description, processedFramesCount, result);
         }
 
         if (result != VK_SUCCESS) {
@@ -950,8 +3829,31 @@ VkResult VkVideoEncoder::ProcessOrderedFrames(VkSharedBaseObj<VkVideoEncodeFrame
     return result;
 }
 
+VkResult VkVideoEncoder::AssembleOrRetireFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                               uint32_t frameIdx, uint32_t ofTotalFrames)
+{
+    if (m_encoderConfig->encodeInFlightFrames == 0) {
+        return AssembleBitstreamData(encodeFrameInfo, frameIdx, ofTotalFrames);
+    }
+    // Left encoding while the next frames are submitted, the completed ones are assembled here.
+    // This is the last stage of the batch, which is cleared after it.
+    m_inFlightFrames.push_back(encodeFrameInfo.Detach());
+    m_metrics.inFlightFrames.Set((double)m_inFlightFrames.size());
+    return RetireInFlightFrames(m_encoderConfig->encodeInFlightFrames);
+}
+
 bool VkVideoEncoder::WaitForThreadsToComplete()
 {
+    // The frames loaded ahead are staged before the deferred ones are flushed
+    StagePendingInputFrames(0);
+    EncodeLookAheadFrames(0);
+
+    // The slices of all the bands are handed over before the frames still deferred here are assembled
+    bool bandsRetired = true;
+    for (VkSharedBaseObj<VkVideoEncoder>& splitFrameEncoder : m_splitFrameEncoders) {
+        bandsRetired = splitFrameEncoder->WaitForThreadsToComplete() && bandsRetired;
+    }
+
     PushOrderedFrames();
 
     if (m_enableEncoderQueue) {
@@ -961,7 +3863,20 @@ bool VkVideoEncoder::WaitForThreadsToComplete()
         }
     }
 
-    return true;
+    // The frames still encoding are assembled once the consumer thread is done submitting
+    StopStagePipeline();
+    bool retired = (RetireInFlightFrames(0) == VK_SUCCESS) && (m_stagePipelineResult == VK_SUCCESS) && bandsRetired;
+
+    // All of their frames were handed over by now
+    for (VkSharedBaseObj<VkVideoEncoder>& simulcastEncoder : m_simulcastEncoders) {
+        retired = simulcastEncoder->WaitForThreadsToComplete() && retired;
+    }
+
+    if (m_bitstreamWriter) {
+        return m_bitstreamWriter->Flush() && retired;
+    }
+
+    return retired;
 }
 
 int32_t VkVideoEncoder::DeinitEncoder()
@@ -969,18 +3884,95 @@ int32_t VkVideoEncoder::DeinitEncoder()
 
     m_displayQueue.Flush();
 
-    m_lastDeferredFrame = nullptr;
+    StopStagePipeline();
+
+    // Joins the loader threads once their frames are loaded, those not staged by now are dropped
+    m_inputLoaderThreadPool.reset();
+    m_pendingInputFrames.clear();
+    m_lookAheadFrames.clear();
+    m_inputConversionThreadPool.reset();
+
+    // Writes out what is left of the bitstream
+    m_bitstreamWriter = nullptr;
+
+    for (uint32_t position = 0; position < MAX_REORDER_FRAMES; position++) {
+        m_reorderBuffer[position] = nullptr;
+    }
+    m_numDeferredFrames = 0;
+    m_nextDecodePosition = 0;
+
+    // All the queues the frames were spread over
+    for (uint32_t queue = 0; queue < m_numEncodeQueues; queue++) {
+        m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::ENCODE,
+                                               (m_numEncodeQueues > 1) ? queue : m_encodeQueueIndex);
+    }
+
+    // Not retired by WaitForThreadsToComplete on errors, dropped
+    m_inFlightFrames.clear();
+
+    // With the device time of the encodes, before the timestamps are released
+    PrintBenchmarkStats();
+    PrintInputStats();
+    if (m_inputConversionSelector) {
+        m_inputConversionSelector->PrintStats();
+        m_inputConversionSelector.reset();
+    }
+
+    if (m_gpuTimestamps) {
+        m_gpuTimestamps->PrintStats();
+        m_gpuTimestamps = nullptr;
+    }
+
+    PrintFrameLatencies();
+    PrintQualityMetrics();
+    if (m_frameStats) {
+        m_frameStats->Close();
+        m_frameStats = nullptr;
+    }
+    PrintBitstreamBufferSizes();
+
+    if (m_encoderConfig->firstPass && !m_twoPassFrameStats.empty()) {
+        VkVideoEncoderTwoPass::WriteStats(m_encoderConfig->twoPassStatsFileName.c_str(), m_twoPassFrameStats);
+        m_twoPassFrameStats.clear();
+    }
 
-    m_vkDevCtx->MultiThreadedQueueWaitIdle(VulkanDeviceContext::ENCODE, 0);
+    // The attached encoders are done with the frames of the input submissions by now
+    m_simulcastFrames.clear();
+    m_simulcastEncoders.clear();
+    m_splitFrameFrames.clear();
+    m_splitFrameEncoders.clear();
+    m_simulcastScaleFilter = nullptr;
+
+    m_inputComputeFilter = nullptr;
+    m_inputRgbaFilter = nullptr;
+    for (VkImageView& imageView : m_inputRgbaImageViews) {
+        if (imageView != VK_NULL_HANDLE) {
+            m_vkDevCtx->DestroyImageView(*m_vkDevCtx, imageView, nullptr);
+        }
+    }
+    m_inputRgbaImageViews.clear();
+    m_syntheticInput = nullptr;
+    m_temporalFilter = nullptr;
+    m_preAnalysis = nullptr;
+    m_qualityMetrics = nullptr;
+    m_inputStagingBuffers.clear();
+    m_inputHostImport = nullptr;
+    m_deviceBitstreamBuffers.clear();
 
     m_linearInputImagePool = nullptr;
     m_inputImagePool       = nullptr;
     m_dpbImagePool         = nullptr;
 
+    m_preRecordedInputCmdBuffersValid.clear();
+    m_preRecordedInputCmdBuffers.DestroyCommandBuffer();
+    m_preRecordedInputCmdBuffers.DestroyCommandBufferPool();
+
     m_inputCommandBufferPool  = nullptr;
     m_encodeCommandBufferPool = nullptr;
 
     m_videoSessionParameters =  nullptr;
+    m_encodedSessionParametersHandle = VK_NULL_HANDLE;
+    m_encodedSessionParameters.clear();
     m_videoSession = nullptr;
 
     m_encoderConfig = nullptr;
@@ -990,25 +3982,310 @@ int32_t VkVideoEncoder::DeinitEncoder()
 
 void VkVideoEncoder::ConsumerThread()
 {
-   std::cout << "ConsumerThread is stating now.\n" << std::endl;
+   VK_LOG_DEBUG("ConsumerThread is stating now.\n");
    do {
-       VkSharedBaseObj<VkVideoEncodeFrameInfo> encodeFrameInfo;
-       bool success = m_encoderQueue.WaitAndPop(encodeFrameInfo);
-       if (success) { // 5 seconds in nanoseconds
-           std::cout << "==>>>> Consumed: " << (uint32_t)encodeFrameInfo->positionInGopInDisplayOrder
-                      << ", Order: " << (uint32_t)encodeFrameInfo->positionInGopInDecodeOrder << std::endl << std::flush;
-
-           VkResult result = ProcessOrderedFrames(encodeFrameInfo, 0);
+       OrderedFrames frames;
+       bool success = m_encoderQueue.WaitAndPop(frames);
+       if (success && !frames.empty()) { // 5 seconds in nanoseconds
+           VK_LOG_DEBUG("==>>>> Consumed: %u, Order: %u, Frames: %zu\n",
+                        (uint32_t)frames.front()->positionInGopInDisplayOrder,
+                        (uint32_t)frames.front()->positionInGopInDecodeOrder, frames.size());
+
+           VkResult result = ProcessOrderedFrames(frames);
            if (result != VK_SUCCESS) {
-               std::cout << "Error processing frames from the frame thread!" << std::endl;
+               VK_LOG_ERROR("Error processing frames from the frame thread!\n");
                m_encoderQueue.SetFlushAndExit();
            }
 
        } else {
            bool shouldExit = m_encoderQueue.ExitQueue();
-           std::cout << "Thread should exit: " << (shouldExit ? "Yes" : "No") << std::endl;
+           VK_LOG_DEBUG("Thread should exit: %s\n", (shouldExit ? "Yes" : "No"));
        }
    } while (!m_encoderQueue.ExitQueue());
 
-   std::cout << "ConsumerThread is exiting now.\n" << std::endl;
+   VK_LOG_DEBUG("ConsumerThread is exiting now.\n");
+}
+
+void VkVideoEncoder::SetStagePipelineError(VkResult result)
+{
+    VkResult noError = VK_SUCCESS;
+    m_stagePipelineResult.compare_exchange_strong(noError, result);
+}
+
+void VkVideoEncoder::RecordStageThread()
+{
+    VkTrace::SetThreadName("Encoder record stage");
+    VkSharedBaseObj<VkVideoEncodeFrameInfo> encodeFrameInfo;
+    while (m_recordStageQueue.WaitAndPop(encodeFrameInfo)) {
+
+        // After an error, the frames are dropped until the pipeline is drained
+        if (m_stagePipelineResult != VK_SUCCESS) {
+            encodeFrameInfo = nullptr;
+            continue;
+        }
+
+        const uint64_t frameId = encodeFrameInfo->frameInputOrderNum;
+        const std::chrono::steady_clock::time_point recordStart = std::chrono::steady_clock::now();
+        VkResult result = VK_SUCCESS;
+        {
+            VK_TRACE_ZONE_FRAME("RecordVideoCodingCmd", frameId);
+            result = RecordVideoCodingCmd(encodeFrameInfo, 0, 1);
+        }
+        AddBenchmarkStageTime(BENCHMARK_STAGE_RECORD, recordStart);
+        if (result == VK_SUCCESS) {
+            const std::chrono::steady_clock::time_point submitStart = std::chrono::steady_clock::now();
+            VK_TRACE_ZONE_FRAME("SubmitVideoCodingCmds", frameId);
+            result = SubmitVideoCodingCmds(encodeFrameInfo, 0, 1);
+            AddBenchmarkStageTime(BENCHMARK_STAGE_SUBMIT, submitStart);
+        }
+
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nRecordStageThread Error: Failed to record or submit the frame (%d).\n", result);
+            SetStagePipelineError(result);
+            encodeFrameInfo = nullptr;
+        } else if (!m_assembleStageQueue.Push(encodeFrameInfo)) {
+            SetStagePipelineError(VK_NOT_READY);
+        } else {
+            m_metrics.assembleQueueDepth.Set((double)m_assembleStageQueue.Size());
+        }
+    }
+}
+
+void VkVideoEncoder::AssembleStageThread()
+{
+    VkTrace::SetThreadName("Encoder assemble stage");
+    VkSharedBaseObj<VkVideoEncodeFrameInfo> encodeFrameInfo;
+    while (m_assembleStageQueue.WaitAndPop(encodeFrameInfo)) {
+
+        // Submitted frames are still assembled after an error, the output stays in order up to it
+        const std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+        VkResult result = AssembleBitstreamData(encodeFrameInfo, 0, 1);
+        AddBenchmarkStageTime(BENCHMARK_STAGE_ASSEMBLE, stageStart);
+        if (result != VK_SUCCESS) {
+            fprintf(stderr, "\nAssembleStageThread Error: Failed to assemble the frame (%d).\n", result);
+            SetStagePipelineError(result);
+        }
+
+        // Releases the frame's input image, command buffer and bitstream buffer
+        encodeFrameInfo = nullptr;
+    }
+}
+
+void VkVideoEncoder::StopStagePipeline()
+{
+    if (!m_useStagePipeline) {
+        return;
+    }
+
+    // Drained in the stage order, the record thread pushes its last frames to the assemble thread
+    m_recordStageQueue.SetFlushAndExit();
+    if (m_recordStageThread.joinable()) {
+        m_recordStageThread.join();
+    }
+
+    m_assembleStageQueue.SetFlushAndExit();
+    if (m_assembleStageThread.joinable()) {
+        m_assembleStageThread.join();
+    }
+}
+
+VkResult VkVideoEncoder::EncodeFrameLowLatency(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    VkResult result = ProcessDpb(encodeFrameInfo, 0, 1);
+    if (result == VK_SUCCESS) {
+        result = RecordVideoCodingCmd(encodeFrameInfo, 0, 1);
+    }
+    if (result == VK_SUCCESS) {
+        result = SubmitVideoCodingCmds(encodeFrameInfo, 0, 1);
+    }
+    if (result == VK_SUCCESS) {
+        result = AssembleBitstreamData(encodeFrameInfo, 0, 1);
+    }
+
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nEncodeFrameLowLatency Error: Failed to encode the frame %llu (%d).\n",
+                (unsigned long long)encodeFrameInfo->frameInputOrderNum, result);
+    }
+    return result;
+}
+
+static double LatencyPercentile(std::vector<double>& values, uint32_t percentile)
+{
+    const size_t index = std::min(values.size() - 1, (values.size() * percentile) / 100);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void VkVideoEncoder::PrintFrameLatencies()
+{
+    if (m_frameLatenciesMs.empty()) {
+        return;
+    }
+
+    if (!m_encoderConfig->lowLatencyCsvFileName.empty()) {
+        FILE* csvFile = fopen(m_encoderConfig->lowLatencyCsvFileName.c_str(), "w");
+        if (csvFile == nullptr) {
+            fprintf(stderr, "\nERROR: Can't open the latency CSV file %s\n", m_encoderConfig->lowLatencyCsvFileName.c_str());
+        } else {
+            fprintf(csvFile, "frame,input_to_bitstream_ms\n");
+            for (size_t frame = 0; frame < m_frameLatenciesMs.size(); frame++) {
+                fprintf(csvFile, "%zu,%.4f\n", frame, m_frameLatenciesMs[frame]);
+            }
+            fclose(csvFile);
+        }
+    }
+
+    std::vector<double> latencies(m_frameLatenciesMs);
+    const double maxLatency = *std::max_element(latencies.begin(), latencies.end());
+    printf("Input to bitstream latency over %zu frames (ms):\n", latencies.size());
+    printf("\tp50 %8.3f p99 %8.3f max %8.3f\n", LatencyPercentile(latencies, 50), LatencyPercentile(latencies, 99), maxLatency);
+
+    m_frameLatenciesMs.clear();
+}
+
+void VkVideoEncoder::AddBenchmarkStageTime(BenchmarkStage stage, const std::chrono::steady_clock::time_point& start)
+{
+    if (!m_encoderConfig->enableBenchmark || (stage >= BENCHMARK_NUM_STAGES)) {
+        return;
+    }
+    const std::chrono::nanoseconds stageTime = std::chrono::steady_clock::now() - start;
+    m_benchmarkStageTimeNs[stage].fetch_add((uint64_t)stageTime.count(), std::memory_order_relaxed);
+}
+
+void VkVideoEncoder::PrintBenchmarkStats()
+{
+    if (!m_encoderConfig || !m_encoderConfig->enableBenchmark || (m_numBenchmarkFrames == 0)) {
+        return;
+    }
+
+    const double seconds = std::chrono::duration<double>(m_benchmarkEndTime - m_benchmarkStartTime).count();
+    const double numFrames = (double)m_numBenchmarkFrames;
+    printf("Benchmark: %llu frames of %ux%u in %.3f s, %.2f fps\n", (unsigned long long)m_numBenchmarkFrames,
+           m_encoderConfig->encodeWidth, m_encoderConfig->encodeHeight, seconds,
+           (seconds > 0.0) ? (numFrames / seconds) : 0.0);
+
+    if (m_gpuTimestamps) {
+        // The share of the run the encode queue spent on the encode commands
+        size_t numSamples = 0;
+        const double gpuTimeMs = m_gpuTimestamps->GetTotalGpuTimeMs(&numSamples);
+        printf("\tEncode device time %.3f ms per frame, busy %.1f%% of the run\n",
+               (numSamples > 0) ? (gpuTimeMs / numSamples) : 0.0,
+               (seconds > 0.0) ? (gpuTimeMs / (10.0 * seconds)) : 0.0);
+    }
+
+    static const char* const stageNames[BENCHMARK_NUM_STAGES] = { "input", "dpb", "record", "submit", "assemble" };
+    printf("\tCPU time per frame (ms):");
+    for (uint32_t stage = 0; stage < BENCHMARK_NUM_STAGES; stage++) {
+        printf(" %s %.3f", stageNames[stage], (double)m_benchmarkStageTimeNs[stage].load() / (numFrames * 1.0e6));
+    }
+    printf("\n");
+
+    // The bitrate at the configured frame rate, not the encode one
+    const double frameRate = (m_encoderConfig->frameRateDenominator > 0) ?
+                                 ((double)m_encoderConfig->frameRateNumerator / m_encoderConfig->frameRateDenominator) :
+                                 0.0;
+    printf("\tBitstream %llu bytes, %.0f bytes per frame, %.1f kbit/s at %.3f fps\n",
+           (unsigned long long)m_numBenchmarkBytes, (double)m_numBenchmarkBytes / numFrames,
+           (double)m_numBenchmarkBytes * 8.0 * frameRate / (numFrames * 1000.0), frameRate);
+
+    m_numBenchmarkFrames = 0;
+}
+
+// The major page faults taken reading the mapped input file, before the input file is closed
+void VkVideoEncoder::PrintInputStats()
+{
+    if (!m_encoderConfig || !m_encoderConfig->inputFileHandler.IsMapped() ||
+        !(m_encoderConfig->enableBenchmark || m_encoderConfig->verbose || m_encoderConfig->enableInputHugePages ||
+          m_encoderConfig->enableInputHostImport || (m_encoderConfig->inputPrefaultFrames > 0))) {
+        return;
+    }
+
+    uint64_t prefaultMajorFaults = 0;
+    const uint64_t majorFaults = m_encoderConfig->inputFileHandler.GetMajorFaults(&prefaultMajorFaults);
+    printf("Input: %llu major page faults since the file was mapped", (unsigned long long)majorFaults);
+    if (m_encoderConfig->inputPrefaultFrames > 0) {
+        printf(", %llu of them on the prefault thread", (unsigned long long)prefaultMajorFaults);
+    }
+    printf("\n");
+    if (m_encoderConfig->enableInputHostImport) {
+        printf("Input: %llu frames read in place from the imported file\n", (unsigned long long)m_numInputHostImportFrames);
+    }
+}
+
+VkResult VkVideoEncoder::InitQualityMetrics(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    // The reconstructed pictures are read in the DPB format, with the storage usage
+    const VkVideoProfileListInfoKHR videoProfiles = { VK_STRUCTURE_TYPE_VIDEO_PROFILE_LIST_INFO_KHR, nullptr, 1,
+                                                      encoderConfig->videoCoreProfile.GetProfile() };
+    const VkPhysicalDeviceVideoFormatInfoKHR videoFormatInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VIDEO_FORMAT_INFO_KHR,
+                                                                 &videoProfiles,
+                                                                 (VK_IMAGE_USAGE_VIDEO_ENCODE_DPB_BIT_KHR |
+                                                                  VK_IMAGE_USAGE_STORAGE_BIT) };
+    uint32_t supportedFormatCount = 0;
+    VkResult result = m_vkDevCtx->GetPhysicalDeviceVideoFormatPropertiesKHR(m_vkDevCtx->getPhysicalDevice(), &videoFormatInfo,
+                                                                            &supportedFormatCount, nullptr);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    VkFormat supportedFormats[8];
+    uint32_t formatCount = std::min<uint32_t>(supportedFormatCount, sizeof(supportedFormats) / sizeof(supportedFormats[0]));
+    if (formatCount > 0) {
+        result = VulkanVideoCapabilities::GetVideoFormats(m_vkDevCtx, encoderConfig->videoCoreProfile,
+                                                          videoFormatInfo.imageUsage, formatCount, supportedFormats);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+    if (std::find(supportedFormats, supportedFormats + formatCount, m_imageDpbFormat) == (supportedFormats + formatCount)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    const VkExtent2D extent { encoderConfig->encodeWidth, encoderConfig->encodeHeight };
+    return VulkanQualityMetrics::Create(m_vkDevCtx, m_imageInFormat, m_imageDpbFormat, extent,
+                                        encoderConfig->numInputImages, m_qualityMetrics);
+}
+
+void VkVideoEncoder::PrintQualityMetrics()
+{
+    if (m_frameQualityMetrics.empty()) {
+        return;
+    }
+
+    // In input order, the frames are assembled in encode order
+    std::sort(m_frameQualityMetrics.begin(), m_frameQualityMetrics.end(),
+              [](const FrameQualityMetrics& a, const FrameQualityMetrics& b) { return a.frameInputOrderNum < b.frameInputOrderNum; });
+
+    FILE* csvFile = fopen(m_encoderConfig->qualityMetricsCsvFileName.c_str(), "w");
+    if (csvFile == nullptr) {
+        fprintf(stderr, "\nERROR: Can't open the quality metrics CSV file %s\n", m_encoderConfig->qualityMetricsCsvFileName.c_str());
+    } else {
+        fprintf(csvFile, "frame,mse_y,mse_u,mse_v,psnr_y,psnr_u,psnr_v,ssim_y,ssim_u,ssim_v\n");
+    }
+
+    VulkanQualityMetrics::FrameMetrics average{};
+    for (const FrameQualityMetrics& frameQualityMetrics : m_frameQualityMetrics) {
+        const VulkanQualityMetrics::FrameMetrics& metrics = frameQualityMetrics.metrics;
+        if (csvFile != nullptr) {
+            fprintf(csvFile, "%llu,%.8f,%.8f,%.8f,%.4f,%.4f,%.4f,%.6f,%.6f,%.6f\n",
+                    (unsigned long long)frameQualityMetrics.frameInputOrderNum,
+                    metrics.mse[0], metrics.mse[1], metrics.mse[2],
+                    metrics.psnr[0], metrics.psnr[1], metrics.psnr[2],
+                    metrics.ssim[0], metrics.ssim[1], metrics.ssim[2]);
+        }
+        for (uint32_t plane = 0; plane < VulkanQualityMetrics::NUM_PLANES; plane++) {
+            average.mse[plane] += metrics.mse[plane];
+            average.psnr[plane] += metrics.psnr[plane];
+            average.ssim[plane] += metrics.ssim[plane];
+        }
+    }
+    if (csvFile != nullptr) {
+        fclose(csvFile);
+    }
+
+    const double numFrames = (double)m_frameQualityMetrics.size();
+    printf("Quality of the reconstructed frames over %zu frames (Y U V):\n", m_frameQualityMetrics.size());
+    printf("\tPSNR %8.3f %8.3f %8.3f dB\n", average.psnr[0] / numFrames, average.psnr[1] / numFrames, average.psnr[2] / numFrames);
+    printf("\tSSIM %8.5f %8.5f %8.5f\n", average.ssim[0] / numFrames, average.ssim[1] / numFrames, average.ssim[2] / numFrames);
+
+    m_frameQualityMetrics.clear();
 }
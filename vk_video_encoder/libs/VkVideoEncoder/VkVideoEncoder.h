@@ -20,6 +20,13 @@
 #include <assert.h>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
 #include "VkCodecUtils/VkVideoRefCountBase.h"
 #include "VkVideoEncoderDef.h"
 #include "VkVideoEncoder/VkEncoderConfig.h"
@@ -29,11 +36,29 @@
 #include "VkCodecUtils/VulkanVideoImagePool.h"
 #include "VkCodecUtils/VulkanBufferPool.h"
 #include "VkCodecUtils/VulkanCommandBufferPool.h"
+#include "VkCodecUtils/VulkanCommandBuffersSet.h"
 #include "VkCodecUtils/VulkanVideoReferenceCountedPool.h"
+#include "VkCodecUtils/VulkanVideoSizeClassRefCountedPool.h"
 #include "VkCodecUtils/VkBufferResource.h"
 #include "VkCodecUtils/VulkanBistreamBufferImpl.h"
+#include "VkCodecUtils/VulkanHostMappedBitstream.h"
+#include "VkCodecUtils/VulkanVideoGpuTimestamps.h"
+#include "VkCodecUtils/VulkanFilterYuvCompute.h"
+#include "VkCodecUtils/VkThreadPool.h"
+#include "VkCodecUtils/VkConversionPathSelector.h"
+#include "VkCodecUtils/VkLockFreeQueue.h"
+#include "VkCodecUtils/VkThreadSafeQueue.h"
+#include "VkCodecUtils/VkMetrics.h"
+#include "VkVideoEncoder/VkVideoEncoderBitstreamWriter.h"
+#include "VkVideoEncoder/VkVideoEncoderPreAnalysis.h"
+#include "VkVideoEncoder/VkVideoEncoderTemporalFilter.h"
+#include "VkVideoEncoder/VkVideoEncoderSyntheticInput.h"
+#include "VkVideoEncoder/VkVideoEncoderTwoPass.h"
+#include "VkVideoEncoder/VkVideoEncoderFrameStats.h"
+#include "VkCodecUtils/VulkanQualityMetrics.h"
 #include "VkEncoderDpbH264.h"
 #include "VkCodecUtils/VulkanVideoEncodeDisplayQueue.h"
+#include "VkCodecUtils/VulkanDecodedFrame.h"
 #include "VkShell/Shell.h"
 #include "mio/mio.hpp"
 
@@ -44,10 +69,62 @@ class VkVideoEncoder : public VkVideoRefCountBase {
 
 public:
 
-    using VulkanBitstreamBufferPool = VulkanVideoRefCountedPool<VulkanBitstreamBufferImpl, 64>;
+    using VulkanBitstreamBufferPool = VulkanVideoSizeClassRefCountedPool<VulkanBitstreamBufferImpl, 64>;
 
     enum { MAX_IMAGE_REF_RESOURCES = 17 }; /* List of reference pictures 16 + 1 for current */
     enum { MAX_BITSTREAM_HEADER_BUFFER_SIZE = 256 };
+    enum { MAX_REORDER_FRAMES = 256 }; /* Indexed by the uint8_t positionInGopInDecodeOrder */
+    enum { STAGE_PIPELINE_RECORD_DEPTH = 4, STAGE_PIPELINE_DEFAULT_ASSEMBLE_DEPTH = 4 };
+    enum { ADAPTIVE_GOP_DEFAULT_LOOK_AHEAD = 8 };
+
+    // An image on the device the input frame is copied from, like a capture, a rendered or a decoded picture.
+    // In the encoder input format, GetInputImageFormat(), with the transfer src usage.
+    struct VkVideoEncodeInputImage {
+        VkImage       image;
+        VkFormat      format;
+        uint32_t      baseArrayLayer;
+        VkImageLayout imageLayout;     // the layout the image is in, and is left in by the copy
+        VkExtent2D    extent;          // of the frame in the image, cropped to the encoder input size
+        VkSemaphore   waitSemaphore;   // signaled once the frame is written to the image, optional
+        uint64_t      waitValue;       // of a timeline waitSemaphore, 0 for a binary one
+        VkSemaphore   signalSemaphore; // signaled once the frame is copied from the image, optional
+        uint64_t      signalValue;     // of a timeline signalSemaphore, 0 for a binary one
+        // VK_QUEUE_FAMILY_FOREIGN_EXT for an image imported from another API or device, like the dma-buf of a
+        // capture device, acquired for the copy and released back to it, VK_QUEUE_FAMILY_IGNORED otherwise
+        uint32_t      ownerQueueFamilyIndex;
+        // The region of interest QP deltas of the frame, see VkVideoEncodeFrameInfo::SetQpDeltaMap(), optional
+        const int8_t* pQpDeltaMap;
+        uint32_t      qpDeltaMapWidth;
+        uint32_t      qpDeltaMapHeight;
+
+        VkVideoEncodeInputImage()
+            : image(VK_NULL_HANDLE), format(VK_FORMAT_UNDEFINED), baseArrayLayer(0)
+            , imageLayout(VK_IMAGE_LAYOUT_UNDEFINED), extent(), waitSemaphore(VK_NULL_HANDLE), waitValue(0)
+            , signalSemaphore(VK_NULL_HANDLE), signalValue(0), ownerQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            , pQpDeltaMap(nullptr), qpDeltaMapWidth(0), qpDeltaMapHeight(0) {}
+    };
+
+    // With packetFraming, each coded frame is written as this header followed by its access unit: the parameter
+    // sets sent with the frame, then its slices, in Annex-B. The fields are in the byte order of the host.
+    struct VkVideoEncodePacketHeader {
+        enum { MAGIC = 0x4B505656 }; // "VVPK"
+        enum Flags { FLAG_KEYFRAME = 1 << 0, FLAG_PARAMETER_SETS = 1 << 1, FLAG_LAST_FRAME = 1 << 2 };
+        uint32_t magic;
+        uint32_t size;         // of the access unit following the header
+        uint64_t pts;          // the input time stamp of the frame
+        uint64_t dts;          // the position of the frame in the coded order, from 0
+        uint32_t flags;
+        uint8_t  pictureType;  // VkVideoGopStructure::FrameType
+        uint8_t  temporalId;
+        uint16_t headerSize;   // sizeof(VkVideoEncodePacketHeader), the fields added later follow
+    };
+
+    // The results of the encode feedback query of a frame
+    struct VkVideoEncodeStatus {
+        uint32_t bitstreamStartOffset;
+        uint32_t bitstreamSize;
+        VkQueryResultStatusKHR status;
+    };
 
     struct VkVideoEncodeFrameInfo : public VkVideoRefCountBase
     {
@@ -65,10 +142,14 @@ public:
             , picOrderCntVal(-1)
             , pictureType(VkVideoGopStructure::FRAME_TYPE_IDR)
             , inputTimeStamp(0)
+            , inputReadyTime()
             , bitstreamHeaderBufferSize(0)
             , bitstreamHeaderOffset(0)
             , bitstreamHeaderBuffer{}
             , constQp()
+            , lookAheadComplexity()
+            , lookAheadQpDeltas()
+            , adaptiveBFrameCount(-1)
             , qualityLevel()
             , islongTermReference(false)
             , sendControlCmd(false)
@@ -76,6 +157,16 @@ public:
             , sendQualityLevelCmd(false)
             , sendRateControlCmd(false)
             , lastFrame(false)
+            , hasLookAheadComplexity(false)
+            , sceneCut(false)
+            , qualityMetricsSubmitted(false)
+            , encodeStatusFetched(false)
+            , inputComputeConversion(false)
+            , feedbackQuerySlot((uint32_t)-1)
+            , encodeStatus()
+            , qpDeltaMap()
+            , qpDeltaMapWidth(0)
+            , qpDeltaMapHeight(0)
             , numDpbImageResources()
             , controlCmd()
             , pControlCmdChain(nullptr)
@@ -87,6 +178,8 @@ public:
             , videoSession()
             , videoSessionParameters()
             , srcStagingImageView()
+            , inputHostImport()
+            , inputHostImportOffset(0)
             , srcEncodeImageResource()
             , setupImageResource()
             , outputBitstreamBuffer()
@@ -114,10 +207,14 @@ public:
         int32_t                                            picOrderCntVal;
         VkVideoGopStructure::FrameType                     pictureType;
         uint64_t                                           inputTimeStamp;
+        std::chrono::steady_clock::time_point              inputReadyTime; // once the frame is read, for the low-latency report
         size_t                                             bitstreamHeaderBufferSize;
         uint32_t                                           bitstreamHeaderOffset;
         uint8_t                                            bitstreamHeaderBuffer[MAX_BITSTREAM_HEADER_BUFFER_SIZE];
         ConstQpSettings                                    constQp;
+        VkVideoEncoderPreAnalysis::FrameComplexity         lookAheadComplexity; // valid with hasLookAheadComplexity
+        VkVideoEncoderPreAnalysis::QpDeltas                lookAheadQpDeltas;   // of the constant QP
+        int8_t                                             adaptiveBFrameCount; // of the GOP started by the frame, -1 if not adapted
         uint32_t                                           qualityLevel;
         uint32_t                                           islongTermReference : 1;
         uint32_t                                           sendControlCmd      : 1;
@@ -125,24 +222,44 @@ public:
         uint32_t                                           sendQualityLevelCmd : 1;
         uint32_t                                           sendRateControlCmd  : 1;
         uint32_t                                           lastFrame           : 1;
+        uint32_t                                           hasLookAheadComplexity : 1;
+        uint32_t                                           sceneCut            : 1; // coded as an IDR frame
+        uint32_t                                           qualityMetricsSubmitted : 1; // its reconstructed picture compared
+        uint32_t                                           encodeStatusFetched : 1; // encodeStatus read in a batch
+        uint32_t                                           inputComputeConversion : 1; // else converted on the CPU
+        uint32_t                                           feedbackQuerySlot;   // of the encode feedback query
+        VkVideoEncodeStatus                                encodeStatus;
+        std::vector<int8_t>                                qpDeltaMap;          // qpDeltaMapWidth x qpDeltaMapHeight
+        uint32_t                                           qpDeltaMapWidth;
+        uint32_t                                           qpDeltaMapHeight;
         uint32_t                                           numDpbImageResources;
         VkVideoCodingControlFlagsKHR                       controlCmd;
         VkBaseInStructure *                                pControlCmdChain;
         VkVideoEncodeQualityLevelInfoKHR                   qualityLevelInfo;
         VkVideoEncodeRateControlInfoKHR                    rateControlInfo;
-        VkVideoEncodeRateControlLayerInfoKHR               rateControlLayersInfo[1];
+        VkVideoEncodeRateControlLayerInfoKHR               rateControlLayersInfo[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
         VkVideoReferenceSlotInfoKHR                        referenceSlotsInfo[MAX_IMAGE_REF_RESOURCES];
         VkVideoReferenceSlotInfoKHR                        setupReferenceSlotInfo;
         VkSharedBaseObj<VulkanVideoSession>                videoSession;
         VkSharedBaseObj<VulkanVideoSessionParameters>      videoSessionParameters;
         VkSharedBaseObj<VulkanVideoImagePoolNode>          srcStagingImageView;
+        VkSharedBaseObj<VulkanHostMappedMemory>            inputHostImport; // the frame is read in place from it
+        VkDeviceSize                                       inputHostImportOffset;
         VkSharedBaseObj<VulkanVideoImagePoolNode>          srcEncodeImageResource;
         VkSharedBaseObj<VulkanVideoImagePoolNode>          setupImageResource;
         VkSharedBaseObj<VulkanBitstreamBuffer>             outputBitstreamBuffer;
         VkSharedBaseObj<VulkanVideoImagePoolNode>          dpbImageResources[MAX_IMAGE_REF_RESOURCES];
         VkSharedBaseObj<VulkanCommandBufferPool::PoolNode> inputCmdBuffer;
         VkSharedBaseObj<VulkanCommandBufferPool::PoolNode> encodeCmdBuffer;
-        VkSharedBaseObj<VkVideoEncodeFrameInfo>            dependantFrames;
+
+        // Region of interest: the QP offsets of a grid of blocks over the picture in raster order, e.g. one per
+        // MB or CTB, set before LoadNextFrame(). With the rate control disabled on a device with a per slice
+        // constant QP, each slice is offset by the average of the deltas of its rows. Cleared with the frame.
+        void SetQpDeltaMap(const int8_t* qpDeltas, uint32_t width, uint32_t height) {
+            qpDeltaMap.assign(qpDeltas, qpDeltas + (size_t)width * height);
+            qpDeltaMapWidth = width;
+            qpDeltaMapHeight = height;
+        }
 
         VkResult SyncHostOnCmdBuffComplete() {
 
@@ -157,45 +274,6 @@ public:
             return VK_SUCCESS;
         }
 
-        static void ReleaseChildrenFrames(VkSharedBaseObj<VkVideoEncodeFrameInfo>& dependantFrames) {
-
-            if (dependantFrames == nullptr) {
-                // Base case: if frame is null, do nothing
-                return;
-            }
-
-            // Recursive case: process the next frame first
-            ReleaseChildrenFrames(dependantFrames->dependantFrames);
-
-            // After processing the next frame, reset the current frame
-            dependantFrames = nullptr;
-        }
-
-        template <typename Callback>
-        static VkResult ProcessFrames(VkVideoEncoder* encoder,
-                                      VkSharedBaseObj<VkVideoEncodeFrameInfo>& frame,
-                                      uint32_t& processFramesIndex,
-                                      uint32_t  totalFrameCount,
-                                      Callback callback)
-        {
-            if (frame == nullptr) {
-                return VK_SUCCESS;  // Base case: No more frames, return success
-            }
-
-            // Invoke the callback for the current frame
-            VkResult result = callback(frame, processFramesIndex, totalFrameCount);
-            if (result != VK_SUCCESS) {
-                return result;  // If an error occurred, return the error code
-            }
-
-            // Increment the counter after processing the current frame
-            processFramesIndex++;
-
-            // Recursive call to process the next frame
-            return ProcessFrames(encoder, frame->dependantFrames,
-                                 processFramesIndex, totalFrameCount, callback);
-        }
-
         virtual void Reset(bool releaseResources = true) {
             // Clear and check state
             assert(encodeInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_INFO_KHR);
@@ -223,6 +301,17 @@ public:
             sendQualityLevelCmd = false;
             sendRateControlCmd = false;
             lastFrame = false;
+            hasLookAheadComplexity = false;
+            sceneCut = false;
+            qualityMetricsSubmitted = false;
+            encodeStatusFetched = false;
+            inputComputeConversion = false;
+            feedbackQuerySlot = (uint32_t)-1;
+            qpDeltaMap.clear();
+            qpDeltaMapWidth = 0;
+            qpDeltaMapHeight = 0;
+            lookAheadQpDeltas = VkVideoEncoderPreAnalysis::QpDeltas();
+            adaptiveBFrameCount = -1;
             controlCmd = VkVideoCodingControlFlagsKHR();
             pControlCmdChain = nullptr;
             assert(qualityLevelInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_QUALITY_LEVEL_INFO_KHR);
@@ -239,6 +328,8 @@ public:
                 videoSession = nullptr;
                 videoSessionParameters = nullptr;
                 srcStagingImageView = nullptr;
+                inputHostImport = nullptr;
+                inputHostImportOffset = 0;
                 srcEncodeImageResource = nullptr;
                 setupImageResource = nullptr;
                 outputBitstreamBuffer = nullptr;
@@ -249,9 +340,6 @@ public:
                 numDpbImageResources = 0;
                 inputCmdBuffer = nullptr;
                 encodeCmdBuffer = nullptr;
-
-                // recurse and free the children frames
-                ReleaseChildrenFrames(dependantFrames);
             }
         }
 
@@ -267,9 +355,13 @@ public:
         {
             uint32_t ret = --m_refCount;
             if (ret == 1) {
-                m_parent->ReleasePoolNodeToPool(m_parentIndex);
+                // Detach before handing the node back, the pool is lock-free and
+                // another thread may acquire and re-parent it right away.
+                VkSharedBaseObj<VulkanBufferPoolIf> parent(m_parent);
+                const int32_t parentIndex = m_parentIndex;
                 m_parentIndex = -1;
                 m_parent = nullptr;
+                parent->ReleasePoolNodeToPool(parentIndex);
             } else if (ret == 0) {
                 // Destroy the resources if ref-count reaches zero
             }
@@ -375,14 +467,28 @@ public:
         , m_vkDevCtx(vkDevCtx)
         , m_inputFrameNum(0)
         , m_encodeFrameNum(0)
+        , m_framesSinceIdr(0)
         , m_videoSession()
         , m_videoSessionParameters()
         , m_imageDpbFormat()
         , m_imageInFormat()
         , m_maxCodedExtent()
         , m_maxActiveReferencePictures(16)
+        , m_encodeQueueIndex(0)
+        , m_numEncodeQueues(1)
+        , m_nextEncodeQueue(0)
+        , m_controlCmdQueue(0)
+        , m_controlCmdSemaphore()
+        , m_controlCmdValue(0)
         , m_minStreamBufferSize(2 * 1024 * 1024)
         , m_streamBufferSize(m_minStreamBufferSize)
+        , m_rateControlFrameSize()
+        , m_peakFrameSize()
+        , m_minFrameBufferSize()
+        , m_numBitstreamOverflows(0)
+        , m_numFeedbackQuerySlots(0)
+        , m_nextFeedbackQuerySlot(0)
+        , m_feedbackQueryResults()
         , m_rateControlInfo{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_RATE_CONTROL_INFO_KHR }
         , m_rateControlLayersInfo{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_RATE_CONTROL_LAYER_INFO_KHR }
         , m_picIdxToDpb{}
@@ -399,10 +505,22 @@ public:
         , m_useImageViewArray(false)
         , m_useSeparateOutputImages(false)
         , m_useLinearInput(false)
+        , m_useInputComputeConversion(false)
+        , m_useInputBufferUpload(false)
+        , m_useInputHostImport(false)
         , m_resetEncoder(false)
         , m_enableEncoderQueue(false)
+        , m_useStagePipeline(false)
+        , m_lowLatency(false)
+        , m_packetFraming(false)
+        , m_rightSizedBitstreamBuffers(false)
+        , m_deviceLocalBitstream(false)
+        , m_adaptiveGop(false)
         , m_verbose(false)
         , m_numDeferredFrames()
+        , m_firstDeferredFramePosition()
+        , m_lastDeferredFramePosition()
+        , m_nextDecodePosition()
         , m_controlCmd(VK_VIDEO_CODING_CONTROL_RESET_BIT_KHR |
                        VK_VIDEO_CODING_CONTROL_ENCODE_QUALITY_LEVEL_BIT_KHR |
                        VK_VIDEO_CODING_CONTROL_ENCODE_RATE_CONTROL_BIT_KHR)
@@ -411,8 +529,76 @@ public:
         , m_dpbImagePool()
         , m_inputCommandBufferPool()
         , m_encodeCommandBufferPool()
+        , m_preRecordedInputCmdBuffers()
+        , m_preRecordedInputCmdBuffersValid()
+        , m_numPreRecordedStagingSlots(0)
+        , m_gpuTimestamps()
+        , m_autoQualityGpuTimeMs(0.0)
+        , m_autoQualityNumSamples(0)
+        , m_autoQualityLevelLimit(UINT32_MAX)
+        , m_inputComputeFilter()
+        , m_inputRgbaFilter()
+        , m_inputRgbaImageViews()
+        , m_inputStagingBuffers()
+        , m_inputHostImport()
+        , m_inputHostImportWindowFrames(0)
+        , m_numInputHostImportFrames(0)
+        , m_deviceBitstreamBuffers()
+        , m_inputStagingNumaNode(-1)
+        , m_simulcastScaleFilter()
+        , m_simulcastEncoders()
+        , m_simulcastFrames()
+        , m_splitFrameEncoders()
+        , m_splitFrameFrames()
+        , m_splitFrameBandSlices(UINT32_MAX) // the main encoder may assemble some frames behind
+        , m_splitFrameData()
+        , m_inputUploadPlaneLayouts()
+        , m_inputUploadFrameSize()
+        , m_inputLoaderThreadPool()
+        , m_pendingInputFrames()
+        , m_syntheticInput()
+        , m_temporalFilter()
+        , m_preAnalysis()
+        , m_lookAheadFrames()
+        , m_lookAheadWindow()
+        , m_lastLookAheadComplexity()
+        , m_framesSinceSceneCut()
+        , m_rateControlChangesMutex()
+        , m_rateControlChanges()
+        , m_rateControlMinQp(-1)
+        , m_rateControlMaxQp(-1)
+        , m_referenceInvalidationsMutex()
+        , m_referenceInvalidations()
+        , m_forceIdrFrame(false)
+        , m_inputConversionThreadPool()
+        , m_inputConversionSelector()
+        , m_bitstreamWriter()
+        , m_inFlightFrames()
         , m_bitstreamBuffersQueue()
         , m_displayQueue()
+        , m_reorderBuffer()
+        , m_orderedFrames()
+        , m_recordStageQueue()
+        , m_assembleStageQueue()
+        , m_recordStageThread()
+        , m_assembleStageThread()
+        , m_stagePipelineResult(VK_SUCCESS)
+        , m_frameLatenciesMs()
+        , m_benchmarkStageTimeNs()
+        , m_benchmarkStartTime()
+        , m_benchmarkEndTime()
+        , m_numBenchmarkFrames(0)
+        , m_numBenchmarkBytes(0)
+        , m_qualityMetrics()
+        , m_frameQualityMetrics()
+        , m_frameStats()
+        , m_twoPassFrameStats()
+        , m_twoPassQpDeltas()
+        , m_sliceOffsets()
+        , m_numPacketsWritten(0)
+        , m_encodedSessionParametersHandle(VK_NULL_HANDLE)
+        , m_encodedSessionParameters()
+        , m_metrics(VkMetrics::NewStreamLabels())
     { }
 
     // Factory Function
@@ -454,23 +640,102 @@ public:
 
     virtual VkResult InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& encoderConfig) = 0; // Must be implemented by the codec
     VkResult LoadNextFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
-    VkResult StageInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
-    VkResult SubmitStagedInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    // Encodes an image the application already has on the device as the next input frame, instead of one loaded
+    // from the input file by LoadNextFrame(): copied on the device into an input image of the encoder once the
+    // waitSemaphore is signaled, without a staging through the host. The image can be written again once the
+    // signalSemaphore is signaled. The pts are the input timestamps of the frames, increasing in the input order,
+    // that InvalidateReferenceFrames() takes. An image of the inputRgbaFormat of the configuration, created with the
+    // storage usage, is converted to the encoder input format on the compute queue instead of copied.
+    VkResult EncodeImage(const VkVideoEncodeInputImage& inputImage, uint64_t pts, bool lastFrame = false);
+    VkFormat GetInputImageFormat() const { return m_imageInFormat; }
+    // Transcoding: encodes the decoded picture as the next input frame, like EncodeImage(). The frame can be
+    // released to the decoder right after, the decoder waits for the copy before writing to its image again.
+    VkResult LoadDecodedFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                              VulkanDecodedFrame& decodedFrame, bool lastFrame);
+    // With an input image, the frame is copied from it instead of the staging image or buffer
+    VkResult StageInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                             const VkVideoEncodeInputImage* pInputImage = nullptr);
+    // Submits the command buffer of the input pool node, or the pre-recorded one, synchronized by the node
+    VkResult SubmitStagedInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                    const VkVideoEncodeInputImage* pInputImage = nullptr,
+                                    const VkCommandBuffer* pPreRecordedCmdBuf = nullptr);
     virtual VkResult EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo) = 0; // Must be implemented by the codec
     virtual VkResult HandleCtrlCmd(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
-
+    // Replaces m_videoSessionParameters with new ones for that encode quality level
+    virtual VkResult CreateVideoSessionParameters(uint32_t qualityLevel) = 0; // Must be implemented by the codec
+    // With autoQualityLevelFps, adapts the quality level at the IDR frames to the device time of the encodes since
+    // the previous one, with new session parameters
+    VkResult UpdateAutoQualityLevel(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    // Retrieves the encoded session parameters from the driver, into the header buffer of the frame
+    virtual VkResult EncodeVideoSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo) = 0; // Must be implemented by the codec
+    // The constant QP of that slice of the frame, offset by the QP delta map of the frame if any
+    int32_t GetSliceConstantQp(const VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, int32_t constantQp,
+                               uint32_t sliceIndex, uint32_t sliceCount) const;
+    // The encoded session parameters written ahead of each IDR frame, retrieved once per session parameters object
+    VkResult GetEncodedSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Simulcast: each input frame staged by this encoder is also scaled into an input image of the attached encoder,
+    // configured for a --simulcast rung, by the same submission, then encoded by it. Attached before the first frame.
+    VkResult AttachSimulcastEncoder(VkSharedBaseObj<VkVideoEncoder>& simulcastEncoder);
+
+    // Split frames: the attached encoder, configured for a band of --splitFrameBands, gets that band of each input
+    // frame staged by this encoder, copied by the same submission, and encodes it on its own encode queue. Its
+    // slices are stitched after those of this encoder's band. Attached before the first frame, in band order.
+    VkResult AttachSplitFrameEncoder(VkSharedBaseObj<VkVideoEncoder>& splitFrameEncoder);
+
+    // Changes the rate control in-band from the frame with that input order number on, without an IDR frame or
+    // a session reset. Can be called from any thread, the changes are applied as the frames due are encoded.
+    VkResult ChangeRateControl(const RateControlChange& rateControlChange);
+
+    // Marks the references from the frame with that input timestamp on as lost, from the receiver feedback.
+    // The next frames predict from the references left, such as the long-term one (longTermRefInterval), with an
+    // IDR frame when none is left. Can be called from any thread, applied once the frames following it are encoded.
+    VkResult InvalidateReferenceFrames(uint64_t timeStamp);
 
     VkResult RecordVideoCodingCmd(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                   uint32_t frameIdx, uint32_t ofTotalFrames);
 
-    VkResult RecordVideoCodingCmds(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, uint32_t numFrames);
+    // The frames of a batch, in decode order
+    typedef std::vector<VkSharedBaseObj<VkVideoEncodeFrameInfo>> OrderedFrames;
+
+    VkResult RecordVideoCodingCmds(OrderedFrames& frames);
 
     VkResult SubmitVideoCodingCmds(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                    uint32_t frameIdx, uint32_t ofTotalFrames);
 
+    // Without waitForResults, returns VK_NOT_READY and writes nothing if the encode query is not available yet.
     VkResult AssembleBitstreamData(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                   uint32_t frameIdx, uint32_t ofTotalFrames, bool waitForResults = true);
+
+    // The last stage of a batch: assembles the frame, or leaves it in flight with encodeInFlightFrames
+    VkResult AssembleOrRetireFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                    uint32_t frameIdx, uint32_t ofTotalFrames);
 
+    // Counts the frame assembled into the runtime metrics
+    void UpdateOutputMetrics(const VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, size_t bitstreamSize);
+
+    // Writes the statistics of the frame assembled to the CSV file of frameStatsCsvFileName
+    void AddFrameStats(const VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, VkQueryResultStatusKHR status,
+                       size_t bitstreamSize);
+
+    // Assembles the in-flight frames, in submission order, as long as their queries are available.
+    // Waits for the oldest ones while more than maxInFlightFrames are left.
+    VkResult RetireInFlightFrames(size_t maxInFlightFrames);
+
+    // Reads the feedback queries of the in-flight frames available so far, from the oldest one, in one call
+    // for the run of consecutive query slots up to the end of the pool.
+    void FetchInFlightEncodeStatus();
+
+    // Writes to the output file, through the writer thread if there is one. Returns the size written or queued.
+    size_t WriteBitstream(const uint8_t* data, size_t size);
+
+    // The VkVideoEncodePacketHeader of a frame with that access unit size, with packetFraming
+    size_t WritePacketHeader(const VkVideoEncodeFrameInfo* encodeFrameInfo, size_t accessUnitSize);
+
+    // The offsets of the slice NAL units in the coded data of a picture, from their start codes,
+    // since the encode feedback only has the offset and the size of the whole picture.
+    uint32_t GetSliceOffsets(const uint8_t* data, size_t size, std::vector<uint32_t>& sliceOffsets) const;
+
     VkResult PrintVideoCodingLink(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, uint32_t frameIdx, uint32_t ofTotalFrames)
     {
         if (m_encoderConfig->verbose) {
@@ -494,11 +759,125 @@ protected:
     // Called by the InitEncoderCodec to initialize the common encoder code.
     VkResult InitEncoder(VkSharedBaseObj<EncoderConfig>& encoderConfig);
 
-    VkDeviceSize GetBitstreamBuffer(VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer);
+    // Sets up the compute conversion of the input frames, on the compute queue. Fails if the input is not supported.
+    VkResult InitInputComputeConversion(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+    // Sets up the conversion of the RGBA images of EncodeImage(), on the compute queue.
+    VkResult InitInputRgbaConversion(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+    VkResult InitSimulcastScaling(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+    // On the attached encoder, takes a frame with an input image and an input semaphore for the main encoder's frame
+    VkResult AcquireSimulcastFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& primaryFrameInfo,
+                                   VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    // Scales the input image, left in imageLayout, into the images of m_simulcastFrames
+    void RecordSimulcastScaling(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                VkImageLayout imageLayout);
+    // Copies the bands of the input image, left in imageLayout, into the images of m_splitFrameFrames
+    void RecordSplitFrameBandCopies(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                    VkImageLayout imageLayout);
+    // On a band encoder, hands the slices of the frame over to the main encoder
+    void HandOverSplitFrameBandSlices(const uint8_t* data, size_t size);
+    // The slices of this encoder's band followed by those of the attached encoders, into m_splitFrameData
+    bool StitchSplitFrameBands(const uint8_t* data, size_t size);
+    // Appends the slices of the band, with the addresses of the whole picture, false if they can't be rewritten
+    virtual bool AppendSplitFrameBandSlices(const uint8_t* data, size_t size, uint32_t bandIndex,
+                                            std::vector<uint8_t>& frameData) { return false; }
+
+    // Lays out the two planes of the encoder input format in the upload buffers.
+    void InitInputBufferUpload(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+
+    // Takes the input image of the frame from the pool, if it has none yet. Waits for the release of an image
+    // by the encoder threads when all are in flight.
+    VkResult AcquireInputImage(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    // How long the input stage waits for an image of the pools, none without a thread to release one.
+    std::chrono::nanoseconds GetInputImageAcquireTimeout() const;
+
+    // Returns the staging buffer of the frame's input image, allocated on first use.
+    VkResult GetInputStagingBuffer(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                   VkBufferUsageFlags usage, VkDeviceSize size,
+                                   VkSharedBaseObj<VkBufferResource>& stagingBuffer);
+
+    // Takes the staging image or buffer of the frame from the pools, on the thread calling LoadNextFrame.
+    VkResult AcquireInputStaging(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Sizes the windows of the mapped input file imported as host memory for the compute conversion.
+    VkResult InitInputHostImport(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+
+    // Points the frame at its data in the imported window of the mapped input file, importing the window
+    // on first use. Returns false for the frame to be copied to its staging buffer instead.
+    bool ImportInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Reads the frame from the file into its staging resource, converting it on the CPU if needed.
+    // Only writes to the frame's own resources, so it can run on the input loader threads.
+    VkResult ConvertInputFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // With --autoInputConversion, picks the conversion path of the frame, timing both on it first when the
+    // selector asks for it
+    VkResult SelectInputConversionPath(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Converts and uploads the frame on the path with cmdBuffer, and waits for the upload, for the calibration
+    bool RunInputConversion(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, bool computeConversion,
+                            VkSharedBaseObj<VulkanCommandBufferPool::PoolNode>& cmdBuffer);
+
+    // Stages the frame from the input image with that input timestamp and encodes it
+    VkResult LoadInputImage(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                            const VkVideoEncodeInputImage& inputImage, uint64_t timeStamp, bool lastFrame);
+
+    // Stages and encodes the loaded frames, in order, until no more than maxPendingFrames are left.
+    VkResult StagePendingInputFrames(size_t maxPendingFrames);
+
+    void RecordInputComputeConversion(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // The copy or the conversion of the staged frame, or of the input image, to the input image of the frame
+    void RecordInputUpload(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                           const VkVideoEncodeInputImage* pInputImage);
+    // The upload of the pair of staging and input images of the frame, recorded at its first use, nullptr if
+    // the input stage of the frame has to be recorded
+    const VkCommandBuffer* GetPreRecordedInputCmdBuffer(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                                        const VkVideoEncodeInputImage* pInputImage);
+
+    // Encodes the frames held back for the look-ahead, in order, until no more than maxLookAheadFrames are left.
+    // The QP of each frame is adapted to the complexities of the frames following it.
+    VkResult EncodeLookAheadFrames(size_t maxLookAheadFrames);
+
+    // Determines the picture type and the display order position in the GOP of the frame, for the codecs.
+    // With the adaptive GOP, the scene cuts are coded as IDR frames and each GOP gets the B-frame runs of its look-ahead.
+    uint8_t GetPositionInGop(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, uint8_t& positionInGopInDisplayOrder);
+
+    // Applies the rate control changes due by the frame, for the codecs, and sets the constant QP of the frame.
+    void UpdateFrameRateControl(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Rebuilds the rate control state from the encoder configuration, with the QP bounds that are not negative.
+    virtual void UpdateRateControlParameters(int32_t minQp, int32_t maxQp) = 0; // Must be implemented by the codec
+
+    // Takes the next reference invalidation due by the frame, of a frame before it.
+    bool GetReferenceInvalidation(uint64_t frameTimeStamp, uint64_t& timeStamp);
+
+    VkDeviceSize GetBitstreamBuffer(VkVideoGopStructure::FrameType pictureType,
+                                    VkSharedBaseObj<VulkanBitstreamBuffer>& bitstreamBuffer);
+
+    // The output buffer sizes of the intra and the inter frames with m_rightSizedBitstreamBuffers
+    enum { BITSTREAM_SIZE_TYPE_INTRA = 0, BITSTREAM_SIZE_TYPE_INTER = 1, BITSTREAM_SIZE_NUM_TYPES = 2 };
+    static uint32_t GetBitstreamSizeType(VkVideoGopStructure::FrameType pictureType);
+    void InitBitstreamBufferSizes();
+    VkDeviceSize GetBitstreamBufferSize(VkVideoGopStructure::FrameType pictureType) const;
+    // From the assembly of the frames, a single thread
+    void UpdateBitstreamBufferSize(VkVideoGopStructure::FrameType pictureType, VkDeviceSize codedSize,
+                                   VkDeviceSize bufferSize, bool overflow);
+    void PrintBitstreamBufferSizes();
+
+    // The device-local output of the frame with m_deviceLocalBitstream, by its input image like the query slot
+    VkResult GetDeviceBitstreamBuffer(uint32_t imageIndex, VkDeviceSize size,
+                                      VkSharedBaseObj<VkBufferResource>& deviceBitstreamBuffer);
+    void RecordBitstreamReadback(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                 const VkSharedBaseObj<VkBufferResource>& deviceBitstreamBuffer);
 
     VkImageLayout TransitionImageLayout(VkCommandBuffer cmdBuf,
                                         VkSharedBaseObj<VkImageResourceView>& imageView,
-                                        VkImageLayout oldLayout, VkImageLayout newLayout);
+                                        VkImageLayout newLayout,
+                                        VkPipelineStageFlags2KHR dstStageMask,
+                                        VkAccessFlags2KHR dstAccessMask);
+
+    // Transitions the setup picture and the references of the frame to the DPB layout, in one barrier
+    void RecordDpbBarriers(VkCommandBuffer cmdBuf, VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
 
     VkResult CopyLinearToOptimalImage(VkCommandBuffer& commandBuffer,
                                       VkSharedBaseObj<VkImageResourceView>& srcImageView,
@@ -508,6 +887,28 @@ protected:
                                       VkImageLayout srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
                                       VkImageLayout dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
+    // The queue the input frames are staged on
+    VulkanDeviceContext::QueueFamilySubmitType GetInputSubmitType() const;
+
+    // Copies the two planes of the frame in the input image to the image and leaves it in the encode src layout.
+    // The input image is left in its own layout.
+    void CopyInputImageToOptimalImage(VkCommandBuffer commandBuffer,
+                                      const VkVideoEncodeInputImage& inputImage,
+                                      VkSharedBaseObj<VkImageResourceView>& dstImageView,
+                                      uint32_t dstCopyArrayLayer);
+
+    // Converts the RGBA input image to the input image of the frame and leaves it in the encode src layout.
+    // The input image is left in its own layout.
+    void ConvertInputImageToOptimalImage(VkCommandBuffer commandBuffer,
+                                         const VkVideoEncodeInputImage& inputImage,
+                                         VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Copies the two planes of the buffer, laid out as planeLayouts, to the image and leaves it in the encode src layout.
+    VkResult CopyBufferToOptimalImage(VkCommandBuffer commandBuffer,
+                                      VkSharedBaseObj<VkBufferResource>& srcBuffer,
+                                      const VkSubresourceLayout planeLayouts[2],
+                                      VkSharedBaseObj<VkImageResourceView>& dstImageView);
+
     virtual VkResult ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                 uint32_t frameIdx, uint32_t ofTotalFrames) = 0;
 
@@ -519,57 +920,88 @@ protected:
 
     bool EnqueueFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, bool preFlushQueue, bool postFlushQueue) {
 
+        if (m_lowLatency) {
+            return (EncodeFrameLowLatency(encodeFrameInfo) == VK_SUCCESS);
+        }
+
         if (preFlushQueue) {
             PushOrderedFrames();
+            m_nextDecodePosition = encodeFrameInfo->positionInGopInDecodeOrder;
         }
         InsertOrdered(encodeFrameInfo);
         if (postFlushQueue) {
             PushOrderedFrames();
+        } else {
+            // The frames next in decode order don't wait for the rest of their B-frame run
+            PushReadyFrames();
         }
         return true;
     }
 
     void ConsumerThread();
 
-    void InsertOrdered(VkSharedBaseObj<VkVideoEncodeFrameInfo>& current,
-                       VkSharedBaseObj<VkVideoEncodeFrameInfo>& prev,
-                       VkSharedBaseObj<VkVideoEncodeFrameInfo>& node) {
-
-        if ((current == nullptr) || (current->positionInGopInDecodeOrder >= node->positionInGopInDecodeOrder)) {
-
-            node->dependantFrames = current;
-
-            if (prev != nullptr) {
-                // If not inserting at the beginning, link the previous node to the new node
-                prev->dependantFrames = node;
-            } else {
-                // If inserting at the beginning, update the head
-                m_lastDeferredFrame = node;
-            }
-
-            return;
+    // Runs all the stages of the frame and writes it out, without the reorder buffer. The frames come in decode order.
+    VkResult EncodeFrameLowLatency(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+    // Prints the percentiles of the low-latency mode input to bitstream latencies, and writes them to the CSV file
+    void PrintFrameLatencies();
+
+    // With enableBenchmark, the time spent on the CPU by the frames in each stage, on whichever thread runs it
+    enum BenchmarkStage { BENCHMARK_STAGE_INPUT, BENCHMARK_STAGE_DPB, BENCHMARK_STAGE_RECORD, BENCHMARK_STAGE_SUBMIT,
+                          BENCHMARK_STAGE_ASSEMBLE, BENCHMARK_NUM_STAGES };
+    // Adds the time since start to the stage, nothing for BENCHMARK_NUM_STAGES
+    void AddBenchmarkStageTime(BenchmarkStage stage, const std::chrono::steady_clock::time_point& start);
+    // Prints the encode frame rate, the device utilization of the encodes, the CPU time per frame of each stage
+    // and the bitstream size, from the first input frame to the last bitstream write
+    void PrintBenchmarkStats();
+    void PrintInputStats();
+
+    // Compares the reconstructed pictures with the input frames on the compute queue, with qualityMetricsCsvFileName
+    VkResult InitQualityMetrics(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+    // Writes the per frame metrics to the CSV file and prints their averages
+    void PrintQualityMetrics();
+
+    // With the stage pipeline, the frames go through the DPB processing on the thread pushing them,
+    // then through these two threads, in order, so the next frame is processed while the previous is encoded.
+    void RecordStageThread();   // records and submits the video coding commands
+    void AssembleStageThread(); // waits for the encode queries and writes the bitstream
+    // Drains the stage threads and joins them
+    void StopStagePipeline();
+    void SetStagePipelineError(VkResult result);
+
+    // Defers the frame to its decode order slot of the reorder buffer, until the batch is pushed
+    void InsertOrdered(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo) {
+
+        const uint32_t position = encodeFrameInfo->positionInGopInDecodeOrder;
+        if (m_reorderBuffer[position] != nullptr) {
+            assert(!"The decode order position is already taken");
+            // Keep the frames in order, the deferred ones are pushed first
+            PushOrderedFrames();
         }
 
-        // Recursive case: Move to the next node, updating previous node pointer
-        InsertOrdered(current->dependantFrames, current, node);
-    }
-
-    // Wrapper function to start the recursion
-    void InsertOrdered(VkSharedBaseObj<VkVideoEncodeFrameInfo>& dependantFrames) {
-        if (m_lastDeferredFrame == nullptr) {
-            m_lastDeferredFrame = dependantFrames;
-            m_numDeferredFrames++;
-            return;
+        m_reorderBuffer[position] = encodeFrameInfo;
+        if (m_numDeferredFrames == 0) {
+            m_firstDeferredFramePosition = m_lastDeferredFramePosition = position;
+        } else {
+            m_firstDeferredFramePosition = std::min(m_firstDeferredFramePosition, position);
+            m_lastDeferredFramePosition  = std::max(m_lastDeferredFramePosition, position);
         }
-        VkSharedBaseObj<VkVideoEncodeFrameInfo> prev;
-        InsertOrdered(m_lastDeferredFrame, prev, dependantFrames);
         m_numDeferredFrames++;
     }
 
+    // Pushes all the deferred frames, in decode order
     VkResult PushOrderedFrames();
-    VkResult ProcessOrderedFrames(VkSharedBaseObj<VkVideoEncodeFrameInfo>& frames, uint32_t numFrames);
-
-    typedef VkThreadSafeQueue<VkSharedBaseObj<VkVideoEncodeFrameInfo>> EncoderFrameQueue;
+    // Pushes the deferred frames from m_nextDecodePosition on, up to the first one still missing. Their references
+    // were all pushed before them, so the deferred frames stay within a B-frame run and the reference after it.
+    VkResult PushReadyFrames();
+    // Hands m_orderedFrames over to the encoder queue, or processes them
+    VkResult SubmitOrderedFrames();
+    VkResult ProcessOrderedFrames(OrderedFrames& frames);
+
+    // One producer and one consumer thread each: the encoder thread to the consumer thread, then the thread
+    // processing the DPB to the record stage thread, and the record stage thread to the assemble one
+    typedef VkSpscQueue<OrderedFrames> EncoderFrameQueue;
+    typedef VkSpscQueue<VkSharedBaseObj<VkVideoEncodeFrameInfo>> EncoderStageQueue;
 
 private:
     std::atomic<int32_t> refCount;
@@ -578,17 +1010,31 @@ protected:
     const VulkanDeviceContext*                    m_vkDevCtx;
     uint64_t                                      m_inputFrameNum;
     uint64_t                                      m_encodeFrameNum;
+    uint32_t                                      m_framesSinceIdr; // in encode order, from GetPositionInGop()
     VkSharedBaseObj<VulkanVideoSession>           m_videoSession;
     VkSharedBaseObj<VulkanVideoSessionParameters> m_videoSessionParameters;
     VkFormat                              m_imageDpbFormat;
     VkFormat                              m_imageInFormat;
     VkExtent2D                            m_maxCodedExtent;
     uint32_t                              m_maxActiveReferencePictures;
+    uint32_t                              m_encodeQueueIndex;
+    uint32_t                              m_numEncodeQueues; // the frames are spread over, from m_encodeQueueIndex
+    uint32_t                              m_nextEncodeQueue;
+    uint32_t                              m_controlCmdQueue; // of the last frame with video coding control commands
+    VkSemaphore                           m_controlCmdSemaphore; // its completion, waited for on the other queues
+    uint64_t                              m_controlCmdValue;
     size_t                                m_minStreamBufferSize;
     size_t                                m_streamBufferSize;
+    VkDeviceSize                          m_rateControlFrameSize[BITSTREAM_SIZE_NUM_TYPES]; // 0 without a bitrate
+    std::atomic<VkDeviceSize>             m_peakFrameSize[BITSTREAM_SIZE_NUM_TYPES]; // decaying, of the coded frames
+    std::atomic<VkDeviceSize>             m_minFrameBufferSize[BITSTREAM_SIZE_NUM_TYPES]; // raised by the overflows
+    uint32_t                              m_numBitstreamOverflows;
+    uint32_t                              m_numFeedbackQuerySlots; // taken in turn, in the submission order
+    uint32_t                              m_nextFeedbackQuerySlot;
+    std::vector<VkVideoEncodeStatus>      m_feedbackQueryResults;  // reused by FetchInFlightEncodeStatus()
     VkVideoEncodeQualityLevelInfoKHR      m_qualityLevelInfo;
     VkVideoEncodeRateControlInfoKHR       m_rateControlInfo;
-    VkVideoEncodeRateControlLayerInfoKHR  m_rateControlLayersInfo[1];
+    VkVideoEncodeRateControlLayerInfoKHR  m_rateControlLayersInfo[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
     int8_t   m_picIdxToDpb[17]; // MAX_DPB_SLOTS + 1
     uint32_t m_dpbSlotsMask;
     uint32_t m_frameNumSyntax;
@@ -603,21 +1049,125 @@ protected:
     uint32_t m_useImageViewArray : 1;
     uint32_t m_useSeparateOutputImages : 1;
     uint32_t m_useLinearInput : 1;
+    uint32_t m_useInputComputeConversion : 1;
+    uint32_t m_useInputBufferUpload : 1;
+    uint32_t m_useInputHostImport : 1;
     uint32_t m_resetEncoder : 1;
     uint32_t m_enableEncoderQueue : 1;
+    uint32_t m_useStagePipeline : 1;
+    uint32_t m_lowLatency : 1;
+    uint32_t m_packetFraming : 1;
+    uint32_t m_rightSizedBitstreamBuffers : 1;
+    uint32_t m_deviceLocalBitstream : 1;
+    uint32_t m_adaptiveGop : 1;
     uint32_t m_verbose : 1;
     uint32_t                                 m_numDeferredFrames;
+    uint32_t                                 m_firstDeferredFramePosition; // range of the occupied m_reorderBuffer slots
+    uint32_t                                 m_lastDeferredFramePosition;
+    uint32_t                                 m_nextDecodePosition; // of the next frame to push
     VkVideoCodingControlFlagsKHR             m_controlCmd;
     VkSharedBaseObj<VulkanVideoImagePool>    m_linearInputImagePool;
     VkSharedBaseObj<VulkanVideoImagePool>    m_inputImagePool;
     VkSharedBaseObj<VulkanVideoImagePool>    m_dpbImagePool;
     VkSharedBaseObj<VulkanCommandBufferPool> m_inputCommandBufferPool;
     VkSharedBaseObj<VulkanCommandBufferPool> m_encodeCommandBufferPool;
+    VulkanCommandBuffersSet                  m_preRecordedInputCmdBuffers; // per input image and staging image
+    std::vector<bool>                        m_preRecordedInputCmdBuffersValid; // recorded
+    uint32_t                                 m_numPreRecordedStagingSlots; // the staging images, 1 for the buffers
+    VkSharedBaseObj<VulkanVideoGpuTimestamps> m_gpuTimestamps; // one slot per input image
+    double                                   m_autoQualityGpuTimeMs;  // of the samples at the last IDR frame
+    size_t                                   m_autoQualityNumSamples;
+    uint32_t                                 m_autoQualityLevelLimit; // the lowest level found too slow
+    VkSharedBaseObj<VulkanFilter>            m_inputComputeFilter;  // I420 to NV12/P010 with m_useInputComputeConversion
+    VkSharedBaseObj<VulkanFilter>            m_inputRgbaFilter;     // RGBA2YCBCR of the EncodeImage() images
+    std::vector<VkImageView>                 m_inputRgbaImageViews; // of the RGBA images, by the input image index
+    std::vector<VkSharedBaseObj<VkBufferResource>> m_inputStagingBuffers; // indexed by the input image index
+    VkSharedBaseObj<VulkanHostMappedMemory>  m_inputHostImport; // the window of the mapped input file of the last frame
+    uint32_t                                 m_inputHostImportWindowFrames;
+    uint64_t                                 m_numInputHostImportFrames; // read in place by the compute conversion
+    std::vector<VkSharedBaseObj<VkBufferResource>> m_deviceBitstreamBuffers; // the same, with m_deviceLocalBitstream
+    int32_t m_inputStagingNumaNode; // of the pinned loader threads filling the staging buffers, -1 if not known
+    VkSharedBaseObj<VulkanFilter>            m_simulcastScaleFilter; // YCBCRSCALE of the input to the simulcast rungs
+    std::vector<VkSharedBaseObj<VkVideoEncoder>> m_simulcastEncoders; // attached
+    std::vector<VkSharedBaseObj<VkVideoEncodeFrameInfo>> m_simulcastFrames; // of the frame being staged, per encoder
+    std::vector<VkSharedBaseObj<VkVideoEncoder>> m_splitFrameEncoders; // attached, of the bands after the first one
+    std::vector<VkSharedBaseObj<VkVideoEncodeFrameInfo>> m_splitFrameFrames; // of the frame being staged, per band
+    VkThreadSafeQueue<std::vector<uint8_t>>  m_splitFrameBandSlices; // of a band encoder, in encode order
+    std::vector<uint8_t>                     m_splitFrameData; // the stitched slices of the frame being assembled
+    VkSubresourceLayout                      m_inputUploadPlaneLayouts[2]; // NV12 planes of the m_useInputBufferUpload buffers
+    VkDeviceSize                             m_inputUploadFrameSize;
+    struct PendingInputFrame {
+        VkSharedBaseObj<VkVideoEncodeFrameInfo> encodeFrameInfo;
+        std::future<VkResult>                   loadResult;
+    };
+    std::unique_ptr<VkThreadPool>            m_inputLoaderThreadPool; // with inputLoadAheadFrames
+    std::deque<PendingInputFrame>            m_pendingInputFrames;    // in input order
+    VkSharedBaseObj<VkVideoEncoderSyntheticInput> m_syntheticInput; // with enableBenchmark, instead of the input file
+    VkSharedBaseObj<VkVideoEncoderTemporalFilter> m_temporalFilter; // with temporalFilterStrength, before m_preAnalysis
+    VkSharedBaseObj<VkVideoEncoderPreAnalysis> m_preAnalysis;         // with lookAheadFrames, on the input command buffers
+    std::deque<VkSharedBaseObj<VkVideoEncodeFrameInfo>> m_lookAheadFrames; // staged, in input order
+    std::vector<VkVideoEncoderPreAnalysis::FrameComplexity> m_lookAheadWindow; // reused
+    VkVideoEncoderPreAnalysis::FrameComplexity m_lastLookAheadComplexity; // of the last frame out of the look-ahead
+    uint32_t                                 m_framesSinceSceneCut;
+    std::mutex                               m_rateControlChangesMutex;
+    std::vector<RateControlChange>           m_rateControlChanges; // pending, by frame number
+    int32_t                                  m_rateControlMinQp;   // the QP bounds of the changes, -1 if not set
+    int32_t                                  m_rateControlMaxQp;
+    std::mutex                               m_referenceInvalidationsMutex;
+    std::vector<uint64_t>                    m_referenceInvalidations; // pending, by input timestamp
+    std::atomic<bool>                        m_forceIdrFrame;          // no valid reference is left to recover from
+    std::unique_ptr<VkThreadPool>            m_inputConversionThreadPool; // row bands of the CPU conversion
+    std::unique_ptr<VkConversionPathSelector> m_inputConversionSelector; // CPU or compute conversion, per frame
+    VkSharedBaseObj<VkVideoEncoderBitstreamWriter> m_bitstreamWriter; // with enableOutputWriterThread
+    std::deque<VkSharedBaseObj<VkVideoEncodeFrameInfo>> m_inFlightFrames; // submitted, in order, with encodeInFlightFrames
     VulkanBitstreamBufferPool                m_bitstreamBuffersQueue;
     DisplayQueue                             m_displayQueue;
     EncoderFrameQueue                        m_encoderQueue;
     std::thread                              m_encoderQueueConsumerThread;
-    VkSharedBaseObj<VkVideoEncodeFrameInfo>  m_lastDeferredFrame;
+    VkSharedBaseObj<VkVideoEncodeFrameInfo>  m_reorderBuffer[MAX_REORDER_FRAMES];
+    OrderedFrames                            m_orderedFrames; // the pushed batch, reused
+    EncoderStageQueue                        m_recordStageQueue;
+    EncoderStageQueue                        m_assembleStageQueue;
+    std::thread                              m_recordStageThread;
+    std::thread                              m_assembleStageThread;
+    std::atomic<VkResult>                    m_stagePipelineResult; // the first error of the stage threads
+    std::vector<double>                      m_frameLatenciesMs; // per frame, in input order, with m_lowLatency
+    std::atomic<uint64_t>                    m_benchmarkStageTimeNs[BENCHMARK_NUM_STAGES];
+    std::chrono::steady_clock::time_point    m_benchmarkStartTime; // of the first input frame, with enableBenchmark
+    std::chrono::steady_clock::time_point    m_benchmarkEndTime;   // of the last frame assembled
+    uint64_t                                 m_numBenchmarkFrames; // assembled
+    uint64_t                                 m_numBenchmarkBytes;  // of their bitstream, with the parameter sets
+    struct FrameQualityMetrics {
+        uint64_t                          frameInputOrderNum;
+        VulkanQualityMetrics::FrameMetrics metrics;
+    };
+    VkSharedBaseObj<VulkanQualityMetrics>    m_qualityMetrics;      // with qualityMetricsCsvFileName
+    std::vector<FrameQualityMetrics>         m_frameQualityMetrics; // of the assembled frames
+    VkSharedBaseObj<VkVideoEncoderFrameStats> m_frameStats;         // with frameStatsCsvFileName
+    std::vector<VkVideoEncoderTwoPass::FrameStats> m_twoPassFrameStats; // of the assembled frames of the first pass
+    std::vector<int8_t>                      m_twoPassQpDeltas;  // of the second pass, by input order number
+    std::vector<uint32_t>                    m_sliceOffsets;     // of the frame being assembled, with several slices
+    uint64_t                                 m_numPacketsWritten; // the coded order of the next packet
+    VkVideoSessionParametersKHR              m_encodedSessionParametersHandle; // the parameters they were encoded from
+    std::vector<uint8_t>                     m_encodedSessionParameters;
+    struct EncoderMetrics {
+        explicit EncoderMetrics(const std::string& labels);
+
+        VkMetricCounter&   framesEncoded;
+        VkMetricCounter&   bitstreamBytes;
+        VkMetricHistogram& frameLatencyUs;   // from the input frame ready to its bitstream assembled
+        VkMetricGauge&     fps;              // of the assembled frames, over the last second
+        VkMetricGauge&     encoderQueueDepth;
+        VkMetricGauge&     recordQueueDepth;
+        VkMetricGauge&     assembleQueueDepth;
+        VkMetricGauge&     inFlightFrames;
+        VkMetricCounter&   bitstreamOverflows; // the frames growing the bitstream buffers of their type
+        VkMetricCounter&   bitstreamBufferAllocations;
+        VkMetricGauge&     bitstreamBuffersAvailable; // sampled while the metrics are enabled
+        VkMetricCounter&   fenceTimeouts;
+        std::chrono::steady_clock::time_point fpsStartTime; // on the thread assembling the frames
+        uint64_t                              fpsStartFrame;
+    } m_metrics;
 };
 
 VkResult CreateVideoEncoderH264(const VulkanDeviceContext* vkDevCtx,
@@ -628,4 +1178,10 @@ VkResult CreateVideoEncoderH265(const VulkanDeviceContext* vkDevCtx,
                                 VkSharedBaseObj<EncoderConfig>& encoderConfig,
                                 VkSharedBaseObj<VkVideoEncoder>& encoder);
 
+#ifdef VK_KHR_video_encode_av1
+VkResult CreateVideoEncoderAV1(const VulkanDeviceContext* vkDevCtx,
+                               VkSharedBaseObj<EncoderConfig>& encoderConfig,
+                               VkSharedBaseObj<VkVideoEncoder>& encoder);
+#endif
+
 #endif /* _VKVIDEOENCODER_VKVIDEOENCODER_H_ */
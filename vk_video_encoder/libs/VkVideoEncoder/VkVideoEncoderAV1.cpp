@@ -0,0 +1,475 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VkVideoEncoder/VkVideoEncoderAV1.h"
+#include "VkVideoCore/VulkanVideoCapabilities.h"
+
+#ifdef VK_KHR_video_encode_av1
+
+VkResult CreateVideoEncoderAV1(const VulkanDeviceContext* vkDevCtx,
+                               VkSharedBaseObj<EncoderConfig>& encoderConfig,
+                               VkSharedBaseObj<VkVideoEncoder>& encoder)
+{
+    VkSharedBaseObj<VkVideoEncoderAV1> vkEncoderAV1(new VkVideoEncoderAV1(vkDevCtx));
+    if (vkEncoderAV1) {
+
+        VkResult result = vkEncoderAV1->InitEncoderCodec(encoderConfig);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+
+        encoder = vkEncoderAV1;
+        return VK_SUCCESS;
+    }
+
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+VkResult VkVideoEncoderAV1::InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& encoderConfig)
+{
+    m_encoderConfig = encoderConfig->GetEncoderConfigAV1();
+    assert(m_encoderConfig);
+
+    if (m_encoderConfig->codec != VK_VIDEO_CODEC_OPERATION_ENCODE_AV1_BIT_KHR) {
+        return VK_ERROR_VIDEO_PROFILE_CODEC_NOT_SUPPORTED_KHR;
+    }
+
+    VkResult result = InitEncoder(encoderConfig);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "\nERROR: InitEncoder() failed with ret(%d)\n", result);
+        return result;
+    }
+
+    // Initialize DPB
+    m_dpb.DpbSequenceStart(m_maxActiveReferencePictures, m_encoderConfig->numRefL0);
+
+    m_maxDpbSlots = m_maxActiveReferencePictures;
+
+    std::cout << "maxDpbSlots: " << m_maxDpbSlots
+              << ", numRefL0: "    << (uint32_t)m_encoderConfig->numRefL0
+              << ", tiles: "       << m_encoderConfig->tileColumns << "x" << m_encoderConfig->tileRows << std::endl;
+
+    m_encoderConfig->GetRateControlParameters(&m_rateControlInfo, m_rateControlLayersInfo, &m_rateControlInfoAV1, m_rateControlLayersInfoAV1);
+
+    m_encoderConfig->InitSequenceHeader(&m_sequenceHeader, &m_colorConfig);
+
+    return CreateVideoSessionParameters(m_encoderConfig->qualityLevel);
+}
+
+VkResult VkVideoEncoderAV1::CreateVideoSessionParameters(uint32_t qualityLevel)
+{
+    VkVideoEncodeAV1SessionParametersCreateInfoKHR encodeAV1SessionParametersCreateInfo = {
+        VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_SESSION_PARAMETERS_CREATE_INFO_KHR,
+        NULL, &m_sequenceHeader, NULL /* pStdDecoderModelInfo */, 0 /* stdOperatingPointCount */, NULL
+    };
+
+    // The encodes with these parameters must use the same quality level
+    VkVideoEncodeQualityLevelInfoKHR qualityLevelInfo = {
+        VK_STRUCTURE_TYPE_VIDEO_ENCODE_QUALITY_LEVEL_INFO_KHR, &encodeAV1SessionParametersCreateInfo, qualityLevel};
+
+    VkVideoSessionParametersCreateInfoKHR encodeSessionParametersCreateInfo = {
+        VK_STRUCTURE_TYPE_VIDEO_SESSION_PARAMETERS_CREATE_INFO_KHR, &qualityLevelInfo};
+    encodeSessionParametersCreateInfo.videoSession = *m_videoSession;
+
+    VkVideoSessionParametersKHR sessionParameters;
+    VkResult result = m_vkDevCtx->CreateVideoSessionParametersKHR(*m_vkDevCtx,
+                                                         &encodeSessionParametersCreateInfo,
+                                                         nullptr,
+                                                         &sessionParameters);
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nEncodeFrame Error: Failed to get create video session parameters.\n");
+        return result;
+    }
+
+    result = VulkanVideoSessionParameters::Create(m_vkDevCtx, m_videoSession,
+                                                  sessionParameters, m_videoSessionParameters);
+    if(result != VK_SUCCESS) {
+        fprintf(stderr, "\nEncodeFrame Error: Failed to get create video session object.\n");
+        return result;
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoderAV1::InitRateControl(VkCommandBuffer cmdBuf, uint32_t qp)
+{
+    return VK_NOT_READY;
+}
+
+void VkVideoEncoderAV1::UpdateRateControlParameters(int32_t minQp, int32_t maxQp)
+{
+    m_encoderConfig->GetRateControlParameters(&m_rateControlInfo, m_rateControlLayersInfo, &m_rateControlInfoAV1, m_rateControlLayersInfoAV1);
+
+    for (uint32_t layerIndx = 0; layerIndx < ARRAYSIZE(m_rateControlLayersInfoAV1); layerIndx++) {
+        VkVideoEncodeAV1RateControlLayerInfoKHR& rateControlLayerInfo = m_rateControlLayersInfoAV1[layerIndx];
+        if (minQp >= 0) {
+            const uint32_t minQIndex = EncoderConfigAV1::QpToQIndex(minQp);
+            rateControlLayerInfo.useMinQIndex = VK_TRUE;
+            rateControlLayerInfo.minQIndex = { minQIndex, minQIndex, minQIndex };
+        }
+        if (maxQp >= 0) {
+            const uint32_t maxQIndex = EncoderConfigAV1::QpToQIndex(maxQp);
+            rateControlLayerInfo.useMaxQIndex = VK_TRUE;
+            rateControlLayerInfo.maxQIndex = { maxQIndex, maxQIndex, maxQIndex };
+        }
+    }
+}
+
+VkResult VkVideoEncoderAV1::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                       uint32_t frameIdx, uint32_t ofTotalFrames)
+{
+    VkVideoEncodeFrameInfoAV1* pFrameInfo = GetEncodeFrameInfoAV1(encodeFrameInfo);
+
+    // The DPB doesn't track the corrupted references, a lost frame is recovered from with a key frame
+    uint64_t invalidTimeStamp = 0;
+    while (GetReferenceInvalidation(encodeFrameInfo->inputTimeStamp, invalidTimeStamp)) {
+        if (m_verbose) {
+            std::cout << "Invalidated the references from timestamp " << invalidTimeStamp
+                      << ", at frame " << encodeFrameInfo->frameInputOrderNum << std::endl;
+        }
+        m_forceIdrFrame = true;
+    }
+
+    StdVideoEncodeAV1PictureInfo& stdPictureInfo = pFrameInfo->stdPictureInfo;
+    const bool isKeyFrame = (stdPictureInfo.frame_type == STD_VIDEO_AV1_FRAME_TYPE_KEY);
+    const bool isReference = isKeyFrame ||
+                             m_encoderConfig->gopStructure.IsFrameReference(encodeFrameInfo->positionInGopInDisplayOrder);
+
+    bool success = m_dpbImagePool->GetAvailableImage(encodeFrameInfo->setupImageResource,
+                                                     VK_IMAGE_LAYOUT_VIDEO_ENCODE_DPB_KHR);
+    assert(success);
+    assert(encodeFrameInfo->setupImageResource != nullptr);
+    VkVideoPictureResourceInfoKHR* setupImageViewPictureResource = encodeFrameInfo->setupImageResource->GetPictureResourceInfo();
+    setupImageViewPictureResource->codedOffset = pFrameInfo->encodeInfo.srcPictureResource.codedOffset;
+    setupImageViewPictureResource->codedExtent = pFrameInfo->encodeInfo.srcPictureResource.codedExtent;
+
+    VkEncDpbAV1::RefFrames refFrames{};
+    int8_t targetDpbSlot = m_dpb.DpbPictureStart(encodeFrameInfo->frameEncodeOrderNum, isKeyFrame,
+                                                 stdPictureInfo.order_hint, isReference,
+                                                 m_encoderConfig->numRefL0, &refFrames);
+    assert(targetDpbSlot >= 0);
+    if (targetDpbSlot < 0) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    stdPictureInfo.refresh_frame_flags = refFrames.refreshFrameFlags;
+    for (uint32_t i = 0; i < VkEncDpbAV1::NUM_REF_FRAMES; i++) {
+        stdPictureInfo.ref_order_hint[i] = (uint8_t)refFrames.refOrderHint[i];
+    }
+    for (uint32_t i = 0; i < VkEncDpbAV1::REFS_PER_FRAME; i++) {
+        stdPictureInfo.ref_frame_idx[i] = (int8_t)refFrames.refFrameIdx[i];
+        pFrameInfo->pictureInfo.referenceNameSlotIndices[i] = refFrames.refNameSlotIndex[i];
+    }
+
+    m_dpb.DpbPictureEnd(encodeFrameInfo->setupImageResource);
+
+    // ***************** Start Update DPB info ************** //
+
+    uint32_t numReferenceSlots = 0;
+    assert(pFrameInfo->numDpbImageResources == 0);
+
+    // setup ref slot index 0, with the reference info the frames predicted from it get
+    pFrameInfo->stdReferenceInfo[numReferenceSlots] = StdVideoEncodeAV1ReferenceInfo();
+    pFrameInfo->stdReferenceInfo[numReferenceSlots].RefFrameId = (uint32_t)encodeFrameInfo->frameEncodeOrderNum;
+    pFrameInfo->stdReferenceInfo[numReferenceSlots].frame_type = stdPictureInfo.frame_type;
+    pFrameInfo->stdReferenceInfo[numReferenceSlots].OrderHint = stdPictureInfo.order_hint;
+    pFrameInfo->stdDpbSlotInfo[numReferenceSlots].sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_DPB_SLOT_INFO_KHR;
+    pFrameInfo->stdDpbSlotInfo[numReferenceSlots].pStdReferenceInfo = &pFrameInfo->stdReferenceInfo[numReferenceSlots];
+
+    pFrameInfo->referenceSlotsInfo[numReferenceSlots].sType = VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR;
+    pFrameInfo->referenceSlotsInfo[numReferenceSlots].pNext = &pFrameInfo->stdDpbSlotInfo[numReferenceSlots];
+    pFrameInfo->referenceSlotsInfo[numReferenceSlots].slotIndex = targetDpbSlot;
+    pFrameInfo->referenceSlotsInfo[numReferenceSlots].pPictureResource = setupImageViewPictureResource;
+    pFrameInfo->setupReferenceSlotInfo = pFrameInfo->referenceSlotsInfo[numReferenceSlots];
+    pFrameInfo->encodeInfo.pSetupReferenceSlot = &pFrameInfo->setupReferenceSlotInfo;
+    numReferenceSlots++;
+
+    for (uint32_t i = 0; !isKeyFrame && (i < refFrames.numRefSlots); i++) {
+
+        int8_t dpbIndex = refFrames.refSlots[i];
+
+        bool refPicAvailable = m_dpb.GetRefPicture(dpbIndex, pFrameInfo->dpbImageResources[numReferenceSlots]);
+        assert(refPicAvailable);
+        if (!refPicAvailable) {
+            continue;
+        }
+
+        const DpbEntryAV1* pDpbEntry = m_dpb.GetDpbEntry(dpbIndex);
+        pFrameInfo->stdReferenceInfo[numReferenceSlots] = StdVideoEncodeAV1ReferenceInfo();
+        pFrameInfo->stdReferenceInfo[numReferenceSlots].RefFrameId = (uint32_t)pDpbEntry->frameId;
+        pFrameInfo->stdReferenceInfo[numReferenceSlots].frame_type = (StdVideoAV1FrameType)pDpbEntry->frameType;
+        pFrameInfo->stdReferenceInfo[numReferenceSlots].OrderHint = (uint8_t)pDpbEntry->orderHint;
+
+        pFrameInfo->stdDpbSlotInfo[numReferenceSlots].sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_DPB_SLOT_INFO_KHR;
+        pFrameInfo->stdDpbSlotInfo[numReferenceSlots].pStdReferenceInfo = &pFrameInfo->stdReferenceInfo[numReferenceSlots];
+
+        pFrameInfo->referenceSlotsInfo[numReferenceSlots].sType = VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR;
+        pFrameInfo->referenceSlotsInfo[numReferenceSlots].pNext = &pFrameInfo->stdDpbSlotInfo[numReferenceSlots];
+        pFrameInfo->referenceSlotsInfo[numReferenceSlots].slotIndex = dpbIndex;
+        pFrameInfo->referenceSlotsInfo[numReferenceSlots].pPictureResource =
+                pFrameInfo->dpbImageResources[numReferenceSlots]->GetPictureResourceInfo();
+
+        numReferenceSlots++;
+        assert(numReferenceSlots <= ARRAYSIZE(pFrameInfo->stdReferenceInfo));
+    }
+    pFrameInfo->numDpbImageResources = numReferenceSlots;
+
+    // The setup slot, the first entry, is not one of the references of the current picture
+    encodeFrameInfo->encodeInfo.referenceSlotCount = numReferenceSlots - 1;
+    encodeFrameInfo->encodeInfo.pReferenceSlots = pFrameInfo->referenceSlotsInfo + 1;
+
+    // ***************** End Update DPB info ************** //
+
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoderAV1::EncodeVideoSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    VkVideoEncodeFrameInfoAV1* pFrameInfo = GetEncodeFrameInfoAV1(encodeFrameInfo);
+
+    assert(pFrameInfo->videoSessionParameters);
+
+    // The sequence header OBU, the only parameters of AV1
+    VkVideoEncodeSessionParametersGetInfoKHR sessionParametersGetInfo = {
+        VK_STRUCTURE_TYPE_VIDEO_ENCODE_SESSION_PARAMETERS_GET_INFO_KHR,
+        nullptr,
+        *pFrameInfo->videoSessionParameters,
+    };
+
+    VkVideoEncodeSessionParametersFeedbackInfoKHR sessionParametersFeedbackInfo = {
+        VK_STRUCTURE_TYPE_VIDEO_ENCODE_SESSION_PARAMETERS_FEEDBACK_INFO_KHR,
+        nullptr,
+    };
+
+    size_t bufferSize = sizeof(encodeFrameInfo->bitstreamHeaderBuffer);
+    VkResult result = m_vkDevCtx->GetEncodedVideoSessionParametersKHR(*m_vkDevCtx,
+                                                                      &sessionParametersGetInfo,
+                                                                      &sessionParametersFeedbackInfo,
+                                                                      &bufferSize,
+                                                                      encodeFrameInfo->bitstreamHeaderBuffer);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    encodeFrameInfo->bitstreamHeaderBufferSize = bufferSize;
+
+    return result;
+}
+
+VkResult VkVideoEncoderAV1::WriteTemporalUnitHeader(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, bool isKeyFrame)
+{
+    // obu_type OBU_TEMPORAL_DELIMITER with obu_has_size_field, and its empty payload
+    static const uint8_t temporalDelimiterObu[] = { 0x12, 0x00 };
+
+    encodeFrameInfo->bitstreamHeaderBufferSize = 0;
+    encodeFrameInfo->bitstreamHeaderOffset = 0;
+
+    // The sequence header is repeated ahead of each key frame, for the decoders starting there
+    if (isKeyFrame) {
+        VkResult result = GetEncodedSessionParameters(encodeFrameInfo);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    const size_t sequenceHeaderSize = encodeFrameInfo->bitstreamHeaderBufferSize;
+    if ((sequenceHeaderSize + sizeof(temporalDelimiterObu)) > sizeof(encodeFrameInfo->bitstreamHeaderBuffer)) {
+        assert(!"The sequence header does not fit the header buffer");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    memmove(encodeFrameInfo->bitstreamHeaderBuffer + sizeof(temporalDelimiterObu),
+            encodeFrameInfo->bitstreamHeaderBuffer, sequenceHeaderSize);
+    memcpy(encodeFrameInfo->bitstreamHeaderBuffer, temporalDelimiterObu, sizeof(temporalDelimiterObu));
+    encodeFrameInfo->bitstreamHeaderBufferSize = sequenceHeaderSize + sizeof(temporalDelimiterObu);
+
+    return VK_SUCCESS;
+}
+
+VkResult VkVideoEncoderAV1::CreateFrameInfoBuffersQueue(uint32_t numPoolNodes)
+{
+    VkSharedBaseObj<VulkanBufferPool<VkVideoEncodeFrameInfoAV1>> _cmdBuffPool(new VulkanBufferPool<VkVideoEncodeFrameInfoAV1>());
+
+    if (_cmdBuffPool) {
+        _cmdBuffPool->Init(numPoolNodes);
+        m_frameInfoBuffersQueue = _cmdBuffPool;
+        return VK_SUCCESS;
+    }
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+VkResult VkVideoEncoderAV1::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    VkVideoEncodeFrameInfoAV1* pFrameInfo = GetEncodeFrameInfoAV1(encodeFrameInfo);
+
+    assert(encodeFrameInfo);
+    assert(m_encoderConfig);
+    assert(encodeFrameInfo->srcEncodeImageResource);
+
+    encodeFrameInfo->frameEncodeOrderNum = m_encodeFrameNum++;
+
+    UpdateFrameRateControl(encodeFrameInfo);
+
+    encodeFrameInfo->positionInGopInDisplayOrder = GetPositionInGop(encodeFrameInfo, m_positionInGopInDisplayOrder);
+
+    if (encodeFrameInfo->frameEncodeOrderNum == 0) {
+        assert(encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR);
+    }
+    // The I frames of the GOP are key frames as well, the references restart from them
+    const bool isKeyFrame = ((encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) ||
+                             (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_I));
+    if (!isKeyFrame && (encodeFrameInfo->pictureType != VkVideoGopStructure::FRAME_TYPE_P)) {
+        assert(!"Invalid picture type");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Without B-frames the display order is the encode order, counted from the key frame
+    encodeFrameInfo->picOrderCntVal = (int32_t)m_framesSinceIdr;
+    encodeFrameInfo->positionInGopInDecodeOrder = encodeFrameInfo->positionInGopInDisplayOrder;
+
+    if (m_encoderConfig->verboseFrameStruct) {
+        std::cout << VkVideoGopStructure::GetFrameTypeName(encodeFrameInfo->pictureType)
+                  << " inputOrderNum: "  << (int)encodeFrameInfo->frameEncodeOrderNum
+                  << " encodeFrameNum: " << (int)encodeFrameInfo->frameEncodeOrderNum
+                  << " display order: "  << (int)encodeFrameInfo->positionInGopInDisplayOrder
+                  << " order hint: "     << (int)encodeFrameInfo->picOrderCntVal
+                  << std::endl << std::flush;
+    }
+
+    assert(pFrameInfo->encodeInfo.srcPictureResource.codedOffset.x == 0);
+    assert(pFrameInfo->encodeInfo.srcPictureResource.codedOffset.y == 0);
+    pFrameInfo->encodeInfo.srcPictureResource.codedExtent.width = m_encoderConfig->encodeWidth;
+    pFrameInfo->encodeInfo.srcPictureResource.codedExtent.height = m_encoderConfig->encodeHeight;
+    VkVideoPictureResourceInfoKHR* pSrcPictureResource = encodeFrameInfo->srcEncodeImageResource->GetPictureResourceInfo();
+    encodeFrameInfo->encodeInfo.srcPictureResource.imageViewBinding = pSrcPictureResource->imageViewBinding;
+    encodeFrameInfo->encodeInfo.srcPictureResource.baseArrayLayer = pSrcPictureResource->baseArrayLayer;
+
+    pFrameInfo->qualityLevel = m_encoderConfig->qualityLevel;
+    pFrameInfo->videoSession = m_videoSession;
+    pFrameInfo->videoSessionParameters = m_videoSessionParameters;
+
+    VkDeviceSize size = GetBitstreamBuffer(encodeFrameInfo->pictureType, encodeFrameInfo->outputBitstreamBuffer);
+    assert((size > 0) && (encodeFrameInfo->outputBitstreamBuffer != nullptr));
+    pFrameInfo->encodeInfo.dstBuffer = encodeFrameInfo->outputBitstreamBuffer->GetBuffer();
+    // The whole buffer, for the overflow to be detected at its end
+    pFrameInfo->encodeInfo.dstBufferRange = size;
+    encodeFrameInfo->encodeInfo.dstBufferOffset = 0;
+
+    VkResult result = WriteTemporalUnitHeader(encodeFrameInfo, isKeyFrame);
+    if (result != VK_SUCCESS) {
+        assert(result == VK_SUCCESS);
+        return result;
+    }
+
+    // The frame header, the DPB fills in the references and the refresh of the VBIs from ProcessDpb()
+    StdVideoEncodeAV1PictureInfo& stdPictureInfo = pFrameInfo->stdPictureInfo;
+    stdPictureInfo.frame_type = isKeyFrame ? STD_VIDEO_AV1_FRAME_TYPE_KEY : STD_VIDEO_AV1_FRAME_TYPE_INTER;
+    stdPictureInfo.flags.show_frame = 1;
+    stdPictureInfo.flags.showable_frame = isKeyFrame ? 0 : 1;
+    stdPictureInfo.flags.error_resilient_mode = isKeyFrame ? 1 : 0;
+    stdPictureInfo.flags.allow_high_precision_mv = 0;
+    stdPictureInfo.flags.use_ref_frame_mvs = 0;
+    stdPictureInfo.flags.is_motion_mode_switchable = 0;
+    stdPictureInfo.flags.reduced_tx_set = 0;
+    stdPictureInfo.order_hint = (uint8_t)(m_framesSinceIdr & ((1u << m_encoderConfig->orderHintBits) - 1));
+    stdPictureInfo.primary_ref_frame = isKeyFrame ? STD_VIDEO_AV1_PRIMARY_REF_NONE : 0; // LAST_FRAME
+    stdPictureInfo.current_frame_id = 0;
+    stdPictureInfo.interpolation_filter = STD_VIDEO_AV1_INTERPOLATION_FILTER_EIGHTTAP;
+    stdPictureInfo.TxMode = STD_VIDEO_AV1_TX_MODE_SELECT;
+
+    // Uniformly spaced tiles
+    pFrameInfo->stdTileInfo.flags.uniform_tile_spacing_flag = 1;
+    pFrameInfo->stdTileInfo.TileCols = (uint8_t)m_encoderConfig->tileColumns;
+    pFrameInfo->stdTileInfo.TileRows = (uint8_t)m_encoderConfig->tileRows;
+    pFrameInfo->stdTileInfo.context_update_tile_id = 0;
+    pFrameInfo->stdTileInfo.tile_size_bytes_minus_1 = 3;
+
+    pFrameInfo->pictureInfo.predictionMode = isKeyFrame ? VK_VIDEO_ENCODE_AV1_PREDICTION_MODE_INTRA_ONLY_KHR :
+                                                       VK_VIDEO_ENCODE_AV1_PREDICTION_MODE_SINGLE_REFERENCE_KHR;
+    pFrameInfo->pictureInfo.rateControlGroup = isKeyFrame ? VK_VIDEO_ENCODE_AV1_RATE_CONTROL_GROUP_INTRA_KHR :
+                                                         VK_VIDEO_ENCODE_AV1_RATE_CONTROL_GROUP_PREDICTIVE_KHR;
+    pFrameInfo->pictureInfo.primaryReferenceCdfOnly = VK_FALSE;
+    pFrameInfo->pictureInfo.generateObuExtensionHeader = VK_FALSE;
+
+    uint32_t qIndex = EncoderConfigAV1::QpToQIndex(isKeyFrame ? encodeFrameInfo->constQp.qpIntra :
+                                                             encodeFrameInfo->constQp.qpInterP);
+    qIndex = std::min(std::max(qIndex, m_encoderConfig->minQIndex), m_encoderConfig->maxQIndex);
+    if (m_rateControlInfo.rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+        pFrameInfo->pictureInfo.constantQIndex = qIndex;
+    }
+    pFrameInfo->stdQuantization.base_q_idx = (uint8_t)qIndex;
+
+    // The loop filter and the CDEF strengths follow the quantization
+    const uint8_t loopFilterLevel = (uint8_t)std::min<uint32_t>(qIndex / 4, 63);
+    pFrameInfo->stdLoopFilter.loop_filter_level[0] = loopFilterLevel;
+    pFrameInfo->stdLoopFilter.loop_filter_level[1] = loopFilterLevel;
+    pFrameInfo->stdLoopFilter.loop_filter_level[2] = loopFilterLevel;
+    pFrameInfo->stdLoopFilter.loop_filter_level[3] = loopFilterLevel;
+    pFrameInfo->stdLoopFilter.loop_filter_sharpness = 0;
+
+    if (m_encoderConfig->enableCdef) {
+        pFrameInfo->stdCdef.cdef_damping_minus_3 = 2;
+        pFrameInfo->stdCdef.cdef_bits = 0;
+        pFrameInfo->stdCdef.cdef_y_pri_strength[0] = (uint8_t)std::min<uint32_t>(qIndex / 16, 15);
+        pFrameInfo->stdCdef.cdef_y_sec_strength[0] = 1;
+        pFrameInfo->stdCdef.cdef_uv_pri_strength[0] = (uint8_t)std::min<uint32_t>(qIndex / 32, 15);
+        pFrameInfo->stdCdef.cdef_uv_sec_strength[0] = 0;
+        stdPictureInfo.pCDEF = &pFrameInfo->stdCdef;
+    } else {
+        stdPictureInfo.pCDEF = nullptr;
+    }
+
+    if (m_sendControlCmd == true) {
+        HandleCtrlCmd(encodeFrameInfo);
+    }
+
+    const bool preFlushQueue = isKeyFrame || (encodeFrameInfo->positionInGopInDecodeOrder == 0);
+    const bool postFlushQueue = true; // each frame is coded in its input order
+    EnqueueFrame(encodeFrameInfo, preFlushQueue, postFlushQueue);
+    return result;
+}
+
+VkResult VkVideoEncoderAV1::HandleCtrlCmd(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+{
+    VkVideoEncodeFrameInfoAV1* pFrameInfo = GetEncodeFrameInfoAV1(encodeFrameInfo);
+
+    // Save the RateControlCmd request.
+    const bool sendRateControlCmd = m_sendRateControlCmd;
+    // Call the base class first to cover the bases
+    VkVideoEncoder::HandleCtrlCmd(encodeFrameInfo);
+
+    // Fill-n the codec-specific parts next
+    if (sendRateControlCmd) {
+
+        for (uint32_t layerIndx = 0; layerIndx < ARRAYSIZE(m_rateControlLayersInfoAV1); layerIndx++) {
+            pFrameInfo->rateControlLayersInfoAV1[layerIndx] = m_rateControlLayersInfoAV1[layerIndx];
+            pFrameInfo->rateControlLayersInfoAV1[layerIndx].sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_LAYER_INFO_KHR;
+            pFrameInfo->rateControlLayersInfo[layerIndx].pNext = &pFrameInfo->rateControlLayersInfoAV1[layerIndx];
+        }
+
+        pFrameInfo->rateControlInfoAV1 = m_rateControlInfoAV1;
+        pFrameInfo->rateControlInfoAV1.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_INFO_KHR;
+        pFrameInfo->rateControlInfoAV1.temporalLayerCount = m_encoderConfig->gopStructure.GetTemporalLayerCount();
+
+        if (pFrameInfo->pControlCmdChain != nullptr) {
+            pFrameInfo->rateControlInfoAV1.pNext = pFrameInfo->pControlCmdChain;
+        }
+
+        pFrameInfo->pControlCmdChain = (VkBaseInStructure*)&pFrameInfo->rateControlInfoAV1;
+    }
+
+    return VK_SUCCESS;
+}
+
+#endif // VK_KHR_video_encode_av1
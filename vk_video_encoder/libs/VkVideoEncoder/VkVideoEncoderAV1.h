@@ -0,0 +1,149 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERAV1_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERAV1_H_
+
+#include "VkVideoEncoder/VkVideoEncoder.h"
+#include "VkVideoEncoder/VkEncoderConfigAV1.h"
+#include "VkVideoEncoder/VkEncoderDpbAV1.h"
+
+#ifdef VK_KHR_video_encode_av1
+
+class VkVideoEncoderAV1 : public VkVideoEncoder {
+
+    enum { MAX_REFFERENCES = VkEncDpbAV1::REFS_PER_FRAME + 1 }; // with the setup slot
+
+    struct VkVideoEncodeFrameInfoAV1 : public VkVideoEncodeFrameInfo {
+
+        VkVideoEncodeAV1PictureInfoKHR          pictureInfo;
+        StdVideoEncodeAV1PictureInfo            stdPictureInfo;
+        StdVideoAV1TileInfo                     stdTileInfo;
+        StdVideoAV1Quantization                 stdQuantization;
+        StdVideoAV1LoopFilter                   stdLoopFilter;
+        StdVideoAV1CDEF                         stdCdef;
+        VkVideoEncodeAV1RateControlInfoKHR      rateControlInfoAV1;
+        VkVideoEncodeAV1RateControlLayerInfoKHR rateControlLayersInfoAV1[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
+        StdVideoEncodeAV1ReferenceInfo          stdReferenceInfo[MAX_REFFERENCES];
+        VkVideoEncodeAV1DpbSlotInfoKHR          stdDpbSlotInfo[MAX_REFFERENCES];
+
+        VkVideoEncodeFrameInfoAV1()
+          : VkVideoEncodeFrameInfo(&pictureInfo)
+          , pictureInfo { VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_PICTURE_INFO_KHR }
+          , stdPictureInfo()
+          , stdTileInfo()
+          , stdQuantization()
+          , stdLoopFilter()
+          , stdCdef()
+          , rateControlInfoAV1{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_INFO_KHR }
+          , rateControlLayersInfoAV1{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_LAYER_INFO_KHR }
+          , stdReferenceInfo{}
+          , stdDpbSlotInfo{}
+        {
+            pictureInfo.pStdPictureInfo = &stdPictureInfo;
+            stdPictureInfo.pTileInfo     = &stdTileInfo;
+            stdPictureInfo.pQuantization = &stdQuantization;
+            stdPictureInfo.pLoopFilter   = &stdLoopFilter;
+            stdPictureInfo.pCDEF         = &stdCdef;
+        };
+
+        virtual void Reset(bool releaseResources = true) {
+
+            // Reset the base first
+            VkVideoEncodeFrameInfo::Reset(releaseResources);
+
+            // Clear and check state
+            assert(pictureInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_PICTURE_INFO_KHR);
+            // stdPictureInfo()
+            assert(rateControlInfoAV1.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_INFO_KHR);
+            assert(rateControlLayersInfoAV1[0].sType ==  VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_LAYER_INFO_KHR);
+            // stdReferenceInfo{}
+            // stdDpbSlotInfo{}
+        }
+
+        virtual ~VkVideoEncodeFrameInfoAV1() {
+            Reset(true);
+        }
+    };
+
+public:
+
+    VkVideoEncoderAV1(const VulkanDeviceContext* vkDevCtx)
+        : VkVideoEncoder(vkDevCtx)
+        , m_encoderConfig()
+        , m_positionInGopInDisplayOrder()
+        , m_sequenceHeader{}
+        , m_colorConfig{}
+        , m_rateControlInfoAV1{VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_INFO_KHR}
+        , m_rateControlLayersInfoAV1{VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_RATE_CONTROL_LAYER_INFO_KHR}
+        , m_dpb{}
+        , m_maxDpbSlots(0)
+    { }
+
+    virtual VkResult InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& encoderConfig);
+    virtual VkResult InitRateControl(VkCommandBuffer cmdBuf, uint32_t qp);
+    virtual void UpdateRateControlParameters(int32_t minQp, int32_t maxQp);
+    virtual VkResult CreateVideoSessionParameters(uint32_t qualityLevel);
+    virtual VkResult EncodeVideoSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    virtual VkResult ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
+                                uint32_t frameIdx, uint32_t ofTotalFrames);
+    virtual VkResult CreateFrameInfoBuffersQueue(uint32_t numPoolNodes);
+    virtual bool GetAvailablePoolNode(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo)
+    {
+        VkSharedBaseObj<VkVideoEncodeFrameInfoAV1> encodeFrameInfoAV1;
+        bool success = m_frameInfoBuffersQueue->GetAvailablePoolNode(encodeFrameInfoAV1);
+        if (success) {
+            encodeFrameInfo = encodeFrameInfoAV1;
+        }
+        return success;
+    }
+
+    virtual VkResult EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    virtual VkResult HandleCtrlCmd(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+
+protected:
+    virtual ~VkVideoEncoderAV1() {
+
+        m_frameInfoBuffersQueue = nullptr;
+        m_encoderConfig = nullptr;
+    }
+
+private:
+
+    VkVideoEncodeFrameInfoAV1* GetEncodeFrameInfoAV1(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo) {
+        assert(VK_STRUCTURE_TYPE_VIDEO_ENCODE_AV1_PICTURE_INFO_KHR == encodeFrameInfo->GetType());
+        VkVideoEncodeFrameInfo* pEncodeFrameInfo = encodeFrameInfo;
+        return (VkVideoEncodeFrameInfoAV1*)pEncodeFrameInfo;
+    }
+
+    // The temporal unit of each frame starts with a temporal delimiter OBU, and the sequence header OBU at the key frames
+    VkResult WriteTemporalUnitHeader(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo, bool isKeyFrame);
+
+private:
+    VkSharedBaseObj<EncoderConfigAV1>          m_encoderConfig;
+    uint8_t                                    m_positionInGopInDisplayOrder;
+    StdVideoAV1SequenceHeader                  m_sequenceHeader;
+    StdVideoAV1ColorConfig                     m_colorConfig;
+    VkVideoEncodeAV1RateControlInfoKHR         m_rateControlInfoAV1;
+    VkVideoEncodeAV1RateControlLayerInfoKHR    m_rateControlLayersInfoAV1[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
+    VkEncDpbAV1                                m_dpb;
+    uint32_t                                   m_maxDpbSlots;
+    VkSharedBaseObj<VulkanBufferPool<VkVideoEncodeFrameInfoAV1>> m_frameInfoBuffersQueue;
+};
+
+#endif // VK_KHR_video_encode_av1
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERAV1_H_ */
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <algorithm>
+#include <string.h>
+#include "VkVideoEncoderBitstreamWriter.h"
+#include "VkCodecUtils/VkThreadAffinity.h"
+
+VkResult VkVideoEncoderBitstreamWriter::Create(FILE* outputFile,
+                                               size_t blockSize,
+                                               uint32_t maxPendingBlocks,
+                                               VkSharedBaseObj<VkVideoEncoderBitstreamWriter>& bitstreamWriter)
+{
+    if ((outputFile == nullptr) || (blockSize == 0) || (maxPendingBlocks == 0)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkSharedBaseObj<VkVideoEncoderBitstreamWriter> writer(new VkVideoEncoderBitstreamWriter(outputFile, blockSize,
+                                                                                            maxPendingBlocks));
+    if (!writer) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    bitstreamWriter = writer;
+    return VK_SUCCESS;
+}
+
+VkVideoEncoderBitstreamWriter::VkVideoEncoderBitstreamWriter(FILE* outputFile, size_t blockSize,
+                                                             uint32_t maxPendingBlocks)
+    : m_refCount(0)
+    , m_outputFile(outputFile)
+    , m_blockSize(blockSize)
+    , m_maxPendingBlocks(maxPendingBlocks)
+    , m_currentBlock()
+    , m_mutex()
+    , m_condWriter()
+    , m_condProducer()
+    , m_pendingBlocks()
+    , m_freeBlocks()
+    , m_writing(false)
+    , m_exit(false)
+    , m_writeFailed(false)
+    , m_bytesWritten(0)
+    , m_thread()
+{
+    m_currentBlock.reserve(m_blockSize);
+    m_thread = std::thread(&VkVideoEncoderBitstreamWriter::WriterThread, this);
+}
+
+bool VkVideoEncoderBitstreamWriter::SetWriterThreadAffinity(const std::vector<uint32_t>& cpus)
+{
+    return VkSetThreadAffinity(m_thread, cpus);
+}
+
+VkVideoEncoderBitstreamWriter::~VkVideoEncoderBitstreamWriter()
+{
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_condWriter.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool VkVideoEncoderBitstreamWriter::Write(const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        const size_t copySize = std::min(size, m_blockSize - m_currentBlock.size());
+        m_currentBlock.insert(m_currentBlock.end(), data, data + copySize);
+        data += copySize;
+        size -= copySize;
+
+        if (m_currentBlock.size() >= m_blockSize) {
+            QueueCurrentBlock();
+        }
+    }
+    return !m_writeFailed;
+}
+
+void VkVideoEncoderBitstreamWriter::QueueCurrentBlock()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Only blocks the producer when the disk is that far behind
+    m_condProducer.wait(lock, [this]{ return (m_pendingBlocks.size() < m_maxPendingBlocks); });
+
+    m_pendingBlocks.push_back(std::move(m_currentBlock));
+
+    // Reuse the blocks already written, their capacity is kept
+    if (!m_freeBlocks.empty()) {
+        m_currentBlock = std::move(m_freeBlocks.back());
+        m_freeBlocks.pop_back();
+    } else {
+        m_currentBlock = std::vector<uint8_t>();
+        m_currentBlock.reserve(m_blockSize);
+    }
+    m_condWriter.notify_one();
+}
+
+bool VkVideoEncoderBitstreamWriter::Flush()
+{
+    if (!m_currentBlock.empty()) {
+        QueueCurrentBlock();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condProducer.wait(lock, [this]{ return (m_pendingBlocks.empty() && !m_writing); });
+
+    if (fflush(m_outputFile) != 0) {
+        m_writeFailed = true;
+    }
+    return !m_writeFailed;
+}
+
+void VkVideoEncoderBitstreamWriter::WriterThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_condWriter.wait(lock, [this]{ return (m_exit || !m_pendingBlocks.empty()); });
+        if (m_pendingBlocks.empty()) {
+            // m_exit, all the blocks are written
+            return;
+        }
+
+        std::vector<uint8_t> block(std::move(m_pendingBlocks.front()));
+        m_pendingBlocks.pop_front();
+        m_writing = true;
+        lock.unlock();
+
+        const size_t written = fwrite(block.data(), 1, block.size(), m_outputFile);
+        if (written != block.size()) {
+            fprintf(stderr, "\nERROR: Failed to write %zu bytes of the output bitstream\n", block.size() - written);
+            m_writeFailed = true;
+        }
+        m_bytesWritten += written;
+
+        block.clear();
+        lock.lock();
+        m_freeBlocks.push_back(std::move(block));
+        m_writing = false;
+        m_condProducer.notify_one();
+    }
+}
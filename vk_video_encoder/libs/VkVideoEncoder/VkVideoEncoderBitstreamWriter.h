@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERBITSTREAMWRITER_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERBITSTREAMWRITER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+
+// Writes the coded bitstream to the output file on a dedicated thread. The data is copied in stream order
+// into blocks, which are written to the file once they reach the block size, so the encode thread only
+// blocks when maxPendingBlocks full blocks are already waiting for the disk.
+// Write() and Flush() must be called from one thread.
+class VkVideoEncoderBitstreamWriter : public VkVideoRefCountBase
+{
+public:
+    enum { DEFAULT_BLOCK_SIZE = 1024 * 1024, DEFAULT_MAX_PENDING_BLOCKS = 16 };
+
+    static VkResult Create(FILE* outputFile,
+                           size_t blockSize,
+                           uint32_t maxPendingBlocks,
+                           VkSharedBaseObj<VkVideoEncoderBitstreamWriter>& bitstreamWriter);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the writer if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns false if an earlier write to the file has failed.
+    bool Write(const uint8_t* data, size_t size);
+
+    // Writes out the partial block and waits for the writer thread to complete all the writes.
+    bool Flush();
+
+    uint64_t GetBytesWritten() const { return m_bytesWritten; }
+
+    // Restricts the writer thread to the CPUs of the list
+    bool SetWriterThreadAffinity(const std::vector<uint32_t>& cpus);
+
+private:
+    VkVideoEncoderBitstreamWriter(FILE* outputFile, size_t blockSize, uint32_t maxPendingBlocks);
+
+    virtual ~VkVideoEncoderBitstreamWriter();
+
+    void QueueCurrentBlock();
+    void WriterThread();
+
+private:
+    std::atomic<int32_t>              m_refCount;
+    FILE*                             m_outputFile;
+    const size_t                      m_blockSize;
+    const uint32_t                    m_maxPendingBlocks;
+    std::vector<uint8_t>              m_currentBlock;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_condWriter;
+    std::condition_variable           m_condProducer;
+    std::deque<std::vector<uint8_t>>  m_pendingBlocks;
+    std::vector<std::vector<uint8_t>> m_freeBlocks;
+    bool                              m_writing;
+    bool                              m_exit;
+    std::atomic<bool>                 m_writeFailed;
+    std::atomic<uint64_t>             m_bytesWritten;
+    std::thread                       m_thread;
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERBITSTREAMWRITER_H_ */
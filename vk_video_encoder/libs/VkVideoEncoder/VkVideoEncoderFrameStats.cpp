@@ -0,0 +1,155 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include "VkVideoEncoderFrameStats.h"
+
+// The lines of a few thousand frames per write
+static const size_t frameStatsBlockSize = 256 * 1024;
+static const uint32_t frameStatsMaxPendingBlocks = 4;
+
+static const char* GetStatusName(VkQueryResultStatusKHR status)
+{
+    switch (status) {
+    case VK_QUERY_RESULT_STATUS_COMPLETE_KHR:
+        return "complete";
+    case VK_QUERY_RESULT_STATUS_NOT_READY_KHR:
+        return "not_ready";
+    case VK_QUERY_RESULT_STATUS_INSUFFICIENT_BITSTREAM_BUFFER_RANGE_KHR:
+        return "overflow";
+    default:
+        break;
+    }
+    return "error";
+}
+
+VkResult VkVideoEncoderFrameStats::Create(const char* csvFileName, VkSharedBaseObj<VkVideoEncoderFrameStats>& frameStats)
+{
+    FILE* csvFile = fopen(csvFileName, "w");
+    if (csvFile == nullptr) {
+        fprintf(stderr, "\nERROR: Can't open the frame statistics CSV file %s\n", csvFileName);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    fprintf(csvFile, "frame,encode_order,type,poc,bytes,qp,status,gpu_ms,queue_wait_ms,latency_ms\n");
+
+    VkSharedBaseObj<VkVideoEncoderBitstreamWriter> writer;
+    VkResult result = VkVideoEncoderBitstreamWriter::Create(csvFile, frameStatsBlockSize, frameStatsMaxPendingBlocks,
+                                                            writer);
+    if (result != VK_SUCCESS) {
+        fclose(csvFile);
+        return result;
+    }
+
+    VkSharedBaseObj<VkVideoEncoderFrameStats> stats(new VkVideoEncoderFrameStats(csvFile, writer));
+    if (!stats) {
+        assert(!"Couldn't allocate host memory!");
+        fclose(csvFile);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    frameStats = stats;
+    return VK_SUCCESS;
+}
+
+VkVideoEncoderFrameStats::VkVideoEncoderFrameStats(FILE* csvFile, VkSharedBaseObj<VkVideoEncoderBitstreamWriter>& writer)
+    : m_refCount(0)
+    , m_csvFile(csvFile)
+    , m_writer(writer)
+    , m_typeTotals()
+{
+}
+
+VkVideoEncoderFrameStats::~VkVideoEncoderFrameStats()
+{
+    Close();
+}
+
+bool VkVideoEncoderFrameStats::Add(const FrameStats& frameStats)
+{
+    if (!m_writer) {
+        return false;
+    }
+
+    char line[256];
+    int lineSize = snprintf(line, sizeof(line), "%llu,%llu,%s,%d,%llu,",
+                            (unsigned long long)frameStats.frameInputOrderNum,
+                            (unsigned long long)frameStats.frameEncodeOrderNum,
+                            VkVideoGopStructure::GetFrameTypeName(frameStats.pictureType),
+                            frameStats.picOrderCnt, (unsigned long long)frameStats.bytes);
+    // The unknown values are left empty
+    if (frameStats.qp >= 0) {
+        lineSize += snprintf(line + lineSize, sizeof(line) - lineSize, "%d", frameStats.qp);
+    }
+    lineSize += snprintf(line + lineSize, sizeof(line) - lineSize, ",%s,", GetStatusName(frameStats.status));
+    if (frameStats.gpuTimeMs >= 0.0) {
+        lineSize += snprintf(line + lineSize, sizeof(line) - lineSize, "%.4f", frameStats.gpuTimeMs);
+    }
+    lineSize += snprintf(line + lineSize, sizeof(line) - lineSize, ",");
+    if (frameStats.queueWaitMs >= 0.0) {
+        lineSize += snprintf(line + lineSize, sizeof(line) - lineSize, "%.4f", frameStats.queueWaitMs);
+    }
+    lineSize += snprintf(line + lineSize, sizeof(line) - lineSize, ",%.4f\n", frameStats.latencyMs);
+    assert((lineSize > 0) && ((size_t)lineSize < sizeof(line)));
+
+    if ((frameStats.pictureType >= 0) && ((uint32_t)frameStats.pictureType < (uint32_t)NUM_FRAME_TYPES)) {
+        TypeTotals& totals = m_typeTotals[frameStats.pictureType];
+        totals.numFrames++;
+        totals.bytes += frameStats.bytes;
+        totals.latencyMs += frameStats.latencyMs;
+        if (frameStats.gpuTimeMs >= 0.0) {
+            totals.numGpuTimes++;
+            totals.gpuTimeMs += frameStats.gpuTimeMs;
+            totals.maxGpuTimeMs = std::max(totals.maxGpuTimeMs, frameStats.gpuTimeMs);
+        }
+    }
+
+    return m_writer->Write((const uint8_t*)line, (size_t)lineSize);
+}
+
+bool VkVideoEncoderFrameStats::Close()
+{
+    if (!m_writer) {
+        return true;
+    }
+
+    // The writer thread is done with the file once released
+    const bool written = m_writer->Flush();
+    m_writer = nullptr;
+    fclose(m_csvFile);
+    m_csvFile = nullptr;
+
+    printf("Frame statistics per picture type:\n");
+    for (uint32_t type = 0; type < NUM_FRAME_TYPES; type++) {
+        const TypeTotals& totals = m_typeTotals[type];
+        if (totals.numFrames == 0) {
+            continue;
+        }
+        printf("\t%-13s %8llu frames, mean %10.1f bytes, %8.3f ms latency",
+               VkVideoGopStructure::GetFrameTypeName((VkVideoGopStructure::FrameType)type),
+               (unsigned long long)totals.numFrames, (double)totals.bytes / totals.numFrames,
+               totals.latencyMs / totals.numFrames);
+        if (totals.numGpuTimes > 0) {
+            printf(", %8.3f ms GPU (max %.3f)", totals.gpuTimeMs / totals.numGpuTimes, totals.maxGpuTimeMs);
+        }
+        printf("\n");
+    }
+    if (!written) {
+        fprintf(stderr, "\nERROR: Failed to write the frame statistics\n");
+    }
+    return written;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERFRAMESTATS_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERFRAMESTATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include "vulkan/vulkan.h"
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkVideoEncoder/VkVideoGopStructure.h"
+#include "VkVideoEncoder/VkVideoEncoderBitstreamWriter.h"
+
+// The per frame statistics of the encoder, one CSV line per assembled frame, in encode order. The lines are
+// formatted on the calling thread and written to the file by a VkVideoEncoderBitstreamWriter thread, so the
+// assembly of the frames does not wait for the disk. The totals of each picture type are printed on Close().
+// Add() and Close() must be called from one thread.
+class VkVideoEncoderFrameStats : public VkVideoRefCountBase
+{
+public:
+    struct FrameStats {
+        uint64_t                       frameInputOrderNum;
+        uint64_t                       frameEncodeOrderNum;
+        VkVideoGopStructure::FrameType pictureType;
+        int32_t                        picOrderCnt;
+        uint64_t                       bytes;          // with the parameter sets and the headers written with the frame
+        int32_t                        qp;             // the constant QP, -1 when chosen by the rate control of the device
+        VkQueryResultStatusKHR         status;         // of the encode feedback query
+        double                         gpuTimeMs;      // of the encode commands, negative without the GPU timestamps
+        double                         queueWaitMs;    // from the submission to the start on the queue, negative if unknown
+        double                         latencyMs;      // from the input frame ready to the bitstream written
+    };
+
+    static VkResult Create(const char* csvFileName, VkSharedBaseObj<VkVideoEncoderFrameStats>& frameStats);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the statistics if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Returns false if an earlier write to the file has failed.
+    bool Add(const FrameStats& frameStats);
+
+    // Waits for the lines to be written, closes the file and prints the totals per picture type
+    bool Close();
+
+private:
+    enum { NUM_FRAME_TYPES = VkVideoGopStructure::FRAME_TYPE_INTRA_REFRESH + 1 };
+
+    struct TypeTotals {
+        uint64_t numFrames;
+        uint64_t bytes;
+        uint64_t numGpuTimes;
+        double   gpuTimeMs;
+        double   maxGpuTimeMs;
+        double   latencyMs;
+    };
+
+    VkVideoEncoderFrameStats(FILE* csvFile, VkSharedBaseObj<VkVideoEncoderBitstreamWriter>& writer);
+
+    virtual ~VkVideoEncoderFrameStats();
+
+private:
+    std::atomic<int32_t>                           m_refCount;
+    FILE*                                          m_csvFile;
+    VkSharedBaseObj<VkVideoEncoderBitstreamWriter> m_writer;
+    TypeTotals                                     m_typeTotals[NUM_FRAME_TYPES];
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERFRAMESTATS_H_ */
@@ -61,15 +61,24 @@ VkResult VkVideoEncoderH264::InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& en
     m_encoderConfig->InitSpsPpsParameters(&m_h264.m_spsInfo, &m_h264.m_ppsInfo,
             m_encoderConfig->InitVuiParameters(&m_h264.m_vuiInfo, &m_h264.m_hrdParameters));
 
+    return CreateVideoSessionParameters(m_encoderConfig->qualityLevel);
+}
 
+VkResult VkVideoEncoderH264::CreateVideoSessionParameters(uint32_t qualityLevel)
+{
     // create SPS and PPS set
     VideoSessionParametersInfo videoSessionParametersInfo(*m_videoSession,
                                                           &m_h264.m_spsInfo,
                                                           &m_h264.m_ppsInfo);
 
     VkVideoSessionParametersCreateInfoKHR* encodeSessionParametersCreateInfo = videoSessionParametersInfo.getVideoSessionParametersInfo();
+    // The encodes with these parameters must use the same quality level
+    VkVideoEncodeQualityLevelInfoKHR qualityLevelInfo = { VK_STRUCTURE_TYPE_VIDEO_ENCODE_QUALITY_LEVEL_INFO_KHR };
+    qualityLevelInfo.pNext = encodeSessionParametersCreateInfo->pNext;
+    qualityLevelInfo.qualityLevel = qualityLevel;
+    encodeSessionParametersCreateInfo->pNext = &qualityLevelInfo;
     VkVideoSessionParametersKHR sessionParameters;
-    result = m_vkDevCtx->CreateVideoSessionParametersKHR(*m_vkDevCtx,
+    VkResult result = m_vkDevCtx->CreateVideoSessionParametersKHR(*m_vkDevCtx,
                                                          encodeSessionParametersCreateInfo,
                                                          nullptr,
                                                          &sessionParameters);
@@ -125,6 +134,23 @@ VkResult VkVideoEncoderH264::InitRateControl(VkCommandBuffer cmdBuf, uint32_t qp
     return VK_SUCCESS;
 }
 
+void VkVideoEncoderH264::UpdateRateControlParameters(int32_t minQp, int32_t maxQp)
+{
+    m_encoderConfig->GetRateControlParameters(&m_rateControlInfo, m_rateControlLayersInfo, &m_h264.m_rateControlInfoH264, m_h264.m_rateControlLayersInfoH264);
+
+    for (uint32_t layerIndx = 0; layerIndx < ARRAYSIZE(m_h264.m_rateControlLayersInfoH264); layerIndx++) {
+        VkVideoEncodeH264RateControlLayerInfoKHR& rateControlLayerInfo = m_h264.m_rateControlLayersInfoH264[layerIndx];
+        if (minQp >= 0) {
+            rateControlLayerInfo.useMinQp = VK_TRUE;
+            rateControlLayerInfo.minQp = { minQp, minQp, minQp };
+        }
+        if (maxQp >= 0) {
+            rateControlLayerInfo.useMaxQp = VK_TRUE;
+            rateControlLayerInfo.maxQp = { maxQp, maxQp, maxQp };
+        }
+    }
+}
+
 void VkVideoEncoderH264::POCBasedRefPicManagement(StdVideoEncodeH264RefPicMarkingEntry* m_mmco,
                                                   uint8_t& m_refPicMarkingOpCount) {
     int picNumX = -1;
@@ -179,31 +205,41 @@ VkResult VkVideoEncoderH264::SetupRefPicReorderingCommands(const PicInfoH264 *pP
     NvVideoEncodeH264DpbSlotInfoLists<STD_VIDEO_H264_MAX_NUM_LIST_REF> refLists;
     m_dpb264->GetRefPicList(pPicInfo, &refLists, &m_h264.m_spsInfo, &m_h264.m_ppsInfo, slh, nullptr, true);
 
+    if (refLists.refPicListCount[0] == 0) {
+        // All the references are corrupted, the frame is followed by an IDR one
+        m_forceIdrFrame = true;
+        return VK_SUCCESS;
+    }
+
     int maxPicNum = 1 << (m_h264.m_spsInfo.log2_max_frame_num_minus4 + 4);
     int picNumLXPred = m_dpb264->GetCurrentDpbEntry()->frame_num % maxPicNum;
-    int numSTR = 0, numLTR = 0;
-    m_dpb264->GetNumRefFramesInDPB(0, &numSTR, &numLTR);
 
     // Re-order the active list to skip all corrupted frames
     pFlags->ref_pic_list_modification_flag_l0 = true;
     m_refList0ModOpCount = 0;
-    if (numSTR) {
-        for (uint32_t i = 0; i < refLists.refPicListCount[0]; i++) {
-            int diff = m_dpb264->GetPicNum(refLists.refPicList[0][i]) - picNumLXPred;
-            if (diff <= 0) {
-                refPicList0Mod[m_refList0ModOpCount].modification_of_pic_nums_idc =
-                    STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_SHORT_TERM_SUBTRACT;
-                refPicList0Mod[m_refList0ModOpCount].abs_diff_pic_num_minus1 = abs(diff) ? abs(diff) - 1 : maxPicNum - 1;
-            } else {
-                refPicList0Mod[m_refList0ModOpCount].modification_of_pic_nums_idc =
-                    STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_SHORT_TERM_ADD;
-                refPicList0Mod[m_refList0ModOpCount].abs_diff_pic_num_minus1 = abs(diff) - 1;
-            }
+    for (uint32_t i = 0; i < refLists.refPicListCount[0]; i++) {
+        bool shortTerm = false, longTerm = false;
+        const int picNum = m_dpb264->GetPicNumFromDpbIdx(refLists.refPicList[0][i], &shortTerm, &longTerm);
+        if (longTerm) {
+            // The LongTermPicNum of a frame is its LongTermFrameIdx
+            refPicList0Mod[m_refList0ModOpCount].modification_of_pic_nums_idc =
+                STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_LONG_TERM;
+            refPicList0Mod[m_refList0ModOpCount].long_term_pic_num = (uint16_t)picNum;
             m_refList0ModOpCount++;
-            picNumLXPred = m_dpb264->GetPicNum(refLists.refPicList[0][i]);
+            continue;
+        }
+        int diff = picNum - picNumLXPred;
+        if (diff <= 0) {
+            refPicList0Mod[m_refList0ModOpCount].modification_of_pic_nums_idc =
+                STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_SHORT_TERM_SUBTRACT;
+            refPicList0Mod[m_refList0ModOpCount].abs_diff_pic_num_minus1 = abs(diff) ? abs(diff) - 1 : maxPicNum - 1;
+        } else {
+            refPicList0Mod[m_refList0ModOpCount].modification_of_pic_nums_idc =
+                STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_SHORT_TERM_ADD;
+            refPicList0Mod[m_refList0ModOpCount].abs_diff_pic_num_minus1 = abs(diff) - 1;
         }
-    } else if (numLTR) {
-        // If we end up supporting LTR, add code here.
+        m_refList0ModOpCount++;
+        picNumLXPred = picNum;
     }
 
     refPicList0Mod[m_refList0ModOpCount++].modification_of_pic_nums_idc = STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_END;
@@ -213,6 +249,30 @@ VkResult VkVideoEncoderH264::SetupRefPicReorderingCommands(const PicInfoH264 *pP
     return VK_SUCCESS;
 }
 
+void VkVideoEncoderH264::SetupTemporalLayerRefPicCommands(const PicInfoH264 *pPicInfo,
+                                                          VkVideoEncodeFrameInfoH264* pFrameInfo,
+                                                          StdVideoEncodeH264ReferenceListsInfoFlags* pFlags,
+                                                          uint8_t& refList0ModOpCount)
+{
+    // Move the reference picture of the temporal layer to the front of the list, as the only active one,
+    // so that the frames of each layer only predict from the layers below it.
+    const int32_t maxPicNum = 1 << (m_h264.m_spsInfo.log2_max_frame_num_minus4 + 4);
+    const uint32_t refFrameNum = m_temporalLayerRefFrameNum[pFrameInfo->stdPictureInfo.temporal_id];
+    const int32_t absDiffPicNum = ((int32_t)pPicInfo->frame_num - (int32_t)refFrameNum + maxPicNum) % maxPicNum;
+    assert(absDiffPicNum > 0);
+
+    pFlags->ref_pic_list_modification_flag_l0 = true;
+    refList0ModOpCount = 0;
+    pFrameInfo->refList0ModOperations[refList0ModOpCount].modification_of_pic_nums_idc =
+        STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_SHORT_TERM_SUBTRACT;
+    pFrameInfo->refList0ModOperations[refList0ModOpCount++].abs_diff_pic_num_minus1 = absDiffPicNum - 1;
+    pFrameInfo->refList0ModOperations[refList0ModOpCount++].modification_of_pic_nums_idc =
+        STD_VIDEO_H264_MODIFICATION_OF_PIC_NUMS_IDC_END;
+
+    pFrameInfo->stdSliceHeader.flags.num_ref_idx_active_override_flag = true;
+    pFrameInfo->stdReferenceListsInfo.num_ref_idx_l0_active_minus1 = 0;
+}
+
 VkResult VkVideoEncoderH264::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                         uint32_t frameIdx, uint32_t ofTotalFrames)
 {
@@ -236,6 +296,19 @@ VkResult VkVideoEncoderH264::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
         m_frameNumSyntax++;
     }
 
+    // The references lost by the receiver, from the frames before this one
+    bool referencesInvalidated = false;
+    uint64_t invalidTimeStamp = 0;
+    while (GetReferenceInvalidation(encodeFrameInfo->inputTimeStamp, invalidTimeStamp)) {
+        if (m_dpb264->InvalidateReferenceFrames(invalidTimeStamp)) {
+            referencesInvalidated = true;
+            if (m_verbose) {
+                std::cout << "Invalidated the references from timestamp " << invalidTimeStamp
+                          << ", at frame " << encodeFrameInfo->frameInputOrderNum << std::endl;
+            }
+        }
+    }
+
     bool success = m_dpbImagePool->GetAvailableImage(encodeFrameInfo->setupImageResource,
                                                      VK_IMAGE_LAYOUT_VIDEO_ENCODE_DPB_KHR);
     assert(success);
@@ -261,13 +334,55 @@ VkResult VkVideoEncoderH264::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
         }
     }
 
+    if (m_encoderConfig->gopStructure.GetPyramid() && isReference && !pictureInfo.flags.IdrPicFlag &&
+            (picType != VkVideoGopStructure::FRAME_TYPE_B)) {
+        // The reference B-frames of the pyramid before this anchor are done with, only the previous anchor stays
+        int32_t picNums[MAX_MEM_MGMNT_CTRL_OPS_COMMANDS - 2];
+        const int32_t numPicNums = m_dpb264->GetPicNumsExceptMaxPOC(0, picNums, ARRAYSIZE(picNums));
+        for (int32_t i = 0; i < numPicNums; i++) {
+            pFrameInfo->refPicMarkingEntry[refPicMarkingOpCount].memory_management_control_operation =
+                STD_VIDEO_H264_MEM_MGMT_CONTROL_OP_UNMARK_SHORT_TERM;
+            pFrameInfo->refPicMarkingEntry[refPicMarkingOpCount++].difference_of_pic_nums_minus1 =
+                (uint16_t)(pictureInfo.frame_num - picNums[i] - 1);
+        }
+        if (numPicNums > 0) {
+            pFrameInfo->refPicMarkingEntry[refPicMarkingOpCount++].memory_management_control_operation =
+                STD_VIDEO_H264_MEM_MGMT_CONTROL_OP_END;
+            pictureInfo.flags.adaptive_ref_pic_marking_mode_flag = true;
+            pFrameInfo->stdPictureInfo.flags.adaptive_ref_pic_marking_mode_flag = true;
+        }
+    }
+
     // ref_pic_list_modification
     uint8_t refList0ModOpCount = 0;
     uint8_t refList1ModOpCount = 0;
 
     StdVideoEncodeH264ReferenceListsInfoFlags refMgmtFlags = StdVideoEncodeH264ReferenceListsInfoFlags();
+    bool predictsFromCorruptedFrames = false;
     if ((m_dpb264->IsRefFramesCorrupted()) && ((picType == VkVideoGopStructure::FRAME_TYPE_P) || (picType == VkVideoGopStructure::FRAME_TYPE_B))) {
         SetupRefPicReorderingCommands(&pictureInfo, &pFrameInfo->stdSliceHeader, &refMgmtFlags, pFrameInfo->refList0ModOperations, refList0ModOpCount);
+        predictsFromCorruptedFrames = (refList0ModOpCount == 0);
+        if (!predictsFromCorruptedFrames) {
+            // Only the valid references are active
+            pFrameInfo->stdSliceHeader.flags.num_ref_idx_active_override_flag = true;
+            pFrameInfo->stdReferenceListsInfo.num_ref_idx_l0_active_minus1 = refList0ModOpCount - 2;
+        }
+    } else if ((m_encoderConfig->gopStructure.GetTemporalLayerCount() > 1) && (picType == VkVideoGopStructure::FRAME_TYPE_P)) {
+        SetupTemporalLayerRefPicCommands(&pictureInfo, pFrameInfo, &refMgmtFlags, refList0ModOpCount);
+    }
+
+    if (pFrameInfo->islongTermReference && !pictureInfo.flags.IdrPicFlag && !predictsFromCorruptedFrames) {
+        // The frame replaces the long-term reference, after the operations above but for their end
+        if (refPicMarkingOpCount > 0) {
+            refPicMarkingOpCount--;
+        }
+        pFrameInfo->refPicMarkingEntry[refPicMarkingOpCount].memory_management_control_operation =
+            STD_VIDEO_H264_MEM_MGMT_CONTROL_OP_MARK_CURRENT_AS_LONG_TERM;
+        pFrameInfo->refPicMarkingEntry[refPicMarkingOpCount++].long_term_frame_idx = 0;
+        pFrameInfo->refPicMarkingEntry[refPicMarkingOpCount++].memory_management_control_operation =
+            STD_VIDEO_H264_MEM_MGMT_CONTROL_OP_END;
+        pictureInfo.flags.adaptive_ref_pic_marking_mode_flag = true;
+        pFrameInfo->stdPictureInfo.flags.adaptive_ref_pic_marking_mode_flag = true;
     }
 
     // Fill in the reference-related information for the current picture
@@ -318,9 +433,19 @@ VkResult VkVideoEncoderH264::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
                                                    &pFrameInfo->stdReferenceListsInfo, MAX_MEM_MGMNT_CTRL_OPS_COMMANDS);
     if (isReference) {
         assert(targetDpbSlot >= 0);
+
+        // The frames of the upper layers predict from this one, and so does the next base layer frame.
+        const uint8_t temporalId = pFrameInfo->stdPictureInfo.temporal_id;
+        for (uint32_t layer = 0; layer < ARRAYSIZE(m_temporalLayerRefFrameNum); layer++) {
+            if ((layer > temporalId) || (temporalId == 0)) {
+                m_temporalLayerRefFrameNum[layer] = pictureInfo.frame_num;
+            }
+        }
     }
 
-    if ((picType == VkVideoGopStructure::FRAME_TYPE_P) || (picType == VkVideoGopStructure::FRAME_TYPE_B)) {
+    if ((picType == VkVideoGopStructure::FRAME_TYPE_P) || (picType == VkVideoGopStructure::FRAME_TYPE_B) ||
+            (refPicMarkingOpCount > 0)) {
+        // The intra frames too, for their memory management control operations
         pFrameInfo->stdPictureInfo.pRefLists = &pFrameInfo->stdReferenceListsInfo;
     }
 
@@ -384,13 +509,20 @@ VkResult VkVideoEncoderH264::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
     pFrameInfo->encodeInfo.referenceSlotCount = numReferenceSlots - 1;
     pFrameInfo->encodeInfo.pReferenceSlots = pFrameInfo->referenceSlotsInfo + 1;
 
-    if ((picType == VkVideoGopStructure::FRAME_TYPE_P) || (picType == VkVideoGopStructure::FRAME_TYPE_B)) {
-        uint64_t timeStamp = m_dpb264->GetPictureTimestamp(pFrameInfo->referenceSlotsInfo[0].slotIndex);
+    if (((picType == VkVideoGopStructure::FRAME_TYPE_P) || (picType == VkVideoGopStructure::FRAME_TYPE_B)) &&
+            (numReferenceSlots > 1)) {
+        // The first L0 reference, after the setup slot
+        uint64_t timeStamp = m_dpb264->GetPictureTimestamp(pFrameInfo->referenceSlotsInfo[1].slotIndex);
         m_dpb264->SetCurRefFrameTimeStamp(timeStamp);
     } else {
         m_dpb264->SetCurRefFrameTimeStamp(0);
     }
 
+    if (referencesInvalidated && !predictsFromCorruptedFrames) {
+        // The lost frames between this frame and its reference no longer matter to the frames from it on
+        m_dpb264->SetCurRecoveryFrame();
+    }
+
     assert(m_dpb264->GetNumRefFramesInDPB(0) <= m_h264.m_spsInfo.max_num_ref_frames);
 
     return VK_SUCCESS;
@@ -466,19 +598,20 @@ VkResult VkVideoEncoderH264::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
 
     encodeFrameInfo->frameEncodeOrderNum = m_encodeFrameNum++;
 
-    encodeFrameInfo->positionInGopInDisplayOrder = m_encoderConfig->gopStructure.GetPositionInGOP(m_positionInGopInDisplayOrder,
-                                                                                                  encodeFrameInfo->pictureType,
-                                                                                                  (encodeFrameInfo->frameEncodeOrderNum == 0),
-                                                                                                  encodeFrameInfo->lastFrame);
+    UpdateFrameRateControl(encodeFrameInfo);
+
+    encodeFrameInfo->positionInGopInDisplayOrder = GetPositionInGop(encodeFrameInfo, m_positionInGopInDisplayOrder);
 
     if (encodeFrameInfo->frameEncodeOrderNum == 0) {
         assert(encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR);
     }
     const bool isIdr = ((encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) ||
                         (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_INTRA_REFRESH));
-    const bool isReference = m_encoderConfig->gopStructure.IsFrameReference(encodeFrameInfo->frameEncodeOrderNum);
+    const bool isReference = m_encoderConfig->gopStructure.IsFrameReference(encodeFrameInfo->positionInGopInDisplayOrder);
 
-    encodeFrameInfo->picOrderCntVal = 2 * encodeFrameInfo->positionInGopInDisplayOrder;
+    // Without the periodic IDR frames restarting it, the POC of the intra refresh counts on past the GOP position
+    encodeFrameInfo->picOrderCntVal = 2 * (m_encoderConfig->gopStructure.GetIntraRefresh() ? (int32_t)m_framesSinceIdr :
+                                                                                             encodeFrameInfo->positionInGopInDisplayOrder);
     encodeFrameInfo->positionInGopInDecodeOrder = m_encoderConfig->gopStructure.GetFrameDecodeOrderPosition(encodeFrameInfo->positionInGopInDisplayOrder);
 
     if (m_encoderConfig->verboseFrameStruct) {
@@ -539,7 +672,19 @@ VkResult VkVideoEncoderH264::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
 
     pFrameInfo->stdPictureInfo.flags.IdrPicFlag = isIdr;
     pFrameInfo->stdPictureInfo.flags.is_reference = isReference;
-    pFrameInfo->stdPictureInfo.flags.long_term_reference_flag = pFrameInfo->islongTermReference;
+    pFrameInfo->stdPictureInfo.temporal_id = m_encoderConfig->gopStructure.GetTemporalId(encodeFrameInfo->positionInGopInDisplayOrder);
+    if (m_encoderConfig->longTermRefInterval > 0) {
+        // The IDR frames, and then a P frame every longTermRefInterval frames, replace the long-term reference
+        m_framesSinceLongTermRef++;
+        pFrameInfo->islongTermReference = isReference &&
+                                          (isIdr || ((encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_P) &&
+                                                     (m_encoderConfig->gopStructure.GetTemporalLayerCount() <= 1) &&
+                                                     (m_framesSinceLongTermRef >= m_encoderConfig->longTermRefInterval)));
+        if (pFrameInfo->islongTermReference) {
+            m_framesSinceLongTermRef = 0;
+        }
+    }
+    pFrameInfo->stdPictureInfo.flags.long_term_reference_flag = isIdr && pFrameInfo->islongTermReference;
     pFrameInfo->stdPictureInfo.primary_pic_type = stdPictureType;
     pFrameInfo->stdPictureInfo.flags.no_output_of_prior_pics_flag = false;        // TODO: replace this by a check for the corresponding slh flag
     pFrameInfo->stdPictureInfo.flags.adaptive_ref_pic_marking_mode_flag = false;  // TODO: replace this by a check for the corresponding slh flag
@@ -548,13 +693,27 @@ VkResult VkVideoEncoderH264::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
      // FIXME: set cabac_init_idc based on a query
      pFrameInfo->stdSliceHeader.cabac_init_idc = STD_VIDEO_H264_CABAC_INIT_IDC_0;
 
+    // The slices of the picture, of whole rows split by the implementation.
+    // With the intra refresh, each P frame also codes the next of the slices as an I slice, down the picture
+    const uint32_t sliceCount = m_encoderConfig->sliceCount;
+    pFrameInfo->pictureInfo.naluSliceEntryCount = sliceCount;
+    for (uint32_t i = 0; i < sliceCount; i++) {
+        pFrameInfo->naluSliceInfo[i].pStdSliceHeader = &pFrameInfo->stdSliceHeader;
+    }
+    if ((m_encoderConfig->intraRefreshPeriod > 0) && (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_P)) {
+        pFrameInfo->stdIntraSliceHeader = pFrameInfo->stdSliceHeader;
+        pFrameInfo->stdIntraSliceHeader.slice_type = STD_VIDEO_H264_SLICE_TYPE_I;
+        pFrameInfo->naluSliceInfo[(m_framesSinceIdr - 1) % sliceCount].pStdSliceHeader = &pFrameInfo->stdIntraSliceHeader;
+    }
+
     if (isIdr) {
         pFrameInfo->stdPictureInfo.idr_pic_id = m_IDRPicId & 1;
         m_IDRPicId++;
     }
 
-    if (isIdr && (encodeFrameInfo->frameEncodeOrderNum == 0)) {
-        VkResult result = EncodeVideoSessionParameters(encodeFrameInfo);
+    // The SPS and PPS are repeated ahead of each IDR frame, for the decoders starting there
+    if (isIdr) {
+        VkResult result = GetEncodedSessionParameters(encodeFrameInfo);
         if (result != VK_SUCCESS) {
             return result;
         }
@@ -569,30 +728,37 @@ VkResult VkVideoEncoderH264::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
     }
 
     // NOTE: dstBuffer resource acquisition can be deferred at the last moment before submit
-    VkDeviceSize size = GetBitstreamBuffer(encodeFrameInfo->outputBitstreamBuffer);
+    VkDeviceSize size = GetBitstreamBuffer(encodeFrameInfo->pictureType, encodeFrameInfo->outputBitstreamBuffer);
     assert((size > 0) && (encodeFrameInfo->outputBitstreamBuffer != nullptr));
     pFrameInfo->encodeInfo.dstBuffer = encodeFrameInfo->outputBitstreamBuffer->GetBuffer();
+    // The whole buffer, for the overflow to be detected at its end
+    pFrameInfo->encodeInfo.dstBufferRange = size;
 
     // For the actual (VCL) data, specify its insertion starting from the
     // provided offset into the bitstream buffer.
     pFrameInfo->encodeInfo.dstBufferOffset = 0;
 
     if (m_rateControlInfo.rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+        int32_t constantQp = 0;
         switch (encodeFrameInfo->pictureType) {
             case VkVideoGopStructure::FRAME_TYPE_IDR:
             case VkVideoGopStructure::FRAME_TYPE_I:
-                pFrameInfo->naluSliceInfo.constantQp = encodeFrameInfo->constQp.qpIntra;
+                constantQp = encodeFrameInfo->constQp.qpIntra;
                 break;
             case VkVideoGopStructure::FRAME_TYPE_P:
-                pFrameInfo->naluSliceInfo.constantQp = encodeFrameInfo->constQp.qpInterP;
+                constantQp = encodeFrameInfo->constQp.qpInterP;
                 break;
             case VkVideoGopStructure::FRAME_TYPE_B:
-                pFrameInfo->naluSliceInfo.constantQp = encodeFrameInfo->constQp.qpInterB;
+                constantQp = encodeFrameInfo->constQp.qpInterB;
                 break;
             default:
                 assert(!"Invalid picture type");
                 break;
         }
+        // The same for all the slices, for the devices without a per slice constant QP or without a QP delta map
+        for (uint32_t i = 0; i < sliceCount; i++) {
+            pFrameInfo->naluSliceInfo[i].constantQp = GetSliceConstantQp(encodeFrameInfo, constantQp, i, sliceCount);
+        }
     }
 
     if (m_sendControlCmd == true) {
@@ -600,7 +766,9 @@ VkResult VkVideoEncoderH264::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
     }
 
     const bool preFlushQueue = isIdr || (encodeFrameInfo->positionInGopInDecodeOrder == 0);
-    const bool postFlushQueue = encodeFrameInfo->lastFrame || isReference;
+    // The reference B-frames of a pyramid are reordered with the other B-frames of their run
+    const bool postFlushQueue = encodeFrameInfo->lastFrame ||
+                                (isReference && (encodeFrameInfo->pictureType != VkVideoGopStructure::FRAME_TYPE_B));
     EnqueueFrame(encodeFrameInfo, preFlushQueue, postFlushQueue);
 
     return VK_SUCCESS;
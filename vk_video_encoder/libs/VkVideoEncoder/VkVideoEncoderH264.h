@@ -33,11 +33,12 @@ public:
     struct VkVideoEncodeFrameInfoH264 : public VkVideoEncodeFrameInfo {
 
         VkVideoEncodeH264PictureInfoKHR          pictureInfo;
-        VkVideoEncodeH264NaluSliceInfoKHR        naluSliceInfo;
+        VkVideoEncodeH264NaluSliceInfoKHR        naluSliceInfo[MAX_NUM_SLICES_H264];
         StdVideoEncodeH264PictureInfo            stdPictureInfo;
         StdVideoEncodeH264SliceHeader            stdSliceHeader;
+        StdVideoEncodeH264SliceHeader            stdIntraSliceHeader; // of the slice the intra refresh codes
         VkVideoEncodeH264RateControlInfoKHR      rateControlInfoH264;
-        VkVideoEncodeH264RateControlLayerInfoKHR rateControlLayersInfoH264[1];
+        VkVideoEncodeH264RateControlLayerInfoKHR rateControlLayersInfoH264[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
         StdVideoEncodeH264ReferenceListsInfo     stdReferenceListsInfo;
         StdVideoEncodeH264ReferenceInfo          stdReferenceInfo[MAX_REFFERENCES];
         VkVideoEncodeH264DpbSlotInfoKHR          stdDpbSlotInfo[MAX_REFFERENCES];
@@ -48,9 +49,10 @@ public:
         VkVideoEncodeFrameInfoH264()
           : VkVideoEncodeFrameInfo(&pictureInfo)
           , pictureInfo { VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_PICTURE_INFO_KHR }
-          , naluSliceInfo { VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_NALU_SLICE_INFO_KHR }
+          , naluSliceInfo()
           , stdPictureInfo()
           , stdSliceHeader()
+          , stdIntraSliceHeader()
           , rateControlInfoH264{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_RATE_CONTROL_INFO_KHR }
           , rateControlLayersInfoH264 { VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_RATE_CONTROL_LAYER_INFO_KHR }
           , stdReferenceListsInfo()
@@ -60,10 +62,13 @@ public:
           , refList1ModOperations{}
           , refPicMarkingEntry{}
         {
-            pictureInfo.naluSliceEntryCount = 1; // FIXME: support more than one
-            pictureInfo.pNaluSliceEntries = &naluSliceInfo;
+            pictureInfo.naluSliceEntryCount = 1;
+            pictureInfo.pNaluSliceEntries = naluSliceInfo;
             pictureInfo.pStdPictureInfo = &stdPictureInfo;
-            naluSliceInfo.pStdSliceHeader = &stdSliceHeader;
+            for (uint32_t i = 0; i < MAX_NUM_SLICES_H264; i++) {
+                naluSliceInfo[i].sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_NALU_SLICE_INFO_KHR;
+                naluSliceInfo[i].pStdSliceHeader = &stdSliceHeader;
+            }
 
             stdPictureInfo.pRefLists           = &stdReferenceListsInfo;
         };
@@ -75,9 +80,10 @@ public:
 
             // Clear and check state
             assert(pictureInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_PICTURE_INFO_KHR);
-            assert(naluSliceInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_NALU_SLICE_INFO_KHR);
+            assert(naluSliceInfo[0].sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_NALU_SLICE_INFO_KHR);
             // stdPictureInfo()
             // stdSliceHeader()
+            // stdIntraSliceHeader()
             assert(rateControlInfoH264.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_RATE_CONTROL_INFO_KHR);
             assert(rateControlLayersInfoH264[0].sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_RATE_CONTROL_LAYER_INFO_KHR);
             // stdReferenceListsInfo()
@@ -99,10 +105,14 @@ public:
         , m_positionInGopInDisplayOrder()
         , m_h264()
         , m_dpb264()
+        , m_temporalLayerRefFrameNum()
+        , m_framesSinceLongTermRef()
     { }
 
     virtual VkResult InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& encoderConfig);
     virtual VkResult InitRateControl(VkCommandBuffer cmdBuf, uint32_t qp);
+    virtual void UpdateRateControlParameters(int32_t minQp, int32_t maxQp);
+    virtual VkResult CreateVideoSessionParameters(uint32_t qualityLevel);
     virtual VkResult EncodeVideoSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
     virtual VkResult ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                 uint32_t frameIdx, uint32_t ofTotalFrames);
@@ -154,11 +164,19 @@ private:
                                            StdVideoEncodeH264RefListModEntry* m_ref_pic_list_modification_l0,
                                            uint8_t& m_refList0ModOpCount);
 
+    void SetupTemporalLayerRefPicCommands(const PicInfoH264 *pPicInfo,
+                                          VkVideoEncodeFrameInfoH264* pFrameInfo,
+                                          StdVideoEncodeH264ReferenceListsInfoFlags* pFlags,
+                                          uint8_t& refList0ModOpCount);
+
 private:
     VkSharedBaseObj<EncoderConfigH264> m_encoderConfig;
     uint8_t                            m_positionInGopInDisplayOrder;
     EncoderH264State                   m_h264;
     VkEncDpbH264*                      m_dpb264;
+    // The frame_num of the reference picture the next frame of each temporal layer predicts from
+    uint32_t                           m_temporalLayerRefFrameNum[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
+    uint32_t                           m_framesSinceLongTermRef; // with longTermRefInterval
     VkSharedBaseObj<VulkanBufferPool<VkVideoEncodeFrameInfoH264>> m_frameInfoBuffersQueue;
 };
 
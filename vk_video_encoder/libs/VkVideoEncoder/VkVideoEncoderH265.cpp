@@ -15,6 +15,7 @@
  */
 
 #include "VkVideoEncoder/VkVideoEncoderH265.h"
+#include "VkVideoEncoder/VkVideoEncoderSplitFrameH265.h"
 #include "VkVideoCore/VulkanVideoCapabilities.h"
 
 VkResult CreateVideoEncoderH265(const VulkanDeviceContext* vkDevCtx,
@@ -67,14 +68,50 @@ VkResult VkVideoEncoderH265::InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& en
                                                    &m_sps.hrdParameters,
                                                    &m_sps.subLayerHrdParametersNal));
 
+    if ((m_encoderConfig->splitFrameBands > 1) && (m_encoderConfig->splitFrameBandIndex == 0)) {
+        // The parameter sets of the whole picture, with the bitrate of all the bands, written in place of the
+        // band's. The band's PPS is the picture's.
+        const uint32_t bandHeight = m_encoderConfig->encodeHeight;
+        const uint32_t averageBitrate = m_encoderConfig->averageBitrate;
+        const uint32_t maxBitrate = m_encoderConfig->maxBitrate;
+        const uint32_t hrdBitrate = m_encoderConfig->hrdBitrate;
+        m_encoderConfig->encodeHeight = m_encoderConfig->splitFrameHeight;
+        m_encoderConfig->averageBitrate = (uint32_t)(((uint64_t)averageBitrate * m_encoderConfig->splitFrameHeight) / bandHeight);
+        m_encoderConfig->maxBitrate = (uint32_t)(((uint64_t)maxBitrate * m_encoderConfig->splitFrameHeight) / bandHeight);
+        m_encoderConfig->hrdBitrate = (uint32_t)(((uint64_t)hrdBitrate * m_encoderConfig->splitFrameHeight) / bandHeight);
+        StdVideoH265PictureParameterSet pps{};
+        m_encoderConfig->InitParamameters(&m_splitFrameVps, &m_splitFrameSps, &pps,
+                m_encoderConfig->InitVuiParameters(&m_splitFrameSps.vuiInfo,
+                                                   &m_splitFrameSps.hrdParameters,
+                                                   &m_splitFrameSps.subLayerHrdParametersNal));
+        m_encoderConfig->encodeHeight = bandHeight;
+        m_encoderConfig->averageBitrate = averageBitrate;
+        m_encoderConfig->maxBitrate = maxBitrate;
+        m_encoderConfig->hrdBitrate = hrdBitrate;
+    }
+
+    return CreateVideoSessionParameters(m_encoderConfig->qualityLevel);
+}
+
+VkResult VkVideoEncoderH265::CreateVideoSessionParameters(uint32_t qualityLevel)
+{
+    VkResult result = CreateVideoSessionParameters(m_vps, m_sps, qualityLevel, m_videoSessionParameters);
+    if ((result == VK_SUCCESS) && (m_encoderConfig->splitFrameBands > 1) && (m_encoderConfig->splitFrameBandIndex == 0)) {
+        result = CreateVideoSessionParameters(m_splitFrameVps, m_splitFrameSps, qualityLevel, m_splitFrameSessionParameters);
+    }
+    return result;
+}
 
+VkResult VkVideoEncoderH265::CreateVideoSessionParameters(VpsH265& vps, SpsH265& sps, uint32_t qualityLevel,
+                                                          VkSharedBaseObj<VulkanVideoSessionParameters>& videoSessionParameters)
+{
     VkVideoEncodeH265SessionParametersAddInfoKHR encodeH265SessionParametersAddInfo = {
         VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_SESSION_PARAMETERS_ADD_INFO_KHR};
 
     encodeH265SessionParametersAddInfo.stdVPSCount = 1;
-    encodeH265SessionParametersAddInfo.pStdVPSs = &m_vps.vpsInfo;
+    encodeH265SessionParametersAddInfo.pStdVPSs = &vps.vpsInfo;
     encodeH265SessionParametersAddInfo.stdSPSCount = 1;
-    encodeH265SessionParametersAddInfo.pStdSPSs = &m_sps.sps;
+    encodeH265SessionParametersAddInfo.pStdSPSs = &sps.sps;
     encodeH265SessionParametersAddInfo.stdPPSCount = 1;
     encodeH265SessionParametersAddInfo.pStdPPSs = &m_pps;
 
@@ -84,12 +121,16 @@ VkResult VkVideoEncoderH265::InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& en
         &encodeH265SessionParametersAddInfo
     };
 
+    // The encodes with these parameters must use the same quality level
+    VkVideoEncodeQualityLevelInfoKHR qualityLevelInfo = {
+        VK_STRUCTURE_TYPE_VIDEO_ENCODE_QUALITY_LEVEL_INFO_KHR, &encodeH265SessionParametersCreateInfo, qualityLevel};
+
     VkVideoSessionParametersCreateInfoKHR encodeSessionParametersCreateInfo = {
-        VK_STRUCTURE_TYPE_VIDEO_SESSION_PARAMETERS_CREATE_INFO_KHR, &encodeH265SessionParametersCreateInfo};
+        VK_STRUCTURE_TYPE_VIDEO_SESSION_PARAMETERS_CREATE_INFO_KHR, &qualityLevelInfo};
     encodeSessionParametersCreateInfo.videoSession = *m_videoSession;
 
     VkVideoSessionParametersKHR sessionParameters;
-    result = m_vkDevCtx->CreateVideoSessionParametersKHR(*m_vkDevCtx,
+    VkResult result = m_vkDevCtx->CreateVideoSessionParametersKHR(*m_vkDevCtx,
                                                          &encodeSessionParametersCreateInfo,
                                                          nullptr,
                                                          &sessionParameters);
@@ -99,7 +140,7 @@ VkResult VkVideoEncoderH265::InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& en
     }
 
     result = VulkanVideoSessionParameters::Create(m_vkDevCtx, m_videoSession,
-                                                  sessionParameters, m_videoSessionParameters);
+                                                  sessionParameters, videoSessionParameters);
     if(result != VK_SUCCESS) {
         fprintf(stderr, "\nEncodeFrame Error: Failed to get create video session object.\n");
         return result;
@@ -113,11 +154,38 @@ VkResult VkVideoEncoderH265::InitRateControl(VkCommandBuffer cmdBuf, uint32_t qp
     return VK_NOT_READY;
 }
 
+void VkVideoEncoderH265::UpdateRateControlParameters(int32_t minQp, int32_t maxQp)
+{
+    m_encoderConfig->GetRateControlParameters(&m_rateControlInfo, m_rateControlLayersInfo, &m_rateControlInfoH265, m_rateControlLayersInfoH265);
+
+    for (uint32_t layerIndx = 0; layerIndx < ARRAYSIZE(m_rateControlLayersInfoH265); layerIndx++) {
+        VkVideoEncodeH265RateControlLayerInfoKHR& rateControlLayerInfo = m_rateControlLayersInfoH265[layerIndx];
+        if (minQp >= 0) {
+            rateControlLayerInfo.useMinQp = VK_TRUE;
+            rateControlLayerInfo.minQp = { minQp, minQp, minQp };
+        }
+        if (maxQp >= 0) {
+            rateControlLayerInfo.useMaxQp = VK_TRUE;
+            rateControlLayerInfo.maxQp = { maxQp, maxQp, maxQp };
+        }
+    }
+}
+
 VkResult VkVideoEncoderH265::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                         uint32_t frameIdx, uint32_t ofTotalFrames)
 {
     VkVideoEncodeFrameInfoH265* pFrameInfo = GetEncodeFrameInfoH265(encodeFrameInfo);
 
+    // The DPB doesn't track the corrupted references, a lost frame is recovered from with an IDR frame
+    uint64_t invalidTimeStamp = 0;
+    while (GetReferenceInvalidation(encodeFrameInfo->inputTimeStamp, invalidTimeStamp)) {
+        if (m_verbose) {
+            std::cout << "Invalidated the references from timestamp " << invalidTimeStamp
+                      << ", at frame " << encodeFrameInfo->frameInputOrderNum << std::endl;
+        }
+        m_forceIdrFrame = true;
+    }
+
     // TODO: Optimize this below very complex and inefficient DPB management code.
 
     uint32_t numRefL0 = m_encoderConfig->numRefL0;
@@ -133,9 +201,13 @@ VkResult VkVideoEncoderH265::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
         }
     }
 
+    // With the pyramid, each I or P frame drops the reference B-frames before it, keeping the previous anchor
+    const bool keepLatestReferenceOnly = m_encoderConfig->gopStructure.GetPyramid() &&
+        ((encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_P) ||
+         (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_I));
     m_dpb.ReferencePictureMarking(encodeFrameInfo->picOrderCntVal,
                                   (StdVideoH265PictureType)encodeFrameInfo->pictureType,
-                                  m_sps.sps.flags.long_term_ref_pics_present_flag);
+                                  m_sps.sps.flags.long_term_ref_pics_present_flag, keepLatestReferenceOnly);
 
 
     if (!pFrameInfo->stdPictureInfo.flags.no_output_of_prior_pics_flag) {
@@ -198,7 +270,8 @@ VkResult VkVideoEncoderH265::ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>&
         pFrameInfo->stdPictureInfo.pRefLists = nullptr;
     }
 
-    m_dpb.DpbPictureEnd(encodeFrameInfo->setupImageResource, 1 /* numTemporalLayers */, pFrameInfo->stdPictureInfo.flags.is_reference);
+    m_dpb.DpbPictureEnd(encodeFrameInfo->setupImageResource, m_encoderConfig->gopStructure.GetTemporalLayerCount(),
+                        pFrameInfo->stdPictureInfo.flags.is_reference);
 
     // ***************** Start Update DPB info ************** //
 
@@ -305,10 +378,11 @@ VkResult VkVideoEncoderH265::EncodeVideoSessionParameters(VkSharedBaseObj<VkVide
         pFrameInfo->stdPictureInfo.pps_pic_parameter_set_id
     };
 
+    // The split frames start with the parameter sets of the whole picture
     VkVideoEncodeSessionParametersGetInfoKHR sessionParametersGetInfo = {
         VK_STRUCTURE_TYPE_VIDEO_ENCODE_SESSION_PARAMETERS_GET_INFO_KHR,
         &sessionParametersGetInfoH265,
-        *pFrameInfo->videoSessionParameters,
+        m_splitFrameSessionParameters ? *m_splitFrameSessionParameters : *pFrameInfo->videoSessionParameters,
     };
 
     VkVideoEncodeH265SessionParametersFeedbackInfoKHR sessionParametersFeedbackInfoH265 = {
@@ -335,6 +409,24 @@ VkResult VkVideoEncoderH265::EncodeVideoSessionParameters(VkSharedBaseObj<VkVide
     return result;
 }
 
+bool VkVideoEncoderH265::AppendSplitFrameBandSlices(const uint8_t* data, size_t size, uint32_t bandIndex,
+                                                    std::vector<uint8_t>& frameData)
+{
+    uint32_t bandY = 0;
+    uint32_t bandHeight = 0;
+    if (!m_encoderConfig->GetSplitFrameBand(bandIndex, bandY, bandHeight)) {
+        return false;
+    }
+
+    const uint32_t ctbSize = m_encoderConfig->GetSliceRowHeight();
+    const uint32_t picWidthInCtbs = DivUp<uint32_t>(m_encoderConfig->encodeWidth, ctbSize);
+    return VkVideoEncoderSplitFrameH265::AppendBandSlices(m_sps, m_pps,
+                                                          picWidthInCtbs * DivUp<uint32_t>(bandHeight, ctbSize),
+                                                          picWidthInCtbs * (bandY / ctbSize),
+                                                          picWidthInCtbs * DivUp<uint32_t>(m_encoderConfig->splitFrameHeight, ctbSize),
+                                                          data, size, frameData);
+}
+
 VkResult VkVideoEncoderH265::CreateFrameInfoBuffersQueue(uint32_t numPoolNodes)
 {
     VkSharedBaseObj<VulkanBufferPool<VkVideoEncodeFrameInfoH265>> _cmdBuffPool(new VulkanBufferPool<VkVideoEncodeFrameInfoH265>());
@@ -358,19 +450,20 @@ VkResult VkVideoEncoderH265::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
 
     encodeFrameInfo->frameEncodeOrderNum = m_encodeFrameNum++;
 
-    encodeFrameInfo->positionInGopInDisplayOrder = m_encoderConfig->gopStructure.GetPositionInGOP(m_positionInGopInDisplayOrder,
-                                                                                                  encodeFrameInfo->pictureType,
-                                                                                                 (encodeFrameInfo->frameEncodeOrderNum == 0),
-                                                                                                  encodeFrameInfo->lastFrame);
+    UpdateFrameRateControl(encodeFrameInfo);
+
+    encodeFrameInfo->positionInGopInDisplayOrder = GetPositionInGop(encodeFrameInfo, m_positionInGopInDisplayOrder);
 
     if (encodeFrameInfo->frameEncodeOrderNum == 0) {
         assert(encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR);
     }
     const bool isIdr = ((encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_IDR) ||
                         (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_INTRA_REFRESH));
-    const bool isReference = m_encoderConfig->gopStructure.IsFrameReference(encodeFrameInfo->frameEncodeOrderNum);
+    const bool isReference = m_encoderConfig->gopStructure.IsFrameReference(encodeFrameInfo->positionInGopInDisplayOrder);
 
-    encodeFrameInfo->picOrderCntVal = encodeFrameInfo->positionInGopInDisplayOrder;
+    // Without the periodic IDR frames restarting it, the POC of the intra refresh counts on past the GOP position
+    encodeFrameInfo->picOrderCntVal = m_encoderConfig->gopStructure.GetIntraRefresh() ? (int32_t)m_framesSinceIdr :
+                                                                                        encodeFrameInfo->positionInGopInDisplayOrder;
     encodeFrameInfo->positionInGopInDecodeOrder = m_encoderConfig->gopStructure.GetFrameDecodeOrderPosition(encodeFrameInfo->positionInGopInDisplayOrder);
 
     if (m_encoderConfig->verboseFrameStruct) {
@@ -409,17 +502,20 @@ VkResult VkVideoEncoderH265::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
     VkResult result = VK_SUCCESS;
 
 
-    VkDeviceSize size = GetBitstreamBuffer(encodeFrameInfo->outputBitstreamBuffer);
+    VkDeviceSize size = GetBitstreamBuffer(encodeFrameInfo->pictureType, encodeFrameInfo->outputBitstreamBuffer);
     assert((size > 0) && (encodeFrameInfo->outputBitstreamBuffer != nullptr));
     pFrameInfo->encodeInfo.dstBuffer = encodeFrameInfo->outputBitstreamBuffer->GetBuffer();
+    // The whole buffer, for the overflow to be detected at its end
+    pFrameInfo->encodeInfo.dstBufferRange = size;
 
     // For the actual (VCL) data, specify its insertion starting from the
     // provided offset into the bitstream buffer.
     encodeFrameInfo->encodeInfo.dstBufferOffset = 0; // FIXME: pEncPicParams->bitstreamBufferOffset;
 
-    if (isIdr && (encodeFrameInfo->frameEncodeOrderNum == 0 /*|| pEncodeConfigH265->repeatSPSPPS || m_bReconfigForcedIDR*/)) {
+    // The VPS, SPS and PPS are repeated ahead of each IDR frame, for the decoders starting there
+    if (isIdr) {
 
-        result = EncodeVideoSessionParameters(encodeFrameInfo);
+        result = GetEncodedSessionParameters(encodeFrameInfo);
         if (result != VK_SUCCESS ) {
             assert(result == VK_SUCCESS);
             return result;
@@ -469,22 +565,43 @@ VkResult VkVideoEncoderH265::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
     pFrameInfo->stdSliceSegmentHeader.flags.collocated_from_l0_flag = 0;
     pFrameInfo->stdSliceSegmentHeader.flags.slice_loop_filter_across_slices_enabled_flag = 0;
 
+    // The slice segments of the picture, of whole rows split by the implementation.
+    // With the intra refresh, each P frame also codes the next of the slice segments as an I slice, down the picture
+    const uint32_t sliceSegmentCount = m_encoderConfig->sliceCount;
+    pFrameInfo->pictureInfo.naluSliceSegmentEntryCount = sliceSegmentCount;
+    for (uint32_t i = 0; i < sliceSegmentCount; i++) {
+        pFrameInfo->naluSliceSegmentInfo[i].pStdSliceSegmentHeader = &pFrameInfo->stdSliceSegmentHeader;
+    }
+    if ((m_encoderConfig->intraRefreshPeriod > 0) && (encodeFrameInfo->pictureType == VkVideoGopStructure::FRAME_TYPE_P)) {
+        pFrameInfo->stdIntraSliceSegmentHeader = pFrameInfo->stdSliceSegmentHeader;
+        pFrameInfo->stdIntraSliceSegmentHeader.slice_type = STD_VIDEO_H265_SLICE_TYPE_I;
+        pFrameInfo->naluSliceSegmentInfo[(m_framesSinceIdr - 1) % sliceSegmentCount].pStdSliceSegmentHeader =
+            &pFrameInfo->stdIntraSliceSegmentHeader;
+    }
+
     if (m_rateControlInfo.rateControlMode == VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) {
+        int32_t constantQp = 0;
         switch (encodeFrameInfo->pictureType) {
             case VkVideoGopStructure::FRAME_TYPE_IDR:
             case VkVideoGopStructure::FRAME_TYPE_I:
-                pFrameInfo->naluSliceSegmentInfo.constantQp = encodeFrameInfo->constQp.qpIntra;
+                constantQp = encodeFrameInfo->constQp.qpIntra;
                 break;
             case VkVideoGopStructure::FRAME_TYPE_P:
-                pFrameInfo->naluSliceSegmentInfo.constantQp = encodeFrameInfo->constQp.qpInterP;
+                constantQp = encodeFrameInfo->constQp.qpInterP;
                 break;
             case VkVideoGopStructure::FRAME_TYPE_B:
-                pFrameInfo->naluSliceSegmentInfo.constantQp = encodeFrameInfo->constQp.qpInterB;
+                constantQp = encodeFrameInfo->constQp.qpInterB;
                 break;
             default:
                 assert(!"Invalid picture type");
                 break;
         }
+        // The same for all the slice segments, for the devices without a per slice segment constant QP or without
+        // a QP delta map
+        for (uint32_t i = 0; i < sliceSegmentCount; i++) {
+            pFrameInfo->naluSliceSegmentInfo[i].constantQp = GetSliceConstantQp(encodeFrameInfo, constantQp,
+                                                                                i, sliceSegmentCount);
+        }
     }
 
     pFrameInfo->stdPictureInfo.flags.is_reference = isReference;
@@ -497,7 +614,7 @@ VkResult VkVideoEncoderH265::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
     pFrameInfo->stdPictureInfo.pps_seq_parameter_set_id = m_sps.sps.sps_seq_parameter_set_id;
     pFrameInfo->stdPictureInfo.pps_pic_parameter_set_id = m_pps.pps_pic_parameter_set_id;
     pFrameInfo->stdPictureInfo.PicOrderCntVal = encodeFrameInfo->picOrderCntVal;
-    pFrameInfo->stdPictureInfo.TemporalId = 0;
+    pFrameInfo->stdPictureInfo.TemporalId = m_encoderConfig->gopStructure.GetTemporalId(encodeFrameInfo->positionInGopInDisplayOrder);
 
 
     if (m_sendControlCmd == true) {
@@ -505,7 +622,9 @@ VkResult VkVideoEncoderH265::EncodeFrame(VkSharedBaseObj<VkVideoEncodeFrameInfo>
     }
 
     const bool preFlushQueue = isIdr || (encodeFrameInfo->positionInGopInDecodeOrder == 0);
-    const bool postFlushQueue = encodeFrameInfo->lastFrame | isReference;
+    // The reference B-frames of a pyramid are reordered with the other B-frames of their run
+    const bool postFlushQueue = encodeFrameInfo->lastFrame ||
+                                (isReference && (encodeFrameInfo->pictureType != VkVideoGopStructure::FRAME_TYPE_B));
     EnqueueFrame(encodeFrameInfo, preFlushQueue, postFlushQueue);
     return result;
 }
@@ -30,11 +30,12 @@ class VkVideoEncoderH265 : public VkVideoEncoder {
     struct VkVideoEncodeFrameInfoH265 : public VkVideoEncodeFrameInfo {
 
         VkVideoEncodeH265PictureInfoKHR          pictureInfo;
-        VkVideoEncodeH265NaluSliceSegmentInfoKHR naluSliceSegmentInfo;
+        VkVideoEncodeH265NaluSliceSegmentInfoKHR naluSliceSegmentInfo[MAX_NUM_SLICES];
         StdVideoEncodeH265PictureInfo            stdPictureInfo;
         VkVideoEncodeH265RateControlInfoKHR      rateControlInfoH265;
-        VkVideoEncodeH265RateControlLayerInfoKHR rateControlLayersInfoH265[1];
+        VkVideoEncodeH265RateControlLayerInfoKHR rateControlLayersInfoH265[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
         StdVideoEncodeH265SliceSegmentHeader     stdSliceSegmentHeader;
+        StdVideoEncodeH265SliceSegmentHeader     stdIntraSliceSegmentHeader; // of the one the intra refresh codes
         StdVideoEncodeH265ReferenceListsInfo     stdReferenceListsInfo;
         StdVideoH265ShortTermRefPicSet           stdShortTermRefPicSet;
         StdVideoEncodeH265LongTermRefPics        stdLongTermRefPics;
@@ -44,11 +45,12 @@ class VkVideoEncoderH265 : public VkVideoEncoder {
         VkVideoEncodeFrameInfoH265()
           : VkVideoEncodeFrameInfo(&pictureInfo)
           , pictureInfo { VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_PICTURE_INFO_KHR }
-          , naluSliceSegmentInfo { VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_NALU_SLICE_SEGMENT_INFO_KHR }
+          , naluSliceSegmentInfo()
           , stdPictureInfo()
           , rateControlInfoH265{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_RATE_CONTROL_INFO_KHR }
           , rateControlLayersInfoH265{ VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_RATE_CONTROL_LAYER_INFO_KHR }
           , stdSliceSegmentHeader()
+          , stdIntraSliceSegmentHeader()
           , stdReferenceListsInfo()
           , stdShortTermRefPicSet()
           , stdLongTermRefPics()
@@ -56,9 +58,12 @@ class VkVideoEncoderH265 : public VkVideoEncoder {
           , stdDpbSlotInfo{}
         {
             pictureInfo.naluSliceSegmentEntryCount = 1;
-            pictureInfo.pNaluSliceSegmentEntries = &naluSliceSegmentInfo;
+            pictureInfo.pNaluSliceSegmentEntries = naluSliceSegmentInfo;
             pictureInfo.pStdPictureInfo = &stdPictureInfo;
-            naluSliceSegmentInfo.pStdSliceSegmentHeader = &stdSliceSegmentHeader;
+            for (uint32_t i = 0; i < MAX_NUM_SLICES; i++) {
+                naluSliceSegmentInfo[i].sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_NALU_SLICE_SEGMENT_INFO_KHR;
+                naluSliceSegmentInfo[i].pStdSliceSegmentHeader = &stdSliceSegmentHeader;
+            }
 
             stdPictureInfo.pRefLists           = &stdReferenceListsInfo;
             stdPictureInfo.pShortTermRefPicSet = &stdShortTermRefPicSet;
@@ -72,11 +77,12 @@ class VkVideoEncoderH265 : public VkVideoEncoder {
 
             // Clear and check state
             assert(pictureInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_PICTURE_INFO_KHR);
-            assert(naluSliceSegmentInfo.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_NALU_SLICE_SEGMENT_INFO_KHR);
+            assert(naluSliceSegmentInfo[0].sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_NALU_SLICE_SEGMENT_INFO_KHR);
             // stdPictureInfo()
             assert(rateControlInfoH265.sType == VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_RATE_CONTROL_INFO_KHR);
             assert(rateControlLayersInfoH265[0].sType ==  VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_RATE_CONTROL_LAYER_INFO_KHR);
             // stdSliceSegmentHeader()
+            // stdIntraSliceSegmentHeader()
             // stdReferenceListsInfo()
             // stdShortTermRefPicSet()
             // stdLongTermRefPics()
@@ -101,6 +107,9 @@ public:
         , m_vps{}
         , m_sps{}
         , m_pps{}
+        , m_splitFrameVps{}
+        , m_splitFrameSps{}
+        , m_splitFrameSessionParameters()
         , m_rateControlInfoH265{VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_RATE_CONTROL_INFO_KHR}
         , m_rateControlLayersInfoH265{VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_RATE_CONTROL_LAYER_INFO_KHR}
         , m_dpb{}
@@ -109,7 +118,11 @@ public:
 
     virtual VkResult InitEncoderCodec(VkSharedBaseObj<EncoderConfig>& encoderConfig);
     virtual VkResult InitRateControl(VkCommandBuffer cmdBuf, uint32_t qp);
+    virtual void UpdateRateControlParameters(int32_t minQp, int32_t maxQp);
+    virtual VkResult CreateVideoSessionParameters(uint32_t qualityLevel);
     virtual VkResult EncodeVideoSessionParameters(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo);
+    virtual bool AppendSplitFrameBandSlices(const uint8_t* data, size_t size, uint32_t bandIndex,
+                                            std::vector<uint8_t>& frameData);
     virtual VkResult ProcessDpb(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo,
                                 uint32_t frameIdx, uint32_t ofTotalFrames);
     virtual VkResult CreateFrameInfoBuffersQueue(uint32_t numPoolNodes);
@@ -135,6 +148,9 @@ protected:
 
 private:
 
+    VkResult CreateVideoSessionParameters(VpsH265& vps, SpsH265& sps, uint32_t qualityLevel,
+                                          VkSharedBaseObj<VulkanVideoSessionParameters>& videoSessionParameters);
+
     VkVideoEncodeFrameInfoH265* GetEncodeFrameInfoH265(VkSharedBaseObj<VkVideoEncodeFrameInfo>& encodeFrameInfo) {
         assert(VK_STRUCTURE_TYPE_VIDEO_ENCODE_H265_PICTURE_INFO_KHR == encodeFrameInfo->GetType());
         VkVideoEncodeFrameInfo* pEncodeFrameInfo = encodeFrameInfo;
@@ -149,8 +165,11 @@ private:
     VpsH265                                    m_vps;
     SpsH265                                    m_sps;
     StdVideoH265PictureParameterSet            m_pps;
+    VpsH265                                    m_splitFrameVps; // of the whole picture, on the main split frame encoder
+    SpsH265                                    m_splitFrameSps;
+    VkSharedBaseObj<VulkanVideoSessionParameters> m_splitFrameSessionParameters;
     VkVideoEncodeH265RateControlInfoKHR        m_rateControlInfoH265;
-    VkVideoEncodeH265RateControlLayerInfoKHR   m_rateControlLayersInfoH265[1];
+    VkVideoEncodeH265RateControlLayerInfoKHR   m_rateControlLayersInfoH265[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
     VkEncDpbH265                               m_dpb;
     uint32_t                                   m_maxDpbSlots;
     VkSharedBaseObj<VulkanBufferPool<VkVideoEncodeFrameInfoH265>> m_frameInfoBuffersQueue;
@@ -0,0 +1,484 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+#include "VkVideoEncoderPreAnalysis.h"
+
+// The luma is downscaled by 4 in each direction, the costs are per block of 4x4 downscaled samples
+static const uint32_t lowResScale = 4;
+static const uint32_t lowResBlockSize = 4;
+static const uint32_t workgroupSize = 8;
+
+// With the customary qcomp of 0.6, the qscale follows the complexity to the power of 0.4
+static const double complexityQpScale = 6.0 * 0.4;
+// The QP reduction of an intra and a P frame followed by a fully static window
+static const double intraPropagationQpScale = 4.0;
+static const double interPPropagationQpScale = 2.0;
+
+// The inter to intra cost ratio of a cut, and its increase over the previous frame
+static const double sceneCutInterRatio = 0.7;
+static const double sceneCutInterIncrease = 3.0;
+// The inter to intra cost ratios the B-frame runs are the longest at and stop at
+static const double staticInterRatio = 0.1;
+static const double highMotionInterRatio = 0.6;
+
+VkResult VkVideoEncoderPreAnalysis::Create(const VulkanDeviceContext* vkDevCtx,
+                                           VkFormat inputFormat,
+                                           const VkExtent2D& inputExtent,
+                                           uint32_t numSlots,
+                                           VkSharedBaseObj<VkVideoEncoderPreAnalysis>& preAnalysis)
+{
+    // The descriptors are pushed with the command buffer of each frame
+    if (!vkDevCtx->FindRequiredDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) ||
+            (vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VkSharedBaseObj<VkVideoEncoderPreAnalysis> analysis(new VkVideoEncoderPreAnalysis(vkDevCtx, inputFormat, inputExtent));
+    if (!analysis) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = analysis->Init(numSlots);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    preAnalysis = analysis;
+    return VK_SUCCESS;
+}
+
+VkVideoEncoderPreAnalysis::VkVideoEncoderPreAnalysis(const VulkanDeviceContext* vkDevCtx, VkFormat inputFormat,
+                                                     const VkExtent2D& inputExtent)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_inputFormat(inputFormat)
+    , m_inputExtent(inputExtent)
+    , m_lowResExtent{ (inputExtent.width + lowResScale - 1) / lowResScale, (inputExtent.height + lowResScale - 1) / lowResScale }
+    , m_vulkanShaderCompiler()
+    , m_descriptorSetLayout()
+    , m_computePipeline()
+    , m_lowResFrames()
+    , m_frameStats()
+    , m_numAnalyzedFrames(0)
+{
+}
+
+VkResult VkVideoEncoderPreAnalysis::Init(uint32_t numSlots)
+{
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        //                        binding,  descriptorType,          descriptorCount, stageFlags, pImmutableSamplers;
+        // Binding 0: Input image (read-only) Y plane
+        VkDescriptorSetLayoutBinding{ 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 1: Downscaled luma of the current frame (write)
+        VkDescriptorSetLayoutBinding{ 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 2: Downscaled luma of the previous frame (read-only)
+        VkDescriptorSetLayoutBinding{ 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 3: Frame costs (read-write)
+        VkDescriptorSetLayoutBinding{ 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // The source image layer, the input and downscaled extents and whether there is a previous frame
+    pushConstantRange.size = 6 * sizeof(uint32_t);
+
+    VkResult result = m_descriptorSetLayout.CreateDescriptorSet(m_vkDevCtx,
+                                                                setLayoutBindings,
+                                                                VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                                1, &pushConstantRange,
+                                                                nullptr,
+                                                                1,
+                                                                false);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::string computeShader;
+    const size_t computeShaderSize = InitShader(computeShader);
+    result = m_computePipeline.CreatePipeline(m_vkDevCtx, m_vulkanShaderCompiler,
+                                              computeShader.c_str(), computeShaderSize,
+                                              "main",
+                                              workgroupSize, workgroupSize,
+                                              &m_descriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_FILTER);
+    const VkDeviceSize lowResFrameSize = (VkDeviceSize)m_lowResExtent.width * m_lowResExtent.height * sizeof(float);
+    for (VkSharedBaseObj<VkBufferResource>& lowResFrame : m_lowResFrames) {
+        result = VkBufferResource::Create(m_vkDevCtx,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                          lowResFrameSize,
+                                          lowResFrame);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    m_frameStats.resize(numSlots);
+    for (VkSharedBaseObj<VkBufferResource>& frameStats : m_frameStats) {
+        result = VkBufferResource::Create(m_vkDevCtx,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          2 * sizeof(uint32_t),
+                                          frameStats);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+size_t VkVideoEncoderPreAnalysis::InitShader(std::string& computeShader) const
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_inputFormat);
+    const bool is16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != 0);
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
+                        "    uint lowResWidth;\n"
+                        "    uint lowResHeight;\n"
+                        "    uint hasPrevious;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << workgroupSize << ", local_size_y = " << workgroupSize << ") in;\n"
+                        "layout (set = 0, binding = 0, " << (is16BitSample ? "r16" : "r8") <<
+                                ") uniform readonly image2DArray inImageY;\n"
+                        "layout (set = 0, binding = 1) writeonly buffer CurrentLowRes {\n"
+                        "    float currentLowRes[];\n"
+                        "};\n"
+                        "layout (set = 0, binding = 2) readonly buffer PreviousLowRes {\n"
+                        "    float previousLowRes[];\n"
+                        "};\n"
+                        "layout (set = 0, binding = 3) buffer FrameStats {\n"
+                        "    uint intraCost;\n"
+                        "    uint interCost;\n"
+                        "} frameStats;\n"
+                        "\n"
+                        "const int scale = " << lowResScale << ";\n"
+                        "const int blockSize = " << lowResBlockSize << ";\n"
+                        "const int searchRange = 2;\n"
+                        "\n"
+                        "float fetchPrevious(ivec2 pos) {\n"
+                        "    pos = clamp(pos, ivec2(0), ivec2(pushConstants.lowResWidth - 1, pushConstants.lowResHeight - 1));\n"
+                        "    return previousLowRes[pos.y * pushConstants.lowResWidth + pos.x];\n"
+                        "}\n"
+                        "\n"
+                        "void main()\n"
+                        "{\n"
+                        "    ivec2 blockPos = ivec2(gl_GlobalInvocationID.xy) * blockSize;\n"
+                        "    ivec2 lowResExtent = ivec2(pushConstants.lowResWidth, pushConstants.lowResHeight);\n"
+                        "    if ((blockPos.x >= lowResExtent.x) || (blockPos.y >= lowResExtent.y)) {\n"
+                        "        return;\n"
+                        "    }\n"
+                        "\n"
+                        "    // Downscale the block, on the 8-bit scale\n"
+                        "    ivec2 maxPos = ivec2(pushConstants.width - 1, pushConstants.height - 1);\n"
+                        "    float block[blockSize * blockSize];\n"
+                        "    float sum = 0.0;\n"
+                        "    for (int y = 0; y < blockSize; y++) {\n"
+                        "        for (int x = 0; x < blockSize; x++) {\n"
+                        "            ivec2 lowResPos = blockPos + ivec2(x, y);\n"
+                        "            float value = 0.0;\n"
+                        "            for (int dy = 0; dy < scale; dy++) {\n"
+                        "                for (int dx = 0; dx < scale; dx++) {\n"
+                        "                    ivec2 pos = min(lowResPos * scale + ivec2(dx, dy), maxPos);\n"
+                        "                    value += imageLoad(inImageY, ivec3(pos, pushConstants.srcImageLayer)).r;\n"
+                        "                }\n"
+                        "            }\n"
+                        "            value *= 255.0 / float(scale * scale);\n"
+                        "            block[y * blockSize + x] = value;\n"
+                        "            sum += value;\n"
+                        "            if ((lowResPos.x < lowResExtent.x) && (lowResPos.y < lowResExtent.y)) {\n"
+                        "                currentLowRes[lowResPos.y * lowResExtent.x + lowResPos.x] = value;\n"
+                        "            }\n"
+                        "        }\n"
+                        "    }\n"
+                        "\n"
+                        "    float mean = sum / float(blockSize * blockSize);\n"
+                        "    float intraCost = 0.0;\n"
+                        "    for (int i = 0; i < blockSize * blockSize; i++) {\n"
+                        "        intraCost += abs(block[i] - mean);\n"
+                        "    }\n"
+                        "\n"
+                        "    // A block cheaper to code as intra is counted as such\n"
+                        "    float interCost = intraCost;\n"
+                        "    if (pushConstants.hasPrevious != 0) {\n"
+                        "        for (int my = -searchRange; my <= searchRange; my++) {\n"
+                        "            for (int mx = -searchRange; mx <= searchRange; mx++) {\n"
+                        "                float sad = 0.0;\n"
+                        "                for (int y = 0; y < blockSize; y++) {\n"
+                        "                    for (int x = 0; x < blockSize; x++) {\n"
+                        "                        sad += abs(block[y * blockSize + x] - fetchPrevious(blockPos + ivec2(x + mx, y + my)));\n"
+                        "                    }\n"
+                        "                }\n"
+                        "                interCost = min(interCost, sad);\n"
+                        "            }\n"
+                        "        }\n"
+                        "    }\n"
+                        "\n"
+                        "    atomicAdd(frameStats.intraCost, uint(intraCost + 0.5));\n"
+                        "    atomicAdd(frameStats.interCost, uint(interCost + 0.5));\n"
+                        "}\n";
+
+    computeShader = shaderStr.str();
+    return computeShader.size();
+}
+
+VkResult VkVideoEncoderPreAnalysis::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                        uint32_t slot,
+                                                        const VkImageResourceView* inputImageView,
+                                                        uint32_t inputImageLayer,
+                                                        VkImageLayout imageLayout)
+{
+    assert(slot < m_frameStats.size());
+    assert(inputImageView != nullptr);
+
+    const VkBufferResource* currentLowRes = m_lowResFrames[m_numAnalyzedFrames % 2];
+    const VkBufferResource* previousLowRes = m_lowResFrames[(m_numAnalyzedFrames + 1) % 2];
+    const VkBufferResource* frameStats = m_frameStats[slot];
+
+    // The host has read the previous costs of the slot before its command buffer was reused
+    m_vkDevCtx->CmdFillBuffer(cmdBuf, frameStats->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+    // The downscaled frames of the previous submissions and the cleared costs, then the input image being written
+    VkMemoryBarrier2KHR memoryBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR, // srcStageMask
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,  // srcAccessMask
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // dstStageMask
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR, // dstAccessMask
+    };
+
+    VkImageMemoryBarrier2KHR imageBarrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, // VkPipelineStageFlags2KHR srcStageMask
+            VK_ACCESS_2_MEMORY_WRITE_BIT_KHR, // VkAccessFlags2KHR        srcAccessMask
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR, // VkAccessFlags   dstAccessMask
+            imageLayout, // VkImageLayout   oldLayout
+            VK_IMAGE_LAYOUT_GENERAL, // VkImageLayout   newLayout
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+            inputImageView->GetImageResource()->GetImage(), // VkImage         image;
+            {
+                // VkImageSubresourceRange   subresourceRange
+                VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                0, // uint32_t           baseMipLevel
+                1, // uint32_t           levelCount
+                inputImageLayer, // uint32_t           baseArrayLayer
+                1, // uint32_t           layerCount;
+            },
+    };
+
+    VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        1,
+        &memoryBarrier,
+        0,
+        nullptr,
+        1,
+        &imageBarrier,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 4;
+    VkDescriptorImageInfo imageDescriptor{};
+    VkDescriptorBufferInfo bufferDescriptors[3]{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    imageDescriptor.sampler = VK_NULL_HANDLE;
+    imageDescriptor.imageView = inputImageView->GetPlaneImageView(0);
+    assert(imageDescriptor.imageView);
+    imageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[0].dstBinding = 0;
+    writeDescriptorSets[0].descriptorCount = 1;
+    writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSets[0].pImageInfo = &imageDescriptor;
+
+    const VkBufferResource* buffers[3] = { currentLowRes, previousLowRes, frameStats };
+    for (uint32_t bufferNum = 0; bufferNum < 3; bufferNum++) {
+        bufferDescriptors[bufferNum].buffer = buffers[bufferNum]->GetBuffer();
+        bufferDescriptors[bufferNum].offset = 0;
+        bufferDescriptors[bufferNum].range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[1 + bufferNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = 1 + bufferNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet.pBufferInfo = &bufferDescriptors[bufferNum];
+    }
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t width;
+        uint32_t height;
+        uint32_t lowResWidth;
+        uint32_t lowResHeight;
+        uint32_t hasPrevious;
+    };
+
+    const PushConstants pushConstants = {
+            inputImageLayer,
+            m_inputExtent.width,
+            m_inputExtent.height,
+            m_lowResExtent.width,
+            m_lowResExtent.height,
+            (m_numAnalyzedFrames > 0) ? 1u : 0u
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    const uint32_t blocksX = (m_lowResExtent.width  + lowResBlockSize - 1) / lowResBlockSize;
+    const uint32_t blocksY = (m_lowResExtent.height + lowResBlockSize - 1) / lowResBlockSize;
+    m_vkDevCtx->CmdDispatch(cmdBuf, (blocksX + workgroupSize - 1) / workgroupSize,
+                            (blocksY + workgroupSize - 1) / workgroupSize, 1);
+
+    // The costs are read by the host once the command buffer's fence is signaled.
+    // The encode submission waits on the input semaphore, which covers the image reads.
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.newLayout = imageLayout;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_numAnalyzedFrames++;
+    return VK_SUCCESS;
+}
+
+void VkVideoEncoderPreAnalysis::GetFrameComplexity(uint32_t slot, FrameComplexity& frameComplexity) const
+{
+    assert(slot < m_frameStats.size());
+
+    VkDeviceSize maxSize = 0;
+    const uint32_t* pFrameStats = (const uint32_t*)m_frameStats[slot]->GetReadOnlyDataPtr(0, maxSize);
+    assert((pFrameStats != nullptr) && (maxSize >= 2 * sizeof(uint32_t)));
+
+    const uint32_t blocksX = (m_lowResExtent.width  + lowResBlockSize - 1) / lowResBlockSize;
+    const uint32_t blocksY = (m_lowResExtent.height + lowResBlockSize - 1) / lowResBlockSize;
+    const uint32_t numBlocks = std::max<uint32_t>(blocksX * blocksY, 1);
+    frameComplexity.intraCost = pFrameStats[0] / numBlocks;
+    frameComplexity.interCost = pFrameStats[1] / numBlocks;
+}
+
+VkVideoEncoderPreAnalysis::QpDeltas VkVideoEncoderPreAnalysis::GetQpDeltas(const FrameComplexity* pWindow,
+                                                                           uint32_t numFrames)
+{
+    QpDeltas qpDeltas = { 0, 0, 0 };
+    if ((pWindow == nullptr) || (numFrames == 0)) {
+        return qpDeltas;
+    }
+
+    double averageIntraCost = 0.0;
+    double averageInterCost = 0.0;
+    for (uint32_t i = 0; i < numFrames; i++) {
+        averageIntraCost += std::max<uint32_t>(pWindow[i].intraCost, 1);
+        averageInterCost += std::max<uint32_t>(pWindow[i].interCost, 1);
+    }
+    averageIntraCost /= numFrames;
+    averageInterCost /= numFrames;
+
+    // The frames more complex than the rest of the window hide more of the distortion,
+    // some of their bits are moved to the simpler ones
+    const double intraDelta = complexityQpScale * log2(std::max<uint32_t>(pWindow[0].intraCost, 1) / averageIntraCost);
+    const double interDelta = complexityQpScale * log2(std::max<uint32_t>(pWindow[0].interCost, 1) / averageInterCost);
+
+    // The more static the frames following a reference are, the more of its quality propagates to them
+    double propagation = 0.0;
+    if (numFrames > 1) {
+        double followingInterCost = 0.0;
+        for (uint32_t i = 1; i < numFrames; i++) {
+            followingInterCost += std::max<uint32_t>(pWindow[i].interCost, 1);
+        }
+        followingInterCost /= (numFrames - 1);
+        propagation = 1.0 - std::min(followingInterCost / std::max<uint32_t>(pWindow[0].intraCost, 1), 1.0);
+    }
+
+    const int32_t maxQpDelta = MAX_QP_DELTA;
+    qpDeltas.intra  = std::min(std::max((int32_t)lround(intraDelta - intraPropagationQpScale * propagation), -maxQpDelta),
+                               maxQpDelta);
+    qpDeltas.interP = std::min(std::max((int32_t)lround(interDelta - interPPropagationQpScale * propagation), -maxQpDelta),
+                               maxQpDelta);
+    qpDeltas.interB = std::min(std::max((int32_t)lround(interDelta), -maxQpDelta), maxQpDelta);
+    return qpDeltas;
+}
+
+bool VkVideoEncoderPreAnalysis::IsSceneCut(const FrameComplexity& previousFrame, const FrameComplexity& frame)
+{
+    // A sustained high motion has a high inter cost over consecutive frames
+    const double interCost = frame.interCost;
+    return (interCost >= sceneCutInterRatio * std::max<uint32_t>(frame.intraCost, 1)) &&
+           (interCost > sceneCutInterIncrease * std::max<uint32_t>(previousFrame.interCost, 1));
+}
+
+uint32_t VkVideoEncoderPreAnalysis::GetBFrameCount(const FrameComplexity* pWindow, uint32_t numFrames,
+                                                   uint32_t maxBFrameCount)
+{
+    if ((pWindow == nullptr) || (numFrames == 0)) {
+        return maxBFrameCount;
+    }
+
+    double intraCost = 0.0;
+    double interCost = 0.0;
+    for (uint32_t i = 0; i < numFrames; i++) {
+        intraCost += std::max<uint32_t>(pWindow[i].intraCost, 1);
+        interCost += pWindow[i].interCost;
+    }
+
+    // The B-frames predict well from references further apart on static content only
+    const double interRatio = interCost / intraCost;
+    const double staticWeight = std::min(std::max((highMotionInterRatio - interRatio) /
+                                                  (highMotionInterRatio - staticInterRatio), 0.0), 1.0);
+    return (uint32_t)lround(staticWeight * maxBFrameCount);
+}
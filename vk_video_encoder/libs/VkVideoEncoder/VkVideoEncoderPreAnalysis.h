@@ -0,0 +1,117 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERPREANALYSIS_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERPREANALYSIS_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanShaderCompiler.h"
+#include "VkCodecUtils/VulkanDescriptorSetLayout.h"
+#include "VkCodecUtils/VulkanComputePipeline.h"
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VkImageResource.h"
+
+// Estimates the coding complexity of the input frames with a compute shader, ahead of their encoding.
+// The luma is downscaled 4x and kept for the next frame. Per 16x16 luma block, the intra cost is the absolute
+// deviation of the downscaled block from its mean and the inter cost is the lowest SAD against the previous
+// downscaled frame, over a +-8 luma sample search. The costs are summed per frame, into a host visible buffer
+// per slot. The frames must be recorded in input order, into command buffers executing on a single queue.
+class VkVideoEncoderPreAnalysis : public VkVideoRefCountBase
+{
+public:
+    enum { MAX_QP_DELTA = 6, MIN_SCENE_CUT_DISTANCE = 8 };
+
+    // Average costs per 16x16 block
+    struct FrameComplexity {
+        uint32_t intraCost;
+        uint32_t interCost;
+    };
+
+    struct QpDeltas {
+        int32_t intra;
+        int32_t interP;
+        int32_t interB;
+    };
+
+    // The input format is the 2-plane format of the encoder input images, which need the storage usage.
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkFormat inputFormat,
+                           const VkExtent2D& inputExtent,
+                           uint32_t numSlots,
+                           VkSharedBaseObj<VkVideoEncoderPreAnalysis>& preAnalysis);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the pre-analysis if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Records the analysis after the commands writing the input image, which is left in imageLayout.
+    // The command buffer must be submitted to a compute queue.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 uint32_t slot,
+                                 const VkImageResourceView* inputImageView,
+                                 uint32_t inputImageLayer,
+                                 VkImageLayout imageLayout);
+
+    // The command buffer the slot was recorded into must have completed.
+    void GetFrameComplexity(uint32_t slot, FrameComplexity& frameComplexity) const;
+
+    // The QP offsets of the first frame of a look-ahead window, from the complexities of the frames in it.
+    static QpDeltas GetQpDeltas(const FrameComplexity* pWindow, uint32_t numFrames);
+
+    // A frame the motion search finds little of the previous one in, while the previous frame was predicted well.
+    static bool IsSceneCut(const FrameComplexity& previousFrame, const FrameComplexity& frame);
+
+    // The B-frame run length, up to maxBFrameCount, for the motion of the frames in the window.
+    static uint32_t GetBFrameCount(const FrameComplexity* pWindow, uint32_t numFrames, uint32_t maxBFrameCount);
+
+private:
+    VkVideoEncoderPreAnalysis(const VulkanDeviceContext* vkDevCtx, VkFormat inputFormat, const VkExtent2D& inputExtent);
+
+    virtual ~VkVideoEncoderPreAnalysis() {}
+
+    VkResult Init(uint32_t numSlots);
+    size_t InitShader(std::string& computeShader) const;
+
+private:
+    std::atomic<int32_t>                           m_refCount;
+    const VulkanDeviceContext*                     m_vkDevCtx;
+    const VkFormat                                 m_inputFormat;
+    const VkExtent2D                               m_inputExtent;
+    const VkExtent2D                               m_lowResExtent;
+    VulkanShaderCompiler                           m_vulkanShaderCompiler;
+    VulkanDescriptorSetLayout                      m_descriptorSetLayout;
+    VulkanComputePipeline                          m_computePipeline;
+    VkSharedBaseObj<VkBufferResource>              m_lowResFrames[2]; // alternating, the current and the previous one
+    std::vector<VkSharedBaseObj<VkBufferResource>> m_frameStats;      // per slot
+    uint64_t                                       m_numAnalyzedFrames;
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERPREANALYSIS_H_ */
@@ -0,0 +1,390 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include "VkVideoEncoderSplitFrameH265.h"
+
+namespace {
+
+// The nal_unit_type values of the slice segments
+enum NalUnitTypeH265 {
+    NUT_BLA_W_LP = 16,
+    NUT_IDR_W_RADL = 19,
+    NUT_IDR_N_LP = 20,
+    NUT_RSV_IRAP_VCL23 = 23,
+    NUT_RSV_VCL31 = 31,
+};
+
+// Reads the fields of an RBSP, the emulation prevention bytes removed
+class RbspReader
+{
+public:
+    explicit RbspReader(const std::vector<uint8_t>& rbsp)
+        : m_rbsp(rbsp), m_bitPos(0), m_overrun(false) {}
+
+    uint32_t U(uint32_t numBits) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < numBits; i++) {
+            value = (value << 1) | Bit();
+        }
+        return value;
+    }
+
+    uint32_t Ue() {
+        uint32_t leadingZeroBits = 0;
+        while ((Bit() == 0) && !m_overrun) {
+            if (++leadingZeroBits > 31) {
+                m_overrun = true;
+                return 0;
+            }
+        }
+        return ((1U << leadingZeroBits) - 1) + U(leadingZeroBits);
+    }
+
+    int32_t Se() {
+        const uint32_t codeNum = Ue();
+        return (codeNum & 1) ? (int32_t)((codeNum + 1) / 2) : -(int32_t)(codeNum / 2);
+    }
+
+    void Skip(size_t numBits) {
+        m_bitPos += numBits;
+        m_overrun = m_overrun || (m_bitPos > (m_rbsp.size() * 8));
+    }
+
+    size_t GetBitPos() const { return m_bitPos; }
+    bool IsOverrun() const { return m_overrun; }
+
+private:
+    uint32_t Bit() {
+        if (m_bitPos >= (m_rbsp.size() * 8)) {
+            m_overrun = true;
+            return 0;
+        }
+        const uint32_t bit = (m_rbsp[m_bitPos >> 3] >> (7 - (m_bitPos & 7))) & 1;
+        m_bitPos++;
+        return bit;
+    }
+
+    const std::vector<uint8_t>& m_rbsp;
+    size_t                      m_bitPos;
+    bool                        m_overrun;
+};
+
+// Writes the fields of an RBSP
+class RbspWriter
+{
+public:
+    RbspWriter() : m_rbsp(), m_numBits(0) {}
+
+    void U(uint32_t value, uint32_t numBits) {
+        for (uint32_t i = numBits; i > 0; i--) {
+            Bit((value >> (i - 1)) & 1);
+        }
+    }
+
+    // The bits [startBit, endBit) of the source RBSP
+    void CopyBits(const std::vector<uint8_t>& rbsp, size_t startBit, size_t endBit) {
+        for (size_t pos = startBit; pos < endBit; pos++) {
+            Bit((rbsp[pos >> 3] >> (7 - (pos & 7))) & 1);
+        }
+    }
+
+    // byte_alignment(): a one, then zeros to the end of the byte
+    void ByteAlign() {
+        Bit(1);
+        while ((m_numBits & 7) != 0) {
+            Bit(0);
+        }
+    }
+
+    // After ByteAlign()
+    void AppendBytes(const uint8_t* data, size_t size) {
+        m_rbsp.insert(m_rbsp.end(), data, data + size);
+        m_numBits += size * 8;
+    }
+
+    const std::vector<uint8_t>& GetRbsp() const { return m_rbsp; }
+
+private:
+    void Bit(uint32_t bit) {
+        if ((m_numBits & 7) == 0) {
+            m_rbsp.push_back(0);
+        }
+        m_rbsp.back() |= (uint8_t)(bit << (7 - (m_numBits & 7)));
+        m_numBits++;
+    }
+
+    std::vector<uint8_t> m_rbsp;
+    size_t               m_numBits;
+};
+
+uint32_t CeilLog2(uint32_t value)
+{
+    uint32_t log2 = 0;
+    while ((1U << log2) < value) {
+        log2++;
+    }
+    return log2;
+}
+
+void RemoveEmulationPrevention(const uint8_t* data, size_t size, std::vector<uint8_t>& rbsp)
+{
+    rbsp.clear();
+    rbsp.reserve(size);
+    uint32_t numZeros = 0;
+    for (size_t i = 0; i < size; i++) {
+        if ((numZeros >= 2) && (data[i] == 0x03)) {
+            numZeros = 0;
+            continue;
+        }
+        numZeros = (data[i] == 0) ? (numZeros + 1) : 0;
+        rbsp.push_back(data[i]);
+    }
+}
+
+void AppendWithEmulationPrevention(const std::vector<uint8_t>& rbsp, std::vector<uint8_t>& nalData)
+{
+    uint32_t numZeros = 0;
+    for (const uint8_t byte : rbsp) {
+        if ((numZeros >= 2) && (byte <= 0x03)) {
+            nalData.push_back(0x03);
+            numZeros = 0;
+        }
+        nalData.push_back(byte);
+        numZeros = (byte == 0) ? (numZeros + 1) : 0;
+    }
+    if (numZeros > 0) {
+        // A NAL unit doesn't end with a zero byte
+        nalData.push_back(0x03);
+    }
+}
+
+// st_ref_pic_set(num_short_term_ref_pic_sets) of the slice segment header
+bool SkipShortTermRefPicSet(RbspReader& reader, const StdVideoH265SequenceParameterSet& sps)
+{
+    const uint32_t stRpsIdx = sps.num_short_term_ref_pic_sets;
+    const bool interRefPicSetPrediction = (stRpsIdx != 0) && (reader.U(1) != 0);
+    if (interRefPicSetPrediction) {
+        const uint32_t deltaIdxMinus1 = reader.Ue();
+        reader.U(1);  // delta_rps_sign
+        reader.Ue();  // abs_delta_rps_minus1
+        if ((deltaIdxMinus1 + 1) > stRpsIdx) {
+            return false;
+        }
+        const StdVideoH265ShortTermRefPicSet& refRps = sps.pShortTermRefPicSet[stRpsIdx - (deltaIdxMinus1 + 1)];
+        const uint32_t numDeltaPocs = refRps.num_negative_pics + refRps.num_positive_pics;
+        for (uint32_t j = 0; j <= numDeltaPocs; j++) {
+            if (reader.U(1) == 0) { // used_by_curr_pic_flag
+                reader.U(1);        // use_delta_flag
+            }
+        }
+        return !reader.IsOverrun();
+    }
+
+    const uint32_t numNegativePics = reader.Ue();
+    const uint32_t numPositivePics = reader.Ue();
+    if ((numNegativePics > STD_VIDEO_H265_MAX_DPB_SIZE) || (numPositivePics > STD_VIDEO_H265_MAX_DPB_SIZE)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < (numNegativePics + numPositivePics); i++) {
+        reader.Ue();  // delta_poc_s0/s1_minus1
+        reader.U(1);  // used_by_curr_pic_s0/s1_flag
+    }
+    return !reader.IsOverrun();
+}
+
+// Writes the slice segment NAL unit with its address in the whole picture, without the start code
+bool RewriteSliceSegment(const SpsH265& sps, const StdVideoH265PictureParameterSet& pps,
+                         uint32_t bandSizeInCtbs, uint32_t bandStartCtb, uint32_t picSizeInCtbs,
+                         const uint8_t* nalData, size_t nalSize, std::vector<uint8_t>& frameData)
+{
+    if (nalSize < 3) {
+        return false;
+    }
+    const uint32_t nalUnitType = (nalData[0] >> 1) & 0x3f;
+
+    std::vector<uint8_t> rbsp;
+    RemoveEmulationPrevention(nalData + 2, nalSize - 2, rbsp);
+    RbspReader reader(rbsp);
+
+    const bool firstSliceSegmentInPic = (reader.U(1) != 0);
+    if ((nalUnitType >= NUT_BLA_W_LP) && (nalUnitType <= NUT_RSV_IRAP_VCL23)) {
+        reader.U(1);  // no_output_of_prior_pics_flag
+    }
+    reader.Ue();      // slice_pic_parameter_set_id
+    const size_t addressStartBit = reader.GetBitPos();
+
+    bool dependentSliceSegment = false;
+    uint32_t sliceSegmentAddress = 0;
+    if (!firstSliceSegmentInPic) {
+        if (pps.flags.dependent_slice_segments_enabled_flag) {
+            dependentSliceSegment = (reader.U(1) != 0);
+        }
+        sliceSegmentAddress = reader.U(CeilLog2(bandSizeInCtbs));
+    }
+    const size_t addressEndBit = reader.GetBitPos();
+
+    if (!dependentSliceSegment) {
+        reader.U(pps.num_extra_slice_header_bits);  // slice_reserved_flag
+        const uint32_t sliceType = reader.Ue();
+        if (sliceType != STD_VIDEO_H265_SLICE_TYPE_I) {
+            // The bands are intra only, the P and B slices would reference the pictures of the band
+            return false;
+        }
+        if (pps.flags.output_flag_present_flag) {
+            reader.U(1);  // pic_output_flag
+        }
+        if ((nalUnitType != NUT_IDR_W_RADL) && (nalUnitType != NUT_IDR_N_LP)) {
+            reader.U(sps.sps.log2_max_pic_order_cnt_lsb_minus4 + 4);  // slice_pic_order_cnt_lsb
+            const bool shortTermRefPicSetSps = (reader.U(1) != 0);
+            if (!shortTermRefPicSetSps) {
+                if (!SkipShortTermRefPicSet(reader, sps.sps)) {
+                    return false;
+                }
+            } else if (sps.sps.num_short_term_ref_pic_sets > 1) {
+                reader.U(CeilLog2(sps.sps.num_short_term_ref_pic_sets));  // short_term_ref_pic_set_idx
+            }
+            if (sps.sps.flags.long_term_ref_pics_present_flag) {
+                // Not used by the encoder
+                return false;
+            }
+            if (sps.sps.flags.sps_temporal_mvp_enabled_flag) {
+                reader.U(1);  // slice_temporal_mvp_enabled_flag
+            }
+        }
+        bool sliceSao = false;
+        if (sps.sps.flags.sample_adaptive_offset_enabled_flag) {
+            sliceSao = (reader.U(1) != 0);  // slice_sao_luma_flag
+            if (sps.sps.chroma_format_idc != STD_VIDEO_H265_CHROMA_FORMAT_IDC_MONOCHROME) {
+                sliceSao = (reader.U(1) != 0) || sliceSao;  // slice_sao_chroma_flag
+            }
+        }
+        reader.Se();  // slice_qp_delta
+        if (pps.flags.pps_slice_chroma_qp_offsets_present_flag) {
+            reader.Se();  // slice_cb_qp_offset
+            reader.Se();  // slice_cr_qp_offset
+        }
+        if (pps.flags.pps_slice_act_qp_offsets_present_flag) {
+            reader.Se();  // slice_act_y_qp_offset
+            reader.Se();  // slice_act_cb_qp_offset
+            reader.Se();  // slice_act_cr_qp_offset
+        }
+        if (pps.flags.chroma_qp_offset_list_enabled_flag) {
+            reader.U(1);  // cu_chroma_qp_offset_enabled_flag
+        }
+        bool deblockingFilterOverride = false;
+        bool sliceDeblockingFilterDisabled = pps.flags.pps_deblocking_filter_disabled_flag;
+        if (pps.flags.deblocking_filter_override_enabled_flag) {
+            deblockingFilterOverride = (reader.U(1) != 0);
+        }
+        if (deblockingFilterOverride) {
+            sliceDeblockingFilterDisabled = (reader.U(1) != 0);
+            if (!sliceDeblockingFilterDisabled) {
+                reader.Se();  // slice_beta_offset_div2
+                reader.Se();  // slice_tc_offset_div2
+            }
+        }
+        if (pps.flags.pps_loop_filter_across_slices_enabled_flag && (sliceSao || !sliceDeblockingFilterDisabled)) {
+            reader.U(1);  // slice_loop_filter_across_slices_enabled_flag
+        }
+    }
+    if (pps.flags.tiles_enabled_flag || pps.flags.entropy_coding_sync_enabled_flag) {
+        const uint32_t numEntryPointOffsets = reader.Ue();
+        if (numEntryPointOffsets > 0) {
+            const uint32_t offsetLenMinus1 = reader.Ue();
+            if (offsetLenMinus1 > 31) {
+                return false;
+            }
+            reader.Skip((size_t)numEntryPointOffsets * (offsetLenMinus1 + 1));
+        }
+    }
+    if (pps.flags.slice_segment_header_extension_present_flag) {
+        const uint32_t sliceSegmentHeaderExtensionLength = reader.Ue();
+        reader.Skip((size_t)sliceSegmentHeaderExtensionLength * 8);
+    }
+    const size_t headerEndBit = reader.GetBitPos();
+    if (reader.IsOverrun() || (reader.U(1) != 1)) {  // alignment_bit_equal_to_one
+        return false;
+    }
+    const size_t sliceDataStartByte = (headerEndBit + 8) / 8;
+    if (sliceDataStartByte > rbsp.size()) {
+        return false;
+    }
+
+    const uint32_t address = bandStartCtb + sliceSegmentAddress;
+    RbspWriter writer;
+    writer.U((address == 0) ? 1 : 0, 1);          // first_slice_segment_in_pic_flag
+    writer.CopyBits(rbsp, 1, addressStartBit);    // no_output_of_prior_pics_flag, slice_pic_parameter_set_id
+    if (address != 0) {
+        if (pps.flags.dependent_slice_segments_enabled_flag) {
+            writer.U(dependentSliceSegment ? 1 : 0, 1);
+        }
+        writer.U(address, CeilLog2(picSizeInCtbs));
+    }
+    writer.CopyBits(rbsp, addressEndBit, headerEndBit);
+    writer.ByteAlign();
+    writer.AppendBytes(rbsp.data() + sliceDataStartByte, rbsp.size() - sliceDataStartByte);
+
+    static const uint8_t startCode[] = { 0x00, 0x00, 0x00, 0x01 };
+    frameData.insert(frameData.end(), startCode, startCode + sizeof(startCode));
+    frameData.insert(frameData.end(), nalData, nalData + 2);
+    AppendWithEmulationPrevention(writer.GetRbsp(), frameData);
+    return true;
+}
+
+} // namespace
+
+bool VkVideoEncoderSplitFrameH265::AppendBandSlices(const SpsH265& sps, const StdVideoH265PictureParameterSet& pps,
+                                                    uint32_t bandSizeInCtbs, uint32_t bandStartCtb, uint32_t picSizeInCtbs,
+                                                    const uint8_t* data, size_t size, std::vector<uint8_t>& frameData)
+{
+    // The start of each NAL unit, after its start code
+    std::vector<size_t> nalStarts;
+    for (size_t i = 0; (i + 2) < size; i++) {
+        if ((data[i] == 0) && (data[i + 1] == 0) && (data[i + 2] == 1)) {
+            nalStarts.push_back(i + 3);
+            i += 2;
+        }
+    }
+
+    uint32_t numSlices = 0;
+    for (size_t nal = 0; nal < nalStarts.size(); nal++) {
+        const size_t nalStart = nalStarts[nal];
+        size_t nalEnd = ((nal + 1) < nalStarts.size()) ? (nalStarts[nal + 1] - 3) : size;
+        // The zero_byte of the next start code and the trailing_zero_8bits
+        while ((nalEnd > nalStart) && (data[nalEnd - 1] == 0)) {
+            nalEnd--;
+        }
+        if ((nalEnd - nalStart) < 2) {
+            continue;
+        }
+
+        const uint32_t nalUnitType = (data[nalStart] >> 1) & 0x3f;
+        if (nalUnitType > NUT_RSV_VCL31) {
+            static const uint8_t startCode[] = { 0x00, 0x00, 0x00, 0x01 };
+            frameData.insert(frameData.end(), startCode, startCode + sizeof(startCode));
+            frameData.insert(frameData.end(), data + nalStart, data + nalEnd);
+            continue;
+        }
+        if (!RewriteSliceSegment(sps, pps, bandSizeInCtbs, bandStartCtb, picSizeInCtbs,
+                                 data + nalStart, nalEnd - nalStart, frameData)) {
+            fprintf(stderr, "Failed to stitch the slice of the split frame band at the CTB %u\n", bandStartCtb);
+            return false;
+        }
+        numSlices++;
+    }
+    return (numSlices > 0);
+}
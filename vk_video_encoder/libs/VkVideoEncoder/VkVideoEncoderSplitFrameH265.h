@@ -0,0 +1,40 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERSPLITFRAMEH265_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERSPLITFRAMEH265_H_
+
+#include <stdint.h>
+#include <vector>
+#include "vulkan_interfaces.h"
+#include "VkVideoEncoder/VkVideoEncoderStateH265.h"
+
+// The slices of the row bands of a split frame, each band coded as a picture of its own by its session, stitched
+// into the slices of the whole picture. Of the slice segment header, only the address depends on the band: the
+// header is parsed to its end with the parameter sets of the band, then written again with the address of the
+// slice in the whole picture. The slice data is copied as it is.
+class VkVideoEncoderSplitFrameH265
+{
+public:
+    // Appends the NAL units of the coded picture of a band, with start codes, to frameData. The slices are of a
+    // band of bandSizeInCtbs CTBs that starts at the CTB bandStartCtb of a picture of picSizeInCtbs CTBs. The
+    // other NAL units are copied. False if a slice header can't be parsed, e.g. of a P or B slice.
+    static bool AppendBandSlices(const SpsH265& sps, const StdVideoH265PictureParameterSet& pps,
+                                 uint32_t bandSizeInCtbs, uint32_t bandStartCtb, uint32_t picSizeInCtbs,
+                                 const uint8_t* data, size_t size, std::vector<uint8_t>& frameData);
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERSPLITFRAMEH265_H_ */
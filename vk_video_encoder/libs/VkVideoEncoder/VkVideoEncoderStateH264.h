@@ -74,7 +74,7 @@ public:
     StdVideoH264SequenceParameterSetVui      m_vuiInfo;
     StdVideoH264HrdParameters                m_hrdParameters;
     VkVideoEncodeH264RateControlInfoKHR      m_rateControlInfoH264;
-    VkVideoEncodeH264RateControlLayerInfoKHR m_rateControlLayersInfoH264[1];
+    VkVideoEncodeH264RateControlLayerInfoKHR m_rateControlLayersInfoH264[EncoderConfig::MAX_TEMPORAL_LAYER_COUNT];
 };
 
 #endif /* _LIBS_VKVIDEOENCODER_VKVIDEOENCODERSTATEH264_H_ */
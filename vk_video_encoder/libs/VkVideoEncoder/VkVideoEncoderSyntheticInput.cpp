@@ -0,0 +1,319 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <array>
+#include <sstream>
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+#include "VkVideoEncoderSyntheticInput.h"
+
+static const uint32_t workgroupSize = 16;
+
+VkResult VkVideoEncoderSyntheticInput::Create(const VulkanDeviceContext* vkDevCtx,
+                                              VkFormat inputFormat,
+                                              const VkExtent2D& inputExtent,
+                                              VkSharedBaseObj<VkVideoEncoderSyntheticInput>& syntheticInput)
+{
+    // The descriptors are pushed with the command buffer of each frame
+    if (!vkDevCtx->FindRequiredDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) ||
+            (vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(inputFormat);
+    if ((mpInfo == nullptr) || (mpInfo->planesLayout.numberOfExtraPlanes != 1)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    VkSharedBaseObj<VkVideoEncoderSyntheticInput> generator(new VkVideoEncoderSyntheticInput(vkDevCtx, inputFormat,
+                                                                                              inputExtent));
+    if (!generator) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = generator->Init();
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    syntheticInput = generator;
+    return VK_SUCCESS;
+}
+
+VkVideoEncoderSyntheticInput::VkVideoEncoderSyntheticInput(const VulkanDeviceContext* vkDevCtx, VkFormat inputFormat,
+                                                           const VkExtent2D& inputExtent)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_inputFormat(inputFormat)
+    , m_inputExtent(inputExtent)
+    , m_chromaShiftX(0)
+    , m_chromaShiftY(0)
+    , m_vulkanShaderCompiler()
+    , m_descriptorSetLayout()
+    , m_computePipeline()
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(inputFormat);
+    if (mpInfo != nullptr) {
+        m_chromaShiftX = mpInfo->planesLayout.secondaryPlaneSubsampledX ? 1 : 0;
+        m_chromaShiftY = mpInfo->planesLayout.secondaryPlaneSubsampledY ? 1 : 0;
+    }
+}
+
+VkResult VkVideoEncoderSyntheticInput::Init()
+{
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        //                        binding,  descriptorType,          descriptorCount, stageFlags, pImmutableSamplers;
+        // Binding 0: Input image (write-only) Y plane
+        VkDescriptorSetLayoutBinding{ 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 1: Input image (write-only) CbCr plane
+        VkDescriptorSetLayoutBinding{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // The source image layer, the luma extent and the frame number
+    pushConstantRange.size = 4 * sizeof(uint32_t);
+
+    VkResult result = m_descriptorSetLayout.CreateDescriptorSet(m_vkDevCtx,
+                                                                setLayoutBindings,
+                                                                VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                                1, &pushConstantRange,
+                                                                nullptr,
+                                                                1,
+                                                                false);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::string computeShader;
+    const size_t computeShaderSize = InitShader(computeShader);
+    return m_computePipeline.CreatePipeline(m_vkDevCtx, m_vulkanShaderCompiler,
+                                            computeShader.c_str(), computeShaderSize,
+                                            "main",
+                                            workgroupSize, workgroupSize,
+                                            &m_descriptorSetLayout);
+}
+
+size_t VkVideoEncoderSyntheticInput::InitShader(std::string& computeShader) const
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_inputFormat);
+    const bool is16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != 0);
+    // The 10 and 12-bit samples are in the most significant bits of the 16-bit ones
+    const uint32_t bitDepth = is16BitSample ? (8 + 2 * mpInfo->planesLayout.bpp) : 8;
+    const uint32_t containerBits = is16BitSample ? 16 : 8;
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
+                        "    uint frameNum;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << workgroupSize << ", local_size_y = " << workgroupSize << ") in;\n"
+                        "layout (set = 0, binding = 0, " << (is16BitSample ? "r16" : "r8") <<
+                                ") uniform writeonly image2DArray imageY;\n"
+                        "layout (set = 0, binding = 1, " << (is16BitSample ? "rg16" : "rg8") <<
+                                ") uniform writeonly image2DArray imageCbCr;\n"
+                        "\n"
+                        "const ivec2 chromaShift = ivec2(" << m_chromaShiftX << ", " << m_chromaShiftY << ");\n"
+                        // From the normalized value to the sample code, and the largest code
+                        "const float codeScale = " << std::to_string((double)((1u << containerBits) - 1) /
+                                                                         (1u << (containerBits - bitDepth))) << ";\n"
+                        "const float maxCode = " << std::to_string((double)((1u << bitDepth) - 1)) << ";\n"
+                        "\n"
+                        "// The 75% color bars, in 8-bit BT.601 YCbCr\n"
+                        "const vec3 colorBars[8] = vec3[8](vec3(180.0, 128.0, 128.0), vec3(162.0, 44.0, 142.0),\n"
+                        "                                  vec3(131.0, 156.0, 44.0), vec3(112.0, 72.0, 58.0),\n"
+                        "                                  vec3(84.0, 184.0, 198.0), vec3(65.0, 100.0, 212.0),\n"
+                        "                                  vec3(35.0, 212.0, 114.0), vec3(16.0, 128.0, 128.0));\n"
+                        "\n"
+                        "float storeSample(float value) {\n"
+                        "    return clamp(round(value * (maxCode / 255.0)), 0.0, maxCode) / codeScale;\n"
+                        "}\n"
+                        "\n"
+                        "uint hash(uint x) {\n"
+                        "    x ^= x >> 16;\n"
+                        "    x *= 0x7feb352du;\n"
+                        "    x ^= x >> 15;\n"
+                        "    x *= 0x846ca68bu;\n"
+                        "    x ^= x >> 16;\n"
+                        "    return x;\n"
+                        "}\n"
+                        "\n"
+                        "float noise(ivec2 pos, uint seed) {\n"
+                        "    return float(hash(uint(pos.x) * 1973u + uint(pos.y) * 9277u + seed * 26699u) & 255u);\n"
+                        "}\n"
+                        "\n"
+                        "// The YCbCr of a luma position, on the 8-bit scale\n"
+                        "vec3 generate(ivec2 pos, int frame) {\n"
+                        "    ivec2 extent = ivec2(pushConstants.width, pushConstants.height);\n"
+                        "    vec3 color;\n"
+                        "    if (pos.y < extent.y / 3) {\n"
+                        "        // Scrolling left to right, 4 samples per frame\n"
+                        "        int barWidth = max(extent.x / 8, 1);\n"
+                        "        color = colorBars[((pos.x - 4 * frame) / barWidth) & 7];\n"
+                        "    } else if (pos.y < (2 * extent.y) / 3) {\n"
+                        "        // A smooth diagonal ramp moving down, 2 samples per frame\n"
+                        "        float ramp = float((pos.x + pos.y - 2 * frame) & 511);\n"
+                        "        float luma = 16.0 + (219.0 / 256.0) * ((ramp < 256.0) ? ramp : (511.0 - ramp));\n"
+                        "        color = vec3(luma, 128.0 + 48.0 * sin(float(pos.x) * 0.01 + float(frame) * 0.02),\n"
+                        "                     128.0 + 48.0 * cos(float(pos.y) * 0.01 - float(frame) * 0.03));\n"
+                        "    } else {\n"
+                        "        // A texture of 4x4 cells panning by (3, 1) per frame, with some noise of its own\n"
+                        "        ivec2 cell = (pos - ivec2(3, 1) * frame) >> 2;\n"
+                        "        float pattern = 48.0 + 0.625 * noise(cell, 0u) + (noise(pos, uint(frame) + 1u) - 128.0) / 32.0;\n"
+                        "        color = vec3(pattern, 112.0 + noise(cell, 1u) / 8.0, 112.0 + noise(cell, 2u) / 8.0);\n"
+                        "    }\n"
+                        "\n"
+                        "    // A box bouncing over the picture\n"
+                        "    ivec2 boxSize = max(extent / 8, ivec2(1));\n"
+                        "    ivec2 travel = max(extent - boxSize, ivec2(1));\n"
+                        "    ivec2 boxPos = ivec2(5, 3) * frame % (2 * travel);\n"
+                        "    boxPos = min(boxPos, 2 * travel - boxPos);\n"
+                        "    if (all(greaterThanEqual(pos, boxPos)) && all(lessThan(pos, boxPos + boxSize))) {\n"
+                        "        color = vec3(235.0, 128.0 + 64.0 * sin(float(frame) * 0.1), 128.0 - 64.0 * sin(float(frame) * 0.1));\n"
+                        "    }\n"
+                        "    return color;\n"
+                        "}\n"
+                        "\n"
+                        "void main()\n"
+                        "{\n"
+                        "    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);\n"
+                        "    if ((pos.x >= int(pushConstants.width)) || (pos.y >= int(pushConstants.height))) {\n"
+                        "        return;\n"
+                        "    }\n"
+                        "\n"
+                        "    int frame = int(pushConstants.frameNum);\n"
+                        "    vec3 color = generate(pos, frame);\n"
+                        "    imageStore(imageY, ivec3(pos, pushConstants.srcImageLayer), vec4(storeSample(color.x)));\n"
+                        "\n"
+                        "    // The chroma is taken from the top-left luma position of each chroma sample\n"
+                        "    if (all(equal(pos & ((ivec2(1) << chromaShift) - 1), ivec2(0)))) {\n"
+                        "        imageStore(imageCbCr, ivec3(pos >> chromaShift, pushConstants.srcImageLayer),\n"
+                        "                   vec4(storeSample(color.y), storeSample(color.z), 0.0, 0.0));\n"
+                        "    }\n"
+                        "}\n";
+
+    computeShader = shaderStr.str();
+    return computeShader.size();
+}
+
+VkResult VkVideoEncoderSyntheticInput::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                           const VkImageResourceView* inputImageView,
+                                                           uint32_t inputImageLayer,
+                                                           uint64_t frameNum)
+{
+    assert(inputImageView != nullptr);
+
+    VkImageMemoryBarrier2KHR imageBarrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_NONE_KHR, // VkPipelineStageFlags2KHR srcStageMask
+            0, // VkAccessFlags2KHR        srcAccessMask
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR, // VkAccessFlags   dstAccessMask
+            VK_IMAGE_LAYOUT_UNDEFINED, // VkImageLayout   oldLayout, the whole frame is overwritten
+            VK_IMAGE_LAYOUT_GENERAL, // VkImageLayout   newLayout
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+            inputImageView->GetImageResource()->GetImage(), // VkImage         image;
+            {
+                // VkImageSubresourceRange   subresourceRange
+                VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                0, // uint32_t           baseMipLevel
+                1, // uint32_t           levelCount
+                inputImageLayer, // uint32_t           baseArrayLayer
+                1, // uint32_t           layerCount;
+            },
+    };
+
+    const VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &imageBarrier,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 2;
+    VkDescriptorImageInfo imageDescriptors[numDescriptors]{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    for (uint32_t planeNum = 0; planeNum < numDescriptors; planeNum++) {
+        imageDescriptors[planeNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[planeNum].imageView = inputImageView->GetPlaneImageView(planeNum);
+        assert(imageDescriptors[planeNum].imageView);
+        imageDescriptors[planeNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[planeNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = planeNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.pImageInfo = &imageDescriptors[planeNum];
+    }
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t width;
+        uint32_t height;
+        uint32_t frameNum;
+    };
+
+    // The motion wraps around with the frame number, well past the length of a benchmark run
+    const PushConstants pushConstants = {
+            inputImageLayer,
+            m_inputExtent.width,
+            m_inputExtent.height,
+            (uint32_t)(frameNum & 0xffffff)
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    m_vkDevCtx->CmdDispatch(cmdBuf, (m_inputExtent.width + workgroupSize - 1) / workgroupSize,
+                            (m_inputExtent.height + workgroupSize - 1) / workgroupSize, 1);
+
+    // The encode submission waits on the input semaphore, which makes the shader writes available
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    return VK_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERSYNTHETICINPUT_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERSYNTHETICINPUT_H_
+
+#include <atomic>
+#include <string>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanShaderCompiler.h"
+#include "VkCodecUtils/VulkanDescriptorSetLayout.h"
+#include "VkCodecUtils/VulkanComputePipeline.h"
+#include "VkCodecUtils/VkImageResource.h"
+
+// Generates moving content into the input images on the GPU for the --benchmark runs, instead of reading the input
+// frames from a file: color bars scrolling horizontally, a diagonal gradient moving down, a panning noise texture
+// with a bit of temporal noise over it, and a box bouncing across the picture. The content of a frame only depends
+// on its input order number.
+class VkVideoEncoderSyntheticInput : public VkVideoRefCountBase
+{
+public:
+    // The input format is the 2-plane format of the encoder input images, which need the storage usage.
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkFormat inputFormat,
+                           const VkExtent2D& inputExtent,
+                           VkSharedBaseObj<VkVideoEncoderSyntheticInput>& syntheticInput);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the generator if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Records the generation of that frame, overwriting the whole input image, which is left in the video encode
+    // source layout. The command buffer must be submitted to a compute queue.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 const VkImageResourceView* inputImageView,
+                                 uint32_t inputImageLayer,
+                                 uint64_t frameNum);
+
+private:
+    VkVideoEncoderSyntheticInput(const VulkanDeviceContext* vkDevCtx, VkFormat inputFormat,
+                                 const VkExtent2D& inputExtent);
+
+    virtual ~VkVideoEncoderSyntheticInput() {}
+
+    VkResult Init();
+    size_t InitShader(std::string& computeShader) const;
+
+private:
+    std::atomic<int32_t>                           m_refCount;
+    const VulkanDeviceContext*                     m_vkDevCtx;
+    const VkFormat                                 m_inputFormat;
+    const VkExtent2D                               m_inputExtent;
+    uint32_t                                       m_chromaShiftX;
+    uint32_t                                       m_chromaShiftY;
+    VulkanShaderCompiler                           m_vulkanShaderCompiler;
+    VulkanDescriptorSetLayout                      m_descriptorSetLayout;
+    VulkanComputePipeline                          m_computePipeline;
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERSYNTHETICINPUT_H_ */
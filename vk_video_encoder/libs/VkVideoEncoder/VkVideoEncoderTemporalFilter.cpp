@@ -0,0 +1,450 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include "nvidia_utils/vulkan/ycbcrvkinfo.h"
+#include "VkVideoEncoderTemporalFilter.h"
+
+// The motion is searched per block of 8x8 luma samples, over +-4 samples
+static const uint32_t blockSize = 8;
+static const uint32_t searchRange = 4;
+static const uint32_t workgroupSize = 8;
+
+// On the 8-bit scale, the mean absolute difference of the best match and the difference of a sample past which
+// they are no longer averaged, a bit over the noise of a typical camera source
+static const float blockMatchThreshold = 6.0f;
+static const float sampleMatchThreshold = 12.0f;
+
+VkResult VkVideoEncoderTemporalFilter::Create(const VulkanDeviceContext* vkDevCtx,
+                                              VkFormat inputFormat,
+                                              const VkExtent2D& inputExtent,
+                                              float strength,
+                                              VkSharedBaseObj<VkVideoEncoderTemporalFilter>& temporalFilter)
+{
+    // The descriptors are pushed with the command buffer of each frame
+    if (!vkDevCtx->FindRequiredDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) ||
+            (vkDevCtx->GetComputeQueueFamilyIdx() < 0)) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(inputFormat);
+    if ((mpInfo == nullptr) || (mpInfo->planesLayout.numberOfExtraPlanes != 1)) {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    strength = std::min(std::max(strength, 0.0f), 1.0f);
+    VkSharedBaseObj<VkVideoEncoderTemporalFilter> filter(new VkVideoEncoderTemporalFilter(vkDevCtx, inputFormat,
+                                                                                           inputExtent, strength));
+    if (!filter) {
+        assert(!"Couldn't allocate host memory!");
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkResult result = filter->Init();
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    temporalFilter = filter;
+    return VK_SUCCESS;
+}
+
+VkVideoEncoderTemporalFilter::VkVideoEncoderTemporalFilter(const VulkanDeviceContext* vkDevCtx, VkFormat inputFormat,
+                                                           const VkExtent2D& inputExtent, float strength)
+    : m_refCount(0)
+    , m_vkDevCtx(vkDevCtx)
+    , m_inputFormat(inputFormat)
+    , m_inputExtent(inputExtent)
+    , m_strength(strength)
+    , m_chromaExtent(inputExtent)
+    , m_chromaShiftX(0)
+    , m_chromaShiftY(0)
+    , m_vulkanShaderCompiler()
+    , m_descriptorSetLayout()
+    , m_computePipeline()
+    , m_filteredFrames()
+    , m_numFilteredFrames(0)
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(inputFormat);
+    if (mpInfo != nullptr) {
+        m_chromaShiftX = mpInfo->planesLayout.secondaryPlaneSubsampledX ? 1 : 0;
+        m_chromaShiftY = mpInfo->planesLayout.secondaryPlaneSubsampledY ? 1 : 0;
+    }
+    m_chromaExtent.width = (inputExtent.width + (1 << m_chromaShiftX) - 1) >> m_chromaShiftX;
+    m_chromaExtent.height = (inputExtent.height + (1 << m_chromaShiftY) - 1) >> m_chromaShiftY;
+}
+
+VkResult VkVideoEncoderTemporalFilter::Init()
+{
+    const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        //                        binding,  descriptorType,          descriptorCount, stageFlags, pImmutableSamplers;
+        // Binding 0: Input image (read-write) Y plane
+        VkDescriptorSetLayoutBinding{ 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 1: Input image (read-write) CbCr plane
+        VkDescriptorSetLayoutBinding{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 2: Filtered current frame (write)
+        VkDescriptorSetLayoutBinding{ 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        // Binding 3: Filtered previous frame (read-only)
+        VkDescriptorSetLayoutBinding{ 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // The source image layer, the luma and chroma extents, whether there is a previous frame and the strength
+    pushConstantRange.size = 7 * sizeof(uint32_t);
+
+    VkResult result = m_descriptorSetLayout.CreateDescriptorSet(m_vkDevCtx,
+                                                                setLayoutBindings,
+                                                                VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                                1, &pushConstantRange,
+                                                                nullptr,
+                                                                1,
+                                                                false);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::string computeShader;
+    const size_t computeShaderSize = InitShader(computeShader);
+    result = m_computePipeline.CreatePipeline(m_vkDevCtx, m_vulkanShaderCompiler,
+                                              computeShader.c_str(), computeShaderSize,
+                                              "main",
+                                              workgroupSize, workgroupSize,
+                                              &m_descriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // Two half-precision luma samples or a Cb and Cr pair per uint, the luma rows first
+    VulkanMemoryOwnerScope ownerScope(VULKAN_MEMORY_OWNER_FILTER);
+    const VkDeviceSize lumaSize = (VkDeviceSize)((m_inputExtent.width + 1) / 2) * m_inputExtent.height;
+    const VkDeviceSize chromaSize = (VkDeviceSize)m_chromaExtent.width * m_chromaExtent.height;
+    for (VkSharedBaseObj<VkBufferResource>& filteredFrame : m_filteredFrames) {
+        result = VkBufferResource::Create(m_vkDevCtx,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                          (lumaSize + chromaSize) * sizeof(uint32_t),
+                                          filteredFrame);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+size_t VkVideoEncoderTemporalFilter::InitShader(std::string& computeShader) const
+{
+    const VkMpFormatInfo* mpInfo = YcbcrVkFormatInfo(m_inputFormat);
+    const bool is16BitSample = (mpInfo != nullptr) && (mpInfo->planesLayout.bpp != 0);
+    // The 10 and 12-bit samples are in the most significant bits of the 16-bit ones
+    const uint32_t bitDepth = is16BitSample ? (8 + 2 * mpInfo->planesLayout.bpp) : 8;
+    const uint32_t containerBits = is16BitSample ? 16 : 8;
+
+    std::stringstream shaderStr;
+    shaderStr << "#version 450\n"
+                        "layout(push_constant) uniform PushConstants {\n"
+                        "    uint srcImageLayer;\n"
+                        "    uint width;\n"
+                        "    uint height;\n"
+                        "    uint chromaWidth;\n"
+                        "    uint chromaHeight;\n"
+                        "    uint hasPrevious;\n"
+                        "    float strength;\n"
+                        "} pushConstants;\n"
+                        "\n"
+                        "layout (local_size_x = " << workgroupSize << ", local_size_y = " << workgroupSize << ") in;\n"
+                        "layout (set = 0, binding = 0, " << (is16BitSample ? "r16" : "r8") <<
+                                ") uniform image2DArray imageY;\n"
+                        "layout (set = 0, binding = 1, " << (is16BitSample ? "rg16" : "rg8") <<
+                                ") uniform image2DArray imageCbCr;\n"
+                        "layout (set = 0, binding = 2) writeonly buffer CurrentFiltered {\n"
+                        "    uint currentFiltered[];\n"
+                        "};\n"
+                        "layout (set = 0, binding = 3) readonly buffer PreviousFiltered {\n"
+                        "    uint previousFiltered[];\n"
+                        "};\n"
+                        "\n"
+                        "const int blockSize = " << blockSize << ";\n"
+                        "const int searchRange = " << searchRange << ";\n"
+                        "const ivec2 chromaShift = ivec2(" << m_chromaShiftX << ", " << m_chromaShiftY << ");\n"
+                        "const float blockMatchThreshold = " << std::to_string(blockMatchThreshold) << ";\n"
+                        "const float sampleMatchThreshold = " << std::to_string(sampleMatchThreshold) << ";\n"
+                        // From the normalized value to the sample code, and the largest code
+                        "const float codeScale = " << std::to_string((double)((1u << containerBits) - 1) /
+                                                                         (1u << (containerBits - bitDepth))) << ";\n"
+                        "const float maxCode = " << std::to_string((double)((1u << bitDepth) - 1)) << ";\n"
+                        "\n"
+                        "float loadSample(float normalized) {\n"
+                        "    return round(normalized * codeScale) * (255.0 / maxCode);\n"
+                        "}\n"
+                        "\n"
+                        "float storeSample(float value) {\n"
+                        "    return clamp(round(value * (maxCode / 255.0)), 0.0, maxCode) / codeScale;\n"
+                        "}\n"
+                        "\n"
+                        "float fetchPreviousY(ivec2 pos) {\n"
+                        "    pos = clamp(pos, ivec2(0), ivec2(pushConstants.width - 1, pushConstants.height - 1));\n"
+                        "    vec2 pair = unpackHalf2x16(previousFiltered[pos.y * ((pushConstants.width + 1) / 2) + pos.x / 2]);\n"
+                        "    return ((pos.x & 1) == 0) ? pair.x : pair.y;\n"
+                        "}\n"
+                        "\n"
+                        "uint chromaIndex(ivec2 pos) {\n"
+                        "    return ((pushConstants.width + 1) / 2) * pushConstants.height +\n"
+                        "           pos.y * pushConstants.chromaWidth + pos.x;\n"
+                        "}\n"
+                        "\n"
+                        "vec2 fetchPreviousCbCr(ivec2 pos) {\n"
+                        "    pos = clamp(pos, ivec2(0), ivec2(pushConstants.chromaWidth - 1, pushConstants.chromaHeight - 1));\n"
+                        "    return unpackHalf2x16(previousFiltered[chromaIndex(pos)]);\n"
+                        "}\n"
+                        "\n"
+                        "// The weight of the previous frame, down to none for the samples too far from their match\n"
+                        "float sampleWeight(float blockWeight, float difference) {\n"
+                        "    return blockWeight * clamp(1.0 - difference / sampleMatchThreshold, 0.0, 1.0);\n"
+                        "}\n"
+                        "\n"
+                        "void main()\n"
+                        "{\n"
+                        "    ivec2 blockPos = ivec2(gl_GlobalInvocationID.xy) * blockSize;\n"
+                        "    ivec2 extent = ivec2(pushConstants.width, pushConstants.height);\n"
+                        "    if ((blockPos.x >= extent.x) || (blockPos.y >= extent.y)) {\n"
+                        "        return;\n"
+                        "    }\n"
+                        "\n"
+                        "    // The luma of the block, on the 8-bit scale\n"
+                        "    float block[blockSize * blockSize];\n"
+                        "    for (int y = 0; y < blockSize; y++) {\n"
+                        "        for (int x = 0; x < blockSize; x++) {\n"
+                        "            ivec2 pos = min(blockPos + ivec2(x, y), extent - 1);\n"
+                        "            block[y * blockSize + x] = loadSample(imageLoad(imageY, ivec3(pos, pushConstants.srcImageLayer)).r);\n"
+                        "        }\n"
+                        "    }\n"
+                        "\n"
+                        "    // The zero motion is kept on ties, for the static areas\n"
+                        "    ivec2 motion = ivec2(0);\n"
+                        "    float blockWeight = 0.0;\n"
+                        "    if (pushConstants.hasPrevious != 0) {\n"
+                        "        float bestSad = 3.0e38;\n"
+                        "        for (int my = -searchRange; my <= searchRange; my++) {\n"
+                        "            for (int mx = -searchRange; mx <= searchRange; mx++) {\n"
+                        "                float sad = 0.0;\n"
+                        "                for (int y = 0; y < blockSize; y++) {\n"
+                        "                    for (int x = 0; x < blockSize; x++) {\n"
+                        "                        sad += abs(block[y * blockSize + x] - fetchPreviousY(blockPos + ivec2(x + mx, y + my)));\n"
+                        "                    }\n"
+                        "                }\n"
+                        "                if ((sad < bestSad) || ((sad == bestSad) && (mx == 0) && (my == 0))) {\n"
+                        "                    bestSad = sad;\n"
+                        "                    motion = ivec2(mx, my);\n"
+                        "                }\n"
+                        "            }\n"
+                        "        }\n"
+                        "        float meanDifference = bestSad / float(blockSize * blockSize);\n"
+                        "        blockWeight = pushConstants.strength * clamp(1.0 - meanDifference / blockMatchThreshold, 0.0, 1.0);\n"
+                        "    }\n"
+                        "\n"
+                        "    for (int y = 0; (y < blockSize) && (blockPos.y + y < extent.y); y++) {\n"
+                        "        for (int x = 0; (x < blockSize) && (blockPos.x + x < extent.x); x += 2) {\n"
+                        "            ivec2 pos = blockPos + ivec2(x, y);\n"
+                        "            vec2 filtered;\n"
+                        "            for (int i = 0; i < 2; i++) {\n"
+                        "                float value = block[y * blockSize + x + i];\n"
+                        "                float previous = fetchPreviousY(pos + ivec2(i, 0) + motion);\n"
+                        "                filtered[i] = mix(value, previous, sampleWeight(blockWeight, abs(value - previous)));\n"
+                        "            }\n"
+                        "            currentFiltered[pos.y * ((extent.x + 1) / 2) + pos.x / 2] = packHalf2x16(filtered);\n"
+                        "            if (blockWeight > 0.0) {\n"
+                        "                imageStore(imageY, ivec3(pos, pushConstants.srcImageLayer), vec4(storeSample(filtered.x)));\n"
+                        "                if (pos.x + 1 < extent.x) {\n"
+                        "                    imageStore(imageY, ivec3(pos.x + 1, pos.y, pushConstants.srcImageLayer),\n"
+                        "                               vec4(storeSample(filtered.y)));\n"
+                        "                }\n"
+                        "            }\n"
+                        "        }\n"
+                        "    }\n"
+                        "\n"
+                        "    // The chroma of the block follows the luma motion\n"
+                        "    ivec2 chromaBlockPos = blockPos >> chromaShift;\n"
+                        "    ivec2 chromaBlockSize = ivec2(blockSize) >> chromaShift;\n"
+                        "    ivec2 chromaMotion = motion >> chromaShift;\n"
+                        "    ivec2 chromaExtent = ivec2(pushConstants.chromaWidth, pushConstants.chromaHeight);\n"
+                        "    for (int y = 0; (y < chromaBlockSize.y) && (chromaBlockPos.y + y < chromaExtent.y); y++) {\n"
+                        "        for (int x = 0; (x < chromaBlockSize.x) && (chromaBlockPos.x + x < chromaExtent.x); x++) {\n"
+                        "            ivec2 pos = chromaBlockPos + ivec2(x, y);\n"
+                        "            vec2 sampleCbCr = imageLoad(imageCbCr, ivec3(pos, pushConstants.srcImageLayer)).rg;\n"
+                        "            vec2 value = vec2(loadSample(sampleCbCr.x), loadSample(sampleCbCr.y));\n"
+                        "            vec2 previous = fetchPreviousCbCr(pos + chromaMotion);\n"
+                        "            vec2 filtered = vec2(mix(value.x, previous.x, sampleWeight(blockWeight, abs(value.x - previous.x))),\n"
+                        "                                 mix(value.y, previous.y, sampleWeight(blockWeight, abs(value.y - previous.y))));\n"
+                        "            currentFiltered[chromaIndex(pos)] = packHalf2x16(filtered);\n"
+                        "            if (blockWeight > 0.0) {\n"
+                        "                imageStore(imageCbCr, ivec3(pos, pushConstants.srcImageLayer),\n"
+                        "                           vec4(storeSample(filtered.x), storeSample(filtered.y), 0.0, 0.0));\n"
+                        "            }\n"
+                        "        }\n"
+                        "    }\n"
+                        "}\n";
+
+    computeShader = shaderStr.str();
+    return computeShader.size();
+}
+
+VkResult VkVideoEncoderTemporalFilter::RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                                           const VkImageResourceView* inputImageView,
+                                                           uint32_t inputImageLayer,
+                                                           VkImageLayout imageLayout)
+{
+    assert(inputImageView != nullptr);
+
+    const VkBufferResource* currentFiltered = m_filteredFrames[m_numFilteredFrames % 2];
+    const VkBufferResource* previousFiltered = m_filteredFrames[(m_numFilteredFrames + 1) % 2];
+
+    // The filtered frame of the previous submission, then the input image being written
+    VkMemoryBarrier2KHR memoryBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // srcStageMask
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,   // srcAccessMask
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // dstStageMask
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR, // dstAccessMask
+    };
+
+    VkImageMemoryBarrier2KHR imageBarrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, // VkStructureType sType
+            nullptr, // const void*     pNext
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, // VkPipelineStageFlags2KHR srcStageMask
+            VK_ACCESS_2_MEMORY_WRITE_BIT_KHR, // VkAccessFlags2KHR        srcAccessMask
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, // VkPipelineStageFlags2KHR dstStageMask;
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR, // dstAccessMask
+            imageLayout, // VkImageLayout   oldLayout
+            VK_IMAGE_LAYOUT_GENERAL, // VkImageLayout   newLayout
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t        srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED, // uint32_t   dstQueueFamilyIndex
+            inputImageView->GetImageResource()->GetImage(), // VkImage         image;
+            {
+                // VkImageSubresourceRange   subresourceRange
+                VK_IMAGE_ASPECT_COLOR_BIT, // VkImageAspectFlags aspectMask
+                0, // uint32_t           baseMipLevel
+                1, // uint32_t           levelCount
+                inputImageLayer, // uint32_t           baseArrayLayer
+                1, // uint32_t           layerCount;
+            },
+    };
+
+    VkDependencyInfoKHR dependencyInfo = {
+        VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        nullptr,
+        VK_DEPENDENCY_BY_REGION_BIT,
+        1,
+        &memoryBarrier,
+        0,
+        nullptr,
+        1,
+        &imageBarrier,
+    };
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_vkDevCtx->CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.getPipeline());
+
+    const uint32_t numDescriptors = 4;
+    VkDescriptorImageInfo imageDescriptors[2]{};
+    VkDescriptorBufferInfo bufferDescriptors[2]{};
+    std::array<VkWriteDescriptorSet, numDescriptors> writeDescriptorSets{};
+
+    for (uint32_t planeNum = 0; planeNum < 2; planeNum++) {
+        imageDescriptors[planeNum].sampler = VK_NULL_HANDLE;
+        imageDescriptors[planeNum].imageView = inputImageView->GetPlaneImageView(planeNum);
+        assert(imageDescriptors[planeNum].imageView);
+        imageDescriptors[planeNum].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[planeNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = planeNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeDescriptorSet.pImageInfo = &imageDescriptors[planeNum];
+    }
+
+    const VkBufferResource* buffers[2] = { currentFiltered, previousFiltered };
+    for (uint32_t bufferNum = 0; bufferNum < 2; bufferNum++) {
+        bufferDescriptors[bufferNum].buffer = buffers[bufferNum]->GetBuffer();
+        bufferDescriptors[bufferNum].offset = 0;
+        bufferDescriptors[bufferNum].range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[2 + bufferNum];
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstBinding = 2 + bufferNum;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet.pBufferInfo = &bufferDescriptors[bufferNum];
+    }
+
+    m_vkDevCtx->CmdPushDescriptorSetKHR(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        m_descriptorSetLayout.GetPipelineLayout(),
+                                        0, numDescriptors, writeDescriptorSets.data());
+
+    struct PushConstants {
+        uint32_t srcLayer;
+        uint32_t width;
+        uint32_t height;
+        uint32_t chromaWidth;
+        uint32_t chromaHeight;
+        uint32_t hasPrevious;
+        float    strength;
+    };
+
+    const PushConstants pushConstants = {
+            inputImageLayer,
+            m_inputExtent.width,
+            m_inputExtent.height,
+            m_chromaExtent.width,
+            m_chromaExtent.height,
+            (m_numFilteredFrames > 0) ? 1u : 0u,
+            m_strength
+    };
+
+    m_vkDevCtx->CmdPushConstants(cmdBuf,
+                                 m_descriptorSetLayout.GetPipelineLayout(),
+                                 VK_SHADER_STAGE_COMPUTE_BIT,
+                                 0, // offset
+                                 sizeof(PushConstants),
+                                 &pushConstants);
+
+    const uint32_t blocksX = (m_inputExtent.width  + blockSize - 1) / blockSize;
+    const uint32_t blocksY = (m_inputExtent.height + blockSize - 1) / blockSize;
+    m_vkDevCtx->CmdDispatch(cmdBuf, (blocksX + workgroupSize - 1) / workgroupSize,
+                            (blocksY + workgroupSize - 1) / workgroupSize, 1);
+
+    // The filtered image is read by the commands recorded after this one, and by the encode submission,
+    // which waits on the input semaphore
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.newLayout = imageLayout;
+    dependencyInfo.memoryBarrierCount = 0;
+    dependencyInfo.pMemoryBarriers = nullptr;
+    m_vkDevCtx->CmdPipelineBarrier2KHR(cmdBuf, &dependencyInfo);
+
+    m_numFilteredFrames++;
+    return VK_SUCCESS;
+}
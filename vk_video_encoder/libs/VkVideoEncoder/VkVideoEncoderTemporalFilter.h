@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERTEMPORALFILTER_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERTEMPORALFILTER_H_
+
+#include <atomic>
+#include <string>
+#include "VkCodecUtils/VkVideoRefCountBase.h"
+#include "VkCodecUtils/VulkanDeviceContext.h"
+#include "VkCodecUtils/VulkanShaderCompiler.h"
+#include "VkCodecUtils/VulkanDescriptorSetLayout.h"
+#include "VkCodecUtils/VulkanComputePipeline.h"
+#include "VkCodecUtils/VkBufferResource.h"
+#include "VkCodecUtils/VkImageResource.h"
+
+// Denoises the input frames in place with a motion compensated recursive temporal filter, ahead of their encoding.
+// Per 8x8 luma block, the motion search finds the best match in the previous filtered frame, over a +-4 luma sample
+// search. The samples of the block are then blended with the matching ones, less so as their difference grows, so
+// that the noise is averaged over the frames while the edges, the uncovered areas and the scene cuts are kept.
+// The filtered frame is kept at half precision for the next frame. The frames must be recorded in input order,
+// into command buffers executing on a single queue.
+class VkVideoEncoderTemporalFilter : public VkVideoRefCountBase
+{
+public:
+    // The input format is the 2-plane format of the encoder input images, which need the storage usage.
+    // The strength, from 0 to 1, is the weight of the previous frame for the samples that match it exactly.
+    static VkResult Create(const VulkanDeviceContext* vkDevCtx,
+                           VkFormat inputFormat,
+                           const VkExtent2D& inputExtent,
+                           float strength,
+                           VkSharedBaseObj<VkVideoEncoderTemporalFilter>& temporalFilter);
+
+    virtual int32_t AddRef()
+    {
+        return ++m_refCount;
+    }
+
+    virtual int32_t Release()
+    {
+        uint32_t ret = --m_refCount;
+        // Destroy the filter if ref-count reaches zero
+        if (ret == 0) {
+            delete this;
+        }
+        return ret;
+    }
+
+    // Records the filter after the commands writing the input image, which is left in imageLayout.
+    // The command buffer must be submitted to a compute queue.
+    VkResult RecordCommandBuffer(VkCommandBuffer cmdBuf,
+                                 const VkImageResourceView* inputImageView,
+                                 uint32_t inputImageLayer,
+                                 VkImageLayout imageLayout);
+
+private:
+    VkVideoEncoderTemporalFilter(const VulkanDeviceContext* vkDevCtx, VkFormat inputFormat,
+                                 const VkExtent2D& inputExtent, float strength);
+
+    virtual ~VkVideoEncoderTemporalFilter() {}
+
+    VkResult Init();
+    size_t InitShader(std::string& computeShader) const;
+
+private:
+    std::atomic<int32_t>                           m_refCount;
+    const VulkanDeviceContext*                     m_vkDevCtx;
+    const VkFormat                                 m_inputFormat;
+    const VkExtent2D                               m_inputExtent;
+    const float                                    m_strength;
+    VkExtent2D                                     m_chromaExtent;
+    uint32_t                                       m_chromaShiftX;
+    uint32_t                                       m_chromaShiftY;
+    VulkanShaderCompiler                           m_vulkanShaderCompiler;
+    VulkanDescriptorSetLayout                      m_descriptorSetLayout;
+    VulkanComputePipeline                          m_computePipeline;
+    VkSharedBaseObj<VkBufferResource>              m_filteredFrames[2]; // alternating, the current and the previous one
+    uint64_t                                       m_numFilteredFrames;
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERTEMPORALFILTER_H_ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include "VkVideoEncoder/VkVideoGopStructure.h"
+#include "VkVideoEncoderTwoPass.h"
+
+// The bits of the frames are only averaged within their class, an intra frame is not complex next to a P frame
+static uint32_t GetPictureClass(int32_t pictureType)
+{
+    switch (pictureType) {
+    case VkVideoGopStructure::FRAME_TYPE_IDR:
+    case VkVideoGopStructure::FRAME_TYPE_I:
+        return 0;
+    case VkVideoGopStructure::FRAME_TYPE_B:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+bool VkVideoEncoderTwoPass::WriteStats(const char* fileName, std::vector<FrameStats>& frameStats)
+{
+    FILE* statsFile = fopen(fileName, "w");
+    if (statsFile == nullptr) {
+        fprintf(stderr, "Failed to open the first pass stats file %s for writing\n", fileName);
+        return false;
+    }
+
+    // The frames complete in encode order
+    std::sort(frameStats.begin(), frameStats.end(),
+              [](const FrameStats& a, const FrameStats& b) { return a.frameInputOrderNum < b.frameInputOrderNum; });
+
+    fprintf(statsFile, "frame,type,qp,bits,intraCost,interCost\n");
+    for (const FrameStats& stats : frameStats) {
+        fprintf(statsFile, "%llu,%d,%d,%llu,%u,%u\n",
+                (unsigned long long)stats.frameInputOrderNum, stats.pictureType, stats.qp,
+                (unsigned long long)stats.bits, stats.intraCost, stats.interCost);
+    }
+    fclose(statsFile);
+    return true;
+}
+
+bool VkVideoEncoderTwoPass::ReadStats(const char* fileName, std::vector<FrameStats>& frameStats)
+{
+    FILE* statsFile = fopen(fileName, "r");
+    if (statsFile == nullptr) {
+        fprintf(stderr, "Failed to open the first pass stats file %s\n", fileName);
+        return false;
+    }
+
+    frameStats.clear();
+    char line[256];
+    // The header line
+    if (fgets(line, sizeof(line), statsFile) == nullptr) {
+        fclose(statsFile);
+        return false;
+    }
+    while (fgets(line, sizeof(line), statsFile) != nullptr) {
+        unsigned long long frameInputOrderNum = 0;
+        unsigned long long bits = 0;
+        FrameStats stats = FrameStats();
+        if (sscanf(line, "%llu,%d,%d,%llu,%u,%u", &frameInputOrderNum, &stats.pictureType, &stats.qp,
+                   &bits, &stats.intraCost, &stats.interCost) != 6) {
+            fprintf(stderr, "Invalid first pass stats line: %s", line);
+            fclose(statsFile);
+            return false;
+        }
+        stats.frameInputOrderNum = frameInputOrderNum;
+        stats.bits = bits;
+        frameStats.push_back(stats);
+    }
+    fclose(statsFile);
+    return !frameStats.empty();
+}
+
+uint64_t VkVideoEncoderTwoPass::AllocateBits(const std::vector<FrameStats>& frameStats, uint64_t targetBits,
+                                             int32_t minQp, int32_t maxQp, std::vector<int8_t>& qpDeltas)
+{
+    qpDeltas.clear();
+    if (frameStats.empty()) {
+        return 0;
+    }
+
+    double averageBits[3] = { 0.0, 0.0, 0.0 };
+    uint32_t numFrames[3] = { 0, 0, 0 };
+    uint64_t numFramesTotal = 0;
+    for (const FrameStats& stats : frameStats) {
+        const uint32_t pictureClass = GetPictureClass(stats.pictureType);
+        averageBits[pictureClass] += (double)std::max<uint64_t>(stats.bits, 1);
+        numFrames[pictureClass]++;
+        numFramesTotal = std::max<uint64_t>(numFramesTotal, stats.frameInputOrderNum + 1);
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        if (numFrames[i] > 0) {
+            averageBits[i] /= numFrames[i];
+        }
+    }
+
+    // The share of its complexity a frame keeps over the average of its class
+    const double complexityQpScale = 6.0 * (1.0 - QP_COMPRESSION_PERCENT / 100.0);
+    std::vector<double> complexityDeltas(frameStats.size());
+    for (size_t i = 0; i < frameStats.size(); i++) {
+        const FrameStats& stats = frameStats[i];
+        const double bits = (double)std::max<uint64_t>(stats.bits, 1);
+        complexityDeltas[i] = complexityQpScale * log2(bits / averageBits[GetPictureClass(stats.pictureType)]);
+    }
+
+    auto getQpDelta = [&](size_t i, double offset) -> int32_t {
+        const int32_t qp = frameStats[i].qp;
+        const int32_t qpDelta = (int32_t)lround(offset + complexityDeltas[i]);
+        return std::min(std::max(qp + qpDelta, minQp), maxQp) - qp;
+    };
+    auto predictBits = [&](double offset) -> double {
+        double bits = 0.0;
+        for (size_t i = 0; i < frameStats.size(); i++) {
+            bits += (double)frameStats[i].bits * exp2(-getQpDelta(i, offset) / 6.0);
+        }
+        return bits;
+    };
+
+    // The predicted size decreases with the offset, the lowest offset within the target is searched for
+    double lowOffset = -51.0;
+    double highOffset = 51.0;
+    for (uint32_t iteration = 0; iteration < 32; iteration++) {
+        const double offset = (lowOffset + highOffset) / 2.0;
+        if (predictBits(offset) > (double)targetBits) {
+            lowOffset = offset;
+        } else {
+            highOffset = offset;
+        }
+    }
+
+    qpDeltas.assign((size_t)numFramesTotal, 0);
+    for (size_t i = 0; i < frameStats.size(); i++) {
+        qpDeltas[(size_t)frameStats[i].frameInputOrderNum] = (int8_t)getQpDelta(i, highOffset);
+    }
+    return (uint64_t)predictBits(highOffset);
+}
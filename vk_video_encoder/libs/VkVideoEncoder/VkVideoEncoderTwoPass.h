@@ -0,0 +1,51 @@
+/*
+ * Copyright 2024 NVIDIA Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKVIDEOENCODER_VKVIDEOENCODERTWOPASS_H_
+#define _VKVIDEOENCODER_VKVIDEOENCODERTWOPASS_H_
+
+#include <stdint.h>
+#include <vector>
+
+// The statistics of a constant QP first pass and the bit allocation of the second pass from them. The bits of a
+// frame are modeled to halve every 6 QP from those of the first pass. The QP of each frame is offset from its first
+// pass QP by a common offset, found for the frames to add up to the target size, and by a share of the log of its
+// bits against the average of its picture type, which evens out the quality of the complex and the simple frames.
+class VkVideoEncoderTwoPass
+{
+public:
+    enum { QP_COMPRESSION_PERCENT = 60 }; // 100 would give all the frames the same QP offset
+
+    struct FrameStats {
+        uint64_t frameInputOrderNum;
+        int32_t  pictureType; // VkVideoGopStructure::FrameType
+        int32_t  qp;
+        uint64_t bits;
+        uint32_t intraCost;   // of the look-ahead analysis, 0 without it
+        uint32_t interCost;
+    };
+
+    // One CSV line per frame, in input order
+    static bool WriteStats(const char* fileName, std::vector<FrameStats>& frameStats);
+    static bool ReadStats(const char* fileName, std::vector<FrameStats>& frameStats);
+
+    // The QP offsets from the first pass QPs, indexed by the input order number of the frames. The QPs stay in
+    // the [minQp, maxQp] range. Returns the size predicted for the second pass, in bits.
+    static uint64_t AllocateBits(const std::vector<FrameStats>& frameStats, uint64_t targetBits,
+                                 int32_t minQp, int32_t maxQp, std::vector<int8_t>& qpDeltas);
+};
+
+#endif /* _VKVIDEOENCODER_VKVIDEOENCODERTWOPASS_H_ */
@@ -27,6 +27,8 @@ VkVideoGopStructure::VkVideoGopStructure(int8_t gopFrameCount,
     , m_gopFrameCycle(m_consecutiveBFrameCount + 1)
     , m_temporalLayerCount(temporalLayerCount)
     , m_lastFrameType(lastFrameType)
+    , m_intraRefresh(false)
+    , m_pyramid(false)
 {
     Init();
 }
@@ -50,6 +52,7 @@ void VkVideoGopStructure::ComputeDecodeOrderMap()
     m_decodeOrderMap[gopFrameNum].frameType   = GetFrameType(0);
     m_decodeOrderMap[gopFrameNum].decodeOrder = decodeIndex++;
     m_decodeOrderMap[gopFrameNum].isReference = 1;
+    m_decodeOrderMap[gopFrameNum].pyramidLevel = 0;
     gopFrameNum++;
     for ( ;gopFrameNum < m_gopFrameCount + 1;
             gopFrameNum += m_gopFrameCycle) {
@@ -61,9 +64,23 @@ void VkVideoGopStructure::ComputeDecodeOrderMap()
                 m_decodeOrderMap[gopFrameNum + i].frameType   = frameType;
                 m_decodeOrderMap[gopFrameNum + i].isReference = 1;
                 m_decodeOrderMap[gopFrameNum + i].decodeOrder = decodeIndex++;
+                m_decodeOrderMap[gopFrameNum + i].pyramidLevel = 0;
             }
         }
 
+        if (m_pyramid) {
+            // Then, the B frames of the cycle, in the order of the pyramid
+            int8_t bFramePositions[MAX_GOP_SIZE];
+            int32_t numBFrames = 0;
+            for (int i = 0; (i < m_gopFrameCycle) && ((gopFrameNum + i) <= m_gopFrameCount); ++i) {
+                if (GetFrameType(gopFrameNum + i) == FRAME_TYPE_B) {
+                    bFramePositions[numBFrames++] = (int8_t)(gopFrameNum + i);
+                }
+            }
+            ComputePyramidDecodeOrder(bFramePositions, 0, numBFrames - 1, 1, decodeIndex);
+            continue;
+        }
+
         // Then, assign decode order for B frames
         for (int i = 0; i < m_gopFrameCycle; ++i) {
             FrameType frameType = GetFrameType(gopFrameNum + i);
@@ -71,6 +88,7 @@ void VkVideoGopStructure::ComputeDecodeOrderMap()
                 m_decodeOrderMap[gopFrameNum + i].frameType   = frameType;
                 m_decodeOrderMap[gopFrameNum + i].isReference = 0;
                 m_decodeOrderMap[gopFrameNum + i].decodeOrder = decodeIndex++;
+                m_decodeOrderMap[gopFrameNum + i].pyramidLevel = 0;
             }
         }
     }
@@ -91,6 +109,34 @@ void VkVideoGopStructure::ComputeDecodeOrderMap()
     }
 }
 
+void VkVideoGopStructure::ComputePyramidDecodeOrder(const int8_t* bFramePositions, int32_t first, int32_t last,
+                                                    uint8_t level, int8_t& decodeIndex)
+{
+    if (first > last) {
+        return;
+    }
+
+    // The middle frame predicts from the frames around the run, the frames of each half also from it
+    const int32_t middle = (first + last) / 2;
+    GopEntry& gopEntry = m_decodeOrderMap[bFramePositions[middle]];
+    gopEntry.frameType   = FRAME_TYPE_B;
+    gopEntry.isReference = (first < last) ? 1 : 0;
+    gopEntry.decodeOrder = decodeIndex++;
+    gopEntry.pyramidLevel = level;
+
+    ComputePyramidDecodeOrder(bFramePositions, first, middle - 1, level + 1, decodeIndex);
+    ComputePyramidDecodeOrder(bFramePositions, middle + 1, last, level + 1, decodeIndex);
+}
+
+uint8_t VkVideoGopStructure::GetNumPyramidReferences(int32_t numBFrames)
+{
+    if (numBFrames <= 1) {
+        return 0;
+    }
+    const int32_t numFirstHalf = (numBFrames - 1) / 2;
+    return 1 + GetNumPyramidReferences(numFirstHalf) + GetNumPyramidReferences(numBFrames - 1 - numFirstHalf);
+}
+
 VkVideoGopStructure::FrameType VkVideoGopStructure::GetFrameType(uint64_t frameNumInInputOrder,
                                                                  bool firstFrame, bool lastFrame) const
 {
@@ -102,16 +148,16 @@ VkVideoGopStructure::FrameType VkVideoGopStructure::GetFrameType(uint64_t frameN
         return m_lastFrameType;
     }
 
-    if (frameNumInInputOrder % m_idrPeriod == 0) {
+    if (!m_intraRefresh && (frameNumInInputOrder % m_idrPeriod == 0)) {
         return FRAME_TYPE_IDR;
     }
 
-    if (frameNumInInputOrder % m_gopFrameCount == 0) {
+    if (!m_intraRefresh && (frameNumInInputOrder % m_gopFrameCount == 0)) {
         return FRAME_TYPE_I;
     }
 
     uint8_t posInGop = frameNumInInputOrder % m_gopFrameCount;
-    return (posInGop % (m_consecutiveBFrameCount + 1) == 0) ? FRAME_TYPE_P : FRAME_TYPE_B;
+    return (posInGop % m_gopFrameCycle == 0) ? FRAME_TYPE_P : FRAME_TYPE_B;
 }
 
 void VkVideoGopStructure::PrintGopStructure(uint64_t numFrames) const
@@ -25,6 +25,7 @@
 #include <functional>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 static const uint32_t MAX_GOP_SIZE = 64;
 
@@ -38,6 +39,7 @@ public:
       FrameType                 frameType;
       uint8_t                   decodeOrder;
       uint8_t                   isReference : 1;
+      uint8_t                   pyramidLevel;   // 0 for the I and P frames, from 1 for the B-frames of a pyramid
       std::bitset<MAX_GOP_SIZE> references;
     };
 
@@ -87,6 +89,39 @@ public:
     void SetConsecutiveBFrameCount(int8_t consecutiveBFrameCount) { m_consecutiveBFrameCount = consecutiveBFrameCount; }
     int8_t GetConsecutiveBFrameCount() const { return m_consecutiveBFrameCount; }
 
+    // The adaptive GOP shortens the B-frame runs below consecutiveBFrameCount, which the stream parameters
+    // and the DPB stay sized for. Takes effect from the next frame on and must be set at an I or IDR frame,
+    // once the decode order of the frames before it is determined. Init() restores consecutiveBFrameCount.
+    void SetAdaptiveBFrameCount(int8_t bFrameCount) {
+
+        const int8_t gopFrameCycle = std::min(std::max(bFrameCount, (int8_t)0), m_consecutiveBFrameCount) + 1;
+        if (gopFrameCycle != m_gopFrameCycle) {
+            m_gopFrameCycle = gopFrameCycle;
+            ComputeDecodeOrderMap();
+        }
+    }
+    int8_t GetAdaptiveBFrameCount() const { return m_gopFrameCycle - 1; }
+
+    // With the pyramid, the B-frames between two I or P frames are coded as a dyadic hierarchy: the middle one first,
+    // as a reference for the B-frames of each half, and so on down to the non-reference B-frames of the top level.
+    void SetPyramid(bool pyramid) { m_pyramid = pyramid; }
+    bool GetPyramid() const { return m_pyramid; }
+
+    // The level of the frame in the pyramid, 0 for the I and P frames and for all the frames without the pyramid
+    uint8_t GetPyramidLevel(uint64_t frameNumInDisplayOrder) const {
+        return m_decodeOrderMap[frameNumInDisplayOrder % m_gopFrameCount].pyramidLevel;
+    }
+
+    // The reference B-frames of a run of consecutiveBFrameCount B-frames, 0 without the pyramid
+    uint8_t GetNumPyramidReferences() const {
+        return m_pyramid ? GetNumPyramidReferences(m_consecutiveBFrameCount) : 0;
+    }
+
+    // With the intra refresh, only the first frame and the forced ones are IDR frames, without I frames.
+    // The P frames refresh the picture instead, a band of slices at a time.
+    void SetIntraRefresh(bool intraRefresh) { m_intraRefresh = intraRefresh; }
+    bool GetIntraRefresh() const { return m_intraRefresh; }
+
     // specifies the number of H.264/5 sub-layers that the application intends to use.
     void SetTemporalLayerCount(int8_t temporalLayerCount) { m_temporalLayerCount = temporalLayerCount; }
     int8_t GetTemporalLayerCount() const { return m_temporalLayerCount; }
@@ -146,9 +181,32 @@ public:
     }
 
     bool IsFrameReference(uint64_t frameNumInDisplayOrder) const {
+        // The frames of the top temporal layer are never referenced, for the layer to be droppable.
+        if ((m_temporalLayerCount > 1) && (GetTemporalId(frameNumInDisplayOrder) == (m_temporalLayerCount - 1))) {
+            return false;
+        }
         return (m_decodeOrderMap[frameNumInDisplayOrder % m_gopFrameCount].isReference == 1);
     }
 
+    // The temporal layer of a frame of the dyadic hierarchy that repeats every 2^(temporalLayerCount - 1) frames
+    // from the IDR frame, without B-frames. Each frame predicts from the last reference frame of the lower layers,
+    // or from the last base layer frame for the base layer.
+    uint8_t GetTemporalId(uint64_t frameNumInDisplayOrder) const {
+        if (m_temporalLayerCount <= 1) {
+            return 0;
+        }
+        uint64_t positionInPattern = frameNumInDisplayOrder % (1ULL << (m_temporalLayerCount - 1));
+        if (positionInPattern == 0) {
+            return 0;
+        }
+        uint8_t temporalId = (uint8_t)(m_temporalLayerCount - 1);
+        while ((positionInPattern & 1) == 0) {
+            positionInPattern >>= 1;
+            temporalId--;
+        }
+        return temporalId;
+    }
+
     virtual void DumpFrameGopStructure(uint64_t frameNumInInputOrder,
                                        bool firstFrame = false, bool lastFrame = false) const;
 
@@ -159,12 +217,19 @@ public:
 protected:
     virtual void ComputeDecodeOrderMap();
 private:
+    static uint8_t GetNumPyramidReferences(int32_t numBFrames);
+    // The B-frames at bFramePositions[first..last] in display order, the middle one first, then each half
+    void ComputePyramidDecodeOrder(const int8_t* bFramePositions, int32_t first, int32_t last,
+                                   uint8_t level, int8_t& decodeIndex);
+
     int8_t                m_gopFrameCount;
     int8_t                m_idrPeriod;
     int8_t                m_consecutiveBFrameCount;
     int8_t                m_gopFrameCycle;
     int8_t                m_temporalLayerCount;
     FrameType             m_lastFrameType;
+    bool                  m_intraRefresh;
+    bool                  m_pyramid;
     std::vector<GopEntry> m_decodeOrderMap;
 };
 #endif /* _VKVIDEOENCODER_VKVIDEOGOPSTRUCTURE_H_ */